@@ -53,6 +53,9 @@ GC_SECTIONS ?= 0
 # set this to 1 to gzip-compress the kernel (AArch64 only)
 GZIP_KERNEL ?= 0
 
+# set this to 1 to build a self-extracting LZ4-compressed kernel (needs the lz4 tool)
+LZ4_KERNEL ?= 0
+
 ifneq ($(strip $(CLANG)),1)
 CC	= $(PREFIX)gcc
 CPP	= $(PREFIX)g++
@@ -197,6 +200,15 @@ ifeq ($(strip $(CHECK_DEPS)),1)
 DEPS	= $(OBJS:.o=.d)
 endif
 
+LZ4STUB_FLAGS = $(ARCH) -DLOADADDR=$(LOADADDR) -O2 -ffreestanding -fno-builtin \
+		-fno-tree-loop-distribute-patterns -fno-tree-vectorize
+ifeq ($(strip $(AARCH)),64)
+LZ4STUB_FLAGS += -mgeneral-regs-only
+LZ4STUB_STARTUP = $(CIRCLEHOME)/lib/lz4stub/startup64.S
+else
+LZ4STUB_STARTUP = $(CIRCLEHOME)/lib/lz4stub/startup.S
+endif
+
 %.o: %.S
 	@echo "  AS    $@"
 	@$(AS) $(AFLAGS) -c -o $@ $<
@@ -243,6 +255,24 @@ ifeq ($(strip $(GZIP_KERNEL)),1)
 	@wc -c < $(TARGET).img
 endif
 endif
+ifeq ($(strip $(LZ4_KERNEL)),1)
+	@lz4 -9 -l -f -q $(TARGET).img $(TARGET).lz4
+	@$(AS) $(LZ4STUB_FLAGS) -c -o lz4startup.o $(LZ4STUB_STARTUP)
+	@$(AS) $(LZ4STUB_FLAGS) -DLZ4_PAYLOAD=\"$(TARGET).lz4\" -c -o lz4payload.o \
+		$(CIRCLEHOME)/lib/lz4stub/payload.S
+	@$(CC) $(LZ4STUB_FLAGS) $(C_STANDARD) -c -o lz4stub.o $(CIRCLEHOME)/lib/lz4stub/lz4stub.c
+ifneq ($(strip $(CLANG)),1)
+	@$(LD) -o $(TARGET)-lz4.elf -T $(CIRCLEHOME)/lib/lz4stub/lz4stub.ld \
+		lz4startup.o lz4stub.o lz4payload.o
+else
+	@$(LD) -o $(TARGET)-lz4.elf $(ARCH) -nostdlib -T $(CIRCLEHOME)/lib/lz4stub/lz4stub.ld \
+		lz4startup.o lz4stub.o lz4payload.o
+endif
+	@$(OBJCOPY) $(TARGET)-lz4.elf -O binary $(TARGET).img
+	@rm -f $(TARGET).lz4
+	@echo -n "  LZ4   $(TARGET).img => "
+	@wc -c < $(TARGET).img
+endif
 
 clean:
 	@echo "  CLEAN " `pwd`
@@ -25,6 +25,11 @@ public:
 	float GetCelsius (void) const;
 	float GetFahrenheit (void) const;
 
+	/// \param pScratchpad Pointer to the 9-byte scratchpad (with valid CRC)
+	/// \param bIs18S20 Is it a DS18S20 (or DS1820) device?
+	/// \return Temperature in 1/10 degree Celsius
+	static int ConvertScratchpad (const u8 *pScratchpad, boolean bIs18S20);
+
 private:
 	OneWire *m_pOneWire;
 	boolean  m_bSearch;
@@ -0,0 +1,231 @@
+//
+// ds18x20bus.cpp
+//
+#include <OneWire/ds18x20bus.h>
+#include <OneWire/ds18x20.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define CONVERSION_TIME_US	750000		// for 12 bit resolution (default)
+
+static const char FromDS18x20[] = "ds18x20";
+
+CDS18x20Bus::CDS18x20Bus (OneWire *pOneWire)
+:	m_pOneWire (pOneWire),
+	m_bParasitePower (FALSE),
+	m_nConversionStart (0),
+	m_bConverting (FALSE),
+	m_nSensors (0)
+{
+	assert (m_pOneWire != 0);
+}
+
+CDS18x20Bus::~CDS18x20Bus (void)
+{
+	m_pOneWire = 0;
+}
+
+boolean CDS18x20Bus::Initialize (void)
+{
+	assert (m_pOneWire != 0);
+
+	m_nSensors = 0;
+	m_bConverting = FALSE;
+
+	u8 Address[8];
+	m_pOneWire->reset_search ();
+	while (   m_nSensors < DS18X20_BUS_MAX_SENSORS
+	       && m_pOneWire->search (Address))
+	{
+		if (OneWire::crc8 (Address, 7) != Address[7])
+		{
+			CLogger::Get ()->Write (FromDS18x20, LogWarning, "CRC is not valid");
+
+			continue;
+		}
+
+		TSensor *pSensor = &m_Sensor[m_nSensors];
+
+		// the first ROM byte indicates which chip
+		switch (Address[0])
+		{
+		case 0x10:
+			pSensor->bIs18S20 = TRUE;
+			break;
+
+		case 0x28:
+		case 0x22:
+			pSensor->bIs18S20 = FALSE;
+			break;
+
+		default:
+			continue;		// other family device
+		}
+
+		memcpy (pSensor->Address, Address, sizeof pSensor->Address);
+		pSensor->bValid = FALSE;
+		pSensor->nCelsius = 0;
+
+		m_nSensors++;
+	}
+
+	if (m_nSensors == 0)
+	{
+		CLogger::Get ()->Write (FromDS18x20, LogError, "Sensor not found");
+
+		return FALSE;
+	}
+
+	// read power supply, a parasite powered sensor pulls the bus low
+	if (!m_pOneWire->reset ())
+	{
+		CLogger::Get ()->Write (FromDS18x20, LogError, "Device does not respond");
+
+		return FALSE;
+	}
+
+	m_pOneWire->skip ();
+	m_pOneWire->write (0xB4);
+
+	m_bParasitePower = m_pOneWire->read_bit () ? FALSE : TRUE;
+
+	CLogger::Get ()->Write (FromDS18x20, LogNotice, "%u sensor(s) found (%s)", m_nSensors,
+				m_bParasitePower ? "parasite power" : "external supply");
+
+	return TRUE;
+}
+
+unsigned CDS18x20Bus::GetCount (void) const
+{
+	return m_nSensors;
+}
+
+const u8 *CDS18x20Bus::GetAddress (unsigned nSensor) const
+{
+	assert (nSensor < m_nSensors);
+
+	return m_Sensor[nSensor].Address;
+}
+
+boolean CDS18x20Bus::StartConversion (void)
+{
+	assert (m_pOneWire != 0);
+
+	if (!m_pOneWire->reset ())
+	{
+		CLogger::Get ()->Write (FromDS18x20, LogWarning, "Device does not respond");
+
+		return FALSE;
+	}
+
+	m_pOneWire->skip ();
+	m_pOneWire->write (0x44, m_bParasitePower ? 1 : 0);	// start conversion on all
+
+	m_nConversionStart = CTimer::GetClockTicks ();
+	m_bConverting = TRUE;
+
+	return TRUE;
+}
+
+boolean CDS18x20Bus::IsConversionDone (void)
+{
+	assert (m_pOneWire != 0);
+
+	if (!m_bConverting)
+	{
+		return TRUE;
+	}
+
+	if (CTimer::GetClockTicks () - m_nConversionStart >= CONVERSION_TIME_US)
+	{
+		return TRUE;
+	}
+
+	// with external supply the sensors hold the bus low, while converting
+	if (   !m_bParasitePower
+	    && m_pOneWire->read_bit ())
+	{
+		return TRUE;
+	}
+
+	return FALSE;
+}
+
+unsigned CDS18x20Bus::ReadResults (void)
+{
+	assert (m_pOneWire != 0);
+
+	m_bConverting = FALSE;
+
+	unsigned nValid = 0;
+	for (unsigned i = 0; i < m_nSensors; i++)
+	{
+		TSensor *pSensor = &m_Sensor[i];
+		pSensor->bValid = FALSE;
+
+		if (!m_pOneWire->reset ())
+		{
+			CLogger::Get ()->Write (FromDS18x20, LogWarning, "Device does not respond");
+
+			break;
+		}
+
+		m_pOneWire->select (pSensor->Address);
+		m_pOneWire->write (0xBE);		// read Scratchpad
+
+		u8 Data[9];
+		m_pOneWire->read_bytes (Data, sizeof Data);
+
+		if (OneWire::crc8 (Data, 8) != Data[8])
+		{
+			continue;
+		}
+
+		pSensor->nCelsius = CDS18x20::ConvertScratchpad (Data, pSensor->bIs18S20);
+		pSensor->bValid = TRUE;
+
+		nValid++;
+	}
+
+	return nValid;
+}
+
+unsigned CDS18x20Bus::DoMeasurement (void)
+{
+	if (!StartConversion ())
+	{
+		return 0;
+	}
+
+	while (!IsConversionDone ())
+	{
+		CTimer::Get ()->MsDelay (10);
+	}
+
+	return ReadResults ();
+}
+
+boolean CDS18x20Bus::IsValid (unsigned nSensor) const
+{
+	assert (nSensor < m_nSensors);
+
+	return m_Sensor[nSensor].bValid;
+}
+
+float CDS18x20Bus::GetCelsius (unsigned nSensor) const
+{
+	assert (nSensor < m_nSensors);
+
+	return m_Sensor[nSensor].nCelsius / 10.0;
+}
+
+float CDS18x20Bus::GetFahrenheit (unsigned nSensor) const
+{
+	assert (nSensor < m_nSensors);
+
+	int nFahrenheit = (m_Sensor[nSensor].nCelsius * 18) / 10 + 320;
+
+	return nFahrenheit / 10.0;
+}
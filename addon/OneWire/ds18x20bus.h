@@ -0,0 +1,76 @@
+//
+// ds18x20bus.h
+//
+#ifndef _OneWire_ds18x20bus_h
+#define _OneWire_ds18x20bus_h
+
+#include <OneWire/OneWire.h>
+#include <circle/types.h>
+
+#define DS18X20_BUS_MAX_SENSORS		64
+
+/// \note All sensors on the bus start their conversion at once (Skip ROM, Convert T),\n
+///	  so that the measurement of all sensors takes only one conversion time.
+/// \note The ROM IDs are cached by Initialize(), which has to be called again,\n
+///	  if sensors have been added or removed.
+
+class CDS18x20Bus	/// Driver for multiple DS18B20, DS18S20 and DS1822 sensors on one bus
+{
+public:
+	/// \param pOneWire Pointer to OneWire bus object
+	CDS18x20Bus (OneWire *pOneWire);
+
+	~CDS18x20Bus (void);
+
+	/// \brief Searches the bus for sensors and determines the power mode
+	/// \return Operation successful? (FALSE, if no sensor was found)
+	boolean Initialize (void);
+
+	/// \return Number of found sensors
+	unsigned GetCount (void) const;
+	/// \param nSensor Sensor index (0 .. GetCount()-1)
+	/// \return Pointer to the 8-byte ROM ID of the sensor
+	const u8 *GetAddress (unsigned nSensor) const;
+
+	/// \brief Starts the conversion on all sensors
+	/// \return Operation successful?
+	boolean StartConversion (void);
+	/// \return Has the conversion been completed?
+	/// \note Polls the bus with external supply, uses the conversion time otherwise.
+	boolean IsConversionDone (void);
+	/// \brief Reads the scratchpads of all sensors back-to-back
+	/// \return Number of sensors with a valid result
+	unsigned ReadResults (void);
+
+	/// \brief Starts the conversion, waits for it and reads the results
+	/// \return Number of sensors with a valid result
+	unsigned DoMeasurement (void);
+
+	/// \param nSensor Sensor index (0 .. GetCount()-1)
+	/// \return Is the last result of this sensor valid?
+	boolean IsValid (unsigned nSensor) const;
+	/// \param nSensor Sensor index (0 .. GetCount()-1)
+	float GetCelsius (unsigned nSensor) const;
+	/// \param nSensor Sensor index (0 .. GetCount()-1)
+	float GetFahrenheit (unsigned nSensor) const;
+
+private:
+	OneWire *m_pOneWire;
+
+	boolean  m_bParasitePower;	// at least one sensor uses parasite power
+
+	unsigned m_nConversionStart;	// CTimer::GetClockTicks()
+	boolean  m_bConverting;
+
+	unsigned m_nSensors;
+	struct TSensor
+	{
+		u8	Address[8];
+		boolean	bIs18S20;
+		boolean	bValid;
+		int	nCelsius;	// 1/10 degree
+	}
+	m_Sensor[DS18X20_BUS_MAX_SENSORS];
+};
+
+#endif
@@ -23,16 +23,23 @@
 #include <circle/logger.h>
 #include <assert.h>
 
+#define HASH_SIZE_MIN	16		// entries in a hash table, power of 2
+
 struct TSection
 {
 	CString Name;
-	CPtrArray PropArray;
+	CPtrArray PropArray;		// in insertion order
+	TPropertyPair **ppHashTable;	// index into PropArray, by name
+	unsigned nHashSize;
 };
 
 struct TPropertyPair
 {
 	char *pName;
 	char *pValue;
+	u32 nHash;
+	boolean bModified;
+	TPropertyPair *pNextHash;
 };
 
 const char CProperties::DefaultSection[] = "";
@@ -189,16 +196,23 @@ void CProperties::SetString (const char *pPropertyName, const char *pValue)
 	TPropertyPair *pProperty = Lookup (pPropertyName);
 	if (pProperty == 0)
 	{
-		AddProperty (pPropertyName, pValue);
+		pProperty = Insert (pPropertyName, pValue);
 	}
-	else
+	else if (strcmp (pProperty->pValue, pValue) != 0)
 	{
-		delete pProperty->pValue;
+		delete [] pProperty->pValue;
 
 		pProperty->pValue = new char[strlen (pValue)+1];
 		assert (pProperty->pValue != 0);
 		strcpy (pProperty->pValue, pValue);
 	}
+	else
+	{
+		return;
+	}
+
+	assert (pProperty != 0);
+	pProperty->bModified = TRUE;
 }
 
 void CProperties::SetNumber (const char *pPropertyName, unsigned nValue, unsigned nBase)
@@ -255,6 +269,7 @@ void CProperties::RemoveAll (void)
 			pPropArray->RemoveLast ();
 		}
 
+		delete [] pSection->ppHashTable;
 		delete pSection;
 
 		m_SectionList.Remove (pElement);
@@ -271,6 +286,11 @@ void CProperties::AddProperty (const char*pPropertyName, const char *pValue)
 		return;
 	}
 
+	Insert (pPropertyName, pValue);
+}
+
+TPropertyPair *CProperties::Insert (const char*pPropertyName, const char *pValue)
+{
 	TPropertyPair *pProperty = new TPropertyPair;
 	assert (pProperty != 0);
 
@@ -286,12 +306,18 @@ void CProperties::AddProperty (const char*pPropertyName, const char *pValue)
 	assert (pProperty->pValue != 0);
 	strcpy (pProperty->pValue, pValue);
 
+	pProperty->nHash = Hash (pPropertyName);
+	pProperty->bModified = FALSE;
+	pProperty->pNextHash = 0;
+
 	if (m_pCurrentSection == 0)
 	{
 		m_pCurrentSection = new TSection;
 		assert (m_pCurrentSection != 0);
 
 		m_pCurrentSection->Name = m_CurrentSectionName;
+		m_pCurrentSection->ppHashTable = 0;
+		m_pCurrentSection->nHashSize = 0;
 
 		TPtrListElement *pElement = m_SectionList.GetFirst ();
 		while (pElement != 0)
@@ -309,6 +335,20 @@ void CProperties::AddProperty (const char*pPropertyName, const char *pValue)
 	}
 
 	m_pCurrentSection->PropArray.Append (pProperty);
+
+	// keep the load factor below 1
+	if (m_pCurrentSection->PropArray.GetCount () > m_pCurrentSection->nHashSize)
+	{
+		Rehash (m_pCurrentSection);
+	}
+	else
+	{
+		unsigned nIndex = pProperty->nHash & (m_pCurrentSection->nHashSize-1);
+		pProperty->pNextHash = m_pCurrentSection->ppHashTable[nIndex];
+		m_pCurrentSection->ppHashTable[nIndex] = pProperty;
+	}
+
+	return pProperty;
 }
 
 boolean CProperties::GetFirst (void)
@@ -383,6 +423,37 @@ const char *CProperties::GetName (void) const
 	return pProperty->pName;
 }
 
+boolean CProperties::IsModified (void) const
+{
+	assert (m_pGetSection != 0);
+	TSection *pSection = (TSection *) m_SectionList.GetPtr (m_pGetSection);
+	assert (pSection != 0);
+
+	assert (m_nGetIndex < pSection->PropArray.GetCount ());
+	TPropertyPair *pProperty = (TPropertyPair *) pSection->PropArray[m_nGetIndex];
+	assert (pProperty != 0);
+
+	return pProperty->bModified;
+}
+
+void CProperties::ClearModified (void)
+{
+	for (TPtrListElement *pElement = m_SectionList.GetFirst (); pElement != 0;
+	     pElement = m_SectionList.GetNext (pElement))
+	{
+		TSection *pSection = (TSection *) m_SectionList.GetPtr (pElement);
+		assert (pSection != 0);
+
+		for (unsigned i = 0; i < pSection->PropArray.GetCount (); i++)
+		{
+			TPropertyPair *pProperty = (TPropertyPair *) pSection->PropArray[i];
+			assert (pProperty != 0);
+
+			pProperty->bModified = FALSE;
+		}
+	}
+}
+
 const char *CProperties::GetValue (void) const
 {
 	assert (m_pGetSection != 0);
@@ -426,11 +497,16 @@ TPropertyPair *CProperties::Lookup (const char*pPropertyName) const
 		return 0;
 	}
 
-	for (unsigned i = 0; i < m_pCurrentSection->PropArray.GetCount (); i++)
+	assert (pPropertyName != 0);
+	u32 nHash = Hash (pPropertyName);
+
+	assert (m_pCurrentSection->ppHashTable != 0);
+	for (TPropertyPair *pProperty =
+		m_pCurrentSection->ppHashTable[nHash & (m_pCurrentSection->nHashSize-1)];
+	     pProperty != 0; pProperty = pProperty->pNextHash)
 	{
-		TPropertyPair *pProperty = (TPropertyPair *) m_pCurrentSection->PropArray[i];
-		assert (pProperty != 0);
-		if (strcmp (pProperty->pName, pPropertyName) == 0)
+		if (   pProperty->nHash == nHash
+		    && strcmp (pProperty->pName, pPropertyName) == 0)
 		{
 			return pProperty;
 		}
@@ -439,6 +515,44 @@ TPropertyPair *CProperties::Lookup (const char*pPropertyName) const
 	return 0;
 }
 
+void CProperties::Rehash (TSection *pSection)
+{
+	assert (pSection != 0);
+
+	unsigned nHashSize = pSection->nHashSize > 0 ? pSection->nHashSize * 2 : HASH_SIZE_MIN;
+
+	delete [] pSection->ppHashTable;
+	pSection->ppHashTable = new TPropertyPair *[nHashSize];
+	assert (pSection->ppHashTable != 0);
+	pSection->nHashSize = nHashSize;
+
+	memset (pSection->ppHashTable, 0, nHashSize * sizeof (TPropertyPair *));
+
+	for (unsigned i = 0; i < pSection->PropArray.GetCount (); i++)
+	{
+		TPropertyPair *pProperty = (TPropertyPair *) pSection->PropArray[i];
+		assert (pProperty != 0);
+
+		unsigned nIndex = pProperty->nHash & (nHashSize-1);
+		pProperty->pNextHash = pSection->ppHashTable[nIndex];
+		pSection->ppHashTable[nIndex] = pProperty;
+	}
+}
+
+u32 CProperties::Hash (const char *pString)
+{
+	assert (pString != 0);
+
+	u32 nHash = 2166136261U;		// FNV-1a
+	while (*pString != '\0')
+	{
+		nHash ^= (u8) *pString++;
+		nHash *= 16777619U;
+	}
+
+	return nHash;
+}
+
 #ifndef NDEBUG
 
 void CProperties::Dump (const char *pSource) const
@@ -76,9 +76,18 @@ protected:
 	const char *GetName (void) const;
 	const char *GetValue (void) const;
 
+	// has the property at current position been set by Set*() since the last call of
+	// ClearModified()?
+	boolean IsModified (void) const;
+	void ClearModified (void);
+
 private:
 	TSection *LookupSection (const char*pSectionName) const;
-	TPropertyPair *Lookup (const char*pPropertyName) const;
+	TPropertyPair *Lookup (const char*pPropertyName) const;	// O(1) by hash
+
+	TPropertyPair *Insert (const char *pPropertyName, const char *pValue);
+	static void Rehash (TSection *pSection);
+	static u32 Hash (const char *pString);
 
 private:
 	CPtrList m_SectionList;
@@ -0,0 +1,429 @@
+//
+// propertiesjournalfile.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <Properties/propertiesjournalfile.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CPropertiesJournalFile::CPropertiesJournalFile (const char *pFileName, FATFS *pFileSystem)
+:	m_FileName (pFileName),
+	m_CommitOffset (0),
+	m_nRecords (0)
+{
+}
+
+CPropertiesJournalFile::~CPropertiesJournalFile (void)
+{
+}
+
+boolean CPropertiesJournalFile::Load (void)
+{
+	FRESULT Result;
+	FIL File;
+
+	RemoveAll ();
+
+	ResetErrorLine ();
+
+	m_CommitOffset = 0;
+	m_nRecords = 0;
+
+	CString TempName (m_FileName);
+	TempName.Append (".tmp");
+
+	assert (m_FileName.GetLength () > 0);
+	Result = f_open (&File, m_FileName, FA_READ | FA_OPEN_EXISTING);
+	if (Result == FR_NO_FILE)
+	{
+		// Compact() has been interrupted after removing the old journal
+		if (f_rename (TempName, m_FileName) != FR_OK)
+		{
+			return FALSE;
+		}
+
+		Result = f_open (&File, m_FileName, FA_READ | FA_OPEN_EXISTING);
+	}
+	else if (Result == FR_OK)
+	{
+		f_unlink (TempName);		// may be incomplete
+	}
+
+	if (Result != FR_OK)
+	{
+		return FALSE;
+	}
+
+	// find the last commit first, apply the committed records only
+	boolean bResult =    Scan (&File, FALSE)
+			  && Scan (&File, TRUE);
+
+	f_close (&File);
+
+	SelectSection (DefaultSection);
+
+	ClearModified ();
+
+	return bResult;
+}
+
+boolean CPropertiesJournalFile::Save (void)
+{
+	FRESULT Result;
+	FIL File;
+
+	if (m_CommitOffset == 0)
+	{
+		return Compact ();		// there is no valid journal yet
+	}
+
+	unsigned nModified = 0;
+	for (boolean bContinue = GetFirst (); bContinue; bContinue = GetNext ())
+	{
+		if (IsModified ())
+		{
+			nModified++;
+		}
+	}
+
+	if (nModified == 0)
+	{
+		return TRUE;
+	}
+
+	if (   m_nRecords + nModified >= PROPERTIES_JOURNAL_COMPACT_MIN
+	    && m_nRecords + nModified > 2 * GetPropertyCount ())
+	{
+		return Compact ();
+	}
+
+	assert (m_FileName.GetLength () > 0);
+	Result = f_open (&File, m_FileName, FA_WRITE | FA_OPEN_EXISTING);
+	if (Result != FR_OK)
+	{
+		return FALSE;
+	}
+
+	// drop the records of an interrupted Save()
+	if (   f_lseek (&File, m_CommitOffset) != FR_OK
+	    || f_truncate (&File) != FR_OK)
+	{
+		f_close (&File);
+
+		return FALSE;
+	}
+
+	for (boolean bContinue = GetFirst (); bContinue; bContinue = GetNext ())
+	{
+		if (   IsModified ()
+		    && !WriteRecord (&File, PROPERTIES_JOURNAL_PROPERTY,
+				     GetSectionName (), GetName (), GetValue ()))
+		{
+			f_close (&File);
+
+			return FALSE;
+		}
+	}
+
+	if (!WriteRecord (&File, PROPERTIES_JOURNAL_COMMIT))
+	{
+		f_close (&File);
+
+		return FALSE;
+	}
+
+	FSIZE_t CommitOffset = f_tell (&File);
+
+	// the file size in the directory entry is updated here
+	if (f_close (&File) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	m_CommitOffset = CommitOffset;
+	m_nRecords += nModified;
+
+	ClearModified ();
+
+	return TRUE;
+}
+
+boolean CPropertiesJournalFile::Compact (void)
+{
+	FRESULT Result;
+	FIL File;
+	unsigned nBytesWritten;
+
+	CString TempName (m_FileName);
+	TempName.Append (".tmp");
+
+	Result = f_open (&File, TempName, FA_WRITE | FA_CREATE_ALWAYS);
+	if (Result != FR_OK)
+	{
+		return FALSE;
+	}
+
+	TFileHeader Header;
+	Header.nMagic = PROPERTIES_JOURNAL_MAGIC;
+	Header.nReserved = 0;
+
+	if (   f_write (&File, &Header, sizeof Header, &nBytesWritten) != FR_OK
+	    || nBytesWritten != sizeof Header)
+	{
+		f_close (&File);
+
+		return FALSE;
+	}
+
+	unsigned nRecords = 0;
+	for (boolean bContinue = GetFirst (); bContinue; bContinue = GetNext ())
+	{
+		if (!WriteRecord (&File, PROPERTIES_JOURNAL_PROPERTY,
+				  GetSectionName (), GetName (), GetValue ()))
+		{
+			f_close (&File);
+
+			return FALSE;
+		}
+
+		nRecords++;
+	}
+
+	if (!WriteRecord (&File, PROPERTIES_JOURNAL_COMMIT))
+	{
+		f_close (&File);
+
+		return FALSE;
+	}
+
+	FSIZE_t CommitOffset = f_tell (&File);
+
+	if (f_close (&File) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	// Load() completes this, if interrupted
+	Result = f_unlink (m_FileName);
+	if (   Result != FR_OK
+	    && Result != FR_NO_FILE)
+	{
+		return FALSE;
+	}
+
+	if (f_rename (TempName, m_FileName) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	m_CommitOffset = CommitOffset;
+	m_nRecords = nRecords;
+
+	ClearModified ();
+
+	return TRUE;
+}
+
+boolean CPropertiesJournalFile::Scan (FIL *pFile, boolean bApply)
+{
+	assert (pFile != 0);
+	unsigned nBytesRead;
+
+	if (f_lseek (pFile, 0) != FR_OK)
+	{
+		return FALSE;
+	}
+
+	TFileHeader Header;
+	if (   f_read (pFile, &Header, sizeof Header, &nBytesRead) != FR_OK
+	    || nBytesRead != sizeof Header
+	    || Header.nMagic != PROPERTIES_JOURNAL_MAGIC)
+	{
+		return FALSE;
+	}
+
+	FSIZE_t Offset = sizeof Header;
+	unsigned nRecords = 0;
+	unsigned nBatch = 0;
+
+	if (!bApply)
+	{
+		m_CommitOffset = Offset;
+		m_nRecords = 0;
+	}
+
+	// a torn or corrupted record ends the journal
+	while (   !bApply
+	       || Offset < m_CommitOffset)
+	{
+		TRecordHeader *pHeader = (TRecordHeader *) m_Record;
+		if (f_read (pFile, pHeader, sizeof *pHeader, &nBytesRead) != FR_OK)
+		{
+			return FALSE;
+		}
+
+		if (   nBytesRead != sizeof *pHeader
+		    || pHeader->nSectionLength >= MAX_PROPERTY_SECTION_LENGTH
+		    || pHeader->nNameLength >= MAX_PROPERTY_NAME_LENGTH
+		    || pHeader->nValueLength >= MAX_PROPERTY_VALUE_LENTGH)
+		{
+			break;
+		}
+
+		unsigned nDataLength =   pHeader->nSectionLength + pHeader->nNameLength
+				       + pHeader->nValueLength;
+		u8 *pData = m_Record + sizeof *pHeader;
+		if (f_read (pFile, pData, nDataLength, &nBytesRead) != FR_OK)
+		{
+			return FALSE;
+		}
+
+		if (nBytesRead != nDataLength)
+		{
+			break;
+		}
+
+		u32 nCRC = pHeader->nCRC;
+		pHeader->nCRC = 0;
+		if (CRC32 (0, m_Record, sizeof *pHeader + nDataLength) != nCRC)
+		{
+			break;
+		}
+
+		Offset += sizeof *pHeader + nDataLength;
+
+		if (pHeader->nType == PROPERTIES_JOURNAL_PROPERTY)
+		{
+			if (pHeader->nNameLength == 0)
+			{
+				break;
+			}
+
+			nBatch++;
+
+			if (bApply)
+			{
+				char Section[MAX_PROPERTY_SECTION_LENGTH];
+				memcpy (Section, pData, pHeader->nSectionLength);
+				Section[pHeader->nSectionLength] = '\0';
+				pData += pHeader->nSectionLength;
+
+				char Name[MAX_PROPERTY_NAME_LENGTH];
+				memcpy (Name, pData, pHeader->nNameLength);
+				Name[pHeader->nNameLength] = '\0';
+				pData += pHeader->nNameLength;
+
+				pData[pHeader->nValueLength] = '\0';
+
+				SelectSection (Section);
+				SetString (Name, (const char *) pData);
+			}
+		}
+		else if (pHeader->nType == PROPERTIES_JOURNAL_COMMIT)
+		{
+			nRecords += nBatch;
+			nBatch = 0;
+
+			if (!bApply)
+			{
+				m_CommitOffset = Offset;
+				m_nRecords = nRecords;
+			}
+		}
+		else
+		{
+			break;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CPropertiesJournalFile::WriteRecord (FIL *pFile, unsigned nType, const char *pSection,
+					     const char *pName, const char *pValue)
+{
+	assert (pFile != 0);
+	assert (pSection != 0);
+	assert (pName != 0);
+	assert (pValue != 0);
+
+	size_t nSectionLength = strlen (pSection);
+	size_t nNameLength = strlen (pName);
+	size_t nValueLength = strlen (pValue);
+	if (   nSectionLength >= MAX_PROPERTY_SECTION_LENGTH
+	    || nNameLength >= MAX_PROPERTY_NAME_LENGTH
+	    || nValueLength >= MAX_PROPERTY_VALUE_LENTGH)
+	{
+		return FALSE;
+	}
+
+	TRecordHeader *pHeader = (TRecordHeader *) m_Record;
+	pHeader->nType = (u16) nType;
+	pHeader->nSectionLength = (u16) nSectionLength;
+	pHeader->nNameLength = (u16) nNameLength;
+	pHeader->nValueLength = (u16) nValueLength;
+	pHeader->nCRC = 0;
+
+	u8 *pData = m_Record + sizeof *pHeader;
+	memcpy (pData, pSection, nSectionLength);
+	pData += nSectionLength;
+	memcpy (pData, pName, nNameLength);
+	pData += nNameLength;
+	memcpy (pData, pValue, nValueLength);
+	pData += nValueLength;
+
+	unsigned nLength = pData - m_Record;
+	pHeader->nCRC = CRC32 (0, m_Record, nLength);
+
+	unsigned nBytesWritten;
+	return    f_write (pFile, m_Record, nLength, &nBytesWritten) == FR_OK
+	       && nBytesWritten == nLength;
+}
+
+unsigned CPropertiesJournalFile::GetPropertyCount (void)
+{
+	unsigned nCount = 0;
+	for (boolean bContinue = GetFirst (); bContinue; bContinue = GetNext ())
+	{
+		nCount++;
+	}
+
+	return nCount;
+}
+
+u32 CPropertiesJournalFile::CRC32 (u32 nCRC, const void *pData, size_t nLength)
+{
+	static const u32 Table[16] =
+	{
+		0x00000000, 0x1DB71064, 0x3B6E20C8, 0x26D930AC,
+		0x76DC4190, 0x6B6B51F4, 0x4DB26158, 0x5005713C,
+		0xEDB88320, 0xF00F9344, 0xD6D6A3E8, 0xCB61B38C,
+		0x9B64C2B0, 0x86D3D2D4, 0xA00AE278, 0xBDBDF21C
+	};
+
+	const u8 *p = (const u8 *) pData;
+
+	nCRC = ~nCRC;
+	while (nLength--)
+	{
+		nCRC = Table[(nCRC ^ *p) & 0xF] ^ (nCRC >> 4);
+		nCRC = Table[(nCRC ^ (*p++ >> 4)) & 0xF] ^ (nCRC >> 4);
+	}
+
+	return ~nCRC;
+}
@@ -0,0 +1,86 @@
+//
+// propertiesjournalfile.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _Properties_propertiesjournalfile_h
+#define _Properties_propertiesjournalfile_h
+
+#include <Properties/propertiesbasefile.h>
+#include <fatfs/ff.h>
+#include <circle/string.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define PROPERTIES_JOURNAL_COMPACT_MIN	64	// records, before the journal may be compacted
+
+// Binary property store, to which Save() appends the modified properties only. Each
+// Save() is committed atomically: an interrupted Save() is ignored on the next Load().
+// The journal is rewritten, when it contains too many outdated records.
+
+class CPropertiesJournalFile : public CPropertiesBaseFile
+{
+public:
+	CPropertiesJournalFile (const char *pFileName, FATFS *pFileSystem);
+	~CPropertiesJournalFile (void);
+
+	boolean Load (void);		// loads the last committed state
+	boolean Save (void);		// appends the modified properties and commits them
+
+	boolean Compact (void);		// rewrites the journal with the current properties only
+
+private:
+	boolean Scan (FIL *pFile, boolean bApply);
+
+	boolean WriteRecord (FIL *pFile, unsigned nType, const char *pSection = "",
+			     const char *pName = "", const char *pValue = "");
+
+	unsigned GetPropertyCount (void);
+
+	static u32 CRC32 (u32 nCRC, const void *pData, size_t nLength);
+
+private:
+	struct TFileHeader
+	{
+		u32	nMagic;
+#define PROPERTIES_JOURNAL_MAGIC	0x314A5043	// "CPJ1"
+		u32	nReserved;
+	}
+	PACKED;
+
+	struct TRecordHeader
+	{
+		u16	nType;
+#define PROPERTIES_JOURNAL_PROPERTY	1
+#define PROPERTIES_JOURNAL_COMMIT	2
+		u16	nSectionLength;
+		u16	nNameLength;
+		u16	nValueLength;
+		u32	nCRC;		// over header (with nCRC = 0) and data
+	}
+	PACKED;
+
+	CString m_FileName;
+
+	FSIZE_t m_CommitOffset;		// end of the last commit record (0 for no journal)
+	unsigned m_nRecords;		// property records up to m_CommitOffset
+
+	u8 m_Record[sizeof (TRecordHeader) + MAX_PROPERTY_SECTION_LENGTH
+		    + MAX_PROPERTY_NAME_LENGTH + MAX_PROPERTY_VALUE_LENTGH];
+};
+
+#endif
@@ -41,9 +41,13 @@
 #ifndef USE_SDHOST
 	#include <circle/bcm2835.h>
 	#include <circle/bcm2711.h>
+	#include <circle/bcm2712.h>
 	#include <circle/bcmpropertytags.h>
 	#include <circle/synchronize.h>
 	#include <circle/machineinfo.h>
+	#include <circle/devicetreeblob.h>
+	#include <circle/memory.h>
+	#include <circle/new.h>
 	#include <circle/memio.h>
 	#include <circle/sched/scheduler.h>
 #else
@@ -72,6 +76,17 @@
 // Enable High Speed/SDR25 mode
 //#define SD_HIGH_SPEED
 
+// Enable UHS-I modes (SDR50, SDR104, DDR50) with 1.8V signaling and tuning
+// The best mode, supported by card and host controller, is selected.
+// Only the Raspberry Pi 4 and 5 have a switchable I/O voltage regulator.
+#if RASPPI >= 4 && !defined (USE_EMBEDDED_MMC_CM)
+	#define SD_UHS_SUPPORT
+#endif
+
+#ifdef SD_UHS_SUPPORT
+	#define SD_1_8V_SUPPORT
+#endif
+
 // Enable 4-bit support
 #define SD_4BIT_DATA
 
@@ -95,6 +110,14 @@
 // Required for QEMU
 #define EMMC_ALLOW_OLD_SDHCI
 
+// Use ADMA2 for block data transfers, if supported by the host controller.
+// The completion of a transfer is signaled by interrupt. Buffers, which are
+// not cache-aligned or not reachable by the controller, are still transferred
+// using PIO.
+#if RASPPI <= 4
+	#define EMMC_USE_ADMA
+#endif
+
 #if RASPPI != 4
 	#define EMMC_BASE	ARM_EMMC_BASE
 #else
@@ -120,6 +143,8 @@
 #define EMMC_CAPABILITIES_0	(EMMC_BASE + 0x40)
 #define EMMC_CAPABILITIES_1	(EMMC_BASE + 0x44)
 #define EMMC_FORCE_IRPT		(EMMC_BASE + 0x50)
+#define EMMC_ADMA_ERR		(EMMC_BASE + 0x54)
+#define EMMC_ADMA_ADDR		(EMMC_BASE + 0x58)
 #define EMMC_BOOT_TIMEOUT	(EMMC_BASE + 0x70)
 #define EMMC_DBG_SEL		(EMMC_BASE + 0x74)
 #define EMMC_EXRDFIFO_CFG	(EMMC_BASE + 0x80)
@@ -191,6 +216,38 @@
 #define SD_CARD_INSERTION       (1 << 6)
 #define SD_CARD_REMOVAL         (1 << 7)
 #define SD_CARD_INTERRUPT       (1 << 8)
+#define SD_ERROR_INTERRUPT      (1 << 15)
+
+#define SD_CAPS_ADMA2		(1 << 19)	// in EMMC_CAPABILITIES_0
+
+#define SD_CAPS1_SDR50		(1 << 0)	// in EMMC_CAPABILITIES_1
+#define SD_CAPS1_SDR104		(1 << 1)
+#define SD_CAPS1_DDR50		(1 << 2)
+#define SD_CAPS1_TUNING_SDR50	(1 << 13)
+
+#define SD_CTRL2_UHS_MODE_MASK	(7 << 16)	// in EMMC_CONTROL2
+#define SD_CTRL2_UHS_SDR12	(0 << 16)
+#define SD_CTRL2_UHS_SDR25	(1 << 16)
+#define SD_CTRL2_UHS_SDR50	(2 << 16)
+#define SD_CTRL2_UHS_SDR104	(3 << 16)
+#define SD_CTRL2_UHS_DDR50	(4 << 16)
+#define SD_CTRL2_SIGNAL_1_8V	(1 << 19)
+#define SD_CTRL2_EXEC_TUNING	(1 << 22)
+#define SD_CTRL2_TUNED_CLOCK	(1 << 23)
+
+#define SD_TUNING_LOOPS		40		// HCSS 2.2.25
+
+#define SD_CTRL0_DMA_SEL_MASK	(3 << 3)
+#define SD_CTRL0_DMA_SEL_ADMA2	(2 << 3)	// 32-bit address ADMA2
+
+// ADMA2 descriptor attributes (HCSS 1.13.4)
+#define ADMA2_VALID		(1 << 0)
+#define ADMA2_END		(1 << 1)
+#define ADMA2_INT		(1 << 2)
+#define ADMA2_ACT_TRAN		(2 << 4)
+
+#define ADMA2_MAX_LENGTH	0x10000		// length field 0 means 64 KByte
+#define ADMA2_DESCRIPTORS	256		// max. 16 MByte per transfer
 
 #endif
 
@@ -497,6 +554,13 @@ CEMMCDevice::CEMMCDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer, CA
 	assert (m_pSCR != 0);
 
 #ifndef USE_SDHOST
+	m_use_adma = FALSE;
+	m_dma_transfer = FALSE;
+	m_adma_desc = 0;
+	m_transfer_done = FALSE;
+#if RASPPI >= 4
+	m_signal_1_8v = FALSE;
+#endif
 
 #if RASPPI >= 2 && RASPPI <= 4
 	// workaround if bootloader does not restore GPIO modes
@@ -522,6 +586,16 @@ CEMMCDevice::~CEMMCDevice (void)
 {
 #ifdef USE_SDHOST
 	m_Host.Reset ();
+#elif defined (EMMC_USE_ADMA)
+	if (m_use_adma)
+	{
+		write32 (EMMC_IRPT_EN, 0);
+
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_ARASANSDIO);
+	}
+
+	delete [] m_adma_desc;
+	m_adma_desc = 0;
 #endif
 
 	delete m_pSCR;
@@ -879,6 +953,221 @@ int CEMMCDevice::ResetDat (void)
 	return 0;
 }
 
+#ifdef SD_UHS_SUPPORT
+
+// Switch the I/O voltage regulator of the SD card interface
+boolean CEMMCDevice::SetSignalVoltage (boolean bLow)
+{
+#if RASPPI == 4
+	CBcmPropertyTags Tags;
+	TPropertyTagGPIOState GPIOState;
+	GPIOState.nGPIO = EXP_GPIO_BASE + 4;
+	GPIOState.nState = bLow ? 1 : 0;
+	if (!Tags.GetTag (PROPTAG_SET_SET_GPIO_STATE, &GPIOState, sizeof GPIOState, 8))
+	{
+		LogWrite (LogError, "Cannot switch I/O voltage");
+
+		return FALSE;
+	}
+#else
+	// AON GPIO 3 controls the regulator (high for 1.8V)
+	write32 (ARM_GPIO2_IODIR0, read32 (ARM_GPIO2_IODIR0) & ~BIT (3));
+
+	u32 nData = read32 (ARM_GPIO2_DATA0);
+	if (bLow)
+	{
+		nData |= BIT (3);
+	}
+	else
+	{
+		nData &= ~BIT (3);
+	}
+	write32 (ARM_GPIO2_DATA0, nData);
+#endif
+
+	m_signal_1_8v = bLow;
+
+	// Wait for the regulator output to be stable
+	usDelay (5000);
+
+	return TRUE;
+}
+
+// Select the UHS mode and the clock rate in the host controller
+void CEMMCDevice::SetUHSMode (u32 uhs_mode, u32 target_rate)
+{
+	// Set the SD clock off
+	u32 control1 = read32 (EMMC_CONTROL1);
+	control1 &= ~(1 << 2);
+	write32 (EMMC_CONTROL1, control1);
+
+	u32 control2 = read32 (EMMC_CONTROL2);
+	control2 &= ~(SD_CTRL2_UHS_MODE_MASK | SD_CTRL2_EXEC_TUNING | SD_CTRL2_TUNED_CLOCK);
+	control2 |= uhs_mode;
+	write32 (EMMC_CONTROL2, control2);
+
+	// High speed enable is required for the modes above SDR12
+	u32 control0 = read32 (EMMC_CONTROL0);
+	if (uhs_mode != SD_CTRL2_UHS_SDR12)
+	{
+		control0 |= 1 << 2;
+	}
+	else
+	{
+		control0 &= ~(1 << 2);
+	}
+	write32 (EMMC_CONTROL0, control0);
+
+	SwitchClockRate (m_base_clock, target_rate);
+}
+
+// Find the sampling clock point with CMD19, as per HCSS 3.6.3
+boolean CEMMCDevice::ExecuteTuning (void)
+{
+	u32 control2 = read32 (EMMC_CONTROL2);
+	control2 &= ~SD_CTRL2_TUNED_CLOCK;
+	control2 |= SD_CTRL2_EXEC_TUNING;
+	write32 (EMMC_CONTROL2, control2);
+
+	for (unsigned i = 0; i < SD_TUNING_LOOPS; i++)
+	{
+		// The tuning block is 64 bytes with the 4-bit bus
+		write32 (EMMC_BLKSIZECNT, 64 | (1 << 16));
+		write32 (EMMC_ARG1, 0);
+		write32 (EMMC_CMDTM, sd_commands[SEND_TUNING_BLOCK]);
+
+		// The host controller does not generate Transfer Complete while
+		// tuning and the data must not be read from the buffer
+		if (TimeoutWait (EMMC_INTERRUPT, SD_BUFFER_READ_READY | SD_ERROR_INTERRUPT,
+				 1, 150000) < 0)
+		{
+			break;
+		}
+
+		u32 irpts = read32 (EMMC_INTERRUPT);
+		write32 (EMMC_INTERRUPT, 0xffff0000 | SD_COMMAND_COMPLETE | SD_BUFFER_READ_READY);
+		if (irpts & SD_ERROR_INTERRUPT)
+		{
+			break;
+		}
+
+		if (!(read32 (EMMC_CONTROL2) & SD_CTRL2_EXEC_TUNING))
+		{
+			break;
+		}
+
+		usDelay (1000);
+	}
+
+	control2 = read32 (EMMC_CONTROL2);
+	if ((control2 & (SD_CTRL2_EXEC_TUNING | SD_CTRL2_TUNED_CLOCK)) != SD_CTRL2_TUNED_CLOCK)
+	{
+		control2 &= ~(SD_CTRL2_EXEC_TUNING | SD_CTRL2_TUNED_CLOCK);
+		write32 (EMMC_CONTROL2, control2);
+
+		ResetCmd ();
+		ResetDat ();
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+// Switch to the fastest UHS-I bus speed mode, which is supported by the card
+// and the host controller (PLSS 4.3.10). The card must be in 1.8V signaling
+// mode and the 4-bit bus must be active.
+boolean CEMMCDevice::SelectUHSMode (void)
+{
+	static const struct
+	{
+		u32		function;	// CMD6 group 1 (bus speed mode)
+		u32		host_caps;	// required in EMMC_CAPABILITIES_1
+		u32		uhs_mode;
+		u32		clock;
+		const char	*name;
+	}
+	modes[] =
+	{
+		{3, SD_CAPS1_SDR104,	SD_CTRL2_UHS_SDR104,	SD_CLOCK_208,	"SDR104"},
+		{4, SD_CAPS1_DDR50,	SD_CTRL2_UHS_DDR50,	SD_CLOCK_HIGH,	"DDR50"},
+		{2, SD_CAPS1_SDR50,	SD_CTRL2_UHS_SDR50,	SD_CLOCK_100,	"SDR50"},
+		{1, 0,			SD_CTRL2_UHS_SDR25,	SD_CLOCK_HIGH,	"SDR25"}
+	};
+
+	// 512 bit response
+	u32 cmd6_resp[16];
+	u8 *pStatus = (u8 *) cmd6_resp;
+	m_buf = cmd6_resp;
+	m_block_size = 64;
+	m_blocks_to_transfer = 1;
+
+	// CMD6 Mode 0: Check Function (Group 1, Bus Speed Mode)
+	if (!IssueCommand (SWITCH_FUNC, 0x00fffff0, 100000))
+	{
+		LogWrite (LogError, "Error sending SWITCH_FUNC (Mode 0)");
+
+		m_block_size = SD_BLOCK_SIZE;
+
+		return FALSE;
+	}
+
+	u32 card_modes = pStatus[13];
+	u32 host_caps = read32 (EMMC_CAPABILITIES_1);
+#ifdef EMMC_DEBUG2
+	LogWrite (LogDebug, "UHS modes: card %02x, host %08x", card_modes, host_caps);
+#endif
+
+	for (unsigned i = 0; i < sizeof modes / sizeof modes[0]; i++)
+	{
+		if (   !(card_modes & (1 << modes[i].function))
+		    || (host_caps & modes[i].host_caps) != modes[i].host_caps)
+		{
+			continue;
+		}
+
+		// CMD6 Mode 1: Set Function (Group 1, Bus Speed Mode)
+		m_blocks_to_transfer = 1;
+		if (   !IssueCommand (SWITCH_FUNC, 0x80fffff0 | modes[i].function, 100000)
+		    || (pStatus[16] & 0xf) != modes[i].function)
+		{
+			LogWrite (LogWarning, "Switch to %s mode failed", modes[i].name);
+
+			continue;
+		}
+
+		SetUHSMode (modes[i].uhs_mode, modes[i].clock);
+
+		// Tuning is mandatory for SDR104 and optional for SDR50
+		if (   modes[i].uhs_mode == SD_CTRL2_UHS_SDR104
+		    || (   modes[i].uhs_mode == SD_CTRL2_UHS_SDR50
+			&& (host_caps & SD_CAPS1_TUNING_SDR50)))
+		{
+			if (!ExecuteTuning ())
+			{
+				LogWrite (LogWarning, "Tuning for %s mode failed", modes[i].name);
+
+				// Try the next mode with a safe clock rate
+				SetUHSMode (SD_CTRL2_UHS_SDR12, SD_CLOCK_NORMAL);
+
+				continue;
+			}
+		}
+
+		m_block_size = SD_BLOCK_SIZE;
+
+		LogWrite (LogNotice, "Using %s mode", modes[i].name);
+
+		return TRUE;
+	}
+
+	m_block_size = SD_BLOCK_SIZE;
+
+	return FALSE;
+}
+
+#endif	// #ifdef SD_UHS_SUPPORT
+
 void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 {
 	m_last_cmd_reg = cmd_reg;
@@ -926,6 +1215,23 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 	// Set argument 1 reg
 	write32 (EMMC_ARG1, argument);
 
+#ifdef EMMC_USE_ADMA
+	if (m_dma_transfer)
+	{
+		assert (cmd_reg & SD_CMD_ISDATA);
+		cmd_reg |= SD_CMD_DMA;
+
+		// Select 32-bit ADMA2 and set the descriptor table address
+		u32 control0 = read32 (EMMC_CONTROL0);
+		control0 &= ~SD_CTRL0_DMA_SEL_MASK;
+		control0 |= SD_CTRL0_DMA_SEL_ADMA2;
+		write32 (EMMC_CONTROL0, control0);
+
+		write32 (EMMC_ADMA_ADDR,
+			 (u32) ((uintptr) m_adma_desc - m_dma_cpu_base + m_dma_bus_base));
+	}
+#endif
+
 	// Set command reg
 	write32 (EMMC_CMDTM, cmd_reg);
 
@@ -969,7 +1275,9 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 	}
 
 	// If with data, wait for the appropriate interrupt
-	if (cmd_reg & SD_CMD_ISDATA)
+	// (with ADMA2 the controller moves the data itself)
+	if (   (cmd_reg & SD_CMD_ISDATA)
+	    && !(cmd_reg & SD_CMD_DMA))
 	{
 		u32 wr_irpt;
 		int is_write = 0;
@@ -1049,7 +1357,16 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 		else
 #endif
 		{
-			TimeoutWait (EMMC_INTERRUPT, 0x8002, 1, timeout);
+#ifdef EMMC_USE_ADMA
+			if (cmd_reg & SD_CMD_DMA)
+			{
+				WaitForTransfer (timeout);
+			}
+			else
+#endif
+			{
+				TimeoutWait (EMMC_INTERRUPT, 0x8002, 1, timeout);
+			}
 			irpts = read32 (EMMC_INTERRUPT);
 			write32 (EMMC_INTERRUPT, 0xffff0002);
 
@@ -1064,6 +1381,21 @@ void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
 				m_last_error = irpts & 0xffff0000;
 				m_last_interrupt = irpts;
 
+#ifdef EMMC_USE_ADMA
+				if (cmd_reg & SD_CMD_DMA)
+				{
+#ifdef EMMC_DEBUG
+					if (ADMA_ERROR)
+					{
+						LogWrite (LogWarning, "ADMA error (status %02x)",
+							  read32 (EMMC_ADMA_ERR));
+					}
+#endif
+					// The ADMA engine stops on error, restart the data line
+					ResetDat ();
+				}
+#endif
+
 				return;
 			}
 
@@ -1203,6 +1535,175 @@ void CEMMCDevice::HandleInterrupts (void)
 	write32 (EMMC_INTERRUPT, reset_mask);
 }
 
+#ifdef EMMC_USE_ADMA
+
+void CEMMCDevice::InitDMA (void)
+{
+	if (   m_use_adma
+	    || !(read32 (EMMC_CAPABILITIES_0) & SD_CAPS_ADMA2))
+	{
+		return;
+	}
+
+	// Default memory window, as translated by BUS_ADDRESS()
+	m_dma_cpu_base = 0;
+	m_dma_bus_base = GPU_MEM_BASE;
+	m_dma_size = 0x40000000;
+
+#if RASPPI == 4
+	// The EMMC2 bus mapping depends on the SoC stepping and is defined
+	// in the device tree: <bus-address(2) cpu-address(2) size(1)>
+	const CDeviceTreeBlob *pDTB = CMachineInfo::Get ()->GetDTB ();
+	if (pDTB != 0)
+	{
+		const TDeviceTreeNode *pBus = pDTB->FindNode ("/emmc2bus");
+		if (pBus != 0)
+		{
+			const TDeviceTreeProperty *pDMA = pDTB->FindProperty (pBus, "dma-ranges");
+			if (   pDMA != 0
+			    && pDTB->GetPropertyValueLength (pDMA) == sizeof (u32)*5)
+			{
+				m_dma_bus_base =   (u64) pDTB->GetPropertyValueWord (pDMA, 0) << 32
+						 | pDTB->GetPropertyValueWord (pDMA, 1);
+				m_dma_cpu_base =   (u64) pDTB->GetPropertyValueWord (pDMA, 2) << 32
+						 | pDTB->GetPropertyValueWord (pDMA, 3);
+				m_dma_size = pDTB->GetPropertyValueWord (pDMA, 4);
+			}
+		}
+	}
+#endif
+
+	assert (m_adma_desc == 0);
+	m_adma_desc = new (HEAP_DMA30) TADMA2Descriptor[ADMA2_DESCRIPTORS];
+	assert (m_adma_desc != 0);
+
+	if ((uintptr) m_adma_desc + sizeof (TADMA2Descriptor[ADMA2_DESCRIPTORS])
+	    > m_dma_cpu_base + m_dma_size)
+	{
+		delete [] m_adma_desc;
+		m_adma_desc = 0;
+
+		return;
+	}
+
+	write32 (EMMC_IRPT_EN, 0);
+
+	assert (m_pInterruptSystem != 0);
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_ARASANSDIO, InterruptStub, this);
+
+	m_use_adma = TRUE;
+
+#ifdef EMMC_DEBUG
+	LogWrite (LogDebug, "Using ADMA2 (bus %llx, size %llx)", m_dma_bus_base, m_dma_size);
+#endif
+}
+
+// Builds the ADMA2 descriptor table for the buffer. Returns FALSE, if the
+// buffer cannot be transferred using ADMA2 and PIO has to be used instead.
+boolean CEMMCDevice::SetupDMA (u8 *buf, size_t buf_size)
+{
+	if (   !m_use_adma
+	    || !IS_CACHE_ALIGNED (buf, buf_size)
+	    || buf_size > ADMA2_MAX_LENGTH * ADMA2_DESCRIPTORS)
+	{
+		return FALSE;
+	}
+
+	u64 address = (uintptr) buf;
+	if (   address < m_dma_cpu_base
+	    || address + buf_size > m_dma_cpu_base + m_dma_size)
+	{
+		return FALSE;
+	}
+
+	u64 bus_address = address - m_dma_cpu_base + m_dma_bus_base;
+	if (bus_address + buf_size > 0x100000000ULL)
+	{
+		return FALSE;
+	}
+
+	TADMA2Descriptor *pDesc = m_adma_desc;
+	assert (pDesc != 0);
+	for (size_t remaining = buf_size; remaining > 0; pDesc++)
+	{
+		size_t length = remaining < ADMA2_MAX_LENGTH ? remaining : ADMA2_MAX_LENGTH;
+		assert ((length & 3) == 0);
+
+		pDesc->attribute = ADMA2_ACT_TRAN | ADMA2_VALID;
+		pDesc->length = (u16) length;		// 0 for 64 KByte
+		pDesc->address = (u32) bus_address;
+
+		bus_address += length;
+		remaining -= length;
+
+		if (remaining == 0)
+		{
+			pDesc->attribute |= ADMA2_END;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_adma_desc,
+					  (uintptr) pDesc - (uintptr) m_adma_desc);
+	CleanAndInvalidateDataCacheRange ((uintptr) buf, buf_size);
+
+	return TRUE;
+}
+
+int CEMMCDevice::WaitForTransfer (unsigned usec)
+{
+	assert (m_pTimer != 0);
+	unsigned nStartTicks = m_pTimer->GetClockTicks ();
+	unsigned nTimeoutTicks = usec * (CLOCKHZ / 1000000);
+
+	// The interrupt fires immediately, if the transfer is already complete
+	m_transfer_done = FALSE;
+	write32 (EMMC_IRPT_EN, 0xffff0000 | SD_ERROR_INTERRUPT | SD_TRANSFER_COMPLETE);
+
+	while (!m_transfer_done)
+	{
+		if (m_pTimer->GetClockTicks () - nStartTicks >= nTimeoutTicks)
+		{
+			write32 (EMMC_IRPT_EN, 0);
+
+			return -1;
+		}
+
+#ifdef NO_BUSY_WAIT
+		CScheduler::Get ()->Yield ();
+#endif
+	}
+
+	return 0;
+}
+
+void CEMMCDevice::InterruptHandler (void)
+{
+	// The status is evaluated and cleared by the waiting task
+	u32 irpts = read32 (EMMC_INTERRUPT);
+	if (!(irpts & read32 (EMMC_IRPT_EN)))
+	{
+		return;
+	}
+
+	write32 (EMMC_IRPT_EN, 0);
+
+	m_transfer_done = TRUE;
+}
+
+void CEMMCDevice::InterruptStub (void *pParam)
+{
+	CEMMCDevice *pThis = (CEMMCDevice *) pParam;
+	assert (pThis != 0);
+
+	PeripheralEntry ();
+
+	pThis->InterruptHandler ();
+
+	PeripheralExit ();
+}
+
+#endif	// #ifdef EMMC_USE_ADMA
+
 #else	// #ifndef USE_SDHOST
 
 void CEMMCDevice::IssueCommandInt (u32 cmd_reg, u32 argument, int timeout)
@@ -1422,6 +1923,14 @@ u32 CEMMCDevice::GetCSDField (unsigned start, unsigned width) const
 
 int CEMMCDevice::CardReset (void)
 {
+#ifdef SD_UHS_SUPPORT
+	if (   m_failed_voltage_switch
+	    && m_signal_1_8v)
+	{
+		SetSignalVoltage (FALSE);
+	}
+#endif
+
 #ifndef USE_SDHOST
 
 #ifdef EMMC_DEBUG2
@@ -1573,8 +2082,6 @@ int CEMMCDevice::CardReset (void)
 #endif
 	m_last_error = 0;
 
-	m_failed_voltage_switch = 0;
-
 	m_last_cmd_reg = 0;
 	m_last_cmd = 0;
 	m_last_cmd_success = 0;
@@ -1820,16 +2327,25 @@ int CEMMCDevice::CardReset (void)
 		}
 
 		// Set 1.8V signal enable to 1
-		u32 control0 = read32(EMMC_CONTROL0);
-		control0 |= (1 << 8);
-		write32(EMMC_CONTROL0, control0);
+#ifdef SD_UHS_SUPPORT
+		if (!SetSignalVoltage (TRUE))
+		{
+			m_failed_voltage_switch = 1;
+			PowerOff();
+
+			return CardReset ();
+		}
+#endif
+		u32 control2 = read32(EMMC_CONTROL2);
+		control2 |= SD_CTRL2_SIGNAL_1_8V;
+		write32(EMMC_CONTROL2, control2);
 
 		// Wait 5 ms
 		usDelay (5000);
 
 		// Check the 1.8V signal enable is set
-		control0 = read32(EMMC_CONTROL0);
-		if(((control0 >> 8) & 1) == 0)
+		control2 = read32(EMMC_CONTROL2);
+		if (!(control2 & SD_CTRL2_SIGNAL_1_8V))
 		{
 #ifdef EMMC_DEBUG
 			LogWrite (LogDebug, "controller did not keep 1.8V signal enable high");
@@ -1865,6 +2381,15 @@ int CEMMCDevice::CardReset (void)
 		LogWrite (LogDebug, "voltage switch complete");
 #endif
 	}
+#ifdef SD_UHS_SUPPORT
+	else if (m_signal_1_8v)
+	{
+		// The card is still in 1.8V mode from a previous initialization
+		// and does not report S18A again, until it is power cycled.
+		write32 (EMMC_CONTROL2, read32 (EMMC_CONTROL2) | SD_CTRL2_SIGNAL_1_8V);
+		m_card_supports_18v = 1;
+	}
+#endif
 
 #endif	// #if !defined (USE_SDHOST) && !defined (USE_EMBEDDED_MMC_CM)
 
@@ -2175,6 +2700,15 @@ int CEMMCDevice::CardReset (void)
 #endif
 	}
 
+#ifdef SD_UHS_SUPPORT
+	// UHS-I modes require 1.8V signaling and the 4-bit bus
+	if (   m_card_supports_18v
+	    && (read32 (EMMC_CONTROL0) & 0x2))
+	{
+		SelectUHSMode ();
+	}
+#endif
+
 	LogWrite (LogNotice, "Found a valid version %s SD card", sd_versions[m_pSCR->sd_version]);
 
 #else	// #ifndef USE_EMBEDDED_MMC_CM
@@ -2269,8 +2803,14 @@ int CEMMCDevice::CardInit (void)
 #endif
 	}
 
+#ifdef EMMC_USE_ADMA
+	InitDMA ();
+#endif
+
 #endif	// #ifndef USE_SDHOST
 
+	m_failed_voltage_switch = 0;
+
 	// The SEND_SCR command may fail with a DATA_TIMEOUT on the Raspberry Pi 4
 	// for unknown reason. As a workaround the whole card reset is retried.
 	int ret;
@@ -2410,6 +2950,10 @@ int CEMMCDevice::DoDataCommand (int is_write, u8 *buf, size_t buf_size, u32 bloc
 	}
 	m_buf = buf;
 
+#ifdef EMMC_USE_ADMA
+	m_dma_transfer = SetupDMA (buf, buf_size);
+#endif
+
 	// Decide on the command to use
 	int command;
 	if (is_write)
@@ -2459,6 +3003,19 @@ int CEMMCDevice::DoDataCommand (int is_write, u8 *buf, size_t buf_size, u32 bloc
 		}
 	}
 
+#ifdef EMMC_USE_ADMA
+	if (m_dma_transfer)
+	{
+		m_dma_transfer = FALSE;
+
+		if (!is_write)
+		{
+			// Drop cache lines, which may have been fetched during the transfer
+			CleanAndInvalidateDataCacheRange ((uintptr) buf, buf_size);
+		}
+	}
+#endif
+
 	if (retry_count == max_retries)
 	{
 		m_card_rca = CARD_RCA_INVALID;
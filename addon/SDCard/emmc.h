@@ -38,6 +38,7 @@
 #include <circle/logger.h>
 #include <circle/types.h>
 #include <circle/sysconfig.h>
+#include <circle/macros.h>
 #ifdef USE_SDHOST
 	#include <SDCard/sdhost.h>
 #endif
@@ -49,6 +50,18 @@ struct TSCR			// SD configuration register
 	int	sd_version;
 };
 
+#ifndef USE_SDHOST
+
+struct TADMA2Descriptor		// 32-bit address ADMA2 descriptor
+{
+	u16	attribute;
+	u16	length;
+	u32	address;
+}
+PACKED;
+
+#endif
+
 class CEMMCDevice : public CDevice
 {
 public:
@@ -79,12 +92,25 @@ private:
 
 	int ResetCmd (void);
 	int ResetDat (void);
+
+#if RASPPI >= 4
+	boolean SetSignalVoltage (boolean bLow);	// TRUE for 1.8V
+	void SetUHSMode (u32 uhs_mode, u32 target_rate);
+	boolean ExecuteTuning (void);
+	boolean SelectUHSMode (void);
+#endif
 #endif
 
 	void IssueCommandInt (u32 cmd_reg, u32 argument, int timeout);
 #ifndef USE_SDHOST
 	void HandleCardInterrupt (void);
 	void HandleInterrupts (void);
+
+	void InitDMA (void);
+	boolean SetupDMA (u8 *buf, size_t buf_size);
+	int WaitForTransfer (unsigned usec);
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
 #endif
 	boolean IssueCommand (u32 command, u32 argument, int timeout = 500000);
 
@@ -165,6 +191,17 @@ private:
 #ifndef USE_SDHOST
 	int m_card_removal;
 	u32 m_base_clock;
+
+	boolean m_use_adma;		// controller supports ADMA2 and IRQ is connected
+	boolean m_dma_transfer;		// current data command uses ADMA2
+	TADMA2Descriptor *m_adma_desc;	// descriptor table
+	u64 m_dma_cpu_base;		// memory window, which is reachable by ADMA2
+	u64 m_dma_bus_base;
+	u64 m_dma_size;
+	volatile boolean m_transfer_done;
+#if RASPPI >= 4
+	boolean m_signal_1_8v;		// I/O voltage regulator is at 1.8V
+#endif
 #endif
 
 	static const char *sd_versions[];
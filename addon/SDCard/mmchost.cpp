@@ -24,6 +24,7 @@
 #include "mmcerror.h"
 #include <circle/synchronize.h>
 #include <circle/util.h>
+#include <circle/sched/scheduler.h>
 #include <assert.h>
 
 CMMCHost::CMMCHost (void)
@@ -111,6 +112,14 @@ void CMMCHost::RequestSync (mmc_request *pRequest)
 
 	do
 	{
+#ifdef NO_BUSY_WAIT
+		// other tasks can run, while a DMA transfer is active
+		if (CurrentExecutionLevel () == TASK_LEVEL)
+		{
+			CScheduler::Get ()->Yield ();
+		}
+#endif
+
 		DataMemBarrier ();
 	}
 	while (!pRequest->done);
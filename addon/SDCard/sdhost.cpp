@@ -52,6 +52,12 @@
 #define SDDATA_FIFO_PIO_BURST   8
 #define CMD_DALLY_US            1
 
+// Use DMA for multi-block transfers. The transfer is paced by the DREQ of the
+// SDHOST FIFO and its completion is signaled by interrupt. Buffers, which are
+// not cache-aligned, and single blocks are still transferred using PIO.
+#define SDHOST_USE_DMA
+#define PIO_LIMIT		1	/* maximum blocks transferred using PIO */
+
 #define DRIVER_NAME "sdhost-bcm2835"
 
 #define SDCMD  0x00 /* Command to SD card              - 16 R/W */
@@ -179,7 +185,8 @@ static const char From[] = "sdhost";
 
 CSDHOSTDevice::CSDHOSTDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer)
 :	m_pInterruptSystem (pInterruptSystem),
-	m_pTimer (pTimer)
+	m_pTimer (pTimer),
+	m_DMAChannel (DMA_CHANNEL_NORMAL, pInterruptSystem)
 {
 	for (unsigned i = 0; i <= 5; i++)
 	{
@@ -604,11 +611,106 @@ void CSDHOSTDevice::transfer_pio (void)
 	}
 }
 
+boolean CSDHOSTDevice::prepare_dma (mmc_data *data)
+{
+#ifdef SDHOST_USE_DMA
+	size_t len = data->blksz * data->blocks;
+
+	if (data->blocks <= PIO_LIMIT || !IS_CACHE_ALIGNED (data->sg, len))
+		return false;
+
+	host->drain_words = 0;
+
+	if (data->flags & MMC_DATA_READ) {
+		/* The block doesn't manage the FIFO DREQs properly for
+		 * multi-block transfers, so don't attempt to DMA the final
+		 * few words. */
+		u32 drain_len = (FIFO_READ_THRESHOLD - 1) * 4;
+
+		len -= drain_len;
+		host->drain_words = drain_len / 4;
+		host->drain_buf = (u32 *) ((u8 *) data->sg + len);
+
+		m_DMAChannel.SetupIORead (data->sg, ARM_SDHOST_BASE + SDDATA, len,
+					  DREQSourceSDHOST);
+	} else
+		m_DMAChannel.SetupIOWrite (ARM_SDHOST_BASE + SDDATA, data->sg, len,
+					   DREQSourceSDHOST);
+
+	m_DMAChannel.SetCompletionRoutine (dma_stub, this);
+
+	host->use_dma = 1;
+
+	return true;
+#else
+	return false;
+#endif
+}
+
+void CSDHOSTDevice::start_dma (void)
+{
+	BUG_ON(!host->use_dma);
+
+	host->dma_active = 1;
+
+	m_DMAChannel.Start ();
+}
+
+void CSDHOSTDevice::dma_complete (boolean status)
+{
+	m_SpinLock.Acquire ();
+
+	pr_debug("dma_complete(%d)", status);
+
+	/* The request may have been aborted in the meantime */
+	if (!host->dma_active || !host->data) {
+		m_SpinLock.Release ();
+		return;
+	}
+
+	host->use_dma = 0;
+	host->dma_active = 0;
+
+	if (!status) {
+		pr_err("%s: DMA transfer failed", mmc_hostname(host->mmc));
+		host->data->error = -EILSEQ;
+	}
+
+	u32 *buf = host->drain_buf;
+	while (host->drain_words) {
+		u32 edm = read(SDEDM);
+		if ((edm >> 4) & 0x1f)
+			*(buf++) = read(SDDATA);
+		host->drain_words--;
+	}
+
+	finish_data();
+
+	mmiowb();
+
+	m_SpinLock.Release ();
+}
+
+void CSDHOSTDevice::dma_stub (unsigned channel, unsigned buffer, boolean status, void *param)
+{
+	CSDHOSTDevice *pThis = (CSDHOSTDevice *) param;
+	assert (pThis != 0);
+
+	PeripheralEntry ();
+
+	pThis->dma_complete (status);
+
+	PeripheralExit ();
+}
+
 void CSDHOSTDevice::set_transfer_irqs (void)
 {
 	u32 all_irqs = SDHCFG_DATA_IRPT_EN | SDHCFG_BLOCK_IRPT_EN | SDHCFG_BUSY_IRPT_EN;
 
-	host->hcfg = (host->hcfg & ~all_irqs) | SDHCFG_DATA_IRPT_EN | SDHCFG_BUSY_IRPT_EN;
+	if (host->use_dma)
+		host->hcfg = (host->hcfg & ~all_irqs) | SDHCFG_BUSY_IRPT_EN;
+	else
+		host->hcfg = (host->hcfg & ~all_irqs) | SDHCFG_DATA_IRPT_EN | SDHCFG_BUSY_IRPT_EN;
 
 	write(host->hcfg, SDHCFG);
 }
@@ -649,14 +751,16 @@ void CSDHOSTDevice::prepare_data (mmc_command *cmd)
 // 		}
 // 	}
 
-	int flags = SG_MITER_ATOMIC;
+	if (!host->use_dma) {
+		int flags = SG_MITER_ATOMIC;
 
-	if (data->flags & MMC_DATA_READ)
-		flags |= SG_MITER_TO_SG;
-	else
-		flags |= SG_MITER_FROM_SG;
-	sg_miter_start(&host->sg_miter, data->sg, data->sg_len, flags);
-	host->blocks = data->blocks;
+		if (data->flags & MMC_DATA_READ)
+			flags |= SG_MITER_TO_SG;
+		else
+			flags |= SG_MITER_FROM_SG;
+		sg_miter_start(&host->sg_miter, data->sg, data->sg_len, flags);
+		host->blocks = data->blocks;
+	}
 
 	set_transfer_irqs();
 
@@ -982,7 +1086,9 @@ void CSDHOSTDevice::finish_command (void)
 		/* Finished CMD23, now send actual command. */
 		host->cmd = 0;
 		if (send_command(host->mrq->cmd)) {
-			/* PIO starts after irq */
+			/* DMA transfer starts now, PIO starts after irq */
+			if (host->data && host->use_dma)
+				start_dma();
 
 			if (!host->use_busy)
 				finish_command();
@@ -1317,6 +1423,10 @@ void CSDHOSTDevice::request (mmc_host *mmc, mmc_request *mrq)
 	if (host->reset_clock)
 	    set_clock(host->clock);
 
+	host->use_dma = 0;
+	if (mrq->data)
+		prepare_dma(mrq->data);
+
 	m_SpinLock.Acquire ();
 
 	WARN_ON(host->mrq != 0);
@@ -1349,7 +1459,9 @@ void CSDHOSTDevice::request (mmc_host *mmc, mmc_request *mrq)
 				finish_command();
 		}
 	} else if (send_command(mrq->cmd)) {
-		/* PIO starts after irq */
+		/* DMA transfer starts now, PIO starts after irq */
+		if (host->data && host->use_dma)
+			start_dma();
 
 		if (!host->use_busy)
 			finish_command();
@@ -1405,6 +1517,13 @@ void CSDHOSTDevice::tasklet_finish (void)
 
 	mmc_request *mrq = host->mrq;
 
+	if (host->dma_active) {
+		/* Request aborted, DMA did not complete */
+		m_DMAChannel.Cancel ();
+		host->dma_active = 0;
+	}
+	host->use_dma = 0;
+
 	/* Drop the overclock after any data corruption, or after any
 	 * error while overclocked. Ignore errors for status commands,
 	 * as they are likely when a card is ejected. */
@@ -23,7 +23,8 @@
 CSpectrumScreen::CSpectrumScreen (void)
 :	m_pFrameBuffer (0),
 	m_pBuffer (0),
-	m_pVideoMem (0)
+	m_pVideoMem (0),
+	m_bFullUpdate (TRUE)
 {
 }
 
@@ -104,54 +105,37 @@ void CSpectrumScreen::Update (boolean flash)
 	assert (m_pBuffer != 0);
 	assert (m_pVideoMem != 0);
 
+	// The display file consists of three thirds with 8 character rows each.
+	// The pixel lines of a character row are 256 bytes apart.
 	int bufIdx = 1413;
-	int attr = 6144;
-	for (int addr = 0; addr < 256; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
+	int attr = 0;
+	for (int row = 0; row < 24; row++) {
+		int addr = ((row & 0x18) << 8) | ((row & 0x07) << 5);
+		for (int col = 0; col < 32; col++, attr++) {
+			unsigned char color = m_pVideoMem[6144 + attr];
 			if (!flash)
 				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
-		}
-		bufIdx += 352;
-	}
-	for (int addr = 2048; addr < 2304; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
-			if (!flash)
-				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
-		}
-		bufIdx += 352;
-	}
-	for (int addr = 4096; addr < 4352; addr += 32) {
-		for (int col = 0; col < 32; col++) {
-			unsigned char color = m_pVideoMem[attr++];
-			if (!flash)
-				color &= 0x7F;
-			m_pBuffer[bufIdx + col] = m_scrTable[color][m_pVideoMem[addr + col]];
-			m_pBuffer[bufIdx + col + 44] = m_scrTable[color][m_pVideoMem[addr + col + 256]];
-			m_pBuffer[bufIdx + col + 88] = m_scrTable[color][m_pVideoMem[addr + col + 512]];
-			m_pBuffer[bufIdx + col + 132] = m_scrTable[color][m_pVideoMem[addr + col + 768]];
-			m_pBuffer[bufIdx + col + 176] = m_scrTable[color][m_pVideoMem[addr + col + 1024]];
-			m_pBuffer[bufIdx + col + 220] = m_scrTable[color][m_pVideoMem[addr + col + 1280]];
-			m_pBuffer[bufIdx + col + 264] = m_scrTable[color][m_pVideoMem[addr + col + 1536]];
-			m_pBuffer[bufIdx + col + 308] = m_scrTable[color][m_pVideoMem[addr + col + 1792]];
+
+			// a changed attribute redraws the whole cell
+			boolean dirty = m_bFullUpdate || color != m_Attr[attr];
+			m_Attr[attr] = color;
+
+			for (int line = 0; line < 8; line++) {
+				int idx = addr + col + (line << 8);
+				u8 bits = m_pVideoMem[idx];
+				if (dirty || bits != m_Bitmap[idx]) {
+					m_Bitmap[idx] = bits;
+					m_pBuffer[bufIdx + col + line * 44] = m_scrTable[color][bits];
+				}
+			}
 		}
 		bufIdx += 352;
 	}
+
+	m_bFullUpdate = FALSE;
+}
+
+void CSpectrumScreen::Invalidate (void)
+{
+	m_bFullUpdate = TRUE;
 }
@@ -30,13 +30,21 @@ public:
 
 	boolean Initialize (u8 *pVideoMem);
 
+	// Renders only the character cells and pixel lines,
+	// which changed since the previous call
 	void Update (boolean flash);
 
+	// Forces a full redraw on the next Update()
+	void Invalidate (void);
+
 private:
 	CBcmFrameBuffer	*m_pFrameBuffer;
 	u32		*m_pBuffer;		// Address of frame buffer
 	unsigned	 m_scrTable[256][256];	// lookup table
 	u8		*m_pVideoMem;		// Spectrum video memory
+	boolean		 m_bFullUpdate;
+	u8		 m_Bitmap[6144];	// displayed copy of video memory
+	u8		 m_Attr[768];		// displayed attributes (flash applied)
 };
 
 #endif
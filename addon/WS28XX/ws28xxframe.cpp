@@ -0,0 +1,241 @@
+//
+// ws28xxframe.cpp
+//
+// Double-buffered frame output for WS28XX controlled LED strips
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "ws28xxframe.h"
+#include <circle/util.h>
+#include <assert.h>
+
+static float Power (float fBase, float fExponent);
+
+CWS28XXFrame::CWS28XXFrame (unsigned nStrips, unsigned nLEDsPerStrip)
+:	m_nStrips (nStrips),
+	m_nLEDsPerStrip (nLEDsPerStrip),
+	m_bDithering (FALSE),
+	m_nBackBuffer (0)
+{
+	assert (m_nStrips > 0);
+	assert (m_nLEDsPerStrip > 0);
+
+	unsigned nLEDs = m_nStrips * m_nLEDsPerStrip;
+
+	m_pPixels = new u8[nLEDs * 3];
+	assert (m_pPixels != 0);
+	memset (m_pPixels, 0, nLEDs * 3);
+
+	m_pResiduals = new u8[nLEDs * 3];
+	assert (m_pResiduals != 0);
+	memset (m_pResiduals, 0, nLEDs * 3);
+
+	m_pGRB = new u32[nLEDs];
+	assert (m_pGRB != 0);
+
+	SetGamma (1.0f);
+}
+
+CWS28XXFrame::~CWS28XXFrame (void)
+{
+	delete [] m_pGRB;
+	m_pGRB = 0;
+
+	delete [] m_pResiduals;
+	m_pResiduals = 0;
+
+	delete [] m_pPixels;
+	m_pPixels = 0;
+}
+
+unsigned CWS28XXFrame::GetLEDCount (void) const
+{
+	return m_nLEDsPerStrip;
+}
+
+void CWS28XXFrame::SetLED (unsigned nStrip, unsigned nLEDIndex, u8 nRed, u8 nGreen, u8 nBlue)
+{
+	assert (nStrip < m_nStrips);
+	assert (nLEDIndex < m_nLEDsPerStrip);
+
+	assert (m_pPixels != 0);
+	u8 *pPixel = &m_pPixels[(nStrip * m_nLEDsPerStrip + nLEDIndex) * 3];
+
+	pPixel[0] = nRed;
+	pPixel[1] = nGreen;
+	pPixel[2] = nBlue;
+}
+
+void CWS28XXFrame::SetGamma (float fGamma)
+{
+	assert (fGamma > 0.0f);
+
+	m_Gamma[0] = 0;
+	for (unsigned i = 1; i < 256; i++)
+	{
+		float fValue = Power (i / 255.0f, fGamma) * 255.0f;
+
+		m_Gamma[i] = (u16) (fValue * 256.0f + 0.5f);
+		if (m_Gamma[i] > 255 << 8)
+		{
+			m_Gamma[i] = 255 << 8;
+		}
+	}
+}
+
+void CWS28XXFrame::EnableDithering (boolean bEnable)
+{
+	m_bDithering = bEnable;
+
+	if (!m_bDithering)
+	{
+		assert (m_pResiduals != 0);
+		memset (m_pResiduals, 0, m_nStrips * m_nLEDsPerStrip * 3);
+	}
+}
+
+boolean CWS28XXFrame::Update (void)
+{
+	assert (m_pPixels != 0);
+	assert (m_pResiduals != 0);
+	assert (m_pGRB != 0);
+
+	unsigned nLEDs = m_nStrips * m_nLEDsPerStrip;
+	for (unsigned i = 0; i < nLEDs; i++)
+	{
+		const u8 *pPixel = &m_pPixels[i * 3];
+		u8 *pResidual = &m_pResiduals[i * 3];
+
+		u32 nRed   = Correct (pPixel[0], &pResidual[0]);
+		u32 nGreen = Correct (pPixel[1], &pResidual[1]);
+		u32 nBlue  = Correct (pPixel[2], &pResidual[2]);
+
+		m_pGRB[i] = nGreen << 16 | nRed << 8 | nBlue;
+	}
+
+	// the previous frame is sent, while this one is encoded
+	Encode (m_pGRB, m_nBackBuffer);
+
+	if (!Wait ())
+	{
+		return FALSE;
+	}
+
+	if (!StartOutput (m_nBackBuffer))
+	{
+		return FALSE;
+	}
+
+	m_nBackBuffer ^= 1;
+
+	return TRUE;
+}
+
+u64 CWS28XXFrame::Transpose8x8 (u64 ulRows)
+{
+	// see: H. S. Warren, Hacker's Delight, 7-3
+	u64 t;
+
+	t = (ulRows ^ (ulRows >> 7)) & 0x00AA00AA00AA00AAULL;
+	ulRows ^= t ^ (t << 7);
+
+	t = (ulRows ^ (ulRows >> 14)) & 0x0000CCCC0000CCCCULL;
+	ulRows ^= t ^ (t << 14);
+
+	t = (ulRows ^ (ulRows >> 28)) & 0x00000000F0F0F0F0ULL;
+	ulRows ^= t ^ (t << 28);
+
+	return ulRows;
+}
+
+u8 CWS28XXFrame::Correct (u8 nValue, u8 *pResidual)
+{
+	unsigned nCorrected = m_Gamma[nValue];
+
+	if (!m_bDithering)
+	{
+		return (u8) ((nCorrected + 0x80) >> 8);
+	}
+
+	// the maximum is (255 << 8) + 255, no overflow
+	assert (pResidual != 0);
+	nCorrected += *pResidual;
+	*pResidual = (u8) nCorrected;
+
+	return (u8) (nCorrected >> 8);
+}
+
+// there is no math library, precision is sufficient for the gamma table
+static float Power (float fBase, float fExponent)
+{
+	assert (fBase > 0.0f);
+
+	// log2 (fBase), using ln (x) = 2 atanh ((x-1) / (x+1)) with x in [1, 2)
+	int nExp = 0;
+	while (fBase >= 2.0f)
+	{
+		fBase /= 2.0f;
+		nExp++;
+	}
+
+	while (fBase < 1.0f)
+	{
+		fBase *= 2.0f;
+		nExp--;
+	}
+
+	float y = (fBase - 1.0f) / (fBase + 1.0f);
+	float y2 = y * y;
+	float fTerm = y;
+	float fSum = y;
+	for (unsigned k = 3; k <= 11; k += 2)
+	{
+		fTerm *= y2;
+		fSum += fTerm / k;
+	}
+
+	float fLog2 = nExp + 2.0f * fSum * 1.442695041f;
+
+	// 2 ^ (fExponent * fLog2), split into integer and fractional part
+	float x = fExponent * fLog2;
+	int n = (int) x;
+	if (n > x)
+	{
+		n--;
+	}
+
+	float z = (x - n) * 0.693147181f;
+	fTerm = 1.0f;
+	fSum = 1.0f;
+	for (unsigned k = 1; k <= 8; k++)
+	{
+		fTerm *= z / k;
+		fSum += fTerm;
+	}
+
+	for (; n > 0; n--)
+	{
+		fSum *= 2.0f;
+	}
+
+	for (; n < 0; n++)
+	{
+		fSum /= 2.0f;
+	}
+
+	return fSum;
+}
@@ -0,0 +1,110 @@
+//
+// ws28xxframe.h
+//
+// Double-buffered frame output for WS28XX controlled LED strips
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _ws28xx_ws28xxframe_h
+#define _ws28xx_ws28xxframe_h
+
+#include <circle/types.h>
+
+/// \class CWS28XXFrame
+/// \brief Common interface of the double-buffered WS28XX frame drivers
+///
+/// \details The application sets the LEDs of the next frame with SetLED() and calls\n
+/// Update(). Update() applies the gamma table and the temporal dithering, encodes the\n
+/// frame into the back buffer, while the previous frame is still sent by DMA, waits for\n
+/// the previous frame to complete and starts sending the new one. The LEDs of the next\n
+/// frame can be set, as soon as Update() returns.
+///
+/// \note Implemented by CWS28XXFrameSPI (one strip) and CWS28XXFrameSMI (up to 16 strips).
+
+class CWS28XXFrame
+{
+public:
+	/// \param nStrips Number of strips (strip index range)
+	/// \param nLEDsPerStrip Number of LEDs in each strip
+	CWS28XXFrame (unsigned nStrips, unsigned nLEDsPerStrip);
+
+	virtual ~CWS28XXFrame (void);
+
+	/// \return Operation successful?
+	virtual boolean Initialize (void) = 0;
+
+	/// \return Number of LEDs in each strip
+	unsigned GetLEDCount (void) const;
+
+	/// \brief Sets the color of one LED in the next frame
+	/// \param nStrip Strip index (0-based, see derived class)
+	/// \param nLEDIndex LED index in the strip (0-based)
+	void SetLED (unsigned nStrip, unsigned nLEDIndex, u8 nRed, u8 nGreen, u8 nBlue);
+
+	/// \brief Sets the gamma correction applied to all colors
+	/// \param fGamma Gamma value (default 1.0 for linear output, 2.2 is typical)
+	void SetGamma (float fGamma);
+
+	/// \brief Enables temporal dithering of the gamma-corrected colors
+	/// \param bEnable Distribute the fractional part of the colors over the frames?
+	/// \note Useful with high frame rates, it reduces the visible steps of dark colors.
+	void EnableDithering (boolean bEnable = TRUE);
+
+	/// \brief Sends the frame, set with SetLED() before
+	/// \return Operation successful?
+	boolean Update (void);
+
+	/// \brief Waits until the last frame has been sent
+	/// \return Operation successful?
+	virtual boolean Wait (void) = 0;
+
+protected:
+	/// \brief Encodes frame into transmit buffer
+	/// \param pGRB Output colors (0xGGRRBB) in order [strip][LED]
+	/// \param nBuffer Transmit buffer index (0 or 1), which is not sent at the moment
+	virtual void Encode (const u32 *pGRB, unsigned nBuffer) = 0;
+
+	/// \brief Starts sending transmit buffer
+	/// \param nBuffer Transmit buffer index (0 or 1)
+	/// \return Operation successful?
+	/// \note The previous transfer has completed (Wait() has been called before).
+	virtual boolean StartOutput (unsigned nBuffer) = 0;
+
+	/// \brief Transposes an 8x8 bit matrix
+	/// \param ulRows Byte n is row n
+	/// \return Byte n is column n (bit m of byte n is bit n of row m)
+	static u64 Transpose8x8 (u64 ulRows);
+
+private:
+	u8 Correct (u8 nValue, u8 *pResidual);
+
+protected:
+	unsigned m_nStrips;
+	unsigned m_nLEDsPerStrip;
+
+private:
+	u8 *m_pPixels;			// RGB in order [strip][LED]
+	u8 *m_pResiduals;		// dithering fractions, same order
+	u32 *m_pGRB;			// output colors
+
+	u16 m_Gamma[256];		// 8.8 fixed point
+	boolean m_bDithering;
+
+	unsigned m_nBackBuffer;
+};
+
+#endif
@@ -0,0 +1,138 @@
+//
+// ws28xxframesmi.cpp
+//
+// Frame output for up to 16 parallel WS2812 controlled LED strips over SMI
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "ws28xxframesmi.h"
+#include "ws2812oversmi.h"
+#include <circle/util.h>
+#include <assert.h>
+
+#define STRIPS			16
+#define RESET_PULSES		200		// > 50 us low between frames
+
+#define BUFFER_LENGTH(leds)	(LED_TX_OSET (leds) + RESET_PULSES)
+
+CWS28XXFrameSMI::CWS28XXFrameSMI (unsigned nSDLinesMask, unsigned nLEDsPerStrip)
+:	CWS28XXFrame (STRIPS, nLEDsPerStrip),
+	m_nSDLinesMask (nSDLinesMask & ((1 << STRIPS) - 1)),
+	m_SMIMaster (m_nSDLinesMask, FALSE),
+	m_nBufLength (BUFFER_LENGTH (nLEDsPerStrip)),
+	m_bStarted (FALSE)
+{
+	assert (m_nSDLinesMask != 0);
+
+	// the high and low pulses of each bit do not change
+	for (unsigned i = 0; i < 2; i++)
+	{
+		m_pBuffer[i] = new u16[m_nBufLength];
+		assert (m_pBuffer[i] != 0);
+		memset (m_pBuffer[i], 0, m_nBufLength * sizeof (u16));
+
+		for (unsigned j = 0; j < nLEDsPerStrip * LED_NBITS; j++)
+		{
+			m_pBuffer[i][LED_PREBITS + j * BIT_NPULSES] = (u16) m_nSDLinesMask;
+		}
+	}
+}
+
+CWS28XXFrameSMI::~CWS28XXFrameSMI (void)
+{
+	Wait ();
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		delete [] m_pBuffer[i];
+		m_pBuffer[i] = 0;
+	}
+}
+
+boolean CWS28XXFrameSMI::Initialize (void)
+{
+	m_SMIMaster.SetupTiming (SMI16Bits, NEOPIXEL_SMI_NS, NEOPIXEL_SMI_SETUP,
+				 NEOPIXEL_SMI_STROBE, NEOPIXEL_SMI_HOLD, NEOPIXEL_SMI_PACE);
+
+	return TRUE;
+}
+
+boolean CWS28XXFrameSMI::Wait (void)
+{
+	if (!m_bStarted)
+	{
+		return TRUE;
+	}
+
+	m_bStarted = FALSE;
+
+	return m_SMIMaster.WaitForDMA ();
+}
+
+void CWS28XXFrameSMI::Encode (const u32 *pGRB, unsigned nBuffer)
+{
+	assert (pGRB != 0);
+	assert (nBuffer < 2);
+	u16 *pBuffer = m_pBuffer[nBuffer];
+	assert (pBuffer != 0);
+
+	u16 *pData = &pBuffer[LED_PREBITS + 1];		// data pulse of the first bit
+	for (unsigned nLED = 0; nLED < m_nLEDsPerStrip; nLED++)
+	{
+		const u32 *pColors = &pGRB[nLED];
+
+		for (int nShift = 16; nShift >= 0; nShift -= 8)		// green, red, blue
+		{
+			// byte n of the rows is the color byte of strip n (+ 8)
+			u64 ulRowsLow = 0;
+			u64 ulRowsHigh = 0;
+			for (unsigned nStrip = 0; nStrip < 8; nStrip++)
+			{
+				ulRowsLow |=   (u64) ((pColors[nStrip * m_nLEDsPerStrip] >> nShift) & 0xFF)
+					    << (nStrip * 8);
+				ulRowsHigh |=   (u64) ((pColors[(nStrip+8) * m_nLEDsPerStrip] >> nShift) & 0xFF)
+					     << (nStrip * 8);
+			}
+
+			// byte n of the columns is bit n of all strips
+			u64 ulColumnsLow = Transpose8x8 (ulRowsLow);
+			u64 ulColumnsHigh = Transpose8x8 (ulRowsHigh);
+
+			for (int nBit = 7; nBit >= 0; nBit--)		// MSB first
+			{
+				*pData =   (ulColumnsLow >> (nBit * 8) & 0xFF)
+					 | (ulColumnsHigh >> (nBit * 8) & 0xFF) << 8;
+				*pData &= m_nSDLinesMask;
+
+				pData += BIT_NPULSES;
+			}
+		}
+	}
+}
+
+boolean CWS28XXFrameSMI::StartOutput (unsigned nBuffer)
+{
+	assert (!m_bStarted);
+	assert (nBuffer < 2);
+
+	m_SMIMaster.SetupDMA (m_pBuffer[nBuffer], m_nBufLength * sizeof (u16));
+	m_SMIMaster.WriteDMA (FALSE);
+
+	m_bStarted = TRUE;
+
+	return TRUE;
+}
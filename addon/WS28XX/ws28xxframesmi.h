@@ -0,0 +1,64 @@
+//
+// ws28xxframesmi.h
+//
+// Frame output for up to 16 parallel WS2812 controlled LED strips over SMI
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _ws28xx_ws28xxframesmi_h
+#define _ws28xx_ws28xxframesmi_h
+
+#include "ws28xxframe.h"
+#include <circle/smimaster.h>
+#include <circle/types.h>
+
+/// \class CWS28XXFrameSMI
+/// \brief Double-buffered frame output for up to 16 parallel WS2812 strips over SMI
+/// \details The strip index for SetLED() is the SMI data line (0 for SD0 on GPIO8, 1 for\n
+/// SD1 on GPIO9 etc.). The colors of 8 strips are bit-transposed at once for encoding.
+/// \note Sending one LED takes 1.2 us, so the frame rate is limited to about 33 fps\n
+///	  with 1000 LEDs per strip, independent of the number of strips.
+
+class CWS28XXFrameSMI : public CWS28XXFrame
+{
+public:
+	/// \param nSDLinesMask Data lines with a strip, e.g. (1 << 0) | (1 << 5) for SD0 and SD5
+	/// \param nLEDsPerStrip Number of LEDs in each strip
+	CWS28XXFrameSMI (unsigned nSDLinesMask, unsigned nLEDsPerStrip);
+
+	~CWS28XXFrameSMI (void);
+
+	boolean Initialize (void);
+
+	boolean Wait (void);
+
+private:
+	void Encode (const u32 *pGRB, unsigned nBuffer);
+
+	boolean StartOutput (unsigned nBuffer);
+
+private:
+	unsigned m_nSDLinesMask;
+	CSMIMaster m_SMIMaster;
+
+	unsigned m_nBufLength;			// in words
+	u16 *m_pBuffer[2];
+
+	boolean m_bStarted;
+};
+
+#endif
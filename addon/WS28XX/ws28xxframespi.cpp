@@ -0,0 +1,143 @@
+//
+// ws28xxframespi.cpp
+//
+// Frame output for one WS28XX controlled LED strip over SPI DMA
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "ws28xxframespi.h"
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CWS28XXFrameSPI::CWS28XXFrameSPI (CInterruptSystem *pInterruptSystem, TWS28XXType Type,
+				  unsigned nLEDCount, unsigned nClockSpeed)
+:	CWS28XXFrame (1, nLEDCount),
+	m_Type (Type),
+	m_SPIMaster (pInterruptSystem, m_Type == WS2801 ? nClockSpeed : 6400000),
+	m_bBusy (FALSE),
+	m_bStatus (TRUE)
+{
+	assert (m_Type <= WS2812B);
+
+	// one SPI byte per bit on WS2812, which is sent at 6.4 MHz
+	m_nBufSize = nLEDCount * 3;
+	if (m_Type != WS2801)
+	{
+		m_nBufSize *= 8;
+	}
+
+	assert (m_nBufSize <= 0xFFFF);
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		m_pBuffer[i] = new u8[m_nBufSize];
+		assert (m_pBuffer[i] != 0);
+	}
+
+	m_pReadBuffer = new u8[m_nBufSize];
+	assert (m_pReadBuffer != 0);
+}
+
+CWS28XXFrameSPI::~CWS28XXFrameSPI (void)
+{
+	Wait ();
+
+	delete [] m_pReadBuffer;
+	m_pReadBuffer = 0;
+
+	for (unsigned i = 0; i < 2; i++)
+	{
+		delete [] m_pBuffer[i];
+		m_pBuffer[i] = 0;
+	}
+}
+
+boolean CWS28XXFrameSPI::Initialize (void)
+{
+	return m_SPIMaster.Initialize ();
+}
+
+boolean CWS28XXFrameSPI::Wait (void)
+{
+	while (m_bBusy)
+	{
+		// do nothing
+	}
+
+	DataMemBarrier ();
+
+	return m_bStatus;
+}
+
+void CWS28XXFrameSPI::Encode (const u32 *pGRB, unsigned nBuffer)
+{
+	assert (pGRB != 0);
+	assert (nBuffer < 2);
+	u8 *pBuffer = m_pBuffer[nBuffer];
+	assert (pBuffer != 0);
+
+	if (m_Type == WS2801)
+	{
+		for (unsigned i = 0; i < m_nLEDsPerStrip; i++)
+		{
+			*pBuffer++ = (u8) (pGRB[i] >> 8);		// red
+			*pBuffer++ = (u8) (pGRB[i] >> 16);		// green
+			*pBuffer++ = (u8) pGRB[i];			// blue
+		}
+
+		return;
+	}
+
+	u8 nHighCode = m_Type == WS2812 ? 0xF0 : 0xF8;
+
+	for (unsigned i = 0; i < m_nLEDsPerStrip; i++)
+	{
+		u32 nGRB = pGRB[i];
+
+		for (u32 nMask = 1 << 23; nMask != 0; nMask >>= 1)
+		{
+			*pBuffer++ = nGRB & nMask ? nHighCode : 0xC0;
+		}
+	}
+}
+
+boolean CWS28XXFrameSPI::StartOutput (unsigned nBuffer)
+{
+	assert (!m_bBusy);
+	assert (nBuffer < 2);
+
+	m_bBusy = TRUE;
+	m_bStatus = TRUE;
+
+	m_SPIMaster.SetCompletionRoutine (SPICompletionRoutine, this);
+	m_SPIMaster.StartWriteRead (0, m_pBuffer[nBuffer], m_pReadBuffer, m_nBufSize);
+
+	return TRUE;
+}
+
+void CWS28XXFrameSPI::SPICompletionRoutine (boolean bStatus, void *pParam)
+{
+	CWS28XXFrameSPI *pThis = (CWS28XXFrameSPI *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_bStatus = bStatus;
+
+	DataMemBarrier ();
+
+	pThis->m_bBusy = FALSE;
+}
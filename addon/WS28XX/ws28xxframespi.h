@@ -0,0 +1,70 @@
+//
+// ws28xxframespi.h
+//
+// Frame output for one WS28XX controlled LED strip over SPI DMA
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _ws28xx_ws28xxframespi_h
+#define _ws28xx_ws28xxframespi_h
+
+#include "ws28xxframe.h"
+#include "ws28xxstripe.h"
+#include <circle/spimasterdma.h>
+#include <circle/interrupt.h>
+#include <circle/types.h>
+
+/// \class CWS28XXFrameSPI
+/// \brief Double-buffered frame output for one WS28XX strip on SPI0 (MOSI) with DMA
+/// \note The strip index for SetLED() is always 0.
+
+class CWS28XXFrameSPI : public CWS28XXFrame
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param Type LED controller type
+	/// \param nLEDCount Number of LEDs in the strip
+	/// \param nClockSpeed SPI clock in Hz, only variable on WS2801, otherwise ignored
+	CWS28XXFrameSPI (CInterruptSystem *pInterruptSystem, TWS28XXType Type,
+			 unsigned nLEDCount, unsigned nClockSpeed = 4000000);
+
+	~CWS28XXFrameSPI (void);
+
+	boolean Initialize (void);
+
+	boolean Wait (void);
+
+private:
+	void Encode (const u32 *pGRB, unsigned nBuffer);
+
+	boolean StartOutput (unsigned nBuffer);
+
+	static void SPICompletionRoutine (boolean bStatus, void *pParam);
+
+private:
+	TWS28XXType m_Type;
+	CSPIMasterDMA m_SPIMaster;
+
+	unsigned m_nBufSize;
+	u8 *m_pBuffer[2];
+	u8 *m_pReadBuffer;			// received data is ignored
+
+	volatile boolean m_bBusy;
+	volatile boolean m_bStatus;
+};
+
+#endif
@@ -22,6 +22,8 @@
 //
 #include <display/ili9341display.h>
 #include <circle/timer.h>
+#include <circle/new.h>
+#include <circle/synchronize.h>
 #include <circle/util.h>
 #include <circle/stdarg.h>
 #include <assert.h>
@@ -118,6 +120,10 @@
 #define ILI9341_INTERFACE_CONTROL	0xF6
 #define ILI9341_PUMP_RATIO_CONTROL	0xF7
 
+// The BCM2835 SPI master has a transfer size limit.
+// TODO: Request this parameter from the SPI master driver.
+static const size_t MaxTransferSize = 0xFFFC;
+
 CILI9341Display::CILI9341Display (CSPIMaster *pSPIMaster,
 				  unsigned nDCPin, unsigned nResetPin, unsigned nBackLightPin,
 				  unsigned nWidth, unsigned nHeight,
@@ -125,6 +131,7 @@ CILI9341Display::CILI9341Display (CSPIMaster *pSPIMaster,
 				  unsigned nChipSelect, boolean bSwapColorBytes)
 :	CDisplay (bSwapColorBytes ? RGB565_BE : RGB565),
 	m_pSPIMaster (pSPIMaster),
+	m_pSPIMasterDMA (nullptr),
 	m_nResetPin (nResetPin),
 	m_nBackLightPin (nBackLightPin),
 	m_nWidth (nWidth),
@@ -136,6 +143,8 @@ CILI9341Display::CILI9341Display (CSPIMaster *pSPIMaster,
 	m_bSwapColorBytes (bSwapColorBytes),
 	m_pBuffer (nullptr),
 	m_nRotation (0),
+	m_pRxBuffer (nullptr),
+	m_bTransferActive (FALSE),
 	m_DCPin (nDCPin, GPIOModeOutput)
 {
 	assert (nDCPin != None);
@@ -153,8 +162,28 @@ CILI9341Display::CILI9341Display (CSPIMaster *pSPIMaster,
 	}
 }
 
+CILI9341Display::CILI9341Display (CSPIMasterDMA *pSPIMasterDMA,
+				  unsigned nDCPin, unsigned nResetPin, unsigned nBackLightPin,
+				  unsigned nWidth, unsigned nHeight,
+				  unsigned nCPOL, unsigned nCPHA, unsigned nClockSpeed,
+				  unsigned nChipSelect, boolean bSwapColorBytes)
+:	CILI9341Display ((CSPIMaster *) nullptr, nDCPin, nResetPin, nBackLightPin,
+			 nWidth, nHeight, nCPOL, nCPHA,
+			 nClockSpeed, nChipSelect, bSwapColorBytes)
+{
+	m_pSPIMasterDMA = pSPIMasterDMA;
+	assert (m_pSPIMasterDMA != 0);
+
+	// the DMA receives the same amount of data, which is sent
+	m_pRxBuffer = new (HEAP_DMA30) u8[MaxTransferSize];
+	assert (m_pRxBuffer != 0);
+}
+
 CILI9341Display::~CILI9341Display (void)
 {
+	WaitForTransfer ();
+
+	delete [] m_pRxBuffer;
 	delete [] m_pBuffer;
 };
 
@@ -167,9 +196,11 @@ void CILI9341Display::SetRotation (unsigned nDegrees)
 
 boolean CILI9341Display::Initialize (void)
 {
-	assert (m_pSPIMaster != 0);
+	assert (m_pSPIMaster != 0 || m_pSPIMasterDMA != 0);
 
-	if (!m_bSwapColorBytes)
+	// the buffer is also needed to align the pixel data for DMA
+	if (   !m_bSwapColorBytes
+	    || m_pSPIMasterDMA)
 	{
 		assert (!m_pBuffer);
 		m_pBuffer = new u16[m_nWidth * m_nHeight];
@@ -325,6 +356,9 @@ void CILI9341Display::SetArea (const TArea &rArea, const void *pPixels,
 			       TAreaCompletionRoutine *pRoutine,
 			       void *pParam)
 {
+	// m_pBuffer may still be sent
+	WaitForTransfer ();
+
 	SetWindow (rArea.x1, rArea.y1, rArea.x2, rArea.y2);
 
 	size_t ulSize = (rArea.y2 - rArea.y1 + 1) * (rArea.x2 - rArea.x1 + 1) * sizeof (u16);
@@ -345,12 +379,15 @@ void CILI9341Display::SetArea (const TArea &rArea, const void *pPixels,
 		pPixels = m_pBuffer;
 	}
 
-	while (ulSize)
+	if (m_pSPIMasterDMA)
 	{
-		// The BCM2835 SPI master has a transfer size limit.
-		// TODO: Request this parameter from the SPI master driver.
-		const size_t MaxTransferSize = 0xFFFC;
+		SendDataDMA (pPixels, ulSize, pRoutine, pParam);
 
+		return;
+	}
+
+	while (ulSize)
+	{
 		size_t ulBlockSize = ulSize >= MaxTransferSize ? MaxTransferSize : ulSize;
 
 		SendData (pPixels, ulBlockSize);
@@ -388,10 +425,26 @@ void CILI9341Display::SetWindow (unsigned x0, unsigned y0, unsigned x1, unsigned
 
 void CILI9341Display::SendByte (u8 uchByte, boolean bIsData)
 {
-	assert (m_pSPIMaster != 0);
+	WaitForTransfer ();
 
 	m_DCPin.Write (bIsData ? HIGH : LOW);
 
+	if (m_pSPIMasterDMA)
+	{
+		m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+		m_pSPIMasterDMA->SetMode (m_nCPOL, m_nCPHA);
+
+#ifndef NDEBUG
+		int nResult =
+#endif
+			m_pSPIMasterDMA->WriteReadSync (m_nChipSelect, &uchByte, 0, sizeof uchByte);
+		assert (nResult == (int) sizeof uchByte);
+
+		return;
+	}
+
+	assert (m_pSPIMaster != 0);
+
 	m_pSPIMaster->SetClock (m_nClockSpeed);
 	m_pSPIMaster->SetMode (m_nCPOL, m_nCPHA);
 
@@ -406,10 +459,27 @@ void CILI9341Display::SendData (const void *pData, size_t nLength)
 {
 	assert (pData != 0);
 	assert (nLength > 0);
-	assert (m_pSPIMaster != 0);
+
+	WaitForTransfer ();
 
 	m_DCPin.Write (HIGH);
 
+	if (m_pSPIMasterDMA)
+	{
+		m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+		m_pSPIMasterDMA->SetMode (m_nCPOL, m_nCPHA);
+
+#ifndef NDEBUG
+		int nResult =
+#endif
+			m_pSPIMasterDMA->WriteReadSync (m_nChipSelect, pData, 0, nLength);
+		assert (nResult == (int) nLength);
+
+		return;
+	}
+
+	assert (m_pSPIMaster != 0);
+
 	m_pSPIMaster->SetClock (m_nClockSpeed);
 	m_pSPIMaster->SetMode (m_nCPOL, m_nCPHA);
 
@@ -420,6 +490,100 @@ void CILI9341Display::SendData (const void *pData, size_t nLength)
 	assert (nResult == (int) nLength);
 }
 
+void CILI9341Display::SendDataDMA (const void *pData, size_t nLength,
+				   TAreaCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pData != 0);
+	assert (nLength > 0);
+	assert (m_pSPIMasterDMA != 0);
+	assert (!m_bTransferActive);
+
+	// the DMA buffer must be word aligned
+	if ((uintptr) pData & 3)
+	{
+		assert (m_pBuffer != 0);
+		assert (nLength <= m_nWidth * m_nHeight * sizeof (u16));
+		memcpy (m_pBuffer, pData, nLength);
+
+		pData = m_pBuffer;
+	}
+
+	m_DCPin.Write (HIGH);
+
+	m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+	m_pSPIMasterDMA->SetMode (m_nCPOL, m_nCPHA);
+
+	m_pTransferData = (const u8 *) pData;
+	m_ulTransferRemaining = nLength;
+	m_pAreaCompletionRoutine = pRoutine;
+	m_pAreaCompletionParam = pParam;
+
+	m_bTransferActive = TRUE;
+
+	StartTransfer ();
+
+	if (!pRoutine)
+	{
+		WaitForTransfer ();
+	}
+}
+
+void CILI9341Display::StartTransfer (void)
+{
+	size_t ulBlockSize =   m_ulTransferRemaining >= MaxTransferSize
+			     ? MaxTransferSize : m_ulTransferRemaining;
+
+	const u8 *pBlock = m_pTransferData;
+	m_pTransferData += ulBlockSize;
+	m_ulTransferRemaining -= ulBlockSize;
+
+	assert (m_pSPIMasterDMA != 0);
+	m_pSPIMasterDMA->SetCompletionRoutine (SPICompletionStub, this);
+	m_pSPIMasterDMA->StartWriteRead (m_nChipSelect, pBlock, m_pRxBuffer, ulBlockSize);
+}
+
+void CILI9341Display::WaitForTransfer (void)
+{
+	while (m_bTransferActive)
+	{
+		// just wait
+	}
+
+	DataMemBarrier ();
+}
+
+void CILI9341Display::SPICompletionRoutine (boolean bStatus)
+{
+	assert (m_bTransferActive);
+	assert (bStatus);
+
+	if (   bStatus
+	    && m_ulTransferRemaining)
+	{
+		StartTransfer ();
+
+		return;
+	}
+
+	TAreaCompletionRoutine *pRoutine = m_pAreaCompletionRoutine;
+	void *pParam = m_pAreaCompletionParam;
+
+	m_bTransferActive = FALSE;
+
+	if (pRoutine)
+	{
+		(*pRoutine) (pParam);
+	}
+}
+
+void CILI9341Display::SPICompletionStub (boolean bStatus, void *pParam)
+{
+	CILI9341Display *pThis = static_cast<CILI9341Display *> (pParam);
+	assert (pThis != 0);
+
+	pThis->SPICompletionRoutine (bStatus);
+}
+
 void CILI9341Display::CommandAndData (u8 uchCmd, unsigned nDataLen, ...)
 {
 	va_list var;
@@ -26,6 +26,9 @@
 //
 #include <display/st7789display.h>
 #include <circle/timer.h>
+#include <circle/new.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
 #include <assert.h>
 
 #define ST7789_NOP	0x00
@@ -84,6 +87,10 @@
 
 #define ST7789_PWCTR6	0xFC
 
+// The BCM2835 SPI master has a transfer size limit.
+// TODO: Request this parameter from the SPI master driver.
+static const size_t MaxTransferSize = 0xFFFC;
+
 CST7789Display::CST7789Display (CSPIMaster *pSPIMaster,
 				unsigned nDCPin, unsigned nResetPin, unsigned nBackLightPin,
 				unsigned nWidth, unsigned nHeight,
@@ -91,6 +98,7 @@ CST7789Display::CST7789Display (CSPIMaster *pSPIMaster,
 				unsigned nChipSelect, boolean bSwapColorBytes)
 :	CDisplay (bSwapColorBytes ? RGB565_BE : RGB565),
 	m_pSPIMaster (pSPIMaster),
+	m_pSPIMasterDMA (nullptr),
 	m_nResetPin (nResetPin),
 	m_nBackLightPin (nBackLightPin),
 	m_nWidth (nWidth),
@@ -100,6 +108,8 @@ CST7789Display::CST7789Display (CSPIMaster *pSPIMaster,
 	m_nClockSpeed (nClockSpeed),
 	m_nChipSelect (nChipSelect),
 	m_bSwapColorBytes (bSwapColorBytes),
+	m_pRxBuffer (nullptr),
+	m_bTransferActive (FALSE),
 	m_DCPin (nDCPin, GPIOModeOutput)
 {
 	assert (nDCPin != None);
@@ -122,14 +132,34 @@ CST7789Display::CST7789Display (CSPIMaster *pSPIMaster,
 	assert (m_pBuffer != 0);
 }
 
+CST7789Display::CST7789Display (CSPIMasterDMA *pSPIMasterDMA,
+				unsigned nDCPin, unsigned nResetPin, unsigned nBackLightPin,
+				unsigned nWidth, unsigned nHeight,
+				unsigned CPOL, unsigned CPHA, unsigned nClockSpeed,
+				unsigned nChipSelect, boolean bSwapColorBytes)
+:	CST7789Display ((CSPIMaster *) nullptr, nDCPin, nResetPin, nBackLightPin,
+			nWidth, nHeight, CPOL, CPHA,
+			nClockSpeed, nChipSelect, bSwapColorBytes)
+{
+	m_pSPIMasterDMA = pSPIMasterDMA;
+	assert (m_pSPIMasterDMA != 0);
+
+	// the DMA receives the same amount of data, which is sent
+	m_pRxBuffer = new (HEAP_DMA30) u8[MaxTransferSize];
+	assert (m_pRxBuffer != 0);
+}
+
 CST7789Display::~CST7789Display (void)
 {
+	WaitForTransfer ();
+
+	delete [] m_pRxBuffer;
 	delete [] m_pBuffer;
 }
 
 boolean CST7789Display::Initialize (void)
 {
-	assert (m_pSPIMaster != 0);
+	assert (m_pSPIMaster != 0 || m_pSPIMasterDMA != 0);
 
 	if (m_nBackLightPin != None)
 	{
@@ -413,6 +443,9 @@ void CST7789Display::SetPixel (unsigned nPosX, unsigned nPosY, TRawColor nColor)
 void CST7789Display::SetArea (const TArea &rArea, const void *pPixels,
 			      TAreaCompletionRoutine *pRoutine, void *pParam)
 {
+	// m_pBuffer may still be sent
+	WaitForTransfer ();
+
 	int nWidth = rArea.x2 - rArea.x1 + 1;
 	int nHeight = rArea.y2 - rArea.y1 + 1;
 
@@ -472,12 +505,15 @@ void CST7789Display::SetArea (const TArea &rArea, const void *pPixels,
 	}
 
 	size_t ulSize = nWidth * nHeight * sizeof (u16);
-	while (ulSize)
+	if (m_pSPIMasterDMA)
 	{
-		// The BCM2835 SPI master has a transfer size limit.
-		// TODO: Request this parameter from the SPI master driver.
-		const size_t MaxTransferSize = 0xFFFC;
+		SendDataDMA (pPixels, ulSize, pRoutine, pParam);
+
+		return;
+	}
 
+	while (ulSize)
+	{
 		size_t ulBlockSize = ulSize >= MaxTransferSize ? MaxTransferSize : ulSize;
 
 		SendData (pPixels, ulBlockSize);
@@ -517,10 +553,26 @@ void CST7789Display::SetWindow (unsigned x0, unsigned y0, unsigned x1, unsigned
 
 void CST7789Display::SendByte (u8 uchByte, boolean bIsData)
 {
-	assert (m_pSPIMaster != 0);
+	WaitForTransfer ();
 
 	m_DCPin.Write (bIsData ? HIGH : LOW);
 
+	if (m_pSPIMasterDMA)
+	{
+		m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+		m_pSPIMasterDMA->SetMode (m_CPOL, m_CPHA);
+
+#ifndef NDEBUG
+		int nResult =
+#endif
+			m_pSPIMasterDMA->WriteReadSync (m_nChipSelect, &uchByte, 0, sizeof uchByte);
+		assert (nResult == (int) sizeof uchByte);
+
+		return;
+	}
+
+	assert (m_pSPIMaster != 0);
+
 	m_pSPIMaster->SetClock (m_nClockSpeed);
 	m_pSPIMaster->SetMode (m_CPOL, m_CPHA);
 
@@ -535,10 +587,27 @@ void CST7789Display::SendData (const void *pData, size_t nLength)
 {
 	assert (pData != 0);
 	assert (nLength > 0);
-	assert (m_pSPIMaster != 0);
+
+	WaitForTransfer ();
 
 	m_DCPin.Write (HIGH);
 
+	if (m_pSPIMasterDMA)
+	{
+		m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+		m_pSPIMasterDMA->SetMode (m_CPOL, m_CPHA);
+
+#ifndef NDEBUG
+		int nResult =
+#endif
+			m_pSPIMasterDMA->WriteReadSync (m_nChipSelect, pData, 0, nLength);
+		assert (nResult == (int) nLength);
+
+		return;
+	}
+
+	assert (m_pSPIMaster != 0);
+
 	m_pSPIMaster->SetClock (m_nClockSpeed);
 	m_pSPIMaster->SetMode (m_CPOL, m_CPHA);
 
@@ -548,3 +617,97 @@ void CST7789Display::SendData (const void *pData, size_t nLength)
 		m_pSPIMaster->Write (m_nChipSelect, pData, nLength);
 	assert (nResult == (int) nLength);
 }
+
+void CST7789Display::SendDataDMA (const void *pData, size_t nLength,
+				  TAreaCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pData != 0);
+	assert (nLength > 0);
+	assert (m_pSPIMasterDMA != 0);
+	assert (!m_bTransferActive);
+
+	// the DMA buffer must be word aligned
+	if ((uintptr) pData & 3)
+	{
+		assert (m_pBuffer != 0);
+		assert (nLength <= m_nWidth * m_nHeight * sizeof (u16));
+		memcpy (m_pBuffer, pData, nLength);
+
+		pData = m_pBuffer;
+	}
+
+	m_DCPin.Write (HIGH);
+
+	m_pSPIMasterDMA->SetClock (m_nClockSpeed);
+	m_pSPIMasterDMA->SetMode (m_CPOL, m_CPHA);
+
+	m_pTransferData = (const u8 *) pData;
+	m_ulTransferRemaining = nLength;
+	m_pAreaCompletionRoutine = pRoutine;
+	m_pAreaCompletionParam = pParam;
+
+	m_bTransferActive = TRUE;
+
+	StartTransfer ();
+
+	if (!pRoutine)
+	{
+		WaitForTransfer ();
+	}
+}
+
+void CST7789Display::StartTransfer (void)
+{
+	size_t ulBlockSize =   m_ulTransferRemaining >= MaxTransferSize
+			     ? MaxTransferSize : m_ulTransferRemaining;
+
+	const u8 *pBlock = m_pTransferData;
+	m_pTransferData += ulBlockSize;
+	m_ulTransferRemaining -= ulBlockSize;
+
+	assert (m_pSPIMasterDMA != 0);
+	m_pSPIMasterDMA->SetCompletionRoutine (SPICompletionStub, this);
+	m_pSPIMasterDMA->StartWriteRead (m_nChipSelect, pBlock, m_pRxBuffer, ulBlockSize);
+}
+
+void CST7789Display::WaitForTransfer (void)
+{
+	while (m_bTransferActive)
+	{
+		// just wait
+	}
+
+	DataMemBarrier ();
+}
+
+void CST7789Display::SPICompletionRoutine (boolean bStatus)
+{
+	assert (m_bTransferActive);
+	assert (bStatus);
+
+	if (   bStatus
+	    && m_ulTransferRemaining)
+	{
+		StartTransfer ();
+
+		return;
+	}
+
+	TAreaCompletionRoutine *pRoutine = m_pAreaCompletionRoutine;
+	void *pParam = m_pAreaCompletionParam;
+
+	m_bTransferActive = FALSE;
+
+	if (pRoutine)
+	{
+		(*pRoutine) (pParam);
+	}
+}
+
+void CST7789Display::SPICompletionStub (boolean bStatus, void *pParam)
+{
+	CST7789Display *pThis = static_cast<CST7789Display *> (pParam);
+	assert (pThis != 0);
+
+	pThis->SPICompletionRoutine (bStatus);
+}
@@ -22,6 +22,7 @@
 
 #include <circle/display.h>
 #include <circle/spimaster.h>
+#include <circle/spimasterdma.h>
 #include <circle/gpiopin.h>
 #include <circle/chargenerator.h>
 #include <circle/util.h>
@@ -64,6 +65,16 @@ public:
 			unsigned CPOL = 0, unsigned CPHA = 0, unsigned nClockSpeed = 15000000,
 			unsigned nChipSelect = 0, boolean bSwapColorBytes = TRUE);
 
+	/// \param pSPIMasterDMA Pointer to SPI master object with DMA support
+	/// \note The other parameters are the same as above.
+	/// \note SetArea() sends the pixel data with DMA and returns immediately,
+	///	  when a completion routine is given.
+	CST7789Display (CSPIMasterDMA *pSPIMasterDMA,
+			unsigned nDCPin, unsigned nResetPin = None, unsigned nBackLightPin = None,
+			unsigned nWidth = 240, unsigned nHeight = 240,
+			unsigned CPOL = 0, unsigned CPHA = 0, unsigned nClockSpeed = 15000000,
+			unsigned nChipSelect = 0, boolean bSwapColorBytes = TRUE);
+
 	~CST7789Display (void);
 
 	/// \return Display width in number of pixels
@@ -122,6 +133,8 @@ public:
 	/// \param pPixels Pointer to array with raw color values (RGB565 or RGB565_BE)
 	/// \param pRoutine Routine to be called on completion
 	/// \param pParam User parameter to be handed over to completion routine
+	/// \note With DMA and pRoutine given, the pixels must not be modified, until
+	///	  pRoutine is called (from interrupt context).
 	void SetArea (const TArea &rArea, const void *pPixels,
 		      TAreaCompletionRoutine *pRoutine = nullptr,
 		      void *pParam = nullptr);
@@ -135,12 +148,20 @@ private:
 	void Data (u8 uchByte)		{ SendByte (uchByte, TRUE); }
 
 	void SendData (const void *pData, size_t nLength);
+
+	void SendDataDMA (const void *pData, size_t nLength,
+			  TAreaCompletionRoutine *pRoutine, void *pParam);
+	void StartTransfer (void);
+	void WaitForTransfer (void);
+	void SPICompletionRoutine (boolean bStatus);
+	static void SPICompletionStub (boolean bStatus, void *pParam);
 	
 	unsigned RotX (unsigned x, unsigned y);
 	unsigned RotY (unsigned x, unsigned y);
 
 private:
 	CSPIMaster *m_pSPIMaster;
+	CSPIMasterDMA *m_pSPIMasterDMA;
 	unsigned m_nResetPin;
 	unsigned m_nBackLightPin;
 	unsigned m_nWidth;
@@ -154,6 +175,13 @@ private:
 	unsigned m_nRotation;
 	u16 *m_pBuffer;
 
+	u8 *m_pRxBuffer;				// dummy buffer for DMA
+	volatile boolean m_bTransferActive;
+	const u8 *m_pTransferData;
+	size_t m_ulTransferRemaining;
+	TAreaCompletionRoutine *m_pAreaCompletionRoutine;
+	void *m_pAreaCompletionParam;
+
 	CGPIOPin m_DCPin;
 	CGPIOPin m_ResetPin;
 	CGPIOPin m_BackLightPin;
@@ -12,14 +12,21 @@
 #include "diskio.h"		/* Declarations of disk functions */
 #include <circle/device.h>
 #include <circle/devicenameservice.h>
+#include <circle/fs/buffercache.h>
+#include <circle/synchronize.h>
+#include <circle/sysconfig.h>
 #include <circle/util.h>
+#include <circle/new.h>
 #include <circle/types.h>
 #include <assert.h>
 
-#if FF_MIN_SS != FF_MAX_SS
-	#error FF_MIN_SS != FF_MAX_SS is not supported!
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/synchronizationevent.h>
+#endif
+
+#if FF_MIN_SS != 512
+	#error FF_MIN_SS must be 512!
 #endif
-#define SECTOR_SIZE		FF_MIN_SS
 
 /*-----------------------------------------------------------------------*/
 /* Static Data                                                           */
@@ -32,13 +39,27 @@ static const char *s_pVolumeName[FF_VOLUMES] =
 	"umsd2",
 	"umsd3",
 	"ufd1",
-	"nvme1"
+	"nvme1",
+	"ramdisk1"
 };
 
 static CDevice *s_pVolume[FF_VOLUMES] = {0};
 
-static u8 *s_pBuffer = 0;
-static unsigned s_nBufferSize = 0;
+/* Logical block size of the device, FF_MIN_SS..FF_MAX_SS */
+static unsigned s_nSectorSize[FF_VOLUMES] = {0};
+
+/* Bounce buffers for transfers, which are not cache aligned */
+static u8 *s_pBuffer[FF_VOLUMES] = {0};
+static unsigned s_nBufferSize[FF_VOLUMES] = {0};
+
+struct TTransfer
+{
+	volatile int nResult;
+	volatile boolean bDone;
+#ifdef NO_BUSY_WAIT
+	CSynchronizationEvent Event;
+#endif
+};
 
 
 
@@ -54,6 +75,136 @@ static void disk_removed (
 	*((CDevice **) pContext) = 0;
 }
 
+static void transfer_completed (
+	int nResult,		/* transferred bytes or < 0 */
+	void *pParam		/* TTransfer */
+)
+{
+	TTransfer *pTransfer = (TTransfer *) pParam;
+	assert (pTransfer != 0);
+
+	pTransfer->nResult = nResult;
+	DataMemBarrier ();
+	pTransfer->bDone = TRUE;
+
+#ifdef NO_BUSY_WAIT
+	pTransfer->Event.Set ();
+#endif
+}
+
+
+
+/*-----------------------------------------------------------------------*/
+/* Helpers                                                               */
+/*-----------------------------------------------------------------------*/
+
+static u8 *get_buffer (
+	BYTE pdrv,		/* Physical drive nmuber */
+	unsigned nSize		/* Required size in bytes */
+)
+{
+	assert (pdrv < FF_VOLUMES);
+
+	if (s_nBufferSize[pdrv] < nSize)
+	{
+		delete [] s_pBuffer[pdrv];
+
+		s_nBufferSize[pdrv] = nSize;
+
+		s_pBuffer[pdrv] = new (HEAP_DMA30) u8[s_nBufferSize[pdrv]];
+		assert (s_pBuffer[pdrv] != 0);
+	}
+
+	return s_pBuffer[pdrv];
+}
+
+static unsigned get_sector_size (
+	CDevice *pDevice	/* Block device */
+)
+{
+	assert (pDevice != 0);
+
+	/* This fails, if unsupported, 512 bytes are assumed then */
+	unsigned nSectorSize = FF_MIN_SS;
+	pDevice->IOCtl (DEVICE_IOCTL_GET_BLOCK_SIZE, &nSectorSize);
+
+	if (   nSectorSize < FF_MIN_SS
+	    || nSectorSize > FF_MAX_SS
+	    || (nSectorSize & (nSectorSize-1)) != 0)
+	{
+		return 0;
+	}
+
+	return nSectorSize;
+}
+
+static boolean disk_transfer (
+	CDevice *pDevice,	/* Block device */
+	boolean bWrite,		/* Direction */
+	void *pBuffer,		/* Cache aligned buffer */
+	QWORD offset,		/* Byte offset on device */
+	unsigned nSize,		/* Number of bytes */
+	UINT count		/* Number of sectors */
+)
+{
+	assert (pDevice != 0);
+
+	/* The buffer cache is shared with the partition devices */
+	CBufferCache *pCache = CBufferCache::Get ();
+	if (pCache != 0)
+	{
+		int nResult = bWrite ? pCache->Write (pDevice, offset, pBuffer, nSize)
+				     : pCache->Read (pDevice, offset, pBuffer, nSize);
+
+		return nResult == (int) nSize;
+	}
+
+	/* Multi-sector requests are queued to the device, if it supports it */
+	if (count > 1)
+	{
+		TTransfer Transfer;
+		Transfer.nResult = -1;
+		Transfer.bDone = FALSE;
+
+		TDeviceBlockRequest Request;
+		Request.bWrite = bWrite;
+		Request.pBuffer = pBuffer;
+		Request.ullOffset = offset;
+		Request.nCount = nSize;
+		Request.pCompletionRoutine = transfer_completed;
+		Request.pParam = &Transfer;
+
+		if (pDevice->IOCtl (DEVICE_IOCTL_SUBMIT, &Request) == 0)
+		{
+#ifdef NO_BUSY_WAIT
+			Transfer.Event.Wait ();
+#else
+			while (!Transfer.bDone)
+			{
+				/* completed from interrupt */
+			}
+#endif
+			DataMemBarrier ();
+
+			if (Transfer.nResult == (int) nSize)
+			{
+				return TRUE;
+			}
+
+			/* Retry synchronously, the driver does its error recovery there */
+		}
+	}
+
+	if (pDevice->Seek (offset) != offset)
+	{
+		return FALSE;
+	}
+
+	int nResult = bWrite ? pDevice->Write (pBuffer, nSize) : pDevice->Read (pBuffer, nSize);
+
+	return nResult == (int) nSize;
+}
+
 
 
 /*-----------------------------------------------------------------------*/
@@ -91,6 +242,14 @@ DSTATUS disk_initialize (
 	s_pVolume[pdrv] = CDeviceNameService::Get ()->GetDevice (s_pVolumeName[pdrv], TRUE);
 	if (s_pVolume[pdrv] != 0)
 	{
+		s_nSectorSize[pdrv] = get_sector_size (s_pVolume[pdrv]);
+		if (s_nSectorSize[pdrv] == 0)
+		{
+			s_pVolume[pdrv] = 0;
+
+			return STA_NOINIT;
+		}
+
 		s_pVolume[pdrv]->RegisterRemovedHandler (disk_removed, &s_pVolume[pdrv]);
 
 		return 0;
@@ -123,29 +282,18 @@ DRESULT disk_read (
 		return RES_NOTRDY;
 	}
 
-	/* Ensure that the transfer buffer is word aligned */
+	/* DMA goes directly to the caller's buffer, if it is cache aligned */
 	BYTE *pBuffer = buff;
-	unsigned nSize = count * SECTOR_SIZE;
-	if (((uintptr) pBuffer & 3) != 0)
+	unsigned nSize = count * s_nSectorSize[pdrv];
+	if (!IS_CACHE_ALIGNED (pBuffer, nSize))
 	{
-		if (s_nBufferSize < nSize)
-		{
-			delete [] s_pBuffer;
-
-			s_nBufferSize = nSize;
-
-			s_pBuffer = new u8[s_nBufferSize];
-			assert (s_pBuffer != 0);
-		}
-
-		pBuffer = s_pBuffer;
+		pBuffer = get_buffer (pdrv, nSize);
 	}
 
 	QWORD offset = sector;
-	offset *= SECTOR_SIZE;
-	pDevice->Seek (offset);
+	offset *= s_nSectorSize[pdrv];
 
-	if (pDevice->Read (pBuffer, nSize) < 0)
+	if (!disk_transfer (pDevice, FALSE, pBuffer, offset, nSize, count))
 	{
 		return RES_ERROR;
 	}
@@ -184,31 +332,22 @@ DRESULT disk_write (
 		return RES_NOTRDY;
 	}
 
-	/* Ensure that the transfer buffer is word aligned */
+	/* DMA goes directly from the caller's buffer, if it is cache aligned */
 	const BYTE *pBuffer = buff;
-	unsigned nSize = count * SECTOR_SIZE;
-	if (((uintptr) pBuffer & 3) != 0)
+	unsigned nSize = count * s_nSectorSize[pdrv];
+	if (!IS_CACHE_ALIGNED (pBuffer, nSize))
 	{
-		if (s_nBufferSize < nSize)
-		{
-			delete [] s_pBuffer;
-
-			s_nBufferSize = nSize;
+		u8 *pBounceBuffer = get_buffer (pdrv, nSize);
 
-			s_pBuffer = new u8[s_nBufferSize];
-			assert (s_pBuffer != 0);
-		}
-
-		memcpy (s_pBuffer, buff, nSize);
+		memcpy (pBounceBuffer, buff, nSize);
 
-		pBuffer = s_pBuffer;
+		pBuffer = pBounceBuffer;
 	}
 
 	QWORD offset = sector;
-	offset *= SECTOR_SIZE;
-	pDevice->Seek (offset);
+	offset *= s_nSectorSize[pdrv];
 
-	if (pDevice->Write (pBuffer, nSize) < 0)
+	if (!disk_transfer (pDevice, TRUE, (void *) pBuffer, offset, nSize, count))
 	{
 		return RES_ERROR;
 	}
@@ -243,12 +382,14 @@ DRESULT disk_ioctl (
 			if (pDevice != 0)
 			{
 				u64 ullSize = pDevice->GetSize ();
-				if (ullSize == (u64) -1)
+				unsigned nSectorSize = get_sector_size (pDevice);
+				if (   ullSize == (u64) -1
+				    || nSectorSize == 0)
 				{
 					return RES_PARERR;
 				}
 
-				*(LBA_t *) buff = (LBA_t) (ullSize / SECTOR_SIZE);
+				*(LBA_t *) buff = (LBA_t) (ullSize / nSectorSize);
 			}
 			else
 			{
@@ -268,6 +409,12 @@ DRESULT disk_ioctl (
 				CDeviceNameService::Get ()->GetDevice (s_pVolumeName[pdrv], TRUE);
 			if (pDevice != 0)
 			{
+				if (   CBufferCache::Get () != 0
+				    && !CBufferCache::Get ()->Flush (pDevice))
+				{
+					return RES_ERROR;
+				}
+
 				/* This fails, if unsupported, so ignore eventual errors. */
 				pDevice->IOCtl (DEVICE_IOCTL_SYNC, 0);
 			}
@@ -279,8 +426,66 @@ DRESULT disk_ioctl (
 		return RES_OK;
 
 	case GET_SECTOR_SIZE:
-		assert (buff != 0);
-		*(WORD *) buff = SECTOR_SIZE;
+		{
+			if (pdrv >= FF_VOLUMES)
+			{
+				return RES_PARERR;
+			}
+
+			CDevice *pDevice =
+				CDeviceNameService::Get ()->GetDevice (s_pVolumeName[pdrv], TRUE);
+			if (pDevice == 0)
+			{
+				return RES_NOTRDY;
+			}
+
+			unsigned nSectorSize = get_sector_size (pDevice);
+			if (nSectorSize == 0)
+			{
+				return RES_ERROR;
+			}
+
+			assert (buff != 0);
+			*(WORD *) buff = (WORD) nSectorSize;
+		}
+		return RES_OK;
+
+	case CTRL_TRIM:
+		{
+			if (pdrv >= FF_VOLUMES)
+			{
+				return RES_PARERR;
+			}
+
+			CDevice *pDevice = s_pVolume[pdrv];
+			if (pDevice == 0)
+			{
+				return RES_NOTRDY;
+			}
+
+			/* buff points to the first and last sector (inclusive) */
+			assert (buff != 0);
+			const LBA_t *pRange = (const LBA_t *) buff;
+			if (pRange[1] < pRange[0])
+			{
+				return RES_PARERR;
+			}
+
+			TDeviceBlockRange Range;
+			Range.ullOffset = (u64) pRange[0] * s_nSectorSize[pdrv];
+			Range.ullCount = ((u64) pRange[1] - pRange[0] + 1) * s_nSectorSize[pdrv];
+
+			if (CBufferCache::Get () != 0)
+			{
+				CBufferCache::Get ()->Discard (pDevice, Range.ullOffset, Range.ullCount);
+			}
+
+			/* This fails, if unsupported. FatFs ignores the result. */
+			if (pDevice->IOCtl (DEVICE_IOCTL_DISCARD, &Range) != 0)
+			{
+				return RES_ERROR;
+			}
+		}
 		return RES_OK;
 
 	case CTRL_EJECT:
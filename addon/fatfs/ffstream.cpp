@@ -0,0 +1,374 @@
+/*------------------------------------------------------------------------*/
+/* Fast seek, contiguous allocation and raw sector streaming for FatFs    */
+/* Implementation for Circle by R. Stange <rsta2@o2online.de>             */
+/*------------------------------------------------------------------------*/
+
+#include "ffstream.h"
+#include "diskio.h"
+#include <circle/alloc.h>
+#include <assert.h>
+
+#define CLMT_INITIAL_SIZE	64	/* Items, enough for 30 fragments */
+
+
+/*------------------------------------------------------------------------*/
+/* Build the cluster link map table and enable fast seek mode             */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_fastseek_open (
+	FIL* fp			/* Pointer to the open file object */
+)
+{
+	assert (fp != 0);
+
+	f_fastseek_close (fp);
+
+	DWORD tlen = CLMT_INITIAL_SIZE;
+	for (;;)
+	{
+		DWORD *tbl = (DWORD *) malloc (tlen * sizeof (DWORD));
+		if (tbl == 0)
+		{
+			return FR_NOT_ENOUGH_CORE;
+		}
+
+		tbl[0] = tlen;
+		fp->cltbl = tbl;
+
+		FRESULT res = f_lseek (fp, CREATE_LINKMAP);
+		if (res == FR_OK)
+		{
+			return FR_OK;
+		}
+
+		/* On FR_NOT_ENOUGH_CORE tbl[0] holds the required size */
+		DWORD ulen = tbl[0];
+
+		fp->cltbl = 0;
+		free (tbl);
+
+		if (   res != FR_NOT_ENOUGH_CORE
+		    || ulen <= tlen)
+		{
+			return res;
+		}
+
+		tlen = ulen;
+	}
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Release the cluster link map table                                     */
+/*------------------------------------------------------------------------*/
+/* Can be called before or after f_close().
+*/
+
+void f_fastseek_close (
+	FIL* fp			/* Pointer to the file object */
+)
+{
+	assert (fp != 0);
+
+	if (fp->cltbl != 0)
+	{
+		free (fp->cltbl);
+		fp->cltbl = 0;
+	}
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Allocate a contiguous cluster block to an empty file                   */
+/*------------------------------------------------------------------------*/
+/* The file size is set to fsz, the content of the file is undefined.
+/  The directory entry is written immediately, so that the allocation
+/  persists, even if the file is not closed properly later.
+*/
+
+FRESULT f_prealloc (
+	FIL* fp,		/* Pointer to the file object opened for writing */
+	FSIZE_t fsz		/* File size to be allocated */
+)
+{
+	assert (fp != 0);
+
+	FRESULT res = f_expand (fp, fsz, 1);
+	if (res != FR_OK)
+	{
+		return res;
+	}
+
+	return f_sync (fp);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Check, if the cluster chain of a file is contiguous                    */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_is_contiguous (
+	FIL* fp			/* Pointer to the open file object */
+)
+{
+	assert (fp != 0);
+
+	/* A CLMT with a single fragment needs four items */
+	DWORD tbl[4];
+	tbl[0] = sizeof tbl / sizeof tbl[0];
+
+	DWORD *cltbl = fp->cltbl;
+	fp->cltbl = tbl;
+
+	FRESULT res = f_lseek (fp, CREATE_LINKMAP);
+
+	fp->cltbl = cltbl;
+
+	if (res == FR_NOT_ENOUGH_CORE)
+	{
+		return FR_DENIED;
+	}
+
+	return res;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Open a raw sector stream on a contiguous file                          */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_stream_open (
+	FFSTREAM* st,	/* Pointer to the stream object to be created */
+	FIL* fp			/* Pointer to the open file object */
+)
+{
+	assert (st != 0);
+	assert (fp != 0);
+
+	st->fp = 0;
+
+	FRESULT res = f_is_contiguous (fp);
+	if (res != FR_OK)
+	{
+		return res;
+	}
+
+	FATFS *fs = fp->obj.fs;
+	assert (fs != 0);
+
+	if (fp->obj.sclust < 2)
+	{
+		return FR_DENIED;		/* No data allocated */
+	}
+
+	/* Write back the file buffer and the directory entry */
+	if (fp->flag & FA_WRITE)
+	{
+		res = f_sync (fp);
+		if (res != FR_OK)
+		{
+			return res;
+		}
+	}
+
+	st->fp = fp;
+	st->sect = fs->database + (LBA_t) fs->csize * (fp->obj.sclust - 2);
+#if FF_MAX_SS != FF_MIN_SS
+	st->nsect = (LBA_t) (fp->obj.objsize / fs->ssize);
+#else
+	st->nsect = (LBA_t) (fp->obj.objsize / FF_MAX_SS);
+#endif
+	st->pos = 0;
+
+	return FR_OK;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Close a raw sector stream                                              */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_stream_close (
+	FFSTREAM* st	/* Pointer to the stream object */
+)
+{
+	assert (st != 0);
+
+	if (st->fp == 0)
+	{
+		return FR_INVALID_OBJECT;
+	}
+
+	/* The sector buffer of the file may be stale now */
+	st->fp->sect = 0;
+
+	st->fp = 0;
+
+	return FR_OK;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Set the sector position of a raw sector stream                         */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_stream_seek (
+	FFSTREAM* st,	/* Pointer to the stream object */
+	LBA_t pos		/* Sector position from the top of the file */
+)
+{
+	assert (st != 0);
+
+	if (st->fp == 0)
+	{
+		return FR_INVALID_OBJECT;
+	}
+
+	if (pos > st->nsect)
+	{
+		return FR_INVALID_PARAMETER;
+	}
+
+	st->pos = pos;
+
+	return FR_OK;
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Transfer sectors of a raw sector stream                                */
+/*------------------------------------------------------------------------*/
+
+static FRESULT stream_transfer (
+	FFSTREAM* st,	/* Pointer to the stream object */
+	BYTE* buff,		/* Data buffer */
+	UINT count,		/* Number of sectors to transfer */
+	UINT* bt,		/* Number of sectors transferred */
+	int write		/* Direction */
+)
+{
+	assert (st != 0);
+	assert (buff != 0);
+	assert (bt != 0);
+
+	*bt = 0;
+
+	FIL *fp = st->fp;
+	if (fp == 0)
+	{
+		return FR_INVALID_OBJECT;
+	}
+
+	FATFS *fs = fp->obj.fs;
+	if (   fs == 0
+	    || fs->fs_type == 0
+	    || fs->id != fp->obj.id)
+	{
+		return FR_INVALID_OBJECT;	/* Volume has been unmounted */
+	}
+
+	if (write && !(fp->flag & FA_WRITE))
+	{
+		return FR_DENIED;
+	}
+
+	assert (st->pos <= st->nsect);
+	if (count > st->nsect - st->pos)
+	{
+		count = (UINT) (st->nsect - st->pos);	/* Clip at the end of file */
+	}
+
+	if (count == 0)
+	{
+		return FR_OK;
+	}
+
+#if FF_FS_REENTRANT
+	if (!ff_mutex_take (fs->ldrv))	/* Serialize with FatFs on this volume */
+	{
+		return FR_TIMEOUT;
+	}
+#endif
+
+	LBA_t sect = st->sect + st->pos;
+
+	DRESULT dres = write ? disk_write (fs->pdrv, buff, sect, count)
+			     : disk_read (fs->pdrv, buff, sect, count);
+
+	fp->sect = 0;		/* Invalidate the sector buffer of the file */
+
+#if FF_FS_REENTRANT
+	ff_mutex_give (fs->ldrv);
+#endif
+
+	if (dres != RES_OK)
+	{
+		return FR_DISK_ERR;
+	}
+
+	st->pos += count;
+	*bt = count;
+
+	return FR_OK;
+}
+
+FRESULT f_stream_read (
+	FFSTREAM* st,	/* Pointer to the stream object */
+	void* buff,		/* Pointer to the data buffer */
+	UINT count,		/* Number of sectors to read */
+	UINT* br		/* Pointer to the number of sectors read */
+)
+{
+	return stream_transfer (st, (BYTE *) buff, count, br, 0);
+}
+
+FRESULT f_stream_write (
+	FFSTREAM* st,	/* Pointer to the stream object */
+	const void* buff,	/* Pointer to the data to be written */
+	UINT count,		/* Number of sectors to write */
+	UINT* bw		/* Pointer to the number of sectors written */
+)
+{
+	return stream_transfer (st, (BYTE *) buff, count, bw, 1);
+}
+
+
+/*------------------------------------------------------------------------*/
+/* Flush the write cache of the drive of a raw sector stream              */
+/*------------------------------------------------------------------------*/
+
+FRESULT f_stream_sync (
+	FFSTREAM* st	/* Pointer to the stream object */
+)
+{
+	assert (st != 0);
+
+	FIL *fp = st->fp;
+	if (fp == 0)
+	{
+		return FR_INVALID_OBJECT;
+	}
+
+	FATFS *fs = fp->obj.fs;
+	if (   fs == 0
+	    || fs->fs_type == 0
+	    || fs->id != fp->obj.id)
+	{
+		return FR_INVALID_OBJECT;	/* Volume has been unmounted */
+	}
+
+#if FF_FS_REENTRANT
+	if (!ff_mutex_take (fs->ldrv))
+	{
+		return FR_TIMEOUT;
+	}
+#endif
+
+	DRESULT dres = disk_ioctl (fs->pdrv, CTRL_SYNC, 0);
+
+#if FF_FS_REENTRANT
+	ff_mutex_give (fs->ldrv);
+#endif
+
+	return dres == RES_OK ? FR_OK : FR_DISK_ERR;
+}
@@ -0,0 +1,66 @@
+/*------------------------------------------------------------------------*/
+/* Fast seek, contiguous allocation and raw sector streaming for FatFs    */
+/* Implementation for Circle by R. Stange <rsta2@o2online.de>             */
+/*------------------------------------------------------------------------*/
+/* f_fastseek_open() builds the cluster link map table (CLMT) of an open  */
+/* file and attaches it to the file object, so that f_lseek() and the     */
+/* following reads do not walk the FAT chain from the start. Files in     */
+/* fast seek mode cannot be extended, f_write() is limited to the already */
+/* allocated clusters.                                                    */
+/*                                                                        */
+/* f_prealloc() allocates a contiguous cluster block for an empty file    */
+/* and sets the file size. f_stream_*() transfer whole sectors of such a  */
+/* file directly from/to the physical drive, without any FAT or directory */
+/* updates on the way.                                                    */
+/*------------------------------------------------------------------------*/
+
+#ifndef FF_STREAM_DEFINED
+#define FF_STREAM_DEFINED
+
+#include "ff.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if !FF_USE_FASTSEEK || !FF_USE_EXPAND || FF_FS_READONLY
+#error FF_USE_FASTSEEK and FF_USE_EXPAND must be enabled in ffconf.h
+#endif
+
+/* Raw sector stream on a contiguous file */
+
+typedef struct {
+	FIL*	fp;			/* File object (0:stream closed) */
+	LBA_t	sect;		/* First sector of the file on the physical drive */
+	LBA_t	nsect;		/* Number of sectors covered by the file size */
+	LBA_t	pos;		/* Current sector position in the file */
+} FFSTREAM;
+
+
+/* Fast seek */
+
+FRESULT f_fastseek_open (FIL* fp);										/* Build the CLMT and enable fast seek mode */
+void f_fastseek_close (FIL* fp);										/* Release the CLMT and disable fast seek mode */
+
+/* Contiguous allocation */
+
+FRESULT f_prealloc (FIL* fp, FSIZE_t fsz);								/* Allocate a contiguous block to an empty file */
+FRESULT f_is_contiguous (FIL* fp);										/* FR_OK:contiguous, FR_DENIED:fragmented */
+
+/* Raw sector streaming */
+
+FRESULT f_stream_open (FFSTREAM* st, FIL* fp);							/* Open a stream on a contiguous file */
+FRESULT f_stream_close (FFSTREAM* st);									/* Close the stream */
+FRESULT f_stream_seek (FFSTREAM* st, LBA_t pos);						/* Set the sector position */
+FRESULT f_stream_read (FFSTREAM* st, void* buff, UINT count, UINT* br);	/* Read count sectors */
+FRESULT f_stream_write (FFSTREAM* st, const void* buff, UINT count, UINT* bw);	/* Write count sectors */
+FRESULT f_stream_sync (FFSTREAM* st);									/* Flush the write cache of the drive */
+
+#define f_stream_tell(st) ((st)->pos)
+#define f_stream_size(st) ((st)->nsect)
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* FF_STREAM_DEFINED */
@@ -0,0 +1,352 @@
+//
+// fileioqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <fatfs/fileioqueue.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CFileIOQueue::CFileIOQueue (void)
+:	m_pFree (0),
+	m_pQueue (0),
+	m_nPending (0),
+	m_pLastVolume (0),
+	m_ullLastPosition (0),
+	m_IdleEvent (TRUE)
+{
+	for (unsigned i = 0; i < FILE_IO_QUEUE_DEPTH; i++)
+	{
+		m_Request[i].pNext = m_pFree;
+		m_pFree = &m_Request[i];
+	}
+
+	SetName ("fileio");
+}
+
+CFileIOQueue::~CFileIOQueue (void)
+{
+	assert (m_nPending == 0);
+}
+
+void CFileIOQueue::Run (void)
+{
+	while (1)
+	{
+		m_Event.Clear ();
+
+		TRequest *pRequest;
+		while ((pRequest = SelectRequest ()) != 0)
+		{
+			// unlink
+			TRequest **ppPrev = &m_pQueue;
+			while (*ppPrev != pRequest)
+			{
+				assert (*ppPrev != 0);
+				ppPrev = &(*ppPrev)->pNext;
+			}
+			*ppPrev = pRequest->pNext;
+
+			Execute (pRequest);
+
+			// may submit new requests
+			assert (m_nPending > 0);
+			if (--m_nPending == 0)
+			{
+				m_IdleEvent.Set ();
+			}
+		}
+
+		m_Event.Wait ();
+	}
+}
+
+boolean CFileIOQueue::SubmitRead (FIL *pFile, FSIZE_t Offset, void *pBuffer, UINT nCount,
+				  TFileIOCompletionHandler *pHandler, void *pParam)
+{
+	assert (pBuffer != 0);
+
+	return Submit (RequestRead, pFile, Offset, pBuffer, nCount, pHandler, pParam);
+}
+
+boolean CFileIOQueue::SubmitWrite (FIL *pFile, FSIZE_t Offset, const void *pBuffer, UINT nCount,
+				   TFileIOCompletionHandler *pHandler, void *pParam)
+{
+	assert (pBuffer != 0);
+
+	return Submit (RequestWrite, pFile, Offset, (void *) pBuffer, nCount, pHandler, pParam);
+}
+
+boolean CFileIOQueue::SubmitSync (FIL *pFile, TFileIOCompletionHandler *pHandler, void *pParam)
+{
+	return Submit (RequestSync, pFile, 0, 0, 0, pHandler, pParam);
+}
+
+FRESULT CFileIOQueue::Read (FIL *pFile, FSIZE_t Offset, void *pBuffer, UINT nCount, UINT *pRead)
+{
+	TSyncRequest Request;
+	while (!SubmitRead (pFile, Offset, pBuffer, nCount, SyncCompletionHandler, &Request))
+	{
+		m_IdleEvent.Wait ();
+	}
+
+	Request.Event.Wait ();
+
+	if (pRead != 0)
+	{
+		*pRead = Request.nTransferred;
+	}
+
+	return Request.Result;
+}
+
+FRESULT CFileIOQueue::Write (FIL *pFile, FSIZE_t Offset, const void *pBuffer, UINT nCount,
+			     UINT *pWritten)
+{
+	TSyncRequest Request;
+	while (!SubmitWrite (pFile, Offset, pBuffer, nCount, SyncCompletionHandler, &Request))
+	{
+		m_IdleEvent.Wait ();
+	}
+
+	Request.Event.Wait ();
+
+	if (pWritten != 0)
+	{
+		*pWritten = Request.nTransferred;
+	}
+
+	return Request.Result;
+}
+
+void CFileIOQueue::Flush (void)
+{
+	while (m_nPending > 0)
+	{
+		m_IdleEvent.Wait ();
+	}
+}
+
+unsigned CFileIOQueue::GetPending (void) const
+{
+	return m_nPending;
+}
+
+boolean CFileIOQueue::Submit (TRequestType Type, FIL *pFile, FSIZE_t Offset, void *pBuffer,
+			      UINT nCount, TFileIOCompletionHandler *pHandler, void *pParam)
+{
+	assert (pFile != 0);
+	assert (pHandler != 0);
+
+	TRequest *pRequest = m_pFree;
+	if (pRequest == 0)
+	{
+		return FALSE;
+	}
+	m_pFree = pRequest->pNext;
+
+	pRequest->Type = Type;
+	pRequest->pFile = pFile;
+	pRequest->Offset = Offset;
+	pRequest->pBuffer = (u8 *) pBuffer;
+	pRequest->nCount = nCount;
+	pRequest->pHandler = pHandler;
+	pRequest->pParam = pParam;
+	pRequest->ullPosition = GetPosition (pFile, Offset);
+	pRequest->nDeadline = CTimer::GetClockTicks () + FILE_IO_DEADLINE * (CLOCKHZ / 1000);
+	pRequest->pNext = 0;
+
+	// append in submission order
+	TRequest **ppPrev = &m_pQueue;
+	while (*ppPrev != 0)
+	{
+		ppPrev = &(*ppPrev)->pNext;
+	}
+	*ppPrev = pRequest;
+
+	if (m_nPending++ == 0)
+	{
+		m_IdleEvent.Clear ();
+	}
+
+	m_Event.Set ();
+
+	return TRUE;
+}
+
+CFileIOQueue::TRequest *CFileIOQueue::SelectRequest (void)
+{
+	// serve the oldest request with an expired deadline first
+	unsigned nTicks = CTimer::GetClockTicks ();
+	TRequest *pRequest;
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (   (int) (nTicks - pRequest->nDeadline) >= 0
+		    && !IsBlocked (pRequest))
+		{
+			return pRequest;
+		}
+	}
+
+	// otherwise the nearest request in ascending order on the last volume (C-LOOK)
+	TRequest *pNearest = 0;
+	TRequest *pLowest = 0;
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (   pRequest->pFile->obj.fs != m_pLastVolume
+		    || IsBlocked (pRequest))
+		{
+			continue;
+		}
+
+		if (   pRequest->ullPosition >= m_ullLastPosition
+		    && (   pNearest == 0
+			|| pRequest->ullPosition < pNearest->ullPosition))
+		{
+			pNearest = pRequest;
+		}
+
+		if (   pLowest == 0
+		    || pRequest->ullPosition < pLowest->ullPosition)
+		{
+			pLowest = pRequest;
+		}
+	}
+
+	if (pNearest != 0)
+	{
+		return pNearest;
+	}
+
+	if (pLowest != 0)
+	{
+		return pLowest;
+	}
+
+	// no request for the last volume, take the oldest one
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (!IsBlocked (pRequest))
+		{
+			return pRequest;
+		}
+	}
+
+	return 0;
+}
+
+boolean CFileIOQueue::IsBlocked (const TRequest *pRequest) const
+{
+	assert (pRequest != 0);
+
+	// reads of the same file may pass each other, everything else keeps its order
+	for (const TRequest *p = m_pQueue; p != pRequest; p = p->pNext)
+	{
+		assert (p != 0);
+
+		if (   p->pFile == pRequest->pFile
+		    && (   p->Type != RequestRead
+			|| pRequest->Type != RequestRead))
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CFileIOQueue::Execute (TRequest *pRequest)
+{
+	assert (pRequest != 0);
+
+	FIL *pFile = pRequest->pFile;
+	assert (pFile != 0);
+
+	FRESULT Result = FR_OK;
+	UINT nTransferred = 0;
+
+	switch (pRequest->Type)
+	{
+	case RequestRead:
+		Result = f_lseek (pFile, pRequest->Offset);
+		if (Result == FR_OK)
+		{
+			Result = f_read (pFile, pRequest->pBuffer, pRequest->nCount, &nTransferred);
+		}
+		break;
+
+	case RequestWrite:
+		Result = f_lseek (pFile, pRequest->Offset);
+		if (Result == FR_OK)
+		{
+			Result = f_write (pFile, pRequest->pBuffer, pRequest->nCount, &nTransferred);
+		}
+		break;
+
+	case RequestSync:
+		Result = f_sync (pFile);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	m_pLastVolume = pFile->obj.fs;
+	m_ullLastPosition = pRequest->ullPosition + nTransferred / FF_MIN_SS;
+
+	TFileIOCompletionHandler *pHandler = pRequest->pHandler;
+	void *pParam = pRequest->pParam;
+
+	pRequest->pNext = m_pFree;
+	m_pFree = pRequest;
+
+	assert (pHandler != 0);
+	(*pHandler) (Result, nTransferred, pParam);
+}
+
+u64 CFileIOQueue::GetPosition (FIL *pFile, FSIZE_t Offset)
+{
+	assert (pFile != 0);
+
+	// exact for contiguous files, an estimate otherwise
+	const FATFS *pVolume = pFile->obj.fs;
+	if (   pVolume == 0
+	    || pFile->obj.sclust < 2)
+	{
+		return 0;
+	}
+
+#if FF_MAX_SS != FF_MIN_SS
+	unsigned nSectorSize = pVolume->ssize;
+#else
+	unsigned nSectorSize = FF_MAX_SS;
+#endif
+
+	return   pVolume->database + (u64) pVolume->csize * (pFile->obj.sclust - 2)
+	       + Offset / nSectorSize;
+}
+
+void CFileIOQueue::SyncCompletionHandler (FRESULT Result, UINT nTransferred, void *pParam)
+{
+	TSyncRequest *pRequest = (TSyncRequest *) pParam;
+	assert (pRequest != 0);
+
+	pRequest->Result = Result;
+	pRequest->nTransferred = nTransferred;
+	pRequest->Event.Set ();
+}
@@ -0,0 +1,142 @@
+//
+// fileioqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fatfs_fileioqueue_h
+#define _fatfs_fileioqueue_h
+
+#include <fatfs/ff.h>
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/types.h>
+
+#define FILE_IO_QUEUE_DEPTH	32		// max. number of queued requests
+#define FILE_IO_DEADLINE	200		// milliseconds, older requests are served first
+
+/// \param Result FatFs result code of the operation
+/// \param nTransferred Number of bytes read or written
+/// \param pParam User parameter, given to Submit*()
+/// \note Is called from the I/O task and must not block.
+typedef void TFileIOCompletionHandler (FRESULT Result, UINT nTransferred, void *pParam);
+
+class CFileIOQueue : public CTask	/// Asynchronous file I/O over FatFs, runs as a task
+{
+public:
+	CFileIOQueue (void);
+	~CFileIOQueue (void);
+
+	void Run (void);
+
+	/// \brief Queue a read request
+	/// \param pFile Open file object
+	/// \param Offset File offset to read from
+	/// \param pBuffer Buffer, where read data will be placed
+	/// \param nCount Number of bytes to be read
+	/// \param pHandler Will be called, when the request has been completed
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return FALSE, if the queue is full (retry after a completion)
+	/// \note The file object and the buffer must not be accessed, before the request has
+	///	  been completed. Reads of the same file may be reordered.
+	boolean SubmitRead (FIL *pFile, FSIZE_t Offset, void *pBuffer, UINT nCount,
+			    TFileIOCompletionHandler *pHandler, void *pParam = 0);
+
+	/// \brief Queue a write request
+	/// \param pFile Open file object
+	/// \param Offset File offset to write to
+	/// \param pBuffer Buffer, from which data will be fetched for write
+	/// \param nCount Number of bytes to be written
+	/// \param pHandler Will be called, when the request has been completed
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return FALSE, if the queue is full (retry after a completion)
+	/// \note Writes are not reordered with other requests for the same file.
+	boolean SubmitWrite (FIL *pFile, FSIZE_t Offset, const void *pBuffer, UINT nCount,
+			     TFileIOCompletionHandler *pHandler, void *pParam = 0);
+
+	/// \brief Queue f_sync() of a file, after its preceding requests
+	boolean SubmitSync (FIL *pFile, TFileIOCompletionHandler *pHandler, void *pParam = 0);
+
+	/// \brief Read synchronously, ordered with the queued requests of the file
+	/// \return FatFs result code
+	FRESULT Read (FIL *pFile, FSIZE_t Offset, void *pBuffer, UINT nCount, UINT *pRead);
+	/// \brief Write synchronously, ordered with the queued requests of the file
+	/// \return FatFs result code
+	FRESULT Write (FIL *pFile, FSIZE_t Offset, const void *pBuffer, UINT nCount,
+		       UINT *pWritten);
+
+	/// \brief Wait for the completion of all queued requests
+	void Flush (void);
+
+	/// \return Number of requests, which have not been completed yet
+	unsigned GetPending (void) const;
+
+private:
+	enum TRequestType
+	{
+		RequestRead,
+		RequestWrite,
+		RequestSync
+	};
+
+	struct TRequest
+	{
+		TRequestType Type;
+		FIL *pFile;
+		FSIZE_t Offset;
+		u8 *pBuffer;
+		UINT nCount;
+		TFileIOCompletionHandler *pHandler;
+		void *pParam;
+		u64 ullPosition;		// estimated position on the volume
+		unsigned nDeadline;		// in clock ticks
+		TRequest *pNext;		// queue is in submission order
+	};
+
+	boolean Submit (TRequestType Type, FIL *pFile, FSIZE_t Offset, void *pBuffer, UINT nCount,
+			TFileIOCompletionHandler *pHandler, void *pParam);
+
+	TRequest *SelectRequest (void);		// deadline first, nearest position otherwise
+	boolean IsBlocked (const TRequest *pRequest) const;	// by an older request
+
+	void Execute (TRequest *pRequest);
+
+	static u64 GetPosition (FIL *pFile, FSIZE_t Offset);
+
+	struct TSyncRequest
+	{
+		CSynchronizationEvent Event;
+		FRESULT Result;
+		UINT nTransferred;
+	};
+
+	static void SyncCompletionHandler (FRESULT Result, UINT nTransferred, void *pParam);
+
+private:
+	TRequest m_Request[FILE_IO_QUEUE_DEPTH];
+	TRequest *m_pFree;
+	TRequest *m_pQueue;
+
+	unsigned m_nPending;
+
+	const FATFS *m_pLastVolume;
+	u64 m_ullLastPosition;			// end of last request
+
+	CSynchronizationEvent m_Event;		// requests are queued
+	CSynchronizationEvent m_IdleEvent;	// all requests have been completed
+};
+
+#endif
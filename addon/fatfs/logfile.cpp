@@ -0,0 +1,574 @@
+//
+// logfile.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <fatfs/logfile.h>
+#include <circle/new.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CLogFile::CLogFile (void)
+:	m_bOpen (FALSE),
+	m_nSectorSize (FF_MIN_SS),
+	m_nDataStart (0),
+	m_nRingSectors (0),
+	m_ullRingSize (0),
+	m_ullHead (0),
+	m_ullSegment (0),
+	m_ullReadPos (0),
+	m_nSequence (0),
+	m_nSegments (0)
+{
+	m_pSegment = new (HEAP_DMA30) u8[LOG_FILE_SEGMENT_SIZE];
+	assert (m_pSegment != 0);
+
+	m_pSector = new (HEAP_DMA30) u8[FF_MAX_SS];
+	assert (m_pSector != 0);
+
+	m_Stream.fp = 0;
+}
+
+CLogFile::~CLogFile (void)
+{
+	Close ();
+
+	delete [] m_pSector;
+	m_pSector = 0;
+
+	delete [] m_pSegment;
+	m_pSegment = 0;
+}
+
+FRESULT CLogFile::Create (const TCHAR *pPath, u64 ullSize)
+{
+	assert (!m_bOpen);
+	assert (pPath != 0);
+
+	FRESULT Result = f_open (&m_File, pPath, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	Result = f_prealloc (&m_File, ullSize);
+	if (Result == FR_OK)
+	{
+		Result = f_stream_open (&m_Stream, &m_File);
+	}
+
+	if (Result == FR_OK)
+	{
+		Result = Setup ();
+	}
+
+	UINT nWritten;
+	if (Result == FR_OK)
+	{
+		// invalidate the first checkpoint, WriteCheckpoint() uses the second one
+		memset (m_pSector, 0, m_nSectorSize);
+		Result = f_stream_write (&m_Stream, m_pSector, 1, &nWritten);
+	}
+
+	if (Result != FR_OK)
+	{
+		f_stream_close (&m_Stream);
+		f_close (&m_File);
+
+		return Result;
+	}
+
+	m_ullHead = 0;
+	m_ullSegment = 0;
+	m_ullReadPos = 0;
+	m_nSequence = 0;
+	m_nSegments = 0;
+
+	m_bOpen = TRUE;
+
+	Result = WriteCheckpoint ();
+	if (Result != FR_OK)
+	{
+		Close ();
+	}
+
+	return Result;
+}
+
+FRESULT CLogFile::Open (const TCHAR *pPath)
+{
+	assert (!m_bOpen);
+	assert (pPath != 0);
+
+	FRESULT Result = f_open (&m_File, pPath, FA_READ | FA_WRITE | FA_OPEN_EXISTING);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	Result = f_stream_open (&m_Stream, &m_File);
+	if (Result == FR_OK)
+	{
+		Result = Setup ();
+	}
+
+	// continue at the newest valid checkpoint
+	u32 nSequence[2];
+	u64 ullHead[2];
+	boolean bValid[2] = {FALSE, FALSE};
+	if (Result == FR_OK)
+	{
+		bValid[0] = ReadCheckpoint (0, &nSequence[0], &ullHead[0]);
+		bValid[1] = ReadCheckpoint (1, &nSequence[1], &ullHead[1]);
+
+		if (   !bValid[0]
+		    && !bValid[1])
+		{
+			Result = FR_NO_FILESYSTEM;
+		}
+	}
+
+	if (Result != FR_OK)
+	{
+		f_stream_close (&m_Stream);
+		f_close (&m_File);
+
+		return Result;
+	}
+
+	unsigned nIndex =    bValid[0]
+			  && (   !bValid[1]
+			      || (int) (nSequence[0] - nSequence[1]) > 0) ? 0 : 1;
+
+	m_nSequence = nSequence[nIndex];
+	m_ullHead = ullHead[nIndex];
+	m_ullSegment = m_ullHead / LOG_FILE_SEGMENT_SIZE * LOG_FILE_SEGMENT_SIZE;
+	m_nSegments = 0;
+
+	// reload the partial segment, it will be written again completely
+	size_t nFill = (size_t) (m_ullHead - m_ullSegment);
+	if (nFill > 0)
+	{
+		UINT nSectors = (nFill + m_nSectorSize-1) / m_nSectorSize;
+		UINT nRead;
+
+		Result = f_stream_seek (&m_Stream,   m_nDataStart
+						   + (m_ullSegment % m_ullRingSize) / m_nSectorSize);
+		if (Result == FR_OK)
+		{
+			Result = f_stream_read (&m_Stream, m_pSegment, nSectors, &nRead);
+		}
+
+		if (   Result == FR_OK
+		    && nRead != nSectors)
+		{
+			Result = FR_DISK_ERR;
+		}
+
+		if (Result != FR_OK)
+		{
+			f_stream_close (&m_Stream);
+			f_close (&m_File);
+
+			return Result;
+		}
+	}
+
+	m_bOpen = TRUE;
+
+	m_ullReadPos = GetTail ();
+
+	return FR_OK;
+}
+
+FRESULT CLogFile::Close (void)
+{
+	if (!m_bOpen)
+	{
+		return FR_OK;
+	}
+
+	FRESULT Result = IOCtl (DEVICE_IOCTL_SYNC, 0) == 0 ? FR_OK : FR_DISK_ERR;
+
+	f_stream_close (&m_Stream);
+
+	FRESULT CloseResult = f_close (&m_File);
+	if (Result == FR_OK)
+	{
+		Result = CloseResult;
+	}
+
+	m_bOpen = FALSE;
+
+	return Result;
+}
+
+int CLogFile::Write (const void *pBuffer, size_t nCount)
+{
+	if (!m_bOpen)
+	{
+		return -1;
+	}
+
+	const u8 *p = (const u8 *) pBuffer;
+	assert (p != 0 || nCount == 0);
+
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		size_t nFill = (size_t) (m_ullHead - m_ullSegment);
+		assert (nFill < LOG_FILE_SEGMENT_SIZE);
+
+		size_t nChunk = LOG_FILE_SEGMENT_SIZE - nFill;
+		if (nChunk > nRemaining)
+		{
+			nChunk = nRemaining;
+		}
+
+		memcpy (m_pSegment + nFill, p, nChunk);
+
+		p += nChunk;
+		nRemaining -= nChunk;
+		m_ullHead += nChunk;
+
+		if (m_ullHead - m_ullSegment < LOG_FILE_SEGMENT_SIZE)
+		{
+			break;
+		}
+
+		if (WriteSegment (LOG_FILE_SEGMENT_SIZE) != FR_OK)
+		{
+			return -1;
+		}
+
+		m_ullSegment += LOG_FILE_SEGMENT_SIZE;
+
+		if (   ++m_nSegments >= LOG_FILE_CHECKPOINT
+		    && WriteCheckpoint () != FR_OK)
+		{
+			return -1;
+		}
+	}
+
+	return (int) nCount;
+}
+
+int CLogFile::Read (void *pBuffer, size_t nCount)
+{
+	if (!m_bOpen)
+	{
+		return -1;
+	}
+
+	u64 ullTail = GetTail ();
+	if (m_ullReadPos < ullTail)
+	{
+		m_ullReadPos = ullTail;		// has been overwritten
+	}
+
+	if (nCount > m_ullHead - m_ullReadPos)
+	{
+		nCount = (size_t) (m_ullHead - m_ullReadPos);
+	}
+
+	u8 *p = (u8 *) pBuffer;
+	assert (p != 0 || nCount == 0);
+
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		size_t nChunk;
+
+		if (m_ullReadPos >= m_ullSegment)
+		{
+			// from the current segment
+			nChunk = nRemaining;
+			memcpy (p, m_pSegment + (size_t) (m_ullReadPos - m_ullSegment), nChunk);
+		}
+		else
+		{
+			u64 ullRingPos = m_ullReadPos % m_ullRingSize;
+			LBA_t nSector = m_nDataStart + (LBA_t) (ullRingPos / m_nSectorSize);
+			size_t nOffset = (size_t) (ullRingPos % m_nSectorSize);
+
+			u64 ullMax = m_ullSegment - m_ullReadPos;
+			if (ullMax > m_ullRingSize - ullRingPos)
+			{
+				ullMax = m_ullRingSize - ullRingPos;	// wrap around
+			}
+
+			nChunk = ullMax < nRemaining ? (size_t) ullMax : nRemaining;
+
+			if (f_stream_seek (&m_Stream, nSector) != FR_OK)
+			{
+				return -1;
+			}
+
+			UINT nRead;
+			if (   nOffset == 0
+			    && nChunk >= m_nSectorSize)
+			{
+				// whole sectors directly to the caller
+				UINT nSectors = nChunk / m_nSectorSize;
+				if (   f_stream_read (&m_Stream, p, nSectors, &nRead) != FR_OK
+				    || nRead != nSectors)
+				{
+					return -1;
+				}
+
+				nChunk = nSectors * m_nSectorSize;
+			}
+			else
+			{
+				if (   f_stream_read (&m_Stream, m_pSector, 1, &nRead) != FR_OK
+				    || nRead != 1)
+				{
+					return -1;
+				}
+
+				if (nChunk > m_nSectorSize - nOffset)
+				{
+					nChunk = m_nSectorSize - nOffset;
+				}
+
+				memcpy (p, m_pSector + nOffset, nChunk);
+			}
+		}
+
+		p += nChunk;
+		nRemaining -= nChunk;
+		m_ullReadPos += nChunk;
+	}
+
+	return (int) nCount;
+}
+
+u64 CLogFile::Seek (u64 ullOffset)
+{
+	if (ullOffset > m_ullHead)
+	{
+		ullOffset = m_ullHead;
+	}
+
+	u64 ullTail = GetTail ();
+	if (ullOffset < ullTail)
+	{
+		ullOffset = ullTail;
+	}
+
+	m_ullReadPos = ullOffset;
+
+	return m_ullReadPos;
+}
+
+u64 CLogFile::GetSize (void) const
+{
+	return m_ullHead;
+}
+
+u64 CLogFile::GetTail (void) const
+{
+	// the slot of the current segment is overwritten first
+	u64 ullEnd = m_ullSegment + LOG_FILE_SEGMENT_SIZE;
+
+	return ullEnd > m_ullRingSize ? ullEnd - m_ullRingSize : 0;
+}
+
+int CLogFile::IOCtl (unsigned long ulCmd, void *pData)
+{
+	switch (ulCmd)
+	{
+	case DEVICE_IOCTL_SYNC: {
+		if (!m_bOpen)
+		{
+			return -1;
+		}
+
+		size_t nFill = (size_t) (m_ullHead - m_ullSegment);
+		if (   nFill > 0
+		    && WriteSegment (nFill) != FR_OK)
+		{
+			return -1;
+		}
+
+		return WriteCheckpoint () == FR_OK ? 0 : -1;
+		}
+
+	default:
+		return -1;
+	}
+}
+
+FRESULT CLogFile::Setup (void)
+{
+	FATFS *pVolume = m_File.obj.fs;
+	assert (pVolume != 0);
+
+#if FF_MAX_SS != FF_MIN_SS
+	m_nSectorSize = pVolume->ssize;
+#else
+	m_nSectorSize = FF_MAX_SS;
+#endif
+	if (LOG_FILE_SEGMENT_SIZE % m_nSectorSize != 0)
+	{
+		return FR_INVALID_PARAMETER;
+	}
+
+	// align the ring to erase blocks on the drive, behind the checkpoint sectors
+	LBA_t nAlign = LOG_FILE_ALIGNMENT / m_nSectorSize;
+	LBA_t nFirst = m_Stream.sect + 2;
+	LBA_t nStart = (nFirst + nAlign-1) / nAlign * nAlign;
+
+	LBA_t nDataStart = nStart - m_Stream.sect;
+	if (nDataStart >= f_stream_size (&m_Stream))
+	{
+		return FR_INVALID_PARAMETER;
+	}
+
+	u64 ullRingSize = (u64) (f_stream_size (&m_Stream) - nDataStart) * m_nSectorSize;
+	ullRingSize = ullRingSize / LOG_FILE_SEGMENT_SIZE * LOG_FILE_SEGMENT_SIZE;
+	if (ullRingSize == 0)
+	{
+		return FR_INVALID_PARAMETER;		// file too small
+	}
+
+	m_nDataStart = (u32) nDataStart;
+	m_ullRingSize = ullRingSize;
+	m_nRingSectors = (u32) (ullRingSize / m_nSectorSize);
+
+	return FR_OK;
+}
+
+FRESULT CLogFile::WriteSegment (size_t nLength)
+{
+	assert (m_bOpen);
+	assert (0 < nLength && nLength <= LOG_FILE_SEGMENT_SIZE);
+
+	UINT nSectors = (nLength + m_nSectorSize-1) / m_nSectorSize;
+	memset (m_pSegment + nLength, 0, nSectors * m_nSectorSize - nLength);
+
+	FRESULT Result = f_stream_seek (&m_Stream,   m_nDataStart
+						   + (m_ullSegment % m_ullRingSize) / m_nSectorSize);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	UINT nWritten;
+	Result = f_stream_write (&m_Stream, m_pSegment, nSectors, &nWritten);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	return nWritten == nSectors ? FR_OK : FR_DISK_ERR;
+}
+
+FRESULT CLogFile::WriteCheckpoint (void)
+{
+	assert (m_bOpen);
+
+	// the data must be on the medium before the checkpoint refers to it
+	FRESULT Result = f_stream_sync (&m_Stream);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	u32 nSequence = m_nSequence + 1;
+
+	memset (m_pSector, 0, m_nSectorSize);
+	TCheckpoint *pCheckpoint = (TCheckpoint *) m_pSector;
+	pCheckpoint->nMagic = LOG_FILE_MAGIC;
+	pCheckpoint->nSequence = nSequence;
+	pCheckpoint->ullHead = m_ullHead;
+	pCheckpoint->nDataStart = m_nDataStart;
+	pCheckpoint->nRingSectors = m_nRingSectors;
+	pCheckpoint->nChecksum = GetChecksum (pCheckpoint);
+
+	// alternate between the two checkpoint sectors
+	Result = f_stream_seek (&m_Stream, nSequence & 1);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	UINT nWritten;
+	Result = f_stream_write (&m_Stream, m_pSector, 1, &nWritten);
+	if (Result == FR_OK)
+	{
+		Result = f_stream_sync (&m_Stream);
+	}
+
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	if (nWritten != 1)
+	{
+		return FR_DISK_ERR;
+	}
+
+	m_nSequence = nSequence;
+	m_nSegments = 0;
+
+	return FR_OK;
+}
+
+boolean CLogFile::ReadCheckpoint (unsigned nIndex, u32 *pSequence, u64 *pHead)
+{
+	assert (nIndex < 2);
+	assert (pSequence != 0);
+	assert (pHead != 0);
+
+	UINT nRead;
+	if (   f_stream_seek (&m_Stream, nIndex) != FR_OK
+	    || f_stream_read (&m_Stream, m_pSector, 1, &nRead) != FR_OK
+	    || nRead != 1)
+	{
+		return FALSE;
+	}
+
+	const TCheckpoint *pCheckpoint = (const TCheckpoint *) m_pSector;
+	if (   pCheckpoint->nMagic != LOG_FILE_MAGIC
+	    || pCheckpoint->nChecksum != GetChecksum (pCheckpoint)
+	    || pCheckpoint->nDataStart != m_nDataStart
+	    || pCheckpoint->nRingSectors != m_nRingSectors)
+	{
+		return FALSE;
+	}
+
+	*pSequence = pCheckpoint->nSequence;
+	*pHead = pCheckpoint->ullHead;
+
+	return TRUE;
+}
+
+u32 CLogFile::GetChecksum (const TCheckpoint *pCheckpoint)
+{
+	assert (pCheckpoint != 0);
+
+	const u8 *p = (const u8 *) pCheckpoint;
+	u32 nSum = 0;
+	for (unsigned i = 0; i < sizeof *pCheckpoint - sizeof (u32); i++)
+	{
+		nSum = (nSum << 1 | nSum >> 31) + p[i];
+	}
+
+	return ~nSum;
+}
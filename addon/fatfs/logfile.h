@@ -0,0 +1,117 @@
+//
+// logfile.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fatfs_logfile_h
+#define _fatfs_logfile_h
+
+#include <fatfs/ff.h>
+#include <fatfs/ffstream.h>
+#include <circle/device.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define LOG_FILE_SEGMENT_SIZE	0x10000		// bytes written at once, multiple of sector size
+#define LOG_FILE_ALIGNMENT	0x400000	// erase block size, the ring is aligned to
+#define LOG_FILE_CHECKPOINT	16		// segments between two checkpoints
+
+/// \note Only the two checkpoint sectors at the start of the file and the data ring are
+///	  written. The FAT and the directory entry remain unchanged after Create().
+/// \note Data, which has not been covered by a checkpoint, is lost on power failure.
+
+class CLogFile : public CDevice	/// Preallocated ring file for high-rate sequential logging
+{
+public:
+	CLogFile (void);
+	~CLogFile (void);
+
+	/// \brief Create a new, empty log file with contiguous allocation
+	/// \param pPath Path of the file (an existing file will be overwritten)
+	/// \param ullSize File size in bytes (is reduced to full segments in the aligned ring)
+	/// \return FatFs result code
+	FRESULT Create (const TCHAR *pPath, u64 ullSize);
+	/// \brief Open an existing log file and continue at the last checkpoint
+	/// \return FatFs result code
+	FRESULT Open (const TCHAR *pPath);
+	/// \brief Write pending data, a checkpoint and close the file
+	/// \return FatFs result code
+	FRESULT Close (void);
+
+	/// \brief Append data to the log
+	/// \return Number of written bytes or < 0 on failure
+	int Write (const void *pBuffer, size_t nCount) override;
+
+	/// \brief Read data from the current read position
+	/// \return Number of read bytes (0 at end of log) or < 0 on failure
+	int Read (void *pBuffer, size_t nCount) override;
+
+	/// \brief Set the read position
+	/// \param ullOffset Log offset (number of bytes written since Create() before)
+	/// \return The resulting offset, is >= GetTail()
+	u64 Seek (u64 ullOffset) override;
+
+	/// \return Log offset after the last written byte
+	u64 GetSize (void) const override;
+	/// \return Log offset of the oldest byte, which has not been overwritten yet
+	u64 GetTail (void) const;
+
+	/// \note DEVICE_IOCTL_SYNC writes pending data and a checkpoint
+	int IOCtl (unsigned long ulCmd, void *pData) override;
+
+private:
+	struct TCheckpoint
+	{
+		u32	nMagic;
+#define LOG_FILE_MAGIC		0x4743464C	// "LFCG"
+		u32	nSequence;
+		u64	ullHead;		// log offset
+		u32	nDataStart;		// in sectors from start of file
+		u32	nRingSectors;
+		u32	nChecksum;
+	}
+	PACKED;
+
+	FRESULT Setup (void);		// geometry of the data ring
+
+	FRESULT WriteSegment (size_t nLength);
+	FRESULT WriteCheckpoint (void);
+	boolean ReadCheckpoint (unsigned nIndex, u32 *pSequence, u64 *pHead);
+
+	static u32 GetChecksum (const TCheckpoint *pCheckpoint);
+
+private:
+	FIL m_File;
+	FFSTREAM m_Stream;
+	boolean m_bOpen;
+
+	unsigned m_nSectorSize;
+	u32 m_nDataStart;			// first sector of the ring, in file sectors
+	u32 m_nRingSectors;
+	u64 m_ullRingSize;			// in bytes
+
+	u64 m_ullHead;				// log offset after last byte
+	u64 m_ullSegment;			// log offset of the current segment
+	u64 m_ullReadPos;
+	u32 m_nSequence;			// of the last checkpoint
+	unsigned m_nSegments;			// since the last checkpoint
+
+	u8 *m_pSegment;				// current segment, is filled up to m_ullHead
+	u8 *m_pSector;				// for checkpoints and unaligned reads
+};
+
+#endif
@@ -0,0 +1,305 @@
+//
+// mappedfile.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <fatfs/mappedfile.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define MAX_CHUNKS_PER_LOAD	1024		// keeps the byte count in range of UINT
+
+CMappedFile::CMappedFile (int nHeap)
+:	m_nHeap (nHeap),
+	m_bOpen (FALSE),
+	m_bStream (FALSE),
+	m_Size (0),
+	m_pData (0),
+	m_nChunks (0),
+	m_pLoadedMap (0),
+	m_nChunksLoaded (0)
+{
+}
+
+CMappedFile::~CMappedFile (void)
+{
+	Close ();
+}
+
+FRESULT CMappedFile::Open (const TCHAR *pPath)
+{
+	assert (!m_bOpen);
+	assert (pPath != 0);
+
+	FRESULT Result = f_open (&m_File, pPath, FA_READ | FA_OPEN_EXISTING);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	m_Size = f_size (&m_File);
+	if ((size_t) m_Size != m_Size)
+	{
+		f_close (&m_File);
+
+		return FR_NOT_ENOUGH_CORE;
+	}
+
+	m_nChunks = (unsigned) ((m_Size + MAPPED_FILE_CHUNK_SIZE-1) / MAPPED_FILE_CHUNK_SIZE);
+
+	m_pData = new (m_nHeap) u8[m_Size > 0 ? (size_t) m_Size : 1];
+	m_pLoadedMap = new u32[(m_nChunks + 31) / 32 + 1];
+	if (   m_pData == 0
+	    || m_pLoadedMap == 0)
+	{
+		delete [] m_pData;
+		m_pData = 0;
+		delete [] m_pLoadedMap;
+		m_pLoadedMap = 0;
+
+		f_close (&m_File);
+
+		return FR_NOT_ENOUGH_CORE;
+	}
+
+	memset (m_pLoadedMap, 0, ((m_nChunks + 31) / 32 + 1) * sizeof (u32));
+	m_nChunksLoaded = 0;
+
+	// contiguous files bypass FatFs, fragmented files are read with fast seek
+	m_bStream = f_stream_open (&m_Stream, &m_File) == FR_OK;
+	if (!m_bStream)
+	{
+		f_fastseek_open (&m_File);	// optional
+	}
+
+	m_bOpen = TRUE;
+
+	return FR_OK;
+}
+
+void CMappedFile::Close (void)
+{
+	if (!m_bOpen)
+	{
+		return;
+	}
+
+	if (m_bStream)
+	{
+		f_stream_close (&m_Stream);
+		m_bStream = FALSE;
+	}
+
+	f_fastseek_close (&m_File);
+	f_close (&m_File);
+
+	delete [] m_pData;
+	m_pData = 0;
+
+	delete [] m_pLoadedMap;
+	m_pLoadedMap = 0;
+
+	m_nChunks = 0;
+	m_nChunksLoaded = 0;
+	m_Size = 0;
+
+	m_bOpen = FALSE;
+}
+
+FRESULT CMappedFile::Preload (void)
+{
+	if (!m_bOpen)
+	{
+		return FR_INVALID_OBJECT;
+	}
+
+	return Map () != 0 ? FR_OK : FR_DISK_ERR;
+}
+
+const void *CMappedFile::Map (FSIZE_t Offset, size_t nLength)
+{
+	if (   !m_bOpen
+	    || Offset > m_Size)
+	{
+		return 0;
+	}
+
+	if (nLength == 0)
+	{
+		nLength = (size_t) (m_Size - Offset);
+	}
+	else if (nLength > m_Size - Offset)
+	{
+		return 0;
+	}
+
+	if (nLength > 0)
+	{
+		unsigned nFirst = (unsigned) (Offset / MAPPED_FILE_CHUNK_SIZE);
+		unsigned nLast = (unsigned) ((Offset + nLength - 1) / MAPPED_FILE_CHUNK_SIZE);
+		assert (nLast < m_nChunks);
+
+		// load each run of missing chunks with one transfer
+		for (unsigned nChunk = nFirst; nChunk <= nLast; nChunk++)
+		{
+			if (IsLoaded (nChunk))
+			{
+				continue;
+			}
+
+			unsigned nChunks = 1;
+			while (   nChunk + nChunks <= nLast
+			       && nChunks < MAX_CHUNKS_PER_LOAD
+			       && !IsLoaded (nChunk + nChunks))
+			{
+				nChunks++;
+			}
+
+			if (Load (nChunk, nChunks) != FR_OK)
+			{
+				return 0;
+			}
+
+			nChunk += nChunks - 1;
+		}
+	}
+
+	return m_pData + (size_t) Offset;
+}
+
+FSIZE_t CMappedFile::GetSize (void) const
+{
+	return m_Size;
+}
+
+size_t CMappedFile::GetLoaded (void) const
+{
+	size_t nLoaded = (size_t) m_nChunksLoaded * MAPPED_FILE_CHUNK_SIZE;
+
+	return nLoaded < m_Size ? nLoaded : (size_t) m_Size;
+}
+
+boolean CMappedFile::IsContiguous (void) const
+{
+	return m_bStream;
+}
+
+FRESULT CMappedFile::Load (unsigned nChunk, unsigned nChunks)
+{
+	assert (m_bOpen);
+	assert (nChunks > 0);
+	assert (nChunk + nChunks <= m_nChunks);
+
+	FSIZE_t Offset = (FSIZE_t) nChunk * MAPPED_FILE_CHUNK_SIZE;
+	FSIZE_t End = Offset + (FSIZE_t) nChunks * MAPPED_FILE_CHUNK_SIZE;
+	if (End > m_Size)
+	{
+		End = m_Size;
+	}
+
+	FRESULT Result;
+
+	if (m_bStream)
+	{
+		// whole sectors directly from the device
+		FATFS *pVolume = m_File.obj.fs;
+		assert (pVolume != 0);
+#if FF_MAX_SS != FF_MIN_SS
+		UINT nSectorSize = pVolume->ssize;
+#else
+		UINT nSectorSize = FF_MAX_SS;
+#endif
+
+		FSIZE_t StreamEnd = (FSIZE_t) f_stream_size (&m_Stream) * nSectorSize;
+		if (Offset < StreamEnd)
+		{
+			UINT nSectors = (UINT) (((End < StreamEnd ? End : StreamEnd) - Offset)
+						/ nSectorSize);
+
+			Result = f_stream_seek (&m_Stream, (LBA_t) (Offset / nSectorSize));
+			if (Result != FR_OK)
+			{
+				return Result;
+			}
+
+			UINT nRead;
+			Result = f_stream_read (&m_Stream, m_pData + (size_t) Offset, nSectors, &nRead);
+			if (Result != FR_OK)
+			{
+				return Result;
+			}
+
+			if (nRead != nSectors)
+			{
+				return FR_DISK_ERR;
+			}
+
+			Offset += (FSIZE_t) nSectors * nSectorSize;
+		}
+	}
+
+	// the partial last sector or a fragmented file
+	if (Offset < End)
+	{
+		Result = f_lseek (&m_File, Offset);
+		if (Result != FR_OK)
+		{
+			return Result;
+		}
+
+		UINT nCount = (UINT) (End - Offset);
+		UINT nRead;
+		Result = f_read (&m_File, m_pData + (size_t) Offset, nCount, &nRead);
+		if (Result != FR_OK)
+		{
+			return Result;
+		}
+
+		if (nRead != nCount)
+		{
+			return FR_DISK_ERR;
+		}
+	}
+
+	for (unsigned i = 0; i < nChunks; i++)
+	{
+		SetLoaded (nChunk + i);
+	}
+
+	return FR_OK;
+}
+
+boolean CMappedFile::IsLoaded (unsigned nChunk) const
+{
+	assert (nChunk < m_nChunks);
+	assert (m_pLoadedMap != 0);
+
+	return m_pLoadedMap[nChunk / 32] & (1U << (nChunk % 32)) ? TRUE : FALSE;
+}
+
+void CMappedFile::SetLoaded (unsigned nChunk)
+{
+	assert (nChunk < m_nChunks);
+	assert (m_pLoadedMap != 0);
+
+	if (!IsLoaded (nChunk))
+	{
+		m_pLoadedMap[nChunk / 32] |= 1U << (nChunk % 32);
+
+		m_nChunksLoaded++;
+	}
+}
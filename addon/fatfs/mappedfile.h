@@ -0,0 +1,88 @@
+//
+// mappedfile.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fatfs_mappedfile_h
+#define _fatfs_mappedfile_h
+
+#include <fatfs/ff.h>
+#include <fatfs/ffstream.h>
+#include <circle/new.h>
+#include <circle/types.h>
+
+#define MAPPED_FILE_CHUNK_SIZE	0x10000		// granularity of on-demand loading
+
+class CMappedFile	/// Read-only file contents in memory, loaded on demand
+{
+public:
+	/// \param nHeap Heap, from which the memory is allocated (HEAP_ANY, HEAP_DMA30 etc.)
+	CMappedFile (int nHeap = HEAP_DMA30);
+	~CMappedFile (void);
+
+	/// \brief Open a file and reserve memory for its contents, which is not loaded yet
+	/// \param pPath Path of the file (e.g. "SD:/fonts/font.bin")
+	/// \return FatFs result code
+	/// \note Contiguous files are read as raw sectors from the device directly to memory.
+	FRESULT Open (const TCHAR *pPath);
+	/// \brief Release the memory and close the file
+	void Close (void);
+
+	/// \brief Load all parts of the file, which have not been loaded yet
+	/// \return FatFs result code
+	FRESULT Preload (void);
+
+	/// \brief Get the memory of a file region, load it, if necessary
+	/// \param Offset File offset of the region
+	/// \param nLength Length of the region in bytes (0 to end of file)
+	/// \return Pointer to the file contents at Offset (0 on error)
+	/// \note The pointer is valid until Close() and points into one block of memory,
+	///	  which holds the whole file. Its contents must not be modified.
+	const void *Map (FSIZE_t Offset = 0, size_t nLength = 0);
+
+	/// \return Size of the file in bytes
+	FSIZE_t GetSize (void) const;
+	/// \return Number of bytes, which have been loaded into memory
+	size_t GetLoaded (void) const;
+
+	/// \return Is the file read as raw sectors?
+	boolean IsContiguous (void) const;
+
+private:
+	FRESULT Load (unsigned nChunk, unsigned nChunks);
+
+	boolean IsLoaded (unsigned nChunk) const;
+	void SetLoaded (unsigned nChunk);
+
+private:
+	int m_nHeap;
+
+	FIL m_File;
+	boolean m_bOpen;
+
+	FFSTREAM m_Stream;
+	boolean m_bStream;
+
+	FSIZE_t m_Size;
+	u8 *m_pData;
+
+	unsigned m_nChunks;
+	u32 *m_pLoadedMap;			// one bit per chunk
+	unsigned m_nChunksLoaded;
+};
+
+#endif
@@ -0,0 +1,700 @@
+//
+// soundcapture.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <fatfs/soundcapture.h>
+#include <circle/sched/scheduler.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define SOUND_CAPTURE_MAGIC_DATA	0x61746164	// "data"
+
+// KSDATAFORMAT_SUBTYPE_PCM
+static const u8 SubFormatPCM[16] =
+	{0x01, 0x00, 0x00, 0x00, 0x00, 0x00, 0x10, 0x00,
+	 0x80, 0x00, 0x00, 0xAA, 0x00, 0x38, 0x9B, 0x71};
+
+CSoundCapture::CSoundCapture (void)
+:	m_pDevice (0),
+	m_nDeviceOverrunBase (0),
+	m_Format (SoundFormatUnknown),
+	m_nChannels (0),
+	m_nSampleRate (0),
+	m_nInSampleSize (0),
+	m_nOutSampleSize (0),
+	m_pRing (0),
+	m_nRingSize (0),
+	m_nInPtr (0),
+	m_nOutPtr (0),
+	m_nOverrunFrames (0),
+	m_nOverrunBase (0),
+	m_nMaxRingLevel (0),
+	m_State (StateIdle),
+	m_Result (FR_OK),
+	m_nFileNumber (0),
+	m_ullFileCapacity (0),
+	m_ullTotalBytes (0),
+	m_bFileOpen (FALSE),
+	m_nSectorSize (FF_MIN_SS),
+	m_ullFileData (0),
+	m_nSegmentFill (0),
+	m_nSegmentLimit (0)
+{
+	// room for the padding of a sample, which crosses the segment limit
+	m_pSegment = new (HEAP_DMA30) u8[SOUND_CAPTURE_SEGMENT_SIZE + sizeof (u32)];
+	assert (m_pSegment != 0);
+
+	m_Stream.fp = 0;
+
+	SetName ("soundcapture");
+}
+
+CSoundCapture::~CSoundCapture (void)
+{
+	assert (!m_bFileOpen);
+
+	delete [] m_pSegment;
+	m_pSegment = 0;
+
+	delete [] m_pRing;
+	m_pRing = 0;
+}
+
+boolean CSoundCapture::Initialize (TSoundFormat Format, unsigned nChannels, unsigned nSampleRate,
+				   unsigned nRingMsecs)
+{
+	assert (m_pRing == 0);
+	assert (1 <= nChannels && nChannels <= SOUND_MAX_CHANNELS);
+	assert (nSampleRate > 0);
+	assert (nRingMsecs > 0);
+
+	switch (Format)
+	{
+	case SoundFormatUnsigned8:	m_nInSampleSize = 1;	break;
+	case SoundFormatSigned16:	m_nInSampleSize = 2;	break;
+	case SoundFormatSigned24:	m_nInSampleSize = 3;	break;
+	case SoundFormatSigned24_32:	m_nInSampleSize = 4;	break;
+
+	default:
+		return FALSE;
+	}
+
+	m_Format = Format;
+	m_nChannels = nChannels;
+	m_nSampleRate = nSampleRate;
+	m_nOutSampleSize = m_nInSampleSize;		// only the alignment is changed
+
+	// 1 frame remains free, so that the ring pointers are always frame aligned
+	unsigned nFrameSize = m_nChannels * m_nInSampleSize;
+	u64 ullFrames = (u64) m_nSampleRate * nRingMsecs / 1000;
+	m_nRingSize = (unsigned) ((ullFrames + 1) * nFrameSize);
+
+	m_pRing = new u8[m_nRingSize];
+	if (m_pRing == 0)
+	{
+		return FALSE;
+	}
+
+	m_nInPtr = 0;
+	m_nOutPtr = 0;
+
+	return TRUE;
+}
+
+boolean CSoundCapture::Initialize (CSoundBaseDevice *pDevice, unsigned nSampleRate,
+				   unsigned nRingMsecs)
+{
+	assert (pDevice != 0);
+	assert (m_pDevice == 0);
+
+	if (   !Initialize (pDevice->GetHWFormat (), pDevice->GetHWRXChannels (), nSampleRate,
+			    nRingMsecs)
+	    || !pDevice->AllocateReadQueue (SOUND_CAPTURE_DEVICE_MSECS))
+	{
+		return FALSE;
+	}
+
+	m_pDevice = pDevice;
+	m_nDeviceOverrunBase = m_pDevice->GetReadOverrunFrames ();
+
+	// is called, when the read queue is half full
+	m_pDevice->RegisterHaveDataCallback (HaveDataCallback, this);
+
+	return TRUE;
+}
+
+int CSoundCapture::Write (const void *pBuffer, size_t nCount)
+{
+	const u8 *pBuffer8 = static_cast<const u8 *> (pBuffer);
+	assert (pBuffer8 != 0);
+	assert (m_pRing != 0);
+
+	unsigned nFrameSize = m_nChannels * m_nInSampleSize;
+	assert (nCount % nFrameSize == 0);
+
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	unsigned nFree =   nOutPtr > nInPtr
+			 ? nOutPtr - nInPtr - nFrameSize
+			 : m_nRingSize - nInPtr + nOutPtr - nFrameSize;
+
+	unsigned nBytes = nCount < nFree ? nCount : nFree;
+	if (nBytes > 0)
+	{
+		// copy in up to two parts, if the ring wraps around
+		unsigned nFirst = m_nRingSize - nInPtr;
+		if (nFirst > nBytes)
+		{
+			nFirst = nBytes;
+		}
+
+		memcpy (m_pRing + nInPtr, pBuffer8, nFirst);
+		memcpy (m_pRing, pBuffer8 + nFirst, nBytes - nFirst);
+
+		nInPtr += nBytes;
+		if (nInPtr >= m_nRingSize)
+		{
+			nInPtr -= m_nRingSize;
+		}
+
+		// the data must be written, before the consumer sees the new pointer
+		DataMemBarrier ();
+
+		m_nInPtr = nInPtr;
+	}
+
+	if (nBytes < nCount)
+	{
+		m_nOverrunFrames += (nCount - nBytes) / nFrameSize;
+	}
+
+	return nBytes;
+}
+
+boolean CSoundCapture::StartRecording (const char *pPathPattern, unsigned nSecondsPerFile)
+{
+	assert (pPathPattern != 0);
+	assert (nSecondsPerFile > 0);
+	assert (m_pRing != 0);
+
+	if (   m_State != StateIdle
+	    && m_State != StateError)
+	{
+		return FALSE;
+	}
+
+	unsigned nFrameSize = m_nChannels * m_nOutSampleSize;
+	m_ullFileCapacity = (u64) nSecondsPerFile * m_nSampleRate * nFrameSize;
+	if (m_ullFileCapacity > SOUND_CAPTURE_MAX_DATA)
+	{
+		m_ullFileCapacity = SOUND_CAPTURE_MAX_DATA / nFrameSize * nFrameSize;
+	}
+
+	m_PathPattern = pPathPattern;
+	m_nFileNumber = 0;
+	m_ullTotalBytes = 0;
+
+	m_nSegmentFill = 0;
+	m_nSegmentLimit =   m_ullFileCapacity < SOUND_CAPTURE_SEGMENT_SIZE
+			  ? (unsigned) m_ullFileCapacity : SOUND_CAPTURE_SEGMENT_SIZE;
+
+	m_nOverrunBase = m_nOverrunFrames;
+	if (m_pDevice != 0)
+	{
+		m_nDeviceOverrunBase = m_pDevice->GetReadOverrunFrames ();
+	}
+
+	m_nMaxRingLevel = 0;
+	m_Result = FR_OK;
+
+	// the task opens the first file
+	m_Event.Clear ();
+	m_State = StateStarting;
+	m_Event.Wait ();
+
+	return m_State == StateRecording;
+}
+
+boolean CSoundCapture::StopRecording (void)
+{
+	if (m_State != StateRecording)
+	{
+		return FALSE;
+	}
+
+	m_Event.Clear ();
+	m_State = StateStopping;
+	m_Event.Wait ();
+
+	return m_State == StateIdle;
+}
+
+boolean CSoundCapture::IsRecording (void) const
+{
+	return    m_State == StateRecording
+	       || m_State == StateStopping;
+}
+
+FRESULT CSoundCapture::GetResult (void) const
+{
+	return m_Result;
+}
+
+u64 CSoundCapture::GetFramesRecorded (void) const
+{
+	if (m_nChannels == 0)
+	{
+		return 0;
+	}
+
+	return m_ullTotalBytes / (m_nChannels * m_nOutSampleSize);
+}
+
+unsigned CSoundCapture::GetOverrunFrames (void) const
+{
+	unsigned nFrames = m_nOverrunFrames - m_nOverrunBase;
+
+	if (m_pDevice != 0)
+	{
+		nFrames += m_pDevice->GetReadOverrunFrames () - m_nDeviceOverrunBase;
+	}
+
+	return nFrames;
+}
+
+unsigned CSoundCapture::GetMaxRingLevel (void) const
+{
+	return m_nMaxRingLevel;
+}
+
+void CSoundCapture::Run (void)
+{
+	while (1)
+	{
+		switch (m_State)
+		{
+		case StateStarting:
+			m_Result = OpenFile ();
+			m_State = m_Result == FR_OK ? StateRecording : StateError;
+			m_Event.Set ();
+			break;
+
+		case StateRecording:
+		case StateStopping: {
+			unsigned nLevel = (unsigned) ((u64) GetBytesAvail () * 100 / m_nRingSize);
+			if (nLevel > m_nMaxRingLevel)
+			{
+				m_nMaxRingLevel = nLevel;
+			}
+
+			FRESULT Result = Process ();
+
+			if (   Result == FR_OK
+			    && m_State == StateStopping)
+			{
+				if (m_nSegmentFill > 0)
+				{
+					Result = WriteSegment ();
+				}
+
+				if (Result == FR_OK)
+				{
+					Result = CloseFile ();
+				}
+
+				if (Result == FR_OK)
+				{
+					m_State = StateIdle;
+					m_Event.Set ();
+
+					break;
+				}
+			}
+
+			if (Result != FR_OK)
+			{
+				m_Result = Result;
+
+				if (m_bFileOpen)
+				{
+					CloseFile ();
+				}
+
+				TState PrevState = m_State;
+				m_State = StateError;
+
+				if (PrevState == StateStopping)
+				{
+					m_Event.Set ();
+				}
+			}
+			} break;
+
+		default:
+			// not recording, discard the data
+			if (m_pRing != 0)
+			{
+				m_nOutPtr = m_nInPtr;
+			}
+			break;
+		}
+
+		if (m_State != StateStarting)
+		{
+			CScheduler::Get ()->MsSleep (SOUND_CAPTURE_POLL_MS);
+		}
+	}
+}
+
+unsigned CSoundCapture::GetBytesAvail (void) const
+{
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	if (nInPtr < nOutPtr)
+	{
+		return m_nRingSize + nInPtr - nOutPtr;
+	}
+
+	return nInPtr - nOutPtr;
+}
+
+void CSoundCapture::FetchFromDevice (void)
+{
+	assert (m_pDevice != 0);
+
+	unsigned nFrameSize = m_nChannels * m_nInSampleSize;
+
+	const void *pBuffer;
+	unsigned nFrames;
+	while ((nFrames = m_pDevice->AcquireReadRegion (&pBuffer)) > 0)
+	{
+		// frames, which do not fit, are counted by Write()
+		Write (pBuffer, nFrames * nFrameSize);
+
+		m_pDevice->ReleaseReadRegion (nFrames);
+	}
+}
+
+void CSoundCapture::HaveDataCallback (void *pParam)
+{
+	CSoundCapture *pThis = static_cast<CSoundCapture *> (pParam);
+	assert (pThis != 0);
+
+	pThis->FetchFromDevice ();
+}
+
+FRESULT CSoundCapture::Process (void)
+{
+	unsigned nAvail;
+	while ((nAvail = GetBytesAvail ()) > 0)
+	{
+		// the producer must have written the data, before it is read
+		DataMemBarrier ();
+
+		unsigned nOutPtr = m_nOutPtr;
+		if (nAvail > m_nRingSize - nOutPtr)
+		{
+			nAvail = m_nRingSize - nOutPtr;		// contiguous part only
+		}
+
+		const u8 *pFrom = m_pRing + nOutPtr;
+		unsigned nConsumed = 0;
+		while (   nConsumed < nAvail
+		       && m_nSegmentFill < m_nSegmentLimit)
+		{
+			ConvertSample (m_Format, pFrom + nConsumed, m_pSegment + m_nSegmentFill);
+
+			nConsumed += m_nInSampleSize;
+			m_nSegmentFill += m_nOutSampleSize;
+		}
+
+		nOutPtr += nConsumed;
+		if (nOutPtr == m_nRingSize)
+		{
+			nOutPtr = 0;
+		}
+
+		// the data must be read, before the producer sees the new pointer
+		DataMemBarrier ();
+
+		m_nOutPtr = nOutPtr;
+
+		if (m_nSegmentFill >= m_nSegmentLimit)
+		{
+			FRESULT Result = WriteSegment ();
+			if (Result != FR_OK)
+			{
+				return Result;
+			}
+		}
+	}
+
+	return FR_OK;
+}
+
+FRESULT CSoundCapture::OpenFile (void)
+{
+	assert (!m_bFileOpen);
+
+	CString Path;
+	Path.Format (m_PathPattern, ++m_nFileNumber);
+
+	FRESULT Result = f_open (&m_File, Path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	// the FAT is not touched again, until the file is closed
+	Result = f_prealloc (&m_File, SOUND_CAPTURE_HEADER_SIZE + m_ullFileCapacity);
+	if (Result == FR_OK)
+	{
+		Result = f_stream_open (&m_Stream, &m_File);
+	}
+
+	if (Result == FR_OK)
+	{
+#if FF_MAX_SS != FF_MIN_SS
+		m_nSectorSize = m_File.obj.fs->ssize;
+#else
+		m_nSectorSize = FF_MAX_SS;
+#endif
+		assert (SOUND_CAPTURE_HEADER_SIZE % m_nSectorSize == 0);
+		assert (SOUND_CAPTURE_SEGMENT_SIZE % m_nSectorSize == 0);
+
+		// the file is readable up to the end, if it is never completed
+		Result = WriteHeader (m_ullFileCapacity);
+	}
+
+	if (Result != FR_OK)
+	{
+		f_stream_close (&m_Stream);
+		f_close (&m_File);
+
+		return Result;
+	}
+
+	m_bFileOpen = TRUE;
+	m_ullFileData = 0;
+
+	return FR_OK;
+}
+
+FRESULT CSoundCapture::WriteSegment (void)
+{
+	assert (m_nSegmentFill > 0);
+
+	FRESULT Result;
+
+	// change to the next file, when the current one is full
+	if (   m_bFileOpen
+	    && m_ullFileData >= m_ullFileCapacity)
+	{
+		Result = CloseFile ();
+		if (Result != FR_OK)
+		{
+			return Result;
+		}
+	}
+
+	if (!m_bFileOpen)
+	{
+		Result = OpenFile ();
+		if (Result != FR_OK)
+		{
+			return Result;
+		}
+	}
+
+	unsigned nLength = m_nSegmentFill < m_nSegmentLimit ? m_nSegmentFill : m_nSegmentLimit;
+	assert (m_ullFileData + nLength <= m_ullFileCapacity);
+
+	// a sample, which crossed the limit, belongs to the next segment
+	u8 Overflow[sizeof (u32)];
+	unsigned nOverflow = m_nSegmentFill - nLength;
+	assert (nOverflow < sizeof Overflow);
+	memcpy (Overflow, m_pSegment + nLength, nOverflow);
+
+	UINT nSectors = (nLength + m_nSectorSize-1) / m_nSectorSize;
+	memset (m_pSegment + nLength, 0, nSectors * m_nSectorSize - nLength);
+
+	// all segments, but the last one of a file, are sector aligned
+	Result = f_stream_seek (&m_Stream,
+				(SOUND_CAPTURE_HEADER_SIZE + m_ullFileData) / m_nSectorSize);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	UINT nWritten;
+	Result = f_stream_write (&m_Stream, m_pSegment, nSectors, &nWritten);
+	if (Result != FR_OK)
+	{
+		return Result;
+	}
+
+	if (nWritten != nSectors)
+	{
+		return FR_DISK_ERR;
+	}
+
+	m_ullFileData += nLength;
+	m_ullTotalBytes += nLength;
+
+	memcpy (m_pSegment, Overflow, nOverflow);
+	m_nSegmentFill = nOverflow;
+
+	// the next segment ends at the end of the file, if it is reached before
+	u64 ullRemaining = m_ullFileCapacity - m_ullFileData;
+	if (ullRemaining == 0)
+	{
+		ullRemaining = m_ullFileCapacity;
+	}
+
+	m_nSegmentLimit =   ullRemaining < SOUND_CAPTURE_SEGMENT_SIZE
+			  ? (unsigned) ullRemaining : SOUND_CAPTURE_SEGMENT_SIZE;
+
+	return FR_OK;
+}
+
+FRESULT CSoundCapture::CloseFile (void)
+{
+	assert (m_bFileOpen);
+	m_bFileOpen = FALSE;
+
+	FRESULT Result = WriteHeader (m_ullFileData);
+	if (Result == FR_OK)
+	{
+		Result = f_stream_sync (&m_Stream);
+	}
+
+	f_stream_close (&m_Stream);
+
+	// release the unused clusters of the preallocation
+	if (Result == FR_OK)
+	{
+		Result = f_lseek (&m_File, SOUND_CAPTURE_HEADER_SIZE + m_ullFileData);
+	}
+
+	if (Result == FR_OK)
+	{
+		Result = f_truncate (&m_File);
+	}
+
+	FRESULT CloseResult = f_close (&m_File);
+	if (Result == FR_OK)
+	{
+		Result = CloseResult;
+	}
+
+	return Result;
+}
+
+FRESULT CSoundCapture::WriteHeader (u64 ullDataSize)
+{
+	assert (ullDataSize <= SOUND_CAPTURE_MAX_DATA);
+
+	// the segment buffer cannot be used, it may contain pending data
+	u8 *pHeader = new (HEAP_DMA30) u8[SOUND_CAPTURE_HEADER_SIZE];
+	if (pHeader == 0)
+	{
+		return FR_NOT_ENOUGH_CORE;
+	}
+
+	memset (pHeader, 0, SOUND_CAPTURE_HEADER_SIZE);
+
+	unsigned nBits = m_nOutSampleSize * 8;
+
+	TWAVEHeader *pWAVE = (TWAVEHeader *) pHeader;
+	pWAVE->nRIFFMagic = SOUND_CAPTURE_MAGIC_RIFF;
+	pWAVE->nRIFFSize = SOUND_CAPTURE_HEADER_SIZE - 8 + (u32) ullDataSize;
+	pWAVE->nWAVEMagic = SOUND_CAPTURE_MAGIC_WAVE;
+	pWAVE->nFormatMagic = SOUND_CAPTURE_MAGIC_FMT;
+	pWAVE->nFormatSize = 40;
+	pWAVE->nFormatTag = SOUND_CAPTURE_FORMAT_EXTENSIBLE;
+	pWAVE->nChannels = m_nChannels;
+	pWAVE->nSampleRate = m_nSampleRate;
+	pWAVE->nByteRate = m_nSampleRate * m_nChannels * m_nOutSampleSize;
+	pWAVE->nBlockAlign = m_nChannels * m_nOutSampleSize;
+	pWAVE->nBitsPerSample = nBits;
+	pWAVE->nExtensionSize = 22;
+	pWAVE->nValidBitsPerSample = m_Format == SoundFormatSigned24_32 ? 24 : nBits;
+	pWAVE->nChannelMask = m_nChannels == 1 ? 0x4 : (m_nChannels == 2 ? 0x3 : 0);
+	memcpy (pWAVE->SubFormat, SubFormatPCM, sizeof SubFormatPCM);
+	pWAVE->nJunkMagic = SOUND_CAPTURE_MAGIC_JUNK;
+	pWAVE->nJunkSize = SOUND_CAPTURE_HEADER_SIZE - sizeof (TWAVEHeader) - 8;
+
+	// the data chunk header occupies the last 8 bytes of the header area
+	u32 *pData = (u32 *) (pHeader + SOUND_CAPTURE_HEADER_SIZE - 8);
+	pData[0] = SOUND_CAPTURE_MAGIC_DATA;
+	pData[1] = (u32) ullDataSize;
+
+	UINT nSectors = SOUND_CAPTURE_HEADER_SIZE / m_nSectorSize;
+	UINT nWritten;
+
+	FRESULT Result = f_stream_seek (&m_Stream, 0);
+	if (Result == FR_OK)
+	{
+		Result = f_stream_write (&m_Stream, pHeader, nSectors, &nWritten);
+	}
+
+	if (   Result == FR_OK
+	    && nWritten != nSectors)
+	{
+		Result = FR_DISK_ERR;
+	}
+
+	delete [] pHeader;
+
+	return Result;
+}
+
+void CSoundCapture::ConvertSample (TSoundFormat Format, const u8 *pFrom, u8 *pTo)
+{
+	switch (Format)
+	{
+	case SoundFormatUnsigned8:
+		pTo[0] = pFrom[0];
+		break;
+
+	case SoundFormatSigned16:
+		pTo[0] = pFrom[0];
+		pTo[1] = pFrom[1];
+		break;
+
+	case SoundFormatSigned24:
+		pTo[0] = pFrom[0];
+		pTo[1] = pFrom[1];
+		pTo[2] = pFrom[2];
+		break;
+
+	case SoundFormatSigned24_32: {
+		// left-justify the 24-bit value, as required for 32-bit PCM
+		u32 nValue;
+		memcpy (&nValue, pFrom, sizeof nValue);
+		nValue <<= 8;
+		memcpy (pTo, &nValue, sizeof nValue);
+		} break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
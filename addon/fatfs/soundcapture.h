@@ -0,0 +1,191 @@
+//
+// soundcapture.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fatfs_soundcapture_h
+#define _fatfs_soundcapture_h
+
+#include <fatfs/ff.h>
+#include <fatfs/ffstream.h>
+#include <circle/sound/soundbasedevice.h>
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/macros.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define SOUND_CAPTURE_RING_MSECS	5000		// default, must cover stalls of the medium
+#define SOUND_CAPTURE_DEVICE_MSECS	100		// read queue of a connected device
+#define SOUND_CAPTURE_SEGMENT_SIZE	0x40000		// bytes written at once, multiple of sector size
+#define SOUND_CAPTURE_HEADER_SIZE	0x1000		// WAVE header, the data is sector aligned
+#define SOUND_CAPTURE_FILE_SECONDS	1200		// default duration of one file
+#define SOUND_CAPTURE_MAX_DATA		0xFFF00000	// per file, 32-bit RIFF sizes
+#define SOUND_CAPTURE_POLL_MS		10		// interval for checking the ring
+
+/// \note The recorded data goes through a lock-free ring to the task, which writes it to a
+///	  contiguous, preallocated WAVE file in sector aligned segments, bypassing the FAT.
+///	  When the file is full, recording continues seamlessly in the next file.
+/// \note The samples in the WAVE file have 8, 16, 24 or 32 (with 24 valid) bits.
+
+class CSoundCapture : public CTask	/// Records sound input to WAVE files without gaps
+{
+public:
+	CSoundCapture (void);
+	~CSoundCapture (void);
+
+	/// \brief Setup for sound data, which is fed by Write()
+	/// \param Format Format of the sound data
+	/// \param nChannels Number of channels of the sound data
+	/// \param nSampleRate Sample rate in Hz
+	/// \param nRingMsecs Size of the ring in milliseconds duration of the stream
+	/// \return Operation successful?
+	boolean Initialize (TSoundFormat Format, unsigned nChannels, unsigned nSampleRate,
+			    unsigned nRingMsecs = SOUND_CAPTURE_RING_MSECS);
+	/// \brief Setup for sound data, which is fetched from a sound device directly
+	/// \param pDevice Sound device, must not have been started yet
+	/// \param nSampleRate Sample rate of the device in Hz
+	/// \param nRingMsecs Size of the ring in milliseconds duration of the stream
+	/// \return Operation successful?
+	/// \note Allocates the read queue of the device, which must not be read otherwise.
+	boolean Initialize (CSoundBaseDevice *pDevice, unsigned nSampleRate,
+			    unsigned nRingMsecs = SOUND_CAPTURE_RING_MSECS);
+
+	/// \brief Feed sound data into the ring (lock-free, single producer)
+	/// \param pBuffer Contains the frames in the format given to Initialize()
+	/// \param nCount Size of the buffer in bytes (multiple of frame size)
+	/// \return Number of bytes consumed, the rest is counted as overrun
+	/// \note Can be called on any core and from interrupt context.
+	int Write (const void *pBuffer, size_t nCount);
+
+	/// \brief Start recording to one or more new files
+	/// \param pPathPattern Path of the files, containing "%u" for the file number (from 1)
+	/// \param nSecondsPerFile Duration of each file (limited to SOUND_CAPTURE_MAX_DATA)
+	/// \return Operation successful? (see GetResult() on failure)
+	boolean StartRecording (const char *pPathPattern,
+				unsigned nSecondsPerFile = SOUND_CAPTURE_FILE_SECONDS);
+	/// \brief Write the pending data, complete the current file and stop recording
+	/// \return Operation successful? (see GetResult() on failure)
+	boolean StopRecording (void);
+
+	/// \return Is recording running?
+	/// \note Recording stops on a write error.
+	boolean IsRecording (void) const;
+
+	/// \return FatFs result code of the last failed operation (FR_OK if none)
+	FRESULT GetResult (void) const;
+
+	/// \return Number of frames written to files since StartRecording()
+	u64 GetFramesRecorded (void) const;
+	/// \return Number of frames lost since StartRecording(), because the ring was full
+	unsigned GetOverrunFrames (void) const;
+	/// \return Maximum fill level of the ring since StartRecording() in percent
+	unsigned GetMaxRingLevel (void) const;
+
+	void Run (void);
+
+private:
+	unsigned GetBytesAvail (void) const;
+
+	void FetchFromDevice (void);
+	static void HaveDataCallback (void *pParam);
+
+	FRESULT Process (void);			// moves data from the ring to the segment
+	FRESULT OpenFile (void);
+	FRESULT WriteSegment (void);
+	FRESULT CloseFile (void);
+	FRESULT WriteHeader (u64 ullDataSize);
+
+	static void ConvertSample (TSoundFormat Format, const u8 *pFrom, u8 *pTo);
+
+	struct TWAVEHeader
+	{
+		u32	nRIFFMagic;
+#define SOUND_CAPTURE_MAGIC_RIFF	0x46464952	// "RIFF"
+		u32	nRIFFSize;
+		u32	nWAVEMagic;
+#define SOUND_CAPTURE_MAGIC_WAVE	0x45564157	// "WAVE"
+
+		u32	nFormatMagic;
+#define SOUND_CAPTURE_MAGIC_FMT		0x20746D66	// "fmt "
+		u32	nFormatSize;
+		u16	nFormatTag;
+#define SOUND_CAPTURE_FORMAT_EXTENSIBLE	0xFFFE
+		u16	nChannels;
+		u32	nSampleRate;
+		u32	nByteRate;
+		u16	nBlockAlign;
+		u16	nBitsPerSample;
+		u16	nExtensionSize;
+		u16	nValidBitsPerSample;
+		u32	nChannelMask;
+		u8	SubFormat[16];
+
+		u32	nJunkMagic;			// pads the header to the sector boundary
+#define SOUND_CAPTURE_MAGIC_JUNK	0x4B4E554A	// "JUNK"
+		u32	nJunkSize;
+	}
+	PACKED;
+
+	enum TState
+	{
+		StateIdle,
+		StateStarting,
+		StateRecording,
+		StateStopping,
+		StateError
+	};
+
+private:
+	CSoundBaseDevice *m_pDevice;
+	unsigned m_nDeviceOverrunBase;
+
+	TSoundFormat m_Format;
+	unsigned m_nChannels;
+	unsigned m_nSampleRate;
+	unsigned m_nInSampleSize;		// in the ring
+	unsigned m_nOutSampleSize;		// in the file
+
+	u8 *m_pRing;
+	unsigned m_nRingSize;			// multiple of frame size
+	volatile unsigned m_nInPtr;
+	volatile unsigned m_nOutPtr;
+	volatile unsigned m_nOverrunFrames;	// is updated by the producer only
+	unsigned m_nOverrunBase;
+	unsigned m_nMaxRingLevel;
+
+	volatile TState m_State;
+	CSynchronizationEvent m_Event;		// start or stop has been processed
+	FRESULT m_Result;
+
+	CString m_PathPattern;
+	unsigned m_nFileNumber;
+	u64 m_ullFileCapacity;			// data bytes per file, multiple of frame size
+	u64 m_ullTotalBytes;			// data bytes in all files
+
+	FIL m_File;
+	FFSTREAM m_Stream;
+	boolean m_bFileOpen;
+	unsigned m_nSectorSize;
+	u64 m_ullFileData;			// data bytes written to the current file
+
+	u8 *m_pSegment;
+	unsigned m_nSegmentFill;
+	unsigned m_nSegmentLimit;		// next write, limited by the remaining file capacity
+};
+
+#endif
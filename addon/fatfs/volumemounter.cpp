@@ -0,0 +1,168 @@
+//
+// volumemounter.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <fatfs/volumemounter.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CVolumeMounter::CVolumeMounter (void)
+:	m_nVolumes (0)
+{
+}
+
+CVolumeMounter::~CVolumeMounter (void)
+{
+	WaitForAll ();
+
+	for (unsigned i = 0; i < m_nVolumes; i++)
+	{
+		assert (m_pVolume[i] != 0);
+		if (m_pVolume[i]->Result == FR_OK)
+		{
+			f_unmount (m_pVolume[i]->Name);
+		}
+
+		delete m_pVolume[i];
+		m_pVolume[i] = 0;
+	}
+}
+
+boolean CVolumeMounter::Add (const TCHAR *pVolume, unsigned nTimeoutMs)
+{
+	assert (pVolume != 0);
+
+	if (   m_nVolumes >= FF_VOLUMES
+	    || Lookup (pVolume) != 0)
+	{
+		return FALSE;
+	}
+
+	TVolume *pNew = new TVolume;
+	assert (pNew != 0);
+
+	pNew->Name = pVolume;
+	pNew->nTimeout = nTimeoutMs * (CLOCKHZ / 1000);
+	pNew->Result = FR_NOT_READY;
+	pNew->bDone = FALSE;
+
+	m_pVolume[m_nVolumes++] = pNew;
+
+	// is deleted by the scheduler on termination
+	CMountTask *pTask = new CMountTask (pNew);
+	assert (pTask != 0);
+
+	return TRUE;
+}
+
+boolean CVolumeMounter::IsReady (const TCHAR *pVolume) const
+{
+	TVolume *pEntry = Lookup (pVolume);
+
+	return    pEntry != 0
+	       && pEntry->bDone
+	       && pEntry->Result == FR_OK;
+}
+
+FATFS *CVolumeMounter::WaitForVolume (const TCHAR *pVolume)
+{
+	TVolume *pEntry = Lookup (pVolume);
+	if (pEntry == 0)
+	{
+		return 0;
+	}
+
+	pEntry->Event.Wait ();
+
+	assert (pEntry->bDone);
+	return pEntry->Result == FR_OK ? &pEntry->FileSystem : 0;
+}
+
+void CVolumeMounter::WaitForAll (void)
+{
+	for (unsigned i = 0; i < m_nVolumes; i++)
+	{
+		assert (m_pVolume[i] != 0);
+		m_pVolume[i]->Event.Wait ();
+	}
+}
+
+FRESULT CVolumeMounter::GetResult (const TCHAR *pVolume) const
+{
+	TVolume *pEntry = Lookup (pVolume);
+	if (pEntry == 0)
+	{
+		return FR_INVALID_DRIVE;
+	}
+
+	return pEntry->Result;
+}
+
+CVolumeMounter::TVolume *CVolumeMounter::Lookup (const TCHAR *pVolume) const
+{
+	assert (pVolume != 0);
+
+	for (unsigned i = 0; i < m_nVolumes; i++)
+	{
+		assert (m_pVolume[i] != 0);
+		if (m_pVolume[i]->Name.Compare (pVolume) == 0)
+		{
+			return m_pVolume[i];
+		}
+	}
+
+	return 0;
+}
+
+CVolumeMounter::CMountTask::CMountTask (TVolume *pVolume)
+:	m_pVolume (pVolume)
+{
+	CString Name ("mount ");
+	Name.Append (pVolume->Name);
+	SetName (Name);
+}
+
+void CVolumeMounter::CMountTask::Run (void)
+{
+	TVolume *pVolume = m_pVolume;
+	assert (pVolume != 0);
+
+	// FR_NOT_READY is returned, until the device has been registered
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	FRESULT Result;
+	while ((Result = f_mount (&pVolume->FileSystem, pVolume->Name, 1)) == FR_NOT_READY)
+	{
+		if (   pVolume->nTimeout != 0
+		    && CTimer::GetClockTicks () - nStartTicks >= pVolume->nTimeout)
+		{
+			break;
+		}
+
+		CScheduler::Get ()->MsSleep (VOLUME_MOUNTER_POLL_MS);
+	}
+
+	if (Result != FR_OK)
+	{
+		f_unmount (pVolume->Name);
+	}
+
+	pVolume->Result = Result;
+	pVolume->bDone = TRUE;
+	pVolume->Event.Set ();
+}
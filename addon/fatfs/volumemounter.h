@@ -0,0 +1,88 @@
+//
+// volumemounter.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _fatfs_volumemounter_h
+#define _fatfs_volumemounter_h
+
+#include <fatfs/ff.h>
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define VOLUME_MOUNTER_POLL_MS	20		// interval for checking, if the device is available
+
+class CVolumeMounter	/// Mounts FatFs volumes in parallel tasks, when their devices appear
+{
+public:
+	CVolumeMounter (void);
+	~CVolumeMounter (void);
+
+	/// \brief Start a task, which mounts a volume, as soon as its device is available
+	/// \param pVolume Volume ID with colon (e.g. "SD:", "USB:", "NVME:")
+	/// \param nTimeoutMs Give up, if the device does not appear in this time (0 for never)
+	/// \return Operation successful?
+	boolean Add (const TCHAR *pVolume, unsigned nTimeoutMs = 0);
+
+	/// \return Has the volume been mounted successfully yet?
+	/// \param pVolume Volume ID as given to Add()
+	boolean IsReady (const TCHAR *pVolume) const;
+
+	/// \brief Wait, until a volume has been mounted or mounting failed
+	/// \param pVolume Volume ID as given to Add()
+	/// \return Pointer to the mounted file system object (0 on failure)
+	FATFS *WaitForVolume (const TCHAR *pVolume);
+
+	/// \brief Wait, until all added volumes have been processed
+	void WaitForAll (void);
+
+	/// \param pVolume Volume ID as given to Add()
+	/// \return Result of f_mount(), FR_NOT_READY while not processed
+	FRESULT GetResult (const TCHAR *pVolume) const;
+
+private:
+	struct TVolume
+	{
+		CString Name;
+		FATFS FileSystem;
+		unsigned nTimeout;		// in clock ticks (0 for never)
+		volatile FRESULT Result;
+		volatile boolean bDone;
+		CSynchronizationEvent Event;	// set, when done
+	};
+
+	TVolume *Lookup (const TCHAR *pVolume) const;
+
+	class CMountTask : public CTask
+	{
+	public:
+		CMountTask (TVolume *pVolume);
+
+		void Run (void) override;
+
+	private:
+		TVolume *m_pVolume;
+	};
+
+private:
+	TVolume *m_pVolume[FF_VOLUMES];
+	unsigned m_nVolumes;
+};
+
+#endif
@@ -0,0 +1,420 @@
+//
+// httpfileserver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <httpfileserver/httpfileserver.h>
+#include <circle/netbuffer.h>
+#include <circle/time.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define CONTENT_BUFFER_SIZE	1024		// for error pages only
+
+#define SECTOR_SIZE		512
+#define CHUNK_SIZE		(3 * SECTOR_SIZE)	// must fit into one net buffer
+
+static const char s_IndexFile[] = "index.html";
+
+CHTTPFileServer::CHTTPFileServer (CNetSubSystem *pNetSubSystem, const char *pPath,
+				  u16 nPort, unsigned nTimeoutSeconds, CSocket *pSocket)
+:	CHTTPDaemon (pNetSubSystem, pSocket, CONTENT_BUFFER_SIZE, nPort, 0, nTimeoutSeconds),
+	m_Path (pPath),
+	m_nPort (nPort),
+	m_nTimeoutSeconds (nTimeoutSeconds)
+{
+	assert (m_Path.GetLength () > 0);
+	assert (((const char *) m_Path)[m_Path.GetLength ()-1] == '/');
+}
+
+CHTTPFileServer::~CHTTPFileServer (void)
+{
+}
+
+CHTTPDaemon *CHTTPFileServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket)
+{
+	return new CHTTPFileServer (pNetSubSystem, m_Path, m_nPort, m_nTimeoutSeconds, pSocket);
+}
+
+THTTPStatus CHTTPFileServer::GetContent (const char  *pPath,
+					 const char  *pParams,
+					 const char  *pFormData,
+					 u8	     *pBuffer,
+					 unsigned    *pLength,
+					 const char **ppContentType)
+{
+	if (GetRequestMethod () == HTTPRequestMethodPost)
+	{
+		return HTTPMethodNotImplemented;
+	}
+
+	char Path[HTTP_MAX_PATH+sizeof s_IndexFile];
+	assert (pPath != 0);
+	if (   *pPath++ != '/'
+	    || !DecodePath (Path, pPath, HTTP_MAX_PATH+1)
+	    || strstr (Path, "..") != 0)		// do not leave the served directory
+	{
+		return HTTPBadRequest;
+	}
+
+	size_t nPathLength = strlen (Path);
+	if (   nPathLength == 0
+	    || Path[nPathLength-1] == '/')
+	{
+		strcat (Path, s_IndexFile);
+	}
+
+	CString FileName (m_Path);
+	FileName.Append (Path);
+
+	FILINFO FileInfo;
+	if (   f_stat (FileName, &FileInfo) != FR_OK
+	    || (FileInfo.fattrib & AM_DIR))
+	{
+		return HTTPNotFound;
+	}
+
+	if (FileInfo.fsize >= HTTPD_CONTENT_LENGTH_UNKNOWN)
+	{
+		return HTTPRequestEntityTooLarge;
+	}
+	u32 nSize = (u32) FileInfo.fsize;
+
+	// validators for caching
+	CString ETag;
+	ETag.Format ("\"%x-%x\"", nSize, (unsigned) FileInfo.fdate << 16 | FileInfo.ftime);
+
+	CString LastModified;
+	FormatDate (&LastModified, FileInfo.fdate, FileInfo.ftime);
+
+	const char *pContentType = GetContentType (Path);
+
+	CString HeaderFields;
+	HeaderFields.Format ("Accept-Ranges: bytes\r\n"
+			     "ETag: %s\r\n"
+			     "Last-Modified: %s\r\n",
+			     (const char *) ETag, (const char *) LastModified);
+
+	// If-Modified-Since is only compared with the date, which has been sent before
+	const char *pIfNoneMatch = GetRequestIfNoneMatch ();
+	if (   *pIfNoneMatch != '\0'
+	    ?    strstr (pIfNoneMatch, ETag) != 0
+	      || strcmp (pIfNoneMatch, "*") == 0
+	    : strcmp (GetRequestIfModifiedSince (), LastModified) == 0)
+	{
+		BeginResponse (HTTPNotModified, pContentType, 0, HeaderFields);
+
+		return HTTPOK;
+	}
+
+	THTTPStatus Status = HTTPOK;
+	u32 nStart = 0;
+	u32 nEnd = nSize-1;		// inclusive
+	if (!ParseRange (GetRequestRange (), nSize, &nStart, &nEnd))
+	{
+		CString ContentRange;
+		ContentRange.Format ("Content-Range: bytes */%u\r\n", nSize);
+		HeaderFields.Append (ContentRange);
+
+		BeginResponse (HTTPRangeNotSatisfiable, pContentType, 0, HeaderFields);
+
+		return HTTPOK;
+	}
+
+	if (   nStart != 0
+	    || nEnd != nSize-1)
+	{
+		CString ContentRange;
+		ContentRange.Format ("Content-Range: bytes %u-%u/%u\r\n", nStart, nEnd, nSize);
+		HeaderFields.Append (ContentRange);
+
+		Status = HTTPPartialContent;
+	}
+
+	u32 nLength = nSize > 0 ? nEnd-nStart+1 : 0;
+
+	FIL File;
+	if (f_open (&File, FileName, FA_READ | FA_OPEN_EXISTING) != FR_OK)
+	{
+		return HTTPNotFound;
+	}
+
+	if (   nStart > 0
+	    && f_lseek (&File, nStart) != FR_OK)
+	{
+		f_close (&File);
+
+		return HTTPInternalServerError;
+	}
+
+	if (!BeginResponse (Status, pContentType, nLength, HeaderFields))
+	{
+		f_close (&File);
+
+		return HTTPOK;
+	}
+
+	if (GetRequestMethod () == HTTPRequestMethodHead)
+	{
+		nLength = 0;
+	}
+
+	THTTPStatus Result = HTTPOK;
+	u32 nOffset = nStart;
+	while (nLength > 0)
+	{
+		// the first piece ends on a sector boundary, so that FatFs can read the
+		// following sectors directly into the (DMA aligned) net buffers
+		unsigned nCount = CHUNK_SIZE - nOffset % SECTOR_SIZE;
+		if (nCount > nLength)
+		{
+			nCount = nLength;
+		}
+
+		CNetBuffer *pNetBuffer = CNetBuffer::Alloc ();
+		assert (pNetBuffer != 0);
+		assert (nCount <= pNetBuffer->GetTailroom ());
+
+		UINT nBytesRead;
+		if (   f_read (&File, pNetBuffer->Append (nCount), nCount, &nBytesRead) != FR_OK
+		    || nBytesRead != nCount)
+		{
+			pNetBuffer->Release ();
+
+			Result = HTTPInternalServerError;	// connection will be closed
+
+			break;
+		}
+
+		if (!WriteContent (pNetBuffer))
+		{
+			break;
+		}
+
+		nOffset += nCount;
+		nLength -= nCount;
+	}
+
+	f_close (&File);
+
+	return Result;
+}
+
+boolean CHTTPFileServer::ParseRange (const char *pRange, u32 nSize, u32 *pStart, u32 *pEnd)
+{
+	// "bytes=first-last", "bytes=first-" or "bytes=-suffixlength"
+	assert (pRange != 0);
+	if (strncmp (pRange, "bytes=", 6) != 0)
+	{
+		return TRUE;
+	}
+	pRange += 6;
+
+	boolean bFirst = FALSE;
+	u32 nFirst = 0;
+	while ('0' <= *pRange && *pRange <= '9')
+	{
+		bFirst = TRUE;
+		nFirst = nFirst * 10 + (*pRange++ - '0');
+		if (nFirst >= HTTPD_CONTENT_LENGTH_UNKNOWN / 10)
+		{
+			return TRUE;
+		}
+	}
+
+	if (*pRange++ != '-')
+	{
+		return TRUE;
+	}
+
+	boolean bLast = FALSE;
+	u32 nLast = 0;
+	while ('0' <= *pRange && *pRange <= '9')
+	{
+		bLast = TRUE;
+		nLast = nLast * 10 + (*pRange++ - '0');
+		if (nLast >= HTTPD_CONTENT_LENGTH_UNKNOWN / 10)
+		{
+			return TRUE;
+		}
+	}
+
+	if (   *pRange != '\0'		// multiple ranges are ignored, the whole file is sent
+	    || (!bFirst && !bLast)
+	    || (bFirst && bLast && nLast < nFirst))
+	{
+		return TRUE;
+	}
+
+	if (!bFirst)				// suffix range
+	{
+		if (nLast == 0)
+		{
+			return FALSE;
+		}
+
+		if (nSize == 0)
+		{
+			return TRUE;
+		}
+
+		assert (pStart != 0);
+		*pStart = nLast < nSize ? nSize-nLast : 0;
+		assert (pEnd != 0);
+		*pEnd = nSize-1;
+
+		return TRUE;
+	}
+
+	if (nFirst >= nSize)
+	{
+		return FALSE;
+	}
+
+	assert (pStart != 0);
+	*pStart = nFirst;
+	assert (pEnd != 0);
+	*pEnd = bLast && nLast < nSize ? nLast : nSize-1;
+
+	return TRUE;
+}
+
+boolean CHTTPFileServer::DecodePath (char *pDest, const char *pPath, unsigned nDestSize)
+{
+	assert (pDest != 0);
+	assert (pPath != 0);
+	while (*pPath != '\0')
+	{
+		char chChar = *pPath++;
+		if (chChar == '%')
+		{
+			unsigned nValue = 0;
+			for (unsigned i = 0; i < 2; i++)
+			{
+				char chDigit = *pPath++;
+				if ('0' <= chDigit && chDigit <= '9')
+				{
+					nValue = nValue << 4 | (chDigit - '0');
+				}
+				else if ('A' <= (chDigit & ~0x20) && (chDigit & ~0x20) <= 'F')
+				{
+					nValue = nValue << 4 | ((chDigit & ~0x20) - 'A' + 10);
+				}
+				else
+				{
+					return FALSE;
+				}
+			}
+
+			if (nValue == 0)
+			{
+				return FALSE;
+			}
+
+			chChar = (char) nValue;
+		}
+
+		if (nDestSize <= 1)
+		{
+			return FALSE;
+		}
+
+		*pDest++ = chChar;
+		nDestSize--;
+	}
+
+	*pDest = '\0';
+
+	return TRUE;
+}
+
+const char *CHTTPFileServer::GetContentType (const char *pFileName)
+{
+	static const struct
+	{
+		const char *pExtension;
+		const char *pContentType;
+	}
+	ContentTypes[] =
+	{
+		{".html",	"text/html"},
+		{".htm",	"text/html"},
+		{".css",	"text/css"},
+		{".js",		"text/javascript"},
+		{".json",	"application/json"},
+		{".txt",	"text/plain"},
+		{".xml",	"text/xml"},
+		{".png",	"image/png"},
+		{".jpg",	"image/jpeg"},
+		{".jpeg",	"image/jpeg"},
+		{".gif",	"image/gif"},
+		{".svg",	"image/svg+xml"},
+		{".ico",	"image/x-icon"},
+		{".wav",	"audio/wav"},
+		{".mp3",	"audio/mpeg"},
+		{".pdf",	"application/pdf"}
+	};
+
+	assert (pFileName != 0);
+	const char *pExtension = 0;
+	for (const char *p = pFileName; *p != '\0'; p++)
+	{
+		if (*p == '.')
+		{
+			pExtension = p;
+		}
+		else if (*p == '/')
+		{
+			pExtension = 0;
+		}
+	}
+
+	if (pExtension != 0)
+	{
+		for (unsigned i = 0; i < sizeof ContentTypes / sizeof ContentTypes[0]; i++)
+		{
+			if (strcasecmp (pExtension, ContentTypes[i].pExtension) == 0)
+			{
+				return ContentTypes[i].pContentType;
+			}
+		}
+	}
+
+	return "application/octet-stream";
+}
+
+void CHTTPFileServer::FormatDate (CString *pString, unsigned nFATDate, unsigned nFATTime)
+{
+	static const char *DaysOfWeek[] = {"Sun", "Mon", "Tue", "Wed", "Thu", "Fri", "Sat"};
+	static const char *MonthName[] = {"Jan", "Feb", "Mar", "Apr", "May", "Jun",
+					  "Jul", "Aug", "Sep", "Oct", "Nov", "Dec"};
+
+	// the local time of the file system is sent as GMT
+	CTime Time;
+	if (   !Time.SetDate (nFATDate & 0x1F, (nFATDate >> 5) & 0x0F, (nFATDate >> 9) + 1980)
+	    || !Time.SetTime (nFATTime >> 11, (nFATTime >> 5) & 0x3F, (nFATTime & 0x1F) * 2))
+	{
+		Time.Set (0);
+	}
+
+	// RFC 7231 IMF-fixdate
+	assert (pString != 0);
+	pString->Format ("%s, %02u %s %u %02u:%02u:%02u GMT",
+			 DaysOfWeek[Time.GetWeekDay ()], Time.GetMonthDay (),
+			 MonthName[Time.GetMonth ()-1], Time.GetYear (),
+			 Time.GetHours (), Time.GetMinutes (), Time.GetSeconds ());
+}
@@ -0,0 +1,75 @@
+//
+// httpfileserver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _httpfileserver_httpfileserver_h
+#define _httpfileserver_httpfileserver_h
+
+#include <circle/net/httpdaemon.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/string.h>
+#include <fatfs/ff.h>
+#include <circle/types.h>
+
+class CHTTPFileServer : public CHTTPDaemon	/// Serves static files from a FatFs volume
+{
+public:
+	/// \param pNetSubSystem Pointer to the network subsystem
+	/// \param pPath Directory with the files to be served (must have trailing '/')
+	/// \param nPort TCP port to listen on
+	/// \param nTimeoutSeconds Receive timeout (or 0 to wait forever)
+	/// \param pSocket Is 0 for 1st created instance (listener)
+	CHTTPFileServer (CNetSubSystem *pNetSubSystem,
+			 const char    *pPath		= "SD:/",
+			 u16		nPort		= HTTP_PORT,
+			 unsigned	nTimeoutSeconds	= 0,
+			 CSocket       *pSocket		= 0);
+	~CHTTPFileServer (void);
+
+	CHTTPDaemon *CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket);
+
+	/// \brief Sends the file for pPath ("/" is "index.html") in pieces,
+	///	   which are read from the file system directly into the net buffers
+	/// \note Supports conditional (ETag, If-Modified-Since) and single range requests.\n
+	///	  Override this to serve dynamic content and call it for the other paths.
+	THTTPStatus GetContent (const char  *pPath,
+				const char  *pParams,
+				const char  *pFormData,
+				u8	    *pBuffer,
+				unsigned    *pLength,
+				const char **ppContentType);
+
+private:
+	// returns FALSE, if the range is not satisfiable (*pStart and *pEnd are not modified,
+	// if pRange does not hold a single, valid byte range)
+	static boolean ParseRange (const char *pRange, u32 nSize, u32 *pStart, u32 *pEnd);
+
+	static boolean DecodePath (char *pDest, const char *pPath, unsigned nDestSize);
+
+	static const char *GetContentType (const char *pFileName);
+
+	static void FormatDate (CString *pString, unsigned nFATDate, unsigned nFATTime);
+
+private:
+	CString m_Path;
+	u16 m_nPort;
+	unsigned m_nTimeoutSeconds;
+};
+
+#endif
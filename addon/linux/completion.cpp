@@ -1,66 +1,51 @@
 #include <linux/completion.h>
 #include <linux/jiffies.h>
-#include <linux/bug.h>
 #include <circle/sched/scheduler.h>
-#include <circle/multicore.h>
 
-void complete (struct completion *x)
+// decrements x->done, if it is not zero, returns 1 on success
+static int completion_take (struct completion *x)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
+	int done = __atomic_load_n (&x->done, __ATOMIC_ACQUIRE);
+	while (done != 0)
+	{
+		if (__atomic_compare_exchange_n (&x->done, &done, done-1, 0,
+						 __ATOMIC_ACQUIRE, __ATOMIC_ACQUIRE))
+		{
+			return 1;
+		}
+	}
 
-	x->done++;
+	return 0;
 }
 
-void complete_all (struct completion *x)
+void complete (struct completion *x)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
+	__atomic_add_fetch (&x->done, 1, __ATOMIC_RELEASE);
+}
 
-	x->done = (unsigned) -1 / 2;
+void complete_all (struct completion *x)
+{
+	__atomic_store_n (&x->done, (unsigned) -1 / 2, __ATOMIC_RELEASE);
 }
 
 void wait_for_completion (struct completion *x)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	while (x->done == 0)
+	while (!completion_take (x))
 	{
 		CScheduler::Get ()->Yield ();
 	}
-
-	x->done--;
 }
 
 int try_wait_for_completion (struct completion *x)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	if (x->done == 0)
-	{
-		return 0;
-	}
-
-	x->done--;
-
-	return 1;
+	return completion_take (x);
 }
 
 long wait_for_completion_interruptible_timeout (struct completion *x, unsigned long timeout)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
 	unsigned long start = jiffies;
 
-	while (x->done == 0)
+	while (!completion_take (x))
 	{
 		unsigned long now = jiffies;
 		if (now-start >= timeout)
@@ -71,7 +56,5 @@ long wait_for_completion_interruptible_timeout (struct completion *x, unsigned l
 		CScheduler::Get ()->Yield ();
 	}
 
-	x->done--;
-
 	return 1;
 }
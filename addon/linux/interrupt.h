@@ -2,6 +2,7 @@
 #define _linux_interrupt_h
 
 #include <linux/compiler.h>
+#include <linux/workqueue.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -31,6 +32,31 @@ struct device;
 int __must_check devm_request_irq (struct device *dev, unsigned int irq, irq_handler_t handler,
 				   unsigned long irqflags, const char *devname, void *dev_id);
 
+// tasklets are executed by a high priority kthread on the core, which scheduled it
+
+struct tasklet_struct
+{
+	struct work_struct work;
+	volatile unsigned long state;
+	int count;			// disabled, if not 0
+	void (*func) (unsigned long data);
+	unsigned long data;
+};
+
+void tasklet_init (struct tasklet_struct *t, void (*func) (unsigned long), unsigned long data);
+
+void tasklet_schedule (struct tasklet_struct *t);
+
+static inline void tasklet_hi_schedule (struct tasklet_struct *t)
+{
+	tasklet_schedule (t);
+}
+
+void tasklet_disable (struct tasklet_struct *t);
+void tasklet_enable (struct tasklet_struct *t);
+
+void tasklet_kill (struct tasklet_struct *t);
+
 #ifdef __cplusplus
 }
 #endif
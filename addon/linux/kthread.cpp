@@ -1,15 +1,22 @@
 #include <linux/kthread.h>
 #include <linux/bug.h>
+#include <linux/smp.h>
+#include <assert.h>
 #include <circle/sched/task.h>
 #include <circle/sched/scheduler.h>
+#include <circle/multicore.h>
+#include <circle/sysconfig.h>
 #include <circle/string.h>
 #include <circle/stdarg.h>
 
 class CKThread : public CTask
 {
 public:
-	CKThread (int (*threadfn) (void *data), void *data, const char *pName)
-	:	m_threadfn (threadfn),
+	CKThread (int (*threadfn) (void *data), void *data, const char *pName,
+		  boolean bCreateSuspended = FALSE, unsigned nPriority = TASK_PRIORITY_DEFAULT,
+		  unsigned nCore = TASK_CORE_CURRENT)
+	:	CTask (TASK_STACK_SIZE, bCreateSuspended, nPriority, nCore),
+		m_threadfn (threadfn),
 		m_data (data)
 	{
 		SetName (pName);
@@ -27,8 +34,12 @@ private:
 
 struct task_struct *current = 0;
 
+static struct task_struct *current_on_core[NR_CPUS];
+
 static int next_pid = 1;
 
+static void register_handlers (unsigned core);
+
 struct task_struct *kthread_create (int (*threadfn)(void *data),
 				    void *data,
 				    const char namefmt[], ...)
@@ -41,7 +52,7 @@ struct task_struct *kthread_create (int (*threadfn)(void *data),
 
 	task_struct *task = new task_struct;
 
-	task->pid = next_pid++;
+	task->pid = __atomic_fetch_add (&next_pid, 1, __ATOMIC_RELAXED);
 	task->terminated = 0;
 	task->userdata = 0;
 
@@ -52,6 +63,69 @@ struct task_struct *kthread_create (int (*threadfn)(void *data),
 	return task;
 }
 
+struct task_struct *linuxemu_kthread_create (int (*threadfn)(void *data), void *data,
+					     unsigned int cpu, unsigned int priority,
+					     const char *name)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (   cpu >= NR_CPUS
+	    || !CScheduler::IsActive (cpu))
+	{
+		cpu = CMultiCoreSupport::ThisCore ();
+	}
+
+	register_handlers (cpu);
+#else
+	cpu = 0;
+#endif
+
+	task_struct *task = new task_struct;
+
+	task->pid = __atomic_fetch_add (&next_pid, 1, __ATOMIC_RELAXED);
+	task->terminated = 0;
+	task->userdata = 0;
+
+	// a task for another core must be started after construction
+	CTask *ctask = new CKThread (threadfn, data, name, TRUE, priority, cpu);
+	ctask->SetUserData (task, TASK_USER_DATA_KTHREAD);
+	task->taskobj = (void *) ctask;
+
+	ctask->Start ();
+
+	return task;
+}
+
+struct task_struct *kthread_create_on_cpu (int (*threadfn)(void *data),
+					   void *data, unsigned int cpu,
+					   const char namefmt[], ...)
+{
+	CString name;
+	va_list var;
+	va_start (var, namefmt);
+	name.FormatV (namefmt, var);
+	va_end (var);
+
+	return linuxemu_kthread_create (threadfn, data, cpu, TASK_PRIORITY_DEFAULT, name);
+}
+
+struct task_struct *get_current (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return current_on_core[CMultiCoreSupport::ThisCore ()];
+#else
+	return current;
+#endif
+}
+
+unsigned int smp_processor_id (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return CMultiCoreSupport::ThisCore ();
+#else
+	return 0;
+#endif
+}
+
 void set_user_nice (struct task_struct *task, long nice)
 {
 }
@@ -68,7 +142,15 @@ void flush_signals (struct task_struct *task)
 
 static void task_switch_handler (CTask *ctask)
 {
-	current = (struct task_struct *) ctask->GetUserData (TASK_USER_DATA_KTHREAD);
+	struct task_struct *task =
+		(struct task_struct *) ctask->GetUserData (TASK_USER_DATA_KTHREAD);
+
+	unsigned core = ctask->GetCore ();
+	current_on_core[core] = task;
+	if (core == 0)
+	{
+		current = task;
+	}
 }
 
 static void task_termination_handler (CTask *ctask)
@@ -95,9 +177,31 @@ int linuxemu_init_kthread (void)
 	ctask->SetUserData (task, TASK_USER_DATA_KTHREAD);
 
 	current = task;
+	current_on_core[ctask->GetCore ()] = task;
 
-	CScheduler::Get ()->RegisterTaskSwitchHandler (task_switch_handler);
-	CScheduler::Get ()->RegisterTaskTerminationHandler (task_termination_handler);
+	register_handlers (ctask->GetCore ());
 
 	return 0;
 }
+
+// the handlers are registered with the scheduler of each core, which runs kthreads
+static void register_handlers (unsigned core)
+{
+	static volatile boolean registered[NR_CPUS];
+
+	assert (core < NR_CPUS);
+	if (__atomic_exchange_n (&registered[core], TRUE, __ATOMIC_ACQ_REL))
+	{
+		return;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CScheduler *scheduler = CScheduler::Get (core);
+#else
+	CScheduler *scheduler = CScheduler::Get ();
+#endif
+	assert (scheduler != 0);
+
+	scheduler->RegisterTaskSwitchHandler (task_switch_handler);
+	scheduler->RegisterTaskTerminationHandler (task_termination_handler);
+}
@@ -11,6 +11,15 @@ struct task_struct *kthread_create (int (*threadfn)(void *data),
 				    void *data,
 				    const char namefmt[], ...);
 
+struct task_struct *kthread_create_on_cpu (int (*threadfn)(void *data),
+					   void *data, unsigned int cpu,
+					   const char namefmt[], ...);
+
+// starts a kthread on a CPU core, which must already run a scheduler (else on this core)
+struct task_struct *linuxemu_kthread_create (int (*threadfn)(void *data), void *data,
+					     unsigned int cpu, unsigned int priority,
+					     const char *name);
+
 int linuxemu_init_kthread (void);
 
 #ifdef __cplusplus
@@ -1,6 +1,7 @@
 #include <linux/linuxemu.h>
 #include <linux/timer.h>
 #include <linux/kthread.h>
+#include <linux/workqueue.h>
 
 int linuxemu_init (void)
 {
@@ -23,5 +24,11 @@ int linuxemu_init (void)
 		return ret;
 	}
 
+	ret = linuxemu_init_workqueue ();
+	if (ret != 0)
+	{
+		return ret;
+	}
+
 	return 0;
 }
@@ -4,7 +4,6 @@
 #include <linux/errno.h>
 #include <linux/bug.h>
 #include <circle/sysconfig.h>
-#include <circle/multicore.h>
 #include <circle/sched/task.h>
 
 static pthread_key_t next_key = 1;
@@ -67,21 +66,22 @@ int pthread_create (pthread_t *thread, const pthread_attr_t *attr,
 
 pthread_t pthread_self (void)
 {
-	BUG_ON (current == 0);
+	struct task_struct *task = get_current ();
+	BUG_ON (task == 0);
 
-	if (current->userdata == 0)
+	if (task->userdata == 0)
 	{
 		struct pthread *p = (struct pthread *) kmalloc (sizeof (struct pthread), GFP_KERNEL);
 		BUG_ON (p == 0);
 
 		p->retval = 0;
 		INIT_LIST_HEAD (&p->key_list);
-		p->kthread = current;
+		p->kthread = task;
 
-		current->userdata = p;
+		task->userdata = p;
 	}
 
-	return (pthread_t) current->userdata;
+	return (pthread_t) task->userdata;
 }
 
 void pthread_exit (void *retval)
@@ -164,17 +164,11 @@ int pthread_mutex_lock (pthread_mutex_t *mutex)
 
 int pthread_mutex_trylock (pthread_mutex_t *mutex)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	if (mutex->lock != 0)
+	if (__atomic_exchange_n (&mutex->lock, 1, __ATOMIC_ACQUIRE) != 0)
 	{
 		return -EAGAIN;
 	}
 
-	mutex->lock = 1;
-
 	return 0;
 }
 
@@ -1,19 +1,13 @@
 #include <linux/rwlock.h>
-#include <linux/bug.h>
 #include <circle/sched/scheduler.h>
-#include <circle/multicore.h>
 
 #define WRITE_LOCK	(1U << 31)
 
 void read_lock_bh (rwlock_t *lock)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
+	__atomic_add_fetch (&lock->lock, 1, __ATOMIC_ACQUIRE);
 
-	lock->lock++;
-
-	while (lock->lock >= WRITE_LOCK)
+	while (__atomic_load_n (&lock->lock, __ATOMIC_ACQUIRE) >= WRITE_LOCK)
 	{
 		CScheduler::Get ()->Yield ();
 	}
@@ -21,22 +15,18 @@ void read_lock_bh (rwlock_t *lock)
 
 void read_unlock_bh (rwlock_t *lock)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	lock->lock--;
+	__atomic_sub_fetch (&lock->lock, 1, __ATOMIC_RELEASE);
 }
 
 void write_lock_bh (rwlock_t *lock)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	lock->lock |= WRITE_LOCK;
+	// only one writer at a time
+	while (__atomic_fetch_or (&lock->lock, WRITE_LOCK, __ATOMIC_ACQUIRE) & WRITE_LOCK)
+	{
+		CScheduler::Get ()->Yield ();
+	}
 
-	while ((lock->lock & ~WRITE_LOCK) != 0)
+	while ((__atomic_load_n (&lock->lock, __ATOMIC_ACQUIRE) & ~WRITE_LOCK) != 0)
 	{
 		CScheduler::Get ()->Yield ();
 	}
@@ -44,9 +34,5 @@ void write_lock_bh (rwlock_t *lock)
 
 void write_unlock_bh (rwlock_t *lock)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	lock->lock &= ~WRITE_LOCK;
+	__atomic_and_fetch (&lock->lock, ~WRITE_LOCK, __ATOMIC_RELEASE);
 }
@@ -1,6 +1,8 @@
 #ifndef _linux_sched_h
 #define _linux_sched_h
 
+#include <linux/smp.h>
+
 #ifdef __cplusplus
 extern "C" {
 #endif
@@ -13,8 +15,12 @@ struct task_struct
 	void *userdata;
 };
 
+// current is the task of core 0 only (it is not a macro, because it is used as an
+// identifier in ported code), get_current() works on all cores
 extern struct task_struct *current;
 
+struct task_struct *get_current (void);
+
 void set_user_nice (struct task_struct *task, long nice);
 
 int wake_up_process (struct task_struct *task);
@@ -1,43 +1,33 @@
 #include <linux/semaphore.h>
-#include <linux/bug.h>
 #include <circle/sched/scheduler.h>
-#include <circle/multicore.h>
 
 void down (struct semaphore *sem)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	while (atomic_read (&sem->count) == 0)
+	while (down_trylock (sem))
 	{
 		CScheduler::Get ()->Yield ();
 	}
-
-	atomic_dec (&sem->count);
 }
 
 void up (struct semaphore *sem)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
 	atomic_inc (&sem->count);
 }
 
 int down_trylock (struct semaphore *sem)
 {
-#ifdef ARM_ALLOW_MULTI_CORE
-	BUG_ON (CMultiCoreSupport::ThisCore () != 0);
-#endif
-
-	if (atomic_read (&sem->count) == 0)
+	int count = atomic_read (&sem->count);
+	while (count > 0)
 	{
-		return 1;
+		// decrement only, if no other core took the count meanwhile
+		int prev = atomic_cmpxchg (&sem->count, count, count-1);
+		if (prev == count)
+		{
+			return 0;
+		}
+
+		count = prev;
 	}
 
-	atomic_dec (&sem->count);
-
-	return 0;
+	return 1;
 }
@@ -0,0 +1,22 @@
+#ifndef _linux_smp_h
+#define _linux_smp_h
+
+#include <circle/sysconfig.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#ifdef ARM_ALLOW_MULTI_CORE
+#define NR_CPUS		CORES
+#else
+#define NR_CPUS		1		// CORES is not defined for the Raspberry Pi 1
+#endif
+
+unsigned int smp_processor_id (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
@@ -76,6 +76,20 @@ void spin_unlock (spinlock_t *lock)
 	LeaveCritical ();
 }
 
+int spin_trylock (spinlock_t *lock)
+{
+	EnterCritical (IRQ_LEVEL);
+
+	if (__atomic_exchange_n (&lock->lock, 1, __ATOMIC_ACQUIRE) != 0)
+	{
+		LeaveCritical ();
+
+		return 0;
+	}
+
+	return 1;
+}
+
 #else
 
 void spin_lock (spinlock_t *lock)
@@ -88,4 +102,11 @@ void spin_unlock (spinlock_t *lock)
 	LeaveCritical ();
 }
 
+int spin_trylock (spinlock_t *lock)
+{
+	EnterCritical (IRQ_LEVEL);
+
+	return 1;
+}
+
 #endif
@@ -33,6 +33,17 @@ static inline void spin_lock_init (spinlock_t *lock)
 void spin_lock (spinlock_t *lock);
 void spin_unlock (spinlock_t *lock);
 
+// returns 1 if the lock has been acquired
+int spin_trylock (spinlock_t *lock);
+
+// spin_lock() disables IRQs already and nests, so no flags need to be saved
+#define spin_lock_irqsave(lock, flags)		do { (void) (flags); spin_lock (lock); } while (0)
+#define spin_unlock_irqrestore(lock, flags)	do { (void) (flags); spin_unlock (lock); } while (0)
+#define spin_lock_irq(lock)			spin_lock (lock)
+#define spin_unlock_irq(lock)			spin_unlock (lock)
+#define spin_lock_bh(lock)			spin_lock (lock)
+#define spin_unlock_bh(lock)			spin_unlock (lock)
+
 #ifdef __cplusplus
 }
 #endif
@@ -0,0 +1,484 @@
+#include <linux/workqueue.h>
+#include <linux/interrupt.h>
+#include <linux/kthread.h>
+#include <linux/jiffies.h>
+#include <linux/bug.h>
+#include <linux/smp.h>
+#include <circle/sched/scheduler.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/string.h>
+#include <circle/stdarg.h>
+
+class CWorker		// executes the work of a workqueue on one CPU core
+{
+public:
+	CWorker (unsigned nCore)
+	:	m_nCore (nCore),
+		m_pFirst (0),
+		m_pLast (0),
+		m_bStop (FALSE),
+		m_bIdle (TRUE),
+		m_pTask (0),
+		m_SpinLock (IRQ_LEVEL)
+	{
+	}
+
+	void Start (unsigned nPriority, const char *pName)
+	{
+		m_pTask = linuxemu_kthread_create (WorkerThread, this, m_nCore, nPriority, pName);
+		BUG_ON (m_pTask == 0);
+	}
+
+	void Stop (void)
+	{
+		m_bStop = TRUE;
+		m_Event.Set ();
+
+		while (!m_pTask->terminated)
+		{
+			CScheduler::Get ()->Yield ();
+		}
+	}
+
+	unsigned GetCore (void) const	{ return m_nCore; }
+
+	bool Queue (struct work_struct *work)
+	{
+		m_SpinLock.Acquire ();
+
+		if (work->queued != 0)
+		{
+			m_SpinLock.Release ();
+
+			return false;
+		}
+
+		work->queued = this;
+		work->next = 0;
+
+		if (m_pLast == 0)
+		{
+			m_pFirst = work;
+		}
+		else
+		{
+			m_pLast->next = work;
+		}
+		m_pLast = work;
+
+		m_bIdle = FALSE;
+
+		m_SpinLock.Release ();
+
+		m_Event.Set ();
+
+		return true;
+	}
+
+	bool Cancel (struct work_struct *work)
+	{
+		m_SpinLock.Acquire ();
+
+		if (work->queued != this)
+		{
+			m_SpinLock.Release ();
+
+			return false;
+		}
+
+		struct work_struct *prev = 0;
+		for (struct work_struct *w = m_pFirst; w != 0; prev = w, w = w->next)
+		{
+			if (w == work)
+			{
+				if (prev == 0)
+				{
+					m_pFirst = w->next;
+				}
+				else
+				{
+					prev->next = w->next;
+				}
+
+				if (m_pLast == w)
+				{
+					m_pLast = prev;
+				}
+
+				break;
+			}
+		}
+
+		work->queued = 0;
+		work->next = 0;
+
+		m_SpinLock.Release ();
+
+		return true;
+	}
+
+	// has all queued work been executed?
+	boolean IsIdle (void) const	{ return m_bIdle; }
+
+private:
+	void Run (void)
+	{
+		while (!m_bStop)
+		{
+			m_SpinLock.Acquire ();
+
+			struct work_struct *work = m_pFirst;
+			if (work == 0)
+			{
+				m_bIdle = TRUE;
+				m_Event.Clear ();
+
+				m_SpinLock.Release ();
+
+				m_Event.Wait ();
+
+				continue;
+			}
+
+			m_pFirst = work->next;
+			if (m_pFirst == 0)
+			{
+				m_pLast = 0;
+			}
+
+			// the work may be queued again from its function
+			__atomic_add_fetch (&work->running, 1, __ATOMIC_RELAXED);
+			work->queued = 0;
+			work->next = 0;
+
+			m_SpinLock.Release ();
+
+			(*work->func) (work);
+
+			__atomic_sub_fetch (&work->running, 1, __ATOMIC_RELEASE);
+		}
+	}
+
+	static int WorkerThread (void *data)
+	{
+		CWorker *pThis = (CWorker *) data;
+		BUG_ON (pThis == 0);
+
+		pThis->Run ();
+
+		return 0;
+	}
+
+private:
+	unsigned m_nCore;
+
+	struct work_struct *m_pFirst;
+	struct work_struct *m_pLast;
+
+	volatile boolean m_bStop;
+	volatile boolean m_bIdle;
+
+	struct task_struct *m_pTask;
+
+	CSynchronizationEvent m_Event;
+	CSpinLock m_SpinLock;
+};
+
+struct workqueue_struct
+{
+	CWorker *worker[NR_CPUS];		// 0 for cores without scheduler
+};
+
+struct workqueue_struct *system_wq = 0;
+
+static struct workqueue_struct *tasklet_wq = 0;
+
+static struct workqueue_struct *create_workqueue_internal (const char *name, unsigned int flags,
+							   unsigned priority)
+{
+	struct workqueue_struct *wq = new workqueue_struct;
+	BUG_ON (wq == 0);
+
+	for (unsigned core = 0; core < NR_CPUS; core++)
+	{
+		wq->worker[core] = 0;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+		if (   (flags & WQ_UNBOUND)
+		    && core > 0)
+		{
+			continue;
+		}
+
+		if (!CScheduler::IsActive (core))
+		{
+			continue;
+		}
+#else
+		if (core > 0)
+		{
+			continue;
+		}
+#endif
+
+		CString WorkerName;
+		WorkerName.Format ("%s/%u", name, core);
+
+		wq->worker[core] = new CWorker (core);
+		BUG_ON (wq->worker[core] == 0);
+
+		wq->worker[core]->Start (priority, WorkerName);
+	}
+
+	BUG_ON (wq->worker[0] == 0);
+
+	return wq;
+}
+
+struct workqueue_struct *alloc_workqueue (const char *fmt, unsigned int flags, int max_active, ...)
+{
+	CString name;
+	va_list var;
+	va_start (var, max_active);
+	name.FormatV (fmt, var);
+	va_end (var);
+
+	return create_workqueue_internal (name, flags,
+					  flags & WQ_HIGHPRI ? TASK_PRIORITY_HIGHEST
+							     : TASK_PRIORITY_DEFAULT);
+}
+
+void destroy_workqueue (struct workqueue_struct *wq)
+{
+	BUG_ON (wq == 0);
+
+	flush_workqueue (wq);
+
+	for (unsigned core = 0; core < NR_CPUS; core++)
+	{
+		if (wq->worker[core] != 0)
+		{
+			wq->worker[core]->Stop ();
+
+			delete wq->worker[core];
+			wq->worker[core] = 0;
+		}
+	}
+
+	delete wq;
+}
+
+bool queue_work_on (int cpu, struct workqueue_struct *wq, struct work_struct *work)
+{
+	BUG_ON (wq == 0);
+	BUG_ON (work == 0);
+	BUG_ON (work->func == 0);
+
+	if (cpu == WORK_CPU_UNBOUND)
+	{
+		cpu = smp_processor_id ();
+	}
+
+	// fall back to core 0, if there is no worker on the requested core
+	CWorker *worker = 0 <= cpu && cpu < NR_CPUS ? wq->worker[cpu] : 0;
+	if (worker == 0)
+	{
+		worker = wq->worker[0];
+	}
+
+	return worker->Queue (work);
+}
+
+void flush_workqueue (struct workqueue_struct *wq)
+{
+	BUG_ON (wq == 0);
+
+	for (unsigned core = 0; core < NR_CPUS; core++)
+	{
+		if (wq->worker[core] != 0)
+		{
+			while (!wq->worker[core]->IsIdle ())
+			{
+				CScheduler::Get ()->Yield ();
+			}
+		}
+	}
+}
+
+bool flush_work (struct work_struct *work)
+{
+	BUG_ON (work == 0);
+
+	bool ret = work->queued != 0 || work->running != 0;
+
+	while (   work->queued != 0
+	       || __atomic_load_n (&work->running, __ATOMIC_ACQUIRE) != 0)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+
+	return ret;
+}
+
+bool cancel_work_sync (struct work_struct *work)
+{
+	BUG_ON (work == 0);
+
+	bool ret = false;
+
+	CWorker *worker = (CWorker *) work->queued;
+	if (worker != 0)
+	{
+		ret = worker->Cancel (work);
+	}
+
+	while (__atomic_load_n (&work->running, __ATOMIC_ACQUIRE) != 0)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+
+	return ret;
+}
+
+static void delayed_work_timer_fn (unsigned long data)
+{
+	struct delayed_work *dwork = (struct delayed_work *) data;
+	BUG_ON (dwork == 0);
+
+	queue_work_on (dwork->cpu, dwork->wq, &dwork->work);
+}
+
+void linuxemu_delayed_work_init (struct delayed_work *dwork)
+{
+	init_timer (&dwork->timer);
+	dwork->timer.function = delayed_work_timer_fn;
+	dwork->timer.data = (unsigned long) dwork;
+
+	dwork->wq = 0;
+	dwork->cpu = WORK_CPU_UNBOUND;
+}
+
+bool queue_delayed_work_on (int cpu, struct workqueue_struct *wq,
+			    struct delayed_work *dwork, unsigned long delay)
+{
+	BUG_ON (dwork == 0);
+
+	if (   dwork->work.queued != 0
+	    || dwork->timer.entry.next != &dwork->timer.entry)
+	{
+		return false;
+	}
+
+	if (cpu == WORK_CPU_UNBOUND)
+	{
+		cpu = smp_processor_id ();
+	}
+
+	if (delay == 0)
+	{
+		return queue_work_on (cpu, wq, &dwork->work);
+	}
+
+	dwork->wq = wq;
+	dwork->cpu = cpu;
+
+	dwork->timer.expires = jiffies + delay;
+	add_timer (&dwork->timer);
+
+	return true;
+}
+
+bool cancel_delayed_work_sync (struct delayed_work *dwork)
+{
+	BUG_ON (dwork == 0);
+
+	bool ret = del_timer (&dwork->timer) != 0;
+
+	return cancel_work_sync (&dwork->work) || ret;
+}
+
+#define TASKLET_STATE_SCHED	(1 << 0)	// scheduled for execution
+#define TASKLET_STATE_RUN	(1 << 1)	// executing
+
+static void tasklet_work_fn (struct work_struct *work)
+{
+	struct tasklet_struct *t = container_of (work, struct tasklet_struct, work);
+
+	if (__atomic_load_n (&t->count, __ATOMIC_ACQUIRE) != 0)
+	{
+		return;				// disabled, tasklet_enable() reschedules it
+	}
+
+	__atomic_fetch_or (&t->state, TASKLET_STATE_RUN, __ATOMIC_ACQUIRE);
+	__atomic_fetch_and (&t->state, ~TASKLET_STATE_SCHED, __ATOMIC_RELEASE);
+
+	(*t->func) (t->data);
+
+	__atomic_fetch_and (&t->state, ~TASKLET_STATE_RUN, __ATOMIC_RELEASE);
+}
+
+void tasklet_init (struct tasklet_struct *t, void (*func) (unsigned long), unsigned long data)
+{
+	BUG_ON (t == 0);
+
+	INIT_WORK (&t->work, tasklet_work_fn);
+	t->state = 0;
+	t->count = 0;
+	t->func = func;
+	t->data = data;
+}
+
+void tasklet_schedule (struct tasklet_struct *t)
+{
+	BUG_ON (t == 0);
+	BUG_ON (tasklet_wq == 0);
+
+	// runs on the calling core, like with Linux
+	if (!(__atomic_fetch_or (&t->state, TASKLET_STATE_SCHED, __ATOMIC_ACQ_REL)
+	      & TASKLET_STATE_SCHED))
+	{
+		queue_work_on (WORK_CPU_UNBOUND, tasklet_wq, &t->work);
+	}
+}
+
+void tasklet_disable (struct tasklet_struct *t)
+{
+	BUG_ON (t == 0);
+
+	__atomic_add_fetch (&t->count, 1, __ATOMIC_ACQ_REL);
+
+	while (__atomic_load_n (&t->state, __ATOMIC_ACQUIRE) & TASKLET_STATE_RUN)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+}
+
+void tasklet_enable (struct tasklet_struct *t)
+{
+	BUG_ON (t == 0);
+
+	if (   __atomic_sub_fetch (&t->count, 1, __ATOMIC_ACQ_REL) == 0
+	    && (__atomic_load_n (&t->state, __ATOMIC_ACQUIRE) & TASKLET_STATE_SCHED))
+	{
+		queue_work_on (WORK_CPU_UNBOUND, tasklet_wq, &t->work);
+	}
+}
+
+void tasklet_kill (struct tasklet_struct *t)
+{
+	BUG_ON (t == 0);
+
+	cancel_work_sync (&t->work);
+
+	__atomic_store_n (&t->state, 0, __ATOMIC_RELEASE);
+}
+
+int linuxemu_init_workqueue (void)
+{
+	system_wq = create_workqueue_internal ("events", 0, TASK_PRIORITY_DEFAULT);
+	tasklet_wq = create_workqueue_internal ("tasklet", 0, TASK_PRIORITY_HIGHEST);
+
+	return 0;
+}
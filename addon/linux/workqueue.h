@@ -0,0 +1,121 @@
+#ifndef _linux_workqueue_h
+#define _linux_workqueue_h
+
+#include <linux/kernel.h>
+#include <linux/timer.h>
+#include <linux/types.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+struct work_struct;
+struct workqueue_struct;
+
+typedef void (*work_func_t) (struct work_struct *work);
+
+struct work_struct
+{
+	struct work_struct *next;
+	work_func_t func;
+	void * volatile queued;		// worker, on which the work is pending, or 0
+	volatile int running;		// number of workers executing it
+};
+
+#define INIT_WORK(_work, _func)					\
+	do							\
+	{							\
+		(_work)->next = 0;				\
+		(_work)->func = (_func);			\
+		(_work)->queued = 0;				\
+		(_work)->running = 0;				\
+	}							\
+	while (0)
+
+struct delayed_work
+{
+	struct work_struct work;
+	struct timer_list timer;
+	struct workqueue_struct *wq;
+	int cpu;
+};
+
+void linuxemu_delayed_work_init (struct delayed_work *dwork);
+
+#define INIT_DELAYED_WORK(_dwork, _func)			\
+	do							\
+	{							\
+		INIT_WORK (&(_dwork)->work, (_func));		\
+		linuxemu_delayed_work_init (_dwork);		\
+	}							\
+	while (0)
+
+static inline struct delayed_work *to_delayed_work (struct work_struct *work)
+{
+	return container_of (work, struct delayed_work, work);
+}
+
+#define WORK_CPU_UNBOUND	(-1)	// queue on the calling core
+
+#define WQ_UNBOUND		(1 << 1)	// one worker on core 0 only
+#define WQ_HIGHPRI		(1 << 4)
+
+struct workqueue_struct *alloc_workqueue (const char *fmt, unsigned int flags, int max_active, ...);
+
+#define create_workqueue(name)			alloc_workqueue ("%s", 0, 1, (name))
+#define create_singlethread_workqueue(name)	alloc_workqueue ("%s", WQ_UNBOUND, 1, (name))
+
+void destroy_workqueue (struct workqueue_struct *wq);
+
+// return true, if the work has been queued, false if it was already pending
+bool queue_work_on (int cpu, struct workqueue_struct *wq, struct work_struct *work);
+bool queue_delayed_work_on (int cpu, struct workqueue_struct *wq,
+			    struct delayed_work *dwork, unsigned long delay);
+
+static inline bool queue_work (struct workqueue_struct *wq, struct work_struct *work)
+{
+	return queue_work_on (WORK_CPU_UNBOUND, wq, work);
+}
+
+static inline bool queue_delayed_work (struct workqueue_struct *wq,
+				       struct delayed_work *dwork, unsigned long delay)
+{
+	return queue_delayed_work_on (WORK_CPU_UNBOUND, wq, dwork, delay);
+}
+
+void flush_workqueue (struct workqueue_struct *wq);
+
+// return true, if the work was pending
+bool flush_work (struct work_struct *work);
+bool cancel_work_sync (struct work_struct *work);
+bool cancel_delayed_work_sync (struct delayed_work *dwork);
+
+extern struct workqueue_struct *system_wq;
+
+static inline bool schedule_work (struct work_struct *work)
+{
+	return queue_work (system_wq, work);
+}
+
+static inline bool schedule_work_on (int cpu, struct work_struct *work)
+{
+	return queue_work_on (cpu, system_wq, work);
+}
+
+static inline bool schedule_delayed_work (struct delayed_work *dwork, unsigned long delay)
+{
+	return queue_delayed_work (system_wq, dwork, delay);
+}
+
+static inline void flush_scheduled_work (void)
+{
+	flush_workqueue (system_wq);
+}
+
+int linuxemu_init_workqueue (void);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif
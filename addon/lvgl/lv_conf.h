@@ -120,10 +120,16 @@
  * - LV_OS_MQX
  * - LV_OS_SDL2
  * - LV_OS_CUSTOM */
-#define LV_USE_OS   LV_OS_NONE
+/* Circle: The secondary cores are used as draw units, if ARM_ALLOW_MULTI_CORE is defined
+ * in Config.mk (DEFINE += -DARM_ALLOW_MULTI_CORE). See CLVGL::RunDrawUnit(). */
+#ifdef ARM_ALLOW_MULTI_CORE
+    #define LV_USE_OS   LV_OS_CUSTOM
+#else
+    #define LV_USE_OS   LV_OS_NONE
+#endif
 
 #if LV_USE_OS == LV_OS_CUSTOM
-    #define LV_OS_CUSTOM_INCLUDE <stdint.h>
+    #define LV_OS_CUSTOM_INCLUDE <lvgl/lv_os_circle.h>
 #endif
 #if LV_USE_OS == LV_OS_FREERTOS
     /*
@@ -205,7 +211,11 @@
     /** Set number of draw units.
      *  - > 1 requires operating system to be enabled in `LV_USE_OS`.
      *  - > 1 means multiple threads will render the screen in parallel. */
-    #define LV_DRAW_SW_DRAW_UNIT_CNT    1
+    #if LV_USE_OS == LV_OS_CUSTOM
+        #define LV_DRAW_SW_DRAW_UNIT_CNT    3       /* one per secondary core */
+    #else
+        #define LV_DRAW_SW_DRAW_UNIT_CNT    1
+    #endif
 
     /** Use Arm-2D to accelerate software (sw) rendering. */
     #define LV_USE_DRAW_ARM2D_SYNC      0
@@ -231,7 +241,12 @@
         #define LV_DRAW_SW_CIRCLE_CACHE_SIZE 4
     #endif
 
-    #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_NONE
+    /* Circle: NEON is available on all models, but the Raspberry Pi 1 and Zero. */
+    #ifdef __ARM_NEON
+        #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_NEON
+    #else
+        #define  LV_USE_DRAW_SW_ASM     LV_DRAW_SW_ASM_NONE
+    #endif
 
     #if LV_USE_DRAW_SW_ASM == LV_DRAW_SW_ASM_CUSTOM
         #define  LV_DRAW_SW_ASM_CUSTOM_INCLUDE ""
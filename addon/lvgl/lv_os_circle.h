@@ -0,0 +1,46 @@
+//
+// lv_os_circle.h
+//
+// Types for LV_USE_OS == LV_OS_CUSTOM (see: lvgl.cpp)
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _lvgl_lv_os_circle_h
+#define _lvgl_lv_os_circle_h
+
+// This file is included from C code of LVGL too.
+
+typedef struct			// runs on a secondary core
+{
+	unsigned nCore;
+}
+lv_thread_t;
+
+typedef struct			// recursive spin lock, shared by all cores
+{
+	volatile int nOwner;	// core number + 1, or 0 if free
+	unsigned nCount;
+}
+lv_mutex_t;
+
+typedef struct
+{
+	volatile int nSignaled;
+}
+lv_thread_sync_t;
+
+#endif
@@ -25,9 +25,27 @@
 #include <circle/string.h>
 #include <circle/util.h>
 #include <circle/new.h>
+#ifdef ARM_ALLOW_MULTI_CORE
+	#include <circle/multicore.h>
+	#include <circle/synchronize.h>
+	#include <circle/atomic.h>
+	#include <lvgl/lvgl/src/osal/lv_os_private.h>
+#endif
 
 CLVGL *CLVGL::s_pThis = 0;
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+static struct TDrawThread
+{
+	void (*pCallback) (void *);
+	void *pUserData;
+	volatile int nAssigned;
+}
+s_DrawThread[CORES];
+
+#endif
+
 CLVGL::CLVGL (CScreenDevice *pScreen)
 :	m_pBuffer1 (0),
 	m_pBuffer2 (0),
@@ -231,6 +249,32 @@ void CLVGL::Update (boolean bPlugAndPlayUpdated)
 	}
 }
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+void CLVGL::RunDrawUnit (unsigned nCore)
+{
+	assert (1 <= nCore && nCore < CORES);
+	TDrawThread *pThread = &s_DrawThread[nCore];
+
+	while (1)
+	{
+		while (!AtomicGet (&pThread->nAssigned))
+		{
+			WaitForEvent ();
+		}
+
+		DataMemBarrier ();
+
+		// returns, when the draw unit is deleted
+		assert (pThread->pCallback != 0);
+		(*pThread->pCallback) (pThread->pUserData);
+
+		AtomicSet (&pThread->nAssigned, 0);
+	}
+}
+
+#endif
+
 void CLVGL::DisplayFlush (lv_display_t *pDisplay, const lv_area_t *pArea, u8 *pBuffer)
 {
 	assert (s_pThis != 0);
@@ -434,3 +478,149 @@ void CLVGL::SetupCursor (lv_indev_t *pIndev)
 		lv_indev_set_cursor (pIndev, pCursorImage);
 	}
 }
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+// LVGL OS abstraction layer for LV_OS_CUSTOM
+
+lv_result_t lv_thread_init (lv_thread_t *pThread, const char *const pName, lv_thread_prio_t Prio,
+			    void (*pCallback) (void *), size_t nStackSize, void *pUserData)
+{
+	assert (pThread != 0);
+	assert (pCallback != 0);
+
+	// each thread gets its own secondary core, the stack of this core is used
+	for (unsigned nCore = 1; nCore < CORES; nCore++)
+	{
+		TDrawThread *pDrawThread = &s_DrawThread[nCore];
+		if (AtomicGet (&pDrawThread->nAssigned))
+		{
+			continue;
+		}
+
+		pDrawThread->pCallback = pCallback;
+		pDrawThread->pUserData = pUserData;
+
+		DataSyncBarrier ();
+
+		AtomicSet (&pDrawThread->nAssigned, 1);
+		SendEvent ();
+
+		pThread->nCore = nCore;
+
+		return LV_RESULT_OK;
+	}
+
+	return LV_RESULT_INVALID;
+}
+
+lv_result_t lv_thread_delete (lv_thread_t *pThread)
+{
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_mutex_init (lv_mutex_t *pMutex)
+{
+	assert (pMutex != 0);
+	pMutex->nOwner = 0;
+	pMutex->nCount = 0;
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_mutex_lock (lv_mutex_t *pMutex)
+{
+	assert (pMutex != 0);
+	int nOwner = CMultiCoreSupport::ThisCore () + 1;
+
+	if (AtomicGet (&pMutex->nOwner) != nOwner)
+	{
+		while (AtomicCompareExchange (&pMutex->nOwner, 0, nOwner) != 0)
+		{
+			// just wait
+		}
+
+		DataMemBarrier ();
+	}
+
+	pMutex->nCount++;
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_mutex_lock_isr (lv_mutex_t *pMutex)
+{
+	return lv_mutex_lock (pMutex);
+}
+
+lv_result_t lv_mutex_unlock (lv_mutex_t *pMutex)
+{
+	assert (pMutex != 0);
+	assert (AtomicGet (&pMutex->nOwner) == (int) CMultiCoreSupport::ThisCore () + 1);
+	assert (pMutex->nCount > 0);
+
+	if (--pMutex->nCount == 0)
+	{
+		DataMemBarrier ();
+
+		AtomicSet (&pMutex->nOwner, 0);
+	}
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_mutex_delete (lv_mutex_t *pMutex)
+{
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_thread_sync_init (lv_thread_sync_t *pSync)
+{
+	assert (pSync != 0);
+	pSync->nSignaled = 0;
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_thread_sync_wait (lv_thread_sync_t *pSync)
+{
+	assert (pSync != 0);
+
+	while (!AtomicExchange (&pSync->nSignaled, 0))
+	{
+		WaitForEvent ();
+	}
+
+	DataMemBarrier ();
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_thread_sync_signal (lv_thread_sync_t *pSync)
+{
+	assert (pSync != 0);
+
+	DataSyncBarrier ();
+
+	AtomicSet (&pSync->nSignaled, 1);
+	SendEvent ();
+
+	return LV_RESULT_OK;
+}
+
+lv_result_t lv_thread_sync_signal_isr (lv_thread_sync_t *pSync)
+{
+	return lv_thread_sync_signal (pSync);
+}
+
+lv_result_t lv_thread_sync_delete (lv_thread_sync_t *pSync)
+{
+	return LV_RESULT_OK;
+}
+
+uint32_t lv_os_get_idle_percent (void)
+{
+	return lv_timer_get_idle ();
+}
+
+#endif
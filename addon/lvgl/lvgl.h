@@ -29,6 +29,7 @@
 #include <circle/input/mouse.h>
 #include <circle/input/touchscreen.h>
 #include <circle/dmachannel.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
 
@@ -43,6 +44,14 @@ public:
 
 	void Update (boolean bPlugAndPlayUpdated = FALSE);
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	/// \brief Renders the tiles of a LVGL draw unit on this core
+	/// \param nCore Number of this secondary core (1..CORES-1)
+	/// \note Must be called from CMultiCoreSupport::Run() on all secondary cores,
+	///	  because LVGL waits for its draw units. Does not return.
+	static void RunDrawUnit (unsigned nCore);
+#endif
+
 private:
 	static void DisplayFlush (lv_display_t *pDisplay, const lv_area_t *pArea, u8 *pBuffer);
 	static void DisplayFlushComplete (void *pParam);
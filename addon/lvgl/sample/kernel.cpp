@@ -126,6 +126,13 @@ boolean CKernel::Initialize (void)
 		bOK = m_GUI.Initialize ();
 	}
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (bOK)
+	{
+		bOK = m_DrawCores.Initialize ();
+	}
+#endif
+
 	return bOK;
 }
 
@@ -32,6 +32,8 @@
 #include <circle/usb/usbhcidevice.h>
 #include <circle/input/rpitouchscreen.h>
 #include <lvgl/lvgl.h>
+#include <circle/multicore.h>
+#include <circle/memory.h>
 #include <circle/types.h>
 
 #ifdef SPI_DISPLAY
@@ -49,6 +51,27 @@ enum TShutdownMode
 	ShutdownReboot
 };
 
+#ifdef ARM_ALLOW_MULTI_CORE
+
+class CDrawCores : public CMultiCoreSupport	// LVGL renders on the secondary cores
+{
+public:
+	CDrawCores (void)
+	:	CMultiCoreSupport (CMemorySystem::Get ())
+	{
+	}
+
+	void Run (unsigned nCore)
+	{
+		if (nCore > 0)
+		{
+			CLVGL::RunDrawUnit (nCore);
+		}
+	}
+};
+
+#endif
+
 class CKernel
 {
 public:
@@ -83,6 +106,10 @@ private:
 #endif
 
 	CLVGL			m_GUI;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	CDrawCores		m_DrawCores;
+#endif
 };
 
 #endif
@@ -1,7 +1,7 @@
 #
 # microbit-server.py
 #
-# by R. Stange, 2020
+# by R. Stange, 2020-2026
 #
 
 #
@@ -16,6 +16,12 @@
 # Server returns:
 #	'OK\n' | 'ERROR\n' | ['-']Number '\n'
 #
+# Streaming mode ('!ST:ON:' PeriodMs '\n' starts, '!ST:OF\n' stops it):
+#	Server pushes binary sensor frames in addition to the replies:
+#	0xA5 0x5A 8 AccelX AccelY AccelZ Buttons Sequence Checksum
+#	(AccelX/Y/Z are signed 16-bit little endian, Buttons bit 0 is A, bit 1 is B,
+#	 Checksum is the XOR of the length and the payload bytes)
+#
 
 from microbit import *
 
@@ -41,9 +47,39 @@ def send_result_bool (b):
     else:
         send_result ('0')
 
+stream_period = 0
+stream_next = 0
+stream_seq = 0
+
+def send_frame ():
+    global stream_seq
+    x = accelerometer.get_x () & 0xFFFF
+    y = accelerometer.get_y () & 0xFFFF
+    z = accelerometer.get_z () & 0xFFFF
+    bt = 0
+    if button_a.is_pressed ():
+        bt |= 1
+    if button_b.is_pressed ():
+        bt |= 2
+    frame = [8, x & 0xFF, x >> 8, y & 0xFF, y >> 8, z & 0xFF, z >> 8, bt, stream_seq]
+    cs = 0
+    for b in frame:
+        cs ^= b
+    frame.append (cs)
+    uart.write (bytes ([0xA5, 0x5A] + frame))
+    stream_seq = (stream_seq + 1) & 0xFF
+
 def mainloop ():
+    global stream_next
     state = 0
     while True:
+        if stream_period > 0:
+            now = running_time ()
+            if now - stream_next >= 0:
+                send_frame ()
+                stream_next += stream_period
+                if now - stream_next >= 0:
+                    stream_next = now + stream_period
         if uart.any ():
             buf = str (uart.read (20), 'UTF-8')
             for i in range (len (buf)):
@@ -71,6 +107,7 @@ def execute (cmd):
         elif obj == 'PI':   execute_pin (fn, par)
         elif obj == 'AC':   execute_accelerometer (fn, par)
         elif obj == 'CO':   execute_compass (fn, par)
+        elif obj == 'ST':   execute_stream (fn, par)
         else:               raise
     except:
         send_error ()
@@ -202,6 +239,21 @@ def execute_compass (fn, par):
     else:
         raise
 
+def execute_stream (fn, par):
+    global stream_period, stream_next
+    if fn == "ON":
+        period = int (par[0])
+        if period < 1:
+            raise
+        send_ok ()
+        stream_period = period
+        stream_next = running_time () + period
+    elif fn == "OF":
+        stream_period = 0
+        send_ok ()
+    else:
+        raise
+
 def main ():
     init ()
     mainloop ()
@@ -2,7 +2,7 @@
 // microbitclient.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -28,9 +28,26 @@
 
 static const char From[] = "microbit";
 
+// Frame format in streaming mode (multi-byte values are little endian):
+//	0xA5 0x5A Length(8) AccelX(s16) AccelY(s16) AccelZ(s16) Buttons(u8) Sequence(u8) Checksum
+// The checksum is the XOR of the length and payload bytes. Replies to commands are
+// ASCII text lines, which cannot contain the first sync byte.
+#define FRAME_SYNC1		0xA5
+#define FRAME_SYNC2		0x5A
+#define FRAME_PAYLOAD_SIZE	8
+#define FRAME_SIZE		(3 + FRAME_PAYLOAD_SIZE + 1)
+
+#define FRAME_BUTTON_A		(1 << 0)
+#define FRAME_BUTTON_B		(1 << 1)
+
 CMicrobitClient::CMicrobitClient (const char *pDeviceName)
 :	m_DeviceName (pDeviceName),
-	m_pMicrobit (0)
+	m_pMicrobit (0),
+	m_bStreaming (FALSE),
+	m_bFrameValid (FALSE),
+	m_nLostFrames (0),
+	m_nRxCount (0),
+	m_bTextLineComplete (FALSE)
 {
 }
 
@@ -429,6 +446,213 @@ int CMicrobitClient::GetFieldStrength (void)
 	return ReceiveInteger ();
 }
 
+int CMicrobitClient::StartStreaming (unsigned nPeriodMs)
+{
+	assert (!m_bStreaming);
+
+	if (nPeriodMs < MICROBIT_STREAM_PERIOD_MIN_MS)
+	{
+		nPeriodMs = MICROBIT_STREAM_PERIOD_MIN_MS;
+	}
+
+	CString Cmd;
+	Cmd.Format ("!ST:ON:%u\n", nPeriodMs);
+
+	m_nRxCount = 0;
+	m_bFrameValid = FALSE;
+	m_nLostFrames = 0;
+
+	// the first frames may follow the reply immediately
+	m_bStreaming = TRUE;
+
+	if (!SendCommand (Cmd))
+	{
+		m_bStreaming = FALSE;
+
+		return MICROBIT_ERROR;
+	}
+
+	int nResult = CheckStreamStatus ();
+	if (nResult != MICROBIT_OK)
+	{
+		m_bStreaming = FALSE;
+	}
+
+	return nResult;
+}
+
+int CMicrobitClient::StopStreaming (void)
+{
+	assert (m_bStreaming);
+
+	int nResult = MICROBIT_ERROR;
+	if (SendCommand ("!ST:OF\n"))
+	{
+		nResult = CheckStreamStatus ();
+	}
+
+	m_bStreaming = FALSE;
+	m_nRxCount = 0;
+
+	return nResult;
+}
+
+boolean CMicrobitClient::UpdateStream (void)
+{
+	assert (m_bStreaming);
+	assert (m_pMicrobit != 0);
+
+	boolean bNewFrame = FALSE;
+
+	while (1)
+	{
+		assert (m_nRxCount < RxBufferSize);
+		int nResult = m_pMicrobit->Read (m_RxBuffer + m_nRxCount, RxBufferSize - m_nRxCount);
+		if (nResult <= 0)
+		{
+			if (nResult < 0)
+			{
+				CLogger::Get ()->Write (From, LogError, "Read error");
+
+				m_bStreaming = FALSE;
+			}
+
+			break;
+		}
+
+		m_nRxCount += nResult;
+
+		if (DecodeStream ())
+		{
+			bNewFrame = TRUE;
+		}
+	}
+
+	return bNewFrame;
+}
+
+boolean CMicrobitClient::GetSensorFrame (TMicrobitSensorFrame *pFrame) const
+{
+	assert (pFrame != 0);
+
+	if (!m_bFrameValid)
+	{
+		return FALSE;
+	}
+
+	*pFrame = m_Frame;
+
+	return TRUE;
+}
+
+int CMicrobitClient::CheckStreamStatus (void)
+{
+	m_TextLine = "";
+	m_bTextLineComplete = FALSE;
+
+	// frames may arrive before and after the reply
+	while (!m_bTextLineComplete)
+	{
+		if (   !UpdateStream ()
+		    && !m_bTextLineComplete
+		    && CScheduler::IsActive ())
+		{
+			CScheduler::Get ()->Yield ();
+		}
+
+		if (!m_bStreaming)
+		{
+			return MICROBIT_ERROR;		// read error
+		}
+	}
+
+	if (m_TextLine.Compare ("OK") != 0)
+	{
+		return MICROBIT_ERROR;
+	}
+
+	return MICROBIT_OK;
+}
+
+boolean CMicrobitClient::DecodeStream (void)
+{
+	boolean bNewFrame = FALSE;
+
+	unsigned i = 0;
+	while (i < m_nRxCount)
+	{
+		const u8 *pFrame = &m_RxBuffer[i];
+		if (pFrame[0] != FRAME_SYNC1)
+		{
+			if (pFrame[0] == '\n')
+			{
+				m_bTextLineComplete = TRUE;
+			}
+			else if (!m_bTextLineComplete)
+			{
+				m_TextLine.Append ((char) pFrame[0]);
+			}
+
+			i++;
+
+			continue;
+		}
+
+		if (m_nRxCount - i < FRAME_SIZE)
+		{
+			break;			// wait for the rest of the frame
+		}
+
+		u8 uchChecksum = 0;
+		for (unsigned j = 2; j < FRAME_SIZE; j++)
+		{
+			uchChecksum ^= pFrame[j];
+		}
+
+		if (   pFrame[1] != FRAME_SYNC2
+		    || pFrame[2] != FRAME_PAYLOAD_SIZE
+		    || uchChecksum != 0)
+		{
+			m_nLostFrames++;
+
+			i++;			// resynchronize
+
+			continue;
+		}
+
+		// decode the frame directly from the receive buffer
+		const u8 *pPayload = &pFrame[3];
+
+		unsigned nSequence = pPayload[7];
+		if (   m_bFrameValid
+		    && nSequence != ((m_Frame.nSequence + 1) & 0xFF))
+		{
+			m_nLostFrames += (nSequence - m_Frame.nSequence - 1) & 0xFF;
+		}
+
+		m_Frame.nAccelX = (s16) (pPayload[0] | pPayload[1] << 8);
+		m_Frame.nAccelY = (s16) (pPayload[2] | pPayload[3] << 8);
+		m_Frame.nAccelZ = (s16) (pPayload[4] | pPayload[5] << 8);
+		m_Frame.bButtonA = pPayload[6] & FRAME_BUTTON_A ? TRUE : FALSE;
+		m_Frame.bButtonB = pPayload[6] & FRAME_BUTTON_B ? TRUE : FALSE;
+		m_Frame.nSequence = nSequence;
+
+		m_bFrameValid = TRUE;
+		bNewFrame = TRUE;
+
+		i += FRAME_SIZE;
+	}
+
+	// keep an incomplete frame for the next call
+	m_nRxCount -= i;
+	if (m_nRxCount > 0)
+	{
+		memmove (m_RxBuffer, &m_RxBuffer[i], m_nRxCount);
+	}
+
+	return bNewFrame;
+}
+
 boolean CMicrobitClient::SendCommand (const char *pCommand)
 {
 	assert (m_pMicrobit != 0);
@@ -2,7 +2,7 @@
 // microbitclient.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -30,6 +30,16 @@
 #define MICROBIT_FALSE		0
 #define MICROBIT_TRUE		1
 
+struct TMicrobitSensorFrame		// pushed by the micro:bit in streaming mode
+{
+	int	nAccelX;		// milli-g
+	int	nAccelY;
+	int	nAccelZ;
+	boolean	bButtonA;		// currently pressed?
+	boolean	bButtonB;
+	unsigned nSequence;		// 0..255, incremented with each frame
+};
+
 class CMicrobitClient
 {
 public:
@@ -99,6 +109,18 @@ public:
 	int GetHeading (void);			// return 0..360 (0 is north)
         int GetFieldStrength (void);		// returns nano tesla
 
+	// Streaming mode
+#define MICROBIT_STREAM_PERIOD_MIN_MS	2
+	// the micro:bit pushes sensor frames with this period, other commands are not allowed
+	int StartStreaming (unsigned nPeriodMs = 5);
+	int StopStreaming (void);
+	// decode the frames received so far (does not block), returns TRUE if a new frame arrived
+	boolean UpdateStream (void);
+	// returns FALSE, if no frame has been received yet
+	boolean GetSensorFrame (TMicrobitSensorFrame *pFrame) const;
+	// number of frames lost (sequence gaps) or rejected (invalid checksum)
+	unsigned GetLostFrames (void) const	{ return m_nLostFrames; }
+
 private:
 	boolean SendCommand (const char *pCommand);
 	boolean ReceiveResult (CString *pResult);
@@ -109,10 +131,28 @@ private:
 
 	static int ConvertInteger (const char *pString);
 
+	// wait for "OK" reply, while frames are decoded
+	int CheckStreamStatus (void);
+
+	// decode frames in m_RxBuffer in place, collect other characters into m_TextLine
+	boolean DecodeStream (void);			// returns TRUE if a new frame arrived
+
 private:
 	CString m_DeviceName;
 
 	CUSBSerialDevice *m_pMicrobit;
+
+	boolean m_bStreaming;
+	TMicrobitSensorFrame m_Frame;
+	boolean m_bFrameValid;
+	unsigned m_nLostFrames;
+
+	static const unsigned RxBufferSize = 256;
+	u8 m_RxBuffer[RxBufferSize];
+	unsigned m_nRxCount;
+
+	CString m_TextLine;			// reply received in streaming mode
+	boolean m_bTextLineComplete;
 };
 
 #endif
@@ -5,8 +5,8 @@
 //
 // Support for:
 //	Tested with NVMe v1.4 only, v1.3 may also work
-//	One I/O queue only
-//	512 Byte LBA size format only
+//	One I/O queue pair per core, INTx interrupt only
+//	512 Byte to 4KB LBA size formats (partition devices with 512 Byte only)
 //	4KB page size only
 //	Namespace with NSID 1 only
 //	Controller Identifier (CNTID) 0 only
@@ -32,12 +32,15 @@
 #include <nvme/nvmehelper.h>
 #include <circle/devicenameservice.h>
 #include <circle/sysconfig.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
 #include <circle/memory.h>
 #include <circle/memio.h>
 #include <circle/logger.h>
 #include <circle/timer.h>
 #include <circle/macros.h>
 #include <circle/util.h>
+#include <circle/new.h>
 #include <assert.h>
 
 #ifdef NO_BUSY_WAIT
@@ -58,6 +61,7 @@
 	#define NVME_REG_CAP_DSTRD__MASK	(0x0FUL << 32)
 	#define NVME_REG_CAP_TO__SHIFT		24
 	#define NVME_REG_CAP_TO__MASK		(0xFF << 24)
+	#define NVME_REG_CAP_MQES__MASK		0xFFFF
 #define NVME_REG_VER			0x0008
 	#define NVME_REG_VER_MJR__SHIFT		16
 	#define NVME_REG_VER_MJR__MASK		(0xFFFF << 16)
@@ -95,21 +99,46 @@
 #define NVME_ADMIN_OPC_CREATE_IO_SQ	0x01
 #define NVME_ADMIN_OPC_CREATE_IO_CQ	0x05
 #define NVME_ADMIN_OPC_IDENTIFY		0x06
+#define NVME_ADMIN_OPC_SET_FEATURES	0x09
+
+// Feature Identifiers
+#define NVME_FEATURE_NUMBER_OF_QUEUES	0x07
 
 // NVM Command Opcodes
 #define NVME_IO_OPC_FLUSH		0x00
 #define NVME_IO_OPC_WRITE 		0x01
 #define NVME_IO_OPC_READ		0x02
+#define NVME_IO_OPC_DSM			0x09
+
+// Dataset Management
+#define NVME_DSM_ATTR_DEALLOCATE	(1 << 2)
+#define NVME_DSM_MAX_RANGES		256
+#define NVME_DSM_MAX_BLOCKS		0xFFFFFFFFU	// per range
+
+struct TNVMeDSMRange
+{
+	u32	nContextAttributes;
+	u32	nBlocks;
+	u64	ulStartLba;
+}
+PACKED;
+
+// Optional NVM Command Support (Identify Controller)
+#define NVME_ONCS_DSM			(1 << 2)
 
 // Identifier
 #define NSID				1	// ID of our only supported namespace
 
 #define AQID				0	// ID of Admin queue (fixed)
-#define IOQID				1	// ID of our only I/O queue (submission / completion)
+#define IOQID(index)			((index) + 1)	// ID of I/O queue pair (submission / completion)
+
+#define NO_SLOT				0xFFFF
 
 // Constants for queue sizes
 #define NVME_ADMIN_QUEUE_ENTRIES	64
-#define NVME_IO_QUEUE_ENTRIES		64
+#define NVME_IO_QUEUE_ENTRIES		256	// Limited by CAP.MQES
+
+#define NVME_MAX_TRANSFER		MEGABYTE	// Limited by MDTS
 
 #define POLL_TIMEOUT_HZ			MSEC2HZ(5000)
 
@@ -183,22 +212,27 @@ CNVMeDevice::CNVMeDevice(CInterruptSystem *pInterrupt)
 : 	m_PCIeExternal (PCIE_BUS_NVME, pInterrupt),
 	m_Allocator (CMemorySystem::GetCoherentPage (COHERENT_SLOT_NVME),
 		     CMemorySystem::GetCoherentPage (COHERENT_SLOT_NVME + 1)),
-#ifdef NO_BUSY_WAIT
 	m_pInterrupt(pInterrupt),
 	m_bIRQConnected(false),
-#endif
+	m_bMSIX(false),
+	m_ulMaxTransfer(NVME_MAX_TRANSFER),
+	m_bDeallocate(false),
+	m_nIoQueues(0),
+	m_ulLBASize(NVME_MIN_LBA_SIZE),
 	m_ulOffset(0),
 	m_pPartitionManager(nullptr)
 {
-	memset(&m_AdminQueue, 0, sizeof m_AdminQueue);
-	m_AdminQueue.pName = "Admin";
-	m_AdminQueue.usID = AQID;
-	m_AdminQueue.nEntries = NVME_ADMIN_QUEUE_ENTRIES;
+	InitQueue(&m_AdminQueue, "Admin", AQID, 0);
 
-	memset(&m_IoQueue, 0, sizeof m_IoQueue);
-	m_IoQueue.pName = "I/O";
-	m_IoQueue.usID = IOQID;
-	m_IoQueue.nEntries = NVME_IO_QUEUE_ENTRIES;
+	for (unsigned i = 0; i < NVME_IO_QUEUES; i++)
+	{
+		InitQueue(&m_IoQueue[i], "I/O", IOQID(i), 0);
+	}
+
+	for (unsigned i = 0; i < NVME_MSIX_VECTORS; i++)
+	{
+		m_nMSIVector[i] = -1;
+	}
 }
 
 CNVMeDevice::~CNVMeDevice(void)
@@ -206,7 +240,6 @@ CNVMeDevice::~CNVMeDevice(void)
 	delete m_pPartitionManager;
 	m_pPartitionManager = nullptr;
 
-#ifdef NO_BUSY_WAIT
 	if (m_bIRQConnected)
 	{
 		MmioWrite32(NVME_REG_INTMS, NVME_REG_INTM_ALL_VECTORS);
@@ -216,7 +249,11 @@ CNVMeDevice::~CNVMeDevice(void)
 
 		m_bIRQConnected = false;
 	}
-#endif
+
+	if (m_bMSIX)
+	{
+		DisconnectMSIX();
+	}
 
         // Reset controller
         MmioWrite32(NVME_REG_CC, MmioRead32(NVME_REG_CC) & ~NVME_REG_CC_EN);
@@ -234,17 +271,14 @@ CNVMeDevice::~CNVMeDevice(void)
 		m_AdminQueue.pCqVirt = nullptr;
 	}
 
-	if (m_IoQueue.pSqVirt)
-	{
-		m_Allocator.Free(m_IoQueue.pSqVirt);
-		m_IoQueue.pSqVirt = nullptr;
-	}
+	FreeQueue(&m_AdminQueue);
 
-	if (m_IoQueue.pCqVirt)
+	for (unsigned i = 0; i < NVME_IO_QUEUES; i++)
 	{
-		m_Allocator.Free(m_IoQueue.pCqVirt);
-		m_IoQueue.pCqVirt = nullptr;
+		FreeQueue(&m_IoQueue[i]);
 	}
+
+	m_nIoQueues = 0;
 }
 
 bool CNVMeDevice::Initialize(void)
@@ -289,7 +323,7 @@ bool CNVMeDevice::Initialize(void)
 #endif
 
 	m_nDoorbellStride = DOORBELL_STRIDE(   (m_ulCaps & NVME_REG_CAP_DSTRD__MASK)
-					    << NVME_REG_CAP_DSTRD__SHIFT);
+					    >> NVME_REG_CAP_DSTRD__SHIFT);
 
 	m_nTimeoutHZ = MSEC2HZ(((m_ulCaps & NVME_REG_CAP_TO__MASK) >> NVME_REG_CAP_TO__SHIFT) * 500);
 	if (!m_nTimeoutHZ)
@@ -299,6 +333,13 @@ bool CNVMeDevice::Initialize(void)
 		m_nTimeoutHZ = 5 * HZ;
 	}
 
+	// CAP.MQES is zero based
+	unsigned nIoQueueEntries = (m_ulCaps & NVME_REG_CAP_MQES__MASK) + 1;
+	if (nIoQueueEntries > NVME_IO_QUEUE_ENTRIES)
+	{
+		nIoQueueEntries = NVME_IO_QUEUE_ENTRIES;
+	}
+
         // Reset controller
         MmioWrite32(NVME_REG_CC, MmioRead32(NVME_REG_CC) & ~NVME_REG_CC_EN);
         if (!WaitReady(false))
@@ -308,16 +349,17 @@ bool CNVMeDevice::Initialize(void)
 		return false;
 	}
 
-#ifdef NO_BUSY_WAIT
-	// Connect IRQ
-	assert(!m_bIRQConnected);
-	m_bIRQConnected = true;
+	// Connect IRQ, prefer one MSI-X vector per queue, fall back to INTx
+	if (!ConnectMSIX())
+	{
+		assert(!m_bIRQConnected);
+		m_bIRQConnected = true;
 
-	MmioWrite32(NVME_REG_INTMS, NVME_REG_INTM_ALL_VECTORS);
+		MmioWrite32(NVME_REG_INTMS, NVME_REG_INTM_ALL_VECTORS);
 
-	assert(m_pInterrupt);
-	m_pInterrupt->ConnectIRQ (ARM_IRQ_PCIE_EXT_HOST_INTA, InterruptHandler, this);
-#endif
+		assert(m_pInterrupt);
+		m_pInterrupt->ConnectIRQ (ARM_IRQ_PCIE_EXT_HOST_INTA, InterruptHandler, this);
+	}
 
 	// Create admin queues
 	u32 nRet = CreateAdminQueues();
@@ -330,7 +372,7 @@ bool CNVMeDevice::Initialize(void)
 
         // Choose SQ/CQ entry sizes and enable controller
         u32 nCC = MmioRead32(NVME_REG_CC);
-	nCC &= ~(NVME_REG_CC_IOCQES__MASK | NVME_REG_CC_IOCQES__MASK);
+	nCC &= ~(NVME_REG_CC_IOSQES__MASK | NVME_REG_CC_IOCQES__MASK);
 	nCC |=   NVME_REG_CC_IOSQES_64B << NVME_REG_CC_IOSQES__SHIFT
 	       | NVME_REG_CC_IOCQES_16B << NVME_REG_CC_IOCQES__SHIFT
 	       | NVME_REG_CC_EN;
@@ -343,13 +385,26 @@ bool CNVMeDevice::Initialize(void)
 		return false;
 	}
 
-	// Create a single I/O queue
-	nRet = CreateIoQueue(IOQID, NVME_IO_QUEUE_ENTRIES);
-	if (nRet != NVME_STATUS_OK)
+	// INTMS/INTMC must not be used with MSI-X
+	if (!m_bMSIX)
 	{
-		LOGERR("Cannot create I/O queue");
+		MmioWrite32(NVME_REG_INTMC, NVME_REG_INTM_VECTOR0);
+	}
 
-		return false;
+	// Create one I/O queue pair per core, using interrupt vector 0 with INTx,
+	// or the MSI-X vector of the queue ID otherwise
+	unsigned nIoQueues = SetNumberOfQueues(NVME_IO_QUEUES);
+	for (unsigned i = 0; i < nIoQueues; i++)
+	{
+		nRet = CreateIoQueue(&m_IoQueue[i], IOQID(i), nIoQueueEntries);
+		if (nRet != NVME_STATUS_OK)
+		{
+			LOGERR("Cannot create I/O queue %u", IOQID(i));
+
+			return false;
+		}
+
+		m_nIoQueues = i + 1;
 	}
 
 	// Identify namespace and controller
@@ -382,7 +437,8 @@ bool CNVMeDevice::Initialize(void)
 			u8 uchLBADS = nLBAFormat >> 16 & 0xFF;
 			unsigned nLBASize = 1 << uchLBADS;
 
-			if (nLBASize != NVME_LBA_SIZE)
+			if (   uchLBADS < 9
+			    || nLBASize > NVME_MAX_LBA_SIZE)
 			{
 				LOGERR("LBA size not supported (%u)", nLBASize);
 
@@ -391,6 +447,7 @@ bool CNVMeDevice::Initialize(void)
 				return false;
 			}
 
+			m_ulLBASize = nLBASize;
 			m_ulNamespaceSize = *(u64 *) &pIdBuf[0] * nLBASize;
 
 			u16 usMS = nLBAFormat & 0xFFFF;		// Check Metadata size field
@@ -408,20 +465,42 @@ bool CNVMeDevice::Initialize(void)
 			// Controller
 			memcpy (ModelNumber, &pIdBuf[24], sizeof ModelNumber-1);
 			ModelNumber[sizeof ModelNumber-1] = '\0';
+
+			// Maximum Data Transfer Size in units of the minimum page size (4KB)
+			u8 uchMDTS = pIdBuf[77];
+			if (   uchMDTS
+			    && uchMDTS < 20
+			    && (static_cast<size_t>(NVME_PAGE_SIZE) << uchMDTS) < m_ulMaxTransfer)
+			{
+				m_ulMaxTransfer = static_cast<size_t>(NVME_PAGE_SIZE) << uchMDTS;
+			}
+
+			u16 usONCS = *reinterpret_cast<u16 *>(&pIdBuf[520]);
+			m_bDeallocate = !!(usONCS & NVME_ONCS_DSM);
 		}
 	}
 
 	m_Allocator.Free(pIdBuf);
 
-	LOGNOTE("%luGB NVMe Model %s", m_ulNamespaceSize / GIGABYTE, ModelNumber);
+	LOGNOTE("%luGB NVMe Model %s (%lu bytes per block)", m_ulNamespaceSize / GIGABYTE,
+		ModelNumber, m_ulLBASize);
+
+#ifdef NVME_DEBUG
+	LOGDBG("%u I/O queues with %u entries, max. transfer %luKB",
+	       m_nIoQueues, nIoQueueEntries, m_ulMaxTransfer / 1024);
+#endif
 
 	// Create partion devices and device names
-	assert(m_pPartitionManager == 0);
-	m_pPartitionManager = new CPartitionManager(this, DeviceName);
-	assert(m_pPartitionManager != 0);
-	if (!m_pPartitionManager->Initialize())
+	// (CPartition supports 512 byte blocks only, use FatFs otherwise)
+	if (m_ulLBASize == FS_BLOCK_SIZE)
 	{
-		return false;
+		assert(m_pPartitionManager == 0);
+		m_pPartitionManager = new CPartitionManager(this, DeviceName);
+		assert(m_pPartitionManager != 0);
+		if (!m_pPartitionManager->Initialize())
+		{
+			return false;
+		}
 	}
 
 	CDeviceNameService::Get ()->AddDevice (DeviceName, this, TRUE);
@@ -437,13 +516,13 @@ int CNVMeDevice::Read (void *pBuffer, size_t ulCount)
 
 	assert (pBuffer);
 
-	if (m_ulOffset & (NVME_LBA_SIZE-1))
+	if (m_ulOffset & (m_ulLBASize-1))
 	{
 		return NVME_STATUS_ERROR_BAD_PARAM;
 	}
-        unsigned nLBA = m_ulOffset / NVME_LBA_SIZE;
+        u64 nLBA = m_ulOffset / m_ulLBASize;
 
-	if (!ulCount || (ulCount & (NVME_LBA_SIZE-1)))
+	if (!ulCount || (ulCount & (m_ulLBASize-1)))
 	{
 		return NVME_STATUS_ERROR_BAD_PARAM;
 	}
@@ -464,12 +543,24 @@ int CNVMeDevice::Read (void *pBuffer, size_t ulCount)
 
 	InvalidateDataCacheRange (reinterpret_cast<uintptr>(pTransferBuffer), ulCount);
 
-	int nRet = IoPassThrough(NSID, nLBA, ulCount / NVME_LBA_SIZE, pTransferBuffer, false);
-        if (nRet != NVME_STATUS_OK)
+	// Split transfer according to MDTS
+	size_t ulChunk;
+	for (size_t ulDone = 0; ulDone < ulCount; ulDone += ulChunk)
 	{
-		delete [] pDMABuffer;
+		ulChunk = ulCount - ulDone;
+		if (ulChunk > m_ulMaxTransfer)
+		{
+			ulChunk = m_ulMaxTransfer;
+		}
+
+		int nRet = IoPassThrough(NSID, nLBA + ulDone / m_ulLBASize, ulChunk / m_ulLBASize,
+					 static_cast<u8 *>(pTransferBuffer) + ulDone, false);
+		if (nRet != NVME_STATUS_OK)
+		{
+			delete [] pDMABuffer;
 
-		return nRet;
+			return nRet;
+		}
         }
 
 	InvalidateDataCacheRange (reinterpret_cast<uintptr>(pTransferBuffer), ulCount);
@@ -492,13 +583,13 @@ int CNVMeDevice::Write (const void *pBuffer, size_t ulCount)
 
 	assert (pBuffer);
 
-	if (m_ulOffset & (NVME_LBA_SIZE-1))
+	if (m_ulOffset & (m_ulLBASize-1))
 	{
 		return NVME_STATUS_ERROR_BAD_PARAM;
 	}
-        unsigned nLBA = m_ulOffset / NVME_LBA_SIZE;
+        u64 nLBA = m_ulOffset / m_ulLBASize;
 
-	if (!ulCount || (ulCount & (NVME_LBA_SIZE-1)))
+	if (!ulCount || (ulCount & (m_ulLBASize-1)))
 	{
 		return NVME_STATUS_ERROR_BAD_PARAM;
 	}
@@ -525,15 +616,27 @@ int CNVMeDevice::Write (const void *pBuffer, size_t ulCount)
 
 	CleanDataCacheRange (reinterpret_cast<uintptr>(pTransferBuffer), ulCount);
 
-	int nRet = IoPassThrough(NSID, nLBA, ulCount / NVME_LBA_SIZE, pTransferBuffer, true);
+	// Split transfer according to MDTS
+	size_t ulChunk;
+	for (size_t ulDone = 0; ulDone < ulCount; ulDone += ulChunk)
+	{
+		ulChunk = ulCount - ulDone;
+		if (ulChunk > m_ulMaxTransfer)
+		{
+			ulChunk = m_ulMaxTransfer;
+		}
 
-	delete [] pDMABuffer;
+		int nRet = IoPassThrough(NSID, nLBA + ulDone / m_ulLBASize, ulChunk / m_ulLBASize,
+					 static_cast<u8 *>(pTransferBuffer) + ulDone, true);
+		if (nRet != NVME_STATUS_OK)
+		{
+			delete [] pDMABuffer;
 
-        if (nRet != NVME_STATUS_OK)
-	{
+			return nRet;
+		}
+	}
 
-		return nRet;
-        }
+	delete [] pDMABuffer;
 
 	return ulCount;
 }
@@ -565,6 +668,27 @@ int CNVMeDevice::IOCtl (unsigned long ulCmd, void *pData)
 		return Flush(NSID);
 	}
 
+	if (ulCmd == DEVICE_IOCTL_SUBMIT)
+	{
+		return SubmitRequest(static_cast<const TDeviceBlockRequest *> (pData));
+	}
+
+	if (ulCmd == DEVICE_IOCTL_GET_BLOCK_SIZE)
+	{
+		assert (pData);
+		*static_cast<unsigned *> (pData) = static_cast<unsigned> (m_ulLBASize);
+
+		return NVME_STATUS_OK;
+	}
+
+	if (ulCmd == DEVICE_IOCTL_DISCARD)
+	{
+		const TDeviceBlockRange *pRange = static_cast<const TDeviceBlockRange *> (pData);
+		assert (pRange);
+
+		return Deallocate(pRange->ullOffset, pRange->ullCount);
+	}
+
 	return NVME_STATUS_ERROR_BAD_PARAM;
 }
 
@@ -582,6 +706,11 @@ int CNVMeDevice::CreateAdminQueues(void)
 	memset(pSq, 0, uSqSize);
 	memset(pCq, 0, uCqSize);
 
+	if (!InitQueue(&m_AdminQueue, "Admin", AQID, NVME_ADMIN_QUEUE_ENTRIES))
+	{
+		return NVME_STATUS_ERROR_NO_RESOURCE;
+	}
+
 	m_AdminQueue.pSqVirt = pSq;
 	m_AdminQueue.pCqVirt = pCq;
 	m_AdminQueue.nSqPhys = PhysicalOf(pSq);
@@ -592,58 +721,226 @@ int CNVMeDevice::CreateAdminQueues(void)
 	MmioWrite64(NVME_REG_ASQ, m_AdminQueue.nSqPhys);
 	MmioWrite64(NVME_REG_ACQ, m_AdminQueue.nCqPhys);
 
-	m_AdminQueue.nSqTail = 0;
-	m_AdminQueue.nCqHead = 0;
-	m_AdminQueue.bCqPhase = true;
-
 	return NVME_STATUS_OK;
 }
 
-int CNVMeDevice::CreateIoQueue(u16 uQueueId, u16 uEntries)
+int CNVMeDevice::CreateIoQueue(TQueue *pQueue, u16 uQueueId, u16 uEntries)
 {
+	assert (pQueue);
+
 	// For I/O queues, we need to send Admin Create I/O Completion Queue and
 	// Create Submission Queue commands. We allocate SQ/CQ memory and then use
-	// AdminCommand() to create queues.
+	// AdminCommand() to create queues. The queues of all cores do not fit into
+	// the coherent page, so they are allocated from the DMA coherent pool.
 	size_t uSqSize = sizeof(TNVMeCommand) * uEntries;
 	size_t uCqSize = sizeof(TNVMeCompletion) * uEntries;
+	uSqSize = (uSqSize + NVME_PAGE_SIZE-1) & ~(NVME_PAGE_SIZE-1);
+	uCqSize = (uCqSize + NVME_PAGE_SIZE-1) & ~(NVME_PAGE_SIZE-1);
 
-	void *pSq = m_Allocator.Allocate(uSqSize, NVME_PAGE_SIZE);
-	if (!pSq) return NVME_STATUS_ERROR_NO_RESOURCE;
-	void *pCq = m_Allocator.Allocate(uCqSize, NVME_PAGE_SIZE);
-	if (!pCq) return NVME_STATUS_ERROR_NO_RESOURCE;
+	if (!InitQueue(pQueue, "I/O", uQueueId, uEntries))
+	{
+		return NVME_STATUS_ERROR_NO_RESOURCE;
+	}
+
+	pQueue->pMemory = new (HEAP_COHERENT) u8[uSqSize + uCqSize + NVME_PAGE_SIZE-1];
+	if (!pQueue->pMemory) return NVME_STATUS_ERROR_NO_RESOURCE;
+
+	uintptr nBase = reinterpret_cast<uintptr>(pQueue->pMemory);
+	nBase = (nBase + NVME_PAGE_SIZE-1) & ~(NVME_PAGE_SIZE-1);
+	void *pSq = reinterpret_cast<void *>(nBase);
+	void *pCq = reinterpret_cast<void *>(nBase + uSqSize);
 
 	memset(pSq, 0, uSqSize);
 	memset(pCq, 0, uCqSize);
 
-	m_IoQueue.pSqVirt = pSq;
-	m_IoQueue.pCqVirt = pCq;
-	m_IoQueue.nSqPhys = PhysicalOf(pSq);
-	m_IoQueue.nCqPhys = PhysicalOf(pCq);
+	pQueue->pSqVirt = pSq;
+	pQueue->pCqVirt = pCq;
+	pQueue->nSqPhys = PhysicalOf(pSq);
+	pQueue->nCqPhys = PhysicalOf(pCq);
 
 	// Build Create CQ
 	u32 uCdw10 = (uQueueId & 0xffff) | ((uEntries - 1) << 16);
-	// cdw11: PC=1(phys contig) | IEN=1 | PRIO=0 | IRQ vector=0
-	u32 uCdw11 = BIT(0) | BIT(1) | 0 << 16;
+	// cdw11: PC=1(phys contig) | IEN=1 | PRIO=0 | IRQ vector
+	u32 nVector = m_bMSIX ? uQueueId : 0;
+	u32 uCdw11 = BIT(0) | BIT(1) | nVector << 16;
 	// Data pointer: PRP1 = CQ physical base, PRP2 = 0
-	u32 nRet = AdminCommand(NVME_ADMIN_OPC_CREATE_IO_CQ, 0, uCdw10, uCdw11, m_IoQueue.nCqPhys);
+	u32 nRet = AdminCommand(NVME_ADMIN_OPC_CREATE_IO_CQ, 0, uCdw10, uCdw11, pQueue->nCqPhys);
 	if (nRet != NVME_STATUS_OK) return nRet;
 
 	uCdw10 = (uQueueId & 0xffff) | ((uEntries - 1) << 16);
 	// cdw11: CQid << 16, PC=1
 	uCdw11 = (static_cast<u32>(uQueueId) << 16) | 1;
-	nRet = AdminCommand(NVME_ADMIN_OPC_CREATE_IO_SQ, 0, uCdw10, uCdw11, m_IoQueue.nSqPhys);
+	nRet = AdminCommand(NVME_ADMIN_OPC_CREATE_IO_SQ, 0, uCdw10, uCdw11, pQueue->nSqPhys);
 	if (nRet != NVME_STATUS_OK) return nRet;
 
-	m_IoQueue.nSqTail = 0;
-	m_IoQueue.nCqHead = 0;
-	m_IoQueue.bCqPhase = true;
-
 	return NVME_STATUS_OK;
 }
 
+bool CNVMeDevice::InitQueue(TQueue *pQueue, const char *pName, u16 usID, u16 usEntries)
+{
+	assert (pQueue);
+
+	pQueue->pName = pName;
+	pQueue->usID = usID;
+	pQueue->nEntries = usEntries;
+
+	pQueue->pSqVirt = nullptr;
+	pQueue->pCqVirt = nullptr;
+	pQueue->nSqPhys = 0;
+	pQueue->nCqPhys = 0;
+	pQueue->pMemory = nullptr;
+
+	pQueue->nSqTail = 0;
+	pQueue->nSqHead = 0;
+	pQueue->nCqHead = 0;
+	pQueue->bCqPhase = true;
+
+	pQueue->pSlots = nullptr;
+	pQueue->usFreeSlot = NO_SLOT;
+
+	if (!usEntries)
+	{
+		return true;
+	}
+
+	pQueue->pSlots = new TCommandSlot[usEntries];
+	if (!pQueue->pSlots)
+	{
+		return false;
+	}
+
+	for (unsigned i = 0; i < usEntries; i++)
+	{
+		pQueue->pSlots[i].bBusy = false;
+		pQueue->pSlots[i].pBounceBuffer = nullptr;
+	}
+
+	// One entry must stay free, so that a full queue can be told from an empty one
+	for (unsigned i = usEntries - 1; i-- > 0; )
+	{
+		pQueue->pSlots[i].usNext = pQueue->usFreeSlot;
+		pQueue->usFreeSlot = i;
+	}
+
+	return true;
+}
+
+void CNVMeDevice::FreeQueue(TQueue *pQueue)
+{
+	assert (pQueue);
+
+	delete [] pQueue->pSlots;
+	pQueue->pSlots = nullptr;
+	pQueue->usFreeSlot = NO_SLOT;
+
+	delete [] pQueue->pMemory;
+	pQueue->pMemory = nullptr;
+	pQueue->pSqVirt = nullptr;
+	pQueue->pCqVirt = nullptr;
+}
+
+unsigned CNVMeDevice::SetNumberOfQueues(unsigned nQueues)
+{
+	assert (nQueues);
+
+	// cdw11: NCQR << 16 | NSQR (zero based)
+	u32 nDw0;
+	int nRet = SubmitCommand(&m_AdminQueue, NVME_ADMIN_OPC_SET_FEATURES, 0,
+				 NVME_FEATURE_NUMBER_OF_QUEUES, (nQueues - 1) << 16 | (nQueues - 1), 0,
+				 0, 0, &nDw0);
+	if (nRet != NVME_STATUS_OK)
+	{
+		LOGWARN("Cannot set number of queues (err %d)", nRet);
+
+		return 1;
+	}
+
+	// The controller may have allocated more or fewer queues than requested
+	unsigned nSQs = (nDw0 & 0xFFFF) + 1;
+	unsigned nCQs = (nDw0 >> 16) + 1;
+
+	if (nQueues > nSQs) nQueues = nSQs;
+	if (nQueues > nCQs) nQueues = nCQs;
+
+	return nQueues;
+}
+
+CNVMeDevice::TQueue *CNVMeDevice::GetIoQueue(void)
+{
+	assert (m_nIoQueues);
+
+	return &m_IoQueue[ThisCore() % m_nIoQueues];
+}
+
 int CNVMeDevice::Flush(u32 nNsId)
 {
-	return SubmitCommand(&m_IoQueue, NVME_IO_OPC_FLUSH, nNsId, 0, 0, 0, 0, 0);
+	return SubmitCommand(GetIoQueue(), NVME_IO_OPC_FLUSH, nNsId, 0, 0, 0, 0, 0);
+}
+
+int CNVMeDevice::Deallocate(u64 ulOffset, u64 ulCount)
+{
+	if (   !m_bDeallocate
+	    || !m_nIoQueues
+	    || (ulOffset & (m_ulLBASize-1))
+	    || (ulCount & (m_ulLBASize-1)))
+	{
+		return NVME_STATUS_ERROR_BAD_PARAM;
+	}
+
+	if (ulOffset + ulCount > m_ulNamespaceSize)
+	{
+		return NVME_STATUS_ERROR_LBA_RANGE;
+	}
+
+#ifdef NVME_READ_ONLY
+	return NVME_STATUS_ERROR_READ_ONLY;
+#endif
+
+	u64 ulLba = ulOffset / m_ulLBASize;
+	u64 ulBlocks = ulCount / m_ulLBASize;
+	if (!ulBlocks)
+	{
+		return NVME_STATUS_OK;
+	}
+
+	// The range list must not cross a page boundary, because PRP2 is not used
+	static_assert (NVME_DSM_MAX_RANGES * sizeof (TNVMeDSMRange) <= NVME_PAGE_SIZE, "");
+	u8 *pMemory = new (HEAP_COHERENT) u8[2*NVME_PAGE_SIZE];
+	if (!pMemory)
+	{
+		return NVME_STATUS_ERROR_NO_RESOURCE;
+	}
+
+	TNVMeDSMRange *pRanges = reinterpret_cast<TNVMeDSMRange *> (
+		(reinterpret_cast<uintptr>(pMemory) + NVME_PAGE_SIZE-1) & ~(uintptr) (NVME_PAGE_SIZE-1));
+
+	int nRet = NVME_STATUS_OK;
+	while (ulBlocks && nRet == NVME_STATUS_OK)
+	{
+		unsigned nRanges = 0;
+		while (ulBlocks && nRanges < NVME_DSM_MAX_RANGES)
+		{
+			u32 nBlocks = ulBlocks > NVME_DSM_MAX_BLOCKS ? NVME_DSM_MAX_BLOCKS
+								    : static_cast<u32>(ulBlocks);
+
+			pRanges[nRanges].nContextAttributes = 0;
+			pRanges[nRanges].nBlocks = nBlocks;
+			pRanges[nRanges].ulStartLba = ulLba;
+			nRanges++;
+
+			ulLba += nBlocks;
+			ulBlocks -= nBlocks;
+		}
+
+		// cdw10: NR (zero based), cdw11: attributes
+		nRet = SubmitCommand(GetIoQueue(), NVME_IO_OPC_DSM, NSID,
+				     nRanges - 1, NVME_DSM_ATTR_DEALLOCATE, 0,
+				     PhysicalOf(pRanges), 0);
+	}
+
+	delete [] pMemory;
+
+	return nRet;
 }
 
 int CNVMeDevice::Identify(u32 uCns, void *pOutBuf, u32 uNsId)
@@ -662,20 +959,123 @@ int CNVMeDevice::IoPassThrough(u32 nNsId, u64 nLba, u32 nBlocks, void *pBuffer,
 	assert (pBuffer);
 	assert (nBlocks);
 
-	CNVMePRP PrpBuilder(&m_Allocator);
-	if (!PrpBuilder.BuildForBuffer(pBuffer, static_cast<size_t>(nBlocks) * NVME_LBA_SIZE))
+	TQueue *pQueue = GetIoQueue();
+
+	int nCid = AllocateCommand(pQueue);
+	if (nCid < 0)
 	{
+		return nCid;
+	}
+
+	CNVMePRP &PrpBuilder = pQueue->pSlots[nCid].PRP;
+	if (!PrpBuilder.BuildForBuffer(pBuffer, static_cast<size_t>(nBlocks) * m_ulLBASize))
+	{
+		FreeCommand(pQueue, nCid);
+
 		return NVME_STATUS_ERROR_NO_RESOURCE;
 	}
 
-	return SubmitCommand(&m_IoQueue,
-			     bIsWrite ? NVME_IO_OPC_WRITE : NVME_IO_OPC_READ,
-			     nNsId,
-			     static_cast<u32>(nLba & 0xffffffff),
-			     static_cast<u32>((nLba >> 32) & 0xffffffff),
-			     nBlocks - 1,
-			     PrpBuilder.Prp1(),
-			     PrpBuilder.Prp2());
+	IssueCommand(pQueue, nCid,
+		     bIsWrite ? NVME_IO_OPC_WRITE : NVME_IO_OPC_READ,
+		     nNsId,
+		     static_cast<u32>(nLba & 0xffffffff),
+		     static_cast<u32>((nLba >> 32) & 0xffffffff),
+		     nBlocks - 1,
+		     PrpBuilder.Prp1(),
+		     PrpBuilder.Prp2());
+
+	return WaitForCompletion(pQueue, nCid, POLL_TIMEOUT_HZ);
+}
+
+int CNVMeDevice::SubmitRequest(const TDeviceBlockRequest *pRequest)
+{
+	assert (pRequest);
+	assert (pRequest->pBuffer);
+	assert (pRequest->pCompletionRoutine);
+
+#ifdef NVME_DEBUG
+	LOGDBG("Submit(%s, %p, %lu, %lu)", pRequest->bWrite ? "write" : "read",
+	       pRequest->pBuffer, pRequest->ullOffset, pRequest->nCount);
+#endif
+
+	size_t ulCount = pRequest->nCount;
+	if (   (pRequest->ullOffset & (m_ulLBASize-1))
+	    || !ulCount
+	    || (ulCount & (m_ulLBASize-1))
+	    || ulCount > m_ulMaxTransfer
+	    || !m_nIoQueues)
+	{
+		return NVME_STATUS_ERROR_BAD_PARAM;
+	}
+
+#ifdef NVME_READ_ONLY
+	if (pRequest->bWrite)
+	{
+		return NVME_STATUS_ERROR_READ_ONLY;
+	}
+#endif
+
+	TQueue *pQueue = GetIoQueue();
+
+	int nCid = AllocateCommand(pQueue, pRequest->pCompletionRoutine, pRequest->pParam);
+	if (nCid < 0)
+	{
+		return nCid;
+	}
+
+	TCommandSlot *pSlot = &pQueue->pSlots[nCid];
+	pSlot->pTransferBuffer = pRequest->pBuffer;
+	pSlot->ulLength = ulCount;
+
+	// Use temporary DMA buffer, if pBuffer is not cache aligned
+	if (!IS_CACHE_ALIGNED(pRequest->pBuffer, ulCount))
+	{
+		pSlot->pBounceBuffer = new u8[ulCount];
+		if (!pSlot->pBounceBuffer)
+		{
+			FreeCommand(pQueue, nCid);
+
+			return NVME_STATUS_ERROR_NO_RESOURCE;
+		}
+
+		if (pRequest->bWrite)
+		{
+			memcpy (pSlot->pBounceBuffer, pRequest->pBuffer, ulCount);
+		}
+
+		pSlot->pTransferBuffer = pSlot->pBounceBuffer;
+	}
+
+	if (pRequest->bWrite)
+	{
+		CleanDataCacheRange (reinterpret_cast<uintptr>(pSlot->pTransferBuffer), ulCount);
+	}
+	else
+	{
+		pSlot->pReadBuffer = pRequest->pBuffer;
+
+		InvalidateDataCacheRange (reinterpret_cast<uintptr>(pSlot->pTransferBuffer), ulCount);
+	}
+
+	if (!pSlot->PRP.BuildForBuffer(pSlot->pTransferBuffer, ulCount))
+	{
+		FreeCommand(pQueue, nCid);
+
+		return NVME_STATUS_ERROR_NO_RESOURCE;
+	}
+
+	u64 nLba = pRequest->ullOffset / m_ulLBASize;
+
+	IssueCommand(pQueue, nCid,
+		     pRequest->bWrite ? NVME_IO_OPC_WRITE : NVME_IO_OPC_READ,
+		     NSID,
+		     static_cast<u32>(nLba & 0xffffffff),
+		     static_cast<u32>((nLba >> 32) & 0xffffffff),
+		     ulCount / m_ulLBASize - 1,
+		     pSlot->PRP.Prp1(),
+		     pSlot->PRP.Prp2());
+
+	return NVME_STATUS_OK;
 }
 
 int CNVMeDevice::AdminCommand(u8 uchOpcode, u32 nNsId, u32 uCdw10, u32 uCdw11, u64 ulDataPhysAddr)
@@ -685,20 +1085,88 @@ int CNVMeDevice::AdminCommand(u8 uchOpcode, u32 nNsId, u32 uCdw10, u32 uCdw11, u
 	return SubmitCommand(&m_AdminQueue, uchOpcode, nNsId, uCdw10, uCdw11, 0, ulDataPhysAddr, 0);
 }
 
-int CNVMeDevice::SubmitCommand(TQueue *pQueue, u8 uchOpcode, u32 nNsId,
+int CNVMeDevice::AllocateCommand(TQueue *pQueue, TDeviceCompletionRoutine *pCompletionRoutine,
+				 void *pParam)
+{
+	assert (pQueue);
+	assert (pQueue->pSlots);
+
+	pQueue->SpinLock.Acquire();
+
+	u16 usCid = pQueue->usFreeSlot;
+	if (usCid == NO_SLOT)
+	{
+		pQueue->SpinLock.Release();
+
+#ifdef NVME_DEBUG
+		LOGDBG("%s queue is full", pQueue->pName);
+#endif
+
+		return NVME_STATUS_ERROR_NO_RESOURCE;
+	}
+
+	TCommandSlot *pSlot = &pQueue->pSlots[usCid];
+	pQueue->usFreeSlot = pSlot->usNext;
+
+	assert (!pSlot->bBusy);
+	pSlot->bBusy = true;
+
+	pQueue->SpinLock.Release();
+
+	pSlot->bAbandoned = false;
+	pSlot->bDone = false;
+	pSlot->nResult = NVME_STATUS_OK;
+	pSlot->nDw0 = 0;
+	pSlot->pCompletionRoutine = pCompletionRoutine;
+	pSlot->pParam = pParam;
+	pSlot->pTransferBuffer = nullptr;
+	pSlot->pReadBuffer = nullptr;
+	assert (!pSlot->pBounceBuffer);
+	pSlot->ulLength = 0;
+
+	return usCid;
+}
+
+void CNVMeDevice::FreeCommand(TQueue *pQueue, u16 usCid)
+{
+	assert (pQueue);
+	assert (usCid < pQueue->nEntries);
+	TCommandSlot *pSlot = &pQueue->pSlots[usCid];
+
+	pSlot->PRP.Release();
+
+	delete [] pSlot->pBounceBuffer;
+	pSlot->pBounceBuffer = nullptr;
+
+	pQueue->SpinLock.Acquire();
+
+	assert (pSlot->bBusy);
+	pSlot->bBusy = false;
+
+	pSlot->usNext = pQueue->usFreeSlot;
+	pQueue->usFreeSlot = usCid;
+
+	pQueue->SpinLock.Release();
+}
+
+void CNVMeDevice::IssueCommand(TQueue *pQueue, u16 usCid, u8 uchOpcode, u32 nNsId,
 			       u32 nCdw10, u32 nCdw11, u32 nCdw12,
-			       uintptr ulPrp1, uintptr ulPrp2)
+			       u64 ulPrp1, u64 ulPrp2)
 {
 	assert (pQueue);
 
 #ifdef NVME_DEBUG
-	LOGDBG("%s command (opcode 0x%02X, cdw 0x%X 0x%X 0x%X)",
-	       pQueue->pName, uchOpcode, nCdw10, nCdw11, nCdw12);
+	LOGDBG("%s command (opcode 0x%02X, cid %u, cdw 0x%X 0x%X 0x%X)",
+	       pQueue->pName, uchOpcode, usCid, nCdw10, nCdw11, nCdw12);
 #endif
 
 	TNVMeCommand *pSq = reinterpret_cast<TNVMeCommand *>(pQueue->pSqVirt);
 
-	u16 usCid = static_cast<u16>((pQueue->nSqTail) & 0xffff);
+	pQueue->SpinLock.Acquire();
+
+	// Cannot overflow, because there are fewer CIDs than queue entries
+	assert ((pQueue->nSqTail + 1) % pQueue->nEntries != pQueue->nSqHead);
+
 	TNVMeCommand *pCmd = &pSq[pQueue->nSqTail];
 	memset(pCmd, 0, sizeof(TNVMeCommand));
 	pCmd->opc = uchOpcode;
@@ -710,44 +1178,131 @@ int CNVMeDevice::SubmitCommand(TQueue *pQueue, u8 uchOpcode, u32 nNsId,
 	pCmd->cdw11 = nCdw11;
 	pCmd->cdw12 = nCdw12;
 
-#ifdef NO_BUSY_WAIT
-	m_Event.Clear();
-
-	MmioWrite32(NVME_REG_INTMC, NVME_REG_INTM_VECTOR0);
-#endif
-
 	// Doorbell write for submission queue
 	pQueue->nSqTail = (pQueue->nSqTail + 1) % pQueue->nEntries;
 	DataSyncBarrier();
 	MmioWrite32(NVME_DOORBELL_SQ_OFFSET(pQueue->usID), pQueue->nSqTail);
 
-	return PollForCompletion(pQueue, usCid, POLL_TIMEOUT_HZ);
+	pQueue->SpinLock.Release();
+}
+
+int CNVMeDevice::SubmitCommand(TQueue *pQueue, u8 uchOpcode, u32 nNsId,
+			       u32 nCdw10, u32 nCdw11, u32 nCdw12,
+			       uintptr ulPrp1, uintptr ulPrp2, u32 *pDw0)
+{
+	int nCid = AllocateCommand(pQueue);
+	if (nCid < 0)
+	{
+		return nCid;
+	}
+
+	IssueCommand(pQueue, nCid, uchOpcode, nNsId, nCdw10, nCdw11, nCdw12, ulPrp1, ulPrp2);
+
+	return WaitForCompletion(pQueue, nCid, POLL_TIMEOUT_HZ, pDw0);
 }
 
-int CNVMeDevice::PollForCompletion(TQueue *pQueue, u16 usCid, unsigned nTimeoutHZ)
+int CNVMeDevice::WaitForCompletion(TQueue *pQueue, u16 usCid, unsigned nTimeoutHZ, u32 *pDw0)
 {
 	assert (pQueue);
 	assert (usCid < pQueue->nEntries);
+	TCommandSlot *pSlot = &pQueue->pSlots[usCid];
+	assert (pSlot->bBusy);
+	assert (!pSlot->pCompletionRoutine);
 
-	// Poll queue for matching CID
-	TNVMeCompletion *pCq = reinterpret_cast<TNVMeCompletion *>(pQueue->pCqVirt);
 	unsigned nStart = CTimer::Get()->GetTicks();
 
 #ifdef NVME_DEBUG
 	unsigned nStartClockTicks = CTimer::Get()->GetClockTicks();
 #endif
 
-#ifdef NO_BUSY_WAIT
-	if (m_Event.WaitWithTimeout(1000000UL * nTimeoutHZ / HZ))
+	while (!pSlot->bDone)
 	{
+#ifdef NO_BUSY_WAIT
+		// The interrupt handler completes the command, while we are blocked.
+		// This requires the scheduler, which is available on core 0 only.
+		if (   ThisCore() == 0
+		    && CurrentExecutionLevel() == TASK_LEVEL)
+		{
+			m_Event.Clear();
+
+			if (pSlot->bDone)
+			{
+				break;
+			}
+
+			m_Event.WaitWithTimeout(1000000UL * nTimeoutHZ / HZ);
+		}
+		else
+#endif
+		{
+			ProcessCompletions(pQueue);
+
+			if (pSlot->bDone)
+			{
+				break;
+			}
+
+			CTimer::Get()->usDelay(1);
+		}
+
+		if (CTimer::Get()->GetTicks() - nStart > nTimeoutHZ)
+		{
+			// The controller may still access the buffers of the command, so we
+			// cannot reuse the CID, before the command has been completed.
+			pQueue->SpinLock.Acquire();
+
+			bool bDone = pSlot->bDone;
+			if (!bDone)
+			{
+				pSlot->bAbandoned = true;
+			}
+
+			pQueue->SpinLock.Release();
+
+			if (!bDone)
+			{
 #ifdef NVME_DEBUG
-		LOGDBG("%s command timed out", pQueue->pName);
+				LOGDBG("%s command timed out", pQueue->pName);
 #endif
 
-		return NVME_STATUS_ERROR_TIMEOUT;
+				return NVME_STATUS_ERROR_TIMEOUT;
+			}
+		}
+	}
+
+	DataMemBarrier();
+
+	int nResult = pSlot->nResult;
+	if (pDw0)
+	{
+		*pDw0 = pSlot->nDw0;
 	}
+
+	FreeCommand(pQueue, usCid);
+
+#ifdef NVME_DEBUG
+	LOGDBG("%s command completed after %uus",
+	       pQueue->pName, CTimer::Get()->GetClockTicks() - nStartClockTicks);
 #endif
 
+	return nResult;
+}
+
+void CNVMeDevice::ProcessCompletions(TQueue *pQueue)
+{
+	assert (pQueue);
+
+	TNVMeCompletion *pCq = reinterpret_cast<TNVMeCompletion *>(pQueue->pCqVirt);
+	if (!pCq)
+	{
+		return;
+	}
+
+	u16 usFinished = NO_SLOT;	// list of asynchronous and abandoned commands
+	bool bConsumed = false;
+
+	pQueue->SpinLock.Acquire();
+
 	while (true)
 	{
 		DataMemBarrier();
@@ -755,63 +1310,108 @@ int CNVMeDevice::PollForCompletion(TQueue *pQueue, u16 usCid, unsigned nTimeoutH
 		TNVMeCompletion &ce = pCq[pQueue->nCqHead];
 		u16 usStatus = ATOMIC_READ(&ce.status);
 
-		if (   !!(usStatus & CQE_STATUS_PHASE_BIT) == pQueue->bCqPhase
-		    && ATOMIC_READ(&ce.cid) == usCid
-		    && ATOMIC_READ(&ce.sqid) == pQueue->usID)
+		if (!!(usStatus & CQE_STATUS_PHASE_BIT) != pQueue->bCqPhase)
 		{
-			// Advance head
-			pQueue->nCqHead = (pQueue->nCqHead + 1) % pQueue->nEntries;
-			if (pQueue->nCqHead == 0) pQueue->bCqPhase = !pQueue->bCqPhase;
-			DataSyncBarrier ();
-			MmioWrite32(NVME_DOORBELL_CQ_OFFSET(pQueue->usID), pQueue->nCqHead);
-
-			unsigned nSCT = (usStatus & CQE_STATUS_SCT__MASK) >> CQE_STATUS_SCT__SHIFT;
-			unsigned nSC = (usStatus & CQE_STATUS_SC__MASK) >> CQE_STATUS_SC__SHIFT;
-			if (nSCT || nSC)
-			{
-				LOGDBG("%s command failed (sct %u, sc 0x%X)",
-				       pQueue->pName, nSCT, nSC);
+			break;
+		}
 
-				if (!nSCT && nSC == 0x80)
-				{
-					return NVME_STATUS_ERROR_LBA_RANGE;
-				}
+		u16 usCid = ATOMIC_READ(&ce.cid);
+		u32 nDw0 = ATOMIC_READ(&ce.dw0);
+		pQueue->nSqHead = ATOMIC_READ(&ce.sqhead);
 
-				return NVME_STATUS_ERROR_CONTROLLER;
-			}
+		// Advance head
+		pQueue->nCqHead = (pQueue->nCqHead + 1) % pQueue->nEntries;
+		if (pQueue->nCqHead == 0) pQueue->bCqPhase = !pQueue->bCqPhase;
+		bConsumed = true;
 
-			break;
+		if (   usCid >= pQueue->nEntries
+		    || !pQueue->pSlots[usCid].bBusy)
+		{
+#ifdef NVME_DEBUG
+			LOGDBG("%s completion with invalid cid %u", pQueue->pName, usCid);
+#endif
+
+			continue;
 		}
 
-#ifdef NO_BUSY_WAIT
+		TCommandSlot *pSlot = &pQueue->pSlots[usCid];
+
+		pSlot->nResult = NVME_STATUS_OK;
+		pSlot->nDw0 = nDw0;
+
+		unsigned nSCT = (usStatus & CQE_STATUS_SCT__MASK) >> CQE_STATUS_SCT__SHIFT;
+		unsigned nSC = (usStatus & CQE_STATUS_SC__MASK) >> CQE_STATUS_SC__SHIFT;
+		if (nSCT || nSC)
+		{
 #ifdef NVME_DEBUG
+			LOGDBG("%s command failed (sct %u, sc 0x%X)",
+			       pQueue->pName, nSCT, nSC);
+#endif
+
+			pSlot->nResult =   !nSCT && nSC == 0x80
+					 ? NVME_STATUS_ERROR_LBA_RANGE
+					 : NVME_STATUS_ERROR_CONTROLLER;
+		}
+
+		if (   pSlot->pCompletionRoutine
+		    || pSlot->bAbandoned)
+		{
+			pSlot->usNext = usFinished;
+			usFinished = usCid;
+		}
 		else
 		{
-			LOGDBG("Interrupt without completion");
+			DataMemBarrier();
+
+			pSlot->bDone = true;
 		}
-#endif
-#endif
+	}
 
-		if (CTimer::Get()->GetTicks() - nStart > nTimeoutHZ)
+	if (bConsumed)
+	{
+		DataSyncBarrier ();
+		MmioWrite32(NVME_DOORBELL_CQ_OFFSET(pQueue->usID), pQueue->nCqHead);
+	}
+
+	pQueue->SpinLock.Release();
+
+	// Complete asynchronous commands without holding the lock,
+	// so that the completion routine can submit the next request
+	while (usFinished != NO_SLOT)
+	{
+		u16 usCid = usFinished;
+		TCommandSlot *pSlot = &pQueue->pSlots[usCid];
+		usFinished = pSlot->usNext;
+
+		TDeviceCompletionRoutine *pCompletionRoutine = pSlot->pCompletionRoutine;
+		void *pParam = pSlot->pParam;
+		int nResult = pSlot->nResult;
+		if (nResult == NVME_STATUS_OK)
 		{
-#ifdef NVME_DEBUG
-			LOGDBG("%s command timed out", pQueue->pName);
-#endif
+			nResult = pSlot->ulLength;
+
+			if (pSlot->pReadBuffer)
+			{
+				InvalidateDataCacheRange (reinterpret_cast<uintptr>(pSlot->pTransferBuffer),
+							  pSlot->ulLength);
 
-			return NVME_STATUS_ERROR_TIMEOUT;
+				if (pSlot->pBounceBuffer)
+				{
+					memcpy (pSlot->pReadBuffer, pSlot->pBounceBuffer, pSlot->ulLength);
+				}
+			}
 		}
 
-#ifndef NO_BUSY_WAIT
-		CTimer::Get()->usDelay(1);
-#endif
-	}
+		bool bAbandoned = pSlot->bAbandoned;
 
-#ifdef NVME_DEBUG
-	LOGDBG("%s command completed after %uus",
-	       pQueue->pName, CTimer::Get()->GetClockTicks() - nStartClockTicks);
-#endif
+		FreeCommand(pQueue, usCid);
 
-	return NVME_STATUS_OK;
+		if (   pCompletionRoutine
+		    && !bAbandoned)
+		{
+			(*pCompletionRoutine) (nResult, pParam);
+		}
+	}
 }
 
 bool CNVMeDevice::WaitReady(bool bOn)
@@ -844,6 +1444,63 @@ bool CNVMeDevice::WaitReady(bool bOn)
 	return false;
 }
 
+bool CNVMeDevice::ConnectMSIX(void)
+{
+	assert(!m_bMSIX);
+
+	if (m_PCIeExternal.GetMSIXTableSize(PCIE_SLOT, PCIE_FUNC) < NVME_MSIX_VECTORS)
+	{
+		return false;
+	}
+
+	// Entry 0 is used by the Admin queue, entry IOQID(i) by the I/O queue of core i
+	for (unsigned i = 0; i < NVME_MSIX_VECTORS; i++)
+	{
+		unsigned nCore = i ? (i - 1) % CORES : 0;
+
+		m_nMSIVector[i] = m_PCIeExternal.AllocateMSIVector(MSIHandler, this, nCore);
+		if (   m_nMSIVector[i] < 0
+		    || !m_PCIeExternal.SetMSIXVector(PCIE_SLOT, PCIE_FUNC, i, m_nMSIVector[i]))
+		{
+			DisconnectMSIX();
+
+			return false;
+		}
+	}
+
+	if (!m_PCIeExternal.EnableMSIX(PCIE_SLOT, PCIE_FUNC))
+	{
+		DisconnectMSIX();
+
+		return false;
+	}
+
+	m_bMSIX = true;
+
+#ifdef NVME_DEBUG
+	LOGDBG("Using %u MSI-X vectors", NVME_MSIX_VECTORS);
+#endif
+
+	return true;
+}
+
+void CNVMeDevice::DisconnectMSIX(void)
+{
+	m_PCIeExternal.DisableMSI(PCIE_SLOT, PCIE_FUNC);
+
+	for (unsigned i = 0; i < NVME_MSIX_VECTORS; i++)
+	{
+		if (m_nMSIVector[i] >= 0)
+		{
+			m_PCIeExternal.FreeMSIVector(m_nMSIVector[i]);
+
+			m_nMSIVector[i] = -1;
+		}
+	}
+
+	m_bMSIX = false;
+}
+
 void CNVMeDevice::DumpStatus(void)
 {
 	for (u32 nOffset = 0; nOffset <= 0x3F; nOffset += 4)
@@ -856,20 +1513,60 @@ void CNVMeDevice::DumpStatus(void)
 	LOGDBG("%lu bytes shared memory free", m_Allocator.GetFreeSpace ());
 }
 
-#ifdef NO_BUSY_WAIT
-
 void CNVMeDevice::InterruptHandler (void *pParam)
 {
 	CNVMeDevice *pThis = static_cast<CNVMeDevice *> (pParam);
 	assert (pThis);
 
+	// INTx is level triggered and deasserted, when all completions have been consumed
 	MmioWrite32(NVME_REG_INTMS, NVME_REG_INTM_VECTOR0);
 
 #ifdef NVME_DEBUG
 	//LOGDBG("IRQ");
 #endif
 
+	pThis->ProcessCompletions(&pThis->m_AdminQueue);
+
+	for (unsigned i = 0; i < pThis->m_nIoQueues; i++)
+	{
+		pThis->ProcessCompletions(&pThis->m_IoQueue[i]);
+	}
+
+	MmioWrite32(NVME_REG_INTMC, NVME_REG_INTM_VECTOR0);
+
+#ifdef NO_BUSY_WAIT
 	pThis->m_Event.Set();
+#endif
 }
 
+void CNVMeDevice::MSIHandler (unsigned nVector, void *pParam)
+{
+	CNVMeDevice *pThis = static_cast<CNVMeDevice *> (pParam);
+	assert (pThis);
+
+	// MSI-X is edge triggered, each vector serves one completion queue
+	if (static_cast<int> (nVector) == pThis->m_nMSIVector[0])
+	{
+		pThis->ProcessCompletions(&pThis->m_AdminQueue);
+	}
+	else
+	{
+		for (unsigned i = 0; i < pThis->m_nIoQueues; i++)
+		{
+			if (static_cast<int> (nVector) == pThis->m_nMSIVector[IOQID(i)])
+			{
+				pThis->ProcessCompletions(&pThis->m_IoQueue[i]);
+
+				break;
+			}
+		}
+	}
+
+#ifdef NO_BUSY_WAIT
+	// The scheduler is available on core 0 only
+	if (ThisCore() == 0)
+	{
+		pThis->m_Event.Set();
+	}
 #endif
+}
@@ -21,14 +21,27 @@
 #define _nvme_nvmedevice_h
 
 #include <nvme/nvmesharedmemallocator.h>
+#include <nvme/nvmeprp.h>
 #include <circle/device.h>
 #include <circle/interrupt.h>
 #include <circle/bcmpciehostbridge.h>
 #include <circle/fs/partitionmanager.h>
+#include <circle/fs/fsdef.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
-#define NVME_LBA_SIZE	512	// The only supported NVMe LBA size format
+#define NVME_MIN_LBA_SIZE	512	// Supported NVMe LBA size formats
+#define NVME_MAX_LBA_SIZE	4096
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define NVME_IO_QUEUES	CORES	// One I/O queue pair per core
+#else
+	#define NVME_IO_QUEUES	1
+#endif
+
+#define NVME_MSIX_VECTORS	(NVME_IO_QUEUES + 1)	// Admin queue and one per I/O queue
 
 enum NVME_STATUS : int
 {
@@ -74,7 +87,10 @@ public:
 	/// \param ulCmd The IOCtl command to invoke
 	/// \param pData Depends on command, used to return command specific data
 	/// \return Zero on success, or error code on failure
-	/// \note Currently only supports DEVICE_IOCTL_SYNC.
+	/// \note Supports DEVICE_IOCTL_SYNC, DEVICE_IOCTL_SUBMIT and DEVICE_IOCTL_DISCARD.
+	/// \note DEVICE_IOCTL_DISCARD fails, if the controller does not support Deallocate.
+	/// \note The completion routine of DEVICE_IOCTL_SUBMIT is called from interrupt context,
+	///	  or from the submitting core, when it waits for a synchronous command.
 	int IOCtl (unsigned long ulCmd, void *pData) override;
 
 	void DumpStatus(void);
@@ -84,6 +100,9 @@ private:
 	// nNamespaceId: target namespace id (typically 1)
 	int Flush(u32 nNamespaceId);
 
+	// Deallocate (trim) a range of bytes with the Dataset Management command
+	int Deallocate(u64 ulOffset, u64 ulCount);
+
 	// Send an Admin Identify command to get controller/namespace data.
 	// pOutBuf must point to a buffer of at least 4096 bytes physically mapped.
 	int Identify(u32 nCns, void *pOutBuf, u32 uNsId = 0);
@@ -96,12 +115,35 @@ private:
 	// bIsWrite: true for write, false for read
 	int IoPassThrough(u32 nNamespaceId, u64 nLba, u32 nBlocks, void *pBuffer, bool bIsWrite);
 
+	// Queue an asynchronous I/O command for DEVICE_IOCTL_SUBMIT
+	int SubmitRequest(const TDeviceBlockRequest *pRequest);
+
 	// Admin command submitter
 	int AdminCommand(u8 nOpcode, u32 nNsId, u32 nCdw10, u32 nCdw11, u64 ulDataPhysAddr);
 
-	// Internal helpers
-	int CreateAdminQueues(void);
-	int CreateIoQueue(u16 usQueueId, u16 usEntries);
+	// Request nQueues I/O queue pairs, returns the number of granted pairs
+	unsigned SetNumberOfQueues(unsigned nQueues);
+
+	struct TCommandSlot	// State of an outstanding command, indexed by CID
+	{
+		bool bBusy;
+		bool bAbandoned;		// waiter timed out, free on completion
+		volatile bool bDone;		// synchronous command has been completed
+		int  nResult;
+		u32  nDw0;			// command specific result
+
+		TDeviceCompletionRoutine *pCompletionRoutine;	// nullptr for synchronous commands
+		void *pParam;
+
+		void  *pTransferBuffer;		// buffer used for DMA
+		void  *pReadBuffer;		// destination of an asynchronous read
+		u8    *pBounceBuffer;		// if the user buffer is not cache aligned
+		size_t ulLength;
+
+		CNVMePRP PRP;
+
+		u16   usNext;			// free list or list of finished commands
+	};
 
 	struct TQueue
 	{
@@ -113,45 +155,81 @@ private:
 		void *pCqVirt;		// virtual pointer to Completion Queue array
 		u64   nSqPhys;		// physical address of Submission Queue array
 		u64   nCqPhys;		// physical address of Completion Queue array
+		u8   *pMemory;		// allocated block of I/O queue arrays
 
 		u16   nSqTail;		// tail index for Submission Queue
+		u16   nSqHead;		// head index for Submission Queue, as reported by controller
 		u16   nCqHead;		// head index for Completion Queue
 		bool  bCqPhase;		// phase state of Completion Queue
+
+		TCommandSlot *pSlots;	// one per CID, nEntries-1 are usable
+		u16   usFreeSlot;	// head of free list
+
+		CSpinLock SpinLock;	// protects queue and slots, used from IRQ
 	};
 
-	// Submit command with opcode to queue with namespace id and parameters
+	// Internal helpers
+	int CreateAdminQueues(void);
+	int CreateIoQueue(TQueue *pQueue, u16 usQueueId, u16 usEntries);
+	bool InitQueue(TQueue *pQueue, const char *pName, u16 usID, u16 usEntries);
+	void FreeQueue(TQueue *pQueue);
+
+	// Queue of the calling core
+	TQueue *GetIoQueue(void);
+
+	// Allocate a CID, pCompletionRoutine is nullptr for synchronous commands
+	int AllocateCommand(TQueue *pQueue, TDeviceCompletionRoutine *pCompletionRoutine = nullptr,
+			    void *pParam = nullptr);
+	void FreeCommand(TQueue *pQueue, u16 usCid);
+
+	// Place command with opcode into queue with namespace id and parameters
+	void IssueCommand(TQueue *pQueue, u16 usCid, u8 uchOpcode, u32 nNsId,
+			  u32 nCdw10, u32 nCdw11, u32 nCdw12,
+			  u64 ulPrp1, u64 ulPrp2);
+
+	// Submit command synchronously
 	int SubmitCommand(TQueue *pQueue, u8 uchOpcode, u32 nNsId,
 			  u32 nCdw10, u32 nCdw11, u32 nCdw12,
-			  uintptr ulPrp1, uintptr ulPrp2);
+			  uintptr ulPrp1, uintptr ulPrp2, u32 *pDw0 = nullptr);
+
+	// Wait for command completion for up to nTimeoutHZ ticks, frees the CID
+	int WaitForCompletion(TQueue *pQueue, u16 usCid, unsigned nTimeoutHZ, u32 *pDw0 = nullptr);
 
-	// Poll queue for command completion for up to nTimeoutHZ ticks
-	int PollForCompletion(TQueue *pQueue, u16 usCid, unsigned nTimeoutHZ);
+	// Consume completion queue entries and complete asynchronous commands
+	void ProcessCompletions(TQueue *pQueue);
 
 	// Wait for CSTS.RDY to equal target (true -> 1, false -> 0)
 	bool WaitReady(bool bOn);
 
-#ifdef NO_BUSY_WAIT
+	// Connect one MSI-X vector per completion queue, routed to the core of the queue
+	bool ConnectMSIX(void);
+	void DisconnectMSIX(void);
+
 	static void InterruptHandler (void *pParam);
-#endif
+	static void MSIHandler (unsigned nVector, void *pParam);
 
 private:
 	CBcmPCIeHostBridge m_PCIeExternal;
 	CNVMeSharedMemAllocator m_Allocator;
 
-#ifdef NO_BUSY_WAIT
 	CInterruptSystem *m_pInterrupt;
 	bool m_bIRQConnected;
-#endif
+	bool m_bMSIX;			// MSI-X is used instead of INTx
+	int m_nMSIVector[NVME_MSIX_VECTORS];	// host bridge vector per MSI-X table entry
 
 	u32 m_nVersion;
 	u64 m_ulCaps;
 	unsigned m_nDoorbellStride;
 	unsigned m_nTimeoutHZ;		// RDY timeout in HZ units
+	size_t m_ulMaxTransfer;		// bytes per command
+	bool m_bDeallocate;		// Dataset Management is supported
 
 	TQueue m_AdminQueue;
-	TQueue m_IoQueue;
+	TQueue m_IoQueue[NVME_IO_QUEUES];
+	volatile unsigned m_nIoQueues;	// number of created I/O queues
 
 	u64 m_ulNamespaceSize;
+	size_t m_ulLBASize;		// bytes per logical block
 	u64 m_ulOffset;
 
 	CPartitionManager *m_pPartitionManager;
@@ -19,38 +19,40 @@
 //
 #include <nvme/nvmeprp.h>
 #include <nvme/nvmehelper.h>
-#include <circle/util.h>
+#include <circle/new.h>
 #include <assert.h>
 
 #define PRP_PAGE_SIZE	NVME_PAGE_SIZE		// Page size used by PRP builder
 
 #define PRP_ENTRY_SIZE	8			// Size per PRP entry
 
-CNVMePRP::CNVMePRP(CNVMeSharedMemAllocator *pAllocator)
-:	m_pAllocator(pAllocator),
-	m_uPrp1(0),
+CNVMePRP::CNVMePRP(void)
+:	m_uPrp1(0),
 	m_uPrp2(0),
-	m_pPrpListVirt(nullptr),
-	m_nPrpListPages(0)
+	m_pPrpList(nullptr)
 {
 }
 
 CNVMePRP::~CNVMePRP()
 {
-	if (m_pPrpListVirt)
-	{
-		m_pAllocator->Free(m_pPrpListVirt);
-		m_pPrpListVirt = nullptr;
-		m_nPrpListPages = 0;
-		m_uPrp1 = 0;
-		m_uPrp2 = 0;
-	}
+	Release();
+}
+
+void CNVMePRP::Release(void)
+{
+	delete [] m_pPrpList;
+	m_pPrpList = nullptr;
+
+	m_uPrp1 = 0;
+	m_uPrp2 = 0;
 }
 
 bool CNVMePRP::BuildForBuffer(void *pBuffer, size_t ulLength)
 {
 	if (!pBuffer || ulLength == 0) return false;
 
+	Release();
+
 	// Buffer is physically contiguous or described by page addresses
 	// We'll compute PRP1 as physical address of the first page + offset within page.
 	uintptr uBuf = reinterpret_cast<uintptr>(pBuffer);
@@ -85,35 +87,41 @@ bool CNVMePRP::BuildForBuffer(void *pBuffer, size_t ulLength)
 		return true;
 	}
 
-	// Need PRP list pages. Each PRP list page can hold PRP_PAGE_SIZE / PRP_ENTRY_SIZE entries.
+	// Need a PRP list. The last entry of each list page points to the next list page,
+	// if more entries follow. The list is allocated as one block, which may start
+	// anywhere in a page, so the next list page simply is the following entry.
 	size_t uEntriesPerPage = PRP_PAGE_SIZE / PRP_ENTRY_SIZE;
 	size_t uNeededEntries = (uRemaining + PRP_PAGE_SIZE - 1) / PRP_PAGE_SIZE;
+	size_t uListEntries = uNeededEntries + uNeededEntries / (uEntriesPerPage - 1) + 1;
 
-	// Allocate one or more pages for PRP list
-	size_t uPages = (uNeededEntries + uEntriesPerPage - 1) / uEntriesPerPage;
-	void *pList = m_pAllocator->Allocate(uPages * PRP_PAGE_SIZE, PRP_PAGE_SIZE);
-	if (!pList)
+	m_pPrpList = new (HEAP_COHERENT) u64[uListEntries];
+	if (!m_pPrpList)
 	{
 		return false;
 	}
 
-	memset(pList, 0, uPages * PRP_PAGE_SIZE);
-
 	// Fill list with subsequent page physical addresses
-	u64 *pEntries = reinterpret_cast<u64 *>(pList);
+	u64 *pEntry = m_pPrpList;
 	uintptr uCurPageVirt = uSecondPageVirt;
 	for (size_t i = 0; i < uNeededEntries; ++i)
 	{
+		if (   i < uNeededEntries - 1
+		    && !((reinterpret_cast<uintptr>(pEntry) + PRP_ENTRY_SIZE) & (PRP_PAGE_SIZE - 1)))
+		{
+			// last entry in list page, chain to the next list page
+			*pEntry = PhysicalOf(pEntry + 1);
+			pEntry++;
+		}
+
+		assert(pEntry < m_pPrpList + uListEntries);
+
 		// compute physical of current page
 		void *pPagePtr = reinterpret_cast<void *>(uCurPageVirt + i * PRP_PAGE_SIZE);
-		pEntries[i] = PhysicalOf(pPagePtr);
+		*pEntry++ = PhysicalOf(pPagePtr);
 	}
 
-	m_pPrpListVirt = pList;
-	m_nPrpListPages = uPages;
-
-	// PRP2 should point to the PRP list page physical address
-	m_uPrp2 = PhysicalOf(pList);
+	// PRP2 should point to the PRP list physical address
+	m_uPrp2 = PhysicalOf(m_pPrpList);
 
 	return true;
 }
@@ -26,23 +26,23 @@
 class CNVMePRP	// Helper to build PRP1 / PRP2 and optional PRP list pages for a given buffer
 {
 public:
-	CNVMePRP(CNVMeSharedMemAllocator *pAllocator);
+	CNVMePRP(void);
 	~CNVMePRP(void);
 
 	// Build PRP descriptors for given buffer and length (bytes)
 	bool BuildForBuffer(void *pBuffer, size_t ulLength);
 
+	// Free PRP list, can be called from interrupt context
+	void Release(void);
+
 	u64 Prp1(void) const	{ return m_uPrp1; }
 	u64 Prp2(void) const	{ return m_uPrp2; }
 
 private:
-	CNVMeSharedMemAllocator *m_pAllocator;
-
 	u64 m_uPrp1;
 	u64 m_uPrp2;
 
-	void *m_pPrpListVirt;		// virtual pointer of PRP list page (if allocated)
-	unsigned m_nPrpListPages;	// number of pages used for PRP list
+	u64 *m_pPrpList;		// PRP list pages (if allocated) from DMA coherent pool
 };
 
 #endif
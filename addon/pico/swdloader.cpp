@@ -2,7 +2,7 @@
 // swdloader.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2021-2026  R. Stange <rsta2@gmx.net>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -29,12 +29,17 @@
 //
 // [1] ARM Debug Interface Architecture Specification ADIv5.0 to ADIv5.2, IHI 0031E
 // [2] ARM v6-M Architecture Reference Manual, DDI 0419E
+// [3] RP2040 Datasheet, section 2.8.3 Bootrom Contents
 //
 
 // Debug Port v2
 
 #define TURN_CYCLES		1
 
+#define MAX_WAIT_RETRIES	100
+
+#define TAR_WRAP_SIZE		1024	// TAR auto-increment is guaranteed in this range only
+
 // SWD-DP Requests
 #define WR_DP_ABORT		0x81
 	#define DP_ABORT_STKCMPCLR		BIT(1)
@@ -86,20 +91,43 @@
 #define DHCSR			0xE000EDF0
 	#define DHCSR_C_DEBUGEN			BIT(0)
 	#define DHCSR_C_HALT			BIT(1)
+	#define DHCSR_C_MASKINTS		BIT(3)
+	#define DHCSR_S_REGRDY			BIT(16)
+	#define DHCSR_S_HALT			BIT(17)
 	#define DHCSR_DBGKEY__SHIFT		16
-		#define DHCSR_DBGKEY_KEY		0xA05F
+		#define DHCSR_DBGKEY_KEY		0xA05FU
 #define DCRSR			0xE000EDF4
 	#define DCRSR_REGSEL__SHIFT		0
+		#define DCRSR_REGSEL_R0			0
+		#define DCRSR_REGSEL_SP			13
+		#define DCRSR_REGSEL_LR			14
 		#define DCRSR_REGSEL_R15		15	// PC register
+		#define DCRSR_REGSEL_XPSR		16
+			#define XPSR_T			BIT(24)
 	#define DCRSR_REGW_N_R			BIT(16)
 #define DCRDR			0xE000EDF8
 
+// RP2040 boot ROM ([3])
+#define ROM_FUNC_TABLE		0x00000014	// 16-bit pointer to table of (code, function)
+	#define ROM_CODE(c1, c2)		((c1) | (c2) << 8)
+#define FLASH_SECTOR_SIZE	4096
+#define FLASH_BLOCK_SIZE	0x10000
+#define FLASH_BLOCK_ERASE_CMD	0xD8
+#define FLASH_PAGE_SIZE		256
+
+// RP2040 SRAM usage while calling ROM functions
+#define RAM_BREAKPOINT		0x20000000	// BKPT instruction to return to
+#define RAM_BUFFER		0x20000100	// data staging buffer
+#define RAM_BUFFER_SIZE		0x20000
+#define RAM_STACK_TOP		0x20042000
+
 LOGMODULE ("swdloader");
 
 CSWDLoader::CSWDLoader (unsigned nClockPin, unsigned nDataPin, unsigned nResetPin,
 			unsigned nClockRateKHz)
 :	m_bResetAvailable (nResetPin != 0),
-	m_nDelayNanos (1000000U / nClockRateKHz / 2),
+	m_nDelayNanos (nClockRateKHz < MaxClockRateKHz ? 1000000U / nClockRateKHz / 2 : 0),
+	m_bDataOutput (TRUE),
 	m_ClockPin (nClockPin, GPIOModeOutput),
 	m_DataPin (nDataPin, GPIOModeOutput),
 	m_pTimer (CTimer::Get ())
@@ -233,6 +261,13 @@ boolean CSWDLoader::LoadChunk (const void *pChunk, size_t nChunkSize, u32 nAddre
 	assert ((nChunkSize & 3) == 0);
 	while (nChunkSize > 0)
 	{
+		// TAR is written once per block, DRW writes increment it
+		size_t nBlockSize = TAR_WRAP_SIZE - (nAddress & (TAR_WRAP_SIZE-1));
+		if (nBlockSize > nChunkSize)
+		{
+			nBlockSize = nChunkSize;
+		}
+
 		BeginTransaction ();
 
 		if (!WriteData (WR_AP_TAR, nAddress))
@@ -242,30 +277,20 @@ boolean CSWDLoader::LoadChunk (const void *pChunk, size_t nChunkSize, u32 nAddre
 			return FALSE;
 		}
 
-		const size_t BlockSize = 1024;
-		for (unsigned i = 0; i < BlockSize; i += 4)
+		for (unsigned i = 0; i < nBlockSize; i += 4)
 		{
 			if (!WriteData (WR_AP_DRW, *pChunk32++))
 			{
-				LOGERR ("Memory write failed (0x%X)", nAddress);
+				LOGERR ("Memory write failed (0x%X)", nAddress + i);
 
 				return FALSE;
 			}
-
-			if (nChunkSize > 4)
-			{
-				nChunkSize -= 4;
-			}
-			else
-			{
-				nChunkSize = 0;
-				break;
-			}
 		}
 
-		nAddress += BlockSize;
-
 		EndTransaction ();
+
+		nAddress += nBlockSize;
+		nChunkSize -= nBlockSize;
 	}
 
 	BeginTransaction ();
@@ -274,6 +299,8 @@ boolean CSWDLoader::LoadChunk (const void *pChunk, size_t nChunkSize, u32 nAddre
 	if (!ReadMem (nAddressCopy, &nFirstWordRead))
 	{
 		LOGERR ("Memory read failed (0x%X)", nAddressCopy);
+
+		return FALSE;
 	}
 
 	EndTransaction ();
@@ -288,6 +315,177 @@ boolean CSWDLoader::LoadChunk (const void *pChunk, size_t nChunkSize, u32 nAddre
 	return TRUE;
 }
 
+boolean CSWDLoader::ReadChunk (void *pBuffer, size_t nChunkSize, u32 nAddress)
+{
+	u32 *pBuffer32 = (u32 *) pBuffer;
+	assert (pBuffer32 != 0);
+	assert ((nChunkSize & 3) == 0);
+	assert ((nAddress & 3) == 0);
+
+	while (nChunkSize > 0)
+	{
+		size_t nBlockSize = TAR_WRAP_SIZE - (nAddress & (TAR_WRAP_SIZE-1));
+		if (nBlockSize > nChunkSize)
+		{
+			nBlockSize = nChunkSize;
+		}
+
+		BeginTransaction ();
+
+		// AP reads are posted, each one returns the result of the previous read,
+		// the first result is discarded and the last one is read from RDBUFF
+		u32 nData;
+		if (   !WriteData (WR_AP_TAR, nAddress)
+		    || !ReadData (RD_AP_DRW, &nData))
+		{
+			LOGERR ("Memory read failed (0x%X)", nAddress);
+
+			return FALSE;
+		}
+
+		for (unsigned i = 4; i < nBlockSize; i += 4)
+		{
+			if (!ReadData (RD_AP_DRW, pBuffer32++))
+			{
+				LOGERR ("Memory read failed (0x%X)", nAddress + i);
+
+				return FALSE;
+			}
+		}
+
+		if (!ReadData (RD_DP_RDBUFF, pBuffer32++))
+		{
+			LOGERR ("Memory read failed (0x%X)", nAddress);
+
+			return FALSE;
+		}
+
+		EndTransaction ();
+
+		nAddress += nBlockSize;
+		nChunkSize -= nBlockSize;
+	}
+
+	return TRUE;
+}
+
+boolean CSWDLoader::Flash (const void *pImage, size_t nImageSize, u32 nFlashOffset)
+{
+	const u8 *pImage8 = (const u8 *) pImage;
+	assert (pImage8 != 0);
+	assert (nImageSize > 0);
+	assert ((nImageSize & 3) == 0);
+	assert ((nFlashOffset & (FLASH_SECTOR_SIZE-1)) == 0);
+
+	if (!Halt ())
+	{
+		return FALSE;
+	}
+
+	unsigned nStartTicks = m_pTimer->GetClockTicks ();
+
+	u32 nConnectInternalFlash = LookupROMFunction ('I', 'F');
+	u32 nFlashExitXIP = LookupROMFunction ('E', 'X');
+	u32 nFlashRangeErase = LookupROMFunction ('R', 'E');
+	u32 nFlashRangeProgram = LookupROMFunction ('R', 'P');
+	u32 nFlashFlushCache = LookupROMFunction ('F', 'C');
+	u32 nFlashEnterCmdXIP = LookupROMFunction ('C', 'X');
+	if (   !nConnectInternalFlash
+	    || !nFlashExitXIP
+	    || !nFlashRangeErase
+	    || !nFlashRangeProgram
+	    || !nFlashFlushCache
+	    || !nFlashEnterCmdXIP)
+	{
+		LOGERR ("Boot ROM functions not found");
+
+		return FALSE;
+	}
+
+	// return point of the called functions
+	BeginTransaction ();
+
+	if (!WriteMem (RAM_BREAKPOINT, 0xBE00BE00))	// BKPT #0
+	{
+		return FALSE;
+	}
+
+	EndTransaction ();
+
+	u32 nEraseSize = (nImageSize + FLASH_SECTOR_SIZE-1) & ~(FLASH_SECTOR_SIZE-1);
+
+	if (   !CallFunction (nConnectInternalFlash)
+	    || !CallFunction (nFlashExitXIP)
+	    || !CallFunction (nFlashRangeErase, nFlashOffset, nEraseSize,
+			      FLASH_BLOCK_SIZE, FLASH_BLOCK_ERASE_CMD, 30000))
+	{
+		LOGERR ("Flash erase failed");
+
+		return FALSE;
+	}
+
+	// stage the image in target RAM and program it from there
+	for (size_t nOffset = 0; nOffset < nImageSize; nOffset += RAM_BUFFER_SIZE)
+	{
+		size_t nSize = nImageSize - nOffset;
+		if (nSize > RAM_BUFFER_SIZE)
+		{
+			nSize = RAM_BUFFER_SIZE;
+		}
+
+		if (!LoadChunk (pImage8 + nOffset, nSize, RAM_BUFFER))
+		{
+			return FALSE;
+		}
+
+		// pad the last page with erased flash content
+		size_t nProgramSize = (nSize + FLASH_PAGE_SIZE-1) & ~(FLASH_PAGE_SIZE-1);
+		if (nProgramSize > nSize)
+		{
+			BeginTransaction ();
+
+			if (!WriteData (WR_AP_TAR, RAM_BUFFER + nSize))
+			{
+				return FALSE;
+			}
+
+			for (size_t i = nSize; i < nProgramSize; i += 4)
+			{
+				if (!WriteData (WR_AP_DRW, 0xFFFFFFFFU))
+				{
+					return FALSE;
+				}
+			}
+
+			EndTransaction ();
+		}
+
+		if (!CallFunction (nFlashRangeProgram, nFlashOffset + nOffset, RAM_BUFFER,
+				   nProgramSize, 0, 5000))
+		{
+			LOGERR ("Flash program failed (offset 0x%X)", nFlashOffset + nOffset);
+
+			return FALSE;
+		}
+	}
+
+	if (   !CallFunction (nFlashFlushCache)
+	    || !CallFunction (nFlashEnterCmdXIP))
+	{
+		LOGERR ("Cannot re-enable XIP");
+
+		return FALSE;
+	}
+
+	unsigned nEndTicks = m_pTimer->GetClockTicks ();
+	double fDuration = (double) (nEndTicks - nStartTicks) / CLOCKHZ;
+
+	LOGNOTE ("%u bytes flashed in %.2f seconds (%.1f KBytes/s)",
+		 nImageSize, fDuration, nImageSize / fDuration / 1024.0);
+
+	return TRUE;
+}
+
 boolean CSWDLoader::Start (u32 nAddress)
 {
 	BeginTransaction ();
@@ -323,8 +521,8 @@ boolean CSWDLoader::PowerOn (void)
 		return FALSE;
 	}
 
-	if (!WriteData (WR_DP_CTRL_STAT,   DP_CTRL_STAT_ORUNDETECT
-					 | DP_CTRL_STAT_STICKYERR
+	// no overrun detection, so that a WAIT response can simply be retried
+	if (!WriteData (WR_DP_CTRL_STAT,   DP_CTRL_STAT_STICKYERR
 					 | DP_CTRL_STAT_CDBGPWRUPREQ
 					 | DP_CTRL_STAT_CSYSPWRUPREQ))
 	{
@@ -361,16 +559,172 @@ boolean CSWDLoader::ReadMem (u32 nAddress, u32 *pData)
 	       && ReadData (RD_DP_RDBUFF, pData);
 }
 
+boolean CSWDLoader::ReadMem16 (u32 nAddress, u16 *pData)
+{
+	u32 nData;
+	if (!ReadMem (nAddress & ~3, &nData))
+	{
+		return FALSE;
+	}
+
+	assert (pData != 0);
+	*pData = (u16) (nData >> (nAddress & 2) * 8);
+
+	return TRUE;
+}
+
+boolean CSWDLoader::WriteCoreRegister (unsigned nRegister, u32 nValue)
+{
+	if (   !WriteMem (DCRDR, nValue)
+	    || !WriteMem (DCRSR, (nRegister << DCRSR_REGSEL__SHIFT) | DCRSR_REGW_N_R))
+	{
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < 100; i++)
+	{
+		u32 nDHCSR;
+		if (!ReadMem (DHCSR, &nDHCSR))
+		{
+			return FALSE;
+		}
+
+		if (nDHCSR & DHCSR_S_REGRDY)
+		{
+			return TRUE;
+		}
+	}
+
+	EndTransaction ();
+
+	return FALSE;
+}
+
+boolean CSWDLoader::WaitForHalt (unsigned nTimeoutMs)
+{
+	unsigned nStartTicks = m_pTimer->GetClockTicks ();
+
+	do
+	{
+		// do not block interrupts for the whole wait time
+		BeginTransaction ();
+
+		u32 nDHCSR;
+		if (!ReadMem (DHCSR, &nDHCSR))
+		{
+			return FALSE;
+		}
+
+		EndTransaction ();
+
+		if (nDHCSR & DHCSR_S_HALT)
+		{
+			return TRUE;
+		}
+	}
+	while (m_pTimer->GetClockTicks () - nStartTicks < nTimeoutMs * (CLOCKHZ / 1000));
+
+	return FALSE;
+}
+
+u32 CSWDLoader::LookupROMFunction (char chCode1, char chCode2)
+{
+	BeginTransaction ();
+
+	u16 usTable;
+	if (!ReadMem16 (ROM_FUNC_TABLE, &usTable))
+	{
+		return 0;
+	}
+
+	for (u32 nEntry = usTable; ; nEntry += 4)
+	{
+		u16 usCode;
+		if (!ReadMem16 (nEntry, &usCode))
+		{
+			return 0;
+		}
+
+		if (usCode == 0)
+		{
+			break;
+		}
+
+		if (usCode == ROM_CODE (chCode1, chCode2))
+		{
+			u16 usFunction;
+			if (!ReadMem16 (nEntry + 2, &usFunction))
+			{
+				return 0;
+			}
+
+			EndTransaction ();
+
+			return usFunction;
+		}
+	}
+
+	EndTransaction ();
+
+	return 0;
+}
+
+// calls a function on the halted target, which returns to the breakpoint in RAM
+boolean CSWDLoader::CallFunction (u32 nFunction, u32 nArg0, u32 nArg1, u32 nArg2, u32 nArg3,
+				  unsigned nTimeoutMs)
+{
+	BeginTransaction ();
+
+	if (   !WriteCoreRegister (DCRSR_REGSEL_R0,   nArg0)
+	    || !WriteCoreRegister (DCRSR_REGSEL_R0+1, nArg1)
+	    || !WriteCoreRegister (DCRSR_REGSEL_R0+2, nArg2)
+	    || !WriteCoreRegister (DCRSR_REGSEL_R0+3, nArg3)
+	    || !WriteCoreRegister (DCRSR_REGSEL_SP, RAM_STACK_TOP)
+	    || !WriteCoreRegister (DCRSR_REGSEL_LR, RAM_BREAKPOINT | 1)
+	    || !WriteCoreRegister (DCRSR_REGSEL_R15, nFunction & ~1)
+	    || !WriteCoreRegister (DCRSR_REGSEL_XPSR, XPSR_T)
+	    || !WriteMem (DHCSR,   DHCSR_C_DEBUGEN
+				 | DHCSR_C_HALT
+				 | DHCSR_C_MASKINTS
+				 | (DHCSR_DBGKEY_KEY << DHCSR_DBGKEY__SHIFT))
+	    || !WriteMem (DHCSR,   DHCSR_C_DEBUGEN
+				 | DHCSR_C_MASKINTS
+				 | (DHCSR_DBGKEY_KEY << DHCSR_DBGKEY__SHIFT)))
+	{
+		LOGERR ("Cannot call function (0x%X)", nFunction);
+
+		return FALSE;
+	}
+
+	EndTransaction ();
+
+	if (!WaitForHalt (nTimeoutMs))
+	{
+		LOGERR ("Function does not return (0x%X)", nFunction);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
 boolean CSWDLoader::WriteData (u8 nRequest, u32 nData)
 {
-	WriteBits (nRequest, 7);
+	u32 nResponse;
+	unsigned nRetries = MAX_WAIT_RETRIES;
+	do
+	{
+		WriteBits (nRequest, 7);
 
-	assert (nRequest & 0x80);
-	ReadBits (1 + TURN_CYCLES);	// park bit (not driven) and turn cycle
+		assert (nRequest & 0x80);
+		ReadBits (1 + TURN_CYCLES);	// park bit (not driven) and turn cycle
 
-	u32 nResponse = ReadBits (3);
+		nResponse = ReadBits (3);
 
-	ReadBits (TURN_CYCLES);
+		ReadBits (TURN_CYCLES);
+	}
+	while (   nResponse == DP_WAIT
+	       && --nRetries > 0);
 
 	if (nResponse != DP_OK)
 	{
@@ -390,12 +744,24 @@ boolean CSWDLoader::WriteData (u8 nRequest, u32 nData)
 
 boolean CSWDLoader::ReadData (u8 nRequest, u32 *pData)
 {
-	WriteBits (nRequest, 7);
+	u32 nResponse;
+	unsigned nRetries = MAX_WAIT_RETRIES;
+	while (1)
+	{
+		WriteBits (nRequest, 7);
+
+		assert (nRequest & 0x80);
+		ReadBits (1 + TURN_CYCLES);	// park bit (not driven) and turn cycle
 
-	assert (nRequest & 0x80);
-	ReadBits (1 + TURN_CYCLES);	// park bit (not driven) and turn cycle
+		nResponse = ReadBits (3);
+		if (   nResponse != DP_WAIT
+		    || --nRetries == 0)
+		{
+			break;
+		}
 
-	u32 nResponse = ReadBits (3);
+		ReadBits (TURN_CYCLES);
+	}
 
 	if (nResponse != DP_OK)
 	{
@@ -483,13 +849,13 @@ void CSWDLoader::WriteIdle (void)
 
 	m_ClockPin.Write (LOW);
 
-	m_DataPin.SetMode (GPIOModeOutput, FALSE);
+	SetDataOutput (TRUE);
 	m_DataPin.Write (LOW);
 }
 
 void CSWDLoader::WriteBits (u32 nBits, unsigned nBitCount)
 {
-	m_DataPin.SetMode (GPIOModeOutput, FALSE);
+	SetDataOutput (TRUE);
 
 	while (nBitCount--)
 	{
@@ -503,7 +869,7 @@ void CSWDLoader::WriteBits (u32 nBits, unsigned nBitCount)
 
 u32 CSWDLoader::ReadBits (unsigned nBitCount)
 {
-	m_DataPin.SetMode (GPIOModeInput, FALSE);
+	SetDataOutput (FALSE);
 
 	u32 nBits = 0;
 	unsigned nRemaining = nBitCount--;
@@ -523,8 +889,25 @@ u32 CSWDLoader::ReadBits (unsigned nBitCount)
 void CSWDLoader::WriteClock (void)
 {
 	m_ClockPin.Write (LOW);
-	m_pTimer->nsDelay (m_nDelayNanos);
+	if (m_nDelayNanos)
+	{
+		m_pTimer->nsDelay (m_nDelayNanos);
+	}
 
 	m_ClockPin.Write (HIGH);
-	m_pTimer->nsDelay (m_nDelayNanos);
+	if (m_nDelayNanos)
+	{
+		m_pTimer->nsDelay (m_nDelayNanos);
+	}
+}
+
+void CSWDLoader::SetDataOutput (boolean bOutput)
+{
+	// changing the pin mode is expensive, so do it on direction changes only
+	if (m_bDataOutput != bOutput)
+	{
+		m_DataPin.SetMode (bOutput ? GPIOModeOutput : GPIOModeInput, FALSE);
+
+		m_bDataOutput = bOutput;
+	}
 }
@@ -2,7 +2,7 @@
 // swdloader.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2021-2026  R. Stange <rsta2@gmx.net>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -28,6 +28,7 @@ class CSWDLoader	/// Loads a program via the Serial Wire Debug interface to the
 {
 public:
 	const static unsigned DefaultClockRateKHz = 400;	///< Default clock rate in KHz
+	const static unsigned MaxClockRateKHz = 10000;		///< Clock without delay from here
 
 public:
 	/// \param nClockPin GPIO pin to which SWCLK is connected
@@ -36,6 +37,8 @@ public:
 	/// \param nClockRateKHz Requested interface clock rate in KHz
 	/// \note GPIO pin numbers are SoC number, not header positions.
 	/// \note The actual clock rate may be smaller than the requested.
+	/// \note With nClockRateKHz >= MaxClockRateKHz, the clock is generated without any\n
+	///	  delay and the rate is limited by the GPIO access time only (use short wires).
 	CSWDLoader (unsigned nClockPin, unsigned nDataPin, unsigned nResetPin = 0,
 		    unsigned nClockRateKHz = DefaultClockRateKHz);
 
@@ -51,6 +54,15 @@ public:
 	/// \param nAddress Load and start address of the program image
 	boolean Load (const void *pProgram, size_t nProgSize, u32 nAddress);
 
+	/// \brief Halt the RP2040 and program an image into its flash memory
+	/// \param pImage Pointer to the image in memory
+	/// \param nImageSize Size of the image (must be a multiple of 4)
+	/// \param nFlashOffset Byte offset in flash memory (must be a multiple of 4096)
+	/// \return Operation successful?
+	/// \note Uses the flash functions of the RP2040 boot ROM, which are called via SWD.\n
+	///	  The RP2040 remains halted, reset it (e.g. with Initialize()) to boot the image.
+	boolean Flash (const void *pImage, size_t nImageSize, u32 nFlashOffset = 0);
+
 public:
 	/// \brief Halt the RP2040
 	/// \return Operation successful?
@@ -63,6 +75,13 @@ public:
 	/// \return Operation successful?
 	boolean LoadChunk (const void *pChunk, size_t nChunkSize, u32 nAddress);
 
+	/// \brief Read a chunk of memory from the RP2040 (with pipelined reads)
+	/// \param pBuffer Pointer to the destination buffer
+	/// \param nChunkSize Size of the chunk (must be a multiple of 4)
+	/// \param nAddress Address of the chunk (must be word aligned)
+	/// \return Operation successful?
+	boolean ReadChunk (void *pBuffer, size_t nChunkSize, u32 nAddress);
+
 	/// \brief Start program image
 	/// \param nAddress Start address of the program image
 	/// \return Operation successful?
@@ -73,6 +92,14 @@ private:
 
 	boolean WriteMem (u32 nAddress, u32 nData);
 	boolean ReadMem (u32 nAddress, u32 *pData);
+	boolean ReadMem16 (u32 nAddress, u16 *pData);
+
+	boolean WriteCoreRegister (unsigned nRegister, u32 nValue);
+	boolean WaitForHalt (unsigned nTimeoutMs);
+
+	u32 LookupROMFunction (char chCode1, char chCode2);	// returns 0 if not found
+	boolean CallFunction (u32 nFunction, u32 nArg0 = 0, u32 nArg1 = 0, u32 nArg2 = 0,
+			      u32 nArg3 = 0, unsigned nTimeoutMs = 1000);
 
 	boolean WriteData (u8 uchRequest, u32 nData);
 	boolean ReadData (u8 uchRequest, u32 *pData);
@@ -89,10 +116,12 @@ private:
 	void WriteBits (u32 nBits, unsigned nBitCount);
 	u32 ReadBits (unsigned nBitCount);
 	void WriteClock (void);
+	void SetDataOutput (boolean bOutput);
 
 private:
 	unsigned m_bResetAvailable;
 	unsigned m_nDelayNanos;
+	boolean m_bDataOutput;
 
 	CGPIOPin m_ResetPin;
 	CGPIOPin m_ClockPin;
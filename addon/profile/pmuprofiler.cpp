@@ -0,0 +1,443 @@
+//
+// pmuprofiler.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <profile/pmuprofiler.h>
+#include <profile/glibc_compat.h>
+#include <circle/devicenameservice.h>
+#include <circle/interrupt.h>
+#include <circle/exceptionstub.h>
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define STACK_SPAN_MAX		0x100000	// frames must be within this range above the SP
+
+#define PMCR_E			(1 << 0)	// enable all counters
+#define PMCR_P			(1 << 1)	// reset event counters
+#define PMCR_C			(1 << 2)	// reset cycle counter
+
+#define PMU_COUNTER0		(1 << 0)
+#define PMU_CYCLE_COUNTER	(1U << 31)
+
+static const char From[] = "pmuprof";
+
+static const struct
+{
+	const char *pName;		// as used by perf
+	u32	    nEventNumber;	// common architectural event
+}
+s_EventInfo[PMUEventUnknown] =
+{
+	{"cycles",			0x11},	// the cycle counter is used instead
+	{"instructions",		0x08},
+	{"L1-dcache-load-misses",	0x03},
+	{"LLC-load-misses",		0x17},
+	{"branch-misses",		0x10}
+};
+
+#if RASPPI >= 2
+
+#if AARCH == 32
+
+#define PMU_WRITE(crm, op2, value) \
+	asm volatile ("mcr p15, 0, %0, c9, " #crm ", " #op2 : : "r" ((u32) (value)))
+#define PMU_READ(crm, op2, value) \
+	asm volatile ("mrc p15, 0, %0, c9, " #crm ", " #op2 : "=r" (value))
+
+#define PMCR_WRITE(value)		PMU_WRITE (c12, 0, value)
+#define PMCNTENSET_WRITE(value)		PMU_WRITE (c12, 1, value)
+#define PMCNTENCLR_WRITE(value)		PMU_WRITE (c12, 2, value)
+#define PMOVSCLR_READ(value)		PMU_READ (c12, 3, value)
+#define PMOVSCLR_WRITE(value)		PMU_WRITE (c12, 3, value)
+#define PMINTENSET_WRITE(value)		PMU_WRITE (c14, 1, value)
+#define PMINTENCLR_WRITE(value)		PMU_WRITE (c14, 2, value)
+#define PMCCNTR_WRITE(value)		PMU_WRITE (c13, 0, value)
+#define PMEVTYPER0_WRITE(value)		do { PMU_WRITE (c12, 5, 0); InstructionSyncBarrier (); \
+					     PMU_WRITE (c13, 1, value); } while (0)
+#define PMEVCNTR0_WRITE(value)		do { PMU_WRITE (c12, 5, 0); InstructionSyncBarrier (); \
+					     PMU_WRITE (c13, 2, value); } while (0)
+
+#else
+
+#define PMU_WRITE(reg, value) \
+	asm volatile ("msr " #reg ", %0" : : "r" ((u64) (value)))
+#define PMU_READ(reg, value) \
+	do { u64 nValue; asm volatile ("mrs %0, " #reg : "=r" (nValue)); \
+	     value = (u32) nValue; } while (0)
+
+#define PMCR_WRITE(value)		PMU_WRITE (pmcr_el0, value)
+#define PMCNTENSET_WRITE(value)		PMU_WRITE (pmcntenset_el0, value)
+#define PMCNTENCLR_WRITE(value)		PMU_WRITE (pmcntenclr_el0, value)
+#define PMOVSCLR_READ(value)		PMU_READ (pmovsclr_el0, value)
+#define PMOVSCLR_WRITE(value)		PMU_WRITE (pmovsclr_el0, value)
+#define PMINTENSET_WRITE(value)		PMU_WRITE (pmintenset_el1, value)
+#define PMINTENCLR_WRITE(value)		PMU_WRITE (pmintenclr_el1, value)
+#define PMCCNTR_WRITE(value)		PMU_WRITE (pmccntr_el0, value)	// overflows at 32 bits
+#define PMEVTYPER0_WRITE(value)		PMU_WRITE (pmevtyper0_el0, value)
+#define PMEVCNTR0_WRITE(value)		PMU_WRITE (pmevcntr0_el0, value)
+#define PMCCFILTR_WRITE(value)		PMU_WRITE (pmccfiltr_el0, value)
+
+#endif
+
+#endif
+
+CPMUProfiler::CPMUProfiler (TPMUEvent Event, unsigned nPeriod, unsigned nMaxSamples,
+			    unsigned nMaxDepth, uintptr nTextStart, uintptr nTextEnd)
+:	m_Event (Event),
+	m_nPeriod (nPeriod),
+	m_nMaxSamples (nMaxSamples),
+	m_nMaxDepth (nMaxDepth),
+	m_nTextStart (nTextStart),
+	m_nTextEnd (nTextEnd),
+	m_nStartTicks (CTimer::GetClockTicks64 ())
+#if RASPPI <= 3
+	, m_nActiveCores (0)
+#endif
+{
+	assert (m_Event < PMUEventUnknown);
+	assert (0 < m_nPeriod && m_nPeriod < 0x80000000U);
+	assert (m_nMaxSamples > 0);
+	assert (0 < m_nMaxDepth && m_nMaxDepth <= 255);
+
+	for (unsigned nCore = 0; nCore < PMU_PROFILER_CORES; nCore++)
+	{
+		TCoreSamples *pCore = &m_Core[nCore];
+
+		pCore->bActive = FALSE;
+		pCore->nSamples = 0;
+		pCore->nLost = 0;
+
+		pCore->pTimestamp = new u64[m_nMaxSamples];
+		pCore->pDepth = new u8[m_nMaxSamples];
+		pCore->pStack = new uintptr[m_nMaxSamples * m_nMaxDepth];
+		assert (pCore->pTimestamp != 0);
+		assert (pCore->pDepth != 0);
+		assert (pCore->pStack != 0);
+	}
+}
+
+CPMUProfiler::~CPMUProfiler (void)
+{
+	for (unsigned nCore = 0; nCore < PMU_PROFILER_CORES; nCore++)
+	{
+		TCoreSamples *pCore = &m_Core[nCore];
+
+		assert (!pCore->bActive);
+
+		delete [] pCore->pTimestamp;
+		delete [] pCore->pDepth;
+		delete [] pCore->pStack;
+	}
+}
+
+boolean CPMUProfiler::Start (void)
+{
+#if RASPPI >= 2
+	unsigned nCore = ThisCore ();
+	TCoreSamples *pCore = &m_Core[nCore];
+	if (pCore->bActive)
+	{
+		return TRUE;
+	}
+
+	PMCNTENCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+	PMINTENCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+	PMOVSCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+
+	PMCR_WRITE (PMCR_E | PMCR_P | PMCR_C);
+	InstructionSyncBarrier ();
+
+	u32 nCounter;
+	if (m_Event == PMUEventCycles)
+	{
+#if AARCH == 64
+		PMCCFILTR_WRITE (0);		// count at EL0 and EL1
+#endif
+		PMCCNTR_WRITE (0 - m_nPeriod);
+		nCounter = PMU_CYCLE_COUNTER;
+	}
+	else
+	{
+		PMEVTYPER0_WRITE (s_EventInfo[m_Event].nEventNumber);
+		PMEVCNTR0_WRITE (0 - m_nPeriod);
+		nCounter = PMU_COUNTER0;
+	}
+
+	pCore->bActive = TRUE;
+
+	CInterruptSystem *pInterrupt = CInterruptSystem::Get ();
+#if RASPPI <= 3
+	// there is one handler for all cores, the IRQ is routed per core
+	if (m_nActiveCores++ == 0)
+	{
+		pInterrupt->ConnectIRQ (GetIRQ (nCore), PMUIRQHandler, this);
+	}
+	else
+	{
+		CInterruptSystem::EnableIRQ (GetIRQ (nCore));
+	}
+#else
+	pInterrupt->ConnectIRQ (GetIRQ (nCore), PMUIRQHandler, this);
+#if RASPPI == 4
+	pInterrupt->SetIRQAffinity (GetIRQ (nCore), nCore);
+#endif
+#endif
+
+	PMINTENSET_WRITE (nCounter);
+	PMCNTENSET_WRITE (nCounter);
+	InstructionSyncBarrier ();
+
+	return TRUE;
+#else
+	CLogger::Get ()->Write (From, LogError, "PMU profiling is not supported");
+
+	return FALSE;
+#endif
+}
+
+void CPMUProfiler::Stop (void)
+{
+#if RASPPI >= 2
+	unsigned nCore = ThisCore ();
+	TCoreSamples *pCore = &m_Core[nCore];
+	if (!pCore->bActive)
+	{
+		return;
+	}
+
+	PMCNTENCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+	PMINTENCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+	PMOVSCLR_WRITE (PMU_COUNTER0 | PMU_CYCLE_COUNTER);
+	InstructionSyncBarrier ();
+
+	CInterruptSystem *pInterrupt = CInterruptSystem::Get ();
+#if RASPPI <= 3
+	assert (m_nActiveCores > 0);
+	if (--m_nActiveCores == 0)
+	{
+		pInterrupt->DisconnectIRQ (GetIRQ (nCore));
+	}
+	else
+	{
+		CInterruptSystem::DisableIRQ (GetIRQ (nCore));
+	}
+#else
+	pInterrupt->DisconnectIRQ (GetIRQ (nCore));
+#endif
+
+	pCore->bActive = FALSE;
+	DataMemBarrier ();
+#endif
+}
+
+void CPMUProfiler::SaveResults (const char *pPartitionName)
+{
+	CDevice *pPartition = CDeviceNameService::Get ()->GetDevice (pPartitionName, TRUE);
+	if (pPartition == 0)
+	{
+		CLogger::Get ()->Write (From, LogError, "Partition not found: %s", pPartitionName);
+
+		return;
+	}
+
+	CFATFileSystem FileSystem;
+	if (!FileSystem.Mount (pPartition))
+	{
+		CLogger::Get ()->Write (From, LogError, "Cannot mount partition: %s", pPartitionName);
+
+		return;
+	}
+
+	SaveResults (&FileSystem);
+
+	FileSystem.UnMount ();
+}
+
+void CPMUProfiler::SaveResults (CFATFileSystem *pFileSystem)
+{
+	__set_nocancel_filesystem (pFileSystem);
+
+	WriteResults ("PERF.TXT");
+}
+
+void CPMUProfiler::SaveResults (FATFS *pFileSystem, const char *pDriveName)
+{
+	__set_nocancel_filesystem (pFileSystem, pDriveName);
+
+	WriteResults ("perf.txt");
+}
+
+void CPMUProfiler::WriteResults (const char *pFileName)
+{
+	Stop ();
+
+	int fd = __open_nocancel (pFileName, O_CREAT | O_TRUNC | O_WRONLY, 0666);
+	if (fd < 0)
+	{
+		CLogger::Get ()->Write (From, LogError, "Cannot create file: %s", pFileName);
+
+		return;
+	}
+
+	// The format is that of "perf script", so that the usual tools (e.g. FlameGraph or
+	// speedscope) can be used. Addresses have to be resolved by the user (see README).
+	for (unsigned nCore = 0; nCore < PMU_PROFILER_CORES; nCore++)
+	{
+		const TCoreSamples *pCore = &m_Core[nCore];
+
+		unsigned nSamples = pCore->nSamples;
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			CString Sample;
+			Sample.Format ("kernel 0/%u [%03u] %u.%06u: %u %s:\n",
+				       nCore, nCore,
+				       (unsigned) (pCore->pTimestamp[i] / CLOCKHZ),
+				       (unsigned) (pCore->pTimestamp[i] % CLOCKHZ),
+				       m_nPeriod, s_EventInfo[m_Event].pName);
+
+			const uintptr *pStack = pCore->pStack + i * m_nMaxDepth;
+			for (unsigned j = 0; j < pCore->pDepth[i]; j++)
+			{
+				CString Frame;
+				Frame.Format ("\t%16lx [unknown] (kernel)\n", (unsigned long) pStack[j]);
+
+				Sample.Append (Frame);
+			}
+
+			Sample.Append ("\n");
+
+			__write_nocancel (fd, (const char *) Sample, Sample.GetLength ());
+		}
+
+		if (pCore->nLost > 0)
+		{
+			CLogger::Get ()->Write (From, LogWarning, "Core %u: %u samples lost",
+						nCore, pCore->nLost);
+		}
+	}
+
+	__close_nocancel_nostatus (fd);
+
+	CLogger::Get ()->Write (From, LogDebug, "Profiling results saved");
+}
+
+void CPMUProfiler::CollectSample (unsigned nCore)
+{
+	TCoreSamples *pCore = &m_Core[nCore];
+	if (pCore->nSamples >= m_nMaxSamples)
+	{
+		pCore->nLost++;
+
+		return;
+	}
+
+	unsigned nSample = pCore->nSamples;
+	uintptr *pStack = pCore->pStack + nSample * m_nMaxDepth;
+
+	const TIRQContext *pContext = &IRQContext[nCore];
+	unsigned nDepth = 0;
+	pStack[nDepth++] = pContext->nPC;
+
+	// Walk the frame records. On AArch64 a record is {FP, LR} and FP points to it,
+	// on AArch32 (ARM state) FP points to the saved LR with the saved FP below it.
+	// A frame must be above the previous one and the return address inside the text.
+	uintptr nFP = pContext->nFP;
+#if AARCH == 32
+	uintptr nLow = (uintptr) &_etext;	// all stacks are located behind the kernel image
+	uintptr nHigh = CMemorySystem::Get ()->GetMemSize ();
+#else
+	uintptr nLow = pContext->nSP;
+	uintptr nHigh = nLow + STACK_SPAN_MAX;
+#endif
+	while (   nDepth < m_nMaxDepth
+	       && nLow <= nFP && nFP < nHigh
+	       && !(nFP & (sizeof (uintptr)-1)))
+	{
+		const uintptr *pFrame = (const uintptr *) nFP;
+#if AARCH == 32
+		uintptr nNextFP = pFrame[-1];
+		uintptr nReturn = pFrame[0];
+#else
+		uintptr nNextFP = pFrame[0];
+		uintptr nReturn = pFrame[1];
+#endif
+		if (   nReturn < m_nTextStart
+		    || nReturn >= m_nTextEnd)
+		{
+			break;
+		}
+
+		pStack[nDepth++] = nReturn;
+
+		nLow = nFP + sizeof (uintptr);
+		nFP = nNextFP;
+	}
+
+	pCore->pTimestamp[nSample] = CTimer::GetClockTicks64 () - m_nStartTicks;
+	pCore->pDepth[nSample] = (u8) nDepth;
+	pCore->nSamples = nSample+1;
+}
+
+void CPMUProfiler::PMUIRQHandler (void *pParam)
+{
+#if RASPPI >= 2
+	CPMUProfiler *pThis = (CPMUProfiler *) pParam;
+	assert (pThis != 0);
+
+	u32 nOverflow;
+	PMOVSCLR_READ (nOverflow);
+	PMOVSCLR_WRITE (nOverflow);
+
+	if (!(nOverflow & (PMU_COUNTER0 | PMU_CYCLE_COUNTER)))
+	{
+		return;
+	}
+
+	// reload the counter first, so that the handler is not counted twice
+	if (pThis->m_Event == PMUEventCycles)
+	{
+		PMCCNTR_WRITE (0 - pThis->m_nPeriod);
+	}
+	else
+	{
+		PMEVCNTR0_WRITE (0 - pThis->m_nPeriod);
+	}
+
+	unsigned nCore = ThisCore ();
+	if (pThis->m_Core[nCore].bActive)
+	{
+		pThis->CollectSample (nCore);
+	}
+#endif
+}
+
+unsigned CPMUProfiler::GetIRQ (unsigned nCore)
+{
+#if RASPPI == 4
+	return ARM_IRQ_PMU0 + nCore;
+#elif RASPPI >= 2
+	return ARM_IRQLOCAL0_PMU;
+#else
+	return 0;
+#endif
+}
@@ -0,0 +1,133 @@
+//
+// pmuprofiler.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _profile_pmuprofiler_h
+#define _profile_pmuprofiler_h
+
+#include <circle/fs/fat/fatfs.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+#include <fatfs/ff.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define PMU_PROFILER_CORES	CORES
+#else
+	#define PMU_PROFILER_CORES	1
+#endif
+
+extern u8 _start, _etext;
+
+enum TPMUEvent
+{
+	PMUEventCycles,			///< CPU cycles
+	PMUEventInstructions,		///< Instructions architecturally executed
+	PMUEventL1DCacheMiss,		///< L1 data cache refills
+	PMUEventL2CacheMiss,		///< L2 data cache refills
+	PMUEventBranchMispredict,	///< Mispredicted or not predicted branches
+	PMUEventUnknown
+};
+
+/// \note The PMU profiler takes a sample each time, the selected event has occurred nPeriod
+///	  times on a core. A sample contains the interrupted PC and the call stack, which is
+///	  found by walking the frame pointer chain. For useful call stacks, the code to be
+///	  analyzed has to be built with "CFLAGS += -fno-omit-frame-pointer". Other than with
+///	  CProfiler, no -pg instrumentation is required and multi-core programs are supported.
+
+class CPMUProfiler	/// Sampling profiler, which is driven by PMU counter overflow interrupts
+{
+public:
+	/// \param Event PMU event, which triggers the samples
+	/// \param nPeriod A sample is taken every nPeriod events (< 0x80000000)
+	/// \param nMaxSamples Maximum number of samples per core
+	/// \param nMaxDepth Maximum number of recorded call stack entries per sample
+	/// \param nTextStart Start address of the code to be profiled
+	/// \param nTextEnd End address of the code to be profiled
+	CPMUProfiler (TPMUEvent Event = PMUEventCycles,
+		      unsigned nPeriod = 1000000,
+		      unsigned nMaxSamples = 10000,
+		      unsigned nMaxDepth = 16,
+		      uintptr nTextStart = (uintptr) &_start,
+		      uintptr nTextEnd = (uintptr) &_etext);
+
+	~CPMUProfiler (void);
+
+	/// \brief Start sampling on the calling core
+	/// \return Operation successful? (always FALSE on Raspberry Pi 1 and Zero)
+	/// \note Has to be called on each core, which should be profiled.
+	boolean Start (void);
+
+	/// \brief Stop sampling on the calling core
+	void Stop (void);
+
+	/// \brief Stop sampling on the calling core and save the samples of all cores in
+	///	   "perf script" text format to the file "PERF.TXT"
+	/// \param pPartitionName Name of the partition to be used (default: SD card)
+	/// \note This method uses the class CFATFileSystem.\n
+	///	  The file system is mounted and unmounted automatically.\n
+	///	  Sampling should have been stopped on the other cores before.
+	void SaveResults (const char *pPartitionName = "emmc1-1");
+
+	/// \brief Stop sampling on the calling core and save the results to the file "PERF.TXT"
+	/// \param pFileSystem Pointer to the file system object to be used
+	/// \note The file system must already be mounted before.
+	void SaveResults (CFATFileSystem *pFileSystem);
+
+	/// \brief Stop sampling on the calling core and save the results to the file "perf.txt"
+	/// \param pFileSystem Pointer to the FatFs file system struct to be used
+	/// \param pDriveName Name of the drive to be used (default: SD card)
+	/// \note This method uses the FatFs module.\n
+	///	  The file system must already be mounted before.
+	void SaveResults (FATFS *pFileSystem, const char *pDriveName = "SD:");
+
+private:
+	void WriteResults (const char *pFileName);
+
+	void CollectSample (unsigned nCore);
+
+	static void PMUIRQHandler (void *pParam);
+
+	static unsigned GetIRQ (unsigned nCore);
+
+private:
+	TPMUEvent m_Event;
+	unsigned m_nPeriod;
+	unsigned m_nMaxSamples;
+	unsigned m_nMaxDepth;
+	uintptr m_nTextStart;
+	uintptr m_nTextEnd;
+
+	struct TCoreSamples
+	{
+		boolean	  bActive;
+		unsigned  nSamples;
+		unsigned  nLost;		// samples dropped, because the buffer was full
+		u64	 *pTimestamp;		// microseconds since construction
+		u8	 *pDepth;		// number of valid entries in the stack
+		uintptr	 *pStack;		// nMaxDepth entries per sample, [0] is the PC
+	}
+	m_Core[PMU_PROFILER_CORES];
+
+	u64 m_nStartTicks;
+
+#if RASPPI <= 3
+	unsigned m_nActiveCores;		// the PMU IRQ is shared here
+#endif
+};
+
+#endif
@@ -23,15 +23,16 @@
 #include <circle/sysconfig.h>
 #include <circle/logger.h>
 
-#ifdef ARM_ALLOW_MULTI_CORE
-	#error Multi-core programs are not supported by this profile library!
-#endif
-
 static const char From[] = "prof";
 
 CProfiler::CProfiler (uintptr nTextStart, uintptr nTextEnd)
 {
+#ifndef ARM_ALLOW_MULTI_CORE
 	__monstartup (nTextStart, nTextEnd);
+#else
+	// the library is built for CPMUProfiler, mcount() does nothing without __monstartup()
+	CLogger::Get ()->Write (From, LogError, "Multi-core programs are not supported");
+#endif
 }
 
 CProfiler::~CProfiler (void)
@@ -26,6 +26,8 @@
 
 extern u8 _start, _etext;
 
+/// \note Multi-core programs are not supported by this class, use CPMUProfiler instead.
+
 class CProfiler		/// A software profiler
 {
 public:
@@ -0,0 +1,175 @@
+//
+// benchmark.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "benchmark.h"
+#include <circle/machineinfo.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#ifndef BENCH_COMMIT
+#define BENCH_COMMIT	"unknown"
+#endif
+
+static const char FromBenchmark[] = "bench";
+
+CBenchmarkRunner::CBenchmarkRunner (void)
+:	m_Counters (PerfEventInstructions, PerfEventNone, PerfEventNone, PerfEventNone),
+	m_nResults (0)
+{
+}
+
+CBenchmarkRunner::~CBenchmarkRunner (void)
+{
+}
+
+void CBenchmarkRunner::Run (const char *pName, TBenchmarkFunction *pFunction,
+			    unsigned nIterations, void *pParam)
+{
+	assert (pName != 0);
+	assert (pFunction != 0);
+	assert (nIterations > 0);
+
+	assert (m_nResults < MAX_BENCHMARKS);
+	TResult *pResult = &m_Result[m_nResults++];
+
+	pResult->pName = pName;
+	pResult->nIterations = nIterations;
+	pResult->nInstructions = 0;
+	pResult->nCycles = 0;
+	pResult->nMicroseconds = 0;
+
+	// warm up caches and allocate lazily created resources
+	unsigned nWarmUp = nIterations / 10;
+	pResult->bSkipped = !(*pFunction) (nWarmUp > 0 ? nWarmUp : 1, pParam);
+	if (pResult->bSkipped)
+	{
+		CLogger::Get ()->Write (FromBenchmark, LogWarning, "%s: skipped", pName);
+
+		return;
+	}
+
+	TPerfCounterValues Values;
+	memset (&Values, 0, sizeof Values);
+
+	u64 nStartTicks = CTimer::GetClockTicks64 ();
+
+	boolean bOK;
+	{
+		CPerfMeasurement Measurement (&m_Counters, &Values);
+
+		bOK = (*pFunction) (nIterations, pParam);
+	}
+
+	pResult->nMicroseconds = CTimer::GetClockTicks64 () - nStartTicks;
+
+	if (!bOK)
+	{
+		pResult->bSkipped = TRUE;
+
+		CLogger::Get ()->Write (FromBenchmark, LogError, "%s: failed", pName);
+
+		return;
+	}
+
+	pResult->nInstructions = Values.nEvent[0];
+	pResult->nCycles = Values.nCycles;
+
+	CLogger::Get ()->Write (FromBenchmark, LogNotice,
+				"%s: %u iterations, %llu instructions, %llu cycles, %llu us",
+				pName, nIterations,
+				(unsigned long long) pResult->nInstructions,
+				(unsigned long long) pResult->nCycles,
+				(unsigned long long) pResult->nMicroseconds);
+}
+
+boolean CBenchmarkRunner::WriteResults (CDevice *pFile) const
+{
+	assert (pFile != 0);
+
+	CString JSON;
+	JSON.Format ("{\n"
+		     "  \"commit\": \"%s\",\n"
+		     "  \"machine\": \"%s\",\n"
+		     "  \"aarch\": %u,\n"
+		     "  \"compiler\": \"%s\",\n"
+		     "  \"pmu\": %s,\n"
+		     "  \"benchmarks\": [\n",
+		     BENCH_COMMIT, CMachineInfo::Get ()->GetMachineName (), AARCH, __VERSION__,
+		     m_Counters.IsAvailable () ? "true" : "false");
+
+	for (unsigned i = 0; i < m_nResults; i++)
+	{
+		const TResult *pResult = &m_Result[i];
+
+		CString Entry;
+		Entry.Format ("    {\"name\": \"%s\", \"iterations\": %u, ",
+			      pResult->pName, pResult->nIterations);
+		JSON.Append (Entry);
+
+		if (pResult->bSkipped)
+		{
+			JSON.Append ("\"skipped\": true");
+		}
+		else
+		{
+			// per iteration values are rounded down, the totals are exact
+			AppendU64 (&JSON, "instructions", pResult->nInstructions);
+			AppendU64 (&JSON, "cycles", pResult->nCycles);
+			AppendU64 (&JSON, "time_us", pResult->nMicroseconds);
+			AppendU64 (&JSON, "instructions_per_iteration",
+				   pResult->nInstructions / pResult->nIterations);
+			AppendU64 (&JSON, "cycles_per_iteration",
+				   pResult->nCycles / pResult->nIterations, TRUE);
+		}
+
+		JSON.Append (i+1 < m_nResults ? "},\n" : "}\n");
+	}
+
+	JSON.Append ("  ]\n"
+		     "}\n");
+
+	return pFile->Write ((const char *) JSON, JSON.GetLength ()) == (int) JSON.GetLength ();
+}
+
+unsigned CBenchmarkRunner::GetSkippedCount (void) const
+{
+	unsigned nCount = 0;
+	for (unsigned i = 0; i < m_nResults; i++)
+	{
+		if (m_Result[i].bSkipped)
+		{
+			nCount++;
+		}
+	}
+
+	return nCount;
+}
+
+void CBenchmarkRunner::AppendU64 (CString *pString, const char *pKey, u64 nValue, boolean bLast)
+{
+	assert (pString != 0);
+	assert (pKey != 0);
+
+	CString Field;
+	Field.Format ("\"%s\": %llu%s", pKey, (unsigned long long) nValue, bLast ? "" : ", ");
+
+	pString->Append (Field);
+}
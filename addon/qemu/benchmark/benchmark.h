@@ -0,0 +1,75 @@
+//
+// benchmark.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _benchmark_h
+#define _benchmark_h
+
+#include <circle/perfcounters.h>
+#include <circle/device.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define MAX_BENCHMARKS		32
+
+// returns FALSE, if the benchmark cannot run on this system (e.g. missing device)
+typedef boolean TBenchmarkFunction (unsigned nIterations, void *pParam);
+
+class CBenchmarkRunner	/// Measures benchmarks with the PMU and writes the results as JSON
+{
+public:
+	CBenchmarkRunner (void);
+	~CBenchmarkRunner (void);
+
+	/// \brief Runs a benchmark once for warm-up and once measured
+	/// \param pName Name of the benchmark in the results (must be constant)
+	/// \param pFunction Benchmark function
+	/// \param nIterations Number of iterations executed by the function
+	/// \param pParam Parameter handed over to the function
+	void Run (const char *pName, TBenchmarkFunction *pFunction, unsigned nIterations,
+		  void *pParam = 0);
+
+	/// \brief Writes the results of all benchmarks run so far
+	/// \param pFile Output file (e.g. CQEMUHostFile)
+	/// \return Operation successful?
+	boolean WriteResults (CDevice *pFile) const;
+
+	/// \return Number of benchmarks, which failed or could not run
+	unsigned GetSkippedCount (void) const;
+
+private:
+	struct TResult
+	{
+		const char *pName;
+		unsigned nIterations;
+		boolean bSkipped;
+		u64 nInstructions;
+		u64 nCycles;
+		u64 nMicroseconds;
+	};
+
+	static void AppendU64 (CString *pString, const char *pKey, u64 nValue, boolean bLast = FALSE);
+
+private:
+	CPerfCounters m_Counters;
+
+	TResult m_Result[MAX_BENCHMARKS];
+	unsigned m_nResults;
+};
+
+#endif
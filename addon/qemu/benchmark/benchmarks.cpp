@@ -0,0 +1,349 @@
+//
+// benchmarks.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "benchmarks.h"
+#include <circle/sched/scheduler.h>
+#include <circle/sched/task.h>
+#include <circle/net/checksumcalculator.h>
+#include <circle/fs/fat/fatcache.h>
+#include <circle/sound/soundbasedevice.h>
+#include <circle/2dgraphics.h>
+#include <circle/device.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define MEMCPY_LARGE_SIZE	0x100000
+
+#define RAMDISK_SECTORS		2048		// 1 MByte
+#define FATCACHE_BUFFERS	64		// the hit test fits, the miss test does not
+
+#define BLIT_SIZE		64
+
+#define SOUND_CHUNK_FRAMES	256
+
+// Allocator //////////////////////////////////////////////////////////////////
+
+static boolean BenchAlloc (unsigned nIterations, size_t nSize)
+{
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		u8 *pBlock = new u8[nSize];
+		if (pBlock == 0)
+		{
+			return FALSE;
+		}
+
+		pBlock[0] = (u8) i;		// prevent optimizing away
+
+		delete [] pBlock;
+	}
+
+	return TRUE;
+}
+
+boolean BenchAlloc64 (unsigned nIterations, void *pParam)
+{
+	return BenchAlloc (nIterations, 64);
+}
+
+boolean BenchAlloc16K (unsigned nIterations, void *pParam)
+{
+	return BenchAlloc (nIterations, 16384);
+}
+
+// Scheduler //////////////////////////////////////////////////////////////////
+
+class CYieldTask : public CTask		// yields back, until it is stopped
+{
+public:
+	CYieldTask (void)
+	:	m_bStop (FALSE)
+	{
+	}
+
+	void Run (void)
+	{
+		while (!m_bStop)
+		{
+			CScheduler::Get ()->Yield ();
+		}
+	}
+
+	void Stop (void)
+	{
+		m_bStop = TRUE;
+
+		WaitForTermination ();
+	}
+
+private:
+	volatile boolean m_bStop;
+};
+
+boolean BenchTaskSwitch (unsigned nIterations, void *pParam)
+{
+	CYieldTask *pTask = new CYieldTask;
+	if (pTask == 0)
+	{
+		return FALSE;
+	}
+
+	CScheduler::Get ()->Yield ();		// let the task start
+
+	// one iteration are two task switches (there and back)
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+
+	pTask->Stop ();				// the task object is deleted by the scheduler
+
+	return TRUE;
+}
+
+// Checksum ///////////////////////////////////////////////////////////////////
+
+static volatile u16 s_nChecksum;		// prevent optimizing away
+
+boolean BenchChecksum1500 (unsigned nIterations, void *pParam)
+{
+	static u8 Buffer[1500];
+
+	for (unsigned i = 0; i < sizeof Buffer; i++)
+	{
+		Buffer[i] = (u8) i;
+	}
+
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		s_nChecksum = CChecksumCalculator::SimpleCalculate (Buffer, sizeof Buffer);
+	}
+
+	return TRUE;
+}
+
+// memcpy /////////////////////////////////////////////////////////////////////
+
+static boolean BenchMemcpy (unsigned nIterations, size_t nSize)
+{
+	u8 *pBuffer = new u8[2*nSize];
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	memset (pBuffer, 0x55, 2*nSize);
+
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		memcpy (pBuffer + nSize, pBuffer, nSize);
+	}
+
+	delete [] pBuffer;
+
+	return TRUE;
+}
+
+boolean BenchMemcpy4K (unsigned nIterations, void *pParam)
+{
+	return BenchMemcpy (nIterations, 4096);
+}
+
+boolean BenchMemcpy1M (unsigned nIterations, void *pParam)
+{
+	return BenchMemcpy (nIterations, MEMCPY_LARGE_SIZE);
+}
+
+// FAT cache //////////////////////////////////////////////////////////////////
+
+class CRAMDisk : public CDevice		// block device in memory for the FAT cache
+{
+public:
+	CRAMDisk (void)
+	:	m_pData (new u8[RAMDISK_SECTORS * FAT_SECTOR_SIZE]),
+		m_ullOffset (0)
+	{
+		assert (m_pData != 0);
+		memset (m_pData, 0, RAMDISK_SECTORS * FAT_SECTOR_SIZE);
+	}
+
+	~CRAMDisk (void)
+	{
+		delete [] m_pData;
+	}
+
+	int Read (void *pBuffer, size_t nCount)
+	{
+		if (m_ullOffset + nCount > GetSize ())
+		{
+			return -1;
+		}
+
+		memcpy (pBuffer, m_pData + m_ullOffset, nCount);
+
+		return nCount;
+	}
+
+	int Write (const void *pBuffer, size_t nCount)
+	{
+		if (m_ullOffset + nCount > GetSize ())
+		{
+			return -1;
+		}
+
+		memcpy (m_pData + m_ullOffset, pBuffer, nCount);
+
+		return nCount;
+	}
+
+	u64 Seek (u64 ullOffset)
+	{
+		m_ullOffset = ullOffset;
+
+		return m_ullOffset;
+	}
+
+	u64 GetSize (void) const
+	{
+		return (u64) RAMDISK_SECTORS * FAT_SECTOR_SIZE;
+	}
+
+private:
+	u8 *m_pData;
+	u64 m_ullOffset;
+};
+
+// accesses nIterations sectors, cycling through nSectors different sectors
+static boolean BenchFATCache (unsigned nIterations, unsigned nSectors)
+{
+	CRAMDisk RAMDisk;
+
+	CFATCache Cache;
+	if (!Cache.Open (&RAMDisk, FATCACHE_BUFFERS))
+	{
+		return FALSE;
+	}
+
+	boolean bOK = TRUE;
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		// a stride of 7 prevents the read-ahead from loading the next sectors
+		TFATBuffer *pBuffer = Cache.GetSector (i * 7 % nSectors, 0);
+		if (pBuffer == 0)
+		{
+			bOK = FALSE;
+
+			break;
+		}
+
+		Cache.FreeSector (pBuffer, 0);
+	}
+
+	Cache.Close ();
+
+	return bOK;
+}
+
+boolean BenchFATCacheHit (unsigned nIterations, void *pParam)
+{
+	return BenchFATCache (nIterations, FATCACHE_BUFFERS / 2);
+}
+
+boolean BenchFATCacheMiss (unsigned nIterations, void *pParam)
+{
+	return BenchFATCache (nIterations, RAMDISK_SECTORS);
+}
+
+// 2D graphics ////////////////////////////////////////////////////////////////
+
+boolean BenchBlit64x64 (unsigned nIterations, void *pParam)
+{
+	C2DGraphics *pGraphics = (C2DGraphics *) pParam;
+	if (pGraphics == 0)			// display is not available
+	{
+		return FALSE;
+	}
+
+	static T2DColor Image[BLIT_SIZE * BLIT_SIZE];
+	for (unsigned i = 0; i < BLIT_SIZE * BLIT_SIZE; i++)
+	{
+		Image[i] = (T2DColor) i;
+	}
+
+	unsigned nMaxX = pGraphics->GetWidth () - BLIT_SIZE;
+	unsigned nMaxY = pGraphics->GetHeight () - BLIT_SIZE;
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		pGraphics->DrawImage (i * 13 % nMaxX, i * 7 % nMaxY, BLIT_SIZE, BLIT_SIZE, Image);
+	}
+
+	return TRUE;
+}
+
+// Sound conversion ///////////////////////////////////////////////////////////
+
+class CNullSoundDevice : public CSoundBaseDevice	// converts only, no hardware
+{
+public:
+	CNullSoundDevice (void)
+	:	CSoundBaseDevice (SoundFormatSigned24_32, 0, 48000)
+	{
+	}
+
+	boolean Start (void)		{ return TRUE; }
+	void Cancel (void)		{ }
+	boolean IsActive (void) const	{ return FALSE; }
+
+	// converts one chunk into the hardware format
+	unsigned Convert (u32 *pBuffer, unsigned nChunkSize)
+	{
+		return GetChunk (pBuffer, nChunkSize);
+	}
+};
+
+boolean BenchSoundConvert (unsigned nIterations, void *pParam)
+{
+	CNullSoundDevice Sound;
+	if (!Sound.AllocateQueueFrames (SOUND_CHUNK_FRAMES * 2))
+	{
+		return FALSE;
+	}
+
+	Sound.SetWriteFormat (SoundFormatSigned16, 2);
+
+	static s16 Samples[SOUND_CHUNK_FRAMES * 2];
+	for (unsigned i = 0; i < SOUND_CHUNK_FRAMES * 2; i++)
+	{
+		Samples[i] = (s16) (i * 251);
+	}
+
+	static u32 Chunk[SOUND_CHUNK_FRAMES * 2];
+
+	// one iteration is a chunk of 256 stereo frames
+	for (unsigned i = 0; i < nIterations; i++)
+	{
+		if (   Sound.Write (Samples, sizeof Samples) != (int) sizeof Samples
+		    || Sound.Convert (Chunk, SOUND_CHUNK_FRAMES * 2) != SOUND_CHUNK_FRAMES * 2)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
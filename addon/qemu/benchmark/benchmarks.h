@@ -0,0 +1,44 @@
+//
+// benchmarks.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _benchmarks_h
+#define _benchmarks_h
+
+#include "benchmark.h"
+
+// the functions execute nIterations operations of the measured kind
+
+boolean BenchAlloc64 (unsigned nIterations, void *pParam);
+boolean BenchAlloc16K (unsigned nIterations, void *pParam);
+
+boolean BenchTaskSwitch (unsigned nIterations, void *pParam);
+
+boolean BenchChecksum1500 (unsigned nIterations, void *pParam);
+
+boolean BenchMemcpy4K (unsigned nIterations, void *pParam);
+boolean BenchMemcpy1M (unsigned nIterations, void *pParam);
+
+boolean BenchFATCacheHit (unsigned nIterations, void *pParam);
+boolean BenchFATCacheMiss (unsigned nIterations, void *pParam);
+
+boolean BenchBlit64x64 (unsigned nIterations, void *pParam);	// pParam is C2DGraphics *
+
+boolean BenchSoundConvert (unsigned nIterations, void *pParam);
+
+#endif
@@ -0,0 +1,98 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include "benchmarks.h"
+#include <circle/startup.h>
+
+#define BLIT_WIDTH	640
+#define BLIT_HEIGHT	480
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_2DGraphics (BLIT_WIDTH, BLIT_HEIGHT, FALSE)
+{
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Logger.Initialize (&m_LogFile);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// the blit benchmark is skipped without display
+	C2DGraphics *pGraphics = m_2DGraphics.Initialize () ? &m_2DGraphics : 0;
+
+	m_Runner.Run ("alloc_64", BenchAlloc64, 100000);
+	m_Runner.Run ("alloc_16k", BenchAlloc16K, 10000);
+	m_Runner.Run ("task_switch", BenchTaskSwitch, 100000);
+	m_Runner.Run ("checksum_1500", BenchChecksum1500, 10000);
+	m_Runner.Run ("memcpy_4k", BenchMemcpy4K, 10000);
+	m_Runner.Run ("memcpy_1m", BenchMemcpy1M, 100);
+	m_Runner.Run ("fatcache_hit", BenchFATCacheHit, 100000);
+	m_Runner.Run ("fatcache_miss", BenchFATCacheMiss, 10000);
+	m_Runner.Run ("blit_64x64", BenchBlit64x64, 10000, pGraphics);
+	m_Runner.Run ("sound_convert_256", BenchSoundConvert, 10000);
+
+	CQEMUHostFile ResultFile (BENCH_RESULT_FILE);
+	if (   !ResultFile.IsOpen ()
+	    || !m_Runner.WriteResults (&ResultFile))
+	{
+		m_Logger.Write (FromKernel, LogError, "Cannot write %s", BENCH_RESULT_FILE);
+
+		set_qemu_exit_status (1);
+
+		return ShutdownHalt;
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Results written to %s", BENCH_RESULT_FILE);
+
+	// the display is not required, the other benchmarks must run
+	unsigned nSkipped = m_Runner.GetSkippedCount () - (pGraphics == 0 ? 1 : 0);
+	set_qemu_exit_status (nSkipped == 0 ? EXIT_STATUS_SUCCESS : 2);
+
+	return ShutdownHalt;
+}
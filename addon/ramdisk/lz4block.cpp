@@ -0,0 +1,276 @@
+//
+// lz4block.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <ramdisk/lz4block.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// See: https://github.com/lz4/lz4/blob/dev/doc/lz4_Block_format.md
+
+#define MIN_MATCH		4
+#define LAST_LITERALS		5	// the last bytes of a block are always literals
+#define MF_LIMIT		12	// the last match starts this far before the end
+#define MAX_OFFSET		0xFFFF
+
+static inline u32 Read32 (const u8 *p)
+{
+	u32 nValue;
+	memcpy (&nValue, p, sizeof nValue);
+
+	return nValue;
+}
+
+static inline unsigned Hash (u32 nSequence)
+{
+	return (nSequence * 2654435761U) >> (32 - LZ4_HASH_LOG);
+}
+
+static inline u8 *WriteLength (u8 *pOut, unsigned nLength)
+{
+	while (nLength >= 255)
+	{
+		*pOut++ = 255;
+		nLength -= 255;
+	}
+
+	*pOut++ = (u8) nLength;
+
+	return pOut;
+}
+
+unsigned CLZ4Block::Compress (const void *pSource, unsigned nSourceLength,
+			      void *pDest, unsigned nDestCapacity)
+{
+	assert (pSource != 0);
+	assert (pDest != 0);
+	assert (nSourceLength <= LZ4_MAX_INPUT_SIZE);
+
+	const u8 *pIn = (const u8 *) pSource;
+	const u8 *pStart = pIn;
+	const u8 *pAnchor = pIn;
+	const u8 *pEnd = pIn + nSourceLength;
+
+	u8 *pOut = (u8 *) pDest;
+	u8 *pOutEnd = pOut + nDestCapacity;
+
+	if (nSourceLength > MF_LIMIT)
+	{
+		const u8 *pMatchFindLimit = pEnd - MF_LIMIT;
+		const u8 *pMatchLimit = pEnd - LAST_LITERALS;
+
+		memset (m_HashTable, 0, sizeof m_HashTable);
+
+		while (pIn <= pMatchFindLimit)
+		{
+			u32 nSequence = Read32 (pIn);
+			unsigned nHash = Hash (nSequence);
+			const u8 *pRef = pStart + m_HashTable[nHash];
+			m_HashTable[nHash] = (u16) (pIn - pStart);
+
+			if (   pRef >= pIn
+			    || pIn - pRef > MAX_OFFSET
+			    || Read32 (pRef) != nSequence)
+			{
+				pIn++;
+
+				continue;
+			}
+
+			// extend the match backwards into the pending literals
+			while (   pIn > pAnchor
+			       && pRef > pStart
+			       && pIn[-1] == pRef[-1])
+			{
+				pIn--;
+				pRef--;
+			}
+
+			const u8 *pMatchEnd = pIn + MIN_MATCH;
+			const u8 *pRefEnd = pRef + MIN_MATCH;
+			while (   pMatchEnd < pMatchLimit
+			       && *pMatchEnd == *pRefEnd)
+			{
+				pMatchEnd++;
+				pRefEnd++;
+			}
+
+			unsigned nLiterals = pIn - pAnchor;
+			unsigned nMatch = pMatchEnd - pIn - MIN_MATCH;
+
+			// token, literals with length, offset and match length
+			if (  (unsigned) (pOutEnd - pOut)
+			    < 1 + nLiterals/255 + 1 + nLiterals + 2 + nMatch/255 + 1)
+			{
+				return 0;
+			}
+
+			u8 *pToken = pOut++;
+
+			if (nLiterals >= 15)
+			{
+				*pToken = 15 << 4;
+				pOut = WriteLength (pOut, nLiterals - 15);
+			}
+			else
+			{
+				*pToken = nLiterals << 4;
+			}
+
+			memcpy (pOut, pAnchor, nLiterals);
+			pOut += nLiterals;
+
+			unsigned nOffset = pIn - pRef;
+			*pOut++ = nOffset & 0xFF;
+			*pOut++ = nOffset >> 8;
+
+			if (nMatch >= 15)
+			{
+				*pToken |= 15;
+				pOut = WriteLength (pOut, nMatch - 15);
+			}
+			else
+			{
+				*pToken |= nMatch;
+			}
+
+			pIn = pMatchEnd;
+			pAnchor = pIn;
+		}
+	}
+
+	// last sequence with literals only
+	unsigned nLiterals = pEnd - pAnchor;
+	if ((unsigned) (pOutEnd - pOut) < 1 + nLiterals/255 + 1 + nLiterals)
+	{
+		return 0;
+	}
+
+	u8 *pToken = pOut++;
+
+	if (nLiterals >= 15)
+	{
+		*pToken = 15 << 4;
+		pOut = WriteLength (pOut, nLiterals - 15);
+	}
+	else
+	{
+		*pToken = nLiterals << 4;
+	}
+
+	memcpy (pOut, pAnchor, nLiterals);
+	pOut += nLiterals;
+
+	return pOut - (u8 *) pDest;
+}
+
+int CLZ4Block::Decompress (const void *pSource, unsigned nSourceLength,
+			   void *pDest, unsigned nDestCapacity)
+{
+	assert (pSource != 0);
+	assert (pDest != 0);
+
+	const u8 *pIn = (const u8 *) pSource;
+	const u8 *pEnd = pIn + nSourceLength;
+
+	u8 *pOut = (u8 *) pDest;
+	u8 *pOutEnd = pOut + nDestCapacity;
+
+	while (pIn < pEnd)
+	{
+		u8 uchToken = *pIn++;
+
+		unsigned nLiterals = uchToken >> 4;
+		if (nLiterals == 15)
+		{
+			u8 uchByte;
+			do
+			{
+				if (pIn >= pEnd)
+				{
+					return -1;
+				}
+
+				uchByte = *pIn++;
+				nLiterals += uchByte;
+			}
+			while (uchByte == 255);
+		}
+
+		if (   nLiterals > (unsigned) (pEnd - pIn)
+		    || nLiterals > (unsigned) (pOutEnd - pOut))
+		{
+			return -1;
+		}
+
+		memcpy (pOut, pIn, nLiterals);
+		pIn += nLiterals;
+		pOut += nLiterals;
+
+		if (pIn == pEnd)
+		{
+			break;			// last sequence has no match
+		}
+
+		if (pEnd - pIn < 2)
+		{
+			return -1;
+		}
+
+		unsigned nOffset = pIn[0] | (unsigned) pIn[1] << 8;
+		pIn += 2;
+
+		if (   nOffset == 0
+		    || nOffset > (unsigned) (pOut - (u8 *) pDest))
+		{
+			return -1;
+		}
+
+		unsigned nMatch = uchToken & 15;
+		if (nMatch == 15)
+		{
+			u8 uchByte;
+			do
+			{
+				if (pIn >= pEnd)
+				{
+					return -1;
+				}
+
+				uchByte = *pIn++;
+				nMatch += uchByte;
+			}
+			while (uchByte == 255);
+		}
+		nMatch += MIN_MATCH;
+
+		if (nMatch > (unsigned) (pOutEnd - pOut))
+		{
+			return -1;
+		}
+
+		// the match may overlap the output, copy bytewise
+		const u8 *pRef = pOut - nOffset;
+		while (nMatch--)
+		{
+			*pOut++ = *pRef++;
+		}
+	}
+
+	return pOut - (u8 *) pDest;
+}
@@ -0,0 +1,51 @@
+//
+// lz4block.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _ramdisk_lz4block_h
+#define _ramdisk_lz4block_h
+
+#include <circle/types.h>
+
+#define LZ4_HASH_LOG		12
+#define LZ4_MAX_INPUT_SIZE	0x10000		// offsets in the hash table are 16 bits
+
+class CLZ4Block		/// Compressor and decompressor for the LZ4 block format
+{
+public:
+	/// \param pSource Data to be compressed
+	/// \param nSourceLength Length of the data in bytes (up to LZ4_MAX_INPUT_SIZE)
+	/// \param pDest Buffer, where the compressed data will be placed
+	/// \param nDestCapacity Size of the destination buffer in bytes
+	/// \return Length of the compressed data, or 0 if it does not fit into pDest
+	unsigned Compress (const void *pSource, unsigned nSourceLength,
+			   void *pDest, unsigned nDestCapacity);
+
+	/// \param pSource Compressed data
+	/// \param nSourceLength Length of the compressed data in bytes
+	/// \param pDest Buffer, where the decompressed data will be placed
+	/// \param nDestCapacity Size of the destination buffer in bytes
+	/// \return Length of the decompressed data, or < 0 if the data is corrupted
+	static int Decompress (const void *pSource, unsigned nSourceLength,
+			       void *pDest, unsigned nDestCapacity);
+
+private:
+	u16 m_HashTable[1 << LZ4_HASH_LOG];	// positions of recent 4-byte sequences
+};
+
+#endif
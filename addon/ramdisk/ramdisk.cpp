@@ -0,0 +1,555 @@
+//
+// ramdisk.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <ramdisk/ramdisk.h>
+#include <circle/devicenameservice.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+LOGMODULE ("ramdisk");
+
+CNumberPool CRAMDiskDevice::s_DeviceNumberPool (1);
+
+CRAMDiskDevice::CRAMDiskDevice (u64 ullSize, boolean bCompressed, int nHeap)
+:	m_ullSize (ullSize & ~(u64) (RAMDISK_PAGE_SIZE-1)),
+	m_bCompressed (bCompressed),
+	m_nHeap (nHeap),
+	m_ullOffset (0),
+	m_ppChunk (0),
+	m_ullChunks (0),
+	m_pPage (0),
+	m_ullPages (0),
+	m_ullMemoryUsed (0),
+	m_pPartitionManager (0),
+	m_nDeviceNumber (0)
+{
+}
+
+CRAMDiskDevice::~CRAMDiskDevice (void)
+{
+	if (m_nDeviceNumber != 0)
+	{
+		CDeviceNameService::Get ()->RemoveDevice ("ramdisk", m_nDeviceNumber, TRUE);
+
+		s_DeviceNumberPool.FreeNumber (m_nDeviceNumber);
+
+		m_nDeviceNumber = 0;
+	}
+
+	delete m_pPartitionManager;
+	m_pPartitionManager = 0;
+
+	if (m_ppChunk != 0)
+	{
+		for (u64 i = 0; i < m_ullChunks; i++)
+		{
+			delete [] m_ppChunk[i];
+		}
+
+		delete [] m_ppChunk;
+		m_ppChunk = 0;
+	}
+
+	if (m_pPage != 0)
+	{
+		for (u64 i = 0; i < m_ullPages; i++)
+		{
+			delete [] m_pPage[i].pData;
+		}
+
+		delete [] m_pPage;
+		m_pPage = 0;
+	}
+}
+
+boolean CRAMDiskDevice::Initialize (void)
+{
+	if (m_ullSize == 0)
+	{
+		LOGERR ("Invalid size");
+
+		return FALSE;
+	}
+
+	if (!m_bCompressed)
+	{
+		m_ullChunks = (m_ullSize + RAMDISK_CHUNK_SIZE-1) / RAMDISK_CHUNK_SIZE;
+
+		assert (m_ppChunk == 0);
+		m_ppChunk = new (m_nHeap) u8 *[m_ullChunks];
+		if (m_ppChunk == 0)
+		{
+			LOGERR ("Cannot allocate chunk table");
+
+			return FALSE;
+		}
+
+		for (u64 i = 0; i < m_ullChunks; i++)
+		{
+			m_ppChunk[i] = 0;
+		}
+	}
+	else
+	{
+		m_ullPages = m_ullSize / RAMDISK_PAGE_SIZE;
+
+		assert (m_pPage == 0);
+		m_pPage = new (m_nHeap) TPage[m_ullPages];
+		if (m_pPage == 0)
+		{
+			LOGERR ("Cannot allocate page table");
+
+			return FALSE;
+		}
+
+		for (u64 i = 0; i < m_ullPages; i++)
+		{
+			m_pPage[i].pData = 0;
+			m_pPage[i].nLength = 0;
+		}
+	}
+
+	unsigned nDeviceNumber = s_DeviceNumberPool.AllocateNumber (FALSE);
+	if (nDeviceNumber == CNumberPool::Invalid)
+	{
+		LOGERR ("Too many devices");
+
+		return FALSE;
+	}
+
+	assert (m_nDeviceNumber == 0);
+	m_nDeviceNumber = nDeviceNumber;
+
+	CString DeviceName;
+	DeviceName.Format ("ramdisk%u", m_nDeviceNumber);
+
+	LOGNOTE ("%s: %llu MByte%s", (const char *) DeviceName, m_ullSize / MEGABYTE,
+		 m_bCompressed ? " (compressed)" : "");
+
+	if (!RescanPartitions ())
+	{
+		s_DeviceNumberPool.FreeNumber (m_nDeviceNumber);
+		m_nDeviceNumber = 0;
+
+		return FALSE;
+	}
+
+	CDeviceNameService::Get ()->AddDevice (DeviceName, this, TRUE);
+
+	return TRUE;
+}
+
+int CRAMDiskDevice::Read (void *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+
+	if (   (nCount & RAMDISK_BLOCK_MASK) != 0
+	    || m_ullOffset + nCount > m_ullSize
+	    || nCount > 0x7FFFFFFF)
+	{
+		return -1;
+	}
+
+	m_Lock.Acquire ();
+
+	int nResult = m_bCompressed ? ReadCompressed ((u8 *) pBuffer, m_ullOffset, nCount)
+				    : ReadUncompressed ((u8 *) pBuffer, m_ullOffset, nCount);
+
+	m_Lock.Release ();
+
+	return nResult;
+}
+
+int CRAMDiskDevice::Write (const void *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+
+	if (   (nCount & RAMDISK_BLOCK_MASK) != 0
+	    || m_ullOffset + nCount > m_ullSize
+	    || nCount > 0x7FFFFFFF)
+	{
+		return -1;
+	}
+
+	m_Lock.Acquire ();
+
+	int nResult = m_bCompressed ? WriteCompressed ((const u8 *) pBuffer, m_ullOffset, nCount)
+				    : WriteUncompressed ((const u8 *) pBuffer, m_ullOffset, nCount);
+
+	m_Lock.Release ();
+
+	return nResult;
+}
+
+u64 CRAMDiskDevice::Seek (u64 ullOffset)
+{
+	if (   (ullOffset & RAMDISK_BLOCK_MASK) != 0
+	    || ullOffset >= m_ullSize)
+	{
+		return (u64) -1;
+	}
+
+	m_ullOffset = ullOffset;
+
+	return m_ullOffset;
+}
+
+u64 CRAMDiskDevice::GetSize (void) const
+{
+	return m_ullSize;
+}
+
+int CRAMDiskDevice::IOCtl (unsigned long ulCmd, void *pData)
+{
+	switch (ulCmd)
+	{
+	case DEVICE_IOCTL_SYNC:
+		return 0;
+
+	case DEVICE_IOCTL_DISCARD: {
+			const TDeviceBlockRange *pRange = (const TDeviceBlockRange *) pData;
+			assert (pRange != 0);
+
+			if (   (pRange->ullOffset & RAMDISK_BLOCK_MASK) != 0
+			    || (pRange->ullCount & RAMDISK_BLOCK_MASK) != 0
+			    || pRange->ullOffset + pRange->ullCount > m_ullSize)
+			{
+				return -1;
+			}
+
+			m_Lock.Acquire ();
+
+			Discard (pRange->ullOffset, pRange->ullCount);
+
+			m_Lock.Release ();
+		}
+		return 0;
+
+	case DEVICE_IOCTL_GET_BLOCK_SIZE:
+		assert (pData != 0);
+		*(unsigned *) pData = RAMDISK_BLOCK_SIZE;
+		return 0;
+
+	default:
+		return -1;
+	}
+}
+
+boolean CRAMDiskDevice::RescanPartitions (void)
+{
+	assert (m_nDeviceNumber != 0);
+
+	delete m_pPartitionManager;
+
+	CString DeviceName;
+	DeviceName.Format ("ramdisk%u", m_nDeviceNumber);
+
+	m_pPartitionManager = new CPartitionManager (this, DeviceName);
+	assert (m_pPartitionManager != 0);
+
+	return m_pPartitionManager->Initialize ();
+}
+
+u64 CRAMDiskDevice::GetMemoryUsed (void) const
+{
+	return m_ullMemoryUsed;
+}
+
+int CRAMDiskDevice::ReadUncompressed (u8 *pBuffer, u64 ullOffset, size_t nCount)
+{
+	assert (m_ppChunk != 0);
+
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullChunk = ullOffset / RAMDISK_CHUNK_SIZE;
+		unsigned nChunkOffset = (unsigned) (ullOffset % RAMDISK_CHUNK_SIZE);
+
+		size_t nBytes = RAMDISK_CHUNK_SIZE - nChunkOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		assert (ullChunk < m_ullChunks);
+		if (m_ppChunk[ullChunk] != 0)
+		{
+			memcpy (pBuffer, m_ppChunk[ullChunk] + nChunkOffset, nBytes);
+		}
+		else
+		{
+			memset (pBuffer, 0, nBytes);
+		}
+
+		pBuffer += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	return (int) nCount;
+}
+
+int CRAMDiskDevice::WriteUncompressed (const u8 *pBuffer, u64 ullOffset, size_t nCount)
+{
+	assert (m_ppChunk != 0);
+
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullChunk = ullOffset / RAMDISK_CHUNK_SIZE;
+		unsigned nChunkOffset = (unsigned) (ullOffset % RAMDISK_CHUNK_SIZE);
+
+		size_t nBytes = RAMDISK_CHUNK_SIZE - nChunkOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		assert (ullChunk < m_ullChunks);
+		if (m_ppChunk[ullChunk] == 0)
+		{
+			m_ppChunk[ullChunk] = new (m_nHeap) u8[RAMDISK_CHUNK_SIZE];
+			if (m_ppChunk[ullChunk] == 0)
+			{
+				LOGWARN ("Out of memory");
+
+				return -1;
+			}
+
+			memset (m_ppChunk[ullChunk], 0, RAMDISK_CHUNK_SIZE);
+
+			m_ullMemoryUsed += RAMDISK_CHUNK_SIZE;
+		}
+
+		memcpy (m_ppChunk[ullChunk] + nChunkOffset, pBuffer, nBytes);
+
+		pBuffer += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	return (int) nCount;
+}
+
+int CRAMDiskDevice::ReadCompressed (u8 *pBuffer, u64 ullOffset, size_t nCount)
+{
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullPage = ullOffset / RAMDISK_PAGE_SIZE;
+		unsigned nPageOffset = (unsigned) (ullOffset % RAMDISK_PAGE_SIZE);
+
+		size_t nBytes = RAMDISK_PAGE_SIZE - nPageOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		// complete pages are decompressed in place
+		u8 *pPageBuffer = nBytes == RAMDISK_PAGE_SIZE ? pBuffer : m_PageBuffer;
+		if (!LoadPage (ullPage, pPageBuffer))
+		{
+			return -1;
+		}
+
+		if (pPageBuffer != pBuffer)
+		{
+			memcpy (pBuffer, pPageBuffer + nPageOffset, nBytes);
+		}
+
+		pBuffer += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	return (int) nCount;
+}
+
+int CRAMDiskDevice::WriteCompressed (const u8 *pBuffer, u64 ullOffset, size_t nCount)
+{
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullPage = ullOffset / RAMDISK_PAGE_SIZE;
+		unsigned nPageOffset = (unsigned) (ullOffset % RAMDISK_PAGE_SIZE);
+
+		size_t nBytes = RAMDISK_PAGE_SIZE - nPageOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		const u8 *pPageBuffer = pBuffer;
+		if (nBytes < RAMDISK_PAGE_SIZE)
+		{
+			// read-modify-write of a partial page
+			if (!LoadPage (ullPage, m_PageBuffer))
+			{
+				return -1;
+			}
+
+			memcpy (m_PageBuffer + nPageOffset, pBuffer, nBytes);
+
+			pPageBuffer = m_PageBuffer;
+		}
+
+		if (!StorePage (ullPage, pPageBuffer))
+		{
+			return -1;
+		}
+
+		pBuffer += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	return (int) nCount;
+}
+
+boolean CRAMDiskDevice::LoadPage (u64 ullPage, u8 *pBuffer)
+{
+	assert (m_pPage != 0);
+	assert (ullPage < m_ullPages);
+	TPage *pPage = &m_pPage[ullPage];
+
+	if (pPage->pData == 0)
+	{
+		memset (pBuffer, 0, RAMDISK_PAGE_SIZE);
+
+		return TRUE;
+	}
+
+	if (pPage->nLength == RAMDISK_PAGE_SIZE)
+	{
+		memcpy (pBuffer, pPage->pData, RAMDISK_PAGE_SIZE);
+
+		return TRUE;
+	}
+
+	if (CLZ4Block::Decompress (pPage->pData, pPage->nLength,
+				   pBuffer, RAMDISK_PAGE_SIZE) != RAMDISK_PAGE_SIZE)
+	{
+		LOGERR ("Page %llu is corrupted", ullPage);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CRAMDiskDevice::StorePage (u64 ullPage, const u8 *pBuffer)
+{
+	assert (m_pPage != 0);
+	assert (ullPage < m_ullPages);
+
+	// zeroed pages need no memory
+	unsigned i;
+	for (i = 0; i < RAMDISK_PAGE_SIZE; i++)
+	{
+		if (pBuffer[i] != 0)
+		{
+			break;
+		}
+	}
+
+	if (i == RAMDISK_PAGE_SIZE)
+	{
+		FreePage (ullPage);
+
+		return TRUE;
+	}
+
+	// store uncompressed, if it does not save anything
+	unsigned nLength = m_LZ4.Compress (pBuffer, RAMDISK_PAGE_SIZE,
+					   m_CompressBuffer, RAMDISK_PAGE_SIZE-1);
+	const u8 *pData = m_CompressBuffer;
+	if (nLength == 0)
+	{
+		nLength = RAMDISK_PAGE_SIZE;
+		pData = pBuffer;
+	}
+
+	u8 *pNewData = new (m_nHeap) u8[nLength];
+	if (pNewData == 0)
+	{
+		LOGWARN ("Out of memory");
+
+		return FALSE;
+	}
+
+	memcpy (pNewData, pData, nLength);
+
+	FreePage (ullPage);
+
+	TPage *pPage = &m_pPage[ullPage];
+	pPage->pData = pNewData;
+	pPage->nLength = nLength;
+
+	m_ullMemoryUsed += nLength;
+
+	return TRUE;
+}
+
+void CRAMDiskDevice::FreePage (u64 ullPage)
+{
+	assert (m_pPage != 0);
+	assert (ullPage < m_ullPages);
+	TPage *pPage = &m_pPage[ullPage];
+
+	if (pPage->pData != 0)
+	{
+		assert (m_ullMemoryUsed >= pPage->nLength);
+		m_ullMemoryUsed -= pPage->nLength;
+
+		delete [] pPage->pData;
+		pPage->pData = 0;
+		pPage->nLength = 0;
+	}
+}
+
+void CRAMDiskDevice::Discard (u64 ullOffset, u64 ullCount)
+{
+	// only complete chunks or pages can be freed
+	unsigned nUnit = m_bCompressed ? RAMDISK_PAGE_SIZE : RAMDISK_CHUNK_SIZE;
+
+	u64 ullFirst = (ullOffset + nUnit-1) / nUnit;
+	u64 ullEnd = (ullOffset + ullCount) / nUnit;
+	if (ullOffset + ullCount == m_ullSize)
+	{
+		ullEnd = (m_ullSize + nUnit-1) / nUnit;		// last chunk may be incomplete
+	}
+
+	for (u64 i = ullFirst; i < ullEnd; i++)
+	{
+		if (m_bCompressed)
+		{
+			FreePage (i);
+		}
+		else if (m_ppChunk[i] != 0)
+		{
+			delete [] m_ppChunk[i];
+			m_ppChunk[i] = 0;
+
+			m_ullMemoryUsed -= RAMDISK_CHUNK_SIZE;
+		}
+	}
+}
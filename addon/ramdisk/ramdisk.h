@@ -0,0 +1,116 @@
+//
+// ramdisk.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _ramdisk_ramdisk_h
+#define _ramdisk_ramdisk_h
+
+#include <ramdisk/lz4block.h>
+#include <circle/device.h>
+#include <circle/fs/partitionmanager.h>
+#include <circle/genericlock.h>
+#include <circle/numberpool.h>
+#include <circle/memory.h>
+#include <circle/types.h>
+
+#define RAMDISK_BLOCK_SIZE	512		// sector size
+#define RAMDISK_BLOCK_MASK	(RAMDISK_BLOCK_SIZE-1)
+
+#define RAMDISK_CHUNK_SIZE	0x10000		// unit of allocation in uncompressed mode
+#define RAMDISK_PAGE_SIZE	4096		// unit of compression in compressed mode
+
+class CRAMDiskDevice : public CDevice	/// Block device in RAM, optionally LZ4-compressed
+{
+public:
+	/// \param ullSize Size of the disk in bytes (rounded down to RAMDISK_PAGE_SIZE)
+	/// \param bCompressed Store 4 KB pages LZ4-compressed (saves memory, costs CPU time)
+	/// \param nHeap Heap, from which the memory is allocated (HEAP_ANY, HEAP_HIGH, HEAP_LOW)
+	/// \note Memory is allocated on the first write of a chunk or page. The disk can be
+	///	  larger than the available memory, writes fail, when the memory is exhausted.
+	CRAMDiskDevice (u64 ullSize, boolean bCompressed = FALSE, int nHeap = HEAP_ANY);
+	~CRAMDiskDevice (void);
+
+	/// \brief Register the device (as "ramdiskN") and its partitions
+	boolean Initialize (void);
+
+	int Read (void *pBuffer, size_t nCount);
+	int Write (const void *pBuffer, size_t nCount);
+
+	u64 Seek (u64 ullOffset);
+
+	u64 GetSize (void) const;
+
+	/// \note Supports DEVICE_IOCTL_SYNC, DEVICE_IOCTL_DISCARD (frees memory) and
+	///	  DEVICE_IOCTL_GET_BLOCK_SIZE
+	int IOCtl (unsigned long ulCmd, void *pData);
+
+	/// \brief Create the partition devices again (e.g. after f_fdisk())
+	/// \note The partition devices must not be in use.
+	boolean RescanPartitions (void);
+
+	/// \return Number of bytes of memory, which are currently used for data
+	u64 GetMemoryUsed (void) const;
+
+private:
+	int ReadUncompressed (u8 *pBuffer, u64 ullOffset, size_t nCount);
+	int WriteUncompressed (const u8 *pBuffer, u64 ullOffset, size_t nCount);
+
+	int ReadCompressed (u8 *pBuffer, u64 ullOffset, size_t nCount);
+	int WriteCompressed (const u8 *pBuffer, u64 ullOffset, size_t nCount);
+	boolean LoadPage (u64 ullPage, u8 *pBuffer);
+	boolean StorePage (u64 ullPage, const u8 *pBuffer);
+	void FreePage (u64 ullPage);
+
+	void Discard (u64 ullOffset, u64 ullCount);
+
+private:
+	u64 m_ullSize;
+	boolean m_bCompressed;
+	int m_nHeap;
+
+	u64 m_ullOffset;
+
+	// uncompressed mode
+	u8 **m_ppChunk;				// 0 if not written yet (zeroed)
+	u64 m_ullChunks;
+
+	// compressed mode
+	struct TPage
+	{
+		u8 *pData;			// 0 if zeroed
+		unsigned nLength;		// RAMDISK_PAGE_SIZE if stored uncompressed
+	};
+
+	TPage *m_pPage;
+	u64 m_ullPages;
+
+	CLZ4Block m_LZ4;
+	u8 m_PageBuffer[RAMDISK_PAGE_SIZE];
+	u8 m_CompressBuffer[RAMDISK_PAGE_SIZE];
+
+	u64 m_ullMemoryUsed;
+
+	CGenericLock m_Lock;
+
+	CPartitionManager *m_pPartitionManager;
+
+	unsigned m_nDeviceNumber;
+	static CNumberPool s_DeviceNumberPool;
+};
+
+#endif
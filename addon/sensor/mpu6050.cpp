@@ -23,6 +23,14 @@
 #include <assert.h>
 
 // Registers
+#define SMPLRT_DIV		25
+#define CONFIG			26
+	#define CONFIG_DLPF_CFG_1	1
+#define FIFO_EN			35
+	#define FIFO_EN_ACCEL		(1 << 3)
+	#define FIFO_EN_GYRO		(7 << 4)
+#define INT_STATUS		58
+	#define INT_STATUS_FIFO_OFLOW	(1 << 4)
 #define ACCEL_XOUT_H		59
 #define ACCEL_XOUT_L		60
 #define ACCEL_YOUT_H		61
@@ -38,7 +46,17 @@
 #define GYRO_ZOUT_H		71
 #define GYRO_ZOUT_L		72
 
+#define USER_CTRL		106
+	#define USER_CTRL_FIFO_EN	(1 << 6)
+	#define USER_CTRL_FIFO_RESET	(1 << 2)
 #define PWR_MGMT_1		107
+#define FIFO_COUNTH		114
+#define FIFO_COUNTL		115
+#define FIFO_R_W		116
+
+#define FIFO_SAMPLE_SIZE	(MPU6050_FIFO_VALUES * 2)
+#define FIFO_SIZE		1024
+#define FIFO_BURST_SAMPLES	16		// read at once
 
 static const char FromMPU6050[] = "mpu6050";
 
@@ -142,3 +160,124 @@ s16 CMPU6050::GetGyroscopeOutputZ (void) const
 	assert (m_pRegs != 0);
 	return (s16) m_pRegs->GyroZOutH << 8 | m_pRegs->GyroZOutL;
 }
+
+boolean CMPU6050::EnableFIFO (unsigned nSampleRateHz, boolean bEnableDLPF)
+{
+	assert (m_pI2CMaster != 0);
+	m_pI2CMaster->SetClock (m_nI2CClockHz);
+
+	unsigned nGyroRate = bEnableDLPF ? 1000 : 8000;
+	if (   nSampleRateHz == 0
+	    || nSampleRateHz > nGyroRate
+	    || nGyroRate / nSampleRateHz > 256)
+	{
+		return FALSE;
+	}
+
+	if (   !WriteReg (USER_CTRL, 0)
+	    || !WriteReg (FIFO_EN, 0)
+	    || !WriteReg (CONFIG, bEnableDLPF ? CONFIG_DLPF_CFG_1 : 0)
+	    || !WriteReg (SMPLRT_DIV, (u8) (nGyroRate / nSampleRateHz - 1))
+	    || !WriteReg (USER_CTRL, USER_CTRL_FIFO_RESET)
+	    || !WriteReg (USER_CTRL, USER_CTRL_FIFO_EN)
+	    || !WriteReg (FIFO_EN, FIFO_EN_ACCEL | FIFO_EN_GYRO))
+	{
+		CLogger::Get ()->Write (FromMPU6050, LogError, "Cannot enable FIFO");
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+int CMPU6050::ReadFIFO (s16 *pValues, unsigned nMaxSamples)
+{
+	assert (pValues != 0);
+	assert (m_pI2CMaster != 0);
+	m_pI2CMaster->SetClock (m_nI2CClockHz);
+
+	u8 Buffer[FIFO_BURST_SAMPLES * FIFO_SAMPLE_SIZE];
+
+	u8 ucStatus;
+	if (!ReadRegs (INT_STATUS, &ucStatus, 1))
+	{
+		return -1;
+	}
+
+	if (ucStatus & INT_STATUS_FIFO_OFLOW)
+	{
+		CLogger::Get ()->Write (FromMPU6050, LogWarning, "FIFO overflow");
+
+		// the FIFO content is not aligned to samples any more
+		WriteReg (USER_CTRL, USER_CTRL_FIFO_EN | USER_CTRL_FIFO_RESET);
+
+		return -1;
+	}
+
+	if (!ReadRegs (FIFO_COUNTH, Buffer, 2))
+	{
+		return -1;
+	}
+
+	unsigned nSamples = ((Buffer[0] << 8 | Buffer[1]) & (FIFO_SIZE*2-1)) / FIFO_SAMPLE_SIZE;
+	if (nSamples > nMaxSamples)
+	{
+		nSamples = nMaxSamples;
+	}
+
+	unsigned nResult = 0;
+	while (nResult < nSamples)
+	{
+		unsigned nBurst = nSamples - nResult;
+		if (nBurst > FIFO_BURST_SAMPLES)
+		{
+			nBurst = FIFO_BURST_SAMPLES;
+		}
+
+		if (!ReadRegs (FIFO_R_W, Buffer, nBurst * FIFO_SAMPLE_SIZE))
+		{
+			return -1;
+		}
+
+		for (unsigned i = 0; i < nBurst * MPU6050_FIFO_VALUES; i++)
+		{
+			*pValues++ = (s16) (Buffer[i*2] << 8 | Buffer[i*2+1]);
+		}
+
+		nResult += nBurst;
+	}
+
+	return nResult;
+}
+
+boolean CMPU6050::WriteReg (u8 ucReg, u8 ucValue)
+{
+	assert (m_pI2CMaster != 0);
+
+	u8 Data[] = {ucReg, ucValue};
+
+	return m_pI2CMaster->Write (m_ucSlaveAddress, Data, sizeof Data) == sizeof Data;
+}
+
+boolean CMPU6050::ReadRegs (u8 ucReg, void *pBuffer, unsigned nCount)
+{
+	assert (m_pI2CMaster != 0);
+
+	int nResult = m_pI2CMaster->Write (m_ucSlaveAddress, &ucReg, 1);
+	if (nResult != 1)
+	{
+		CLogger::Get ()->Write (FromMPU6050, LogError, "I2C write failed (err %d)", nResult);
+
+		return FALSE;
+	}
+
+	nResult = m_pI2CMaster->Read (m_ucSlaveAddress, pBuffer, nCount);
+	if (nResult != (int) nCount)
+	{
+		CLogger::Get ()->Write (FromMPU6050, LogError, "I2C read failed (err %d)", nResult);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
@@ -45,6 +45,8 @@ struct TMPU6050Regs
 }
 PACKED;
 
+#define MPU6050_FIFO_VALUES	6		// accel X/Y/Z, gyro X/Y/Z per sample
+
 class CMPU6050
 {
 public:
@@ -63,6 +65,23 @@ public:
 	s16 GetGyroscopeOutputY (void) const;
 	s16 GetGyroscopeOutputZ (void) const;
 
+	/// \brief Lets the sensor sample into its FIFO with a fixed rate
+	/// \param nSampleRateHz Sample rate (1000 / n with DLPF, 8000 / n without, 8000 max.)
+	/// \param bEnableDLPF Enable the digital low pass filter (gyro output rate 1 kHz)
+	/// \return Operation successful?
+	/// \note The accelerometer is sampled with 1 kHz max., values are repeated above.
+	boolean EnableFIFO (unsigned nSampleRateHz, boolean bEnableDLPF = FALSE);
+
+	/// \brief Reads the samples from the FIFO (burst read)
+	/// \param pValues Buffer for nMaxSamples * MPU6050_FIFO_VALUES values
+	/// \param nMaxSamples Maximum number of samples to read
+	/// \return Number of read samples, or < 0 on error or FIFO overflow (FIFO is reset)
+	int ReadFIFO (s16 *pValues, unsigned nMaxSamples);
+
+private:
+	boolean WriteReg (u8 ucReg, u8 ucValue);
+	boolean ReadRegs (u8 ucReg, void *pBuffer, unsigned nCount);
+
 private:
 	CI2CMaster *m_pI2CMaster;
 	unsigned    m_nI2CClockHz;
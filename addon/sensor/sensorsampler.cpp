@@ -0,0 +1,323 @@
+//
+// sensorsampler.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <sensor/sensorsampler.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define MIN_DELAY		3		// us
+#define START_DELAY		100		// us
+#define DRAIN_BURST		32		// samples read from a FIFO at once
+
+CSensorSampler::CSensorSampler (CInterruptSystem *pInterruptSystem, unsigned nSampleRateHz,
+				boolean bUseFIQ)
+:	m_UserTimer (pInterruptSystem, TimerStub, this, bUseFIQ),
+	m_nIntervalMicros (0),
+	m_bRunning (FALSE),
+	m_nNextCompare (0),
+	m_nChannels (0)
+{
+	assert (nSampleRateHz > 0);
+	m_nIntervalMicros = USER_CLOCKHZ / nSampleRateHz;
+	assert (m_nIntervalMicros > MIN_DELAY);
+}
+
+CSensorSampler::~CSensorSampler (void)
+{
+	if (m_bRunning)
+	{
+		Stop ();
+	}
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		delete [] m_Channel[i].pRing;
+		m_Channel[i].pRing = 0;
+	}
+}
+
+int CSensorSampler::AddTimedChannel (TSensorAcquireHandler *pHandler, void *pParam,
+				     unsigned nValues, unsigned nRingSize)
+{
+	assert (pHandler != 0);
+	assert (!m_bRunning);
+
+	int nChannel = AddChannel (nValues, nRingSize);
+	if (nChannel < 0)
+	{
+		return nChannel;
+	}
+
+	TChannel *pChannel = &m_Channel[nChannel];
+	pChannel->pAcquireHandler = pHandler;
+	pChannel->pParam = pParam;
+
+	return nChannel;
+}
+
+int CSensorSampler::AddFIFOChannel (TSensorDrainHandler *pHandler, void *pParam,
+				    unsigned nValues, unsigned nSampleRateHz, unsigned nRingSize)
+{
+	assert (pHandler != 0);
+	assert (nSampleRateHz > 0);
+
+	int nChannel = AddChannel (nValues, nRingSize);
+	if (nChannel < 0)
+	{
+		return nChannel;
+	}
+
+	TChannel *pChannel = &m_Channel[nChannel];
+	pChannel->bFIFO = TRUE;
+	pChannel->pDrainHandler = pHandler;
+	pChannel->pParam = pParam;
+	pChannel->nIntervalMicros = USER_CLOCKHZ / nSampleRateHz;
+
+	return nChannel;
+}
+
+int CSensorSampler::AddChannel (unsigned nValues, unsigned nRingSize)
+{
+	if (   m_nChannels >= SENSOR_SAMPLER_MAX_CHANNELS
+	    || nValues == 0
+	    || nValues > SENSOR_SAMPLE_MAX_VALUES
+	    || nRingSize < 2
+	    || (nRingSize & (nRingSize-1)) != 0)
+	{
+		return -1;
+	}
+
+	TChannel *pChannel = &m_Channel[m_nChannels];
+	pChannel->bFIFO = FALSE;
+	pChannel->pAcquireHandler = 0;
+	pChannel->pDrainHandler = 0;
+	pChannel->pParam = 0;
+	pChannel->nValues = nValues;
+	pChannel->nIntervalMicros = 0;
+	pChannel->ullLastTimestamp = 0;
+	pChannel->nRingSize = nRingSize;
+	pChannel->nInPtr = 0;
+	pChannel->nOutPtr = 0;
+	pChannel->nOverflows = 0;
+	pChannel->nErrors = 0;
+
+	pChannel->pRing = new TSensorSample[nRingSize];
+	if (pChannel->pRing == 0)
+	{
+		return -1;
+	}
+
+	return m_nChannels++;
+}
+
+boolean CSensorSampler::Start (void)
+{
+	assert (!m_bRunning);
+
+	if (!m_UserTimer.Initialize ())
+	{
+		return FALSE;
+	}
+
+	m_bRunning = TRUE;
+
+	m_nNextCompare = CUserTimer::GetCounter () + START_DELAY;
+	m_UserTimer.StartAt (m_nNextCompare);
+
+	return TRUE;
+}
+
+void CSensorSampler::Stop (void)
+{
+	assert (m_bRunning);
+
+	m_UserTimer.Stop ();
+
+	m_bRunning = FALSE;
+}
+
+void CSensorSampler::Update (void)
+{
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		if (m_Channel[i].bFIFO)
+		{
+			DrainFIFO (&m_Channel[i]);
+		}
+	}
+}
+
+unsigned CSensorSampler::Read (unsigned nChannel, TSensorSample *pBuffer, unsigned nMaxSamples)
+{
+	assert (nChannel < m_nChannels);
+	TChannel *pChannel = &m_Channel[nChannel];
+	assert (pBuffer != 0);
+
+	unsigned nOutPtr = pChannel->nOutPtr;
+	unsigned nInPtr = pChannel->nInPtr;
+	DataMemBarrier ();			// read the samples after the pointer
+
+	unsigned nResult = 0;
+	while (   nResult < nMaxSamples
+	       && nOutPtr != nInPtr)
+	{
+		pBuffer[nResult++] = pChannel->pRing[nOutPtr];
+
+		nOutPtr = (nOutPtr + 1) & (pChannel->nRingSize-1);
+	}
+
+	DataMemBarrier ();			// free the slots after reading them
+	pChannel->nOutPtr = nOutPtr;
+
+	return nResult;
+}
+
+unsigned CSensorSampler::GetOverflows (unsigned nChannel) const
+{
+	assert (nChannel < m_nChannels);
+
+	return m_Channel[nChannel].nOverflows;
+}
+
+unsigned CSensorSampler::GetErrors (unsigned nChannel) const
+{
+	assert (nChannel < m_nChannels);
+
+	return m_Channel[nChannel].nErrors;
+}
+
+void CSensorSampler::Put (TChannel *pChannel, u64 ullTimestamp, const s16 *pValues)
+{
+	assert (pChannel != 0);
+	assert (pValues != 0);
+
+	unsigned nInPtr = pChannel->nInPtr;
+	unsigned nNextInPtr = (nInPtr + 1) & (pChannel->nRingSize-1);
+	if (nNextInPtr == pChannel->nOutPtr)
+	{
+		pChannel->nOverflows++;
+
+		return;
+	}
+
+	TSensorSample *pSample = &pChannel->pRing[nInPtr];
+	pSample->ullTimestamp = ullTimestamp;
+	for (unsigned i = 0; i < pChannel->nValues; i++)
+	{
+		pSample->Values[i] = pValues[i];
+	}
+
+	DataMemBarrier ();			// publish the sample before the pointer
+	pChannel->nInPtr = nNextInPtr;
+}
+
+void CSensorSampler::DrainFIFO (TChannel *pChannel)
+{
+	assert (pChannel != 0);
+	assert (pChannel->pDrainHandler != 0);
+
+	s16 Values[DRAIN_BURST * SENSOR_SAMPLE_MAX_VALUES];
+
+	int nSamples;
+	do
+	{
+		nSamples = (*pChannel->pDrainHandler) (Values, DRAIN_BURST, pChannel->pParam);
+		if (nSamples <= 0)
+		{
+			if (nSamples < 0)
+			{
+				pChannel->nErrors++;
+
+				pChannel->ullLastTimestamp = 0;		// resynchronize
+			}
+
+			return;
+		}
+
+		assert (nSamples <= DRAIN_BURST);
+
+		// the last sample has been taken just now, the others are evenly spaced before
+		u64 ullNow = CTimer::GetClockTicks64 ();
+		u64 ullInterval = pChannel->nIntervalMicros;
+		u64 ullFirst = ullNow - (nSamples-1) * ullInterval;
+
+		// continue the time line, if it did not drift away
+		if (pChannel->ullLastTimestamp != 0)
+		{
+			u64 ullExpected = pChannel->ullLastTimestamp + ullInterval;
+			if (   ullExpected <= ullFirst + 4*ullInterval
+			    && ullFirst <= ullExpected + 4*ullInterval)
+			{
+				ullFirst = ullExpected;
+			}
+		}
+
+		for (int i = 0; i < nSamples; i++)
+		{
+			Put (pChannel, ullFirst + i * ullInterval, &Values[i * pChannel->nValues]);
+		}
+
+		pChannel->ullLastTimestamp = ullFirst + (nSamples-1) * ullInterval;
+	}
+	while (nSamples == DRAIN_BURST);
+}
+
+void CSensorSampler::TimerHandler (void)
+{
+	u64 ullTimestamp = CTimer::GetClockTicks64 ();
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		TChannel *pChannel = &m_Channel[i];
+		if (pChannel->bFIFO)
+		{
+			continue;
+		}
+
+		s16 Values[SENSOR_SAMPLE_MAX_VALUES];
+
+		assert (pChannel->pAcquireHandler != 0);
+		if ((*pChannel->pAcquireHandler) (Values, pChannel->pParam))
+		{
+			Put (pChannel, ullTimestamp, Values);
+		}
+		else
+		{
+			pChannel->nErrors++;
+		}
+	}
+
+	// skip the missed periods, if the handlers took too long
+	do
+	{
+		m_nNextCompare += m_nIntervalMicros;
+	}
+	while ((int) (m_nNextCompare - CUserTimer::GetCounter ()) < MIN_DELAY);
+
+	m_UserTimer.StartAt (m_nNextCompare);
+}
+
+void CSensorSampler::TimerStub (CUserTimer *pUserTimer, void *pParam)
+{
+	CSensorSampler *pThis = (CSensorSampler *) pParam;
+	assert (pThis != 0);
+
+	pThis->TimerHandler ();
+}
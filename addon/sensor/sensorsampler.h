@@ -0,0 +1,159 @@
+//
+// sensorsampler.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _sensor_sensorsampler_h
+#define _sensor_sensorsampler_h
+
+#include <circle/usertimer.h>
+#include <circle/interrupt.h>
+#include <circle/types.h>
+
+#define SENSOR_SAMPLER_MAX_CHANNELS	8
+#define SENSOR_SAMPLE_MAX_VALUES	8
+
+struct TSensorSample
+{
+	u64	ullTimestamp;			// CTimer::GetClockTicks64()
+	s16	Values[SENSOR_SAMPLE_MAX_VALUES];
+};
+
+/// \brief Called from the timer interrupt to acquire one sample of a timed channel
+/// \param pValues Store the values of the sample here
+/// \param pParam User parameter
+/// \return Operation successful? (no sample is stored otherwise)
+/// \note Must be short (e.g. one SPI transfer), it delays all other timed channels.
+typedef boolean TSensorAcquireHandler (s16 *pValues, void *pParam);
+
+/// \brief Called from Update() to read the samples of a FIFO channel in a burst
+/// \param pValues Store nMaxSamples * nValues values here
+/// \param nMaxSamples Maximum number of samples to be returned
+/// \param pParam User parameter
+/// \return Number of returned samples, or < 0 on error
+typedef int TSensorDrainHandler (s16 *pValues, unsigned nMaxSamples, void *pParam);
+
+/// \class CSensorSampler
+/// \brief Acquires sensor samples with fixed rates into per-channel ring buffers
+///
+/// \details Timed channels are sampled from the CUserTimer interrupt, which elapses\n
+/// at absolute times, so that the sample interval does not drift. FIFO channels\n
+/// (e.g. CMPU6050 with EnableFIFO()) sample into the FIFO of the sensor with its\n
+/// own clock and are drained in bursts by Update(). Their time stamps are derived\n
+/// from the sample rate. The ring buffers are lock-free with one producer and\n
+/// one consumer.
+///
+/// \note Uses the CUserTimer (system timer channel 1), which cannot be used otherwise.
+/// \note Not supported on the Raspberry Pi 5.
+
+class CSensorSampler
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nSampleRateHz Rate of the timed channels in Hz
+	/// \param bUseFIQ Use FIQ instead of IRQ for the user timer
+	CSensorSampler (CInterruptSystem *pInterruptSystem, unsigned nSampleRateHz,
+			boolean bUseFIQ = FALSE);
+
+	~CSensorSampler (void);
+
+	/// \brief Adds a channel, which is sampled from the timer interrupt
+	/// \param pHandler Acquisition handler
+	/// \param pParam User parameter for the handler
+	/// \param nValues Number of values per sample (<= SENSOR_SAMPLE_MAX_VALUES)
+	/// \param nRingSize Size of the ring buffer in samples (must be a power of 2)
+	/// \return Channel number, or < 0 on error
+	int AddTimedChannel (TSensorAcquireHandler *pHandler, void *pParam,
+			     unsigned nValues, unsigned nRingSize = 4096);
+
+	/// \brief Adds a channel, which is drained from the sensor FIFO by Update()
+	/// \param pHandler Drain handler
+	/// \param pParam User parameter for the handler
+	/// \param nValues Number of values per sample (<= SENSOR_SAMPLE_MAX_VALUES)
+	/// \param nSampleRateHz Sample rate of the sensor in Hz
+	/// \param nRingSize Size of the ring buffer in samples (must be a power of 2)
+	/// \return Channel number, or < 0 on error
+	int AddFIFOChannel (TSensorDrainHandler *pHandler, void *pParam,
+			    unsigned nValues, unsigned nSampleRateHz, unsigned nRingSize = 4096);
+
+	/// \brief Starts the timed acquisition
+	/// \return Operation successful?
+	boolean Start (void);
+	/// \brief Stops the timed acquisition
+	void Stop (void);
+
+	/// \brief Drains the FIFO channels
+	/// \note Must be called from TASK_LEVEL often enough, so that the sensor FIFOs\n
+	///	  do not overflow.
+	void Update (void);
+
+	/// \brief Fetches samples of a channel
+	/// \param nChannel Channel number
+	/// \param pBuffer Samples will be returned here
+	/// \param nMaxSamples Size of the buffer in samples
+	/// \return Number of returned samples
+	unsigned Read (unsigned nChannel, TSensorSample *pBuffer, unsigned nMaxSamples);
+
+	/// \param nChannel Channel number
+	/// \return Number of samples, which have been discarded, because the ring was full
+	unsigned GetOverflows (unsigned nChannel) const;
+	/// \param nChannel Channel number
+	/// \return Number of failed acquisitions or drains
+	unsigned GetErrors (unsigned nChannel) const;
+
+private:
+	struct TChannel;
+	int AddChannel (unsigned nValues, unsigned nRingSize);
+	void Put (TChannel *pChannel, u64 ullTimestamp, const s16 *pValues);
+
+	void DrainFIFO (TChannel *pChannel);
+
+	void TimerHandler (void);
+	static void TimerStub (CUserTimer *pUserTimer, void *pParam);
+
+private:
+	CUserTimer m_UserTimer;
+	unsigned m_nIntervalMicros;
+
+	boolean m_bRunning;
+	u32 m_nNextCompare;
+
+	struct TChannel
+	{
+		boolean		bFIFO;
+		TSensorAcquireHandler *pAcquireHandler;
+		TSensorDrainHandler *pDrainHandler;
+		void		*pParam;
+		unsigned	nValues;
+
+		unsigned	nIntervalMicros;	// FIFO channels only
+		u64		ullLastTimestamp;	// FIFO channels only
+
+		TSensorSample	*pRing;
+		unsigned	nRingSize;
+		volatile unsigned nInPtr;		// written by producer only
+		volatile unsigned nOutPtr;		// written by consumer only
+
+		volatile unsigned nOverflows;
+		volatile unsigned nErrors;
+	};
+
+	unsigned m_nChannels;
+	TChannel m_Channel[SENSOR_SAMPLER_MAX_CHANNELS];
+};
+
+#endif
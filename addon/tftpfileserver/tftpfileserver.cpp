@@ -18,18 +18,26 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <tftpfileserver/tftpfileserver.h>
+#include <circle/tracer.h>
+#include <circle/util.h>
 #include <assert.h>
 
+static const char TraceFileName[] = "trace.json";
+
 CTFTPFileServer::CTFTPFileServer (CNetSubSystem *pNetSubSystem, CFATFileSystem *pFileSystem)
 :	CTFTPDaemon (pNetSubSystem),
 	m_pFileSystem (pFileSystem),
-	m_hFile (0)
+	m_hFile (0),
+	m_pTrace (0),
+	m_nTraceLength (0),
+	m_nTraceOffset (0)
 {
 }
 
 CTFTPFileServer::~CTFTPFileServer (void)
 {
-	if (m_hFile != 0)
+	if (   m_hFile != 0
+	    || m_pTrace != 0)
 	{
 		FileClose ();
 	}
@@ -42,6 +50,25 @@ boolean CTFTPFileServer::FileOpen (const char *pFileName)
 	assert (pFileName != 0);
 	assert (m_pFileSystem != 0);
 	assert (m_hFile == 0);
+
+	CTracer *pTracer = CTracer::Get ();
+	if (   strcmp (pFileName, TraceFileName) == 0
+	    && pTracer != 0)
+	{
+		assert (m_pTrace == 0);
+		unsigned nSize = pTracer->GetChromeTraceMaxSize ();
+		m_pTrace = new char[nSize];
+		if (m_pTrace == 0)
+		{
+			return FALSE;
+		}
+
+		m_nTraceLength = pTracer->ExportChromeTrace (m_pTrace, nSize);
+		m_nTraceOffset = 0;
+
+		return TRUE;
+	}
+
 	m_hFile = m_pFileSystem->FileOpen (pFileName);
 
 	return m_hFile != 0 ? TRUE : FALSE;
@@ -59,6 +86,14 @@ boolean CTFTPFileServer::FileCreate (const char *pFileName)
 
 boolean CTFTPFileServer::FileClose (void)
 {
+	if (m_pTrace != 0)
+	{
+		delete [] m_pTrace;
+		m_pTrace = 0;
+
+		return TRUE;
+	}
+
 	assert (m_pFileSystem != 0);
 	assert (m_hFile != 0);
 	boolean bOK = m_pFileSystem->FileClose (m_hFile) != 0 ? TRUE : FALSE;
@@ -70,6 +105,21 @@ boolean CTFTPFileServer::FileClose (void)
 
 int CTFTPFileServer::FileRead (void *pBuffer, unsigned nCount)
 {
+	if (m_pTrace != 0)
+	{
+		assert (m_nTraceOffset <= m_nTraceLength);
+		if (nCount > m_nTraceLength - m_nTraceOffset)
+		{
+			nCount = m_nTraceLength - m_nTraceOffset;
+		}
+
+		assert (pBuffer != 0);
+		memcpy (pBuffer, m_pTrace + m_nTraceOffset, nCount);
+		m_nTraceOffset += nCount;
+
+		return (int) nCount;
+	}
+
 	assert (m_pFileSystem != 0);
 	assert (m_hFile != 0);
 	assert (pBuffer != 0);
@@ -85,3 +135,13 @@ int CTFTPFileServer::FileWrite (const void *pBuffer, unsigned nCount)
 	assert (nCount > 0);
 	return (int) m_pFileSystem->FileWrite (m_hFile, pBuffer, nCount);
 }
+
+int CTFTPFileServer::FileSize (void)
+{
+	if (m_pTrace != 0)
+	{
+		return (int) m_nTraceLength;
+	}
+
+	return -1;		// not available from CFATFileSystem
+}
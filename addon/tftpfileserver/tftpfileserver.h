@@ -36,11 +36,17 @@ public:
 	boolean FileClose (void);
 	int FileRead (void *pBuffer, unsigned nCount);
 	int FileWrite (const void *pBuffer, unsigned nCount);
+	int FileSize (void);
 
 private:
 	CFATFileSystem *m_pFileSystem;
 
 	unsigned m_hFile;
+
+	// "trace.json" is served from memory, if a CTracer object exists
+	char *m_pTrace;
+	unsigned m_nTraceLength;
+	unsigned m_nTraceOffset;
 };
 
 #endif
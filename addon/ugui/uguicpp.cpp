@@ -2,7 +2,7 @@
 // uguicpp.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2024  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,6 +27,10 @@ CUGUI *CUGUI::s_pThis = 0;
 
 CUGUI::CUGUI (CScreenDevice *pScreen)
 :	m_pScreen (pScreen),
+	m_pBuffer (0),
+	m_nPitch (0),
+	m_nWidth (0),
+	m_nHeight (0),
 	m_pMouseDevice (0),
 	m_pTouchScreen (0),
 	m_nLastUpdate (0)
@@ -59,6 +63,23 @@ boolean CUGUI::Initialize (void)
 		return FALSE;
 	}
 
+	// uGUI redraws only windows and objects, which need an update. Filled
+	// rectangles, straight lines and characters are written to the frame
+	// buffer directly with word-wide stores, instead of using SetPixel().
+	CBcmFrameBuffer *pFrameBuffer = m_pScreen->GetFrameBuffer ();
+	if (   pFrameBuffer != 0
+	    && pFrameBuffer->GetDepth () == 16)
+	{
+		m_pBuffer = (u16 *) (uintptr) pFrameBuffer->GetBuffer ();
+		m_nPitch = pFrameBuffer->GetPitch () / sizeof (u16);
+		m_nWidth = m_pScreen->GetWidth ();
+		m_nHeight = m_pScreen->GetHeight ();
+
+		UG_DriverRegister (DRIVER_FILL_FRAME, (void *) FillFrame);
+		UG_DriverRegister (DRIVER_DRAW_LINE, (void *) DrawLine);
+		UG_DriverRegister (DRIVER_FILL_AREA, (void *) FillArea);
+	}
+
 	m_pMouseDevice = (CMouseDevice *) CDeviceNameService::Get ()->GetDevice ("mouse1", FALSE);
 	if (m_pMouseDevice != 0)
 	{
@@ -138,6 +159,112 @@ void CUGUI::SetPixel (UG_S16 sPosX, UG_S16 sPosY, UG_COLOR Color)
 	s_pThis->m_pScreen->SetPixel ((unsigned) sPosX, (unsigned) sPosY, (TScreenColor) Color);
 }
 
+UG_RESULT CUGUI::FillFrame (UG_S16 sPosX1, UG_S16 sPosY1,
+			     UG_S16 sPosX2, UG_S16 sPosY2, UG_COLOR Color)
+{
+	assert (s_pThis != 0);
+	assert (s_pThis->m_pBuffer != 0);
+
+	// coordinates are ordered by UG_FillFrame()
+	int nPosX1 = sPosX1 < 0 ? 0 : sPosX1;
+	int nPosY1 = sPosY1 < 0 ? 0 : sPosY1;
+	int nPosX2 = sPosX2 < (int) s_pThis->m_nWidth ? sPosX2 : (int) s_pThis->m_nWidth-1;
+	int nPosY2 = sPosY2 < (int) s_pThis->m_nHeight ? sPosY2 : (int) s_pThis->m_nHeight-1;
+
+	if (   nPosX1 > nPosX2
+	    || nPosY1 > nPosY2)
+	{
+		return UG_RESULT_OK;
+	}
+
+	u32 nColor2 = (u16) Color | (u32) (u16) Color << 16;
+
+	u16 *pLine = s_pThis->m_pBuffer + nPosY1 * s_pThis->m_nPitch + nPosX1;
+	for (int y = nPosY1; y <= nPosY2; y++)
+	{
+		u16 *p = pLine;
+		unsigned nPixels = nPosX2 - nPosX1 + 1;
+
+		if (((uintptr) p & 3) != 0)
+		{
+			*p++ = (u16) Color;
+			nPixels--;
+		}
+
+		u32 *p32 = (u32 *) p;
+		for (; nPixels >= 2; nPixels -= 2)
+		{
+			*p32++ = nColor2;
+		}
+
+		if (nPixels != 0)
+		{
+			*(u16 *) p32 = (u16) Color;
+		}
+
+		pLine += s_pThis->m_nPitch;
+	}
+
+	return UG_RESULT_OK;
+}
+
+UG_RESULT CUGUI::DrawLine (UG_S16 sPosX1, UG_S16 sPosY1,
+			    UG_S16 sPosX2, UG_S16 sPosY2, UG_COLOR Color)
+{
+	if (   sPosX1 != sPosX2
+	    && sPosY1 != sPosY2)
+	{
+		return UG_RESULT_FAIL;		// uGUI draws diagonal lines itself
+	}
+
+	if (sPosX2 < sPosX1)
+	{
+		UG_S16 sTemp = sPosX1; sPosX1 = sPosX2; sPosX2 = sTemp;
+	}
+
+	if (sPosY2 < sPosY1)
+	{
+		UG_S16 sTemp = sPosY1; sPosY1 = sPosY2; sPosY2 = sTemp;
+	}
+
+	return FillFrame (sPosX1, sPosY1, sPosX2, sPosY2, Color);
+}
+
+void *CUGUI::FillArea (UG_S16 sPosX1, UG_S16 sPosY1, UG_S16 sPosX2, UG_S16 sPosY2)
+{
+	assert (s_pThis != 0);
+
+	s_pThis->m_Area.nPosX1 = sPosX1;
+	s_pThis->m_Area.nPosX2 = sPosX2;
+	s_pThis->m_Area.nPosX = sPosX1;
+	s_pThis->m_Area.nPosY = sPosY1;
+
+	return (void *) PushPixel;
+}
+
+void CUGUI::PushPixel (UG_COLOR Color)
+{
+	assert (s_pThis != 0);
+	assert (s_pThis->m_pBuffer != 0);
+
+	int nPosX = s_pThis->m_Area.nPosX;
+	int nPosY = s_pThis->m_Area.nPosY;
+
+	if (   (unsigned) nPosX < s_pThis->m_nWidth
+	    && (unsigned) nPosY < s_pThis->m_nHeight)
+	{
+		s_pThis->m_pBuffer[nPosY * s_pThis->m_nPitch + nPosX] = (u16) Color;
+	}
+
+	if (++nPosX > s_pThis->m_Area.nPosX2)
+	{
+		nPosX = s_pThis->m_Area.nPosX1;
+		s_pThis->m_Area.nPosY++;
+	}
+
+	s_pThis->m_Area.nPosX = nPosX;
+}
+
 void CUGUI::MouseEventHandler (TMouseEvent Event, unsigned nButtons,
 			       unsigned nPosX, unsigned nPosY, int nWheelMove)
 {
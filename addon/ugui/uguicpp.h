@@ -4,7 +4,7 @@
 // C++ wrapper for uGUI with mouse and touch screen support
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -52,6 +52,14 @@ public:
 private:
 	static void SetPixel (UG_S16 sPosX, UG_S16 sPosY, UG_COLOR Color);
 
+	// hardware acceleration drivers, write directly to the frame buffer
+	static UG_RESULT FillFrame (UG_S16 sPosX1, UG_S16 sPosY1,
+				    UG_S16 sPosX2, UG_S16 sPosY2, UG_COLOR Color);
+	static UG_RESULT DrawLine (UG_S16 sPosX1, UG_S16 sPosY1,
+				   UG_S16 sPosX2, UG_S16 sPosY2, UG_COLOR Color);
+	static void *FillArea (UG_S16 sPosX1, UG_S16 sPosY1, UG_S16 sPosX2, UG_S16 sPosY2);
+	static void PushPixel (UG_COLOR Color);
+
 	void MouseEventHandler (TMouseEvent Event, unsigned nButtons,
 				unsigned nPosX, unsigned nPosY, int nWheelMove);
 	static void MouseEventStub (TMouseEvent Event, unsigned nButtons,
@@ -69,6 +77,20 @@ private:
 
 	UG_GUI m_GUI;
 
+	u16 *m_pBuffer;			// frame buffer
+	unsigned m_nPitch;		// in pixels
+	unsigned m_nWidth;
+	unsigned m_nHeight;
+
+	struct				// state of FillArea()
+	{
+		int nPosX1;
+		int nPosX2;
+		int nPosX;
+		int nPosY;
+	}
+	m_Area;
+
 	CMouseDevice * volatile m_pMouseDevice;
 
 	CTouchScreenDevice *m_pTouchScreen;
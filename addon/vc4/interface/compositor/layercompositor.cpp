@@ -0,0 +1,429 @@
+//
+// layercompositor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <vc4/interface/compositor/layercompositor.h>
+#include <circle/sched/scheduler.h>
+#include <circle/new.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// change flags of vc_dispmanx_element_change_attributes() (see vc_vchi_dispmanx.h)
+#define ELEMENT_CHANGE_LAYER		(1 << 0)
+#define ELEMENT_CHANGE_OPACITY		(1 << 1)
+#define ELEMENT_CHANGE_DEST_RECT	(1 << 2)
+#define ELEMENT_CHANGE_SRC_RECT		(1 << 3)
+
+#define UPDATE_PRIORITY			10
+
+//// CCompositorLayer //////////////////////////////////////////////////////////
+
+CCompositorLayer::CCompositorLayer (CLayerCompositor *pCompositor, TFormat Format,
+				    unsigned nWidth, unsigned nHeight, int nLayer,
+				    unsigned nBuffers)
+:	m_pCompositor (pCompositor),
+	m_Format (Format),
+	m_nWidth (nWidth),
+	m_nHeight (nHeight),
+	m_nLayer (nLayer),
+	m_nBuffers (nBuffers),
+	m_nPitch (0),
+	m_pBuffer (0),
+	m_nFrontBuffer (0),
+	m_hElement (DISPMANX_NO_HANDLE),
+	m_uchOpacity (255),
+	m_bVisible (TRUE)
+{
+	assert (m_pCompositor != 0);
+	assert (m_Format < FormatUnknown);
+	assert (m_nWidth > 0 && m_nHeight > 0);
+	assert (1 <= m_nBuffers && m_nBuffers <= LAYER_MAX_BUFFERS);
+
+	for (unsigned i = 0; i < LAYER_MAX_BUFFERS; i++)
+	{
+		m_hResource[i] = DISPMANX_NO_HANDLE;
+	}
+}
+
+CCompositorLayer::~CCompositorLayer (void)
+{
+	if (m_hElement != DISPMANX_NO_HANDLE)
+	{
+		// remove the element with an own update, if none is open
+		boolean bOwnUpdate = !m_pCompositor->IsUpdating ();
+		if (   !bOwnUpdate
+		    || m_pCompositor->BeginUpdate ())
+		{
+			vc_dispmanx_element_remove (m_pCompositor->GetUpdateHandle (), m_hElement);
+
+			if (bOwnUpdate)
+			{
+				m_pCompositor->Update (TRUE);
+			}
+		}
+
+		m_hElement = DISPMANX_NO_HANDLE;
+	}
+
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		if (m_hResource[i] != DISPMANX_NO_HANDLE)
+		{
+			vc_dispmanx_resource_delete (m_hResource[i]);
+			m_hResource[i] = DISPMANX_NO_HANDLE;
+		}
+	}
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	m_pCompositor = 0;
+}
+
+boolean CCompositorLayer::Initialize (void)
+{
+	assert (m_pCompositor != 0);
+	assert (m_pCompositor->IsUpdating ());
+	assert (m_hElement == DISPMANX_NO_HANDLE);
+
+	unsigned nPixelSize = m_Format == FormatRGB565 ? 2 : 4;
+	m_nPitch = (m_nWidth * nPixelSize + 31) & ~31;		// required by the VideoCore
+
+	// the buffer is sent using bulk transfers
+	m_pBuffer = new (HEAP_DMA30) u8[m_nPitch * m_nHeight];
+	if (m_pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	memset (m_pBuffer, 0, m_nPitch * m_nHeight);
+
+	VC_IMAGE_TYPE_T ImageType = GetImageType (m_Format);
+
+	VC_RECT_T Rect;
+	vc_dispmanx_rect_set (&Rect, 0, 0, m_nWidth, m_nHeight);
+
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		u32 nImageHandle;
+		m_hResource[i] = vc_dispmanx_resource_create (ImageType, m_nWidth, m_nHeight,
+							      &nImageHandle);
+		if (m_hResource[i] == DISPMANX_NO_HANDLE)
+		{
+			return FALSE;
+		}
+
+		if (vc_dispmanx_resource_write_data (m_hResource[i], ImageType, m_nPitch,
+						     m_pBuffer, &Rect) != 0)
+		{
+			return FALSE;
+		}
+
+		m_nDirtyFrom[i] = m_nHeight;
+		m_nDirtyTo[i] = 0;
+	}
+
+	m_nFrontBuffer = 0;
+
+	vc_dispmanx_rect_set (&m_DestRect, 0, 0, m_nWidth, m_nHeight);
+	vc_dispmanx_rect_set (&m_SourceRect, 0, 0, m_nWidth << 16, m_nHeight << 16);
+
+	VC_DISPMANX_ALPHA_T Alpha;
+	Alpha.flags =   m_Format == FormatARGB8888
+		      ? (DISPMANX_FLAGS_ALPHA_T) (  DISPMANX_FLAGS_ALPHA_FROM_SOURCE
+						  | DISPMANX_FLAGS_ALPHA_MIX)
+		      : DISPMANX_FLAGS_ALPHA_FIXED_ALL_PIXELS;
+	Alpha.opacity = m_bVisible ? m_uchOpacity : 0;
+	Alpha.mask = DISPMANX_NO_HANDLE;
+
+	m_hElement = vc_dispmanx_element_add (m_pCompositor->GetUpdateHandle (),
+					      m_pCompositor->GetDisplayHandle (),
+					      m_nLayer, &m_DestRect, m_hResource[m_nFrontBuffer],
+					      &m_SourceRect, DISPMANX_PROTECTION_NONE, &Alpha,
+					      0, DISPMANX_NO_ROTATE);
+
+	return m_hElement != DISPMANX_NO_HANDLE;
+}
+
+unsigned CCompositorLayer::GetWidth (void) const
+{
+	return m_nWidth;
+}
+
+unsigned CCompositorLayer::GetHeight (void) const
+{
+	return m_nHeight;
+}
+
+unsigned CCompositorLayer::GetPitch (void) const
+{
+	return m_nPitch;
+}
+
+void *CCompositorLayer::GetBuffer (void)
+{
+	assert (m_pBuffer != 0);
+
+	return m_pBuffer;
+}
+
+boolean CCompositorLayer::Flip (unsigned nY, unsigned nLines)
+{
+	assert (m_pCompositor != 0);
+	assert (m_pCompositor->IsUpdating ());
+	assert (m_hElement != DISPMANX_NO_HANDLE);
+
+	if (nLines == 0)
+	{
+		nY = 0;
+		nLines = m_nHeight;
+	}
+
+	assert (nY + nLines <= m_nHeight);
+
+	// the changed lines are missing in all resources
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		if (nY < m_nDirtyFrom[i])
+		{
+			m_nDirtyFrom[i] = nY;
+		}
+
+		if (nY + nLines > m_nDirtyTo[i])
+		{
+			m_nDirtyTo[i] = nY + nLines;
+		}
+	}
+
+	// the previous update has completed, so the next resource is not shown any more
+	unsigned nNext = (m_nFrontBuffer + 1) % m_nBuffers;
+
+	VC_RECT_T Rect;
+	vc_dispmanx_rect_set (&Rect, 0, m_nDirtyFrom[nNext], m_nWidth,
+			      m_nDirtyTo[nNext] - m_nDirtyFrom[nNext]);
+
+	if (vc_dispmanx_resource_write_data (m_hResource[nNext], GetImageType (m_Format),
+					     m_nPitch, m_pBuffer, &Rect) != 0)
+	{
+		return FALSE;
+	}
+
+	m_nDirtyFrom[nNext] = m_nHeight;
+	m_nDirtyTo[nNext] = 0;
+
+	int nResult;
+	if (nNext != m_nFrontBuffer)
+	{
+		nResult = vc_dispmanx_element_change_source (m_pCompositor->GetUpdateHandle (),
+							     m_hElement, m_hResource[nNext]);
+	}
+	else
+	{
+		// without page flipping the shown resource has been modified
+		nResult = vc_dispmanx_element_modified (m_pCompositor->GetUpdateHandle (),
+							m_hElement, &Rect);
+	}
+
+	m_nFrontBuffer = nNext;
+
+	return nResult == 0;
+}
+
+void CCompositorLayer::SetDestination (int nX, int nY, unsigned nWidth, unsigned nHeight)
+{
+	assert (nWidth > 0 && nHeight > 0);
+	vc_dispmanx_rect_set (&m_DestRect, nX, nY, nWidth, nHeight);
+
+	ApplyChanges (ELEMENT_CHANGE_DEST_RECT);
+}
+
+void CCompositorLayer::SetSource (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight)
+{
+	assert (nWidth > 0 && nHeight > 0);
+	assert (nX + nWidth <= m_nWidth);
+	assert (nY + nHeight <= m_nHeight);
+
+	// the source rectangle is in 16.16 fixed point format
+	vc_dispmanx_rect_set (&m_SourceRect, nX << 16, nY << 16, nWidth << 16, nHeight << 16);
+
+	ApplyChanges (ELEMENT_CHANGE_SRC_RECT);
+}
+
+void CCompositorLayer::SetOpacity (u8 uchOpacity)
+{
+	m_uchOpacity = uchOpacity;
+
+	ApplyChanges (ELEMENT_CHANGE_OPACITY);
+}
+
+void CCompositorLayer::SetLayer (int nLayer)
+{
+	m_nLayer = nLayer;
+
+	ApplyChanges (ELEMENT_CHANGE_LAYER);
+}
+
+void CCompositorLayer::Show (boolean bVisible)
+{
+	m_bVisible = bVisible;
+
+	ApplyChanges (ELEMENT_CHANGE_OPACITY);
+}
+
+void CCompositorLayer::ApplyChanges (u32 nChangeFlags)
+{
+	assert (m_pCompositor != 0);
+	assert (m_pCompositor->IsUpdating ());
+	assert (m_hElement != DISPMANX_NO_HANDLE);
+
+	vc_dispmanx_element_change_attributes (m_pCompositor->GetUpdateHandle (), m_hElement,
+					       nChangeFlags, m_nLayer,
+					       m_bVisible ? m_uchOpacity : 0,
+					       &m_DestRect, &m_SourceRect,
+					       DISPMANX_NO_HANDLE, DISPMANX_NO_ROTATE);
+}
+
+VC_IMAGE_TYPE_T CCompositorLayer::GetImageType (TFormat Format)
+{
+	switch (Format)
+	{
+	case FormatRGB565:	return VC_IMAGE_RGB565;
+	case FormatARGB8888:	return VC_IMAGE_ARGB8888;
+	case FormatXRGB8888:	return VC_IMAGE_XRGB8888;
+
+	default:
+		assert (0);
+		return VC_IMAGE_MIN;
+	}
+}
+
+//// CLayerCompositor //////////////////////////////////////////////////////////
+
+CLayerCompositor::CLayerCompositor (unsigned nDisplay)
+:	m_nDisplay (nDisplay),
+	m_hDisplay (DISPMANX_NO_HANDLE),
+	m_hUpdate (DISPMANX_NO_HANDLE),
+	m_bUpdatePending (FALSE)
+{
+	memset (&m_ModeInfo, 0, sizeof m_ModeInfo);
+}
+
+CLayerCompositor::~CLayerCompositor (void)
+{
+	assert (m_hUpdate == DISPMANX_NO_HANDLE);
+
+	WaitForPendingUpdate ();
+
+	if (m_hDisplay != DISPMANX_NO_HANDLE)
+	{
+		vc_dispmanx_display_close (m_hDisplay);
+		m_hDisplay = DISPMANX_NO_HANDLE;
+	}
+}
+
+boolean CLayerCompositor::Initialize (void)
+{
+	bcm_host_init ();
+
+	m_hDisplay = vc_dispmanx_display_open (m_nDisplay);
+	if (m_hDisplay == DISPMANX_NO_HANDLE)
+	{
+		return FALSE;
+	}
+
+	return vc_dispmanx_display_get_info (m_hDisplay, &m_ModeInfo) == 0;
+}
+
+unsigned CLayerCompositor::GetWidth (void) const
+{
+	return m_ModeInfo.width;
+}
+
+unsigned CLayerCompositor::GetHeight (void) const
+{
+	return m_ModeInfo.height;
+}
+
+boolean CLayerCompositor::BeginUpdate (void)
+{
+	assert (m_hDisplay != DISPMANX_NO_HANDLE);
+	assert (m_hUpdate == DISPMANX_NO_HANDLE);
+
+	// the resources of the previous frame may be shown until then
+	WaitForPendingUpdate ();
+
+	m_hUpdate = vc_dispmanx_update_start (UPDATE_PRIORITY);
+
+	return m_hUpdate != DISPMANX_NO_HANDLE;
+}
+
+boolean CLayerCompositor::Update (boolean bWait)
+{
+	assert (m_hUpdate != DISPMANX_NO_HANDLE);
+	DISPMANX_UPDATE_HANDLE_T hUpdate = m_hUpdate;
+	m_hUpdate = DISPMANX_NO_HANDLE;
+
+	if (bWait)
+	{
+		return vc_dispmanx_update_submit_sync (hUpdate) == 0;
+	}
+
+	m_bUpdatePending = TRUE;
+
+	if (vc_dispmanx_update_submit (hUpdate, UpdateCallback, this) != 0)
+	{
+		m_bUpdatePending = FALSE;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CLayerCompositor::IsUpdating (void) const
+{
+	return m_hUpdate != DISPMANX_NO_HANDLE;
+}
+
+DISPMANX_DISPLAY_HANDLE_T CLayerCompositor::GetDisplayHandle (void) const
+{
+	return m_hDisplay;
+}
+
+DISPMANX_UPDATE_HANDLE_T CLayerCompositor::GetUpdateHandle (void) const
+{
+	assert (m_hUpdate != DISPMANX_NO_HANDLE);
+
+	return m_hUpdate;
+}
+
+void CLayerCompositor::WaitForPendingUpdate (void)
+{
+	while (m_bUpdatePending)
+	{
+		CScheduler::Get ()->Yield ();
+	}
+}
+
+void CLayerCompositor::UpdateCallback (DISPMANX_UPDATE_HANDLE_T hUpdate, void *pParam)
+{
+	CLayerCompositor *pThis = static_cast<CLayerCompositor *> (pParam);
+	assert (pThis != 0);
+
+	pThis->m_bUpdatePending = FALSE;
+}
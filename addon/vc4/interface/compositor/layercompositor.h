@@ -0,0 +1,184 @@
+//
+// layercompositor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _vc4_interface_compositor_layercompositor_h
+#define _vc4_interface_compositor_layercompositor_h
+
+#include <bcm_host.h>
+#include <circle/types.h>
+
+#define LAYER_MAX_BUFFERS	3
+
+class CLayerCompositor;
+
+/// \note A layer is an element of the VideoCore Hardware Video Scaler (HVS). It is composed
+///	  with the other layers on the display by the HVS, with scaling and alpha blending,
+///	  without using the ARM cores. The pixels are written into an ARM-side buffer and are
+///	  transferred into a (hidden) VideoCore resource with Flip(), which is shown with the
+///	  next CLayerCompositor::Update().
+
+class CCompositorLayer	/// A layer of the HVS with own pixel buffers and page flipping
+{
+public:
+	enum TFormat
+	{
+		FormatRGB565,		///< 16-bit 0bRRRRRGGG'GGGBBBBB
+		FormatARGB8888,		///< 32-bit 0xAARRGGBB, alpha is not premultiplied
+		FormatXRGB8888,		///< 32-bit 0xXXRRGGBB, opaque
+		FormatUnknown
+	};
+
+public:
+	/// \param pCompositor	Pointer to the compositor, this layer belongs to
+	/// \param Format	Pixel format of the layer
+	/// \param nWidth	Width of the source image in pixels
+	/// \param nHeight	Height of the source image in pixels
+	/// \param nLayer	Z-order of the layer (higher values are in front)
+	/// \param nBuffers	Number of VideoCore resources for page flipping\n
+	///			(1..LAYER_MAX_BUFFERS, 1 disables page flipping)
+	CCompositorLayer (CLayerCompositor *pCompositor, TFormat Format,
+			  unsigned nWidth, unsigned nHeight, int nLayer, unsigned nBuffers = 2);
+
+	~CCompositorLayer (void);
+
+	/// \brief Creates the resources and adds the (cleared) layer to the display
+	/// \return Operation successful?
+	/// \note Must be called inside of an update of the compositor.
+	boolean Initialize (void);
+
+	/// \return Width of the source image in pixels
+	unsigned GetWidth (void) const;
+	/// \return Height of the source image in pixels
+	unsigned GetHeight (void) const;
+	/// \return Number of bytes from one line of the buffer to the next
+	unsigned GetPitch (void) const;
+
+	/// \return Pointer to the ARM-side pixel buffer
+	void *GetBuffer (void);
+
+	/// \brief Transfers the pixel buffer into the next resource and shows it with the update
+	/// \param nY	  First line, which has been changed
+	/// \param nLines Number of changed lines (0 for all lines)
+	/// \return Operation successful?
+	/// \note Must be called inside of an update of the compositor.
+	/// \note With page flipping, the lines of the previous frames are transferred too.
+	boolean Flip (unsigned nY = 0, unsigned nLines = 0);
+
+	/// \note The following methods must be called inside of an update of the compositor.
+
+	/// \brief Sets the area of the display, the layer is shown in
+	/// \param nX, nY Position of the top-left corner on the display
+	/// \param nWidth, nHeight Size on the display (the image is scaled to it by the HVS)
+	void SetDestination (int nX, int nY, unsigned nWidth, unsigned nHeight);
+
+	/// \brief Sets the area of the source image, which is shown
+	/// \param nX, nY Position of the top-left corner in the source image
+	/// \param nWidth, nHeight Size of the area in the source image
+	void SetSource (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight);
+
+	/// \param uchOpacity Opacity of the whole layer (0 = transparent, 255 = opaque),\n
+	///	  is multiplied with the alpha of each pixel with FormatARGB8888
+	void SetOpacity (u8 uchOpacity);
+
+	/// \param nLayer Z-order of the layer (higher values are in front)
+	void SetLayer (int nLayer);
+
+	/// \param bVisible Show the layer (otherwise it is fully transparent)
+	void Show (boolean bVisible = TRUE);
+
+private:
+	void ApplyChanges (u32 nChangeFlags);
+
+	static VC_IMAGE_TYPE_T GetImageType (TFormat Format);
+
+private:
+	CLayerCompositor *m_pCompositor;
+	TFormat m_Format;
+	unsigned m_nWidth;
+	unsigned m_nHeight;
+	int m_nLayer;
+	unsigned m_nBuffers;
+
+	unsigned m_nPitch;
+	u8 *m_pBuffer;
+
+	DISPMANX_RESOURCE_HANDLE_T m_hResource[LAYER_MAX_BUFFERS];
+	unsigned m_nFrontBuffer;
+
+	// changed lines, which are missing in each resource
+	unsigned m_nDirtyFrom[LAYER_MAX_BUFFERS];
+	unsigned m_nDirtyTo[LAYER_MAX_BUFFERS];
+
+	DISPMANX_ELEMENT_HANDLE_T m_hElement;
+
+	VC_RECT_T m_DestRect;
+	VC_RECT_T m_SourceRect;
+	u8 m_uchOpacity;
+	boolean m_bVisible;
+};
+
+class CLayerCompositor	/// Composes a number of HVS layers on a display
+{
+public:
+	/// \param nDisplay Number of the display (0 = main LCD, 2 = HDMI 0, 7 = HDMI 1)
+	CLayerCompositor (unsigned nDisplay = 0);
+
+	~CLayerCompositor (void);
+
+	/// \return Operation successful?
+	/// \note The VCHIQ device must have been initialized before.
+	boolean Initialize (void);
+
+	/// \return Width of the display in pixels
+	unsigned GetWidth (void) const;
+	/// \return Height of the display in pixels
+	unsigned GetHeight (void) const;
+
+	/// \brief Starts a new update, which collects all changes of the layers
+	/// \return Operation successful?
+	/// \note Waits for the completion of the previous update, if it is still pending.
+	boolean BeginUpdate (void);
+
+	/// \brief Submits the update, which takes effect with the next vertical sync
+	/// \param bWait Wait for the completion of the update (otherwise return immediately)
+	/// \return Operation successful?
+	boolean Update (boolean bWait = TRUE);
+
+	/// \return Is an update open, which has been started with BeginUpdate()?
+	boolean IsUpdating (void) const;
+
+private:
+	DISPMANX_DISPLAY_HANDLE_T GetDisplayHandle (void) const;
+	DISPMANX_UPDATE_HANDLE_T GetUpdateHandle (void) const;
+	friend class CCompositorLayer;
+
+	void WaitForPendingUpdate (void);
+
+	static void UpdateCallback (DISPMANX_UPDATE_HANDLE_T hUpdate, void *pParam);
+
+private:
+	unsigned m_nDisplay;
+	DISPMANX_DISPLAY_HANDLE_T m_hDisplay;
+	DISPMANX_MODEINFO_T m_ModeInfo;
+
+	DISPMANX_UPDATE_HANDLE_T m_hUpdate;
+	volatile boolean m_bUpdatePending;
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <circle/devicenameservice.h>
 #include <circle/sched/scheduler.h>
 #include <circle/logger.h>
+#include <circle/new.h>
 #include <assert.h>
 
 #define VOLUME_TO_CHIP(volume)		((unsigned) -(((volume) << 8) / 100))
@@ -34,7 +35,8 @@ static const char FromVCHIQSound[] = "sndvchiq";
 CVCHIQSoundBaseDevice::CVCHIQSoundBaseDevice (CVCHIQDevice *pVCHIQDevice,
 					      unsigned nSampleRate,
 					      unsigned nChunkSize,
-					      TVCHIQSoundDestination Destination)
+					      TVCHIQSoundDestination Destination,
+					      unsigned nBuffers)
 :	CSoundBaseDevice (SoundFormatSigned16, 0, nSampleRate),
 	m_nSampleRate (nSampleRate),
 	m_nChunkSize (nChunkSize),
@@ -42,10 +44,20 @@ CVCHIQSoundBaseDevice::CVCHIQSoundBaseDevice (CVCHIQDevice *pVCHIQDevice,
 	m_State (VCHIQSoundCreated),
 	m_VCHIInstance (0),
 	m_hService (0),
+	m_nBuffers (nBuffers),
+	m_bFilling (FALSE),
 	m_Controller (this, Destination)
 {
 	//assert (44100 <= nSampleRate && nSampleRate <= 48000);
 	assert (Destination < VCHIQSoundDestinationUnknown);
+	assert (2 <= m_nBuffers && m_nBuffers <= VCHIQ_SOUND_MAX_BUFFERS);
+
+	// the VideoCore reads the buffers with DMA
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		m_pBuffer[i] = new (HEAP_DMA30) s16[m_nChunkSize];
+		assert (m_pBuffer[i] != 0);
+	}
 
 	CDeviceNameService::Get ()->AddDevice ("sndvchiq", this, FALSE);
 }
@@ -55,6 +67,12 @@ CVCHIQSoundBaseDevice::~CVCHIQSoundBaseDevice (void)
 	assert (m_State <= VCHIQSoundIdle);
 
 	CDeviceNameService::Get ()->RemoveDevice ("sndvchiq", FALSE);
+
+	for (unsigned i = 0; i < m_nBuffers; i++)
+	{
+		delete [] m_pBuffer[i];
+		m_pBuffer[i] = 0;
+	}
 }
 
 int CVCHIQSoundBaseDevice::GetRangeMin (void) const
@@ -185,46 +203,16 @@ boolean CVCHIQSoundBaseDevice::Start (void)
 		return FALSE;
 	}
 
+	m_nNextBuffer = 0;
+	m_nBuffersQueued = 0;
+	m_nCompleteBytes = 0;
+
 	m_State = VCHIQSoundRunning;
 
 	vchi_service_use (m_hService);
 
-	short usPeerVersion = 0;
-	nResult = vchi_get_peer_version (m_hService, &usPeerVersion);
-	if (nResult != 0)
-	{
-		vchi_service_release (m_hService);
-
-		CLogger::Get ()->Write (FromVCHIQSound, LogError,
-					"Cannot get peer version (%d)", nResult);
-
-		m_State = VCHIQSoundError;
-
-		return FALSE;
-	}
-
-	// we need peer version 2, because we do not support bulk transfers
-	if (usPeerVersion < 2)
-	{
-		vchi_service_release (m_hService);
-
-		CLogger::Get ()->Write (FromVCHIQSound, LogError,
-					"Peer version does not match (%u)", (unsigned) usPeerVersion);
-
-		m_State = VCHIQSoundError;
-
-		return FALSE;
-	}
-
-	m_nWritePos = 0;
-	m_nCompletePos = 0;
-
-	nResult = WriteChunk ();
-	if (nResult == 0)
-	{
-		nResult = WriteChunk ();
-	}
-
+	// queue all buffers, the completion callback keeps them in use
+	nResult = FillBuffers ();
 	if (nResult != 0)
 	{
 		vchi_service_release (m_hService);
@@ -250,7 +238,7 @@ void CVCHIQSoundBaseDevice::Cancel (void)
 	}
 
 	m_State = VCHIQSoundCancelled;
-	if (m_nWritePos - m_nCompletePos > 0)
+	if (m_nBuffersQueued > 0)
 	{
 		while (m_State == VCHIQSoundCancelled)
 		{
@@ -347,10 +335,38 @@ int CVCHIQSoundBaseDevice::QueueMessage (VC_AUDIO_MSG_T *pMessage)
 	return nResult;
 }
 
+int CVCHIQSoundBaseDevice::FillBuffers (void)
+{
+	// called from Start() and from the callback, which may run while Start() is blocked
+	if (m_bFilling)
+	{
+		return 0;
+	}
+
+	m_bFilling = TRUE;
+
+	int nResult = 0;
+	while (   m_State == VCHIQSoundRunning
+	       && m_nBuffersQueued < m_nBuffers)
+	{
+		nResult = WriteChunk ();
+		if (nResult != 0)
+		{
+			break;
+		}
+	}
+
+	m_bFilling = FALSE;
+
+	return nResult;
+}
+
 int CVCHIQSoundBaseDevice::WriteChunk (void)
 {
-	s16 Buffer[m_nChunkSize];
-	unsigned nWords = GetChunk (Buffer, m_nChunkSize);
+	s16 *pBuffer = m_pBuffer[m_nNextBuffer];
+	assert (pBuffer != 0);
+
+	unsigned nWords = GetChunk (pBuffer, m_nChunkSize);
 	if (nWords == 0)
 	{
 		m_State = VCHIQSoundIdle;
@@ -364,7 +380,7 @@ int CVCHIQSoundBaseDevice::WriteChunk (void)
 
 	Msg.type = VC_AUDIO_MSG_TYPE_WRITE;
 	Msg.u.write.count = nBytes;
-	Msg.u.write.max_packet = 4000;
+	Msg.u.write.max_packet = 0;		// data follows in a bulk transfer
 	Msg.u.write.cookie1 = VC_AUDIO_WRITE_COOKIE1;
 	Msg.u.write.cookie2 = VC_AUDIO_WRITE_COOKIE2;
 	Msg.u.write.silence = 0;
@@ -375,26 +391,22 @@ int CVCHIQSoundBaseDevice::WriteChunk (void)
 		return nResult;
 	}
 
-	m_nWritePos += nBytes;
-
-	u8 *pBuffer8 = (u8 *) Buffer;
-	while (nBytes > 0)
+	// the buffer is not touched again, before the write has been completed
+	nResult = vchi_bulk_queue_transmit (m_hService, pBuffer, nBytes, VCHI_FLAGS_NONE, 0);
+	if (nResult != 0)
 	{
-		unsigned nBytesToQueue =   nBytes <= Msg.u.write.max_packet
-					 ? nBytes
-					 : Msg.u.write.max_packet;
+		return nResult;
+	}
 
-		nResult = vchi_msg_queue (m_hService, pBuffer8, nBytesToQueue,
-					  VCHI_FLAGS_BLOCK_UNTIL_QUEUED, 0);
-		if (nResult != 0)
-		{
-			return nResult;
-		}
+	m_nBufferBytes[m_nNextBuffer] = nBytes;
 
-		pBuffer8 += nBytesToQueue;
-		nBytes -= nBytesToQueue;
+	if (++m_nNextBuffer == m_nBuffers)
+	{
+		m_nNextBuffer = 0;
 	}
 
+	m_nBuffersQueued++;
+
 	return 0;
 }
 
@@ -445,24 +457,36 @@ void CVCHIQSoundBaseDevice::Callback (const VCHI_CALLBACK_REASON_T Reason, void
 			break;
 		}
 
-		m_nCompletePos += Msg.u.complete.count & 0x3FFFFFFF;
-
-		// if there is no more than one chunk left queued
-		if (m_nWritePos-m_nCompletePos <= m_nChunkSize*sizeof (s16))
+		// release the buffers, which have been played completely
+		m_nCompleteBytes += Msg.u.complete.count & 0x3FFFFFFF;
+		while (m_nBuffersQueued > 0)
 		{
-			if (m_State == VCHIQSoundCancelled)
+			unsigned nOldest = (m_nNextBuffer + m_nBuffers - m_nBuffersQueued) % m_nBuffers;
+			if (m_nCompleteBytes < m_nBufferBytes[nOldest])
 			{
-				m_State = VCHIQSoundTerminating;
-
 				break;
 			}
 
-			if (WriteChunk () != 0)
-			{
-				assert (0);
+			m_nCompleteBytes -= m_nBufferBytes[nOldest];
+			m_nBuffersQueued--;
+		}
 
-				m_State = VCHIQSoundError;
+		if (m_State == VCHIQSoundCancelled)
+		{
+			if (m_nBuffersQueued == 0)
+			{
+				m_State = VCHIQSoundTerminating;
 			}
+
+			break;
+		}
+
+		// refill all free buffers at once, to keep the VideoCore fed
+		if (FillBuffers () != 0)
+		{
+			assert (0);
+
+			m_State = VCHIQSoundError;
 		}
 		break;
 
@@ -29,6 +29,8 @@
 #include <vc4/vchi/vchi.h>
 #include "vc_vchi_audioserv_defs.h"
 
+#define VCHIQ_SOUND_MAX_BUFFERS		4	// limited by VCHIQ_NUM_SERVICE_BULKS
+
 enum TVCHIQSoundState
 {
 	VCHIQSoundCreated,
@@ -48,10 +50,15 @@ public:
 	/// \param nChunkSize	number of samples transfered at once
 	/// \param Destination	the target device, the sound data is sent to\n
 	///			(detected automatically, if equal to VCHIQSoundDestinationAuto)
+	/// \param nBuffers	number of chunks queued to the VideoCore at once\n
+	///			(2..VCHIQ_SOUND_MAX_BUFFERS)
+	/// \note The chunks are sent in one bulk transfer each, so that larger chunk sizes
+	///	  reduce the overhead.
 	CVCHIQSoundBaseDevice (CVCHIQDevice *pVCHIQDevice,
 			       unsigned nSampleRate = 44100,
 			       unsigned nChunkSize  = 4000,
-			       TVCHIQSoundDestination Destination = VCHIQSoundDestinationAuto);
+			       TVCHIQSoundDestination Destination = VCHIQSoundDestinationAuto,
+			       unsigned nBuffers = 3);
 
 	virtual ~CVCHIQSoundBaseDevice (void);
 
@@ -95,6 +102,7 @@ private:
 	int CallMessage (VC_AUDIO_MSG_T *pMessage);	// waits for completion
 	int QueueMessage (VC_AUDIO_MSG_T *pMessage);	// does not wait for completion
 
+	int FillBuffers (void);		// queues chunks, until all buffers are in use
 	int WriteChunk (void);
 
 	void Callback (const VCHI_CALLBACK_REASON_T Reason, void *hMessage);
@@ -113,8 +121,13 @@ private:
 	CSynchronizationEvent m_Event;
 	int m_nResult;
 
-	unsigned m_nWritePos;
-	unsigned m_nCompletePos;
+	unsigned m_nBuffers;
+	s16 *m_pBuffer[VCHIQ_SOUND_MAX_BUFFERS];
+	unsigned m_nBufferBytes[VCHIQ_SOUND_MAX_BUFFERS];
+	unsigned m_nNextBuffer;			// next buffer to be written
+	volatile unsigned m_nBuffersQueued;	// in order from the oldest buffer
+	unsigned m_nCompleteBytes;		// completed bytes of the oldest buffer
+	boolean m_bFilling;
 
 	CVCHIQSoundController m_Controller;
 };
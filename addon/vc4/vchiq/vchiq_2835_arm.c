@@ -86,18 +86,23 @@ typedef struct vchiq_2835_state_struct {
 static void __iomem *g_regs;
 #ifndef __circle__
 static unsigned int g_cache_line_size = sizeof(CACHE_LINE_SIZE);
+static unsigned long g_virt_to_bus_offset;
+#else
+/* must match the cache-line-size property of the device tree */
+#if RASPPI == 1
+static const unsigned int g_cache_line_size = 32;
+#else
+static const unsigned int g_cache_line_size = 64;
+#endif
+#endif
 static unsigned int g_fragments_size;
 static char *g_fragments_base;
 static char *g_free_fragments;
 static struct semaphore g_free_fragments_sema;
-static unsigned long g_virt_to_bus_offset;
-#endif
 
 extern int vchiq_arm_log_level;
 
-#ifndef __circle__
 static DEFINE_SEMAPHORE(g_free_fragments_mutex);
-#endif
 
 static irqreturn_t
 vchiq_doorbell_irq(int irq, void *dev_id);
@@ -120,8 +125,8 @@ int vchiq_platform_init(struct platform_device *pdev, VCHIQ_STATE_T *state)
 	u32 channelbase;
 	int slot_mem_size, frag_mem_size;
 	int err, irq;
-#ifndef __circle__
 	int i;
+#ifndef __circle__
 
 	g_virt_to_bus_offset = virt_to_dma(dev, (void *)0);
 
@@ -132,17 +137,13 @@ int vchiq_platform_init(struct platform_device *pdev, VCHIQ_STATE_T *state)
 		dev_err(dev, "Missing cache-line-size property\n");
 		return -ENODEV;
 	}
+#endif
 
 	g_fragments_size = 2 * g_cache_line_size;
-#endif
 
 	/* Allocate space for the channels in coherent memory */
 	slot_mem_size = PAGE_ALIGN(TOTAL_SLOTS * VCHIQ_SLOT_SIZE);
-#ifndef __circle__
 	frag_mem_size = PAGE_ALIGN(g_fragments_size * MAX_FRAGMENTS);
-#else
-	frag_mem_size = 0;
-#endif
 
 	slot_mem = dmam_alloc_coherent(dev, slot_mem_size + frag_mem_size,
 				       &slot_phys, GFP_KERNEL);
@@ -162,7 +163,6 @@ int vchiq_platform_init(struct platform_device *pdev, VCHIQ_STATE_T *state)
 	vchiq_slot_zero->platform_data[VCHIQ_PLATFORM_FRAGMENTS_COUNT_IDX] =
 		MAX_FRAGMENTS;
 
-#ifndef __circle__
 	g_fragments_base = (char *)slot_mem + slot_mem_size;
 	slot_mem_size += frag_mem_size;
 
@@ -173,7 +173,6 @@ int vchiq_platform_init(struct platform_device *pdev, VCHIQ_STATE_T *state)
 	}
 	*(char **)&g_fragments_base[i * g_fragments_size] = NULL;
 	sema_init(&g_free_fragments_sema, MAX_FRAGMENTS);
-#endif
 
 	if (vchiq_init_state(state, vchiq_slot_zero, 0) != VCHIQ_SUCCESS)
 		return -EINVAL;
@@ -407,6 +406,8 @@ vchiq_doorbell_irq(int irq, void *dev_id)
 struct page {};
 #define vmalloc_to_page(p)	((struct page *) ((uintptr_t) (p) & ~(PAGE_SIZE - 1)))
 #define page_address(pg)	((void *) (pg))
+#define kmap(pg)		page_address(pg)
+#define kunmap(pg)		((void) 0)
 #endif
 
 static int
@@ -449,26 +450,32 @@ create_pagelist(char __user *buf, size_t count, unsigned short type,
 		int dir = (type == PAGELIST_WRITE) ?
 			DMA_TO_DEVICE : DMA_FROM_DEVICE;
 #endif
+#ifndef __circle__
 		unsigned int length = count;
 		unsigned int off = offset;
+#endif
 
 		for (actual_pages = 0; actual_pages < num_pages;
 		     actual_pages++) {
 			struct page *pg = vmalloc_to_page(buf + (actual_pages *
 								 PAGE_SIZE));
+#ifndef __circle__
 			size_t bytes = PAGE_SIZE - off;
 
 			if (bytes > length)
 				bytes = length;
+#endif
 			pages[actual_pages] = pg;
 #ifndef __circle__
 			dmac_map_area(page_address(pg) + off, bytes, dir);
-#else
-			CleanAndInvalidateDataCacheRange ((uintptr_t) pg + off, bytes);
-#endif
 			length -= bytes;
 			off = 0;
+#endif
 		}
+#ifdef __circle__
+		/* The memory is identity mapped, so maintain the whole buffer at once */
+		CleanAndInvalidateDataCacheRange ((uintptr_t) buf, count);
+#endif
 		*need_release = 0; /* do not try and release vmalloc pages */
 #ifndef __circle__
 	} else {
@@ -556,8 +563,8 @@ create_pagelist(char __user *buf, size_t count, unsigned short type,
 	addridx++;
 #endif
 
-#ifndef __circle__
-	/* Partial cache lines (fragments) require special measures */
+	/* Partial cache lines (fragments) require special measures,
+	   cache line aligned receive buffers are transferred directly */
 	if ((type == PAGELIST_READ) &&
 		((pagelist->offset & (g_cache_line_size - 1)) ||
 		((pagelist->offset + pagelist->length) &
@@ -580,6 +587,7 @@ create_pagelist(char __user *buf, size_t count, unsigned short type,
 			(fragments - g_fragments_base) / g_fragments_size;
 	}
 
+#ifndef __circle__
 	dmac_flush_range(pagelist, addrs + num_pages);
 #else
 	CleanAndInvalidateDataCacheRange ((uintptr_t) pagelist,
@@ -596,19 +604,21 @@ free_pagelist(PAGELIST_T *pagelist, int actual)
 {
 #ifndef __circle__
         unsigned long *need_release;
-	struct page **pages;
-	unsigned int num_pages, i;
+	unsigned int i;
 #endif
+	struct page **pages;
+	unsigned int num_pages;
 
 	vchiq_log_trace(vchiq_arm_log_level,
 		"free_pagelist - %x, %d", (unsigned int)(uintptr_t)pagelist, actual);
 
-#ifndef __circle__
 	num_pages =
 		(pagelist->length + pagelist->offset + PAGE_SIZE - 1) /
 		PAGE_SIZE;
 
+#ifndef __circle__
         need_release = (unsigned long *)(pagelist->addrs + num_pages);
+#endif
 	pages = (struct page **)(pagelist->addrs + num_pages + 1);
 
 	/* Deal with any partial cache lines (fragments) */
@@ -649,6 +659,21 @@ free_pagelist(PAGELIST_T *pagelist, int actual)
 		up(&g_free_fragments_sema);
 	}
 
+#ifdef __circle__
+	/* Discard cache lines, which have been speculatively loaded during
+	   the transfer. The partial lines at the ends were received into
+	   the fragments and must not be invalidated. */
+	if (pagelist->type != PAGELIST_WRITE && actual > 0) {
+		uintptr_t start = (uintptr_t) page_address(pages[0]) + pagelist->offset;
+		uintptr_t end = start + actual;
+
+		start = (start + g_cache_line_size - 1) & ~(uintptr_t) (g_cache_line_size - 1);
+		end &= ~(uintptr_t) (g_cache_line_size - 1);
+
+		if (start < end)
+			CleanAndInvalidateDataCacheRange (start, end - start);
+	}
+#else
 	if (*need_release) {
 		unsigned int length = pagelist->length;
 		unsigned int offset = pagelist->offset;
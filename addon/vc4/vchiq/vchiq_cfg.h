@@ -58,6 +58,15 @@
 #define VCHIQ_NUM_CURRENT_BULKS        32
 #define VCHIQ_NUM_SERVICE_BULKS        4
 
+#ifdef __circle__
+/* The CPU core, which runs the slot handler, recycle and sync threads, and so
+** the service callbacks. Its scheduler must be active, when VCHIQ is
+** initialized, otherwise the threads run on the initializing core. */
+#ifndef VCHIQ_SLOT_HANDLER_CORE
+#define VCHIQ_SLOT_HANDLER_CORE        0
+#endif
+#endif
+
 #ifndef VCHIQ_ENABLE_DEBUG
 #define VCHIQ_ENABLE_DEBUG             1
 #endif
@@ -50,6 +50,13 @@
 
 #define BULK_INDEX(x) (x & (VCHIQ_NUM_SERVICE_BULKS - 1))
 
+#ifndef __circle__
+#define vchiq_kthread_create kthread_create
+#else
+#define vchiq_kthread_create(fn, data, name) \
+	kthread_create_on_cpu(fn, data, VCHIQ_SLOT_HANDLER_CORE, name)
+#endif
+
 #define SRVTRACE_LEVEL(srv) \
 	(((srv) && (srv)->trace) ? VCHIQ_LOG_TRACE : vchiq_core_msg_log_level)
 #define SRVTRACE_ENABLED(srv, lev) \
@@ -2513,7 +2520,7 @@ vchiq_init_state(VCHIQ_STATE_T *state, VCHIQ_SLOT_ZERO_T *slot_zero,
 		bring up slot handler thread
 	 */
 	snprintf(threadname, sizeof(threadname), "VCHIQ-%d", state->id);
-	state->slot_handler_thread = kthread_create(&slot_handler_func,
+	state->slot_handler_thread = vchiq_kthread_create(&slot_handler_func,
 		(void *)state,
 		threadname);
 
@@ -2527,7 +2534,7 @@ vchiq_init_state(VCHIQ_STATE_T *state, VCHIQ_SLOT_ZERO_T *slot_zero,
 	wake_up_process(state->slot_handler_thread);
 
 	snprintf(threadname, sizeof(threadname), "VCHIQr-%d", state->id);
-	state->recycle_thread = kthread_create(&recycle_func,
+	state->recycle_thread = vchiq_kthread_create(&recycle_func,
 		(void *)state,
 		threadname);
 	if (state->recycle_thread == NULL) {
@@ -2540,7 +2547,7 @@ vchiq_init_state(VCHIQ_STATE_T *state, VCHIQ_SLOT_ZERO_T *slot_zero,
 	wake_up_process(state->recycle_thread);
 
 	snprintf(threadname, sizeof(threadname), "VCHIQs-%d", state->id);
-	state->sync_thread = kthread_create(&sync_func,
+	state->sync_thread = vchiq_kthread_create(&sync_func,
 		(void *)state,
 		threadname);
 	if (state->sync_thread == NULL) {
@@ -24,7 +24,8 @@ CLogBuffer::CLogBuffer (unsigned nSize)
 :	m_nSize (nSize),
 	m_pBuffer (0),
 	m_nInPtr (0),
-	m_nOutPtr (0)
+	m_nOutPtr (0),
+	m_ullWritten (0)
 {
 	m_pBuffer = new u8[m_nSize];
 	assert (m_pBuffer != 0);
@@ -71,6 +72,8 @@ void CLogBuffer::Put (const void *pBuffer, unsigned nLength)
 	const u8 *p = (const u8 *) pBuffer;
 	assert (p != 0);
 
+	m_ullWritten += nLength;
+
 	while (nLength-- > 0)
 	{
 		m_pBuffer[m_nInPtr++] = *p++;
@@ -100,3 +103,39 @@ unsigned CLogBuffer::Get (void *pBuffer)
 
 	return nResult;
 }
+
+unsigned CLogBuffer::Read (void *pBuffer, unsigned nSize, u64 *pPosition)
+{
+	assert (m_pBuffer != 0);
+	assert (pPosition != 0);
+
+	unsigned nAvail = m_nInPtr-m_nOutPtr;		// may wrap
+	if (nAvail > m_nSize)
+	{
+		nAvail += m_nSize;
+	}
+
+	u64 ullOldest = m_ullWritten - nAvail;
+	if (   *pPosition < ullOldest
+	    || *pPosition > m_ullWritten)		// invalid position from client
+	{
+		*pPosition = ullOldest;
+	}
+
+	unsigned nBehind = (unsigned) (m_ullWritten - *pPosition);
+	unsigned nResult = nBehind < nSize ? nBehind : nSize;
+
+	u8 *p = (u8 *) pBuffer;
+	assert (p != 0);
+
+	unsigned nPtr = (m_nInPtr + m_nSize - nBehind) % m_nSize;
+	for (unsigned nLength = nResult; nLength > 0; nLength--)
+	{
+		*p++ = m_pBuffer[nPtr++];
+		nPtr %= m_nSize;
+	}
+
+	*pPosition += nResult;
+
+	return nResult;
+}
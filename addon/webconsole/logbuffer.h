@@ -32,6 +32,13 @@ public:
 
 	unsigned Get (void *pBuffer);
 
+	// copies up to nSize bytes, which have been put after *pPosition, and advances it
+	// (if the data at *pPosition has been overwritten, reads from the oldest data)
+	unsigned Read (void *pBuffer, unsigned nSize, u64 *pPosition);
+
+	// returns the position after the last byte put
+	u64 GetPosition (void) const	{ return m_ullWritten; }
+
 private:
 	unsigned m_nSize;
 
@@ -39,6 +46,8 @@ private:
 
 	unsigned m_nInPtr;
 	unsigned m_nOutPtr;
+
+	u64 m_ullWritten;		// total number of bytes put
 };
 
 #endif
@@ -19,6 +19,12 @@
 //
 #include <webconsole/webconsole.h>
 #include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/tracer.h>
+#include <circle/metrics.h>
+#include <circle/pipelinestage.h>
+#include <circle/sched/scheduler.h>
+#include <circle/string.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -26,8 +32,36 @@
 
 static const char s_Header[] = "<pre>\n";
 
+// appends new log lines from the event stream, if the browser supports it
+static const char s_Trailer[] =
+	"</pre>\n"
+	"<script>\n"
+	"if (window.EventSource) {\n"
+	"  var log = document.getElementsByTagName (\"pre\")[0];\n"
+	"  var source = new EventSource (\"/events?log=%llu&metrics=0\");\n"
+	"  source.addEventListener (\"log\", function (e) {\n"
+	"    log.textContent += e.data + \"\\n\";\n"
+	"    window.scrollTo (0, document.body.scrollHeight);\n"
+	"  });\n"
+	"}\n"
+	"</script>\n";
+
+#define TRAILER_SIZE		(sizeof s_Trailer + 20)		// with expanded position
+
+#define STREAM_PERIOD_MS	250		// the log buffer is checked with this period
+#define METRICS_PERIODS		4		// metrics are exported every 4th period
+#define KEEPALIVE_PERIODS	60		// a comment is sent after 15s without events
+
+#define HEAP_PAGE_SAMPLES	32
+
+unsigned CWebConsole::s_nLastAllocations[HEAP_COHERENT+1] = {0};
+unsigned CWebConsole::s_nLastTicks = 0;
+
+unsigned CWebConsole::s_nStreams = 0;
+
 CWebConsole::CWebConsole (CNetSubSystem *pNetSubSystem, u16 nPort, CSocket *pSocket, CLogBuffer *pLog)
-:	CHTTPDaemon (pNetSubSystem, pSocket, LOG_BUFFER_SIZE + sizeof s_Header-1, nPort),
+:	CHTTPDaemon (pNetSubSystem, pSocket, LOG_BUFFER_SIZE + sizeof s_Header-1 + TRAILER_SIZE,
+		     nPort),
 	m_nPort (nPort),
 	m_pLog (pLog),
 	m_bLogCreated (FALSE)
@@ -65,6 +99,63 @@ THTTPStatus CWebConsole::GetContent (const char  *pPath,
 	assert (m_pLog != 0);
 
 	assert (pPath != 0);
+	if (strcmp (pPath, "/heap") == 0)
+	{
+		assert (pBuffer != 0);
+		assert (pLength != 0);
+		*pLength = GetHeapContent ((char *) pBuffer, *pLength);
+
+		assert (ppContentType != 0);
+		*ppContentType = "text/plain; charset=iso-8859-1";
+
+		return HTTPOK;
+	}
+
+	if (   strcmp (pPath, "/trace.json") == 0
+	    && CTracer::Get () != 0)
+	{
+		// the tracer is stopped, the trace is truncated to the content buffer
+		assert (pBuffer != 0);
+		assert (pLength != 0);
+		*pLength = CTracer::Get ()->ExportChromeTrace ((char *) pBuffer, *pLength);
+
+		assert (ppContentType != 0);
+		*ppContentType = "application/json";
+
+		return HTTPOK;
+	}
+
+	if (strcmp (pPath, "/metrics") == 0)
+	{
+		assert (pBuffer != 0);
+		assert (pLength != 0);
+		*pLength = CMetric::ExportAll ((char *) pBuffer, *pLength);
+
+		assert (ppContentType != 0);
+		*ppContentType = CMetric::GetContentType ();
+
+		return HTTPOK;
+	}
+
+	if (strcmp (pPath, "/pipeline") == 0)
+	{
+		assert (pBuffer != 0);
+		assert (pLength != 0);
+		*pLength = CPipelineStage::Export ((char *) pBuffer, *pLength);
+
+		assert (ppContentType != 0);
+		*ppContentType = "text/plain; charset=iso-8859-1";
+
+		return HTTPOK;
+	}
+
+	if (strcmp (pPath, "/events") == 0)
+	{
+		assert (pBuffer != 0);
+		assert (pLength != 0);
+		return StreamEvents (pParams, (char *) pBuffer, *pLength);
+	}
+
 	if (   strcmp (pPath, "/") != 0
 	    && strcmp (pPath, "/index.html") != 0)
 	{
@@ -72,8 +163,106 @@ THTTPStatus CWebConsole::GetContent (const char  *pPath,
 	}
 
 	assert (pBuffer != 0);
-	memcpy (pBuffer, s_Header, sizeof s_Header);
-	pBuffer += sizeof s_Header;
+	memcpy (pBuffer, s_Header, sizeof s_Header-1);
+
+	UpdateLog ();
+
+	unsigned nLength = sizeof s_Header-1;
+	nLength += m_pLog->Get (pBuffer + nLength);
+
+	CString Trailer;
+	Trailer.Format (s_Trailer, (unsigned long long) m_pLog->GetPosition ());
+	assert (Trailer.GetLength () < TRAILER_SIZE);
+	memcpy (pBuffer + nLength, (const char *) Trailer, Trailer.GetLength ());
+	nLength += Trailer.GetLength ();
+
+	assert (pLength != 0);
+	assert (*pLength >= nLength);
+	*pLength = nLength;
+
+	assert (ppContentType != 0);
+	*ppContentType = "text/html; charset=iso-8859-1";
+
+	return HTTPOK;
+}
+
+unsigned CWebConsole::GetHeapContent (char *pBuffer, unsigned nBufferSize)
+{
+	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+	unsigned nElapsed = nTicks - s_nLastTicks;
+	s_nLastTicks = nTicks;
+
+	CString Content;
+	for (int nType = HEAP_LOW; nType <= HEAP_COHERENT; nType++)
+	{
+		THeapStatistics Stats;
+		if (!CMemorySystem::GetHeapStatistics (nType, &Stats))
+		{
+			continue;
+		}
+
+		CString Line;
+		Line.Format ("%s heap\n\n",   nType == HEAP_LOW ? "Low"
+					     : (nType == HEAP_HIGH ? "High" : "Coherent"));
+		Content.Append (Line);
+
+		for (unsigned i = 0; i < Stats.nBuckets; i++)
+		{
+			Line.Format ("%8lu: %6u blocks (peak %u)\n",
+				     (unsigned long) Stats.Bucket[i].nSize,
+				     Stats.Bucket[i].nCount, Stats.Bucket[i].nMaxCount);
+			Content.Append (Line);
+		}
+
+		Line.Format ("   large: %6u blocks (peak %u)\n\n",
+			     Stats.nLargeCount, Stats.nLargeMaxCount);
+		Content.Append (Line);
+
+		unsigned nAllocations = Stats.nAllocations - s_nLastAllocations[nType];
+		s_nLastAllocations[nType] = Stats.nAllocations;
+		unsigned nRate = nElapsed != 0 ? (unsigned) ((u64) nAllocations * CLOCKHZ / nElapsed) : 0;
+
+		Line.Format ("Allocations %u (%u/s since last request)\n"
+			     "Free space %lu, bucket free lists %lu, large free lists %lu\n"
+			     "Largest free block %lu, fragmentation %u%%\n\n",
+			     Stats.nAllocations, nRate,
+			     (unsigned long) Stats.nFreeSpace, (unsigned long) Stats.nFreeBucketSpace,
+			     (unsigned long) Stats.nFreeLargeSpace, (unsigned long) Stats.nLargestFree,
+			     Stats.nFragmentation);
+		Content.Append (Line);
+
+		THeapSample Samples[HEAP_PAGE_SAMPLES];
+		unsigned nSamples = CMemorySystem::GetHeapSamples (nType, Samples, HEAP_PAGE_SAMPLES);
+		if (nSamples > 0)
+		{
+			Content.Append ("Sampled allocations (newest first):\n");
+		}
+
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			Line.Format ("  PC %lX: %lu bytes\n",
+				     (unsigned long) Samples[i].nCallerPC,
+				     (unsigned long) Samples[i].nSize);
+			Content.Append (Line);
+		}
+
+		Content.Append ("\n");
+	}
+
+	unsigned nLength = Content.GetLength ();
+	if (nLength > nBufferSize)
+	{
+		nLength = nBufferSize;
+	}
+
+	memcpy (pBuffer, (const char *) Content, nLength);
+
+	return nLength;
+}
+
+void CWebConsole::UpdateLog (void)
+{
+	assert (m_pLog != 0);
 
 	char Buffer[200];
 	int nBytesRead;
@@ -81,15 +270,242 @@ THTTPStatus CWebConsole::GetContent (const char  *pPath,
 	{
 		m_pLog->Put (Buffer, nBytesRead);
 	}
+}
 
-	unsigned nLength = sizeof s_Header + m_pLog->Get (pBuffer);
+THTTPStatus CWebConsole::StreamEvents (const char *pParams, char *pBuffer, unsigned nBufferSize)
+{
+	if (s_nStreams >= WEBCONSOLE_MAX_STREAMS)	// keep workers for other requests
+	{
+		return HTTPServiceUnavailable;
+	}
 
-	assert (pLength != 0);
-	assert (*pLength >= nLength);
-	*pLength = nLength;
+	// "log=position" continues after the given event ID, starts with the oldest line
+	// otherwise, "metrics=0" disables the metric events
+	u64 ullLogPosition = 0;
+	assert (pParams != 0);
+	const char *p = strstr (pParams, "log=");
+	if (p != 0)
+	{
+		for (p += 4; '0' <= *p && *p <= '9'; p++)
+		{
+			ullLogPosition = ullLogPosition * 10 + (*p - '0');
+		}
+	}
 
-	assert (ppContentType != 0);
-	*ppContentType = "text/html; charset=iso-8859-1";
+	boolean bMetrics = strstr (pParams, "metrics=0") == 0;
+
+	if (   !BeginResponse (HTTPOK, "text/event-stream", HTTPD_CONTENT_LENGTH_UNKNOWN,
+			       "Cache-Control: no-cache\r\n")
+	    || GetRequestMethod () == HTTPRequestMethodHead)
+	{
+		return HTTPOK;
+	}
+
+	s_nStreams++;
+
+	CHashMap<u32, u32> LastSamples;
+
+	// the client reconnects after one second, if the connection is lost
+	static const char Retry[] = "retry: 1000\n\n";
+	if (WriteContent (Retry, sizeof Retry-1))
+	{
+		unsigned nIdlePeriods = 0;
+		for (unsigned nPeriod = 0; TRUE; nPeriod++)
+		{
+			UpdateLog ();
+
+			int nResult = SendLogEvent (&ullLogPosition, pBuffer, nBufferSize);
+			if (   nResult >= 0
+			    && bMetrics
+			    && nPeriod % METRICS_PERIODS == 0)
+			{
+				int nMetrics = SendMetricsEvent (&LastSamples, pBuffer, nBufferSize);
+				nResult = nMetrics < 0 ? nMetrics : nResult + nMetrics;
+			}
+
+			if (nResult < 0)
+			{
+				break;
+			}
+
+			if (nResult > 0)
+			{
+				nIdlePeriods = 0;
+			}
+			else if (++nIdlePeriods >= KEEPALIVE_PERIODS)
+			{
+				// detects a closed connection and prevents proxy timeouts
+				static const char KeepAlive[] = ":\n\n";
+				if (!WriteContent (KeepAlive, sizeof KeepAlive-1))
+				{
+					break;
+				}
+
+				nIdlePeriods = 0;
+			}
+
+			CScheduler::Get ()->MsSleep (STREAM_PERIOD_MS);
+		}
+	}
+
+	assert (s_nStreams > 0);
+	s_nStreams--;
 
 	return HTTPOK;
 }
+
+int CWebConsole::SendLogEvent (u64 *pPosition, char *pBuffer, unsigned nBufferSize)
+{
+	assert (m_pLog != 0);
+	assert (pPosition != 0);
+	assert (pBuffer != 0);
+	assert (nBufferSize > 1);
+
+	// one byte is reserved to terminate the last line
+	unsigned nLength = m_pLog->Read (pBuffer, nBufferSize-1, pPosition);
+
+	// send complete lines only, the rest follows with the next event
+	unsigned nLines = nLength;
+	while (   nLines > 0
+	       && pBuffer[nLines-1] != '\n')
+	{
+		nLines--;
+	}
+
+	if (nLines == 0)
+	{
+		if (nLength < nBufferSize-1)
+		{
+			*pPosition -= nLength;
+
+			return 0;
+		}
+
+		nLines = nLength;		// a line longer than the buffer is split
+	}
+
+	*pPosition -= nLength - nLines;
+
+	CString Event;
+	Event.Format ("event: log\nid: %llu\n", (unsigned long long) *pPosition);
+
+	char *pLine = pBuffer;
+	char *pEnd = pBuffer + nLines;
+	while (pLine < pEnd)
+	{
+		char *pEOL = pLine;
+		while (   pEOL < pEnd
+		       && *pEOL != '\n')
+		{
+			pEOL++;
+		}
+
+		*pEOL = '\0';
+		if (   pEOL > pLine
+		    && pEOL[-1] == '\r')
+		{
+			pEOL[-1] = '\0';
+		}
+
+		Event.Append ("data: ");
+		Event.Append (pLine);
+		Event.Append ("\n");
+
+		pLine = pEOL + 1;
+	}
+
+	Event.Append ("\n");
+
+	if (!WriteContent ((const char *) Event, Event.GetLength ()))
+	{
+		return -1;
+	}
+
+	return Event.GetLength ();
+}
+
+int CWebConsole::SendMetricsEvent (CHashMap<u32, u32> *pLastSamples,
+				   char *pBuffer, unsigned nBufferSize)
+{
+	assert (pLastSamples != 0);
+	assert (pBuffer != 0);
+	assert (nBufferSize > 1);
+
+	unsigned nLength = CMetric::ExportAll (pBuffer, nBufferSize-1);
+	pBuffer[nLength] = '\0';
+
+	CString Event ("event: metrics\n");
+	boolean bChanged = FALSE;
+
+	char *pSavePtr;
+	for (char *pLine = strtok_r (pBuffer, "\n", &pSavePtr);
+	     pLine != 0;
+	     pLine = strtok_r (0, "\n", &pSavePtr))
+	{
+		if (*pLine == '#')		// HELP and TYPE lines
+		{
+			continue;
+		}
+
+		// sample line is "name{labels} value"
+		unsigned nLineLength = strlen (pLine);
+		unsigned nNameLength = nLineLength;
+		while (   nNameLength > 0
+		       && pLine[nNameLength-1] != ' ')
+		{
+			nNameLength--;
+		}
+
+		if (nNameLength == 0)
+		{
+			continue;
+		}
+
+		u32 nName = Hash (pLine, nNameLength);
+		u32 nValue = Hash (pLine + nNameLength, nLineLength - nNameLength);
+
+		const u32 *pLastValue = pLastSamples->Find (nName);
+		if (   pLastValue != 0
+		    && *pLastValue == nValue)
+		{
+			continue;
+		}
+
+		pLastSamples->Set (nName, nValue);
+
+		Event.Append ("data: ");
+		Event.Append (pLine);
+		Event.Append ("\n");
+
+		bChanged = TRUE;
+	}
+
+	if (!bChanged)
+	{
+		return 0;
+	}
+
+	Event.Append ("\n");
+
+	if (!WriteContent ((const char *) Event, Event.GetLength ()))
+	{
+		return -1;
+	}
+
+	return Event.GetLength ();
+}
+
+u32 CWebConsole::Hash (const char *pString, unsigned nLength)
+{
+	assert (pString != 0);
+
+	// FNV-1a
+	u32 nHash = 2166136261U;
+	while (nLength-- > 0)
+	{
+		nHash ^= (u8) *pString++;
+		nHash *= 16777619U;
+	}
+
+	return nHash;
+}
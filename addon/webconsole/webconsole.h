@@ -22,8 +22,14 @@
 
 #include <circle/net/httpdaemon.h>
 #include <webconsole/logbuffer.h>
+#include <circle/memory.h>
+#include <circle/hashmap.h>
 #include <circle/types.h>
 
+#ifndef WEBCONSOLE_MAX_STREAMS
+#define WEBCONSOLE_MAX_STREAMS	2	// concurrent event streams, each occupies a worker
+#endif
+
 class CWebConsole : public CHTTPDaemon
 {
 public:
@@ -44,10 +50,36 @@ public:
 			        unsigned    *pLength,		// in: buffer size, out: content length
 			        const char **ppContentType);	// set this if not "text/html"
 
+private:
+	// writes heap statistics and allocation samples to pBuffer
+	unsigned GetHeapContent (char *pBuffer, unsigned nBufferSize);
+
+	// moves new messages from the logger into the log buffer
+	void UpdateLog (void);
+
+	// pushes new log lines and changed metric samples as Server-Sent Events,
+	// until the connection is closed (pBuffer is used as scratch buffer)
+	THTTPStatus StreamEvents (const char *pParams, char *pBuffer, unsigned nBufferSize);
+
+	// send an event with the complete lines, which follow *pPosition in the log buffer,
+	// and one with the metric samples, which changed since the last call
+	// return the number of bytes sent, 0 if there was nothing new, or < 0 on error
+	int SendLogEvent (u64 *pPosition, char *pBuffer, unsigned nBufferSize);
+	int SendMetricsEvent (CHashMap<u32, u32> *pLastSamples,	// sample name to value hash
+			      char *pBuffer, unsigned nBufferSize);
+
+	static u32 Hash (const char *pString, unsigned nLength);
+
 private:
 	u16 m_nPort;
 	CLogBuffer *m_pLog;
 	boolean m_bLogCreated;
+
+	// for calculating the allocation rate between two requests of the heap page
+	static unsigned s_nLastAllocations[HEAP_COHERENT+1];
+	static unsigned s_nLastTicks;
+
+	static unsigned s_nStreams;		// active event streams
 };
 
 #endif
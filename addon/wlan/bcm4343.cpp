@@ -19,6 +19,7 @@
 //
 #include <wlan/bcm4343.h>
 #include <wlan/p9compat.h>
+#include <circle/netbuffer.h>
 #include <circle/logger.h>
 #include <circle/machineinfo.h>
 #include <circle/sysconfig.h>
@@ -39,6 +40,7 @@ CBcm4343Device *CBcm4343Device::s_pThis = 0;
 
 CBcm4343Device::CBcm4343Device (const char *pFirmwarePath)
 :	m_FirmwarePath (pFirmwarePath),
+	m_RxQueue (NET_QUEUE_HIGH_WATER_MARK),
 	m_bOpenNet (FALSE),
 	m_bLinkUp (FALSE),
 	m_pIsConnected (0)
@@ -114,32 +116,51 @@ const CMACAddress *CBcm4343Device::GetMACAddress (void) const
 	return &m_MACAddress;
 }
 
-boolean CBcm4343Device::SendFrame (const void *pBuffer, unsigned nLength)
+boolean CBcm4343Device::IsSendFrameAdvisable (void)
 {
-	//hexdump (pBuffer, nLength, "wlantx");
+	assert (s_EtherDevice.oq != 0);
+	return qlen (s_EtherDevice.oq) < BCM4343_TX_QUEUE_MAX;
+}
 
-	Block *pBlock = allocb (nLength);
-	assert (pBlock != 0);
+boolean CBcm4343Device::SendFrame (const void *pBuffer, unsigned nLength)
+{
+	QueueFrame (pBuffer, nLength);
 
-	assert (pBlock->wp != 0);
-	assert (pBuffer != 0);
-	memcpy (pBlock->wp, pBuffer, nLength);
-	pBlock->wp += nLength;
+	return StartTransmit ();
+}
 
-	assert (s_EtherDevice.oq != 0);
-	qpass (s_EtherDevice.oq, pBlock);
+unsigned CBcm4343Device::SendBuffers (CNetBuffer *pFrames[], unsigned nCount)
+{
+	assert (pFrames != 0);
 
-	if (waserror ())
+	unsigned nFrames = 0;
+	while (   nFrames < nCount
+	       && (   nFrames == 0
+		   || IsSendFrameAdvisable ()))
 	{
-		return FALSE;
-	}
+		CNetBuffer *pFrame = pFrames[nFrames];
+		assert (pFrame != 0);
 
-	assert (s_EtherDevice.transmit != 0);
-	(*s_EtherDevice.transmit) (&s_EtherDevice);
+		unsigned nLength = pFrame->GetTotalLength ();
+		Block *pBlock = AllocBlock (nLength);
 
-	poperror ();
+		pFrame->CopyTo (pBlock->wp);
+		pBlock->wp += nLength;
 
-	return TRUE;
+		assert (s_EtherDevice.oq != 0);
+		qpass (s_EtherDevice.oq, pBlock);
+
+		nFrames++;
+	}
+
+	// the frames are transferred in one go, flow control permitting
+	if (   nFrames > 0
+	    && !StartTransmit ())
+	{
+		return 0;
+	}
+
+	return nFrames;
 }
 
 boolean CBcm4343Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
@@ -325,6 +346,45 @@ void CBcm4343Device::ScanResultReceived (const void *pBuffer, unsigned nLength)
 	s_pThis->m_ScanResultQueue.Enqueue (pBuffer, nLength);
 }
 
+Block *CBcm4343Device::AllocBlock (unsigned nLength)
+{
+	// tailroom for padding the frame to the SDIO block size in txstart()
+	Block *pBlock = allocb (nLength + BCM4343_TX_BLOCK_SIZE);
+	assert (pBlock != 0);
+	assert (pBlock->wp != 0);
+
+	return pBlock;
+}
+
+void CBcm4343Device::QueueFrame (const void *pBuffer, unsigned nLength)
+{
+	//hexdump (pBuffer, nLength, "wlantx");
+
+	Block *pBlock = AllocBlock (nLength);
+
+	assert (pBuffer != 0);
+	memcpy (pBlock->wp, pBuffer, nLength);
+	pBlock->wp += nLength;
+
+	assert (s_EtherDevice.oq != 0);
+	qpass (s_EtherDevice.oq, pBlock);
+}
+
+boolean CBcm4343Device::StartTransmit (void)
+{
+	if (waserror ())
+	{
+		return FALSE;
+	}
+
+	assert (s_EtherDevice.transmit != 0);
+	(*s_EtherDevice.transmit) (&s_EtherDevice);
+
+	poperror ();
+
+	return TRUE;
+}
+
 void CBcm4343Device::OpenNetEventHandler (ether_event_type_t Type,
 					  const ether_event_params_t *pParams,
 					  void *pContext)
@@ -27,6 +27,11 @@
 #include <circle/types.h>
 #include "etherevent.h"
 
+#define BCM4343_TX_QUEUE_MAX	32		// frames waiting for flow control credits
+#define BCM4343_TX_BLOCK_SIZE	512		// SDIO function 2 block size
+
+struct Block;
+
 typedef ether_event_handler_t TBcm4343EventHandler;
 typedef boolean TBcm4343ConnectedProvider (void);
 
@@ -42,8 +47,13 @@ public:
 
 	const CMACAddress *GetMACAddress (void) const;
 
+	boolean IsSendFrameAdvisable (void);
+
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
 
+	/// \brief Queue a batch of frames and start the transmission once
+	unsigned SendBuffers (CNetBuffer *pFrames[], unsigned nCount);
+
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
 
@@ -90,6 +100,10 @@ public:
 	static void ScanResultReceived (const void *pBuffer, unsigned nLength);
 
 private:
+	static struct Block *AllocBlock (unsigned nLength);
+	static void QueueFrame (const void *pBuffer, unsigned nLength);
+	static boolean StartTransmit (void);
+
 	static void OpenNetEventHandler (ether_event_type_t Type,
 					 const ether_event_params_t *pParams,
 					 void *pContext);
@@ -204,6 +204,7 @@ struct Ctlr {
 	uchar	txwindow;
 	uchar	txseq;
 	uchar	rxseq;
+	uchar	rxnextlen;
 	ether_event_handler_t *evhndlr;
 	void	*evcontext;
 };
@@ -1268,13 +1269,21 @@ wlreadpkt(Ctlr *ctl)
 {
 	Block *b;
 	Sdpcm *p;
-	int len, lenck;
+	int len, lenck, rdlen;
 
 	b = allocb(2048);
 	p = (Sdpcm*)b->wp;
 	qlock(&ctl->pktlock);
 	for(;;){
-		packetrw(0, b->wp, sizeof(*p));
+		/*
+		 * the previous frame announced the length of this one
+		 * (in units of 16 bytes), so it can be read in one go
+		 */
+		rdlen = ctl->rxnextlen << 4;
+		ctl->rxnextlen = 0;
+		if(rdlen < sizeof(*p) || rdlen > 2048)
+			rdlen = sizeof(*p);
+		packetrw(0, b->wp, rdlen);
 		len = p->len[0] | p->len[1]<<8;
 		if(len == 0){
 			freeb(b);
@@ -1283,8 +1292,9 @@ wlreadpkt(Ctlr *ctl)
 		}
 		lenck = p->lenck[0] | p->lenck[1]<<8;
 		if(lenck != (len ^ 0xFFFF) ||
-		   len < sizeof(*p) || len > 2048){
-			print("ether4330: wlreadpkt error len %.4x lenck %.4x\n", len, lenck);
+		   len < sizeof(*p) || len > 2048 ||
+		   (rdlen > sizeof(*p) && ROUND(len, 16) < rdlen)){
+			print("ether4330: wlreadpkt error len %.4x lenck %.4x rdlen %.4x\n", len, lenck, rdlen);
 			cfgw(Framectl, Rfhalt);
 			while(cfgr(Rfrmcnt+1))
 				;
@@ -1292,8 +1302,9 @@ wlreadpkt(Ctlr *ctl)
 				;
 			continue;
 		}
-		if(len > sizeof(*p))
-			packetrw(0, b->wp + sizeof(*p), len - sizeof(*p));
+		if(len > rdlen)
+			packetrw(0, b->wp + rdlen, len - rdlen);
+		ctl->rxnextlen = p->nextlen;
 		b->wp += len;
 		break;
 	}
@@ -1307,7 +1318,8 @@ txstart(Ether *edev)
 	Ctlr *ctl;
 	Sdpcm *p;
 	Block *b;
-	int len, off;
+	int len, off, pad;
+	uchar credits;
 
 	ctl = edev->ctlr;
 	if(!canqlock(&ctl->tlock))
@@ -1318,7 +1330,9 @@ txstart(Ether *edev)
 	}
 	for(;;){
 		lock(&ctl->txwinlock);
-		if(ctl->txseq == ctl->txwindow){
+		/* window is the highest sequence number the firmware accepts */
+		credits = ctl->txwindow - ctl->txseq;
+		if(credits == 0 || credits & 0x80){
 			//print("f");
 			unlock(&ctl->txwinlock);
 			break;
@@ -1344,6 +1358,16 @@ txstart(Ether *edev)
 		p->doffset = off;
 		put4(b->rp + off, 0x20);	/* BDC header */
 		if(iodebug) dump("send", b->rp, len);
+		/*
+		 * pad larger frames to the Fn2 block size, so that they
+		 * go out in one block mode transfer instead of a block
+		 * and a byte mode transfer; the firmware uses p->len
+		 */
+		if(len > 512 && (pad = ROUND(len, 512) - len) != 0
+		   && b->lim - b->wp >= pad){
+			memset(b->wp, 0, pad);
+			b->wp += pad;
+		}
 		qlock(&ctl->pktlock);
 		if(waserror()){
 			if(iodebug) print("halt frame %x %x\n", cfgr(Wfrmcnt+1), cfgr(Wfrmcnt+1));
@@ -1355,7 +1379,7 @@ txstart(Ether *edev)
 			qunlock(&ctl->pktlock);
 			nexterror();
 		}
-		packetrw(1, b->rp, len);
+		packetrw(1, b->rp, BLEN(b));
 		ctl->txseq++;
 		poperror();
 		qunlock(&ctl->pktlock);
@@ -1394,8 +1418,7 @@ rproc(void *a)
 		if(p->window != ctl->txwindow || p->fcmask != ctl->fcmask){
 			lock(&ctl->txwinlock);
 			if(p->window != ctl->txwindow){
-				if(ctl->txseq == ctl->txwindow)
-					flowstart = 1;
+				flowstart = 1;
 				ctl->txwindow = p->window;
 			}
 			if(p->fcmask != ctl->fcmask){
@@ -14,7 +14,7 @@ Block *allocb (size_t size)
 	b->buf = b->data;
 
 	b->next = 0;
-	b->lim = b->buf + size;
+	b->lim = (uchar *) b + size;
 	b->wp = b->buf + maxhdrsize;
 	b->rp = b->wp;
 
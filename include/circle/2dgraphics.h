@@ -26,10 +26,15 @@
 #include <circle/display.h>
 #include <circle/bcmframebuffer.h>
 #include <circle/chargenerator.h>
+#include <circle/dmachannel.h>
 #include <circle/types.h>
 
 #define COLOR2D(red, green, blue)	DISPLAY_COLOR (red, green, blue)
 
+#define C2DGRAPHICS_MAX_DIRTY_AREAS	8
+
+#define C2DGRAPHICS_MAX_PAGES		3	// with VSync and triple buffering
+
 typedef CDisplay::TColor T2DColor;
 
 class C2DGraphics;
@@ -75,6 +80,23 @@ public:
 		AlignCenter
 	};
 
+	enum TImageFormat
+	{
+		ImageFormatRGB565,	///< 16-bit 0bRRRRRGGG'GGGBBBBB
+		ImageFormatRGB888,	///< 24-bit, bytes in the order red, green, blue
+		ImageFormatARGB8888	///< 32-bit 0xAARRGGBB, alpha is not premultiplied
+	};
+
+	struct TFrameStats		///< all times in microseconds
+	{
+		unsigned nFrames;		///< number of UpdateDisplay() calls
+		unsigned nMissedVSyncs;		///< refresh periods, in which no new frame was shown
+		unsigned nLastFrameTime;	///< time between the last two UpdateDisplay() calls
+		unsigned nMaxFrameTime;
+		unsigned nAvgFrameTime;
+		unsigned nRefreshPeriod;	///< measured display refresh period (0 if unknown)
+	};
+
 public:
 	/// \param pDisplay Pointer to display driver
 	/// \note There is no VSync support with this constructor.
@@ -89,9 +111,23 @@ public:
 
 	~C2DGraphics (void);
 
+	/// \brief Uses three buffers instead of two with VSync, so that drawing of the next\n
+	///	   frame can continue, while a page flip is pending
+	/// \note Must be called before Initialize(). Has no effect without VSync.
+	void EnableTripleBuffering (void);
+
 	/// \return Operation successful?
 	boolean Initialize (void);
 
+	/// \brief Offloads filled rectangles, clearing the screen and images without\n
+	///	   transparency to the DMA controller, which runs asynchronously to the CPU
+	/// \note Must be called after Initialize(). Not supported with a depth of 1 bit.
+	void EnableDMA (void);
+
+	/// \brief Waits for the completion of a running DMA operation (fence)
+	/// \note Is called automatically, before the drawing buffer is accessed otherwise.
+	void WaitForDMA (void);
+
 	/// \param nWidth  New screen width in pixels
 	/// \param nHeight New screen height in pixels
 	/// \return Operation successful?
@@ -188,6 +224,31 @@ public:
 	/// \param TransparentColor Color to use for transparency
 	void DrawImageRectTransparent (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight, unsigned nSourceX, unsigned nSourceY, unsigned nSourceWidth, unsigned nSourceHeight, const void *PixelBuffer, T2DColor TransparentColor);
 	
+	/// \brief Draws an image, which is converted from another pixel format
+	/// \param nX Image X coordinate
+	/// \param nY Image Y coordinate
+	/// \param nWidth Image width
+	/// \param nHeight Image height
+	/// \param pPixels Pointer to the pixels
+	/// \param Format Pixel format of the image
+	/// \note The alpha channel of ImageFormatARGB8888 is ignored.
+	/// \note Supported with the color models RGB565, RGB565_BE and ARGB8888 only.
+	void DrawImageConvert (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			       const void *pPixels, TImageFormat Format);
+
+	/// \brief Draws an image with alpha blending
+	/// \param nX Image X coordinate
+	/// \param nY Image Y coordinate
+	/// \param nWidth Image width
+	/// \param nHeight Image height
+	/// \param pPixels Pointer to the pixels
+	/// \param Format Pixel format of the image
+	/// \param uchAlpha Global alpha value (0 = transparent, 255 = opaque),\n
+	///	  is multiplied with the alpha of each pixel with ImageFormatARGB8888
+	/// \note Supported with the color models RGB565, RGB565_BE and ARGB8888 only.
+	void DrawImageBlend (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			     const void *pPixels, TImageFormat Format, u8 uchAlpha = 255);
+
 	/// \brief Draws a single pixel. If you need to draw a lot of pixels, consider using GetBuffer() for better speed
 	/// \param nX Pixel X coordinate
 	/// \param nY Pixel Y coordinate
@@ -209,6 +270,10 @@ public:
 
 	/// \brief Gets raw access to the drawing buffer
 	/// \return Pointer to the buffer
+	/// \note Changes in the buffer cannot be tracked, so that UpdateDisplay() always\n
+	///	  updates the whole screen afterwards.
+	/// \note With DMA enabled, call WaitForDMA() before accessing the buffer again,\n
+	///	  after other drawing methods have been called.
 	void *GetBuffer (void);
 
 	/// \return Pointer to display, we are working on
@@ -216,8 +281,43 @@ public:
 	
 	/// \brief Once everything has been drawn, updates the display to show the contents on screen
 	/// \brief If VSync is enabled, this method is blocking until the screen refresh signal is received (every 16ms for 60FPS refresh rate)
+	/// \brief With triple buffering it returns without waiting, unless the previous page flip may still be pending
+	/// \note Only the areas, which have been changed by the Draw*() methods, are updated.
 	void UpdateDisplay (void);
 
+	/// \param pStats Statistics since Initialize() or ResetFrameStats() are returned here
+	void GetFrameStats (TFrameStats *pStats) const;
+	/// \brief Resets the frame pacing statistics
+	void ResetFrameStats (void);
+
+private:
+	struct TDirtyAreas
+	{
+		unsigned nCount;
+		CDisplay::TArea Area[C2DGRAPHICS_MAX_DIRTY_AREAS];
+	};
+
+	// coordinates are inclusive and must be inside the screen
+	void MarkDirty (unsigned nX1, unsigned nY1, unsigned nX2, unsigned nY2);
+	void MarkAllDirty (TDirtyAreas *pAreas);
+	static void AddDirtyArea (TDirtyAreas *pAreas, const CDisplay::TArea &rArea);
+	static int GetMergeCost (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2);
+	static CDisplay::TArea GetUnion (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2);
+
+	void FlushDirtyAreas (CDisplay *pDisplay, const TDirtyAreas &rAreas, unsigned nOffsetY);
+
+	void UpdateFrameStats (void);
+
+	// return FALSE, if the operation has to be done by the CPU
+	boolean DMAFill (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			 CDisplay::TRawColor nColor);
+	boolean DMACopy (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			 const void *pPixels);
+	u8 *PrepareDMA (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight);
+
+	void DrawImageARGB (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			    const void *pPixels, TImageFormat Format, unsigned nAlpha, boolean bBlend);
+
 private:
 	void SetPixel (unsigned nX, unsigned nY, CDisplay::TRawColor nColor)
 	{
@@ -293,7 +393,26 @@ private:
 	};
 
 	boolean m_bVSync;
-	boolean m_bBufferSwapped;
+	boolean m_bTripleBuffering;
+	unsigned m_nPages;			// in the frame buffer with VSync
+	unsigned m_nVisiblePage;		// last page set with SetVirtualOffset()
+
+	TDirtyAreas m_DirtyAreas;
+	TDirtyAreas m_PrevDirtyAreas[C2DGRAPHICS_MAX_PAGES-1];	// for the other buffers with VSync
+	boolean m_bRawAccess;
+
+	u8 *m_pUpdateBuffer;			// for areas, which are not full width
+	size_t m_nUpdateBufferSize;
+
+	CDMAChannel *m_pDMAChannel;
+	boolean m_bDMAActive;
+	uintptr m_nDMADestination;		// range in the drawing buffer
+	size_t m_nDMALength;
+
+	unsigned m_nRefreshPeriod;		// microseconds
+	unsigned m_nLastUpdateTicks;
+	u64 m_ullFrameTimeSum;
+	TFrameStats m_FrameStats;
 };
 
 #endif
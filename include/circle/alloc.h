@@ -33,6 +33,10 @@ void free (void *pBlock);
 void *calloc (size_t nBlocks, size_t nSize);
 void *realloc (void *pBlock, size_t nSize);
 
+// allocates from the DMA coherent pool (non-cacheable, no cache maintenance required),
+// resulting block is aligned to DATA_CACHE_LINE_LENGTH_MAX, free it with free()
+void *dma_alloc_coherent (size_t nSize);
+
 void *palloc (void);			// returns aligned page (AArch32: 4K, AArch64: 64K)
 void pfree (void *pPage);
 
@@ -0,0 +1,80 @@
+//
+// arenaallocator.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_arenaallocator_h
+#define _circle_arenaallocator_h
+
+#include <circle/types.h>
+
+#define ARENA_DEFAULT_ALIGN	16
+
+/// \note All blocks of an arena are freed at once with Reset() or when the arena is destroyed.
+///	  An arena is not protected against concurrent access. Use one arena per task instead.
+/// \note Destructors of objects, which have been created in an arena using the placement new
+///	  operator below, are not called automatically.
+
+class CArenaAllocator	/// Allocates blocks linearly from pages, frees all blocks at once
+{
+public:
+	CArenaAllocator (void);
+	~CArenaAllocator (void);
+
+	/// \param nSize Block size to be allocated
+	/// \param nAlign Alignment of the block (must be a power of 2)
+	/// \return Pointer to new allocated block (0 if out of memory)
+	/// \note Blocks, which do not fit into a page, are allocated from the heap.
+	void *Allocate (size_t nSize, size_t nAlign = ARENA_DEFAULT_ALIGN);
+
+	/// \brief Frees all blocks of the arena
+	/// \note The first page is kept for the next usage.
+	void Reset (void);
+
+	/// \return Number of bytes allocated from the arena since the last Reset()
+	size_t GetUsedSize (void) const		{ return m_nUsedSize; }
+
+private:
+	void FreePages (void);
+
+private:
+	struct TArenaPage
+	{
+		TArenaPage *pNext;
+	};
+
+	TArenaPage *m_pFirstPage;
+	TArenaPage *m_pLargeBlocks;		// blocks allocated from the heap
+
+	u8 *m_pNext;				// next free byte in the current page
+	u8 *m_pLimit;				// end of the current page
+
+	size_t m_nUsedSize;
+};
+
+// placement new for objects in an arena, e.g.: new (Arena) CFoo (...)
+inline void *operator new (size_t nSize, CArenaAllocator &rArena)
+{
+	return rArena.Allocate (nSize);
+}
+
+inline void *operator new[] (size_t nSize, CArenaAllocator &rArena)
+{
+	return rArena.Allocate (nSize);
+}
+
+#endif
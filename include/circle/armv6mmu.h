@@ -79,6 +79,7 @@ PACKED;
 #endif
 #define ARMV6MMUL1SECTION_DEVICE	0x10416		// shared device
 #define ARMV6MMUL1SECTION_COHERENT	0x10412		// strongly ordered
+#define ARMV6MMUL1SECTION_NONCACHED	0x11412		// shared normal non-cacheable
 
 #define ARMV6MMUL1SECTIONBASE(addr)	(((addr) >> 20) & 0xFFF)
 #define ARMV6MMUL1SECTIONPTR(base)	((void *) ((base) << 20))
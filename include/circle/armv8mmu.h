@@ -122,6 +122,7 @@ struct TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR
 PACKED;
 
 #define ARMV8MMU_LEVEL3_PAGE_SIZE	0x10000
+#define ARMV8MMU_LEVEL3_CONTIGUOUS	32		// pages per contiguous group (2MB)
 #define ARMV8MMUL3PAGEADDR(addr)	(((addr) >> 16) & 0xFFFFFFFF)
 #define ARMV8MMUL3PAGEPTR(page)		((void *) ((page) << 16))
 
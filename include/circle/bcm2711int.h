@@ -2,7 +2,7 @@
 // bcm2711int.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -29,8 +29,13 @@
 // IRQs
 #define ARM_IRQLOCAL0_CNTPNS	GIC_PPI (14)
 
+#define ARM_IRQ_SOFTIRQ		2		// SGI, used by CSoftIRQ (see IPI_SOFT_IRQ)
+
 #if RASPPI == 4
 
+#define ARM_IRQ_PMU0		GIC_SPI (16)	// core n: ARM_IRQ_PMU0 + n
+
+#define ARM_IRQ_ARM_MAILBOX	GIC_SPI (33)
 #define ARM_IRQ_ARM_DOORBELL_0	GIC_SPI (34)
 #define ARM_IRQ_TIMER1		GIC_SPI (65)
 #define ARM_IRQ_USB		GIC_SPI (73)
@@ -51,6 +56,7 @@
 #define ARM_IRQ_DMA14		GIC_SPI (92)
 #define ARM_IRQ_CAM0		GIC_SPI (102)
 #define ARM_IRQ_CAM1		GIC_SPI (103)
+#define ARM_IRQ_I2CSPISLV	GIC_SPI (107)
 #define ARM_IRQ_GPIO0		GIC_SPI (113)
 #define ARM_IRQ_GPIO1		GIC_SPI (114)
 #define ARM_IRQ_GPIO2		GIC_SPI (115)
@@ -68,6 +74,8 @@
 
 #else
 
+#define ARM_IRQLOCAL0_PMU	GIC_PPI (7)
+
 #define ARM_IRQ_DMA0		GIC_SPI (80)
 #define ARM_IRQ_DMA1		GIC_SPI (81)
 #define ARM_IRQ_DMA2		GIC_SPI (82)
@@ -82,6 +90,7 @@
 #define ARM_IRQ_DMA11		GIC_SPI (91)
 #define ARM_IRQ_UART_D0		GIC_SPI (120)	// BCM2712 D0 stepping
 #define ARM_IRQ_UART		GIC_SPI (121)
+#define ARM_IRQ_PCIE_MIP0_BASE	GIC_SPI (128)	// 64 SPIs of the MSI interrupt peripheral
 #define ARM_IRQ_PCIE_EXT_HOST_INTA GIC_SPI (219)
 #define ARM_IRQ_PCIE_HOST_INTA	GIC_SPI (229)
 #define ARM_IRQ_PCIE_HOST_MSI	GIC_SPI (234)
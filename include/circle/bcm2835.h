@@ -167,6 +167,8 @@
 #define MAILBOX0_READ  		(MAILBOX_BASE + 0x00)
 #define MAILBOX0_STATUS 	(MAILBOX_BASE + 0x18)
 	#define MAILBOX_STATUS_EMPTY	0x40000000
+#define MAILBOX0_CONFIG		(MAILBOX_BASE + 0x1C)
+	#define MAILBOX_CONFIG_IRQ_DATA	(1 << 0)	// IRQ, when data is available
 #define MAILBOX1_WRITE		(MAILBOX_BASE + 0x20)
 #define MAILBOX1_STATUS 	(MAILBOX_BASE + 0x38)
 	#define MAILBOX_STATUS_FULL	0x80000000
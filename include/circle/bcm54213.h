@@ -84,9 +84,19 @@ public:
 
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
 
+	// sets up the descriptors for all frames, before the transmission is started
+	unsigned SendBuffers (CNetBuffer *pFrames[], unsigned nCount);
+
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
 
+	// fetches the frames from the Rx ring in one batch
+	unsigned ReceiveBuffers (CNetBuffer *pFrames[], unsigned nBudget);
+
+	// interrupt-driven receive
+	boolean RegisterReceiveHandler (TNetReceiveHandler *pHandler, void *pParam);
+	boolean EnableReceiveInterrupt (void);
+
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
 
@@ -137,6 +147,10 @@ private:
 	unsigned tx_reclaim(TGEnetTxRing *ring);
 	void free_tx_cb(TGEnetCB *cb);
 
+	// Tx frame setup without and with starting the transmission
+	boolean QueueFrame (const void *pBuffer, unsigned nLength, unsigned *pRingMask);
+	void StartTransmit (unsigned nRingMask);
+
 	// Rx queues, rings and buffers
 	int init_rx_queues(void);
 	int init_rx_ring(unsigned index, unsigned size, unsigned start_ptr, unsigned end_ptr);
@@ -144,6 +158,8 @@ private:
 	void free_rx_buffers(void);
 	u8 *rx_refill(TGEnetCB *cb);
 	u8 *free_rx_cb(TGEnetCB *cb);
+	unsigned rx_pending(TGEnetRxRing *ring);
+	int rx_frame(TGEnetRxRing *ring, void *pBuffer);
 
 	// Helpers
 	void dmadesc_set(uintptr d, u8 *addr, u32 value);
@@ -184,6 +200,9 @@ private:
 	TGEnetCB *m_rx_cbs;				// Rx control blocks
 	TGEnetRxRing m_rx_rings[GENET_DESC_INDEX+1];	// Rx rings
 
+	TNetReceiveHandler *m_pRxHandler;
+	void *m_pRxParam;
+
 	boolean m_crc_fwd_en;		// has FCS to be removed?
 
 	// PHY status
@@ -68,7 +68,9 @@ public:
 
 	boolean UpdatePalette (void);			// with Depth <= 8 only
 
-	boolean SetVirtualOffset (u32 nOffsetX, u32 nOffsetY);
+	/// \param bWaitForVSync Wait for the vertical sync, after the offset has been set,\n
+	///	  in the same mailbox transaction (the previous page is not displayed any more then)
+	boolean SetVirtualOffset (u32 nOffsetX, u32 nOffsetY, boolean bWaitForVSync = FALSE);
 
 	boolean WaitForVerticalSync (void);
 
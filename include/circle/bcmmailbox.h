@@ -21,9 +21,13 @@
 #define _circle_bcmmailbox_h
 
 #include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/interrupt.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
+typedef void TMailBoxCompletionRoutine (u32 nResult, void *pParam);
+
 class CBcmMailBox
 {
 public:
@@ -33,6 +37,15 @@ public:
 
 	u32 WriteRead (unsigned nData);
 
+	// starts the request and returns, the completion routine is called from the mailbox IRQ,
+	// returns FALSE if the mailbox IRQ is not connected (use WriteRead() instead),
+	// only one asynchronous request can be active (further calls wait for completion)
+	boolean WriteReadAsync (u32 nData, TMailBoxCompletionRoutine *pRoutine, void *pParam);
+
+	// enables WriteReadAsync(), the completion routine must not access the mailbox itself
+	static void ConnectInterrupt (CInterruptSystem *pInterrupt);
+	static boolean IsInterruptConnected (void);
+
 private:
 	void Flush (void);
 
@@ -44,6 +57,14 @@ private:
 	boolean m_bEarlyUse;
 
 	static CSpinLock s_SpinLock;
+
+	static void InterruptHandler (void *pParam);
+
+	static boolean s_bInterruptConnected;
+	static volatile boolean s_bAsyncPending;	// the sync calls wait for the completion
+	static unsigned s_nAsyncChannel;
+	static TMailBoxCompletionRoutine *s_pAsyncRoutine;
+	static void *s_pAsyncParam;
 };
 
 #endif
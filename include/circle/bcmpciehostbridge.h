@@ -7,7 +7,7 @@
 //	Licensed under GPL-2.0
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -39,14 +39,20 @@ struct TPCIeMemoryWindow
 
 typedef void TPCIeMSIHandler (unsigned nVector, void *pParam);
 
-struct TPCIeMSIData
+#if RASPPI == 4
+#define PCIE_MSI_VECTORS	32	// internal MSI controller of the host bridge
+#else
+#define PCIE_MSI_VECTORS	64	// MSI interrupt peripheral (MIP), one SPI per vector
+#endif
+
+class CBcmPCIeHostBridge;
+
+struct TPCIeMSIVector
 {
-	uintptr		base;
-	u64		target_addr;
-	uintptr		intr_base;	// base of interrupt status/set/clr regs
-	unsigned	rev;
-	TPCIeMSIHandler *handler;
-	void		*param;
+	CBcmPCIeHostBridge *pOwner;	// 0 if vector is free
+	TPCIeMSIHandler	*pHandler;
+	void		*pParam;
+	unsigned	 nVector;
 };
 
 class CBcmPCIeHostBridge	/// Driver for PCIe Host Bridge(s) of Raspberry Pi 4 and 5
@@ -67,10 +73,48 @@ public:
 	/// \return Operation successful?
 	boolean EnableDevice (u32 nClassCode, unsigned nSlot, unsigned nFunc);
 
-#if 0
-	boolean ConnectMSI (TPCIeMSIHandler *pHandler, void *pParam);
-	void DisconnectMSI (void);
-#endif
+	/// \brief Allocate a MSI vector and connect a handler to it
+	/// \param pHandler Handler, which is called with the vector number in interrupt context
+	/// \param pParam User parameter, which is handed over to the handler
+	/// \param nCore Core (0..CORES-1), on which the handler will be called
+	/// \return Vector number, or -1 if no vector is available
+	/// \note On the Raspberry Pi 4 all vectors share one IRQ, which is routed to the core,\n
+	///	  which has been requested for the first allocated vector.
+	int AllocateMSIVector (TPCIeMSIHandler *pHandler, void *pParam, unsigned nCore = 0);
+	/// \param nVector Vector number, returned by AllocateMSIVector()
+	void FreeMSIVector (unsigned nVector);
+
+	/// \brief Enable MSI with a single vector for a device
+	/// \param nSlot Slot number of the device
+	/// \param nFunc Function number of the device
+	/// \param nVector Vector number, returned by AllocateMSIVector()
+	/// \return Operation successful?
+	/// \note Must be called after EnableDevice(). Disables INTx for the device.
+	boolean EnableMSI (unsigned nSlot, unsigned nFunc, unsigned nVector);
+
+	/// \param nSlot Slot number of the device
+	/// \param nFunc Function number of the device
+	/// \return Number of MSI-X table entries, 0 if MSI-X is not supported
+	unsigned GetMSIXTableSize (unsigned nSlot, unsigned nFunc);
+	/// \brief Assign a vector to an entry of the MSI-X table of a device and unmask it
+	/// \param nSlot Slot number of the device
+	/// \param nFunc Function number of the device
+	/// \param nEntry Index into the MSI-X table (0..GetMSIXTableSize()-1)
+	/// \param nVector Vector number, returned by AllocateMSIVector()
+	/// \return Operation successful?
+	/// \note Must be called after EnableDevice(). The table must be located in BAR0.
+	boolean SetMSIXVector (unsigned nSlot, unsigned nFunc, unsigned nEntry, unsigned nVector);
+	/// \brief Enable MSI-X for a device, after its table entries have been set
+	/// \param nSlot Slot number of the device
+	/// \param nFunc Function number of the device
+	/// \return Operation successful?
+	/// \note Disables INTx for the device.
+	boolean EnableMSIX (unsigned nSlot, unsigned nFunc);
+
+	/// \brief Disable MSI and MSI-X for a device and return to INTx
+	/// \param nSlot Slot number of the device
+	/// \param nFunc Function number of the device
+	void DisableMSI (unsigned nSlot, unsigned nFunc);
 
 	/// \param nBus 0-based PCIe bus number
 	/// \return Base address of the inbound memory window
@@ -104,8 +148,13 @@ private:
 	bool pcie_link_up(void);
 	bool pcie_rc_mode(void);
 
-	int pcie_enable_msi(TPCIeMSIHandler *pHandler, void *pParam);
-	static void msi_set_regs(TPCIeMSIData *msi);
+	int pcie_enable_msi(void);
+	void pcie_disable_msi(void);
+#if RASPPI == 4
+	void msi_set_regs(void);
+#endif
+	void msi_compose_msg(unsigned vector, u64 *addr, u32 *data);
+	uintptr msix_table_entry(uintptr conf, unsigned entry);
 
 	static int cfg_index(int busnr, int devfn, int reg);
 
@@ -118,7 +167,11 @@ private:
 	static void wr_fld(uintptr p, u32 mask, int shift, u32 val);
 	static void wr_fld_rb(uintptr p, u32 mask, int shift, u32 val);
 
+#if RASPPI == 4
 	static void InterruptHandler (void *pParam);
+#else
+	static void MIPInterruptHandler (void *pParam);
+#endif
 
 	void usleep_range (unsigned min, unsigned max);
 	void msleep (unsigned ms);
@@ -154,9 +207,17 @@ private:
 	int			 m_num_scbs;
 
 	u64			 m_msi_target_addr;
-	TPCIeMSIData		*m_msi;
+#if RASPPI == 4
+	boolean			 m_bMSIEnabled;
+#endif
 
 	static u64		 s_nDMAAddress[PCIE_BUS_NUM];
+
+	// the vectors are a global resource of the MSI controller
+	static TPCIeMSIVector	 s_MSIVector[PCIE_MSI_VECTORS];
+#if RASPPI >= 5
+	static boolean		 s_bMIPInitialized;
+#endif
 };
 
 #endif
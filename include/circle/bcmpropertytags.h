@@ -309,6 +309,8 @@ struct TPropertyTagCommandLine
 }
 PACKED;
 
+typedef void TPropertyTagsCompletionRoutine (boolean bOK, void *pParam);
+
 class CBcmPropertyTags
 {
 public:
@@ -323,8 +325,40 @@ public:
 	boolean GetTags (void	 *pTags,			// pointer to tags struct
 			 unsigned nTagsSize);			// size of tags struct
 
+	// several tags can be processed in one mailbox transaction using the tags struct,
+	// the tags struct must remain valid until the completion routine is called from IRQ,
+	// returns FALSE if the mailbox IRQ is not connected (see CBcmMailBox::ConnectInterrupt())
+	boolean GetTagsAsync (void	 *pTags,		// pointer to tags struct
+			      unsigned nTagsSize,		// size of tags struct
+			      TPropertyTagsCompletionRoutine *pRoutine,
+			      void	 *pParam = 0);
+
+	// fills in the header of a tag, which is part of a tags struct
+	static void InitTag (void *pTag, u32 nTagId, unsigned nTagSize, unsigned nRequestParmSize = 0);
+
+private:
+	static int GetCacheIndex (u32 nTagId, unsigned nValueBufSize, unsigned nRequestParmSize);
+
+	static void AsyncCompletionRoutine (u32 nResult, void *pParam);
+
 private:
 	CBcmMailBox m_MailBox;
+
+	struct TCachedTag			// values of immutable tags
+	{
+		volatile boolean bValid;
+		u32		 nValueBufSize;
+		u32		 nValueLength;
+		u32		 Value[2];
+	};
+
+	static TCachedTag s_CachedTags[];
+
+	static volatile int s_nAsyncBusy;
+	static void *s_pAsyncTags;
+	static unsigned s_nAsyncTagsSize;
+	static TPropertyTagsCompletionRoutine *s_pAsyncRoutine;
+	static void *s_pAsyncParam;
 };
 
 #endif
@@ -2,7 +2,7 @@
 // bcmrandom.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -23,6 +23,8 @@
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
+#define RNG_POOL_WORDS		16	// words drained from the FIFO at once
+
 class CBcmRandomNumberGenerator		/// Driver for the build-in hardware random number generator
 {
 public:
@@ -30,11 +32,27 @@ public:
 	~CBcmRandomNumberGenerator (void);
 
 	/// \return Random number (32-bit)
+	/// \note Waits only, if the pool and the hardware FIFO are empty.
 	u32 GetNumber (void);
 
+	/// \param pBuffer Pointer to buffer, receives the random bytes
+	/// \param nLength Number of bytes requested
+	void GetBytes (void *pBuffer, size_t nLength);
+
+private:
+	// waits for at least one word and reads all words available in the FIFO,
+	// called with spin lock acquired, returns the number of words read
+	static unsigned ReadFIFO (u32 *pBuffer, unsigned nMaxWords);
+
+	// returns a word from the pool, which is refilled from the FIFO if empty
+	static u32 GetPoolWord (void);
+
 private:
 	static CSpinLock s_SpinLock;
 	static boolean s_bInitialized;
+
+	static u32 s_Pool[RNG_POOL_WORDS];
+	static unsigned s_nPoolWords;		// valid words at the start of s_Pool
 };
 
 #endif
@@ -0,0 +1,68 @@
+//
+// bootprofile.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_bootprofile_h
+#define _circle_bootprofile_h
+
+#include <circle/types.h>
+
+#define BOOT_PROFILE_MAX_MARKS	64
+
+/// \class CBootProfile
+/// \brief Records time stamps of the boot phases, from sysinit() onward
+///
+/// \details Mark() can be called from the application (e.g. after each step of\n
+/// CKernel::Initialize()) to add own phases. The time stamps are taken from the free\n
+/// running system counter, which starts at power-on, so that the first mark shows\n
+/// the time spent in the firmware too. Dump() writes a report to the logger.
+///
+/// \note Mark() accepts only static strings, the pointer is stored.
+
+class CBootProfile
+{
+public:
+	/// \brief Records the start of a boot phase
+	/// \param pPhase Name of the phase (static string)
+	/// \note Further marks are ignored, if BOOT_PROFILE_MAX_MARKS is exceeded.
+	static void Mark (const char *pPhase);
+
+	/// \brief Writes the report of the recorded phases to the logger
+	static void Dump (void);
+
+	/// \return Number of recorded marks
+	static unsigned GetCount (void);
+	/// \param nIndex Index of the mark (0 .. GetCount()-1)
+	/// \return Name of the phase
+	static const char *GetPhase (unsigned nIndex);
+	/// \param nIndex Index of the mark (0 .. GetCount()-1)
+	/// \return Time stamp in microseconds since power-on
+	static u64 GetTimestamp (unsigned nIndex);
+
+private:
+	struct TMark
+	{
+		const char	*pPhase;
+		u64		 ullTimestamp;
+	};
+
+	static TMark s_Mark[BOOT_PROFILE_MAX_MARKS];
+	static volatile unsigned s_nMarks;
+};
+
+#endif
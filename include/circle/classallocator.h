@@ -23,6 +23,8 @@
 #define _circle_classallocator_h
 
 #include <circle/spinlock.h>
+#include <circle/memorymap.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
 
@@ -36,6 +38,8 @@
 		static void InitAllocator (unsigned nReservedObjects);		\
 		static void InitProtectedAllocator (unsigned nReservedObjects,	\
 						    unsigned nTargetLevel);	\
+		static void InitLockFreeAllocator (unsigned nReservedObjects,	\
+						   unsigned nTargetLevel);	\
 	private:								\
 		static CClassAllocator *s_pAllocator;
 
@@ -77,6 +81,23 @@
 		else							\
 			s_pAllocator->Extend (nReservedObjects,		\
 					      nTargetLevel);		\
+	}								\
+	void class::InitLockFreeAllocator (unsigned nReservedObjects,	\
+					   unsigned nTargetLevel)	\
+	{								\
+		if (s_pAllocator == 0)					\
+		{							\
+			s_pAllocator = new CClassAllocator (		\
+						sizeof (class),		\
+						nReservedObjects,	\
+						nTargetLevel,		\
+						TRUE,			\
+						#class);		\
+			assert (s_pAllocator != 0);			\
+		}							\
+		else							\
+			s_pAllocator->Extend (nReservedObjects,		\
+					      nTargetLevel);		\
 	}
 
 // call this somewhere before the class is instantiated
@@ -85,6 +106,10 @@
 // initializes an allocator which is protected by a spin lock
 #define INIT_PROTECTED_CLASS_ALLOCATOR(class, objects, level) \
 	class::InitProtectedAllocator (objects, level)
+// initializes an allocator with per-core free lists and a lock-free global free list,
+// which can be used from code running at level (e.g. IRQ_LEVEL) on all cores
+#define INIT_LOCKFREE_CLASS_ALLOCATOR(class, objects, level) \
+	class::InitLockFreeAllocator (objects, level)
 
 class CClassAllocator
 {
@@ -98,6 +123,13 @@ public:
 			 unsigned    nTargetLevel,
 			 const char *pClassName);
 
+	// lock-free variant (bLockFree must be TRUE)
+	CClassAllocator (size_t      nObjectSize,
+			 unsigned    nReservedObjects,
+			 unsigned    nTargetLevel,
+			 boolean     bLockFree,
+			 const char *pClassName);
+
 	~CClassAllocator (void);
 
 	void *Allocate (void);
@@ -109,6 +141,13 @@ public:
 private:
 	void Init (size_t nObjectSize, unsigned nReservedObjects);
 
+	void *AllocateLockFree (void);
+	void FreeLockFree (struct TBlock *pBlock);
+
+	// global free list (tagged pointer, lock-free)
+	struct TBlock *PopGlobal (void);
+	void PushGlobal (struct TBlock *pFirst, struct TBlock *pLast);
+
 private:
 	size_t      m_nObjectSize;
 	unsigned    m_nReservedObjects;
@@ -120,6 +159,20 @@ private:
 	boolean   m_bProtected;
 	unsigned  m_nTargetLevel;
 	CSpinLock m_SpinLock;
+
+	boolean m_bLockFree;
+	u64 m_nGlobalFreeList;			// tagged pointer to first free block
+
+	struct TCoreCache
+	{
+		struct TBlock *pFreeList;
+		unsigned       nCount;
+	}
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_CoreCache[CORES];
+#else
+	m_CoreCache[1];
+#endif
 };
 
 #endif
@@ -0,0 +1,86 @@
+//
+// corechannel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_corechannel_h
+#define _circle_corechannel_h
+
+#include <circle/sysconfig.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+/// \note A channel connects exactly one sender core with one receiver core. Messages have a
+///	  fixed size, which is set on construction, and are copied into the ring, so that the
+///	  sender can reuse its message buffer immediately. No lock is needed and an IPI is sent
+///	  only, if the receiver is waiting for a message in WaitAndReceive(). Use one channel
+///	  object per direction and core pair.
+
+class CCoreChannel	/// Bounded lock-free message channel from one CPU core to another
+{
+public:
+	/// \param nSenderCore Core, which calls Send()
+	/// \param nReceiverCore Core, which calls Receive() or WaitAndReceive()
+	/// \param nMessageSize Size of a message in bytes
+	/// \param nSize Maximum number of queued messages (must be a power of 2)
+	CCoreChannel (unsigned nSenderCore, unsigned nReceiverCore,
+		      size_t nMessageSize, unsigned nSize = 16);
+	~CCoreChannel (void);
+
+	/// \return Size of a message in bytes
+	size_t GetMessageSize (void) const		{ return m_nMessageSize; }
+
+	/// \return Is no message queued?
+	boolean IsEmpty (void) const;
+
+	/// \param pMessage Message to be sent (nMessageSize bytes)
+	/// \return FALSE, if the channel is full
+	/// \note Must be called on the sender core only, in any context.
+	boolean Send (const void *pMessage);
+
+	/// \param pMessage The next message will be copied here (nMessageSize bytes)
+	/// \return FALSE, if no message is available
+	/// \note Must be called on the receiver core only, in any context.
+	boolean Receive (void *pMessage);
+
+	/// \brief Waits in WFE state until a message is available and returns it
+	/// \param pMessage The next message will be copied here (nMessageSize bytes)
+	/// \note Must be called on the receiver core only, from TASK_LEVEL.
+	void WaitAndReceive (void *pMessage);
+
+private:
+	unsigned m_nSenderCore;
+	unsigned m_nReceiverCore;
+	size_t m_nMessageSize;
+	size_t m_nSlotSize;		// message size rounded up to cache lines
+	unsigned m_nMask;
+	u8 *m_pBuffer;
+
+	// each index is written by one side only, keep them in separate cache lines
+	volatile unsigned m_nHead ALIGN (DATA_CACHE_LINE_LENGTH_MAX);	// next to be read
+	volatile unsigned m_nTail ALIGN (DATA_CACHE_LINE_LENGTH_MAX);	// next to be written
+
+	volatile boolean m_bReceiverWaiting ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+};
+
+#endif
+
+#endif
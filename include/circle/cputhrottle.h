@@ -43,6 +43,14 @@ enum TSystemThrottledState
 
 typedef void TSystemThrottledHandler (TSystemThrottledState CurrentState, void *pParam);
 
+#define CPU_CLOCK_RATE_STATS_MAX	32
+
+struct TCPUClockRateStat		///< Time spent at a CPU clock rate
+{
+	unsigned	nClockRate;	///< in Hz
+	u64		ullMicros;	///< accumulated time
+};
+
 /// \warning You have to repeatedly call SetOnTemperature() or Update() if you use this class!\n
 ///	     See the description of SetOnTemperature() for details!\n
 ///	     IF YOU ARE NOT SURE ABOUT HOW TO MANAGE THIS, DO NOT USE THIS CLASS!
@@ -86,6 +94,14 @@ public:
 	/// \return Previous setting or CPUSpeedUnknown on error
 	TCPUSpeed SetSpeed (TCPUSpeed Speed, boolean bWait = TRUE);
 
+	/// \brief Sets a CPU clock rate between the minimum and maximum clock rate
+	/// \param nClockRate Requested clock rate in Hz (will be limited to the valid range)
+	/// \return Operation successful?
+	/// \note This is intended to be used by a load-based governor (see CCPUGovernor).\n
+	///	  The minimum clock rate is set instead, while the speed is set to CPUSpeedLow\n
+	///	  or the SoC temperature is too high. Does not wait for the clock rate to settle.
+	boolean RequestClockRate (unsigned nClockRate);
+
 	/// \brief Sets the CPU speed depending on current SoC temperature.\n
 	/// Call this repeatedly all 2 to 5 seconds to hold temperature down!\n
 	/// Throttles the CPU down when the SoC temperature reaches 60 degrees Celsius\n
@@ -108,6 +124,12 @@ public:
 	void RegisterSystemThrottledHandler (unsigned StateMask,
 					     TSystemThrottledHandler *pHandler, void *pParam = 0);
 
+	/// \brief Get the time spent at each clock rate since construction
+	/// \param pStats Array to be filled with the statistics
+	/// \param nMaxEntries Number of entries in the array
+	/// \return Number of valid entries
+	unsigned GetClockRateStats (TCPUClockRateStat *pStats, unsigned nMaxEntries);
+
 	/// \brief Dump some information on the current CPU status
 	/// \param bAll Dump all information (only current clock rate and temperature otherwise)
 	void DumpStatus (boolean bAll = TRUE);
@@ -117,6 +139,9 @@ public:
 
 private:
 	boolean SetSpeedInternal (TCPUSpeed Speed, boolean bWait);
+	boolean SetClockRateInternal (unsigned nClockRate, boolean bWait);
+
+	void UpdateClockRateStats (unsigned nNewClockRate);
 
 	boolean CheckThrottledState (void);
 
@@ -134,6 +159,9 @@ private:
 	unsigned m_nEnforcedTemperature;
 
 	TCPUSpeed m_SpeedSet;
+	unsigned  m_nRequestedRate;
+	unsigned  m_nCurrentRate;		// as set last time
+	boolean   m_bTemperatureLimit;
 	unsigned  m_nTicksLastSet;
 	unsigned  m_nTicksLastUpdate;
 
@@ -142,6 +170,10 @@ private:
 	TSystemThrottledHandler *m_pThrottledHandler;
 	void *m_pThrottledParam;
 
+	TCPUClockRateStat m_ClockRateStats[CPU_CLOCK_RATE_STATS_MAX];
+	unsigned m_nClockRateStats;
+	unsigned m_nTicksLastRateChange;
+
 	boolean m_bFanConnected;
 	boolean m_bFanActiveLow;
 	CGPIOPin m_FanPin;
@@ -0,0 +1,65 @@
+//
+// aes.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_aes_h
+#define _circle_crypto_aes_h
+
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define AES_BLOCK_SIZE		16
+#define AES_MAX_ROUNDS		14
+
+class CAES		/// AES block cipher (FIPS 197), encryption direction only
+{
+public:
+	CAES (void);
+	~CAES (void);
+
+	/// \param pKey Pointer to the key
+	/// \param nKeyLength Key length in bytes (16, 24 or 32)
+	/// \return Operation successful?
+	boolean SetKey (const u8 *pKey, size_t nKeyLength);
+
+	/// \param pIn Pointer to plaintext block (AES_BLOCK_SIZE bytes)
+	/// \param pOut Pointer to ciphertext block (may be the same as pIn)
+	void EncryptBlock (const u8 *pIn, u8 *pOut) const;
+
+	/// \brief Counter mode with a 32-bit big-endian counter in the last word of the block
+	/// \param pIn Pointer to input data
+	/// \param pOut Pointer to output data (may be the same as pIn)
+	/// \param nLength Data length in bytes (multiple of AES_BLOCK_SIZE, except for the last call)
+	/// \param pCounter Pointer to counter block (AES_BLOCK_SIZE bytes), will be updated
+	void CryptCTR32 (const u8 *pIn, u8 *pOut, size_t nLength, u8 *pCounter) const;
+
+private:
+	static void InitTables (void);
+
+private:
+	unsigned m_nRounds;
+	u8 m_RoundKeys[AES_MAX_ROUNDS+1][AES_BLOCK_SIZE] ALIGN(16);
+
+	boolean m_bUseCE;	// use ARMv8 Crypto Extensions
+
+	static boolean s_bTablesValid;
+	static u8 s_SBox[256];
+	static u32 s_TE[256];
+};
+
+#endif
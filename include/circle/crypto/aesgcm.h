@@ -0,0 +1,79 @@
+//
+// aesgcm.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_aesgcm_h
+#define _circle_crypto_aesgcm_h
+
+#include <circle/crypto/aes.h>
+#include <circle/types.h>
+
+#define AES_GCM_IV_SIZE		12
+#define AES_GCM_TAG_SIZE	16
+
+class CAESGCM		/// AES in Galois/Counter Mode (NIST SP 800-38D), authenticated encryption
+{
+public:
+	CAESGCM (void);
+	~CAESGCM (void);
+
+	/// \param pKey Pointer to the key
+	/// \param nKeyLength Key length in bytes (16, 24 or 32)
+	/// \return Operation successful?
+	boolean SetKey (const u8 *pKey, size_t nKeyLength);
+
+	/// \param pIV Pointer to the initialization vector (AES_GCM_IV_SIZE bytes)
+	/// \param pAAD Pointer to additional authenticated data (may be 0, if nAADLength is 0)
+	/// \param nAADLength Length of additional authenticated data in bytes
+	/// \param pIn Pointer to plaintext
+	/// \param pOut Pointer to buffer, receives the ciphertext (may be the same as pIn)
+	/// \param nLength Length of plaintext in bytes
+	/// \param pTag Pointer to buffer, receives the authentication tag (AES_GCM_TAG_SIZE bytes)
+	void Encrypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+		      const u8 *pIn, u8 *pOut, size_t nLength, u8 *pTag);
+
+	/// \param pIV Pointer to the initialization vector (AES_GCM_IV_SIZE bytes)
+	/// \param pAAD Pointer to additional authenticated data (may be 0, if nAADLength is 0)
+	/// \param nAADLength Length of additional authenticated data in bytes
+	/// \param pIn Pointer to ciphertext
+	/// \param pOut Pointer to buffer, receives the plaintext (may be the same as pIn)
+	/// \param nLength Length of ciphertext in bytes
+	/// \param pTag Pointer to the received authentication tag (AES_GCM_TAG_SIZE bytes)
+	/// \return Authentication successful? (the plaintext must be discarded otherwise)
+	boolean Decrypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+			 const u8 *pIn, u8 *pOut, size_t nLength, const u8 *pTag);
+
+private:
+	void Crypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+		    const u8 *pIn, u8 *pOut, size_t nLength, boolean bDecrypt, u8 *pTag);
+
+	void GHASH (u8 *pHash, const u8 *pData, size_t nLength);
+	void MultiplyH (u8 *pHash) const;
+
+private:
+	CAES m_AES;
+
+	u8 m_H[AES_BLOCK_SIZE];		// hash subkey
+	u64 m_HL[16];			// 4-bit multiplication table for scalar GHASH
+	u64 m_HH[16];
+
+	boolean m_bUsePMULL;
+	boolean m_bKeyValid;
+};
+
+#endif
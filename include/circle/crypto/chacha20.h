@@ -0,0 +1,61 @@
+//
+// chacha20.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_chacha20_h
+#define _circle_crypto_chacha20_h
+
+#include <circle/types.h>
+
+#define CHACHA20_KEY_SIZE	32
+#define CHACHA20_NONCE_SIZE	12
+#define CHACHA20_BLOCK_SIZE	64
+
+/// \note Four blocks are calculated in parallel using GCC vector extensions, which are\n
+///	  compiled to NEON instructions on AArch64 and on AArch32 for the Raspberry Pi 2-4.
+
+class CChaCha20		/// ChaCha20 stream cipher (RFC 8439)
+{
+public:
+	CChaCha20 (void);
+	~CChaCha20 (void);
+
+	/// \param pKey Pointer to the key (CHACHA20_KEY_SIZE bytes)
+	void SetKey (const u8 *pKey);
+
+	/// \param pNonce Pointer to the nonce (CHACHA20_NONCE_SIZE bytes)
+	/// \param nCounter Initial block counter
+	void SetNonce (const u8 *pNonce, u32 nCounter = 0);
+
+	/// \brief XOR the key stream to the data, may be called multiple times
+	/// \param pIn Pointer to input data (0 to output the plain key stream)
+	/// \param pOut Pointer to output data (may be the same as pIn)
+	/// \param nLength Data length in bytes
+	void Crypt (const u8 *pIn, u8 *pOut, size_t nLength);
+
+private:
+	void Blocks4 (u8 *pKeyStream);		// generates 4 blocks, increments counter by 4
+
+private:
+	u32 m_State[16];
+
+	u8 m_KeyStream[4*CHACHA20_BLOCK_SIZE];
+	unsigned m_nKeyStreamOffset;		// consumed bytes in m_KeyStream
+};
+
+#endif
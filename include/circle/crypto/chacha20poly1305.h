@@ -0,0 +1,65 @@
+//
+// chacha20poly1305.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_chacha20poly1305_h
+#define _circle_crypto_chacha20poly1305_h
+
+#include <circle/crypto/chacha20.h>
+#include <circle/crypto/poly1305.h>
+#include <circle/types.h>
+
+class CChaCha20Poly1305	/// ChaCha20-Poly1305 authenticated encryption (RFC 8439)
+{
+public:
+	CChaCha20Poly1305 (void);
+	~CChaCha20Poly1305 (void);
+
+	/// \param pKey Pointer to the key (CHACHA20_KEY_SIZE bytes)
+	void SetKey (const u8 *pKey);
+
+	/// \param pNonce Pointer to the nonce (CHACHA20_NONCE_SIZE bytes)
+	/// \param pAAD Pointer to additional authenticated data (may be 0, if nAADLength is 0)
+	/// \param nAADLength Length of additional authenticated data in bytes
+	/// \param pIn Pointer to plaintext
+	/// \param pOut Pointer to buffer, receives the ciphertext (may be the same as pIn)
+	/// \param nLength Length of plaintext in bytes
+	/// \param pTag Pointer to buffer, receives the authentication tag (POLY1305_TAG_SIZE bytes)
+	void Encrypt (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+		      const u8 *pIn, u8 *pOut, size_t nLength, u8 *pTag);
+
+	/// \param pNonce Pointer to the nonce (CHACHA20_NONCE_SIZE bytes)
+	/// \param pAAD Pointer to additional authenticated data (may be 0, if nAADLength is 0)
+	/// \param nAADLength Length of additional authenticated data in bytes
+	/// \param pIn Pointer to ciphertext
+	/// \param pOut Pointer to buffer, receives the plaintext (may be the same as pIn)
+	/// \param nLength Length of ciphertext in bytes
+	/// \param pTag Pointer to the received authentication tag (POLY1305_TAG_SIZE bytes)
+	/// \return Authentication successful? (pOut is not written otherwise)
+	boolean Decrypt (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+			 const u8 *pIn, u8 *pOut, size_t nLength, const u8 *pTag);
+
+private:
+	void CalculateTag (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+			   const u8 *pCipherText, size_t nLength, u8 *pTag);
+
+private:
+	u8 m_Key[CHACHA20_KEY_SIZE];
+};
+
+#endif
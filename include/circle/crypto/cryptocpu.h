@@ -0,0 +1,48 @@
+//
+// cryptocpu.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_cryptocpu_h
+#define _circle_crypto_cryptocpu_h
+
+#include <circle/types.h>
+
+class CCryptoCPU	/// Detects the ARMv8 Crypto Extensions of the CPU
+{
+public:
+	/// \return AESE/AESMC instructions available?
+	static boolean HasAES (void);
+	/// \return 64x64 bit polynomial multiply (PMULL) available?
+	static boolean HasPMULL (void);
+	/// \return SHA1C/SHA1P/SHA1M/SHA1H/SHA1SU0/SHA1SU1 instructions available?
+	static boolean HasSHA1 (void);
+	/// \return SHA256H/SHA256H2/SHA256SU0/SHA256SU1 instructions available?
+	static boolean HasSHA256 (void);
+
+private:
+	static void Detect (void);
+
+private:
+	static boolean s_bDetected;
+	static boolean s_bHasAES;
+	static boolean s_bHasPMULL;
+	static boolean s_bHasSHA1;
+	static boolean s_bHasSHA256;
+};
+
+#endif
@@ -0,0 +1,72 @@
+//
+// cryptorandom.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_cryptorandom_h
+#define _circle_crypto_cryptorandom_h
+
+#include <circle/crypto/chacha20.h>
+#include <circle/bcmrandom.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define CRYPTO_RANDOM_RESEED_INTERVAL	0x100000	// bytes
+#define CRYPTO_RANDOM_RESEED_TIME	300		// seconds
+
+#define CRYPTO_RANDOM_BUFFER_SIZE	(4*CHACHA20_BLOCK_SIZE - CHACHA20_KEY_SIZE)
+
+/// \note The generator is a ChaCha20 based DRBG with fast key erasure. It is seeded from\n
+///	  the hardware random number generator on first use and is reseeded after\n
+///	  CRYPTO_RANDOM_RESEED_INTERVAL bytes of output or CRYPTO_RANDOM_RESEED_TIME seconds.\n
+///	  The hardware generator alone is too slow to deliver the amount of random data\n
+///	  required for cryptographic protocols.
+/// \note The output is generated in blocks of CRYPTO_RANDOM_BUFFER_SIZE bytes, the rest of\n
+///	  the key stream becomes the next key. Small requests (e.g. GetNumber()) are served\n
+///	  from this buffer, returned bytes are erased from it.
+
+class CCryptoRandom	/// Cryptographically secure random number generator
+{
+public:
+	CCryptoRandom (void);
+	~CCryptoRandom (void);
+
+	/// \param pBuffer Pointer to buffer, receives the random bytes
+	/// \param nLength Number of bytes requested
+	void GetBytes (void *pBuffer, size_t nLength);
+
+	/// \return Random number (32-bit)
+	u32 GetNumber (void);
+
+private:
+	void Refill (void);
+	void Reseed (void);
+
+private:
+	CBcmRandomNumberGenerator m_HWRandom;
+	CChaCha20 m_ChaCha20;
+	boolean m_bSeeded;
+	size_t m_nBytesSinceReseed;
+	u64 m_ullLastReseed;
+
+	u8 m_Buffer[CRYPTO_RANDOM_BUFFER_SIZE + CHACHA20_KEY_SIZE];
+	unsigned m_nBufferOffset;		// consumed bytes in m_Buffer
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -0,0 +1,58 @@
+//
+// poly1305.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_poly1305_h
+#define _circle_crypto_poly1305_h
+
+#include <circle/types.h>
+
+#define POLY1305_KEY_SIZE	32
+#define POLY1305_TAG_SIZE	16
+#define POLY1305_BLOCK_SIZE	16
+
+class CPoly1305		/// Poly1305 one-time authenticator (RFC 8439)
+{
+public:
+	/// \param pKey Pointer to the one-time key (POLY1305_KEY_SIZE bytes)
+	CPoly1305 (const u8 *pKey);
+	~CPoly1305 (void);
+
+	/// \param pData Pointer to data to be authenticated
+	/// \param nLength Length of data in bytes
+	void Update (const void *pData, size_t nLength);
+
+	/// \brief Pad the data with zeros up to the next block boundary
+	void Pad (void);
+
+	/// \param pTag Pointer to buffer, receives the tag (POLY1305_TAG_SIZE bytes)
+	void Final (u8 *pTag);
+
+private:
+	void Blocks (const u8 *pData, size_t nLength, u32 nHighBit);
+
+private:
+	u32 m_R[5];		// 26-bit limbs
+	u32 m_H[5];
+	u32 m_Pad[4];
+
+	u8 m_Buffer[POLY1305_BLOCK_SIZE];
+	unsigned m_nBufferLength;
+};
+
+#endif
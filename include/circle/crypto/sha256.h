@@ -0,0 +1,62 @@
+//
+// sha256.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_crypto_sha256_h
+#define _circle_crypto_sha256_h
+
+#include <circle/types.h>
+
+#define SHA256_DIGEST_SIZE	32
+#define SHA256_BLOCK_SIZE	64
+
+class CSHA256		/// SHA-256 hash function (FIPS 180-4)
+{
+public:
+	CSHA256 (void);
+	~CSHA256 (void);
+
+	/// \brief Start a new hash calculation
+	void Reset (void);
+
+	/// \param pData Pointer to data to be hashed
+	/// \param nLength Length of data in bytes
+	void Update (const void *pData, size_t nLength);
+
+	/// \param pDigest Pointer to buffer, receives the digest (SHA256_DIGEST_SIZE bytes)
+	/// \note The object has to be Reset() before it can be used again.
+	void Final (u8 *pDigest);
+
+	/// \brief Calculate the digest of a buffer in one go
+	static void Calculate (const void *pData, size_t nLength, u8 *pDigest);
+
+private:
+	void Transform (const u8 *pData, size_t nBlocks);
+
+	static void TransformScalar (u32 *pState, const u8 *pData, size_t nBlocks);
+
+private:
+	u32 m_State[8];
+	u64 m_nTotalLength;
+	u8 m_Buffer[SHA256_BLOCK_SIZE];
+	unsigned m_nBufferLength;
+
+	boolean m_bUseCE;	// use ARMv8 Crypto Extensions
+};
+
+#endif
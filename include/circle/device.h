@@ -27,6 +27,27 @@ class CDevice;
 
 typedef void TDeviceRemovedHandler (CDevice *pDevice, void *pContext);
 
+/// \param nResult Number of transferred bytes, or < 0 on failure
+/// \param pParam User parameter from TDeviceBlockRequest
+/// \note May be called from interrupt context.
+typedef void TDeviceCompletionRoutine (int nResult, void *pParam);
+
+struct TDeviceBlockRequest	/// Parameter of DEVICE_IOCTL_SUBMIT
+{
+	boolean			  bWrite;
+	void			 *pBuffer;		// should be cache aligned
+	u64			  ullOffset;		// byte offset from start
+	size_t			  nCount;		// number of bytes
+	TDeviceCompletionRoutine *pCompletionRoutine;
+	void			 *pParam;
+};
+
+struct TDeviceBlockRange	/// Parameter of DEVICE_IOCTL_DISCARD
+{
+	u64	ullOffset;		// byte offset from start, block aligned
+	u64	ullCount;		// number of bytes, block aligned
+};
+
 class CDevice		/// Base class for all devices
 {
 public:
@@ -57,6 +78,12 @@ public:
 	/// \return Zero on success, or error code on failure
 	virtual int IOCtl (unsigned long ulCmd, void *pData);
 #define DEVICE_IOCTL_SYNC 0x10001U		// Complete pending write process (flush buffers)
+#define DEVICE_IOCTL_SUBMIT 0x10002U		// Queue TDeviceBlockRequest (block devices only),
+						// the struct can be reused after return
+#define DEVICE_IOCTL_DISCARD 0x10003U		// Data in TDeviceBlockRange is not needed any more
+						// (block devices only)
+#define DEVICE_IOCTL_GET_BLOCK_SIZE 0x10004U	// Returns logical block size in bytes (unsigned),
+						// 512 is assumed, if not supported
 
 	/// \return TRUE on successful device removal
 	virtual boolean RemoveDevice (void);
@@ -2,7 +2,7 @@
 // devicenameservice.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,16 +22,38 @@
 
 #include <circle/device.h>
 #include <circle/spinlock.h>
+#include <circle/ptrlist.h>
 #include <circle/types.h>
 
+#define DEVICE_NAME_HASH_SIZE	64		// must be a power of 2
+
 struct TDeviceInfo
 {
 	TDeviceInfo	*pNext;
+	TDeviceInfo	*pNextHash;
 	char		*pName;
-	CDevice		*pDevice;
+	CDevice		* volatile pDevice;	// 0 if currently not registered
 	boolean		 bBlockDevice;
+	u32		 nHash;
+};
+
+/// \brief Handle of a device name, which stays valid until the device name service is destroyed
+typedef const TDeviceInfo *TDeviceHandle;
+
+enum TDeviceNameEvent
+{
+	DeviceNameAdded,
+	DeviceNameRemoved
 };
 
+/// \param Event	DeviceNameAdded or DeviceNameRemoved
+/// \param pName	Device name string
+/// \param pDevice	Pointer to the device object
+/// \param bBlockDevice TRUE if this is a block device, otherwise character device
+/// \param pContext	Context pointer handed over to RegisterNotificationHandler()
+typedef void TDeviceNameHandler (TDeviceNameEvent Event, const char *pName, CDevice *pDevice,
+				 boolean bBlockDevice, void *pContext);
+
 class CDeviceNameService  /// Devices can be registered by name and retrieved later by this name
 {
 public:
@@ -66,6 +88,19 @@ public:
 	/// \return Pointer to the device object or 0 if not found
 	CDevice *GetDevice (const char *pPrefix, unsigned nIndex, boolean bBlockDevice);
 
+	/// \param pName	Device name string
+	/// \param bBlockDevice TRUE if this is a block device, otherwise character device
+	/// \return Handle of the device name, also if the device is currently not registered
+	/// \note The handle resolves to the device, which is registered by this name at a time.\n
+	///	  Keeping the handle avoids the search by name on repeated lookups.
+	TDeviceHandle GetDeviceHandle (const char *pName, boolean bBlockDevice);
+	/// \param hDevice	Handle returned by GetDeviceHandle()
+	/// \return Pointer to the device object or 0 if currently not registered
+	CDevice *GetDevice (TDeviceHandle hDevice) const
+	{
+		return hDevice != 0 ? hDevice->pDevice : 0;
+	}
+
 	/// \brief Enumerate all devices, or all devices of a specified prefix
 	/// \param callback A callback to be invoked for each matching device
 	/// \param arg A user define pointer that will back passed to the callback
@@ -75,6 +110,17 @@ public:
 		void* arg
 	);
 
+	typedef void *TRegistrationHandle;
+
+	/// \param pHandler Handler gets called, after a device has been added or before it is removed
+	/// \param pContext Context pointer handed over to the handler
+	/// \return Handle to be handed over to UnregisterNotificationHandler()
+	/// \note The handler is called at TASK_LEVEL and must not (un)register handlers itself.
+	TRegistrationHandle RegisterNotificationHandler (TDeviceNameHandler *pHandler,
+							 void *pContext = 0);
+	/// \param hRegistration Handle returned by RegisterNotificationHandler()
+	void UnregisterNotificationHandler (TRegistrationHandle hRegistration);
+
 	/// \brief Generate device listing
 	/// \param pTarget Device to be used for output
 	void ListDevices (CDevice *pTarget);
@@ -82,8 +128,20 @@ public:
 	/// \return The single CDeviceNameService instance of the system
 	static CDeviceNameService *Get (void);
 
+private:
+	TDeviceInfo *Find (const char *pName, boolean bBlockDevice, u32 nHash);
+	TDeviceInfo *Insert (const char *pName, boolean bBlockDevice, u32 nHash);
+
+	void Notify (TDeviceNameEvent Event, const char *pName, CDevice *pDevice,
+		     boolean bBlockDevice);
+
+	static u32 Hash (const char *pName, boolean bBlockDevice);
+
 private:
 	TDeviceInfo *m_pList;
+	TDeviceInfo *m_pHashTable[DEVICE_NAME_HASH_SIZE];
+
+	CPtrList m_HandlerList;
 
 	CSpinLock m_SpinLock;
 
@@ -2,7 +2,7 @@
 // devicetreeblob.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,6 +24,11 @@
 
 struct TDeviceTreeNode;
 struct TDeviceTreeProperty;
+struct TDeviceTreeIndex;
+
+/// \note An index of all nodes and properties is built once on construction, so that the
+///	  lookups do not need to walk the blob. If the index cannot be built, the blob is
+///	  walked for each lookup.
 
 class CDeviceTreeBlob	/// Simple Devicetree blob parser
 {
@@ -38,6 +43,10 @@ public:
 	const TDeviceTreeNode *FindNode (const char *pPath,
 					 const TDeviceTreeNode *pParentNode = 0) const;
 
+	/// \param nPhandle Value of the "phandle" property of the node
+	/// \return Opaque pointer to the node, or 0 if not found
+	const TDeviceTreeNode *FindNodeByPhandle (u32 nPhandle) const;
+
 	/// \param pNode Pointer to the node
 	/// \param pName Name of the property
 	/// \return Opaque pointer to the property, or 0 if not found
@@ -63,8 +72,23 @@ private:
 						 const TDeviceTreeNode *pNode,
 						 const TDeviceTreeNode **ppNextNode) const;
 
+	void BuildIndex (void);
+	boolean FillIndex (TDeviceTreeIndex *pIndex, unsigned *pNodes,
+			   unsigned *pProperties) const;	// counts only, if pIndex == 0
+
+	const TDeviceTreeNode *FindNodeIndexed (const char *pPath,
+						const TDeviceTreeNode *pParentNode) const;
+	const TDeviceTreeProperty *FindPropertyIndexed (const TDeviceTreeNode *pNode,
+							const char *pName) const;
+
+	int GetNodeIndex (const TDeviceTreeNode *pNode) const;	// returns -1 if not found
+
+	const char *GetPropertyName (const TDeviceTreeProperty *pProperty) const;
+
 private:
 	u8 *m_pFTD;
+
+	TDeviceTreeIndex *m_pIndex;
 };
 
 #endif
@@ -71,6 +71,12 @@ public:
 			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
 			     unsigned nBurstLength = 0);
 
+	// fill nBlockCount blocks of nBlockLength size with nPattern and skip nBlockStride
+	// bytes after each block on destination, destination cache is not touched
+	void SetupMemFill2D (void *pDestination, u32 nPattern,
+			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
+			     unsigned nBurstLength = 0);
+
 	void SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam);
 
 	void Start (void);
@@ -94,6 +100,8 @@ private:
 
 	const void *m_pBuffer[MaxCyclicBuffers];
 
+	u32 *m_pFillPattern;
+
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bIRQConnected;
 
@@ -107,6 +107,21 @@ public:
 			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
 			     unsigned nBurstLength = 0);
 
+	/// \brief Prepare a 2D memory fill transfer (fill a number of blocks with optional stride)
+	/// \param pDestination Pointer to the destination buffer
+	/// \param nPattern	32-bit value to be repeated in the blocks
+	/// \param nBlockLength	Length of the blocks to be filled
+	/// \param nBlockCount	Number of blocks to be filled
+	/// \param nBlockStride	Number of bytes to be skipped after each block in destination buffer
+	/// \param nBurstLength Number of words to be transferred at once (0 = single transfer)
+	/// \note The destination cache is not touched.
+	/// \note The pattern must repeat with the alignment of pDestination\n
+	///	  (e.g. a twice repeated 16-bit value for 2-byte aligned destinations).
+	/// \note This method is not supported with DMA_CHANNEL_LITE.
+	void SetupMemFill2D (void *pDestination, u32 nPattern,
+			     size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
+			     unsigned nBurstLength = 0);
+
 	/// \brief Set completion routine to be called, when the transfer is finished
 	/// \param pRoutine Pointer to the completion routine
 	/// \param pParam   User parameter
@@ -143,6 +158,8 @@ private:
 
 	const void *m_pBuffer[MaxCyclicBuffers];
 
+	u32 *m_pFillPattern;			// source of SetupMemFill2D(), allocated on use
+
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bIRQConnected;
 
@@ -0,0 +1,162 @@
+//
+// dmamanager.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dmamanager_h
+#define _circle_dmamanager_h
+
+#include <circle/dmachannel.h>
+#include <circle/interrupt.h>
+#include <circle/machineinfo.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define DMA_MANAGER_MAX_CHANNELS	4
+#define DMA_MANAGER_MAX_JOBS		32
+
+#define DMA_MEMCPY_THRESHOLD		4096	// Memcpy()/Memset() use the CPU below this size
+
+enum TDMAOperation
+{
+	DMAOperationCopy,
+	DMAOperationFill,
+	DMAOperationUnknown
+};
+
+/// \brief Element of a descriptor chain, which is executed as one job
+/// \note Descriptors are owned by the caller and must be valid until the job completes.
+struct TDMADescriptor
+{
+	TDMAOperation	 Operation;
+	void		*pDestination;
+	const void	*pSource;		// for DMAOperationCopy
+	u32		 nPattern;		// for DMAOperationFill (see CDMAChannel::SetupMemFill2D())
+	size_t		 nLength;
+	TDMADescriptor	*pNext;			// next descriptor in chain or 0
+};
+
+/// \brief Job completion routine
+/// \param bStatus TRUE, if all descriptors of the chain have been executed successfully
+/// \param pParam User parameter
+typedef void TDMAJobCompletionRoutine (boolean bStatus, void *pParam);
+
+/// \note Multiplexes queued descriptor chains onto a pool of DMA channels, which are\n
+///	  allocated once from CMachineInfo. Jobs are started in FIFO order on the next free\n
+///	  channel and directly continued on it from the DMA interrupt.
+
+class CDMAManager	/// Shared DMA channel pool with asynchronous memory copy and fill service
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nMaxChannels Number of DMA channels to be used (if available)
+	/// \param nChannelType DMA_CHANNEL_NORMAL or DMA_CHANNEL_EXTENDED (not _LITE)
+	CDMAManager (CInterruptSystem *pInterruptSystem, unsigned nMaxChannels = 2,
+		     unsigned nChannelType = DMA_CHANNEL_NORMAL);
+
+	~CDMAManager (void);
+
+	/// \return Operation successful (at least one channel available)?
+	boolean Initialize (void);
+
+	/// \return Number of DMA channels in the pool
+	unsigned GetChannelCount (void) const	{ return m_nChannels; }
+
+	/// \brief Queue a descriptor chain for execution
+	/// \param pChain First descriptor of the chain
+	/// \param pRoutine Completion routine, called from interrupt context
+	/// \param pParam User parameter for the completion routine
+	/// \return Operation successful (FALSE if too many jobs are queued)?
+	/// \note Can be called from TASK_LEVEL and IRQ_LEVEL.
+	boolean Submit (TDMADescriptor *pChain, TDMAJobCompletionRoutine *pRoutine, void *pParam);
+
+	/// \brief Queue a memory copy
+	/// \param pDescriptor Caller-owned descriptor, which will be initialized
+	/// \note Other parameters as for memcpy() and Submit()
+	boolean MemcpyAsync (TDMADescriptor *pDescriptor, void *pDestination, const void *pSource,
+			     size_t nLength, TDMAJobCompletionRoutine *pRoutine, void *pParam);
+
+	/// \brief Queue a memory fill with a byte value
+	/// \param pDescriptor Caller-owned descriptor, which will be initialized
+	/// \note Other parameters as for memset() and Submit()
+	boolean MemsetAsync (TDMADescriptor *pDescriptor, void *pDestination, int nValue,
+			     size_t nLength, TDMAJobCompletionRoutine *pRoutine, void *pParam);
+
+	/// \brief Copy memory and wait for completion
+	/// \note Uses DMA for the cache-line aligned part of copies >= DMA_MEMCPY_THRESHOLD\n
+	///	  on TASK_LEVEL, the CPU otherwise
+	void *Memcpy (void *pDestination, const void *pSource, size_t nLength);
+
+	/// \brief Fill memory and wait for completion
+	/// \note Uses DMA like Memcpy()
+	void *Memset (void *pDestination, int nValue, size_t nLength);
+
+	/// \return Number of jobs, which are queued or running
+	unsigned GetPendingJobs (void) const	{ return m_nPendingJobs; }
+
+	static CDMAManager *Get (void);
+
+private:
+	struct TJob
+	{
+		TJob			 *pNext;
+		TDMADescriptor		 *pCurrent;
+		size_t			  nOffset;	// into current descriptor
+		size_t			  nSegment;	// length of running transfer
+		TDMAJobCompletionRoutine *pRoutine;
+		void			 *pParam;
+	};
+
+	struct TChannel
+	{
+		CDMAChannel	*pChannel;
+		TJob		*pJob;			// running job or 0
+		CDMAManager	*pThis;
+	};
+
+	void Schedule (void);			// with spin lock acquired
+	void StartSegment (TChannel *pChannel);
+
+	void ChannelCompletion (TChannel *pChannel, boolean bStatus);
+	static void ChannelCompletionStub (unsigned nChannel, unsigned nBuffer,
+					   boolean bStatus, void *pParam);
+
+	static void SyncCompletionRoutine (boolean bStatus, void *pParam);
+
+	// executes the cache-line aligned middle part with DMA and the rest before with the CPU
+	void TransferSync (TDMADescriptor *pDescriptor);
+
+private:
+	CInterruptSystem *m_pInterruptSystem;
+	unsigned m_nMaxChannels;
+	unsigned m_nChannelType;
+
+	TChannel m_Channel[DMA_MANAGER_MAX_CHANNELS];
+	unsigned m_nChannels;
+
+	TJob m_Job[DMA_MANAGER_MAX_JOBS];
+	TJob *m_pFreeJob;
+	TJob *m_pFirstJob;			// queued jobs
+	TJob *m_pLastJob;
+	volatile unsigned m_nPendingJobs;
+
+	CSpinLock m_SpinLock;
+
+	static CDMAManager *s_pThis;
+};
+
+#endif
@@ -0,0 +1,104 @@
+//
+// biquad.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_biquad_h
+#define _circle_dsp_biquad_h
+
+#include <circle/types.h>
+
+struct TBiquadCoefficients	/// y = b0*x + b1*x[-1] + b2*x[-2] - a1*y[-1] - a2*y[-2]
+{
+	float b0, b1, b2;
+	float a1, a2;			// a0 is normalized to 1
+};
+
+enum TBiquadType
+{
+	BiquadLowPass,
+	BiquadHighPass,
+	BiquadBandPass,			///< 0 dB peak gain
+	BiquadNotch,
+	BiquadAllPass,
+	BiquadUnknown
+};
+
+class CBiquadCascade		/// Cascade of second order IIR sections (float)
+{
+public:
+	/// \param nStages Number of cascaded sections
+	CBiquadCascade (unsigned nStages);
+
+	~CBiquadCascade (void);
+
+	/// \param nStage Section to be set (0 .. nStages-1)
+	/// \param rCoeffs Coefficients of this section
+	void SetCoefficients (unsigned nStage, const TBiquadCoefficients &rCoeffs);
+
+	/// \brief Clear the filter state
+	void Reset (void);
+
+	/// \param pIn Input samples
+	/// \param pOut Output samples (may be equal to pIn)
+	/// \param nSamples Number of samples to be processed
+	void Process (const float *pIn, float *pOut, unsigned nSamples);
+
+	/// \brief Calculate coefficients (Audio EQ Cookbook by R. Bristow-Johnson)
+	/// \param pCoeffs Coefficients are returned here
+	/// \param Type Type of the filter
+	/// \param fSampleRate Sample rate in Hz
+	/// \param fFrequency Cut-off or center frequency in Hz
+	/// \param fQ Quality factor (0.7071 for Butterworth low/high pass)
+	static void Design (TBiquadCoefficients *pCoeffs, TBiquadType Type,
+			    float fSampleRate, float fFrequency, float fQ);
+
+private:
+	unsigned m_nStages;
+
+	TBiquadCoefficients *m_pCoeffs;
+	float *m_pState;		// two per stage (transposed direct form II)
+};
+
+class CBiquadCascadeQ31		/// Cascade of second order IIR sections (Q31 samples)
+{
+public:
+	/// \param nStages Number of cascaded sections
+	CBiquadCascadeQ31 (unsigned nStages);
+
+	~CBiquadCascadeQ31 (void);
+
+	/// \param nStage Section to be set (0 .. nStages-1)
+	/// \param rCoeffs Coefficients of this section (each in the range -2.0 .. < 2.0)
+	void SetCoefficients (unsigned nStage, const TBiquadCoefficients &rCoeffs);
+
+	/// \brief Clear the filter state
+	void Reset (void);
+
+	/// \param pIn Input samples
+	/// \param pOut Output samples (may be equal to pIn)
+	/// \param nSamples Number of samples to be processed
+	void Process (const s32 *pIn, s32 *pOut, unsigned nSamples);
+
+private:
+	unsigned m_nStages;
+
+	s32 *m_pCoeffs;			// five per stage in Q30 format
+	s32 *m_pState;			// four per stage (direct form I)
+};
+
+#endif
@@ -0,0 +1,44 @@
+//
+// dspmath.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_dspmath_h
+#define _circle_dsp_dspmath_h
+
+#include <circle/types.h>
+
+#define DSP_PI		3.14159265358979323846
+
+class CDSPMath		/// Elementary functions for the DSP library (no libm available)
+{
+public:
+	/// \return Sine of x (in radians), double precision
+	static double Sin (double x);
+	/// \return Cosine of x (in radians), double precision
+	static double Cos (double x);
+
+	/// \return Square root of x (x >= 0)
+	static double Sqrt (double x);
+
+	/// \return Value converted to Q15 format with saturation
+	static s16 FloatToQ15 (float fValue);
+	/// \return Value converted to Q31 format with saturation
+	static s32 FloatToQ31 (float fValue);
+};
+
+#endif
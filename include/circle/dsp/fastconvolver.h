@@ -0,0 +1,62 @@
+//
+// fastconvolver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_fastconvolver_h
+#define _circle_dsp_fastconvolver_h
+
+#include <circle/dsp/fft.h>
+#include <circle/types.h>
+
+class CFastConvolver	/// FIR filter with long impulse responses (partitioned overlap-save, float)
+{
+public:
+	/// \param pImpulse Impulse response (is transformed and need not be kept)
+	/// \param nLength Length of the impulse response
+	/// \param nBlockSize Samples per call of Process() (power of 2, >= 2),
+	///	      which is also the latency of the convolver
+	CFastConvolver (const float *pImpulse, unsigned nLength, unsigned nBlockSize);
+
+	~CFastConvolver (void);
+
+	/// \return Samples per call of Process()
+	unsigned GetBlockSize (void) const;
+
+	/// \brief Clear the filter state
+	void Reset (void);
+
+	/// \param pIn nBlockSize input samples
+	/// \param pOut nBlockSize output samples (may be equal to pIn)
+	void Process (const float *pIn, float *pOut);
+
+private:
+	unsigned m_nBlockSize;
+	unsigned m_nPartitions;
+	unsigned m_nSpectrumSize;	// floats per spectrum (2 * FFT size)
+
+	CFFT m_FFT;			// 2 * nBlockSize
+
+	float *m_pFilter;		// spectra of the partitions of the impulse response
+	float *m_pDelayLine;		// spectra of the recent input blocks
+	unsigned m_nDelayPos;
+
+	float *m_pInput;		// previous and current input block
+	float *m_pBuffer;		// complex work buffer
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// fft.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_fft_h
+#define _circle_dsp_fft_h
+
+#include <circle/types.h>
+
+class CFFT		/// Complex FFT (Stockham radix-4, float)
+{
+public:
+	/// \param nSize Number of complex points (power of 2, >= 2)
+	CFFT (unsigned nSize);
+
+	~CFFT (void);
+
+	/// \return Number of complex points
+	unsigned GetSize (void) const;
+
+	/// \brief Forward transform in place
+	/// \param pData nSize complex values (real and imaginary part interleaved)
+	void Forward (float *pData);
+
+	/// \brief Inverse transform in place, scaled by 1/nSize
+	/// \param pData nSize complex values (real and imaginary part interleaved)
+	void Inverse (float *pData);
+
+	/// \brief Multiply two spectra and add the result to another one
+	/// \param pResult pResult += pA * pB, nLength complex values
+	static void MultiplyAccumulate (float *pResult, const float *pA, const float *pB,
+					unsigned nLength);
+
+private:
+	void Transform (float *pData);
+
+	void Radix4Stage (unsigned n, unsigned s, const float *x, float *y);
+
+private:
+	unsigned m_nSize;
+
+	float *m_pTwiddle;		// exp(-2*pi*i*k/nSize), k = 0 .. 3*nSize/4-1
+	float *m_pWork;
+};
+
+#endif
@@ -0,0 +1,120 @@
+//
+// fir.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_fir_h
+#define _circle_dsp_fir_h
+
+#include <circle/dsp/windowfunction.h>
+#include <circle/types.h>
+
+class CFIRFilter		/// FIR filter with optional decimation (float)
+{
+public:
+	/// \param pCoeffs Impulse response (is copied)
+	/// \param nTaps Number of coefficients
+	/// \param nDecimation Output only every n-th sample (1 for no decimation)
+	CFIRFilter (const float *pCoeffs, unsigned nTaps, unsigned nDecimation = 1);
+
+	~CFIRFilter (void);
+
+	/// \brief Clear the delay line
+	void Reset (void);
+
+	/// \param pIn Input samples
+	/// \param pOut Output samples (may be equal to pIn)
+	/// \param nSamples Number of input samples
+	/// \return Number of output samples written to pOut
+	unsigned Process (const float *pIn, float *pOut, unsigned nSamples);
+
+	/// \brief Design a low pass filter with unity DC gain (windowed sinc)
+	/// \param pCoeffs Coefficients are returned here
+	/// \param nTaps Number of coefficients
+	/// \param fCutoff Cut-off frequency relative to the sample rate (0.0 .. 0.5)
+	/// \param Window Window type to be applied
+	static void DesignLowPass (float *pCoeffs, unsigned nTaps, float fCutoff,
+				   TWindowType Window = WindowBlackman);
+
+private:
+	unsigned m_nTaps;		// padded to a multiple of 4
+	unsigned m_nDecimation;
+
+	float *m_pCoeffs;
+	float *m_pDelay;		// doubled, to have a contiguous window of samples
+	unsigned m_nPos;
+	unsigned m_nPhase;
+};
+
+class CFIRFilterQ15		/// FIR filter with optional decimation (Q15 samples and coefficients)
+{
+public:
+	/// \param pCoeffs Impulse response (is converted to Q15)
+	/// \param nTaps Number of coefficients
+	/// \param nDecimation Output only every n-th sample (1 for no decimation)
+	CFIRFilterQ15 (const float *pCoeffs, unsigned nTaps, unsigned nDecimation = 1);
+
+	~CFIRFilterQ15 (void);
+
+	/// \brief Clear the delay line
+	void Reset (void);
+
+	/// \param pIn Input samples
+	/// \param pOut Output samples (may be equal to pIn)
+	/// \param nSamples Number of input samples
+	/// \return Number of output samples written to pOut
+	unsigned Process (const s16 *pIn, s16 *pOut, unsigned nSamples);
+
+private:
+	unsigned m_nTaps;
+	unsigned m_nDecimation;
+
+	s16 *m_pCoeffs;
+	s16 *m_pDelay;			// doubled
+	unsigned m_nPos;
+	unsigned m_nPhase;
+};
+
+class CFIRInterpolator		/// Polyphase FIR interpolator (float)
+{
+public:
+	/// \param pCoeffs Impulse response of the anti-imaging filter at the output rate
+	/// \param nTaps Number of coefficients
+	/// \param nFactor Interpolation factor
+	/// \note The filter should have a DC gain of nFactor to keep the signal level.
+	CFIRInterpolator (const float *pCoeffs, unsigned nTaps, unsigned nFactor);
+
+	~CFIRInterpolator (void);
+
+	/// \brief Clear the delay line
+	void Reset (void);
+
+	/// \param pIn Input samples
+	/// \param pOut Output samples (nSamples * nFactor, must not overlap pIn)
+	/// \param nSamples Number of input samples
+	void Process (const float *pIn, float *pOut, unsigned nSamples);
+
+private:
+	unsigned m_nFactor;
+	unsigned m_nPhaseTaps;		// per phase, padded to a multiple of 4
+
+	float *m_pCoeffs;		// m_nFactor sub-filters
+	float *m_pDelay;		// doubled
+	unsigned m_nPos;
+};
+
+#endif
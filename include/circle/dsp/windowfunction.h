@@ -0,0 +1,50 @@
+//
+// windowfunction.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_dsp_windowfunction_h
+#define _circle_dsp_windowfunction_h
+
+#include <circle/types.h>
+
+enum TWindowType
+{
+	WindowRectangular,
+	WindowHann,
+	WindowHamming,
+	WindowBlackman,
+	WindowBlackmanHarris,		///< 4-term, -92 dB side lobes
+	WindowFlatTop,			///< for amplitude measurements
+	WindowUnknown
+};
+
+class CWindowFunction		/// Generates window functions for FIR design and spectral analysis
+{
+public:
+	/// \param Type Type of the window
+	/// \param pWindow Buffer, which receives the window values
+	/// \param nLength Number of values to be generated
+	/// \param bPeriodic TRUE for spectral analysis (DFT-even), FALSE for filter design
+	static void Generate (TWindowType Type, float *pWindow, unsigned nLength,
+			      boolean bPeriodic = TRUE);
+
+	/// \brief Multiply samples with a window
+	static void Apply (const float *pWindow, float *pData, unsigned nLength);
+};
+
+#endif
@@ -149,6 +149,16 @@ extern TFIQData FIQData;
 
 extern uintptr IRQReturnAddress;		// for profiling
 
+struct TIRQContext			// interrupted context of a core, for profiling
+{
+	uintptr	nPC;
+	uintptr	nFP;			// frame pointer (x29 or r11)
+	uintptr	nLR;			// AArch64 only
+	uintptr	nSP;			// AArch64 only
+};
+
+extern TIRQContext IRQContext[];	// indexed by core number
+
 #ifdef __cplusplus
 }
 #endif
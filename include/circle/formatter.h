@@ -0,0 +1,113 @@
+//
+// formatter.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_formatter_h
+#define _circle_formatter_h
+
+#include <circle/stdarg.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define FORMAT_MAX_PRECISION	19		// of %f
+
+class CFormatter	/// printf(3)-style formatting into a caller-supplied buffer without heap use
+{
+public:
+	/// \param pBuffer Destination buffer, always \0-terminated, if nSize > 0
+	/// \param nSize Size of the destination buffer in bytes
+	/// \param pFormat Format string (see note)
+	/// \return Length of the complete output without \0 (truncated, if >= nSize)
+	/// \note Supported: %c %d %i %u %o %x %X %p %s %f %%, flags # - 0, width and precision\n
+	///	  (also given by *), length modifiers l, ll and z
+	static size_t Format (char *pBuffer, size_t nSize, const char *pFormat, ...) PRINTF_FORMAT (3, 4);
+
+	/// \param pBuffer Destination buffer, always \0-terminated, if nSize > 0
+	/// \param nSize Size of the destination buffer in bytes
+	/// \param pFormat Format string
+	/// \param Args Argument list
+	/// \return Length of the complete output without \0 (truncated, if >= nSize)
+	static size_t FormatV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args);
+
+	/// \param pDest Destination buffer (at least 23 bytes)
+	/// \param ullNumber Number to be converted
+	/// \param nBase 8, 10 or 16
+	/// \param bUpcase Use upper case hex digits?
+	/// \return Number of characters written (without the terminating \0)
+	static unsigned FormatUnsigned (char *pDest, u64 ullNumber, unsigned nBase = 10,
+					boolean bUpcase = FALSE);
+
+	/// \param pDest Destination buffer (at least 22+FORMAT_MAX_PRECISION bytes)
+	/// \param fNumber Number to be converted, correctly rounded to nPrecision digits
+	/// \param nPrecision Number of digits after the decimal point
+	/// \return Number of characters written (without the terminating \0)
+	static unsigned FormatFloat (char *pDest, double fNumber, unsigned nPrecision = 6);
+
+private:
+	struct TOutput
+	{
+		char	*pOut;
+		char	*pEnd;		// last usable position (reserved for \0)
+		size_t	 nLength;	// of complete output
+	};
+
+	static void PutChar (TOutput *pOutput, char chChar, size_t nCount = 1);
+	static void PutString (TOutput *pOutput, const char *pString, size_t nLength);
+};
+
+/// \brief Stack buffer of fixed size, which is formatted with compile-time checked arguments
+template <size_t BufferSize>
+class CFormatBuffer
+{
+public:
+	CFormatBuffer (void)
+	:	m_nLength (0)
+	{
+		m_Buffer[0] = '\0';
+	}
+
+	/// \return Length of the complete output without \0 (truncated, if >= BufferSize)
+	size_t Format (const char *pFormat, ...) PRINTF_FORMAT (2, 3)
+	{
+		va_list var;
+		va_start (var, pFormat);
+
+		m_nLength = CFormatter::FormatV (m_Buffer, BufferSize, pFormat, var);
+
+		va_end (var);
+
+		return m_nLength;
+	}
+
+	operator const char *(void) const	{ return m_Buffer; }
+
+	/// \return Length of the string in the buffer
+	size_t GetLength (void) const
+	{
+		return m_nLength < BufferSize ? m_nLength : BufferSize-1;
+	}
+
+	/// \return Has the last output been truncated?
+	boolean IsTruncated (void) const	{ return m_nLength >= BufferSize; }
+
+private:
+	char	m_Buffer[BufferSize];
+	size_t	m_nLength;
+};
+
+#endif
@@ -0,0 +1,160 @@
+//
+// blockrequestqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_fs_blockrequestqueue_h
+#define _circle_fs_blockrequestqueue_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/device.h>
+#include <circle/types.h>
+
+#define BLOCK_QUEUE_DEPTH		32	// max. number of queued requests
+#define BLOCK_QUEUE_MAX_MERGE		128	// max. sectors of a merged transfer
+#define BLOCK_QUEUE_READ_DEADLINE	500	// milliseconds
+#define BLOCK_QUEUE_WRITE_DEADLINE	5000	// milliseconds
+#define BLOCK_QUEUE_MAX_ACTIVE		8	// max. transfers submitted to the device
+
+/// \param nResult Number of transferred bytes, or < 0 on failure
+/// \param pParam User parameter, given to Submit*()
+/// \note Is called from the queue task and must not block.
+typedef void TBlockRequestCompletionHandler (int nResult, void *pParam);
+
+class CBlockRequestQueue : public CTask	/// Asynchronous request queue for a block device
+{
+public:
+	/// \param pDevice Block device (e.g. "emmc1", "umsd1-1"), with a sector size of 512 bytes
+	/// \note The device must not be accessed directly, while the queue is in use.
+	/// \note Transfers are queued to the device with DEVICE_IOCTL_SUBMIT, if it supports it.
+	CBlockRequestQueue (CDevice *pDevice);
+	~CBlockRequestQueue (void);
+
+	void Run (void);
+
+	/// \brief Queue a read request
+	/// \param pBuffer Buffer, where read data will be placed
+	/// \param ullSector First sector to be read
+	/// \param nSectors Number of sectors to be read
+	/// \param pHandler Will be called, when the request has been completed
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return FALSE, if the queue is full (retry after a completion)
+	/// \note The buffer must not be accessed, before the request has been completed.
+	boolean SubmitRead (void *pBuffer, u64 ullSector, unsigned nSectors,
+			    TBlockRequestCompletionHandler *pHandler, void *pParam = 0);
+
+	/// \brief Queue a write request
+	/// \param pBuffer Buffer, from which data will be fetched for write
+	/// \param ullSector First sector to be written
+	/// \param nSectors Number of sectors to be written
+	/// \param pHandler Will be called, when the request has been completed
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return FALSE, if the queue is full (retry after a completion)
+	/// \note The buffer must not be modified, before the request has been completed.
+	boolean SubmitWrite (const void *pBuffer, u64 ullSector, unsigned nSectors,
+			     TBlockRequestCompletionHandler *pHandler, void *pParam = 0);
+
+	/// \brief Read synchronously, ordered with the queued requests
+	/// \return Number of read bytes or < 0 on failure
+	int Read (void *pBuffer, u64 ullSector, unsigned nSectors);
+	/// \brief Write synchronously, ordered with the queued requests
+	/// \return Number of written bytes or < 0 on failure
+	int Write (const void *pBuffer, u64 ullSector, unsigned nSectors);
+
+	/// \brief Wait for the completion of all queued requests and sync the device
+	void Flush (void);
+
+	/// \return Number of requests, which have not been completed yet
+	unsigned GetPending (void) const;
+
+	/// \return Number of requests, which have been merged into a preceding one
+	unsigned GetMerged (void) const;
+
+private:
+	struct TRequest
+	{
+		boolean bWrite;
+		u8 *pBuffer;
+		u64 ullSector;
+		unsigned nSectors;
+		TBlockRequestCompletionHandler *pHandler;
+		void *pParam;
+		unsigned nDeadline;		// in clock ticks
+		unsigned nSequence;		// order of submission
+		TRequest *pNext;		// queue is sorted by sector
+	};
+
+	boolean Submit (boolean bWrite, void *pBuffer, u64 ullSector, unsigned nSectors,
+			TBlockRequestCompletionHandler *pHandler, void *pParam);
+
+	struct TDispatch			// transfer of merged requests
+	{
+		CBlockRequestQueue *pThis;
+		TRequest *pChain;		// requests in ascending sector order
+		u8 *pBuffer;
+		size_t nBytes;
+		boolean bMergeBuffer;		// m_pMergeBuffer is used
+		boolean bQueued;		// submitted to the device with DEVICE_IOCTL_SUBMIT
+		boolean bActive;
+		volatile boolean bDone;
+		volatile int nResult;
+	};
+
+	TRequest *SelectRequest (void);		// deadline first, elevator otherwise
+	boolean IsBlocked (const TRequest *pRequest) const;	// by an older or active request
+
+	TDispatch *GetIdleDispatch (void);
+	void Dispatch (TRequest *pFirst, TDispatch *pDispatch);	// merges adjacent requests
+	void Complete (TDispatch *pDispatch);
+	int TransferSync (TDispatch *pDispatch);
+
+	void Unlink (TRequest *pRequest);
+
+	static void DeviceCompletionRoutine (int nResult, void *pParam);
+
+	struct TSyncRequest
+	{
+		CSynchronizationEvent Event;
+		int nResult;
+	};
+
+	static void SyncCompletionHandler (int nResult, void *pParam);
+
+private:
+	CDevice *m_pDevice;
+
+	TRequest m_Request[BLOCK_QUEUE_DEPTH];
+	TRequest *m_pFree;
+	TRequest *m_pQueue;
+
+	unsigned m_nPending;
+	unsigned m_nSequence;
+	unsigned m_nMerged;
+
+	u64 m_ullHeadSector;			// elevator position (end of last transfer)
+
+	u8 *m_pMergeBuffer;
+	boolean m_bMergeBufferBusy;
+
+	TDispatch m_Dispatch[BLOCK_QUEUE_MAX_ACTIVE];
+
+	CSynchronizationEvent m_Event;		// requests are queued or transfers completed
+	CSynchronizationEvent m_IdleEvent;	// all requests have been completed
+};
+
+#endif
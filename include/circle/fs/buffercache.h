@@ -0,0 +1,188 @@
+//
+// buffercache.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_fs_buffercache_h
+#define _circle_fs_buffercache_h
+
+#include <circle/device.h>
+#include <circle/genericlock.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/task.h>
+#endif
+
+#define BUFFER_CACHE_BLOCK_SIZE		4096
+#define BUFFER_CACHE_BLOCK_SHIFT	12
+#define BUFFER_CACHE_BLOCK_MASK		(BUFFER_CACHE_BLOCK_SIZE-1)
+
+#define BUFFER_CACHE_BLOCKS		1024	// default, 4 MByte
+#define BUFFER_CACHE_MAX_DEVICES	8	// devices, which are cached at once
+#define BUFFER_CACHE_MAX_READ_AHEAD	32	// blocks, read at once on sequential misses
+#define BUFFER_CACHE_WRITEBACK_DELAY	5	// seconds, dirty blocks are written after
+#define BUFFER_CACHE_FLUSH_INTERVAL	1000	// milliseconds, check for expired blocks
+#define BUFFER_CACHE_BYPASS_SIZE	0x40000	// bytes, larger aligned transfers go to the device
+
+class CBufferCache;
+
+#ifdef NO_BUSY_WAIT
+
+class CBufferCacheFlusher : public CTask	/// Writes expired dirty blocks periodically
+{
+public:
+	CBufferCacheFlusher (CBufferCache *pCache);
+
+	void Run (void);
+
+	void Stop (void);		// waits for termination, the task deletes itself
+
+private:
+	CBufferCache *m_pCache;
+	volatile boolean m_bStop;
+};
+
+#endif
+
+class CBufferCache	/// Global block cache, shared by all block devices
+{
+public:
+	/// \param nBlocks Size of the cache in blocks of BUFFER_CACHE_BLOCK_SIZE
+	/// \note Only one instance is allowed. Once it has been initialized, CPartition and
+	///	  the FatFs glue access block devices through it.
+	/// \note Other direct accesses to a cached block device (including
+	///	  DEVICE_IOCTL_SUBMIT and CBlockRequestQueue) bypass the cache.
+	CBufferCache (unsigned nBlocks = BUFFER_CACHE_BLOCKS);
+	/// \note Writes all dirty blocks
+	~CBufferCache (void);
+
+	boolean Initialize (void);
+
+	/// \param pDevice Block device (not a partition, partitions are mapped to their device)
+	/// \param ullOffset Byte offset on the device, a multiple of the device block size
+	/// \param pBuffer Buffer, where read data will be placed
+	/// \param nCount Number of bytes to be read, a multiple of the device block size
+	/// \return Number of read bytes or < 0 on failure
+	int Read (CDevice *pDevice, u64 ullOffset, void *pBuffer, size_t nCount);
+
+	/// \param pDevice Block device (not a partition, partitions are mapped to their device)
+	/// \param ullOffset Byte offset on the device, a multiple of the device block size
+	/// \param pBuffer Buffer, from which data will be fetched for write
+	/// \param nCount Number of bytes to be written, a multiple of the device block size
+	/// \return Number of written bytes or < 0 on failure
+	/// \note The data is written to the device later, use Flush() to write it now.
+	int Write (CDevice *pDevice, u64 ullOffset, const void *pBuffer, size_t nCount);
+
+	/// \brief Write all dirty blocks of a device
+	/// \param pDevice Block device, or 0 for all devices
+	/// \return Operation successful?
+	boolean Flush (CDevice *pDevice = 0);
+
+	/// \brief Drop the cached blocks, which are completely inside a range
+	/// \param pDevice Block device
+	/// \param ullOffset Byte offset of the range on the device
+	/// \param ullCount Size of the range in bytes
+	/// \note Used, when the data is not needed any more (e.g. DEVICE_IOCTL_DISCARD).
+	void Discard (CDevice *pDevice, u64 ullOffset, u64 ullCount);
+
+	/// \brief Write dirty blocks, which are older than BUFFER_CACHE_WRITEBACK_DELAY
+	void FlushExpired (void);
+
+	/// \return Number of block requests, which have been satisfied from the cache
+	u64 GetHits (void) const;
+	/// \return Number of block requests, which needed a device read
+	u64 GetMisses (void) const;
+
+	/// \return Pointer to the only instance, 0 if it has not been initialized
+	static CBufferCache *Get (void);
+
+private:
+	struct TDevice
+	{
+		CDevice *pDevice;
+		u64 ullBlocks;			// number of complete cache blocks on the device
+		u64 ullNextBlock;		// expected next block on sequential reads
+		unsigned nReadAhead;		// current read-ahead window in blocks
+		CDevice::TRegistrationHandle hRemoved;
+	};
+
+	struct TBlock
+	{
+		TDevice *pDevice;		// 0 if unused
+		u64 ullBlock;
+		TBlock *pHashNext;
+		boolean bDirty;
+		boolean bReferenced;		// for CLOCK eviction
+		boolean bBusy;			// must not be evicted now
+		unsigned nDirtyTicks;		// time of the first modification
+		u8 *pData;
+	};
+
+	TDevice *GetDevice (CDevice *pDevice, boolean bCreate);
+	static void DeviceRemovedHandler (CDevice *pDevice, void *pContext);
+
+	TBlock *GetBlock (TDevice *pDevice, u64 ullBlock, boolean bRead);
+	unsigned GetReadAhead (TDevice *pDevice, u64 ullBlock);
+	TBlock *AllocateBlock (void);		// CLOCK replacement
+	void ReleaseBlock (TBlock *pBlock);
+
+	TBlock *Lookup (TDevice *pDevice, u64 ullBlock) const;
+	void HashInsert (TBlock *pBlock);
+	void HashRemove (TBlock *pBlock);
+	unsigned Hash (TDevice *pDevice, u64 ullBlock) const;
+
+	boolean WriteBack (TDevice *pDevice, boolean bExpiredOnly);	// pDevice = 0 for all
+	boolean WriteBackRange (TDevice *pDevice, u64 ullBlock, u64 ullBlocks);
+	boolean WriteRun (TBlock *pBlock);	// writes adjacent dirty blocks too
+	void DropRange (TDevice *pDevice, u64 ullBlock, u64 ullBlocks);
+
+	int Transfer (TDevice *pDevice, boolean bWrite, u64 ullOffset, void *pBuffer,
+		      size_t nCount);
+
+	void CheckFlush (void);
+
+private:
+	unsigned m_nBlocks;
+	TBlock *m_pBlocks;
+	u8 *m_pData;
+	unsigned m_nClockHand;
+
+	TBlock **m_ppHashTable;
+	unsigned m_nHashMask;
+
+	TDevice m_Device[BUFFER_CACHE_MAX_DEVICES];
+
+	u8 *m_pReadBuffer;			// for read-ahead
+	u8 *m_pWriteBuffer;			// for writing runs of dirty blocks
+
+	u64 m_nHits;
+	u64 m_nMisses;
+
+#ifdef NO_BUSY_WAIT
+	CBufferCacheFlusher *m_pFlusher;
+#else
+	unsigned m_nLastFlushTicks;
+#endif
+
+	CGenericLock m_Lock;
+
+	static CBufferCache *s_pThis;
+};
+
+#endif
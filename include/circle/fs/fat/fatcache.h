@@ -2,7 +2,7 @@
 // fatcache.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,15 +24,23 @@
 #include <circle/device.h>
 #include <circle/genericlock.h>
 #include <circle/synchronize.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/task.h>
+#endif
 
 struct TFATBuffer
 {
 	unsigned	 nMagic;
 	TFATBuffer	*pNext;
 	TFATBuffer	*pPrev;
+	TFATBuffer	*pHashNext;
 	unsigned	 nSector;
 	unsigned	 nUseCount;
 	int		 bDirty;
+	unsigned	 nDirtyTicks;		/* time of the first modification */
 
 	DMA_BUFFER (unsigned char, Data, FAT_SECTOR_SIZE);
 };
@@ -43,6 +51,26 @@ struct TFATBufferList
 	TFATBuffer *pLast;
 };
 
+class CFATCache;
+
+#ifdef NO_BUSY_WAIT
+
+class CFATCacheFlusher : public CTask	/* writes expired dirty buffers periodically */
+{
+public:
+	CFATCacheFlusher (CFATCache *pCache);
+
+	void Run (void);
+
+	void Stop (void);		/* waits for termination, the task deletes itself */
+
+private:
+	CFATCache *m_pCache;
+	volatile boolean m_bStop;
+};
+
+#endif
+
 class CFATCache
 {
 public:
@@ -53,9 +81,10 @@ public:
 	 * Open buffer cache
 	 *
 	 * Params:  pPartition		Partition to be used
+	 *	    nBuffers		Number of sector buffers
 	 * Returns: Nonzero on success
 	 */
-	int Open (CDevice *pPartition);
+	int Open (CDevice *pPartition, unsigned nBuffers = FAT_BUFFERS);
 	
 	/*
 	 * Close buffer cache
@@ -65,6 +94,14 @@ public:
 	 */
 	void Close (void);
 	
+	/*
+	 * Set number of sectors read at once on a miss
+	 *
+	 * Params:  nSectors	Usually the cluster size (limited to FAT_MAX_READ_AHEAD)
+	 * Returns: none
+	 */
+	void SetReadAhead (unsigned nSectors);
+
 	/*
 	 * Flush buffer cache
 	 *
@@ -73,6 +110,14 @@ public:
 	 */
 	void Flush (void);
 	
+	/*
+	 * Write dirty buffers, which are unused and older than FAT_WRITEBACK_DELAY
+	 *
+	 * Params:  none
+	 * Returns: none
+	 */
+	void FlushExpired (void);
+
 	/*
 	 * Get sector from buffer cache
 	 *
@@ -100,7 +145,37 @@ public:
 	 */
 	void MarkDirty (TFATBuffer *pBuffer);
 
+	/*
+	 * Read consecutive sectors from disk, bypassing the cache
+	 *
+	 * Params:  nSector	First sector number
+	 *	    nCount	Number of sectors
+	 *	    pBuffer	Destination buffer
+	 * Returns: Nonzero on success
+	 */
+	int ReadDirect (unsigned nSector, unsigned nCount, void *pBuffer);
+
+	/*
+	 * Write consecutive sectors to disk, bypassing the cache
+	 *
+	 * Params:  nSector	First sector number
+	 *	    nCount	Number of sectors
+	 *	    pBuffer	Source buffer
+	 * Returns: Nonzero on success
+	 */
+	int WriteDirect (unsigned nSector, unsigned nCount, const void *pBuffer);
+
 private:
+	TFATBuffer *Lookup (unsigned nSector) const;
+	void HashInsert (TFATBuffer *pBuffer);
+	void HashRemove (TFATBuffer *pBuffer);
+
+	TFATBuffer *AllocateBuffer (int bWriteBack);	/* an unused buffer from LRU end */
+	unsigned ReadBuffers (TFATBuffer *pBuffer);	/* returns number of sectors read */
+
+	void WriteBack (int bExpiredOnly);
+	int WriteRun (TFATBuffer *pFirst, int bExpiredOnly);
+
 	void MoveBufferFirst (TFATBuffer *pBuffer);
 	void MoveBufferLast (TFATBuffer *pBuffer);
 
@@ -108,8 +183,24 @@ private:
 
 private:
 	CDevice		*m_pPartition;
+	unsigned	 m_nSectors;		/* partition size */
+
+	TFATBuffer	*m_pBuffers;
+	unsigned	 m_nBuffers;
 	TFATBufferList	 m_BufferList;
 
+	TFATBuffer	**m_ppHashTable;
+	unsigned	 m_nHashMask;
+
+	unsigned	 m_nReadAhead;
+	unsigned char	*m_pTransferBuffer;	/* for multi-sector reads and writes */
+
+#ifdef NO_BUSY_WAIT
+	CFATCacheFlusher *m_pFlusher;
+#else
+	unsigned	 m_nLastFlushTicks;
+#endif
+
 	CGenericLock m_BufferListLock;
 	CGenericLock m_DiskLock;
 };
@@ -54,9 +54,10 @@ public:
 	 * Mount file system
 	 * 
 	 * Params:  pPartition		Partition to be used
+	 *	    nCacheBuffers	Number of sector buffers in the cache
 	 * Returns: Nonzero on success
 	 */
-	int Mount (CDevice *pPartition);
+	int Mount (CDevice *pPartition, unsigned nCacheBuffers = FAT_BUFFERS);
 	
 	/*
 	 * UnMount file system
@@ -154,6 +155,11 @@ public:
 	*/
 	int FileDelete (const char *pTitle);
 
+private:
+	// transfer whole sectors at the file offset, using contiguous cluster runs
+	boolean ReadSectors (TFile *pFile, void *pBuffer, unsigned nSectors);
+	boolean WriteSectors (TFile *pFile, const void *pBuffer, unsigned nSectors);
+
 private:
 	CFATCache	m_Cache;
 	CFATInfo	m_FATInfo;
@@ -9,7 +9,13 @@
 
 #define FAT_SECTOR_SIZE		512
 
-#define FAT_BUFFERS		100
+#define FAT_BUFFERS		100		// default, can be set on mount
+#define FAT_READ_AHEAD		8		// min. sectors read on a cache miss
+#define FAT_MAX_READ_AHEAD	128		// max. sectors read on a cache miss
+#define FAT_WRITEBACK_DELAY	5		// seconds, dirty buffers are written after
+#define FAT_FLUSH_INTERVAL	1000		// milliseconds, check for expired buffers
+#define FAT_DIRECT_THRESHOLD	4		// sectors, larger aligned file I/O bypasses the cache
+#define FAT_DIRECT_MAX_RUN	0x10000		// max. sectors per direct device transfer
 #define FAT_FILES		40
 
 #define FAT_MAX_FILESIZE	0xFFFFFFFF
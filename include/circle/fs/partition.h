@@ -35,6 +35,11 @@ public:
 
 	u64 Seek (u64 ullOffset);
 
+	int IOCtl (unsigned long ulCmd, void *pData);
+
+private:
+	u64 GetDeviceOffset (void) const;
+
 private:
 	CDevice *m_pDevice;
 	unsigned m_nFirstSector;
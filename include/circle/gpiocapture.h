@@ -0,0 +1,144 @@
+//
+// gpiocapture.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiocapture_h
+#define _circle_gpiocapture_h
+
+#include <circle/dmachannel.h>
+#include <circle/gpioclock.h>
+#include <circle/types.h>
+
+/// \brief Called by CGPIOCapture::ExportVCD() to output the next part of the file
+/// \param pData Pointer to the data
+/// \param nLength Length of the data in bytes
+/// \param pParam User parameter
+/// \return Operation successful?
+typedef boolean TGPIOCaptureWriter (const void *pData, size_t nLength, void *pParam);
+
+/// \class CGPIOCapture
+/// \brief DMA-paced sampling of the GPIO pins 0-31 (logic analyzer)
+///
+/// \details Each sample is read from the GPLEV0 register by the DMA controller into a\n
+/// ring buffer, the sample rate is paced by the DREQ of the PWM device, which consumes\n
+/// one FIFO word per sample period. Without trigger the capture stops, when the buffer\n
+/// is full. With a trigger condition the buffer is written cyclically, until the\n
+/// trigger has been detected by Update() and the post-trigger samples have been taken.
+///
+/// \note Two DMA control blocks (64 bytes) are needed per sample.
+/// \note The maximum sample rate is limited by the control block overhead of the DMA.
+/// \note The PWM device cannot be used otherwise at the same time (e.g. for sound).
+/// \note Not supported on the Raspberry Pi 5.
+
+class CGPIOCapture
+{
+public:
+	/// \param nMaxSamples Size of the ring buffer in samples
+	/// \param nSampleRateHZ Sample rate in Hz
+	CGPIOCapture (unsigned nMaxSamples, unsigned nSampleRateHZ = 1000000);
+
+	~CGPIOCapture (void);
+
+	/// \brief Sets a trigger condition for the next Start()
+	/// \param nMask Pins to be checked (bit n = GPIO n)
+	/// \param nValue Levels of the pins in nMask, which fulfill the condition
+	/// \param bEdge Trigger only, if the condition was not fulfilled before
+	/// \param nPostTriggerSamples Number of samples to take after the trigger
+	void SetTrigger (u32 nMask, u32 nValue, boolean bEdge, unsigned nPostTriggerSamples);
+	/// \brief Removes the trigger condition
+	void ClearTrigger (void);
+
+	/// \brief Starts the capture
+	/// \return Operation successful?
+	boolean Start (void);
+
+	/// \brief Checks the new samples for the trigger condition
+	/// \return Is the capture complete?
+	/// \note Must be called repeatedly with a trigger condition, at least once per buffer cycle.
+	boolean Update (void);
+
+	/// \brief Stops the capture immediately
+	void Stop (void);
+
+	/// \return Has the trigger condition been detected?
+	boolean IsTriggered (void) const;
+
+	/// \return Number of valid samples after completion
+	unsigned GetSampleCount (void) const;
+	/// \param nIndex Index of the sample (0 is the oldest)
+	/// \return Levels of the GPIO pins 0-31
+	u32 GetSample (unsigned nIndex) const;
+	/// \return Index of the trigger sample (if triggered)
+	unsigned GetTriggerIndex (void) const;
+
+	/// \return Sample rate in Hz
+	unsigned GetSampleRate (void) const;
+
+	/// \brief Writes the captured samples as Value Change Dump (VCD) file
+	/// \param pWriter Routine, which outputs the file (e.g. to a network socket)
+	/// \param pParam User parameter handed over to pWriter
+	/// \param nPinMask Pins to be included in the file (bit n = GPIO n)
+	/// \return Operation successful?
+	/// \note The VCD format can be imported into sigrok (PulseView) and other tools.
+	boolean ExportVCD (TGPIOCaptureWriter *pWriter, void *pParam, u32 nPinMask) const;
+
+private:
+	void Compile (boolean bCyclic);
+
+	unsigned GetDMAPosition (void) const;	// index of the sample being taken
+	void Finish (unsigned nLastSample);
+
+	void RunPWM (void);
+	void StopPWM (void);
+
+	void ResetDMA (void);
+
+	boolean IsRunning (void) const;
+
+private:
+	unsigned m_nMaxSamples;
+	unsigned m_nSampleRate;
+
+	CGPIOClock m_Clock;
+	unsigned m_nDMAChannel;
+
+	u32 *m_pBuffer;				// ring buffer, written by DMA
+
+	u8 *m_pControlBlockBuffer;
+	TDMAControlBlock *m_pControlBlock;	// two per sample
+	u32 *m_pDelaySource;			// dummy word written to the PWM FIFO
+
+	boolean m_bTriggerEnabled;
+	u32 m_nTriggerMask;
+	u32 m_nTriggerValue;
+	boolean m_bTriggerEdge;
+	unsigned m_nPostTriggerSamples;
+
+	boolean m_bActive;
+	boolean m_bTriggered;
+	boolean m_bPrevMatch;
+	unsigned m_nScanPos;			// next sample to be checked
+	u64 m_ullScanned;			// total number of checked samples
+	unsigned m_nTriggerPos;			// in ring buffer
+	unsigned m_nStopPos;			// last sample to be taken
+
+	unsigned m_nFirstSample;		// in ring buffer, after completion
+	unsigned m_nSampleCount;
+};
+
+#endif
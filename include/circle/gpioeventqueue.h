@@ -0,0 +1,100 @@
+//
+// gpioeventqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpioeventqueue_h
+#define _circle_gpioeventqueue_h
+
+#include <circle/gpiopin.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define GPIO_EVENT_QUEUE_SIZE	1024		// default, must be a power of 2
+
+struct TGPIOEvent
+{
+	u64	ullTimestamp;		// CTimer::GetClockTicks64() at interrupt time
+	u8	uchPin;			// physical (Broadcom) pin number
+	u8	uchLevel;		// LOW or HIGH, read in the interrupt handler
+};
+
+/// \class CGPIOEventQueue
+/// \brief Shared ring buffer of timestamped GPIO events from multiple pins
+///
+/// \details The GPIO interrupt handler of each added pin only records the pin number,\n
+/// the current level and the time stamp of the event. The events are fetched by the\n
+/// application in batches from TASK_LEVEL with Read(). If the queue is full, new events\n
+/// are dropped and counted.
+
+class CGPIOEventQueue
+{
+public:
+	/// \param nSize Maximum number of queued events (must be a power of 2)
+	CGPIOEventQueue (unsigned nSize = GPIO_EVENT_QUEUE_SIZE);
+
+	~CGPIOEventQueue (void);
+
+	/// \brief Connects the interrupt of a pin to the queue and enables it
+	/// \param pPin Pin to be monitored, must be an input
+	/// \param Interrupt Interrupt trigger type
+	/// \param Interrupt2 Optional second trigger type (e.g. for both edges)
+	/// \return Operation successful?
+	boolean AddPin (CGPIOPin *pPin, TGPIOInterrupt Interrupt,
+			TGPIOInterrupt Interrupt2 = GPIOInterruptUnknown);
+	/// \brief Disables and disconnects the interrupt of a pin
+	/// \param pPin Pin, which has been added before
+	void RemovePin (CGPIOPin *pPin);
+
+	/// \brief Fetches events from the queue
+	/// \param pBuffer Events will be returned here
+	/// \param nMaxEvents Size of the buffer in number of events
+	/// \return Number of returned events (0 if queue is empty)
+	unsigned Read (TGPIOEvent *pBuffer, unsigned nMaxEvents);
+
+	/// \return Number of queued events
+	unsigned GetCount (void) const;
+
+	/// \return Number of events dropped, because the queue was full
+	unsigned GetOverflows (void) const	{ return m_nOverflows; }
+
+	/// \brief Removes all queued events and resets the overflow counter
+	void Flush (void);
+
+private:
+	void EventHandler (unsigned nPin);
+	static void EventStub (void *pParam);
+
+private:
+	TGPIOEvent *m_pBuffer;
+	unsigned m_nSize;
+	volatile unsigned m_nInPtr;
+	volatile unsigned m_nOutPtr;
+	volatile unsigned m_nOverflows;
+
+	struct TPinSlot
+	{
+		CGPIOEventQueue	*pThis;
+		CGPIOPin	*pPin;
+		TGPIOInterrupt	 Interrupt2;
+	}
+	m_PinSlot[GPIO_PINS];
+
+	mutable CSpinLock m_SpinLock;
+};
+
+#endif
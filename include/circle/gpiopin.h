@@ -121,6 +121,9 @@ public:
 	/// \brief Write inverted value to pin
 	void Invert (void);
 
+	/// \return Physical (Broadcom) number of the pin
+	unsigned GetPin (void) const		{ return m_nPin; }
+
 	/// \param pHandler Interrupt handler to be called on GPIO event
 	/// \param pParam Any parameter, will be handed over to the interrupt handler
 	/// \param bAutoAck Automatically acknowledge GPIO event detect status?
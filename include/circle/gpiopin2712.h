@@ -72,6 +72,8 @@ public:
 
 	void Invert (void);
 
+	unsigned GetPin (void) const		{ return m_nPin; }
+
 	void ConnectInterrupt (TGPIOInterruptHandler *pHandler, void *pParam,
 			       boolean bAutoAck = TRUE);
 	void DisconnectInterrupt (void);
@@ -0,0 +1,245 @@
+//
+// gpiotemplate.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiotemplate_h
+#define _circle_gpiotemplate_h
+
+#include <circle/gpiopin.h>
+#include <circle/memio.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#if RASPPI <= 4
+	#include <circle/bcm2835.h>
+#else
+	#include <circle/bcm2712.h>
+#endif
+
+/// \class TGPIOPinRegs
+/// \brief Register addresses and mask of a GPIO pin, computed at compile time
+/// \tparam Pin Physical (Broadcom) GPIO pin number
+
+template <unsigned Pin>
+struct TGPIOPinRegs
+{
+	static_assert (Pin < GPIO_PINS, "Invalid GPIO pin number");
+
+#if RASPPI <= 4
+	static constexpr unsigned Bank		= Pin / 32;
+	static constexpr u32 Mask		= 1U << (Pin % 32);
+
+	static constexpr uintptr SetReg		= ARM_GPIO_GPSET0 + Bank * 4;
+	static constexpr uintptr ClrReg		= ARM_GPIO_GPCLR0 + Bank * 4;
+	static constexpr uintptr LevReg		= ARM_GPIO_GPLEV0 + Bank * 4;
+#else
+	// RP1 GPIO banks 0-2 with 28, 6 and 20 pins (see CGPIOPin::Pin2Bank())
+	static constexpr unsigned Bank		= Pin < 28 ? 0 : (Pin < 34 ? 1 : 2);
+	static constexpr u32 Mask		= 1U << (Pin - (Pin < 28 ? 0 : (Pin < 34 ? 28 : 34)));
+
+	// RIO registers with atomic set, clear and XOR aliases
+	static constexpr uintptr SetReg		= ARM_GPIO0_RIO_BASE + Bank * 0x4000 + 0x2000;
+	static constexpr uintptr ClrReg		= ARM_GPIO0_RIO_BASE + Bank * 0x4000 + 0x3000;
+	static constexpr uintptr XorReg		= ARM_GPIO0_RIO_BASE + Bank * 0x4000 + 0x1000;
+	static constexpr uintptr LevReg		= ARM_GPIO0_RIO_BASE + Bank * 0x4000 + 8;
+#endif
+};
+
+/// \class TGPIOPin
+/// \brief GPIO pin with a pin number known at compile time, for fast bit-banging
+/// \tparam Pin Physical (Broadcom) GPIO pin number
+/// \tparam Mode Pin mode (GPIOModeOutput or an input mode)
+/// \details The constructor sets the pin mode once using CGPIOPin. The static methods\n
+/// Write(), Read() and Invert() compile to a single register access then, without\n
+/// any runtime lookup of the register address or mask (also on the Raspberry Pi 5).
+/// \note There is no check, if the pin is used by another CGPIOPin object.
+
+template <unsigned Pin, TGPIOMode Mode = GPIOModeOutput>
+class TGPIOPin
+{
+public:
+	typedef TGPIOPinRegs<Pin> Regs;
+
+	TGPIOPin (void)
+	:	m_Pin (Pin, Mode)
+	{
+	}
+
+	/// \param nValue LOW or HIGH
+	static void Write (unsigned nValue)
+	{
+		static_assert (Mode == GPIOModeOutput, "Pin is not an output");
+
+		PeripheralEntry ();
+		write32 (nValue ? Regs::SetReg : Regs::ClrReg, Regs::Mask);
+		PeripheralExit ();
+	}
+
+	static void SetHigh (void)
+	{
+		static_assert (Mode == GPIOModeOutput, "Pin is not an output");
+
+		PeripheralEntry ();
+		write32 (Regs::SetReg, Regs::Mask);
+		PeripheralExit ();
+	}
+
+	static void SetLow (void)
+	{
+		static_assert (Mode == GPIOModeOutput, "Pin is not an output");
+
+		PeripheralEntry ();
+		write32 (Regs::ClrReg, Regs::Mask);
+		PeripheralExit ();
+	}
+
+#if RASPPI >= 5
+	/// \note Only available on the Raspberry Pi 5 (atomic XOR register)
+	static void Invert (void)
+	{
+		static_assert (Mode == GPIOModeOutput, "Pin is not an output");
+
+		write32 (Regs::XorReg, Regs::Mask);
+	}
+#endif
+
+	/// \return LOW or HIGH
+	static unsigned Read (void)
+	{
+		PeripheralEntry ();
+		u32 nLevel = read32 (Regs::LevReg);
+		PeripheralExit ();
+
+		return nLevel & Regs::Mask ? HIGH : LOW;
+	}
+
+private:
+	CGPIOPin m_Pin;
+};
+
+/// \class TGPIOPort
+/// \brief Group of output pins, which are written together
+/// \tparam Pins Physical (Broadcom) GPIO pin numbers, bit 0 of a value is the first pin
+/// \details A write is collapsed into one store to the SET register and one store to\n
+/// the CLR register. All pins must be in the same GPIO bank (GPIO0-31 on the Raspberry\n
+/// Pi 1-4, GPIO0-27 on the Raspberry Pi 5), which is checked at compile time.
+
+template <unsigned... Pins>
+class TGPIOPort
+{
+public:
+	static constexpr unsigned PinCount = sizeof... (Pins);
+
+	static_assert (PinCount > 0 && PinCount <= 32, "Invalid number of pins");
+
+	TGPIOPort (void)
+	{
+		static const unsigned PinNumbers[] = {Pins...};
+
+		for (unsigned i = 0; i < PinCount; i++)
+		{
+			m_Pin[i].AssignPin (PinNumbers[i]);
+			m_Pin[i].SetMode (GPIOModeOutput);
+		}
+	}
+
+	/// \return GPIO register bits for a value (bit 0 is the first pin)
+	static constexpr u32 GetMask (unsigned nValue)
+	{
+		return GetMask<Pins...> (nValue, 0);
+	}
+
+	static constexpr u32 Mask = GetMask (~0U);
+
+	/// \param nValue Bit 0 is written to the first pin, bit 1 to the second pin etc.
+	static void Write (unsigned nValue)
+	{
+		u32 nSet = GetMask (nValue);
+
+		PeripheralEntry ();
+		write32 (SetReg, nSet);
+		write32 (ClrReg, ~nSet & Mask);
+		PeripheralExit ();
+	}
+
+	/// \tparam Value Bit 0 is written to the first pin, bit 1 to the second pin etc.
+	/// \note The register contents are constants here.
+	template <unsigned Value>
+	static void Write (void)
+	{
+		constexpr u32 nSet = GetMask (Value);
+		constexpr u32 nClear = ~nSet & Mask;
+
+		PeripheralEntry ();
+		if (nSet != 0)
+		{
+			write32 (SetReg, nSet);
+		}
+		if (nClear != 0)
+		{
+			write32 (ClrReg, nClear);
+		}
+		PeripheralExit ();
+	}
+
+private:
+	// unrolled at compile time, so that a runtime value needs no table lookup
+	template <unsigned First>
+	static constexpr u32 GetMask (unsigned nValue, unsigned nBit)
+	{
+		return nValue & (1U << nBit) ? TGPIOPinRegs<First>::Mask : 0;
+	}
+
+	template <unsigned First, unsigned Second, unsigned... Rest>
+	static constexpr u32 GetMask (unsigned nValue, unsigned nBit)
+	{
+		return GetMask<First> (nValue, nBit) | GetMask<Second, Rest...> (nValue, nBit+1);
+	}
+
+	static constexpr boolean IsSameBank (void)
+	{
+		const unsigned Banks[] = {TGPIOPinRegs<Pins>::Bank...};
+
+		for (unsigned i = 1; i < PinCount; i++)
+		{
+			if (Banks[i] != Banks[0])
+			{
+				return FALSE;
+			}
+		}
+
+		return TRUE;
+	}
+
+	static_assert (IsSameBank (), "All pins must be in the same GPIO bank");
+
+	static constexpr unsigned FirstPin (void)
+	{
+		const unsigned PinNumbers[] = {Pins...};
+
+		return PinNumbers[0];
+	}
+
+	static constexpr uintptr SetReg = TGPIOPinRegs<FirstPin ()>::SetReg;
+	static constexpr uintptr ClrReg = TGPIOPinRegs<FirstPin ()>::ClrReg;
+
+private:
+	CGPIOPin m_Pin[PinCount];
+};
+
+#endif
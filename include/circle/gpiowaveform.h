@@ -0,0 +1,126 @@
+//
+// gpiowaveform.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_gpiowaveform_h
+#define _circle_gpiowaveform_h
+
+#include <circle/dmachannel.h>
+#include <circle/gpioclock.h>
+#include <circle/interrupt.h>
+#include <circle/types.h>
+
+/// \brief Completion routine, called from IRQ, when a one-shot waveform has been played
+typedef void TGPIOWaveformCompletionRoutine (boolean bStatus, void *pParam);
+
+/// \class CGPIOWaveform
+/// \brief DMA-paced pattern generator for the GPIO pins 0-31
+///
+/// \details A timeline of steps is defined with AddStep(). Each step sets and clears\n
+/// the pins in two masks (bit n = GPIO n) at once and waits a number of ticks then.\n
+/// Start() compiles the timeline into a DMA control block chain, which writes the\n
+/// GPSET0/GPCLR0 registers. The delays are paced by the DREQ of the PWM device,\n
+/// which consumes one FIFO word per tick. The CPU is not involved during playback.
+///
+/// \note The pins must be configured as outputs (e.g. with CGPIOPin) before.
+/// \note The PWM device cannot be used otherwise at the same time (e.g. for sound).
+/// \note Not supported on the Raspberry Pi 5.
+
+class CGPIOWaveform
+{
+public:
+	/// \param nMaxSteps Maximum number of steps in the timeline
+	/// \param nTickRateHZ Rate of the delay ticks in Hz (resolution of the timeline)
+	/// \param pInterruptSystem Pointer to the interrupt system object\n
+	///	   (or 0, if SetCompletionRoutine() is not used)
+	CGPIOWaveform (unsigned nMaxSteps, unsigned nTickRateHZ = 1000000,
+		       CInterruptSystem *pInterruptSystem = 0);
+
+	~CGPIOWaveform (void);
+
+	/// \brief Appends a step to the timeline
+	/// \param nSetMask Pins to be set high (bit n = GPIO n)
+	/// \param nClearMask Pins to be set low
+	/// \param nDelayTicks Number of ticks to wait before the next step
+	/// \return Operation successful? (FALSE, if the timeline is full)
+	/// \note Must not be called, while the waveform is playing.
+	boolean AddStep (u32 nSetMask, u32 nClearMask, unsigned nDelayTicks);
+
+	/// \brief Discards the timeline
+	/// \note Must not be called, while the waveform is playing.
+	void Clear (void);
+
+	/// \brief Set completion routine to be called, when a one-shot waveform has been played
+	/// \param pRoutine Pointer to the completion routine
+	/// \param pParam   User parameter
+	void SetCompletionRoutine (TGPIOWaveformCompletionRoutine *pRoutine, void *pParam = 0);
+
+	/// \brief Compiles the timeline and starts playing it
+	/// \param bCyclic Restart from the first step, after the last step has been played
+	/// \return Operation successful?
+	boolean Start (boolean bCyclic = FALSE);
+
+	/// \brief Stops playing, the pins keep their current levels
+	void Stop (void);
+
+	/// \return Is the waveform playing?
+	boolean IsRunning (void) const;
+
+private:
+	void Compile (boolean bCyclic);
+
+	void RunPWM (void);
+	void StopPWM (void);
+
+	void ResetDMA (void);
+
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+private:
+	unsigned m_nMaxSteps;
+	unsigned m_nSteps;
+	unsigned m_nTickRate;
+
+	CInterruptSystem *m_pInterruptSystem;
+	boolean m_bIRQConnected;
+
+	TGPIOWaveformCompletionRoutine *m_pCompletionRoutine;
+	void *m_pCompletionParam;
+
+	CGPIOClock m_Clock;
+	unsigned m_nDMAChannel;
+
+	struct TStep
+	{
+		u32	nSetMask;		// must be followed by nClearMask for the DMA
+		u32	nClearMask;
+		u32	nDelayTicks;
+		u32	nReserved;
+	};
+
+	TStep *m_pSteps;			// DMA source of the GPIO writes
+
+	u8 *m_pControlBlockBuffer;
+	TDMAControlBlock *m_pControlBlock;	// two per step
+	u32 *m_pDelaySource;			// dummy word written to the PWM FIFO
+
+	boolean m_bCyclic;
+};
+
+#endif
@@ -0,0 +1,224 @@
+//
+// hashmap.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_hashmap_h
+#define _circle_hashmap_h
+
+#include <circle/types.h>
+#include <assert.h>
+
+/// \brief Hash function for integer keys (default)
+template <class TKey>
+struct CHashTraits
+{
+	static u32 Hash (const TKey &rKey)
+	{
+		u64 ullKey = (u64) rKey;
+
+		// mix with the 64-bit golden ratio and use the upper bits
+		return (u32) ((ullKey * 0x9E3779B97F4A7C15ULL) >> 32);
+	}
+};
+
+/// \brief Hash function for pointer keys
+template <class T>
+struct CHashTraits<T *>
+{
+	static u32 Hash (T * const &rKey)
+	{
+		return CHashTraits<uintptr>::Hash ((uintptr) rKey);
+	}
+};
+
+/// \brief Hash map with open addressing (linear probing) in a single array
+/// \note TKey and TValue must be default-constructible and copyable,\n
+///	  for other key types specialize CHashTraits<TKey> or give THash
+template <class TKey, class TValue, class THash = CHashTraits<TKey>>
+class CHashMap
+{
+	struct TSlot
+	{
+		TKey	Key;
+		TValue	Value;
+		boolean	bUsed;
+
+		TSlot (void) : bUsed (FALSE) {}
+	};
+
+public:
+	/// \param nInitialSize Initial number of slots (rounded up to a power of 2)
+	CHashMap (unsigned nInitialSize = 16)
+	:	m_pSlot (0),
+		m_nSize (0),
+		m_nCount (0)
+	{
+		unsigned nSize = 8;
+		while (nSize < nInitialSize)
+		{
+			nSize <<= 1;
+		}
+
+		Resize (nSize);
+	}
+
+	~CHashMap (void)
+	{
+		delete [] m_pSlot;
+	}
+
+	CHashMap (const CHashMap &) = delete;
+	CHashMap &operator= (const CHashMap &) = delete;
+
+	unsigned GetCount (void) const	{ return m_nCount; }
+
+	/// \brief Insert key or update its value
+	void Set (const TKey &rKey, const TValue &rValue)
+	{
+		// keep the load factor below 3/4 to keep the probe sequences short
+		if ((m_nCount+1) * 4 > m_nSize * 3)
+		{
+			Resize (m_nSize * 2);
+		}
+
+		TSlot *pSlot = Lookup (rKey);
+		if (!pSlot->bUsed)
+		{
+			pSlot->Key = rKey;
+			pSlot->bUsed = TRUE;
+			m_nCount++;
+		}
+
+		pSlot->Value = rValue;
+	}
+
+	/// \return Pointer to the value of key, 0 if not found
+	/// \note The pointer is valid until the next Set() or Remove()
+	TValue *Find (const TKey &rKey)
+	{
+		TSlot *pSlot = Lookup (rKey);
+
+		return pSlot->bUsed ? &pSlot->Value : 0;
+	}
+
+	const TValue *Find (const TKey &rKey) const
+	{
+		return const_cast<CHashMap *> (this)->Find (rKey);
+	}
+
+	/// \return Was the key found and removed?
+	boolean Remove (const TKey &rKey)
+	{
+		TSlot *pSlot = Lookup (rKey);
+		if (!pSlot->bUsed)
+		{
+			return FALSE;
+		}
+
+		// shift following entries of the probe sequence back, so no tombstones are needed
+		unsigned nMask = m_nSize-1;
+		unsigned nHole = pSlot - m_pSlot;
+		for (unsigned i = (nHole+1) & nMask; m_pSlot[i].bUsed; i = (i+1) & nMask)
+		{
+			unsigned nHome = THash::Hash (m_pSlot[i].Key) & nMask;
+
+			// can the entry at i move to the hole (is its home not in (nHole, i])?
+			if (((i - nHome) & nMask) >= ((i - nHole) & nMask))
+			{
+				m_pSlot[nHole] = m_pSlot[i];
+				nHole = i;
+			}
+		}
+
+		m_pSlot[nHole].Key = TKey ();
+		m_pSlot[nHole].Value = TValue ();
+		m_pSlot[nHole].bUsed = FALSE;
+
+		assert (m_nCount > 0);
+		m_nCount--;
+
+		return TRUE;
+	}
+
+	void RemoveAll (void)
+	{
+		for (unsigned i = 0; i < m_nSize; i++)
+		{
+			m_pSlot[i] = TSlot ();
+		}
+
+		m_nCount = 0;
+	}
+
+	/// \brief Call Callback (Key, Value, pContext) for each entry (the map must not be modified meanwhile)
+	template <class TCallback>
+	void Enumerate (TCallback Callback, void *pContext) const
+	{
+		for (unsigned i = 0; i < m_nSize; i++)
+		{
+			if (m_pSlot[i].bUsed)
+			{
+				Callback (m_pSlot[i].Key, m_pSlot[i].Value, pContext);
+			}
+		}
+	}
+
+private:
+	TSlot *Lookup (const TKey &rKey) const
+	{
+		unsigned nMask = m_nSize-1;
+		unsigned i = THash::Hash (rKey) & nMask;
+
+		// terminates, because there is always at least one free slot
+		while (   m_pSlot[i].bUsed
+		       && !(m_pSlot[i].Key == rKey))
+		{
+			i = (i+1) & nMask;
+		}
+
+		return &m_pSlot[i];
+	}
+
+	void Resize (unsigned nSize)
+	{
+		TSlot *pOldSlot = m_pSlot;
+		unsigned nOldSize = m_nSize;
+
+		m_pSlot = new TSlot[nSize];
+		assert (m_pSlot != 0);
+		m_nSize = nSize;
+
+		for (unsigned i = 0; i < nOldSize; i++)
+		{
+			if (pOldSlot[i].bUsed)
+			{
+				TSlot *pSlot = Lookup (pOldSlot[i].Key);
+				*pSlot = pOldSlot[i];
+			}
+		}
+
+		delete [] pOldSlot;
+	}
+
+private:
+	TSlot	 *m_pSlot;
+	unsigned  m_nSize;		// power of 2
+	unsigned  m_nCount;
+};
+
+#endif
@@ -29,24 +29,39 @@
 
 //#define HEAP_DEBUG
 
-ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 16);
+#if defined (ARM_ALLOW_MULTI_CORE) && !defined (HEAP_DEBUG) && !defined (NO_HEAP_CORE_CACHE)
+	#define HEAP_CORE_CACHE
+#endif
+
+ASSERT_STATIC (DATA_CACHE_LINE_LENGTH_MAX >= 32);
 
 #define HEAP_BLOCK_ALIGN	DATA_CACHE_LINE_LENGTH_MAX
 #define HEAP_ALIGN_MASK		(HEAP_BLOCK_ALIGN-1)
 
 #define HEAP_BLOCK_MAX_BUCKETS	20
 
+// Blocks, which are bigger than the largest bucket size, are managed using the
+// TLSF (two-level segregated fit) scheme. The first level divides the sizes in
+// powers of 2, the second level divides each first level range linearly.
+#define HEAP_LARGE_SL_SHIFT	4
+#define HEAP_LARGE_SL_COUNT	(1 << HEAP_LARGE_SL_SHIFT)
+#define HEAP_LARGE_FL_SHIFT	(HEAP_LARGE_SL_SHIFT + 6)	// below: linear in 64 byte steps
+#define HEAP_LARGE_FL_COUNT	(32 - HEAP_LARGE_FL_SHIFT + 1)
+
 struct THeapBlockHeader
 {
 	u32			 nMagic;
 #define HEAP_BLOCK_ALLOC_MAGIC	0x424C4D41	// Block is allocated
 #define HEAP_BLOCK_FREE_MAGIC	0x424C4D46	// Block is on freelist
+#define HEAP_BLOCK_LARGE_MAGIC	0x424C4D4C	// Large block is on free list
 	u32			 nSize;
 	THeapBlockHeader	*pNext;
 #if AARCH == 32
 	u32			 nPadding;
 #endif
-	u8			 Align[HEAP_BLOCK_ALIGN-16];
+	THeapBlockHeader	*pPrevPhys;		// physically preceding block (or 0)
+	THeapBlockHeader	*pPrev;			// previous block on large free list
+	u8			 Align[HEAP_BLOCK_ALIGN-16-2*sizeof (THeapBlockHeader *)];
 	u8			 Data[0];
 }
 PACKED;
@@ -54,13 +69,51 @@ PACKED;
 struct THeapBlockBucket
 {
 	u32			 nSize;
-#ifdef HEAP_DEBUG
-	unsigned		 nCount;
-	unsigned		 nMaxCount;
-#endif
+	unsigned		 nCount;		// allocated blocks
+	unsigned		 nMaxCount;		// peak of nCount
+	unsigned		 nBlocks;		// blocks taken from the region
+	THeapBlockHeader	*pFreeList;
+};
+
+struct THeapStatistics		/// Snapshot of the heap usage (see CHeapAllocator::GetStatistics())
+{
+	unsigned	nBuckets;		///< Number of valid entries in Bucket[]
+	struct
+	{
+		size_t		nSize;		///< Block size of this bucket
+		unsigned	nCount;		///< Currently allocated blocks of this size
+		unsigned	nMaxCount;	///< Peak of nCount
+	}
+	Bucket[HEAP_BLOCK_MAX_BUCKETS];
+
+	unsigned	nLargeCount;		///< Currently allocated blocks bigger than all buckets
+	unsigned	nLargeMaxCount;		///< Peak of nLargeCount
+
+	unsigned	nAllocations;		///< Total number of allocations (wraps around)
+
+	size_t		nFreeSpace;		///< Free space of the region, which is not used by blocks
+	size_t		nFreeBucketSpace;	///< Unused blocks on the bucket free lists
+	size_t		nFreeLargeSpace;	///< Unused blocks on the large free lists
+	size_t		nLargestFree;		///< Largest block, which can be allocated at once
+	unsigned	nFragmentation;		///< 100 - nLargestFree * 100 / all free space (percent)
+};
+
+struct THeapSample		/// Recorded allocation (see CHeapAllocator::GetSamples())
+{
+	uintptr		nCallerPC;		///< Return address of the malloc() or new call
+	size_t		nSize;			///< Requested size
+};
+
+#ifdef HEAP_CORE_CACHE
+
+struct THeapCoreCache
+{
 	THeapBlockHeader	*pFreeList;
+	unsigned		 nCount;
 };
 
+#endif
+
 class CHeapAllocator	/// Allocates blocks from a flat memory region
 {
 public:
@@ -79,34 +132,88 @@ public:
 	/// \note Unused blocks on a free list do not count here.
 	size_t GetFreeSpace (void) const;
 
-	/// \param nSize Block size to be allocated
+	/// \param nSize     Block size to be allocated
+	/// \param nCallerPC Address of the caller (recorded, if sampling is enabled)
 	/// \return Pointer to new allocated block (0 if heap is full or not set-up)
 	/// \note Resulting block is always 16 bytes aligned
 	/// \note If nReserve in Setup() is non-zero, the system panics if heap is full.
-	void *Allocate (size_t nSize);
+	void *Allocate (size_t nSize, uintptr nCallerPC = 0);
 
-	/// \param pBlock Memory block to be reallocated
-	/// \param nSize  New block size
+	/// \param pBlock    Memory block to be reallocated
+	/// \param nSize     New block size
+	/// \param nCallerPC Address of the caller (recorded, if sampling is enabled)
 	/// \return Pointer to new block (block contents has been copied, if the block has moved)
-	void *ReAllocate (void *pBlock, size_t nSize);
+	void *ReAllocate (void *pBlock, size_t nSize, uintptr nCallerPC = 0);
 
 	/// \param pBlock Memory block to be freed
-	/// \note Memory space of blocks, which are bigger than the largest bucket size,\n
-	///	  cannot be returned to a free list and is lost.
+	/// \note Blocks, which are bigger than the largest bucket size, are merged with\n
+	///	  adjacent free large blocks. They are returned to the free space of the\n
+	///	  memory region, if they are at its end.
 	void Free (void *pBlock);
 
-#ifdef HEAP_DEBUG
+	/// \param pStats Statistics are returned here
+	void GetStatistics (THeapStatistics *pStats);
+
+	/// \brief Enables or disables sampling of allocations
+	/// \param nInterval Every nInterval-th allocation is recorded (0 to disable)
+	void SetSampleInterval (unsigned nInterval);
+
+	/// \param pBuffer  Recorded samples are copied here (newest first)
+	/// \param nMaxSamples Size of pBuffer in number of entries
+	/// \return Number of samples, which have been returned
+	unsigned GetSamples (THeapSample *pBuffer, unsigned nMaxSamples) const;
+
+	/// \brief Writes the heap statistics to the system log
 	void DumpStatus (void);
+
+private:
+	unsigned GetBucket (size_t nSize) const;
+
+	void Sample (size_t nSize, uintptr nCallerPC);
+
+	static void CountAllocation (THeapBlockBucket *pBucket);
+
+#ifdef HEAP_CORE_CACHE
+	void *AllocateCached (unsigned nBucket);
+	boolean FreeCached (THeapBlockHeader *pBlockHeader, unsigned nBucket);
 #endif
 
+	// the following methods must be called with m_SpinLock acquired
+	THeapBlockHeader *AllocateLarge (size_t nSize);
+	void FreeLarge (THeapBlockHeader *pBlockHeader);
+
+	void InsertLarge (THeapBlockHeader *pBlockHeader);
+	void RemoveLarge (THeapBlockHeader *pBlockHeader);
+
+	THeapBlockHeader *GetNextPhys (THeapBlockHeader *pBlockHeader) const;
+
+	static void MapLargeSize (size_t nSize, unsigned *pFL, unsigned *pSL);
+
 private:
 	const char	*m_pHeapName;
 	u8		*m_pNext;
 	u8		*m_pLimit;
 	size_t	 	 m_nReserve;
+	THeapBlockHeader *m_pLast;		// last block allocated from the region
 	THeapBlockBucket m_Bucket[HEAP_BLOCK_MAX_BUCKETS+1];
 	CSpinLock	 m_SpinLock;
 
+#ifdef HEAP_CORE_CACHE
+	THeapCoreCache	 m_CoreCache[CORES][HEAP_BLOCK_MAX_BUCKETS];
+#endif
+
+	u32		 m_nLargeFLBitmap;
+	u16		 m_nLargeSLBitmap[HEAP_LARGE_FL_COUNT];
+	THeapBlockHeader *m_pLargeFreeList[HEAP_LARGE_FL_COUNT][HEAP_LARGE_SL_COUNT];
+	size_t		 m_nLargeFreeSpace;
+
+	unsigned	 m_nAllocations;
+
+	unsigned	 m_nSampleInterval;
+	unsigned	 m_nSampleCounter;
+	unsigned	 m_nSampleNext;
+	THeapSample	 m_Samples[HEAP_SAMPLE_COUNT];
+
 	static u32 s_nBucketSize[];
 };
 
@@ -45,6 +45,23 @@
 /// \param pParam    The pParam passed in CI2CMasterIRQ::SetCompletionRoutine()
 typedef void TI2CCompletionRoutine (int nStatus, void *pParam);
 
+/// \brief One segment of a batch, submitted with CI2CMasterIRQ::SubmitBatch()
+struct TI2CSegment
+{
+	u8	 ucAddress;		///< I2C slave address of target device
+	boolean	 bRead;			///< Read segment (write otherwise)
+	boolean	 bRepeatedStart;	///< Write segment, followed without stop by a read segment
+	void	*pBuffer;		///< Data to be written or buffer for read data
+	unsigned nCount;		///< Number of bytes (> 0)
+};
+
+/// \param nStatus   One of the CI2CMasterIRQ::TStatus integers (success or error code)
+/// \param nSegments Number of segments, which have been completed successfully
+/// \param pParam    The pParam passed in CI2CMasterIRQ::SubmitBatch()
+typedef void TI2CBatchCompletionRoutine (int nStatus, unsigned nSegments, void *pParam);
+
+#define I2C_BATCH_QUEUE_SIZE	8
+
 
 class CI2CMasterIRQ
 {
@@ -106,7 +123,26 @@ public:
 			    const void *pWriteBuffer, unsigned nWriteCount,
 			    void *pReadBuffer, unsigned nReadCount);
 
+	/// \brief Queue a batch of segments for several devices, executed back-to-back from IRQ
+	/// \param pSegments Array of segments, must stay valid until the batch has completed
+	/// \param nSegments Number of segments in the array
+	/// \param pRoutine  Called once from IRQ, when the batch has completed or failed
+	/// \param pParam    User parameter handed over to the completion routine
+	/// \return 0 if the batch has been queued or < 0 on failure (queue full)
+	/// \note Segments may exceed the FIFO size, the FIFO is refilled from IRQ.
+	/// \note The completion routine may submit the next batch.
+	/// \note Read/Write/StartWriteRead() must not be called, while batches are pending.
+	int SubmitBatch (const TI2CSegment *pSegments, unsigned nSegments,
+			 TI2CBatchCompletionRoutine *pRoutine, void *pParam = 0);
+
+	/// \return Number of batches queued or active
+	unsigned GetPendingBatches (void);
+
 private:
+	void StartBatch (void);
+	void StartSegment (boolean bRepeatedStart);
+	boolean BatchInterruptHandler (u32 nStatus, int *pResult);
+
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
@@ -138,6 +174,22 @@ private:
 	CInterruptSystem *m_pInterruptSystem;
 	TI2CCompletionRoutine *m_pCompletionRoutine;
 	void *m_pCompletionParam;
+
+	struct TBatch
+	{
+		const TI2CSegment	  *pSegments;
+		unsigned		   nSegments;
+		TI2CBatchCompletionRoutine *pRoutine;
+		void			  *pParam;
+	};
+
+	TBatch m_BatchQueue[I2C_BATCH_QUEUE_SIZE];
+	unsigned m_nBatchIn;			// ring buffer indices
+	unsigned m_nBatchOut;
+	boolean m_bBatchActive;			// batch at m_nBatchOut is running
+
+	unsigned m_nSegment;			// current segment of the active batch
+	unsigned m_nSegmentOffset;		// bytes done in the current segment
 };
 
 #endif
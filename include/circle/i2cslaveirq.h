@@ -0,0 +1,125 @@
+//
+// i2cslaveirq.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_i2cslaveirq_h
+#define _circle_i2cslaveirq_h
+
+#include <circle/gpiopin.h>
+#include <circle/interrupt.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define I2C_SLAVE_RING_SIZE	512		// bytes, must be a power of 2
+
+/// \param nRegister First register, which has been written
+/// \param nCount Number of written registers (wraps at the end of the register map)
+/// \param pParam User parameter
+/// \note Called from interrupt context at the end of a write transfer.
+typedef void TI2CSlaveWriteHandler (unsigned nRegister, unsigned nCount, void *pParam);
+
+/// \note In register map mode the master accesses a memory-backed register file, without
+///	  a task being involved. The first byte of a write transfer sets the register
+///	  pointer, the following bytes are written to the registers. A read transfer returns
+///	  the registers from the pointer. The pointer auto-increments and wraps.
+/// \note Otherwise received bytes are stored in a ring buffer, which is read with Read(),
+///	  and bytes given to Write() are sent, when the master reads.
+/// \note The BSC slave cannot stretch the clock and has no stop condition interrupt. The
+///	  end of a write transfer is detected in the interrupt handler, when the receiver is
+///	  not busy any more. The transmit FIFO is then refilled from the register pointer, so
+///	  the master must allow some microseconds between setting the register pointer and
+///	  reading (e.g. use a stop condition instead of a repeated start).
+
+class CI2CSlaveIRQ	/// Interrupt driven driver for the I2C slave device
+{
+public:
+	/// \param ucAddress 7-bit device address
+	/// \param pInterrupt Pointer to the interrupt system object
+	CI2CSlaveIRQ (u8 ucAddress, CInterruptSystem *pInterrupt);
+
+	~CI2CSlaveIRQ (void);
+
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Enable the register map mode (call before Initialize())
+	/// \param pRegisters Pointer to the register file
+	/// \param nSize Size of the register file in bytes (1..256)
+	/// \param pHandler Called when the master has written registers (may be 0)
+	/// \param pParam User parameter for the handler
+	void SetRegisterMap (volatile u8 *pRegisters, unsigned nSize,
+			     TI2CSlaveWriteHandler *pHandler = 0, void *pParam = 0);
+
+	/// \brief Call after the register file has been modified by the application,
+	///	   so that prefetched bytes in the transmit FIFO are updated
+	void RegistersChanged (void);
+
+	/// \param pBuffer Pointer to data buffer
+	/// \param nCount Maximum number of bytes to be read
+	/// \return Number of bytes read from the receive ring buffer (does not wait)
+	int Read (void *pBuffer, unsigned nCount);
+
+	/// \param pBuffer Pointer to data buffer
+	/// \param nCount Number of bytes to be written
+	/// \return Number of bytes queued into the transmit ring buffer (does not wait)
+	int Write (const void *pBuffer, unsigned nCount);
+
+	/// \return Number of overrun (receive) and underrun (transmit) errors
+	unsigned GetErrorCount (void) const	{ return m_nErrors; }
+
+private:
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+	void ReceiveFIFO (void);		// called with spin lock acquired
+	void FillTransmitFIFO (void);		// called with spin lock acquired
+	void RestartTransmit (void);		// called with spin lock acquired
+
+private:
+	u8 m_ucAddress;
+	CInterruptSystem *m_pInterrupt;
+	boolean m_bIRQConnected;
+
+	CGPIOPin m_SDA;
+	CGPIOPin m_SCL;
+
+	// register map mode
+	volatile u8 *m_pRegisters;
+	unsigned m_nRegisterSize;
+	TI2CSlaveWriteHandler *m_pWriteHandler;
+	void *m_pWriteParam;
+	unsigned m_nPointer;			// register pointer of the master
+	unsigned m_nTxPointer;			// next register to be put into the TX FIFO
+	boolean m_bTransferActive;		// a write transfer is in progress
+	unsigned m_nWriteStart;
+	unsigned m_nWriteCount;
+
+	// ring buffer mode
+	u8 m_RxRing[I2C_SLAVE_RING_SIZE];
+	volatile unsigned m_nRxIn;
+	volatile unsigned m_nRxOut;
+	u8 m_TxRing[I2C_SLAVE_RING_SIZE];
+	volatile unsigned m_nTxIn;
+	volatile unsigned m_nTxOut;
+
+	unsigned m_nErrors;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -0,0 +1,111 @@
+//
+// inputeventqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_input_inputeventqueue_h
+#define _circle_input_inputeventqueue_h
+
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define INPUT_EVENT_QUEUE_SIZE	256		// default, must be a power of 2
+
+enum TInputEventType
+{
+	InputEventKeyDown,		// usCode is the USB HID key code (0x80+n for modifier n)
+	InputEventKeyUp,
+	InputEventMouse,		// usCode is the button mask, values are dX, dY, wheel
+	InputEventTouchDown,		// usCode is the touch ID, values are X, Y
+	InputEventTouchUp,
+	InputEventTouchMove,
+	InputEventUnknown
+};
+
+struct TInputEvent
+{
+	u64	ullTimestamp;		// CTimer::GetClockTicks64() on arrival of the input report
+	u8	uchType;		// TInputEventType
+	u8	uchDevice;		// device number (e.g. 1 for "mouse1")
+	u16	usCode;
+	s32	nValue[3];
+};
+
+/// \class CInputEventQueue
+/// \brief Shared queue of timestamped events from all input devices
+///
+/// \details The keyboard, mouse and touch screen drivers add their events to this queue,\n
+/// if an instance of this class exists (normally a member of CKernel). The events are\n
+/// added, when they are reported by the device, before the registered handlers are\n
+/// called. The application fetches them in batches from TASK_LEVEL with Read(). The\n
+/// queue does not need a lock. If it is full, new events are dropped and counted.
+/// \note Touch screen events are reported with calibrated screen coordinates.
+
+class CInputEventQueue
+{
+public:
+	/// \param nSize Maximum number of queued events (must be a power of 2)
+	CInputEventQueue (unsigned nSize = INPUT_EVENT_QUEUE_SIZE);
+
+	~CInputEventQueue (void);
+
+	/// \brief Fetches events from the queue
+	/// \param pBuffer Events will be returned here
+	/// \param nMaxEvents Size of the buffer in number of events
+	/// \return Number of returned events (0 if queue is empty)
+	/// \note Must be called by one consumer only.
+	unsigned Read (TInputEvent *pBuffer, unsigned nMaxEvents);
+
+	/// \return Number of events dropped, because the queue was full
+	unsigned GetOverflows (void) const	{ return m_nOverflows; }
+
+	/// \brief Adds an event to the queue (called by the input drivers)
+	/// \param Type Event type
+	/// \param nDevice Device number
+	/// \param usCode Key code, button mask or touch ID
+	/// \param nValue1 First value of the event
+	/// \param nValue2 Second value of the event
+	/// \param nValue3 Third value of the event
+	/// \param ullTimestamp Time of the event (0 to use the current time)
+	/// \return FALSE, if the queue is full
+	/// \note Can be called from any context (task, IRQ, FIQ) and from different cores.
+	boolean Put (TInputEventType Type, unsigned nDevice, u16 usCode,
+		     int nValue1 = 0, int nValue2 = 0, int nValue3 = 0, u64 ullTimestamp = 0);
+
+	/// \return Pointer to the only instance of this class (0 if not created)
+	static CInputEventQueue *Get (void)	{ return s_pThis; }
+
+private:
+	struct TCell
+	{
+		volatile unsigned nSequence;
+		TInputEvent Event;
+	};
+
+	TCell *m_pBuffer;
+	unsigned m_nMask;
+
+	volatile unsigned m_nEnqueuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+	unsigned m_nDequeuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+
+	volatile unsigned m_nOverflows;
+
+	static CInputEventQueue *s_pThis;
+};
+
+#endif
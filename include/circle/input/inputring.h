@@ -0,0 +1,81 @@
+//
+// inputring.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_input_inputring_h
+#define _circle_input_inputring_h
+
+#include <circle/device.h>
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define INPUT_RING_SIZE		1024		// default, must be a power of 2
+
+/// \class CInputRing
+/// \brief Lock-free ring buffer of input characters from multiple sources
+///
+/// \details Characters from different sources (e.g. USB keyboard, serial interface, web\n
+/// console) can be written into this ring from any context and from different cores\n
+/// without a lock. A source claims space for a whole string at once, so that the\n
+/// characters of one write are not interleaved with others. The characters are\n
+/// fetched by one consumer (normally CLineDiscipline) in slices with Read().\n
+/// If the ring is full, the written string is dropped and counted.
+
+class CInputRing : public CDevice
+{
+public:
+	/// \param nSize Maximum number of buffered characters (must be a power of 2)
+	CInputRing (unsigned nSize = INPUT_RING_SIZE);
+
+	~CInputRing (void);
+
+	/// \brief Fetches characters from the ring
+	/// \param pBuffer Characters will be returned here
+	/// \param nCount Size of the buffer in bytes
+	/// \return Number of returned characters (0 if ring is empty)
+	/// \note Must be called by one consumer only.
+	int Read (void *pBuffer, size_t nCount);
+
+	/// \brief Adds characters to the ring (called by the input sources)
+	/// \param pBuffer Characters to be added
+	/// \param nCount Number of characters
+	/// \return nCount, or 0 if the ring has not enough free space
+	/// \note Can be called from any context (task, IRQ, FIQ) and from different cores.
+	int Write (const void *pBuffer, size_t nCount);
+
+	/// \return Number of characters dropped, because the ring was full
+	unsigned GetOverflows (void) const	{ return m_nOverflows; }
+
+private:
+	struct TCell
+	{
+		volatile unsigned nSequence;
+		char chChar;
+	};
+
+	TCell *m_pBuffer;
+	unsigned m_nMask;
+
+	volatile unsigned m_nEnqueuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+	unsigned m_nDequeuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+
+	volatile unsigned m_nOverflows;
+};
+
+#endif
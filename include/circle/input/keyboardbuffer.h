@@ -2,7 +2,7 @@
 // keyboardbuffer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,11 +22,10 @@
 
 #include <circle/device.h>
 #include <circle/usb/usbkeyboard.h>
-#include <circle/spinlock.h>
+#include <circle/input/inputring.h>
 #include <circle/types.h>
 
-#define KEYB_BUF_SIZE		64			// must be a power of 2
-#define KEYB_BUF_MASK		(KEYB_BUF_SIZE-1)
+#define KEYB_BUF_SIZE		INPUT_RING_SIZE		// must be a power of 2
 
 class CKeyboardBuffer : public CDevice
 {
@@ -36,22 +35,17 @@ public:
 
 	int Read (void *pBuffer, size_t nCount);
 
-private:
-	void InBuf (char chChar);
-	boolean BufStat (void) const;
-	char OutBuf (void);				// returns '\0' if no key is waiting
+	// other sources (e.g. serial interface) can write their input into this ring too
+	CInputRing *GetInputRing (void)		{ return &m_Ring; }
 
+private:
 	void KeyPressedHandler (const char *pString);
 	static void KeyPressedStub (const char *pString);
 
 private:
 	CUSBKeyboardDevice *m_pKeyboard;
 
-	char 	 m_Buffer[KEYB_BUF_SIZE];
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
-
-	CSpinLock m_SpinLock;
+	CInputRing m_Ring;
 
 	static CKeyboardBuffer *s_pThis;
 };
@@ -2,7 +2,7 @@
 // linediscipline.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2017-2026  R. Stange <rsta2@gmx.net>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -52,9 +52,12 @@ private:
 		EscapeKeyDelete
 	};
 
-	// read char from input device and detect escape keys, if not in raw mode
+	// read char from input slice and detect escape keys, if not in raw mode
 	int GetChar (void);
 
+	// append printable chars from input slice directly, if cursor is at end of line
+	void AppendRun (void);
+
 	void PutChar (int nChar);
 	void Flush (void);		// write m_OutBuffer to output device
 
@@ -98,6 +101,12 @@ private:
 		StateNumber2		// '5' read
 	};
 
+	// input is read from the input device in slices
+	static const unsigned InBufferSize = 64;
+	unsigned char m_InBuffer[InBufferSize];
+	unsigned m_nInCount;		// valid chars in m_InBuffer
+	unsigned m_nInIndex;		// next char to be processed
+
 	TInputState m_InputState;
 	int m_nInputParam;
 
@@ -82,7 +82,9 @@ public:
 
 public:
 	/// \warning Do not call this from application!
-	void ReportHandler (unsigned nButtons, int nDisplacementX, int nDisplacementY, int nWheelMove);
+	/// \param ullTimestamp CTimer::GetClockTicks64() on arrival of the report (0 for now)
+	void ReportHandler (unsigned nButtons, int nDisplacementX, int nDisplacementY, int nWheelMove,
+			    u64 ullTimestamp = 0);
 
 private:
 	CMouseBehaviour m_Behaviour;
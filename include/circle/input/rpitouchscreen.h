@@ -21,6 +21,7 @@
 #define _circle_input_rpitouchscreen_h
 
 #include <circle/input/touchscreen.h>
+#include <circle/timer.h>
 #include <circle/types.h>
 
 #define RPITOUCH_SCREEN_MAX_POINTS	10
@@ -33,13 +34,19 @@ public:
 	CRPiTouchScreen (void);
 	~CRPiTouchScreen (void);
 
-	boolean Initialize (void);
+	/// \param nUpdateIntervalUs Read the touch buffer from a kernel timer in this interval\n
+	///	  (0 to read it on CTouchScreenDevice::Update() only)
+	/// \note With nUpdateIntervalUs > 0 the touch events are reported at IRQ_LEVEL,\n
+	///	  which is intended to be used with CInputEventQueue.
+	boolean Initialize (unsigned nUpdateIntervalUs = 0);
 
 private:
 	void Update (void);	// call this about 60 times per second
 
 	static void UpdateStub (void *pParam);
 
+	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
 private:
 	TFT5406Buffer *m_pFT5406Buffer;
 
@@ -49,6 +56,9 @@ private:
 	unsigned m_nPosY[RPITOUCH_SCREEN_MAX_POINTS];
 
 	CTouchScreenDevice *m_pDevice;
+
+	unsigned m_nUpdateIntervalUs;
+	TKernelTimerHandle m_hUpdateTimer;
 };
 
 #endif
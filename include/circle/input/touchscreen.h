@@ -61,7 +61,9 @@ public:
 
 public:
 	/// \warning Do not call this from application!
-	void ReportHandler (TTouchScreenEvent Event, unsigned nID, unsigned nPosX, unsigned nPosY);
+	/// \param ullTimestamp CTimer::GetClockTicks64() on arrival of the report (0 for now)
+	void ReportHandler (TTouchScreenEvent Event, unsigned nID, unsigned nPosX, unsigned nPosY,
+			    u64 ullTimestamp = 0);
 
 private:
 	TTouchScreenUpdateHandler *m_pUpdateHandler;
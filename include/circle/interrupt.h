@@ -2,7 +2,7 @@
 // interrupt.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,10 +22,19 @@
 
 #include <circle/bcm2835int.h>
 #include <circle/exceptionstub.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
 typedef void TIRQHandler (void *pParam);
 
+#ifdef USE_SCHEDULER_PREEMPTION
+typedef void TIRQReturnHandler (void);
+#endif
+
+#if RASPPI >= 4
+#define IRQ_PRIVATE_LINES	32	// SGIs and PPIs are banked per core
+#endif
+
 class CInterruptSystem
 {
 public:
@@ -36,9 +45,20 @@ public:
 
 	boolean Initialize (void);
 
+	// a private IRQ (PPI) is connected on the calling core only
 	void ConnectIRQ (unsigned nIRQ, TIRQHandler *pHandler, void *pParam);
 	void DisconnectIRQ (unsigned nIRQ);
 
+	// routes a shared peripheral IRQ to core nCore (0..CORES-1), which runs its handler then
+	// returns FALSE, if not supported for this IRQ or by the interrupt controller (RPi 1-3)
+	// data shared with this handler must be protected by CSpinLock (IRQ_LEVEL) on other cores
+	boolean SetIRQAffinity (unsigned nIRQ, unsigned nCore);
+
+	// configures a shared peripheral IRQ as edge triggered (default is level triggered)
+	// returns FALSE, if not supported for this IRQ or by the interrupt controller (RPi 1-3)
+	// must be called, while the IRQ is not connected
+	boolean SetIRQTrigger (unsigned nIRQ, boolean bEdgeTriggered);
+
 	void ConnectFIQ (unsigned nFIQ, TFIQHandler *pHandler, void *pParam);
 	void DisconnectFIQ (void);
 
@@ -52,6 +72,19 @@ public:
 
 	static void InterruptHandler (void);
 
+#ifdef USE_SCHEDULER_PREEMPTION
+	// the handler is called on each core, before returning from an IRQ (IRQs disabled)
+	// it may switch to another task, the interrupted context is saved on the task stack
+	static void RegisterIRQReturnHandler (TIRQReturnHandler *pHandler);
+	static void CallIRQReturnHandler (void)
+	{
+		if (s_pIRQReturnHandler != 0)
+		{
+			(*s_pIRQReturnHandler) ();
+		}
+	}
+#endif
+
 #if RASPPI >= 4
 	static void InitializeSecondary (void);
 
@@ -68,7 +101,16 @@ private:
 	TIRQHandler	*m_apIRQHandler[IRQ_LINES];
 	void		*m_pParam[IRQ_LINES];
 
+#if RASPPI >= 4
+	TIRQHandler	*m_apPrivateIRQHandler[CORES][IRQ_PRIVATE_LINES];
+	void		*m_pPrivateParam[CORES][IRQ_PRIVATE_LINES];
+#endif
+
 	static CInterruptSystem *s_pThis;
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	static TIRQReturnHandler *s_pIRQReturnHandler;
+#endif
 };
 
 #endif
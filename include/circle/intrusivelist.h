@@ -0,0 +1,250 @@
+//
+// intrusivelist.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_intrusivelist_h
+#define _circle_intrusivelist_h
+
+#include <circle/types.h>
+#include <assert.h>
+
+/// \brief Links of an object, which is member of a CIntrusiveList<T, Tag>
+/// \note Derive T from CIntrusiveListNode<T> (use different Tag classes for multiple lists)
+template <class T, class Tag = void>
+class CIntrusiveListNode
+{
+public:
+	CIntrusiveListNode (void)
+	:	m_pPrev (0),
+		m_pNext (0),
+		m_bLinked (FALSE)
+	{
+	}
+
+	~CIntrusiveListNode (void)
+	{
+		assert (!m_bLinked);
+	}
+
+	/// \return Is this object currently member of a list?
+	boolean IsLinked (void) const	{ return m_bLinked; }
+
+private:
+	T	*m_pPrev;
+	T	*m_pNext;
+	boolean	 m_bLinked;
+
+	template <class, class> friend class CIntrusiveList;
+};
+
+/// \brief Doubly linked list, which uses the links embedded in the objects (no allocation)
+/// \note Objects are not owned by the list and must be removed, before they are destroyed
+template <class T, class Tag = void>
+class CIntrusiveList
+{
+	typedef CIntrusiveListNode<T, Tag> TNode;
+
+public:
+	CIntrusiveList (void)
+	:	m_pFirst (0),
+		m_pLast (0),
+		m_nCount (0)
+	{
+	}
+
+	~CIntrusiveList (void)
+	{
+		assert (m_pFirst == 0);
+	}
+
+	boolean IsEmpty (void) const	{ return m_pFirst == 0; }
+	unsigned GetCount (void) const	{ return m_nCount; }
+
+	/// \return First object or 0, if list is empty
+	T *GetFirst (void) const	{ return m_pFirst; }
+	/// \return Last object or 0, if list is empty
+	T *GetLast (void) const		{ return m_pLast; }
+
+	/// \return Next object or 0, if pObject is the last one
+	static T *GetNext (const T *pObject)
+	{
+		assert (pObject != 0);
+		return Node (pObject)->m_pNext;
+	}
+
+	/// \return Previous object or 0, if pObject is the first one
+	static T *GetPrevious (const T *pObject)
+	{
+		assert (pObject != 0);
+		return Node (pObject)->m_pPrev;
+	}
+
+	void InsertHead (T *pObject)
+	{
+		TNode *pNode = Link (pObject);
+
+		pNode->m_pNext = m_pFirst;
+		if (m_pFirst != 0)
+		{
+			Node (m_pFirst)->m_pPrev = pObject;
+		}
+		else
+		{
+			m_pLast = pObject;
+		}
+		m_pFirst = pObject;
+	}
+
+	void InsertTail (T *pObject)
+	{
+		TNode *pNode = Link (pObject);
+
+		pNode->m_pPrev = m_pLast;
+		if (m_pLast != 0)
+		{
+			Node (m_pLast)->m_pNext = pObject;
+		}
+		else
+		{
+			m_pFirst = pObject;
+		}
+		m_pLast = pObject;
+	}
+
+	/// \brief Insert pObject after pPosition (which is member of this list)
+	void InsertAfter (T *pPosition, T *pObject)
+	{
+		assert (pPosition != 0);
+		TNode *pPosNode = Node (pPosition);
+		assert (pPosNode->m_bLinked);
+
+		if (pPosNode->m_pNext == 0)
+		{
+			InsertTail (pObject);
+
+			return;
+		}
+
+		TNode *pNode = Link (pObject);
+
+		pNode->m_pPrev = pPosition;
+		pNode->m_pNext = pPosNode->m_pNext;
+		Node (pPosNode->m_pNext)->m_pPrev = pObject;
+		pPosNode->m_pNext = pObject;
+	}
+
+	/// \brief Insert pObject before pPosition (which is member of this list)
+	void InsertBefore (T *pPosition, T *pObject)
+	{
+		assert (pPosition != 0);
+		TNode *pPosNode = Node (pPosition);
+		assert (pPosNode->m_bLinked);
+
+		if (pPosNode->m_pPrev == 0)
+		{
+			InsertHead (pObject);
+
+			return;
+		}
+
+		InsertAfter (pPosNode->m_pPrev, pObject);
+	}
+
+	void Remove (T *pObject)
+	{
+		assert (pObject != 0);
+		TNode *pNode = Node (pObject);
+		assert (pNode->m_bLinked);
+
+		if (pNode->m_pPrev != 0)
+		{
+			Node (pNode->m_pPrev)->m_pNext = pNode->m_pNext;
+		}
+		else
+		{
+			assert (m_pFirst == pObject);
+			m_pFirst = pNode->m_pNext;
+		}
+
+		if (pNode->m_pNext != 0)
+		{
+			Node (pNode->m_pNext)->m_pPrev = pNode->m_pPrev;
+		}
+		else
+		{
+			assert (m_pLast == pObject);
+			m_pLast = pNode->m_pPrev;
+		}
+
+		pNode->m_pPrev = 0;
+		pNode->m_pNext = 0;
+		pNode->m_bLinked = FALSE;
+
+		assert (m_nCount > 0);
+		m_nCount--;
+	}
+
+	/// \return Removed first object or 0, if list is empty
+	T *RemoveHead (void)
+	{
+		T *pObject = m_pFirst;
+		if (pObject != 0)
+		{
+			Remove (pObject);
+		}
+
+		return pObject;
+	}
+
+	/// \brief Unlink all objects
+	void RemoveAll (void)
+	{
+		while (m_pFirst != 0)
+		{
+			Remove (m_pFirst);
+		}
+	}
+
+private:
+	static TNode *Node (const T *pObject)
+	{
+		return static_cast<TNode *> (const_cast<T *> (pObject));
+	}
+
+	TNode *Link (T *pObject)
+	{
+		assert (pObject != 0);
+		TNode *pNode = Node (pObject);
+		assert (!pNode->m_bLinked);
+
+		pNode->m_bLinked = TRUE;
+		pNode->m_pPrev = 0;
+		pNode->m_pNext = 0;
+
+		m_nCount++;
+
+		return pNode;
+	}
+
+private:
+	T	 *m_pFirst;
+	T	 *m_pLast;
+	unsigned  m_nCount;
+};
+
+#endif
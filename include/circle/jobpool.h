@@ -0,0 +1,114 @@
+//
+// jobpool.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_jobpool_h
+#define _circle_jobpool_h
+
+#include <circle/sysconfig.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/multicore.h>
+#include <circle/spinlock.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+#define JOB_POOL_QUEUE_SIZE	256		// jobs per core, must be a power of 2
+
+typedef void TJobFunction (void *pParam);
+/// \note nEnd is the first index, which does not belong to the range any more
+typedef void TParallelForFunction (unsigned nBegin, unsigned nEnd, void *pParam);
+
+/// \note Each core has its own queue of jobs. A core takes new jobs from its own queue
+///	  (last in, first out) and steals jobs from the queues of the other cores (first in,
+///	  first out), when its own queue is empty. Idle secondary cores wait for an event and
+///	  are waken with an IPI, when new jobs have been submitted.
+
+class CJobPool	/// Work-stealing pool of small jobs, which are executed on all CPU cores
+{
+public:
+	CJobPool (void);
+	~CJobPool (void);
+
+	/// \brief Execute jobs on the calling (secondary) core, until Stop() is called
+	/// \note Call this from CMultiCoreSupport::Run() on each core, which should help.
+	void RunWorker (void);
+	/// \brief Cause RunWorker() to return on all cores
+	void Stop (void);
+
+	/// \brief Queue a job on the calling core
+	/// \param pFunction Function to be called
+	/// \param pParam User parameter handed over to the function
+	/// \note The job will be executed directly, if the queue of this core is full.
+	void Submit (TJobFunction *pFunction, void *pParam = 0);
+
+	/// \brief Process a range of indices in parallel and wait for completion
+	/// \param nBegin First index of the range
+	/// \param nEnd First index, which does not belong to the range any more
+	/// \param nGrainSize Maximum number of indices, which are handled by one job
+	/// \param pFunction Function to be called for each sub-range
+	/// \param pParam User parameter handed over to the function
+	/// \note The calling core works on the jobs too.
+	void ParallelFor (unsigned nBegin, unsigned nEnd, unsigned nGrainSize,
+			  TParallelForFunction *pFunction, void *pParam = 0);
+
+	/// \brief Wait until all submitted jobs have been completed
+	/// \note The calling core helps executing the jobs meanwhile.
+	void WaitAll (void);
+
+private:
+	struct TJob
+	{
+		TJobFunction		*pFunction;
+		TParallelForFunction	*pForFunction;
+		void			*pParam;
+		unsigned		 nBegin;
+		unsigned		 nEnd;
+	};
+
+	void Push (const TJob &rJob);
+	boolean ExecuteOne (unsigned nCore);		// returns FALSE, if no job was found
+	boolean Take (unsigned nCore, TJob *pJob);	// from own queue
+	boolean Steal (unsigned nCore, TJob *pJob);	// from other queue
+	static void Execute (const TJob &rJob);
+
+	void WakeWorkers (void);
+
+private:
+	struct TQueue
+	{
+		TJob		Job[JOB_POOL_QUEUE_SIZE];
+		unsigned	nHead;		// next to be stolen
+		unsigned	nTail;		// next free entry
+		CSpinLock	SpinLock;
+	}
+	CACHE_ALIGN;
+
+	TQueue m_Queue[CORES];
+
+	volatile int m_nQueued;			// jobs in all queues
+	volatile int m_nPending;		// jobs not yet completed
+
+	volatile boolean m_bSleeping[CORES];
+	volatile boolean m_bStop;
+};
+
+#endif
+
+#endif
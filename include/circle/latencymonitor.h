@@ -0,0 +1,128 @@
+//
+// latencymonitor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_latencymonitor_h
+#define _circle_latencymonitor_h
+
+#include <circle/sysconfig.h>
+#include <circle/memorymap.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define LATENCY_MONITOR_CORES	CORES
+#else
+	#define LATENCY_MONITOR_CORES	1
+#endif
+
+// Histogram buckets: values below 16 ns have their own bucket, above that each power
+// of two is divided into 8 buckets, which gives a maximum relative error of 12.5%.
+#define LATENCY_LINEAR_BUCKETS		16
+#define LATENCY_SUB_BUCKETS		8
+#define LATENCY_BUCKETS			(LATENCY_LINEAR_BUCKETS + 28*LATENCY_SUB_BUCKETS)
+
+enum TLatencySource
+{
+	LatencyIRQEntry,		///< Timer compare match to entry of the system timer handler
+	LatencyTaskWakeup,		///< CSynchronizationEvent::Set() (etc.) to the task running
+	LatencyDispatch,		///< Expiry of a sleep or wait timeout to the task running
+	LatencySourceUnknown
+};
+
+struct TLatencyStatistics	/// Result of CLatencyMonitor::GetStatistics() (values in ns)
+{
+	u64	 nCount;
+	unsigned nMin;
+	unsigned nMax;
+	unsigned nP50;
+	unsigned nP99;
+	unsigned nP999;
+};
+
+/// \note The measurements are taken by hooks in CTimer and CScheduler, which are enabled
+///	  with the system option LATENCY_MONITOR. The samples are recorded, while an instance
+///	  of CLatencyMonitor exists. Each core has its own histograms, which are written
+///	  without locking. Results are merged, when they are read.
+/// \note Percentiles are given as the upper bound of the histogram bucket, where they are
+///	  located, so they are never lower than the real value.
+
+class CLatencyMonitor		/// Continuously records latency histograms of the system
+{
+public:
+	CLatencyMonitor (void);
+	~CLatencyMonitor (void);
+
+	/// \brief Clear all histograms
+	void Reset (void);
+
+	/// \param Source Latency source to be evaluated
+	/// \param pStatistics Pointer to buffer for the result
+	void GetStatistics (TLatencySource Source, TLatencyStatistics *pStatistics) const;
+
+	/// \param Source Latency source to be evaluated
+	/// \param nPerMille Percentile in 1/1000 (e.g. 999 for p99.9)
+	/// \return Latency in ns, which is not exceeded by this share of the samples
+	unsigned GetPercentile (TLatencySource Source, unsigned nPerMille) const;
+
+	/// \brief Writes the statistics of all sources to the logger
+	void Dump (void) const;
+
+	/// \brief Add a sample (used by the system hooks)
+	/// \param Source Latency source of this sample
+	/// \param nNanoSeconds Measured latency
+	static void Record (TLatencySource Source, unsigned nNanoSeconds)
+	{
+		if (s_pThis != 0)
+		{
+			s_pThis->AddSample (Source, nNanoSeconds);
+		}
+	}
+
+	/// \return Is an instance of CLatencyMonitor active?
+	static boolean IsActive (void)
+	{
+		return s_pThis != 0;
+	}
+
+	static const char *GetSourceName (TLatencySource Source);
+
+	/// \return Index of the histogram bucket for this value (0..LATENCY_BUCKETS-1)
+	static unsigned GetBucket (unsigned nNanoSeconds);
+	/// \return Upper bound of the values in the histogram bucket
+	static unsigned GetBucketLimit (unsigned nBucket);
+
+private:
+	void AddSample (TLatencySource Source, unsigned nNanoSeconds);
+
+	void Merge (TLatencySource Source, u64 *pCount, unsigned *pMin, unsigned *pMax) const;
+	unsigned FindPercentile (TLatencySource Source, u64 nCount, unsigned nPerMille) const;
+
+private:
+	struct THistogram
+	{
+		u32	 nBucket[LATENCY_BUCKETS];
+		u32	 nCount;
+		unsigned nMin;
+		unsigned nMax;
+	}
+	m_Histogram[LATENCY_MONITOR_CORES][LatencySourceUnknown];
+
+	static CLatencyMonitor *s_pThis;
+};
+
+#endif
@@ -24,15 +24,30 @@
 #include <circle/timer.h>
 #include <circle/stdarg.h>
 #include <circle/spinlock.h>
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/sysconfig.h>
 #include <circle/time.h>
 #include <circle/types.h>
 
 #define LOG_MAX_SOURCE		50
 #define LOG_MAX_MESSAGE		200
 #define LOG_QUEUE_SIZE		50
+#define LOG_MAX_FIELDS		4		///< Key/value fields per log event
+#define LOG_MAX_FIELD_KEY	16
+#define LOG_MAX_FIELD_VALUE	40
 
 #define LOGGER_BUFSIZE		0x4000		///< Size of the text ring buffer
 
+#define LOG_DEFERRED_RECORDS	64		///< Per core, must be a power of 2
+#define LOG_DEFERRED_MAX_ARGS	6
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define LOG_DEFERRED_CORES	CORES
+#else
+	#define LOG_DEFERRED_CORES	1
+#endif
+
 enum TLogSeverity
 {
 	LogPanic,	///< Halt the system after processing this message
@@ -42,7 +57,27 @@ enum TLogSeverity
 	LogDebug	///< Message, which is only interesting for debugging this component
 };
 
-struct TLogEvent;
+struct TLogField			/// Key/value field of a structured log message
+{
+	const char	*pKey;
+	const char	*pValue;
+};
+
+struct TLogEvent			/// Structured log record, as returned by CLogger::ReadEvent()
+{
+	TLogSeverity	Severity;
+	char		Source[LOG_MAX_SOURCE];
+	char		Message[LOG_MAX_MESSAGE];
+	time_t		Time;
+	unsigned	nHundredthTime;
+	int		nTimeZone;			///< minutes diff to UTC
+	unsigned	nCore;				///< core, which has written the message
+	unsigned	nFields;
+	char		FieldKey[LOG_MAX_FIELDS][LOG_MAX_FIELD_KEY];
+	char		FieldValue[LOG_MAX_FIELDS][LOG_MAX_FIELD_VALUE];
+};
+
+struct TLogRecord;
 
 typedef void TLogEventNotificationHandler (void);
 typedef void TLogPanicHandler (void);
@@ -74,9 +109,38 @@ public:
 	/// \param Args	    Arguments of the log message
 	void WriteV (const char *pSource, TLogSeverity Severity, const char *pMessage, va_list Args);
 
+	/// \brief Write a log message with additional key/value fields
+	/// \param pSource  Module name of the originator of the log message
+	/// \param Severity Severity of the log message
+	/// \param pFields  Array of key/value fields (up to LOG_MAX_FIELDS are recorded)
+	/// \param nFields  Number of entries in pFields
+	/// \param pMessage Format string of the log message (arguments follow)
+	/// \note The fields are appended to the text as " key=value" and are available
+	///	  separately in the log event (see ReadEvent()).
+	void WriteFields (const char *pSource, TLogSeverity Severity,
+			  const TLogField *pFields, unsigned nFields, const char *pMessage, ...);
+
 	/// \brief Does not allocate memory, for critical (low memory) messages
 	void WriteNoAlloc (const char *pSource, TLogSeverity Severity, const char *pMessage);
 
+	/// \brief Queues a log message, which is formatted and written later by FlushDeferred()
+	/// \param pSource  Module name of the originator of the log message
+	/// \param Severity Severity of the log message (LogPanic is written immediately)
+	/// \param pMessage Format string of the log message (arguments follow)
+	/// \return FALSE, if the message has been dropped, because the buffer is full
+	/// \note Only the pointers to pSource and pMessage and the arguments (up to
+	///	  LOG_DEFERRED_MAX_ARGS) are copied into a buffer of the calling core. Therefore
+	///	  pSource, pMessage and the strings for "%s" must be constant (e.g. literals).
+	/// \note Can be called from TASK_LEVEL and IRQ_LEVEL, but not from an FIQ handler.
+	boolean WriteDeferred (const char *pSource, TLogSeverity Severity, const char *pMessage, ...);
+
+	/// \brief Formats and writes all queued deferred messages to the target
+	/// \note This is done by CLogDrainTask, if the scheduler is used.
+	void FlushDeferred (void);
+
+	/// \return Are deferred messages waiting to be written?
+	boolean HasDeferred (void) const;
+
 	/// \brief Read log message text from the log text ring buffer
 	/// \param pBuffer Read text is copied to this buffer
 	/// \param nCount  Size of the buffer
@@ -95,6 +159,11 @@ public:
 	boolean ReadEvent (TLogSeverity *pSeverity, char *pSource, char *pMessage,
 			   time_t *pTime, unsigned *pHundredthTime, int *pTimeZone);
 
+	/// \brief Read the next structured log record from the log event ring buffer
+	/// \param pEvent Log record is returned here
+	/// \return FALSE if event is not available
+	boolean ReadEvent (TLogEvent *pEvent);
+
 	/// \brief Register handler which is called, when a log event arrives
 	void RegisterEventNotificationHandler (TLogEventNotificationHandler *pHandler);
 	/// \brief Register handler which is called, before the system is halted
@@ -105,9 +174,18 @@ public:
 	static CLogger *Get (void);
 
 private:
+	void WriteMessage (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			   const TLogField *pFields = 0, unsigned nFields = 0);
+
+	// returns the length of the complete line, which is truncated, if >= nSize
+	static size_t FormatLine (char *pBuffer, size_t nSize, const char *pPrefix,
+				  const CString *pTimeString, const char *pSource, const char *pMessage,
+				  const TLogField *pFields, unsigned nFields, const char *pSuffix);
+
 	void Write (const char *pString);
 
-	void WriteEvent (const char *pSource, TLogSeverity Severity, const char *pMessage);
+	void WriteEvent (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			 const TLogField *pFields, unsigned nFields);
 
 private:
 	unsigned m_nLogLevel;
@@ -129,6 +207,17 @@ private:
 	TLogEventNotificationHandler *m_pEventNotificationHandler;
 	TLogPanicHandler *m_pPanicHandler;
 
+	struct TDeferredBuffer
+	{
+		TLogRecord *pRecord;		// ring buffer of LOG_DEFERRED_RECORDS entries
+		volatile unsigned nDropped;
+		// each index is written by one side only, keep them in separate cache lines
+		volatile unsigned nIn ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+		volatile unsigned nOut ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+	}
+	m_Deferred[LOG_DEFERRED_CORES];
+	CSpinLock m_FlushSpinLock;
+
 	static CLogger *s_pThis;
 };
 
@@ -136,9 +225,52 @@ private:
 #define LOGMODULE(name)		static const char From[] = name
 
 #define LOGPANIC(...)		CLogger::Get ()->Write (From, LogPanic, __VA_ARGS__)
-#define LOGERR(...)		CLogger::Get ()->Write (From, LogError, __VA_ARGS__)
-#define LOGWARN(...)		CLogger::Get ()->Write (From, LogWarning, __VA_ARGS__)
-#define LOGNOTE(...)		CLogger::Get ()->Write (From, LogNotice, __VA_ARGS__)
-#define LOGDBG(...)		CLogger::Get ()->Write (From, LogDebug, __VA_ARGS__)
+/// Log messages with a severity above LOG_MAX_LEVEL (see circle/sysconfig.h) are removed
+/// at compile time, the arguments are not evaluated then.
+#define LOG_LEVEL_ENABLED(level)	((level) <= LOG_MAX_LEVEL)
+
+#if LOG_LEVEL_ENABLED (1)
+	#define LOGERR(...)		CLogger::Get ()->Write (From, LogError, __VA_ARGS__)
+	#define LOGERR_DEFERRED(...)	CLogger::Get ()->WriteDeferred (From, LogError, __VA_ARGS__)
+	#define LOGERR_FIELDS(fields, num, ...)	\
+		CLogger::Get ()->WriteFields (From, LogError, fields, num, __VA_ARGS__)
+#else
+	#define LOGERR(...)		((void) 0)
+	#define LOGERR_DEFERRED(...)	((void) 0)
+	#define LOGERR_FIELDS(...)	((void) 0)
+#endif
+
+#if LOG_LEVEL_ENABLED (2)
+	#define LOGWARN(...)		CLogger::Get ()->Write (From, LogWarning, __VA_ARGS__)
+	#define LOGWARN_DEFERRED(...)	CLogger::Get ()->WriteDeferred (From, LogWarning, __VA_ARGS__)
+	#define LOGWARN_FIELDS(fields, num, ...)	\
+		CLogger::Get ()->WriteFields (From, LogWarning, fields, num, __VA_ARGS__)
+#else
+	#define LOGWARN(...)		((void) 0)
+	#define LOGWARN_DEFERRED(...)	((void) 0)
+	#define LOGWARN_FIELDS(...)	((void) 0)
+#endif
+
+#if LOG_LEVEL_ENABLED (3)
+	#define LOGNOTE(...)		CLogger::Get ()->Write (From, LogNotice, __VA_ARGS__)
+	#define LOGNOTE_DEFERRED(...)	CLogger::Get ()->WriteDeferred (From, LogNotice, __VA_ARGS__)
+	#define LOGNOTE_FIELDS(fields, num, ...)	\
+		CLogger::Get ()->WriteFields (From, LogNotice, fields, num, __VA_ARGS__)
+#else
+	#define LOGNOTE(...)		((void) 0)
+	#define LOGNOTE_DEFERRED(...)	((void) 0)
+	#define LOGNOTE_FIELDS(...)	((void) 0)
+#endif
+
+#if LOG_LEVEL_ENABLED (4)
+	#define LOGDBG(...)		CLogger::Get ()->Write (From, LogDebug, __VA_ARGS__)
+	#define LOGDBG_DEFERRED(...)	CLogger::Get ()->WriteDeferred (From, LogDebug, __VA_ARGS__)
+	#define LOGDBG_FIELDS(fields, num, ...)	\
+		CLogger::Get ()->WriteFields (From, LogDebug, fields, num, __VA_ARGS__)
+#else
+	#define LOGDBG(...)		((void) 0)
+	#define LOGDBG_DEFERRED(...)	((void) 0)
+	#define LOGDBG_FIELDS(...)	((void) 0)
+#endif
 
 #endif
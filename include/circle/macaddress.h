@@ -38,6 +38,7 @@ public:
 	void Set (const u8 *pAddress);
 	void SetBroadcast (void);
 	void SetMulticast (const u8 *pIPAddress);
+	void SetMulticastIPv6 (const u8 *pIPv6Address);	// 33:33:xx:xx:xx:xx
 	const u8 *Get (void) const;
 	void CopyTo (u8 *pBuffer) const;
 
@@ -27,6 +27,9 @@ public:
 
 	const CMACAddress *GetMACAddress (void) const;
 
+	// returns NET_DEVICE_CAP_* bit mask
+	unsigned GetCapabilities (void) const;
+
 	// returns TRUE if TX has currently free buffers
 	boolean IsSendFrameAdvisable (void);
 
@@ -35,6 +38,14 @@ public:
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
 
+	// these handle the TCP/UDP checksum offload
+	boolean SendBuffer (CNetBuffer *pFrame);
+	boolean ReceiveBuffer (CNetBuffer *pFrame);
+
+	// interrupt-driven receive
+	boolean RegisterReceiveHandler (TNetReceiveHandler *pHandler, void *pParam);
+	boolean EnableReceiveInterrupt (void);
+
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
 
@@ -45,7 +56,18 @@ public:
 
 	boolean SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE]);
 
+	// IEEE 1588 time stamp unit (timestamps of the last PTP event frames)
+	boolean GetPTPEventTimestamp (boolean bTransmit, u64 *pNanoSeconds);
+	boolean GetPTPClock (u64 *pNanoSeconds);
+	boolean SetPTPClock (u64 nNanoSeconds);
+	boolean AdjustPTPClock (s64 nNanoSeconds);
+	boolean SetPTPClockRate (int nPPB);
+
 private:
+	// nChecksumField is the offset of the TCP/UDP checksum field to be cleared (or 0)
+	boolean SendFrame (const void *pBuffer, unsigned nLength, unsigned nChecksumField);
+	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength, boolean *pChecksumValid);
+
 	static int hash_get_index (const u8 addr[MAC_ADDRESS_SIZE]);
 	static int hash_bit_value (int bitnr, const u8 addr[MAC_ADDRESS_SIZE]);
 
@@ -81,6 +103,12 @@ private:
 
 	static unsigned mii_nway_result (unsigned negotiated);
 
+	void tsu_init (void);
+	void tsu_set_incr (int ppb);
+
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
 private:
 	CMACAddress m_MACAddress;
 
@@ -110,6 +138,12 @@ private:
 	int m_old_duplex;
 
 	CGPIOPin m_PHYResetPin;
+
+	boolean m_bInterruptConnected;
+	TNetReceiveHandler *m_pRxHandler;
+	void *m_pRxParam;
+
+	boolean m_bHasTSU;
 };
 
 #endif
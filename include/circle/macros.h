@@ -35,6 +35,9 @@
 #endif
 #define WEAK		__attribute__ ((weak))
 
+// compile-time check of printf(3)-style arguments (1-based indices, "this" is 1)
+#define PRINTF_FORMAT(fmt, args)	__attribute__ ((format (printf, fmt, args)))
+
 #define likely(exp)	__builtin_expect (!!(exp), 1)
 #define unlikely(exp)	__builtin_expect (!!(exp), 0)
 
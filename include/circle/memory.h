@@ -60,6 +60,8 @@ public:
 #define COHERENT_SLOT_MACB_START	4
 #define COHERENT_SLOT_MACB_END		(4 + 256*1024 / PAGE_SIZE - 1)
 
+#define COHERENT_SLOT_PROP_MAILBOX_ASYNC	(COHERENT_SLOT_MACB_END + 1)
+
 #define COHERENT_SLOT_VCHIQ_START	(MEGABYTE / PAGE_SIZE / 2)
 #define COHERENT_SLOT_VCHIQ_END		(MEGABYTE / PAGE_SIZE - 1)
 
@@ -71,52 +73,68 @@ public:
 	static CMemorySystem *Get (void);
 
 public:
-	static void *HeapAllocate (size_t nSize, int nType)
+	static void *HeapAllocate (size_t nSize, int nType, uintptr nCallerPC = 0)
 #define HEAP_LOW	0		// memory below 1 GB
 #define HEAP_HIGH	1		// memory above 1 GB
 #define HEAP_ANY	2		// high memory (if available) or low memory (otherwise)
 #define HEAP_DMA30	HEAP_LOW	// 30-bit DMA-able memory
+#define HEAP_COHERENT	3		// DMA coherent pool (non-cacheable, no cache maintenance)
 	{
 #if RASPPI >= 4
 		void *pBlock;
 
 		switch (nType)
 		{
-		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize);
-		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize);
-		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize)) != 0
+		case HEAP_COHERENT: return s_pThis->m_HeapCoherent.Allocate (nSize, nCallerPC);
+		case HEAP_LOW:	return s_pThis->m_HeapLow.Allocate (nSize, nCallerPC);
+		case HEAP_HIGH: return s_pThis->m_HeapHigh.Allocate (nSize, nCallerPC);
+		case HEAP_ANY:	return   (pBlock = s_pThis->m_HeapHigh.Allocate (nSize, nCallerPC)) != 0
 				       ? pBlock
-				       : s_pThis->m_HeapLow.Allocate (nSize);
+				       : s_pThis->m_HeapLow.Allocate (nSize, nCallerPC);
 		default:	return 0;
 		}
 #else
 		switch (nType)
 		{
+		case HEAP_COHERENT: return s_pThis->m_HeapCoherent.Allocate (nSize, nCallerPC);
 		case HEAP_LOW:
-		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize);
+		case HEAP_ANY:	return s_pThis->m_HeapLow.Allocate (nSize, nCallerPC);
 		default:	return 0;
 		}
 #endif
 	}
 
-	static void *HeapReAllocate (void *pBlock, size_t nSize)	// pBlock may be 0
+	static void *HeapReAllocate (void *pBlock, size_t nSize,	// pBlock may be 0
+				     uintptr nCallerPC = 0)
 	{
+		if (IsCoherentBlock (pBlock))
+		{
+			return s_pThis->m_HeapCoherent.ReAllocate (pBlock, nSize, nCallerPC);
+		}
+
 #if RASPPI >= 4
 		if ((uintptr) pBlock < MEM_HIGHMEM_START)
 		{
-			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCallerPC);
 		}
 		else
 		{
-			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize);
+			return s_pThis->m_HeapHigh.ReAllocate (pBlock, nSize, nCallerPC);
 		}
 #else
-		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize);
+		return s_pThis->m_HeapLow.ReAllocate (pBlock, nSize, nCallerPC);
 #endif
 	}
 
 	static void HeapFree (void *pBlock)
 	{
+		if (IsCoherentBlock (pBlock))
+		{
+			s_pThis->m_HeapCoherent.Free (pBlock);
+
+			return;
+		}
+
 #if RASPPI >= 4
 		if ((uintptr) pBlock < MEM_HIGHMEM_START)
 		{
@@ -140,6 +158,7 @@ public:
 		case HEAP_HIGH: return s_pThis->m_HeapHigh.GetFreeSpace ();
 		case HEAP_ANY:	return   s_pThis->m_HeapLow.GetFreeSpace ()
 				       + s_pThis->m_HeapHigh.GetFreeSpace ();
+		case HEAP_COHERENT: return s_pThis->m_HeapCoherent.GetFreeSpace ();
 		default:	return 0;
 		}
 #else
@@ -147,22 +166,64 @@ public:
 		{
 		case HEAP_LOW:
 		case HEAP_ANY:	return s_pThis->m_HeapLow.GetFreeSpace ();
+		case HEAP_COHERENT: return s_pThis->m_HeapCoherent.GetFreeSpace ();
 		default:	return 0;
 		}
 #endif
 	}
 
+	// nType is HEAP_LOW, HEAP_HIGH or HEAP_COHERENT
+	static boolean GetHeapStatistics (int nType, THeapStatistics *pStats)
+	{
+		switch (nType)
+		{
+		case HEAP_COHERENT: s_pThis->m_HeapCoherent.GetStatistics (pStats); return TRUE;
+		case HEAP_LOW:	s_pThis->m_HeapLow.GetStatistics (pStats);	return TRUE;
+#if RASPPI >= 4
+		case HEAP_HIGH: s_pThis->m_HeapHigh.GetStatistics (pStats);	return TRUE;
+#endif
+		default:	return FALSE;
+		}
+	}
+
+	// records every nInterval-th allocation on all heaps (0 to disable)
+	static void SetHeapSampleInterval (unsigned nInterval)
+	{
+		s_pThis->m_HeapLow.SetSampleInterval (nInterval);
+#if RASPPI >= 4
+		s_pThis->m_HeapHigh.SetSampleInterval (nInterval);
+#endif
+		s_pThis->m_HeapCoherent.SetSampleInterval (nInterval);
+	}
+
+	static unsigned GetHeapSamples (int nType, THeapSample *pBuffer, unsigned nMaxSamples)
+	{
+		switch (nType)
+		{
+		case HEAP_COHERENT: return s_pThis->m_HeapCoherent.GetSamples (pBuffer, nMaxSamples);
+		case HEAP_LOW:	return s_pThis->m_HeapLow.GetSamples (pBuffer, nMaxSamples);
+#if RASPPI >= 4
+		case HEAP_HIGH: return s_pThis->m_HeapHigh.GetSamples (pBuffer, nMaxSamples);
+#endif
+		default:	return 0;
+		}
+	}
+
+#if AARCH == 64
+	// changes the attributes of an address region (see CTranslationTable::SetRegionAttributes())
+	static boolean SetMemoryAttributes (uintptr nBaseAddress, size_t nSize, unsigned nAttributes);
+#endif
+
 	static void *PageAllocate (void)	{ return s_pThis->m_Pager.Allocate (); }
 	static void PageFree (void *pPage)	{ s_pThis->m_Pager.Free (pPage); }
 
 	static void DumpStatus (void)
 	{
-#ifdef HEAP_DEBUG
 		s_pThis->m_HeapLow.DumpStatus ();
 #if RASPPI >= 4
 		s_pThis->m_HeapHigh.DumpStatus ();
 #endif
-#endif
+		s_pThis->m_HeapCoherent.DumpStatus ();
 
 #ifdef PAGE_DEBUG
 		s_pThis->m_Pager.DumpStatus ();
@@ -172,6 +233,12 @@ public:
 private:
 	void EnableMMU (void);
 
+	static boolean IsCoherentBlock (const void *pBlock)
+	{
+		return    (uintptr) pBlock >= MEM_DMA_COHERENT_POOL
+		       && (uintptr) pBlock <  MEM_DMA_COHERENT_POOL + DMA_COHERENT_POOL_SIZE;
+	}
+
 private:
 	boolean m_bEnableMMU;
 	size_t m_nMemSize;
@@ -181,6 +248,7 @@ private:
 #if RASPPI >= 4
 	CHeapAllocator m_HeapHigh;
 #endif
+	CHeapAllocator m_HeapCoherent;		// DMA coherent pool
 	CPageAllocator m_Pager;
 
 #if AARCH == 32
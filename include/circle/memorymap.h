@@ -64,14 +64,20 @@
 // coherent memory region (one 1 MB section)
 #define MEM_COHERENT_REGION	((MEM_PAGE_TABLE1_END + 2*MEGABYTE) & ~(MEGABYTE-1))
 
-#define MEM_HEAP_START		(MEM_COHERENT_REGION + MEGABYTE)
+// DMA coherent pool (one 1 MB section, normal non-cacheable)
+#define MEM_DMA_COHERENT_POOL	(MEM_COHERENT_REGION + MEGABYTE)
+#define DMA_COHERENT_POOL_SIZE	MEGABYTE
 #else
 // coherent memory region (two 2 MB blocks)
 #define MEM_COHERENT_REGION	((MEM_PAGE_TABLE1_END + 3*MEGABYTE) & ~(2*MEGABYTE-1))
 
-#define MEM_HEAP_START		(MEM_COHERENT_REGION + 2*2*MEGABYTE)
+// DMA coherent pool (one 2 MB block, normal non-cacheable)
+#define MEM_DMA_COHERENT_POOL	(MEM_COHERENT_REGION + 2*2*MEGABYTE)
+#define DMA_COHERENT_POOL_SIZE	(2*MEGABYTE)
 #endif
 
+#define MEM_HEAP_START		(MEM_DMA_COHERENT_POOL + DMA_COHERENT_POOL_SIZE)
+
 #if RASPPI >= 4
 // high memory region (memory >= 3 GB is not safe to be DMA-able and is not used)
 #define MEM_HIGHMEM_START		GIGABYTE
@@ -54,14 +54,20 @@
 // coherent memory region (1 MB)
 #define MEM_COHERENT_REGION	((MEM_EXCEPTION_STACK_END + 2*MEGABYTE) & ~(MEGABYTE-1))
 
-#define MEM_HEAP_START		(MEM_COHERENT_REGION + MEGABYTE)
+// DMA coherent pool (1 MB, normal non-cacheable)
+#define MEM_DMA_COHERENT_POOL	(MEM_COHERENT_REGION + MEGABYTE)
+#define DMA_COHERENT_POOL_SIZE	MEGABYTE
 #else
 // coherent memory region (4 MB)
 #define MEM_COHERENT_REGION	((MEM_EXCEPTION_STACK_END + 2*MEGABYTE) & ~(MEGABYTE-1))
 
-#define MEM_HEAP_START		(MEM_COHERENT_REGION + 4*MEGABYTE)
+// DMA coherent pool (2 MB, normal non-cacheable)
+#define MEM_DMA_COHERENT_POOL	(MEM_COHERENT_REGION + 4*MEGABYTE)
+#define DMA_COHERENT_POOL_SIZE	(2*MEGABYTE)
 #endif
 
+#define MEM_HEAP_START		(MEM_DMA_COHERENT_POOL + DMA_COHERENT_POOL_SIZE)
+
 #if RASPPI >= 4
 // high memory region
 #define MEM_HIGHMEM_START		GIGABYTE
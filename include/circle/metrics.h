@@ -0,0 +1,160 @@
+//
+// metrics.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_metrics_h
+#define _circle_metrics_h
+
+#include <circle/spinlock.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define METRIC_HISTOGRAM_MAX_BUCKETS	16	///< Upper bounds of a histogram (without +Inf)
+
+enum TMetricType
+{
+	MetricCounter,
+	MetricGauge,
+	MetricHistogram,
+	MetricTypeUnknown
+};
+
+/// \note Metrics register themselves in the global registry on construction and are
+///	  removed on destruction. They can be defined as global (static) objects. Metrics,
+///	  which have the same name, but different labels, are exported as one family.
+/// \note The names and labels must follow the Prometheus conventions (e.g.
+///	  "circle_tcp_retransmissions_total" and "device=\"eth0\"").
+
+class CMetric		/// Base class of a metric in the registry, exported in Prometheus text format
+{
+public:
+	/// \param pName   Metric name (must be constant)
+	/// \param pHelp   Description of the metric (must be constant)
+	/// \param Type	   Metric type
+	/// \param pLabels Label list without braces (e.g. "device=\"eth0\""), may be 0
+	CMetric (const char *pName, const char *pHelp, TMetricType Type, const char *pLabels);
+	virtual ~CMetric (void);
+
+	const char *GetName (void) const	{ return m_pName; }
+	TMetricType GetType (void) const	{ return m_Type; }
+
+	/// \brief Write all registered metrics in Prometheus text format (version 0.0.4)
+	/// \param pBuffer Pointer to the output buffer
+	/// \param nBufferSize Size of the output buffer
+	/// \return Number of bytes written (output is truncated, if the buffer is too small)
+	static unsigned ExportAll (char *pBuffer, unsigned nBufferSize);
+
+	/// \return Content type of the output of ExportAll() for HTTP
+	static const char *GetContentType (void);
+
+protected:
+	/// \brief Append the sample lines of this metric to the string
+	virtual void WriteSamples (CString *pOutput) const = 0;
+
+	/// \brief Append "name{labels} " to the string
+	/// \param pSuffix Appended to the name (e.g. "_bucket"), may be 0
+	/// \param pExtraLabel Additional label (e.g. "le=\"10\""), may be 0
+	void WriteSampleName (CString *pOutput, const char *pSuffix = 0,
+			      const char *pExtraLabel = 0) const;
+
+	static void AppendU64 (CString *pOutput, u64 nValue);
+	static void AppendS64 (CString *pOutput, s64 nValue);
+
+private:
+	const char *m_pName;
+	const char *m_pHelp;
+	TMetricType m_Type;
+	const char *m_pLabels;
+
+	CMetric *m_pNext;
+
+	static CMetric *s_pFirst;
+	static CSpinLock s_SpinLock;
+};
+
+class CMetricCounter : public CMetric	/// Monotonically increasing counter
+{
+public:
+	CMetricCounter (const char *pName, const char *pHelp, const char *pLabels = 0);
+
+	void Increment (u64 nValue = 1)
+	{
+		__atomic_add_fetch (&m_nValue, nValue, __ATOMIC_RELAXED);
+	}
+
+	u64 Get (void) const
+	{
+		return __atomic_load_n (&m_nValue, __ATOMIC_RELAXED);
+	}
+
+private:
+	void WriteSamples (CString *pOutput) const;
+
+private:
+	u64 m_nValue;
+};
+
+class CMetricGauge : public CMetric	/// Value, which can go up and down
+{
+public:
+	CMetricGauge (const char *pName, const char *pHelp, const char *pLabels = 0);
+
+	void Set (s64 nValue)
+	{
+		__atomic_store_n (&m_nValue, nValue, __ATOMIC_RELAXED);
+	}
+
+	void Add (s64 nValue)
+	{
+		__atomic_add_fetch (&m_nValue, nValue, __ATOMIC_RELAXED);
+	}
+
+	s64 Get (void) const
+	{
+		return __atomic_load_n (&m_nValue, __ATOMIC_RELAXED);
+	}
+
+private:
+	void WriteSamples (CString *pOutput) const;
+
+private:
+	s64 m_nValue;
+};
+
+class CMetricHistogram : public CMetric	/// Distribution of observed values in buckets
+{
+public:
+	/// \param pBounds Ascending upper bounds of the buckets (must be constant)
+	/// \param nBounds Number of bounds (up to METRIC_HISTOGRAM_MAX_BUCKETS)
+	CMetricHistogram (const char *pName, const char *pHelp,
+			  const u64 *pBounds, unsigned nBounds, const char *pLabels = 0);
+
+	void Observe (u64 nValue);
+
+private:
+	void WriteSamples (CString *pOutput) const;
+
+private:
+	const u64 *m_pBounds;
+	unsigned m_nBounds;
+
+	u64 m_nBucket[METRIC_HISTOGRAM_MAX_BUCKETS+1];	// last one is +Inf (not cumulative)
+	u64 m_nSum;
+};
+
+#endif
@@ -2,7 +2,7 @@
 // multicore.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -30,6 +30,8 @@
 
 // inter-processor interrupt (IPI)
 #define IPI_HALT_CORE		0		// halt target core
+#define IPI_WAKE_CORE		1		// wake target core from WFE/WFI, no action
+#define IPI_SOFT_IRQ		2		// reserved for CSoftIRQ (with GIC only)
 #define IPI_USER		10		// first user defineable IPI
 #if RASPPI <= 3
 #define IPI_MAX			31
@@ -89,4 +91,13 @@ private:
 
 #endif
 
+inline unsigned ThisCore (void)		// returns number of current core (0 on single core)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	return CMultiCoreSupport::ThisCore ();
+#else
+	return 0;
+#endif
+}
+
 #endif
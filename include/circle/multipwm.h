@@ -0,0 +1,122 @@
+//
+// multipwm.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_multipwm_h
+#define _circle_multipwm_h
+
+#include <circle/usertimer.h>
+#include <circle/interrupt.h>
+#include <circle/gpiopin.h>
+#include <circle/types.h>
+
+#define MULTIPWM_MAX_CHANNELS	32
+
+/// \class CMultiPWM
+/// \brief Software PWM on up to 32 GPIO pins (GPIO0-31) with a common period
+///
+/// \details The pulse widths of all channels are compiled into a schedule of edges,\n
+/// sorted by time. All active channels are set high at the start of each period and\n
+/// the CUserTimer elapses only once per distinct falling edge, which clears the\n
+/// respective pins at once. The resolution is 1 microsecond. New pulse widths are\n
+/// compiled into a second schedule by Update(), which replaces the current schedule\n
+/// at the next period start.
+///
+/// \note Uses the CUserTimer (system timer channel 1), which cannot be used otherwise.
+/// \note The interrupt latency adds jitter to the edges, use bUseFIQ for critical loads.
+/// \note Not supported on the Raspberry Pi 5.
+
+class CMultiPWM
+{
+public:
+	/// \param pInterruptSystem Pointer to the interrupt system object
+	/// \param nFrequencyHz Frequency of the PWM period in Hz (e.g. 50 for servos)
+	/// \param bUseFIQ Use FIQ instead of IRQ for the user timer
+	CMultiPWM (CInterruptSystem *pInterruptSystem, unsigned nFrequencyHz = 50,
+		   boolean bUseFIQ = FALSE);
+
+	~CMultiPWM (void);
+
+	/// \param nGPIOPin GPIO pin number (0-31), will be set to output
+	/// \return Channel number (or -1 on error)
+	int AddChannel (unsigned nGPIOPin);
+
+	/// \param nChannel Channel number returned by AddChannel()
+	/// \param nMicros Pulse width in microseconds (0: always low, >= period: always high)
+	/// \note Takes effect with the next Update() or Start().
+	void SetPulseWidth (unsigned nChannel, unsigned nMicros);
+
+	/// \param nChannel Channel number returned by AddChannel()
+	/// \param nValue Duty cycle value (<= nRange)
+	/// \param nRange Range of the duty cycle value
+	/// \note Takes effect with the next Update() or Start().
+	void SetDutyCycle (unsigned nChannel, unsigned nValue, unsigned nRange = 1000);
+
+	/// \brief Applies the pulse widths set before at the next period start
+	/// \note Waits until a previous update has been applied, if necessary.
+	void Update (void);
+
+	/// \brief Starts the PWM output
+	/// \return Operation successful?
+	boolean Start (void);
+	/// \brief Stops the PWM output, all channels are set low
+	void Stop (void);
+
+	/// \return Period length in microseconds
+	unsigned GetPeriod (void) const		{ return m_nPeriodMicros; }
+
+private:
+	struct TSchedule;
+	void Compile (TSchedule *pSchedule);
+
+	void TimerHandler (void);
+	static void TimerStub (CUserTimer *pUserTimer, void *pParam);
+
+private:
+	CUserTimer m_UserTimer;
+	unsigned m_nPeriodMicros;
+
+	unsigned m_nChannels;
+	CGPIOPin m_Pin[MULTIPWM_MAX_CHANNELS];
+	unsigned m_nPulseWidth[MULTIPWM_MAX_CHANNELS];
+
+	struct TEdge
+	{
+		u32	nOffset;		// microseconds after the period start
+		u32	nClearMask;		// pins going low at this time
+	};
+
+	struct TSchedule
+	{
+		u32	nSetMask;		// pins going high at the period start
+		u32	nAllMask;		// pins of all channels
+		unsigned nEdges;
+		TEdge	Edge[MULTIPWM_MAX_CHANNELS];
+	};
+
+	TSchedule m_Schedule[2];
+	volatile unsigned m_nActive;		// index of the playing schedule
+	volatile boolean m_bSwapPending;	// other schedule is waiting to be played
+
+	boolean m_bRunning;
+	unsigned m_nNextEdge;			// 0: period start, n: Edge[n-1]
+	u32 m_nPeriodStart;			// counter value of the current period start
+	u32 m_nNextCompare;
+};
+
+#endif
@@ -27,9 +27,16 @@
 #include <circle/macaddress.h>
 #include <circle/timer.h>
 #include <circle/spinlock.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
-#define ARP_MAX_ENTRIES		20
+#define ARP_HASH_SIZE		256		// must be a power of 2
+
+#define ARP_NO_ENTRY		((u16) -1)
+
+#if ARP_CACHE_SIZE >= 0xFFFF
+	#error ARP_CACHE_SIZE is too big
+#endif
 
 enum TARPState
 {
@@ -49,7 +56,10 @@ struct TARPEntry
 	TKernelTimerHandle	hTimer;
 	unsigned		nAttempts;
 	unsigned		nTicksLastUsed;
-	CNetQueue		*pTxQueue;		// deferred frames
+	unsigned		nTicksConfirmed;	// last time a packet was received from it
+	unsigned		nTicksRefresh;		// last refresh request has been sent
+	u16			nNext;			// in hash chain or free list
+	CNetQueue		*pTxQueue;		// deferred frames (allocated on demand)
 };
 
 class CLinkLayer;
@@ -66,6 +76,17 @@ public:
 	// frame is queued, if resolve fails
 	boolean Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAddress,
 			 const void *pFrame, unsigned nFrameLength);
+
+	// returns TRUE, if Resolve() will succeed for this address (and not queue the frame)
+	boolean IsResolved (const CIPAddress &rIPAddress);
+
+	// for cached flows: returns FALSE, if the address is not resolved (nothing is sent),
+	// *pEntry is valid, as long as GetGeneration() does not change
+	boolean Lookup (const CIPAddress &rIPAddress, CMACAddress *pMACAddress, unsigned *pEntry);
+	// an entry has been freed or a MAC address has changed, since the generation was read
+	unsigned GetGeneration (void) const;
+	// marks the entry as used (is refreshed before it expires then)
+	void Touch (unsigned nEntry);
 	
 private:
 	void ReplyReceived (const CIPAddress &rForeignIP, const CMACAddress &rForeignMAC);
@@ -73,6 +94,14 @@ private:
 
 	void SendPacket (boolean bRequest, const CIPAddress &rForeignIP, const CMACAddress &rForeignMAC);
 
+	void RefreshEntries (void);		// refresh used entries before they expire
+
+	// hash table, must be called with m_SpinLock acquired
+	static unsigned Hash (const u8 *pIPAddress);
+	TARPEntry *Lookup (const CIPAddress &rIPAddress);
+	unsigned AllocateEntry (const CIPAddress &rIPAddress);	// returns index
+	void FreeEntry (unsigned nEntry);
+
 	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
 
 private:
@@ -81,11 +110,16 @@ private:
 	CLinkLayer	*m_pLinkLayer;
 	CNetQueue	*m_pRxQueue;
 
-	unsigned  m_nEntries;
-	TARPEntry m_Entry[ARP_MAX_ENTRIES];
+	TARPEntry m_Entry[ARP_CACHE_SIZE];
+	u16	  m_Hash[ARP_HASH_SIZE];	// first entry in hash chain
+	u16	  m_nFreeList;
+	unsigned  m_nEntries;			// used entries
+	unsigned  m_nPending;			// entries waiting for a reply
 	CSpinLock m_SpinLock;
 
-	unsigned m_nTicksLastCleanup;
+	unsigned m_nTicksLastRefresh;
+
+	volatile unsigned m_nGeneration;
 };
 
 #endif
@@ -21,6 +21,7 @@
 #define _circle_net_checksumcalculator_h
 
 #include <circle/net/ipaddress.h>
+#include <circle/netbuffer.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
@@ -47,10 +48,21 @@ public:
 	void SetDestinationAddress (const CIPAddress &rDestIP);
 	
 	u16 Calculate (const void *pBuffer, unsigned nLength);
+	// over all chained segments of pBuffer
+	u16 Calculate (const CNetBuffer *pBuffer);
+	// not complemented checksum of the pseudo header only, which has to be
+	// set in the header, before calling CNetBuffer::SetChecksumPartial()
+	u16 CalculatePseudoHeader (unsigned nLength);
 
 	static u16 SimpleCalculate (const void *pBuffer, unsigned nLength);
 
+	// completes the checksum, requested with CNetBuffer::SetChecksumPartial(), in software
+	static void CompletePartial (CNetBuffer *pBuffer);
+
 private:
+	// from pStart (in the first segment) over all chained segments of pBuffer
+	static u32 CalculateChain (const CNetBuffer *pBuffer, const u8 *pStart, u32 nChecksum);
+
 	static u32 CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum);
 
 	static u16 FoldResult (u32 nChecksum);
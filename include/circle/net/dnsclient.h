@@ -21,7 +21,9 @@
 #define _circle_net_dnsclient_h
 
 #include <circle/net/netsubsystem.h>
+#include <circle/net/dnsresolver.h>
 #include <circle/net/ipaddress.h>
+#include <circle/sched/synchronizationevent.h>
 #include <circle/types.h>
 
 class CDNSClient
@@ -30,15 +32,35 @@ public:
 	CDNSClient (CNetSubSystem *pNetSubSystem);
 	~CDNSClient (void);
 
+	/// \brief Resolve a hostname, blocks until the result is available
+	/// \param pHostname Hostname or IP address string
+	/// \param pIPAddress Resolved address is returned here
+	/// \return Operation successful?
 	boolean Resolve (const char *pHostname, CIPAddress *pIPAddress);
 
+	/// \brief Resolve a hostname without blocking
+	/// \param pHostname Hostname or IP address string
+	/// \param pIPAddress Resolved address is returned here with DNSResolveOK
+	/// \param pHandler Will be called with the result with DNSResolvePending
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return Status
+	TDNSResolveStatus ResolveAsync (const char *pHostname, CIPAddress *pIPAddress,
+					TDNSResolveHandler *pHandler, void *pParam = 0);
+
 private:
 	boolean ConvertIPString (const char *pIPString, CIPAddress *pIPAddress);
 
+	static void ResolveHandler (const CIPAddress *pIPAddress, void *pParam);
+
 private:
-	CNetSubSystem *m_pNetSubSystem;
+	struct TResolveRequest
+	{
+		CIPAddress *pIPAddress;
+		boolean bOK;
+		CSynchronizationEvent Event;
+	};
 
-	static u16 s_nXID;		// transaction ID
+	CNetSubSystem *m_pNetSubSystem;
 };
 
 #endif
@@ -0,0 +1,123 @@
+//
+// dnsresolver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_dnsresolver_h
+#define _circle_net_dnsresolver_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/socket.h>
+#include <circle/types.h>
+
+#define DNS_CACHE_SIZE		32
+#define DNS_MAX_HOSTNAME	255
+
+enum TDNSResolveStatus
+{
+	DNSResolveOK,			///< Address is available now (from cache)
+	DNSResolvePending,		///< Query is running, the handler will be called
+	DNSResolveFailed		///< Cannot resolve (e.g. unknown host, cached negative result)
+};
+
+/// \param pIPAddress Resolved address (0 on failure)
+/// \param pParam User parameter, given to Resolve()
+/// \note Is called from the resolver task and must not block.
+typedef void TDNSResolveHandler (const CIPAddress *pIPAddress, void *pParam);
+
+class CDNSResolver : public CTask	/// Caching DNS resolver, which runs the queries in the background
+{
+public:
+	CDNSResolver (CNetSubSystem *pNetSubSystem);
+	~CDNSResolver (void);
+
+	void Run (void);
+
+	/// \brief Resolve a hostname from cache or by a DNS query in the background
+	/// \param pHostname Hostname to be resolved
+	/// \param pIPAddress Resolved address is returned here with DNSResolveOK
+	/// \param pHandler Will be called, when a query has been done (with DNSResolvePending)
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return Status
+	/// \note Concurrent requests for the same hostname share one query.
+	TDNSResolveStatus Resolve (const char *pHostname, CIPAddress *pIPAddress,
+				   TDNSResolveHandler *pHandler, void *pParam = 0);
+
+	/// \brief Remove all results from the cache (e.g. on network change)
+	void Flush (void);
+
+	/// \return Pointer to the only instance (created on first call)
+	static CDNSResolver *Get (CNetSubSystem *pNetSubSystem);
+
+private:
+	enum TEntryState
+	{
+		EntryFree,
+		EntryPending,			// query is running
+		EntryValid,			// positive result
+		EntryFailed			// negative result
+	};
+
+	struct TWaiter
+	{
+		TDNSResolveHandler *pHandler;
+		void *pParam;
+		TWaiter *pNext;
+	};
+
+	struct TEntry
+	{
+		TEntryState State;
+		char Hostname[DNS_MAX_HOSTNAME+1];
+		u8 IPAddress[IP_ADDRESS_SIZE];
+		unsigned nExpireTicks;		// for valid and failed entries
+		unsigned nLastUsedTicks;	// for LRU replacement
+		u16 nXID;			// for pending entries
+		unsigned nTries;
+		unsigned nSendTicks;
+		TWaiter *pWaiters;
+	};
+
+	TEntry *Lookup (const char *pHostname);
+	TEntry *AllocateEntry (void);		// the least recently used, which is not pending
+
+	boolean SendQuery (TEntry *pEntry);
+	void ProcessResponse (const u8 *pBuffer, int nSize);
+	void Complete (TEntry *pEntry, const u8 *pIPAddress, unsigned nTTL);	// 0: failed
+
+	boolean CheckSocket (void);		// connects to the current DNS server
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+
+	TEntry m_Entry[DNS_CACHE_SIZE];
+	unsigned m_nPending;
+
+	CSocket *m_pSocket;
+	CIPAddress m_DNSServer;
+
+	u16 m_nXID;				// next transaction ID
+
+	CSynchronizationEvent m_Event;		// a query is pending
+
+	static CDNSResolver *s_pThis;
+};
+
+#endif
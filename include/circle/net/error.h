@@ -29,6 +29,7 @@
 #define NET_ERROR_WOULD_BLOCK			12	// EWOULDBLOCK
 #define NET_ERROR_PERMISSION_DENIED		13	// EACCES
 #define NET_ERROR_INVALID_VALUE			14	// EINVAL
+#define NET_ERROR_NO_BUFFER_SPACE		15	// ENOBUFS
 
 #define NET_ERROR_PROTOCOL_ERROR		51	// EPROTO
 #define NET_ERROR_PROTOCOL_NOT_SUPPORTED	52	// EPROTONOSUPPORT
@@ -21,12 +21,23 @@
 #define _circle_net_httpdaemon_h
 
 #include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
 #include <circle/net/netsubsystem.h>
 #include <circle/net/http.h>
 #include <circle/net/socket.h>
 #include <circle/net/ipaddress.h>
+#include <circle/netdevice.h>
+#include <circle/netbuffer.h>
 #include <circle/types.h>
 
+#define HTTPD_CONTENT_LENGTH_UNKNOWN	0xFFFFFFFFU
+
+#ifndef HTTPD_POOL_SIZE
+#define HTTPD_POOL_SIZE			4	// default number of worker tasks
+#endif
+
+#define HTTPD_MAX_PENDING		16	// accepted connections waiting for a worker
+
 class CHTTPDaemon : public CTask
 {
 public:
@@ -35,7 +46,8 @@ public:
 		     unsigned	    nMaxContentSize = 0,	// buffer size for worker
 		     u16	    nPort	    = HTTP_PORT,
 		     unsigned	    nMaxMultipartSize = 0,	// buffer size for multipart form data
-		     unsigned	    nTimeoutSeconds = 0);	// receive timeout (or 0 to wait forever)
+		     unsigned	    nTimeoutSeconds = 0,	// receive timeout (or 0 to wait forever)
+		     unsigned	    nPoolSize	    = HTTPD_POOL_SIZE);	// max. number of workers
 	~CHTTPDaemon (void);
 
 	void Run (void);
@@ -65,10 +77,45 @@ protected:
 				      const u8	 **ppData,	// returns pointer to part data
 				      unsigned	  *pLength);	// returns part data length
 
+	// call this from GetContent() to send the content in pieces, as it is generated,
+	// instead of copying it to pBuffer (status is HTTPOK, chunked transfer encoding)
+	// pContentType is used on the first call only (0 for "text/html")
+	// returns FALSE, if the connection failed (return from GetContent() then)
+	boolean WriteContent (const void *pData, unsigned nLength, const char *pContentType = 0);
+
+	// call this from GetContent() to send the response header with any status, before
+	// the content is sent with WriteContent() (nContentLength bytes exactly, if known)
+	// pHeaderFields are additional lines, each terminated with "\r\n" (or 0)
+	boolean BeginResponse (THTTPStatus Status, const char *pContentType,
+			       unsigned nContentLength = HTTPD_CONTENT_LENGTH_UNKNOWN,
+			       const char *pHeaderFields = 0);
+
+	// sends a piece of content without copying it (up to FRAME_BUFFER_SIZE bytes),
+	// after BeginResponse(), the reference is taken over (also on error)
+	boolean WriteContent (CNetBuffer *pBuffer);
+
+	// header fields of conditional and partial requests ("" if not sent)
+	const char *GetRequestRange (void) const		{ return m_RequestRange; }
+	const char *GetRequestIfNoneMatch (void) const		{ return m_RequestIfNoneMatch; }
+	const char *GetRequestIfModifiedSince (void) const	{ return m_RequestIfModifiedSince; }
+
+	THTTPRequestMethod GetRequestMethod (void) const	{ return m_RequestMethod; }
+
 private:
 	void Listener (void);			// accepts incoming connections and creates worker task
 	void Worker (void);			// processes a connection
 
+	// worker pool, called on the listener instance
+	void QueueConnection (CSocket *pSocket);
+	CSocket *GetConnection (void);		// waits for the next connection to be served
+	// processes one request, returns TRUE if the connection is kept open
+	boolean ProcessRequest (boolean bKeepAliveAllowed);
+
+	// sends pData or pBuffer with nLength bytes (as one chunk)
+	boolean SendContent (const void *pData, CNetBuffer *pBuffer, unsigned nLength);
+
+	static const char *GetStatusMessage (THTTPStatus Status);
+
 	THTTPStatus ParseRequest (void);
 	THTTPStatus ParseMethod (char *pLine);
 	THTTPStatus ParseHeaderField (char *pLine);
@@ -83,11 +130,32 @@ private:
 	u16	       m_nPort;
 	unsigned       m_nMaxMultipartSize;
 	unsigned       m_nTimeoutSeconds;
+	unsigned       m_nPoolSize;
+
+	// worker pool (in the listener instance)
+	CHTTPDaemon *m_pListener;			// the worker is part of the pool of it
+	unsigned m_nWorkers;				// created workers
+	unsigned m_nIdleWorkers;			// waiting for a connection
+	CSocket *m_pPending[HTTPD_MAX_PENDING];		// accepted connections (ring buffer)
+	unsigned m_nPendingIn;
+	unsigned m_nPendingOut;
+	unsigned m_nPendingCount;
+	CSynchronizationEvent m_ConnectionEvent;	// a connection has been queued
+	CSynchronizationEvent m_SlotEvent;		// a connection has been taken from queue
 	
 	u8 *m_pContentBuffer;
 
+	u8 m_RxBuffer[FRAME_BUFFER_SIZE];		// received data, which may hold
+	unsigned m_nRxOffset;				// the start of the next request
+	unsigned m_nRxLength;
+
 	// from request
 	THTTPRequestMethod m_RequestMethod;
+	boolean m_bHTTP11;				// client talks HTTP/1.1
+	boolean m_bKeepAlive;				// connection will be kept open
+	char m_RequestRange[HTTP_MAX_HEADER_VALUE+1];
+	char m_RequestIfNoneMatch[HTTP_MAX_HEADER_VALUE+1];
+	char m_RequestIfModifiedSince[HTTP_MAX_HEADER_VALUE+1];
 
 	char m_RequestURI[HTTP_MAX_URI+1];		// the URI without host
 	char m_RequestPath[HTTP_MAX_PATH+1];		// the path without parameters
@@ -103,6 +171,13 @@ private:
 	char *m_pMultipartBuffer;			// pointer to allocated multipart buffer
 	char *m_pMultipartPointer;			// pointer into allocated multipart buffer
 
+	// response sent with BeginResponse() and WriteContent()
+	boolean m_bStreaming;				// response header has been sent
+	THTTPStatus m_StreamStatus;
+	unsigned m_nStreamContentLength;		// announced in the header (or unknown)
+	boolean m_bChunked;				// chunked transfer encoding is used
+	unsigned m_nStreamedLength;			// total content length sent
+
 	static unsigned s_nInstanceCount;
 };
 
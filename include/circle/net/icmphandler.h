@@ -93,6 +93,8 @@ public:
 				     const void *pReturnedIPPacket, unsigned nLength);
 
 private:
+	static unsigned GetPlateauMTU (unsigned nPacketLength);
+
 	void EnqueueNotification (TICMPNotificationType Type, TIPHeader *pIPHeader,
 				  TICMPDataDatagramHeader *pDatagramHeader);
 
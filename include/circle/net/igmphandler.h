@@ -27,13 +27,23 @@
 #include <circle/timer.h>
 #include <circle/types.h>
 
+#define IGMP_MAX_SOURCES	8		// per host group
+
 class CNetworkLayer;
 
-class CIGMPHandler	/// IGMP version 2 protocol handler (RFC 2236)
+/// \note Host groups can be joined for any source (ASM) or for specific sources (SSM). The\n
+///	  filter state of a group is EXCLUDE {}, if there is at least one any-source member,\n
+///	  or INCLUDE {sources of all members} otherwise (RFC 3376 section 3.2, without\n
+///	  non-empty exclude lists). The IGMPv1/v2 compatibility modes are entered, when an\n
+///	  older querier is detected, source filters cannot be signaled in these modes.
+
+class CIGMPHandler	/// IGMP version 3 protocol handler (RFC 3376), compatible with IGMPv1/v2
 {
 public:
-	static const unsigned UnsolicitedReportInterval	= 10*HZ;
-	static const unsigned V1RouterPresentTimeout	= 400*HZ;
+	static const unsigned UnsolicitedReportInterval	= 10*HZ;	// IGMPv1/v2
+	static const unsigned UnsolicitedReportIntervalV3 = 1*HZ;
+	static const unsigned V1RouterPresentTimeout	= 400*HZ;	// for v1 and v2 queriers
+	static const unsigned RobustnessVariable	= 2;
 
 public:
 	CIGMPHandler (CNetConfig *pNetConfig, CNetworkLayer *pNetworkLayer, CLinkLayer *pLinkLayer,
@@ -42,13 +52,25 @@ public:
 
 	void Process (void);
 
-	boolean JoinHostGroup (const CIPAddress &rGroupAddress);
-	boolean LeaveHostGroup (const CIPAddress &rGroupAddress);
+	// pSourceAddress is 0 to join or leave for any source
+	boolean JoinHostGroup (const CIPAddress &rGroupAddress, const CIPAddress *pSourceAddress = 0);
+	boolean LeaveHostGroup (const CIPAddress &rGroupAddress, const CIPAddress *pSourceAddress = 0);
 
 private:
-	// sends Membership Report or Leave Group for rGroupAddress
+	void ProcessQuery (const u8 *pPacket, unsigned nLength, unsigned nTicks);
+
+	// start sending State-Change Reports for the host group with index nGroup
+	void ReportStateChange (unsigned nGroup);
+
+	// sends Membership Report or Leave Group for rGroupAddress (IGMPv1/v2)
 	boolean SendPacket (boolean bMembershipReport, const CIPAddress &rGroupAddress);
 
+	// sends IGMPv3 Membership Report with the record of host group nGroup
+	// (or of all host groups, if nGroup == MaxHostGroups)
+	boolean SendReportV3 (boolean bStateChange, unsigned nGroup);
+
+	boolean IsV3Mode (void) const	{ return m_nV1RouterTimer == 0 && m_nV2RouterTimer == 0; }
+
 	unsigned GetRandom (unsigned nMax);
 
 private:
@@ -60,12 +82,21 @@ private:
 	boolean m_bAllSystemsJoined;
 	unsigned m_nLastTicks;
 	unsigned m_nV1RouterTimer;			// 0 if not heard
+	unsigned m_nV2RouterTimer;			// 0 if not heard
+	unsigned m_nGeneralTimer;			// response to IGMPv3 General Query (0 if not running)
 
 	static const unsigned MaxHostGroups = MAX_MULTICAST_GROUPS;
 	CIPAddress m_HostGroup[MaxHostGroups];
-	unsigned m_nUseCounter[MaxHostGroups];
+	unsigned m_nUseCounter[MaxHostGroups];		// all members, 0 if group is unused
+	unsigned m_nAnySourceCounter[MaxHostGroups];	// members without source filter
 	unsigned m_nDelayTimer[MaxHostGroups];		// 0 if not running
 	boolean m_bLastHostFlag[MaxHostGroups];
+	unsigned m_nChangeTimer[MaxHostGroups];		// State-Change Report retransmission
+	unsigned m_nChangeRetransmissions[MaxHostGroups];
+
+	unsigned m_nSources[MaxHostGroups];
+	CIPAddress m_Source[MaxHostGroups][IGMP_MAX_SOURCES];
+	unsigned m_nSourceUseCounter[MaxHostGroups][IGMP_MAX_SOURCES];
 
 	unsigned m_nRandomSeed;
 };
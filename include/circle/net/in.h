@@ -8,7 +8,9 @@
 #define IPPROTO_IGMP	2
 #define IPPROTO_TCP	6
 #define IPPROTO_UDP	17
+#define IPPROTO_ICMPV6	58
 
 #define MSG_DONTWAIT	0x40
+#define MSG_MORE	0x8000		// TCP only, more data will follow
 
 #endif
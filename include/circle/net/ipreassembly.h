@@ -0,0 +1,81 @@
+//
+// ipreassembly.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_ipreassembly_h
+#define _circle_net_ipreassembly_h
+
+#include <circle/net/ipaddress.h>
+#include <circle/netbuffer.h>
+#include <circle/types.h>
+
+#define IP_REASSEMBLY_SLOTS		4	// datagrams, which are reassembled at the same time
+#define IP_REASSEMBLY_MAX_FRAGMENTS	16	// per datagram
+#define IP_REASSEMBLY_TIMEOUT		30	// seconds
+#define IP_REASSEMBLY_MAX_HEADER	24	// bytes (with IP_HEADER_LENGTH_DWORD_MAX)
+
+struct TIPReassemblySlot
+{
+	boolean		 bInUse;
+	u8		 SourceAddress[IP_ADDRESS_SIZE];
+	u8		 DestinationAddress[IP_ADDRESS_SIZE];
+	u16		 nIdentification;
+	u8		 nProtocol;
+	unsigned	 nTicksStarted;
+	unsigned	 nTotalLength;		// of the data, 0 until the last fragment arrived
+	unsigned	 nReceivedLength;	// of the data
+	unsigned	 nFragments;
+	CNetBuffer	*pFragment[IP_REASSEMBLY_MAX_FRAGMENTS];	// sorted by offset
+	unsigned	 nOffset[IP_REASSEMBLY_MAX_FRAGMENTS];		// of the data in bytes
+	u8		 Header[IP_REASSEMBLY_MAX_HEADER];		// of the first fragment
+	unsigned	 nHeaderLength;		// 0 until the first fragment arrived
+};
+
+class CIPReassembly	/// Reassembles fragmented IP datagrams in bounded memory
+{
+public:
+	CIPReassembly (void);
+	~CIPReassembly (void);
+
+	/// \brief Drop all datagrams, which are not complete yet
+	void Flush (void);
+
+	/// \brief Drop all datagrams, which could not be reassembled in time
+	/// \note Has to be called periodically.
+	void Process (void);
+
+	/// \brief Add a fragment of a datagram
+	/// \param pFragment Buffer with a valid IP header and the data of the fragment,\n
+	///		     the reference is taken over
+	/// \return The complete datagram (0 if not complete yet), its first segment holds the\n
+	///	    IP header of the first fragment with updated length and without fragment\n
+	///	    information, the following segments hold the data of the other fragments
+	/// \note Overlapping fragments drop the whole datagram (see RFC 5722).
+	CNetBuffer *AddFragment (CNetBuffer *pFragment);
+
+private:
+	TIPReassemblySlot *GetSlot (const u8 *pSourceAddress, const u8 *pDestinationAddress,
+				    u16 nIdentification, u8 nProtocol);
+
+	static void FreeSlot (TIPReassemblySlot *pSlot);
+
+private:
+	TIPReassemblySlot m_Slot[IP_REASSEMBLY_SLOTS];
+};
+
+#endif
@@ -0,0 +1,77 @@
+//
+// ipv6address.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_ipv6address_h
+#define _circle_net_ipv6address_h
+
+#include <circle/macaddress.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define IPV6_ADDRESS_SIZE	16
+#define IPV6_PREFIX_LENGTH	64	// used for SLAAC
+
+class CIPv6Address	/// Encapsulates an IPv6 address
+{
+public:
+	CIPv6Address (void);			// unspecified address (::)
+	CIPv6Address (const u8 *pAddress);
+	CIPv6Address (const CIPv6Address &rAddress);
+	~CIPv6Address (void);
+
+	boolean operator== (const CIPv6Address &rAddress2) const;
+	boolean operator!= (const CIPv6Address &rAddress2) const;
+	boolean operator== (const u8 *pAddress2) const;
+	boolean operator!= (const u8 *pAddress2) const;
+
+	CIPv6Address &operator= (const CIPv6Address &rAddress);
+	void Set (const u8 *pAddress);
+	void Set (const CIPv6Address &rAddress);
+	void SetNull (void);
+
+	/// \brief Set link-local address (fe80::/64) with interface identifier from MAC address
+	void SetLinkLocal (const CMACAddress &rMACAddress);
+	/// \brief Set address from a 64-bit prefix and the interface identifier from MAC address
+	void SetFromPrefix (const u8 *pPrefix, const CMACAddress &rMACAddress);
+	/// \brief Set solicited-node multicast address (ff02::1:ffxx:xxxx) of an address
+	void SetSolicitedNode (const CIPv6Address &rAddress);
+	/// \brief Set all-nodes (ff02::1) multicast address
+	void SetAllNodes (void);
+	/// \brief Set all-routers (ff02::2) multicast address
+	void SetAllRouters (void);
+
+	const u8 *Get (void) const;
+	void CopyTo (u8 *pBuffer) const;
+
+	boolean IsNull (void) const;
+	boolean IsMulticast (void) const;
+	boolean IsLinkLocal (void) const;
+	unsigned GetSize (void) const;
+
+	/// \brief Format address according to RFC 5952 (e.g. "fe80::1")
+	void Format (CString *pString) const;
+
+	/// \return Is the address covered by the prefix with the given length (in bits)?
+	boolean OnPrefix (const u8 *pPrefix, unsigned nPrefixLength) const;
+
+private:
+	u8 m_Address[IPV6_ADDRESS_SIZE];
+};
+
+#endif
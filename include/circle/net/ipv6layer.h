@@ -0,0 +1,173 @@
+//
+// ipv6layer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_ipv6layer_h
+#define _circle_net_ipv6layer_h
+
+#include <circle/net/netdevlayer.h>
+#include <circle/net/linklayer.h>
+#include <circle/net/ipv6address.h>
+#include <circle/netbuffer.h>
+#include <circle/macaddress.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define IPV6_MTU_MIN			1280
+#define IPV6_NEIGHBOR_CACHE_SIZE	16
+
+struct TIPv6Header
+{
+	u32	nVersionClassFlow;
+#define IPV6_VERSION(field)		((field) >> 28)		// after BE()
+	#define IPV6_VERSION_6			6
+	u16	nPayloadLength;
+	u8	nNextHeader;				// see: in.h
+	u8	nHopLimit;
+#define IPV6_HOP_LIMIT_DEFAULT		64
+#define IPV6_HOP_LIMIT_ND		255		// required for NDP messages
+	u8	SourceAddress[IPV6_ADDRESS_SIZE];
+	u8	DestinationAddress[IPV6_ADDRESS_SIZE];
+}
+PACKED;
+
+struct TIPv6Neighbor
+{
+	unsigned	nState;
+#define IPV6_NEIGHBOR_FREE		0
+#define IPV6_NEIGHBOR_INCOMPLETE	1		// NS sent, waiting for NA
+#define IPV6_NEIGHBOR_REACHABLE		2
+	CIPv6Address	IPAddress;
+	CMACAddress	MACAddress;
+	unsigned	nTicks;				// of last update or NS
+	unsigned	nRetries;
+	CNetBuffer	*pPendingPacket;		// with IPv6 header, sent on resolve
+};
+
+/// \note This is a host-only IPv6 layer, which runs beside the IPv4 network layer. It\n
+///	  configures a link-local address (with duplicate address detection) and a global\n
+///	  address from router advertisements (SLAAC, RFC 4862), resolves neighbors (NDP,\n
+///	  RFC 4861) and answers echo requests. Upper layer packets are sent with Send().\n
+///	  Extension headers and fragmentation are not supported.
+
+class CIPv6Layer	/// Minimal IPv6 host layer with NDP, SLAAC and ICMPv6 echo
+{
+public:
+	CIPv6Layer (CNetDeviceLayer *pNetDevLayer, CLinkLayer *pLinkLayer);
+	~CIPv6Layer (void);
+
+	boolean Initialize (void);
+
+	void Process (void);
+
+	/// \param rReceiver Destination address (unicast or multicast)
+	/// \param pPayload Upper layer packet with a headroom of at least\n
+	///	   sizeof (TIPv6Header) + sizeof (TEthernetHeader) bytes, the reference is taken over
+	/// \param nNextHeader Upper layer protocol (IPPROTO_*)
+	/// \return Operation successful? (the packet may still be queued for address resolution)
+	boolean Send (const CIPv6Address &rReceiver, CNetBuffer *pPayload, int nNextHeader);
+
+	/// \return Has the link-local address passed duplicate address detection?
+	boolean IsRunning (void) const;
+
+	/// \return Link-local address (valid, if IsRunning() returns TRUE)
+	const CIPv6Address *GetLinkLocalAddress (void) const;
+	/// \return Global address, configured from a router advertisement (0 if none)
+	const CIPv6Address *GetGlobalAddress (void) const;
+	/// \return Default router (0 if none)
+	const CIPv6Address *GetDefaultRouter (void) const;
+
+private:
+	void ProcessPacket (CNetBuffer *pPacket);
+	void ProcessICMPv6 (const TIPv6Header *pHeader, const u8 *pMessage, unsigned nLength);
+	void ProcessNeighborSolicitation (const TIPv6Header *pHeader,
+					  const u8 *pMessage, unsigned nLength);
+	void ProcessNeighborAdvertisement (const u8 *pMessage, unsigned nLength);
+	void ProcessRouterAdvertisement (const TIPv6Header *pHeader,
+					 const u8 *pMessage, unsigned nLength);
+	void ProcessTimers (void);
+
+	// returns the source link-layer address option (type 1) or 0
+	static const u8 *FindLinkLayerOption (const u8 *pOptions, unsigned nLength,
+					      unsigned nType);
+
+	boolean SendICMPv6 (const CIPv6Address &rSource, const CIPv6Address &rDestination,
+			    const void *pMessage, unsigned nLength, unsigned nHopLimit);
+	void SendNeighborSolicitation (const CIPv6Address &rTarget, boolean bDAD);
+	void SendNeighborAdvertisement (const CIPv6Address &rDestination,
+					const CIPv6Address &rTarget, boolean bSolicited);
+	void SendRouterSolicitation (void);
+
+	// the reference to pPacket (with IPv6 header) is taken over
+	boolean SendPacket (const CIPv6Address &rNextHop, CNetBuffer *pPacket);
+
+	const CIPv6Address *SelectSource (const CIPv6Address &rDestination) const;
+	boolean IsOwnAddress (const CIPv6Address &rAddress) const;
+	boolean IsOnLink (const CIPv6Address &rAddress) const;
+
+	TIPv6Neighbor *LookupNeighbor (const CIPv6Address &rAddress);
+	TIPv6Neighbor *AllocNeighbor (const CIPv6Address &rAddress);
+	void UpdateNeighbor (const CIPv6Address &rAddress, const u8 *pMACAddress,
+			     boolean bCreate);
+	void FreeNeighbor (TIPv6Neighbor *pEntry);
+
+	void JoinSolicitedNodeGroup (const CIPv6Address &rAddress, boolean bJoin);
+
+	static u16 CalculateChecksum (const CIPv6Address &rSource,
+				      const CIPv6Address &rDestination,
+				      const void *pMessage, unsigned nLength, int nNextHeader);
+
+private:
+	CNetDeviceLayer *m_pNetDevLayer;
+	CLinkLayer *m_pLinkLayer;
+
+	CMACAddress m_OwnMACAddress;
+
+	enum TState
+	{
+		StateWaitForMAC,
+		StateDAD,
+		StateRouterSolicitation,
+		StateRunning,
+		StateDuplicate			// link-local address is in use, IPv6 disabled
+	};
+	TState m_State;
+	unsigned m_nStateTicks;
+	unsigned m_nSolicitations;
+
+	CIPv6Address m_LinkLocalAddress;
+
+	boolean m_bGlobalValid;
+	CIPv6Address m_GlobalAddress;
+	u8 m_Prefix[IPV6_ADDRESS_SIZE];
+	unsigned m_nPrefixLength;
+	unsigned m_nGlobalTicks;
+	unsigned m_nGlobalLifetime;		// in seconds, 0xFFFFFFFF for infinite
+
+	boolean m_bRouterValid;
+	CIPv6Address m_DefaultRouter;
+	unsigned m_nRouterTicks;
+	unsigned m_nRouterLifetime;		// in seconds
+
+	unsigned m_nHopLimit;
+	unsigned m_nLinkMTU;
+
+	TIPv6Neighbor m_Neighbor[IPV6_NEIGHBOR_CACHE_SIZE];
+};
+
+#endif
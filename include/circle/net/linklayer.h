@@ -26,10 +26,12 @@
 #include <circle/net/ipaddress.h>
 #include <circle/macaddress.h>
 #include <circle/net/netqueue.h>
+#include <circle/netbuffer.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
 #define MAX_MULTICAST_GROUPS	8
+#define MAX_RAW_FRAME_RINGS	4
 
 struct TEthernetHeader
 {
@@ -38,10 +40,12 @@ struct TEthernetHeader
 	u16	nProtocolType;
 #define ETH_PROT_IP		0x800
 #define ETH_PROT_ARP		0x806
+#define ETH_PROT_IPV6		0x86DD
 }
 PACKED;
 
 class CNetworkLayer;
+class CRawFrameRing;
 
 class CLinkLayer
 {
@@ -57,9 +61,23 @@ public:
 	void Process (void);
 
 	boolean Send (const CIPAddress &rReceiver, const void *pIPPacket, unsigned nLength);
+	// pIPPacket must have a headroom of at least sizeof (TEthernetHeader) bytes,
+	// the reference is taken over
+	boolean Send (const CIPAddress &rReceiver, CNetBuffer *pIPPacket);
+
+	// used by CNetworkLayer for cached flows (see CNetFlow): sets up the Ethernet header
+	// for an IP packet to rNextHop, returns FALSE if the next hop is not resolved yet
+	// (nothing is sent), *pNeighbor is valid while GetNeighborGeneration() is unchanged
+	boolean SetupFlowHeader (const CIPAddress &rNextHop, TEthernetHeader *pHeader,
+				 unsigned *pNeighbor);
+	unsigned GetNeighborGeneration (void) const;
+	// pFrame holds the complete Ethernet frame, the reference is taken over
+	void SendFlowFrame (CNetBuffer *pFrame, unsigned nNeighbor);
 
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean Receive (void *pBuffer, unsigned *pResultLength);
+	// returns 0 if nothing has been received, the caller has to release the buffer
+	CNetBuffer *Receive (void);
 
 public:
 	boolean SendRaw (const void *pFrame, unsigned nLength);
@@ -70,12 +88,34 @@ public:
 	// nProtocolType is in host byte order
 	boolean EnableReceiveRaw (u16 nProtocolType);
 
+	// used by CRawFrameRing, returns FALSE if its EtherType is already used
+	boolean AttachRawRing (CRawFrameRing *pRing);
+	void DetachRawRing (CRawFrameRing *pRing);
+
 	boolean IsRunning (void) const;
 
+	// returns NET_DEVICE_CAP_* bit mask of the net device
+	unsigned GetCapabilities (void) const;
+
 	boolean JoinLocalGroup (const CIPAddress &rGroupAddress);
 	boolean LeaveLocalGroup (const CIPAddress &rGroupAddress);
 
+	boolean JoinLocalGroup (const CMACAddress &rGroup);
+	boolean LeaveLocalGroup (const CMACAddress &rGroup);
+
+public:
+	// used by CIPv6Layer, which resolves the MAC addresses itself (NDP)
+	void EnableIPv6 (void);
+	// pIPv6Packet must have a headroom of at least sizeof (TEthernetHeader) bytes,
+	// the reference is taken over
+	boolean SendIPv6 (const CMACAddress &rReceiver, CNetBuffer *pIPv6Packet);
+	// returns 0 if nothing has been received, the caller has to release the buffer
+	CNetBuffer *ReceiveIPv6 (void);
+
 private:
+	// returns FALSE, if the frame has been dropped (the caller has to release it then)
+	boolean ProcessFrame (CNetBuffer *pFrame, const CMACAddress *pOwnMACAddress);
+
 	boolean UpdateMulticastFilter (void);
 
 	// return IP packet to the network layer for notification
@@ -91,9 +131,14 @@ private:
 	CNetQueue m_ARPRxQueue;
 	CNetQueue m_IPRxQueue;
 
+	boolean m_bIPv6Enabled;
+	CNetQueue m_IPv6RxQueue;
+
 	CNetQueue m_RawRxQueue;
 	u16 m_nRawProtocolType;
 
+	CRawFrameRing *m_pRawRing[MAX_RAW_FRAME_RINGS];
+
 	static const unsigned MaxGroups = MAX_MULTICAST_GROUPS;
 	CMACAddress m_MulticastGroup[MaxGroups];
 	unsigned m_nMulticastUseCounter[MaxGroups];
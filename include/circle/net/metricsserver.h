@@ -0,0 +1,62 @@
+//
+// metricsserver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_metricsserver_h
+#define _circle_net_metricsserver_h
+
+#include <circle/net/httpdaemon.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/types.h>
+
+#define METRICS_PORT		9100
+#define METRICS_MAX_CONTENT	0x10000
+
+/// \note Serves the registered metrics (see circle/metrics.h) at "/metrics" for Prometheus.
+///	  Only one instance has to be created by the application.
+
+class CMetricsServer : public CHTTPDaemon	/// HTTP server for the metrics registry
+{
+public:
+	CMetricsServer (CNetSubSystem *pNetSubSystem,
+			u16	       nPort   = METRICS_PORT,
+			CSocket	      *pSocket = 0);	// is 0 for 1st created instance (listener)
+	~CMetricsServer (void);
+
+	CHTTPDaemon *CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket);
+
+	THTTPStatus GetContent (const char  *pPath,
+				const char  *pParams,
+				const char  *pFormData,
+				u8	    *pBuffer,
+				unsigned    *pLength,
+				const char **ppContentType);
+
+	// no access log, the endpoint is scraped periodically
+	void WriteAccessLog (const CIPAddress	&rRemoteIP,
+			     THTTPRequestMethod	 RequestMethod,
+			     const char		*pRequestURI,
+			     THTTPStatus	 Status,
+			     unsigned		 nContentLength);
+
+private:
+	u16 m_nPort;
+};
+
+#endif
@@ -67,6 +67,9 @@ enum TMQTTPacketType
 
 #define MQTT_SEND_TRIES		5
 
+#define MQTT_MAX_IN_FLIGHT	8	// default send window
+#define MQTT_TX_BUFFER_SIZE	1460	// fits into one TCP segment
+
 #define MQTT_RESEND_TIMEOUT	(5*HZ)
 #define MQTT_PING_TIMEOUT	(5*HZ)
 
@@ -83,10 +83,15 @@ public:
 	/// \param nMaxPacketsQueued Maximum number of MQTT packets queue-able on receive\n
 	/// If processing a received packet takes longer, further packets have to be queued.
 	/// \param nMaxTopicSize     Maximum allowed size of a received topic string
+	/// \param nMaxInFlight      Maximum number of sent QoS 1/2 PUBLISH (and SUBSCRIBE)\n
+	/// packets, which wait for their acknowledgement. The same number of packets can wait\n
+	/// for a free slot in this send window, before Publish() fails.
+	/// \note All packet buffers are allocated here, sending does not allocate memory.
 	CMQTTClient (CNetSubSystem *pNetSubSystem,
 		     size_t nMaxPacketSize    = 1024,
 		     size_t nMaxPacketsQueued = 4,
-		     size_t nMaxTopicSize     = 256);
+		     size_t nMaxTopicSize     = 256,
+		     size_t nMaxInFlight      = MQTT_MAX_IN_FLIGHT);
 
 	~CMQTTClient (void);
 
@@ -132,8 +137,11 @@ public:
 	/// \param nPayloadLength Length of the message payload (default 0)
 	/// \param uchQoS         QoS value for sending the PUBLISH message (default QoS 1)
 	/// \param bRetain        Retain parameter for the message (default FALSE)
-	void Publish (const char *pTopic, const u8 *pPayload = 0, size_t nPayloadLength = 0,
-		      u8 uchQoS = MQTT_QOS1, boolean bRetain = FALSE);
+	/// \return FALSE, if the message cannot be queued (send window and queue full)
+	/// \note Small packets are collected and sent together with one TCP send\n
+	///	  from the MQTT client task (after OnLoop() returned).
+	boolean Publish (const char *pTopic, const u8 *pPayload = 0, size_t nPayloadLength = 0,
+			 u8 uchQoS = MQTT_QOS1, boolean bRetain = FALSE);
 
 
 	/// \brief Callback entered when the connection to the MQTT broker has been established
@@ -165,7 +173,18 @@ private:
 
 	void CloseConnection (TMQTTDisconnectReason Reason);
 
-	boolean SendPacket (CMQTTSendPacket *pPacket);
+	boolean SendPacket (CMQTTSendPacket *pPacket);	// into transmit buffer
+	boolean FlushTxBuffer (void);
+
+	u16 GetPacketIdentifier (void);
+
+	// packet pool
+	CMQTTSendPacket *AllocatePacket (TMQTTPacketType Type);
+	void FreePacket (CMQTTSendPacket *pPacket);
+
+	// sends packet, which requires an acknowledgement, or queues it, if window is full
+	boolean QueuePacket (CMQTTSendPacket *pPacket);
+	boolean SendPendingPackets (void);
 
 	// retransmission queue (for sender)
 	void InsertPacketIntoQueue (CMQTTSendPacket *pPacket, unsigned nScheduledTime);
@@ -199,7 +218,20 @@ private:
 
 	CMQTTReceivePacket m_ReceivePacket;
 
-	CPtrList m_RetransmissionQueue;		// sorted according to time
+	size_t m_nMaxInFlight;
+	CMQTTSendPacket *m_pFreePackets;	// preallocated
+
+	// all packets are scheduled with the same timeout, so the queue is sorted in time
+	CMQTTSendPacket *m_pRetransmissionFirst;
+	CMQTTSendPacket *m_pRetransmissionLast;
+	unsigned m_nInFlight;
+
+	CMQTTSendPacket *m_pPendingFirst;	// waiting for the send window
+	CMQTTSendPacket *m_pPendingLast;
+
+	u8 m_TxBuffer[MQTT_TX_BUFFER_SIZE];	// collects packets for one TCP send
+	unsigned m_nTxLength;
+
 	CPtrList m_PacketIdentifierStore;	// for QoS 2 receiving PUBLISH
 
 	static const char *s_pErrorMsg[MQTTDisconnectUnknown+1];
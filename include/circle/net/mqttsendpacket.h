@@ -21,15 +21,20 @@
 #define _circle_net_mqttsendpacket_h
 
 #include <circle/net/mqtt.h>
-#include <circle/net/socket.h>
 #include <circle/types.h>
 
+#define MQTT_CONTROL_PACKET_SIZE	16	// enough for packets without payload
+
 class CMQTTSendPacket		/// MQTT helper class
 {
 public:
-	CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize = 128);
+	/// \note Small packets use an internal buffer, no memory is allocated for them.
+	CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize = MQTT_CONTROL_PACKET_SIZE);
 	~CMQTTSendPacket (void);
 
+	/// \brief Reuse the packet for a new message (keeps the buffer)
+	void Reset (TMQTTPacketType Type);
+
 	void SetFlags (u8 uchFlags);
 
 	void AppendByte (u8 uchValue);
@@ -37,7 +42,10 @@ public:
 	void AppendString (const char *pString);
 	void AppendData (const u8 *pBuffer, size_t nLength);
 
-	boolean Send (CSocket *pSocket);
+	/// \brief Complete the fixed header in front of the packet data
+	/// \param pLength Returns the length of the encoded packet
+	/// \return Pointer to the encoded packet, 0 on error or after too many send tries
+	const u8 *Encode (unsigned *pLength);
 
 	TMQTTPacketType GetType (void) const;
 	u8 GetFlags (void) const;
@@ -53,6 +61,9 @@ public:
 	void SetPacketIdentifier (u16 usPacketIdentifier);
 	u16 GetPacketIdentifier (void) const;
 
+	void SetNext (CMQTTSendPacket *pNext);	// for intrusive queues
+	CMQTTSendPacket *GetNext (void) const;
+
 private:
 	TMQTTPacketType m_Type;
 	size_t m_nMaxPacketSize;
@@ -61,6 +72,7 @@ private:
 
 	u8 *m_pBuffer;
 	unsigned m_nBufPtr;
+	u8 m_SmallBuffer[MQTT_CONTROL_PACKET_SIZE];
 
 	u8 m_uchFlags;
 
@@ -70,6 +82,8 @@ private:
 	unsigned m_nScheduledTime;
 	u8 m_uchQoS;
 	u16 m_usPacketIdentifier;
+
+	CMQTTSendPacket *m_pNext;
 };
 
 #endif
@@ -0,0 +1,104 @@
+//
+// netcapture.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netcapture_h
+#define _circle_net_netcapture_h
+
+#include <circle/net/netcapturefilter.h>
+#include <circle/net/netdevlayer.h>
+#include <circle/netbuffer.h>
+#include <circle/netdevice.h>
+#include <circle/types.h>
+
+#define NET_CAPTURE_PCAPNG_HEADER_SIZE	48		// SHB and IDB
+#define NET_CAPTURE_PCAPNG_BLOCK_SIZE	(44 + FRAME_BUFFER_SIZE)	// max. size of an EPB
+
+/// \note The frames are copied (up to the snap length) into a lock-free ring buffer with\n
+///	  a single producer (the net device layer) and a single consumer (the reader of the\n
+///	  pcapng blocks). When the ring is full, frames are dropped and counted. While the\n
+///	  capture is not started, the net device layer only tests a pointer per frame.
+/// \note Write the result of GetPcapngHeader() and then the blocks returned by\n
+///	  ReadPcapngBlock() to a file or a connection (see CNetCaptureServer), to get a\n
+///	  pcapng file, which can be viewed with Wireshark.
+
+class CNetCapture	/// Captures the frames of the net device layer into a ring buffer
+{
+public:
+	/// \param pNetDeviceLayer Pointer to the net device layer to be tapped
+	/// \param nRingSize Number of frames, which can be held in the ring
+	/// \param nSnapLength Maximum number of bytes captured per frame
+	CNetCapture (CNetDeviceLayer *pNetDeviceLayer, unsigned nRingSize = 256,
+		     unsigned nSnapLength = FRAME_BUFFER_SIZE);
+	~CNetCapture (void);
+
+	/// \param pExpression Filter expression (see CNetCaptureFilter, 0 to capture all frames)
+	/// \return Operation successful?
+	/// \note Must be called, while the capture is stopped.
+	boolean SetFilter (const char *pExpression);
+
+	/// \brief Start capturing, frames from a previous capture are discarded
+	void Start (void);
+	/// \brief Stop capturing, the frames in the ring can still be read
+	void Stop (void);
+
+	/// \return Number of frames, which have been dropped, because the ring was full
+	unsigned GetDropped (void) const;
+
+	/// \param pBuffer Pointer to a buffer of NET_CAPTURE_PCAPNG_HEADER_SIZE bytes
+	/// \return Size of the pcapng section header and interface description blocks
+	unsigned GetPcapngHeader (void *pBuffer) const;
+
+	/// \param pBuffer Pointer to a buffer of NET_CAPTURE_PCAPNG_BLOCK_SIZE bytes
+	/// \return Size of the enhanced packet block of the next captured frame (0 if none)
+	unsigned ReadPcapngBlock (void *pBuffer);
+
+public:
+	/// \brief Called by the net device layer for each sent and received frame
+	void CaptureFrame (const CNetBuffer *pFrame, boolean bTransmit);
+
+private:
+	struct TSlot
+	{
+		u64	nTimestamp;		// microseconds since 1970-01-01 00:00:00 UTC
+		u16	nCapturedLength;
+		u16	nOriginalLength;
+		boolean	bTransmit;
+		u8	Data[0];
+	};
+
+	TSlot *GetSlot (unsigned nIndex) const;
+
+private:
+	CNetDeviceLayer *m_pNetDeviceLayer;
+	unsigned m_nRingSize;
+	unsigned m_nSnapLength;
+	unsigned m_nSlotSize;
+
+	u8 *m_pRing;
+	volatile unsigned m_nIn;		// written by the producer only
+	volatile unsigned m_nOut;		// written by the consumer only
+
+	unsigned m_nDropped;
+
+	u64 m_nTimeBase;			// added to CTimer::GetClockTicks64()
+
+	CNetCaptureFilter m_Filter;
+};
+
+#endif
@@ -0,0 +1,111 @@
+//
+// netcapturefilter.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netcapturefilter_h
+#define _circle_net_netcapturefilter_h
+
+#include <circle/types.h>
+
+#define NET_CAPTURE_FILTER_MAX_INSNS	128
+
+/// \note The filter expression is a subset of the tcpdump syntax. Primitives are:\n
+///	  ip, ip6, arp, tcp, udp, icmp, ether proto N, [src|dst] host A.B.C.D,\n
+///	  [tcp|udp] [src|dst] port N, greater N, less N\n
+///	  They can be combined with and (&&), or (||), not (!) and parentheses.\n
+///	  The expression is compiled into a small program of BPF-like instructions,\n
+///	  which is interpreted for each frame. Transport protocols work on IPv4 only.
+
+class CNetCaptureFilter	/// Compiles a capture filter expression and matches frames against it
+{
+public:
+	CNetCaptureFilter (void);
+	~CNetCaptureFilter (void);
+
+	/// \param pExpression Filter expression (0 or empty to match all frames)
+	/// \return Operation successful? (the filter matches all frames on error)
+	boolean Compile (const char *pExpression);
+
+	/// \param pFrame Pointer to an Ethernet frame
+	/// \param nLength Frame length in bytes
+	/// \return Does the frame match the filter?
+	boolean Match (const u8 *pFrame, unsigned nLength) const;
+
+private:
+	enum TOpcode
+	{
+		OpLoadByte,		// A = P[k]
+		OpLoadHalf,		// A = P[k:2]
+		OpLoadWord,		// A = P[k:4]
+		OpLoadLength,		// A = frame length
+		OpLoadIndexMSH,		// X = (P[k] & 0xF) * 4
+		OpLoadHalfIndex,	// A = P[X+k:2]
+		OpJumpEqual,		// A == k ?
+		OpJumpGreaterEqual,	// A >= k ?
+		OpJumpSet,		// (A & k) != 0 ?
+		OpReturn		// return k
+	};
+
+	struct TInsn
+	{
+		u8	Opcode;
+		u16	nTrue;		// jump targets (absolute), patch chain while compiling
+		u16	nFalse;
+		u32	nK;
+	};
+
+	// lists of jump fields to be patched, chained through the fields itself
+	struct TJumpLists
+	{
+		u16	nTrue;
+		u16	nFalse;
+	};
+
+private:
+	boolean ParseExpression (TJumpLists *pResult);
+	boolean ParseTerm (TJumpLists *pResult);
+	boolean ParseFactor (TJumpLists *pResult);
+	boolean ParsePrimitive (TJumpLists *pResult);
+
+	boolean EmitEtherType (u16 usType, TJumpLists *pResult);
+	boolean EmitIPProtocol (u8 uchProtocol, TJumpLists *pResult);
+	boolean EmitHost (int nDirection, u32 nAddress, TJumpLists *pResult);
+	boolean EmitPort (u8 uchProtocol, int nDirection, u16 usPort, TJumpLists *pResult);
+
+	boolean EmitLoad (TOpcode Opcode, u32 nK);
+	boolean EmitJump (TOpcode Opcode, u32 nK, TJumpLists *pResult);	// returns new lists
+	boolean EmitReturn (u32 nK);
+
+	void Patch (u16 nList, u16 nTarget);
+	u16 Merge (u16 nList1, u16 nList2);
+
+	// tokenizer
+	void NextToken (void);
+	boolean IsToken (const char *pToken) const;
+	boolean GetNumber (u32 *pNumber);
+	boolean GetIPAddress (u32 *pAddress);
+
+private:
+	TInsn m_Program[NET_CAPTURE_FILTER_MAX_INSNS];
+	unsigned m_nInsns;			// 0 matches all frames
+
+	const char *m_pNext;			// next character of the expression
+	char m_Token[24];
+};
+
+#endif
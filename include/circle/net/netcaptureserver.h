@@ -0,0 +1,63 @@
+//
+// netcaptureserver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netcaptureserver_h
+#define _circle_net_netcaptureserver_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netcapture.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/string.h>
+#include <circle/types.h>
+
+#define NET_CAPTURE_SERVER_PORT		2002
+#define NET_CAPTURE_SERVER_BUFFER_SIZE	0x4000
+
+/// \note Streams the captured frames as pcapng to one TCP client at a time, e.g.:\n
+///	  nc raspberrypi 2002 | wireshark -k -i -\n
+///	  The capture runs only while a client is connected. The frames of the stream\n
+///	  itself are excluded from the capture.
+
+class CNetCaptureServer : public CTask	/// Streams captured frames as pcapng over TCP
+{
+public:
+	/// \param pNetSubSystem Pointer to the network subsystem
+	/// \param pCapture Pointer to the capture object (must not be used otherwise)
+	/// \param pFilter Filter expression (see CNetCaptureFilter, 0 to capture all frames)
+	/// \param nPort TCP port to listen on
+	CNetCaptureServer (CNetSubSystem *pNetSubSystem, CNetCapture *pCapture,
+			   const char *pFilter = 0, u16 nPort = NET_CAPTURE_SERVER_PORT);
+	~CNetCaptureServer (void);
+
+	void Run (void);
+
+private:
+	void Stream (CSocket *pConnection);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	CNetCapture *m_pCapture;
+	CString m_Filter;
+	u16 m_nPort;
+
+	u8 m_Buffer[NET_CAPTURE_SERVER_BUFFER_SIZE];
+};
+
+#endif
@@ -25,8 +25,17 @@
 #include <circle/net/ipaddress.h>
 #include <circle/net/icmphandler.h>
 #include <circle/net/checksumcalculator.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/netbuffer.h>
 #include <circle/types.h>
 
+struct TNetMessage		// one datagram of a batch (see CSocket::SendBatch())
+{
+	CNetBuffer	*pBuffer;	// buffer holding the message
+	CIPAddress	 ForeignIP;	// IP address of the remote host
+	u16		 nForeignPort;	// port number of the remote host
+};
+
 class CNetConnection
 {
 public:
@@ -61,6 +70,22 @@ public:
 			    const CIPAddress &rForeignIP, u16 nForeignPort) = 0;
 	virtual int ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP, u16 *pForeignPort) = 0;
 
+	// zero-copy variants of the methods above, the reference to pBuffer is taken over
+	// (also on error), the default implementations copy the data
+	virtual int SendBuffer (CNetBuffer *pBuffer, int nFlags);
+	virtual int SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+				  const CIPAddress &rForeignIP, u16 nForeignPort);
+	// the returned *ppBuffer has to be released by the caller
+	virtual int ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags);
+	virtual int ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+				       CIPAddress *pForeignIP, u16 *pForeignPort);
+
+	// batch variants of SendBufferTo() and ReceiveBufferFrom(), return the number of
+	// messages (< 0 on error), the default implementations call them repeatedly
+	virtual int SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags);
+	// waits for the first message only (if nFlags == 0)
+	virtual int ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags);
+
 	virtual int SetOptionReceiveTimeout (unsigned nMicroSeconds) = 0;
 	virtual int SetOptionSendTimeout (unsigned nMicroSeconds) = 0;
 
@@ -68,6 +93,17 @@ public:
 
 	virtual int SetOptionAddMembership (const CIPAddress &rGroupAddress) = 0;
 	virtual int SetOptionDropMembership (const CIPAddress &rGroupAddress) = 0;
+	// source-specific multicast (UDP only, not supported by default)
+	virtual int SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+						  const CIPAddress &rSourceAddress);
+	virtual int SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+						   const CIPAddress &rSourceAddress);
+
+	virtual int SetOptionReceiveBuffer (unsigned nBytes) = 0;
+	virtual int SetOptionSendBuffer (unsigned nBytes) = 0;
+
+	virtual int SetOptionNoDelay (boolean bNoDelay) = 0;
+	virtual int SetOptionCork (boolean bCork) = 0;
 
 	virtual boolean IsConnected (void) const = 0;
 	virtual boolean IsTerminated (void) const = 0;
@@ -77,6 +113,9 @@ public:
 	// returns: -1: invalid packet, 0: not to me, 1: packet consumed
 	virtual int PacketReceived (const void *pPacket, unsigned nLength,
 				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol) = 0;
+	// same as PacketReceived(), the connection may keep a reference to pPacket (single segment)
+	virtual int BufferReceived (CNetBuffer *pPacket,
+				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
 
 	// returns: 0: not to me, 1: notification consumed
 	virtual int NotificationReceived (TICMPNotificationType Type,
@@ -93,6 +132,11 @@ public:
 	};
 	virtual TStatus GetStatus (void) const = 0;
 
+	// pEvent will be set on each change of GetStatus() (0 to detach)
+	void SetReadinessEvent (CSynchronizationEvent *pEvent);
+	// called from CTransportLayer::Process() after Process()
+	void UpdateReadiness (void);
+
 protected:
 	CNetConfig    *m_pNetConfig;
 	CNetworkLayer *m_pNetworkLayer;
@@ -103,6 +147,12 @@ protected:
 	int m_nProtocol;
 
 	CChecksumCalculator m_Checksum;
+
+	CNetFlow m_Flow;			// to m_ForeignIP, if connected
+
+private:
+	CSynchronizationEvent *m_pReadinessEvent;
+	unsigned m_nReadiness;			// last status as bit mask
 };
 
 #endif
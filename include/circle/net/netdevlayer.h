@@ -23,10 +23,15 @@
 #include <circle/net/netconfig.h>
 #include <circle/netdevice.h>
 #include <circle/net/netqueue.h>
+#include <circle/netbuffer.h>
 #include <circle/bcm54213.h>
 #include <circle/macb.h>
 #include <circle/types.h>
 
+class CNetCapture;
+
+#define NET_TX_BUDGET		16		// frames handed over to the net device at once
+
 class CNetDeviceLayer
 {
 public:
@@ -43,19 +48,46 @@ public:
 	void Send (const void *pBuffer, unsigned nLength);
 	boolean Receive (void *pBuffer, unsigned *pResultLength);
 
+	// the reference to pFrame is taken over
+	void Send (CNetBuffer *pFrame);
+	// returns 0 if nothing has been received, the caller has to release the buffer
+	CNetBuffer *Receive (void);
+
 	boolean IsRunning (void) const;		// is net device available and link up?
 
+	// returns NET_DEVICE_CAP_* bit mask (0, if net device is not available yet)
+	unsigned GetCapabilities (void) const;
+
+	// returns 0, if net device is not available yet
+	CNetDevice *GetNetDevice (void);
+
+	// pCapture gets all sent and received frames (0 to disable)
+	void SetCapture (CNetCapture *pCapture);
+
 	// terminated with 00:00:00:00:00:00
 	boolean SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE]);
 
+private:
+	void AttachDevice (void);
+
+	static void ReceiveHandler (void *pParam);	// called from IRQ context
+
 private:
 	TNetDeviceType m_DeviceType;
 	CNetConfig *m_pNetConfig;
 	CNetDevice *m_pDevice;
 
+	boolean m_bRxInterrupt;			// device signals received frames?
+	volatile boolean m_bRxPending;		// device has to be polled for frames?
+
+	CNetBuffer *m_pTxBatch[NET_TX_BUDGET];	// frames dequeued, but not sent yet
+	unsigned m_nTxBatch;
+
 	CNetQueue m_TxQueue;
 	CNetQueue m_RxQueue;
 
+	CNetCapture * volatile m_pCapture;
+
 #if RASPPI == 4
 	CBcm54213Device m_Bcm54213;
 #elif RASPPI >= 5
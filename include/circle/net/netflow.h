@@ -0,0 +1,65 @@
+//
+// netflow.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netflow_h
+#define _circle_net_netflow_h
+
+#include <circle/net/ipaddress.h>
+#include <circle/types.h>
+
+#define NET_FLOW_HEADER_SIZE	(14 + 20)	// Ethernet and IP header (without options)
+
+class CNetworkLayer;
+
+/// \note A flow is attached to a connection and is (re)built by CNetworkLayer::Send(),\n
+///	  when a packet to the same destination is sent the slow way, and the next hop\n
+///	  has been resolved. Sending on a valid flow prepends the cached header template\n
+///	  and fixes up the total length and the header checksum only. A flow becomes\n
+///	  invalid, when a route, the path MTU, the neighbor cache or the own IP address\n
+///	  changes.
+
+class CNetFlow		/// Cached route, neighbor and header template for one destination
+{
+public:
+	CNetFlow (void)
+	:	m_bValid (FALSE)
+	{
+	}
+
+	void Invalidate (void)
+	{
+		m_bValid = FALSE;
+	}
+
+private:
+	boolean	 m_bValid;
+	int	 m_nProtocol;
+	CIPAddress m_Destination;
+	unsigned m_nMTU;			// path MTU
+	unsigned m_nRouteGeneration;		// see CNetworkLayer
+	unsigned m_nNeighborGeneration;		// see CARPHandler
+	unsigned m_nNeighbor;			// ARP entry of the next hop (or ARP_NO_ENTRY)
+	u16	 m_nHeaderChecksum;		// of the template with a total length of 0
+
+	u8	 m_Header[NET_FLOW_HEADER_SIZE];	// Ethernet and IP header template
+
+	friend class CNetworkLayer;
+};
+
+#endif
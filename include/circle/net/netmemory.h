@@ -0,0 +1,67 @@
+//
+// netmemory.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_netmemory_h
+#define _circle_net_netmemory_h
+
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+enum TNetMemoryPressure
+{
+	NetMemoryNormal,		// buffers are used as configured
+	NetMemoryPressure,		// receive windows and queues are limited
+	NetMemoryCritical,		// no new data is accepted, no new connections
+	NetMemoryPressureUnknown
+};
+
+/// \note The TCP receive queues and retransmission buffers and the UDP receive queues are\n
+///	  charged to a global budget of NET_MEMORY_BUDGET bytes. Above 3/4 of the budget the\n
+///	  advertised TCP windows and the UDP receive buffers are limited to\n
+///	  NET_MEMORY_PRESSURE_LIMIT bytes per socket, at the budget the windows are closed,\n
+///	  UDP datagrams are dropped and new TCP connections are not accepted. Data within an\n
+///	  already advertised window is still accepted, so the budget can be exceeded for a\n
+///	  short time.
+
+class CNetMemory	/// Global accounting of the memory used by the socket buffers
+{
+public:
+	static void Charge (unsigned nBytes);
+	static void Uncharge (unsigned nBytes);
+
+	/// \return Number of bytes currently charged
+	static unsigned GetUsage (void);
+	/// \return Peak number of charged bytes
+	static unsigned GetMaxUsage (void);
+
+	static TNetMemoryPressure GetPressure (void);
+
+	/// \param nSize Configured buffer size of a socket (bytes)
+	/// \return Buffer size, which may be used with the current memory pressure
+	static unsigned LimitBuffer (unsigned nSize);
+
+	/// \return Is it allowed to allocate nBytes more (e.g. a larger buffer)?
+	static boolean CanGrow (unsigned nBytes);
+
+private:
+	static unsigned s_nUsage;
+	static unsigned s_nMaxUsage;
+};
+
+#endif
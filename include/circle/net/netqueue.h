@@ -20,30 +20,66 @@
 #ifndef _circle_net_netqueue_h
 #define _circle_net_netqueue_h
 
+#include <circle/netbuffer.h>
+#include <circle/pipelinestage.h>
 #include <circle/spinlock.h>
+#include <circle/sysconfig.h>
 #include <circle/types.h>
 
+#define NET_QUEUE_SLAB_ENTRIES		32	// entries are allocated in slabs of this size
+
 struct TNetQueueEntry;
+struct TNetQueueSlab;
 
 class CNetQueue
 {
 public:
-	CNetQueue (void);
+	// nHighWaterMark is the max. number of queued entries (0 for unlimited)
+	CNetQueue (unsigned nHighWaterMark = 0);
 	~CNetQueue (void);
 
 	boolean IsEmpty (void) const;
 	
 	void Flush (void);
 	
-	void Enqueue (const void *pBuffer, unsigned nLength, void *pParam = 0);
+	// returns FALSE, if the entry has been dropped (the caller has to free pParam then)
+	boolean Enqueue (const void *pBuffer, unsigned nLength, void *pParam = 0);
 
 	// returns length (0 if queue is empty)
 	unsigned Dequeue (void *pBuffer, void **ppParam = 0);
 
+	// enqueues the buffer without copying, the reference is taken over
+	// returns FALSE, if the entry has been dropped (the buffer has been released then)
+	boolean Enqueue (CNetBuffer *pBuffer, void *pParam = 0);
+
+	// returns 0 if queue is empty, the caller has to release the buffer
+	CNetBuffer *DequeueBuffer (void **ppParam = 0);
+
+	unsigned GetCount (void) const		{ return m_nCount; }
+	unsigned GetMaxCount (void) const	{ return m_nMaxCount; }	// peak number of entries
+	unsigned GetDropCount (void) const	{ return m_nDropCount; }
+
+	// records the time, which entries spend in this queue, as pipeline stage (0 to disable)
+	void SetPipelineStage (CPipelineStage *pStage)	{ m_pPipelineStage = pStage; }
+
 private:
+	TNetQueueEntry *AllocEntry (void);	// called with spin lock acquired
+
+private:
+	unsigned m_nHighWaterMark;
+
 	volatile TNetQueueEntry *m_pFirst;
 	volatile TNetQueueEntry *m_pLast;
 
+	TNetQueueEntry *m_pFreeList;
+	TNetQueueSlab *m_pSlabList;
+
+	unsigned m_nCount;
+	unsigned m_nMaxCount;
+	unsigned m_nDropCount;
+
+	CPipelineStage *m_pPipelineStage;
+
 	CSpinLock m_SpinLock;
 };
 
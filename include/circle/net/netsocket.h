@@ -127,6 +127,44 @@ public:
 	/// \return Status (0 success, < 0 on error)
 	virtual int SetOptionDropMembership (const CIPAddress &rGroupAddress) { return -1; }
 
+	/// \brief Add to IP multicast host group, for datagrams from one source only\n
+	/// (source-specific multicast, on UDP socket only)
+	/// \param rGroupAddress Group address to be added
+	/// \param rSourceAddress Source address to be included (unicast address)
+	/// \return Status (0 success, < 0 on error)
+	/// \note Can be called multiple times with the same group to include up to\n
+	///	   IGMP_MAX_SOURCES sources. Cannot be mixed with SetOptionAddMembership().
+	virtual int SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+						  const CIPAddress &rSourceAddress) { return -1; }
+
+	/// \brief Exclude a source from IP multicast host group again (on UDP socket only)
+	/// \param rGroupAddress Group address
+	/// \param rSourceAddress Source address to be removed
+	/// \return Status (0 success, < 0 on error)
+	/// \note The host group is dropped with the last source.
+	virtual int SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+						   const CIPAddress &rSourceAddress) { return -1; }
+
+	/// \brief Set the size of the receive buffer
+	/// \param nBytes Size in bytes (advertised receive window or queued datagrams)
+	/// \return Status (0 success, < 0 on error)
+	virtual int SetOptionReceiveBuffer (unsigned nBytes) { return -1; }
+
+	/// \brief Set the size of the send buffer (TCP only)
+	/// \param nBytes Size in bytes (limits the data in flight)
+	/// \return Status (0 success, < 0 on error)
+	virtual int SetOptionSendBuffer (unsigned nBytes) { return -1; }
+
+	/// \brief Disable Nagle's algorithm (TCP only)
+	/// \param bNoDelay Send small segments immediately? (default FALSE)
+	/// \return Status (0 success, < 0 on error)
+	virtual int SetOptionNoDelay (boolean bNoDelay) { return -1; }
+
+	/// \brief Hold back partial segments (TCP only)
+	/// \param bCork Send only full segments, until this is set to FALSE again (default FALSE)
+	/// \return Status (0 success, < 0 on error)
+	virtual int SetOptionCork (boolean bCork) { return -1; }
+
 	/// \brief Get IP address of connected remote host
 	/// \return Pointer to IP address (four bytes, 0-pointer if not connected)
 	virtual const u8 *GetForeignIP (void) const = 0;
@@ -25,6 +25,8 @@
 #include <circle/net/linklayer.h>
 #include <circle/net/networklayer.h>
 #include <circle/net/transportlayer.h>
+#include <circle/net/ipv6layer.h>
+#include <circle/sysconfig.h>
 #include <circle/string.h>
 #include <circle/types.h>
 
@@ -52,6 +54,9 @@ public:
 	CLinkLayer *GetLinkLayer (void);
 	CNetworkLayer *GetNetworkLayer (void);
 	CTransportLayer *GetTransportLayer (void);
+#ifdef NET_IPV6
+	CIPv6Layer *GetIPv6Layer (void);
+#endif
 
 	boolean IsRunning (void) const;			// is DHCP bound if used?
 
@@ -67,6 +72,9 @@ private:
 	CLinkLayer	m_LinkLayer;
 	CNetworkLayer	m_NetworkLayer;
 	CTransportLayer	m_TransportLayer;
+#ifdef NET_IPV6
+	CIPv6Layer	m_IPv6Layer;
+#endif
 
 	boolean		m_bUseDHCP;
 	CDHCPClient    *m_pDHCPClient;
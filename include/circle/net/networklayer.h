@@ -27,9 +27,15 @@
 #include <circle/net/icmphandler.h>
 #include <circle/net/igmphandler.h>
 #include <circle/net/routecache.h>
+#include <circle/net/ipreassembly.h>
+#include <circle/net/netflow.h>
 #include <circle/macros.h>
 #include <circle/types.h>
 
+#define IP_MTU_DEFAULT			1500	// for Ethernet and WLAN
+#define IP_MTU_MIN			576	// the path MTU is not reduced below this
+#define IP_MAX_DATAGRAM_SIZE		16384	// max. size of a fragmented datagram (with header)
+
 struct TIPHeader
 {
 	u8	nVersionIHL;
@@ -42,7 +48,7 @@ struct TIPHeader
 	u16	nIdentification;
 #define IP_IDENTIFICATION_DEFAULT	0
 	u16	nFlagsFragmentOffset;
-#define IP_FRAGMENT_OFFSET(field)	((field) & 0x1F00)
+#define IP_FRAGMENT_OFFSET(field)	((field) & 0x1FFF)	// in units of 8 bytes
 	#define IP_FRAGMENT_OFFSET_FIRST	0
 #define IP_FLAGS_DF			(1 << 6)	// valid without BE()
 #define IP_FLAGS_MF			(1 << 5)
@@ -55,6 +61,7 @@ struct TIPHeader
 	u8	DestinationAddress[IP_ADDRESS_SIZE];
 	//u32	nOptionsPadding;			// optional
 #define IP_OPTION_SIZE		0	// not used so far
+#define IP_ROUTER_ALERT_SIZE	4	// option, if bRouterAlert is set
 }
 PACKED;
 
@@ -77,10 +84,26 @@ public:
 
 	boolean Send (const CIPAddress &rReceiver, const void *pPacket, unsigned nLength,
 		      int nProtocol, boolean bRouterAlert = FALSE);
+	// the IP header is prepended to pPacket without copying the payload, the reference is
+	// taken over (also on error), packets larger than the path MTU are fragmented
+	boolean Send (const CIPAddress &rReceiver, CNetBuffer *pPacket,
+		      int nProtocol, boolean bRouterAlert = FALSE);
+	// same as before, but sends on the cached flow pFlow (if valid for rReceiver), otherwise
+	// the flow is (re)built after the next hop has been resolved (see CNetFlow)
+	boolean SendFlow (CNetFlow *pFlow, const CIPAddress &rReceiver, CNetBuffer *pPacket,
+			  int nProtocol);
+	// generic segmentation (GSO): the first buffer of pSegments holds the TCP header
+	// (template), each chained segment holds the payload of one TCP segment, to which
+	// a copy of the header is prepended in place (with updated sequence number and
+	// checksum, PSH and FIN only in the last one), the reference is taken over
+	boolean SendSegmented (const CIPAddress &rReceiver, CNetBuffer *pSegments, int nProtocol,
+			       CNetFlow *pFlow = 0);
 
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean Receive (void *pBuffer, unsigned *pResultLength,
 			 CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol);
+	// returns 0 if no packet is available, the caller has to release the buffer
+	CNetBuffer *Receive (CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol);
 
 	boolean ReceiveNotification (TICMPNotificationType *pType,
 				     CIPAddress *pSender, CIPAddress *pReceiver,
@@ -92,16 +115,44 @@ public:
 	boolean ReceiveICMP (void *pBuffer, unsigned *pResultLength,
 			     CIPAddress *pSender, CIPAddress *pReceiver);
 
-	boolean JoinHostGroup (const CIPAddress &rGroupAddress);
-	boolean LeaveHostGroup (const CIPAddress &rGroupAddress);
+	// pSourceAddress is 0 to join or leave for any source (see CIGMPHandler)
+	boolean JoinHostGroup (const CIPAddress &rGroupAddress, const CIPAddress *pSourceAddress = 0);
+	boolean LeaveHostGroup (const CIPAddress &rGroupAddress, const CIPAddress *pSourceAddress = 0);
+
+	// returns NET_DEVICE_CAP_* bit mask of the net device
+	unsigned GetCapabilities (void) const;
 
 private:
+	// returns FALSE, if the packet has been dropped (the caller has to release it then)
+	boolean ProcessPacket (CNetBuffer *pPacket, const CIPAddress *pOwnIPAddress);
+
+	// the reference to pPacketBuffer (with IP header) is taken over
+	boolean SendPacket (const CIPAddress &rReceiver, CNetBuffer *pPacketBuffer);
+	// the reference to pPacket (without IP header) is taken over
+	boolean SendFragmented (const CIPAddress &rReceiver, CNetBuffer *pPacket,
+				int nProtocol, unsigned nMTU);
+
+	// returns 0, if the destination is not reachable (pGatewayIP receives a cached route)
+	const CIPAddress *GetNextHop (const CIPAddress &rReceiver, CIPAddress *pGatewayIP) const;
+
+	boolean IsFlowValid (const CNetFlow *pFlow, const CIPAddress &rReceiver, int nProtocol) const;
+	void BuildFlow (CNetFlow *pFlow, const CIPAddress &rReceiver, int nProtocol);
+
+	void SetupHeader (TIPHeader *pHeader, unsigned nHeaderLength, unsigned nPacketLength,
+			  u16 nIdentification, u16 nFlagsFragmentOffset,
+			  const CIPAddress &rReceiver, int nProtocol);
+
+	unsigned GetPathMTU (const CIPAddress &rReceiver) const;
+
 	void AddRoute (const u8 *pDestIP, const u8 *pGatewayIP);
 	const u8 *GetGateway (const u8 *pDestIP) const;
+	// on ICMP "fragmentation needed" (see RFC 1191)
+	void PathMTUReduced (const u8 *pDestIP, unsigned nMTU);
 	friend class CICMPHandler;
 
 	// post IP packet to the ICMP handler for notification
 	void SendFailed (unsigned nICMPCode, const void *pReturnedPacket, unsigned nLength);
+	void SendFailed (unsigned nICMPCode, const CNetBuffer *pReturnedPacket);
 	friend class CLinkLayer;
 
 private:
@@ -118,6 +169,11 @@ private:
 	CNetQueue *m_pICMPRxQueue2;
 
 	CRouteCache m_RouteCache;
+
+	CIPReassembly m_Reassembly;
+	u16 m_nNextIdentification;		// for fragmented datagrams
+
+	unsigned m_nRouteGeneration;		// changes with routes and path MTUs (see CNetFlow)
 };
 
 #endif
@@ -0,0 +1,151 @@
+//
+// ptpclient.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_ptpclient_h
+#define _circle_net_ptpclient_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/netdevice.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define PTP_CLOCK_IDENTITY_SIZE		8
+#define PTP_PORT_IDENTITY_SIZE		(PTP_CLOCK_IDENTITY_SIZE + 2)
+
+class CPTPClient : public CTask	/// PTP (IEEE 1588-2008) slave-only ordinary clock over UDP/IPv4
+{
+public:
+	/// \param pNetSubSystem Pointer to the network subsystem
+	/// \param uchDomain PTP domain number to be synchronized to
+	CPTPClient (CNetSubSystem *pNetSubSystem, u8 uchDomain = 0);
+	~CPTPClient (void);
+
+	void Run (void);
+
+	/// \return TRUE if the local clock is locked to a master
+	boolean IsSynchronized (void) const;
+
+	/// \return TRUE if the net device timestamps the PTP event frames in hardware
+	boolean IsHardwareTimestamping (void) const;
+
+	/// \brief Get the current PTP time
+	/// \param pNanoSeconds Nanoseconds since 1970-01-01 00:00:00 (TAI) will be stored here
+	/// \return FALSE if not synchronized
+	boolean GetTime (u64 *pNanoSeconds);
+
+	/// \brief Convert a value of CTimer::GetClockTicks64() to PTP time
+	/// \param nClockTicks Value of the 1 MHz system clock
+	/// \param pNanoSeconds Nanoseconds since 1970-01-01 00:00:00 (TAI) will be stored here
+	/// \return FALSE if not synchronized
+	/// \note Can be used to timestamp samples, which have been taken with the system clock.
+	boolean ConvertClockTicks (u64 nClockTicks, u64 *pNanoSeconds);
+
+	/// \return Last measured offset of the local clock from the master in nanoseconds
+	s64 GetOffsetFromMaster (void) const;
+	/// \return Filtered mean path delay to the master in nanoseconds
+	s64 GetMeanPathDelay (void) const;
+	/// \return Current frequency correction of the local clock in ppb
+	int GetFrequencyCorrection (void) const;
+
+private:
+	void ProcessMessage (const u8 *pMessage, unsigned nLength, u64 nRxTime);
+	void ProcessAnnounce (const u8 *pMessage, unsigned nLength);
+	void ProcessSync (const u8 *pMessage, unsigned nLength, u64 nRxTime);
+	void ProcessFollowUp (const u8 *pMessage, unsigned nLength);
+	void ProcessDelayResp (const u8 *pMessage, unsigned nLength);
+
+	void SendDelayReq (void);
+
+	void SyncCompleted (void);
+	void UpdateClock (s64 nOffset, s64 nInterval);
+
+	void ReleaseMaster (void);
+
+	// local clock (PTP clock of the net device, or derived from the system clock)
+	u64 GetLocalTime (void);
+	void StepLocalClock (s64 nNanoSeconds);
+	void SetLocalClockRate (int nPPB);
+
+	// maps the system clock to the local clock
+	u64 MapClockTicks (u64 nClockTicks);
+	void SampleLocalClock (void);		// hardware clock only
+
+	void UpdateSystemTime (void);
+
+	static u64 GetTimestamp (const u8 *pBuffer);
+	static s64 GetCorrection (const u8 *pHeader);
+	static void PutHeader (u8 *pBuffer, u8 uchType, u16 usLength, u8 uchDomain,
+			       const u8 *pPortIdentity, u16 usSequenceId, u8 uchControl);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	u8 m_uchDomain;
+
+	CNetDevice *m_pNetDevice;
+	boolean m_bHardware;
+
+	CSocket *m_pEventSocket;		// valid while Run() is active
+
+	u8 m_PortIdentity[PTP_PORT_IDENTITY_SIZE];
+
+	boolean m_bMasterValid;
+	u8 m_MasterPortIdentity[PTP_PORT_IDENTITY_SIZE];
+	u8 m_MasterPriority[14];		// priority vector of the Announce message
+	unsigned m_nLastAnnounceTicks;
+	int m_nUTCOffset;			// TAI - UTC in seconds
+	boolean m_bPTPTimescale;
+
+	// Sync / Follow_Up
+	boolean m_bSyncPending;			// waiting for Follow_Up
+	u16 m_usSyncSequenceId;
+	u64 m_t1;				// master sends Sync
+	u64 m_t2;				// slave receives Sync
+	s64 m_nSyncCorrection;
+	u64 m_nLastSyncOrigin;			// t1 of the previous Sync (0 if invalid)
+
+	// Delay_Req / Delay_Resp
+	boolean m_bDelayReqPending;
+	u16 m_usDelaySequenceId;
+	unsigned m_nDelayReqTicks;
+	s64 m_nMasterToSlave;			// t2 - t1 at the time Delay_Req was sent
+	u64 m_t3;				// slave sends Delay_Req
+	boolean m_bDelayValid;
+	s64 m_nMeanPathDelay;
+
+	// servo
+	boolean m_bSynchronized;
+	unsigned m_nLockedCount;
+	unsigned m_nOutlierCount;
+	s64 m_nOffset;
+	s64 m_nDrift;				// integral part in ppb
+	int m_nFrequency;			// in ppb
+
+	// system clock -> local clock mapping (is the local clock without hardware)
+	u64 m_nRefTime;
+	u64 m_nRefTicks;
+	int m_nRefPPB;				// rate of the local clock relative to the system clock
+	boolean m_bRefValid;
+	CSpinLock m_RefSpinLock;
+
+	unsigned m_nLastSystemTimeUpdate;	// in seconds of uptime
+};
+
+#endif
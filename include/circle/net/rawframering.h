@@ -0,0 +1,109 @@
+//
+// rawframering.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_rawframering_h
+#define _circle_net_rawframering_h
+
+#include <circle/netdevice.h>
+#include <circle/types.h>
+
+class CLinkLayer;
+
+#define RAW_FRAME_SLOT_SIZE	1664		// multiple of the cache line size
+
+struct TRawFrameSlot		/// One frame slot of a CRawFrameRing
+{
+	volatile u32	nStatus;		// hands the slot over between the net task and the user
+#define RAW_SLOT_STATUS_KERNEL		0	// RX: slot may be filled by the net task
+#define RAW_SLOT_STATUS_USER		1	// RX: slot holds a received frame
+#define RAW_SLOT_STATUS_AVAILABLE	0	// TX: slot may be written by the user
+#define RAW_SLOT_STATUS_SEND_REQUEST	1	// TX: slot holds a frame to be sent
+	u16		nLength;		// of the frame, including the Ethernet header
+	u16		nReserved;
+	u64		nTimestamp;		// RX: CTimer::GetClockTicks64() on receive
+	u8		Frame[RAW_FRAME_SLOT_SIZE - 16];	// starts with the Ethernet header
+};
+
+/// \note The ring has a single producer and a single consumer in each direction, the slots\n
+///	  are handed over with the status word only. The net task copies each received frame\n
+///	  with the given EtherType into the next RX slot, the user reads it in place and hands\n
+///	  it back with ReleaseRxFrame(). A TX frame is written in place into the slot returned\n
+///	  by GetTxFrame() and is handed over to the net device layer by Flush(), which is\n
+///	  called by the net task too, if the user does not call it once per cycle.
+/// \note When the RX ring is full, received frames are dropped and counted.
+
+class CRawFrameRing	/// Shared RX/TX ring of raw Ethernet frames for one EtherType
+{
+public:
+	/// \param pLinkLayer Pointer to the link layer of the net subsystem
+	/// \param nEtherType EtherType of the received frames (host byte order, e.g. 0x88A4)
+	/// \param nRxSlots Number of RX slots
+	/// \param nTxSlots Number of TX slots
+	CRawFrameRing (CLinkLayer *pLinkLayer, u16 nEtherType,
+		       unsigned nRxSlots = 64, unsigned nTxSlots = 16);
+	~CRawFrameRing (void);
+
+	/// \return Operation successful? (fails, if the EtherType is already used)
+	boolean Initialize (void);
+
+	/// \return Next received frame (0 if none), remains valid until ReleaseRxFrame()
+	TRawFrameSlot *GetRxFrame (void);
+	/// \brief Hand the slot returned by GetRxFrame() back to the net task
+	void ReleaseRxFrame (void);
+
+	/// \return Next free TX slot (0 if all slots wait to be sent)
+	/// \note Write the frame (with Ethernet header) to Frame[] and call SendTxFrame().
+	TRawFrameSlot *GetTxFrame (void);
+	/// \param nLength Length of the frame written to the slot returned by GetTxFrame()
+	void SendTxFrame (unsigned nLength);
+
+	/// \brief Hand all frames requested with SendTxFrame() over to the net device layer
+	/// \return Number of frames handed over
+	/// \note Must be called on TASK_LEVEL.
+	unsigned Flush (void);
+
+	/// \return Number of received frames, which have been dropped, because the RX ring was full
+	unsigned GetDropped (void) const;
+
+	/// \return EtherType in network byte order
+	u16 GetEtherType (void) const;
+
+public:
+	/// \brief Called by the link layer for each received frame with our EtherType
+	void FrameReceived (const void *pFrame, unsigned nLength);
+
+private:
+	CLinkLayer *m_pLinkLayer;
+	u16 m_nEtherType;			// network byte order
+	boolean m_bAttached;
+
+	unsigned m_nRxSlots;
+	TRawFrameSlot *m_pRxRing;
+	unsigned m_nRxIn;			// next slot filled by the net task
+	unsigned m_nRxOut;			// next slot read by the user
+
+	unsigned m_nTxSlots;
+	TRawFrameSlot *m_pTxRing;
+	unsigned m_nTxIn;			// next slot written by the user
+	unsigned m_nTxOut;			// next slot sent by Flush()
+
+	unsigned m_nDropped;
+};
+
+#endif
@@ -38,8 +38,18 @@ public:
 	void Advance (unsigned nBytes);
 	void Reset (void);
 
+	// bytes which have been read, but not acknowledged yet
+	unsigned GetBytesUnacknowledged (void) const;
+	// read already sent data again, nOffset is counted from the first unacknowledged byte,
+	// does not modify the read pointer (for selective retransmission)
+	void ReadAt (unsigned nOffset, void *pBuffer, unsigned nLength) const;
+
 	void Flush (void);
 
+	unsigned GetSize (void) const		{ return m_nSize; }
+	// keeps queued data, returns FALSE if it does not fit into the new size
+	boolean Resize (unsigned nSize);
+
 private:
 	unsigned m_nSize;
 
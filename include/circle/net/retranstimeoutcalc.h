@@ -32,15 +32,20 @@ public:
 
 	unsigned GetRTO (void) const;
 
+	unsigned GetSmoothedRTT (void) const;		// in microseconds (0 if unknown)
+	unsigned GetMinimumRTT (void) const;		// in microseconds (0 if unknown)
+
 	void Initialize (u32 nISN);
 
 	void SegmentSent (u32 nSequenceNumber, u32 nLength = 1);
 	void SegmentAcknowledged (u32 nAcknowledgmentNumber);		// called for valid ACKs only
+	void RTTMeasured (unsigned nRTT);				// from TCP timestamps (RFC 7323)
 
 	void RetransmissionTimerExpired (void);
 
 private:
 	void Calculate (unsigned nRTT);
+	void CalculateFine (unsigned nRTT);		// in microseconds
 
 private:
 	CTimer *m_pTimer;
@@ -54,7 +59,12 @@ private:
 
 	boolean m_bMeasurementRuns;
 	unsigned m_nStartTicks;
+	unsigned m_nStartClockTicks;
 	unsigned m_nRetransmissions;
+	boolean m_bTimestampSample;		// RTO has been calculated from timestamps
+
+	unsigned m_nSRTTFine;			// microseconds
+	unsigned m_nMinRTTFine;
 
 	CSpinLock m_SpinLock;
 };
@@ -23,6 +23,9 @@
 #include <circle/ptrarray.h>
 #include <circle/types.h>
 
+#define ROUTE_CACHE_MAX_PMTU_ENTRIES	64	// entries without route are limited to this
+#define ROUTE_CACHE_PMTU_TIMEOUT	600	// seconds, path MTU is probed again then
+
 class CRouteCache
 {
 public:
@@ -35,6 +38,14 @@ public:
 
 	const u8 *GetRoute (const u8 *pDestIP) const;
 
+	void SetPathMTU (const u8 *pDestIP, unsigned nMTU);
+
+	// returns 0, if unknown or timed out
+	unsigned GetPathMTU (const u8 *pDestIP) const;
+
+private:
+	void *Lookup (const u8 *pDestIP) const;
+
 public:
 	CPtrArray m_Cache;
 };
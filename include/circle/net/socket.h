@@ -2,7 +2,7 @@
 // socket.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -25,6 +25,8 @@
 #include <circle/net/netconfig.h>
 #include <circle/net/transportlayer.h>
 #include <circle/net/error.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/sched/asyncflow.h>
 #include <circle/types.h>
 
 #define SOCKET_MAX_LISTEN_BACKLOG	32
@@ -66,7 +68,8 @@ public:
 	/// \brief Send a message to a remote host
 	/// \param pBuffer Pointer to the message
 	/// \param nLength Length of the message
-	/// \param nFlags  MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \param nFlags  MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)\n
+	///		   may be or-ed with MSG_MORE (TCP only, more data follows shortly)
 	/// \return Length of the sent message (< 0 on error)
 	int Send (const void *pBuffer, unsigned nLength, int nFlags);
 
@@ -80,7 +83,8 @@ public:
 
 	/// \brief Send a message to a specific remote host
 	/// \param pBuffer	Pointer to the message
-	/// \param nLength	Length of the message
+	/// \param nLength	Length of the message (up to UDP_MAX_MESSAGE_SIZE on UDP socket,\n
+	///			larger than the path MTU is sent in IP fragments)
 	/// \param nFlags	MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
 	/// \param rForeignIP	IP address of host to be sent to (ignored on TCP socket)
 	/// \param nForeignPort	Number of port to be sent to (ignored on TCP socket)
@@ -96,9 +100,69 @@ public:
 	/// \param pForeignIP	IP address of host which has sent the message will be returned here
 	/// \param pForeignPort	Number of port from which the message has been sent will be returned here
 	/// \return Length of received message (0 with MSG_DONTWAIT if no message available, < 0 on error)
+	/// \note Reassembled UDP messages are truncated to FRAME_BUFFER_SIZE bytes here,\n
+	///	  ReceiveBufferFrom() returns them completely.
 	int ReceiveFrom (void *pBuffer, unsigned nLength, int nFlags,
 			 CIPAddress *pForeignIP, u16 *pForeignPort);
 
+	/// \brief Send a message to a remote host without copying the data
+	/// \param pBuffer Buffer (chain) holding the message (up to FRAME_BUFFER_SIZE bytes),\n
+	///		   the reference is taken over (also on error)
+	/// \param nFlags  MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)\n
+	///		   may be or-ed with MSG_MORE (TCP only, more data follows shortly)
+	/// \return Length of the sent message (< 0 on error)
+	/// \note The protocol headers are prepended in place on UDP sockets, if the buffer has\n
+	///	  been allocated with the default headroom (CNetBuffer::Alloc()).
+	int SendBuffer (CNetBuffer *pBuffer, int nFlags);
+
+	/// \brief Receive a message from a remote host without copying the data
+	/// \param ppBuffer Pointer to the buffer holding the message will be returned here\n
+	///		    (0 if no message is returned), it has to be released by the caller
+	/// \param nFlags MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \return Length of received message (0 with MSG_DONTWAIT if no message available, < 0 on error)
+	int ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags);
+
+	/// \brief Send a message to a specific remote host without copying the data
+	/// \param pBuffer	Buffer (chain) holding the message (up to FRAME_BUFFER_SIZE bytes),\n
+	///			the reference is taken over (also on error)
+	/// \param nFlags	MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \param rForeignIP	IP address of host to be sent to (ignored on TCP socket)
+	/// \param nForeignPort	Number of port to be sent to (ignored on TCP socket)
+	/// \return Length of the sent message (< 0 on error)
+	int SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+			  const CIPAddress &rForeignIP, u16 nForeignPort);
+
+	/// \brief Receive a message from a remote host without copying the data,\n
+	///	   return host/port of remote host
+	/// \param ppBuffer Pointer to the buffer holding the message will be returned here\n
+	///		    (0 if no message is returned), it has to be released by the caller
+	/// \param nFlags MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \param pForeignIP	IP address of host which has sent the message will be returned here
+	/// \param pForeignPort	Number of port from which the message has been sent will be returned here
+	/// \return Length of received message (0 with MSG_DONTWAIT if no message available, < 0 on error)
+	int ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+			       CIPAddress *pForeignIP, u16 *pForeignPort);
+
+	/// \brief Send a batch of messages to remote hosts without copying the data (UDP only)
+	/// \param pMessages	Array of messages, each with a buffer (chain) holding up to\n
+	///			FRAME_BUFFER_SIZE bytes and the address of the remote host (ignored\n
+	///			after Connect()), the references to the buffers are taken over (also on error)
+	/// \param nCount	Number of messages in the array
+	/// \param nFlags	MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \return Number of sent messages (< 0 on error, if no message has been sent)
+	/// \note The frames of a batch are handed over to the net device together.
+	int SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags);
+
+	/// \brief Receive a batch of messages from remote hosts without copying the data (UDP only)
+	/// \param pMessages	Array of messages, which receive the buffers (have to be released\n
+	///			by the caller) and the addresses of the remote hosts
+	/// \param nCount	Number of messages in the array
+	/// \param nFlags	MSG_DONTWAIT (non-blocking operation) or 0 (blocking operation)
+	/// \return Number of received messages (0 with MSG_DONTWAIT if no message available,\n
+	///	    < 0 on error)
+	/// \note Waits for the first message only and returns the messages, which are available then.
+	int ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags);
+
 	/// \brief Set a timeout for Receive() and ReceiveFrom()
 	/// \param nMicroSeconds Timeout in us (or 0 to wait forever, default)
 	/// \return Status (0 success, < 0 on error)
@@ -128,6 +192,51 @@ public:
 	/// \return Status (0 success, < 0 on error)
 	int SetOptionDropMembership (const CIPAddress &rGroupAddress);
 
+	/// \brief Add to IP multicast host group, for datagrams from one source only\n
+	/// (source-specific multicast, on UDP socket only)
+	/// \param rGroupAddress Group address to be added
+	/// \param rSourceAddress Source address to be included (unicast address)
+	/// \return Status (0 success, < 0 on error)
+	/// \note Can be called multiple times with the same group to include up to\n
+	///	   IGMP_MAX_SOURCES sources. Cannot be mixed with SetOptionAddMembership().
+	int SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+					  const CIPAddress &rSourceAddress);
+
+	/// \brief Exclude a source from IP multicast host group again (on UDP socket only)
+	/// \param rGroupAddress Group address
+	/// \param rSourceAddress Source address to be removed
+	/// \return Status (0 success, < 0 on error)
+	/// \note The host group is dropped with the last source.
+	int SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+					   const CIPAddress &rSourceAddress);
+
+	/// \brief Set the size of the receive buffer
+	/// \param nBytes Size in bytes (up to TCP_MAX_BUFFER_SIZE), limits the advertised receive window\n
+	///	  (TCP) or the payload of the queued datagrams (UDP, default UDP_DEFAULT_RECEIVE_BUFFER)
+	/// \return Status (0 success, < 0 on error)
+	/// \note Can be called before Connect() or Listen(). Accept()-ed sockets inherit the setting.
+	/// \note The buffer is limited further, when the network memory is low (see CNetMemory).
+	int SetOptionReceiveBuffer (unsigned nBytes);
+
+	/// \brief Set the size of the send buffer (TCP only)
+	/// \param nBytes Size in bytes (up to TCP_MAX_BUFFER_SIZE), limits the data in flight
+	/// \return Status (0 success, < 0 on error, -NET_ERROR_NO_BUFFER_SPACE if the network memory is low)
+	/// \note Can be called before Connect() or Listen(). Accept()-ed sockets inherit the setting.
+	int SetOptionSendBuffer (unsigned nBytes);
+
+	/// \brief Disable Nagle's algorithm (TCP only)
+	/// \param bNoDelay Send small segments immediately, even if data is unacknowledged? (default FALSE)
+	/// \return Status (0 success, < 0 on error)
+	/// \note Can be called before Connect() or Listen(). Accept()-ed sockets inherit the setting.
+	int SetOptionNoDelay (boolean bNoDelay);
+
+	/// \brief Hold back partial segments (TCP only)
+	/// \param bCork Send only full segments, until this is set to FALSE again (default FALSE)
+	/// \return Status (0 success, < 0 on error)
+	/// \note Partial segments are still sent after 200ms. Send() with MSG_MORE corks until\n
+	/// the next Send() without this flag.
+	int SetOptionCork (boolean bCork);
+
 	/// \brief Get IP address of connected remote host
 	/// \return Pointer to IP address (four bytes, 0-pointer if not connected)
 	const u8 *GetForeignIP (void) const;
@@ -136,9 +245,34 @@ public:
 	/// \return Socket status
 	TStatus GetStatus (void) const;
 
+	/// \return Is this socket listening for incoming connections?
+	boolean IsListening (void) const;
+
+	/// \brief Attach an event, which is set on each status change of this socket
+	/// \param pEvent Pointer to event (0 to detach)
+	/// \note Used by CSocketPoller. Only one event can be attached at a time.
+	void SetReadinessEvent (CSynchronizationEvent *pEvent);
+
+	/// \brief Receive a message from a remote host in an async flow (see ASYNC_AWAIT())
+	/// \param pFlow   Pointer to the calling flow
+	/// \param pBuffer Pointer to buffer for received data (must be valid until completion)
+	/// \param nLength Size of buffer in bytes
+	/// \return Operation completed? (the result is the length of the message, or < 0 on error)
+	/// \note Uses the readiness event of the socket, while the operation is pending.
+	boolean AwaitReceive (CAsyncFlow *pFlow, void *pBuffer, unsigned nLength);
+	/// \brief Send a message to a remote host in an async flow (see ASYNC_AWAIT())
+	/// \param pFlow   Pointer to the calling flow
+	/// \param pBuffer Pointer to message to be sent (must be valid until completion)
+	/// \param nLength Length of the message in bytes
+	/// \return Operation completed? (the result is the number of sent bytes, or < 0 on error)
+	/// \note Uses the readiness event of the socket, while the operation is pending.
+	boolean AwaitSend (CAsyncFlow *pFlow, const void *pBuffer, unsigned nLength);
+
 private:
 	CSocket (CSocket &rSocket, int hConnection);
 
+	void ApplyOptions (int hConnection);
+
 private:
 	CNetConfig	*m_pNetConfig;
 	CTransportLayer	*m_pTransportLayer;
@@ -149,6 +283,12 @@ private:
 
 	unsigned m_nBackLog;
 	int m_hListenConnection[SOCKET_MAX_LISTEN_BACKLOG];
+
+	unsigned m_nReceiveBufferSize;		// 0 for default
+	unsigned m_nSendBufferSize;
+	boolean m_bNoDelay;
+
+	CSynchronizationEvent *m_pReadinessEvent;
 };
 
 #endif
@@ -0,0 +1,111 @@
+//
+// socketpoller.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_socketpoller_h
+#define _circle_net_socketpoller_h
+
+#include <circle/net/socket.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/types.h>
+
+#define SOCKET_POLL_READABLE		(1 << 0)	///< Receive() will not block
+#define SOCKET_POLL_WRITABLE		(1 << 1)	///< Send() will not block
+#define SOCKET_POLL_ACCEPT		(1 << 2)	///< Accept() will not block (listening socket)
+#define SOCKET_POLL_ERROR		(1 << 3)	///< Connection lost (always reported)
+
+#define SOCKET_POLL_EDGE_TRIGGERED	(1 << 8)	///< Report only transitions to ready
+
+class CSocketPoller	/// Waits for readiness of multiple sockets from a single task
+{
+public:
+	struct TEvent
+	{
+		CSocket	 *pSocket;
+		unsigned  nEvents;		///< SOCKET_POLL_* which are ready
+		void	 *pParam;		///< user parameter given to Add()
+	};
+
+public:
+	/// \param nMaxSockets Maximum number of sockets, which can be added
+	CSocketPoller (unsigned nMaxSockets);
+
+	/// \note All sockets are removed from the poller.
+	~CSocketPoller (void);
+
+	/// \brief Add a socket to the poller
+	/// \param pSocket Pointer to socket (must not be added to another poller)
+	/// \param nEvents SOCKET_POLL_* to wait for, optionally or-ed with SOCKET_POLL_EDGE_TRIGGERED
+	/// \param pParam User parameter, which is returned with the event
+	/// \return Status (0 success, < 0 on error)
+	/// \note Must be removed, before the socket or an accept()-ed socket is deleted.
+	int Add (CSocket *pSocket, unsigned nEvents, void *pParam = 0);
+
+	/// \brief Change the events to wait for
+	/// \param pSocket Pointer to socket, which has been added before
+	/// \param nEvents SOCKET_POLL_* to wait for, optionally or-ed with SOCKET_POLL_EDGE_TRIGGERED
+	/// \return Status (0 success, < 0 on error)
+	int Modify (CSocket *pSocket, unsigned nEvents);
+
+	/// \brief Remove a socket from the poller
+	/// \param pSocket Pointer to socket, which has been added before
+	/// \return Status (0 success, < 0 on error)
+	int Remove (CSocket *pSocket);
+
+	/// \brief Wait for sockets to become ready
+	/// \param pEvents Array of events to be filled
+	/// \param nMaxEvents Size of the array
+	/// \param nMicroSeconds Timeout in microseconds (0 to wait forever)
+	/// \return Number of returned events (0 on timeout)
+	/// \note With SOCKET_POLL_EDGE_TRIGGERED an event is returned only once after the\n
+	///	  socket became ready. The caller has to Receive() or Send() until\n
+	///	  -NET_ERROR_WOULD_BLOCK (or Accept() until no connection is pending),\n
+	///	  before the same event is returned again.
+	int Wait (TEvent *pEvents, unsigned nMaxEvents, unsigned nMicroSeconds = 0);
+
+	/// \brief Check the sockets for readiness without blocking
+	/// \param pEvents Array of events to be filled
+	/// \param nMaxEvents Size of the array
+	/// \return Number of returned events
+	int Poll (TEvent *pEvents, unsigned nMaxEvents);
+
+private:
+	int Find (CSocket *pSocket) const;
+
+	static unsigned GetReadiness (CSocket *pSocket, boolean *pWasConnected);
+
+private:
+	unsigned m_nMaxSockets;
+	unsigned m_nSockets;
+
+	struct TEntry
+	{
+		CSocket	 *pSocket;
+		unsigned  nEvents;		// requested
+		unsigned  nReported;		// reported as ready before (edge-triggered only)
+		boolean	  bWasConnected;	// for detecting a lost connection
+		void	 *pParam;
+	};
+
+	TEntry *m_pEntry;
+	unsigned m_nNextEntry;			// next entry to be checked first (fairness)
+
+	CSynchronizationEvent m_Event;
+};
+
+#endif
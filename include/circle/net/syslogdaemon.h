@@ -33,6 +33,8 @@
 #define SYSLOG_VERSION		1
 #define SYSLOG_PORT		514
 
+#define SYSLOG_SD_ID		"fields@32473"	// SD-ID for the fields of structured messages
+
 class CSysLogDaemon : public CTask
 {
 public:
@@ -43,9 +45,7 @@ public:
 	void Run (void);
 
 private:
-	boolean SendMessage (TLogSeverity Severity,
-			     time_t FullTime, unsigned nPartialTime, int nTimeNumOffset,
-			     const char *pAppName, const char *pMsg);
+	boolean SendMessage (const TLogEvent &Event);
 
 	unsigned CalculatePriority (const char *pSource, TLogSeverity Severity);
 
@@ -0,0 +1,80 @@
+//
+// tcpcongestioncontrol.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_tcpcongestioncontrol_h
+#define _circle_net_tcpcongestioncontrol_h
+
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+enum TTCPCongestionAlgorithm
+{
+	TCPCongestionNewReno,
+	TCPCongestionCUBIC,
+	TCPCongestionUnknown
+};
+
+class CTCPCongestionControl	/// Base class of the TCP congestion control algorithms
+{
+public:
+	CTCPCongestionControl (void);
+	virtual ~CTCPCongestionControl (void);
+
+	/// \return Name of the algorithm
+	virtual const char *GetName (void) const = 0;
+
+	/// \brief Set initial window (RFC 6928), called when the connection has been established
+	/// \param nMSS Maximum number of data bytes in a segment
+	virtual void Initialize (unsigned nMSS);
+
+	/// \return Congestion window in bytes
+	unsigned GetWindow (void) const			{ return m_nCongestionWindow; }
+	/// \return Slow start threshold in bytes
+	unsigned GetSlowStartThreshold (void) const	{ return m_nSlowStartThreshold; }
+	/// \return Is the connection in slow start?
+	boolean IsSlowStart (void) const	{ return m_nCongestionWindow < m_nSlowStartThreshold; }
+
+	/// \brief New data has been acknowledged (not called during fast recovery)
+	/// \param nBytesAcked Number of newly acknowledged bytes
+	/// \param nSmoothedRTT Smoothed round-trip time in microseconds (0 if unknown)
+	virtual void DataAcknowledged (unsigned nBytesAcked, unsigned nSmoothedRTT) = 0;
+
+	/// \brief A loss has been detected by duplicate ACKs (fast retransmit)
+	/// \param nFlightSize Number of bytes, which are outstanding
+	virtual void CongestionDetected (unsigned nFlightSize) = 0;
+
+	/// \brief The retransmission timer has expired
+	/// \param nFlightSize Number of bytes, which are outstanding
+	virtual void RetransmissionTimeout (unsigned nFlightSize);
+
+	/// \return Pacing rate relative to cwnd/SRTT in percent
+	virtual unsigned GetPacingGain (void) const;
+
+	/// \param Algorithm Algorithm to be used
+	/// \return Pointer to new congestion control object (caller has to delete it)
+	static CTCPCongestionControl *Create (TTCPCongestionAlgorithm Algorithm
+						= (TTCPCongestionAlgorithm) TCP_CONGESTION_CONTROL);
+
+protected:
+	unsigned m_nMSS;
+	unsigned m_nCongestionWindow;		// bytes
+	unsigned m_nSlowStartThreshold;		// bytes
+};
+
+#endif
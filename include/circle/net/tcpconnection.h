@@ -27,6 +27,7 @@
 #include <circle/net/netqueue.h>
 #include <circle/net/retransmissionqueue.h>
 #include <circle/net/retranstimeoutcalc.h>
+#include <circle/net/tcpcongestioncontrol.h>
 #include <circle/sched/synchronizationevent.h>
 #include <circle/timer.h>
 #include <circle/spinlock.h>
@@ -52,10 +53,22 @@ enum TTCPTimer
 	TCPTimerUser,
 	TCPTimerRetransmission,
 	TCPTimerTimeWait,
+	TCPTimerDelayedACK,
 	TCPTimerUnknown
 };
 
+#define TCP_MAX_BUFFER_SIZE		0x100000	// max. receive/send buffer size per connection
+
+#define TCP_MAX_SACK_SCOREBOARD		8		// max. number of SACK-ed blocks remembered
+
+struct TTCPSACKBlock			// seq. numbers nLeft..nRight-1 have been received by the peer
+{
+	u32	nLeft;
+	u32	nRight;
+};
+
 struct TTCPHeader;
+struct TTCPSegmentOptions;
 
 class CTCPConnection : public CNetConnection
 {
@@ -83,6 +96,13 @@ public:
 		    const CIPAddress &rForeignIP, u16 nForeignPort);
 	int ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP, u16 *pForeignPort);
 
+	int SendBuffer (CNetBuffer *pBuffer, int nFlags);
+	int SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+			  const CIPAddress &rForeignIP, u16 nForeignPort);
+	int ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags);
+	int ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+			       CIPAddress *pForeignIP, u16 *pForeignPort);
+
 	int SetOptionReceiveTimeout (unsigned nMicroSeconds);
 	int SetOptionSendTimeout (unsigned nMicroSeconds);
 
@@ -91,6 +111,12 @@ public:
 	int SetOptionAddMembership (const CIPAddress &rGroupAddress);
 	int SetOptionDropMembership (const CIPAddress &rGroupAddress);
 
+	int SetOptionReceiveBuffer (unsigned nBytes);
+	int SetOptionSendBuffer (unsigned nBytes);
+
+	int SetOptionNoDelay (boolean bNoDelay);
+	int SetOptionCork (boolean bCork);
+
 	boolean IsConnected (void) const;
 	boolean IsTerminated (void) const;
 	
@@ -99,6 +125,8 @@ public:
 	// returns: -1: invalid packet, 0: not to me, 1: packet consumed
 	int PacketReceived (const void *pPacket, unsigned nLength,
 			    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
+	int BufferReceived (CNetBuffer *pPacket,
+			    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
 
 	// returns: 0: not to me, 1: notification consumed
 	int NotificationReceived (TICMPNotificationType Type,
@@ -109,10 +137,40 @@ public:
 	TStatus GetStatus (void) const;
 
 private:
+	int WaitSend (int nFlags);			// returns 0, if data can be queued
+
+	// queue the segment data for the user, without copying if possible
+	void QueueReceivedData (const void *pPacket, unsigned nDataOffset, unsigned nDataLength);
+
 	boolean SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 nAcknowledgmentNumber = 0,
 			     const void *pData = 0, unsigned nDataLength = 0);
+#ifdef NET_SEGMENTATION_OFFLOAD
+	// sends nLength bytes from the retransmission queue at once, segmented in the IP layer
+	boolean SendSegments (unsigned nFlags, u32 nSequenceNumber, unsigned nLength);
+#endif
+	// appends the header to the empty pBuffer (checksum is 0), returns pointer to it
+	TTCPHeader *BuildHeader (CNetBuffer *pBuffer, unsigned nFlags,
+				 u32 nSequenceNumber, u32 nAcknowledgmentNumber);
+
+	void ScanOptions (TTCPHeader *pHeader, TTCPSegmentOptions *pOptions);
+	void NegotiateOptions (const TTCPSegmentOptions *pOptions);	// from received SYN
 
-	void ScanOptions (TTCPHeader *pHeader);
+	unsigned GetMaxSegmentData (void) const;
+
+	void UpdateScoreboard (u32 nLeft, u32 nRight);
+	void PruneScoreboard (void);
+	void FastRetransmit (void);
+
+	boolean HoldPartialSegment (void);		// Nagle's algorithm and corking
+
+	u32 GetFlightSize (void) const;			// outstanding bytes, not SACK-ed
+
+	void FlushRxQueue (void);
+	u32 GetReceiveWindow (void) const;		// to be advertised now
+	u32 GetOfferedWindow (void) const;		// which has been advertised already
+#ifdef TCP_PACING
+	void UpdatePacingCredit (u32 nCongestionWindow);
+#endif
 	
 	u32 CalculateISN (void);
 	
@@ -163,13 +221,55 @@ private:
 
 	// Receive Sequence Variables
 	u32 m_nRCV_NXT;		// receive next
-	u32 m_nRCV_WND;		// receive window
+	u32 m_nRCV_WND;		// receive window (the buffer size, set by the user)
+	u32 m_nRCV_ADV;		// right edge of the last advertised window
 	//u16 m_nRCV_UP;	// receive urgent pointer
 	u32 m_nIRS;		// initial receive sequence number
 
 	// Other Variables
 	u16 m_nSND_MSS;		// send maximum segment size
 
+	// Window scale option (RFC 7323 section 2)
+	boolean m_bWindowScaling;
+	u8 m_nSND_SCALE;	// shift count of received windows
+	u8 m_nRCV_SCALE;	// shift count of sent windows
+
+	// Timestamps option (RFC 7323 section 3)
+	boolean m_bTimestamps;
+	u32 m_nTS_RECENT;	// timestamp to be echoed
+	u32 m_nLAST_ACK_SENT;	// ACK field of last sent segment
+
+	// Selective acknowledgment (RFC 2018)
+	boolean m_bSACKPermitted;
+	TTCPSACKBlock m_Scoreboard[TCP_MAX_SACK_SCOREBOARD];	// sorted, above m_nSND_UNA
+	unsigned m_nScoreboardBlocks;
+
+	// Congestion control (RFC 5681, RFC 6582)
+	CTCPCongestionControl *m_pCongestionControl;
+	unsigned m_nDuplicateACKs;
+	boolean m_bInRecovery;	// fast recovery
+	u32 m_nRecoveryPoint;	// m_nSND_NXT when entering the recovery
+	u32 m_nHighRxt;		// next sequence number to be retransmitted in recovery
+	volatile boolean m_bFastRetransmit;	// retransmit lost segments
+	u32 m_nRecoveryInflation;	// window inflation by duplicate ACKs (without SACK)
+#ifdef TCP_PACING
+	int m_nPacingCredit;		// bytes, which may be sent now
+	unsigned m_nPacingClockTicks;	// time of last update
+#endif
+
+	// Segmentation (RFC 9293 section 3.7.4 and 3.8.6.3)
+	boolean m_bNoDelay;		// Nagle's algorithm disabled
+	volatile boolean m_bCork;
+	volatile boolean m_bMoreData;	// last Send() had MSG_MORE set
+	boolean m_bHolding;		// a partial segment is held back
+	unsigned m_nHoldTicks;		// since this time
+	unsigned m_nSegmentsUnacked;	// received segments, which have not been ACK-ed
+	volatile boolean m_bSendDelayedACK;
+
+	CNetBuffer *m_pRxPacket;		// holds the segment in PacketReceived() (or 0)
+	unsigned m_nRxSegments;			// number of merged segments in m_pRxPacket (GRO)
+	unsigned m_nRxQueued;			// bytes in m_RxQueue, charged to CNetMemory
+
 	CRetransmissionTimeoutCalculator m_RTOCalculator;
 
 	unsigned m_nReceiveTimeout;	// us
@@ -0,0 +1,60 @@
+//
+// tcpcubic.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_tcpcubic_h
+#define _circle_net_tcpcubic_h
+
+#include <circle/net/tcpcongestioncontrol.h>
+#include <circle/types.h>
+
+class CTCPCubic : public CTCPCongestionControl		/// TCP congestion control (RFC 9438)
+{
+public:
+	CTCPCubic (void);
+	~CTCPCubic (void);
+
+	const char *GetName (void) const;
+
+	void Initialize (unsigned nMSS);
+
+	void DataAcknowledged (unsigned nBytesAcked, unsigned nSmoothedRTT);
+	void CongestionDetected (unsigned nFlightSize);
+	void RetransmissionTimeout (unsigned nFlightSize);
+
+private:
+	void ReduceWindow (unsigned nFlightSize);
+
+	s64 GetCubicWindow (u64 nTime) const;		// nTime in milliseconds since epoch start
+
+	static u64 CubeRoot (u64 nValue);
+
+private:
+	unsigned m_nWindowMax;			// window before last reduction (bytes)
+	unsigned m_nWindowEstimate;		// Reno-friendly window (bytes)
+
+	boolean m_bEpochStarted;
+	u64 m_nEpochTime;			// microseconds
+	unsigned m_nLastClockTicks;
+	u64 m_nK;				// milliseconds
+
+	u64 m_nWindowRemainder;			// fractions of window increments
+	u64 m_nEstimateRemainder;
+};
+
+#endif
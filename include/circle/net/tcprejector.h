@@ -52,6 +52,10 @@ public:
 	int SetOptionBroadcast (boolean bAllowed)			{ return -1; }
 	int SetOptionAddMembership (const CIPAddress &rGroupAddress)	{ return -1; }
 	int SetOptionDropMembership (const CIPAddress &rGroupAddress)	{ return -1; }
+	int SetOptionReceiveBuffer (unsigned nBytes)			{ return -1; }
+	int SetOptionSendBuffer (unsigned nBytes)			{ return -1; }
+	int SetOptionNoDelay (boolean bNoDelay)				{ return -1; }
+	int SetOptionCork (boolean bCork)				{ return -1; }
 	boolean IsConnected (void) const				{ return FALSE; }
 	boolean IsTerminated (void) const				{ return FALSE; }
 	void Process (void)						{ }
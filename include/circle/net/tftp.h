@@ -0,0 +1,87 @@
+//
+// tftp.h
+//
+// Definitions common to TFTP client and server
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_tftp_h
+#define _circle_net_tftp_h
+
+#include <circle/macros.h>
+#include <circle/types.h>
+
+#define TFTP_PORT			69
+
+#define TFTP_DEFAULT_BLOCK_SIZE		512
+#define TFTP_MIN_BLOCK_SIZE		8		// RFC 2348
+#define TFTP_MAX_BLOCK_SIZE		1468		// fits into an Ethernet frame
+#define TFTP_MAX_WINDOW_SIZE		16		// RFC 7440
+
+#define TFTP_MAX_OPTIONS_LEN		128		// in request and OACK
+
+#define TFTP_OP_CODE_RRQ		1
+#define TFTP_OP_CODE_WRQ		2
+#define TFTP_OP_CODE_DATA		3
+#define TFTP_OP_CODE_ACK		4
+#define TFTP_OP_CODE_ERROR		5
+#define TFTP_OP_CODE_OACK		6		// RFC 2347
+
+#define TFTP_ERROR_CODE_OTHER		0
+#define TFTP_ERROR_CODE_NO_FILE		1
+#define TFTP_ERROR_CODE_ACCESS		2
+#define TFTP_ERROR_CODE_DISK_FULL	3
+#define TFTP_ERROR_CODE_ILL_OPER	4
+#define TFTP_ERROR_CODE_INV_ID		5
+#define TFTP_ERROR_CODE_EXISTS		6
+#define TFTP_ERROR_CODE_INV_USER	7
+#define TFTP_ERROR_CODE_OPTION		8		// RFC 2347
+
+struct TTFTPDataPacket
+{
+	u16	OpCode;
+	u16	BlockNumber;
+	u8	Data[TFTP_MAX_BLOCK_SIZE];
+}
+PACKED;
+
+#define TFTP_DATA_HEADER_LEN		4
+
+struct TTFTPAckPacket
+{
+	u16	OpCode;
+	u16	BlockNumber;
+}
+PACKED;
+
+struct TTFTPErrorPacket
+{
+	u16	OpCode;
+	u16	ErrorCode;
+#define TFTP_MAX_ERRMSG_LEN		128
+	char	ErrMsg[TFTP_MAX_ERRMSG_LEN];
+}
+PACKED;
+
+struct TTFTPOptionPacket			// OACK
+{
+	u16	OpCode;
+	char	Options[TFTP_MAX_OPTIONS_LEN];	// name and value as 0-terminated strings
+}
+PACKED;
+
+#endif
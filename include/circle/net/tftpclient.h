@@ -0,0 +1,95 @@
+//
+// tftpclient.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_net_tftpclient_h
+#define _circle_net_tftpclient_h
+
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/tftp.h>
+#include <circle/types.h>
+
+#define TFTP_DEFAULT_WINDOW_SIZE	8
+
+/// \param pData Received data of one block
+/// \param nLength Length of the data (may be 0 with the last block)
+/// \param pParam User parameter, handed over to GetFile()
+/// \return FALSE to abort the transfer
+typedef boolean TTFTPDataHandler (const void *pData, unsigned nLength, void *pParam);
+
+class CTFTPClient	/// Receives files from a TFTP server, with the blksize, windowsize and tsize options
+{
+public:
+	/// \param pNetSubSystem Pointer to the network subsystem
+	/// \param nBlockSize Requested block size (server may select a smaller one)
+	/// \param nWindowSize Requested number of blocks, which are sent before an ACK
+	CTFTPClient (CNetSubSystem *pNetSubSystem,
+		     unsigned nBlockSize = TFTP_MAX_BLOCK_SIZE,
+		     unsigned nWindowSize = TFTP_DEFAULT_WINDOW_SIZE);
+	~CTFTPClient (void);
+
+	/// \brief Receive a file and call a handler for each block of data
+	/// \param rServerIP IP address of the TFTP server
+	/// \param pFileName Name of the file on the server
+	/// \param pHandler Will be called for each received block in order
+	/// \param pParam User parameter, handed over to pHandler
+	/// \return Number of received bytes, or -1 on error
+	int GetFile (const CIPAddress &rServerIP, const char *pFileName,
+		     TTFTPDataHandler *pHandler, void *pParam = 0);
+
+	/// \brief Receive a file into a buffer
+	/// \param rServerIP IP address of the TFTP server
+	/// \param pFileName Name of the file on the server
+	/// \param pBuffer Pointer to the buffer
+	/// \param nBufferSize Size of the buffer in bytes
+	/// \return Number of received bytes, or -1 on error (also, if the file is too big)
+	int GetFile (const CIPAddress &rServerIP, const char *pFileName,
+		     void *pBuffer, unsigned nBufferSize);
+
+	/// \return File size from the server (tsize option), 0 if unknown
+	/// \note Is valid from the first call of the data handler on.
+	unsigned GetTransferSize (void) const;
+
+private:
+	unsigned BuildRequest (void *pBuffer, const char *pFileName);
+	boolean ParseOptionAck (const char *pOptions, const char *pEnd);
+
+	boolean SendAck (u16 usBlockNumber);
+	void SendError (u16 usErrorCode, const char *pErrorMessage);
+
+	static boolean BufferHandler (const void *pData, unsigned nLength, void *pParam);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	unsigned m_nRequestedBlockSize;
+	unsigned m_nRequestedWindowSize;
+
+	CSocket *m_pSocket;
+	CIPAddress m_ServerIP;
+	u16 m_usServerPort;			// transfer ID of the server
+
+	unsigned m_nBlockSize;			// negotiated
+	unsigned m_nWindowSize;
+	unsigned m_nTransferSize;
+
+	static u16 s_usOwnPort;
+};
+
+#endif
@@ -55,6 +55,10 @@ public:
 	virtual int FileRead (void *pBuffer, unsigned nCount) = 0;
 	virtual int FileWrite (const void *pBuffer, unsigned nCount) = 0;
 
+	/// \return Size of the opened file in bytes, -1 if unknown
+	/// \note Is used for the tsize option (RFC 2349) of read requests only.
+	virtual int FileSize (void) { return -1; }
+
 	virtual boolean IsAccessAllowed (const CIPAddress *pForeignIP,
 					 const char *pFilename,
 					 boolean bWriteRequest) { return TRUE; }
@@ -62,6 +66,12 @@ public:
 	virtual void UpdateStatus (TStatus Status, const char *pFileName) {}
 
 private:
+	void ParseOptions (const char *pOptions, const char *pEnd);
+	unsigned BuildOptionAck (void *pBuffer, int nTransferSize);	// returns length
+	static unsigned AppendOption (char *pBuffer, unsigned nOffset,
+				      const char *pName, unsigned nValue);
+	boolean SendOptionAck (const void *pOptionAck, unsigned nLength);  // waits for ACK
+
 	boolean DoRead (const char *pFileName);
 	boolean DoWrite (const char *pFileName);
 
@@ -76,6 +86,15 @@ protected:
 	CSocket *m_pTransferSocket;
 
 	char m_Filename[MaxFilenameLen+1];
+
+private:
+	// negotiated options of the current transfer
+	unsigned m_nBlockSize;
+	unsigned m_nWindowSize;
+	boolean m_bBlockSizeOption;
+	boolean m_bWindowSizeOption;
+	boolean m_bTransferSizeOption;
+	unsigned m_nTransferSize;		// from write request
 };
 
 #endif
@@ -24,13 +24,19 @@
 #include <circle/net/networklayer.h>
 #include <circle/net/netconnection.h>
 #include <circle/net/tcprejector.h>
+#include <circle/net/checksumcalculator.h>
 #include <circle/net/ipaddress.h>
 #include <circle/net/netqueue.h>
+#include <circle/sched/synchronizationevent.h>
 #include <circle/device.h>
-#include <circle/ptrarray.h>
+#include <circle/smallvector.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
+#define TRANSPORT_PORT_HASH_SIZE	64	// must be a power of 2
+#define TRANSPORT_TUPLE_HASH_SIZE	256	// must be a power of 2
+#define TRANSPORT_INLINE_CONNECTIONS	32	// in m_pConnection without heap allocation
+
 class CTransportLayer
 {
 public:
@@ -64,6 +70,21 @@ public:
 	int ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP,
 			 u16 *pForeignPort, int hConnection);
 
+	// zero-copy variants, the reference to pBuffer is taken over (also on error)
+	int SendBuffer (CNetBuffer *pBuffer, int nFlags, int hConnection);
+	// the returned *ppBuffer has to be released by the caller
+	int ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags, int hConnection);
+
+	int SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+			  const CIPAddress &rForeignIP, u16 nForeignPort, int hConnection);
+	int ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags, CIPAddress *pForeignIP,
+			       u16 *pForeignPort, int hConnection);
+
+	// the references to the buffers are taken over (also on error)
+	int SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags, int hConnection);
+	// the returned buffers have to be released by the caller
+	int ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags, int hConnection);
+
 	int SetOptionReceiveTimeout (unsigned nMicroSeconds, int hConnection);
 	int SetOptionSendTimeout (unsigned nMicroSeconds, int hConnection);
 
@@ -71,23 +92,96 @@ public:
 
 	int SetOptionAddMembership (const CIPAddress &rGroupAddress, int hConnection);
 	int SetOptionDropMembership (const CIPAddress &rGroupAddress, int hConnection);
+	int SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+					  const CIPAddress &rSourceAddress, int hConnection);
+	int SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+					   const CIPAddress &rSourceAddress, int hConnection);
+
+	int SetOptionReceiveBuffer (unsigned nBytes, int hConnection);
+	int SetOptionSendBuffer (unsigned nBytes, int hConnection);
+
+	int SetOptionNoDelay (boolean bNoDelay, int hConnection);
+	int SetOptionCork (boolean bCork, int hConnection);
 
 	boolean IsConnected (int hConnection) const;
 	const u8 *GetForeignIP (int hConnection) const;		// returns 0 if not connected
 
 	CNetConnection::TStatus GetStatus (int hConnection) const;
 
+	// pEvent will be set on each status change of the connection (0 to detach)
+	int SetReadinessEvent (CSynchronizationEvent *pEvent, int hConnection);
+
 	void ListConnections (CDevice *pTarget);
 
+private:
+	// returns FALSE, if the packet has not been consumed by a connection
+	boolean DeliverPacket (CNetBuffer *pBuffer,
+			       CIPAddress &rSender, CIPAddress &rReceiver, int nProtocol);
+	// delivers an UDP datagram to a host group, the buffer is shared by all members
+	void DeliverMulticast (CNetBuffer *pBuffer, CIPAddress &rSender, CIPAddress &rReceiver);
+
+#ifdef NET_SEGMENTATION_OFFLOAD
+	// appends the data of the TCP segment pSegment to pHead, if it directly follows it
+	// in the same connection, returns FALSE if not merged (pSegment is not modified then)
+	static boolean MergeSegment (CNetBuffer *pHead, CNetBuffer *pSegment,
+				     const CIPAddress &rSender, const CIPAddress &rReceiver);
+#endif
+
+	// connection demultiplexing tables,
+	// modifications must be done with m_SpinLock acquired or from Process()
+	void InsertConnection (unsigned nConnection);
+	void RemoveConnection (unsigned nConnection);
+	boolean IsPortUsed (u16 nOwnPort, int nProtocol) const;
+
+	int LookupTuple (u32 nForeignIP, u16 nForeignPort, u16 nOwnPort) const;
+	void InsertTuple (unsigned nConnection, u32 nForeignIP, u16 nForeignPort, u16 nOwnPort);
+	void RemoveTuples (unsigned nConnection);
+
+	// inserts or removes the connection in the member list of the host group,
+	// according to the current membership of the connection
+	void UpdateMulticastMember (unsigned nConnection, const CIPAddress &rGroupAddress);
+	void RemoveMulticastMember (unsigned nConnection);	// from all host groups
+
+	static unsigned PortHash (u16 nOwnPort, int nProtocol);
+	static unsigned TupleHash (u32 nForeignIP, u16 nForeignPort, u16 nOwnPort);
+
 private:
 	CNetConfig    *m_pNetConfig;
 	CNetworkLayer *m_pNetworkLayer;
 
-	CPtrArray m_pConnection;
+	CSmallVector<CNetConnection *, TRANSPORT_INLINE_CONNECTIONS> m_pConnection;
 	u16 m_nOwnPort;
 	CSpinLock m_SpinLock;
 
 	CTCPRejector m_TCPRejector;
+
+	struct TDemuxEntry
+	{
+		TDemuxEntry	*pNext;
+		unsigned	 nConnection;		// index into m_pConnection
+		int		 nProtocol;
+		u16		 nOwnPort;
+		u16		 nForeignPort;		// in tuple table only
+		u32		 nForeignIP;		// in tuple table only
+	};
+
+	// all connections by own port, sorted by index in each chain
+	TDemuxEntry *m_pPortHash[TRANSPORT_PORT_HASH_SIZE];
+
+	// TCP connections with known foreign address, filled when a segment has been accepted
+	TDemuxEntry *m_pTupleHash[TRANSPORT_TUPLE_HASH_SIZE];
+
+	struct TMulticastGroup
+	{
+		TMulticastGroup	*pNext;
+		u32		 nGroupIP;
+		TDemuxEntry	*pMembers;		// UDP connections, sorted by index
+	};
+
+	// host groups with at least one member connection
+	TMulticastGroup *m_pMulticastGroups;
+
+	CChecksumCalculator m_UDPChecksum;		// for multicast datagrams
 };
 
 #endif
@@ -25,10 +25,18 @@
 #include <circle/net/networklayer.h>
 #include <circle/net/ipaddress.h>
 #include <circle/net/icmphandler.h>
+#include <circle/net/igmphandler.h>
 #include <circle/net/netqueue.h>
 #include <circle/sched/synchronizationevent.h>
 #include <circle/types.h>
 
+// max. size of a message, which is sent in IP fragments, if necessary
+#define UDP_MAX_MESSAGE_SIZE	(IP_MAX_DATAGRAM_SIZE - 20 - 8)	// IP and UDP header
+
+// payload bytes, which can wait in the receive queue (see SetOptionReceiveBuffer())
+#define UDP_DEFAULT_RECEIVE_BUFFER	0x40000
+#define UDP_MAX_RECEIVE_BUFFER		0x100000
+
 class CUDPConnection : public CNetConnection
 {
 public:
@@ -53,6 +61,13 @@ public:
 		    const CIPAddress &rForeignIP, u16 nForeignPort);
 	int ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP, u16 *pForeignPort);
 
+	int SendBuffer (CNetBuffer *pBuffer, int nFlags);
+	int SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+			  const CIPAddress &rForeignIP, u16 nForeignPort);
+	int ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags);
+	int ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+			       CIPAddress *pForeignIP, u16 *pForeignPort);
+
 	int SetOptionReceiveTimeout (unsigned nMicroSeconds);
 	int SetOptionSendTimeout (unsigned nMicroSeconds);
 
@@ -61,6 +76,19 @@ public:
 	int SetOptionAddMembership (const CIPAddress &rGroupAddress);
 	int SetOptionDropMembership (const CIPAddress &rGroupAddress);
 
+	int SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+					  const CIPAddress &rSourceAddress);
+	int SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+					   const CIPAddress &rSourceAddress);
+
+	boolean IsHostGroupMember (const CIPAddress &rGroupAddress) const;
+
+	int SetOptionReceiveBuffer (unsigned nBytes);
+	int SetOptionSendBuffer (unsigned nBytes);
+
+	int SetOptionNoDelay (boolean bNoDelay);
+	int SetOptionCork (boolean bCork);
+
 	boolean IsConnected (void) const;
 	boolean IsTerminated (void) const;
 	
@@ -69,6 +97,14 @@ public:
 	// returns: -1: invalid packet, 0: not to me, 1: packet consumed
 	int PacketReceived (const void *pPacket, unsigned nLength,
 			    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
+	int BufferReceived (CNetBuffer *pPacket,
+			    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
+
+	// datagram to a host group, the UDP header has already been removed from pPayload,
+	// which is shared by all members and must not be modified
+	// returns: 0: not to me, 1: packet consumed
+	int MulticastReceived (CNetBuffer *pPayload, const CIPAddress &rSenderIP,
+			       u16 nSourcePort, u16 nDestPort);
 
 	// returns: 0: not to me, 1: notification consumed
 	int NotificationReceived (TICMPNotificationType Type,
@@ -78,6 +114,24 @@ public:
 
 	TStatus GetStatus (void) const;
 
+private:
+	// returns a buffer chain, if the message is larger than a frame
+	static CNetBuffer *AllocMessage (const void *pData, unsigned nLength);
+
+	// the reference to pBuffer is taken over
+	int SendPacket (CNetBuffer *pBuffer, const CIPAddress &rForeignIP, u16 nForeignPort);
+
+	// pBuffer holds pPacket, if the packet can be queued without copying (may be 0)
+	int ReceivePacket (const void *pPacket, unsigned nLength, CNetBuffer *pBuffer,
+			   CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol);
+
+	// leave the host group for any source or for all sources
+	void LeaveHostGroup (void);
+
+	// returns FALSE, if the datagram has to be dropped (receive buffer full)
+	boolean ChargeReceived (unsigned nLength);
+	void UnchargeReceived (unsigned nLength);
+
 private:
 	boolean m_bOpen;
 	boolean m_bActiveOpen;
@@ -86,6 +140,11 @@ private:
 	unsigned m_nReceiveTimeout;		// us
 	boolean m_bBroadcastsAllowed;
 	CIPAddress *m_pHostGroup;
+	unsigned m_nSources;			// 0 for any source
+	CIPAddress m_Source[IGMP_MAX_SOURCES];
+
+	unsigned m_nRxBufferSize;		// set by the user
+	unsigned m_nRxQueued;			// bytes in m_RxQueue, charged to CNetMemory
 
 	int m_nErrno;				// signalize error to the user
 };
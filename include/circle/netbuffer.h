@@ -0,0 +1,155 @@
+//
+// netbuffer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_netbuffer_h
+#define _circle_netbuffer_h
+
+#include <circle/netdevice.h>
+#include <circle/spinlock.h>
+#include <circle/synchronize.h>
+#include <circle/types.h>
+
+// default space in front of the data, reserved for headers to be prepended
+#define NET_BUFFER_HEADROOM	64
+
+#define NET_BUFFER_SIZE		(2*NET_BUFFER_HEADROOM + FRAME_BUFFER_SIZE)
+
+/// \note A net buffer holds one frame (or a part of it) with free space in front of it, so\n
+///	  that each layer can prepend (on TX) or remove (on RX) its header without copying\n
+///	  the payload. Buffers are reference counted and can be chained to a scatter-gather\n
+///	  list of segments. Released buffers are kept on a free list for reuse and are never\n
+///	  returned to the heap.
+/// \note The data of a buffer, allocated with the default headroom, is aligned to\n
+///	  DATA_CACHE_LINE_LENGTH_MAX and can be directly used for DMA.
+
+class CNetBuffer	/// Reference counted network frame buffer with headroom for headers
+{
+public:
+	/// \param nHeadroom Number of bytes reserved in front of the data
+	/// \return Pointer to an empty buffer with a reference count of 1
+	static CNetBuffer *Alloc (unsigned nHeadroom = NET_BUFFER_HEADROOM);
+
+	/// \param pData Data to be copied into the new buffer
+	/// \param nLength Length of the data in bytes
+	/// \param nHeadroom Number of bytes reserved in front of the data
+	/// \return Pointer to the buffer with a reference count of 1
+	static CNetBuffer *Alloc (const void *pData, unsigned nLength,
+				  unsigned nHeadroom = NET_BUFFER_HEADROOM);
+
+	/// \brief Increment the reference count
+	void AddRef (void);
+	/// \brief Decrement the reference count, free the buffer (and the following segments),\n
+	///	   if it was the last reference
+	void Release (void);
+
+	/// \return Pointer to the data of this segment
+	u8 *GetData (void) const		{ return m_pData; }
+	/// \return Length of the data of this segment
+	unsigned GetLength (void) const		{ return m_nLength; }
+	/// \return Length of the data of all chained segments
+	unsigned GetTotalLength (void) const;
+
+	/// \return Number of bytes, which can be prepended
+	unsigned GetHeadroom (void) const	{ return m_pData - m_Buffer; }
+	/// \return Number of bytes, which can be appended
+	unsigned GetTailroom (void) const	{ return m_Buffer + NET_BUFFER_SIZE - (m_pData + m_nLength); }
+
+	/// \brief Extend the data at the end
+	/// \param nLength Number of bytes to be appended (must fit into the tailroom)
+	/// \return Pointer to the appended area, which has to be filled by the caller
+	void *Append (unsigned nLength);
+
+	/// \brief Extend the data at the front (e.g. for a protocol header)
+	/// \param nLength Number of bytes to be prepended (must fit into the headroom)
+	/// \return Pointer to the new start of the data, which has to be filled by the caller
+	void *Prepend (unsigned nLength);
+
+	/// \brief Remove a header from the front of the data
+	/// \param nLength Number of bytes to be removed
+	/// \return Pointer to the new start of the data (0 if the data is too short)
+	void *RemoveHeader (unsigned nLength);
+
+	/// \brief Cut the data of this segment (e.g. to remove padding)
+	/// \param nLength New (smaller) length of the data in bytes
+	void Truncate (unsigned nLength);
+
+	/// \brief Append a segment to the end of the chain
+	/// \param pSegment Buffer to be appended (the reference is taken over)
+	void AppendSegment (CNetBuffer *pSegment);
+	/// \return Next segment in the chain (0 if this is the last one)
+	CNetBuffer *GetNextSegment (void) const	{ return m_pNextSegment; }
+	/// \brief Remove the following segments from the chain
+	/// \return The following segments (0 if there are none), the reference is handed over
+	CNetBuffer *DetachSegments (void);
+	/// \return Number of segments in the chain (including this one)
+	unsigned GetSegmentCount (void) const;
+
+	/// \brief Copy the data of all chained segments to a linear buffer
+	/// \param pBuffer Destination buffer, must have size GetTotalLength()
+	void CopyTo (void *pBuffer) const;
+	/// \brief Copy a part of the data of the chained segments to a linear buffer
+	/// \param pBuffer Destination buffer, must have size nLength
+	/// \param nLength Number of bytes to be copied
+	/// \param nOffset Offset of the first byte to be copied from the start of the data
+	/// \note nOffset + nLength must not exceed GetTotalLength().
+	void CopyTo (void *pBuffer, unsigned nLength, unsigned nOffset) const;
+
+	/// \brief Mark the TCP/UDP checksum of the received frame as verified (by the hardware)
+	void SetChecksumValid (void)		{ m_bChecksumValid = TRUE; }
+	/// \return Has the TCP/UDP checksum already been verified?
+	boolean IsChecksumValid (void) const	{ return m_bChecksumValid; }
+
+	/// \brief Request the completion of the TCP/UDP checksum (by the hardware) on TX
+	/// \param pStart Pointer to the TCP/UDP header in the data of this segment
+	/// \param nOffset Offset of the checksum field from pStart, the field must hold\n
+	///	   the (not complemented) checksum of the pseudo header
+	/// \note The checksum is calculated from pStart to the end of the last segment.
+	void SetChecksumPartial (const void *pStart, unsigned nOffset);
+	/// \brief The checksum has been completed (in software)
+	void ClearChecksumPartial (void)	{ m_pChecksumStart = 0; }
+	/// \return Has the completion of the TCP/UDP checksum been requested?
+	boolean IsChecksumPartial (void) const	{ return m_pChecksumStart != 0; }
+	/// \return Offset of the TCP/UDP header from the start of the data of this segment
+	unsigned GetChecksumStart (void) const	{ return m_pChecksumStart - m_pData; }
+	/// \return Offset of the checksum field from the TCP/UDP header
+	unsigned GetChecksumOffset (void) const	{ return m_nChecksumOffset; }
+
+private:
+	CNetBuffer (void) {}
+	~CNetBuffer (void) {}
+
+private:
+	DMA_BUFFER (u8, m_Buffer, NET_BUFFER_SIZE);
+
+	u8 *m_pData;
+	unsigned m_nLength;
+	volatile int m_nRefCount;
+
+	CNetBuffer *m_pNextSegment;
+
+	boolean m_bChecksumValid;
+	const u8 *m_pChecksumStart;		// 0 if checksum is not partial
+	unsigned m_nChecksumOffset;
+
+	static CNetBuffer *s_pFreeList;		// linked using m_pNextSegment
+
+	static CSpinLock s_SpinLock;
+};
+
+#endif
@@ -27,6 +27,11 @@
 
 #define MAX_NET_DEVICES		5
 
+// capabilities of a net device (returned by GetCapabilities())
+#define NET_DEVICE_CAP_RX_CHECKSUM	(1 << 0)	// verifies TCP/UDP checksums
+#define NET_DEVICE_CAP_TX_CHECKSUM	(1 << 1)	// completes TCP/UDP checksums
+#define NET_DEVICE_CAP_PTP_TIMESTAMP	(1 << 2)	// timestamps PTP event frames
+
 enum TNetDeviceType
 {
 	NetDeviceTypeEthernet,
@@ -46,6 +51,10 @@ enum TNetDeviceSpeed
 	NetDeviceSpeedUnknown
 };
 
+class CNetBuffer;
+
+typedef void TNetReceiveHandler (void *pParam);
+
 class CNetDevice	/// Base class (interface) of net devices
 {
 public:
@@ -57,6 +66,13 @@ public:
 	/// \return Pointer to a MAC address object, which holds our own address
 	virtual const CMACAddress *GetMACAddress (void) const = 0;
 
+	/// \return Capabilities of this net device (NET_DEVICE_CAP_* bit mask)
+	/// \note With NET_DEVICE_CAP_RX_CHECKSUM, ReceiveBuffer() marks frames, which have\n
+	///	  a verified TCP/UDP checksum (see CNetBuffer::SetChecksumValid()). With\n
+	///	  NET_DEVICE_CAP_TX_CHECKSUM, SendBuffer() completes the checksum of frames,\n
+	///	  which have been marked with CNetBuffer::SetChecksumPartial().
+	virtual unsigned GetCapabilities (void) const	{ return 0; }
+
 	/// \return TRUE if it is advisable to call SendFrame()
 	/// \note SendFrame() can be called at any time, but may fail when the TX queue is full.\n
 	///	  This method gives a hint, if calling SendFrame() is advisable.
@@ -73,6 +89,50 @@ public:
 	/// \return TRUE if a frame is returned in buffer, FALSE if nothing has been received
 	virtual boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength) = 0;
 
+	/// \brief Send a valid Ethernet frame from a net buffer
+	/// \param pFrame Buffer with the frame, may be chained
+	/// \note The default implementation calls SendFrame() with the data of the buffer\n
+	///	  and copies it only, if it is not contiguous or not aligned for DMA.\n
+	///	  The buffer remains owned by the caller.
+	virtual boolean SendBuffer (CNetBuffer *pFrame);
+
+	/// \brief Send a batch of valid Ethernet frames from net buffers
+	/// \param pFrames Array of pointers to the buffers with the frames, may be chained
+	/// \param nCount Number of frames in the array
+	/// \return Number of frames sent, the frames are sent in order until one cannot be sent
+	/// \note The buffers remain owned by the caller. The default implementation calls\n
+	///	  SendBuffer() repeatedly, while IsSendFrameAdvisable() returns TRUE. Devices\n
+	///	  can override it to start the transmission only once for the whole batch.
+	virtual unsigned SendBuffers (CNetBuffer *pFrames[], unsigned nCount);
+
+	/// \brief Poll for a received Ethernet frame into a net buffer
+	/// \param pFrame Empty buffer with at least FRAME_BUFFER_SIZE bytes tailroom
+	/// \return TRUE if a frame has been appended to the buffer
+	/// \note The default implementation calls ReceiveFrame() with the data of the buffer.
+	virtual boolean ReceiveBuffer (CNetBuffer *pFrame);
+
+	/// \brief Fetch a batch of received frames
+	/// \param pFrames Array, which receives pointers to the buffers with the frames
+	/// \param nBudget Maximum number of frames to be fetched (size of the array)
+	/// \return Number of frames fetched, the caller has to release the buffers
+	/// \note The default implementation calls ReceiveBuffer() repeatedly.
+	virtual unsigned ReceiveBuffers (CNetBuffer *pFrames[], unsigned nBudget);
+
+	/// \brief Register a handler, which is called, when frames have been received
+	/// \param pHandler Handler to be called from IRQ context
+	/// \param pParam User parameter handed over to the handler
+	/// \return FALSE if not supported, the device has to be polled continuously then
+	/// \note The receive interrupt is initially disabled, the device has to be polled first.\n
+	///	  The receive interrupt is disabled, before the handler is called. The frames\n
+	///	  have to be fetched with ReceiveBuffers() until it returns less than the budget.\n
+	///	  Then the interrupt has to be enabled again using EnableReceiveInterrupt().
+	virtual boolean RegisterReceiveHandler (TNetReceiveHandler *pHandler, void *pParam)
+							{ return FALSE; }
+
+	/// \brief Enable the receive interrupt again, after the received frames have been fetched
+	/// \return FALSE if more frames are pending, ReceiveBuffers() has to be called again then
+	virtual boolean EnableReceiveInterrupt (void)	{ return TRUE; }
+
 	/// \return TRUE if PHY link is up
 	virtual boolean IsLinkUp (void)			{ return TRUE; }
 
@@ -89,10 +149,44 @@ public:
 	/// \return FALSE if not supported
 	virtual boolean SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE]) { return FALSE; }
 
+	/// \brief Get the hardware timestamp of the last PTP (IEEE 1588) event frame
+	/// \param bTransmit TRUE for the last transmitted, FALSE for the last received frame
+	/// \param pNanoSeconds Timestamp (nanoseconds of the PTP clock) will be stored here
+	/// \return FALSE if not supported (see NET_DEVICE_CAP_PTP_TIMESTAMP)
+	/// \note Event frames are Sync, Delay_Req, Pdelay_Req and Pdelay_Resp messages,\n
+	///	  sent over UDP/IPv4 (port 319) or Ethernet (type 0x88F7).
+	virtual boolean GetPTPEventTimestamp (boolean bTransmit, u64 *pNanoSeconds) { return FALSE; }
+
+	/// \param pNanoSeconds Current time of the PTP clock will be stored here
+	/// \return FALSE if not supported
+	virtual boolean GetPTPClock (u64 *pNanoSeconds)	{ return FALSE; }
+
+	/// \param nNanoSeconds New time of the PTP clock
+	/// \return FALSE if not supported
+	virtual boolean SetPTPClock (u64 nNanoSeconds)	{ return FALSE; }
+
+	/// \brief Step the PTP clock
+	/// \param nNanoSeconds Offset to be added to the PTP clock (may be negative)
+	/// \return FALSE if not supported
+	virtual boolean AdjustPTPClock (s64 nNanoSeconds) { return FALSE; }
+
+	/// \brief Change the rate of the PTP clock
+	/// \param nPPB Frequency correction in parts per billion (0 for nominal rate)
+	/// \return FALSE if not supported
+	virtual boolean SetPTPClockRate (int nPPB)	{ return FALSE; }
+
 	/// \param Speed A value returned by GetLinkSpeed()
 	/// \return Description for this speed value
 	static const char *GetSpeedString (TNetDeviceSpeed Speed);
 
+	/// \brief Calculate a hash over the IPv4 addresses, the protocol and the TCP/UDP ports
+	/// \param pFrame Pointer to an Ethernet frame
+	/// \param nLength Frame length in bytes
+	/// \return Hash value (0 for frames, which do not carry IPv4)
+	/// \note Can be used to steer the frames to multiple queues, so that the frames\n
+	///	  of each flow stay in order.
+	static u32 GetFlowHash (const void *pFrame, unsigned nLength);
+
 	/// \param nDeviceNumber Zero-based number of a net device (normally only 0 is used)
 	/// \return Pointer to the device object
 	static CNetDevice *GetNetDevice (unsigned nDeviceNumber);
@@ -0,0 +1,139 @@
+//
+// perfcounters.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_perfcounters_h
+#define _circle_perfcounters_h
+
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#define PERF_EVENT_COUNTERS	4		// event counters used (plus the cycle counter)
+
+enum TPerfEvent
+{
+	PerfEventNone,				///< Counter is not used
+	PerfEventInstructions,			///< Instructions architecturally executed
+	PerfEventL1DCacheAccess,		///< L1 data cache accesses
+	PerfEventL1DCacheMiss,			///< L1 data cache refills
+	PerfEventL1ICacheMiss,			///< L1 instruction cache refills
+	PerfEventL2CacheAccess,			///< L2 data cache accesses
+	PerfEventL2CacheMiss,			///< L2 data cache refills
+	PerfEventBranchMispredict,		///< Mispredicted or not predicted branches
+	PerfEventUnknown
+};
+
+struct TPerfCounterValues
+{
+	u64	nCycles;
+	u64	nEvent[PERF_EVENT_COUNTERS];	// in the order of the events given to CPerfCounters
+};
+
+/// \note The PMU is private to each CPU core. A CPerfCounters object has to be created,
+///	  used and destroyed on the same core. Counter values are 32 bits wide (the cycle
+///	  counter is 64 bits wide on AArch64), a measured interval must not be longer than
+///	  2^32 events. The PMU cannot be used with CPMUProfiler on the same core at the same
+///	  time. On the Raspberry Pi 1 and Zero all values read as zero.
+
+class CPerfCounters	/// Configures and reads the ARM PMU cycle and event counters of a core
+{
+public:
+	/// \brief Configures and starts the counters of the calling core
+	/// \param Event0 Event to be counted by counter 0 (PerfEventNone if unused)
+	/// \param Event1 Event to be counted by counter 1
+	/// \param Event2 Event to be counted by counter 2
+	/// \param Event3 Event to be counted by counter 3
+	CPerfCounters (TPerfEvent Event0 = PerfEventInstructions,
+		       TPerfEvent Event1 = PerfEventL1DCacheMiss,
+		       TPerfEvent Event2 = PerfEventL2CacheMiss,
+		       TPerfEvent Event3 = PerfEventBranchMispredict);
+
+	/// \brief Stops the counters of the calling core
+	~CPerfCounters (void);
+
+	/// \return Are the PMU and all requested events available?
+	boolean IsAvailable (void) const		{ return m_bAvailable; }
+
+	/// \brief Resets all counters to zero
+	void Reset (void);
+
+	/// \brief Reads the current values of all counters
+	/// \param pValues Values are returned here (unused counters read as zero)
+	void Read (TPerfCounterValues *pValues) const;
+
+	/// \param nCounter Counter index (0..PERF_EVENT_COUNTERS-1)
+	/// \return Event, which is counted by this counter
+	TPerfEvent GetEvent (unsigned nCounter) const;
+
+	/// \param Event Performance event
+	/// \return Short name of the event (as used by perf)
+	static const char *GetEventName (TPerfEvent Event);
+
+	/// \brief Reads the cycle counter of the calling core directly
+	/// \return Current value (wraps at 32 bits on AArch32)
+	static u64 ReadCycleCounter (void)
+	{
+#if AARCH == 32 && RASPPI >= 2
+		u32 nValue;
+		asm volatile ("mrc p15, 0, %0, c9, c13, 0" : "=r" (nValue));
+
+		return nValue;
+#elif AARCH == 64
+		u64 nValue;
+		asm volatile ("mrs %0, pmccntr_el0" : "=r" (nValue));
+
+		return nValue;
+#else
+		return 0;
+#endif
+	}
+
+	/// \return Number of event counters implemented by the PMU of this core
+	static unsigned GetImplementedCounters (void);
+
+	/// \brief Logs the counters in pValues with the event names of this object
+	/// \param pSource Logger source name
+	/// \param pValues Counter values to be logged
+	void Dump (const char *pSource, const TPerfCounterValues *pValues) const;
+
+private:
+	TPerfEvent m_Event[PERF_EVENT_COUNTERS];
+	boolean m_bAvailable;
+	unsigned m_nCore;
+};
+
+/// \note The differences of the counter values between construction and destruction of
+///	  this object are added to the result. This allows to accumulate multiple runs of a
+///	  code block. The result has to be cleared by the caller before the first run.
+
+class CPerfMeasurement	/// Measures the performance counters for the lifetime of a scope
+{
+public:
+	/// \param pCounters Configured counters of the calling core
+	/// \param pResult The measured differences are added to this
+	CPerfMeasurement (const CPerfCounters *pCounters, TPerfCounterValues *pResult);
+
+	~CPerfMeasurement (void);
+
+private:
+	const CPerfCounters *m_pCounters;
+	TPerfCounterValues *m_pResult;
+	TPerfCounterValues m_Start;
+};
+
+#endif
@@ -0,0 +1,140 @@
+//
+// pipelinestage.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_pipelinestage_h
+#define _circle_pipelinestage_h
+
+#include <circle/latencymonitor.h>
+#include <circle/spinlock.h>
+#include <circle/timer.h>
+#include <circle/types.h>
+
+#define PIPELINE_VIOLATIONS	32		///< Number of recorded recent violations
+
+struct TPipelineStageStatistics	/// Result of CPipelineStage::GetStatistics() (values in us)
+{
+	unsigned nCount;
+	unsigned nMax;
+	unsigned nP50;
+	unsigned nP99;
+	unsigned nP999;
+	unsigned nViolations;		///< Number of samples above the budget
+};
+
+struct TPipelineViolation	/// A sample, which exceeded the latency budget of its stage
+{
+	u64		 ullTimestamp;	///< End of the stage (CTimer::GetClockTicks64())
+	const char	*pStage;	///< Name of the stage
+	unsigned	 nLatency;	///< in us
+	unsigned	 nBudget;	///< in us
+	unsigned	 nCore;		///< Core, which completed the stage
+	uintptr		 nContext;	///< Value given by the caller (e.g. sequence number)
+};
+
+/// \note A stage is a handoff in a processing pipeline (e.g. network RX to decoder, decoder
+///	  to sound queue). The producer takes a timestamp with Stamp() and passes it along with
+///	  the data, the consumer calls Complete() with this timestamp. An end-to-end budget can
+///	  be checked with an additional stage, which is completed with the timestamp of the
+///	  first stage. CNetQueue and CSoundBaseDevice can be annotated with a stage directly.
+/// \note The latency histograms use the bucket layout of CLatencyMonitor with us units and
+///	  are updated with atomic operations, so that stages can be completed on any core and
+///	  execution level. Violations of the budget are kept in a global ring buffer.
+
+class CPipelineStage	/// Latency budget and histogram of a stage in a processing pipeline
+{
+public:
+	/// \param pName Name of the stage (must be constant)
+	/// \param nBudgetUs Maximum allowed latency of this stage in microseconds
+	CPipelineStage (const char *pName, unsigned nBudgetUs);
+	~CPipelineStage (void);
+
+	const char *GetName (void) const	{ return m_pName; }
+	unsigned GetBudget (void) const		{ return m_nBudget; }
+
+	/// \return Timestamp to be passed along with the data at the start of a stage
+	static u64 Stamp (void)
+	{
+		return CTimer::GetClockTicks64 ();
+	}
+
+	/// \brief Record the end of this stage
+	/// \param ullStamp Timestamp taken with Stamp() at the start of the stage
+	/// \param nContext Value to be recorded with a violation
+	void Complete (u64 ullStamp, uintptr nContext = 0)
+	{
+		u64 ullNow = CTimer::GetClockTicks64 ();
+		u64 ullLatency = ullNow > ullStamp ? ullNow - ullStamp : 0;
+
+		Record (ullLatency < 0xFFFFFFFFU ? (unsigned) ullLatency : 0xFFFFFFFFU, nContext);
+	}
+
+	/// \brief Record a latency, which has been measured by the caller
+	/// \param nLatencyUs Latency in microseconds
+	/// \param nContext Value to be recorded with a violation
+	void Record (unsigned nLatencyUs, uintptr nContext = 0);
+
+	/// \brief Clear the histogram of this stage
+	void Reset (void);
+
+	/// \param pStatistics Pointer to buffer for the result
+	void GetStatistics (TPipelineStageStatistics *pStatistics) const;
+
+	/// \brief Clear the histograms of all stages and the recorded violations
+	static void ResetAll (void);
+
+	/// \param pBuffer Pointer to buffer for the recent violations (oldest first)
+	/// \param nMaxEntries Size of the buffer in entries
+	/// \return Number of entries returned
+	static unsigned GetViolations (TPipelineViolation *pBuffer, unsigned nMaxEntries);
+
+	/// \brief Write a text report of all stages and the recent violations
+	/// \param pBuffer Pointer to the output buffer
+	/// \param nBufferSize Size of the output buffer
+	/// \return Number of bytes written (output is truncated, if the buffer is too small)
+	static unsigned Export (char *pBuffer, unsigned nBufferSize);
+
+	/// \brief Writes the report to the logger
+	static void Dump (void);
+
+private:
+	unsigned FindPercentile (unsigned nCount, unsigned nPerMille) const;
+
+	void AddViolation (unsigned nLatencyUs, uintptr nContext);
+
+private:
+	const char *m_pName;
+	unsigned m_nBudget;
+
+	u32 m_nBucket[LATENCY_BUCKETS];
+	u32 m_nCount;
+	u32 m_nMax;
+	u32 m_nViolations;
+
+	CPipelineStage *m_pNext;
+
+	static CPipelineStage *s_pFirst;
+
+	static TPipelineViolation s_Violations[PIPELINE_VIOLATIONS];
+	static unsigned s_nViolations;		// total number, next index modulo size
+
+	static CSpinLock s_ListLock;
+	static CSpinLock s_ViolationLock;
+};
+
+#endif
@@ -0,0 +1,146 @@
+//
+// asyncflow.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_asyncflow_h
+#define _circle_sched_asyncflow_h
+
+#include <circle/sched/workqueue.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/device.h>
+#include <circle/timer.h>
+#include <circle/types.h>
+
+/// \note The body of a flow is written in the overloaded method Run() between ASYNC_BEGIN\n
+///	  and ASYNC_END. ASYNC_AWAIT(op) suspends the flow, until the operation op has been\n
+///	  completed, without occupying a task and its stack meanwhile. Local variables of\n
+///	  Run() are lost on suspend, the state of a flow has to be kept in class members.\n
+///	  Only one ASYNC_AWAIT() is allowed per source line.
+/// \note An operation op is an Await*() method of CAsyncFlow or of another class\n
+///	  (e.g. CSocket::AwaitReceive()), which returns TRUE, if it has been completed, and\n
+///	  FALSE, if the flow has to be suspended. It is called again, when the flow resumes.\n
+///	  The result of the last operation can be fetched with GetResult() then.
+/// \note The flow runs in the CWorkQueue given to Start(). All code between two\n
+///	  ASYNC_AWAIT() must not block.
+
+#define ASYNC_BEGIN	switch (m_nResumePoint) { case 0:
+#define ASYNC_AWAIT(op)	do { m_nResumePoint = __LINE__; case __LINE__: if (!(op)) return; } while (0)
+#define ASYNC_YIELD()	do { m_nResumePoint = __LINE__; Reschedule (); return; case __LINE__: ; } while (0)
+#define ASYNC_EXIT()	do { m_nResumePoint = ASYNC_FINISHED; return; } while (0)
+#define ASYNC_END	} m_nResumePoint = ASYNC_FINISHED;
+
+#define ASYNC_FINISHED	-1
+
+class CAsyncFlow	/// Stackless coroutine, which awaits I/O completions without a task of its own
+{
+public:
+	CAsyncFlow (void);
+	virtual ~CAsyncFlow (void);
+
+	/// \brief Start the flow
+	/// \param pQueue Work queue, which runs the flow (0 for the default queue of this core)
+	/// \note Must be called from TASK_LEVEL.
+	void Start (CWorkQueue *pQueue = 0);
+
+	/// \return Has Run() reached ASYNC_END or ASYNC_EXIT()?
+	boolean IsFinished (void) const		{ return m_nResumePoint == ASYNC_FINISHED; }
+
+	/// \brief Wait for an event to be set
+	/// \param pEvent Pointer to the event
+	/// \return Operation completed? (the result is 0)
+	boolean AwaitEvent (CSynchronizationEvent *pEvent);
+
+	/// \brief Wait for a time period to elapse
+	/// \param nMicroSeconds Delay in microseconds (rounded up to 1/HZ without USE_TICKLESS_TIMER)
+	/// \return Operation completed? (the result is 0)
+	boolean AwaitDelay (unsigned nMicroSeconds);
+
+	/// \brief Read or write a block device
+	/// \param pDevice Pointer to a block device
+	/// \param pRequest Request with bWrite, pBuffer, ullOffset and nCount set,\n
+	///		    must be valid until completion
+	/// \return Operation completed? (the result is the number of transferred bytes, or < 0)
+	/// \note Uses DEVICE_IOCTL_SUBMIT, or a synchronous transfer, if it is not supported.
+	boolean AwaitBlockRequest (CDevice *pDevice, TDeviceBlockRequest *pRequest);
+
+	/// \return Result of the last completed operation
+	int GetResult (void) const		{ return m_nResult; }
+
+public:
+	// the following methods are used by the implementations of awaitable operations:
+	//	if (pFlow->IsPending ()) return pFlow->FetchCompletion ();
+	//	pFlow->Suspend ();
+	//	start operation, which calls pFlow->Complete (nResult) later
+	//	return FALSE;
+
+	/// \return Is an operation pending, which has been started by this flow?
+	boolean IsPending (void) const		{ return m_bPending; }
+	/// \brief Mark an operation as pending
+	void Suspend (void);
+	/// \brief Mark an operation as pending, which is completed (with result 0) by setting an event
+	/// \param pEvent Pointer to the event
+	void SuspendOnEvent (CSynchronizationEvent *pEvent);
+	/// \brief Complete the pending operation and resume the flow
+	/// \param nResult Result of the operation
+	/// \note Can be called from IRQ context and from other cores.
+	void Complete (int nResult);
+	/// \return Has the pending operation been completed? (it is not pending any more then)
+	boolean FetchCompletion (void);
+
+	/// \param nResult Result of an operation, which has been completed immediately
+	void SetResult (int nResult)		{ m_nResult = nResult; }
+
+	/// \return Event owned by the flow, which can be used by an operation, while it is pending
+	CSynchronizationEvent *GetEvent (void)	{ return &m_Event; }
+
+protected:
+	/// \brief Overload this method to define the body of the flow
+	virtual void Run (void) = 0;
+
+	/// \brief Called, when the flow has finished
+	/// \note The flow may be deleted here.
+	virtual void Finished (void) {}
+
+	/// \brief Run the flow again, after the current step has returned (see ASYNC_YIELD())
+	void Reschedule (void);
+
+protected:
+	int m_nResumePoint;		// source line of the last ASYNC_AWAIT() (0 initially)
+
+private:
+	static void WorkFunction (void *pParam);
+
+	static void DelayHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+	static void BlockCompletionRoutine (int nResult, void *pParam);
+
+private:
+	CWorkQueue *m_pQueue;
+	CWorkItem m_WorkItem;
+
+	volatile boolean m_bPending;
+	volatile boolean m_bCompleted;
+	volatile int m_nResult;
+
+	CSynchronizationEvent m_Event;
+
+	CSynchronizationEvent *m_pWaitEvent;	// event, the flow is waiting for
+	CAsyncFlow *m_pWaitListNext;		// in the list of flows waiting for this event
+	friend class CSynchronizationEvent;
+};
+
+#endif
@@ -0,0 +1,93 @@
+//
+// cpugovernor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_cpugovernor_h
+#define _circle_sched_cpugovernor_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/cputhrottle.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#define CPU_GOVERNOR_STEP	100000000	// clock rate granularity in Hz
+
+/// \note The load of a CPU core is the part of the sampling interval, in which the scheduler\n
+///	  of this core had a ready task. The highest load of all cores with a scheduler\n
+///	  determines the clock rate, because all cores share the same clock. Tasks, which\n
+///	  only poll in a loop with Yield(), show 100% load. They have to sleep or block, when\n
+///	  they have nothing to do, to allow the clock rate to be decreased.
+/// \note Above the up threshold the maximum clock rate is set at once. Below the down\n
+///	  threshold the clock rate is decreased by one step, after the load has been low for\n
+///	  a number of samples (hysteresis). In between the clock rate is held.
+/// \note The SoC temperature is still checked by calling CCPUThrottle::Update(), which\n
+///	  forces the minimum clock rate, while it is too high.
+
+class CCPUGovernor : public CTask	/// Task, which sets the CPU clock rate depending on the load
+{
+public:
+	/// \param pThrottle Pointer to the CPU throttle object
+	/// \param nSamplingMs Sampling interval in milliseconds
+	/// \param nUpThreshold Load in percent, above which the maximum clock rate is set
+	/// \param nDownThreshold Load in percent, below which the clock rate is decreased
+	/// \param nDownDelay Number of samples with low load, before the clock rate is decreased
+	CCPUGovernor (CCPUThrottle *pThrottle, unsigned nSamplingMs = 20,
+		      unsigned nUpThreshold = 80, unsigned nDownThreshold = 40,
+		      unsigned nDownDelay = 5);
+	~CCPUGovernor (void);
+
+	void Run (void);
+
+	/// \brief Request the maximum clock rate for some time (e.g. for a latency-critical event)
+	/// \param nMilliSeconds Duration of the boost
+	/// \note Can be called from interrupt context. The clock rate is raised, when the\n
+	///	  scheduler switches to the governor task next time, which should have a high\n
+	///	  priority therefore (default).
+	void Boost (unsigned nMilliSeconds = 100);
+
+	/// \return Current load in percent (highest of all cores)
+	unsigned GetLoad (void) const		{ return m_nLoad; }
+
+private:
+	unsigned MeasureLoad (void);
+
+private:
+	CCPUThrottle *m_pThrottle;
+	unsigned m_nSamplingMs;
+	unsigned m_nUpThreshold;
+	unsigned m_nDownThreshold;
+	unsigned m_nDownDelay;
+
+	unsigned m_nClockRate;
+	unsigned m_nLowSamples;
+	unsigned m_nLoad;
+
+	unsigned m_nLastTicks;
+#ifndef ARM_ALLOW_MULTI_CORE
+	unsigned m_nLastIdleTicks[1];
+#else
+	unsigned m_nLastIdleTicks[CORES];
+#endif
+
+	volatile unsigned m_nBoostEndTicks;
+	volatile boolean m_bBoost;
+	CSynchronizationEvent m_Event;
+};
+
+#endif
@@ -0,0 +1,101 @@
+//
+// initsequencer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_initsequencer_h
+#define _circle_sched_initsequencer_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/types.h>
+
+#define INIT_SEQUENCER_MAX_STEPS	32
+
+/// \brief Initialization function of a step
+/// \param pParam User parameter
+/// \return Operation successful?
+typedef boolean TInitStepFunction (void *pParam);
+
+/// \class CInitSequencer
+/// \brief Runs the initialization steps of independent subsystems concurrently
+///
+/// \details Each step runs in its own task, as soon as all steps it depends on have\n
+/// been completed successfully. A step is skipped (and is failed), if one of its\n
+/// dependencies has failed. Steps overlap, when they sleep (e.g. with\n
+/// CScheduler::MsSleep()) or when they run on different cores. The start of each\n
+/// step is recorded with CBootProfile::Mark().
+///
+/// \note The scheduler must be initialized before. Run() must be called from a task.
+/// \note Steps, which use only busy waits (CTimer::MsDelay()) on the same core,\n
+///	  do not overlap, they are run in dependency order then.
+
+class CInitSequencer
+{
+public:
+	CInitSequencer (void);
+	~CInitSequencer (void);
+
+	/// \brief Adds a step
+	/// \param pName Name of the step (static string)
+	/// \param pFunction Initialization function
+	/// \param pParam User parameter handed over to the function
+	/// \param nCore CPU core, on which the step runs (with ARM_ALLOW_MULTI_CORE)
+	/// \return Step number (or < 0 on error)
+	int AddStep (const char *pName, TInitStepFunction *pFunction, void *pParam = 0,
+		     unsigned nCore = TASK_CORE_CURRENT);
+
+	/// \brief Declares, that a step must not start before another step has been completed
+	/// \param nStep Step number
+	/// \param nDependsOnStep Step number of the dependency (must have been added before)
+	void AddDependency (int nStep, int nDependsOnStep);
+
+	/// \brief Runs all steps and waits for their completion
+	/// \return Have all steps been completed successfully?
+	boolean Run (void);
+
+	/// \param nStep Step number
+	/// \return Has the step been completed successfully?
+	boolean GetResult (int nStep) const;
+	/// \param nStep Step number
+	/// \return Run time of the step in microseconds
+	unsigned GetDuration (int nStep) const;
+
+private:
+	void RunStep (unsigned nStep);
+
+	friend class CInitStepTask;
+
+private:
+	struct TStep
+	{
+		const char		*pName;
+		TInitStepFunction	*pFunction;
+		void			*pParam;
+		unsigned		 nCore;
+		u32			 nDependMask;	// bit n = depends on step n
+
+		CSynchronizationEvent	 Event;		// set on completion
+		volatile boolean	 bResult;
+		unsigned		 nDuration;
+	};
+
+	unsigned m_nSteps;
+	TStep m_Step[INIT_SEQUENCER_MAX_STEPS];
+};
+
+#endif
@@ -0,0 +1,44 @@
+//
+// logdraintask.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_logdraintask_h
+#define _circle_sched_logdraintask_h
+
+#include <circle/sched/task.h>
+#include <circle/types.h>
+
+/// \note Messages written with CLogger::WriteDeferred() (or the LOG*_DEFERRED() macros) are
+///	  formatted and written to the log target by this task. It runs with the lowest
+///	  priority, so that logging does not delay time-critical tasks.
+
+class CLogDrainTask : public CTask	/// Task, which periodically flushes the deferred messages of CLogger
+{
+public:
+	/// \param nIntervalMs Flush interval in milliseconds
+	/// \param nPriority Priority of the task
+	CLogDrainTask (unsigned nIntervalMs = 50, unsigned nPriority = TASK_PRIORITY_LOWEST);
+	~CLogDrainTask (void);
+
+	void Run (void);
+
+private:
+	unsigned m_nIntervalMs;
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// mpmcqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_mpmcqueue_h
+#define _circle_sched_mpmcqueue_h
+
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+/// \note Enqueue() and Dequeue() do not block and do not need a lock. They can be called
+///	  from any context (task, IRQ, FIQ) and from different cores concurrently.
+/// \note An entry, which is currently being written by an interrupted producer, hides the
+///	  following entries from the consumers, until the producer continues.
+
+class CMPMCQueue	/// Lock-free multi-producer/multi-consumer ring queue of pointers
+{
+public:
+	/// \param nSize Maximum number of entries (must be a power of 2)
+	CMPMCQueue (unsigned nSize);
+	~CMPMCQueue (void);
+
+	/// \param pItem Pointer to be appended to the queue
+	/// \return FALSE, if the queue is full
+	boolean Enqueue (void *pItem);
+
+	/// \param ppItem The first pointer will be removed from the queue and returned here
+	/// \return FALSE, if the queue is empty
+	boolean Dequeue (void **ppItem);
+
+private:
+	struct TCell
+	{
+		volatile unsigned nSequence;
+		void *pItem;
+	};
+
+	TCell *m_pBuffer;
+	unsigned m_nMask;
+
+	volatile unsigned m_nEnqueuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+	volatile unsigned m_nDequeuePos ALIGN (DATA_CACHE_LINE_LENGTH_MAX);
+};
+
+#endif
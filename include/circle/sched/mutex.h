@@ -25,9 +25,18 @@
 
 #include <circle/types.h>
 #include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
 
 class CTask;
 
+/// \note With ARM_ALLOW_MULTI_CORE defined, the mutex can be used by tasks on different cores.\n
+///	  A task spins for a short time then, before it blocks, while the owner runs on another core.
+/// \note The owning task inherits the priority of a waiting task with a higher priority, until it
+///	  releases the mutex. Then it keeps the highest priority of the tasks, which are waiting for
+///	  the other mutexes it still holds. This is not done transitively, when the owner waits for
+///	  another mutex.
+
 class CMutex	/// Provides a method to provide mutual exclusion (critical sections) across tasks
 {
 public:
@@ -42,9 +51,18 @@ public:
 	void Release (void);
 
 private:
-	CTask* m_pOwningTask;
+	void AddToOwner (CTask *pTask);
+	void RemoveFromOwner (CTask *pTask);	// and restores its priority
+
+private:
+	CTask* volatile m_pOwningTask;
 	int m_iReentrancyCount;
+	volatile unsigned m_nWaiterPriority;	// highest priority of a waiting task
+	CMutex *m_pNextHeld;			// in the list of mutexes held by the owner
 	CSynchronizationEvent m_event;
+#ifdef ARM_ALLOW_MULTI_CORE
+	CSpinLock m_SpinLock;
+#endif
 };
 
 #endif
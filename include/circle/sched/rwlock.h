@@ -0,0 +1,64 @@
+//
+// rwlock.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_rwlock_h
+#define _circle_sched_rwlock_h
+
+#include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+/// \note With ARM_ALLOW_MULTI_CORE defined, the lock can be used by tasks on different cores.
+/// \note Writers are preferred. New readers block, while a writer is waiting for the lock.
+/// \note The lock is not re-entrant and must not be used from interrupt context.
+
+class CRWLock	/// Reader-writer lock, allows multiple readers or one writer at a time
+{
+public:
+	CRWLock (void);
+	~CRWLock (void);
+
+	/// \brief Acquire the lock for reading; task blocks, while a writer holds or waits for it
+	void AcquireRead (void);
+	/// \brief Try to acquire the lock for reading without blocking
+	/// \return Operation successful?
+	boolean TryAcquireRead (void);
+	/// \brief Release the lock, which has been acquired for reading
+	void ReleaseRead (void);
+
+	/// \brief Acquire the lock for writing; task blocks, while any reader or writer holds it
+	void AcquireWrite (void);
+	/// \brief Try to acquire the lock for writing without blocking
+	/// \return Operation successful?
+	boolean TryAcquireWrite (void);
+	/// \brief Release the lock, which has been acquired for writing
+	void ReleaseWrite (void);
+
+private:
+	unsigned m_nReaders;			// number of active readers
+	boolean m_bWriter;			// is a writer active?
+	unsigned m_nWaitingWriters;
+
+	CSynchronizationEvent m_ReadEvent;
+	CSynchronizationEvent m_WriteEvent;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
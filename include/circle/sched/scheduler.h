@@ -2,7 +2,7 @@
 /// \file scheduler.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,7 +22,9 @@
 
 #include <circle/sched/task.h>
 #include <circle/spinlock.h>
+#include <circle/multicore.h>
 #include <circle/device.h>
+#include <circle/timer.h>
 #include <circle/sysconfig.h>
 #include <circle/macros.h>
 #include <circle/types.h>
@@ -36,9 +38,19 @@ enum TTaskFlags		///< for EnumerateTasks()
 
 typedef void TSchedulerTaskHandler (CTask *pTask);
 
-/// \note This scheduler uses the round-robin policy, without priorities.
+/// \note This scheduler always runs a ready task with the highest priority (see CTask::SetPriority()).\n
+///	  Tasks with the same priority are scheduled using the round-robin policy.\n
+///	  If the current task has no time slice, a task, which gets ready, runs not before the\n
+///	  current task calls Yield() or blocks.
+/// \note With the system option USE_SCHEDULER_READY_QUEUE defined, the next task is taken\n
+///	  from a list of ready tasks, instead of walking through all tasks on each switch.
+/// \note With ARM_ALLOW_MULTI_CORE defined, there can be one scheduler instance per CPU core.\n
+///	  It has to be created on the core, on which it should run. Each task runs on one core.
+/// \note With USE_SCHEDULER_PREEMPTION defined, tasks with a time slice (see\n
+///	  CTask::SetTimeSlice()) are preempted on return from an IRQ. All other tasks are still\n
+///	  scheduled cooperatively.
 
-class CScheduler /// Cooperative non-preemtive scheduler, which controls which task runs at a time
+class CScheduler /// Priority-based scheduler (cooperative unless preemption is enabled), which controls which task runs at a time
 {
 public:
 	CScheduler (void);
@@ -48,6 +60,20 @@ public:
 	/// \note A task should call this from time to time, if it does longer calculations.
 	void Yield (void);
 
+#ifdef USE_SCHEDULER_PREEMPTION
+	/// \brief Prevent that the current task is preempted, until EnablePreemption() is called
+	/// \note Calls can be nested. The current task can still block or call Yield().
+	/// \note Holding a TASK_LEVEL spin lock prevents preemption too.
+	/// \note Does nothing on a CPU core without scheduler.
+	static void DisablePreemption (void);
+	/// \brief Allow the current task to be preempted again
+	/// \note Switches to the next task, if the time slice has elapsed meanwhile.
+	static void EnablePreemption (void);
+#else
+	static void DisablePreemption (void)	{}
+	static void EnablePreemption (void)	{}
+#endif
+
 	/// \param nSeconds Number of seconds, the current task will be sleep
 	void Sleep (unsigned nSeconds);
 	/// \param nMilliSeconds Number of milliseconds, the current task will be sleep
@@ -93,10 +119,16 @@ public:
 		void *pParam
 	);
 
+	/// \return Accumulated time in microseconds, in which no task was ready to run on this\n
+	///	    scheduler (wraps around)
+	/// \note The load of a CPU core can be calculated from the difference of two calls.
+	unsigned GetIdleTicks (void) const	{ return m_nIdleTicks; }
+
 	/// \brief Generate task listing
 	/// \param pTarget Device to be used for output
 	void ListTasks (CDevice *pTarget);
 
+#ifndef ARM_ALLOW_MULTI_CORE
 	/// \return Pointer to the only scheduler object in the system
 	static CScheduler *Get (void);
 
@@ -106,33 +138,131 @@ public:
 	{
 		return s_pThis != 0 ? TRUE : FALSE;
 	}
+#else
+	/// \return Pointer to the scheduler object of the calling CPU core
+	static CScheduler *Get (void)
+	{
+		return Get (CMultiCoreSupport::ThisCore ());
+	}
+	/// \param nCore CPU core number (0..CORES-1)
+	/// \return Pointer to the scheduler object of this CPU core
+	static CScheduler *Get (unsigned nCore);
+
+	/// \return Is the scheduler available on the calling CPU core?
+	/// \note The scheduler is optional in Circle.
+	static boolean IsActive (void)
+	{
+		return IsActive (CMultiCoreSupport::ThisCore ());
+	}
+	/// \param nCore CPU core number (0..CORES-1)
+	/// \return Is the scheduler available on this CPU core?
+	static boolean IsActive (unsigned nCore)
+	{
+		return s_pThis[nCore] != 0 ? TRUE : FALSE;
+	}
+#endif
 
 private:
 	void AddTask (CTask *pTask);
 	friend class CTask;
 
 	boolean BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds);
-	void WakeTasks (CTask **ppWaitListHead); // can be called from interrupt context
+	static void WakeTasks (CTask **ppWaitListHead); // can be called from interrupt context
 	friend class CSynchronizationEvent;
 
 	void RemoveTask (CTask *pTask);
-	unsigned GetNextTask (void); // returns index into m_pTask or MAX_TASKS if no task was found
+
+	// returns entry nIndex of the task table (0 if free or out of range),
+	// takes m_SpinLock, because AddTask() may replace the table meanwhile
+	CTask *GetTaskEntry (unsigned nIndex);
+
+	// idle wait
+	unsigned GetIdleDelay (void);		// time in us until next wake-up deadline
+	void WaitForWork (unsigned nDelay);
+	static void SignalWork (void);		// wakes waiting CPU cores
+#ifdef USE_TICKLESS_TIMER
+	static void IdleTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+#endif
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	static void IRQReturnHandler (void);
+	void Preempt (void);			// called on return from IRQ, may switch the task
+	void SwitchedIn (void);			// called, when a task continues after TaskSwitch()
+	void StartTimeSlice (CTask *pTask);
+	void StartTimeSliceTimer (unsigned nMicroSeconds);
+	static void TimeSliceHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+#endif
+
+	// hooks for CLatencyMonitor
+	static void MarkReady (CTask *pTask, unsigned nTicks, unsigned nSource);
+	static void RecordLatency (CTask *pTask);
+
+#ifndef USE_SCHEDULER_READY_QUEUE
+	CTask *GetNextTask (void); // returns 0 if no task was found
+#else
+	void ResumeTask (CTask *pTask);
+	void SuspendTask (CTask *pTask);
+	void SetTaskPriority (CTask *pTask, unsigned nPriority);
+
+	// the following methods must be called with m_SpinLock acquired
+	CTask *GetNextTask (void); // returns 0 if no task was found
+	void ParkCurrentTask (void);
+	void WakeSleepingTasks (void);
+	void MakeReady (CTask *pTask);
+
+	void InsertSleeping (CTask *pTask);
+
+	void ReapTerminatedTasks (void);
+
+	void EnqueueReady (CTask *pTask);
+	boolean IsReadyQueue (const TTaskQueue *pQueue) const;
+
+	void Enqueue (TTaskQueue *pQueue, CTask *pTask);
+	void Dequeue (CTask *pTask);
+#endif
 
 private:
-	CTask *m_pTask[MAX_TASKS];
-	unsigned m_nTasks;
+	CTask **m_pTask;		// task table, grows on demand
+	unsigned m_nTasks;		// used entries
+	unsigned m_nTableSize;		// allocated entries
 
 	CTask *m_pCurrent;
+#ifndef USE_SCHEDULER_READY_QUEUE
 	unsigned m_nCurrent;	// index into m_pTask
+#else
+	TTaskQueue m_ReadyQueue[TASK_PRIORITY_LEVELS];	// ready tasks, except the current one
+	u32 m_nReadyMask;		// bit set for each non-empty ready queue
+	TTaskQueue m_SleepQueue;	// sorted by wake ticks
+	TTaskQueue m_TerminatedQueue;	// tasks to be deleted
+#endif
 
 	TSchedulerTaskHandler *m_pTaskSwitchHandler;
 	TSchedulerTaskHandler *m_pTaskTerminationHandler;
 
 	int m_iSuspendNewTasks;
 
+	volatile unsigned m_nIdleTicks;
+#ifdef USE_TICKLESS_TIMER
+	TKernelTimerHandle m_hIdleTimer;
+#endif
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	volatile boolean m_bSwitching;		// in Yield() or Preempt(), no preemption
+	unsigned m_nSliceEnd;			// clock ticks, when the time slice elapses
+	volatile boolean m_bSliceTimerPending;
+#endif
+
 	CSpinLock m_SpinLock;
 
+#ifndef ARM_ALLOW_MULTI_CORE
 	static CScheduler *s_pThis;
+#else
+	unsigned m_nCore;
+
+	static CScheduler *s_pThis[CORES];
+#endif
+
+	static CSpinLock s_WaitListSpinLock;	// protects the wait lists of all events
 };
 
 #endif
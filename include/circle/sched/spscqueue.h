@@ -0,0 +1,58 @@
+//
+// spscqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_spscqueue_h
+#define _circle_sched_spscqueue_h
+
+#include <circle/synchronize.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+/// \note Enqueue() and Dequeue() do not block and do not need a lock. The producer and the
+///	  consumer can run in any context (task, IRQ, FIQ) and on different cores, but there
+///	  must be only one producer and one consumer at a time.
+
+class CSPSCQueue	/// Lock-free single-producer/single-consumer ring queue of pointers
+{
+public:
+	/// \param nSize Maximum number of entries (must be a power of 2)
+	CSPSCQueue (unsigned nSize);
+	~CSPSCQueue (void);
+
+	/// \return Is the queue empty?
+	boolean IsEmpty (void) const;
+
+	/// \param pItem Pointer to be appended to the queue
+	/// \return FALSE, if the queue is full
+	boolean Enqueue (void *pItem);
+
+	/// \param ppItem The first pointer will be removed from the queue and returned here
+	/// \return FALSE, if the queue is empty
+	boolean Dequeue (void **ppItem);
+
+private:
+	void **m_ppBuffer;
+	unsigned m_nMask;
+
+	// each index is written by one side only, keep them in separate cache lines
+	volatile unsigned m_nHead ALIGN (DATA_CACHE_LINE_LENGTH_MAX);	// next to be read
+	volatile unsigned m_nTail ALIGN (DATA_CACHE_LINE_LENGTH_MAX);	// next to be written
+};
+
+#endif
@@ -2,7 +2,7 @@
 // synchronizationevent.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -20,9 +20,11 @@
 #ifndef _circle_sched_synchronizationevent_h
 #define _circle_sched_synchronizationevent_h
 
+#include <circle/spinlock.h>
 #include <circle/types.h>
 
 class CTask;
+class CAsyncFlow;
 
 class CSynchronizationEvent /// Provides a method to synchronize the execution of a task with an event
 {
@@ -37,7 +39,7 @@ public:
 
 	/// \brief Clear the event
 	void Clear (void);
-	/// \brief Set the event; wakes all task(s) currently waiting for the event
+	/// \brief Set the event; wakes all task(s) and async flow(s) currently waiting for the event
 	/// \note Can be called from interrupt context.
 	void Set (void);
 
@@ -58,9 +60,16 @@ private:
 	void Pulse (void);	// wakes all waiting tasks without actually setting the event
 	friend class CMutex;
 
+	void AddAsyncFlow (CAsyncFlow *pFlow);	// completes the flow immediately, if event is set
+	void WakeAsyncFlows (void);
+	friend class CAsyncFlow;
+
 private:
 	volatile boolean m_bState;
 	CTask	*m_pWaitListHead;	// Linked list of waiting tasks
+	CAsyncFlow *m_pAsyncListHead;	// Linked list of waiting async flows
+
+	static CSpinLock s_AsyncListSpinLock;
 };
 
 #endif
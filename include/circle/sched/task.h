@@ -2,7 +2,7 @@
 /// task.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -37,14 +37,35 @@ enum TTaskState
 	TaskStateUnknown
 };
 
+#define TASK_PRIORITY_LOWEST		0
+#define TASK_PRIORITY_DEFAULT		4
+#define TASK_PRIORITY_HIGHEST		7
+#define TASK_PRIORITY_LEVELS		8	// Number of available priority levels
+
+#define TASK_CORE_CURRENT		0xFFFFFFFFU	// Run on the core, which creates the task
+
 class CScheduler;
+class CTask;
+class CMutex;
+
+struct TTaskQueue	// intrusive list of tasks, used with USE_SCHEDULER_READY_QUEUE
+{
+	CTask	*pHead;
+	CTask	*pTail;
+};
 
 class CTask	/// Overload this class, define the Run() method, and call new on it to start it.
 {
 public:
 	/// \param nStackSize Stack size for this task (0 used internally for the main task)
 	/// \param bCreateSuspended Set to TRUE, if the task is initially not ready to run
-	CTask (unsigned nStackSize = TASK_STACK_SIZE, boolean bCreateSuspended = FALSE);
+	/// \param nPriority Priority of this task (TASK_PRIORITY_LOWEST..TASK_PRIORITY_HIGHEST)
+	/// \param nCore CPU core, on which this task runs (with ARM_ALLOW_MULTI_CORE only)
+	/// \note The scheduler must already run on the core nCore. A task, which will run on\n
+	///	  another core than the calling one, must be created suspended and must be started\n
+	///	  with Start(), after the constructor of the derived class has been completed.
+	CTask (unsigned nStackSize = TASK_STACK_SIZE, boolean bCreateSuspended = FALSE,
+	       unsigned nPriority = TASK_PRIORITY_DEFAULT, unsigned nCore = TASK_CORE_CURRENT);
 
 	virtual ~CTask (void);
 
@@ -75,6 +96,28 @@ public:
 	/// \return Pointer to 0-terminated name string ("@this_address" if not explicitly set)
 	const char *GetName (void) const;
 
+	/// \brief Set the priority of this task
+	/// \param nPriority Priority (TASK_PRIORITY_LOWEST..TASK_PRIORITY_HIGHEST)
+	/// \note The scheduler always selects a ready task with the highest priority.\n
+	///	  Tasks with the same priority are scheduled round-robin.
+	void SetPriority (unsigned nPriority);
+	/// \return Priority of this task (may be temporarily raised, while holding a CMutex)
+	unsigned GetPriority (void) const	{ return m_nPriority; }
+
+	/// \brief Make this task preemptible or cooperative again
+	/// \param nMicroSeconds Time slice of this task (0 for cooperative scheduling, the default)
+	/// \note A preemptible task is switched out on return from an IRQ, when its time slice has\n
+	///	  elapsed and another task with the same or a higher priority is ready, or as soon\n
+	///	  as a task with a higher priority gets ready. Requires USE_SCHEDULER_PREEMPTION.
+	/// \note Data, which is shared with other tasks, must be protected by a CSpinLock, CMutex\n
+	///	  or CScheduler::DisablePreemption() in a preemptible task.
+	void SetTimeSlice (unsigned nMicroSeconds = TASK_TIME_SLICE_DEFAULT_US);
+	/// \return Time slice of this task in microseconds (0 if cooperative)
+	unsigned GetTimeSlice (void) const	{ return m_nTimeSlice; }
+
+	/// \return CPU core number, on which this task runs
+	unsigned GetCore (void) const		{ return m_nCore; }
+
 #define TASK_USER_DATA_KTHREAD		0	// Linux driver emulation
 #define TASK_USER_DATA_ERROR_STACK	1	// Plan 9 driver emulation
 #define TASK_USER_DATA_USER		2	// Free for application usage
@@ -96,19 +139,43 @@ private:
 	unsigned GetWakeTicks (void) const	{ return m_nWakeTicks; }
 	void SetWakeTicks (unsigned nTicks)	{ m_nWakeTicks = nTicks; }
 
+	// for CLatencyMonitor: time, when the task became ready, and reason (TLatencySource)
+	void SetReadyTicks (unsigned nTicks, unsigned nSource)
+						{ m_nReadyTicks = nTicks; m_nReadySource = nSource; }
+
 	TTaskRegisters *GetRegs (void)		{ return &m_Regs; }
 
+	// priority inheritance for CMutex
+	void InheritPriority (unsigned nPriority);
+	void RestorePriority (unsigned nInheritedPriority);	// from the mutexes still held
+
+	boolean IsRunning (void) const;
+
 	friend class CScheduler;
+	friend class CMutex;
+	friend class CTaskHealthMonitor;
 
 private:
 	void InitializeRegs (void);
 
+	void ApplyPriority (unsigned nPriority);
+
 	static void TaskEntry (void *pParam);
 
 private:
 	volatile TTaskState m_State;
 	boolean		    m_bSuspended;
+	unsigned	    m_nPriority;		// effective priority
+	unsigned	    m_nBasePriority;		// set with SetPriority()
+	unsigned	    m_nInheritedPriority;	// from tasks waiting for a CMutex
+	CMutex		   *m_pHeldMutexes;		// linked with CMutex::m_pNextHeld
+	unsigned	    m_nCore;
+	CScheduler	   *m_pScheduler;
 	unsigned	    m_nWakeTicks;
+	unsigned	    m_nReadyTicks;
+	unsigned	    m_nReadySource;
+	unsigned	    m_nTimeSlice;		// in microseconds, 0 if cooperative
+	volatile unsigned   m_nPreemptDisable;		// nesting level of DisablePreemption()
 	TTaskRegisters	    m_Regs;
 	unsigned	    m_nStackSize;
 	u8		   *m_pStack;
@@ -116,6 +183,10 @@ private:
 	void		   *m_pUserData[TASK_USER_DATA_SLOTS];
 	CSynchronizationEvent m_Event;
 	CTask		   *m_pWaitListNext;	// next in list of tasks waiting on an event
+
+	TTaskQueue	   *m_pQueue;		// queue this task is currently linked in (or 0)
+	CTask		   *m_pQueuePrev;
+	CTask		   *m_pQueueNext;
 };
 
 #endif
@@ -0,0 +1,101 @@
+//
+// taskhealthmonitor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_taskhealthmonitor_h
+#define _circle_sched_taskhealthmonitor_h
+
+#include <circle/sched/task.h>
+#include <circle/bcmwatchdog.h>
+#include <circle/timer.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define TASK_HEALTH_MAX_TASKS		16
+#define TASK_HEALTH_CHECK_MS		100		// check interval
+
+/// \note Each critical task registers with a deadline and calls Heartbeat() at least once\n
+///	  within this deadline. Heartbeat() only increments a counter of the task. The\n
+///	  monitor runs from a kernel timer (timer IRQ) and re-triggers the hardware watchdog,\n
+///	  as long as all registered tasks are healthy. If a task misses its deadline, its name,\n
+///	  state and stack are logged once and the watchdog is not fed any more, so that the\n
+///	  system restarts, after the watchdog timeout has elapsed.
+/// \note Suspended tasks are not checked. A task must be unregistered, before it terminates.
+
+class CTaskHealthMonitor	/// Feeds the watchdog, while all registered tasks post heartbeats
+{
+public:
+	typedef int THandle;
+
+public:
+	/// \param pWatchdog Pointer to the watchdog device
+	/// \param nWatchdogSeconds Watchdog timeout in seconds (max. 15)
+	CTaskHealthMonitor (CBcmWatchdog *pWatchdog, unsigned nWatchdogSeconds = 10);
+	~CTaskHealthMonitor (void);
+
+	/// \brief Starts the watchdog and the periodic check
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \param pTask Task to be monitored
+	/// \param nDeadlineMs Maximum time between two heartbeats in milliseconds
+	/// \return Handle to be used with Heartbeat() (< 0 if no free entry)
+	THandle Register (CTask *pTask, unsigned nDeadlineMs);
+	/// \param hEntry Handle returned from Register()
+	void Unregister (THandle hEntry);
+
+	/// \brief Signals, that the task is alive
+	/// \param hEntry Handle returned from Register()
+	/// \note Callable from the registered task only
+	void Heartbeat (THandle hEntry)
+	{
+		TEntry *pEntry = &m_Entry[hEntry];
+		__atomic_store_n (&pEntry->nBeats, pEntry->nBeats+1, __ATOMIC_RELAXED);
+	}
+
+	/// \return Has a task missed its deadline?
+	boolean HasFailed (void) const		{ return m_bFailed; }
+
+private:
+	void Check (void);
+	void ReportTask (CTask *pTask, unsigned nOverdueMs);
+
+	static void TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
+private:
+	CBcmWatchdog *m_pWatchdog;
+	unsigned m_nWatchdogSeconds;
+
+	struct TEntry
+	{
+		CTask		 *pTask;	// 0 if free
+		unsigned	  nDeadlineUs;
+		volatile unsigned nBeats;
+		unsigned	  nLastBeats;
+		unsigned	  nLastBeatTicks;	// CTimer::GetClockTicks() of last seen beat
+	};
+
+	TEntry m_Entry[TASK_HEALTH_MAX_TASKS];
+
+	TKernelTimerHandle m_hTimer;
+	volatile boolean m_bFailed;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -0,0 +1,61 @@
+//
+// taskstackpool.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_taskstackpool_h
+#define _circle_sched_taskstackpool_h
+
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#define TASK_STACK_POOL_MAX_CLASSES	8
+
+/// \note Freed stacks are kept on a free list of their size class for reuse and are\n
+///	  never returned to the heap. Stacks, which are larger than the largest size class\n
+///	  (or all stacks with NO_TASK_STACK_POOL defined), are allocated from the heap.
+
+class CTaskStackPool	/// Pool of reusable task stacks in a few size classes
+{
+public:
+	/// \param nSize Requested stack size in bytes
+	/// \return Pointer to the stack memory (the size is rounded up to the size class)
+	static u8 *Allocate (unsigned nSize);
+
+	/// \param pStack Stack memory, allocated with Allocate()
+	/// \param nSize Same size as given to Allocate()
+	static void Free (u8 *pStack, unsigned nSize);
+
+private:
+	static unsigned GetClass (unsigned nSize);	// returns s_nClasses, if no class fits
+
+private:
+	struct TFreeStack
+	{
+		TFreeStack *pNext;
+	};
+
+	static const unsigned s_nClassSize[];
+	static const unsigned s_nClasses;
+
+	static TFreeStack *s_pFreeList[TASK_STACK_POOL_MAX_CLASSES];
+
+	static CSpinLock s_SpinLock;
+};
+
+#endif
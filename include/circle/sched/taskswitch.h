@@ -45,7 +45,7 @@ struct TTaskRegisters
 	u32	r12;
 	u32	sp;
 	u32	lr;
-	u64	d[16];
+	u64	d[8];	// d8-d15 (callee-saved)
 }
 PACKED;
 
@@ -0,0 +1,80 @@
+//
+// threadedirq.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_threadedirq_h
+#define _circle_sched_threadedirq_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/interrupt.h>
+#include <circle/types.h>
+
+class CThreadedIRQ;
+
+class CThreadedIRQTask : public CTask	/// Handler task of a CThreadedIRQ (internal use only)
+{
+public:
+	CThreadedIRQTask (CThreadedIRQ *pIRQ, unsigned nPriority);
+
+	void Run (void);
+
+private:
+	CThreadedIRQ *m_pIRQ;
+};
+
+/// \note The primary handler runs in IRQ context and must only acknowledge (silence) the
+///	  interrupt source. If no primary handler is given, the IRQ line is disabled in the
+///	  interrupt controller instead, until the thread handler has returned. This is
+///	  required for level-triggered IRQs, which cannot be acknowledged quickly.
+/// \note The thread handler runs in a task with the given priority. Multiple interrupts,
+///	  which occur, before it has run, are handled by one call.
+/// \note The object must be deleted from task context. The destructor waits for the
+///	  termination of the handler task.
+
+class CThreadedIRQ	/// IRQ, whose handler is executed in a dedicated task
+{
+public:
+	/// \param nIRQ IRQ number (see circle/bcm*int.h)
+	/// \param pPrimaryHandler Handler called in IRQ context (may be 0)
+	/// \param pThreadHandler Handler called in task context
+	/// \param pParam User parameter handed over to both handlers
+	/// \param nPriority Priority of the handler task
+	CThreadedIRQ (unsigned nIRQ, TIRQHandler *pPrimaryHandler, TIRQHandler *pThreadHandler,
+		      void *pParam = 0, unsigned nPriority = TASK_PRIORITY_HIGHEST);
+	~CThreadedIRQ (void);
+
+private:
+	void TaskHandler (void);		// called from CThreadedIRQTask::Run()
+	friend class CThreadedIRQTask;
+
+	static void IRQStub (void *pParam);
+
+private:
+	unsigned m_nIRQ;
+	TIRQHandler *m_pPrimaryHandler;
+	TIRQHandler *m_pThreadHandler;
+	void *m_pParam;
+
+	volatile boolean m_bTerminate;
+	CSynchronizationEvent m_Event;
+
+	CThreadedIRQTask *m_pTask;		// deleted by the scheduler, when it has terminated
+};
+
+#endif
@@ -0,0 +1,92 @@
+//
+// workqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sched_workqueue_h
+#define _circle_sched_workqueue_h
+
+#include <circle/sched/task.h>
+#include <circle/sched/synchronizationevent.h>
+#include <circle/spinlock.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+typedef void TWorkFunction (void *pParam);
+
+class CWorkItem	/// Deferred work, which is queued from an IRQ handler and executed in a task
+{
+public:
+	/// \param pFunction Function to be called in task context
+	/// \param pParam User parameter handed over to the function
+	CWorkItem (TWorkFunction *pFunction, void *pParam = 0);
+	~CWorkItem (void);
+
+	/// \return Is this item queued and its function not called yet?
+	boolean IsPending (void) const	{ return m_bPending; }
+
+private:
+	TWorkFunction *m_pFunction;
+	void *m_pParam;
+
+	volatile boolean m_bPending;
+	CWorkItem *m_pNext;
+
+	friend class CWorkQueue;
+};
+
+/// \note The hard IRQ handler only acknowledges the hardware and queues a work item, which
+///	  does the remaining processing. A work item is queued at most once, until its
+///	  function has been called. It can be queued again from its own function.
+/// \note Queue() can be called from task and IRQ context, but not from an FIQ handler.
+///	  The work functions are called in the order of queuing by the task of the work queue,
+///	  which runs on the core, which has created the queue.
+
+class CWorkQueue : public CTask	/// Task, which executes deferred work queued from IRQ handlers
+{
+public:
+	/// \param nPriority Priority of the worker task
+	/// \param nCore CPU core, on which the work is executed (with ARM_ALLOW_MULTI_CORE)
+	CWorkQueue (unsigned nPriority = TASK_PRIORITY_HIGHEST, unsigned nCore = TASK_CORE_CURRENT);
+	~CWorkQueue (void);
+
+	/// \param pItem Work item to be executed
+	/// \return FALSE, if the item is already pending
+	boolean Queue (CWorkItem *pItem);
+
+	void Run (void);
+
+	/// \return Pointer to the default work queue of the calling core
+	/// \note The queue is created on first call, which must be done from task context.
+	static CWorkQueue *Get (void);
+
+private:
+	CWorkItem *m_pFirst;
+	CWorkItem *m_pLast;
+
+	CSpinLock m_SpinLock;
+
+	CSynchronizationEvent m_Event;
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	static CWorkQueue *s_pDefault[1];
+#else
+	static CWorkQueue *s_pDefault[CORES];
+#endif
+};
+
+#endif
@@ -25,6 +25,7 @@
 #include <circle/gpiopin.h>
 #include <circle/spinlock.h>
 #include <circle/sysconfig.h>
+#include <circle/timerwheel.h>
 #include <circle/types.h>
 
 /// \class CSerialDevice
@@ -81,6 +82,10 @@
 #endif
 #define SERIAL_BUF_MASK		(SERIAL_BUF_SIZE-1)
 
+#ifndef SERIAL_DMA_BUF_SIZE
+#define SERIAL_DMA_BUF_SIZE	16384			// default, in characters
+#endif
+
 // serial options
 #define SERIAL_OPTION_ONLCR	(1 << 0)	///< Translate NL to NL+CR on output (default)
 
@@ -90,6 +95,11 @@
 #define SERIAL_ERROR_FRAMING	3
 #define SERIAL_ERROR_PARITY	4
 
+// error flags in the words returned from GetRxData()
+#define SERIAL_RX_ERROR_MASK	(0xF << 8)
+
+struct TDMAControlBlock;
+
 class CSerialDevice : public CDevice
 {
 public:
@@ -114,6 +124,20 @@ public:
 	~CSerialDevice (void);
 #endif
 
+#ifndef USE_RPI_STUB_AT
+	/// \brief Use DMA for receive and transmit, instead of an interrupt per FIFO level
+	/// \param nRxBufferSize Size of the receive ring buffer in characters (power of 2)
+	/// \param nTxBufferSize Size of the transmit ring buffer in characters (power of 2)
+	/// \return Operation successful? (FALSE, if DMA is not supported for this device)
+	/// \note Must be called before Initialize(), requires the interrupt driver.
+	/// \note Supported for device 0 on Raspberry Pi 1-4 only.
+	/// \note The received characters are written by DMA into the receive ring buffer,\n
+	///	  which is overwritten, when it is not read in time (reported as overrun).
+	/// \note The character and magic received handlers do not work with DMA.
+	boolean EnableDMA (unsigned nRxBufferSize = SERIAL_DMA_BUF_SIZE,
+			   unsigned nTxBufferSize = SERIAL_DMA_BUF_SIZE);
+#endif
+
 	/// \param nBaudrate Baud rate in bits per second
 	/// \param nDataBits Number of data bits (5..8, default 8)
 	/// \param nStopBits Number of stop bits (1..2, default 1)
@@ -168,6 +192,27 @@ public:
 	/// \note Does only work with interrupt driver.
 	void RegisterMagicReceivedHandler (const char *pMagic, TMagicReceivedHandler *pHandler);
 
+	/// \param pParam User parameter
+	typedef void TIdleHandler (void *pParam);
+	/// \param pHandler Handler which is called, when no character has been received for\n
+	///	  the idle time after the last received one (0 to unregister)
+	/// \param pParam User parameter, which is handed over to the handler
+	/// \param nIdleMicros Idle time in microseconds (resolution is the kernel timer tick)
+	/// \note Does only work with DMA, the handler is called from a kernel timer.
+	void RegisterIdleHandler (TIdleHandler *pHandler, void *pParam = 0,
+				  unsigned nIdleMicros = 1000);
+
+	/// \brief Zero-copy access to the received data (DMA only)
+	/// \param pCount Number of contiguous words available is returned here
+	/// \return Pointer to the word of the next received character (or 0 if none)
+	/// \note The character is in bits 7-0 of each word, the error flags in the bits\n
+	///	  SERIAL_RX_ERROR_MASK (break, overrun, framing, parity from bit 11 down).
+	/// \note May return fewer words than available, when the ring buffer wraps.
+	const u32 *GetRxData (unsigned *pCount);
+	/// \brief Frees words, returned by GetRxData() before
+	/// \param nCount Number of words to be freed
+	void ReleaseRxData (unsigned nCount);
+
 protected:
 	/// \return Number of bytes buffer space available for Write()
 	/// \note Does only work with interrupt driver.
@@ -190,6 +235,16 @@ private:
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
 
+	boolean SetupDMA (void);
+	void StopDMA (void);
+	unsigned RxDMAAvailable (void);
+	void StartTxDMA (void);
+	void RxDMAInterruptHandler (void);
+	static void RxDMAInterruptStub (void *pParam);
+	void TxDMAInterruptHandler (void);
+	static void TxDMAInterruptStub (void *pParam);
+	static void IdleTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
 private:
 	CInterruptSystem *m_pInterruptSystem;
 	boolean m_bUseFIQ;
@@ -225,6 +280,31 @@ private:
 	CSpinLock m_SpinLock;
 	CSpinLock m_LineSpinLock;
 
+	boolean m_bUseDMA;
+	unsigned m_nRxDMAChannel;
+	unsigned m_nTxDMAChannel;
+	u8 *m_pDMAControlBlockBuffer;
+	TDMAControlBlock *m_pRxControlBlock;
+	TDMAControlBlock *m_pTxControlBlock;
+
+	u32 *m_pRxDMABuffer;			// one word per character
+	unsigned m_nRxDMASize;
+	volatile unsigned m_nRxDMALaps;		// wraps of the DMA write position
+	unsigned m_nRxDMAConsumed;		// total number of characters read
+
+	u32 *m_pTxDMABuffer;
+	unsigned m_nTxDMASize;
+	unsigned m_nTxDMAInPtr;
+	unsigned m_nTxDMAOutPtr;
+	unsigned m_nTxDMALength;		// of the running transfer (0 if idle)
+
+	TIdleHandler *m_pIdleHandler;
+	void *m_pIdleParam;
+	unsigned m_nIdleMicros;
+	TKernelTimerHandle m_hIdleTimer;
+	unsigned m_nIdleLastReceived;
+	boolean m_bIdlePending;
+
 	static unsigned s_nInterruptUseCount;
 	static CInterruptSystem *s_pInterruptSystem;
 	static boolean s_bUseFIQ;
@@ -0,0 +1,152 @@
+//
+// smallvector.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_smallvector_h
+#define _circle_smallvector_h
+
+#include <circle/new.h>
+#include <circle/util.h>
+#include <circle/types.h>
+#include <assert.h>
+
+/// \brief Type-safe dynamic array, which keeps up to InlineSize elements inside the object
+/// \note Elements are moved with memcpy() on growth, so T must be trivially relocatable\n
+///	  (true for pointers, integers and plain structs)
+template <class T, unsigned InlineSize = 8>
+class CSmallVector
+{
+public:
+	CSmallVector (void)
+	:	m_pArray (reinterpret_cast<T *> (m_InlineStorage)),
+		m_nCount (0),
+		m_nReserved (InlineSize)
+	{
+	}
+
+	~CSmallVector (void)
+	{
+		Clear ();
+
+		if (!IsInline ())
+		{
+			delete [] reinterpret_cast<u8 *> (m_pArray);
+		}
+	}
+
+	CSmallVector (const CSmallVector &) = delete;
+	CSmallVector &operator= (const CSmallVector &) = delete;
+
+	unsigned GetCount (void) const	{ return m_nCount; }
+	boolean IsEmpty (void) const	{ return m_nCount == 0; }
+
+	T &operator[] (unsigned nIndex)
+	{
+		assert (nIndex < m_nCount);
+		return m_pArray[nIndex];
+	}
+
+	const T &operator[] (unsigned nIndex) const
+	{
+		assert (nIndex < m_nCount);
+		return m_pArray[nIndex];
+	}
+
+	/// \return Index of the new element
+	unsigned Append (const T &rElement)
+	{
+		if (m_nCount == m_nReserved)
+		{
+			Reserve (m_nReserved * 2);
+		}
+
+		new (&m_pArray[m_nCount]) T (rElement);
+
+		return m_nCount++;
+	}
+
+	void RemoveLast (void)
+	{
+		assert (m_nCount > 0);
+		m_pArray[--m_nCount].~T ();
+	}
+
+	/// \brief Remove element at nIndex, the last element takes its place (order changes)
+	void RemoveFast (unsigned nIndex)
+	{
+		assert (nIndex < m_nCount);
+
+		if (nIndex != --m_nCount)
+		{
+			m_pArray[nIndex] = m_pArray[m_nCount];
+		}
+
+		m_pArray[m_nCount].~T ();
+	}
+
+	void Clear (void)
+	{
+		while (m_nCount > 0)
+		{
+			RemoveLast ();
+		}
+	}
+
+	/// \brief Ensure capacity for nCount elements (allocates on the heap beyond InlineSize)
+	void Reserve (unsigned nCount)
+	{
+		if (nCount <= m_nReserved)
+		{
+			return;
+		}
+
+		T *pNewArray = reinterpret_cast<T *> (new u8[nCount * sizeof (T)]);
+		assert (pNewArray != 0);
+
+		memcpy (pNewArray, m_pArray, m_nCount * sizeof (T));
+
+		if (!IsInline ())
+		{
+			delete [] reinterpret_cast<u8 *> (m_pArray);
+		}
+
+		m_pArray = pNewArray;
+		m_nReserved = nCount;
+	}
+
+	// range-based for loop support
+	T *begin (void)			{ return m_pArray; }
+	T *end (void)			{ return m_pArray + m_nCount; }
+	const T *begin (void) const	{ return m_pArray; }
+	const T *end (void) const	{ return m_pArray + m_nCount; }
+
+private:
+	boolean IsInline (void) const
+	{
+		return m_pArray == reinterpret_cast<const T *> (m_InlineStorage);
+	}
+
+private:
+	T	 *m_pArray;
+	unsigned  m_nCount;
+	unsigned  m_nReserved;
+
+	alignas (T) u8 m_InlineStorage[InlineSize * sizeof (T)];
+};
+
+#endif
@@ -100,6 +100,10 @@ public:
 	/// \param bWaitForCompletion	Whether to wait for DMA completion
 	void WriteDMA (boolean bWaitForCompletion);
 
+	/// \brief Waits for the completion of a DMA transfer, triggered with WriteDMA (FALSE)
+	/// \return Has the transfer been successful?
+	boolean WaitForDMA (void);
+
 protected:
 	unsigned m_nSDLinesMask;
 	boolean m_bUseAddressPins;
@@ -0,0 +1,85 @@
+//
+// softirq.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_softirq_h
+#define _circle_softirq_h
+
+#include <circle/interrupt.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#if RASPPI <= 3
+	#include <circle/mphi.h>
+#endif
+
+#define SOFTIRQ_LINES		32
+
+/// \note This class multiplexes a number of virtual IRQ lines over one hardware source,\n
+///	  which can be triggered from software (MPHI device on Raspberry Pi 1-3, software\n
+///	  generated interrupt (SGI) with GIC). It is used to hand over work from FIQ level\n
+///	  (e.g. FIQ-based USB driver, CGPIOPinFIQ handler) to IRQ level with low latency.
+/// \note Trigger() only sets the pending bit of the line and triggers the hardware source,\n
+///	  if it is not already triggered. The handlers of all pending lines are called from\n
+///	  one IRQ on the core, which created this object.
+
+class CSoftIRQ		/// Virtual IRQ lines, which are triggered from software
+{
+public:
+	/// \param pInterrupt Pointer to the interrupt system object
+	/// \note Use Get() to access the only instance, it is created on first use.
+	CSoftIRQ (CInterruptSystem *pInterrupt);
+	~CSoftIRQ (void);
+
+	/// \param pHandler IRQ handler to be called, when the line has been triggered
+	/// \param pParam User parameter handed over to the handler
+	/// \return Number of the allocated line (< 0 if no line is free)
+	int Connect (TIRQHandler *pHandler, void *pParam = 0);
+	/// \param nLine Number of the line returned from Connect()
+	void Disconnect (unsigned nLine);
+
+	/// \param nLine Number of the line to be triggered
+	/// \note Can be called from any context (task, IRQ, FIQ) and from different cores.
+	void Trigger (unsigned nLine);
+
+	/// \return Pointer to the only instance of this class (created, if not available yet)
+	/// \note Must be called on the core, which handles the IRQs, for the first time.
+	static CSoftIRQ *Get (void);
+
+private:
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+private:
+	CInterruptSystem *m_pInterrupt;
+#if RASPPI <= 3
+	CMPHIDevice m_MPHI;
+#else
+	unsigned m_nCore;
+#endif
+
+	TIRQHandler *m_pHandler[SOFTIRQ_LINES];
+	void *m_pParam[SOFTIRQ_LINES];
+
+	volatile u32 m_nPending;		// bit mask of triggered lines
+	volatile int m_nTriggered;		// hardware source has been triggered
+
+	static CSoftIRQ *s_pThis;
+};
+
+#endif
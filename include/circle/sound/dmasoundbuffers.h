@@ -25,6 +25,8 @@
 #include <circle/spinlock.h>
 #include <circle/types.h>
 
+#define DMA_SOUND_MAX_PERIODS	8
+
 class CDMASoundBuffers	/// Concatenated DMA buffers to be used by sound device drivers
 {
 public:
@@ -54,11 +56,15 @@ public:
 	/// \param DREQ DREQ number to be used to pace the transfer
 	/// \param nChunkSize Size of a chunk, DMA transferred at once, in number of 32-bit words
 	/// \param pInterruptSystem Pointer to the interrupt system
+	/// \param nPeriods Number of concatenated buffers (2 .. DMA_SOUND_MAX_PERIODS)
+	/// \note The handler is called from the DMA IRQ for each completed period.\n
+	///	  Small chunks with more periods reduce the latency, while the IRQ rate grows.
 	CDMASoundBuffers (boolean	    bDirectionOut,
 			  u32		    nIOAddress,
 			  TDREQ		    DREQ,
 			  unsigned	    nChunkSize,
-			  CInterruptSystem *pInterruptSystem);
+			  CInterruptSystem *pInterruptSystem,
+			  unsigned	    nPeriods = 2);
 
 	~CDMASoundBuffers (void);
 
@@ -74,6 +80,9 @@ public:
 	/// \return Is DMA operation running?
 	boolean IsActive (void) const;
 
+	/// \return Number of concatenated buffers
+	unsigned GetPeriods (void) const	{ return m_nPeriods; }
+
 private:
 	boolean GetNextChunk (boolean bFirstCall);
 	boolean PutChunk (void);
@@ -89,6 +98,7 @@ private:
 	TDREQ m_DREQ;
 	unsigned m_nChunkSize;
 	CInterruptSystem *m_pInterruptSystem;
+	unsigned m_nPeriods;
 
 	TChunkCompletedHandler *m_pHandler;
 	void *m_pParam;
@@ -97,10 +107,10 @@ private:
 	volatile TState m_State;
 
 	unsigned m_nDMAChannel;
-	u32 *m_pDMABuffer[2];
-	TDMAControlBlock *m_pControlBlock[2];
+	u32 *m_pDMABuffer[DMA_SOUND_MAX_PERIODS];
+	TDMAControlBlock *m_pControlBlock[DMA_SOUND_MAX_PERIODS];
 
-	unsigned m_nNextBuffer;		// 0 or 1
+	unsigned m_nNextBuffer;		// 0 .. m_nPeriods-1
 
 	CSpinLock m_SpinLock;
 };
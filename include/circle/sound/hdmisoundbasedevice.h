@@ -69,6 +69,9 @@ public:
 	/// \return Is HDMI sound operation running?
 	boolean IsActive (void) const;
 
+	/// \return Number of frames buffered in the DMA buffers (0 in polling mode)
+	unsigned GetHWTXBufferFrames (void) const;
+
 public:
 	/// \return Has the data FIFO room for at least one sample to be written?
 	/// \note Can be called in polling mode only.
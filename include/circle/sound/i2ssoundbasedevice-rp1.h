@@ -55,7 +55,8 @@ public:
 			     CI2CMaster       *pI2CMaster  = 0,
 			     u8		       ucI2CAddress = 0,
 			     TDeviceMode       DeviceMode  = DeviceModeTXOnly,
-			     unsigned	       nHWChannels = 2);	// 2 or 8
+			     unsigned	       nHWChannels = 2,		// 2 or 8
+			     unsigned	       nPeriods    = 2);	// ignored
 
 	virtual ~CI2SSoundBaseDevice (void);
 
@@ -70,6 +71,11 @@ public:
 
 	CSoundController *GetController (void) override;
 
+#ifndef USE_I2S_SOUND_IRQ
+	unsigned GetHWTXBufferFrames (void) const override;
+	unsigned GetHWRXBufferFrames (void) const override;
+#endif
+
 private:
 	boolean RunI2S (void);
 	void StopI2S (void);
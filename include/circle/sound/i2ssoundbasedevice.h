@@ -55,6 +55,8 @@ public:
 	/// \param ucI2CAddress I2C slave address of the DAC (0 for auto probing 0x4C and 0x4D)
 	/// \param DeviceMode	which transfer direction to use?
 	/// \param nHWChannels	number of hardware channels (2 or 8 (Raspberry Pi 5 only))
+	/// \param nPeriods	number of DMA buffers (2 .. DMA_SOUND_MAX_PERIODS)\n
+	///			(use a small nChunkSize with more periods for low latency)
 	CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 			     unsigned	       nSampleRate = 192000,
 			     unsigned	       nChunkSize  = 8192,
@@ -62,7 +64,8 @@ public:
 			     CI2CMaster       *pI2CMaster  = 0,
 			     u8		       ucI2CAddress = 0,
 			     TDeviceMode       DeviceMode  = DeviceModeTXOnly,
-			     unsigned	       nHWChannels = 2);
+			     unsigned	       nHWChannels = 2,
+			     unsigned	       nPeriods    = 2);
 
 	virtual ~CI2SSoundBaseDevice (void);
 
@@ -84,6 +87,11 @@ public:
 	/// \return Pointer to sound controller object or nullptr, if not supported.
 	CSoundController *GetController (void) override;
 
+	/// \return Number of frames buffered in the TX DMA buffers
+	unsigned GetHWTXBufferFrames (void) const override;
+	/// \return Number of frames buffered in the RX DMA buffer
+	unsigned GetHWRXBufferFrames (void) const override;
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
@@ -51,6 +51,8 @@ public:
 
 	boolean IsActive (void) const override;
 
+	unsigned GetHWTXBufferFrames (void) const override;
+
 private:
 	boolean RunPWM (void);
 	void StopPWM (void);
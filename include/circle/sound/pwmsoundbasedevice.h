@@ -72,6 +72,9 @@ public:
 	/// \return Is PWM and DMA operation running?
 	boolean IsActive (void) const;
 
+	/// \return Number of frames buffered in the DMA buffers
+	unsigned GetHWTXBufferFrames (void) const;
+
 protected:
 	/// \brief May overload this to provide the sound samples!
 	/// \param pBuffer	buffer where the samples have to be placed
@@ -22,6 +22,7 @@
 
 #include <circle/device.h>
 #include <circle/sound/soundcontroller.h>
+#include <circle/pipelinestage.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
 #include <assert.h>
@@ -30,6 +31,8 @@
 #define SOUND_MAX_SAMPLE_SIZE	(sizeof (u32))
 #define SOUND_MAX_FRAME_SIZE	(SOUND_MAX_CHANNELS * SOUND_MAX_SAMPLE_SIZE)
 
+#define SOUND_BLOCK_SIZE	4096		// bytes, converted at once in Write()
+
 ASSERT_STATIC (SOUND_MAX_CHANNELS+1 == CSoundController::ChannelUnknown);
 
 // IEC958 (S/PDIF)
@@ -98,6 +101,10 @@ public:
 	/// \note Can be called on any core.
 	unsigned GetHWRXChannels (void) const;
 
+	/// \return Sample format used by the hardware (for direct queue access)
+	/// \note Can be called on any core.
+	TSoundFormat GetHWFormat (void) const;
+
 	/// \return Minium value of one sample
 	/// \note Can be called on any core.
 	virtual int GetRangeMin (void) const;
@@ -121,6 +128,21 @@ public:
 	/// \return Pointer to sound controller object or nullptr, if not supported.
 	virtual CSoundController *GetController (void)		{ return nullptr; }
 
+	/// \return Number of frames buffered by the driver after GetChunk() (e.g. DMA buffers)
+	/// \note Can be called on any core.
+	virtual unsigned GetHWTXBufferFrames (void) const	{ return 0; }
+	/// \return Number of frames buffered by the driver before PutChunk() (e.g. DMA buffer)
+	/// \note Can be called on any core.
+	virtual unsigned GetHWRXBufferFrames (void) const	{ return 0; }
+
+	/// \return Current output latency in number of frames (queue and hardware buffers)
+	/// \note Divide by the sample rate to get the latency in seconds.
+	/// \note Can be called on any core.
+	unsigned GetTXLatencyFrames (void);
+	/// \return Current input latency in number of frames (hardware buffer and read queue)
+	/// \note Can be called on any core.
+	unsigned GetRXLatencyFrames (void);
+
 	// Output /////////////////////////////////////////////////////////////
 
 	/// \brief Allocate the queue used for Write()
@@ -145,6 +167,11 @@ public:
 	/// \note Can be called on any core.
 	int Write (const void *pBuffer, size_t nCount);
 
+	/// \brief Records the time, which written samples wait in the queue, as pipeline stage
+	/// \param pStage Pipeline stage (0 to disable)
+	/// \note The time is calculated from the number of queued frames on Write().
+	void SetPipelineStage (CPipelineStage *pStage)	{ m_pPipelineStage = pStage; }
+
 	/// \return Queue size in number of frames
 	/// \note Not used, if GetChunk() is overloaded.
 	/// \note Can be called on any core.
@@ -155,6 +182,17 @@ public:
 	/// \note Can be called on any core.
 	unsigned GetQueueFramesAvail (void);
 
+	/// \brief Get direct access to the free space in the queue (lock-free)
+	/// \param ppBuffer Pointer to the contiguous free space is returned here
+	/// \return Number of frames, which can be written there (0 if the queue is full)
+	/// \note The frames must be written in hardware format (see GetHWFormat()) with\n
+	///	  GetHWTXChannels() channels, call CommitWriteRegion() afterwards.
+	/// \note Must not be used concurrently with Write() (single producer only).
+	/// \note Not used, if GetChunk() is overloaded.
+	unsigned AcquireWriteRegion (void **ppBuffer);
+	/// \param nFrames Number of frames, which have been written into the region
+	void CommitWriteRegion (unsigned nFrames);
+
 	/// \param pCallback Callback which is called, when more sound data is needed
 	/// \param pParam User parameter to be handed over to the callback
 	/// \note Is called, when at least half of the queue is empty
@@ -190,6 +228,14 @@ public:
 	/// \note Can be called on any core.
 	int Read (void *pBuffer, size_t nCount);
 
+	/// \brief Read the samples de-interleaved into one buffer per channel (planar format)
+	/// \param ppBuffers Array of nChannels (see SetReadFormat()) buffer pointers
+	/// \param nFrames Size of each buffer in number of samples
+	/// \return Number of frames returned (samples per buffer)
+	/// \note Not used, if PutChunk() is overloaded.
+	/// \note Can be called on any core.
+	unsigned ReadPlanar (void *ppBuffers[], unsigned nFrames);
+
 	/// \return Read queue size in number of frames
 	/// \note Not used, if PutChunk() is overloaded.
 	/// \note Can be called on any core.
@@ -200,6 +246,22 @@ public:
 	/// \note Can be called on any core.
 	unsigned GetReadQueueFramesAvail (void);
 
+	/// \return Number of received frames, which were dropped, because the read queue was full
+	/// \note Not used, if PutChunk() is overloaded.
+	/// \note Can be called on any core.
+	unsigned GetReadOverrunFrames (void) const;
+
+	/// \brief Get direct access to the received data in the read queue (lock-free)
+	/// \param ppBuffer Pointer to the contiguous received data is returned here
+	/// \return Number of frames available there (0 if the queue is empty)
+	/// \note The frames are in hardware format (see GetHWFormat()) with\n
+	///	  GetHWRXChannels() channels, call ReleaseReadRegion() afterwards.
+	/// \note Must not be used concurrently with Read() (single consumer only).
+	/// \note Not used, if PutChunk() is overloaded.
+	unsigned AcquireReadRegion (const void **ppBuffer);
+	/// \param nFrames Number of frames, which have been consumed from the region
+	void ReleaseReadRegion (unsigned nFrames);
+
 	/// \param pCallback Callback which is called, when data is available for Read()
 	/// \param pParam User parameter to be handed over to the callback
 	/// \note Is called, when at least half of the queue is full
@@ -232,7 +294,10 @@ protected:
 private:
 	// Output /////////////////////////////////////////////////////////////
 
-	void ConvertSoundFormat (void *pTo, const void *pFrom);
+	// nSamples samples are converted from write to hardware format,
+	// the strides are the distances of two samples in bytes
+	void ConvertSoundBlock (void *pTo, unsigned nToStride,
+				const void *pFrom, unsigned nFromStride, unsigned nSamples);
 
 	unsigned GetChunkInternal (void *pBuffer, unsigned nChunkSize);
 
@@ -245,6 +310,11 @@ private:
 
 	void ConvertReadSoundFormat (void *pTo, const void *pFrom);
 
+	// nSamples samples are converted from hardware to read format,
+	// the strides are the distances of two samples in bytes
+	void ConvertReadSoundBlock (void *pTo, unsigned nToStride,
+				    const void *pFrom, unsigned nFromStride, unsigned nSamples);
+
 	void PutChunkInternal (const void *pBuffer, unsigned nChunkSize);
 
 	unsigned GetReadQueueBytesFree (void);
@@ -275,12 +345,14 @@ private:
 	unsigned m_nWriteFrameSize;
 
 	u8 *m_pQueue;			// Ring buffer
-	unsigned m_nInPtr;
-	unsigned m_nOutPtr;
+	volatile unsigned m_nInPtr;
+	volatile unsigned m_nOutPtr;
 
 	TSoundDataCallback *m_pCallback;
 	void *m_pCallbackParam;
 
+	CPipelineStage *m_pPipelineStage;
+
 	CSpinLock m_SpinLock;
 
 	u8 m_uchIEC958Status[IEC958_STATUS_BYTES];
@@ -297,12 +369,14 @@ private:
 	unsigned m_nReadFrameSize;
 
 	u8 *m_pReadQueue;		// Ring buffer
-	unsigned m_nReadInPtr;
-	unsigned m_nReadOutPtr;
+	volatile unsigned m_nReadInPtr;
+	volatile unsigned m_nReadOutPtr;
 
 	TSoundDataCallback *m_pReadCallback;
 	void *m_pReadCallbackParam;
 
+	volatile unsigned m_nReadOverrunFrames;
+
 	CSpinLock m_ReadSpinLock;
 };
 
@@ -0,0 +1,159 @@
+//
+// soundmixer.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_sound_soundmixer_h
+#define _circle_sound_soundmixer_h
+
+#include <circle/sound/soundbasedevice.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define SOUND_MIXER_MAX_STREAMS		8
+#define SOUND_MIXER_BLOCK_FRAMES	128		// frames rendered at once
+
+#define SOUND_MIXER_UNITY_GAIN		0x1000		// gain factor 1.0
+#define SOUND_MIXER_MAX_GAIN		(4*SOUND_MIXER_UNITY_GAIN)
+
+#define SOUND_MIXER_TAPS		16		// FIR length of the resampler
+#define SOUND_MIXER_PHASES		32		// filter phases (interpolated)
+
+#define SOUND_MIXER_MAX_DRIFT_PPM	1000		// max. correction of the stream rate
+
+/// \note The mixer renders 16-bit stereo blocks to the Write() queue of any sound device.
+/// \note Each stream has its own sample rate and is resampled to the output sample rate\n
+///	  by a polyphase FIR filter, if required. The filter is designed for upsampling\n
+///	  and moderate downsampling ratios (cut-off at 0.9 of the input Nyquist frequency).
+/// \note Process() may run on a dedicated core, while the streams are written from\n
+///	  other cores (one writer per stream). All calculations are done in fixed point.
+/// \note To play the same stream on multiple devices with different clocks, use one mixer\n
+///	  per device, write the stream to each of them and enable the drift compensation.\n
+///	  The latency is bounded then by the target fill level of the stream queues.
+
+class CSoundMixer	/// Mixes multiple sound streams with independent sample rates
+{
+public:
+	/// \param pOutput Sound device to be used for output (queue must be allocated)
+	/// \param nSampleRate Sample rate of the sound device in Hz
+	CSoundMixer (CSoundBaseDevice *pOutput, unsigned nSampleRate);
+
+	~CSoundMixer (void);
+
+	/// \brief Set write format of the output device and start it
+	/// \return Operation successful?
+	boolean Start (void);
+
+	/// \param nSampleRate Sample rate of the stream in Hz
+	/// \param nQueueFrames Size of the stream queue in frames (rounded up to power of 2)
+	/// \return Stream number (>= 0), or < 0 on failure
+	int AddStream (unsigned nSampleRate, unsigned nQueueFrames);
+
+	/// \param nStream Stream number returned by AddStream()
+	/// \note The remaining queued frames of the stream are discarded.
+	void RemoveStream (unsigned nStream);
+
+	/// \param nStream Stream number returned by AddStream()
+	/// \param nGain Gain factor (SOUND_MIXER_UNITY_GAIN is 1.0, up to SOUND_MIXER_MAX_GAIN)
+	void SetGain (unsigned nStream, unsigned nGain);
+
+	/// \brief Adapt the resampling ratio to the clock of the stream source
+	/// \param nStream Stream number returned by AddStream()
+	/// \param nTargetFrames Fill level of the stream queue to be held (0 for half size)
+	/// \note Up to +/- SOUND_MIXER_MAX_DRIFT_PPM of clock drift can be compensated.
+	void EnableDriftCompensation (unsigned nStream, unsigned nTargetFrames = 0);
+
+	/// \param nStream Stream number returned by AddStream()
+	/// \return Current correction of the stream rate in ppm (> 0: consumed faster)
+	int GetStreamDriftPPM (unsigned nStream);
+
+	/// \param nStream Stream number returned by AddStream()
+	/// \param pBuffer Interleaved 16-bit signed stereo frames (left channel first)
+	/// \param nFrames Number of frames in the buffer
+	/// \return Number of frames consumed
+	/// \note Lock-free, but only one writer per stream is allowed.
+	unsigned WriteStream (unsigned nStream, const s16 *pBuffer, unsigned nFrames);
+
+	/// \param nStream Stream number returned by AddStream()
+	/// \return Number of frames, which can be written to the stream queue
+	unsigned GetStreamFramesFree (unsigned nStream);
+
+	/// \brief Render blocks, as long as the output queue has room for them
+	/// \return Has at least one block been rendered?
+	/// \note Must be called repeatedly, e.g. in the loop of a dedicated core.
+	boolean Process (void);
+
+	/// \return CPU load of the rendering in percent of the real-time duration (smoothed)
+	unsigned GetCPULoad (void) const;
+
+	/// \return Deviation of the output device clock from the nominal sample rate in ppm,\n
+	///	    measured against the system timer (0 during the first second)
+	int GetOutputDriftPPM (void) const;
+
+private:
+	struct TStream
+	{
+		unsigned nGain;
+
+		s16 *pQueue;			// stereo frames
+		unsigned nQueueMask;		// size in frames - 1
+		volatile unsigned nIn;		// frame counters (not masked)
+		volatile unsigned nOut;
+
+		boolean bResample;
+		u64 ullStep;			// input frames per output frame (Q32.32)
+		u32 nFraction;			// position between two input frames
+
+		boolean bAdaptive;		// drift compensation enabled
+		u64 ullNominalStep;
+		unsigned nTargetFrames;
+		s32 nFillError;			// averaged fill level error (frames * 256)
+		s32 nIntegral;			// integral part of the correction (ppm * 65536)
+		volatile int nDriftPPM;
+	};
+
+	void RenderBlock (void);
+
+	static void UpdateDrift (TStream *pStream);
+
+	void MeasureOutput (void);
+
+	static void MixStream (TStream *pStream, s32 *pMix, unsigned nFrames);
+	static void MixResampled (TStream *pStream, s32 *pMix, unsigned nFrames);
+
+private:
+	CSoundBaseDevice *m_pOutput;
+	unsigned m_nSampleRate;
+
+	TStream *m_pStream[SOUND_MIXER_MAX_STREAMS];
+
+	s32 m_MixBuffer[SOUND_MIXER_BLOCK_FRAMES * 2];
+	s16 m_OutputBuffer[SOUND_MIXER_BLOCK_FRAMES * 2];
+
+	unsigned m_nBlockTicks;			// real-time duration of one block in clock ticks
+	volatile unsigned m_nCPULoad;		// percent * 256
+
+	boolean m_bMeasuring;
+	u64 m_ullMeasureStartTicks;
+	u64 m_ullFramesWritten;
+	u64 m_ullFramesConsumedAtStart;
+	volatile int m_nOutputDriftPPM;
+
+	CSpinLock m_SpinLock;
+};
+
+#endif
@@ -0,0 +1,165 @@
+//
+// spidmaqueue.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_spidmaqueue_h
+#define _circle_spidmaqueue_h
+
+#include <circle/dmachannel.h>
+#include <circle/gpioclock.h>
+#include <circle/gpiopin.h>
+#include <circle/interrupt.h>
+#include <circle/types.h>
+
+/// \brief Completion routine, called from IRQ, when all queued transfers have been done
+typedef void TSPIQueueCompletionRoutine (boolean bStatus, void *pParam);
+
+/// \class CSPIDMAQueue
+/// \brief Queue of full-duplex transfers on SPI0, executed as one DMA control block chain
+///
+/// \details Each transfer in the queue has its own chip select, clock and mode. Start()\n
+/// compiles the queue into a chain on the RX DMA channel, which programs the SPI0\n
+/// registers, kicks the TX DMA channel and receives the data for every transfer in turn.\n
+/// The next transfer is set up only after the previous one has been received completely.\n
+/// StartStreaming() repeats the queue continuously, optionally with a pause, which is paced\n
+/// by the DREQ of the PWM device (e.g. for ADC sampling without CPU involvement).
+///
+/// \note Buffers must be 4-byte aligned and should be cache-line aligned.
+/// \note Cannot be used at the same time with the other SPI0 drivers (CSPIMaster*).
+/// \note The PWM device cannot be used otherwise, while streaming with a pause.
+/// \note Not supported on the Raspberry Pi 5.
+
+class CSPIDMAQueue
+{
+public:
+	static const unsigned ChipSelectNone = 3;
+
+public:
+	/// \param nMaxTransfers Maximum number of transfers in the queue
+	/// \param pInterruptSystem Pointer to the interrupt system object\n
+	///	   (or 0, if SetCompletionRoutine() is not used)
+	CSPIDMAQueue (unsigned nMaxTransfers, CInterruptSystem *pInterruptSystem = 0);
+
+	~CSPIDMAQueue (void);
+
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Appends a transfer to the queue
+	/// \param nChipSelect 0, 1 or ChipSelectNone
+	/// \param nClockSpeed SPI clock frequency in Hz
+	/// \param CPOL Clock polarity (0 or 1)
+	/// \param CPHA Clock phase (0 or 1)
+	/// \param pWriteBuffer Data to be sent (0 to send zero bytes)
+	/// \param pReadBuffer Buffer for the received data (0 to discard it)
+	/// \param nCount Number of bytes to be transferred (1..65535)
+	/// \return Operation successful? (FALSE, if the queue is full)
+	/// \note Must not be called, while the queue is running.
+	boolean AddTransfer (unsigned nChipSelect, unsigned nClockSpeed,
+			     unsigned CPOL, unsigned CPHA,
+			     const void *pWriteBuffer, void *pReadBuffer, unsigned nCount);
+
+	/// \brief Discards all transfers from the queue
+	/// \note Must not be called, while the queue is running.
+	void Clear (void);
+
+	/// \brief Set completion routine to be called, when Start() has completed
+	/// \param pRoutine Pointer to the completion routine
+	/// \param pParam   User parameter
+	void SetCompletionRoutine (TSPIQueueCompletionRoutine *pRoutine, void *pParam = 0);
+
+	/// \brief Executes the queued transfers once back-to-back
+	/// \return Operation successful?
+	boolean Start (void);
+
+	/// \brief Executes the queued transfers continuously, until Stop() is called
+	/// \param nPauseUS Pause after each run of the queue in microseconds (0 for none)
+	/// \return Operation successful?
+	/// \note The period is the duration of the transfers plus the pause.
+	/// \note The completion routine is not called in this mode.
+	boolean StartStreaming (unsigned nPauseUS = 0);
+
+	/// \brief Aborts the running queue, a transfer may be cut off
+	void Stop (void);
+
+	/// \return Is the queue running?
+	boolean IsRunning (void) const;
+
+	/// \brief Invalidates the read buffers, call before reading data while streaming
+	void SyncReadBuffers (void);
+
+private:
+	void Compile (boolean bStreaming, unsigned nPauseUS);
+
+	void RunPWM (void);
+	void StopPWM (void);
+
+	void ResetDMA (unsigned nChannel);
+	void StartDMA (void);
+
+	void InterruptHandler (void);
+	static void InterruptStub (void *pParam);
+
+private:
+	unsigned m_nMaxTransfers;
+	unsigned m_nTransfers;
+
+	CInterruptSystem *m_pInterruptSystem;
+	boolean m_bIRQConnected;
+
+	TSPIQueueCompletionRoutine *m_pCompletionRoutine;
+	void *m_pCompletionParam;
+
+	CGPIOPin m_SCLK;
+	CGPIOPin m_MOSI;
+	CGPIOPin m_MISO;
+	CGPIOPin m_CE0;
+	CGPIOPin m_CE1;
+
+	unsigned m_nCoreClockRate;
+
+	CGPIOClock m_Clock;
+	boolean m_bPWMRunning;
+
+	unsigned m_nRxDMAChannel;		// runs the chain
+	unsigned m_nTxDMAChannel;		// kicked by the chain for each transfer
+
+	struct TTransfer
+	{
+		// DMA sources of the register writes, the order must not be changed
+		u32	nCSIdle;		// deasserts chip select and clears the FIFOs
+		u32	nCLK;			// must be followed by nDLEN
+		u32	nDLEN;
+		u32	nCSActive;		// starts the transfer
+		u32	nTxControlBlock;	// bus address of the TX control block
+		u32	nTxCS;			// activates the TX DMA channel
+		u32	nReserved[2];
+
+		const void *pWriteBuffer;
+		void *pReadBuffer;
+		unsigned nCount;
+	};
+
+	TTransfer *m_pTransfers;
+
+	u8 *m_pControlBlockBuffer;
+	TDMAControlBlock *m_pControlBlock;	// RX chain, TX blocks and pause
+	u32 *m_pDMAWords;			// zero source, discard destination
+};
+
+#endif
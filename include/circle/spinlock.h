@@ -2,7 +2,7 @@
 // spinlock.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -41,12 +41,21 @@ public:
 
 	static void Enable (void);
 
+#ifdef USE_SCHEDULER_PREEMPTION
+	// returns TRUE, if a TASK_LEVEL spin lock is held on this core (no task preemption then)
+	static boolean IsTaskLevelLockHeld (void);
+#endif
+
 private:
 	unsigned m_nTargetLevel;
 
 	u32 m_nLocked;
 
 	static boolean s_bEnabled;
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	static volatile unsigned s_nTaskLevelLocks[CORES];
+#endif
 };
 
 #else
@@ -65,6 +74,13 @@ public:
 		{
 			EnterCritical (m_nTargetLevel);
 		}
+#ifdef USE_SCHEDULER_PREEMPTION
+		else
+		{
+			s_nTaskLevelLocks++;
+			asm volatile ("" ::: "memory");
+		}
+#endif
 	}
 
 	void Release (void)
@@ -73,10 +89,29 @@ public:
 		{
 			LeaveCritical ();
 		}
+#ifdef USE_SCHEDULER_PREEMPTION
+		else
+		{
+			asm volatile ("" ::: "memory");
+			s_nTaskLevelLocks--;
+		}
+#endif
+	}
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	// returns TRUE, if a TASK_LEVEL spin lock is held (no task preemption then)
+	static boolean IsTaskLevelLockHeld (void)
+	{
+		return s_nTaskLevelLocks != 0;
 	}
+#endif
 
 private:
 	unsigned m_nTargetLevel;
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	static volatile unsigned s_nTaskLevelLocks;
+#endif
 };
 
 #endif
@@ -52,19 +52,13 @@ public:
 
 	int Replace (const char *pOld, const char *pNew); // returns number of occurrences
 
-	void Format (const char *pFormat, ...);		// supports only a small subset of printf(3)
+	void Format (const char *pFormat, ...);		// see CFormatter for the supported subset
 	void FormatV (const char *pFormat, va_list Args);
 
 private:
 	void PutChar (char chChar, size_t nCount = 1);
 	void PutString (const char *pString);
 	void ReserveSpace (size_t nSpace);
-	
-	static char *ntoa (char *pDest, unsigned long ulNumber, unsigned nBase, boolean bUpcase);
-#if STDLIB_SUPPORT >= 1
-	static char *lltoa (char *pDest, unsigned long long ullNumber, unsigned nBase, boolean bUpcase);
-#endif
-	static char *ftoa (char *pDest, double fNumber, unsigned nPrecision);
 
 private:
 	char 	 *m_pBuffer;
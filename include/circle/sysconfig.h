@@ -4,7 +4,7 @@
 // Configurable system options
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -75,8 +75,8 @@
 // (buckets). Each free list contains blocks of a specific size. On
 // block allocation the requested block size is rounded up to the
 // size of next available bucket size. If the requested size is greater
-// than the largest available bucket size, the block can be allocated,
-// but the memory space is lost, if the block will be freed later.
+// than the largest available bucket size, the block is managed by a
+// second allocator, which splits and merges these large blocks.
 // Because the block buckets have to be walked through on each allocate
 // and free operation, it is preferable to have only a few buckets.
 // With this option you can configure the bucket sizes, so that they
@@ -88,6 +88,31 @@
 #define HEAP_BLOCK_BUCKET_SIZES	0x40,0x400,0x1000,0x4000,0x10000,0x40000,0x80000
 #endif
 
+// HEAP_CORE_CACHE_MAX_SIZE is the largest bucket size, for which free
+// heap blocks are held in a cache per CPU core, if ARM_ALLOW_MULTI_CORE
+// is defined. Blocks are moved between these caches and the bucket
+// free lists in batches of HEAP_CORE_CACHE_BATCH blocks, so that most
+// allocations of small blocks do not need to acquire the spin lock of
+// the heap, which is shared by all cores. The caches can be disabled
+// with NO_HEAP_CORE_CACHE.
+
+#ifndef HEAP_CORE_CACHE_MAX_SIZE
+#define HEAP_CORE_CACHE_MAX_SIZE	0x1000
+#endif
+
+#ifndef HEAP_CORE_CACHE_BATCH
+#define HEAP_CORE_CACHE_BATCH		16
+#endif
+
+// HEAP_SAMPLE_COUNT is the number of allocation samples (caller address
+// and size), which are kept per heap, if sampling has been enabled with
+// CMemorySystem::SetHeapSampleInterval(). Every n-th allocation is
+// recorded then. The oldest sample is overwritten, if the buffer is full.
+
+#ifndef HEAP_SAMPLE_COUNT
+#define HEAP_SAMPLE_COUNT		64
+#endif
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Raspberry Pi 1, Zero (W) and Zero 2 W
@@ -228,13 +253,15 @@
 
 // USE_USB_FIQ makes the USB timing more accurate, by using the FIQ to
 // handle time-critical interrupts from the USB controller, which are
-// triggered 8000 times per second. When using the default IRQ instead,
-// USB interrupts may be delayed or entire micro-frames may be skipped,
-// when other IRQs are currently handled, which could result in
-// communication problems with some USB devices. If this option is
-// enabled, USE_USB_SOF_INTR will be enabled too, and the FIQ cannot be
-// used for other purposes. This option has no influence on the
-// Raspberry Pi 4 and 5.
+// triggered up to 8000 times per second. When using the default IRQ
+// instead, USB interrupts may be delayed or entire micro-frames may be
+// skipped, when other IRQs are currently handled, which could result in
+// communication problems with some USB devices. The FIQ handles all
+// transaction states (incl. NAK retries and split transactions), an IRQ
+// is triggered only to call the completion routines of finished requests.
+// If this option is enabled, USE_USB_SOF_INTR will be enabled too, and the
+// FIQ cannot be used for other purposes. This option has no influence on
+// the Raspberry Pi 4 and 5.
 
 //#define USE_USB_FIQ
 
@@ -264,24 +291,112 @@
 #define CALIBRATE_DELAY
 #endif
 
+// USE_TICKLESS_TIMER disables the periodic timer interrupt, which
+// normally occurs HZ (100) times per second. Instead the timer is
+// programmed one-shot for the deadline of the next kernel timer, which
+// can be started with microsecond resolution then (see
+// CTimer::StartKernelTimerUs()). GetTicks() and the system time are
+// derived from the free running counter in this mode. Without pending
+// kernel timers the timer interrupt occurs only every
+// TICKLESS_MAX_IDLE_US microseconds. Kernel timers, which are started
+// from a secondary CPU core, may be delayed by up to this time. If
+// periodic timer handlers are registered, the timer interrupt occurs
+// on each tick again.
+
+//#define USE_TICKLESS_TIMER
+
+#ifndef TICKLESS_MAX_IDLE_US
+#define TICKLESS_MAX_IDLE_US	100000
+#endif
+
+// TRACER_SYSTEM_EVENTS enables built-in trace points for CTracer in the
+// scheduler (task switch), in CInterruptSystem (IRQ entry and exit), in
+// the network device layer (frame send and receive) and in the USB host
+// controller drivers (async request submit and completion). The events
+// are recorded only, while a CTracer object exists and has been started.
+// The trace can be exported in the Chrome trace event format (see
+// CTracer::ExportChromeTrace()).
+
+//#define TRACER_SYSTEM_EVENTS
+
+// LATENCY_MONITOR enables the measurement hooks for CLatencyMonitor in
+// CTimer (IRQ entry latency of the system timer interrupt) and in the
+// scheduler (task wakeup latency and dispatch delay after a timeout).
+// The overhead is a few instructions per event, while no instance of
+// CLatencyMonitor exists, and a histogram update otherwise.
+
+//#define LATENCY_MONITOR
+
 ///////////////////////////////////////////////////////////////////////
 //
 // Scheduler
 //
 ///////////////////////////////////////////////////////////////////////
 
-// MAX_TASKS is the maximum number of tasks in the system.
+// MAX_TASKS is the initial size of the task table of the scheduler. If
+// more tasks are created, the table grows on demand by this number of
+// entries.
 
 #ifndef MAX_TASKS
 #define MAX_TASKS		20
 #endif
 
-// TASK_STACK_SIZE is the stack size for each task.
+// TASK_STACK_SIZE is the default stack size for each task.
 
 #ifndef TASK_STACK_SIZE
 #define TASK_STACK_SIZE		0x8000
 #endif
 
+// TASK_STACK_POOL_SIZES configures the pool of task stacks. The stack
+// of a new task is taken from a free list of stacks of the next
+// matching size class, and is put back to this list, when the task has
+// been terminated. This way creating and terminating tasks repeatedly
+// does not allocate from the heap again and again. You have to define a
+// comma separated list of increasing stack sizes (up to 8 classes),
+// which must be a multiple of 16. Larger stacks are allocated from the
+// heap directly. The pool can be disabled with NO_TASK_STACK_POOL.
+
+#ifndef NO_TASK_STACK_POOL
+#ifndef TASK_STACK_POOL_SIZES
+#define TASK_STACK_POOL_SIZES	0x4000,0x8000,0x10000
+#endif
+#endif
+
+// USE_SCHEDULER_READY_QUEUE enables an alternative implementation of
+// the scheduler, which manages ready tasks in a list and sleeping tasks
+// (and tasks waiting for an event with timeout) in a queue, sorted by
+// their wake-up time. With this option the cost for selecting the next
+// task to run does not depend on the number of tasks in the system.
+// This is useful with a larger number of tasks. Otherwise all tasks are
+// walked through on each task switch.
+
+//#define USE_SCHEDULER_READY_QUEUE
+
+// USE_SCHEDULER_PREEMPTION enables time slices for tasks, which have
+// been marked preemptible with CTask::SetTimeSlice(). Such a task is
+// switched out on return from an IRQ, when its time slice has elapsed
+// and another task of the same or a higher priority is ready, or
+// immediately, when a task of a higher priority gets ready. All other
+// tasks are scheduled cooperatively as before. This option requires
+// AARCH = 64 and implies USE_SCHEDULER_READY_QUEUE and
+// SAVE_VFP_REGS_ON_IRQ.
+
+//#define USE_SCHEDULER_PREEMPTION
+
+#ifndef TASK_TIME_SLICE_DEFAULT_US
+#define TASK_TIME_SLICE_DEFAULT_US	10000
+#endif
+
+// NO_SCHEDULER_IDLE_WAIT disables the idle wait of the scheduler. When
+// no task is ready to run, the CPU core normally waits with WFE until
+// it is woken by a task getting ready, by an interrupt or by the next
+// timer tick, if no sleeping task has to be woken up before. With this
+// option the scheduler polls for the next ready task instead, which may
+// reduce the wake-up latency of sleeping tasks with short timeouts.
+// The Raspberry Pi 1 always polls, because it does not support WFE.
+
+//#define NO_SCHEDULER_IDLE_WAIT
+
 // NO_BUSY_WAIT deactivates busy waiting in the EMMC, SDHOST and USB
 // drivers, while waiting for the completion of a synchronous transfer.
 // This requires the scheduler in the system and transfers must not be
@@ -382,6 +497,17 @@
 
 //#define USE_LOG_COLORS
 
+// LOG_MAX_LEVEL is the maximum severity level (1: LogError, 2: LogWarning,
+// 3: LogNotice, 4: LogDebug) of log messages, which are compiled in, when
+// using the LOG*() macros (e.g. LOGDBG()). Calls with a higher level are
+// removed at compile time, without evaluating their arguments. This is in
+// addition to the log level given to CLogger at runtime. LOGPANIC() is
+// never removed.
+
+#ifndef LOG_MAX_LEVEL
+#define LOG_MAX_LEVEL		4
+#endif
+
 // SERIAL_GPIO_SELECT selects the TXD GPIO pin used for the serial
 // device (UART0). The RXD pin is (SERIAL_GPIO_SELECT+1). Modifying
 // this setting can be useful for Compute Modules. Select only one
@@ -424,6 +550,81 @@
 #define SD_HIGH_SPEED
 #endif
 
+// NET_QUEUE_HIGH_WATER_MARK is the maximum number of frames or packets,
+// which can wait in a receive queue of the network subsystem. Further
+// received frames are dropped (and counted) until the queue has been
+// drained, instead of allocating more memory under a packet flood.
+
+#ifndef NET_QUEUE_HIGH_WATER_MARK
+#define NET_QUEUE_HIGH_WATER_MARK	256
+#endif
+
+// NET_MEMORY_BUDGET is the number of bytes, which can be used by the
+// TCP receive queues and retransmission buffers and the UDP receive
+// queues of all sockets together. Above 3/4 of the budget the buffers
+// of each socket are limited to NET_MEMORY_PRESSURE_LIMIT bytes, at the
+// budget no new data and connections are accepted (see CNetMemory).
+
+#ifndef NET_MEMORY_BUDGET
+#define NET_MEMORY_BUDGET		0x1000000
+#endif
+
+#ifndef NET_MEMORY_PRESSURE_LIMIT
+#define NET_MEMORY_PRESSURE_LIMIT	0x4000
+#endif
+
+// ARP_CACHE_SIZE is the maximum number of neighbors (IP to MAC address
+// mappings), which are kept in the ARP cache. If the cache is full, the
+// least recently used entry is replaced. Each entry takes about 40 bytes.
+
+#ifndef ARP_CACHE_SIZE
+#define ARP_CACHE_SIZE			256
+#endif
+
+// TCP_CONGESTION_CONTROL selects the congestion control algorithm,
+// which is used for new TCP connections (0: NewReno, 1: CUBIC). Fast
+// retransmit and fast recovery on duplicate ACKs is done with both.
+
+#ifndef TCP_CONGESTION_CONTROL
+#define TCP_CONGESTION_CONTROL		1
+#endif
+
+// TCP_PACING spreads the transmitted TCP segments over the round-trip
+// time, instead of sending the whole congestion window at once. This
+// reduces losses on links with small queues, for example with WLAN.
+// You can disable this option by defining NO_TCP_PACING.
+
+#ifndef NO_TCP_PACING
+#define TCP_PACING
+#endif
+
+// NET_CHECKSUM_OFFLOAD lets the Ethernet controller verify and generate
+// the TCP/UDP checksums, if it supports it (MACB/GEM on Raspberry Pi 5).
+// Otherwise the checksums are calculated in software.
+// You can disable this option by defining NO_NET_CHECKSUM_OFFLOAD.
+
+#ifndef NO_NET_CHECKSUM_OFFLOAD
+#define NET_CHECKSUM_OFFLOAD
+#endif
+
+// NET_SEGMENTATION_OFFLOAD lets TCP hand down a burst of up to 64 KByte
+// at once, which is split into segments in the IP layer (GSO), and
+// merges consecutive in-order TCP segments of the same connection,
+// before they are delivered to TCP (GRO). This reduces the per-segment
+// overhead of bulk transfers.
+// You can disable this option by defining NO_NET_SEGMENTATION_OFFLOAD.
+
+#ifndef NO_NET_SEGMENTATION_OFFLOAD
+#define NET_SEGMENTATION_OFFLOAD
+#endif
+
+// NET_IPV6 enables a minimal IPv6 host layer beside IPv4, which configures
+// a link-local address and a global address from router advertisements
+// (SLAAC), resolves neighbors (NDP) and answers ICMPv6 echo requests.
+// TCP and UDP sockets are still IPv4 only.
+
+//#define NET_IPV6
+
 // SAVE_VFP_REGS_ON_IRQ enables saving the floating point registers
 // on entry when an IRQ occurs and will restore these registers on exit
 // from the IRQ handler. This has to be defined, if an IRQ handler
@@ -485,6 +686,25 @@
 #endif
 
 
+// The context of a preempted task remains in the IRQ stack frame on its
+// own task stack, which must include all floating point registers then.
+
+#ifdef USE_SCHEDULER_PREEMPTION
+
+#if AARCH == 32
+#error USE_SCHEDULER_PREEMPTION is not supported with AARCH = 32
+#endif
+
+#ifndef USE_SCHEDULER_READY_QUEUE
+#define USE_SCHEDULER_READY_QUEUE
+#endif
+
+#ifndef SAVE_VFP_REGS_ON_IRQ
+#define SAVE_VFP_REGS_ON_IRQ
+#endif
+
+#endif
+
 // Sets the name of the "main()" entry point function that will be
 // called by circle after system initialization has completed.
 //
@@ -29,6 +29,8 @@
 
 #define TERMINAL_COLOR(red, green, blue)	DISPLAY_COLOR (read, green, blue)
 
+#define TERMINAL_GLYPH_CACHE_SETS	4	// color combinations with pre-rendered glyphs
+
 typedef CDisplay::TColor TTerminalColor;
 
 class CTerminalDevice : public CDevice	/// Terminal support for dot-matrix displays
@@ -180,6 +182,14 @@ private:
 	void EraseChar (unsigned nPosX, unsigned nPosY);
 	void InvertCursor (void);
 
+	// returns nullptr, if the glyph cache is not available
+	const u8 *GetGlyph (char chChar, CDisplay::TRawColor nColor,
+			    CDisplay::TRawColor nBackgroundColor);
+	void BlitGlyph (const u8 *pGlyph, unsigned nPosX, unsigned nPosY);
+
+	// fills consecutive pixels with word-wide stores (nPixels % 8 == 0 with depth 1)
+	void FillPixels (u8 *pBuffer, unsigned nPixels, CDisplay::TRawColor nColor);
+
 private:
 	// We always update entire pixel lines.
 	void SetUpdateArea (unsigned nPosY1, unsigned nPosY2)
@@ -209,12 +219,23 @@ private:
 		StateAutoPage
 	};
 
+	struct TGlyphCache
+	{
+		CDisplay::TRawColor Color;
+		CDisplay::TRawColor BackgroundColor;
+		unsigned	    nLastUse;
+		u8		   *pGlyphs;		// in format of the display buffer
+		u32		    Valid[256 / 32];	// one bit per character
+	};
+
 private:
 	CDisplay	    *m_pDisplay;
 	unsigned	     m_nDeviceIndex;
 	CCharGenerator	     m_CharGen;
 	CDisplay::TRawColor *m_pCursorPixels;
-	union
+	u8		    *m_pBufferBase;		// has spare lines for scrolling
+	unsigned	     m_nBufferSize;
+	union						// currently displayed window
 	{
 		u8	    *m_pBuffer8;
 		u16	    *m_pBuffer16;
@@ -245,6 +266,8 @@ private:
 	boolean		     m_bAutoPage;
 	boolean		     m_bDelayedUpdate;
 	unsigned	     m_nLastUpdateTicks;
+	TGlyphCache	     m_GlyphCache[TERMINAL_GLYPH_CACHE_SETS];
+	unsigned	     m_nGlyphCacheUse;
 	CSpinLock	     m_SpinLock;
 };
 
@@ -2,7 +2,7 @@
 /// \file timer.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -23,6 +23,7 @@
 #include <circle/interrupt.h>
 #include <circle/string.h>
 #include <circle/ptrlist.h>
+#include <circle/timerwheel.h>
 #include <circle/sysconfig.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
@@ -31,10 +32,6 @@
 
 #define MSEC2HZ(msec)	((msec) * HZ / 1000)
 
-typedef uintptr TKernelTimerHandle;
-
-typedef void TKernelTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
-
 /// \param nNewTime New time to be set in seconds since 1970-01-01 00:00:00 UTC
 /// \param nOldTime Current time in seconds since 1970-01-01 00:00:00 UTC
 /// \return TRUE if new time can be set, FALSE if new time is invalid (do not set)
@@ -42,6 +39,10 @@ typedef boolean TUpdateTimeHandler (unsigned nNewTime, unsigned nOldTime);
 
 typedef void TPeriodicTimerHandler (void);
 
+#define WALL_CLOCK_SLEW_PPM	500			///< rate of backward wall clock slew
+#define WALL_CLOCK_SLEW_MAX_US	128000			///< larger backward corrections are stepped
+#define WALL_CLOCK_MAX_PPB	500000			///< max. rate correction of the wall clock
+
 extern "C" void DelayLoop (unsigned nCount);
 
 class CTimer	/// Manages the system clock, supports kernel timers and a calibrated delay loop
@@ -103,6 +104,19 @@ public:
 	/// may be FALSE if time was not set and time zone diff is > 0
 	boolean GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds);
 
+	/// \brief Sets the reference of the wall clock (called by time synchronization clients)
+	/// \param ullClockTicks Value of GetClockTicks64() at the reference point
+	/// \param ullUniversalTimeUs Time (UTC) in microseconds since 1970-01-01 00:00:00 at this point
+	/// \param nRatePPB Rate of the wall clock relative to the system clock in ppb
+	/// \note Backward corrections up to WALL_CLOCK_SLEW_MAX_US are slewed with\n
+	///	  WALL_CLOCK_SLEW_PPM, so that the wall clock is monotonic. Larger ones are stepped.
+	/// \note SetTime() sets the wall clock too, if it differs by at least one second.
+	void AdjustWallClock (u64 ullClockTicks, u64 ullUniversalTimeUs, int nRatePPB = 0);
+	/// \return Current time (UTC) in microseconds since 1970-01-01 00:00:00\n
+	/// or 0 if the time was not set
+	/// \note Lock-free, can be called from any context and any core
+	u64 GetWallClockUs (void) const;
+
 	/// \return "[MMM dD ]HH:MM:SS.ss" or 0 if Initialize() was not called yet,\n
 	/// resulting CString object must be deleted by caller\n
 	/// Current time according to our time zone
@@ -119,6 +133,17 @@ public:
 					     TKernelTimerHandler *pHandler,
 					     void *pParam   = 0,
 					     void *pContext = 0);
+	/// \brief Starts a kernel timer which elapses after a given delay in microseconds
+	/// \param nMicroSeconds Timer elapses after this number of microseconds from now
+	/// \param pHandler	The handler to be called when the timer elapses
+	/// \param pParam	First user defined parameter to hand over to the handler
+	/// \param pContext	Second user defined parameter to hand over to the handler
+	/// \return Timer handle (cannot be 0)
+	/// \note The delay is rounded up to the next 1/HZ tick, if USE_TICKLESS_TIMER is not defined
+	TKernelTimerHandle StartKernelTimerUs (unsigned nMicroSeconds,
+					       TKernelTimerHandler *pHandler,
+					       void *pParam   = 0,
+					       void *pContext = 0);
 	/// \brief Cancel a running kernel timer,\n
 	/// The timer will not elapse any more.
 	/// \param hTimer	Timer handle
@@ -149,14 +174,30 @@ public:
 	void RegisterUpdateTimeHandler (TUpdateTimeHandler *pHandler);
 
 	/// \param pHandler Handler which is called on each timer tick (HZ times per second)
+	/// \note With USE_TICKLESS_TIMER this re-enables the timer interrupt on each tick
 	void RegisterPeriodicHandler (TPeriodicTimerHandler *pHandler);
 
 private:
+	// nDelay is given in 1/HZ ticks, or in clock ticks with USE_TICKLESS_TIMER
+	TKernelTimerHandle AddKernelTimer (u64 nDelay,
+					   TKernelTimerHandler *pHandler,
+					   void *pParam, void *pContext);
 	void PollKernelTimers (void);
+	u64 GetKernelTimerTime (void) const;	// m_KernelTimerSpinLock must be held
+
+#ifdef USE_TICKLESS_TIMER
+	void GetUptimeAndTicks (unsigned *pUptime, unsigned *pTicks) const;
+
+	void ProgramNextEvent (void);		// m_KernelTimerSpinLock must be held
+	void ProgramOneShot (unsigned nMicroSeconds);
+#endif
 
 	void InterruptHandler (void);
 	static void InterruptHandler (void *pParam);
 
+	u64 GetWallClock (u64 ullClockTicks) const;	// m_nWallSequence must be checked
+	boolean GetWallClockLocal (unsigned *pSeconds, unsigned *pMicroSeconds) const;
+
 	void TuneMsDelay (void);
 
 public:
@@ -170,15 +211,31 @@ private:
 	u32			 m_nClockTicksPerHZTick;
 #endif
 
+#ifndef USE_TICKLESS_TIMER
 	volatile unsigned	 m_nTicks;
 	volatile unsigned	 m_nUptime;
 	volatile unsigned	 m_nTime;			// local time
+#else
+	u64			 m_nBootClockTicks;
+	volatile unsigned	 m_nTime;			// local time at boot
+	unsigned		 m_nLastPeriodicTicks;
+#endif
 	CSpinLock		 m_TimeSpinLock;
 
+	// wall clock, protected by a sequence lock (odd while written)
+	volatile unsigned	 m_nWallSequence;
+	u64			 m_ullWallRefTicks;		// GetClockTicks64() at reference
+	u64			 m_ullWallRefTime;		// UTC in us at reference (0 if unset)
+	int			 m_nWallRatePPB;
+	u64			 m_ullWallSlewUs;		// backward correction to be slewed
+
 	int			 m_nMinutesDiff;		// diff to UTC
 
-	CPtrList		 m_KernelTimerList;
+	CTimerWheel		 m_KernelTimerWheel;		// in 1/HZ ticks or clock ticks
 	CSpinLock		 m_KernelTimerSpinLock;
+#ifdef USE_TICKLESS_TIMER
+	u64			 m_nNextEvent;
+#endif
 
 	unsigned		 m_nMsDelay;
 	unsigned		 m_nusDelay;
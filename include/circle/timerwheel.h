@@ -0,0 +1,99 @@
+//
+// timerwheel.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_timerwheel_h
+#define _circle_timerwheel_h
+
+#include <circle/types.h>
+
+typedef uintptr TKernelTimerHandle;
+
+typedef void TKernelTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext);
+
+struct TTimerWheelEntry;
+
+class CTimerWheel	/// Hierarchical timer wheel with O(1) insertion and removal of timers
+{
+public:
+	CTimerWheel (void);
+	~CTimerWheel (void);
+
+	/// \param nElapsesAt Time, when the timer elapses (in units of the wheel)
+	/// \param pHandler	The handler to be called when the timer elapses
+	/// \param pParam	First user defined parameter to hand over to the handler
+	/// \param pContext	Second user defined parameter to hand over to the handler
+	/// \return Timer handle (cannot be 0)
+	/// \note A timer, which has already elapsed, elapses on the next time unit.
+	TKernelTimerHandle Add (u64 nElapsesAt, TKernelTimerHandler *pHandler,
+				void *pParam, void *pContext);
+
+	/// \param hTimer Timer handle
+	/// \return TRUE if the timer was still pending
+	/// \note The handle may be invalid already (timer elapsed or removed before).
+	boolean Remove (TKernelTimerHandle hTimer);
+
+	/// \brief Advances the wheel and fetches the next elapsed timer
+	/// \param nNow Current time (in units of the wheel)
+	/// \param phTimer Handle of the elapsed timer will be returned here
+	/// \param ppHandler Handler of the elapsed timer will be returned here
+	/// \param ppParam First user parameter will be returned here
+	/// \param ppContext Second user parameter will be returned here
+	/// \return FALSE, if no more timer has elapsed until nNow
+	/// \note The timer is not pending any more, when this returns.
+	boolean GetElapsed (u64 nNow, TKernelTimerHandle *phTimer,
+			    TKernelTimerHandler **ppHandler, void **ppParam, void **ppContext);
+
+	/// \return Time up to which the wheel has been advanced
+	u64 GetTime (void) const		{ return m_nTime; }
+
+	/// \return Earliest time, when GetElapsed() may return a timer, (u64) -1 if empty
+	/// \note May be earlier than the next elapsing timer (e.g. for cascading).
+	u64 GetNextEvent (void) const;
+
+private:
+	void Advance (u64 nTime);
+	void Cascade (unsigned nLevel);
+
+	void Insert (TTimerWheelEntry *pEntry);
+	void Unlink (TTimerWheelEntry *pEntry);
+
+	TTimerWheelEntry *AllocateEntry (void);
+	void FreeEntry (TTimerWheelEntry *pEntry);
+
+public:
+#define TIMER_WHEEL_BITS	6
+#define TIMER_WHEEL_SLOTS	(1 << TIMER_WHEEL_BITS)
+#define TIMER_WHEEL_LEVELS	6
+
+private:
+	u64 m_nTime;
+
+	TTimerWheelEntry *m_pSlot[TIMER_WHEEL_LEVELS][TIMER_WHEEL_SLOTS];
+	u64 m_nSlotMask[TIMER_WHEEL_LEVELS];		// bit set for each non-empty slot
+
+	TTimerWheelEntry *m_pElapsed;			// list of elapsed timers
+
+	TTimerWheelEntry **m_ppChunk;			// entries are allocated in chunks
+	unsigned m_nChunks;
+
+	TTimerWheelEntry *m_pFreeHead;			// FIFO of free entries
+	TTimerWheelEntry *m_pFreeTail;
+};
+
+#endif
@@ -20,40 +20,100 @@
 #ifndef _circle_tracer_h
 #define _circle_tracer_h
 
+#include <circle/sysconfig.h>
+#include <circle/memorymap.h>
+#include <circle/synchronize.h>
+#include <circle/macros.h>
 #include <circle/types.h>
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define TRACER_CORES	CORES
+#else
+	#define TRACER_CORES	1
+#endif
+
 struct TTraceEntry
 {
-	unsigned nClockTicks;
+	u64 nTimestamp;			// microseconds since Start()
 	unsigned nEventID;
-#define TRACER_EVENT_STOP	0
+#define TRACER_EVENT_STOP		0
+	// built-in events (enabled with TRACER_SYSTEM_EVENTS), user IDs must be smaller
+#define TRACER_EVENT_SYSTEM		0xFFFFFF00U
+#define TRACER_EVENT_TASK_SWITCH	(TRACER_EVENT_SYSTEM+1)	// task name (16 chars packed)
+#define TRACER_EVENT_IRQ_ENTER		(TRACER_EVENT_SYSTEM+2)	// IRQ number
+#define TRACER_EVENT_IRQ_EXIT		(TRACER_EVENT_SYSTEM+3)	// IRQ number
+#define TRACER_EVENT_NET_SEND		(TRACER_EVENT_SYSTEM+4)	// frame length
+#define TRACER_EVENT_NET_RECEIVE	(TRACER_EVENT_SYSTEM+5)	// frame length
+#define TRACER_EVENT_USB_SUBMIT		(TRACER_EVENT_SYSTEM+6)	// device, endpoint, length
+#define TRACER_EVENT_USB_COMPLETE	(TRACER_EVENT_SYSTEM+7)	// device, endpoint, status, length
 	unsigned nParam[4];
 };
 
-class CTracer
+#ifdef TRACER_SYSTEM_EVENTS
+	#define TRACE_SYSTEM_EVENT(...)		CTracer::SystemEvent (__VA_ARGS__)
+	#define TRACE_TASK_SWITCH(name)		CTracer::TaskSwitchEvent (name)
+#else
+	#define TRACE_SYSTEM_EVENT(...)		((void) 0)
+	#define TRACE_TASK_SWITCH(name)		((void) 0)
+#endif
+
+/// \note Each CPU core writes into its own ring buffer. An entry is reserved with an atomic
+///	  increment of the write index, so that Event() can be called from any context (TASK,
+///	  IRQ, FIQ) without a lock, also when it is interrupted by another Event() call.
+
+class CTracer	/// Records time-stamped events into per-core ring buffers
 {
 public:
+	/// \param nDepth Size of the ring buffer of each core (number of entries)
+	/// \param bStopIfFull Stop recording on a core, when its buffer is full (otherwise overwrite)
 	CTracer (unsigned nDepth, boolean bStopIfFull);
 	~CTracer (void);
 
 	void Start (void);
 	void Stop (void);
 
-	// not reentrant, use spin lock if required
 	void Event (unsigned nID, unsigned nParam1 = 0, unsigned nParam2 = 0, unsigned nParam3 = 0, unsigned nParam4 = 0);
 
+	/// \brief Writes the recorded events as text to the logger
 	void Dump (void);
 
+	/// \return Maximum size of the output of ExportChromeTrace() in bytes
+	unsigned GetChromeTraceMaxSize (void) const;
+	/// \brief Writes the recorded events in the Chrome trace event (JSON) format
+	/// \param pBuffer Output buffer
+	/// \param nBufferSize Size of the output buffer (trace is truncated to fit)
+	/// \return Length of the output in bytes
+	/// \note The output can be loaded into chrome://tracing or ui.perfetto.dev.
+	unsigned ExportChromeTrace (char *pBuffer, unsigned nBufferSize);
+
 	static CTracer *Get (void);
 
+	static void SystemEvent (unsigned nID, unsigned nParam1 = 0, unsigned nParam2 = 0,
+				 unsigned nParam3 = 0, unsigned nParam4 = 0)
+	{
+		if (s_pThis != 0)
+		{
+			s_pThis->Event (nID, nParam1, nParam2, nParam3, nParam4);
+		}
+	}
+
+	static void TaskSwitchEvent (const char *pTaskName);
+
 private:
-	unsigned	 m_nDepth;		// size of ring buffer
+	unsigned GetEntries (unsigned nCore, unsigned *pFirst) const;
+
+private:
+	unsigned	 m_nDepth;		// size of each ring buffer
 	boolean		 m_bStopIfFull;
-	boolean		 m_bActive;
-	unsigned	 m_nStartTicks;
-	TTraceEntry	*m_pEntry;		// array used as ring buffer
-	unsigned	 m_nEntries;		// valid entries in ring buffer
-	unsigned	 m_nCurrent;		// write index into ring buffer
+	volatile boolean m_bActive;
+	u64		 m_nStartTicks;
+
+	struct TTraceRing
+	{
+		TTraceEntry	*pEntry;	// array used as ring buffer
+		volatile unsigned nWrite ALIGN (DATA_CACHE_LINE_LENGTH_MAX);	// free running
+	}
+	m_Ring[TRACER_CORES];
 
 	static CTracer *s_pThis;
 };
@@ -28,8 +28,17 @@
 #define ATTRINDX_NORMAL		0
 #define ATTRINDX_DEVICE		1
 #define ATTRINDX_COHERENT	2
+#define ATTRINDX_NONCACHED	3
 
-class CTranslationTable
+// memory attributes for CTranslationTable::SetRegionAttributes()
+#define MEMATTR_NORMAL			ATTRINDX_NORMAL		// cached
+#define MEMATTR_DEVICE			ATTRINDX_DEVICE		// Device-nGnRE
+#define MEMATTR_STRONGLY_ORDERED	ATTRINDX_COHERENT	// Device-nGnRnE
+#define MEMATTR_WRITE_COMBINING		ATTRINDX_NONCACHED	// normal non-cacheable
+#define MEMATTR_TYPE_MASK		0x07
+#define MEMATTR_EXECUTE_NEVER		0x08			// can be or'ed to the type
+
+class CTranslationTable	/// Identity mapping of the physical address space (AArch64)
 {
 public:
 	CTranslationTable (size_t nMemSize) NOOPT;
@@ -37,8 +46,33 @@ public:
 
 	uintptr GetBaseAddress (void) const;
 
+	/// \brief Changes the memory attributes of an address region
+	/// \param nBaseAddress Base address of the region (must be 64 KB aligned)
+	/// \param nSize	Size of the region (must be a multiple of 64 KB)
+	/// \param nAttributes	MEMATTR_* type, optionally or'ed with MEMATTR_EXECUTE_NEVER
+	/// \return Operation successful?
+	/// \note Whole 512 MB ranges are mapped with a single block descriptor, otherwise
+	///	  aligned 2 MB runs of equal pages get the contiguous hint.
+	/// \note The region must not be accessed, while its mapping is modified. The caller
+	///	  has to clean and invalidate the data cache, if cached memory changes its type.
+	boolean SetRegionAttributes (uintptr nBaseAddress, size_t nSize, unsigned nAttributes);
+
 private:
-	TARMV8MMU_LEVEL3_DESCRIPTOR *CreateLevel3Table (uintptr nBaseAddress) NOOPT;
+	unsigned GetDefaultAttributes (u64 nBaseAddress) const NOOPT;
+
+	TARMV8MMU_LEVEL3_DESCRIPTOR *CreateLevel3Table (u64 nBaseAddress) NOOPT;
+	TARMV8MMU_LEVEL3_DESCRIPTOR *SplitBlock (unsigned nEntry);
+
+	static void SetBlock (TARMV8MMU_LEVEL2_BLOCK_DESCRIPTOR *pDesc,
+			      u64 nBaseAddress, unsigned nAttributes) NOOPT;
+	static void SetPage (TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR *pDesc,
+			     u64 nBaseAddress, unsigned nAttributes) NOOPT;
+
+	// sets or clears the contiguous hint for all groups, which overlap the given pages
+	static void UpdateContiguous (TARMV8MMU_LEVEL3_DESCRIPTOR *pTable,
+				      unsigned nFirstPage, unsigned nPages, boolean bClear) NOOPT;
+
+	static void InvalidateTLB (void);
 
 private:
 	size_t m_nMemSize;
@@ -2,7 +2,7 @@
 // dwhcidevice.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2022  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -33,12 +33,16 @@
 #include <circle/usb/dwhci.h>
 #include <circle/usb/usb.h>
 #include <circle/spinlock.h>
-#include <circle/mphi.h>
+#include <circle/softirq.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 
 #define DWHCI_WAIT_BLOCKS	DWHCI_MAX_CHANNELS
 
+// Max. number of requests in flight. The objects of the data path are taken from pools of
+// this size. With USE_USB_SOF_INTR a transfer stage may be queued, while it has no channel.
+#define DWHCI_MAX_REQUESTS	(DWHCI_MAX_CHANNELS * 2)
+
 class CDWHCIDevice : public CUSBHostController
 {
 public:
@@ -98,6 +102,9 @@ private:
 	void ChannelInterruptHandler (unsigned nChannel);
 #ifdef USE_USB_SOF_INTR
 	void SOFInterruptHandler (void);
+
+	void EnableSOFInterrupt (void);
+	void DisableSOFInterruptIfIdle (void);
 #endif
 	void InterruptHandler (void);
 	static void InterruptStub (void *pParam);
@@ -145,6 +152,9 @@ private:
 	CDWHCITransferStageData *m_pStageData[DWHCI_MAX_CHANNELS];
 
 	CSpinLock m_IntMaskSpinLock;
+#ifdef USE_USB_SOF_INTR
+	volatile boolean m_bSOFIntEnabled;		// only while transactions are queued
+#endif
 
 	volatile boolean m_bWaiting[DWHCI_WAIT_BLOCKS];
 	volatile unsigned m_nWaitBlockAllocated;	// one bit per wait block, set if allocated
@@ -155,8 +165,9 @@ private:
 
 #ifdef USE_USB_FIQ
 	volatile int m_nPortStatusChanged;
+	volatile int m_nIRQTriggered;			// IRQ pending, which completes URBs
 	CDWHCICompletionQueue m_CompletionQueue;
-	CMPHIDevice m_MPHI;
+	int m_nSoftIRQLine;				// completes the URBs on IRQ level
 #endif
 
 	volatile boolean m_bShutdown;			// USB driver will shutdown
@@ -49,6 +49,9 @@ public:
 	// dequeue next transaction to be processed at usFrameNumber (or earlier)
 	CDWHCITransferStageData *Dequeue (u16 usFrameNumber);
 
+	// no transaction queued?
+	boolean IsEmpty (void);
+
 private:
 	CPtrListFIQ m_List;
 
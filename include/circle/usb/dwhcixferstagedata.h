@@ -56,6 +56,7 @@ public:
 	u8 GetEndpointType (void) const;
 	u8 GetEndpointNumber (void) const;
 	u32 GetMaxPacketSize (void) const;
+	u32 GetMultiCount (void) const;			// transactions per microframe
 	TUSBSpeed GetSpeed (void) const;
 
 	u8 GetPID (void) const;
@@ -100,6 +101,7 @@ private:
 	CUSBEndpoint	*m_pEndpoint;
 	TUSBSpeed	 m_Speed;
 	u32		 m_nMaxPacketSize;
+	u32		 m_nMultiCount;
 	
 	u32		 m_nTransferSize;
 	unsigned	 m_nPackets;
@@ -65,13 +65,16 @@ private:
 
 	volatile boolean m_bInActive;
 
-	static const size_t QueueSize = 8192+1;
+	static const size_t QueueSize = 32768+1;
 	u8 *m_pQueue;
 	volatile unsigned m_nInPtr;
 	volatile unsigned m_nOutPtr;
 
+	// An OUT transfer completes on a short packet only, so it is kept small to not
+	// delay data from hosts, which do not send a zero-length packet. An IN transfer
+	// can span many packets, because the host completes its request on a full buffer.
 	static const size_t MaxOutMessageSize = 512;
-	static const size_t MaxInMessageSize = 512;
+	static const size_t MaxInMessageSize = 4096;
 	DMA_BUFFER (u8, m_OutBuffer, MaxOutMessageSize);
 	DMA_BUFFER (u8, m_InBuffer, MaxInMessageSize);
 
@@ -33,6 +33,8 @@
 
 #define BLOCK_SIZE 512
 
+#define MSD_MAX_TRANSFER_SIZE 0x10000	// bytes per bulk data transfer, multiple of BLOCK_SIZE
+
 struct TUSBMSDCBW   //31 bytes
 {
 	u32 dCBWSignature;
@@ -198,6 +200,15 @@ private:
 
 	void InitDeviceSize(u64 blocks);
 
+	void UpdateRead (void);
+	void UpdateWrite (void);
+
+	void BeginDataIO (void);	// at start of a Read/Write command
+	void StartDeviceIO (unsigned nBuffer, boolean bWrite);
+	void DataIOFailed (void);
+
+	static void DeviceCompletionRoutine (int nResult, void *pParam);
+
 private:
 	CDevice *m_pDevice;
 
@@ -234,7 +245,6 @@ private:
 		ReceiveCBW,
 		InvalidCBW,
 		DataIn,
-		DataOut,
 		SentCSW,
 		SendReqSenseReply,
 		DataInRead,
@@ -260,8 +270,35 @@ private:
 	DMA_BUFFER (u8, m_OutBuffer, MaxOutMessageSize);
 	DMA_BUFFER (u8, m_InBuffer, MaxInMessageSize);
 
+	// ping-pong buffers for multi-block data transfers, which overlap device I/O
+	// with USB transfers (the state is handed over between task and interrupt level)
+	enum TBufferState
+	{
+		BufferFree,
+		BufferUSB,		// USB transfer active
+		BufferFull,		// data is ready for device write or USB transfer
+		BufferDevice		// device I/O active
+	};
+
+	struct TDataBuffer
+	{
+		u8 *pData;
+		volatile TBufferState State;
+		u32 nBlocks;
+		volatile int nResult;	// of device read
+		boolean bWrite;
+		CUSBMSDGadget *pThis;
+	};
+
+	static const unsigned NumBuffers = 2;
+	TDataBuffer m_Buffer[NumBuffers];
+	unsigned m_nDeviceBuffer;	// next buffer for device I/O
+	volatile unsigned m_nUSBBuffer;	// next buffer for USB transfer
+	u32 m_nIOBlocks;		// blocks, not handed over to device read or USB receive yet
+	volatile boolean m_bDataError;
+
 	u32 m_nblock_address;
-	u32 m_nnumber_blocks;
+	volatile u32 m_nnumber_blocks;	// not completed yet
 	u64 m_nDeviceBlocks=0;
 	u32 m_nbyteCount;
 	boolean m_MSDReady=false;
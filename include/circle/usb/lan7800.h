@@ -24,10 +24,16 @@
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbrequest.h>
+#include <circle/usb/usbbulkinring.h>
+#include <circle/synchronize.h>
 #include <circle/macaddress.h>
 #include <circle/timer.h>
 #include <circle/types.h>
 
+#define LAN7800_RX_BUFFER_SIZE		(12 * 1024)	// max. size of a bulk-in burst
+#define LAN7800_RX_BUFFERS		4
+#define LAN7800_TX_BUFFER_SIZE		(8 * 1024)	// max. size of an aggregated bulk-out transfer
+
 class CLAN7800Device : public CUSBFunction, CNetDevice
 {
 public:
@@ -39,9 +45,12 @@ public:
 	const CMACAddress *GetMACAddress (void) const;
 
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
-	
+	// multiple frames are aggregated into one bulk-out transfer
+	unsigned SendBuffers (CNetBuffer *pFrames[], unsigned nCount);
+
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
+	boolean ReceiveBuffer (CNetBuffer *pFrame);
 
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
@@ -51,6 +60,10 @@ public:
 	boolean SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE]);
 
 private:
+	// returns the next frame from the aggregated bulk-in data (without RX command words
+	// and FCS), the frame is valid until the next call
+	const u8 *GetNextFrame (unsigned *pLength);
+
 	void SetAddressFilter (int index, const u8 addr[MAC_ADDRESS_SIZE]);
 
 	boolean InitMACAddress (void);
@@ -72,6 +85,11 @@ private:
 	CUSBEndpoint *m_pEndpointBulkIn;
 	CUSBEndpoint *m_pEndpointBulkOut;
 
+	CUSBBulkInRing *m_pRxRing;
+	unsigned m_nRxOffset;				// in the current buffer of m_pRxRing
+
+	DMA_BUFFER (u8, m_TxBuffer, LAN7800_TX_BUFFER_SIZE);
+
 	CMACAddress m_MACAddress;
 
 	u32 m_FilterTable[33][2];
@@ -24,9 +24,15 @@
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbrequest.h>
+#include <circle/usb/usbbulkinring.h>
+#include <circle/synchronize.h>
 #include <circle/macaddress.h>
 #include <circle/types.h>
 
+#define SMSC951X_RX_BUFFER_SIZE		(16 * 1024 + 5 * 512)	// max. size of a bulk-in burst
+#define SMSC951X_RX_BUFFERS		4
+#define SMSC951X_TX_BUFFER_SIZE		(8 * 1024)	// max. size of an aggregated bulk-out transfer
+
 class CSMSC951xDevice : public CUSBFunction, CNetDevice
 {
 public:
@@ -38,9 +44,12 @@ public:
 	const CMACAddress *GetMACAddress (void) const;
 
 	boolean SendFrame (const void *pBuffer, unsigned nLength);
-	
+	// multiple frames are aggregated into one bulk-out transfer
+	unsigned SendBuffers (CNetBuffer *pFrames[], unsigned nCount);
+
 	// pBuffer must have size FRAME_BUFFER_SIZE
 	boolean ReceiveFrame (void *pBuffer, unsigned *pResultLength);
+	boolean ReceiveBuffer (CNetBuffer *pFrame);
 	
 	// returns TRUE if PHY link is up
 	boolean IsLinkUp (void);
@@ -50,6 +59,10 @@ public:
 	boolean SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE]);
 
 private:
+	// returns the next frame from the aggregated bulk-in data (without RX status and CRC),
+	// the frame is valid until the next call
+	const u8 *GetNextFrame (unsigned *pLength);
+
 	static u32 Hash (const u8 Address[MAC_ADDRESS_SIZE]);
 
 	boolean PHYWrite (u8 uchIndex, u16 usValue);
@@ -68,6 +81,11 @@ private:
 	CUSBEndpoint *m_pEndpointBulkIn;
 	CUSBEndpoint *m_pEndpointBulkOut;
 
+	CUSBBulkInRing *m_pRxRing;
+	unsigned m_nRxOffset;				// in the current buffer of m_pRxRing
+
+	DMA_BUFFER (u8, m_TxBuffer, SMSC951X_TX_BUFFER_SIZE);
+
 	CMACAddress m_MACAddress;
 };
 
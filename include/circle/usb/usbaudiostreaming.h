@@ -108,6 +108,18 @@ public:
 	boolean ReceiveChunk (void *pBuffer, unsigned nChunkSizeBytes,
 			      TCompletionRoutine *pCompletionRoutine = 0, void *pParam = 0);
 
+	/// \return Is this an asynchronous output, which is paced by an input stream\n
+	///	    of the same device (without explicit feedback endpoint)?
+	boolean HasImplicitFeedback (void) const;
+
+	/// \brief Feed the rate of the input stream into an output with implicit feedback
+	/// \param pSource Input streaming device of the same USB device
+	/// \param nBytesReceived Number of bytes received from pSource in one chunk
+	void ImplicitFeedback (const CUSBAudioStreamingDevice *pSource, unsigned nBytesReceived);
+
+	/// \return Current feedback value in frames per second * 65536 (0 if not async output)
+	unsigned GetFeedbackRate (void) const;
+
 	/// \brief Select Input Terminal to be used for input
 	/// \param nIndex Index of the Input Terminal (0 .. NumTerminals-1)
 	/// \return Operation successful?
@@ -133,6 +145,12 @@ private:
 
 	void UpdateChunkSize (void);
 
+	// nFeedback is the number of frames per (micro)frame in Q16.16 format
+	void SetFeedback (u32 nFeedback);
+	void UpdateAsyncChunkSize (void);
+
+	unsigned GetUSBFrameRate (void) const;	// (micro)frames per second
+
 private:
 	unsigned m_nBitResolution;
 	unsigned m_nSubframeSize;
@@ -162,6 +180,12 @@ private:
 	DMA_BUFFER (u32, m_SyncEPBuffer, 1);
 	unsigned m_nSyncAccu;
 
+	boolean m_bImplicitFeedback;
+	u32 m_nFeedbackNominal;			// frames per (micro)frame (Q16.16)
+	volatile u32 m_nFeedback;		// frames per data packet (Q16.16)
+	int m_nFeedbackShift;			// corrects wrong feedback formats
+	boolean m_bFeedbackShiftValid;
+
 	u8 m_uchClockSourceID;
 	u8 m_uchSelectorUnitID;
 	u8 m_uchFeatureUnitID[MaxTerminals];
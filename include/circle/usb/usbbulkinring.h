@@ -0,0 +1,80 @@
+//
+// usbbulkinring.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_usb_usbbulkinring_h
+#define _circle_usb_usbbulkinring_h
+
+#include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbrequest.h>
+#include <circle/types.h>
+
+#define USB_BULK_IN_RING_MAX_BUFFERS	8
+
+/// \note Only one request is active on the endpoint at a time, because the data toggle\n
+///	  of an endpoint cannot be tracked with multiple requests in flight. The next\n
+///	  request is submitted from the completion routine into the next free buffer,\n
+///	  so that the endpoint is kept busy, while the data of the previous buffers is\n
+///	  processed. Requests complete on NAK, a new one is started with Poll() then.
+
+class CUSBBulkInRing	/// Ring of buffers for (aggregated) bulk-in transfers, e.g. of USB NICs
+{
+public:
+	/// \param pHost Host controller, the endpoint belongs to
+	/// \param pEndpoint Bulk-in endpoint
+	/// \param nBufferSize Size of each buffer (a multiple of the max. packet size and of\n
+	///	   DATA_CACHE_LINE_LENGTH_MAX)
+	/// \param nBuffers Number of buffers (2..USB_BULK_IN_RING_MAX_BUFFERS)
+	CUSBBulkInRing (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+			unsigned nBufferSize, unsigned nBuffers);
+	~CUSBBulkInRing (void);
+
+	/// \brief Start a request, if none is active and a buffer is free
+	void Poll (void);
+
+	/// \param pLength Length of the received data is returned here
+	/// \return Pointer to the data of the oldest filled buffer (0 if none)
+	const u8 *GetData (unsigned *pLength) const;
+
+	/// \brief Give the buffer, returned by GetData(), back to the ring
+	void ReleaseData (void);
+
+private:
+	void SubmitRequest (void);		// with IRQs disabled or from IRQ context
+
+	void CompletionRoutine (CUSBRequest *pURB);
+	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+
+private:
+	CUSBHostController *m_pHost;
+	CUSBEndpoint *m_pEndpoint;
+	unsigned m_nBufferSize;
+	unsigned m_nBuffers;
+
+	u8 *m_pBuffer;				// m_nBuffers * m_nBufferSize bytes
+	volatile unsigned m_nLength[USB_BULK_IN_RING_MAX_BUFFERS];
+
+	volatile unsigned m_nIn;		// buffer of the active or next request
+	volatile unsigned m_nOut;		// oldest filled buffer
+	volatile unsigned m_nFilled;		// number of filled buffers
+
+	CUSBRequest *volatile m_pURB;		// active request
+};
+
+#endif
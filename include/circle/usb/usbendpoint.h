@@ -48,6 +48,8 @@ public:
 
 	boolean SetMaxPacketSize (u32 nMaxPacketSize);
 	u32 GetMaxPacketSize (void) const;
+	// 2 or 3 for high-bandwidth (high-speed isochronous or interrupt) endpoints, 1 otherwise
+	u32 GetTransactionsPerMicroframe (void) const;
 
 #if RASPPI <= 3
 	unsigned GetInterval (void) const;		// Milliseconds
@@ -67,6 +69,7 @@ private:
 	TEndpointType	 m_Type;
 	boolean		 m_bDirectionIn;
 	u32		 m_nMaxPacketSize;
+	u32		 m_nTransactions;		// per microframe
 #if RASPPI <= 3
 	unsigned	 m_nInterval;			// Milliseconds
 	TUSBPID		 m_NextPID;
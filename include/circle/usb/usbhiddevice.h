@@ -35,6 +35,16 @@ public:
 
 	boolean ConfigureHID (unsigned nMaxReportSize = 0);
 
+	/// \return CTimer::GetClockTicks64() on completion of the request of the current report
+	/// \note Can be called from a report or status handler to order events in time
+	u64 GetReportTimestamp (void) const;
+
+	/// \brief Overrides the polling interval of HID devices, which are configured afterwards
+	/// \param nMilliseconds Interval of the interrupt IN endpoint (e.g. 1 for 1000 Hz polling),\n
+	///	  0 to use the interval requested by the device (default)
+	/// \note On the Raspberry Pi 1-3 USE_USB_SOF_INTR must be defined for intervals < 20 ms.
+	static void SetPollingInterval (unsigned nMilliseconds);
+
 protected:
 	// has to be called from Configure() in derived class, when initialization is done
 	boolean StartRequest (void);
@@ -66,6 +76,10 @@ private:
 	CUSBEndpoint *m_pEndpointOut;		// interrupt out EP (optional)
 
 	u8 *m_pReportBuffer;
+
+	u64 m_ullReportTimestamp;
+
+	static unsigned s_nPollingInterval;
 };
 
 #endif
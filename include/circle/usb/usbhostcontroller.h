@@ -2,7 +2,7 @@
 // usbhostcontroller.h
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,6 +24,7 @@
 #include <circle/usb/usb.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbrequest.h>
+#include <circle/sched/asyncflow.h>
 #include <circle/ptrlist.h>
 #include <circle/spinlock.h>
 #include <circle/types.h>
@@ -71,6 +72,11 @@ public:
 
 	virtual void CancelDeviceTransactions (CUSBDevice *pUSBDevice) {}
 
+	// submits the URB from an async flow (see ASYNC_AWAIT()), the URB remains owned by the caller,
+	// returns TRUE when completed, result is the resulting length or < 0 on failure
+	boolean AwaitRequest (CAsyncFlow *pFlow, CUSBRequest *pURB,
+			      unsigned nTimeoutMs = USB_TIMEOUT_NONE);
+
 public:
 	boolean IsPlugAndPlay (void) const;
 
@@ -95,6 +101,8 @@ private:
 	void PortStatusChanged (CUSBStandardHub *pHub);
 	friend class CUSBStandardHub;
 
+	static void AsyncFlowCompletionRoutine (CUSBRequest *pURB, void *pParam, void *pContext);
+
 private:
 	boolean m_bPlugAndPlay;
 	boolean m_bFirstUpdateCall;
@@ -65,6 +65,8 @@ public:
 private:
 	void ReportHandler (const u8 *pReport, unsigned nReportSize);
 
+	void QueueKeyEvents (const u8 *pReport);	// to CInputEventQueue
+
 	static boolean FindByte (const u8 *pBuffer, u8 ucByte, unsigned nLength);
 
 private:
@@ -77,6 +79,7 @@ private:
 	boolean m_bMixedMode;
 
 	u8 m_LastReport[USBKEYB_REPORT_SIZE];
+	u8 m_QueuedReport[USBKEYB_REPORT_SIZE];
 
 	u8 m_ucLastLEDStatus;
 
@@ -22,15 +22,21 @@
 
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbrequest.h>
 #include <circle/fs/partitionmanager.h>
+#include <circle/device.h>
 #include <circle/numberpool.h>
+#include <circle/spinlock.h>
+#include <circle/synchronize.h>
 #include <circle/types.h>
 
 #define UMSD_BLOCK_SIZE		512
 #define UMSD_BLOCK_MASK		(UMSD_BLOCK_SIZE-1)
 #define UMSD_BLOCK_SHIFT	9
 
-#define UMSD_MAX_OFFSET		0x1FFFFFFFFFFULL		// 2TB
+#define UMSD_MAX_TRANSFER	(256*1024)			// bytes per SCSI command
+
+#define UMSD_MAX_ASYNC		8				// queued block requests
 
 class CUSBBulkOnlyMassStorageDevice : public CUSBFunction
 {
@@ -46,24 +52,74 @@ public:
 	u64 Seek (u64 ullOffset);
 
 	u64 GetSize (void) const;		// in bytes
-	unsigned GetCapacity (void) const;	// in blocks
+	u64 GetCapacity (void) const;		// in blocks
+
+	// supports DEVICE_IOCTL_SUBMIT, the commands are executed one after another
+	int IOCtl (unsigned long ulCmd, void *pData);
 
 private:
-	int TryRead (void *pBuffer, size_t nCount);
-	int TryWrite (const void *pBuffer, size_t nCount);
+	int TryRead (void *pBuffer, u64 ullOffset, size_t nCount);
+	int TryWrite (const void *pBuffer, u64 ullOffset, size_t nCount);
+
+	// returns length of the command block, READ(10)/WRITE(10) or READ(16)/WRITE(16)
+	static size_t SetupReadWrite (u8 *pCmdBlk, boolean bWrite, u64 ullBlock, u32 nBlocks);
 
 	int Command (void *pCmdBlk, size_t nCmdBlkLen, void *pBuffer, size_t nBufLen, boolean bIn);
 
 	int Reset (void);
 
+private:
+	struct TAsyncCommand
+	{
+		TDeviceBlockRequest Request;
+		u8		*pDMABuffer;		// bounce buffer or 0
+		size_t		 nDone;			// bytes transferred by previous commands
+		size_t		 nLength;		// bytes of the current command
+		TAsyncCommand	*pNext;
+	};
+
+	enum TAsyncStage
+	{
+		AsyncStageCBW,
+		AsyncStageData,
+		AsyncStageCSW
+	};
+
+	int SubmitRequest (const TDeviceBlockRequest *pRequest);
+
+	// spin lock must be held
+	void StartAsync (void);
+	boolean StartCommand (void);
+	boolean StartStage (TAsyncStage Stage);
+	void CompleteAsync (int nResult);
+
+	void AsyncCompletionRoutine (CUSBRequest *pURB);
+	static void AsyncCompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+
+	void BeginSyncAccess (void);
+	void EndSyncAccess (void);
+
 private:
 	CUSBEndpoint *m_pEndpointIn;
 	CUSBEndpoint *m_pEndpointOut;
 
 	unsigned m_nCWBTag;
-	unsigned m_nBlockCount;
+	u64 m_ullBlockCount;
 	u64 m_ullOffset;
 
+	TAsyncCommand m_AsyncCommand[UMSD_MAX_ASYNC];
+	TAsyncCommand *m_pAsyncFree;
+	TAsyncCommand *m_pAsyncFirst;		// waiting commands
+	TAsyncCommand *m_pAsyncLast;
+	TAsyncCommand *m_pAsyncActive;
+	TAsyncStage m_AsyncStage;
+	boolean m_bSyncActive;
+	boolean m_bAsyncFailed;			// reset recovery required
+	CSpinLock m_SpinLock;
+
+	DMA_BUFFER (u8, m_CBWBuffer, 32);
+	DMA_BUFFER (u8, m_CSWBuffer, 16);
+
 	CPartitionManager *m_pPartitionManager;
 
 	static CNumberPool s_DeviceNumberPool;
@@ -39,6 +39,14 @@ typedef void TMIDIPacketHandler (unsigned nCable, u8 *pPacket, unsigned nLength)
 typedef void TMIDIPacketHandlerEx (unsigned nCable, u8 *pPacket, unsigned nLength,
 				   unsigned nDevice, void *pParam);
 
+#define USB_MIDI_EVENT_QUEUE_SIZE	256		// must be a power of 2
+
+struct TMIDIEvent		/// Received MIDI packet with time of arrival
+{
+	u64 ullTimestamp;	///< CTimer::GetClockTicks64() on completion of the USB request
+	u8 Packet[4];		///< Encoded USB MIDI event packet (cable number, CIN, MIDI bytes)
+};
+
 class CUSBMIDIDevice : public CDevice	/// Interface device for USB Audio Class MIDI 1.0 devices
 {
 public:
@@ -56,6 +64,23 @@ public:
 	/// \param pParam User parameter, handed over to the handler
 	void RegisterPacketHandler (TMIDIPacketHandlerEx *pPacketHandler, void *pParam);
 
+	/// \brief Queue received packets with time stamp, instead of handling them in\n
+	///	   interrupt context only (registered packet handler is still called)
+	/// \note Packets are dropped, if the queue is full (see GetLostEvents())
+	void EnableEventQueue (void);
+	/// \brief Get a batch of queued events (single reader only)
+	/// \param pEvents Pointer to buffer for events
+	/// \param nMaxEvents Size of buffer in number of events
+	/// \return Number of events returned (0 if queue is empty)
+	unsigned ReadEvents (TMIDIEvent *pEvents, unsigned nMaxEvents);
+	/// \return Number of events, which have been dropped, because the queue was full
+	unsigned GetLostEvents (void) const;
+
+	/// \brief Set the time, after which the device is polled again, if it had no data
+	/// \param nMilliseconds Polling interval in milliseconds (default 10)
+	/// \note Has no effect, if the option usbboost=true is set
+	void SetPollingInterval (unsigned nMilliseconds);
+
 	/// \brief Send one or more packets in encoded USB MIDI event packet format
 	/// \param pData Pointer to the packet buffer
 	/// \param nLength Length of packet buffer in bytes (multiple of 4)
@@ -88,6 +113,8 @@ private:
 
 	boolean GetAllSoundOffOnUSBError (void) const;
 
+	unsigned GetPollingInterval (void) const;
+
 	friend class CUSBMIDIHostDevice;
 	friend class CUSBMIDIGadgetEndpoint;
 
@@ -100,6 +127,14 @@ private:
 
 	boolean m_bAllSoundOff;
 
+	unsigned m_nPollingIntervalMs;
+
+	boolean m_bEventQueueEnabled;
+	TMIDIEvent *m_pEventQueue;		// USB_MIDI_EVENT_QUEUE_SIZE entries
+	volatile unsigned m_nEventIn;		// free running, written from IRQ context only
+	volatile unsigned m_nEventOut;		// free running, written by the reader only
+	volatile unsigned m_nLostEvents;
+
 	unsigned m_nDeviceNumber;
 	static CNumberPool s_DeviceNumberPool;
 };
@@ -0,0 +1,114 @@
+//
+// usbpipe.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_usb_usbpipe_h
+#define _circle_usb_usbpipe_h
+
+#include <circle/usb/usbhostcontroller.h>
+#include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbrequest.h>
+#include <circle/types.h>
+
+#define USB_PIPE_MAX_BUFFERS	16
+
+#if RASPPI <= 3
+	#define USB_PIPE_MAX_ACTIVE	1	// data toggle is tracked by software on DWHCI
+#else
+	#define USB_PIPE_MAX_ACTIVE	2	// TDs, which can be queued on a xHCI endpoint
+#endif
+
+/// \note An IN pipe keeps up to USB_PIPE_MAX_ACTIVE requests in flight, after Start() has\n
+///	  been called. A buffer is resubmitted, when the completion handler has returned.\n
+///	  An OUT pipe queues the data, given to Submit(), in the next free buffer, and\n
+///	  submits the queued buffers in order, while the endpoint is kept busy.
+/// \note After a failed request no further requests are submitted, queued OUT buffers\n
+///	  are discarded. Start() clears this state.
+/// \note Active requests cannot be cancelled. The pipe must be idle, when it is destroyed.
+
+class CUSBPipe		/// Keeps asynchronous requests in flight on a bulk or interrupt endpoint
+{
+public:
+	/// \param nResult Number of transferred bytes, or < 0 on error
+	/// \param pBuffer Buffer of the request (received data for IN pipes)
+	/// \param pParam User parameter, given to the constructor
+	/// \note Is called from interrupt context
+	typedef void TCompletionHandler (int nResult, const u8 *pBuffer, void *pParam);
+
+	/// \param pHost Host controller, the endpoint belongs to
+	/// \param pEndpoint Bulk or interrupt endpoint
+	/// \param nBufferSize Size of each buffer (a multiple of the max. packet size and of\n
+	///	   DATA_CACHE_LINE_LENGTH_MAX)
+	/// \param nBuffers Number of buffers (1..USB_PIPE_MAX_BUFFERS)
+	/// \param pHandler Completion handler (required for IN pipes)
+	/// \param pParam User parameter, handed over to the completion handler
+	CUSBPipe (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+		  unsigned nBufferSize, unsigned nBuffers,
+		  TCompletionHandler *pHandler = 0, void *pParam = 0);
+	~CUSBPipe (void);
+
+	/// \brief Clear the failed state, IN pipe: start receiving
+	void Start (void);
+	/// \brief IN pipe: do not submit further requests, active requests still complete
+	void Stop (void);
+
+	/// \brief OUT pipe: Append the data of further Submit() calls to the last queued buffer,\n
+	///	   if it fits there (for byte streams without message boundaries only)
+	void EnableCoalescing (void);
+
+	/// \brief OUT pipe: copy data into the next free buffer and queue it for transfer
+	/// \param pData Data to be sent
+	/// \param nLength Length of the data (<= buffer size)
+	/// \return No buffer is free or the pipe has failed, if FALSE
+	boolean Submit (const void *pData, unsigned nLength);
+
+	/// \return No request is active or queued?
+	boolean IsIdle (void) const;
+	/// \return Has a request failed since the last Start()?
+	boolean IsFailed (void) const;
+
+private:
+	void SubmitRequests (void);		// with IRQs disabled or from IRQ context
+
+	void CompletionRoutine (CUSBRequest *pURB);
+	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+
+private:
+	CUSBHostController *m_pHost;
+	CUSBEndpoint *m_pEndpoint;
+	boolean m_bDirectionIn;
+	unsigned m_nBufferSize;
+	unsigned m_nBuffers;
+	unsigned m_nMaxActive;
+	TCompletionHandler *m_pHandler;
+	void *m_pParam;
+	boolean m_bCoalesce;
+
+	u8 *m_pBuffer;				// m_nBuffers * m_nBufferSize bytes
+	unsigned m_nLength[USB_PIPE_MAX_BUFFERS];
+
+	// the active buffers follow m_nTail, the queued OUT buffers follow them
+	volatile unsigned m_nTail;		// oldest active buffer
+	volatile unsigned m_nActive;		// number of active requests
+	volatile unsigned m_nQueued;		// number of queued OUT buffers
+
+	volatile boolean m_bStarted;		// IN pipe only
+	volatile boolean m_bFailed;
+};
+
+#endif
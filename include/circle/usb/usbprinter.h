@@ -22,6 +22,7 @@
 
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
+#include <circle/usb/usbpipe.h>
 #include <circle/numberpool.h>
 #include <circle/types.h>
 
@@ -40,6 +41,8 @@ public:
 
 	boolean Configure (void);
 
+	/// \return nCount, if the data has been queued for transfer, or < 0 on error
+	/// \note An error of a previous transfer is returned by the next call
 	int Write (const void *pBuffer, size_t nCount);
 
 private:
@@ -48,6 +51,8 @@ private:
 	CUSBEndpoint *m_pEndpointIn;
 	CUSBEndpoint *m_pEndpointOut;
 
+	CUSBPipe *m_pPipeOut;
+
 	unsigned m_nDeviceNumber;
 	static CNumberPool s_DeviceNumberPool;
 };
@@ -59,6 +59,15 @@ public:
 	int Write (const void *pBuffer, size_t nCount);
 	int Read (void *pBuffer, size_t nCount);
 
+	/// \brief Get access to the received data without copying it
+	/// \param ppData Pointer to the contiguous received data is returned here
+	/// \return Number of bytes available at *ppData (0 if none),\n
+	///	    < 0 on error or if not supported by the device
+	/// \note Call ReleaseReadData() with the number of used bytes afterwards
+	int GetReadData (const void **ppData);
+	/// \param nCount Number of bytes, consumed from the data returned by GetReadData()
+	void ReleaseReadData (size_t nCount);
+
 	boolean SetBaudRate (unsigned nBaudRate);
 	boolean SetLineProperties (TUSBSerialDataBits nDataBits,
 				   TUSBSerialParity nParity,
@@ -72,6 +81,8 @@ public:
 private:
 	typedef int TWriteHandler (const void *pBuffer, size_t nCount, void *pParam);
 	typedef int TReadHandler (void *pBuffer, size_t nCount, void *pParam);
+	typedef int TGetReadDataHandler (const void **ppData, void *pParam);
+	typedef void TReleaseReadDataHandler (size_t nCount, void *pParam);
 	typedef boolean TSetBaudRateHandler (unsigned nBaudRate, void *pParam);
 	typedef boolean TSetLinePropertiesHandler (TUSBSerialDataBits nDataBits,
 						   TUSBSerialParity nParity,
@@ -80,6 +91,8 @@ private:
 
 	void RegisterWriteHandler (TWriteHandler *pHandler, void *pParam);
 	void RegisterReadHandler (TReadHandler *pHandler, void *pParam);
+	void RegisterReadDataHandlers (TGetReadDataHandler *pGetHandler,
+				       TReleaseReadDataHandler *pReleaseHandler, void *pParam);
 	void RegisterSetBaudRateHandler (TSetBaudRateHandler *pHandler, void *pParam);
 	void RegisterSetLinePropertiesHandler (TSetLinePropertiesHandler *pHandler, void *pParam);
 
@@ -89,11 +102,14 @@ private:
 private:
 	TWriteHandler *m_pWriteHandler;
 	TReadHandler *m_pReadHandler;
+	TGetReadDataHandler *m_pGetReadDataHandler;
+	TReleaseReadDataHandler *m_pReleaseReadDataHandler;
 	TSetBaudRateHandler *m_pSetBaudRateHandler;
 	TSetLinePropertiesHandler *m_pSetLinePropertiesHandler;
 
 	void *m_pWriteParam;
 	void *m_pReadParam;
+	void *m_pReadDataParam;
 	void *m_pSetBaudRateParam;
 	void *m_pSetLinePropertiesParam;
 
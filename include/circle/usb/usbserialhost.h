@@ -23,8 +23,23 @@
 #include <circle/usb/usbfunction.h>
 #include <circle/usb/usbendpoint.h>
 #include <circle/usb/usbserial.h>
+#include <circle/usb/usbpipe.h>
+#include <circle/usb/usbrequest.h>
 #include <circle/types.h>
 
+#define USB_SERIAL_RX_RING_SIZE		0x4000		// must be a power of 2
+#define USB_SERIAL_RX_BUFFER_SIZE	512		// multiple of the max. packet size
+#define USB_SERIAL_RX_BUFFERS		4
+#define USB_SERIAL_TX_BUFFER_SIZE	2048
+#define USB_SERIAL_TX_BUFFERS		4
+
+/// \note Received data is written into a lock-free ring buffer from the completion\n
+///	  routine, so that it can be read without blocking (single reader only).\n
+///	  On xHCI multiple bulk-in requests are kept in flight. On DWHCI a single request\n
+///	  is started from Read(), because concurrent split transactions to the same device\n
+///	  are not possible, and is resubmitted while data arrives and no write is pending.
+/// \note Written data is queued and coalesced into bulk-out requests.
+
 class CUSBSerialHostDevice : public CUSBFunction /// Generic host driver for USB serial devices
 {
 public:
@@ -37,17 +52,30 @@ public:
 	int Write (const void *pBuffer, size_t nCount);
 	int Read (void *pBuffer, size_t nCount);
 
+	int GetReadData (const void **ppData);
+	void ReleaseReadData (size_t nCount);
+
 	virtual boolean SetBaudRate (unsigned nBaudRate);
 	virtual boolean SetLineProperties (TUSBSerialDataBits nDataBits,
 					   TUSBSerialParity nParity,
 					   TUSBSerialStopBits nStopBits);
 
 private:
+	void PutReceivedData (const u8 *pBuffer, unsigned nLength);	// from IRQ context
+
+#if RASPPI <= 3
+	boolean CanStartInRequest (void) const;
+	boolean SubmitInRequest (void);
 	void CompletionRoutine (CUSBRequest *pURB);
 	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
+#else
+	static void PipeInHandler (int nResult, const u8 *pBuffer, void *pParam);
+#endif
 
 	static int WriteHandler (const void *pBuffer, size_t nCount, void *pParam);
 	static int ReadHandler (void *pBuffer, size_t nCount, void *pParam);
+	static int GetReadDataHandler (const void **ppData, void *pParam);
+	static void ReleaseReadDataHandler (size_t nCount, void *pParam);
 	static boolean SetBaudRateHandler (unsigned nBaudRate, void *pParam);
 	static boolean SetLinePropertiesHandler (TUSBSerialDataBits nDataBits,
 						 TUSBSerialParity nParity,
@@ -68,12 +96,26 @@ private:
 	CUSBEndpoint *m_pEndpointIn;
 	CUSBEndpoint *m_pEndpointOut;
 
-	u8 *m_pBufferIn;
-	size_t m_nBufferInSize;
-	size_t m_nBufferInValid;
-	unsigned m_nBufferInPtr;
+	unsigned m_nMaxPacketSizeIn;
+	unsigned m_nBufferInSize;
+
+	u8 *m_pRxRing;				// USB_SERIAL_RX_RING_SIZE bytes
+	volatile unsigned m_nRxIn;		// free running, written from IRQ context only
+	volatile unsigned m_nRxOut;		// free running, written by the reader only
+	volatile unsigned m_nRxOverruns;	// number of dropped bytes
+
+	CUSBPipe *m_pPipeOut;
+
+#if RASPPI <= 3
+	u8 *m_pBufferIn;			// USB_SERIAL_RX_BUFFER_SIZE bytes
 
 	volatile boolean m_bInRequestActive;
+	volatile boolean m_bWritePending;
+#else
+	CUSBPipe *m_pPipeIn;
+
+	volatile boolean m_bPipeInStopped;	// ring buffer is (nearly) full
+#endif
 };
 
 #endif
@@ -29,6 +29,10 @@
 #include <circle/numberpool.h>
 #include <circle/types.h>
 
+#define HUB_PORT_RESET_TIMEOUT_MS	100
+#define HUB_PORT_RESET_POLL_MS		10
+#define HUB_PORT_RESET_RECOVERY_MS	10
+
 class CUSBStandardHub : public CUSBFunction
 {
 public:
@@ -50,6 +54,8 @@ public:
 private:
 	boolean EnumeratePorts (void);
 
+	int ResetPort (unsigned nPort);		// returns < 0 on hub failure, 0 on port failure
+
 	boolean StartStatusChangeRequest (void);
 	void CompletionRoutine (CUSBRequest *pURB);
 	static void CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext);
@@ -340,6 +340,7 @@ PACKED;
 #define XHCI_EVENT_TRB_STATUS_COMPLETION_CODE__MASK		(0xFF << 24)
 
 #define XHCI_TRANSFER_EVENT_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK	0xFFFFFF
+#define XHCI_TRANSFER_EVENT_TRB_CONTROL_ED				(1 << 2)
 #define XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__SHIFT		16
 #define XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__MASK		(0x1F << 16)
 #define XHCI_TRANSFER_EVENT_TRB_CONTROL_SLOTID__SHIFT			24
@@ -374,6 +375,7 @@ PACKED;
 #define XHCI_CMD_TRB_SET_TR_DEQUEUE_PTR_CONTROL_SLOTID__SHIFT	24
 
 // Transfer TRB
+#define XHCI_TRANSFER_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK	0x1FFFF
 #define XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT			17
 #define XHCI_TRANSFER_TRB_STATUS_TD_SIZE__MASK			(0x1F << 17)
 #define XHCI_TRANSFER_TRB_STATUS_INTERRUPTER_TARGET__SHIFT	22
@@ -386,11 +388,16 @@ PACKED;
 	#define XHCI_TRANSFER_TRB_CONTROL_TRT_OUT			2
 	#define XHCI_TRANSFER_TRB_CONTROL_TRT_IN			3
 
+#define XHCI_TRANSFER_TRB_CONTROL_ENT				(1 << 1)		// Event Data TRB
 #define XHCI_TRANSFER_TRB_CONTROL_ISP				(1 << 2)
+#define XHCI_TRANSFER_TRB_CONTROL_CH				(1 << 4)
 #define XHCI_TRANSFER_TRB_CONTROL_IOC				(1 << 5)
 #define XHCI_TRANSFER_TRB_CONTROL_IDT				(1 << 6)
 #define XHCI_TRANSFER_TRB_CONTROL_DIR_IN			(1 << 16)
 
+#define XHCI_TRANSFER_TRB_CONTROL_TLBPC__SHIFT			16		// Isoch TRB
+#define XHCI_TRANSFER_TRB_CONTROL_TLBPC__MASK			(0xF << 16)
+
 #define XHCI_TRANSFER_TRB_CONTROL_FRAME_ID__SHIFT		20		// Isoch TRB
 #define XHCI_TRANSFER_TRB_CONTROL_FRAME_ID__MASK		(0x7FF << 20)
 #define XHCI_TRANSFER_TRB_CONTROL_SIA				(1 << 31)
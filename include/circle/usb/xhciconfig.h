@@ -61,6 +61,7 @@
 #define XHCI_CONFIG_EVENT_RING_SIZE	256
 #define XHCI_CONFIG_CMD_RING_SIZE	64
 #define XHCI_CONFIG_TRANSFER_RING_SIZE	64
+#define XHCI_CONFIG_BULK_RING_SIZE	256		// large TDs are chained from many TRBs
 
 #define XHCI_CONFIG_IMODI		500		// defines maximum interrupt rate
 
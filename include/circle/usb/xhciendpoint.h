@@ -48,7 +48,9 @@ public:
 	boolean Transfer (CUSBRequest *pURB, unsigned nTimeoutMs);
 	boolean TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs);
 
-	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength);
+	// ullParameter: TRB pointer or Event Data, if bEventData is set
+	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+			    u64 ullParameter, boolean bEventData);
 
 	boolean ResetFromHalted (void);
 
@@ -60,8 +62,13 @@ private:
 	static void CompletionRoutine (CUSBRequest *pURB, void *pParam, void *pContext);
 
 	// Cycle bit and Interrupter Target are set automatically
+	// bDeferCycle: cycle bit is inverted, must be toggled by the caller to pass the TRB
 	boolean EnqueueTRB (u32 nControl, u32 nStatus = 0,
-			    u32 nParameter1 = 0, u32 nParameter2 = 0);
+			    u32 nParameter1 = 0, u32 nParameter2 = 0,
+			    boolean bDeferCycle = FALSE);
+
+	// length of the Normal TRB at nOffset, TRB buffers must not cross a 64K boundary
+	static u32 GetTRBLength (const void *pBuffer, u32 nBufLen, u32 nOffset);
 
 	TXHCIInputContext *GetInputContextSetMaxPacketSize (void);
 	TXHCIInputContext *GetInputContextConfigureEndpoint (void);
@@ -81,12 +88,15 @@ private:
 	u8		 m_uchEndpointAddress;
 	u8		 m_uchAttributes;
 	u16		 m_usMaxPacketSize;
+	u8		 m_uchMaxBurst;		// additional transactions per microframe
 	u8		 m_uchInterval;
 
 	u8		 m_uchEndpointID;
 	u8		 m_uchEndpointType;
 
 	CUSBRequest	*m_pURB[2];
+	u32		 m_nTDTag[2];		// Event Data of a chained TD
+	u32		 m_nTDSequence;
 	volatile boolean m_bTransferCompleted;
 
 	u8		*m_pInputContextBuffer;
@@ -46,6 +46,7 @@ public:
 
 private:
 	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+			    u64 ullParameter, boolean bEventData,
 			    u8 uchSlotID, u8 uchEndpointID);
 	friend class CXHCIEventManager;
 
@@ -46,7 +46,9 @@ public:
 
 	void RegisterEndpoint (u8 uchEndpointID, CXHCIEndpoint *pEndpoint);
 
-	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength, u8 uchEndpointID);
+	// ullParameter: TRB pointer or Event Data, if bEventData is set
+	void TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+			    u64 ullParameter, boolean bEventData, u8 uchEndpointID);
 
 #ifndef NDEBUG
 	void DumpStatus (void);
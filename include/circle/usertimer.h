@@ -53,6 +53,13 @@ public:
 	void Start (unsigned nDelayMicros);
 #define USER_CLOCKHZ	1000000U
 
+	/// \param nCompareValue User timer elapses, when GetCounter() reaches this value
+	/// \note Allows drift-free periodic timing, the value must be > GetCounter() + 1
+	void StartAt (u32 nCompareValue);
+
+	/// \return Current value of the free running counter (USER_CLOCKHZ)
+	static u32 GetCounter (void);
+
 private:
 	static void InterruptHandler (void *pParam);
 
@@ -67,19 +67,23 @@ int char2int (char chValue);			// with sign extension
 
 #define bswap16		__builtin_bswap16
 #define bswap32		__builtin_bswap32
+#define bswap64		__builtin_bswap64
 
 #else
 
 u16 bswap16 (u16 usValue);
 u32 bswap32 (u32 ulValue);
+u64 bswap64 (u64 ullValue);
 
 #endif
 
 #define le2be16		bswap16
 #define le2be32		bswap32
+#define le2be64		bswap64
 
 #define be2le16		bswap16
 #define be2le32		bswap32
+#define be2le64		bswap64
 
 #if !defined (__GNUC__) || (AARCH == 32 && STDLIB_SUPPORT == 0)
 	int parity32 (unsigned nValue);		// returns number of ones % 1
@@ -89,6 +93,20 @@ u32 bswap32 (u32 ulValue);
 
 u32 ether_crc (size_t nLength, const unsigned char *pData);
 
+#if AARCH == 64
+
+// Selects the variant of memset(), memcpy(), memmove(), memcmp() and strlen(),
+// which is optimized for the given CPU core. Must not be called before the MMU
+// is on. The NEON variants are only used, if SAVE_VFP_REGS_ON_IRQ and
+// SAVE_VFP_REGS_ON_FIQ are defined in sysconfig.h (default with GNU-C >= 12).
+#define MEMFUNC_CPU_GENERIC		0
+#define MEMFUNC_CPU_CORTEX_A53		1
+#define MEMFUNC_CPU_CORTEX_A72		2
+#define MEMFUNC_CPU_CORTEX_A76		3
+void memfunc_select (unsigned nCPU);
+
+#endif
+
 #ifdef __cplusplus
 }
 #endif
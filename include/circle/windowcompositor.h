@@ -0,0 +1,174 @@
+//
+// windowcompositor.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _circle_windowcompositor_h
+#define _circle_windowcompositor_h
+
+#include <circle/display.h>
+#include <circle/spinlock.h>
+#include <circle/types.h>
+
+#define WINDOW_COMPOSITOR_MAX_WINDOWS	16
+#define WINDOW_COMPOSITOR_MAX_DAMAGE	8
+
+class CCompositedWindow;
+
+class CWindowCompositor		/// Composes overlapping windows with off-screen surfaces on a display
+{
+public:
+	/// \param pDisplay The display the windows are displayed on
+	/// \param BackgroundColor Color of the areas, which are not covered by a window
+	/// \note Supported with a depth of 8, 16 or 32 bits only.
+	CWindowCompositor (CDisplay *pDisplay, CDisplay::TColor BackgroundColor = CDisplay::Black);
+
+	~CWindowCompositor (void);
+
+	/// \return Operation successful?
+	boolean Initialize (void);
+
+	/// \brief Copies the damaged regions of the screen to the display
+	/// \note Should be called once per frame (e.g. after waiting for the vertical sync).
+	void Update (void);
+
+	/// \return The display the windows are displayed on
+	CDisplay *GetDisplay (void) const;
+
+private:
+	friend class CCompositedWindow;
+
+	boolean AddWindow (CCompositedWindow *pWindow);
+	void RemoveWindow (CCompositedWindow *pWindow);
+
+	void RaiseWindow (CCompositedWindow *pWindow);
+	void LowerWindow (CCompositedWindow *pWindow);
+	void MoveWindow (CCompositedWindow *pWindow, unsigned nPosX, unsigned nPosY);
+	void ShowWindow (CCompositedWindow *pWindow, boolean bShow);
+
+	// area in screen coordinates, is clipped to the screen
+	void AddDamage (const CDisplay::TArea &rArea);
+	void AddDamageLocked (const CDisplay::TArea &rArea);
+
+	int FindWindow (CCompositedWindow *pWindow) const;
+
+	void Compose (const CDisplay::TArea &rArea);
+
+	static boolean Intersect (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2,
+				  CDisplay::TArea *pResult);
+	static boolean Contains (const CDisplay::TArea &rOuter, const CDisplay::TArea &rInner);
+
+private:
+	CDisplay *m_pDisplay;
+	CDisplay::TRawColor m_BackgroundColor;
+
+	unsigned m_nWidth;
+	unsigned m_nHeight;
+	unsigned m_nBytesPerPixel;
+
+	CCompositedWindow *m_pWindow[WINDOW_COMPOSITOR_MAX_WINDOWS];	// bottom first
+	unsigned m_nWindows;
+
+	CDisplay::TArea m_Damage[WINDOW_COMPOSITOR_MAX_DAMAGE];
+	unsigned m_nDamage;
+
+	u8 *m_pComposeBuffer;
+
+	CSpinLock m_SpinLock;
+};
+
+class CCompositedWindow : public CDisplay	/// Overlapping window with off-screen surface
+{
+public:
+	/// \param pCompositor The compositor, which displays this window
+	/// \param rArea Area on the display, which is covered by this window initially
+	/// \note The window is shown on top of the other windows.
+	CCompositedWindow (CWindowCompositor *pCompositor, const TArea &rArea);
+
+	~CCompositedWindow (void);
+
+	/// \return Number of horizontal pixels
+	unsigned GetWidth (void) const override;
+	/// \return Number of vertical pixels
+	unsigned GetHeight (void) const override;
+	/// \return Number of bits per pixel
+	unsigned GetDepth (void) const override;
+
+	/// \brief Set one pixel to physical color
+	/// \param nPosX X-position of pixel (0-based)
+	/// \param nPosY Y-position of pixel (0-based)
+	/// \param nColor Raw color value (must match the color model)
+	void SetPixel (unsigned nPosX, unsigned nPosY, TRawColor nColor) override;
+
+	/// \brief Set area (rectangle) on the display to the raw colors in pPixels
+	/// \param rArea Coordinates of the area (0-based)
+	/// \param pPixels Pointer to array with raw color values
+	/// \param pRoutine Routine to be called on completion (or nullptr for synchronous call)
+	/// \param pParam User parameter to be handed over to completion routine
+	/// \note The pixels are copied to the surface, the completion routine is called immediately.
+	void SetArea (const TArea &rArea, const void *pPixels,
+		      TAreaCompletionRoutine *pRoutine = nullptr,
+		      void *pParam = nullptr) override;
+
+	/// \return Parent display
+	CDisplay *GetParent (void) const override;
+	/// \return X-offset in pixels of this window in the parent display
+	unsigned GetOffsetX (void) const override;
+	/// \return Y-offset in pixels of this window in the parent display
+	unsigned GetOffsetY (void) const override;
+
+	/// \brief Move this window on top of the other windows
+	void Raise (void);
+	/// \brief Move this window below the other windows
+	void Lower (void);
+	/// \brief Move this window to a new position on the display
+	/// \param nPosX New X-offset in the parent display
+	/// \param nPosY New Y-offset in the parent display
+	void Move (unsigned nPosX, unsigned nPosY);
+	/// \param bShow Show (TRUE) or hide (FALSE) this window
+	void Show (boolean bShow = TRUE);
+
+	/// \return Is this window shown?
+	boolean IsShown (void) const;
+
+private:
+	friend class CWindowCompositor;
+
+	// area in screen coordinates
+	TArea GetScreenArea (void) const;
+
+	const u8 *GetLine (unsigned nPosY) const
+	{
+		return m_pSurface + nPosY * m_nPitch;
+	}
+
+private:
+	CWindowCompositor *m_pCompositor;
+
+	unsigned m_nPosX;
+	unsigned m_nPosY;
+	unsigned m_nWidth;
+	unsigned m_nHeight;
+
+	unsigned m_nBytesPerPixel;
+	unsigned m_nPitch;		// bytes
+	u8 *m_pSurface;
+
+	boolean m_bShown;
+};
+
+#endif
@@ -27,6 +27,7 @@ class CWindowDisplay : public CDisplay	/// Non-overlapping window on a display
 public:
 	/// \param pDisplay The display this window is displayed on
 	/// \param rArea Area on pDisplay, which is covered by this window
+	/// \note Use CCompositedWindow for overlapping windows.
 	CWindowDisplay (CDisplay *pDisplay, const TArea &rArea);
 
 	~CWindowDisplay (void);
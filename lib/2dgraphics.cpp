@@ -22,11 +22,169 @@
 //
 #include <circle/2dgraphics.h>
 #include <circle/screen.h>
+#include <circle/synchronize.h>
+#include <circle/sysconfig.h>
+#include <circle/timer.h>
 #include <circle/util.h>
 #include <assert.h>
 
 #define PTR_ADD(type, ptr, bytes)	((type) ((uintptr) (ptr) + (bytes)))
 
+// Two dirty areas are merged, if the union contains not more than this number of
+// unchanged pixels. This roughly costs as much as setting up a separate transfer.
+#define DIRTY_MERGE_SLACK		2048
+
+// Smaller operations are done by the CPU, because of the overhead of the DMA setup
+#define DMA_MIN_PIXELS			4096
+
+#ifdef SCREEN_DMA_BURST_LENGTH
+	#define DMA_BURST_LENGTH	SCREEN_DMA_BURST_LENGTH
+#else
+	#define DMA_BURST_LENGTH	0
+#endif
+
+// Pixels are blended and converted in chunks of this size via ARGB8888 on the stack
+#define ARGB_CHUNK_SIZE			64
+
+// The pixel kernels are written for u32 and v4u32 (4 pixels at once in a NEON register).
+typedef u32 v4u32 __attribute__ ((vector_size (16), aligned (4)));
+typedef u16 v4u16 __attribute__ ((vector_size (8), aligned (2)));
+
+// (x + 128) / 255 with exact rounding for x <= 255*255, in each 16-bit field
+template <typename T>
+static inline T Div255 (T x, u32 nMask)
+{
+	x += 0x800080 & nMask;
+
+	return ((x + ((x >> 8) & nMask)) >> 8) & nMask;
+}
+
+// alpha blend opaque ARGB8888 pixels, red and blue are processed together
+template <typename T>
+static inline T BlendARGB (T Src, T Dst, T Alpha)
+{
+	T InvAlpha = 255 - Alpha;
+
+	T RB = Div255<T> ((Src & 0xFF00FF) * Alpha + (Dst & 0xFF00FF) * InvAlpha, 0xFF00FF);
+	T G  = Div255<T> (((Src >> 8) & 0xFF) * Alpha + ((Dst >> 8) & 0xFF) * InvAlpha, 0xFF);
+
+	return 0xFF000000U | RB | (G << 8);
+}
+
+template <typename T>
+static inline T RGB565ToARGB (T Color)
+{
+	T R = (Color >> 11) & 0x1F;
+	T G = (Color >> 5) & 0x3F;
+	T B = Color & 0x1F;
+
+	return 0xFF000000U | ((R << 3 | R >> 2) << 16) | ((G << 2 | G >> 4) << 8) | (B << 3 | B >> 2);
+}
+
+template <typename T>
+static inline T ARGBToRGB565 (T Color)
+{
+	return ((Color >> 8) & 0xF800) | ((Color >> 5) & 0x7E0) | ((Color >> 3) & 0x1F);
+}
+
+template <typename T>
+static inline T Swap16 (T Color)
+{
+	return ((Color >> 8) | (Color << 8)) & 0xFFFF;
+}
+
+static void LoadRGB565 (u32 *pTo, const u16 *pFrom, unsigned nCount, boolean bSwap)
+{
+	unsigned i = 0;
+	for (; i + 4 <= nCount; i += 4)
+	{
+		v4u16 Raw = *(const v4u16 *) &pFrom[i];
+		v4u32 Color = {Raw[0], Raw[1], Raw[2], Raw[3]};
+		if (bSwap)
+		{
+			Color = Swap16<v4u32> (Color);
+		}
+
+		*(v4u32 *) &pTo[i] = RGB565ToARGB<v4u32> (Color);
+	}
+
+	for (; i < nCount; i++)
+	{
+		u32 Color = pFrom[i];
+		if (bSwap)
+		{
+			Color = Swap16<u32> (Color);
+		}
+
+		pTo[i] = RGB565ToARGB<u32> (Color);
+	}
+}
+
+static void StoreRGB565 (u16 *pTo, const u32 *pFrom, unsigned nCount, boolean bSwap)
+{
+	unsigned i = 0;
+	for (; i + 4 <= nCount; i += 4)
+	{
+		v4u32 Color = ARGBToRGB565<v4u32> (*(const v4u32 *) &pFrom[i]);
+		if (bSwap)
+		{
+			Color = Swap16<v4u32> (Color);
+		}
+
+		v4u16 Raw = {(u16) Color[0], (u16) Color[1], (u16) Color[2], (u16) Color[3]};
+		*(v4u16 *) &pTo[i] = Raw;
+	}
+
+	for (; i < nCount; i++)
+	{
+		u32 Color = ARGBToRGB565<u32> (pFrom[i]);
+		if (bSwap)
+		{
+			Color = Swap16<u32> (Color);
+		}
+
+		pTo[i] = (u16) Color;
+	}
+}
+
+static void LoadRGB888 (u32 *pTo, const u8 *pFrom, unsigned nCount)
+{
+	for (unsigned i = 0; i < nCount; i++, pFrom += 3)
+	{
+		pTo[i] = 0xFF000000U | pFrom[0] << 16 | pFrom[1] << 8 | pFrom[2];
+	}
+}
+
+// pDst = pSrc blended over pDst, nAlpha is multiplied with the alpha of each pixel,
+// if bPixelAlpha is TRUE
+static void BlendPixels (u32 *pDst, const u32 *pSrc, unsigned nCount, unsigned nAlpha,
+			 boolean bPixelAlpha)
+{
+	unsigned i = 0;
+	for (; i + 4 <= nCount; i += 4)
+	{
+		v4u32 Src = *(const v4u32 *) &pSrc[i];
+		v4u32 Alpha = {nAlpha, nAlpha, nAlpha, nAlpha};
+		if (bPixelAlpha)
+		{
+			Alpha = Div255<v4u32> ((Src >> 24) * nAlpha, 0xFF);
+		}
+
+		*(v4u32 *) &pDst[i] = BlendARGB<v4u32> (Src, *(v4u32 *) &pDst[i], Alpha);
+	}
+
+	for (; i < nCount; i++)
+	{
+		u32 Alpha = nAlpha;
+		if (bPixelAlpha)
+		{
+			Alpha = Div255<u32> ((pSrc[i] >> 24) * nAlpha, 0xFF);
+		}
+
+		pDst[i] = BlendARGB<u32> (pSrc[i], pDst[i], Alpha);
+	}
+}
+
 //// C2DImage //////////////////////////////////////////////////////////////////
 
 C2DImage::C2DImage (C2DGraphics *p2DGraphics)
@@ -137,8 +295,25 @@ C2DGraphics::C2DGraphics (CDisplay *pDisplay)
 	m_pFrameBuffer(0),
 	m_bIsFrameBuffer(FALSE),
 	m_pBuffer8(0),
-	m_bVSync(FALSE)
+	m_bVSync(FALSE),
+	m_bTripleBuffering(FALSE),
+	m_nPages(1),
+	m_nVisiblePage(0),
+	m_bRawAccess(FALSE),
+	m_pUpdateBuffer(0),
+	m_nUpdateBufferSize(0),
+	m_pDMAChannel(0),
+	m_bDMAActive(FALSE),
+	m_nRefreshPeriod(0),
+	m_nLastUpdateTicks(0)
 {
+	m_DirtyAreas.nCount = 0;
+	for (unsigned i = 0; i < C2DGRAPHICS_MAX_PAGES-1; i++)
+	{
+		m_PrevDirtyAreas[i].nCount = 0;
+	}
+
+	ResetFrameStats ();
 }
 
 C2DGraphics::C2DGraphics (unsigned nWidth, unsigned nHeight, boolean bVSync, unsigned nDisplay)
@@ -151,14 +326,33 @@ C2DGraphics::C2DGraphics (unsigned nWidth, unsigned nHeight, boolean bVSync, uns
 	m_bIsFrameBuffer(TRUE),
 	m_pBuffer8(0),
 	m_bVSync(bVSync),
-	m_bBufferSwapped(TRUE)
+	m_bTripleBuffering(FALSE),
+	m_nPages(2),
+	m_nVisiblePage(0),
+	m_bRawAccess(FALSE),
+	m_pUpdateBuffer(0),
+	m_nUpdateBufferSize(0),
+	m_pDMAChannel(0),
+	m_bDMAActive(FALSE),
+	m_nRefreshPeriod(0),
+	m_nLastUpdateTicks(0)
 {
+	m_DirtyAreas.nCount = 0;
+	for (unsigned i = 0; i < C2DGRAPHICS_MAX_PAGES-1; i++)
+	{
+		m_PrevDirtyAreas[i].nCount = 0;
+	}
 
+	ResetFrameStats ();
 }
 
 C2DGraphics::~C2DGraphics (void)
 {
+	WaitForDMA ();
+	delete m_pDMAChannel;
+
 	delete [] m_pBuffer8;
+	delete [] m_pUpdateBuffer;
 
 	if(m_pFrameBuffer)
 	{
@@ -166,13 +360,21 @@ C2DGraphics::~C2DGraphics (void)
 	}
 }
 
+void C2DGraphics::EnableTripleBuffering (void)
+{
+	assert (m_pBuffer8 == 0);	// must be called before Initialize()
+
+	m_bTripleBuffering = TRUE;
+}
+
 boolean C2DGraphics::Initialize (void)
 {
 	if (m_bIsFrameBuffer)
 	{
 #if RASPPI <= 4
+		m_nPages = m_bVSync && m_bTripleBuffering ? 3 : 2;
 		m_pFrameBuffer = new CBcmFrameBuffer (m_nWidth, m_nHeight, DEPTH,
-						      m_nWidth, 2*m_nHeight, m_nDisplay, TRUE);
+						      m_nWidth, m_nPages*m_nHeight, m_nDisplay, TRUE);
 #else
 		m_pFrameBuffer = new CBcmFrameBuffer (m_nWidth, m_nHeight, DEPTH,
 						      0, 0, m_nDisplay, FALSE);
@@ -220,13 +422,80 @@ boolean C2DGraphics::Initialize (void)
 		return FALSE;
 	}
 
+	// the display has an undefined content initially
+	MarkAllDirty (&m_DirtyAreas);
+	for (unsigned i = 0; i < C2DGRAPHICS_MAX_PAGES-1; i++)
+	{
+		MarkAllDirty (&m_PrevDirtyAreas[i]);
+	}
+
+	m_nVisiblePage = 0;
+
+#if RASPPI <= 4
+	if (m_bVSync)
+	{
+		assert (m_pFrameBuffer != 0);
+
+		// measure the refresh period for frame pacing
+		m_nRefreshPeriod = 0;
+		if (m_pFrameBuffer->WaitForVerticalSync ())
+		{
+			unsigned nStartTicks = CTimer::GetClockTicks ();
+
+			if (m_pFrameBuffer->WaitForVerticalSync ())
+			{
+				m_nRefreshPeriod = CTimer::GetClockTicks () - nStartTicks;
+			}
+		}
+	}
+#endif
+
+	ResetFrameStats ();
+
 	return TRUE;
 }
 
+void C2DGraphics::EnableDMA (void)
+{
+	assert (m_pBuffer8 != 0);
+
+	if (   m_pDMAChannel != 0
+	    || m_nDepth == 1)
+	{
+		return;
+	}
+
+	// the drawing buffer may be above the range of the legacy DMA controller
+#if RASPPI >= 4
+	m_pDMAChannel = new CDMAChannel (DMA_CHANNEL_EXTENDED);
+#else
+	m_pDMAChannel = new CDMAChannel (DMA_CHANNEL_NORMAL);
+#endif
+	assert (m_pDMAChannel != 0);
+}
+
+void C2DGraphics::WaitForDMA (void)
+{
+	if (!m_bDMAActive)
+	{
+		return;
+	}
+
+	assert (m_pDMAChannel != 0);
+	m_pDMAChannel->Wait ();
+
+	// discard cache lines, which may have been loaded speculatively meanwhile
+	CleanAndInvalidateDataCacheRange (m_nDMADestination, m_nDMALength);
+
+	m_bDMAActive = FALSE;
+}
+
 boolean C2DGraphics::Resize (unsigned nWidth, unsigned nHeight)
 {
 	assert (m_bIsFrameBuffer);	// does work with frame buffer only
 
+	WaitForDMA ();
+
 	delete m_pFrameBuffer;
 	m_pFrameBuffer = 0;
 
@@ -235,7 +504,6 @@ boolean C2DGraphics::Resize (unsigned nWidth, unsigned nHeight)
 
 	delete [] m_pBuffer8;
 	m_pBuffer8 = 0;
-	m_bBufferSwapped = TRUE;
 
 	return Initialize ();
 }
@@ -262,7 +530,21 @@ void C2DGraphics::DrawRect (unsigned nX, unsigned nY, unsigned nWidth, unsigned
 		return;
 	}
 
+	if(nWidth == 0 || nHeight == 0)
+	{
+		return;
+	}
+
+	MarkDirty (nX, nY, nX + nWidth-1, nY + nHeight-1);
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
+
+	if (DMAFill (nX, nY, nWidth, nHeight, nColor))
+	{
+		return;
+	}
+
+	WaitForDMA ();
 	
 	for(unsigned i = nY; i < nY + nHeight; i++)
 	{
@@ -293,6 +575,11 @@ void C2DGraphics::DrawLine (unsigned nX1, unsigned nY1, unsigned nX2, unsigned n
 		return;
 	}
 	
+	MarkDirty (nX1 < nX2 ? nX1 : nX2, nY1 < nY2 ? nY1 : nY2,
+		   nX1 > nX2 ? nX1 : nX2, nY1 > nY2 ? nY1 : nY2);
+
+	WaitForDMA ();
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
 
 	int dx = nX2 - nX1;
@@ -343,6 +630,10 @@ void C2DGraphics::DrawCircle (unsigned nX, unsigned nY, unsigned nRadius, T2DCol
 		return;
 	}
 	
+	MarkDirty (nX - nRadius, nY - nRadius, nX + nRadius, nY + nRadius);
+
+	WaitForDMA ();
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
 
 	int r2 = nRadius * nRadius;
@@ -368,6 +659,10 @@ void C2DGraphics::DrawCircleOutline (unsigned nX, unsigned nY, unsigned nRadius,
 		return;
 	}
 
+	MarkDirty (nX - nRadius, nY - nRadius, nX + nRadius, nY + nRadius);
+
+	WaitForDMA ();
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
 
 	SetPixel (nRadius + nX, nY, nColor);
@@ -428,14 +723,23 @@ void C2DGraphics::DrawImageTransparent (unsigned nX, unsigned nY, unsigned nWidt
 
 void C2DGraphics::DrawImageRect (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight, unsigned nSourceX, unsigned nSourceY, const void *PixelBuffer)
 {
-	if(nX + nWidth > m_nWidth || nY + nHeight > m_nHeight)
+	if(nX + nWidth > m_nWidth || nY + nHeight > m_nHeight || nWidth == 0 || nHeight == 0)
 	{
 		return;
 	}
+
+	MarkDirty (nX, nY, nX + nWidth-1, nY + nHeight-1);
 	
 	PixelBuffer = PTR_ADD (const void *, PixelBuffer,
 			       (nSourceY * nWidth + nSourceX) * m_nDepth/8);
 
+	if (DMACopy (nX, nY, nWidth, nHeight, PixelBuffer))
+	{
+		return;
+	}
+
+	WaitForDMA ();
+
 	for(unsigned i=0; i<nHeight; i++)
 	{
 		for(unsigned j=0; j<nWidth; j++)
@@ -447,10 +751,14 @@ void C2DGraphics::DrawImageRect (unsigned nX, unsigned nY, unsigned nWidth, unsi
 
 void C2DGraphics::DrawImageRectTransparent (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight, unsigned nSourceX, unsigned nSourceY, unsigned nSourceWidth, unsigned nSourceHeight, const void *PixelBuffer, T2DColor TransparentColor)
 {
-	if(nX + nWidth > m_nWidth || nY + nHeight > m_nHeight || nSourceX + nWidth > nSourceWidth || nSourceY + nHeight > nSourceHeight)
+	if(nX + nWidth > m_nWidth || nY + nHeight > m_nHeight || nSourceX + nWidth > nSourceWidth || nSourceY + nHeight > nSourceHeight || nWidth == 0 || nHeight == 0)
 	{
 		return;
 	}
+
+	MarkDirty (nX, nY, nX + nWidth-1, nY + nHeight-1);
+
+	WaitForDMA ();
 	
 	for(unsigned i=0; i<nHeight; i++)
 	{
@@ -469,6 +777,123 @@ void C2DGraphics::DrawImageRectTransparent (unsigned nX, unsigned nY, unsigned n
 	}
 }
 
+void C2DGraphics::DrawImageConvert (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				    const void *pPixels, TImageFormat Format)
+{
+	DrawImageARGB (nX, nY, nWidth, nHeight, pPixels, Format, 255, FALSE);
+}
+
+void C2DGraphics::DrawImageBlend (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				  const void *pPixels, TImageFormat Format, u8 uchAlpha)
+{
+	DrawImageARGB (nX, nY, nWidth, nHeight, pPixels, Format, uchAlpha, TRUE);
+}
+
+void C2DGraphics::DrawImageARGB (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+				 const void *pPixels, TImageFormat Format, unsigned nAlpha,
+				 boolean bBlend)
+{
+	if(nX + nWidth > m_nWidth || nY + nHeight > m_nHeight || nWidth == 0 || nHeight == 0)
+	{
+		return;
+	}
+
+	CDisplay::TColorModel ColorModel = m_pDisplay->GetColorModel ();
+	if (   ColorModel != CDisplay::RGB565
+	    && ColorModel != CDisplay::RGB565_BE
+	    && ColorModel != CDisplay::ARGB8888)
+	{
+		return;
+	}
+
+	if (   bBlend
+	    && nAlpha == 0)
+	{
+		return;
+	}
+
+	MarkDirty (nX, nY, nX + nWidth-1, nY + nHeight-1);
+
+	WaitForDMA ();
+
+	static const unsigned SourceSize[] = {2, 3, 4};
+	size_t nSourcePitch = nWidth * SourceSize[Format];
+	size_t nPitch = m_nWidth * m_nDepth/8;
+	boolean bSwap = ColorModel == CDisplay::RGB565_BE;
+
+	// blending of opaque pixels with full alpha is a conversion only
+	boolean bPixelAlpha = Format == ImageFormatARGB8888;
+	if (   !bPixelAlpha
+	    && nAlpha == 255)
+	{
+		bBlend = FALSE;
+	}
+
+	u32 Source[ARGB_CHUNK_SIZE];
+	u32 Destination[ARGB_CHUNK_SIZE];
+
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		const u8 *pFrom = (const u8 *) pPixels + y * nSourcePitch;
+		u8 *pTo = m_pBuffer8 + (nY + y) * nPitch + nX * m_nDepth/8;
+
+		for (unsigned x = 0; x < nWidth; x += ARGB_CHUNK_SIZE)
+		{
+			unsigned nCount = nWidth - x;
+			if (nCount > ARGB_CHUNK_SIZE)
+			{
+				nCount = ARGB_CHUNK_SIZE;
+			}
+
+			const u32 *pSource = Source;
+			switch (Format)
+			{
+			case ImageFormatRGB565:
+				LoadRGB565 (Source, (const u16 *) pFrom + x, nCount, FALSE);
+				break;
+
+			case ImageFormatRGB888:
+				LoadRGB888 (Source, pFrom + x*3, nCount);
+				break;
+
+			case ImageFormatARGB8888:
+				pSource = (const u32 *) pFrom + x;
+				break;
+			}
+
+			if (ColorModel == CDisplay::ARGB8888)
+			{
+				u32 *pTo32 = (u32 *) pTo + x;
+
+				if (bBlend)
+				{
+					BlendPixels (pTo32, pSource, nCount, nAlpha, bPixelAlpha);
+				}
+				else
+				{
+					for (unsigned i = 0; i < nCount; i++)
+					{
+						pTo32[i] = pSource[i] | 0xFF000000U;
+					}
+				}
+			}
+			else
+			{
+				u16 *pTo16 = (u16 *) pTo + x;
+
+				if (bBlend)
+				{
+					LoadRGB565 (Destination, pTo16, nCount, bSwap);
+					BlendPixels (Destination, pSource, nCount, nAlpha, bPixelAlpha);
+					pSource = Destination;
+				}
+
+				StoreRGB565 (pTo16, pSource, nCount, bSwap);
+			}
+		}
+	}
+}
+
 void C2DGraphics::DrawPixel (unsigned nX, unsigned nY, T2DColor Color)
 {
 	if(nX >= m_nWidth || nY >= m_nHeight)
@@ -476,6 +901,10 @@ void C2DGraphics::DrawPixel (unsigned nX, unsigned nY, T2DColor Color)
 		return;
 	}
 
+	MarkDirty (nX, nY, nX, nY);
+
+	WaitForDMA ();
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
 
 	SetPixel (nX, nY, nColor);
@@ -499,11 +928,16 @@ void C2DGraphics::DrawText (unsigned nX, unsigned nY, T2DColor Color, const char
 
 	if (   nX > m_nWidth
 	    || nX + nWidth > m_nWidth
-	    || nY + Font.GetUnderline () > m_nHeight)
+	    || nY + Font.GetUnderline () > m_nHeight
+	    || nWidth == 0)
 	{
 		return;
 	}
 
+	MarkDirty (nX, nY, nX + nWidth-1, nY + Font.GetUnderline ()-1);
+
+	WaitForDMA ();
+
 	CDisplay::TRawColor nColor = m_pDisplay->GetColor (Color);
 
 	for (; *pText != '\0'; pText++, nX += Font.GetCharWidth ())
@@ -525,6 +959,10 @@ void C2DGraphics::DrawText (unsigned nX, unsigned nY, T2DColor Color, const char
 
 void *C2DGraphics::GetBuffer (void)
 {
+	WaitForDMA ();
+
+	m_bRawAccess = TRUE;
+
 	return m_pBuffer8;
 }
 
@@ -535,29 +973,336 @@ CDisplay *C2DGraphics::GetDisplay (void)
 
 void C2DGraphics::UpdateDisplay (void)
 {
+	if (m_bRawAccess)
+	{
+		MarkAllDirty (&m_DirtyAreas);
+	}
+
+	WaitForDMA ();
+
 #if RASPPI <= 4
 	if(m_bVSync)
 	{
-		unsigned nBaseHeight = m_bBufferSwapped ? m_nHeight : 0;
-		CDisplay::TArea Area {0, m_nWidth-1, nBaseHeight, nBaseHeight + m_nHeight-1};
+		assert (2 <= m_nPages && m_nPages <= C2DGRAPHICS_MAX_PAGES);
+		unsigned nPage = (m_nVisiblePage + 1) % m_nPages;
+
+		// the hidden page has missed the changes of the previous frames
+		TDirtyAreas Areas = m_DirtyAreas;
+		for (unsigned j = 0; j < m_nPages-1; j++)
+		{
+			for (unsigned i = 0; i < m_PrevDirtyAreas[j].nCount; i++)
+			{
+				AddDirtyArea (&Areas, m_PrevDirtyAreas[j].Area[i]);
+			}
+		}
+
+		// With triple buffering the new page is the one, which was visible before the
+		// previous flip. It may still be scanned out, until this flip has been latched
+		// at the next vertical blank, which must have happened after a refresh period.
+		if (   m_nPages > 2
+		    && (   m_nRefreshPeriod == 0
+			|| CTimer::GetClockTicks () - m_nLastUpdateTicks < m_nRefreshPeriod))
+		{
+			m_pFrameBuffer->WaitForVerticalSync();
+		}
+
+		FlushDirtyAreas (m_pFrameBuffer, Areas, nPage * m_nHeight);
 
-		m_pFrameBuffer->WaitForVerticalSync();
-		m_pFrameBuffer->SetArea (Area, m_pBuffer8);
-		m_pFrameBuffer->SetVirtualOffset(0, m_bBufferSwapped ? m_nHeight : 0);
-		m_bBufferSwapped = !m_bBufferSwapped;
+		// with double buffering wait for the flip in the same mailbox transaction,
+		// so that the other page is not displayed any more afterwards
+		m_pFrameBuffer->SetVirtualOffset(0, nPage * m_nHeight, m_nPages == 2);
+		m_nVisiblePage = nPage;
+
+		for (unsigned j = m_nPages-2; j > 0; j--)
+		{
+			m_PrevDirtyAreas[j] = m_PrevDirtyAreas[j-1];
+		}
+		m_PrevDirtyAreas[0] = m_DirtyAreas;
 	}
 	else
 #endif
 	{
-		CDisplay::TArea Area {0, m_nWidth-1, 0, m_nHeight-1};
+		FlushDirtyAreas (m_pDisplay ? m_pDisplay : m_pFrameBuffer, m_DirtyAreas, 0);
+	}
+
+	UpdateFrameStats ();
+
+	m_DirtyAreas.nCount = 0;
+}
+
+void C2DGraphics::GetFrameStats (TFrameStats *pStats) const
+{
+	assert (pStats != 0);
+	*pStats = m_FrameStats;
+
+	if (m_FrameStats.nFrames > 1)
+	{
+		pStats->nAvgFrameTime = (unsigned) (m_ullFrameTimeSum / (m_FrameStats.nFrames-1));
+	}
+}
+
+void C2DGraphics::ResetFrameStats (void)
+{
+	memset (&m_FrameStats, 0, sizeof m_FrameStats);
+	m_FrameStats.nRefreshPeriod = m_nRefreshPeriod;
+
+	m_ullFrameTimeSum = 0;
+}
+
+void C2DGraphics::UpdateFrameStats (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	if (m_FrameStats.nFrames++ > 0)
+	{
+		unsigned nFrameTime = nTicks - m_nLastUpdateTicks;
+
+		m_FrameStats.nLastFrameTime = nFrameTime;
+		if (m_FrameStats.nMaxFrameTime < nFrameTime)
+		{
+			m_FrameStats.nMaxFrameTime = nFrameTime;
+		}
+
+		m_ullFrameTimeSum += nFrameTime;
 
-		if (!m_pDisplay)
+		// frames are shown on vertical blanks only with VSync
+		if (   m_bVSync
+		    && m_nRefreshPeriod != 0)
 		{
-			m_pFrameBuffer->SetArea (Area, m_pBuffer8);
+			unsigned nPeriods = (nFrameTime + m_nRefreshPeriod/2) / m_nRefreshPeriod;
+			if (nPeriods > 1)
+			{
+				m_FrameStats.nMissedVSyncs += nPeriods - 1;
+			}
+		}
+	}
+
+	m_nLastUpdateTicks = nTicks;
+}
+
+void C2DGraphics::MarkDirty (unsigned nX1, unsigned nY1, unsigned nX2, unsigned nY2)
+{
+	assert (nX1 <= nX2 && nX2 < m_nWidth);
+	assert (nY1 <= nY2 && nY2 < m_nHeight);
+
+	// areas must start and end on a byte boundary
+	if (m_nDepth == 1)
+	{
+		nX1 &= ~7;
+		nX2 |= 7;
+	}
+
+	CDisplay::TArea Area {nX1, nX2, nY1, nY2};
+
+	AddDirtyArea (&m_DirtyAreas, Area);
+}
+
+void C2DGraphics::MarkAllDirty (TDirtyAreas *pAreas)
+{
+	assert (pAreas != 0);
+	assert (m_nWidth > 0 && m_nHeight > 0);
+
+	pAreas->nCount = 1;
+	pAreas->Area[0] = {0, m_nWidth-1, 0, m_nHeight-1};
+}
+
+void C2DGraphics::AddDirtyArea (TDirtyAreas *pAreas, const CDisplay::TArea &rArea)
+{
+	assert (pAreas != 0);
+
+	CDisplay::TArea NewArea = rArea;
+
+	// merge with all areas, where this is cheaper than a separate update
+	unsigned i = 0;
+	while (i < pAreas->nCount)
+	{
+		if (GetMergeCost (pAreas->Area[i], NewArea) <= DIRTY_MERGE_SLACK)
+		{
+			NewArea = GetUnion (pAreas->Area[i], NewArea);
+
+			pAreas->Area[i] = pAreas->Area[--pAreas->nCount];
+
+			i = 0;		// the grown area may overlap with others now
 		}
 		else
 		{
-			m_pDisplay->SetArea (Area, m_pBuffer8);
+			i++;
+		}
+	}
+
+	// list is full, merge with the area, which gives the smallest overhead
+	if (pAreas->nCount == C2DGRAPHICS_MAX_DIRTY_AREAS)
+	{
+		unsigned nBest = 0;
+		int nBestCost = GetMergeCost (pAreas->Area[0], NewArea);
+		for (i = 1; i < pAreas->nCount; i++)
+		{
+			int nCost = GetMergeCost (pAreas->Area[i], NewArea);
+			if (nCost < nBestCost)
+			{
+				nBest = i;
+				nBestCost = nCost;
+			}
 		}
+
+		NewArea = GetUnion (pAreas->Area[nBest], NewArea);
+
+		pAreas->Area[nBest] = pAreas->Area[--pAreas->nCount];
 	}
+
+	pAreas->Area[pAreas->nCount++] = NewArea;
+}
+
+int C2DGraphics::GetMergeCost (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2)
+{
+	CDisplay::TArea Union = GetUnion (rArea1, rArea2);
+
+	// overlapping pixels are counted twice, which makes the cost negative
+	return   (int) ((Union.x2 - Union.x1 + 1) * (Union.y2 - Union.y1 + 1))
+	       - (int) ((rArea1.x2 - rArea1.x1 + 1) * (rArea1.y2 - rArea1.y1 + 1))
+	       - (int) ((rArea2.x2 - rArea2.x1 + 1) * (rArea2.y2 - rArea2.y1 + 1));
+}
+
+CDisplay::TArea C2DGraphics::GetUnion (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2)
+{
+	CDisplay::TArea Union {rArea1.x1 < rArea2.x1 ? rArea1.x1 : rArea2.x1,
+			       rArea1.x2 > rArea2.x2 ? rArea1.x2 : rArea2.x2,
+			       rArea1.y1 < rArea2.y1 ? rArea1.y1 : rArea2.y1,
+			       rArea1.y2 > rArea2.y2 ? rArea1.y2 : rArea2.y2};
+
+	return Union;
+}
+
+void C2DGraphics::FlushDirtyAreas (CDisplay *pDisplay, const TDirtyAreas &rAreas, unsigned nOffsetY)
+{
+	assert (pDisplay != 0);
+
+	size_t nPitch = m_nWidth * m_nDepth/8;
+
+	for (unsigned i = 0; i < rAreas.nCount; i++)
+	{
+		const CDisplay::TArea &rArea = rAreas.Area[i];
+
+		CDisplay::TArea Area {rArea.x1, rArea.x2, rArea.y1 + nOffsetY, rArea.y2 + nOffsetY};
+
+		const u8 *pFrom = m_pBuffer8 + rArea.y1 * nPitch + rArea.x1 * m_nDepth/8;
+
+		// full width areas are contiguous in the buffer
+		if (   rArea.x1 == 0
+		    && rArea.x2 == m_nWidth-1)
+		{
+			pDisplay->SetArea (Area, pFrom);
+
+			continue;
+		}
+
+		unsigned nLines = rArea.y2 - rArea.y1 + 1;
+		size_t nLineSize = (rArea.x2 - rArea.x1 + 1) * m_nDepth/8;
+		size_t nSize = nLineSize * nLines;
+
+		if (nSize > m_nUpdateBufferSize)
+		{
+			delete [] m_pUpdateBuffer;
+
+			m_pUpdateBuffer = new u8[nSize];
+			assert (m_pUpdateBuffer != 0);
+			m_nUpdateBufferSize = nSize;
+		}
+
+		u8 *pTo = m_pUpdateBuffer;
+		for (unsigned y = 0; y < nLines; y++)
+		{
+			memcpy (pTo, pFrom, nLineSize);
+
+			pTo += nLineSize;
+			pFrom += nPitch;
+		}
+
+		pDisplay->SetArea (Area, m_pUpdateBuffer);
+	}
+}
+
+boolean C2DGraphics::DMAFill (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			      CDisplay::TRawColor nColor)
+{
+	u32 nPattern;
+	switch (m_nDepth)
+	{
+	case 8:		nPattern = (nColor & 0xFF) * 0x01010101U;	break;
+	case 16:	nPattern = (nColor & 0xFFFF) * 0x00010001U;	break;
+	case 32:	nPattern = nColor;				break;
+
+	default:
+		return FALSE;
+	}
+
+	u8 *pDestination = PrepareDMA (nX, nY, nWidth, nHeight);
+	if (!pDestination)
+	{
+		return FALSE;
+	}
+
+	size_t nBlockLength = nWidth * m_nDepth/8;
+
+	assert (m_pDMAChannel != 0);
+	m_pDMAChannel->SetupMemFill2D (pDestination, nPattern, nBlockLength, nHeight,
+				       m_nWidth * m_nDepth/8 - nBlockLength, DMA_BURST_LENGTH);
+	m_pDMAChannel->Start ();
+
+	m_bDMAActive = TRUE;
+
+	return TRUE;
+}
+
+boolean C2DGraphics::DMACopy (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight,
+			      const void *pPixels)
+{
+	u8 *pDestination = PrepareDMA (nX, nY, nWidth, nHeight);
+	if (!pDestination)
+	{
+		return FALSE;
+	}
+
+	size_t nBlockLength = nWidth * m_nDepth/8;
+
+	// the source cache is cleaned by SetupMemCopy2D()
+	assert (m_pDMAChannel != 0);
+	m_pDMAChannel->SetupMemCopy2D (pDestination, pPixels, nBlockLength, nHeight,
+				       m_nWidth * m_nDepth/8 - nBlockLength, DMA_BURST_LENGTH);
+	m_pDMAChannel->Start ();
+
+	m_bDMAActive = TRUE;
+
+	return TRUE;
+}
+
+u8 *C2DGraphics::PrepareDMA (unsigned nX, unsigned nY, unsigned nWidth, unsigned nHeight)
+{
+	if (   !m_pDMAChannel
+	    || m_nDepth == 1
+	    || nWidth * nHeight < DMA_MIN_PIXELS)
+	{
+		return 0;
+	}
+
+	size_t nPitch = m_nWidth * m_nDepth/8;
+	size_t nBlockLength = nWidth * m_nDepth/8;
+	if (   nBlockLength > 0xFFFF
+	    || nHeight > 0x3FFF
+	    || nPitch - nBlockLength > 0xFFFF)
+	{
+		return 0;
+	}
+
+	// only one operation can be active at a time
+	WaitForDMA ();
+
+	u8 *pDestination = m_pBuffer8 + nY * nPitch + nX * m_nDepth/8;
+
+	// the CPU does not write to the buffer, until the DMA has completed
+	m_nDMADestination = (uintptr) pDestination;
+	m_nDMALength = (nHeight-1) * nPitch + nBlockLength;
+	CleanAndInvalidateDataCacheRange (m_nDMADestination, m_nDMALength);
+
+	return pDestination;
 }
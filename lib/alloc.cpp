@@ -25,13 +25,15 @@
 
 void *malloc (size_t nSize)
 {
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC,
+					    (uintptr) __builtin_return_address (0));
 }
 
 void *memalign (size_t nAlign, size_t nSize)
 {
 	assert (nAlign <= HEAP_BLOCK_ALIGN);
-	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	return CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC,
+					    (uintptr) __builtin_return_address (0));
 }
 
 void free (void *pBlock)
@@ -48,7 +50,8 @@ void *calloc (size_t nBlocks, size_t nSize)
 	}
 	assert (nSize >= nBlocks);
 
-	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC);
+	void *pNewBlock = CMemorySystem::HeapAllocate (nSize, HEAP_DEFAULT_MALLOC,
+						       (uintptr) __builtin_return_address (0));
 	if (pNewBlock != 0)
 	{
 		memset (pNewBlock, 0, nSize);
@@ -59,7 +62,14 @@ void *calloc (size_t nBlocks, size_t nSize)
 
 void *realloc (void *pBlock, size_t nSize)
 {
-	return CMemorySystem::HeapReAllocate (pBlock, nSize);
+	return CMemorySystem::HeapReAllocate (pBlock, nSize,
+					      (uintptr) __builtin_return_address (0));
+}
+
+void *dma_alloc_coherent (size_t nSize)
+{
+	return CMemorySystem::HeapAllocate (nSize, HEAP_COHERENT,
+					    (uintptr) __builtin_return_address (0));
 }
 
 void *palloc (void)
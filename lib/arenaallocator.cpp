@@ -0,0 +1,147 @@
+//
+// arenaallocator.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/arenaallocator.h>
+#include <circle/alloc.h>
+#include <circle/memorymap.h>
+#include <circle/macros.h>
+#include <assert.h>
+
+CArenaAllocator::CArenaAllocator (void)
+:	m_pFirstPage (0),
+	m_pLargeBlocks (0),
+	m_pNext (0),
+	m_pLimit (0),
+	m_nUsedSize (0)
+{
+}
+
+CArenaAllocator::~CArenaAllocator (void)
+{
+	FreePages ();
+}
+
+void *CArenaAllocator::Allocate (size_t nSize, size_t nAlign)
+{
+	assert (IS_POWEROF_2 (nAlign));
+
+	uintptr nBlock = ((uintptr) m_pNext + nAlign-1) & ~(nAlign-1);
+	if (   m_pNext == 0
+	    || nBlock + nSize > (uintptr) m_pLimit)
+	{
+		// blocks, which would fill more than a quarter of a page, go to the heap
+		if (nSize + nAlign > PAGE_SIZE / 4)
+		{
+			TArenaPage *pBlock = (TArenaPage *) malloc (sizeof (TArenaPage) + nAlign-1 + nSize);
+			if (pBlock == 0)
+			{
+				return 0;
+			}
+
+			pBlock->pNext = m_pLargeBlocks;
+			m_pLargeBlocks = pBlock;
+
+			m_nUsedSize += nSize;
+
+			return (void *) (((uintptr) pBlock + sizeof (TArenaPage) + nAlign-1) & ~(nAlign-1));
+		}
+
+		// the next page follows the current one in the list, the first page is kept
+		TArenaPage *pPage;
+		if (   m_pFirstPage != 0
+		    && m_pNext == 0)
+		{
+			pPage = m_pFirstPage;
+		}
+		else
+		{
+			pPage = (TArenaPage *) palloc ();
+			if (pPage == 0)
+			{
+				return 0;
+			}
+
+			if (m_pFirstPage == 0)
+			{
+				pPage->pNext = 0;
+				m_pFirstPage = pPage;
+			}
+			else
+			{
+				pPage->pNext = m_pFirstPage->pNext;
+				m_pFirstPage->pNext = pPage;
+			}
+		}
+
+		m_pNext = (u8 *) pPage + sizeof (TArenaPage);
+		m_pLimit = (u8 *) pPage + PAGE_SIZE;
+
+		nBlock = ((uintptr) m_pNext + nAlign-1) & ~(nAlign-1);
+		assert (nBlock + nSize <= (uintptr) m_pLimit);
+	}
+
+	m_pNext = (u8 *) (nBlock + nSize);
+	m_nUsedSize += nSize;
+
+	return (void *) nBlock;
+}
+
+void CArenaAllocator::Reset (void)
+{
+	// keep the first page, free all others
+	if (m_pFirstPage != 0)
+	{
+		TArenaPage *pPage = m_pFirstPage->pNext;
+		while (pPage != 0)
+		{
+			TArenaPage *pNext = pPage->pNext;
+
+			pfree (pPage);
+
+			pPage = pNext;
+		}
+
+		m_pFirstPage->pNext = 0;
+	}
+
+	while (m_pLargeBlocks != 0)
+	{
+		TArenaPage *pNext = m_pLargeBlocks->pNext;
+
+		free (m_pLargeBlocks);
+
+		m_pLargeBlocks = pNext;
+	}
+
+	m_pNext = 0;
+	m_pLimit = 0;
+	m_nUsedSize = 0;
+}
+
+void CArenaAllocator::FreePages (void)
+{
+	Reset ();
+
+	if (m_pFirstPage != 0)
+	{
+		pfree (m_pFirstPage);
+
+		m_pFirstPage = 0;
+	}
+}
@@ -32,6 +32,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/bcm54213.h>
+#include <circle/netbuffer.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/interrupt.h>
 #include <circle/bcm2711int.h>
@@ -39,6 +40,7 @@
 #include <circle/bcm2711.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
+#include <circle/metrics.h>
 #include <circle/string.h>
 #include <circle/util.h>
 #include <circle/macros.h>
@@ -78,7 +80,7 @@
 #define GENET_Q16_RX_BD_CNT		(TOTAL_DESC - RX_QUEUES * RX_BDS_PER_Q)
 #define GENET_Q16_TX_BD_CNT		(TOTAL_DESC - TX_QUEUES * TX_BDS_PER_Q)
 
-#define TX_RING_INDEX			1	// using highest TX priority queue
+#define TX_STEERING_RINGS		TX_QUEUES	// flows are spread over the TX priority rings
 
 // Tx/Rx DMA register offset, skip 256 descriptors
 #define GENET_TDMA_REG_OFF		(TDMA_OFFSET + TOTAL_DESC * DMA_DESC_SIZE)
@@ -577,11 +579,20 @@ GENET_IO_MACRO(rbuf, GENET_RBUF_OFF);
 
 static const char FromBcm54213[] = "genet";
 
+static CMetricCounter s_TxDropped ("circle_net_tx_dropped_total",
+				   "Frames dropped, because the TX ring was full",
+				   "device=\"genet\"");
+static CMetricCounter s_RxDiscarded ("circle_net_rx_discarded_total",
+				     "Frames discarded by the hardware, because the RX ring was full",
+				     "device=\"genet\"");
+
 CBcm54213Device::CBcm54213Device (void)
 :	m_pTimer (CTimer::Get ()),
 	m_bInterruptConnected (FALSE),
 	m_tx_cbs (0),
-	m_rx_cbs (0)
+	m_rx_cbs (0),
+	m_pRxHandler (0),
+	m_pRxParam (0)
 {
 	assert (m_pTimer != 0);
 }
@@ -700,41 +711,97 @@ const CMACAddress *CBcm54213Device::GetMACAddress (void) const
 
 boolean CBcm54213Device::IsSendFrameAdvisable (void)
 {
-	unsigned index = TX_RING_INDEX;			// see SendFrame() for mapping strategy
-	if (index == 0)
-		index = GENET_DESC_INDEX;
-	else
-		index -= 1;
-							// is there room for a frame?
-	return m_tx_rings[index].free_bds >= 2;		// atomic read
+	// The ring of the next frame is not known here. A single full ring must not stop the
+	// transmission on all rings, so it is sufficient, that one ring has room. A frame for
+	// a full ring is dropped in SendFrame().
+	for (unsigned index = 0; index < TX_STEERING_RINGS; index++)
+	{
+		if (m_tx_rings[index].free_bds >= 2)	// atomic read
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
 }
 
 boolean CBcm54213Device::SendFrame (const void *pBuffer, unsigned nLength)
+{
+	m_TxSpinLock.Acquire ();
+
+	unsigned nRingMask = 0;
+	boolean bOK = QueueFrame (pBuffer, nLength, &nRingMask);
+
+	StartTransmit (nRingMask);
+
+	m_TxSpinLock.Release ();
+
+	return bOK;
+}
+
+unsigned CBcm54213Device::SendBuffers (CNetBuffer *pFrames[], unsigned nCount)
+{
+	assert (pFrames != 0);
+
+	m_TxSpinLock.Acquire ();
+
+	// the descriptors of the whole batch are set up first, the producer index of each
+	// involved ring is written only once at the end
+	unsigned nRingMask = 0;
+	unsigned nFrames;
+	for (nFrames = 0; nFrames < nCount; nFrames++)
+	{
+		CNetBuffer *pFrame = pFrames[nFrames];
+		assert (pFrame != 0);
+		unsigned nLength = pFrame->GetTotalLength ();
+		assert (nLength <= FRAME_BUFFER_SIZE);
+
+		boolean bOK;
+		if (pFrame->GetNextSegment () != 0)
+		{
+			u8 Buffer[FRAME_BUFFER_SIZE];	// frame is copied to the DMA buffer anyway
+			pFrame->CopyTo (Buffer);
+
+			bOK = QueueFrame (Buffer, nLength, &nRingMask);
+		}
+		else
+		{
+			bOK = QueueFrame (pFrame->GetData (), nLength, &nRingMask);
+		}
+
+		if (!bOK)
+		{
+			break;
+		}
+	}
+
+	StartTransmit (nRingMask);
+
+	m_TxSpinLock.Release ();
+
+	return nFrames;
+}
+
+// called with m_TxSpinLock acquired
+boolean CBcm54213Device::QueueFrame (const void *pBuffer, unsigned nLength, unsigned *pRingMask)
 {
 	assert (pBuffer != 0);
 	assert (nLength > 0);
+	assert (pRingMask != 0);
 
-	// Mapping strategy:
-	// index = 0, unclassified, packet xmited through ring16
-	// index = 1, goes to ring 0. (highest priority queue)
-	// index = 2, goes to ring 1.
-	// index = 3, goes to ring 2.
-	// index = 4, goes to ring 3.
-	unsigned index = TX_RING_INDEX;
-	if (index == 0)
-		index = GENET_DESC_INDEX;
-	else
-		index -= 1;
+	// Steering strategy:
+	// The frames are distributed to the priority rings 0..TX_STEERING_RINGS-1 by a hash
+	// over the addresses and ports, so that the frames of each flow stay in order, while
+	// different flows can use more descriptors. Ring 16 is not used for transmission.
+	unsigned index = GetFlowHash (pBuffer, nLength) % TX_STEERING_RINGS;
 
 	TGEnetTxRing *ring = &m_tx_rings[index];
 
-	m_TxSpinLock.Acquire ();
-
 	if (ring->free_bds < 2)				// is there room for this frame?
 	{
 		CLogger::Get ()->Write (FromBcm54213, LogWarning, "TX frame dropped");
 
-		m_TxSpinLock.Release ();
+		s_TxDropped.Increment ();
 
 		return FALSE;
 	}
@@ -755,7 +822,7 @@ boolean CBcm54213Device::SendFrame (const void *pBuffer, unsigned nLength)
 
 	tx_cb_ptr->buffer = pTxBuffer;			// set DMA buffer in Tx control block
 
-	// set DMA descriptor and start transfer
+	// set DMA descriptor
 	dmadesc_set (tx_cb_ptr->bd_addr, pTxBuffer,   (nLength << DMA_BUFLENGTH_SHIFT)
 						    | (QTAG_MASK << DMA_TX_QTAG_SHIFT)
 						    | DMA_TX_APPEND_CRC | DMA_SOP | DMA_EOP);
@@ -765,14 +832,25 @@ boolean CBcm54213Device::SendFrame (const void *pBuffer, unsigned nLength)
 	ring->prod_index++;
 	ring->prod_index &= DMA_P_INDEX_MASK;
 
-	// packets are ready, update producer index
-	tdma_ring_writel(ring->index, ring->prod_index, TDMA_PROD_INDEX);
-
-	m_TxSpinLock.Release ();
+	*pRingMask |= 1 << index;
 
 	return TRUE;
 }
 
+// called with m_TxSpinLock acquired
+void CBcm54213Device::StartTransmit (unsigned nRingMask)
+{
+	for (unsigned index = 0; index < TX_STEERING_RINGS; index++)
+	{
+		if (nRingMask & (1 << index))
+		{
+			// packets are ready, update producer index
+			TGEnetTxRing *ring = &m_tx_rings[index];
+			tdma_ring_writel(ring->index, ring->prod_index, TDMA_PROD_INDEX);
+		}
+	}
+}
+
 boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 {
 	assert (pBuffer != 0);
@@ -780,10 +858,93 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 	TGEnetRxRing *ring = &m_rx_rings[GENET_DESC_INDEX];	// the only supported Rx queue
 
+	if (!rx_pending (ring))
+	{
+		return FALSE;
+	}
+
+	int nLength = rx_frame (ring, pBuffer);
+
+	rdma_ring_writel (ring->index, ring->c_index, RDMA_CONS_INDEX);
+
+	if (nLength <= 0)
+	{
+		return FALSE;
+	}
+
+	*pResultLength = nLength;
+
+	return TRUE;
+}
+
+unsigned CBcm54213Device::ReceiveBuffers (CNetBuffer *pFrames[], unsigned nBudget)
+{
+	assert (pFrames != 0);
+
+	TGEnetRxRing *ring = &m_rx_rings[GENET_DESC_INDEX];	// the only supported Rx queue
+
 	// clear status before servicing to reduce spurious interrupts
-	// NOTE: Rx interrupts are not used
-	//intrl2_0_writel (UMAC_IRQ_RXDMA_DONE, INTRL2_CPU_CLEAR);
+	if (m_pRxHandler != 0)
+	{
+		intrl2_0_writel (UMAC_IRQ_RXDMA_DONE, INTRL2_CPU_CLEAR);
+	}
+
+	// the producer and consumer index registers are accessed only once per batch
+	unsigned rxpkttoprocess = rx_pending (ring);
+
+	unsigned nFrames = 0;
+	unsigned nProcessed;
+	for (nProcessed = 0; nProcessed < rxpkttoprocess && nProcessed < nBudget; nProcessed++)
+	{
+		CNetBuffer *pFrame = CNetBuffer::Alloc ();
+		assert (pFrame != 0);
+
+		int nLength = rx_frame (ring, pFrame->GetData ());
+		if (nLength <= 0)
+		{
+			pFrame->Release ();
+
+			continue;
+		}
+
+		pFrame->Append (nLength);
+		pFrames[nFrames++] = pFrame;
+	}
+
+	if (nProcessed > 0)
+	{
+		rdma_ring_writel (ring->index, ring->c_index, RDMA_CONS_INDEX);
+	}
+
+	return nFrames;
+}
+
+boolean CBcm54213Device::RegisterReceiveHandler (TNetReceiveHandler *pHandler, void *pParam)
+{
+	assert (pHandler != 0);
+	assert (m_pRxHandler == 0);
+
+	// the interrupt is enabled with EnableReceiveInterrupt(), after the ring has been polled
+	m_pRxParam = pParam;
+	DataMemBarrier ();
+	m_pRxHandler = pHandler;
+
+	return TRUE;
+}
+
+boolean CBcm54213Device::EnableReceiveInterrupt (void)
+{
+	assert (m_pRxHandler != 0);
+	enable_rx_intr ();
+
+	// frames, which arrived before the status was cleared, do not raise an interrupt
+	return rx_pending (&m_rx_rings[GENET_DESC_INDEX]) == 0;
+}
 
+// returns number of frames waiting in the Rx ring, updates the discard counter
+unsigned CBcm54213Device::rx_pending (TGEnetRxRing *ring)
+{
+	assert (ring != 0);
 	unsigned p_index = rdma_ring_readl (ring->index, RDMA_PROD_INDEX);
 
 	unsigned discards =   (p_index >> DMA_P_INDEX_DISCARD_CNT_SHIFT)
@@ -793,6 +954,8 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 		discards = discards - ring->old_discards;
 		ring->old_discards += discards;
 
+		s_RxDiscarded.Increment (discards);
+
 		// clear HW register when we reach 75% of maximum 0xFFFF
 		if (ring->old_discards >= 0xC000)
 		{
@@ -803,85 +966,84 @@ boolean CBcm54213Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 	p_index &= DMA_P_INDEX_MASK;
 
-	boolean bResult = FALSE;
-
-	unsigned rxpkttoprocess = (p_index - ring->c_index) & DMA_C_INDEX_MASK;
-	if (rxpkttoprocess > 0)
-	{
-		u32 dma_length_status;
-		u32 dma_flag;
-		int nLength;
+	return (p_index - ring->c_index) & DMA_C_INDEX_MASK;
+}
 
-		TGEnetCB *cb = &m_rx_cbs[ring->read_ptr];
+// fetches the next frame from the Rx ring and advances the consumer index in software,
+// returns the frame length (0 if the frame has been dropped)
+int CBcm54213Device::rx_frame (TGEnetRxRing *ring, void *pBuffer)
+{
+	assert (ring != 0);
+	assert (pBuffer != 0);
 
-		u8 *pRxBuffer = rx_refill (cb);
-		if (pRxBuffer == 0)
-		{
-			CLogger::Get ()->Write (FromBcm54213, LogWarning, "Missing RX buffer!");
+	u32 dma_length_status;
+	u32 dma_flag;
+	int nLength = 0;
 
-			goto out;
-		}
+	TGEnetCB *cb = &m_rx_cbs[ring->read_ptr];
 
-		dma_length_status = dmadesc_get_length_status (cb->bd_addr);
-		dma_flag = dma_length_status & 0xFFFF;
-		nLength = dma_length_status >> DMA_BUFLENGTH_SHIFT;
+	u8 *pRxBuffer = rx_refill (cb);
+	if (pRxBuffer == 0)
+	{
+		CLogger::Get ()->Write (FromBcm54213, LogWarning, "Missing RX buffer!");
 
-		if (   !(dma_flag & DMA_EOP)
-		    || !(dma_flag & DMA_SOP))
-		{
-			CLogger::Get ()->Write (FromBcm54213, LogWarning,
-						"Dropping fragmented RX packet!");
+		goto out;
+	}
 
-			delete [] pRxBuffer;
+	dma_length_status = dmadesc_get_length_status (cb->bd_addr);
+	dma_flag = dma_length_status & 0xFFFF;
 
-			goto out;
-		}
+	if (   !(dma_flag & DMA_EOP)
+	    || !(dma_flag & DMA_SOP))
+	{
+		CLogger::Get ()->Write (FromBcm54213, LogWarning,
+					"Dropping fragmented RX packet!");
 
-		// report errors
-		if (dma_flag & (DMA_RX_CRC_ERROR | DMA_RX_OV | DMA_RX_NO | DMA_RX_LG | DMA_RX_RXER))
-		{
-			CLogger::Get ()->Write (FromBcm54213, LogWarning, "RX error (0x%x)",
-						(unsigned) dma_flag);
+		delete [] pRxBuffer;
 
-			delete [] pRxBuffer;
+		goto out;
+	}
 
-			goto out;
-		}
+	// report errors
+	if (dma_flag & (DMA_RX_CRC_ERROR | DMA_RX_OV | DMA_RX_NO | DMA_RX_LG | DMA_RX_RXER))
+	{
+		CLogger::Get ()->Write (FromBcm54213, LogWarning, "RX error (0x%x)",
+					(unsigned) dma_flag);
 
-#define LEADING_PAD	2
-		nLength -= LEADING_PAD;		// remove HW 2 bytes added for IP alignment
+		delete [] pRxBuffer;
 
-		if (m_crc_fwd_en)
-		{
-			nLength -= ETH_FCS_LEN;
-		}
+		goto out;
+	}
 
+	nLength = dma_length_status >> DMA_BUFLENGTH_SHIFT;
 
-		assert (nLength > 0);
-		assert (nLength <= FRAME_BUFFER_SIZE);
-		memcpy (pBuffer, pRxBuffer+LEADING_PAD, nLength);
+#define LEADING_PAD	2
+	nLength -= LEADING_PAD;		// remove HW 2 bytes added for IP alignment
 
-		*pResultLength = nLength;
+	if (m_crc_fwd_en)
+	{
+		nLength -= ETH_FCS_LEN;
+	}
 
-		delete [] pRxBuffer;
+	assert (nLength > 0);
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	memcpy (pBuffer, pRxBuffer+LEADING_PAD, nLength);
 
-		bResult = TRUE;
+	delete [] pRxBuffer;
 
 out:
-		if (ring->read_ptr < ring->end_ptr)
-		{
-			ring->read_ptr++;
-		}
-		else
-		{
-			ring->read_ptr = ring->cb_ptr;
-		}
-
-		ring->c_index = (ring->c_index + 1) & DMA_C_INDEX_MASK;
-		rdma_ring_writel (ring->index, ring->c_index, RDMA_CONS_INDEX);
+	if (ring->read_ptr < ring->end_ptr)
+	{
+		ring->read_ptr++;
 	}
+	else
+	{
+		ring->read_ptr = ring->cb_ptr;
+	}
+
+	ring->c_index = (ring->c_index + 1) & DMA_C_INDEX_MASK;
 
-	return bResult;
+	return nLength;
 }
 
 boolean CBcm54213Device::IsLinkUp (void)
@@ -1091,8 +1253,28 @@ void CBcm54213Device::set_mdf_addr(const u8 addr[MAC_ADDRESS_SIZE], int *i, int
 
 void CBcm54213Device::set_rx_mode(const u8 mc_groups[][MAC_ADDRESS_SIZE])
 {
-	// Promiscuous mode off
+	unsigned nGroups = 0;
+	if (mc_groups)
+	{
+		while (mc_groups[nGroups][0])
+		{
+			nGroups++;
+		}
+	}
+
+	// The MDF has no hash filter, but exact match entries only, two of them are
+	// used for broadcast and our own address. Fall back to promiscuous mode,
+	// if there are more multicast groups, the link layer filters the frames then.
 	u32 reg = umac_readl(UMAC_CMD);
+	if (nGroups > MAX_MC_COUNT+1 - 2)
+	{
+		reg |= CMD_PROMISC;
+		umac_writel(reg, UMAC_CMD);
+
+		return;
+	}
+
+	// Promiscuous mode off
 	reg &= ~CMD_PROMISC;
 	umac_writel(reg, UMAC_CMD);
 
@@ -1150,7 +1332,7 @@ void CBcm54213Device::hfb_init(void)
 // Start the network engine
 void CBcm54213Device::netif_start(void)
 {
-	//enable_rx_intr();		// NOTE: Rx interrupts are not needed
+	//enable_rx_intr();		// NOTE: enabled by EnableReceiveInterrupt(), if used
 
 	umac_enable_set(CMD_TX_EN | CMD_RX_EN, true);
 
@@ -1251,8 +1433,8 @@ void CBcm54213Device::enable_dma(u32 dma_ctrl)
 
 // Initialize or reset Tx queues
 //
-// Queues 0-3 are priority-based, each one has 32 descriptors,
-// with queue 0 being the highest priority queue.
+// Queues 0-3 have 32 descriptors each. They are served round-robin with equal
+// priorities, because the transmitted flows are spread over them by a hash.
 //
 // Queue 16 is the default Tx queue with
 // GENET_Q16_TX_BD_CNT = 256 - 4 * 32 = 128 descriptors.
@@ -1275,8 +1457,9 @@ void CBcm54213Device::init_tx_queues(bool enable)
 
 	if (enable)
 	{
-		// Enable strict priority arbiter mode
-		tdma_writel(DMA_ARBITER_SP, DMA_ARB_CTRL);
+		// Enable round-robin arbiter mode, the flows are steered to the rings by a hash,
+		// so that no ring must be preferred (strict priority would starve rings 1..3)
+		tdma_writel(DMA_ARBITER_RR, DMA_ARB_CTRL);
 	}
 
 	u32 dma_priority[3] = {0, 0, 0};
@@ -1287,7 +1470,7 @@ void CBcm54213Device::init_tx_queues(bool enable)
 		ring_cfg |= (1 << i);
 		dma_ctrl |= (1 << (i + DMA_RING_BUF_EN_SHIFT));
 		dma_priority[DMA_PRIO_REG_INDEX(i)] |=
-			((GENET_Q0_PRIORITY + i) << DMA_PRIO_REG_SHIFT(i));
+			(GENET_Q0_PRIORITY << DMA_PRIO_REG_SHIFT(i));	// equal priorities
 	}
 
 	// Initialize Tx default queue 16
@@ -1477,6 +1660,7 @@ int CBcm54213Device::init_rx_ring(unsigned index, unsigned size,
 	rdma_ring_writel(index, 0, RDMA_PROD_INDEX);
 	rdma_ring_writel(index, 0, RDMA_CONS_INDEX);
 	rdma_ring_writel(index, ((size << DMA_RING_SIZE_SHIFT) | RX_BUF_LENGTH), DMA_RING_BUF_SIZE);
+	rdma_ring_writel(index, 1, DMA_MBUF_DONE_THRESH);	// Rx interrupt per frame
 	rdma_ring_writel(index,   (DMA_FC_THRESH_LO << DMA_XOFF_THRESHOLD_SHIFT)
 				|  DMA_FC_THRESH_HI, RDMA_XON_XOFF_THRESH);
 
@@ -1583,6 +1767,14 @@ void CBcm54213Device::InterruptHandler0 (void)
 	// clear interrupts
 	intrl2_0_writel(status, INTRL2_CPU_CLEAR);
 
+	if (status & UMAC_IRQ_RXDMA_DONE) {
+		// disable until the frames have been fetched (see EnableReceiveInterrupt())
+		intrl2_0_writel(UMAC_IRQ_RXDMA_DONE, INTRL2_CPU_MASK_SET);
+
+		if (m_pRxHandler)
+			(*m_pRxHandler)(m_pRxParam);
+	}
+
 	if (status & UMAC_IRQ_TXDMA_DONE) {
 		m_TxSpinLock.Acquire ();
 
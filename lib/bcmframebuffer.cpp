@@ -19,6 +19,7 @@
 //
 #include <circle/bcmframebuffer.h>
 #include <circle/interrupt.h>
+#include <circle/memory.h>
 #include <circle/util.h>
 #include <circle/koptions.h>
 #include <circle/atomic.h>
@@ -177,6 +178,15 @@ boolean CBcmFrameBuffer::Initialize (void)
 	m_nBufferSize = m_InitTags.AllocateBuffer.nBufferSize;
 	m_nPitch      = m_InitTags.GetPitch.nValue;
 
+#if AARCH == 64
+	// Writing to normal non-cacheable memory is much faster than to device memory,
+	// because writes can be combined and unaligned accesses are allowed.
+	uintptr nMapStart = m_nBufferPtr & ~((uintptr) PAGE_SIZE-1);
+	uintptr nMapEnd = (m_nBufferPtr + m_nBufferSize + PAGE_SIZE-1) & ~((uintptr) PAGE_SIZE-1);
+	CMemorySystem::SetMemoryAttributes (nMapStart, nMapEnd - nMapStart,
+					    MEMATTR_WRITE_COMBINING | MEMATTR_EXECUTE_NEVER);
+#endif
+
 	boolean bOK = UpdatePalette();
 	if (bOK)
 	{
@@ -383,11 +393,40 @@ boolean CBcmFrameBuffer::UpdatePalette (void)
 	return TRUE;
 }
 
-boolean CBcmFrameBuffer::SetVirtualOffset (u32 nOffsetX, u32 nOffsetY)
+boolean CBcmFrameBuffer::SetVirtualOffset (u32 nOffsetX, u32 nOffsetY, boolean bWaitForVSync)
 {
 	SetDisplay ();
 
 	CBcmPropertyTags Tags;
+
+	if (bWaitForVSync)
+	{
+		// both tags are processed in one mailbox transaction
+		struct
+		{
+			TPropertyTagVirtualOffset	VirtualOffset;
+			TPropertyTagSimple		WaitForVSync;
+		}
+		PACKED FlipTags;
+
+		CBcmPropertyTags::InitTag (&FlipTags.VirtualOffset, PROPTAG_SET_VIRTUAL_OFFSET,
+					   sizeof FlipTags.VirtualOffset, 8);
+		FlipTags.VirtualOffset.nOffsetX = nOffsetX;
+		FlipTags.VirtualOffset.nOffsetY = nOffsetY;
+
+		CBcmPropertyTags::InitTag (&FlipTags.WaitForVSync, PROPTAG_WAIT_FOR_VSYNC,
+					   sizeof FlipTags.WaitForVSync);
+
+		if (   !Tags.GetTags (&FlipTags, sizeof FlipTags)
+		    || FlipTags.VirtualOffset.nOffsetX != nOffsetX
+		    || FlipTags.VirtualOffset.nOffsetY != nOffsetY)
+		{
+			return FALSE;
+		}
+
+		return TRUE;
+	}
+
 	TPropertyTagVirtualOffset VirtualOffset;
 	VirtualOffset.nOffsetX = nOffsetX;
 	VirtualOffset.nOffsetY = nOffsetY;
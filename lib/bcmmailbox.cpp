@@ -25,6 +25,12 @@
 
 CSpinLock CBcmMailBox::s_SpinLock (TASK_LEVEL);
 
+boolean CBcmMailBox::s_bInterruptConnected = FALSE;
+volatile boolean CBcmMailBox::s_bAsyncPending = FALSE;
+unsigned CBcmMailBox::s_nAsyncChannel;
+TMailBoxCompletionRoutine *CBcmMailBox::s_pAsyncRoutine = 0;
+void *CBcmMailBox::s_pAsyncParam = 0;
+
 CBcmMailBox::CBcmMailBox (unsigned nChannel, boolean bEarlyUse)
 :	m_nChannel (nChannel),
 	m_bEarlyUse (bEarlyUse)
@@ -44,6 +50,12 @@ u32 CBcmMailBox::WriteRead (u32 nData)
 		s_SpinLock.Acquire ();
 	}
 
+	// the response of an asynchronous request must not be read here
+	while (s_bAsyncPending)
+	{
+		// wait for the mailbox IRQ
+	}
+
 	Flush ();
 
 	Write (nData);
@@ -60,6 +72,109 @@ u32 CBcmMailBox::WriteRead (u32 nData)
 	return nResult;
 }
 
+boolean CBcmMailBox::WriteReadAsync (u32 nData, TMailBoxCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pRoutine != 0);
+
+	if (   m_bEarlyUse
+	    || !s_bInterruptConnected)
+	{
+		return FALSE;
+	}
+
+	PeripheralEntry ();
+
+	s_SpinLock.Acquire ();
+
+	while (s_bAsyncPending)
+	{
+		// wait for the mailbox IRQ
+	}
+
+	Flush ();
+
+	s_nAsyncChannel = m_nChannel;
+	s_pAsyncRoutine = pRoutine;
+	s_pAsyncParam = pParam;
+	s_bAsyncPending = TRUE;
+
+	DataMemBarrier ();
+
+	write32 (MAILBOX0_CONFIG, MAILBOX_CONFIG_IRQ_DATA);
+
+	Write (nData);
+
+	s_SpinLock.Release ();
+
+	PeripheralExit ();
+
+	return TRUE;
+}
+
+void CBcmMailBox::ConnectInterrupt (CInterruptSystem *pInterrupt)
+{
+#ifdef ARM_IRQ_ARM_MAILBOX
+	assert (pInterrupt != 0);
+
+	if (s_bInterruptConnected)
+	{
+		return;
+	}
+
+	PeripheralEntry ();
+	write32 (MAILBOX0_CONFIG, 0);
+	PeripheralExit ();
+
+	pInterrupt->ConnectIRQ (ARM_IRQ_ARM_MAILBOX, InterruptHandler, 0);
+
+	s_bInterruptConnected = TRUE;
+#endif
+}
+
+boolean CBcmMailBox::IsInterruptConnected (void)
+{
+	return s_bInterruptConnected;
+}
+
+void CBcmMailBox::InterruptHandler (void *pParam)
+{
+	PeripheralEntry ();
+
+	boolean bReceived = FALSE;
+	u32 nResult = 0;
+	while (!(read32 (MAILBOX0_STATUS) & MAILBOX_STATUS_EMPTY))
+	{
+		u32 nData = read32 (MAILBOX0_READ);
+		if ((nData & 0xF) == s_nAsyncChannel)
+		{
+			nResult = nData & ~0xF;
+			bReceived = TRUE;
+		}
+	}
+
+	if (   !bReceived
+	    || !s_bAsyncPending)
+	{
+		PeripheralExit ();
+
+		return;
+	}
+
+	write32 (MAILBOX0_CONFIG, 0);
+
+	PeripheralExit ();
+
+	TMailBoxCompletionRoutine *pRoutine = s_pAsyncRoutine;
+	void *pRoutineParam = s_pAsyncParam;
+
+	DataMemBarrier ();
+
+	s_bAsyncPending = FALSE;
+
+	assert (pRoutine != 0);
+	(*pRoutine) (nResult, pRoutineParam);
+}
+
 void CBcmMailBox::Flush (void)
 {
 	while (!(read32 (MAILBOX0_STATUS) & MAILBOX_STATUS_EMPTY))
@@ -7,7 +7,7 @@
 //	Licensed under GPL-2.0+
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -208,6 +208,19 @@
 
 #define BRCM_MSI_TARGET_ADDR_LT_4GB	0x0fffffffcULL
 #define BRCM_MSI_TARGET_ADDR_GT_4GB	0xffffffffcULL
+#define BRCM_MSI_DATA_VALUE		0x6540		// low 5 bits select the vector
+
+#if RASPPI >= 5
+/* MSI interrupt peripheral (MIP), from DTB: msi-controller@130000 (mip0) */
+#define MIP_MSI_PCI_ADDR		0xFFFFFFF000UL	// brcm,msi-pci-addr = <0xff 0xfffff000>;
+#define MIP_BASE			0x1000130000UL	// reg = <0x10 0x00130000 0x0 0xc0>;
+#define MIP_INT_CFGL_HOST		(MIP_BASE + 0x20)
+#define MIP_INT_CFGH_HOST		(MIP_BASE + 0x30)
+#define MIP_INT_MASKL_HOST		(MIP_BASE + 0x40)
+#define MIP_INT_MASKH_HOST		(MIP_BASE + 0x50)
+#define MIP_INT_MASKL_VPU		(MIP_BASE + 0x60)
+#define MIP_INT_MASKH_VPU		(MIP_BASE + 0x70)
+#endif
 
 #define BURST_SIZE_128			0
 #define BURST_SIZE_256			1
@@ -292,6 +305,12 @@
 
 u64 CBcmPCIeHostBridge::s_nDMAAddress[PCIE_BUS_NUM] = {0};
 
+TPCIeMSIVector CBcmPCIeHostBridge::s_MSIVector[PCIE_MSI_VECTORS];
+
+#if RASPPI >= 5
+boolean CBcmPCIeHostBridge::s_bMIPInitialized = FALSE;
+#endif
+
 static const char FromPCIeHost[] = "pcie";
 
 CBcmPCIeHostBridge::CBcmPCIeHostBridge (unsigned nBus, CInterruptSystem *pInterrupt)
@@ -304,19 +323,22 @@ CBcmPCIeHostBridge::CBcmPCIeHostBridge (unsigned nBus, CInterruptSystem *pInterr
 #endif
 	m_num_out_wins (0),
 	m_num_dma_ranges (0),
-	m_num_scbs (0),
-	m_msi (0)
+	m_num_scbs (0)
+#if RASPPI == 4
+	, m_bMSIEnabled (FALSE)
+#endif
 {
 }
 
 CBcmPCIeHostBridge::~CBcmPCIeHostBridge (void)
 {
-#if 0
-	if (m_msi != 0)
+	for (unsigned nVector = 0; nVector < PCIE_MSI_VECTORS; nVector++)
 	{
-		DisconnectMSI ();
+		if (s_MSIVector[nVector].pOwner == this)
+		{
+			FreeMSIVector (nVector);
+		}
 	}
-#endif
 
 	m_pInterrupt = 0;
 }
@@ -349,27 +371,237 @@ boolean CBcmPCIeHostBridge::EnableDevice (u32 nClassCode, unsigned nSlot, unsign
 	return !enable_device (nClassCode, nSlot, nFunc);
 }
 
-#if 0
-
-boolean CBcmPCIeHostBridge::ConnectMSI (TPCIeMSIHandler *pHandler, void *pParam)
+int CBcmPCIeHostBridge::AllocateMSIVector (TPCIeMSIHandler *pHandler, void *pParam,
+					   unsigned nCore)
 {
-	return !pcie_enable_msi (pHandler, pParam);
+	assert (pHandler != 0);
+	assert (nCore < CORES);
+	assert (m_pInterrupt != 0);
+
+	unsigned nVector;
+	for (nVector = 0; nVector < PCIE_MSI_VECTORS; nVector++)
+	{
+		if (s_MSIVector[nVector].pOwner == 0)
+		{
+			break;
+		}
+	}
+
+	if (nVector >= PCIE_MSI_VECTORS)
+	{
+		CLogger::Get ()->Write (FromPCIeHost, LogError, "No MSI vector available");
+
+		return -1;
+	}
+
+	TPCIeMSIVector *pVector = &s_MSIVector[nVector];
+	pVector->pHandler = pHandler;
+	pVector->pParam = pParam;
+	pVector->nVector = nVector;
+	pVector->pOwner = this;
+
+#if RASPPI == 4
+	if (!m_bMSIEnabled)
+	{
+		if (pcie_enable_msi ())
+		{
+			pVector->pOwner = 0;
+
+			return -1;
+		}
+
+		// all vectors share this IRQ
+		m_pInterrupt->SetIRQAffinity (ARM_IRQ_PCIE_HOST_MSI, nCore);
+	}
+#else
+	if (pcie_enable_msi ())
+	{
+		pVector->pOwner = 0;
+
+		return -1;
+	}
+
+	unsigned nIRQ = ARM_IRQ_PCIE_MIP0_BASE + nVector;
+
+	// the MIP signals MSIs as edge on its SPIs
+	m_pInterrupt->SetIRQTrigger (nIRQ, TRUE);
+	m_pInterrupt->SetIRQAffinity (nIRQ, nCore);
+
+	m_pInterrupt->ConnectIRQ (nIRQ, MIPInterruptHandler, pVector);
+#endif
+
+	return nVector;
 }
 
-void CBcmPCIeHostBridge::DisconnectMSI (void)
+void CBcmPCIeHostBridge::FreeMSIVector (unsigned nVector)
 {
-	bcm_writel(0xffffffff, m_msi->intr_base + MASK_SET);
-	bcm_writel(0, m_msi->base + PCIE_MISC_MSI_BAR_CONFIG_LO);
+	assert (nVector < PCIE_MSI_VECTORS);
+	TPCIeMSIVector *pVector = &s_MSIVector[nVector];
+	assert (pVector->pOwner == this);
 
 	assert (m_pInterrupt != 0);
-	m_pInterrupt->DisconnectIRQ (ARM_IRQ_PCIE_HOST_MSI);
 
-	delete m_msi;
-	m_msi = 0;
-}
+#if RASPPI == 4
+	pVector->pHandler = 0;
+
+	unsigned i;
+	for (i = 0; i < PCIE_MSI_VECTORS; i++)
+	{
+		if (   i != nVector
+		    && s_MSIVector[i].pOwner != 0)
+		{
+			break;
+		}
+	}
 
+	if (i >= PCIE_MSI_VECTORS)
+	{
+		pcie_disable_msi ();
+	}
+#else
+	unsigned nIRQ = ARM_IRQ_PCIE_MIP0_BASE + nVector;
+
+	m_pInterrupt->DisconnectIRQ (nIRQ);
+	m_pInterrupt->SetIRQAffinity (nIRQ, 0);
+	m_pInterrupt->SetIRQTrigger (nIRQ, FALSE);
 #endif
 
+	pVector->pOwner = 0;
+}
+
+boolean CBcmPCIeHostBridge::EnableMSI (unsigned nSlot, unsigned nFunc, unsigned nVector)
+{
+	assert (nVector < PCIE_MSI_VECTORS);
+	assert (s_MSIVector[nVector].pOwner == this);
+
+	uintptr conf = pcie_map_conf (PCI_BUS (1), PCI_DEVFN (nSlot, nFunc), 0);
+	if (!conf)
+		return FALSE;
+
+	uintptr msi_conf = find_pci_capability (conf, PCI_CAP_ID_MSI);
+	if (!msi_conf)
+		return FALSE;
+
+	u16 flags = read16 (msi_conf + PCI_MSI_FLAGS);
+	write16 (msi_conf + PCI_MSI_FLAGS, flags & ~PCI_MSI_FLAGS_ENABLE);
+
+	u64 addr;
+	u32 data;
+	msi_compose_msg (nVector, &addr, &data);
+
+	write32 (msi_conf + PCI_MSI_ADDRESS_LO, lower_32_bits (addr));
+	if (flags & PCI_MSI_FLAGS_64BIT)
+	{
+		write32 (msi_conf + PCI_MSI_ADDRESS_HI, upper_32_bits (addr));
+		write16 (msi_conf + PCI_MSI_DATA_64, data);
+	}
+	else
+	{
+		if (upper_32_bits (addr))
+		{
+			CLogger::Get ()->Write (FromPCIeHost, LogError,
+						"Device does not support 64-bit MSI address");
+
+			return FALSE;
+		}
+
+		write16 (msi_conf + PCI_MSI_DATA_32, data);
+	}
+
+	// single message (QSIZE = 0)
+	flags &= ~PCI_MSI_FLAGS_QSIZE;
+	write16 (msi_conf + PCI_MSI_FLAGS, flags | PCI_MSI_FLAGS_ENABLE);
+
+	write16 (conf + PCI_COMMAND, read16 (conf + PCI_COMMAND) | PCI_COMMAND_INTX_DISABLE);
+
+	return TRUE;
+}
+
+unsigned CBcmPCIeHostBridge::GetMSIXTableSize (unsigned nSlot, unsigned nFunc)
+{
+	uintptr conf = pcie_map_conf (PCI_BUS (1), PCI_DEVFN (nSlot, nFunc), 0);
+	if (!conf)
+		return 0;
+
+	uintptr msix_conf = find_pci_capability (conf, PCI_CAP_ID_MSIX);
+	if (!msix_conf)
+		return 0;
+
+	// only a table in BAR0 is supported, which is the only assigned BAR
+	if ((read32 (msix_conf + PCI_MSIX_TABLE) & PCI_MSIX_TABLE_BIR) != 0)
+		return 0;
+
+	// QSIZE is zero based
+	return (read16 (msix_conf + PCI_MSIX_FLAGS) & PCI_MSIX_FLAGS_QSIZE) + 1;
+}
+
+boolean CBcmPCIeHostBridge::SetMSIXVector (unsigned nSlot, unsigned nFunc,
+					   unsigned nEntry, unsigned nVector)
+{
+	assert (nVector < PCIE_MSI_VECTORS);
+	assert (s_MSIVector[nVector].pOwner == this);
+
+	if (nEntry >= GetMSIXTableSize (nSlot, nFunc))
+		return FALSE;
+
+	uintptr conf = pcie_map_conf (PCI_BUS (1), PCI_DEVFN (nSlot, nFunc), 0);
+	assert (conf);
+
+	uintptr entry = msix_table_entry (conf, nEntry);
+	if (!entry)
+		return FALSE;
+
+	u64 addr;
+	u32 data;
+	msi_compose_msg (nVector, &addr, &data);
+
+	write32 (entry + PCI_MSIX_ENTRY_VECTOR_CTRL, PCI_MSIX_ENTRY_CTRL_MASKBIT);
+	write32 (entry + PCI_MSIX_ENTRY_LOWER_ADDR, lower_32_bits (addr));
+	write32 (entry + PCI_MSIX_ENTRY_UPPER_ADDR, upper_32_bits (addr));
+	write32 (entry + PCI_MSIX_ENTRY_DATA, data);
+	write32 (entry + PCI_MSIX_ENTRY_VECTOR_CTRL, 0);
+
+	return TRUE;
+}
+
+boolean CBcmPCIeHostBridge::EnableMSIX (unsigned nSlot, unsigned nFunc)
+{
+	uintptr conf = pcie_map_conf (PCI_BUS (1), PCI_DEVFN (nSlot, nFunc), 0);
+	if (!conf)
+		return FALSE;
+
+	uintptr msix_conf = find_pci_capability (conf, PCI_CAP_ID_MSIX);
+	if (!msix_conf)
+		return FALSE;
+
+	write16 (conf + PCI_COMMAND, read16 (conf + PCI_COMMAND) | PCI_COMMAND_INTX_DISABLE);
+
+	u16 flags = read16 (msix_conf + PCI_MSIX_FLAGS);
+	flags &= ~PCI_MSIX_FLAGS_MASKALL;
+	write16 (msix_conf + PCI_MSIX_FLAGS, flags | PCI_MSIX_FLAGS_ENABLE);
+
+	return TRUE;
+}
+
+void CBcmPCIeHostBridge::DisableMSI (unsigned nSlot, unsigned nFunc)
+{
+	uintptr conf = pcie_map_conf (PCI_BUS (1), PCI_DEVFN (nSlot, nFunc), 0);
+	if (!conf)
+		return;
+
+	uintptr msi_conf = find_pci_capability (conf, PCI_CAP_ID_MSI);
+	if (msi_conf)
+		write16 (msi_conf + PCI_MSI_FLAGS,
+			 read16 (msi_conf + PCI_MSI_FLAGS) & ~PCI_MSI_FLAGS_ENABLE);
+
+	uintptr msix_conf = find_pci_capability (conf, PCI_CAP_ID_MSIX);
+	if (msix_conf)
+		write16 (msix_conf + PCI_MSIX_FLAGS,
+			 read16 (msix_conf + PCI_MSIX_FLAGS) & ~PCI_MSIX_FLAGS_ENABLE);
+
+	write16 (conf + PCI_COMMAND, read16 (conf + PCI_COMMAND) & ~PCI_COMMAND_INTX_DISABLE);
+}
+
 #ifndef NDEBUG
 
 void CBcmPCIeHostBridge::DumpStatus (unsigned nSlot, unsigned nFunc)
@@ -614,11 +846,9 @@ int CBcmPCIeHostBridge::pcie_setup(void)
 	// Back in probe:
 
 #if RASPPI >= 5
-	// TODO? enable msi-controller@130000 (mip0)
-
-	/* Use RC_BAR1 for MIP access */	// From DTB:
-	u64 msi_pci_addr = 0xFFFFFFF000UL;	// brcm,msi-pci-addr = <0xff 0xfffff000>;
-	u64 msi_phys_addr = 0x1000130000UL;	// reg = <0x10 0x00130000 0x0 0xc0>;
+	/* Use RC_BAR1 for MIP access, the MIP is initialized with the first MSI vector */
+	u64 msi_pci_addr = MIP_MSI_PCI_ADDR;
+	u64 msi_phys_addr = MIP_BASE;
 
 	bcm_writel(lower_32_bits(msi_pci_addr) | encode_ibar_size(0x1000),
 		m_base + PCIE_MISC_RC_BAR1_CONFIG_LO);
@@ -758,20 +988,6 @@ int CBcmPCIeHostBridge::enable_device (u32 nClassCode, unsigned nSlot, unsigned
 					    | PCI_BASE_ADDRESS_MEM_TYPE_64);
 	write32 (conf + PCI_BASE_ADDRESS_1, upper_32_bits (m_out_wins[0].pcie_addr));
 
-#if 0
-	uintptr msi_conf = find_pci_capability (conf, PCI_CAP_ID_MSI);
-	if (!msi_conf)
-		return -1;
-
-	write32 (msi_conf + PCI_MSI_ADDRESS_LO, lower_32_bits (m_msi_target_addr));
-	write32 (msi_conf + PCI_MSI_ADDRESS_HI, upper_32_bits (m_msi_target_addr));
-	write16 (msi_conf + PCI_MSI_DATA_64, 0x6540);
-
-	u8 uchQueueSize = (read8 (msi_conf + PCI_MSI_FLAGS) & PCI_MSI_FLAGS_QMASK) >> 1;
-	write8 (msi_conf + PCI_MSI_FLAGS,   PCI_MSI_FLAGS_ENABLE
-					  | PCI_MSI_FLAGS_64BIT
-					  | uchQueueSize << 4);
-#else
 	// Ensure, that we can use INTA.
 	u8 uchIntPin = read8 (conf + PCI_INTERRUPT_PIN);
 	if (uchIntPin != 1)
@@ -781,7 +997,6 @@ int CBcmPCIeHostBridge::enable_device (u32 nClassCode, unsigned nSlot, unsigned
 
 		write8 (conf + PCI_INTERRUPT_PIN, 1);
 	}
-#endif
 
 	write16 (conf + PCI_COMMAND,   PCI_COMMAND_MEMORY
 				     | PCI_COMMAND_MASTER
@@ -948,56 +1163,121 @@ bool CBcmPCIeHostBridge::pcie_rc_mode(void)
 #endif
 }
 
-int CBcmPCIeHostBridge::pcie_enable_msi(TPCIeMSIHandler *pHandler, void *pParam)
+int CBcmPCIeHostBridge::pcie_enable_msi(void)
 {
-	assert (pHandler != 0);
+#if RASPPI == 4
+	assert (!m_bMSIEnabled);
 
-	m_msi = new TPCIeMSIData;
-	if (!m_msi)
-		return -1;
-	memset (m_msi, 0, sizeof *m_msi);
+	assert (m_pInterrupt != 0);
+	m_pInterrupt->ConnectIRQ (ARM_IRQ_PCIE_HOST_MSI, InterruptHandler, this);
 
-	m_msi->base = m_base;
-	m_msi->rev = m_rev;
-	m_msi->target_addr = m_msi_target_addr;
-	m_msi->handler = pHandler;
-	m_msi->param = pParam;
+	msi_set_regs();
 
-	assert (m_pInterrupt != 0);
-	m_pInterrupt->ConnectIRQ (ARM_IRQ_PCIE_HOST_MSI, InterruptHandler, m_msi);
+	m_bMSIEnabled = TRUE;
+#else
+	if (s_bMIPInitialized)
+		return 0;
 
-	assert (m_rev >= BRCM_PCIE_HW_REV_33);
-	m_msi->intr_base = m_msi->base + PCIE_MSI_INTR2_BASE;
+	/* Unmask all interrupts for the host and mask them for the VPU */
+	bcm_writel(0, MIP_INT_MASKL_HOST);
+	bcm_writel(0, MIP_INT_MASKH_HOST);
+	bcm_writel(~0, MIP_INT_MASKL_VPU);
+	bcm_writel(~0, MIP_INT_MASKH_VPU);
 
-	msi_set_regs(m_msi);
+	/* Set all interrupts to edge triggered */
+	bcm_writel(~0, MIP_INT_CFGL_HOST);
+	bcm_writel(~0, MIP_INT_CFGH_HOST);
+
+	s_bMIPInitialized = TRUE;
+#endif
 
 	return 0;
 }
 
-void CBcmPCIeHostBridge::msi_set_regs(TPCIeMSIData *msi)
+void CBcmPCIeHostBridge::pcie_disable_msi(void)
 {
-	assert (msi->rev >= BRCM_PCIE_HW_REV_33);
+#if RASPPI == 4
+	if (!m_bMSIEnabled)
+		return;
+
+	uintptr intr_base = m_base + PCIE_MSI_INTR2_BASE;
+	bcm_writel(0xffffffff, intr_base + MASK_SET);
+	bcm_writel(0, m_base + PCIE_MISC_MSI_BAR_CONFIG_LO);
+
+	assert (m_pInterrupt != 0);
+	m_pInterrupt->DisconnectIRQ (ARM_IRQ_PCIE_HOST_MSI);
+	m_pInterrupt->SetIRQAffinity (ARM_IRQ_PCIE_HOST_MSI, 0);
+
+	m_bMSIEnabled = FALSE;
+#endif
+}
+
+#if RASPPI == 4
+
+void CBcmPCIeHostBridge::msi_set_regs(void)
+{
+	assert (m_rev >= BRCM_PCIE_HW_REV_33);
+	uintptr intr_base = m_base + PCIE_MSI_INTR2_BASE;
+
 	/*
 	 * ffe0 -- least sig 5 bits are 0 indicating 32 msgs
 	 * 6540 -- this is our arbitrary unique data value
 	 */
-	u32 data_val = 0xffe06540;
+	u32 data_val = 0xffe00000 | BRCM_MSI_DATA_VALUE;
 
 	/*
 	 * Make sure we are not masking MSIs. Note that MSIs can be masked,
 	 * but that occurs on the PCIe EP device
 	 */
-	bcm_writel(0xffffffff, msi->intr_base + MASK_CLR);
+	bcm_writel(0xffffffff, intr_base + CLR);
+	bcm_writel(0xffffffff, intr_base + MASK_CLR);
 
-	u32 msi_lo = lower_32_bits(msi->target_addr);
-	u32 msi_hi = upper_32_bits(msi->target_addr);
+	u32 msi_lo = lower_32_bits(m_msi_target_addr);
+	u32 msi_hi = upper_32_bits(m_msi_target_addr);
 	/*
 	 * The 0 bit of PCIE_MISC_MSI_BAR_CONFIG_LO is repurposed to MSI
 	 * enable, which we set to 1.
 	 */
-	bcm_writel(msi_lo | 1, msi->base + PCIE_MISC_MSI_BAR_CONFIG_LO);
-	bcm_writel(msi_hi, msi->base + PCIE_MISC_MSI_BAR_CONFIG_HI);
-	bcm_writel(data_val, msi->base + PCIE_MISC_MSI_DATA_CONFIG);
+	bcm_writel(msi_lo | 1, m_base + PCIE_MISC_MSI_BAR_CONFIG_LO);
+	bcm_writel(msi_hi, m_base + PCIE_MISC_MSI_BAR_CONFIG_HI);
+	bcm_writel(data_val, m_base + PCIE_MISC_MSI_DATA_CONFIG);
+}
+
+#endif
+
+void CBcmPCIeHostBridge::msi_compose_msg(unsigned vector, u64 *addr, u32 *data)
+{
+	assert (vector < PCIE_MSI_VECTORS);
+	assert (addr != 0);
+	assert (data != 0);
+
+#if RASPPI == 4
+	*addr = m_msi_target_addr;
+	*data = BRCM_MSI_DATA_VALUE | vector;
+#else
+	*addr = MIP_MSI_PCI_ADDR;
+	*data = vector;
+#endif
+}
+
+uintptr CBcmPCIeHostBridge::msix_table_entry(uintptr conf, unsigned entry)
+{
+	uintptr msix_conf = find_pci_capability (conf, PCI_CAP_ID_MSIX);
+	if (!msix_conf)
+		return 0;
+
+	u32 table = read32 (msix_conf + PCI_MSIX_TABLE);
+	if ((table & PCI_MSIX_TABLE_BIR) != 0)
+		return 0;
+
+	/* BAR0 is mapped to the outbound window */
+#if RASPPI == 4
+	uintptr bar0 = MEM_PCIE_RANGE_START_VIRTUAL;
+#else
+	uintptr bar0 = (uintptr) m_out_wins[0].cpu_addr;
+#endif
+
+	return bar0 + (table & PCI_MSIX_TABLE_OFFSET) + entry * PCI_MSIX_ENTRY_SIZE;
 }
 
 /* Configuration space read/write support */
@@ -1074,13 +1354,17 @@ void CBcmPCIeHostBridge::wr_fld_rb(uintptr p, u32 mask, int shift, u32 val)
 	(void)bcm_readl(p);
 }
 
+#if RASPPI == 4
+
 void CBcmPCIeHostBridge::InterruptHandler (void *pParam)
 {
-	TPCIeMSIData *msi = (TPCIeMSIData *) pParam;
-	assert (msi != 0);
+	CBcmPCIeHostBridge *pThis = (CBcmPCIeHostBridge *) pParam;
+	assert (pThis != 0);
+
+	uintptr intr_base = pThis->m_base + PCIE_MSI_INTR2_BASE;
 
 	u32 status;
-	while ((status = bcm_readl(msi->intr_base + STATUS)) != 0)
+	while ((status = bcm_readl(intr_base + STATUS)) != 0)
 	{
 		for (unsigned vector = 0; status && vector < BRCM_INT_PCI_MSI_NR; vector++)
 		{
@@ -1092,18 +1376,34 @@ void CBcmPCIeHostBridge::InterruptHandler (void *pParam)
 			}
 
 			/* clear the interrupt */
-			bcm_writel(mask, msi->intr_base + CLR);
+			bcm_writel(mask, intr_base + CLR);
 
-			assert (msi->handler != 0);
-			(*msi->handler) (vector, msi->param);
+			TPCIeMSIVector *pVector = &s_MSIVector[vector];
+			if (pVector->pHandler != 0)
+			{
+				(*pVector->pHandler) (vector, pVector->pParam);
+			}
 
 			status &= ~mask;
 		}
 	}
 
-	bcm_writel(1, msi->base + PCIE_MISC_EOI_CTRL);
+	bcm_writel(1, pThis->m_base + PCIE_MISC_EOI_CTRL);
+}
+
+#else
+
+void CBcmPCIeHostBridge::MIPInterruptHandler (void *pParam)
+{
+	TPCIeMSIVector *pVector = (TPCIeMSIVector *) pParam;
+	assert (pVector != 0);
+
+	assert (pVector->pHandler != 0);
+	(*pVector->pHandler) (pVector->nVector, pVector->pParam);
 }
 
+#endif
+
 void CBcmPCIeHostBridge::usleep_range (unsigned min, unsigned max)
 {
 	CTimer::SimpleusDelay (min);
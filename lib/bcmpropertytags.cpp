@@ -23,6 +23,7 @@
 #include <circle/bcm2835.h>
 #include <circle/memory.h>
 #include <circle/macros.h>
+#include <circle/atomic.h>
 #include <assert.h>
 
 struct TPropertyBuffer
@@ -37,6 +38,28 @@ struct TPropertyBuffer
 }
 PACKED;
 
+// these tags return the same value on each call
+static const u32 s_CachedTagIds[] =
+{
+	PROPTAG_GET_FIRMWARE_REVISION,
+	PROPTAG_GET_BOARD_MODEL,
+	PROPTAG_GET_BOARD_REVISION,
+	PROPTAG_GET_MAC_ADDRESS,
+	PROPTAG_GET_BOARD_SERIAL,
+	PROPTAG_GET_ARM_MEMORY,
+	PROPTAG_GET_VC_MEMORY
+};
+
+#define CACHED_TAGS	(sizeof s_CachedTagIds / sizeof s_CachedTagIds[0])
+
+CBcmPropertyTags::TCachedTag CBcmPropertyTags::s_CachedTags[CACHED_TAGS];
+
+volatile int CBcmPropertyTags::s_nAsyncBusy = 0;
+void *CBcmPropertyTags::s_pAsyncTags = 0;
+unsigned CBcmPropertyTags::s_nAsyncTagsSize = 0;
+TPropertyTagsCompletionRoutine *CBcmPropertyTags::s_pAsyncRoutine = 0;
+void *CBcmPropertyTags::s_pAsyncParam = 0;
+
 CBcmPropertyTags::CBcmPropertyTags (boolean bEarlyUse)
 :	m_MailBox (BCM_MAILBOX_PROP_OUT, bEarlyUse)
 {
@@ -51,10 +74,23 @@ boolean CBcmPropertyTags::GetTag (u32 nTagId, void *pTag, unsigned nTagSize, uns
 	assert (pTag != 0);
 	assert (nTagSize >= sizeof (TPropertyTagSimple));
 
+	InitTag (pTag, nTagId, nTagSize, nRequestParmSize);
+
 	TPropertyTag *pHeader = (TPropertyTag *) pTag;
-	pHeader->nTagId = nTagId;
-	pHeader->nValueBufSize = nTagSize - sizeof (TPropertyTag);
-	pHeader->nValueLength = nRequestParmSize & ~VALUE_LENGTH_RESPONSE;
+	u8 *pValue = (u8 *) pTag + sizeof (TPropertyTag);
+
+	int nCacheIndex = GetCacheIndex (nTagId, pHeader->nValueBufSize, nRequestParmSize);
+	if (   nCacheIndex >= 0
+	    && s_CachedTags[nCacheIndex].bValid
+	    && s_CachedTags[nCacheIndex].nValueBufSize == pHeader->nValueBufSize)
+	{
+		DataMemBarrier ();
+
+		memcpy (pValue, s_CachedTags[nCacheIndex].Value, pHeader->nValueBufSize);
+		pHeader->nValueLength = s_CachedTags[nCacheIndex].nValueLength;
+
+		return TRUE;
+	}
 
 	if (!GetTags (pTag, nTagSize))
 	{
@@ -67,6 +103,17 @@ boolean CBcmPropertyTags::GetTag (u32 nTagId, void *pTag, unsigned nTagSize, uns
 		return FALSE;
 	}
 
+	if (nCacheIndex >= 0)
+	{
+		memcpy (s_CachedTags[nCacheIndex].Value, pValue, pHeader->nValueBufSize);
+		s_CachedTags[nCacheIndex].nValueBufSize = pHeader->nValueBufSize;
+		s_CachedTags[nCacheIndex].nValueLength = pHeader->nValueLength;
+
+		DataMemBarrier ();
+
+		s_CachedTags[nCacheIndex].bValid = TRUE;
+	}
+
 	return TRUE;
 }
 
@@ -106,3 +153,106 @@ boolean CBcmPropertyTags::GetTags (void *pTags, unsigned nTagsSize)
 
 	return TRUE;
 }
+
+boolean CBcmPropertyTags::GetTagsAsync (void *pTags, unsigned nTagsSize,
+					TPropertyTagsCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pTags != 0);
+	assert (nTagsSize >= sizeof (TPropertyTagSimple));
+	assert (pRoutine != 0);
+	unsigned nBufferSize = sizeof (TPropertyBuffer) + nTagsSize + sizeof (u32);
+	assert ((nBufferSize & 3) == 0);
+	assert (nBufferSize <= PAGE_SIZE);
+
+	if (!CBcmMailBox::IsInterruptConnected ())
+	{
+		return FALSE;
+	}
+
+	// the buffer is released in the completion routine
+	while (AtomicCompareExchange (&s_nAsyncBusy, 0, 1) != 0)
+	{
+		// wait for the mailbox IRQ
+	}
+
+	TPropertyBuffer *pBuffer =
+		(TPropertyBuffer *) CMemorySystem::GetCoherentPage (COHERENT_SLOT_PROP_MAILBOX_ASYNC);
+
+	pBuffer->nBufferSize = nBufferSize;
+	pBuffer->nCode = CODE_REQUEST;
+	memcpy (pBuffer->Tags, pTags, nTagsSize);
+
+	u32 *pEndTag = (u32 *) (pBuffer->Tags + nTagsSize);
+	*pEndTag = PROPTAG_END;
+
+	s_pAsyncTags = pTags;
+	s_nAsyncTagsSize = nTagsSize;
+	s_pAsyncRoutine = pRoutine;
+	s_pAsyncParam = pParam;
+
+	DataSyncBarrier ();
+
+	if (!m_MailBox.WriteReadAsync (BUS_ADDRESS ((uintptr) pBuffer),
+				       AsyncCompletionRoutine, pBuffer))
+	{
+		AtomicSet (&s_nAsyncBusy, 0);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CBcmPropertyTags::AsyncCompletionRoutine (u32 nResult, void *pParam)
+{
+	TPropertyBuffer *pBuffer = (TPropertyBuffer *) pParam;
+	assert (pBuffer != 0);
+
+	DataMemBarrier ();
+
+	boolean bOK =    nResult == BUS_ADDRESS ((uintptr) pBuffer)
+		      && pBuffer->nCode == CODE_RESPONSE_SUCCESS;
+	if (bOK)
+	{
+		assert (s_pAsyncTags != 0);
+		memcpy (s_pAsyncTags, pBuffer->Tags, s_nAsyncTagsSize);
+	}
+
+	TPropertyTagsCompletionRoutine *pRoutine = s_pAsyncRoutine;
+	void *pRoutineParam = s_pAsyncParam;
+
+	AtomicSet (&s_nAsyncBusy, 0);
+
+	assert (pRoutine != 0);
+	(*pRoutine) (bOK, pRoutineParam);
+}
+
+void CBcmPropertyTags::InitTag (void *pTag, u32 nTagId, unsigned nTagSize, unsigned nRequestParmSize)
+{
+	assert (pTag != 0);
+	assert (nTagSize >= sizeof (TPropertyTag));
+
+	TPropertyTag *pHeader = (TPropertyTag *) pTag;
+	pHeader->nTagId = nTagId;
+	pHeader->nValueBufSize = nTagSize - sizeof (TPropertyTag);
+	pHeader->nValueLength = nRequestParmSize & ~VALUE_LENGTH_RESPONSE;
+}
+
+int CBcmPropertyTags::GetCacheIndex (u32 nTagId, unsigned nValueBufSize, unsigned nRequestParmSize)
+{
+	if (   nRequestParmSize != 0
+	    || nValueBufSize > sizeof s_CachedTags[0].Value)
+	{
+		return -1;
+	}
+
+	for (unsigned i = 0; i < CACHED_TAGS; i++)
+	{
+		if (s_CachedTagIds[i] == nTagId)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
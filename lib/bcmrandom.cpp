@@ -2,7 +2,7 @@
 // bcmrandom.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2017  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 // 
 // This file contains code taken from Linux:
 //	drivers/char/hw_random/bcm2835-rng.c
@@ -26,6 +26,8 @@
 #include <circle/bcm2835.h>
 #include <circle/memio.h>
 #include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
 
 // the initial numbers generated are "less random" so will be discarded
 #define RNG_WARMUP_COUNT	0x40000
@@ -34,6 +36,9 @@ CSpinLock CBcmRandomNumberGenerator::s_SpinLock (TASK_LEVEL);
 
 boolean CBcmRandomNumberGenerator::s_bInitialized = FALSE;
 
+u32 CBcmRandomNumberGenerator::s_Pool[RNG_POOL_WORDS];
+unsigned CBcmRandomNumberGenerator::s_nPoolWords = 0;
+
 CBcmRandomNumberGenerator::CBcmRandomNumberGenerator (void)
 {
 	s_SpinLock.Acquire ();
@@ -61,18 +66,70 @@ u32 CBcmRandomNumberGenerator::GetNumber (void)
 {
 	s_SpinLock.Acquire ();
 
+	u32 nResult = GetPoolWord ();
+
+	s_SpinLock.Release ();
+
+	return nResult;
+}
+
+void CBcmRandomNumberGenerator::GetBytes (void *pBuffer, size_t nLength)
+{
+	assert (pBuffer != 0);
+	u8 *pBuffer8 = (u8 *) pBuffer;
+
+	s_SpinLock.Acquire ();
+
+	while (nLength > 0)
+	{
+		u32 nWord = GetPoolWord ();
+
+		size_t nBytes = nLength < sizeof nWord ? nLength : sizeof nWord;
+		memcpy (pBuffer8, &nWord, nBytes);
+
+		pBuffer8 += nBytes;
+		nLength -= nBytes;
+	}
+
+	s_SpinLock.Release ();
+}
+
+u32 CBcmRandomNumberGenerator::GetPoolWord (void)
+{
+	if (s_nPoolWords == 0)
+	{
+		s_nPoolWords = ReadFIFO (s_Pool, RNG_POOL_WORDS);
+		assert (s_nPoolWords > 0);
+	}
+
+	// used words are erased
+	u32 nResult = s_Pool[--s_nPoolWords];
+	s_Pool[s_nPoolWords] = 0;
+
+	return nResult;
+}
+
+unsigned CBcmRandomNumberGenerator::ReadFIFO (u32 *pBuffer, unsigned nMaxWords)
+{
 	PeripheralEntry ();
 
-	while ((read32 (ARM_HW_RNG_STATUS) >> 24) == 0)
+	unsigned nWords;
+	while ((nWords = read32 (ARM_HW_RNG_STATUS) >> 24) == 0)
 	{
 		// just wait
 	}
-	
-	u32 nResult = read32 (ARM_HW_RNG_DATA);
 
-	PeripheralExit ();
+	if (nWords > nMaxWords)
+	{
+		nWords = nMaxWords;
+	}
 
-	s_SpinLock.Release ();
+	for (unsigned i = 0; i < nWords; i++)
+	{
+		pBuffer[i] = read32 (ARM_HW_RNG_DATA);
+	}
 
-	return nResult;
+	PeripheralExit ();
+
+	return nWords;
 }
@@ -2,7 +2,7 @@
 // bcmrandom200.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2016-2019  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2016-2026  R. Stange <rsta2@o2online.de>
 //
 // This file contains code taken from Linux:
 //	drivers/char/hw_random/iproc-rng200.c
@@ -26,6 +26,8 @@
 #include <circle/bcmrandom.h>
 #include <circle/bcm2711.h>
 #include <circle/memio.h>
+#include <circle/util.h>
+#include <assert.h>
 
 #define RNG_CTRL					(ARM_HW_RNG200_BASE + 0x00)
 	#define RNG_CTRL_RNG_RBGEN__MASK			0x00001FFF
@@ -41,6 +43,9 @@ CSpinLock CBcmRandomNumberGenerator::s_SpinLock (TASK_LEVEL);
 
 boolean CBcmRandomNumberGenerator::s_bInitialized = FALSE;
 
+u32 CBcmRandomNumberGenerator::s_Pool[RNG_POOL_WORDS];
+unsigned CBcmRandomNumberGenerator::s_nPoolWords = 0;
+
 CBcmRandomNumberGenerator::CBcmRandomNumberGenerator (void)
 {
 	s_SpinLock.Acquire ();
@@ -77,15 +82,67 @@ u32 CBcmRandomNumberGenerator::GetNumber (void)
 {
 	s_SpinLock.Acquire ();
 
+	u32 nResult = GetPoolWord ();
+
+	s_SpinLock.Release ();
+
+	return nResult;
+}
+
+void CBcmRandomNumberGenerator::GetBytes (void *pBuffer, size_t nLength)
+{
+	assert (pBuffer != 0);
+	u8 *pBuffer8 = (u8 *) pBuffer;
+
+	s_SpinLock.Acquire ();
+
+	while (nLength > 0)
+	{
+		u32 nWord = GetPoolWord ();
+
+		size_t nBytes = nLength < sizeof nWord ? nLength : sizeof nWord;
+		memcpy (pBuffer8, &nWord, nBytes);
+
+		pBuffer8 += nBytes;
+		nLength -= nBytes;
+	}
+
+	s_SpinLock.Release ();
+}
+
+u32 CBcmRandomNumberGenerator::GetPoolWord (void)
+{
+	if (s_nPoolWords == 0)
+	{
+		s_nPoolWords = ReadFIFO (s_Pool, RNG_POOL_WORDS);
+		assert (s_nPoolWords > 0);
+	}
+
+	// used words are erased
+	u32 nResult = s_Pool[--s_nPoolWords];
+	s_Pool[s_nPoolWords] = 0;
+
+	return nResult;
+}
+
+unsigned CBcmRandomNumberGenerator::ReadFIFO (u32 *pBuffer, unsigned nMaxWords)
+{
 	// ensure FIFO is not empty
-	while ((read32 (RNG_FIFO_COUNT) & RNG_FIFO_COUNT_RNG_FIFO_COUNT__MASK) == 0)
+	unsigned nWords;
+	while ((nWords = read32 (RNG_FIFO_COUNT) & RNG_FIFO_COUNT_RNG_FIFO_COUNT__MASK) == 0)
 	{
 		// just wait
 	}
 
-	u32 nResult = read32 (RNG_FIFO_DATA);
+	if (nWords > nMaxWords)
+	{
+		nWords = nMaxWords;
+	}
 
-	s_SpinLock.Release ();
+	for (unsigned i = 0; i < nWords; i++)
+	{
+		pBuffer[i] = read32 (RNG_FIFO_DATA);
+	}
 
-	return nResult;
+	return nWords;
 }
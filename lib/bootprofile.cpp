@@ -0,0 +1,90 @@
+//
+// bootprofile.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/bootprofile.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+static const char From[] = "bootprof";
+
+CBootProfile::TMark CBootProfile::s_Mark[BOOT_PROFILE_MAX_MARKS];
+volatile unsigned CBootProfile::s_nMarks = 0;
+
+void CBootProfile::Mark (const char *pPhase)
+{
+	assert (pPhase != 0);
+
+	u64 ullTimestamp = CTimer::GetClockTicks64 ();
+
+	EnterCritical (IRQ_LEVEL);
+
+	unsigned nIndex = s_nMarks;
+	if (nIndex < BOOT_PROFILE_MAX_MARKS)
+	{
+		s_Mark[nIndex].pPhase = pPhase;
+		s_Mark[nIndex].ullTimestamp = ullTimestamp;
+
+		s_nMarks = nIndex+1;
+	}
+
+	LeaveCritical ();
+}
+
+void CBootProfile::Dump (void)
+{
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	unsigned nMarks = s_nMarks;
+	for (unsigned i = 0; i < nMarks; i++)
+	{
+		// the duration of a phase lasts until the next mark
+		u64 ullDuration =   i+1 < nMarks
+				  ? s_Mark[i+1].ullTimestamp - s_Mark[i].ullTimestamp
+				  : CTimer::GetClockTicks64 () - s_Mark[i].ullTimestamp;
+
+		pLogger->Write (From, LogNotice, "%-24s at %6u.%03u ms, took %6u.%03u ms",
+				s_Mark[i].pPhase,
+				(unsigned) (s_Mark[i].ullTimestamp / 1000),
+				(unsigned) (s_Mark[i].ullTimestamp % 1000),
+				(unsigned) (ullDuration / 1000),
+				(unsigned) (ullDuration % 1000));
+	}
+}
+
+unsigned CBootProfile::GetCount (void)
+{
+	return s_nMarks;
+}
+
+const char *CBootProfile::GetPhase (unsigned nIndex)
+{
+	assert (nIndex < s_nMarks);
+
+	return s_Mark[nIndex].pPhase;
+}
+
+u64 CBootProfile::GetTimestamp (unsigned nIndex)
+{
+	assert (nIndex < s_nMarks);
+
+	return s_Mark[nIndex].ullTimestamp;
+}
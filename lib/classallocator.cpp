@@ -20,6 +20,8 @@
 #include <circle/classallocator.h>
 #include <circle/alloc.h>
 #include <circle/logger.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
 
 #define BLOCK_ALIGN	16U
 #define ALIGN_MASK	(~(BLOCK_ALIGN-1))
@@ -36,13 +38,42 @@ struct TBlock
 	unsigned char  Data[0];
 };
 
+// The lock-free global free list is a Treiber stack. Its head is a tagged pointer, which
+// contains a modification counter to solve the ABA problem. Blocks are 16 byte aligned, so
+// the pointer is stored shifted right by 4 bits (AArch64 addresses are below 2^48).
+#if AARCH == 32
+	#define TAG_SHIFT	32
+#else
+	#define TAG_SHIFT	44
+#endif
+#define POINTER_MASK	((1ULL << TAG_SHIFT)-1)
+#define TAG_INCREMENT	(1ULL << TAG_SHIFT)
+
+// number of blocks moved between a per-core and the global free list at once
+#define CORE_CACHE_BATCH	8
+
+// blocks, which can be held in the per-core free list of one core at most
+#define CORE_CACHE_MAX		(2*CORE_CACHE_BATCH-1)
+
+static inline TBlock *Untag (u64 nTagged)
+{
+	return reinterpret_cast<TBlock *> (static_cast<uintptr> ((nTagged & POINTER_MASK) << 4));
+}
+
+static inline u64 Tag (TBlock *pBlock, u64 nPrevTagged)
+{
+	return   ((nPrevTagged & ~POINTER_MASK) + TAG_INCREMENT)
+	       | (static_cast<u64> (reinterpret_cast<uintptr> (pBlock)) >> 4);
+}
+
 CClassAllocator::CClassAllocator (size_t      nObjectSize,
 				  unsigned    nReservedObjects,
 				  const char *pClassName)
 :	m_pClassName (pClassName),
 	m_pMemory (0),
 	m_pFreeList (0),
-	m_bProtected (FALSE)
+	m_bProtected (FALSE),
+	m_bLockFree (FALSE)
 {
 	Init (nObjectSize, nReservedObjects);
 }
@@ -56,11 +87,45 @@ CClassAllocator::CClassAllocator (size_t      nObjectSize,
 	m_pFreeList (0),
 	m_bProtected (TRUE),
 	m_nTargetLevel (nTargetLevel),
-	m_SpinLock (nTargetLevel)
+	m_SpinLock (nTargetLevel),
+	m_bLockFree (FALSE)
 {
 	Init (nObjectSize, nReservedObjects);
 }
 
+CClassAllocator::CClassAllocator (size_t      nObjectSize,
+				  unsigned    nReservedObjects,
+				  unsigned    nTargetLevel,
+				  boolean     bLockFree,
+				  const char *pClassName)
+:	m_pClassName (pClassName),
+	m_pMemory (0),
+	m_pFreeList (0),
+	m_bProtected (FALSE),
+	m_nTargetLevel (nTargetLevel),
+	m_bLockFree (TRUE),
+	m_nGlobalFreeList (0)
+{
+	assert (bLockFree);
+
+	for (unsigned i = 0; i < sizeof m_CoreCache / sizeof m_CoreCache[0]; i++)
+	{
+		m_CoreCache[i].pFreeList = 0;
+		m_CoreCache[i].nCount = 0;
+	}
+
+	// The blocks cached on the other cores are not available to a core, so that these
+	// are reserved in addition to the requested number of objects.
+	unsigned nCores = sizeof m_CoreCache / sizeof m_CoreCache[0];
+	Init (nObjectSize, nReservedObjects + (nCores-1) * CORE_CACHE_MAX);
+
+	// move initial blocks to the global free list
+	m_nGlobalFreeList = Tag (m_pFreeList, 0);
+	m_pFreeList = 0;
+
+	DataMemBarrier ();
+}
+
 // TODO: Does not free all memory, if class store has been extended.
 CClassAllocator::~CClassAllocator (void)
 {
@@ -109,7 +174,7 @@ void CClassAllocator::Init (size_t nObjectSize, unsigned nReservedObjects)
 
 void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
 {
-	assert (m_bProtected);
+	assert (m_bProtected || m_bLockFree);
 	assert (m_nTargetLevel == nTargetLevel);
 	assert (nReservedObjects > 0);
 
@@ -121,6 +186,32 @@ void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
 	}
 	assert ((reinterpret_cast<uintptr> (pMemory) & ~ALIGN_MASK) == 0);
 
+	if (m_bLockFree)
+	{
+		// build a private chain and publish it with a single CAS
+		TBlock *pFirst = 0;
+		TBlock *pLast = 0;
+		for (unsigned i = 0; i < nReservedObjects; i++)
+		{
+			TBlock *pBlock = reinterpret_cast<TBlock *> (pMemory + m_nObjectSize*i);
+
+			pBlock->nMagic = BLOCK_MAGIC;
+			pBlock->pNext = pFirst;
+
+			pFirst = pBlock;
+			if (pLast == 0)
+			{
+				pLast = pBlock;
+			}
+		}
+
+		PushGlobal (pFirst, pLast);
+
+		__atomic_add_fetch (&m_nReservedObjects, nReservedObjects, __ATOMIC_RELAXED);
+
+		return;
+	}
+
 	m_SpinLock.Acquire ();
 
 	for (unsigned i = 0; i < nReservedObjects; i++)
@@ -140,6 +231,11 @@ void CClassAllocator::Extend (unsigned nReservedObjects, unsigned nTargetLevel)
 
 void *CClassAllocator::Allocate (void)
 {
+	if (m_bLockFree)
+	{
+		return AllocateLockFree ();
+	}
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Acquire ();
@@ -181,6 +277,13 @@ void CClassAllocator::Free (void *pBlock)
 	assert (pBlk->nMagic == BLOCK_MAGIC);
 	assert (pBlk->pNext == 0);
 
+	if (m_bLockFree)
+	{
+		FreeLockFree (pBlk);
+
+		return;
+	}
+
 	if (m_bProtected)
 	{
 		m_SpinLock.Acquire ();
@@ -194,3 +297,130 @@ void CClassAllocator::Free (void *pBlock)
 		m_SpinLock.Release ();
 	}
 }
+
+void *CClassAllocator::AllocateLockFree (void)
+{
+	// The per-core free list is only accessed from this core, so disabling the interrupts
+	// up to the target level locally is sufficient to protect it. IRQs are disabled at
+	// least, because a preemptive task switch on return from an IRQ could run another
+	// task on this core, while the list is modified.
+	EnterCritical (m_nTargetLevel > IRQ_LEVEL ? m_nTargetLevel : IRQ_LEVEL);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+#else
+	TCoreCache *pCache = &m_CoreCache[0];
+#endif
+
+	if (pCache->pFreeList == 0)
+	{
+		// refill per-core free list from the global free list
+		for (unsigned i = 0; i < CORE_CACHE_BATCH; i++)
+		{
+			TBlock *pBlock = PopGlobal ();
+			if (pBlock == 0)
+			{
+				break;
+			}
+
+			pBlock->pNext = pCache->pFreeList;
+			pCache->pFreeList = pBlock;
+			pCache->nCount++;
+		}
+	}
+
+	TBlock *pBlock = pCache->pFreeList;
+	if (pBlock != 0)
+	{
+		pCache->pFreeList = pBlock->pNext;
+		pCache->nCount--;
+	}
+
+	LeaveCritical ();
+
+	if (pBlock == 0)
+	{
+		CLogger::Get ()->Write (m_pClassName, LogPanic,
+					"Trying to allocate more than %u instances",
+					m_nReservedObjects);
+
+		return 0;
+	}
+
+	assert (pBlock->nMagic == BLOCK_MAGIC);
+	pBlock->pNext = 0;
+
+	return pBlock->Data;
+}
+
+void CClassAllocator::FreeLockFree (TBlock *pBlock)
+{
+	EnterCritical (m_nTargetLevel > IRQ_LEVEL ? m_nTargetLevel : IRQ_LEVEL);
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()];
+#else
+	TCoreCache *pCache = &m_CoreCache[0];
+#endif
+
+	pBlock->pNext = pCache->pFreeList;
+	pCache->pFreeList = pBlock;
+
+	if (++pCache->nCount > CORE_CACHE_MAX)
+	{
+		// return a batch to the global free list, so that other cores can use it
+		TBlock *pFirst = pCache->pFreeList;
+		TBlock *pLast = pFirst;
+		for (unsigned i = 1; i < CORE_CACHE_BATCH; i++)
+		{
+			pLast = pLast->pNext;
+			assert (pLast != 0);
+		}
+
+		pCache->pFreeList = pLast->pNext;
+		pCache->nCount -= CORE_CACHE_BATCH;
+
+		PushGlobal (pFirst, pLast);
+	}
+
+	LeaveCritical ();
+}
+
+TBlock *CClassAllocator::PopGlobal (void)
+{
+	u64 nHead = __atomic_load_n (&m_nGlobalFreeList, __ATOMIC_ACQUIRE);
+
+	TBlock *pBlock;
+	do
+	{
+		pBlock = Untag (nHead);
+		if (pBlock == 0)
+		{
+			return 0;
+		}
+
+		// pBlock may have been allocated meanwhile, but it is never returned to the
+		// heap, so reading pNext is safe. The tag lets the CAS fail in this case.
+	}
+	while (!__atomic_compare_exchange_n (&m_nGlobalFreeList, &nHead,
+					     Tag (pBlock->pNext, nHead), TRUE,
+					     __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE));
+
+	return pBlock;
+}
+
+void CClassAllocator::PushGlobal (TBlock *pFirst, TBlock *pLast)
+{
+	assert (pFirst != 0);
+	assert (pLast != 0);
+
+	u64 nHead = __atomic_load_n (&m_nGlobalFreeList, __ATOMIC_RELAXED);
+
+	do
+	{
+		pLast->pNext = Untag (nHead);
+	}
+	while (!__atomic_compare_exchange_n (&m_nGlobalFreeList, &nHead,
+					     Tag (pFirst, nHead), TRUE,
+					     __ATOMIC_RELEASE, __ATOMIC_RELAXED));
+}
@@ -0,0 +1,126 @@
+//
+// corechannel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/corechannel.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/multicore.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// The ring works like CSPSCQueue, but holds message copies. Each slot starts on a cache
+// line, so that the sender and the receiver do not share lines of different messages.
+
+CCoreChannel::CCoreChannel (unsigned nSenderCore, unsigned nReceiverCore,
+			    size_t nMessageSize, unsigned nSize)
+:	m_nSenderCore (nSenderCore),
+	m_nReceiverCore (nReceiverCore),
+	m_nMessageSize (nMessageSize),
+	m_nSlotSize (  (nMessageSize + DATA_CACHE_LINE_LENGTH_MAX-1)
+		     & ~(DATA_CACHE_LINE_LENGTH_MAX-1)),
+	m_nMask (nSize-1),
+	m_nHead (0),
+	m_nTail (0),
+	m_bReceiverWaiting (FALSE)
+{
+	assert (nSenderCore < CORES);
+	assert (nReceiverCore < CORES);
+	assert (nSenderCore != nReceiverCore);
+	assert (nMessageSize > 0);
+	assert (IS_POWEROF_2 (nSize));
+
+	m_pBuffer = new u8[m_nSlotSize * nSize];
+	assert (m_pBuffer != 0);
+}
+
+CCoreChannel::~CCoreChannel (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+boolean CCoreChannel::IsEmpty (void) const
+{
+	return   __atomic_load_n (&m_nHead, __ATOMIC_RELAXED)
+	      == __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE);
+}
+
+boolean CCoreChannel::Send (const void *pMessage)
+{
+	assert (CMultiCoreSupport::ThisCore () == m_nSenderCore);
+
+	unsigned nTail = __atomic_load_n (&m_nTail, __ATOMIC_RELAXED);
+	if (nTail - __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE) > m_nMask)
+	{
+		return FALSE;
+	}
+
+	assert (pMessage != 0);
+	memcpy (m_pBuffer + (nTail & m_nMask) * m_nSlotSize, pMessage, m_nMessageSize);
+
+	__atomic_store_n (&m_nTail, nTail+1, __ATOMIC_RELEASE);
+
+	// the tail must be visible, before the waiting flag is read
+	DataMemBarrier ();
+
+	if (m_bReceiverWaiting)
+	{
+		CMultiCoreSupport::SendIPI (m_nReceiverCore, IPI_WAKE_CORE);
+	}
+
+	return TRUE;
+}
+
+boolean CCoreChannel::Receive (void *pMessage)
+{
+	assert (CMultiCoreSupport::ThisCore () == m_nReceiverCore);
+
+	unsigned nHead = __atomic_load_n (&m_nHead, __ATOMIC_RELAXED);
+	if (nHead == __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE))
+	{
+		return FALSE;
+	}
+
+	assert (pMessage != 0);
+	memcpy (pMessage, m_pBuffer + (nHead & m_nMask) * m_nSlotSize, m_nMessageSize);
+
+	__atomic_store_n (&m_nHead, nHead+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+void CCoreChannel::WaitAndReceive (void *pMessage)
+{
+	while (!Receive (pMessage))
+	{
+		m_bReceiverWaiting = TRUE;
+		DataMemBarrier ();
+
+		// check again, a message may have been sent in the meantime
+		if (IsEmpty ())
+		{
+			WaitForEvent ();
+		}
+
+		m_bReceiverWaiting = FALSE;
+	}
+}
+
+#endif
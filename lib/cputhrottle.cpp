@@ -37,12 +37,17 @@ CCPUThrottle::CCPUThrottle (TCPUSpeed InitialSpeed)
 	m_nMaxTemperature (85000),
 	m_nEnforcedTemperature (60000),
 	m_SpeedSet (CPUSpeedUnknown),
+	m_nRequestedRate (0),
+	m_nCurrentRate (0),
+	m_bTemperatureLimit (FALSE),
 	m_nTicksLastSet (0),
 	m_nTicksLastUpdate (0),
 	m_ThrottledStateMask (SystemStateNothingOccurred),
 	m_LastThrottledState (SystemStateNothingOccurred),
 	m_pThrottledHandler (0),
 	m_pThrottledParam (0),
+	m_nClockRateStats (0),
+	m_nTicksLastRateChange (0),
 	m_bFanConnected (FALSE),
 	m_bFanActiveLow (FALSE)
 {
@@ -169,10 +174,43 @@ TCPUSpeed CCPUThrottle::SetSpeed (TCPUSpeed Speed, boolean bWait)
 
 	TCPUSpeed PreviousSpeed = m_SpeedSet;
 	m_SpeedSet = Speed;
+	m_nRequestedRate = Speed == CPUSpeedMaximum ? m_nMaxClockRate : m_nMinClockRate;
 
 	return PreviousSpeed;
 }
 
+boolean CCPUThrottle::RequestClockRate (unsigned nClockRate)
+{
+	if (!m_bDynamic)
+	{
+		return TRUE;
+	}
+
+	if (nClockRate < m_nMinClockRate)
+	{
+		nClockRate = m_nMinClockRate;
+	}
+	else if (nClockRate > m_nMaxClockRate)
+	{
+		nClockRate = m_nMaxClockRate;
+	}
+
+	m_nRequestedRate = nClockRate;
+
+	if (   m_SpeedSet != CPUSpeedMaximum
+	    || m_bTemperatureLimit)
+	{
+		nClockRate = m_nMinClockRate;
+	}
+
+	if (nClockRate == m_nCurrentRate)
+	{
+		return TRUE;
+	}
+
+	return SetClockRateInternal (nClockRate, FALSE);
+}
+
 boolean CCPUThrottle::SetOnTemperature (void)
 {
 	if (m_bFanConnected)
@@ -224,19 +262,23 @@ boolean CCPUThrottle::SetOnTemperature (void)
 		m_nEnforcedTemperature = m_nMaxTemperature;
 	}
 
-	if (   nTemperature > m_nEnforcedTemperature
-	    && nCurrentRate > m_nMinClockRate)
+	if (nTemperature > m_nEnforcedTemperature)
 	{
-		if (!SetSpeedInternal (CPUSpeedLow, FALSE))
+		m_bTemperatureLimit = TRUE;
+
+		if (   nCurrentRate > m_nMinClockRate
+		    && !SetSpeedInternal (CPUSpeedLow, FALSE))
 		{
 			return FALSE;
 		}
 	}
-	else if (   nTemperature < (m_nEnforcedTemperature-3000)	// 3 degrees hysteresis
-		 && nCurrentRate < m_nMaxClockRate
-		 && m_SpeedSet == CPUSpeedMaximum)
+	else if (nTemperature < (m_nEnforcedTemperature-3000))	// 3 degrees hysteresis
 	{
-		if (!SetSpeedInternal (m_SpeedSet, FALSE))
+		m_bTemperatureLimit = FALSE;
+
+		if (   nCurrentRate < m_nRequestedRate
+		    && m_SpeedSet == CPUSpeedMaximum
+		    && !SetClockRateInternal (m_nRequestedRate, FALSE))
 		{
 			return FALSE;
 		}
@@ -260,6 +302,8 @@ boolean CCPUThrottle::Update (void)
 		}
 
 		m_nTicksLastUpdate = nTicks;
+
+		UpdateClockRateStats (m_nCurrentRate);	// prevent wrap around of the tick delta
 	}
 
 	return bOK;
@@ -278,6 +322,25 @@ void CCPUThrottle::RegisterSystemThrottledHandler (unsigned StateMask,
 	m_pThrottledParam = pParam;
 }
 
+unsigned CCPUThrottle::GetClockRateStats (TCPUClockRateStat *pStats, unsigned nMaxEntries)
+{
+	UpdateClockRateStats (m_nCurrentRate);
+
+	unsigned nEntries = m_nClockRateStats;
+	if (nEntries > nMaxEntries)
+	{
+		nEntries = nMaxEntries;
+	}
+
+	assert (pStats != 0 || nEntries == 0);
+	for (unsigned i = 0; i < nEntries; i++)
+	{
+		pStats[i] = m_ClockRateStats[i];
+	}
+
+	return nEntries;
+}
+
 void CCPUThrottle::DumpStatus (boolean bAll)
 {
 	CLogger *pLogger = CLogger::Get ();
@@ -300,6 +363,15 @@ void CCPUThrottle::DumpStatus (boolean bAll)
 		{
 			pLogger->Write (FromCPUThrottle, LogDebug, "Dynamic clock rate disabled");
 		}
+
+		UpdateClockRateStats (m_nCurrentRate);
+
+		for (unsigned i = 0; i < m_nClockRateStats; i++)
+		{
+			pLogger->Write (FromCPUThrottle, LogDebug, "%4u MHz: %llu ms",
+					m_ClockRateStats[i].nClockRate / 1000000,
+					m_ClockRateStats[i].ullMicros / 1000);
+		}
 	}
 
 	pLogger->Write (FromCPUThrottle, LogDebug, "Current clock rate is %u MHz",
@@ -318,21 +390,16 @@ boolean CCPUThrottle::SetSpeedInternal (TCPUSpeed Speed, boolean bWait)
 {
 	assert (m_bDynamic);
 
-	SetToSetDelay ();
-
 	unsigned nClockRate;
-	boolean bSkipTurbo;
 
 	switch (Speed)
 	{
 	case CPUSpeedLow:
 		nClockRate = m_nMinClockRate;
-		bSkipTurbo = FALSE;
 		break;
 
 	case CPUSpeedMaximum:
 		nClockRate = m_nMaxClockRate;
-		bSkipTurbo = FALSE;
 		break;
 
 	default:
@@ -341,11 +408,22 @@ boolean CCPUThrottle::SetSpeedInternal (TCPUSpeed Speed, boolean bWait)
 
 	}
 
-	if (!SetClockRate (nClockRate, bSkipTurbo))
+	return SetClockRateInternal (nClockRate, bWait);
+}
+
+boolean CCPUThrottle::SetClockRateInternal (unsigned nClockRate, boolean bWait)
+{
+	assert (m_bDynamic);
+
+	SetToSetDelay ();
+
+	if (!SetClockRate (nClockRate, FALSE))
 	{
 		return FALSE;
 	}
 
+	UpdateClockRateStats (nClockRate);
+
 	if (bWait)
 	{
 		CTimer::SimpleusDelay (TRANSITION_DELAY_USECS);
@@ -354,6 +432,48 @@ boolean CCPUThrottle::SetSpeedInternal (TCPUSpeed Speed, boolean bWait)
 	return TRUE;
 }
 
+void CCPUThrottle::UpdateClockRateStats (unsigned nNewClockRate)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+
+	if (m_nCurrentRate != 0)
+	{
+		for (unsigned i = 0; i < m_nClockRateStats; i++)
+		{
+			if (m_ClockRateStats[i].nClockRate == m_nCurrentRate)
+			{
+				m_ClockRateStats[i].ullMicros +=
+					(nTicks - m_nTicksLastRateChange) / (CLOCKHZ / 1000000);
+
+				break;
+			}
+		}
+	}
+
+	m_nTicksLastRateChange = nTicks;
+	m_nCurrentRate = nNewClockRate;
+
+	if (nNewClockRate == 0)
+	{
+		return;
+	}
+
+	for (unsigned i = 0; i < m_nClockRateStats; i++)
+	{
+		if (m_ClockRateStats[i].nClockRate == nNewClockRate)
+		{
+			return;
+		}
+	}
+
+	if (m_nClockRateStats < CPU_CLOCK_RATE_STATS_MAX)
+	{
+		m_ClockRateStats[m_nClockRateStats].nClockRate = nNewClockRate;
+		m_ClockRateStats[m_nClockRateStats].ullMicros = 0;
+		m_nClockRateStats++;
+	}
+}
+
 boolean CCPUThrottle::CheckThrottledState (void)
 {
 	CBcmPropertyTags Tags;
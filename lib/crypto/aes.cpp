@@ -0,0 +1,236 @@
+//
+// aes.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/aes.h>
+#include <circle/crypto/cryptocpu.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if AARCH == 64
+extern "C" void aes_ce_encrypt (const u8 *pRoundKeys, unsigned nRounds, const u8 *pIn, u8 *pOut);
+extern "C" void aes_ce_ctr32 (const u8 *pRoundKeys, unsigned nRounds, const u8 *pIn, u8 *pOut,
+			      size_t nBlocks, u8 *pCounter);
+#endif
+
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+#define ROL8(x, n)	((u8) (((x) << (n)) | ((x) >> (8 - (n)))))
+
+#define GET_BE32(p)	((u32) (p)[0] << 24 | (u32) (p)[1] << 16 | (u32) (p)[2] << 8 | (p)[3])
+#define PUT_BE32(p, v)	((p)[0] = (u8) ((v) >> 24), (p)[1] = (u8) ((v) >> 16), \
+			 (p)[2] = (u8) ((v) >> 8), (p)[3] = (u8) (v))
+
+boolean CAES::s_bTablesValid = FALSE;
+u8 CAES::s_SBox[256];
+u32 CAES::s_TE[256];
+
+CAES::CAES (void)
+:	m_nRounds (0),
+	m_bUseCE (CCryptoCPU::HasAES ())
+{
+	if (!s_bTablesValid)
+	{
+		InitTables ();
+	}
+}
+
+CAES::~CAES (void)
+{
+	memset (m_RoundKeys, 0, sizeof m_RoundKeys);
+}
+
+boolean CAES::SetKey (const u8 *pKey, size_t nKeyLength)
+{
+	if (   nKeyLength != 16
+	    && nKeyLength != 24
+	    && nKeyLength != 32)
+	{
+		return FALSE;
+	}
+
+	unsigned nKeyWords = nKeyLength / 4;
+	m_nRounds = nKeyWords + 6;
+
+	u32 W[4*(AES_MAX_ROUNDS+1)];
+	for (unsigned i = 0; i < nKeyWords; i++)
+	{
+		W[i] = GET_BE32 (pKey + i*4);
+	}
+
+	u8 uchRcon = 0x01;
+	for (unsigned i = nKeyWords; i < 4*(m_nRounds+1); i++)
+	{
+		u32 nTemp = W[i-1];
+		if (i % nKeyWords == 0)
+		{
+			nTemp =   (u32) s_SBox[(nTemp >> 16) & 0xFF] << 24
+				| (u32) s_SBox[(nTemp >> 8) & 0xFF] << 16
+				| (u32) s_SBox[nTemp & 0xFF] << 8
+				| s_SBox[nTemp >> 24];
+			nTemp ^= (u32) uchRcon << 24;
+
+			uchRcon = (u8) (uchRcon << 1) ^ (uchRcon & 0x80 ? 0x1B : 0);
+		}
+		else if (   nKeyWords > 6
+			 && i % nKeyWords == 4)
+		{
+			nTemp =   (u32) s_SBox[nTemp >> 24] << 24
+				| (u32) s_SBox[(nTemp >> 16) & 0xFF] << 16
+				| (u32) s_SBox[(nTemp >> 8) & 0xFF] << 8
+				| s_SBox[nTemp & 0xFF];
+		}
+
+		W[i] = W[i-nKeyWords] ^ nTemp;
+	}
+
+	for (unsigned i = 0; i < 4*(m_nRounds+1); i++)
+	{
+		PUT_BE32 (&m_RoundKeys[i / 4][(i % 4) * 4], W[i]);
+	}
+
+	memset (W, 0, sizeof W);
+
+	return TRUE;
+}
+
+void CAES::EncryptBlock (const u8 *pIn, u8 *pOut) const
+{
+	assert (m_nRounds != 0);
+
+#if AARCH == 64
+	if (m_bUseCE)
+	{
+		aes_ce_encrypt (m_RoundKeys[0], m_nRounds, pIn, pOut);
+
+		return;
+	}
+#endif
+
+	const u8 *pRoundKey = m_RoundKeys[0];
+	u32 s0 = GET_BE32 (pIn)    ^ GET_BE32 (pRoundKey);
+	u32 s1 = GET_BE32 (pIn+4)  ^ GET_BE32 (pRoundKey+4);
+	u32 s2 = GET_BE32 (pIn+8)  ^ GET_BE32 (pRoundKey+8);
+	u32 s3 = GET_BE32 (pIn+12) ^ GET_BE32 (pRoundKey+12);
+
+	for (unsigned nRound = 1; nRound < m_nRounds; nRound++)
+	{
+		pRoundKey += AES_BLOCK_SIZE;
+
+		u32 t0 =   s_TE[s0 >> 24] ^ ROR (s_TE[(s1 >> 16) & 0xFF], 8)
+			 ^ ROR (s_TE[(s2 >> 8) & 0xFF], 16) ^ ROR (s_TE[s3 & 0xFF], 24)
+			 ^ GET_BE32 (pRoundKey);
+		u32 t1 =   s_TE[s1 >> 24] ^ ROR (s_TE[(s2 >> 16) & 0xFF], 8)
+			 ^ ROR (s_TE[(s3 >> 8) & 0xFF], 16) ^ ROR (s_TE[s0 & 0xFF], 24)
+			 ^ GET_BE32 (pRoundKey+4);
+		u32 t2 =   s_TE[s2 >> 24] ^ ROR (s_TE[(s3 >> 16) & 0xFF], 8)
+			 ^ ROR (s_TE[(s0 >> 8) & 0xFF], 16) ^ ROR (s_TE[s1 & 0xFF], 24)
+			 ^ GET_BE32 (pRoundKey+8);
+		u32 t3 =   s_TE[s3 >> 24] ^ ROR (s_TE[(s0 >> 16) & 0xFF], 8)
+			 ^ ROR (s_TE[(s1 >> 8) & 0xFF], 16) ^ ROR (s_TE[s2 & 0xFF], 24)
+			 ^ GET_BE32 (pRoundKey+12);
+
+		s0 = t0;
+		s1 = t1;
+		s2 = t2;
+		s3 = t3;
+	}
+
+	pRoundKey += AES_BLOCK_SIZE;
+
+	u32 t0 =   (u32) s_SBox[s0 >> 24] << 24 | (u32) s_SBox[(s1 >> 16) & 0xFF] << 16
+		 | (u32) s_SBox[(s2 >> 8) & 0xFF] << 8 | s_SBox[s3 & 0xFF];
+	u32 t1 =   (u32) s_SBox[s1 >> 24] << 24 | (u32) s_SBox[(s2 >> 16) & 0xFF] << 16
+		 | (u32) s_SBox[(s3 >> 8) & 0xFF] << 8 | s_SBox[s0 & 0xFF];
+	u32 t2 =   (u32) s_SBox[s2 >> 24] << 24 | (u32) s_SBox[(s3 >> 16) & 0xFF] << 16
+		 | (u32) s_SBox[(s0 >> 8) & 0xFF] << 8 | s_SBox[s1 & 0xFF];
+	u32 t3 =   (u32) s_SBox[s3 >> 24] << 24 | (u32) s_SBox[(s0 >> 16) & 0xFF] << 16
+		 | (u32) s_SBox[(s1 >> 8) & 0xFF] << 8 | s_SBox[s2 & 0xFF];
+
+	PUT_BE32 (pOut,    t0 ^ GET_BE32 (pRoundKey));
+	PUT_BE32 (pOut+4,  t1 ^ GET_BE32 (pRoundKey+4));
+	PUT_BE32 (pOut+8,  t2 ^ GET_BE32 (pRoundKey+8));
+	PUT_BE32 (pOut+12, t3 ^ GET_BE32 (pRoundKey+12));
+}
+
+void CAES::CryptCTR32 (const u8 *pIn, u8 *pOut, size_t nLength, u8 *pCounter) const
+{
+	assert (m_nRounds != 0);
+
+#if AARCH == 64
+	size_t nBlocks = nLength / AES_BLOCK_SIZE;
+	if (   m_bUseCE
+	    && nBlocks > 0)
+	{
+		aes_ce_ctr32 (m_RoundKeys[0], m_nRounds, pIn, pOut, nBlocks, pCounter);
+
+		pIn += nBlocks * AES_BLOCK_SIZE;
+		pOut += nBlocks * AES_BLOCK_SIZE;
+		nLength -= nBlocks * AES_BLOCK_SIZE;
+	}
+#endif
+
+	while (nLength > 0)
+	{
+		u8 KeyStream[AES_BLOCK_SIZE];
+		EncryptBlock (pCounter, KeyStream);
+
+		size_t nPart = nLength < AES_BLOCK_SIZE ? nLength : AES_BLOCK_SIZE;
+		for (unsigned i = 0; i < nPart; i++)
+		{
+			pOut[i] = pIn[i] ^ KeyStream[i];
+		}
+
+		u32 nCounter = GET_BE32 (pCounter+12) + 1;
+		PUT_BE32 (pCounter+12, nCounter);
+
+		pIn += nPart;
+		pOut += nPart;
+		nLength -= nPart;
+	}
+}
+
+void CAES::InitTables (void)
+{
+	// generate the S-box from the multiplicative inverse in GF(2^8) and the affine transform
+	u8 p = 1, q = 1;
+	do
+	{
+		p = p ^ (u8) (p << 1) ^ (p & 0x80 ? 0x1B : 0);		// p *= 3
+
+		q ^= q << 1;						// q /= 3
+		q ^= q << 2;
+		q ^= q << 4;
+		q ^= q & 0x80 ? 0x09 : 0;
+
+		s_SBox[p] = q ^ ROL8 (q, 1) ^ ROL8 (q, 2) ^ ROL8 (q, 3) ^ ROL8 (q, 4) ^ 0x63;
+	}
+	while (p != 1);
+
+	s_SBox[0] = 0x63;
+
+	for (unsigned i = 0; i < 256; i++)
+	{
+		u8 s = s_SBox[i];
+		u8 s2 = (u8) (s << 1) ^ (s & 0x80 ? 0x1B : 0);
+		u8 s3 = s2 ^ s;
+
+		s_TE[i] = (u32) s2 << 24 | (u32) s << 16 | (u32) s << 8 | s3;
+	}
+
+	s_bTablesValid = TRUE;
+}
@@ -0,0 +1,248 @@
+//
+// aesgcm.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/aesgcm.h>
+#include <circle/crypto/cryptocpu.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if AARCH == 64
+extern "C" void ghash_ce_update (u8 *pHash, const u8 *pH, const u8 *pData, size_t nBlocks);
+#endif
+
+#define GET_BE64(p)	(  (u64) (p)[0] << 56 | (u64) (p)[1] << 48 | (u64) (p)[2] << 40 \
+			 | (u64) (p)[3] << 32 | (u64) (p)[4] << 24 | (u64) (p)[5] << 16 \
+			 | (u64) (p)[6] << 8 | (p)[7])
+
+static const u64 s_Last4[16] =
+{
+	0x0000, 0x1C20, 0x3840, 0x2460, 0x7080, 0x6CA0, 0x48C0, 0x54E0,
+	0xE100, 0xFD20, 0xD940, 0xC560, 0x9180, 0x8DA0, 0xA9C0, 0xB5E0
+};
+
+static void PutBE64 (u8 *pBuffer, u64 nValue)
+{
+	for (unsigned i = 0; i < 8; i++)
+	{
+		pBuffer[i] = (u8) (nValue >> (56 - i*8));
+	}
+}
+
+CAESGCM::CAESGCM (void)
+:	m_bUsePMULL (CCryptoCPU::HasPMULL ()),
+	m_bKeyValid (FALSE)
+{
+}
+
+CAESGCM::~CAESGCM (void)
+{
+	memset (m_H, 0, sizeof m_H);
+	memset (m_HL, 0, sizeof m_HL);
+	memset (m_HH, 0, sizeof m_HH);
+}
+
+boolean CAESGCM::SetKey (const u8 *pKey, size_t nKeyLength)
+{
+	if (!m_AES.SetKey (pKey, nKeyLength))
+	{
+		return FALSE;
+	}
+
+	u8 Zero[AES_BLOCK_SIZE];
+	memset (Zero, 0, sizeof Zero);
+	m_AES.EncryptBlock (Zero, m_H);
+
+	// precalculate the multiples of H for the 4-bit table method (Shoup)
+	u64 vh = GET_BE64 (m_H);
+	u64 vl = GET_BE64 (m_H + 8);
+
+	m_HL[8] = vl;
+	m_HH[8] = vh;
+	m_HL[0] = 0;
+	m_HH[0] = 0;
+
+	for (unsigned i = 4; i > 0; i >>= 1)
+	{
+		u64 T = (vl & 1) * 0xE1000000U;
+		vl = (vh << 63) | (vl >> 1);
+		vh = (vh >> 1) ^ (T << 32);
+
+		m_HL[i] = vl;
+		m_HH[i] = vh;
+	}
+
+	for (unsigned i = 2; i <= 8; i *= 2)
+	{
+		vh = m_HH[i];
+		vl = m_HL[i];
+		for (unsigned j = 1; j < i; j++)
+		{
+			m_HH[i+j] = vh ^ m_HH[j];
+			m_HL[i+j] = vl ^ m_HL[j];
+		}
+	}
+
+	m_bKeyValid = TRUE;
+
+	return TRUE;
+}
+
+void CAESGCM::Encrypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+		       const u8 *pIn, u8 *pOut, size_t nLength, u8 *pTag)
+{
+	Crypt (pIV, pAAD, nAADLength, pIn, pOut, nLength, FALSE, pTag);
+}
+
+boolean CAESGCM::Decrypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+			  const u8 *pIn, u8 *pOut, size_t nLength, const u8 *pTag)
+{
+	u8 Tag[AES_GCM_TAG_SIZE];
+	Crypt (pIV, pAAD, nAADLength, pIn, pOut, nLength, TRUE, Tag);
+
+	// compare in constant time
+	u8 uchDiff = 0;
+	for (unsigned i = 0; i < AES_GCM_TAG_SIZE; i++)
+	{
+		uchDiff |= Tag[i] ^ pTag[i];
+	}
+
+	if (uchDiff != 0)
+	{
+		memset (pOut, 0, nLength);
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CAESGCM::Crypt (const u8 *pIV, const void *pAAD, size_t nAADLength,
+		     const u8 *pIn, u8 *pOut, size_t nLength, boolean bDecrypt, u8 *pTag)
+{
+	assert (m_bKeyValid);
+
+	u8 Hash[AES_BLOCK_SIZE];
+	memset (Hash, 0, sizeof Hash);
+	GHASH (Hash, (const u8 *) pAAD, nAADLength);
+
+	u8 J0[AES_BLOCK_SIZE];
+	memcpy (J0, pIV, AES_GCM_IV_SIZE);
+	J0[12] = 0;
+	J0[13] = 0;
+	J0[14] = 0;
+	J0[15] = 1;
+
+	u8 Counter[AES_BLOCK_SIZE];
+	memcpy (Counter, J0, AES_BLOCK_SIZE);
+	Counter[15] = 2;
+
+	if (bDecrypt)				// the ciphertext is hashed in any case
+	{
+		GHASH (Hash, pIn, nLength);
+		m_AES.CryptCTR32 (pIn, pOut, nLength, Counter);
+	}
+	else
+	{
+		m_AES.CryptCTR32 (pIn, pOut, nLength, Counter);
+		GHASH (Hash, pOut, nLength);
+	}
+
+	u8 Lengths[AES_BLOCK_SIZE];
+	PutBE64 (Lengths, (u64) nAADLength * 8);
+	PutBE64 (Lengths + 8, (u64) nLength * 8);
+	GHASH (Hash, Lengths, AES_BLOCK_SIZE);
+
+	u8 EJ0[AES_BLOCK_SIZE];
+	m_AES.EncryptBlock (J0, EJ0);
+
+	for (unsigned i = 0; i < AES_GCM_TAG_SIZE; i++)
+	{
+		pTag[i] = Hash[i] ^ EJ0[i];
+	}
+}
+
+void CAESGCM::GHASH (u8 *pHash, const u8 *pData, size_t nLength)
+{
+	size_t nBlocks = nLength / AES_BLOCK_SIZE;
+
+#if AARCH == 64
+	if (   m_bUsePMULL
+	    && nBlocks > 0)
+	{
+		ghash_ce_update (pHash, m_H, pData, nBlocks);
+
+		pData += nBlocks * AES_BLOCK_SIZE;
+		nLength -= nBlocks * AES_BLOCK_SIZE;
+		nBlocks = 0;
+	}
+#endif
+
+	for (; nBlocks > 0; nBlocks--)
+	{
+		for (unsigned i = 0; i < AES_BLOCK_SIZE; i++)
+		{
+			pHash[i] ^= pData[i];
+		}
+
+		MultiplyH (pHash);
+
+		pData += AES_BLOCK_SIZE;
+		nLength -= AES_BLOCK_SIZE;
+	}
+
+	if (nLength > 0)
+	{
+		u8 Block[AES_BLOCK_SIZE];
+		memset (Block, 0, sizeof Block);
+		memcpy (Block, pData, nLength);
+
+		GHASH (pHash, Block, AES_BLOCK_SIZE);
+	}
+}
+
+void CAESGCM::MultiplyH (u8 *pHash) const
+{
+	unsigned nLow = pHash[15] & 0xF;
+	u64 zh = m_HH[nLow];
+	u64 zl = m_HL[nLow];
+
+	for (int i = 15; i >= 0; i--)
+	{
+		nLow = pHash[i] & 0xF;
+		unsigned nHigh = pHash[i] >> 4;
+
+		if (i != 15)
+		{
+			unsigned nRem = zl & 0xF;
+			zl = (zh << 60) | (zl >> 4);
+			zh = (zh >> 4) ^ (s_Last4[nRem] << 48);
+			zh ^= m_HH[nLow];
+			zl ^= m_HL[nLow];
+		}
+
+		unsigned nRem = zl & 0xF;
+		zl = (zh << 60) | (zl >> 4);
+		zh = (zh >> 4) ^ (s_Last4[nRem] << 48);
+		zh ^= m_HH[nHigh];
+		zl ^= m_HL[nHigh];
+	}
+
+	PutBE64 (pHash, zh);
+	PutBE64 (pHash + 8, zl);
+}
@@ -0,0 +1,156 @@
+//
+// chacha20.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/chacha20.h>
+#include <circle/util.h>
+
+typedef u32 v4u32 __attribute__ ((vector_size (16)));
+
+#define GET_LE32(p)	((u32) (p)[0] | (u32) (p)[1] << 8 | (u32) (p)[2] << 16 | (u32) (p)[3] << 24)
+
+#define ROTL(v, n)	(((v) << (n)) | ((v) >> (32 - (n))))
+
+#define QUARTERROUND(a, b, c, d)			\
+	a += b; d ^= a; d = ROTL (d, 16);		\
+	c += d; b ^= c; b = ROTL (b, 12);		\
+	a += b; d ^= a; d = ROTL (d, 8);		\
+	c += d; b ^= c; b = ROTL (b, 7);
+
+CChaCha20::CChaCha20 (void)
+:	m_nKeyStreamOffset (sizeof m_KeyStream)
+{
+	// "expand 32-byte k"
+	m_State[0] = 0x61707865;
+	m_State[1] = 0x3320646E;
+	m_State[2] = 0x79622D32;
+	m_State[3] = 0x6B206574;
+
+	memset (m_State + 4, 0, 12 * sizeof (u32));
+}
+
+CChaCha20::~CChaCha20 (void)
+{
+	memset (m_State, 0, sizeof m_State);
+	memset (m_KeyStream, 0, sizeof m_KeyStream);
+}
+
+void CChaCha20::SetKey (const u8 *pKey)
+{
+	for (unsigned i = 0; i < 8; i++)
+	{
+		m_State[4+i] = GET_LE32 (pKey + i*4);
+	}
+
+	m_nKeyStreamOffset = sizeof m_KeyStream;
+}
+
+void CChaCha20::SetNonce (const u8 *pNonce, u32 nCounter)
+{
+	m_State[12] = nCounter;
+	m_State[13] = GET_LE32 (pNonce);
+	m_State[14] = GET_LE32 (pNonce + 4);
+	m_State[15] = GET_LE32 (pNonce + 8);
+
+	m_nKeyStreamOffset = sizeof m_KeyStream;
+}
+
+void CChaCha20::Crypt (const u8 *pIn, u8 *pOut, size_t nLength)
+{
+	while (nLength > 0)
+	{
+		if (m_nKeyStreamOffset == sizeof m_KeyStream)
+		{
+			Blocks4 (m_KeyStream);
+			m_nKeyStreamOffset = 0;
+		}
+
+		size_t nPart = sizeof m_KeyStream - m_nKeyStreamOffset;
+		if (nPart > nLength)
+		{
+			nPart = nLength;
+		}
+
+		const u8 *pKeyStream = m_KeyStream + m_nKeyStreamOffset;
+		if (pIn != 0)
+		{
+			for (unsigned i = 0; i < nPart; i++)
+			{
+				pOut[i] = pIn[i] ^ pKeyStream[i];
+			}
+
+			pIn += nPart;
+		}
+		else
+		{
+			memcpy (pOut, pKeyStream, nPart);
+		}
+
+		m_nKeyStreamOffset += nPart;
+		pOut += nPart;
+		nLength -= nPart;
+	}
+}
+
+void CChaCha20::Blocks4 (u8 *pKeyStream)
+{
+	v4u32 x[16], Input[16];
+	for (unsigned i = 0; i < 16; i++)
+	{
+		u32 nValue = m_State[i];
+		Input[i] = (v4u32) {nValue, nValue, nValue, nValue};
+	}
+
+	Input[12] += (v4u32) {0, 1, 2, 3};	// block counters of the four lanes
+
+	for (unsigned i = 0; i < 16; i++)
+	{
+		x[i] = Input[i];
+	}
+
+	for (unsigned i = 0; i < 10; i++)
+	{
+		QUARTERROUND (x[0], x[4], x[8],  x[12])
+		QUARTERROUND (x[1], x[5], x[9],  x[13])
+		QUARTERROUND (x[2], x[6], x[10], x[14])
+		QUARTERROUND (x[3], x[7], x[11], x[15])
+
+		QUARTERROUND (x[0], x[5], x[10], x[15])
+		QUARTERROUND (x[1], x[6], x[11], x[12])
+		QUARTERROUND (x[2], x[7], x[8],  x[13])
+		QUARTERROUND (x[3], x[4], x[9],  x[14])
+	}
+
+	for (unsigned i = 0; i < 16; i++)
+	{
+		x[i] += Input[i];
+
+		for (unsigned nLane = 0; nLane < 4; nLane++)
+		{
+			u32 nValue = x[i][nLane];
+			u8 *p = pKeyStream + nLane*CHACHA20_BLOCK_SIZE + i*4;
+
+			p[0] = (u8) nValue;
+			p[1] = (u8) (nValue >> 8);
+			p[2] = (u8) (nValue >> 16);
+			p[3] = (u8) (nValue >> 24);
+		}
+	}
+
+	m_State[12] += 4;
+}
@@ -0,0 +1,102 @@
+//
+// chacha20poly1305.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/chacha20poly1305.h>
+#include <circle/util.h>
+
+CChaCha20Poly1305::CChaCha20Poly1305 (void)
+{
+	memset (m_Key, 0, sizeof m_Key);
+}
+
+CChaCha20Poly1305::~CChaCha20Poly1305 (void)
+{
+	memset (m_Key, 0, sizeof m_Key);
+}
+
+void CChaCha20Poly1305::SetKey (const u8 *pKey)
+{
+	memcpy (m_Key, pKey, CHACHA20_KEY_SIZE);
+}
+
+void CChaCha20Poly1305::Encrypt (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+				 const u8 *pIn, u8 *pOut, size_t nLength, u8 *pTag)
+{
+	CChaCha20 ChaCha20;
+	ChaCha20.SetKey (m_Key);
+	ChaCha20.SetNonce (pNonce, 1);
+	ChaCha20.Crypt (pIn, pOut, nLength);
+
+	CalculateTag (pNonce, pAAD, nAADLength, pOut, nLength, pTag);
+}
+
+boolean CChaCha20Poly1305::Decrypt (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+				    const u8 *pIn, u8 *pOut, size_t nLength, const u8 *pTag)
+{
+	u8 Tag[POLY1305_TAG_SIZE];
+	CalculateTag (pNonce, pAAD, nAADLength, pIn, nLength, Tag);
+
+	// compare in constant time
+	u8 uchDiff = 0;
+	for (unsigned i = 0; i < POLY1305_TAG_SIZE; i++)
+	{
+		uchDiff |= Tag[i] ^ pTag[i];
+	}
+
+	if (uchDiff != 0)
+	{
+		return FALSE;
+	}
+
+	CChaCha20 ChaCha20;
+	ChaCha20.SetKey (m_Key);
+	ChaCha20.SetNonce (pNonce, 1);
+	ChaCha20.Crypt (pIn, pOut, nLength);
+
+	return TRUE;
+}
+
+void CChaCha20Poly1305::CalculateTag (const u8 *pNonce, const void *pAAD, size_t nAADLength,
+				      const u8 *pCipherText, size_t nLength, u8 *pTag)
+{
+	// the one-time key is the first half of key stream block 0
+	u8 PolyKey[CHACHA20_BLOCK_SIZE];
+	CChaCha20 ChaCha20;
+	ChaCha20.SetKey (m_Key);
+	ChaCha20.SetNonce (pNonce, 0);
+	ChaCha20.Crypt (0, PolyKey, sizeof PolyKey);
+
+	CPoly1305 Poly1305 (PolyKey);
+	memset (PolyKey, 0, sizeof PolyKey);
+
+	Poly1305.Update (pAAD, nAADLength);
+	Poly1305.Pad ();
+	Poly1305.Update (pCipherText, nLength);
+	Poly1305.Pad ();
+
+	u8 Lengths[16];
+	for (unsigned i = 0; i < 8; i++)
+	{
+		Lengths[i] = (u8) ((u64) nAADLength >> (i*8));
+		Lengths[8+i] = (u8) ((u64) nLength >> (i*8));
+	}
+	Poly1305.Update (Lengths, sizeof Lengths);
+
+	Poly1305.Final (pTag);
+}
@@ -0,0 +1,75 @@
+//
+// cryptocpu.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/cryptocpu.h>
+
+boolean CCryptoCPU::s_bDetected = FALSE;
+boolean CCryptoCPU::s_bHasAES = FALSE;
+boolean CCryptoCPU::s_bHasPMULL = FALSE;
+boolean CCryptoCPU::s_bHasSHA1 = FALSE;
+boolean CCryptoCPU::s_bHasSHA256 = FALSE;
+
+boolean CCryptoCPU::HasAES (void)
+{
+	Detect ();
+
+	return s_bHasAES;
+}
+
+boolean CCryptoCPU::HasPMULL (void)
+{
+	Detect ();
+
+	return s_bHasPMULL;
+}
+
+boolean CCryptoCPU::HasSHA1 (void)
+{
+	Detect ();
+
+	return s_bHasSHA1;
+}
+
+boolean CCryptoCPU::HasSHA256 (void)
+{
+	Detect ();
+
+	return s_bHasSHA256;
+}
+
+void CCryptoCPU::Detect (void)
+{
+	if (s_bDetected)
+	{
+		return;
+	}
+
+#if AARCH == 64
+	u64 nISAR0;
+	asm volatile ("mrs %0, id_aa64isar0_el1" : "=r" (nISAR0));
+
+	unsigned nAES = (nISAR0 >> 4) & 0xF;
+	s_bHasAES = nAES >= 1;
+	s_bHasPMULL = nAES >= 2;
+	s_bHasSHA1 = ((nISAR0 >> 8) & 0xF) >= 1;
+	s_bHasSHA256 = ((nISAR0 >> 12) & 0xF) >= 1;
+#endif
+
+	s_bDetected = TRUE;
+}
@@ -0,0 +1,128 @@
+//
+// cryptorandom.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/cryptorandom.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+static const u8 s_Nonce[CHACHA20_NONCE_SIZE] = {0};
+
+CCryptoRandom::CCryptoRandom (void)
+:	m_bSeeded (FALSE),
+	m_nBytesSinceReseed (0),
+	m_ullLastReseed (0),
+	m_nBufferOffset (CRYPTO_RANDOM_BUFFER_SIZE)
+{
+}
+
+CCryptoRandom::~CCryptoRandom (void)
+{
+	memset (m_Buffer, 0, sizeof m_Buffer);
+}
+
+void CCryptoRandom::GetBytes (void *pBuffer, size_t nLength)
+{
+	assert (pBuffer != 0);
+	u8 *pBuffer8 = (u8 *) pBuffer;
+
+	m_SpinLock.Acquire ();
+
+	while (nLength > 0)
+	{
+		if (m_nBufferOffset >= CRYPTO_RANDOM_BUFFER_SIZE)
+		{
+			Refill ();
+		}
+
+		size_t nBytes = CRYPTO_RANDOM_BUFFER_SIZE - m_nBufferOffset;
+		if (nBytes > nLength)
+		{
+			nBytes = nLength;
+		}
+
+		memcpy (pBuffer8, m_Buffer + m_nBufferOffset, nBytes);
+		memset (m_Buffer + m_nBufferOffset, 0, nBytes);
+		m_nBufferOffset += nBytes;
+
+		pBuffer8 += nBytes;
+		nLength -= nBytes;
+	}
+
+	m_SpinLock.Release ();
+}
+
+u32 CCryptoRandom::GetNumber (void)
+{
+	u32 nNumber;
+	GetBytes (&nNumber, sizeof nNumber);
+
+	return nNumber;
+}
+
+void CCryptoRandom::Refill (void)
+{
+	if (   !m_bSeeded
+	    || m_nBytesSinceReseed >= CRYPTO_RANDOM_RESEED_INTERVAL
+	    || CTimer::GetClockTicks64 () - m_ullLastReseed >= CRYPTO_RANDOM_RESEED_TIME * 1000000ULL)
+	{
+		Reseed ();
+	}
+
+	// four ChaCha20 blocks are calculated at once
+	m_ChaCha20.Crypt (0, m_Buffer, sizeof m_Buffer);
+	m_nBytesSinceReseed += CRYPTO_RANDOM_BUFFER_SIZE;
+
+	// fast key erasure: the key, which generated this output, cannot be recovered
+	m_ChaCha20.SetKey (m_Buffer + CRYPTO_RANDOM_BUFFER_SIZE);
+	m_ChaCha20.SetNonce (s_Nonce);
+	memset (m_Buffer + CRYPTO_RANDOM_BUFFER_SIZE, 0, CHACHA20_KEY_SIZE);
+
+	m_nBufferOffset = 0;
+}
+
+void CCryptoRandom::Reseed (void)
+{
+	u8 Key[CHACHA20_KEY_SIZE];
+	if (m_bSeeded)
+	{
+		m_ChaCha20.Crypt (0, Key, sizeof Key);	// keep the entropy of the old state
+	}
+	else
+	{
+		memset (Key, 0, sizeof Key);
+	}
+
+	u8 Seed[CHACHA20_KEY_SIZE];
+	m_HWRandom.GetBytes (Seed, sizeof Seed);
+
+	for (unsigned i = 0; i < CHACHA20_KEY_SIZE; i++)
+	{
+		Key[i] ^= Seed[i];
+	}
+
+	m_ChaCha20.SetKey (Key);
+	m_ChaCha20.SetNonce (s_Nonce);
+	memset (Key, 0, sizeof Key);
+	memset (Seed, 0, sizeof Seed);
+
+	m_bSeeded = TRUE;
+	m_nBytesSinceReseed = 0;
+	m_ullLastReseed = CTimer::GetClockTicks64 ();
+}
@@ -0,0 +1,217 @@
+//
+// poly1305.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/poly1305.h>
+#include <circle/util.h>
+
+#define GET_LE32(p)	((u32) (p)[0] | (u32) (p)[1] << 8 | (u32) (p)[2] << 16 | (u32) (p)[3] << 24)
+
+#define MASK26		0x3FFFFFF
+
+CPoly1305::CPoly1305 (const u8 *pKey)
+:	m_nBufferLength (0)
+{
+	// clamp r and split it into 26-bit limbs
+	m_R[0] = (GET_LE32 (pKey)          ) & 0x3FFFFFF;
+	m_R[1] = (GET_LE32 (pKey + 3)  >> 2) & 0x3FFFF03;
+	m_R[2] = (GET_LE32 (pKey + 6)  >> 4) & 0x3FFC0FF;
+	m_R[3] = (GET_LE32 (pKey + 9)  >> 6) & 0x3F03FFF;
+	m_R[4] = (GET_LE32 (pKey + 12) >> 8) & 0x00FFFFF;
+
+	for (unsigned i = 0; i < 5; i++)
+	{
+		m_H[i] = 0;
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		m_Pad[i] = GET_LE32 (pKey + 16 + i*4);
+	}
+}
+
+CPoly1305::~CPoly1305 (void)
+{
+	memset (m_R, 0, sizeof m_R);
+	memset (m_Pad, 0, sizeof m_Pad);
+}
+
+void CPoly1305::Update (const void *pData, size_t nLength)
+{
+	const u8 *pData8 = (const u8 *) pData;
+
+	if (m_nBufferLength > 0)
+	{
+		size_t nPart = POLY1305_BLOCK_SIZE - m_nBufferLength;
+		if (nPart > nLength)
+		{
+			nPart = nLength;
+		}
+
+		memcpy (m_Buffer + m_nBufferLength, pData8, nPart);
+		m_nBufferLength += nPart;
+		pData8 += nPart;
+		nLength -= nPart;
+
+		if (m_nBufferLength < POLY1305_BLOCK_SIZE)
+		{
+			return;
+		}
+
+		Blocks (m_Buffer, POLY1305_BLOCK_SIZE, 1 << 24);
+		m_nBufferLength = 0;
+	}
+
+	size_t nBlockLength = nLength & ~(POLY1305_BLOCK_SIZE-1);
+	if (nBlockLength > 0)
+	{
+		Blocks (pData8, nBlockLength, 1 << 24);
+		pData8 += nBlockLength;
+		nLength -= nBlockLength;
+	}
+
+	if (nLength > 0)
+	{
+		memcpy (m_Buffer, pData8, nLength);
+		m_nBufferLength = nLength;
+	}
+}
+
+void CPoly1305::Pad (void)
+{
+	if (m_nBufferLength > 0)
+	{
+		memset (m_Buffer + m_nBufferLength, 0, POLY1305_BLOCK_SIZE - m_nBufferLength);
+		Blocks (m_Buffer, POLY1305_BLOCK_SIZE, 1 << 24);
+		m_nBufferLength = 0;
+	}
+}
+
+void CPoly1305::Final (u8 *pTag)
+{
+	if (m_nBufferLength > 0)
+	{
+		m_Buffer[m_nBufferLength++] = 1;
+		memset (m_Buffer + m_nBufferLength, 0, POLY1305_BLOCK_SIZE - m_nBufferLength);
+		Blocks (m_Buffer, POLY1305_BLOCK_SIZE, 0);
+		m_nBufferLength = 0;
+	}
+
+	u32 h0 = m_H[0], h1 = m_H[1], h2 = m_H[2], h3 = m_H[3], h4 = m_H[4];
+
+	// fully carry h
+	u32 c;
+	c = h1 >> 26; h1 &= MASK26;
+	h2 += c; c = h2 >> 26; h2 &= MASK26;
+	h3 += c; c = h3 >> 26; h3 &= MASK26;
+	h4 += c; c = h4 >> 26; h4 &= MASK26;
+	h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+	h1 += c;
+
+	// compute h - p = h + 5 - 2^130
+	u32 g0 = h0 + 5; c = g0 >> 26; g0 &= MASK26;
+	u32 g1 = h1 + c; c = g1 >> 26; g1 &= MASK26;
+	u32 g2 = h2 + c; c = g2 >> 26; g2 &= MASK26;
+	u32 g3 = h3 + c; c = g3 >> 26; g3 &= MASK26;
+	u32 g4 = h4 + c - (1 << 26);
+
+	// select h, if h < p, or h - p otherwise (in constant time)
+	u32 nMask = (g4 >> 31) - 1;
+	g0 &= nMask;
+	g1 &= nMask;
+	g2 &= nMask;
+	g3 &= nMask;
+	g4 &= nMask;
+	nMask = ~nMask;
+	h0 = (h0 & nMask) | g0;
+	h1 = (h1 & nMask) | g1;
+	h2 = (h2 & nMask) | g2;
+	h3 = (h3 & nMask) | g3;
+	h4 = (h4 & nMask) | g4;
+
+	// h = (h + pad) % 2^128
+	h0 = h0 | (h1 << 26);
+	h1 = (h1 >> 6) | (h2 << 20);
+	h2 = (h2 >> 12) | (h3 << 14);
+	h3 = (h3 >> 18) | (h4 << 8);
+
+	u64 f;
+	f = (u64) h0 + m_Pad[0];            h0 = (u32) f;
+	f = (u64) h1 + m_Pad[1] + (f >> 32); h1 = (u32) f;
+	f = (u64) h2 + m_Pad[2] + (f >> 32); h2 = (u32) f;
+	f = (u64) h3 + m_Pad[3] + (f >> 32); h3 = (u32) f;
+
+	u32 Result[4] = {h0, h1, h2, h3};
+	for (unsigned i = 0; i < 4; i++)
+	{
+		pTag[i*4]   = (u8) Result[i];
+		pTag[i*4+1] = (u8) (Result[i] >> 8);
+		pTag[i*4+2] = (u8) (Result[i] >> 16);
+		pTag[i*4+3] = (u8) (Result[i] >> 24);
+	}
+
+	memset (m_H, 0, sizeof m_H);
+}
+
+void CPoly1305::Blocks (const u8 *pData, size_t nLength, u32 nHighBit)
+{
+	const u32 r0 = m_R[0], r1 = m_R[1], r2 = m_R[2], r3 = m_R[3], r4 = m_R[4];
+	const u32 s1 = r1 * 5, s2 = r2 * 5, s3 = r3 * 5, s4 = r4 * 5;
+
+	u32 h0 = m_H[0], h1 = m_H[1], h2 = m_H[2], h3 = m_H[3], h4 = m_H[4];
+
+	for (; nLength >= POLY1305_BLOCK_SIZE; nLength -= POLY1305_BLOCK_SIZE)
+	{
+		// h += m
+		h0 += (GET_LE32 (pData)          ) & MASK26;
+		h1 += (GET_LE32 (pData + 3)  >> 2) & MASK26;
+		h2 += (GET_LE32 (pData + 6)  >> 4) & MASK26;
+		h3 += (GET_LE32 (pData + 9)  >> 6) & MASK26;
+		h4 += (GET_LE32 (pData + 12) >> 8) | nHighBit;
+
+		// h *= r
+		u64 d0 =   (u64) h0 * r0 + (u64) h1 * s4 + (u64) h2 * s3
+			 + (u64) h3 * s2 + (u64) h4 * s1;
+		u64 d1 =   (u64) h0 * r1 + (u64) h1 * r0 + (u64) h2 * s4
+			 + (u64) h3 * s3 + (u64) h4 * s2;
+		u64 d2 =   (u64) h0 * r2 + (u64) h1 * r1 + (u64) h2 * r0
+			 + (u64) h3 * s4 + (u64) h4 * s3;
+		u64 d3 =   (u64) h0 * r3 + (u64) h1 * r2 + (u64) h2 * r1
+			 + (u64) h3 * r0 + (u64) h4 * s4;
+		u64 d4 =   (u64) h0 * r4 + (u64) h1 * r3 + (u64) h2 * r2
+			 + (u64) h3 * r1 + (u64) h4 * r0;
+
+		// partial reduction modulo 2^130 - 5
+		u32 c;
+		c = (u32) (d0 >> 26); h0 = (u32) d0 & MASK26;
+		d1 += c; c = (u32) (d1 >> 26); h1 = (u32) d1 & MASK26;
+		d2 += c; c = (u32) (d2 >> 26); h2 = (u32) d2 & MASK26;
+		d3 += c; c = (u32) (d3 >> 26); h3 = (u32) d3 & MASK26;
+		d4 += c; c = (u32) (d4 >> 26); h4 = (u32) d4 & MASK26;
+		h0 += c * 5; c = h0 >> 26; h0 &= MASK26;
+		h1 += c;
+
+		pData += POLY1305_BLOCK_SIZE;
+	}
+
+	m_H[0] = h0;
+	m_H[1] = h1;
+	m_H[2] = h2;
+	m_H[3] = h3;
+	m_H[4] = h4;
+}
@@ -0,0 +1,203 @@
+//
+// sha1.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/sha1.h>
+#include <circle/crypto/cryptocpu.h>
+#include <circle/util.h>
+
+#if AARCH == 64
+extern "C" void sha1_ce_transform (u32 *pState, const u8 *pData, size_t nBlocks);
+#endif
+
+#define ROL(x, n)	(((x) << (n)) | ((x) >> (32 - (n))))
+
+CSHA1::CSHA1 (void)
+:	m_bUseCE (CCryptoCPU::HasSHA1 ())
+{
+	Reset ();
+}
+
+CSHA1::~CSHA1 (void)
+{
+}
+
+void CSHA1::Reset (void)
+{
+	m_State[0] = 0x67452301;
+	m_State[1] = 0xEFCDAB89;
+	m_State[2] = 0x98BADCFE;
+	m_State[3] = 0x10325476;
+	m_State[4] = 0xC3D2E1F0;
+
+	m_nTotalLength = 0;
+	m_nBufferLength = 0;
+}
+
+void CSHA1::Update (const void *pData, size_t nLength)
+{
+	const u8 *pData8 = (const u8 *) pData;
+	m_nTotalLength += nLength;
+
+	if (m_nBufferLength > 0)
+	{
+		size_t nPart = SHA1_BLOCK_SIZE - m_nBufferLength;
+		if (nPart > nLength)
+		{
+			nPart = nLength;
+		}
+
+		memcpy (m_Buffer + m_nBufferLength, pData8, nPart);
+		m_nBufferLength += nPart;
+		pData8 += nPart;
+		nLength -= nPart;
+
+		if (m_nBufferLength < SHA1_BLOCK_SIZE)
+		{
+			return;
+		}
+
+		Transform (m_Buffer, 1);
+		m_nBufferLength = 0;
+	}
+
+	size_t nBlocks = nLength / SHA1_BLOCK_SIZE;
+	if (nBlocks > 0)
+	{
+		Transform (pData8, nBlocks);
+		pData8 += nBlocks * SHA1_BLOCK_SIZE;
+		nLength -= nBlocks * SHA1_BLOCK_SIZE;
+	}
+
+	if (nLength > 0)
+	{
+		memcpy (m_Buffer, pData8, nLength);
+		m_nBufferLength = nLength;
+	}
+}
+
+void CSHA1::Final (u8 *pDigest)
+{
+	u64 nBitLength = m_nTotalLength * 8;
+
+	m_Buffer[m_nBufferLength++] = 0x80;
+	if (m_nBufferLength > SHA1_BLOCK_SIZE-8)
+	{
+		memset (m_Buffer + m_nBufferLength, 0, SHA1_BLOCK_SIZE - m_nBufferLength);
+		Transform (m_Buffer, 1);
+		m_nBufferLength = 0;
+	}
+
+	memset (m_Buffer + m_nBufferLength, 0, SHA1_BLOCK_SIZE-8 - m_nBufferLength);
+	for (unsigned i = 0; i < 8; i++)
+	{
+		m_Buffer[SHA1_BLOCK_SIZE-1 - i] = (u8) (nBitLength >> (i * 8));
+	}
+	Transform (m_Buffer, 1);
+
+	for (unsigned i = 0; i < 5; i++)
+	{
+		pDigest[i*4]   = (u8) (m_State[i] >> 24);
+		pDigest[i*4+1] = (u8) (m_State[i] >> 16);
+		pDigest[i*4+2] = (u8) (m_State[i] >> 8);
+		pDigest[i*4+3] = (u8) m_State[i];
+	}
+
+	m_nBufferLength = 0;
+}
+
+void CSHA1::Calculate (const void *pData, size_t nLength, u8 *pDigest)
+{
+	CSHA1 SHA1;
+	SHA1.Update (pData, nLength);
+	SHA1.Final (pDigest);
+}
+
+void CSHA1::Transform (const u8 *pData, size_t nBlocks)
+{
+#if AARCH == 64
+	if (m_bUseCE)
+	{
+		sha1_ce_transform (m_State, pData, nBlocks);
+
+		return;
+	}
+#endif
+
+	TransformScalar (m_State, pData, nBlocks);
+}
+
+void CSHA1::TransformScalar (u32 *pState, const u8 *pData, size_t nBlocks)
+{
+	while (nBlocks--)
+	{
+		u32 W[80];
+		for (unsigned i = 0; i < 16; i++)
+		{
+			W[i] =   (u32) pData[i*4] << 24 | (u32) pData[i*4+1] << 16
+			       | (u32) pData[i*4+2] << 8 | pData[i*4+3];
+		}
+
+		for (unsigned i = 16; i < 80; i++)
+		{
+			W[i] = ROL (W[i-3] ^ W[i-8] ^ W[i-14] ^ W[i-16], 1);
+		}
+
+		u32 a = pState[0], b = pState[1], c = pState[2], d = pState[3], e = pState[4];
+
+		for (unsigned i = 0; i < 80; i++)
+		{
+			u32 f, k;
+			if (i < 20)
+			{
+				f = (b & c) | (~b & d);
+				k = 0x5A827999;
+			}
+			else if (i < 40)
+			{
+				f = b ^ c ^ d;
+				k = 0x6ED9EBA1;
+			}
+			else if (i < 60)
+			{
+				f = (b & c) | (b & d) | (c & d);
+				k = 0x8F1BBCDC;
+			}
+			else
+			{
+				f = b ^ c ^ d;
+				k = 0xCA62C1D6;
+			}
+
+			u32 t = ROL (a, 5) + f + e + k + W[i];
+			e = d;
+			d = c;
+			c = ROL (b, 30);
+			b = a;
+			a = t;
+		}
+
+		pState[0] += a;
+		pState[1] += b;
+		pState[2] += c;
+		pState[3] += d;
+		pState[4] += e;
+
+		pData += SHA1_BLOCK_SIZE;
+	}
+}
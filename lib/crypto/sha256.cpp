@@ -0,0 +1,211 @@
+//
+// sha256.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/crypto/sha256.h>
+#include <circle/crypto/cryptocpu.h>
+#include <circle/util.h>
+
+#if AARCH == 64
+extern "C" void sha256_ce_transform (u32 *pState, const u8 *pData, size_t nBlocks);
+#endif
+
+static const u32 K[64] =
+{
+	0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+	0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+	0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+	0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+	0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+	0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+	0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+	0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+#define ROR(x, n)	(((x) >> (n)) | ((x) << (32 - (n))))
+
+CSHA256::CSHA256 (void)
+:	m_bUseCE (CCryptoCPU::HasSHA256 ())
+{
+	Reset ();
+}
+
+CSHA256::~CSHA256 (void)
+{
+}
+
+void CSHA256::Reset (void)
+{
+	m_State[0] = 0x6A09E667;
+	m_State[1] = 0xBB67AE85;
+	m_State[2] = 0x3C6EF372;
+	m_State[3] = 0xA54FF53A;
+	m_State[4] = 0x510E527F;
+	m_State[5] = 0x9B05688C;
+	m_State[6] = 0x1F83D9AB;
+	m_State[7] = 0x5BE0CD19;
+
+	m_nTotalLength = 0;
+	m_nBufferLength = 0;
+}
+
+void CSHA256::Update (const void *pData, size_t nLength)
+{
+	const u8 *pData8 = (const u8 *) pData;
+	m_nTotalLength += nLength;
+
+	if (m_nBufferLength > 0)
+	{
+		size_t nPart = SHA256_BLOCK_SIZE - m_nBufferLength;
+		if (nPart > nLength)
+		{
+			nPart = nLength;
+		}
+
+		memcpy (m_Buffer + m_nBufferLength, pData8, nPart);
+		m_nBufferLength += nPart;
+		pData8 += nPart;
+		nLength -= nPart;
+
+		if (m_nBufferLength < SHA256_BLOCK_SIZE)
+		{
+			return;
+		}
+
+		Transform (m_Buffer, 1);
+		m_nBufferLength = 0;
+	}
+
+	size_t nBlocks = nLength / SHA256_BLOCK_SIZE;
+	if (nBlocks > 0)
+	{
+		Transform (pData8, nBlocks);
+		pData8 += nBlocks * SHA256_BLOCK_SIZE;
+		nLength -= nBlocks * SHA256_BLOCK_SIZE;
+	}
+
+	if (nLength > 0)
+	{
+		memcpy (m_Buffer, pData8, nLength);
+		m_nBufferLength = nLength;
+	}
+}
+
+void CSHA256::Final (u8 *pDigest)
+{
+	u64 nBitLength = m_nTotalLength * 8;
+
+	m_Buffer[m_nBufferLength++] = 0x80;
+	if (m_nBufferLength > SHA256_BLOCK_SIZE-8)
+	{
+		memset (m_Buffer + m_nBufferLength, 0, SHA256_BLOCK_SIZE - m_nBufferLength);
+		Transform (m_Buffer, 1);
+		m_nBufferLength = 0;
+	}
+
+	memset (m_Buffer + m_nBufferLength, 0, SHA256_BLOCK_SIZE-8 - m_nBufferLength);
+	for (unsigned i = 0; i < 8; i++)
+	{
+		m_Buffer[SHA256_BLOCK_SIZE-1 - i] = (u8) (nBitLength >> (i * 8));
+	}
+	Transform (m_Buffer, 1);
+
+	for (unsigned i = 0; i < 8; i++)
+	{
+		pDigest[i*4]   = (u8) (m_State[i] >> 24);
+		pDigest[i*4+1] = (u8) (m_State[i] >> 16);
+		pDigest[i*4+2] = (u8) (m_State[i] >> 8);
+		pDigest[i*4+3] = (u8) m_State[i];
+	}
+
+	m_nBufferLength = 0;
+}
+
+void CSHA256::Calculate (const void *pData, size_t nLength, u8 *pDigest)
+{
+	CSHA256 SHA256;
+	SHA256.Update (pData, nLength);
+	SHA256.Final (pDigest);
+}
+
+void CSHA256::Transform (const u8 *pData, size_t nBlocks)
+{
+#if AARCH == 64
+	if (m_bUseCE)
+	{
+		sha256_ce_transform (m_State, pData, nBlocks);
+
+		return;
+	}
+#endif
+
+	TransformScalar (m_State, pData, nBlocks);
+}
+
+void CSHA256::TransformScalar (u32 *pState, const u8 *pData, size_t nBlocks)
+{
+	while (nBlocks--)
+	{
+		u32 W[64];
+		for (unsigned i = 0; i < 16; i++)
+		{
+			W[i] =   (u32) pData[i*4] << 24 | (u32) pData[i*4+1] << 16
+			       | (u32) pData[i*4+2] << 8 | pData[i*4+3];
+		}
+
+		for (unsigned i = 16; i < 64; i++)
+		{
+			u32 s0 = ROR (W[i-15], 7) ^ ROR (W[i-15], 18) ^ (W[i-15] >> 3);
+			u32 s1 = ROR (W[i-2], 17) ^ ROR (W[i-2], 19) ^ (W[i-2] >> 10);
+			W[i] = W[i-16] + s0 + W[i-7] + s1;
+		}
+
+		u32 a = pState[0], b = pState[1], c = pState[2], d = pState[3];
+		u32 e = pState[4], f = pState[5], g = pState[6], h = pState[7];
+
+		for (unsigned i = 0; i < 64; i++)
+		{
+			u32 S1 = ROR (e, 6) ^ ROR (e, 11) ^ ROR (e, 25);
+			u32 ch = (e & f) ^ (~e & g);
+			u32 t1 = h + S1 + ch + K[i] + W[i];
+			u32 S0 = ROR (a, 2) ^ ROR (a, 13) ^ ROR (a, 22);
+			u32 maj = (a & b) ^ (a & c) ^ (b & c);
+			u32 t2 = S0 + maj;
+
+			h = g;
+			g = f;
+			f = e;
+			e = d + t1;
+			d = c;
+			c = b;
+			b = a;
+			a = t1 + t2;
+		}
+
+		pState[0] += a;
+		pState[1] += b;
+		pState[2] += c;
+		pState[3] += d;
+		pState[4] += e;
+		pState[5] += f;
+		pState[6] += g;
+		pState[7] += h;
+
+		pData += SHA256_BLOCK_SIZE;
+	}
+}
@@ -2,7 +2,7 @@
 // devicenameservice.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -22,12 +22,23 @@
 #include <circle/util.h>
 #include <assert.h>
 
+struct TNotificationHandlerEntry
+{
+	TDeviceNameHandler	*pHandler;
+	void			*pContext;
+};
+
 CDeviceNameService *CDeviceNameService::s_This = 0;
 
 CDeviceNameService::CDeviceNameService (void)
 :	m_pList (0),
 	m_SpinLock (TASK_LEVEL)
 {
+	for (unsigned i = 0; i < DEVICE_NAME_HASH_SIZE; i++)
+	{
+		m_pHashTable[i] = 0;
+	}
+
 	assert (s_This == 0);
 	s_This = this;
 }
@@ -45,31 +56,45 @@ CDeviceNameService::~CDeviceNameService (void)
 
 		m_pList = pNext;
 	}
+
+	for (unsigned i = 0; i < DEVICE_NAME_HASH_SIZE; i++)
+	{
+		m_pHashTable[i] = 0;
+	}
+
+	TPtrListElement *pElement;
+	while ((pElement = m_HandlerList.GetFirst ()) != 0)
+	{
+		delete (TNotificationHandlerEntry *) m_HandlerList.GetPtr (pElement);
+
+		m_HandlerList.Remove (pElement);
+	}
 	
 	s_This = 0;
 }
 
 void CDeviceNameService::AddDevice (const char *pName, CDevice *pDevice, boolean bBlockDevice)
 {
-	m_SpinLock.Acquire ();
+	assert (pName != 0);
+	assert (pDevice != 0);
 
-	TDeviceInfo *pInfo = new TDeviceInfo;
-	assert (pInfo != 0);
+	u32 nHash = Hash (pName, bBlockDevice);
 
-	assert (pName != 0);
-	pInfo->pName = new char [strlen (pName)+1];
-	assert (pInfo->pName != 0);
-	strcpy (pInfo->pName, pName);
+	m_SpinLock.Acquire ();
 
-	assert (pDevice != 0);
-	pInfo->pDevice = pDevice;
-	
-	pInfo->bBlockDevice = bBlockDevice;
+	// the entry of a formerly removed device is reused, so that its handles stay valid
+	TDeviceInfo *pInfo = Find (pName, bBlockDevice, nHash);
+	if (pInfo == 0)
+	{
+		pInfo = Insert (pName, bBlockDevice, nHash);
+	}
 
-	pInfo->pNext = m_pList;
-	m_pList = pInfo;
+	assert (pInfo != 0);
+	pInfo->pDevice = pDevice;
 
 	m_SpinLock.Release ();
+
+	Notify (DeviceNameAdded, pName, pDevice, bBlockDevice);
 }
 
 void CDeviceNameService::AddDevice (const char *pPrefix, unsigned nIndex,
@@ -85,45 +110,28 @@ void CDeviceNameService::RemoveDevice (const char *pName, boolean bBlockDevice)
 {
 	assert (pName != 0);
 
+	u32 nHash = Hash (pName, bBlockDevice);
+
 	m_SpinLock.Acquire ();
 
-	TDeviceInfo *pInfo = m_pList;
-	TDeviceInfo *pPrev = 0;
-	while (pInfo != 0)
-	{
-		assert (pInfo->pName != 0);
-		if (   strcmp (pName, pInfo->pName) == 0
-		    && pInfo->bBlockDevice == bBlockDevice)
-		{
-			break;
-		}
+	TDeviceInfo *pInfo = Find (pName, bBlockDevice, nHash);
+	CDevice *pDevice = pInfo != 0 ? pInfo->pDevice : 0;
 
-		pPrev = pInfo;
-		pInfo = pInfo->pNext;
-	}
+	m_SpinLock.Release ();
 
-	if (pInfo == 0)
+	if (pDevice == 0)
 	{
-		m_SpinLock.Release ();
-
 		return;
 	}
 
-	if (pPrev == 0)
-	{
-		m_pList = pInfo->pNext;
-	}
-	else
-	{
-		pPrev->pNext = pInfo->pNext;
-	}
+	Notify (DeviceNameRemoved, pName, pDevice, bBlockDevice);
 
-	m_SpinLock.Release ();
+	// the entry is kept for existing handles
+	m_SpinLock.Acquire ();
 
-	delete [] pInfo->pName;
-	pInfo->pName = 0;
 	pInfo->pDevice = 0;
-	delete pInfo;
+
+	m_SpinLock.Release ();
 }
 
 void CDeviceNameService::RemoveDevice (const char *pPrefix, unsigned nIndex, boolean bBlockDevice)
@@ -138,29 +146,16 @@ CDevice *CDeviceNameService::GetDevice (const char *pName, boolean bBlockDevice)
 {
 	assert (pName != 0);
 
-	m_SpinLock.Acquire ();
+	u32 nHash = Hash (pName, bBlockDevice);
 
-	TDeviceInfo *pInfo = m_pList;
-	while (pInfo != 0)
-	{
-		assert (pInfo->pName != 0);
-		if (   strcmp (pName, pInfo->pName) == 0
-		    && pInfo->bBlockDevice == bBlockDevice)
-		{
-			CDevice *pResult = pInfo->pDevice;
-
-			m_SpinLock.Release ();
-
-			assert (pResult != 0);
-			return pResult;
-		}
+	m_SpinLock.Acquire ();
 
-		pInfo = pInfo->pNext;
-	}
+	TDeviceInfo *pInfo = Find (pName, bBlockDevice, nHash);
+	CDevice *pResult = pInfo != 0 ? pInfo->pDevice : 0;
 
 	m_SpinLock.Release ();
 
-	return 0;
+	return pResult;
 }
 
 CDevice *CDeviceNameService::GetDevice (const char *pPrefix, unsigned nIndex, boolean bBlockDevice)
@@ -171,6 +166,25 @@ CDevice *CDeviceNameService::GetDevice (const char *pPrefix, unsigned nIndex, bo
 	return GetDevice (Name, bBlockDevice);
 }
 
+TDeviceHandle CDeviceNameService::GetDeviceHandle (const char *pName, boolean bBlockDevice)
+{
+	assert (pName != 0);
+
+	u32 nHash = Hash (pName, bBlockDevice);
+
+	m_SpinLock.Acquire ();
+
+	TDeviceInfo *pInfo = Find (pName, bBlockDevice, nHash);
+	if (pInfo == 0)
+	{
+		pInfo = Insert (pName, bBlockDevice, nHash);
+	}
+
+	m_SpinLock.Release ();
+
+	return pInfo;
+}
+
 boolean CDeviceNameService::EnumerateDevices (
 	boolean (*callback)(CDevice* pDevice, const char* name, boolean bBlockDevice, void* arg), 
 	void* arg
@@ -182,7 +196,8 @@ boolean CDeviceNameService::EnumerateDevices (
 	TDeviceInfo *pInfo = m_pList;
 	while (pInfo != 0)
 	{
-		if (!callback(pInfo->pDevice, pInfo->pName, pInfo->bBlockDevice, arg))
+		if (   pInfo->pDevice != 0
+		    && !callback(pInfo->pDevice, pInfo->pName, pInfo->bBlockDevice, arg))
 		{
 			result = false;
 			break;
@@ -195,6 +210,41 @@ boolean CDeviceNameService::EnumerateDevices (
 	return result;
 }
 
+CDeviceNameService::TRegistrationHandle CDeviceNameService::RegisterNotificationHandler (
+	TDeviceNameHandler *pHandler, void *pContext)
+{
+	assert (pHandler != 0);
+
+	TNotificationHandlerEntry *pEntry = new TNotificationHandlerEntry;
+	assert (pEntry != 0);
+	pEntry->pHandler = pHandler;
+	pEntry->pContext = pContext;
+
+	m_SpinLock.Acquire ();
+
+	m_HandlerList.InsertAfter (0, pEntry);
+
+	m_SpinLock.Release ();
+
+	return (TRegistrationHandle) pEntry;
+}
+
+void CDeviceNameService::UnregisterNotificationHandler (TRegistrationHandle hRegistration)
+{
+	TNotificationHandlerEntry *pEntry = (TNotificationHandlerEntry *) hRegistration;
+	assert (pEntry != 0);
+
+	m_SpinLock.Acquire ();
+
+	TPtrListElement *pElement = m_HandlerList.Find (pEntry);
+	assert (pElement != 0);
+
+	m_HandlerList.Remove (pElement);
+
+	m_SpinLock.Release ();
+
+	delete pEntry;
+}
 
 void CDeviceNameService::ListDevices (CDevice *pTarget)
 {
@@ -205,6 +255,13 @@ void CDeviceNameService::ListDevices (CDevice *pTarget)
 	TDeviceInfo *pInfo = m_pList;
 	while (pInfo != 0)
 	{
+		if (pInfo->pDevice == 0)
+		{
+			pInfo = pInfo->pNext;
+
+			continue;
+		}
+
 		CString String;
 
 		assert (pInfo->pName != 0);
@@ -229,3 +286,78 @@ CDeviceNameService *CDeviceNameService::Get (void)
 	assert (s_This != 0);
 	return s_This;
 }
+
+TDeviceInfo *CDeviceNameService::Find (const char *pName, boolean bBlockDevice, u32 nHash)
+{
+	assert (pName != 0);
+
+	for (TDeviceInfo *pInfo = m_pHashTable[nHash & (DEVICE_NAME_HASH_SIZE-1)];
+	     pInfo != 0; pInfo = pInfo->pNextHash)
+	{
+		assert (pInfo->pName != 0);
+		if (   pInfo->nHash == nHash
+		    && pInfo->bBlockDevice == bBlockDevice
+		    && strcmp (pName, pInfo->pName) == 0)
+		{
+			return pInfo;
+		}
+	}
+
+	return 0;
+}
+
+TDeviceInfo *CDeviceNameService::Insert (const char *pName, boolean bBlockDevice, u32 nHash)
+{
+	assert (pName != 0);
+
+	TDeviceInfo *pInfo = new TDeviceInfo;
+	assert (pInfo != 0);
+
+	pInfo->pName = new char [strlen (pName)+1];
+	assert (pInfo->pName != 0);
+	strcpy (pInfo->pName, pName);
+
+	pInfo->pDevice = 0;
+	pInfo->bBlockDevice = bBlockDevice;
+	pInfo->nHash = nHash;
+
+	pInfo->pNext = m_pList;
+	m_pList = pInfo;
+
+	TDeviceInfo **ppBucket = &m_pHashTable[nHash & (DEVICE_NAME_HASH_SIZE-1)];
+	pInfo->pNextHash = *ppBucket;
+	*ppBucket = pInfo;
+
+	return pInfo;
+}
+
+void CDeviceNameService::Notify (TDeviceNameEvent Event, const char *pName, CDevice *pDevice,
+				 boolean bBlockDevice)
+{
+	// handlers are called without holding the lock, so that they can look up devices
+	for (TPtrListElement *pElement = m_HandlerList.GetFirst (); pElement != 0;
+	     pElement = m_HandlerList.GetNext (pElement))
+	{
+		TNotificationHandlerEntry *pEntry =
+			(TNotificationHandlerEntry *) m_HandlerList.GetPtr (pElement);
+		assert (pEntry != 0);
+
+		assert (pEntry->pHandler != 0);
+		(*pEntry->pHandler) (Event, pName, pDevice, bBlockDevice, pEntry->pContext);
+	}
+}
+
+u32 CDeviceNameService::Hash (const char *pName, boolean bBlockDevice)
+{
+	assert (pName != 0);
+
+	// FNV-1a
+	u32 nHash = 2166136261U;
+	while (*pName != '\0')
+	{
+		nHash ^= (u8) *pName++;
+		nHash *= 16777619U;
+	}
+
+	return bBlockDevice ? ~nHash : nHash;
+}
@@ -6,7 +6,7 @@
 //		download/v0.3/devicetree-specification-v0.3.pdf
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2020-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -31,6 +31,12 @@
 
 #define DTB_ALIGN(n)		(((n) + 3) & ~3)
 
+#define DTB_MAX_DEPTH		32
+
+#define HASH_BASIS		2166136261U		// FNV-1a
+#define HASH_PRIME		16777619U
+#define HASH_GOLDEN		0x9E3779B1U
+
 // all values big endian
 
 struct TDeviceTreeBlobHeader
@@ -84,10 +90,84 @@ union TDeviceTreePiece
 }
 PACKED;
 
+struct TDeviceTreeIndexNode
+{
+	u32	nOffset;		// of the FDT_BEGIN_NODE token in the blob
+	u32	nParent;		// index, the root node is its own parent
+	u32	nPathHash;
+	u32	nPhandle;		// 0 if none
+};
+
+struct TDeviceTreeIndexProperty
+{
+	u32	nOffset;		// of the FDT_PROP token in the blob
+	u32	nNode;			// index
+	u32	nNameHash;
+};
+
+struct TDeviceTreeIndex
+{
+	unsigned		  nNodes;
+	TDeviceTreeIndexNode	 *pNode;	// in order of the blob
+	unsigned		  nProperties;
+	TDeviceTreeIndexProperty *pProperty;
+
+	// open addressing hash tables with linear probing, contain index+1 (0 if unused)
+	unsigned		  nNodeHashMask;
+	u32			 *pPathHash;
+	u32			 *pOffsetHash;
+	u32			 *pPhandleHash;
+	unsigned		  nPropertyHashMask;
+	u32			 *pPropertyHash;
+};
+
 static const char From[] = "dtb";
 
+static u32 HashString (u32 nHash, const char *pString, size_t nLength)
+{
+	while (nLength--)
+	{
+		nHash = (nHash ^ (u8) *pString++) * HASH_PRIME;
+	}
+
+	return nHash;
+}
+
+static u32 HashPathComponent (u32 nParentHash, const char *pName, size_t nLength)
+{
+	return HashString ((nParentHash ^ '/') * HASH_PRIME, pName, nLength);
+}
+
+static u32 HashProperty (u32 nNode, u32 nNameHash)
+{
+	return nNameHash + nNode * HASH_GOLDEN;
+}
+
+static unsigned GetHashSize (unsigned nEntries)
+{
+	unsigned nSize = 16;
+	while (nSize < 2*nEntries)
+	{
+		nSize <<= 1;
+	}
+
+	return nSize;
+}
+
+static void HashInsert (u32 *pTable, unsigned nMask, u32 nHash, unsigned nIndex)
+{
+	unsigned nSlot = nHash & nMask;
+	while (pTable[nSlot] != 0)
+	{
+		nSlot = (nSlot + 1) & nMask;
+	}
+
+	pTable[nSlot] = nIndex + 1;
+}
+
 CDeviceTreeBlob::CDeviceTreeBlob (const void *pBuffer)
-:	m_pFTD (0)
+:	m_pFTD (0),
+	m_pIndex (0)
 {
 	const TDeviceTreeBlobHeader *pHeader = (const TDeviceTreeBlobHeader *) pBuffer;
 	if (   pHeader == 0
@@ -111,10 +191,15 @@ CDeviceTreeBlob::CDeviceTreeBlob (const void *pBuffer)
 	}
 
 	memcpy (m_pFTD, pHeader, nTotalSize);
+
+	BuildIndex ();
 }
 
 CDeviceTreeBlob::~CDeviceTreeBlob (void)
 {
+	delete [] (u8 *) m_pIndex;
+	m_pIndex = 0;
+
 	delete [] m_pFTD;
 	m_pFTD = 0;
 }
@@ -122,9 +207,44 @@ CDeviceTreeBlob::~CDeviceTreeBlob (void)
 const TDeviceTreeNode *CDeviceTreeBlob::FindNode (const char *pPath,
 						  const TDeviceTreeNode *pNode) const
 {
+	if (m_pIndex != 0)
+	{
+		return FindNodeIndexed (pPath, pNode);
+	}
+
 	return FindNodeInternal (pPath, pNode, 0);
 }
 
+const TDeviceTreeNode *CDeviceTreeBlob::FindNodeByPhandle (u32 nPhandle) const
+{
+	if (m_pIndex == 0)
+	{
+		CLogger::Get ()->Write (From, LogWarning, "DTB index not available");
+
+		return 0;
+	}
+
+	if (nPhandle == 0)
+	{
+		return 0;
+	}
+
+	for (unsigned nSlot = (nPhandle * HASH_GOLDEN) & m_pIndex->nNodeHashMask;
+	     m_pIndex->pPhandleHash[nSlot] != 0;
+	     nSlot = (nSlot + 1) & m_pIndex->nNodeHashMask)
+	{
+		const TDeviceTreeIndexNode *pEntry =
+			&m_pIndex->pNode[m_pIndex->pPhandleHash[nSlot] - 1];
+
+		if (pEntry->nPhandle == nPhandle)
+		{
+			return (const TDeviceTreeNode *) (m_pFTD + pEntry->nOffset);
+		}
+	}
+
+	return 0;
+}
+
 const TDeviceTreeNode *CDeviceTreeBlob::FindNodeInternal (const char *pPath,
 							  const TDeviceTreeNode *pNode,
 							  const TDeviceTreeNode **ppNextNode) const
@@ -272,6 +392,17 @@ const TDeviceTreeProperty *CDeviceTreeBlob::FindProperty (const TDeviceTreeNode
 		return 0;
 	}
 
+	if (m_pIndex != 0)
+	{
+		const TDeviceTreeProperty *pProperty = FindPropertyIndexed (pNode, pName);
+		if (pProperty == 0)
+		{
+			CLogger::Get ()->Write (From, LogWarning, "Property not found: %s", pName);
+		}
+
+		return pProperty;
+	}
+
 	if (be2le32 (pNode->token) != FDT_BEGIN_NODE)
 	{
 		CLogger::Get ()->Write (From, LogWarning, "FDT_BEGIN_NODE expected (0x%X)",
@@ -359,3 +490,417 @@ u32 CDeviceTreeBlob::GetPropertyValueWord (const TDeviceTreeProperty *pProperty,
 
 	return be2le32 (*((u32 *) pProperty->data + nIndex));
 }
+
+void CDeviceTreeBlob::BuildIndex (void)
+{
+	assert (m_pFTD != 0);
+	assert (m_pIndex == 0);
+
+	// first pass counts the entries to allocate all tables at once
+	unsigned nNodes = 0;
+	unsigned nProperties = 0;
+	if (!FillIndex (0, &nNodes, &nProperties))
+	{
+		CLogger::Get ()->Write (From, LogWarning, "Cannot index DTB");
+
+		return;
+	}
+
+	unsigned nNodeHashSize = GetHashSize (nNodes);
+	unsigned nPropertyHashSize = GetHashSize (nProperties);
+
+	size_t nSize =   sizeof (TDeviceTreeIndex)
+		       + nNodes * sizeof (TDeviceTreeIndexNode)
+		       + nProperties * sizeof (TDeviceTreeIndexProperty)
+		       + (3*nNodeHashSize + nPropertyHashSize) * sizeof (u32);
+
+	u8 *pMemory = new u8[nSize];
+	if (pMemory == 0)
+	{
+		return;
+	}
+
+	memset (pMemory, 0, nSize);
+
+	TDeviceTreeIndex *pIndex = (TDeviceTreeIndex *) pMemory;
+	pMemory += sizeof (TDeviceTreeIndex);
+
+	pIndex->pNode = (TDeviceTreeIndexNode *) pMemory;
+	pMemory += nNodes * sizeof (TDeviceTreeIndexNode);
+
+	pIndex->pProperty = (TDeviceTreeIndexProperty *) pMemory;
+	pMemory += nProperties * sizeof (TDeviceTreeIndexProperty);
+
+	pIndex->nNodeHashMask = nNodeHashSize - 1;
+	pIndex->pPathHash = (u32 *) pMemory;
+	pIndex->pOffsetHash = pIndex->pPathHash + nNodeHashSize;
+	pIndex->pPhandleHash = pIndex->pOffsetHash + nNodeHashSize;
+
+	pIndex->nPropertyHashMask = nPropertyHashSize - 1;
+	pIndex->pPropertyHash = pIndex->pPhandleHash + nNodeHashSize;
+
+	// second pass fills the tables
+	if (!FillIndex (pIndex, &nNodes, &nProperties))
+	{
+		delete [] (u8 *) pIndex;
+
+		return;
+	}
+
+	assert (pIndex->nNodes == nNodes);
+	assert (pIndex->nProperties == nProperties);
+
+	for (unsigned i = 0; i < nNodes; i++)
+	{
+		const TDeviceTreeIndexNode *pNode = &pIndex->pNode[i];
+
+		HashInsert (pIndex->pPathHash, pIndex->nNodeHashMask, pNode->nPathHash, i);
+		HashInsert (pIndex->pOffsetHash, pIndex->nNodeHashMask,
+			    (pNode->nOffset >> 2) * HASH_GOLDEN, i);
+
+		if (pNode->nPhandle != 0)
+		{
+			HashInsert (pIndex->pPhandleHash, pIndex->nNodeHashMask,
+				    pNode->nPhandle * HASH_GOLDEN, i);
+		}
+	}
+
+	for (unsigned i = 0; i < nProperties; i++)
+	{
+		const TDeviceTreeIndexProperty *pProperty = &pIndex->pProperty[i];
+
+		HashInsert (pIndex->pPropertyHash, pIndex->nPropertyHashMask,
+			    HashProperty (pProperty->nNode, pProperty->nNameHash), i);
+	}
+
+	m_pIndex = pIndex;
+}
+
+boolean CDeviceTreeBlob::FillIndex (TDeviceTreeIndex *pIndex, unsigned *pNodes,
+				    unsigned *pProperties) const
+{
+	assert (m_pFTD != 0);
+	assert (pNodes != 0);
+	assert (pProperties != 0);
+
+	const TDeviceTreeBlobHeader *pHeader = (const TDeviceTreeBlobHeader *) m_pFTD;
+	u32 nTotalSize = be2le32 (pHeader->totalsize);
+	u32 nOffset = be2le32 (pHeader->off_dt_struct);
+	u32 nStrings = be2le32 (pHeader->off_dt_strings);
+	u32 nStringsSize = be2le32 (pHeader->size_dt_strings);
+	if (   nOffset >= nTotalSize
+	    || nStrings > nTotalSize
+	    || nStringsSize > nTotalSize - nStrings)
+	{
+		return FALSE;
+	}
+
+	unsigned nNodes = 0;
+	unsigned nProperties = 0;
+
+	u32 Parent[DTB_MAX_DEPTH];
+	unsigned nDepth = 0;
+
+	while (nOffset + sizeof (u32) <= nTotalSize)
+	{
+		const TDeviceTreePiece *pPiece = (const TDeviceTreePiece *) (m_pFTD + nOffset);
+
+		switch (be2le32 (pPiece->token))
+		{
+		case FDT_BEGIN_NODE: {
+			if (   nDepth == DTB_MAX_DEPTH
+			    || (nDepth == 0 && nNodes > 0))	// only one root node
+			{
+				return FALSE;
+			}
+
+			const char *pName = (const char *) pPiece->node.data;
+			size_t nMaxLength = nTotalSize - nOffset - sizeof (u32);
+			size_t nLength = 0;
+			while (nLength < nMaxLength && pName[nLength] != '\0')
+			{
+				nLength++;
+			}
+
+			if (nLength == nMaxLength)
+			{
+				return FALSE;
+			}
+
+			if (pIndex != 0)
+			{
+				TDeviceTreeIndexNode *pNode = &pIndex->pNode[nNodes];
+
+				pNode->nOffset = nOffset;
+				pNode->nParent = nDepth > 0 ? Parent[nDepth-1] : nNodes;
+				pNode->nPathHash =   nDepth > 0
+						   ? HashPathComponent (pIndex->pNode[pNode->nParent].nPathHash,
+									pName, nLength)
+						   : HASH_BASIS;
+				pNode->nPhandle = 0;
+			}
+
+			Parent[nDepth++] = nNodes++;
+
+			nOffset += sizeof (u32) + DTB_ALIGN (nLength + 1);
+			} break;
+
+		case FDT_END_NODE:
+			if (nDepth == 0)
+			{
+				return FALSE;
+			}
+
+			nDepth--;
+
+			nOffset += sizeof (u32);
+			break;
+
+		case FDT_PROP: {
+			if (   nDepth == 0
+			    || nOffset + sizeof (TDeviceTreeProperty) > nTotalSize)
+			{
+				return FALSE;
+			}
+
+			u32 nLength = be2le32 (pPiece->property.len);
+			u32 nNameOffset = be2le32 (pPiece->property.nameoff);
+			if (   nLength > nTotalSize - nOffset - sizeof (TDeviceTreeProperty)
+			    || nNameOffset >= nStringsSize)
+			{
+				return FALSE;
+			}
+
+			if (pIndex != 0)
+			{
+				TDeviceTreeIndexProperty *pProperty = &pIndex->pProperty[nProperties];
+				const char *pName = GetPropertyName (&pPiece->property);
+
+				pProperty->nOffset = nOffset;
+				pProperty->nNode = Parent[nDepth-1];
+				pProperty->nNameHash = HashString (HASH_BASIS, pName, strlen (pName));
+
+				if (   nLength == sizeof (u32)
+				    && strcmp (pName, "phandle") == 0)
+				{
+					pIndex->pNode[pProperty->nNode].nPhandle =
+						be2le32 (*(const u32 *) pPiece->property.data);
+				}
+			}
+
+			nProperties++;
+
+			nOffset += sizeof (TDeviceTreeProperty) + DTB_ALIGN (nLength);
+			} break;
+
+		case FDT_NOP:
+			nOffset += sizeof (u32);
+			break;
+
+		case FDT_END:
+			if (   nDepth != 0
+			    || nNodes == 0)
+			{
+				return FALSE;
+			}
+
+			if (pIndex != 0)
+			{
+				pIndex->nNodes = nNodes;
+				pIndex->nProperties = nProperties;
+			}
+
+			*pNodes = nNodes;
+			*pProperties = nProperties;
+
+			return TRUE;
+
+		default:
+			return FALSE;
+		}
+	}
+
+	return FALSE;
+}
+
+const TDeviceTreeNode *CDeviceTreeBlob::FindNodeIndexed (const char *pPath,
+							 const TDeviceTreeNode *pParentNode) const
+{
+	assert (pPath != 0);
+	assert (m_pIndex != 0);
+
+	unsigned nStart = 0;			// root node
+	if (pParentNode == 0)
+	{
+		if (pPath[0] != '/')
+		{
+			CLogger::Get ()->Write (From, LogWarning, "Invalid path: %s", pPath);
+
+			return 0;
+		}
+
+		pPath++;
+	}
+	else
+	{
+		int nIndex = GetNodeIndex (pParentNode);
+		if (nIndex < 0)
+		{
+			CLogger::Get ()->Write (From, LogWarning, "FDT_BEGIN_NODE expected (0x%X)",
+						be2le32 (pParentNode->token));
+
+			return 0;
+		}
+
+		nStart = nIndex;
+	}
+
+	// split the path into its components and calculate the hash
+	const char *pComponent[DTB_MAX_DEPTH];
+	size_t nComponentLength[DTB_MAX_DEPTH];
+	unsigned nComponents = 0;
+
+	u32 nHash = m_pIndex->pNode[nStart].nPathHash;
+	while (pPath[0] != '\0')
+	{
+		const char *pEnd = strchr (pPath, '/');
+		size_t nLength = pEnd != 0 ? (size_t) (pEnd - pPath) : strlen (pPath);
+		if (nLength == 0)
+		{
+			CLogger::Get ()->Write (From, LogWarning, "Zero length path component");
+
+			return 0;
+		}
+
+		if (nComponents == DTB_MAX_DEPTH)
+		{
+			return 0;			// cannot be in the index
+		}
+
+		pComponent[nComponents] = pPath;
+		nComponentLength[nComponents++] = nLength;
+
+		nHash = HashPathComponent (nHash, pPath, nLength);
+
+		pPath += nLength;
+		if (pPath[0] == '/')
+		{
+			pPath++;
+		}
+	}
+
+	if (nComponents == 0)
+	{
+		return (const TDeviceTreeNode *) (m_pFTD + m_pIndex->pNode[nStart].nOffset);
+	}
+
+	for (unsigned nSlot = nHash & m_pIndex->nNodeHashMask;
+	     m_pIndex->pPathHash[nSlot] != 0;
+	     nSlot = (nSlot + 1) & m_pIndex->nNodeHashMask)
+	{
+		unsigned nIndex = m_pIndex->pPathHash[nSlot] - 1;
+		if (m_pIndex->pNode[nIndex].nPathHash != nHash)
+		{
+			continue;
+		}
+
+		// compare the path components from the end up to the start node
+		unsigned i = nComponents;
+		unsigned nNode = nIndex;
+		while (i > 0 && nNode != nStart)
+		{
+			const TDeviceTreeNode *pNode =
+				(const TDeviceTreeNode *) (m_pFTD + m_pIndex->pNode[nNode].nOffset);
+			const char *pName = (const char *) pNode->data;
+
+			i--;
+			if (   strncmp (pName, pComponent[i], nComponentLength[i]) != 0
+			    || pName[nComponentLength[i]] != '\0')
+			{
+				break;
+			}
+
+			nNode = m_pIndex->pNode[nNode].nParent;
+		}
+
+		if (   i == 0
+		    && nNode == nStart)
+		{
+			return (const TDeviceTreeNode *) (m_pFTD + m_pIndex->pNode[nIndex].nOffset);
+		}
+	}
+
+	return 0;
+}
+
+const TDeviceTreeProperty *CDeviceTreeBlob::FindPropertyIndexed (const TDeviceTreeNode *pNode,
+								  const char *pName) const
+{
+	assert (pNode != 0);
+	assert (pName != 0);
+	assert (m_pIndex != 0);
+
+	int nNode = GetNodeIndex (pNode);
+	if (nNode < 0)
+	{
+		CLogger::Get ()->Write (From, LogWarning, "FDT_BEGIN_NODE expected (0x%X)",
+					be2le32 (pNode->token));
+		return 0;
+	}
+
+	u32 nNameHash = HashString (HASH_BASIS, pName, strlen (pName));
+
+	for (unsigned nSlot = HashProperty (nNode, nNameHash) & m_pIndex->nPropertyHashMask;
+	     m_pIndex->pPropertyHash[nSlot] != 0;
+	     nSlot = (nSlot + 1) & m_pIndex->nPropertyHashMask)
+	{
+		const TDeviceTreeIndexProperty *pEntry =
+			&m_pIndex->pProperty[m_pIndex->pPropertyHash[nSlot] - 1];
+
+		if (   pEntry->nNode == (u32) nNode
+		    && pEntry->nNameHash == nNameHash)
+		{
+			const TDeviceTreeProperty *pProperty =
+				(const TDeviceTreeProperty *) (m_pFTD + pEntry->nOffset);
+
+			if (strcmp (GetPropertyName (pProperty), pName) == 0)
+			{
+				return pProperty;
+			}
+		}
+	}
+
+	return 0;
+}
+
+int CDeviceTreeBlob::GetNodeIndex (const TDeviceTreeNode *pNode) const
+{
+	assert (pNode != 0);
+	assert (m_pIndex != 0);
+
+	uintptr nOffset = (const u8 *) pNode - m_pFTD;
+
+	for (unsigned nSlot = ((u32) nOffset >> 2) * HASH_GOLDEN & m_pIndex->nNodeHashMask;
+	     m_pIndex->pOffsetHash[nSlot] != 0;
+	     nSlot = (nSlot + 1) & m_pIndex->nNodeHashMask)
+	{
+		unsigned nIndex = m_pIndex->pOffsetHash[nSlot] - 1;
+		if (m_pIndex->pNode[nIndex].nOffset == nOffset)
+		{
+			return (int) nIndex;
+		}
+	}
+
+	return -1;
+}
+
+const char *CDeviceTreeBlob::GetPropertyName (const TDeviceTreeProperty *pProperty) const
+{
+	assert (pProperty != 0);
+	assert (m_pFTD != 0);
+
+	const TDeviceTreeBlobHeader *pHeader = (const TDeviceTreeBlobHeader *) m_pFTD;
+
+	return (const char *) (  m_pFTD + be2le32 (pHeader->off_dt_strings)
+			       + be2le32 (pProperty->nameoff));
+}
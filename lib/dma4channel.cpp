@@ -108,6 +108,7 @@
 CDMA4Channel::CDMA4Channel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
 :	m_nChannel (nChannel),
 	m_nBuffers (0),
+	m_pFillPattern (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_bIRQConnected (FALSE),
 	m_pCompletionRoutine (0),
@@ -119,7 +120,7 @@ CDMA4Channel::CDMA4Channel (unsigned nChannel, CInterruptSystem *pInterruptSyste
 
 	for (unsigned i = 0; i < MaxCyclicBuffers; i++)
 	{
-		m_pControlBlock[i] = new (HEAP_ANY) TDMA4ControlBlock;
+		m_pControlBlock[i] = new (HEAP_COHERENT) TDMA4ControlBlock;
 		assert (m_pControlBlock[i]);
 
 		m_pControlBlock[i]->nReserved = 0;
@@ -174,6 +175,9 @@ CDMA4Channel::~CDMA4Channel (void)
 		delete m_pControlBlock[i];
 		m_pControlBlock[i] = 0;
 	}
+
+	delete [] m_pFillPattern;
+	m_pFillPattern = 0;
 }
 
 void CDMA4Channel::SetupMemCopy (void *pDestination, const void *pSource, size_t nLength,
@@ -402,6 +406,57 @@ void CDMA4Channel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	m_nBuffers = 1;
 }
 
+void CDMA4Channel::SetupMemFill2D (void *pDestination, u32 nPattern,
+				  size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
+				  unsigned nBurstLength)
+{
+	assert (pDestination != 0);
+	assert (nBlockLength > 0);
+	assert (nBlockLength <= LEN4_XLENGTH_2D_MAX);
+	assert (nBlockCount > 0);
+	assert (nBlockCount <= LEN4_YLENGTH_MAX);
+	assert (nBlockStride <= DEST4_STRIDE_MAX);
+	assert (nBurstLength <= BURST4_MAX);
+
+	// the source is read with 128-bit width and is not incremented
+	if (m_pFillPattern == 0)
+	{
+		m_pFillPattern = new (HEAP_COHERENT) u32[4];
+		assert (m_pFillPattern != 0);
+		assert (((uintptr) m_pFillPattern & 15) == 0);
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		m_pFillPattern[i] = nPattern;
+	}
+
+	assert (m_pControlBlock[0] != 0);
+
+	m_pControlBlock[0]->nTransferInformation     =   TI4_WAIT_RD_RESP
+						       | TI4_WAIT_RESP
+						       | TI4_TDMODE;
+	m_pControlBlock[0]->nSourceAddress           = ADDRESS4_LOW (m_pFillPattern);
+	m_pControlBlock[0]->nSourceInformation	     =   (SIZE4_128 << SOURCE4_SIZE_SHIFT)
+						       | (nBurstLength << SOURCE4_BURST_LEN_SHIFT)
+						       |    (ADDRESS4_HIGH (m_pFillPattern)
+						         << SOURCE4_ADDR_SHIFT);
+	m_pControlBlock[0]->nDestinationAddress      = ADDRESS4_LOW (pDestination);
+	m_pControlBlock[0]->nDestinationInformation  =   (nBlockStride << DEST4_STRIDE_SHIFT)
+						       | (SIZE4_128 << DEST4_SIZE_SHIFT)
+						       | DEST4_INC
+						       | (nBurstLength << DEST4_BURST_LEN_SHIFT)
+						       |    (ADDRESS4_HIGH (pDestination)
+						         << DEST4_ADDR_SHIFT);
+	m_pControlBlock[0]->nTransferLength          =   ((nBlockCount-1) << LEN4_YLENGTH_SHIFT)
+						       | (nBlockLength << LEN4_XLENGTH_SHIFT);
+	m_pControlBlock[0]->nNextControlBlockAddress = 0;
+
+	m_nDestinationAddress = 0;
+
+	m_nBuffers = 1;
+}
+
 void CDMA4Channel::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
 {
 	assert (m_nChannel >= DMA4_CHANNEL_MIN);
@@ -439,11 +494,11 @@ void CDMA4Channel::Start (void)
 			assert (m_bIRQConnected);
 			m_pControlBlock[i]->nTransferInformation |= TI4_INTEN;
 		}
-
-		CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[i],
-						  sizeof *m_pControlBlock[i]);
 	}
 
+	// control blocks are in the DMA coherent pool, wait for pending writes only
+	DataSyncBarrier ();
+
 	PeripheralEntry ();
 
 	assert (m_nChannel >= DMA4_CHANNEL_MIN);
@@ -31,6 +31,7 @@
 CDMAChannel::CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
 :	m_nChannel (CMachineInfo::Get ()->AllocateDMAChannel (nChannel)),
 	m_nBuffers (0),
+	m_pFillPattern (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_bIRQConnected (FALSE),
 	m_pCompletionRoutine (0),
@@ -58,7 +59,7 @@ CDMAChannel::CDMAChannel (unsigned nChannel, CInterruptSystem *pInterruptSystem)
 
 	for (unsigned i = 0; i < MaxCyclicBuffers; i++)
 	{
-		m_pControlBlock[i] = new (HEAP_DMA30) TDMAControlBlock;
+		m_pControlBlock[i] = new (HEAP_COHERENT) TDMAControlBlock;
 		assert (m_pControlBlock[i]);
 
 		m_pControlBlock[i]->nReserved[0] = 0;
@@ -128,6 +129,9 @@ CDMAChannel::~CDMAChannel (void)
 		delete m_pControlBlock[i];
 		m_pControlBlock[i] = 0;
 	}
+
+	delete [] m_pFillPattern;
+	m_pFillPattern = 0;
 }
 
 void CDMAChannel::SetupMemCopy (void *pDestination, const void *pSource, size_t nLength,
@@ -368,6 +372,62 @@ void CDMAChannel::SetupMemCopy2D (void *pDestination, const void *pSource,
 	m_nBuffers = 1;
 }
 
+void CDMAChannel::SetupMemFill2D (void *pDestination, u32 nPattern,
+				  size_t nBlockLength, unsigned nBlockCount, size_t nBlockStride,
+				  unsigned nBurstLength)
+{
+#if RASPPI >= 4
+	if (m_pDMA4Channel != 0)
+	{
+		m_pDMA4Channel->SetupMemFill2D (pDestination, nPattern, nBlockLength,
+						nBlockCount, nBlockStride, nBurstLength);
+
+		return;
+	}
+#endif
+
+	assert (pDestination != 0);
+	assert (nBlockLength > 0);
+	assert (nBlockLength <= 0xFFFF);
+	assert (nBlockCount > 0);
+	assert (nBlockCount <= 0x3FFF);
+	assert (nBlockStride <= 0xFFFF);
+	assert (nBurstLength <= 15);
+
+	assert (!(read32 (ARM_DMACHAN_DEBUG (m_nChannel)) & DEBUG_LITE));
+
+	// the source is read with 128-bit width and is not incremented
+	if (m_pFillPattern == 0)
+	{
+		m_pFillPattern = new (HEAP_COHERENT) u32[4];
+		assert (m_pFillPattern != 0);
+		assert (((uintptr) m_pFillPattern & 15) == 0);
+	}
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		m_pFillPattern[i] = nPattern;
+	}
+
+	assert (m_pControlBlock[0] != 0);
+
+	m_pControlBlock[0]->nTransferInformation     =   (nBurstLength << TI_BURST_LENGTH_SHIFT)
+						       | TI_SRC_WIDTH
+						       | TI_DEST_WIDTH
+						       | TI_DEST_INC
+						       | TI_TDMODE;
+	m_pControlBlock[0]->nSourceAddress           = BUS_ADDRESS ((uintptr) m_pFillPattern);
+	m_pControlBlock[0]->nDestinationAddress      = BUS_ADDRESS ((uintptr) pDestination);
+	m_pControlBlock[0]->nTransferLength          =   ((nBlockCount-1) << TXFR_LEN_YLENGTH_SHIFT)
+						       | (nBlockLength << TXFR_LEN_XLENGTH_SHIFT);
+	m_pControlBlock[0]->n2DModeStride            = nBlockStride << STRIDE_DEST_SHIFT;
+	m_pControlBlock[0]->nNextControlBlockAddress = 0;
+
+	m_nDestinationAddress = 0;
+
+	m_nBuffers = 1;
+}
+
 void CDMAChannel::SetCompletionRoutine (TDMACompletionRoutine *pRoutine, void *pParam)
 {
 #if RASPPI >= 4
@@ -416,11 +476,11 @@ void CDMAChannel::Start (void)
 			assert (m_bIRQConnected);
 			m_pControlBlock[i]->nTransferInformation |= TI_INTEN;
 		}
-
-		CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[i],
-						  sizeof *m_pControlBlock[i]);
 	}
 
+	// control blocks are in the DMA coherent pool, wait for pending writes only
+	DataSyncBarrier ();
+
 	PeripheralEntry ();
 
 	assert (m_nChannel < DMA_CHANNELS);
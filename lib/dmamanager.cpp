@@ -0,0 +1,443 @@
+//
+// dmamanager.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dmamanager.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define MAX_COPY_SEGMENT	0x100000	// bytes per DMA transfer
+#define FILL_BLOCK_LENGTH	0x8000		// must be <= 0xFFFF
+#define MAX_FILL_BLOCKS		32
+
+LOGMODULE ("dmamanager");
+
+CDMAManager *CDMAManager::s_pThis = 0;
+
+CDMAManager::CDMAManager (CInterruptSystem *pInterruptSystem, unsigned nMaxChannels,
+			  unsigned nChannelType)
+:	m_pInterruptSystem (pInterruptSystem),
+	m_nMaxChannels (nMaxChannels),
+	m_nChannelType (nChannelType),
+	m_nChannels (0),
+	m_pFreeJob (0),
+	m_pFirstJob (0),
+	m_pLastJob (0),
+	m_nPendingJobs (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	assert (m_nMaxChannels <= DMA_MANAGER_MAX_CHANNELS);
+	assert (m_nChannelType != DMA_CHANNEL_LITE);
+
+	for (unsigned i = 0; i < DMA_MANAGER_MAX_JOBS; i++)
+	{
+		m_Job[i].pNext = m_pFreeJob;
+		m_pFreeJob = &m_Job[i];
+	}
+}
+
+CDMAManager::~CDMAManager (void)
+{
+	assert (m_nPendingJobs == 0);
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		delete m_Channel[i].pChannel;
+		m_Channel[i].pChannel = 0;
+	}
+
+	m_nChannels = 0;
+
+	s_pThis = 0;
+}
+
+boolean CDMAManager::Initialize (void)
+{
+	assert (m_pInterruptSystem != 0);
+	assert (m_nChannels == 0);
+
+	CMachineInfo *pMachineInfo = CMachineInfo::Get ();
+	assert (pMachineInfo != 0);
+
+	while (m_nChannels < m_nMaxChannels)
+	{
+		// CDMAChannel asserts on allocation failure, so check availability first
+		unsigned nChannel = pMachineInfo->AllocateDMAChannel (m_nChannelType);
+		if (nChannel == DMA_CHANNEL_NONE)
+		{
+			break;
+		}
+
+		pMachineInfo->FreeDMAChannel (nChannel);
+
+		TChannel *pChannel = &m_Channel[m_nChannels++];
+		pChannel->pChannel = new CDMAChannel (nChannel, m_pInterruptSystem);
+		assert (pChannel->pChannel != 0);
+		pChannel->pJob = 0;
+		pChannel->pThis = this;
+	}
+
+	if (m_nChannels == 0)
+	{
+		LOGERR ("No DMA channel available");
+
+		return FALSE;
+	}
+
+	LOGDBG ("Using %u DMA channel(s)", m_nChannels);
+
+	return TRUE;
+}
+
+boolean CDMAManager::Submit (TDMADescriptor *pChain, TDMAJobCompletionRoutine *pRoutine,
+			     void *pParam)
+{
+	assert (pChain != 0);
+	assert (pRoutine != 0);
+	assert (m_nChannels > 0);
+
+	m_SpinLock.Acquire ();
+
+	TJob *pJob = m_pFreeJob;
+	if (pJob == 0)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_pFreeJob = pJob->pNext;
+
+	pJob->pNext = 0;
+	pJob->pCurrent = pChain;
+	pJob->nOffset = 0;
+	pJob->nSegment = 0;
+	pJob->pRoutine = pRoutine;
+	pJob->pParam = pParam;
+
+	if (m_pLastJob == 0)
+	{
+		m_pFirstJob = pJob;
+	}
+	else
+	{
+		m_pLastJob->pNext = pJob;
+	}
+	m_pLastJob = pJob;
+
+	m_nPendingJobs++;
+
+	Schedule ();
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+boolean CDMAManager::MemcpyAsync (TDMADescriptor *pDescriptor, void *pDestination,
+				  const void *pSource, size_t nLength,
+				  TDMAJobCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pDescriptor != 0);
+	pDescriptor->Operation = DMAOperationCopy;
+	pDescriptor->pDestination = pDestination;
+	pDescriptor->pSource = pSource;
+	pDescriptor->nPattern = 0;
+	pDescriptor->nLength = nLength;
+	pDescriptor->pNext = 0;
+
+	return Submit (pDescriptor, pRoutine, pParam);
+}
+
+boolean CDMAManager::MemsetAsync (TDMADescriptor *pDescriptor, void *pDestination, int nValue,
+				  size_t nLength, TDMAJobCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pDescriptor != 0);
+	pDescriptor->Operation = DMAOperationFill;
+	pDescriptor->pDestination = pDestination;
+	pDescriptor->pSource = 0;
+	pDescriptor->nPattern = (u8) nValue * 0x01010101U;
+	pDescriptor->nLength = nLength;
+	pDescriptor->pNext = 0;
+
+	return Submit (pDescriptor, pRoutine, pParam);
+}
+
+void *CDMAManager::Memcpy (void *pDestination, const void *pSource, size_t nLength)
+{
+	if (   nLength < DMA_MEMCPY_THRESHOLD
+	    || CurrentExecutionLevel () != TASK_LEVEL)
+	{
+		return memcpy (pDestination, pSource, nLength);
+	}
+
+	TDMADescriptor Descriptor;
+	Descriptor.Operation = DMAOperationCopy;
+	Descriptor.pDestination = pDestination;
+	Descriptor.pSource = pSource;
+	Descriptor.nPattern = 0;
+	Descriptor.nLength = nLength;
+	Descriptor.pNext = 0;
+
+	TransferSync (&Descriptor);
+
+	return pDestination;
+}
+
+void *CDMAManager::Memset (void *pDestination, int nValue, size_t nLength)
+{
+	if (   nLength < DMA_MEMCPY_THRESHOLD
+	    || CurrentExecutionLevel () != TASK_LEVEL)
+	{
+		return memset (pDestination, nValue, nLength);
+	}
+
+	TDMADescriptor Descriptor;
+	Descriptor.Operation = DMAOperationFill;
+	Descriptor.pDestination = pDestination;
+	Descriptor.pSource = 0;
+	Descriptor.nPattern = (u8) nValue * 0x01010101U;
+	Descriptor.nLength = nLength;
+	Descriptor.pNext = 0;
+
+	TransferSync (&Descriptor);
+
+	return pDestination;
+}
+
+void CDMAManager::TransferSync (TDMADescriptor *pDescriptor)
+{
+	assert (pDescriptor != 0);
+
+	// cache lines, which are partially written by the CPU, must not be touched by DMA
+	u8 *pDest = (u8 *) pDescriptor->pDestination;
+	size_t nHead = (DATA_CACHE_LINE_LENGTH_MAX - ((uintptr) pDest & (DATA_CACHE_LINE_LENGTH_MAX-1)))
+		       & (DATA_CACHE_LINE_LENGTH_MAX-1);
+	size_t nMiddle = (pDescriptor->nLength - nHead) & ~(DATA_CACHE_LINE_LENGTH_MAX-1);
+	size_t nTail = pDescriptor->nLength - nHead - nMiddle;
+
+	const u8 *pSource = (const u8 *) pDescriptor->pSource;
+	if (pDescriptor->Operation == DMAOperationCopy)
+	{
+		memcpy (pDest, pSource, nHead);
+		memcpy (pDest + nHead + nMiddle, pSource + nHead + nMiddle, nTail);
+	}
+	else
+	{
+		memset (pDest, (u8) pDescriptor->nPattern, nHead);
+		memset (pDest + nHead + nMiddle, (u8) pDescriptor->nPattern, nTail);
+	}
+
+	pDescriptor->pDestination = pDest + nHead;
+	pDescriptor->pSource = pSource != 0 ? pSource + nHead : 0;
+	pDescriptor->nLength = nMiddle;
+
+	volatile int nStatus = -1;
+	if (   nMiddle == 0
+	    || !Submit (pDescriptor, SyncCompletionRoutine, (void *) &nStatus))
+	{
+		nStatus = FALSE;
+	}
+
+	while (nStatus < 0)
+	{
+		// just wait
+	}
+
+	DataMemBarrier ();
+
+	if (!nStatus)
+	{
+		// fall back to the CPU, if DMA is not possible (e.g. too many jobs)
+		if (pDescriptor->Operation == DMAOperationCopy)
+		{
+			memcpy (pDescriptor->pDestination, pDescriptor->pSource, nMiddle);
+		}
+		else
+		{
+			memset (pDescriptor->pDestination, (u8) pDescriptor->nPattern, nMiddle);
+		}
+	}
+}
+
+void CDMAManager::SyncCompletionRoutine (boolean bStatus, void *pParam)
+{
+	volatile int *pStatus = (volatile int *) pParam;
+	assert (pStatus != 0);
+
+	*pStatus = bStatus ? TRUE : FALSE;
+}
+
+void CDMAManager::Schedule (void)
+{
+	for (unsigned i = 0; i < m_nChannels && m_pFirstJob != 0; i++)
+	{
+		TChannel *pChannel = &m_Channel[i];
+		if (pChannel->pJob != 0)
+		{
+			continue;
+		}
+
+		TJob *pJob = m_pFirstJob;
+		m_pFirstJob = pJob->pNext;
+		if (m_pFirstJob == 0)
+		{
+			m_pLastJob = 0;
+		}
+
+		pJob->pNext = 0;
+		pChannel->pJob = pJob;
+
+		StartSegment (pChannel);
+	}
+}
+
+void CDMAManager::StartSegment (TChannel *pChannel)
+{
+	assert (pChannel != 0);
+	TJob *pJob = pChannel->pJob;
+	assert (pJob != 0);
+	TDMADescriptor *pDesc = pJob->pCurrent;
+	assert (pDesc != 0);
+	assert (pDesc->nLength > 0);
+	assert (pJob->nOffset < pDesc->nLength);
+
+	size_t nRemaining = pDesc->nLength - pJob->nOffset;
+	u8 *pDest = (u8 *) pDesc->pDestination + pJob->nOffset;
+
+	CDMAChannel *pDMA = pChannel->pChannel;
+	assert (pDMA != 0);
+
+	switch (pDesc->Operation)
+	{
+	case DMAOperationCopy:
+		pJob->nSegment = nRemaining < MAX_COPY_SEGMENT ? nRemaining : MAX_COPY_SEGMENT;
+
+		pDMA->SetupMemCopy (pDest, (const u8 *) pDesc->pSource + pJob->nOffset,
+				    pJob->nSegment, 2);
+		break;
+
+	case DMAOperationFill: {
+		unsigned nBlocks = nRemaining / FILL_BLOCK_LENGTH;
+		size_t nBlockLength = FILL_BLOCK_LENGTH;
+		if (nBlocks == 0)
+		{
+			nBlocks = 1;
+			nBlockLength = nRemaining;
+		}
+		else if (nBlocks > MAX_FILL_BLOCKS)
+		{
+			nBlocks = MAX_FILL_BLOCKS;
+		}
+
+		pJob->nSegment = nBlockLength * nBlocks;
+
+		// the fill does not maintain the cache itself
+		CleanAndInvalidateDataCacheRange ((uintptr) pDest, pJob->nSegment);
+
+		pDMA->SetupMemFill2D (pDest, pDesc->nPattern, nBlockLength, nBlocks, 0, 2);
+		} break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	pDMA->SetCompletionRoutine (ChannelCompletionStub, pChannel);
+	pDMA->Start ();
+}
+
+void CDMAManager::ChannelCompletion (TChannel *pChannel, boolean bStatus)
+{
+	assert (pChannel != 0);
+
+	m_SpinLock.Acquire ();
+
+	TJob *pJob = pChannel->pJob;
+	assert (pJob != 0);
+	TDMADescriptor *pDesc = pJob->pCurrent;
+	assert (pDesc != 0);
+
+	if (pDesc->Operation == DMAOperationFill)
+	{
+		// remove lines, which may have been fetched speculatively meanwhile
+		CleanAndInvalidateDataCacheRange ((uintptr) pDesc->pDestination + pJob->nOffset,
+						  pJob->nSegment);
+	}
+
+	if (bStatus)
+	{
+		pJob->nOffset += pJob->nSegment;
+		if (pJob->nOffset >= pDesc->nLength)
+		{
+			pJob->pCurrent = pDesc->pNext;
+			pJob->nOffset = 0;
+		}
+
+		if (pJob->pCurrent != 0)
+		{
+			// continue the chain on the same channel
+			StartSegment (pChannel);
+
+			m_SpinLock.Release ();
+
+			return;
+		}
+	}
+
+	TDMAJobCompletionRoutine *pRoutine = pJob->pRoutine;
+	void *pParam = pJob->pParam;
+
+	pChannel->pJob = 0;
+
+	pJob->pNext = m_pFreeJob;
+	m_pFreeJob = pJob;
+
+	assert (m_nPendingJobs > 0);
+	m_nPendingJobs--;
+
+	Schedule ();
+
+	m_SpinLock.Release ();
+
+	assert (pRoutine != 0);
+	(*pRoutine) (bStatus, pParam);
+}
+
+void CDMAManager::ChannelCompletionStub (unsigned nChannel, unsigned nBuffer,
+					 boolean bStatus, void *pParam)
+{
+	TChannel *pChannel = (TChannel *) pParam;
+	assert (pChannel != 0);
+
+	CDMAManager *pThis = pChannel->pThis;
+	assert (pThis != 0);
+
+	pThis->ChannelCompletion (pChannel, bStatus);
+}
+
+CDMAManager *CDMAManager::Get (void)
+{
+	assert (s_pThis != 0);
+	return s_pThis;
+}
@@ -0,0 +1,262 @@
+//
+// biquad.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dsp/biquad.h>
+#include <circle/dsp/dspmath.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CBiquadCascade::CBiquadCascade (unsigned nStages)
+:	m_nStages (nStages),
+	m_pCoeffs (new TBiquadCoefficients[nStages]),
+	m_pState (new float[nStages * 2])
+{
+	assert (m_nStages > 0);
+	assert (m_pCoeffs != 0);
+	assert (m_pState != 0);
+
+	// pass-through until set
+	for (unsigned i = 0; i < m_nStages; i++)
+	{
+		m_pCoeffs[i].b0 = 1.0f;
+		m_pCoeffs[i].b1 = 0.0f;
+		m_pCoeffs[i].b2 = 0.0f;
+		m_pCoeffs[i].a1 = 0.0f;
+		m_pCoeffs[i].a2 = 0.0f;
+	}
+
+	Reset ();
+}
+
+CBiquadCascade::~CBiquadCascade (void)
+{
+	delete [] m_pState;
+	m_pState = 0;
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+void CBiquadCascade::SetCoefficients (unsigned nStage, const TBiquadCoefficients &rCoeffs)
+{
+	assert (nStage < m_nStages);
+	m_pCoeffs[nStage] = rCoeffs;
+}
+
+void CBiquadCascade::Reset (void)
+{
+	for (unsigned i = 0; i < m_nStages * 2; i++)
+	{
+		m_pState[i] = 0.0f;
+	}
+}
+
+void CBiquadCascade::Process (const float *pIn, float *pOut, unsigned nSamples)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	// process the whole block stage by stage, to keep the coefficients in registers
+	for (unsigned nStage = 0; nStage < m_nStages; nStage++)
+	{
+		const TBiquadCoefficients *pCoeffs = &m_pCoeffs[nStage];
+		float b0 = pCoeffs->b0;
+		float b1 = pCoeffs->b1;
+		float b2 = pCoeffs->b2;
+		float a1 = pCoeffs->a1;
+		float a2 = pCoeffs->a2;
+
+		float s1 = m_pState[nStage*2];
+		float s2 = m_pState[nStage*2+1];
+
+		const float *pFrom = nStage == 0 ? pIn : pOut;
+
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			float x = pFrom[i];
+			float y = b0 * x + s1;
+
+			s1 = b1 * x - a1 * y + s2;
+			s2 = b2 * x - a2 * y;
+
+			pOut[i] = y;
+		}
+
+		m_pState[nStage*2] = s1;
+		m_pState[nStage*2+1] = s2;
+	}
+}
+
+void CBiquadCascade::Design (TBiquadCoefficients *pCoeffs, TBiquadType Type,
+			     float fSampleRate, float fFrequency, float fQ)
+{
+	assert (pCoeffs != 0);
+	assert (fSampleRate > 0.0f);
+	assert (0.0f < fFrequency && fFrequency < fSampleRate / 2.0f);
+	assert (fQ > 0.0f);
+
+	double w0 = 2.0 * DSP_PI * fFrequency / fSampleRate;
+	double dCos = CDSPMath::Cos (w0);
+	double dAlpha = CDSPMath::Sin (w0) / (2.0 * fQ);
+
+	double b0, b1, b2;
+	switch (Type)
+	{
+	case BiquadLowPass:
+		b0 = (1.0 - dCos) / 2.0;
+		b1 = 1.0 - dCos;
+		b2 = b0;
+		break;
+
+	case BiquadHighPass:
+		b0 = (1.0 + dCos) / 2.0;
+		b1 = -(1.0 + dCos);
+		b2 = b0;
+		break;
+
+	case BiquadBandPass:
+		b0 = dAlpha;
+		b1 = 0.0;
+		b2 = -dAlpha;
+		break;
+
+	case BiquadNotch:
+		b0 = 1.0;
+		b1 = -2.0 * dCos;
+		b2 = 1.0;
+		break;
+
+	case BiquadAllPass:
+		b0 = 1.0 - dAlpha;
+		b1 = -2.0 * dCos;
+		b2 = 1.0 + dAlpha;
+		break;
+
+	default:
+		assert (0);
+		return;
+	}
+
+	double a0 = 1.0 + dAlpha;
+
+	pCoeffs->b0 = (float) (b0 / a0);
+	pCoeffs->b1 = (float) (b1 / a0);
+	pCoeffs->b2 = (float) (b2 / a0);
+	pCoeffs->a1 = (float) (-2.0 * dCos / a0);
+	pCoeffs->a2 = (float) ((1.0 - dAlpha) / a0);
+}
+
+CBiquadCascadeQ31::CBiquadCascadeQ31 (unsigned nStages)
+:	m_nStages (nStages),
+	m_pCoeffs (new s32[nStages * 5]),
+	m_pState (new s32[nStages * 4])
+{
+	assert (m_nStages > 0);
+	assert (m_pCoeffs != 0);
+	assert (m_pState != 0);
+
+	TBiquadCoefficients PassThrough = {1.0f, 0.0f, 0.0f, 0.0f, 0.0f};
+	for (unsigned i = 0; i < m_nStages; i++)
+	{
+		SetCoefficients (i, PassThrough);
+	}
+
+	Reset ();
+}
+
+CBiquadCascadeQ31::~CBiquadCascadeQ31 (void)
+{
+	delete [] m_pState;
+	m_pState = 0;
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+void CBiquadCascadeQ31::SetCoefficients (unsigned nStage, const TBiquadCoefficients &rCoeffs)
+{
+	assert (nStage < m_nStages);
+
+	// Q30 allows the range -2.0 .. < 2.0, which is required for a1
+	s32 *pCoeffs = &m_pCoeffs[nStage * 5];
+	pCoeffs[0] = CDSPMath::FloatToQ31 (rCoeffs.b0 / 2.0f);
+	pCoeffs[1] = CDSPMath::FloatToQ31 (rCoeffs.b1 / 2.0f);
+	pCoeffs[2] = CDSPMath::FloatToQ31 (rCoeffs.b2 / 2.0f);
+	pCoeffs[3] = CDSPMath::FloatToQ31 (rCoeffs.a1 / 2.0f);
+	pCoeffs[4] = CDSPMath::FloatToQ31 (rCoeffs.a2 / 2.0f);
+}
+
+void CBiquadCascadeQ31::Reset (void)
+{
+	memset (m_pState, 0, m_nStages * 4 * sizeof (s32));
+}
+
+void CBiquadCascadeQ31::Process (const s32 *pIn, s32 *pOut, unsigned nSamples)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	for (unsigned nStage = 0; nStage < m_nStages; nStage++)
+	{
+		const s32 *pCoeffs = &m_pCoeffs[nStage * 5];
+		s64 b0 = pCoeffs[0];
+		s64 b1 = pCoeffs[1];
+		s64 b2 = pCoeffs[2];
+		s64 a1 = pCoeffs[3];
+		s64 a2 = pCoeffs[4];
+
+		s32 *pState = &m_pState[nStage * 4];
+		s32 x1 = pState[0];
+		s32 x2 = pState[1];
+		s32 y1 = pState[2];
+		s32 y2 = pState[3];
+
+		const s32 *pFrom = nStage == 0 ? pIn : pOut;
+
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			s32 x = pFrom[i];
+
+			s64 nAcc = b0 * x + b1 * x1 + b2 * x2 - a1 * y1 - a2 * y2;
+
+			// Q31 * Q30 = Q61, saturate to Q31
+			nAcc >>= 30;
+			if (nAcc > 0x7FFFFFFF)
+			{
+				nAcc = 0x7FFFFFFF;
+			}
+			else if (nAcc < -(s64) 0x80000000)
+			{
+				nAcc = -(s64) 0x80000000;
+			}
+
+			x2 = x1;
+			x1 = x;
+			y2 = y1;
+			y1 = (s32) nAcc;
+
+			pOut[i] = y1;
+		}
+
+		pState[0] = x1;
+		pState[1] = x2;
+		pState[2] = y1;
+		pState[3] = y2;
+	}
+}
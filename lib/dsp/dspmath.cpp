@@ -0,0 +1,114 @@
+//
+// dspmath.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dsp/dspmath.h>
+
+// Taylor series on [-pi/4, pi/4], the error is below 1e-16 there
+static double SinReduced (double x)
+{
+	double x2 = x * x;
+
+	return x * (1.0 - x2 / 6.0 * (1.0 - x2 / 20.0 * (1.0 - x2 / 42.0 * (1.0 - x2 / 72.0
+		   * (1.0 - x2 / 110.0 * (1.0 - x2 / 156.0 * (1.0 - x2 / 210.0)))))));
+}
+
+static double CosReduced (double x)
+{
+	double x2 = x * x;
+
+	return 1.0 - x2 / 2.0 * (1.0 - x2 / 12.0 * (1.0 - x2 / 30.0 * (1.0 - x2 / 56.0
+		   * (1.0 - x2 / 90.0 * (1.0 - x2 / 132.0 * (1.0 - x2 / 182.0))))));
+}
+
+double CDSPMath::Sin (double x)
+{
+	// reduce to [-pi/4, pi/4] around the nearest multiple of pi/2
+	double dQuadrants = x / (DSP_PI / 2.0);
+	s64 nQuadrant = (s64) (dQuadrants >= 0.0 ? dQuadrants + 0.5 : dQuadrants - 0.5);
+	double r = x - (double) nQuadrant * (DSP_PI / 2.0);
+
+	switch (nQuadrant & 3)
+	{
+	case 0:		return SinReduced (r);
+	case 1:		return CosReduced (r);
+	case 2:		return -SinReduced (r);
+	default:	return -CosReduced (r);
+	}
+}
+
+double CDSPMath::Cos (double x)
+{
+	return Sin (x + DSP_PI / 2.0);
+}
+
+double CDSPMath::Sqrt (double x)
+{
+	if (x <= 0.0)
+	{
+		return 0.0;
+	}
+
+	// Newton iteration, starting from an estimate by the exponent
+	double y = 1.0;
+	for (double t = x; t > 4.0; t /= 4.0)
+	{
+		y *= 2.0;
+	}
+	for (double t = x; t < 0.25; t *= 4.0)
+	{
+		y /= 2.0;
+	}
+
+	for (unsigned i = 0; i < 8; i++)
+	{
+		y = 0.5 * (y + x / y);
+	}
+
+	return y;
+}
+
+s16 CDSPMath::FloatToQ15 (float fValue)
+{
+	float f = fValue * 32768.0f;
+	if (f >= 32767.0f)
+	{
+		return 32767;
+	}
+	if (f <= -32768.0f)
+	{
+		return -32768;
+	}
+
+	return (s16) (f >= 0.0f ? f + 0.5f : f - 0.5f);
+}
+
+s32 CDSPMath::FloatToQ31 (float fValue)
+{
+	double d = (double) fValue * 2147483648.0;
+	if (d >= 2147483647.0)
+	{
+		return 0x7FFFFFFF;
+	}
+	if (d <= -2147483648.0)
+	{
+		return (s32) 0x80000000;
+	}
+
+	return (s32) (d >= 0.0 ? d + 0.5 : d - 0.5);
+}
@@ -0,0 +1,144 @@
+//
+// fastconvolver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dsp/fastconvolver.h>
+#include <assert.h>
+
+CFastConvolver::CFastConvolver (const float *pImpulse, unsigned nLength, unsigned nBlockSize)
+:	m_nBlockSize (nBlockSize),
+	m_nPartitions ((nLength + nBlockSize - 1) / nBlockSize),
+	m_nSpectrumSize (nBlockSize * 4),
+	m_FFT (nBlockSize * 2),
+	m_pFilter (new float[m_nPartitions * m_nSpectrumSize]),
+	m_pDelayLine (new float[m_nPartitions * m_nSpectrumSize]),
+	m_pInput (new float[nBlockSize * 2]),
+	m_pBuffer (new float[m_nSpectrumSize])
+{
+	assert (pImpulse != 0);
+	assert (nLength > 0);
+	assert (m_nBlockSize >= 2);
+	assert (m_pFilter != 0);
+	assert (m_pDelayLine != 0);
+	assert (m_pInput != 0);
+	assert (m_pBuffer != 0);
+
+	// each partition is zero-padded to the FFT size
+	for (unsigned nPart = 0; nPart < m_nPartitions; nPart++)
+	{
+		float *pSpectrum = &m_pFilter[nPart * m_nSpectrumSize];
+
+		for (unsigned i = 0; i < m_nBlockSize * 2; i++)
+		{
+			unsigned nIndex = nPart * m_nBlockSize + i;
+
+			pSpectrum[i*2] =    i < m_nBlockSize && nIndex < nLength
+					  ? pImpulse[nIndex] : 0.0f;
+			pSpectrum[i*2+1] = 0.0f;
+		}
+
+		m_FFT.Forward (pSpectrum);
+	}
+
+	Reset ();
+}
+
+CFastConvolver::~CFastConvolver (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	delete [] m_pInput;
+	m_pInput = 0;
+
+	delete [] m_pDelayLine;
+	m_pDelayLine = 0;
+
+	delete [] m_pFilter;
+	m_pFilter = 0;
+}
+
+unsigned CFastConvolver::GetBlockSize (void) const
+{
+	return m_nBlockSize;
+}
+
+void CFastConvolver::Reset (void)
+{
+	for (unsigned i = 0; i < m_nPartitions * m_nSpectrumSize; i++)
+	{
+		m_pDelayLine[i] = 0.0f;
+	}
+
+	for (unsigned i = 0; i < m_nBlockSize * 2; i++)
+	{
+		m_pInput[i] = 0.0f;
+	}
+
+	m_nDelayPos = 0;
+}
+
+void CFastConvolver::Process (const float *pIn, float *pOut)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	for (unsigned i = 0; i < m_nBlockSize; i++)
+	{
+		m_pInput[i] = m_pInput[m_nBlockSize + i];
+		m_pInput[m_nBlockSize + i] = pIn[i];
+	}
+
+	// transform the last two input blocks into the frequency-domain delay line
+	float *pSpectrum = &m_pDelayLine[m_nDelayPos * m_nSpectrumSize];
+	for (unsigned i = 0; i < m_nBlockSize * 2; i++)
+	{
+		pSpectrum[i*2] = m_pInput[i];
+		pSpectrum[i*2+1] = 0.0f;
+	}
+
+	m_FFT.Forward (pSpectrum);
+
+	// m_pBuffer = sum of delayed input spectrum k * filter partition k
+	for (unsigned i = 0; i < m_nSpectrumSize; i++)
+	{
+		m_pBuffer[i] = 0.0f;
+	}
+
+	unsigned nPos = m_nDelayPos;
+	for (unsigned nPart = 0; nPart < m_nPartitions; nPart++)
+	{
+		CFFT::MultiplyAccumulate (m_pBuffer, &m_pDelayLine[nPos * m_nSpectrumSize],
+					  &m_pFilter[nPart * m_nSpectrumSize], m_nBlockSize * 2);
+
+		nPos = (nPos == 0 ? m_nPartitions : nPos) - 1;
+	}
+
+	m_FFT.Inverse (m_pBuffer);
+
+	// the second half is free of circular aliasing
+	for (unsigned i = 0; i < m_nBlockSize; i++)
+	{
+		pOut[i] = m_pBuffer[(m_nBlockSize + i) * 2];
+	}
+
+	if (++m_nDelayPos == m_nPartitions)
+	{
+		m_nDelayPos = 0;
+	}
+}
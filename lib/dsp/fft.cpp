@@ -0,0 +1,243 @@
+//
+// fft.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// The Stockham algorithm is described here:
+//	http://wwwa.pikara.ne.jp/okojisan/otfft-en/stockham3.html
+//
+#include <circle/dsp/fft.h>
+#include <circle/dsp/dspmath.h>
+#include <assert.h>
+
+// two complex values per vector, see fir.cpp
+typedef float v4float __attribute__ ((vector_size (16), aligned (4)));
+typedef int v4int __attribute__ ((vector_size (16)));
+
+#define V(p)	(*(v4float *) (p))
+
+// (a, b) * i for both complex values
+static inline v4float MulJ (v4float z)
+{
+	return __builtin_shuffle (z, (v4int) {1, 0, 3, 2}) * (v4float) {-1.0f, 1.0f, -1.0f, 1.0f};
+}
+
+// z * (wr + i*wi) for both complex values
+static inline v4float MulW (v4float z, float wr, float wi)
+{
+	return z * wr + MulJ (z) * wi;
+}
+
+CFFT::CFFT (unsigned nSize)
+:	m_nSize (nSize),
+	m_pTwiddle (new float[nSize * 3 / 4 * 2]),
+	m_pWork (new float[nSize * 2])
+{
+	assert (m_nSize >= 2);
+	assert ((m_nSize & (m_nSize - 1)) == 0);
+	assert (m_pTwiddle != 0);
+	assert (m_pWork != 0);
+
+	for (unsigned k = 0; k < m_nSize * 3 / 4; k++)
+	{
+		double dAngle = 2.0 * DSP_PI * k / m_nSize;
+
+		m_pTwiddle[k*2] = (float) CDSPMath::Cos (dAngle);
+		m_pTwiddle[k*2+1] = (float) -CDSPMath::Sin (dAngle);
+	}
+}
+
+CFFT::~CFFT (void)
+{
+	delete [] m_pWork;
+	m_pWork = 0;
+
+	delete [] m_pTwiddle;
+	m_pTwiddle = 0;
+}
+
+unsigned CFFT::GetSize (void) const
+{
+	return m_nSize;
+}
+
+void CFFT::Forward (float *pData)
+{
+	assert (pData != 0);
+
+	Transform (pData);
+}
+
+void CFFT::Inverse (float *pData)
+{
+	assert (pData != 0);
+
+	// IFFT(x) = conj (FFT (conj (x))) / N
+	for (unsigned i = 0; i < m_nSize; i++)
+	{
+		pData[i*2+1] = -pData[i*2+1];
+	}
+
+	Transform (pData);
+
+	float fScale = 1.0f / m_nSize;
+	for (unsigned i = 0; i < m_nSize * 2; i += 4)
+	{
+		V (&pData[i]) *= (v4float) {fScale, -fScale, fScale, -fScale};
+	}
+}
+
+void CFFT::MultiplyAccumulate (float *pResult, const float *pA, const float *pB,
+			       unsigned nLength)
+{
+	assert (pResult != 0);
+	assert (pA != 0);
+	assert (pB != 0);
+
+	unsigned i;
+	for (i = 0; i + 2 <= nLength; i += 2)
+	{
+		v4float a = V (&pA[i*2]);
+		v4float b = V (&pB[i*2]);
+
+		v4float bre = __builtin_shuffle (b, (v4int) {0, 0, 2, 2});
+		v4float bim = __builtin_shuffle (b, (v4int) {1, 1, 3, 3});
+
+		V (&pResult[i*2]) += a * bre + MulJ (a) * bim;
+	}
+
+	if (i < nLength)
+	{
+		float re = pA[i*2] * pB[i*2] - pA[i*2+1] * pB[i*2+1];
+		float im = pA[i*2] * pB[i*2+1] + pA[i*2+1] * pB[i*2];
+
+		pResult[i*2] += re;
+		pResult[i*2+1] += im;
+	}
+}
+
+void CFFT::Transform (float *pData)
+{
+	float *x = pData;
+	float *y = m_pWork;
+
+	unsigned n = m_nSize;
+	unsigned s = 1;
+	for (; n >= 4; n /= 4, s *= 4)
+	{
+		Radix4Stage (n, s, x, y);
+
+		float *pTemp = x;
+		x = y;
+		y = pTemp;
+	}
+
+	if (n == 2)
+	{
+		// final radix-2 stage, writes the result to pData
+		for (unsigned q = 0; q < s; q++)
+		{
+			float are = x[q*2];
+			float aim = x[q*2+1];
+			float bre = x[(q+s)*2];
+			float bim = x[(q+s)*2+1];
+
+			pData[q*2] = are + bre;
+			pData[q*2+1] = aim + bim;
+			pData[(q+s)*2] = are - bre;
+			pData[(q+s)*2+1] = aim - bim;
+		}
+	}
+	else if (x != pData)
+	{
+		assert (n == 1);
+
+		for (unsigned i = 0; i < m_nSize * 2; i++)
+		{
+			pData[i] = x[i];
+		}
+	}
+}
+
+void CFFT::Radix4Stage (unsigned n, unsigned s, const float *x, float *y)
+{
+	unsigned n1 = n / 4;
+	unsigned n2 = n / 2;
+	unsigned n3 = n1 + n2;
+
+	for (unsigned p = 0; p < n1; p++)
+	{
+		const float *pW1 = &m_pTwiddle[p*s * 2];
+		const float *pW2 = &m_pTwiddle[2*p*s * 2];
+		const float *pW3 = &m_pTwiddle[3*p*s * 2];
+
+		const float *a = &x[s*p * 2];
+		const float *b = &x[s*(p + n1) * 2];
+		const float *c = &x[s*(p + n2) * 2];
+		const float *d = &x[s*(p + n3) * 2];
+
+		float *y0 = &y[s*(4*p) * 2];
+		float *y1 = &y[s*(4*p + 1) * 2];
+		float *y2 = &y[s*(4*p + 2) * 2];
+		float *y3 = &y[s*(4*p + 3) * 2];
+
+		if (s == 1)
+		{
+			float apcre = a[0] + c[0], apcim = a[1] + c[1];
+			float amcre = a[0] - c[0], amcim = a[1] - c[1];
+			float bpdre = b[0] + d[0], bpdim = b[1] + d[1];
+			float jbmdre = d[1] - b[1], jbmdim = b[0] - d[0];
+
+			y0[0] = apcre + bpdre;
+			y0[1] = apcim + bpdim;
+
+			float re = amcre - jbmdre, im = amcim - jbmdim;
+			y1[0] = re * pW1[0] - im * pW1[1];
+			y1[1] = re * pW1[1] + im * pW1[0];
+
+			re = apcre - bpdre; im = apcim - bpdim;
+			y2[0] = re * pW2[0] - im * pW2[1];
+			y2[1] = re * pW2[1] + im * pW2[0];
+
+			re = amcre + jbmdre; im = amcim + jbmdim;
+			y3[0] = re * pW3[0] - im * pW3[1];
+			y3[1] = re * pW3[1] + im * pW3[0];
+
+			continue;
+		}
+
+		// s is a multiple of 4 here, process two complex values at once
+		for (unsigned q = 0; q < s * 2; q += 4)
+		{
+			v4float va = V (&a[q]);
+			v4float vb = V (&b[q]);
+			v4float vc = V (&c[q]);
+			v4float vd = V (&d[q]);
+
+			v4float apc = va + vc;
+			v4float amc = va - vc;
+			v4float bpd = vb + vd;
+			v4float jbmd = MulJ (vb - vd);
+
+			V (&y0[q]) = apc + bpd;
+			V (&y1[q]) = MulW (amc - jbmd, pW1[0], pW1[1]);
+			V (&y2[q]) = MulW (apc - bpd, pW2[0], pW2[1]);
+			V (&y3[q]) = MulW (amc + jbmd, pW3[0], pW3[1]);
+		}
+	}
+}
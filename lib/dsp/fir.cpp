@@ -0,0 +1,284 @@
+//
+// fir.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dsp/fir.h>
+#include <circle/dsp/dspmath.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// GCC generates NEON code for this on AArch64 and on AArch32 with -ffast-math,
+// otherwise it is lowered to scalar VFP operations
+typedef float v4float __attribute__ ((vector_size (16), aligned (4)));
+
+// nLength must be a multiple of 4, the buffers need not be aligned
+static inline float DotProduct (const float *pA, const float *pB, unsigned nLength)
+{
+	v4float Sum = {0.0f, 0.0f, 0.0f, 0.0f};
+
+	for (unsigned i = 0; i < nLength; i += 4)
+	{
+		Sum += *(const v4float *) &pA[i] * *(const v4float *) &pB[i];
+	}
+
+	return (Sum[0] + Sum[1]) + (Sum[2] + Sum[3]);
+}
+
+CFIRFilter::CFIRFilter (const float *pCoeffs, unsigned nTaps, unsigned nDecimation)
+:	m_nTaps ((nTaps + 3) & ~3),
+	m_nDecimation (nDecimation),
+	m_pCoeffs (new float[m_nTaps]),
+	m_pDelay (new float[m_nTaps * 2])
+{
+	assert (pCoeffs != 0);
+	assert (nTaps > 0);
+	assert (m_nDecimation > 0);
+	assert (m_pCoeffs != 0);
+	assert (m_pDelay != 0);
+
+	for (unsigned i = 0; i < m_nTaps; i++)
+	{
+		m_pCoeffs[i] = i < nTaps ? pCoeffs[i] : 0.0f;
+	}
+
+	Reset ();
+}
+
+CFIRFilter::~CFIRFilter (void)
+{
+	delete [] m_pDelay;
+	m_pDelay = 0;
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+void CFIRFilter::Reset (void)
+{
+	for (unsigned i = 0; i < m_nTaps * 2; i++)
+	{
+		m_pDelay[i] = 0.0f;
+	}
+
+	m_nPos = 0;
+	m_nPhase = 0;
+}
+
+unsigned CFIRFilter::Process (const float *pIn, float *pOut, unsigned nSamples)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	unsigned nOut = 0;
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		// m_pDelay[m_nPos..] holds the newest sample first
+		m_nPos = (m_nPos == 0 ? m_nTaps : m_nPos) - 1;
+		m_pDelay[m_nPos] = m_pDelay[m_nPos + m_nTaps] = pIn[i];
+
+		if (m_nPhase == 0)
+		{
+			// nOut <= i, so this works in place
+			pOut[nOut++] = DotProduct (m_pCoeffs, &m_pDelay[m_nPos], m_nTaps);
+		}
+
+		if (++m_nPhase == m_nDecimation)
+		{
+			m_nPhase = 0;
+		}
+	}
+
+	return nOut;
+}
+
+void CFIRFilter::DesignLowPass (float *pCoeffs, unsigned nTaps, float fCutoff,
+				TWindowType Window)
+{
+	assert (pCoeffs != 0);
+	assert (nTaps > 0);
+	assert (0.0f < fCutoff && fCutoff <= 0.5f);
+
+	CWindowFunction::Generate (Window, pCoeffs, nTaps, FALSE);
+
+	double dCenter = (nTaps - 1) / 2.0;
+	double dSum = 0.0;
+	for (unsigned i = 0; i < nTaps; i++)
+	{
+		double x = i - dCenter;
+		double dSinc =   x != 0.0
+			       ? CDSPMath::Sin (2.0 * DSP_PI * fCutoff * x) / (DSP_PI * x)
+			       : 2.0 * fCutoff;
+
+		double dValue = dSinc * pCoeffs[i];
+		pCoeffs[i] = (float) dValue;
+		dSum += dValue;
+	}
+
+	assert (dSum > 0.0);
+	for (unsigned i = 0; i < nTaps; i++)
+	{
+		pCoeffs[i] = (float) (pCoeffs[i] / dSum);
+	}
+}
+
+CFIRFilterQ15::CFIRFilterQ15 (const float *pCoeffs, unsigned nTaps, unsigned nDecimation)
+:	m_nTaps (nTaps),
+	m_nDecimation (nDecimation),
+	m_pCoeffs (new s16[nTaps]),
+	m_pDelay (new s16[nTaps * 2])
+{
+	assert (pCoeffs != 0);
+	assert (m_nTaps > 0);
+	assert (m_nDecimation > 0);
+	assert (m_pCoeffs != 0);
+	assert (m_pDelay != 0);
+
+	for (unsigned i = 0; i < m_nTaps; i++)
+	{
+		m_pCoeffs[i] = CDSPMath::FloatToQ15 (pCoeffs[i]);
+	}
+
+	Reset ();
+}
+
+CFIRFilterQ15::~CFIRFilterQ15 (void)
+{
+	delete [] m_pDelay;
+	m_pDelay = 0;
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+void CFIRFilterQ15::Reset (void)
+{
+	memset (m_pDelay, 0, m_nTaps * 2 * sizeof (s16));
+
+	m_nPos = 0;
+	m_nPhase = 0;
+}
+
+unsigned CFIRFilterQ15::Process (const s16 *pIn, s16 *pOut, unsigned nSamples)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	unsigned nOut = 0;
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		m_nPos = (m_nPos == 0 ? m_nTaps : m_nPos) - 1;
+		m_pDelay[m_nPos] = m_pDelay[m_nPos + m_nTaps] = pIn[i];
+
+		if (m_nPhase == 0)
+		{
+			const s16 *pDelay = &m_pDelay[m_nPos];
+
+			// Q15 * Q15 = Q30, accumulated without overflow
+			s64 nAcc = 1 << 14;
+			for (unsigned j = 0; j < m_nTaps; j++)
+			{
+				nAcc += (s32) m_pCoeffs[j] * pDelay[j];
+			}
+
+			nAcc >>= 15;
+			if (nAcc > 32767)
+			{
+				nAcc = 32767;
+			}
+			else if (nAcc < -32768)
+			{
+				nAcc = -32768;
+			}
+
+			pOut[nOut++] = (s16) nAcc;
+		}
+
+		if (++m_nPhase == m_nDecimation)
+		{
+			m_nPhase = 0;
+		}
+	}
+
+	return nOut;
+}
+
+CFIRInterpolator::CFIRInterpolator (const float *pCoeffs, unsigned nTaps, unsigned nFactor)
+:	m_nFactor (nFactor),
+	m_nPhaseTaps ((((nTaps + nFactor - 1) / nFactor) + 3) & ~3),
+	m_pCoeffs (new float[m_nPhaseTaps * nFactor]),
+	m_pDelay (new float[m_nPhaseTaps * 2])
+{
+	assert (pCoeffs != 0);
+	assert (nTaps > 0);
+	assert (m_nFactor > 0);
+	assert (m_pCoeffs != 0);
+	assert (m_pDelay != 0);
+
+	// sub-filter p gets the coefficients p, p+L, p+2L, ...
+	for (unsigned nPhase = 0; nPhase < m_nFactor; nPhase++)
+	{
+		float *pPhase = &m_pCoeffs[nPhase * m_nPhaseTaps];
+
+		for (unsigned i = 0; i < m_nPhaseTaps; i++)
+		{
+			unsigned nIndex = nPhase + i * m_nFactor;
+
+			pPhase[i] = nIndex < nTaps ? pCoeffs[nIndex] : 0.0f;
+		}
+	}
+
+	Reset ();
+}
+
+CFIRInterpolator::~CFIRInterpolator (void)
+{
+	delete [] m_pDelay;
+	m_pDelay = 0;
+
+	delete [] m_pCoeffs;
+	m_pCoeffs = 0;
+}
+
+void CFIRInterpolator::Reset (void)
+{
+	for (unsigned i = 0; i < m_nPhaseTaps * 2; i++)
+	{
+		m_pDelay[i] = 0.0f;
+	}
+
+	m_nPos = 0;
+}
+
+void CFIRInterpolator::Process (const float *pIn, float *pOut, unsigned nSamples)
+{
+	assert (pIn != 0);
+	assert (pOut != 0);
+
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		m_nPos = (m_nPos == 0 ? m_nPhaseTaps : m_nPos) - 1;
+		m_pDelay[m_nPos] = m_pDelay[m_nPos + m_nPhaseTaps] = pIn[i];
+
+		const float *pDelay = &m_pDelay[m_nPos];
+		for (unsigned nPhase = 0; nPhase < m_nFactor; nPhase++)
+		{
+			*pOut++ = DotProduct (&m_pCoeffs[nPhase * m_nPhaseTaps], pDelay,
+					      m_nPhaseTaps);
+		}
+	}
+}
@@ -0,0 +1,75 @@
+//
+// windowfunction.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/dsp/windowfunction.h>
+#include <circle/dsp/dspmath.h>
+#include <assert.h>
+
+// coefficients of the cosine sums a0 - a1*cos(x) + a2*cos(2x) - a3*cos(3x) + a4*cos(4x)
+static const double CosineSum[WindowUnknown][5] =
+{
+	{1.0,		0.0,		0.0,		0.0,		0.0},		// Rectangular
+	{0.5,		0.5,		0.0,		0.0,		0.0},		// Hann
+	{0.54,		0.46,		0.0,		0.0,		0.0},		// Hamming
+	{0.42,		0.5,		0.08,		0.0,		0.0},		// Blackman
+	{0.35875,	0.48829,	0.14128,	0.01168,	0.0},		// Blackman-Harris
+	{0.21557895,	0.41663158,	0.277263158,	0.083578947,	0.006947368}	// Flat top
+};
+
+void CWindowFunction::Generate (TWindowType Type, float *pWindow, unsigned nLength,
+				boolean bPeriodic)
+{
+	assert (Type < WindowUnknown);
+	assert (pWindow != 0);
+	assert (nLength > 0);
+
+	if (nLength == 1)
+	{
+		pWindow[0] = 1.0f;
+
+		return;
+	}
+
+	const double *pCoeff = CosineSum[Type];
+	double dPeriod = bPeriodic ? nLength : nLength - 1;
+
+	for (unsigned i = 0; i < nLength; i++)
+	{
+		double x = 2.0 * DSP_PI * i / dPeriod;
+
+		double dValue =   pCoeff[0]
+				- pCoeff[1] * CDSPMath::Cos (x)
+				+ pCoeff[2] * CDSPMath::Cos (2.0 * x)
+				- pCoeff[3] * CDSPMath::Cos (3.0 * x)
+				+ pCoeff[4] * CDSPMath::Cos (4.0 * x);
+
+		pWindow[i] = (float) dValue;
+	}
+}
+
+void CWindowFunction::Apply (const float *pWindow, float *pData, unsigned nLength)
+{
+	assert (pWindow != 0);
+	assert (pData != 0);
+
+	for (unsigned i = 0; i < nLength; i++)
+	{
+		pData[i] *= pWindow[i];
+	}
+}
@@ -0,0 +1,610 @@
+//
+// formatter.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/formatter.h>
+#include <circle/util.h>
+
+#define MAX_NUMBER_LEN		22	// 64 bit octal number
+#define MAX_FLOAT_LEN		(1+20+1+FORMAT_MAX_PRECISION)
+
+#define FRACTION_BITS		60	// fixed point fraction of %f, 4 bits for the next digit
+
+static const char s_DecimalPairs[] =
+	"00010203040506070809"
+	"10111213141516171819"
+	"20212223242526272829"
+	"30313233343536373839"
+	"40414243444546474849"
+	"50515253545556575859"
+	"60616263646566676869"
+	"70717273747576777879"
+	"80818283848586878889"
+	"90919293949596979899";
+
+size_t CFormatter::Format (char *pBuffer, size_t nSize, const char *pFormat, ...)
+{
+	va_list var;
+	va_start (var, pFormat);
+
+	size_t nResult = FormatV (pBuffer, nSize, pFormat, var);
+
+	va_end (var);
+
+	return nResult;
+}
+
+size_t CFormatter::FormatV (char *pBuffer, size_t nSize, const char *pFormat, va_list Args)
+{
+	TOutput Output;
+	Output.pOut = pBuffer;
+	Output.pEnd = nSize > 0 ? pBuffer + nSize-1 : pBuffer;
+	Output.nLength = 0;
+
+	while (*pFormat != '\0')
+	{
+		if (*pFormat != '%')
+		{
+			// copy literal text up to the next specification at once
+			const char *pText = pFormat;
+			while (*pFormat != '\0' && *pFormat != '%')
+			{
+				pFormat++;
+			}
+
+			PutString (&Output, pText, pFormat - pText);
+
+			continue;
+		}
+
+		if (*++pFormat == '%')
+		{
+			PutChar (&Output, '%');
+
+			pFormat++;
+
+			continue;
+		}
+
+		boolean bAlternate = FALSE;
+		boolean bLeft = FALSE;
+		boolean bNull = FALSE;
+		while (1)
+		{
+			if (*pFormat == '#')
+			{
+				bAlternate = TRUE;
+			}
+			else if (*pFormat == '-')
+			{
+				bLeft = TRUE;
+			}
+			else if (*pFormat == '0')
+			{
+				bNull = TRUE;
+			}
+			else
+			{
+				break;
+			}
+
+			pFormat++;
+		}
+
+		size_t nWidth = 0;
+		if (*pFormat == '*')
+		{
+			int nArg = va_arg (Args, int);
+			if (nArg < 0)
+			{
+				bLeft = TRUE;
+				nArg = -nArg;
+			}
+
+			nWidth = nArg;
+
+			pFormat++;
+		}
+		else
+		{
+			while ('0' <= *pFormat && *pFormat <= '9')
+			{
+				nWidth = nWidth * 10 + (*pFormat - '0');
+
+				pFormat++;
+			}
+		}
+
+		boolean bPrecision = FALSE;
+		unsigned nPrecision = 6;
+		if (*pFormat == '.')
+		{
+			bPrecision = TRUE;
+			nPrecision = 0;
+
+			pFormat++;
+
+			if (*pFormat == '*')
+			{
+				int nArg = va_arg (Args, int);
+				if (nArg < 0)
+				{
+					bPrecision = FALSE;
+					nArg = 6;
+				}
+
+				nPrecision = nArg;
+
+				pFormat++;
+			}
+			else
+			{
+				while ('0' <= *pFormat && *pFormat <= '9')
+				{
+					nPrecision = nPrecision * 10 + (*pFormat - '0');
+
+					pFormat++;
+				}
+			}
+		}
+
+		boolean bLong = FALSE;
+		boolean bLongLong = FALSE;
+		boolean bSize = FALSE;
+		if (*pFormat == 'l')
+		{
+			if (*++pFormat == 'l')
+			{
+				bLongLong = TRUE;
+
+				pFormat++;
+			}
+			else
+			{
+				bLong = TRUE;
+			}
+		}
+		else if (*pFormat == 'z')
+		{
+			bSize = TRUE;
+
+			pFormat++;
+		}
+
+		char NumBuf[MAX_FLOAT_LEN+1];
+		const char *pArg = NumBuf;
+		size_t nLen;
+		char chPad = ' ';
+		const char *pPrefix = 0;
+		unsigned nBase = 10;
+		u64 ullArg;
+
+		switch (*pFormat)
+		{
+		case 'c':
+			NumBuf[0] = (char) va_arg (Args, int);
+			nLen = 1;
+			break;
+
+		case 'd':
+		case 'i': {
+			s64 llArg;
+			if (bLongLong)
+			{
+				llArg = va_arg (Args, long long);
+			}
+			else if (bLong)
+			{
+				llArg = va_arg (Args, long);
+			}
+			else if (bSize)
+			{
+				llArg = va_arg (Args, ssize_t);
+			}
+			else
+			{
+				llArg = va_arg (Args, int);
+			}
+
+			char *p = NumBuf;
+			ullArg = (u64) llArg;
+			if (llArg < 0)
+			{
+				*p++ = '-';
+				ullArg = -ullArg;
+			}
+
+			nLen = (p - NumBuf) + FormatUnsigned (p, ullArg, 10, FALSE);
+
+			if (bNull && !bLeft)
+			{
+				// the sign precedes the zeros
+				if (p != NumBuf)
+				{
+					PutChar (&Output, '-');
+
+					pArg++;
+					nLen--;
+					if (nWidth > 0)
+					{
+						nWidth--;
+					}
+				}
+
+				chPad = '0';
+			}
+			} break;
+
+		case 'f':
+			if (nPrecision > FORMAT_MAX_PRECISION)
+			{
+				nPrecision = FORMAT_MAX_PRECISION;
+			}
+
+			nLen = FormatFloat (NumBuf, va_arg (Args, double), nPrecision);
+			break;
+
+		case 's':
+			pArg = va_arg (Args, const char *);
+			if (pArg == 0)
+			{
+				pArg = "(null)";
+			}
+
+			if (!bPrecision)
+			{
+				nLen = strlen (pArg);
+			}
+			else
+			{
+				for (nLen = 0; nLen < nPrecision && pArg[nLen] != '\0'; nLen++)
+				{
+					// just count
+				}
+			}
+			break;
+
+		case 'p':
+			bAlternate = TRUE;
+			bLongLong = FALSE;
+			bLong = TRUE;
+			bSize = FALSE;
+			// fall through
+
+		case 'o':
+		case 'u':
+		case 'x':
+		case 'X':
+			if (bLongLong)
+			{
+				ullArg = va_arg (Args, unsigned long long);
+			}
+			else if (bLong)
+			{
+				ullArg = va_arg (Args, unsigned long);
+			}
+			else if (bSize)
+			{
+				ullArg = va_arg (Args, size_t);
+			}
+			else
+			{
+				ullArg = va_arg (Args, unsigned);
+			}
+
+			if (*pFormat == 'o')
+			{
+				nBase = 8;
+				if (bAlternate)
+				{
+					pPrefix = "0";
+				}
+			}
+			else if (*pFormat != 'u')
+			{
+				nBase = 16;
+				if (bAlternate)
+				{
+					pPrefix = *pFormat == 'X' ? "0X" : "0x";
+				}
+			}
+
+			// the prefix is not accounted in the width (compatible with former CString)
+			if (pPrefix != 0)
+			{
+				PutString (&Output, pPrefix, strlen (pPrefix));
+			}
+
+			nLen = FormatUnsigned (NumBuf, ullArg, nBase, *pFormat == 'X');
+			if (bNull && !bLeft)
+			{
+				chPad = '0';
+			}
+			break;
+
+		default:
+			PutChar (&Output, '%');
+			if (*pFormat == '\0')
+			{
+				continue;
+			}
+			NumBuf[0] = *pFormat;
+			nLen = 1;
+			nWidth = 0;
+			break;
+		}
+
+		if (!bLeft && nWidth > nLen)
+		{
+			PutChar (&Output, chPad, nWidth-nLen);
+		}
+
+		PutString (&Output, pArg, nLen);
+
+		if (bLeft && nWidth > nLen)
+		{
+			PutChar (&Output, ' ', nWidth-nLen);
+		}
+
+		pFormat++;
+	}
+
+	if (nSize > 0)
+	{
+		*Output.pOut = '\0';
+	}
+
+	return Output.nLength;
+}
+
+unsigned CFormatter::FormatUnsigned (char *pDest, u64 ullNumber, unsigned nBase, boolean bUpcase)
+{
+	char Buffer[MAX_NUMBER_LEN];
+	char *p = Buffer + sizeof Buffer;
+
+	if (nBase == 10)
+	{
+		// 64-bit division is expensive on AArch32, so continue in 32-bit, when possible
+		while (ullNumber > 0xFFFFFFFFU)
+		{
+			unsigned nRest = (unsigned) (ullNumber % 100);
+			ullNumber /= 100;
+
+			p -= 2;
+			memcpy (p, &s_DecimalPairs[nRest * 2], 2);
+		}
+
+		u32 nNumber = (u32) ullNumber;
+		while (nNumber >= 100)
+		{
+			unsigned nRest = nNumber % 100;
+			nNumber /= 100;
+
+			p -= 2;
+			memcpy (p, &s_DecimalPairs[nRest * 2], 2);
+		}
+
+		if (nNumber >= 10)
+		{
+			p -= 2;
+			memcpy (p, &s_DecimalPairs[nNumber * 2], 2);
+		}
+		else
+		{
+			*--p = '0' + nNumber;
+		}
+	}
+	else
+	{
+		// power of 2 bases are converted by shifting
+		unsigned nShift = nBase == 16 ? 4 : 3;
+		unsigned nMask = nBase - 1;
+		const char *pDigits = bUpcase ? "0123456789ABCDEF" : "0123456789abcdef";
+
+		do
+		{
+			*--p = pDigits[ullNumber & nMask];
+			ullNumber >>= nShift;
+		}
+		while (ullNumber != 0);
+	}
+
+	unsigned nLength = Buffer + sizeof Buffer - p;
+	memcpy (pDest, p, nLength);
+	pDest[nLength] = '\0';
+
+	return nLength;
+}
+
+unsigned CFormatter::FormatFloat (char *pDest, double fNumber, unsigned nPrecision)
+{
+	char *p = pDest;
+
+	if (nPrecision > FORMAT_MAX_PRECISION)
+	{
+		nPrecision = FORMAT_MAX_PRECISION;
+	}
+
+	union
+	{
+		double	fValue;
+		u64	ullBits;
+	}
+	Number;
+	Number.fValue = fNumber;
+
+	int nExponent = (int) ((Number.ullBits >> 52) & 0x7FF);
+	u64 ullMantissa = Number.ullBits & ((1ULL << 52)-1);
+
+	if (nExponent == 0x7FF)
+	{
+		if (ullMantissa != 0)
+		{
+			strcpy (p, "nan");
+
+			return 3;
+		}
+
+		if (fNumber < 0)
+		{
+			*p++ = '-';
+		}
+
+		strcpy (p, "inf");
+
+		return p - pDest + 3;
+	}
+
+	if (fNumber < 0)
+	{
+		*p++ = '-';
+	}
+
+	if (nExponent == 0)
+	{
+		nExponent = 1;			// subnormal number
+	}
+	else
+	{
+		ullMantissa |= 1ULL << 52;
+	}
+
+	// value = mantissa * 2^(exponent-52)
+	nExponent -= 1023;
+	if (nExponent >= 64)
+	{
+		strcpy (p, "overflow");
+
+		return p - pDest + 8;
+	}
+
+	// split into integer part and fraction with FRACTION_BITS, the fraction is exact,
+	// except for numbers < 2^-8, where lost bits are kept as sticky bit for rounding
+	u64 ullInteger;
+	u64 ullFraction;
+	if (nExponent >= 52)
+	{
+		ullInteger = ullMantissa << (nExponent-52);
+		ullFraction = 0;
+	}
+	else if (nExponent >= 0)
+	{
+		ullInteger = ullMantissa >> (52-nExponent);
+		ullFraction =   (ullMantissa & ((1ULL << (52-nExponent))-1))
+			      << (FRACTION_BITS-52+nExponent);
+	}
+	else
+	{
+		ullInteger = 0;
+
+		int nShift = FRACTION_BITS-52+nExponent;
+		if (nShift >= 0)
+		{
+			ullFraction = ullMantissa << nShift;
+		}
+		else if (nShift > -64)
+		{
+			ullFraction = ullMantissa >> -nShift;
+			if (ullMantissa & ((1ULL << -nShift)-1))
+			{
+				ullFraction |= 1;
+			}
+		}
+		else
+		{
+			ullFraction = ullMantissa != 0 ? 1 : 0;
+		}
+	}
+
+	// generate the digits of the fraction, multiplying by 10 keeps them exact
+	char Digits[FORMAT_MAX_PRECISION];
+	const u64 ullMask = (1ULL << FRACTION_BITS)-1;
+	for (unsigned i = 0; i < nPrecision; i++)
+	{
+		ullFraction *= 10;
+		Digits[i] = '0' + (char) (ullFraction >> FRACTION_BITS);
+		ullFraction &= ullMask;
+	}
+
+	// round to nearest, ties to even
+	const u64 ullHalf = 1ULL << (FRACTION_BITS-1);
+	boolean bOdd = nPrecision > 0 ? (Digits[nPrecision-1] & 1) : (ullInteger & 1);
+	if (   ullFraction > ullHalf
+	    || (ullFraction == ullHalf && bOdd))
+	{
+		int i;
+		for (i = (int) nPrecision-1; i >= 0; i--)
+		{
+			if (Digits[i] != '9')
+			{
+				Digits[i]++;
+
+				break;
+			}
+
+			Digits[i] = '0';
+		}
+
+		if (i < 0)
+		{
+			ullInteger++;
+		}
+	}
+
+	p += FormatUnsigned (p, ullInteger, 10, FALSE);
+
+	if (nPrecision > 0)
+	{
+		*p++ = '.';
+
+		memcpy (p, Digits, nPrecision);
+		p += nPrecision;
+	}
+
+	*p = '\0';
+
+	return p - pDest;
+}
+
+void CFormatter::PutChar (TOutput *pOutput, char chChar, size_t nCount)
+{
+	pOutput->nLength += nCount;
+
+	size_t nSpace = pOutput->pEnd - pOutput->pOut;
+	if (nCount > nSpace)
+	{
+		nCount = nSpace;
+	}
+
+	memset (pOutput->pOut, chChar, nCount);
+	pOutput->pOut += nCount;
+}
+
+void CFormatter::PutString (TOutput *pOutput, const char *pString, size_t nLength)
+{
+	pOutput->nLength += nLength;
+
+	size_t nSpace = pOutput->pEnd - pOutput->pOut;
+	if (nLength > nSpace)
+	{
+		nLength = nSpace;
+	}
+
+	memcpy (pOutput->pOut, pString, nLength);
+	pOutput->pOut += nLength;
+}
@@ -0,0 +1,520 @@
+//
+// blockrequestqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/fs/blockrequestqueue.h>
+#include <circle/fs/fsdef.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CBlockRequestQueue::CBlockRequestQueue (CDevice *pDevice)
+:	m_pDevice (pDevice),
+	m_pFree (0),
+	m_pQueue (0),
+	m_nPending (0),
+	m_nSequence (0),
+	m_nMerged (0),
+	m_ullHeadSector (0),
+	m_pMergeBuffer (0),
+	m_bMergeBufferBusy (FALSE),
+	m_IdleEvent (TRUE)
+{
+	assert (m_pDevice != 0);
+
+	for (unsigned i = 0; i < BLOCK_QUEUE_DEPTH; i++)
+	{
+		m_Request[i].pNext = m_pFree;
+		m_pFree = &m_Request[i];
+	}
+
+	for (unsigned i = 0; i < BLOCK_QUEUE_MAX_ACTIVE; i++)
+	{
+		m_Dispatch[i].pThis = this;
+		m_Dispatch[i].bActive = FALSE;
+	}
+
+	m_pMergeBuffer = new (HEAP_DMA30) u8[BLOCK_QUEUE_MAX_MERGE * FS_BLOCK_SIZE];
+	assert (m_pMergeBuffer != 0);
+
+	SetName ("blockio");
+}
+
+CBlockRequestQueue::~CBlockRequestQueue (void)
+{
+	assert (m_nPending == 0);
+
+	delete [] m_pMergeBuffer;
+	m_pMergeBuffer = 0;
+
+	m_pDevice = 0;
+}
+
+void CBlockRequestQueue::Run (void)
+{
+	while (1)
+	{
+		// cleared before checking, because completions are signaled from IRQ
+		m_Event.Clear ();
+
+		for (unsigned i = 0; i < BLOCK_QUEUE_MAX_ACTIVE; i++)
+		{
+			if (   m_Dispatch[i].bActive
+			    && m_Dispatch[i].bDone)
+			{
+				Complete (&m_Dispatch[i]);
+			}
+		}
+
+		TDispatch *pDispatch = GetIdleDispatch ();
+		if (pDispatch != 0)
+		{
+			TRequest *pRequest = SelectRequest ();
+			if (pRequest != 0)
+			{
+				Dispatch (pRequest, pDispatch);
+
+				continue;
+			}
+		}
+
+		if (m_nPending == 0)
+		{
+			m_IdleEvent.Set ();
+		}
+
+		m_Event.Wait ();
+	}
+}
+
+boolean CBlockRequestQueue::SubmitRead (void *pBuffer, u64 ullSector, unsigned nSectors,
+					TBlockRequestCompletionHandler *pHandler, void *pParam)
+{
+	return Submit (FALSE, pBuffer, ullSector, nSectors, pHandler, pParam);
+}
+
+boolean CBlockRequestQueue::SubmitWrite (const void *pBuffer, u64 ullSector, unsigned nSectors,
+					 TBlockRequestCompletionHandler *pHandler, void *pParam)
+{
+	return Submit (TRUE, (void *) pBuffer, ullSector, nSectors, pHandler, pParam);
+}
+
+int CBlockRequestQueue::Read (void *pBuffer, u64 ullSector, unsigned nSectors)
+{
+	TSyncRequest Request;
+	while (!Submit (FALSE, pBuffer, ullSector, nSectors, SyncCompletionHandler, &Request))
+	{
+		m_IdleEvent.Wait ();
+	}
+
+	Request.Event.Wait ();
+
+	return Request.nResult;
+}
+
+int CBlockRequestQueue::Write (const void *pBuffer, u64 ullSector, unsigned nSectors)
+{
+	TSyncRequest Request;
+	while (!Submit (TRUE, (void *) pBuffer, ullSector, nSectors, SyncCompletionHandler, &Request))
+	{
+		m_IdleEvent.Wait ();
+	}
+
+	Request.Event.Wait ();
+
+	return Request.nResult;
+}
+
+void CBlockRequestQueue::Flush (void)
+{
+	while (m_nPending > 0)
+	{
+		m_IdleEvent.Wait ();
+	}
+
+	assert (m_pDevice != 0);
+	m_pDevice->IOCtl (DEVICE_IOCTL_SYNC, 0);
+}
+
+unsigned CBlockRequestQueue::GetPending (void) const
+{
+	return m_nPending;
+}
+
+unsigned CBlockRequestQueue::GetMerged (void) const
+{
+	return m_nMerged;
+}
+
+boolean CBlockRequestQueue::Submit (boolean bWrite, void *pBuffer, u64 ullSector, unsigned nSectors,
+				    TBlockRequestCompletionHandler *pHandler, void *pParam)
+{
+	assert (pBuffer != 0);
+	assert (nSectors > 0);
+	assert (pHandler != 0);
+
+	TRequest *pRequest = m_pFree;
+	if (pRequest == 0)
+	{
+		return FALSE;
+	}
+	m_pFree = pRequest->pNext;
+
+	pRequest->bWrite = bWrite;
+	pRequest->pBuffer = (u8 *) pBuffer;
+	pRequest->ullSector = ullSector;
+	pRequest->nSectors = nSectors;
+	pRequest->pHandler = pHandler;
+	pRequest->pParam = pParam;
+	pRequest->nDeadline =   CTimer::GetClockTicks ()
+			      + (bWrite ? BLOCK_QUEUE_WRITE_DEADLINE : BLOCK_QUEUE_READ_DEADLINE)
+				* (CLOCKHZ / 1000);
+	pRequest->nSequence = m_nSequence++;
+
+	// insert sorted by sector, behind requests for the same sector
+	TRequest **ppPrev = &m_pQueue;
+	while (   *ppPrev != 0
+	       && (*ppPrev)->ullSector <= ullSector)
+	{
+		ppPrev = &(*ppPrev)->pNext;
+	}
+	pRequest->pNext = *ppPrev;
+	*ppPrev = pRequest;
+
+	if (m_nPending++ == 0)
+	{
+		m_IdleEvent.Clear ();
+	}
+
+	m_Event.Set ();
+
+	return TRUE;
+}
+
+CBlockRequestQueue::TRequest *CBlockRequestQueue::SelectRequest (void)
+{
+	// serve the request with the earliest expired deadline first
+	unsigned nTicks = CTimer::GetClockTicks ();
+	TRequest *pExpired = 0;
+	TRequest *pRequest;
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (   (int) (nTicks - pRequest->nDeadline) >= 0
+		    && (   pExpired == 0
+			|| (int) (pRequest->nDeadline - pExpired->nDeadline) < 0)
+		    && !IsBlocked (pRequest))
+		{
+			pExpired = pRequest;
+		}
+	}
+
+	if (pExpired != 0)
+	{
+		return pExpired;
+	}
+
+	// otherwise continue in ascending sector order (C-LOOK)
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (   pRequest->ullSector >= m_ullHeadSector
+		    && !IsBlocked (pRequest))
+		{
+			return pRequest;
+		}
+	}
+
+	for (pRequest = m_pQueue; pRequest != 0; pRequest = pRequest->pNext)
+	{
+		if (!IsBlocked (pRequest))
+		{
+			return pRequest;
+		}
+	}
+
+	// all requests wait for active transfers
+	return 0;
+}
+
+boolean CBlockRequestQueue::IsBlocked (const TRequest *pRequest) const
+{
+	assert (pRequest != 0);
+
+	for (const TRequest *p = m_pQueue; p != 0; p = p->pNext)
+	{
+		if (   (int) (p->nSequence - pRequest->nSequence) < 0
+		    && (p->bWrite || pRequest->bWrite)
+		    && p->ullSector < pRequest->ullSector + pRequest->nSectors
+		    && pRequest->ullSector < p->ullSector + p->nSectors)
+		{
+			return TRUE;
+		}
+	}
+
+	for (unsigned i = 0; i < BLOCK_QUEUE_MAX_ACTIVE; i++)
+	{
+		if (!m_Dispatch[i].bActive)
+		{
+			continue;
+		}
+
+		for (const TRequest *p = m_Dispatch[i].pChain; p != 0; p = p->pNext)
+		{
+			if (   (p->bWrite || pRequest->bWrite)
+			    && p->ullSector < pRequest->ullSector + pRequest->nSectors
+			    && pRequest->ullSector < p->ullSector + p->nSectors)
+			{
+				return TRUE;
+			}
+		}
+	}
+
+	return FALSE;
+}
+
+CBlockRequestQueue::TDispatch *CBlockRequestQueue::GetIdleDispatch (void)
+{
+	for (unsigned i = 0; i < BLOCK_QUEUE_MAX_ACTIVE; i++)
+	{
+		if (!m_Dispatch[i].bActive)
+		{
+			return &m_Dispatch[i];
+		}
+	}
+
+	return 0;
+}
+
+void CBlockRequestQueue::Dispatch (TRequest *pFirst, TDispatch *pDispatch)
+{
+	assert (pFirst != 0);
+	assert (pDispatch != 0);
+	assert (!pDispatch->bActive);
+
+	// collect adjacent requests of the same direction
+	TRequest *Chain[BLOCK_QUEUE_DEPTH];
+	unsigned nChain = 0;
+	Chain[nChain++] = pFirst;
+
+	unsigned nSectors = pFirst->nSectors;
+	boolean bContiguous = TRUE;
+
+	TRequest *pLast = pFirst;
+	for (TRequest *pNext = pFirst->pNext; pNext != 0; pNext = pNext->pNext)
+	{
+		if (pNext->ullSector != pLast->ullSector + pLast->nSectors)
+		{
+			if (pNext->ullSector < pLast->ullSector + pLast->nSectors)
+			{
+				continue;	// same start sector, look further
+			}
+
+			break;
+		}
+
+		if (   pNext->bWrite != pFirst->bWrite
+		    || nSectors + pNext->nSectors > BLOCK_QUEUE_MAX_MERGE
+		    || IsBlocked (pNext))
+		{
+			break;
+		}
+
+		if (pNext->pBuffer != pLast->pBuffer + pLast->nSectors * FS_BLOCK_SIZE)
+		{
+			if (m_bMergeBufferBusy)
+			{
+				break;		// used by another active transfer
+			}
+
+			bContiguous = FALSE;
+		}
+
+		Chain[nChain++] = pNext;
+		nSectors += pNext->nSectors;
+		pLast = pNext;
+	}
+
+	for (unsigned i = 0; i < nChain; i++)
+	{
+		Unlink (Chain[i]);
+
+		Chain[i]->pNext = i+1 < nChain ? Chain[i+1] : 0;
+	}
+
+	m_nMerged += nChain - 1;
+
+	assert (bContiguous || nSectors <= BLOCK_QUEUE_MAX_MERGE);
+	u8 *pBuffer = bContiguous ? pFirst->pBuffer : m_pMergeBuffer;
+	size_t nBytes = (size_t) nSectors * FS_BLOCK_SIZE;
+
+	if (!bContiguous)
+	{
+		assert (!m_bMergeBufferBusy);
+		m_bMergeBufferBusy = TRUE;
+
+		if (pFirst->bWrite)
+		{
+			u8 *p = m_pMergeBuffer;
+			for (unsigned i = 0; i < nChain; i++)
+			{
+				memcpy (p, Chain[i]->pBuffer, Chain[i]->nSectors * FS_BLOCK_SIZE);
+				p += Chain[i]->nSectors * FS_BLOCK_SIZE;
+			}
+		}
+	}
+
+	m_ullHeadSector = pFirst->ullSector + nSectors;
+
+	pDispatch->pChain = pFirst;
+	pDispatch->pBuffer = pBuffer;
+	pDispatch->nBytes = nBytes;
+	pDispatch->bMergeBuffer = !bContiguous;
+	pDispatch->bDone = FALSE;
+	pDispatch->bActive = TRUE;
+
+	// queue the transfer, if the device supports it
+	TDeviceBlockRequest Request;
+	Request.bWrite = pFirst->bWrite;
+	Request.pBuffer = pBuffer;
+	Request.ullOffset = pFirst->ullSector << FS_BLOCK_SHIFT;
+	Request.nCount = nBytes;
+	Request.pCompletionRoutine = DeviceCompletionRoutine;
+	Request.pParam = pDispatch;
+
+	assert (m_pDevice != 0);
+	if (m_pDevice->IOCtl (DEVICE_IOCTL_SUBMIT, &Request) == 0)
+	{
+		pDispatch->bQueued = TRUE;
+
+		return;
+	}
+
+	// otherwise transfer synchronously
+	pDispatch->bQueued = FALSE;
+	pDispatch->nResult = TransferSync (pDispatch);
+	pDispatch->bDone = TRUE;
+}
+
+int CBlockRequestQueue::TransferSync (TDispatch *pDispatch)
+{
+	assert (pDispatch != 0);
+	TRequest *pFirst = pDispatch->pChain;
+	assert (pFirst != 0);
+
+	u64 ullOffset = pFirst->ullSector << FS_BLOCK_SHIFT;
+
+	assert (m_pDevice != 0);
+	if (m_pDevice->Seek (ullOffset) != ullOffset)
+	{
+		return -1;
+	}
+
+	return pFirst->bWrite ? m_pDevice->Write (pDispatch->pBuffer, pDispatch->nBytes)
+			      : m_pDevice->Read (pDispatch->pBuffer, pDispatch->nBytes);
+}
+
+void CBlockRequestQueue::Complete (TDispatch *pDispatch)
+{
+	assert (pDispatch != 0);
+	assert (pDispatch->bActive);
+	assert (pDispatch->bDone);
+
+	DataMemBarrier ();
+
+	boolean bOK = pDispatch->nResult == (int) pDispatch->nBytes;
+	if (   !bOK
+	    && pDispatch->bQueued)
+	{
+		// the driver does its error recovery for synchronous transfers only
+		bOK = TransferSync (pDispatch) == (int) pDispatch->nBytes;
+	}
+
+	// complete the requests in ascending sector order
+	u8 *p = m_pMergeBuffer;
+	TRequest *pRequest = pDispatch->pChain;
+	while (pRequest != 0)
+	{
+		TRequest *pNext = pRequest->pNext;
+		size_t nLength = pRequest->nSectors * FS_BLOCK_SIZE;
+
+		if (   bOK
+		    && pDispatch->bMergeBuffer
+		    && !pRequest->bWrite)
+		{
+			memcpy (pRequest->pBuffer, p, nLength);
+		}
+		p += nLength;
+
+		TBlockRequestCompletionHandler *pHandler = pRequest->pHandler;
+		void *pParam = pRequest->pParam;
+
+		pRequest->pNext = m_pFree;
+		m_pFree = pRequest;
+
+		assert (m_nPending > 0);
+		m_nPending--;
+
+		assert (pHandler != 0);
+		(*pHandler) (bOK ? (int) nLength : -1, pParam);
+
+		pRequest = pNext;
+	}
+
+	if (pDispatch->bMergeBuffer)
+	{
+		m_bMergeBufferBusy = FALSE;
+	}
+
+	pDispatch->pChain = 0;
+	pDispatch->bActive = FALSE;
+}
+
+void CBlockRequestQueue::Unlink (TRequest *pRequest)
+{
+	TRequest **ppPrev = &m_pQueue;
+	while (*ppPrev != pRequest)
+	{
+		assert (*ppPrev != 0);
+		ppPrev = &(*ppPrev)->pNext;
+	}
+
+	*ppPrev = pRequest->pNext;
+}
+
+void CBlockRequestQueue::SyncCompletionHandler (int nResult, void *pParam)
+{
+	TSyncRequest *pRequest = (TSyncRequest *) pParam;
+	assert (pRequest != 0);
+
+	pRequest->nResult = nResult;
+	pRequest->Event.Set ();
+}
+
+void CBlockRequestQueue::DeviceCompletionRoutine (int nResult, void *pParam)
+{
+	TDispatch *pDispatch = (TDispatch *) pParam;
+	assert (pDispatch != 0);
+	assert (pDispatch->bActive);
+
+	pDispatch->nResult = nResult;
+	DataMemBarrier ();
+	pDispatch->bDone = TRUE;
+
+	pDispatch->pThis->m_Event.Set ();
+}
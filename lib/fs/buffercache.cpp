@@ -0,0 +1,967 @@
+//
+// buffercache.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/fs/buffercache.h>
+#include <circle/logger.h>
+#include <circle/metrics.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/scheduler.h>
+#endif
+
+LOGMODULE ("bcache");
+
+static CMetricCounter s_CacheHits ("circle_buffer_cache_requests_total",
+				   "Block requests to the buffer cache", "result=\"hit\"");
+static CMetricCounter s_CacheMisses ("circle_buffer_cache_requests_total",
+				     "Block requests to the buffer cache", "result=\"miss\"");
+
+CBufferCache *CBufferCache::s_pThis = 0;
+
+CBufferCache::CBufferCache (unsigned nBlocks)
+:	m_nBlocks (nBlocks),
+	m_pBlocks (0),
+	m_pData (0),
+	m_nClockHand (0),
+	m_ppHashTable (0),
+	m_nHashMask (0),
+	m_pReadBuffer (0),
+	m_pWriteBuffer (0),
+	m_nHits (0),
+	m_nMisses (0),
+#ifdef NO_BUSY_WAIT
+	m_pFlusher (0)
+#else
+	m_nLastFlushTicks (0)
+#endif
+{
+	assert (s_pThis == 0);
+
+	for (unsigned i = 0; i < BUFFER_CACHE_MAX_DEVICES; i++)
+	{
+		m_Device[i].pDevice = 0;
+	}
+}
+
+CBufferCache::~CBufferCache (void)
+{
+#ifdef NO_BUSY_WAIT
+	if (m_pFlusher != 0)
+	{
+		m_pFlusher->Stop ();
+		m_pFlusher = 0;
+	}
+#endif
+
+	if (s_pThis == this)
+	{
+		Flush ();
+
+		s_pThis = 0;
+	}
+
+	for (unsigned i = 0; i < BUFFER_CACHE_MAX_DEVICES; i++)
+	{
+		if (m_Device[i].pDevice != 0)
+		{
+			m_Device[i].pDevice->UnregisterRemovedHandler (m_Device[i].hRemoved);
+			m_Device[i].pDevice = 0;
+		}
+	}
+
+	delete [] m_pWriteBuffer;
+	delete [] m_pReadBuffer;
+	delete [] m_ppHashTable;
+	delete [] m_pData;
+	delete [] m_pBlocks;
+}
+
+boolean CBufferCache::Initialize (void)
+{
+	assert (s_pThis == 0);
+
+	// keep room for read-ahead, without evicting the whole cache
+	if (m_nBlocks < 4 * BUFFER_CACHE_MAX_READ_AHEAD)
+	{
+		m_nBlocks = 4 * BUFFER_CACHE_MAX_READ_AHEAD;
+	}
+
+	unsigned nHashSize = 1;
+	while (nHashSize < m_nBlocks)
+	{
+		nHashSize <<= 1;
+	}
+	m_nHashMask = nHashSize-1;
+
+	m_pBlocks = new TBlock[m_nBlocks];
+	m_pData = new (HEAP_DMA30) u8[(size_t) m_nBlocks * BUFFER_CACHE_BLOCK_SIZE];
+	m_ppHashTable = new TBlock *[nHashSize];
+	m_pReadBuffer =
+		new (HEAP_DMA30) u8[BUFFER_CACHE_MAX_READ_AHEAD * BUFFER_CACHE_BLOCK_SIZE];
+	m_pWriteBuffer =
+		new (HEAP_DMA30) u8[BUFFER_CACHE_MAX_READ_AHEAD * BUFFER_CACHE_BLOCK_SIZE];
+	if (   m_pBlocks == 0
+	    || m_pData == 0
+	    || m_ppHashTable == 0
+	    || m_pReadBuffer == 0
+	    || m_pWriteBuffer == 0)
+	{
+		LOGERR ("Cannot allocate %u blocks", m_nBlocks);
+
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < nHashSize; i++)
+	{
+		m_ppHashTable[i] = 0;
+	}
+
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		TBlock *pBlock = &m_pBlocks[i];
+
+		pBlock->pDevice = 0;
+		pBlock->pHashNext = 0;
+		pBlock->bDirty = FALSE;
+		pBlock->bReferenced = FALSE;
+		pBlock->bBusy = FALSE;
+		pBlock->pData = m_pData + (size_t) i * BUFFER_CACHE_BLOCK_SIZE;
+	}
+
+#ifdef NO_BUSY_WAIT
+	assert (m_pFlusher == 0);
+	m_pFlusher = new CBufferCacheFlusher (this);
+	assert (m_pFlusher != 0);
+#else
+	m_nLastFlushTicks = CTimer::Get ()->GetTicks ();
+#endif
+
+	s_pThis = this;
+
+	LOGNOTE ("%u KByte buffer cache", m_nBlocks * (BUFFER_CACHE_BLOCK_SIZE / 1024));
+
+	return TRUE;
+}
+
+int CBufferCache::Read (CDevice *pDevice, u64 ullOffset, void *pBuffer, size_t nCount)
+{
+	assert (pDevice != 0);
+	assert (pBuffer != 0);
+
+	CheckFlush ();
+
+	m_Lock.Acquire ();
+
+	TDevice *pDev = GetDevice (pDevice, TRUE);
+	if (pDev == 0)
+	{
+		m_Lock.Release ();
+
+		// too many devices, not cached
+		if (pDevice->Seek (ullOffset) != ullOffset)
+		{
+			return -1;
+		}
+
+		return pDevice->Read (pBuffer, nCount);
+	}
+
+	u8 *pBuffer8 = (u8 *) pBuffer;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullBlock = ullOffset >> BUFFER_CACHE_BLOCK_SHIFT;
+		unsigned nBlockOffset = (unsigned) (ullOffset & BUFFER_CACHE_BLOCK_MASK);
+
+		// incomplete block at the end of the device is not cached
+		if (ullBlock >= pDev->ullBlocks)
+		{
+			if (Transfer (pDev, FALSE, ullOffset, pBuffer8, nRemaining) < 0)
+			{
+				m_Lock.Release ();
+
+				return -1;
+			}
+
+			break;
+		}
+
+		// large transfers would evict the whole cache
+		if (   nBlockOffset == 0
+		    && nRemaining >= BUFFER_CACHE_BYPASS_SIZE)
+		{
+			u64 ullBlocks = nRemaining >> BUFFER_CACHE_BLOCK_SHIFT;
+			if (ullBlocks > pDev->ullBlocks - ullBlock)
+			{
+				ullBlocks = pDev->ullBlocks - ullBlock;
+			}
+
+			size_t nBytes = (size_t) ullBlocks << BUFFER_CACHE_BLOCK_SHIFT;
+
+			// the device must have the current data
+			if (   !WriteBackRange (pDev, ullBlock, ullBlocks)
+			    || Transfer (pDev, FALSE, ullOffset, pBuffer8, nBytes) < 0)
+			{
+				m_Lock.Release ();
+
+				return -1;
+			}
+
+			pDev->ullNextBlock = ullBlock + ullBlocks;
+
+			pBuffer8 += nBytes;
+			ullOffset += nBytes;
+			nRemaining -= nBytes;
+
+			continue;
+		}
+
+		TBlock *pBlock = GetBlock (pDev, ullBlock, TRUE);
+		if (pBlock == 0)
+		{
+			m_Lock.Release ();
+
+			return -1;
+		}
+
+		size_t nBytes = BUFFER_CACHE_BLOCK_SIZE - nBlockOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		memcpy (pBuffer8, pBlock->pData + nBlockOffset, nBytes);
+
+		pBuffer8 += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	m_Lock.Release ();
+
+	return (int) nCount;
+}
+
+int CBufferCache::Write (CDevice *pDevice, u64 ullOffset, const void *pBuffer, size_t nCount)
+{
+	assert (pDevice != 0);
+	assert (pBuffer != 0);
+
+	CheckFlush ();
+
+	m_Lock.Acquire ();
+
+	TDevice *pDev = GetDevice (pDevice, TRUE);
+	if (pDev == 0)
+	{
+		m_Lock.Release ();
+
+		// too many devices, not cached
+		if (pDevice->Seek (ullOffset) != ullOffset)
+		{
+			return -1;
+		}
+
+		return pDevice->Write (pBuffer, nCount);
+	}
+
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		u64 ullBlock = ullOffset >> BUFFER_CACHE_BLOCK_SHIFT;
+		unsigned nBlockOffset = (unsigned) (ullOffset & BUFFER_CACHE_BLOCK_MASK);
+
+		// incomplete block at the end of the device is not cached
+		if (ullBlock >= pDev->ullBlocks)
+		{
+			if (Transfer (pDev, TRUE, ullOffset, (void *) pBuffer8, nRemaining) < 0)
+			{
+				m_Lock.Release ();
+
+				return -1;
+			}
+
+			break;
+		}
+
+		// large transfers would evict the whole cache
+		if (   nBlockOffset == 0
+		    && nRemaining >= BUFFER_CACHE_BYPASS_SIZE)
+		{
+			u64 ullBlocks = nRemaining >> BUFFER_CACHE_BLOCK_SHIFT;
+			if (ullBlocks > pDev->ullBlocks - ullBlock)
+			{
+				ullBlocks = pDev->ullBlocks - ullBlock;
+			}
+
+			size_t nBytes = (size_t) ullBlocks << BUFFER_CACHE_BLOCK_SHIFT;
+
+			if (Transfer (pDev, TRUE, ullOffset, (void *) pBuffer8, nBytes) < 0)
+			{
+				m_Lock.Release ();
+
+				return -1;
+			}
+
+			// cached copies are overwritten
+			DropRange (pDev, ullBlock, ullBlocks);
+
+			pBuffer8 += nBytes;
+			ullOffset += nBytes;
+			nRemaining -= nBytes;
+
+			continue;
+		}
+
+		size_t nBytes = BUFFER_CACHE_BLOCK_SIZE - nBlockOffset;
+		if (nBytes > nRemaining)
+		{
+			nBytes = nRemaining;
+		}
+
+		// a partially written block has to be read first
+		TBlock *pBlock = GetBlock (pDev, ullBlock, nBytes < BUFFER_CACHE_BLOCK_SIZE);
+		if (pBlock == 0)
+		{
+			m_Lock.Release ();
+
+			return -1;
+		}
+
+		memcpy (pBlock->pData + nBlockOffset, pBuffer8, nBytes);
+
+		if (!pBlock->bDirty)
+		{
+			pBlock->bDirty = TRUE;
+			pBlock->nDirtyTicks = CTimer::Get ()->GetTicks ();
+		}
+
+		pBuffer8 += nBytes;
+		ullOffset += nBytes;
+		nRemaining -= nBytes;
+	}
+
+	m_Lock.Release ();
+
+	return (int) nCount;
+}
+
+boolean CBufferCache::Flush (CDevice *pDevice)
+{
+	m_Lock.Acquire ();
+
+	boolean bOK = TRUE;
+
+	if (pDevice == 0)
+	{
+		bOK = WriteBack (0, FALSE);
+	}
+	else
+	{
+		TDevice *pDev = GetDevice (pDevice, FALSE);
+		if (pDev != 0)
+		{
+			bOK = WriteBack (pDev, FALSE);
+		}
+	}
+
+	m_Lock.Release ();
+
+	return bOK;
+}
+
+void CBufferCache::Discard (CDevice *pDevice, u64 ullOffset, u64 ullCount)
+{
+	assert (pDevice != 0);
+
+	m_Lock.Acquire ();
+
+	TDevice *pDev = GetDevice (pDevice, FALSE);
+	if (pDev != 0)
+	{
+		u64 ullFirst = (ullOffset + BUFFER_CACHE_BLOCK_MASK) >> BUFFER_CACHE_BLOCK_SHIFT;
+		u64 ullEnd = (ullOffset + ullCount) >> BUFFER_CACHE_BLOCK_SHIFT;
+
+		if (ullEnd > ullFirst)
+		{
+			DropRange (pDev, ullFirst, ullEnd - ullFirst);
+		}
+	}
+
+	m_Lock.Release ();
+}
+
+void CBufferCache::FlushExpired (void)
+{
+	m_Lock.Acquire ();
+
+	WriteBack (0, TRUE);
+
+	m_Lock.Release ();
+}
+
+u64 CBufferCache::GetHits (void) const
+{
+	return m_nHits;
+}
+
+u64 CBufferCache::GetMisses (void) const
+{
+	return m_nMisses;
+}
+
+CBufferCache *CBufferCache::Get (void)
+{
+	return s_pThis;
+}
+
+CBufferCache::TDevice *CBufferCache::GetDevice (CDevice *pDevice, boolean bCreate)
+{
+	assert (pDevice != 0);
+
+	TDevice *pFree = 0;
+	for (unsigned i = 0; i < BUFFER_CACHE_MAX_DEVICES; i++)
+	{
+		if (m_Device[i].pDevice == pDevice)
+		{
+			return &m_Device[i];
+		}
+
+		if (   pFree == 0
+		    && m_Device[i].pDevice == 0)
+		{
+			pFree = &m_Device[i];
+		}
+	}
+
+	if (   !bCreate
+	    || pFree == 0)
+	{
+		return 0;
+	}
+
+	u64 ullSize = pDevice->GetSize ();
+	if (ullSize == (u64) -1)
+	{
+		return 0;
+	}
+
+	pFree->pDevice = pDevice;
+	pFree->ullBlocks = ullSize >> BUFFER_CACHE_BLOCK_SHIFT;
+	pFree->ullNextBlock = 0;
+	pFree->nReadAhead = 1;
+	pFree->hRemoved = pDevice->RegisterRemovedHandler (DeviceRemovedHandler, this);
+
+	return pFree;
+}
+
+void CBufferCache::DeviceRemovedHandler (CDevice *pDevice, void *pContext)
+{
+	CBufferCache *pThis = (CBufferCache *) pContext;
+	assert (pThis != 0);
+
+	pThis->m_Lock.Acquire ();
+
+	TDevice *pDev = pThis->GetDevice (pDevice, FALSE);
+	if (pDev != 0)
+	{
+		// the data of dirty blocks is lost
+		for (unsigned i = 0; i < pThis->m_nBlocks; i++)
+		{
+			TBlock *pBlock = &pThis->m_pBlocks[i];
+			if (pBlock->pDevice == pDev)
+			{
+				if (pBlock->bDirty)
+				{
+					LOGWARN ("Block %llu lost", pBlock->ullBlock);
+				}
+
+				pThis->ReleaseBlock (pBlock);
+			}
+		}
+
+		pDev->pDevice = 0;		// handler is removed by the caller
+	}
+
+	pThis->m_Lock.Release ();
+}
+
+CBufferCache::TBlock *CBufferCache::GetBlock (TDevice *pDevice, u64 ullBlock, boolean bRead)
+{
+	assert (pDevice != 0);
+	assert (ullBlock < pDevice->ullBlocks);
+
+	TBlock *pBlock = Lookup (pDevice, ullBlock);
+	if (pBlock != 0)
+	{
+		pBlock->bReferenced = TRUE;
+
+		if (bRead)
+		{
+			pDevice->ullNextBlock = ullBlock + 1;
+		}
+
+		m_nHits++;
+		s_CacheHits.Increment ();
+
+		return pBlock;
+	}
+
+	m_nMisses++;
+	s_CacheMisses.Increment ();
+
+	unsigned nBlocks = bRead ? GetReadAhead (pDevice, ullBlock) : 1;
+
+	pBlock = AllocateBlock ();
+	if (pBlock == 0)
+	{
+		LOGERR ("No free block");
+
+		return 0;
+	}
+
+	pBlock->pDevice = pDevice;
+	pBlock->ullBlock = ullBlock;
+	pBlock->bDirty = FALSE;
+	pBlock->bReferenced = TRUE;
+	HashInsert (pBlock);
+
+	if (!bRead)
+	{
+		return pBlock;
+	}
+
+	pDevice->ullNextBlock = ullBlock + 1;
+
+	u64 ullOffset = ullBlock << BUFFER_CACHE_BLOCK_SHIFT;
+
+	if (nBlocks > 1)
+	{
+		if (Transfer (pDevice, FALSE, ullOffset, m_pReadBuffer,
+			      nBlocks * BUFFER_CACHE_BLOCK_SIZE) < 0)
+		{
+			nBlocks = 1;		// try the requested block alone
+		}
+		else
+		{
+			memcpy (pBlock->pData, m_pReadBuffer, BUFFER_CACHE_BLOCK_SIZE);
+
+			// allocating may evict, the requested block must be kept
+			pBlock->bBusy = TRUE;
+
+			unsigned i;
+			for (i = 1; i < nBlocks; i++)
+			{
+				TBlock *pAhead = AllocateBlock ();
+				if (pAhead == 0)
+				{
+					break;
+				}
+
+				pAhead->pDevice = pDevice;
+				pAhead->ullBlock = ullBlock + i;
+				pAhead->bDirty = FALSE;
+				pAhead->bReferenced = FALSE;	// evict first, if it is not used
+				HashInsert (pAhead);
+
+				memcpy (pAhead->pData, m_pReadBuffer + i * BUFFER_CACHE_BLOCK_SIZE,
+					BUFFER_CACHE_BLOCK_SIZE);
+			}
+
+			pBlock->bBusy = FALSE;
+
+			pDevice->ullNextBlock = ullBlock + i;
+
+			return pBlock;
+		}
+	}
+
+	if (Transfer (pDevice, FALSE, ullOffset, pBlock->pData, BUFFER_CACHE_BLOCK_SIZE) < 0)
+	{
+		ReleaseBlock (pBlock);
+
+		return 0;
+	}
+
+	return pBlock;
+}
+
+unsigned CBufferCache::GetReadAhead (TDevice *pDevice, u64 ullBlock)
+{
+	assert (pDevice != 0);
+
+	// the window grows, while the device is read sequentially
+	if (ullBlock == pDevice->ullNextBlock)
+	{
+		pDevice->nReadAhead *= 2;
+		if (pDevice->nReadAhead > BUFFER_CACHE_MAX_READ_AHEAD)
+		{
+			pDevice->nReadAhead = BUFFER_CACHE_MAX_READ_AHEAD;
+		}
+	}
+	else
+	{
+		pDevice->nReadAhead = 1;
+	}
+
+	unsigned nBlocks = pDevice->nReadAhead;
+	if (nBlocks > pDevice->ullBlocks - ullBlock)
+	{
+		nBlocks = (unsigned) (pDevice->ullBlocks - ullBlock);
+	}
+
+	// stop before the first block, which is already cached
+	for (unsigned i = 1; i < nBlocks; i++)
+	{
+		if (Lookup (pDevice, ullBlock + i) != 0)
+		{
+			return i;
+		}
+	}
+
+	return nBlocks;
+}
+
+CBufferCache::TBlock *CBufferCache::AllocateBlock (void)
+{
+	// two rounds clear all reference bits, the third one finds dirty blocks written
+	for (unsigned n = 0; n < 3 * m_nBlocks; n++)
+	{
+		TBlock *pBlock = &m_pBlocks[m_nClockHand];
+
+		if (++m_nClockHand == m_nBlocks)
+		{
+			m_nClockHand = 0;
+		}
+
+		if (pBlock->pDevice == 0)
+		{
+			return pBlock;
+		}
+
+		if (pBlock->bBusy)
+		{
+			continue;
+		}
+
+		if (pBlock->bReferenced)
+		{
+			pBlock->bReferenced = FALSE;
+
+			continue;
+		}
+
+		if (   pBlock->bDirty
+		    && !WriteRun (pBlock))
+		{
+			continue;		// keep it, may succeed later
+		}
+
+		ReleaseBlock (pBlock);
+
+		return pBlock;
+	}
+
+	return 0;
+}
+
+void CBufferCache::ReleaseBlock (TBlock *pBlock)
+{
+	assert (pBlock != 0);
+	assert (pBlock->pDevice != 0);
+
+	HashRemove (pBlock);
+
+	pBlock->pDevice = 0;
+	pBlock->bDirty = FALSE;
+	pBlock->bReferenced = FALSE;
+	pBlock->bBusy = FALSE;
+}
+
+CBufferCache::TBlock *CBufferCache::Lookup (TDevice *pDevice, u64 ullBlock) const
+{
+	assert (m_ppHashTable != 0);
+
+	for (TBlock *pBlock = m_ppHashTable[Hash (pDevice, ullBlock)];
+	     pBlock != 0;
+	     pBlock = pBlock->pHashNext)
+	{
+		if (   pBlock->pDevice == pDevice
+		    && pBlock->ullBlock == ullBlock)
+		{
+			return pBlock;
+		}
+	}
+
+	return 0;
+}
+
+void CBufferCache::HashInsert (TBlock *pBlock)
+{
+	assert (pBlock != 0);
+	assert (m_ppHashTable != 0);
+
+	unsigned nHash = Hash (pBlock->pDevice, pBlock->ullBlock);
+
+	pBlock->pHashNext = m_ppHashTable[nHash];
+	m_ppHashTable[nHash] = pBlock;
+}
+
+void CBufferCache::HashRemove (TBlock *pBlock)
+{
+	assert (pBlock != 0);
+	assert (m_ppHashTable != 0);
+
+	TBlock **ppBlock = &m_ppHashTable[Hash (pBlock->pDevice, pBlock->ullBlock)];
+	while (*ppBlock != 0)
+	{
+		if (*ppBlock == pBlock)
+		{
+			*ppBlock = pBlock->pHashNext;
+			pBlock->pHashNext = 0;
+
+			return;
+		}
+
+		ppBlock = &(*ppBlock)->pHashNext;
+	}
+
+	assert (0);
+}
+
+unsigned CBufferCache::Hash (TDevice *pDevice, u64 ullBlock) const
+{
+	unsigned nDevice = (unsigned) (pDevice - m_Device);
+
+	return ((unsigned) ullBlock ^ (unsigned) (ullBlock >> 32) ^ (nDevice << 7)) & m_nHashMask;
+}
+
+boolean CBufferCache::WriteBack (TDevice *pDevice, boolean bExpiredOnly)
+{
+	boolean bOK = TRUE;
+
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	for (unsigned i = 0; i < m_nBlocks; i++)
+	{
+		TBlock *pBlock = &m_pBlocks[i];
+
+		if (   pBlock->pDevice == 0
+		    || !pBlock->bDirty
+		    || (pDevice != 0 && pBlock->pDevice != pDevice)
+		    || (   bExpiredOnly
+			&& nTicks - pBlock->nDirtyTicks < BUFFER_CACHE_WRITEBACK_DELAY * HZ))
+		{
+			continue;
+		}
+
+		if (!WriteRun (pBlock))
+		{
+			bOK = FALSE;
+		}
+	}
+
+	return bOK;
+}
+
+boolean CBufferCache::WriteBackRange (TDevice *pDevice, u64 ullBlock, u64 ullBlocks)
+{
+	assert (pDevice != 0);
+
+	boolean bOK = TRUE;
+
+	for (u64 i = 0; i < ullBlocks; i++)
+	{
+		TBlock *pBlock = Lookup (pDevice, ullBlock + i);
+		if (   pBlock != 0
+		    && pBlock->bDirty
+		    && !WriteRun (pBlock))
+		{
+			bOK = FALSE;
+		}
+	}
+
+	return bOK;
+}
+
+boolean CBufferCache::WriteRun (TBlock *pBlock)
+{
+	assert (pBlock != 0);
+	assert (pBlock->bDirty);
+
+	TDevice *pDevice = pBlock->pDevice;
+	assert (pDevice != 0);
+
+	// find the start of the run of dirty blocks, where this block belongs to
+	TBlock *pFirst = pBlock;
+	for (unsigned i = 1; i < BUFFER_CACHE_MAX_READ_AHEAD && pFirst->ullBlock > 0; i++)
+	{
+		TBlock *pPrev = Lookup (pDevice, pFirst->ullBlock - 1);
+		if (   pPrev == 0
+		    || !pPrev->bDirty)
+		{
+			break;
+		}
+
+		pFirst = pPrev;
+	}
+
+	TBlock *Run[BUFFER_CACHE_MAX_READ_AHEAD];
+	unsigned nRun = 0;
+	Run[nRun++] = pFirst;
+
+	while (nRun < BUFFER_CACHE_MAX_READ_AHEAD)
+	{
+		TBlock *pNext = Lookup (pDevice, pFirst->ullBlock + nRun);
+		if (   pNext == 0
+		    || !pNext->bDirty)
+		{
+			break;
+		}
+
+		Run[nRun++] = pNext;
+	}
+
+	u8 *pBuffer = pFirst->pData;
+	if (nRun > 1)
+	{
+		pBuffer = m_pWriteBuffer;
+
+		for (unsigned i = 0; i < nRun; i++)
+		{
+			memcpy (pBuffer + i * BUFFER_CACHE_BLOCK_SIZE, Run[i]->pData,
+				BUFFER_CACHE_BLOCK_SIZE);
+		}
+	}
+
+	if (Transfer (pDevice, TRUE, pFirst->ullBlock << BUFFER_CACHE_BLOCK_SHIFT, pBuffer,
+		      nRun * BUFFER_CACHE_BLOCK_SIZE) < 0)
+	{
+		LOGERR ("Write error (block %llu)", pFirst->ullBlock);
+
+		return FALSE;
+	}
+
+	for (unsigned i = 0; i < nRun; i++)
+	{
+		Run[i]->bDirty = FALSE;
+	}
+
+	return TRUE;
+}
+
+void CBufferCache::DropRange (TDevice *pDevice, u64 ullBlock, u64 ullBlocks)
+{
+	assert (pDevice != 0);
+
+	if (ullBlocks > m_nBlocks)
+	{
+		for (unsigned i = 0; i < m_nBlocks; i++)
+		{
+			TBlock *pBlock = &m_pBlocks[i];
+			if (   pBlock->pDevice == pDevice
+			    && pBlock->ullBlock >= ullBlock
+			    && pBlock->ullBlock - ullBlock < ullBlocks
+			    && !pBlock->bBusy)
+			{
+				ReleaseBlock (pBlock);
+			}
+		}
+
+		return;
+	}
+
+	for (u64 i = 0; i < ullBlocks; i++)
+	{
+		TBlock *pBlock = Lookup (pDevice, ullBlock + i);
+		if (   pBlock != 0
+		    && !pBlock->bBusy)
+		{
+			ReleaseBlock (pBlock);
+		}
+	}
+}
+
+int CBufferCache::Transfer (TDevice *pDevice, boolean bWrite, u64 ullOffset, void *pBuffer,
+			    size_t nCount)
+{
+	assert (pDevice != 0);
+	assert (pDevice->pDevice != 0);
+
+	if (pDevice->pDevice->Seek (ullOffset) != ullOffset)
+	{
+		return -1;
+	}
+
+	int nResult = bWrite ? pDevice->pDevice->Write (pBuffer, nCount)
+			     : pDevice->pDevice->Read (pBuffer, nCount);
+
+	return nResult == (int) nCount ? nResult : -1;
+}
+
+void CBufferCache::CheckFlush (void)
+{
+#ifndef NO_BUSY_WAIT
+	// there is no flusher task without scheduler
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+	if (nTicks - m_nLastFlushTicks >= MSEC2HZ (BUFFER_CACHE_FLUSH_INTERVAL))
+	{
+		m_nLastFlushTicks = nTicks;
+
+		FlushExpired ();
+	}
+#endif
+}
+
+#ifdef NO_BUSY_WAIT
+
+CBufferCacheFlusher::CBufferCacheFlusher (CBufferCache *pCache)
+:	m_pCache (pCache),
+	m_bStop (FALSE)
+{
+	SetName ("bcflush");
+}
+
+void CBufferCacheFlusher::Run (void)
+{
+	while (!m_bStop)
+	{
+		CScheduler::Get ()->MsSleep (BUFFER_CACHE_FLUSH_INTERVAL);
+
+		if (!m_bStop)
+		{
+			assert (m_pCache != 0);
+			m_pCache->FlushExpired ();
+		}
+	}
+}
+
+void CBufferCacheFlusher::Stop (void)
+{
+	m_bStop = TRUE;
+
+	WaitForTermination ();
+}
+
+#endif
@@ -2,7 +2,7 @@
 // fatcache.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,9 +19,16 @@
 //
 #include <circle/fs/fat/fatcache.h>
 #include <circle/logger.h>
+#include <circle/metrics.h>
+#include <circle/timer.h>
+#include <circle/util.h>
 #include <circle/new.h>
 #include <assert.h>
 
+#ifdef NO_BUSY_WAIT
+	#include <circle/sched/scheduler.h>
+#endif
+
 #define BUFFER_MAGIC		0x4641544D
 #define BUFFER_NOSECTOR		0xFFFFFFFF
 
@@ -29,8 +36,25 @@
 #define FAULT_READ_ERROR	0x1502
 #define FAULT_WRITE_ERROR	0x1503
 
+static CMetricCounter s_CacheHits ("circle_fat_cache_requests_total",
+				   "Sector requests to the FAT buffer cache", "result=\"hit\"");
+static CMetricCounter s_CacheMisses ("circle_fat_cache_requests_total",
+				     "Sector requests to the FAT buffer cache", "result=\"miss\"");
+
 CFATCache::CFATCache (void)
-:	m_pPartition (0)
+:	m_pPartition (0),
+	m_nSectors (0),
+	m_pBuffers (0),
+	m_nBuffers (0),
+	m_ppHashTable (0),
+	m_nHashMask (0),
+	m_nReadAhead (1),
+	m_pTransferBuffer (0),
+#ifdef NO_BUSY_WAIT
+	m_pFlusher (0)
+#else
+	m_nLastFlushTicks (0)
+#endif
 {
 	m_BufferList.pFirst = 0;
 	m_BufferList.pLast = 0;
@@ -40,111 +64,360 @@ CFATCache::~CFATCache (void)
 {
 }
 
-int CFATCache::Open (CDevice *pPartition)
+int CFATCache::Open (CDevice *pPartition, unsigned nBuffers)
 {
-	TFATBuffer *pBuffer;
-	TFATBuffer *pPrevBuffer = 0;
-	int i;
-	
+	unsigned i;
+
 	assert (m_pPartition == 0);
 	m_pPartition = pPartition;
 	assert (m_pPartition != 0);
 
-	for (i = 1; i <= FAT_BUFFERS; i++)
+	u64 ullSize = m_pPartition->GetSize ();
+	m_nSectors =   ullSize == (u64) -1 || ullSize / FAT_SECTOR_SIZE > BUFFER_NOSECTOR
+		     ? BUFFER_NOSECTOR : (unsigned) (ullSize / FAT_SECTOR_SIZE);
+
+	assert (nBuffers > 0);
+	m_nBuffers = nBuffers;
+
+	unsigned nHashSize = 1;
+	while (nHashSize < m_nBuffers)
 	{
-		pBuffer = new (HEAP_DMA30) TFATBuffer;
-		if (pBuffer == 0)
-		{
-			return 0;
-		}
+		nHashSize <<= 1;
+	}
+	m_nHashMask = nHashSize-1;
+
+	m_pBuffers = new (HEAP_DMA30) TFATBuffer[m_nBuffers];
+	m_ppHashTable = new TFATBuffer *[nHashSize];
+	m_pTransferBuffer = new (HEAP_DMA30) unsigned char[FAT_MAX_READ_AHEAD * FAT_SECTOR_SIZE];
+	if (   m_pBuffers == 0
+	    || m_ppHashTable == 0
+	    || m_pTransferBuffer == 0)
+	{
+		delete [] m_pTransferBuffer;
+		m_pTransferBuffer = 0;
+
+		delete [] m_ppHashTable;
+		m_ppHashTable = 0;
+
+		delete [] m_pBuffers;
+		m_pBuffers = 0;
+
+		m_pPartition = 0;
+
+		return 0;
+	}
+
+	for (i = 0; i < nHashSize; i++)
+	{
+		m_ppHashTable[i] = 0;
+	}
+
+	for (i = 0; i < m_nBuffers; i++)
+	{
+		TFATBuffer *pBuffer = &m_pBuffers[i];
 
 		pBuffer->nMagic    = BUFFER_MAGIC;
-		pBuffer->pNext     = 0;
-		pBuffer->pPrev     = pPrevBuffer;
+		pBuffer->pNext     = i+1 < m_nBuffers ? &m_pBuffers[i+1] : 0;
+		pBuffer->pPrev     = i > 0 ? &m_pBuffers[i-1] : 0;
+		pBuffer->pHashNext = 0;
 		pBuffer->nSector   = BUFFER_NOSECTOR;
 		pBuffer->nUseCount = 0;
+		pBuffer->bDirty    = 0;
+	}
 
-		if (pPrevBuffer != 0)
-		{
-			pPrevBuffer->pNext = pBuffer;
-		}
+	m_BufferList.pFirst = &m_pBuffers[0];
+	m_BufferList.pLast = &m_pBuffers[m_nBuffers-1];
 
-		pPrevBuffer = pBuffer;
-		
-		if (i == 1)
-		{
-			m_BufferList.pFirst = pBuffer;
-		}
-		else if (i == FAT_BUFFERS)
-		{
-			m_BufferList.pLast = pBuffer;
-		}
-	}
+	m_nReadAhead = 1;
+
+#ifdef NO_BUSY_WAIT
+	assert (m_pFlusher == 0);
+	m_pFlusher = new CFATCacheFlusher (this);
+	assert (m_pFlusher != 0);
+#else
+	m_nLastFlushTicks = CTimer::Get ()->GetTicks ();
+#endif
 
 	return 1;
 }
 
 void CFATCache::Close (void)
 {
-	TFATBuffer *pBuffer;
-	TFATBuffer *pNextBuffer;
+#ifdef NO_BUSY_WAIT
+	if (m_pFlusher != 0)
+	{
+		m_pFlusher->Stop ();
+		m_pFlusher = 0;
+	}
+#endif
+
+	if (m_pBuffers == 0)
+	{
+		return;
+	}
 
 	Flush ();
 
-	for (pBuffer = m_BufferList.pFirst; pBuffer != 0; pBuffer = pNextBuffer)
+	for (unsigned i = 0; i < m_nBuffers; i++)
 	{
-		assert (pBuffer->nMagic == BUFFER_MAGIC);
+		assert (m_pBuffers[i].nMagic == BUFFER_MAGIC);
 
-		pNextBuffer = pBuffer->pNext;
+		m_pBuffers[i].nMagic = 0;
+	}
 
-		pBuffer->nMagic = 0;
+	delete [] m_pTransferBuffer;
+	m_pTransferBuffer = 0;
 
-		delete [] pBuffer;
-	}
+	delete [] m_ppHashTable;
+	m_ppHashTable = 0;
+
+	delete [] m_pBuffers;
+	m_pBuffers = 0;
 
 	m_BufferList.pFirst = 0;
 	m_BufferList.pLast = 0;
+
+	m_pPartition = 0;
+}
+
+void CFATCache::SetReadAhead (unsigned nSectors)
+{
+	if (nSectors > FAT_MAX_READ_AHEAD)
+	{
+		nSectors = FAT_MAX_READ_AHEAD;
+	}
+
+	// keep most of the cache for other sectors
+	if (nSectors > m_nBuffers / 4)
+	{
+		nSectors = m_nBuffers / 4;
+	}
+
+	m_nReadAhead = nSectors > 0 ? nSectors : 1;
 }
 
 void CFATCache::Flush (void)
+{
+	m_BufferListLock.Acquire ();
+
+	WriteBack (0);
+
+	m_BufferListLock.Release ();
+}
+
+void CFATCache::FlushExpired (void)
+{
+	m_BufferListLock.Acquire ();
+
+	WriteBack (1);
+
+	m_BufferListLock.Release ();
+}
+
+TFATBuffer *CFATCache::GetSector (unsigned nSector, int bWriteOnly)
 {
 	TFATBuffer *pBuffer;
 
+	assert (nSector != BUFFER_NOSECTOR);
+
 	m_BufferListLock.Acquire ();
 
-	for (pBuffer = m_BufferList.pFirst; pBuffer != 0; pBuffer = pBuffer->pNext)
+	pBuffer = Lookup (nSector);
+	if (pBuffer != 0)
 	{
-		assert (pBuffer->nMagic == BUFFER_MAGIC);
+		MoveBufferFirst (pBuffer);
 
-		if (pBuffer->nSector != BUFFER_NOSECTOR)
-		{
-			if (pBuffer->bDirty)
-			{
-				m_DiskLock.Acquire ();
+		pBuffer->nUseCount++;
 
-				m_pPartition->Seek (pBuffer->nSector * FAT_SECTOR_SIZE);
-				if (m_pPartition->Write (pBuffer->Data, FAT_SECTOR_SIZE) != FAT_SECTOR_SIZE)
-				{
-					Fault (FAULT_WRITE_ERROR);
-				}
+		m_BufferListLock.Release ();
+
+		s_CacheHits.Increment ();
+
+		return pBuffer;
+	}
+
+	s_CacheMisses.Increment ();
+
+	pBuffer = AllocateBuffer (1);
+	if (pBuffer == 0)
+	{
+		m_BufferListLock.Release ();
+		return 0;
+	}
+
+	assert (pBuffer->nUseCount == 0);
+	pBuffer->nUseCount = 1;
+	assert (pBuffer->nSector == BUFFER_NOSECTOR);
+	pBuffer->nSector = nSector;
+	pBuffer->bDirty = 0;
+	HashInsert (pBuffer);
+
+	if (   !bWriteOnly
+	    && ReadBuffers (pBuffer) == 0)
+	{
+		HashRemove (pBuffer);
+		pBuffer->nUseCount--;
+		pBuffer->nSector = BUFFER_NOSECTOR;
+		MoveBufferLast (pBuffer);
+
+		Fault (FAULT_READ_ERROR);
+		m_BufferListLock.Release ();
+		return 0;
+	}
+
+	MoveBufferFirst (pBuffer);
+
+	m_BufferListLock.Release ();
+
+	return pBuffer;
+}
+
+void CFATCache::FreeSector (TFATBuffer *pBuffer, int bCritical)
+{
+	assert (pBuffer->nMagic == BUFFER_MAGIC);
+	assert (pBuffer->nUseCount > 0);
+	pBuffer->nUseCount--;
+	if (pBuffer->nUseCount > 0)
+	{
+		return;
+	}
 
-				m_DiskLock.Release ();
+	if (bCritical)
+	{
+#if 0
+		if (pBuffer->bDirty)
+		{
+			m_DiskLock.Acquire ();
 
+			m_pPartition->Seek ((u64) pBuffer->nSector * FAT_SECTOR_SIZE);
+			if (m_pPartition->Write (pBuffer->Data, FAT_SECTOR_SIZE) == FAT_SECTOR_SIZE)
+			{
 				pBuffer->bDirty = 0;
 			}
+
+			m_DiskLock.Release ();
+		}
+#endif
+	}
+	else
+	{
+		m_BufferListLock.Acquire ();
+
+		MoveBufferLast (pBuffer);
+
+		m_BufferListLock.Release ();
+	}
+
+#ifndef NO_BUSY_WAIT
+	// there is no flusher task without scheduler
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+	if (nTicks - m_nLastFlushTicks >= MSEC2HZ (FAT_FLUSH_INTERVAL))
+	{
+		m_nLastFlushTicks = nTicks;
+
+		FlushExpired ();
+	}
+#endif
+}
+
+void CFATCache::MarkDirty (TFATBuffer *pBuffer)
+{
+	assert (pBuffer->nMagic == BUFFER_MAGIC);
+	assert (pBuffer->nUseCount > 0);
+
+	if (!pBuffer->bDirty)
+	{
+		pBuffer->nDirtyTicks = CTimer::Get ()->GetTicks ();
+	}
+
+	pBuffer->bDirty = 1;
+}
+
+int CFATCache::ReadDirect (unsigned nSector, unsigned nCount, void *pBuffer)
+{
+	assert (pBuffer != 0);
+	assert (0 < nCount && nCount <= FAT_DIRECT_MAX_RUN);
+
+	m_BufferListLock.Acquire ();
+
+	m_DiskLock.Acquire ();
+
+	m_pPartition->Seek ((u64) nSector * FAT_SECTOR_SIZE);
+	if (   m_pPartition->Read (pBuffer, nCount * FAT_SECTOR_SIZE)
+	    != (int) (nCount * FAT_SECTOR_SIZE))
+	{
+		m_DiskLock.Release ();
+
+		Fault (FAULT_READ_ERROR);
+		m_BufferListLock.Release ();
+		return 0;
+	}
+
+	m_DiskLock.Release ();
+
+	// cached sectors, which are not written yet, are newer than the disk
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		TFATBuffer *pCached = Lookup (nSector + i);
+		if (   pCached != 0
+		    && pCached->bDirty)
+		{
+			memcpy ((unsigned char *) pBuffer + i * FAT_SECTOR_SIZE, pCached->Data,
+				FAT_SECTOR_SIZE);
 		}
 	}
 
 	m_BufferListLock.Release ();
+
+	return 1;
 }
 
-TFATBuffer *CFATCache::GetSector (unsigned nSector, int bWriteOnly)
+int CFATCache::WriteDirect (unsigned nSector, unsigned nCount, const void *pBuffer)
 {
-	TFATBuffer *pBuffer;
+	assert (pBuffer != 0);
+	assert (0 < nCount && nCount <= FAT_DIRECT_MAX_RUN);
 
 	m_BufferListLock.Acquire ();
 
-	for (pBuffer = m_BufferList.pFirst; pBuffer != 0; pBuffer = pBuffer->pNext)
+	m_DiskLock.Acquire ();
+
+	m_pPartition->Seek ((u64) nSector * FAT_SECTOR_SIZE);
+	if (   m_pPartition->Write (pBuffer, nCount * FAT_SECTOR_SIZE)
+	    != (int) (nCount * FAT_SECTOR_SIZE))
+	{
+		m_DiskLock.Release ();
+
+		Fault (FAULT_WRITE_ERROR);
+		m_BufferListLock.Release ();
+		return 0;
+	}
+
+	m_DiskLock.Release ();
+
+	// update cached copies of the written sectors
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		TFATBuffer *pCached = Lookup (nSector + i);
+		if (pCached != 0)
+		{
+			memcpy (pCached->Data, (const unsigned char *) pBuffer + i * FAT_SECTOR_SIZE,
+				FAT_SECTOR_SIZE);
+
+			pCached->bDirty = 0;
+		}
+	}
+
+	m_BufferListLock.Release ();
+
+	return 1;
+}
+
+TFATBuffer *CFATCache::Lookup (unsigned nSector) const
+{
+	assert (m_ppHashTable != 0);
+
+	TFATBuffer *pBuffer;
+	for (pBuffer = m_ppHashTable[nSector & m_nHashMask]; pBuffer != 0; pBuffer = pBuffer->pHashNext)
 	{
 		assert (pBuffer->nMagic == BUFFER_MAGIC);
 
@@ -154,23 +427,50 @@ TFATBuffer *CFATCache::GetSector (unsigned nSector, int bWriteOnly)
 		}
 	}
 
-	if (pBuffer != 0)
-	{
-		MoveBufferFirst (pBuffer);
+	return pBuffer;
+}
 
-		pBuffer->nUseCount++;
+void CFATCache::HashInsert (TFATBuffer *pBuffer)
+{
+	assert (pBuffer->nSector != BUFFER_NOSECTOR);
+	assert (Lookup (pBuffer->nSector) == 0);
 
-		m_BufferListLock.Release ();
+	TFATBuffer **ppBucket = &m_ppHashTable[pBuffer->nSector & m_nHashMask];
+	pBuffer->pHashNext = *ppBucket;
+	*ppBucket = pBuffer;
+}
 
-		return pBuffer;
+void CFATCache::HashRemove (TFATBuffer *pBuffer)
+{
+	assert (pBuffer->nSector != BUFFER_NOSECTOR);
+
+	TFATBuffer **ppBuffer;
+	for (ppBuffer = &m_ppHashTable[pBuffer->nSector & m_nHashMask];
+	     *ppBuffer != 0;
+	     ppBuffer = &(*ppBuffer)->pHashNext)
+	{
+		if (*ppBuffer == pBuffer)
+		{
+			*ppBuffer = pBuffer->pHashNext;
+			pBuffer->pHashNext = 0;
+
+			return;
+		}
 	}
 
+	assert (0);
+}
 
+TFATBuffer *CFATCache::AllocateBuffer (int bWriteBack)
+{
+	TFATBuffer *pBuffer;
+
+	// free and released non-critical buffers are at the end of the list
 	for (pBuffer = m_BufferList.pLast; pBuffer != 0; pBuffer = pBuffer->pPrev)
 	{
 		assert (pBuffer->nMagic == BUFFER_MAGIC);
 
-		if (pBuffer->nSector == BUFFER_NOSECTOR)
+		if (pBuffer->nUseCount == 0)
 		{
 			break;
 		}
@@ -178,116 +478,209 @@ TFATBuffer *CFATCache::GetSector (unsigned nSector, int bWriteOnly)
 
 	if (pBuffer == 0)
 	{
-		for (pBuffer = m_BufferList.pLast; pBuffer != 0; pBuffer = pBuffer->pPrev)
+		if (bWriteBack)
 		{
-			assert (pBuffer->nMagic == BUFFER_MAGIC);
-
-			if (pBuffer->nUseCount == 0)
-			{
-				break;
-			}
+			Fault (FAULT_NO_BUFFER);
 		}
 
-		if (pBuffer == 0)
+		return 0;
+	}
+
+	if (pBuffer->nSector == BUFFER_NOSECTOR)
+	{
+		return pBuffer;
+	}
+
+	if (pBuffer->bDirty)
+	{
+		if (!bWriteBack)
 		{
-			Fault (FAULT_NO_BUFFER);
-			m_BufferListLock.Release ();
 			return 0;
 		}
 
-		if (pBuffer->bDirty)
+		if (!WriteRun (pBuffer, 0))
 		{
-			m_DiskLock.Acquire ();
+			Fault (FAULT_WRITE_ERROR);
+			return 0;
+		}
+	}
 
-			m_pPartition->Seek (pBuffer->nSector * FAT_SECTOR_SIZE);
-			if (m_pPartition->Write (pBuffer->Data, FAT_SECTOR_SIZE) != FAT_SECTOR_SIZE)
-			{
-				Fault (FAULT_WRITE_ERROR);
-				m_DiskLock.Release ();
-				m_BufferListLock.Release ();
-				return 0;
-			}
+	HashRemove (pBuffer);
+	pBuffer->nSector = BUFFER_NOSECTOR;
 
-			m_DiskLock.Release ();
+	return pBuffer;
+}
+
+unsigned CFATCache::ReadBuffers (TFATBuffer *pBuffer)
+{
+	assert (pBuffer->nUseCount > 0);
+	unsigned nSector = pBuffer->nSector;
+
+	// collect buffers for the following sectors, which are not cached yet
+	TFATBuffer *ReadAhead[FAT_MAX_READ_AHEAD];
+	ReadAhead[0] = pBuffer;
+
+	unsigned nCount = 1;
+	while (   nCount < m_nReadAhead
+	       && nSector + nCount < m_nSectors
+	       && Lookup (nSector + nCount) == 0)
+	{
+		TFATBuffer *pNext = AllocateBuffer (0);		// clean buffers only
+		if (pNext == 0)
+		{
+			break;
 		}
 
-		pBuffer->nSector = BUFFER_NOSECTOR;
-		assert (pBuffer->nUseCount == 0);
+		pNext->nUseCount = 1;			// not available for this loop
+		pNext->nSector = nSector + nCount;
+		pNext->bDirty = 0;
+		HashInsert (pNext);
+
+		ReadAhead[nCount++] = pNext;
 	}
 
-	pBuffer->nUseCount = 1;
-	assert (pBuffer->nSector == BUFFER_NOSECTOR);
-	pBuffer->nSector = nSector;
-	pBuffer->bDirty = 0;
+	m_DiskLock.Acquire ();
 
-	if (!bWriteOnly)
+	m_pPartition->Seek ((u64) nSector * FAT_SECTOR_SIZE);
+
+	unsigned i;
+	if (   nCount > 1
+	    && m_pPartition->Read (m_pTransferBuffer, nCount * FAT_SECTOR_SIZE)
+	       == (int) (nCount * FAT_SECTOR_SIZE))
 	{
-		m_DiskLock.Acquire ();
+		for (i = 0; i < nCount; i++)
+		{
+			memcpy (ReadAhead[i]->Data, m_pTransferBuffer + i * FAT_SECTOR_SIZE,
+				FAT_SECTOR_SIZE);
+		}
+	}
+	else
+	{
+		// read the requested sector only
+		for (i = 1; i < nCount; i++)
+		{
+			HashRemove (ReadAhead[i]);
+			ReadAhead[i]->nSector = BUFFER_NOSECTOR;
+			ReadAhead[i]->nUseCount = 0;
+			MoveBufferLast (ReadAhead[i]);
+		}
 
-		m_pPartition->Seek (nSector * FAT_SECTOR_SIZE);
+		nCount = 1;
+
+		m_pPartition->Seek ((u64) nSector * FAT_SECTOR_SIZE);
 		if (m_pPartition->Read (pBuffer->Data, FAT_SECTOR_SIZE) != FAT_SECTOR_SIZE)
 		{
-			pBuffer->nUseCount--;
-			pBuffer->nSector = BUFFER_NOSECTOR;
-
-			Fault (FAULT_READ_ERROR);
-			m_DiskLock.Release ();
-			m_BufferListLock.Release ();
-			return 0;
+			nCount = 0;
 		}
-
-		m_DiskLock.Release ();
 	}
 
-	MoveBufferFirst (pBuffer);
+	m_DiskLock.Release ();
 
-	m_BufferListLock.Release ();
+	// the read-ahead buffers follow the requested buffer in LRU order
+	for (i = nCount; i-- > 1;)
+	{
+		ReadAhead[i]->nUseCount = 0;
+		MoveBufferFirst (ReadAhead[i]);
+	}
 
-	return pBuffer;
+	return nCount;
 }
 
-void CFATCache::FreeSector (TFATBuffer *pBuffer, int bCritical)
+void CFATCache::WriteBack (int bExpiredOnly)
 {
-	assert (pBuffer->nMagic == BUFFER_MAGIC);
-	assert (pBuffer->nUseCount > 0);
-	pBuffer->nUseCount--;
-	if (pBuffer->nUseCount > 0)
-	{
-		return;
-	}
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
 
-	if (bCritical)
+	for (TFATBuffer *pBuffer = m_BufferList.pFirst; pBuffer != 0; pBuffer = pBuffer->pNext)
 	{
-#if 0
-		if (pBuffer->bDirty)
+		assert (pBuffer->nMagic == BUFFER_MAGIC);
+
+		while (pBuffer->bDirty)
 		{
-			m_DiskLock.Acquire ();
+			if (   bExpiredOnly
+			    && (   pBuffer->nUseCount > 0
+				|| nTicks - pBuffer->nDirtyTicks < FAT_WRITEBACK_DELAY * HZ))
+			{
+				break;
+			}
 
-			m_pPartition->Seek (pBuffer->nSector * FAT_SECTOR_SIZE);
-			if (m_pPartition->Write (pBuffer->Data, FAT_SECTOR_SIZE) == FAT_SECTOR_SIZE)
+			// write the run of dirty sectors, where this buffer belongs to, at once
+			TFATBuffer *pFirst = pBuffer;
+			for (unsigned i = 0; i < FAT_MAX_READ_AHEAD && pFirst->nSector > 0; i++)
 			{
-				pBuffer->bDirty = 0;
+				TFATBuffer *pPrev = Lookup (pFirst->nSector - 1);
+				if (   pPrev == 0
+				    || !pPrev->bDirty
+				    || (bExpiredOnly && pPrev->nUseCount > 0))
+				{
+					break;
+				}
+
+				pFirst = pPrev;
 			}
 
-			m_DiskLock.Release ();
+			if (!WriteRun (pFirst, !bExpiredOnly))
+			{
+				Fault (FAULT_WRITE_ERROR);
+
+				pBuffer->bDirty = 0;
+			}
 		}
-#endif
+	}
+}
+
+int CFATCache::WriteRun (TFATBuffer *pFirst, int bInUse)
+{
+	assert (pFirst != 0);
+	assert (pFirst->bDirty);
+
+	TFATBuffer *Run[FAT_MAX_READ_AHEAD];
+	unsigned nCount = 0;
+
+	for (TFATBuffer *pBuffer = pFirst;
+	        pBuffer != 0
+	     && pBuffer->bDirty
+	     && (bInUse || pBuffer->nUseCount == 0 || pBuffer == pFirst)
+	     && nCount < FAT_MAX_READ_AHEAD;
+	     pBuffer = Lookup (pBuffer->nSector + 1))
+	{
+		Run[nCount++] = pBuffer;
+	}
+
+	assert (nCount > 0);
+
+	m_DiskLock.Acquire ();
+
+	m_pPartition->Seek ((u64) pFirst->nSector * FAT_SECTOR_SIZE);
+
+	int bOK;
+	if (nCount == 1)
+	{
+		bOK = m_pPartition->Write (pFirst->Data, FAT_SECTOR_SIZE) == FAT_SECTOR_SIZE;
 	}
 	else
 	{
-		m_BufferListLock.Acquire ();
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			memcpy (m_pTransferBuffer + i * FAT_SECTOR_SIZE, Run[i]->Data, FAT_SECTOR_SIZE);
+		}
 
-		MoveBufferLast (pBuffer);
+		bOK =    m_pPartition->Write (m_pTransferBuffer, nCount * FAT_SECTOR_SIZE)
+		      == (int) (nCount * FAT_SECTOR_SIZE);
+	}
 
-		m_BufferListLock.Release ();
+	m_DiskLock.Release ();
+
+	if (!bOK)
+	{
+		return 0;
 	}
-}
 
-void CFATCache::MarkDirty (TFATBuffer *pBuffer)
-{
-	assert (pBuffer->nMagic == BUFFER_MAGIC);
-	assert (pBuffer->nUseCount > 0);
-	pBuffer->bDirty = 1;
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		Run[i]->bDirty = 0;
+	}
+
+	return 1;
 }
 
 void CFATCache::MoveBufferFirst (TFATBuffer *pBuffer)
@@ -365,3 +758,35 @@ void CFATCache::Fault (unsigned nCode)
 
 	CLogger::Get ()->Write ("fatcache", LogPanic, pMsg);
 }
+
+#ifdef NO_BUSY_WAIT
+
+CFATCacheFlusher::CFATCacheFlusher (CFATCache *pCache)
+:	m_pCache (pCache),
+	m_bStop (FALSE)
+{
+	SetName ("fatflush");
+}
+
+void CFATCacheFlusher::Run (void)
+{
+	while (!m_bStop)
+	{
+		CScheduler::Get ()->MsSleep (FAT_FLUSH_INTERVAL);
+
+		if (!m_bStop)
+		{
+			assert (m_pCache != 0);
+			m_pCache->FlushExpired ();
+		}
+	}
+}
+
+void CFATCacheFlusher::Stop (void)
+{
+	m_bStop = TRUE;
+
+	WaitForTermination ();
+}
+
+#endif
@@ -34,9 +34,9 @@ CFATFileSystem::~CFATFileSystem (void)
 {
 }
 
-int CFATFileSystem::Mount (CDevice *pPartition)
+int CFATFileSystem::Mount (CDevice *pPartition, unsigned nCacheBuffers)
 {
-	if (!m_Cache.Open (pPartition))
+	if (!m_Cache.Open (pPartition, nCacheBuffers))
 	{
 		return 0;
 	}
@@ -47,6 +47,10 @@ int CFATFileSystem::Mount (CDevice *pPartition)
 		return 0;
 	}
 
+	// read whole clusters, the FAT is read ahead by the same amount
+	unsigned nReadAhead = m_FATInfo.GetSectorsPerCluster ();
+	m_Cache.SetReadAhead (nReadAhead > FAT_READ_AHEAD ? nReadAhead : FAT_READ_AHEAD);
+
 	return 1;
 }
 
@@ -271,6 +275,28 @@ unsigned CFATFileSystem::FileRead (unsigned hFile, void *pBuffer, unsigned ulByt
 			m_FileTableLock.Release ();
 			return ulBytesRead;
 		}
+
+		if (   pFile->pBuffer == 0
+		    && (pFile->nOffset % FAT_SECTOR_SIZE) == 0)
+		{
+			unsigned nSectors = (ulBytes < ulBytesLeft ? ulBytes : ulBytesLeft) / FAT_SECTOR_SIZE;
+			if (nSectors >= FAT_DIRECT_THRESHOLD)
+			{
+				if (!ReadSectors (pFile, pBuffer, nSectors))
+				{
+					m_FileTableLock.Release ();
+					return FS_ERROR;
+				}
+
+				ulCopyBytes = nSectors * FAT_SECTOR_SIZE;
+				pBuffer = (void *) (((unsigned char *) pBuffer) + ulCopyBytes);
+
+				ulBytes -= ulCopyBytes;
+				ulBytesRead += ulCopyBytes;
+
+				continue;
+			}
+		}
 	
 		if (pFile->pBuffer == 0)
 		{
@@ -371,6 +397,28 @@ unsigned CFATFileSystem::FileWrite (unsigned hFile, const void *pBuffer, unsigne
 			m_FileTableLock.Release ();
 			return ulBytesWritten;
 		}
+
+		if (   pFile->pBuffer == 0
+		    && (pFile->nOffset % FAT_SECTOR_SIZE) == 0)
+		{
+			unsigned nSectors = (ulBytes < ulBytesLeft ? ulBytes : ulBytesLeft) / FAT_SECTOR_SIZE;
+			if (nSectors >= FAT_DIRECT_THRESHOLD)
+			{
+				if (!WriteSectors (pFile, pBuffer, nSectors))
+				{
+					m_FileTableLock.Release ();
+					return FS_ERROR;
+				}
+
+				ulCopyBytes = nSectors * FAT_SECTOR_SIZE;
+				pBuffer = (void *) (((unsigned char *) pBuffer) + ulCopyBytes);
+
+				ulBytes -= ulCopyBytes;
+				ulBytesWritten += ulCopyBytes;
+
+				continue;
+			}
+		}
 	
 		if (pFile->pBuffer == 0)
 		{
@@ -449,6 +497,159 @@ unsigned CFATFileSystem::FileWrite (unsigned hFile, const void *pBuffer, unsigne
 	return ulBytesWritten;
 }
 
+boolean CFATFileSystem::ReadSectors (TFile *pFile, void *pBuffer, unsigned nSectors)
+{
+	assert (pFile != 0);
+	assert (pFile->pBuffer == 0);
+	assert ((pFile->nOffset % FAT_SECTOR_SIZE) == 0);
+	assert (pBuffer != 0);
+
+	unsigned nSectorsPerCluster = m_FATInfo.GetSectorsPerCluster ();
+	unsigned nSectorOffset = pFile->nOffset / FAT_SECTOR_SIZE;
+
+	unsigned char *pRunBuffer = (unsigned char *) pBuffer;
+	unsigned nRunSector = 0;
+	unsigned nRunCount = 0;
+
+	for (unsigned i = 0; i < nSectors; i++, nSectorOffset++)
+	{
+		unsigned nClusterOffset = nSectorOffset % nSectorsPerCluster;
+		if (   nClusterOffset == 0
+		    && nSectorOffset > 0)
+		{
+			unsigned nNextCluster = m_FAT.GetClusterEntry (pFile->nCluster);
+			if (m_FAT.IsEOC (nNextCluster))
+			{
+				return FALSE;
+			}
+
+			if (nNextCluster != pFile->nCluster + 1)
+			{
+				if (   nRunCount > 0
+				    && !m_Cache.ReadDirect (nRunSector, nRunCount, pRunBuffer))
+				{
+					return FALSE;
+				}
+
+				pRunBuffer += nRunCount * FAT_SECTOR_SIZE;
+				nRunCount = 0;
+			}
+
+			pFile->nCluster = nNextCluster;
+		}
+
+		if (nRunCount == FAT_DIRECT_MAX_RUN)
+		{
+			if (!m_Cache.ReadDirect (nRunSector, nRunCount, pRunBuffer))
+			{
+				return FALSE;
+			}
+
+			pRunBuffer += nRunCount * FAT_SECTOR_SIZE;
+			nRunCount = 0;
+		}
+
+		if (nRunCount == 0)
+		{
+			nRunSector = m_FATInfo.GetFirstSector (pFile->nCluster) + nClusterOffset;
+		}
+
+		nRunCount++;
+	}
+
+	if (   nRunCount > 0
+	    && !m_Cache.ReadDirect (nRunSector, nRunCount, pRunBuffer))
+	{
+		return FALSE;
+	}
+
+	pFile->nOffset += nSectors * FAT_SECTOR_SIZE;
+
+	return TRUE;
+}
+
+boolean CFATFileSystem::WriteSectors (TFile *pFile, const void *pBuffer, unsigned nSectors)
+{
+	assert (pFile != 0);
+	assert (pFile->pBuffer == 0);
+	assert ((pFile->nOffset % FAT_SECTOR_SIZE) == 0);
+	assert (pBuffer != 0);
+
+	unsigned nSectorsPerCluster = m_FATInfo.GetSectorsPerCluster ();
+	unsigned nSectorOffset = pFile->nOffset / FAT_SECTOR_SIZE;
+
+	const unsigned char *pRunBuffer = (const unsigned char *) pBuffer;
+	unsigned nRunSector = 0;
+	unsigned nRunCount = 0;
+
+	for (unsigned i = 0; i < nSectors; i++, nSectorOffset++)
+	{
+		unsigned nClusterOffset = nSectorOffset % nSectorsPerCluster;
+		if (nClusterOffset == 0)
+		{
+			unsigned nNextCluster = m_FAT.AllocateCluster ();
+			if (nNextCluster == 0)
+			{
+				return FALSE;
+			}
+
+			if (pFile->nFirstCluster == 0)
+			{
+				pFile->nFirstCluster = nNextCluster;
+			}
+			else
+			{
+				m_FAT.SetClusterEntry (pFile->nCluster, nNextCluster);
+			}
+
+			if (nNextCluster != pFile->nCluster + 1)
+			{
+				if (   nRunCount > 0
+				    && !m_Cache.WriteDirect (nRunSector, nRunCount, pRunBuffer))
+				{
+					return FALSE;
+				}
+
+				pRunBuffer += nRunCount * FAT_SECTOR_SIZE;
+				nRunCount = 0;
+			}
+
+			pFile->nCluster = nNextCluster;
+		}
+
+		if (nRunCount == FAT_DIRECT_MAX_RUN)
+		{
+			if (!m_Cache.WriteDirect (nRunSector, nRunCount, pRunBuffer))
+			{
+				return FALSE;
+			}
+
+			pRunBuffer += nRunCount * FAT_SECTOR_SIZE;
+			nRunCount = 0;
+		}
+
+		if (nRunCount == 0)
+		{
+			nRunSector = m_FATInfo.GetFirstSector (pFile->nCluster) + nClusterOffset;
+		}
+
+		nRunCount++;
+	}
+
+	if (   nRunCount > 0
+	    && !m_Cache.WriteDirect (nRunSector, nRunCount, pRunBuffer))
+	{
+		return FALSE;
+	}
+
+	pFile->nOffset += nSectors * FAT_SECTOR_SIZE;
+	assert (pFile->nOffset < FAT_MAX_FILESIZE);
+	pFile->nSize += nSectors * FAT_SECTOR_SIZE;
+	assert (pFile->nSize == pFile->nOffset);
+
+	return TRUE;
+}
+
 int CFATFileSystem::FileDelete (const char *pTitle)
 {
 	assert (pTitle != 0);
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/fs/partition.h>
+#include <circle/fs/buffercache.h>
 #include <circle/fs/fsdef.h>
 #include <assert.h>
 
@@ -51,6 +52,13 @@ int CPartition::Read (void *pBuffer, size_t nCount)
 	}
 	
 	assert (m_pDevice != 0);
+
+	CBufferCache *pCache = CBufferCache::Get ();
+	if (pCache != 0)
+	{
+		return pCache->Read (m_pDevice, GetDeviceOffset (), pBuffer, nCount);
+	}
+
 	return m_pDevice->Read (pBuffer, nCount);
 }
 
@@ -69,6 +77,13 @@ int CPartition::Write (const void *pBuffer, size_t nCount)
 	}
 	
 	assert (m_pDevice != 0);
+
+	CBufferCache *pCache = CBufferCache::Get ();
+	if (pCache != 0)
+	{
+		return pCache->Write (m_pDevice, GetDeviceOffset (), pBuffer, nCount);
+	}
+
 	return m_pDevice->Write (pBuffer, nCount);
 }
 
@@ -82,18 +97,99 @@ u64 CPartition::Seek (u64 ullOffset)
 		return (u64) -1;
 	}
 
-	u64 ullDeviceOffset = m_nFirstSector;
-	ullDeviceOffset <<= FS_BLOCK_SHIFT;
-	ullDeviceOffset += ullOffset;
-	
-	assert (m_pDevice != 0);
-	if (m_pDevice->Seek (ullDeviceOffset) != ullDeviceOffset)
+	m_ullOffset = ullOffset;
+
+	// the buffer cache seeks itself
+	if (CBufferCache::Get () == 0)
 	{
-		return (u64) -1;
+		u64 ullDeviceOffset = GetDeviceOffset ();
+
+		assert (m_pDevice != 0);
+		if (m_pDevice->Seek (ullDeviceOffset) != ullDeviceOffset)
+		{
+			return (u64) -1;
+		}
 	}
 
-	m_ullOffset = ullOffset;
 	m_bSeekError = FALSE;
 
 	return m_ullOffset;
 }
+
+int CPartition::IOCtl (unsigned long ulCmd, void *pData)
+{
+	assert (m_pDevice != 0);
+
+	switch (ulCmd)
+	{
+	case DEVICE_IOCTL_SYNC:
+		if (   CBufferCache::Get () != 0
+		    && !CBufferCache::Get ()->Flush (m_pDevice))
+		{
+			return -1;
+		}
+		return m_pDevice->IOCtl (ulCmd, pData);
+
+	case DEVICE_IOCTL_GET_BLOCK_SIZE:
+		return m_pDevice->IOCtl (ulCmd, pData);
+
+	case DEVICE_IOCTL_SUBMIT: {
+			// would bypass the buffer cache, Read() and Write() are used instead
+			if (CBufferCache::Get () != 0)
+			{
+				return -1;
+			}
+
+			const TDeviceBlockRequest *pRequest = (const TDeviceBlockRequest *) pData;
+			assert (pRequest != 0);
+
+			if ((pRequest->ullOffset & FS_BLOCK_MASK) != 0)
+			{
+				return -1;
+			}
+
+			u64 ullTransferEnd = pRequest->ullOffset + pRequest->nCount + FS_BLOCK_SIZE-1;
+			ullTransferEnd >>= FS_BLOCK_SHIFT;
+			if (ullTransferEnd > m_nNumberOfSectors)
+			{
+				return -1;
+			}
+
+			TDeviceBlockRequest Request = *pRequest;
+			Request.ullOffset += (u64) m_nFirstSector << FS_BLOCK_SHIFT;
+
+			return m_pDevice->IOCtl (ulCmd, &Request);
+		}
+
+	case DEVICE_IOCTL_DISCARD: {
+			const TDeviceBlockRange *pRange = (const TDeviceBlockRange *) pData;
+			assert (pRange != 0);
+
+			if (   (pRange->ullOffset & FS_BLOCK_MASK) != 0
+			    || (pRange->ullCount & FS_BLOCK_MASK) != 0
+			    || (pRange->ullOffset + pRange->ullCount) >> FS_BLOCK_SHIFT > m_nNumberOfSectors)
+			{
+				return -1;
+			}
+
+			TDeviceBlockRange Range = *pRange;
+			Range.ullOffset += (u64) m_nFirstSector << FS_BLOCK_SHIFT;
+
+			if (CBufferCache::Get () != 0)
+			{
+				CBufferCache::Get ()->Discard (m_pDevice, Range.ullOffset,
+							       Range.ullCount);
+			}
+
+			return m_pDevice->IOCtl (ulCmd, &Range);
+		}
+
+	default:
+		return -1;
+	}
+}
+
+u64 CPartition::GetDeviceOffset (void) const
+{
+	return ((u64) m_nFirstSector << FS_BLOCK_SHIFT) + m_ullOffset;
+}
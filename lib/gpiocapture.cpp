@@ -0,0 +1,604 @@
+//
+// gpiocapture.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpiocapture.h>
+#include <circle/bcm2835.h>
+#include <circle/machineinfo.h>
+#include <circle/memio.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <circle/new.h>
+#include <assert.h>
+
+//
+// PWM device selection (for DREQ only, the PWM outputs are not used)
+//
+#if RASPPI <= 3
+	#define CLOCK_RATE	250000000
+	#define PWM_BASE	ARM_PWM_BASE
+	#define DREQ_SOURCE	DREQSourcePWM
+#else
+	#define CLOCK_RATE	125000000
+	#define PWM_BASE	ARM_PWM1_BASE
+	#define DREQ_SOURCE	DREQSourcePWM1
+#endif
+
+#define PWM_CTL			(PWM_BASE + 0x00)
+	#define PWM_CTL_PWEN1		(1 << 0)
+	#define PWM_CTL_USEF1		(1 << 5)
+	#define PWM_CTL_CLRF1		(1 << 6)
+#define PWM_DMAC		(PWM_BASE + 0x08)
+	#define PWM_DMAC_DREQ__SHIFT	0
+	#define PWM_DMAC_PANIC__SHIFT	8
+	#define PWM_DMAC_ENAB		(1 << 31)
+#define PWM_RNG1		(PWM_BASE + 0x10)
+#define PWM_FIF1		(PWM_BASE + 0x18)
+
+#define BUS_IO_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
+#define STOP_MARGIN		4	// samples the DMA must be away from the stop position
+
+#define VCD_BUFFER_SIZE		1024
+
+CGPIOCapture::CGPIOCapture (unsigned nMaxSamples, unsigned nSampleRateHZ)
+:	m_nMaxSamples (nMaxSamples),
+	m_nSampleRate (nSampleRateHZ),
+	m_Clock (GPIOClockPWM),
+	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_NORMAL)),
+	m_bTriggerEnabled (FALSE),
+	m_bActive (FALSE),
+	m_bTriggered (FALSE),
+	m_nFirstSample (0),
+	m_nSampleCount (0)
+{
+	assert (m_nMaxSamples > STOP_MARGIN);
+	assert (0 < m_nSampleRate && m_nSampleRate <= CLOCK_RATE / 2);
+	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+
+	m_pBuffer = new (HEAP_DMA30) u32[m_nMaxSamples];
+	assert (m_pBuffer != 0);
+
+	m_pControlBlockBuffer = new (HEAP_DMA30) u8[2 * m_nMaxSamples * sizeof (TDMAControlBlock) + 31];
+	assert (m_pControlBlockBuffer != 0);
+	m_pControlBlock = (TDMAControlBlock *) (((uintptr) m_pControlBlockBuffer + 31) & ~31);
+
+	m_pDelaySource = new (HEAP_DMA30) u32[1];
+	assert (m_pDelaySource != 0);
+	*m_pDelaySource = 0;
+
+	// start clock and PWM device
+	RunPWM ();
+
+	// enable and reset DMA channel
+	PeripheralEntry ();
+
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nDMAChannel));
+	CTimer::SimpleusDelay (1000);
+
+	PeripheralExit ();
+
+	ResetDMA ();
+}
+
+CGPIOCapture::~CGPIOCapture (void)
+{
+	ResetDMA ();
+
+	PeripheralEntry ();
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nDMAChannel));
+	PeripheralExit ();
+
+	StopPWM ();
+
+	CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
+
+	delete [] m_pDelaySource;
+	m_pDelaySource = 0;
+
+	m_pControlBlock = 0;
+	delete [] m_pControlBlockBuffer;
+	m_pControlBlockBuffer = 0;
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+void CGPIOCapture::SetTrigger (u32 nMask, u32 nValue, boolean bEdge, unsigned nPostTriggerSamples)
+{
+	assert (!m_bActive);
+	assert (nPostTriggerSamples < m_nMaxSamples - STOP_MARGIN);
+
+	m_nTriggerMask = nMask;
+	m_nTriggerValue = nValue & nMask;
+	m_bTriggerEdge = bEdge;
+	m_nPostTriggerSamples = nPostTriggerSamples;
+
+	m_bTriggerEnabled = TRUE;
+}
+
+void CGPIOCapture::ClearTrigger (void)
+{
+	assert (!m_bActive);
+
+	m_bTriggerEnabled = FALSE;
+}
+
+boolean CGPIOCapture::Start (void)
+{
+	if (m_bActive)
+	{
+		return FALSE;
+	}
+
+	Compile (m_bTriggerEnabled);
+
+	m_bActive = TRUE;
+	m_bTriggered = FALSE;
+	m_bPrevMatch = TRUE;		// an edge needs a sample, which does not match before
+	m_nScanPos = 0;
+	m_ullScanned = 0;
+	m_nFirstSample = 0;
+	m_nSampleCount = 0;
+
+	ResetDMA ();
+
+	PeripheralEntry ();
+
+	// discard ticks from a previous run and enable the PWM DMA operation,
+	// the DMA does not run ahead of the sample clock by more than one FIFO word
+	write32 (PWM_CTL, read32 (PWM_CTL) | PWM_CTL_CLRF1);
+	write32 (PWM_DMAC,   PWM_DMAC_ENAB
+			   | (1 << PWM_DMAC_PANIC__SHIFT)
+			   | (1 << PWM_DMAC_DREQ__SHIFT));
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel), BUS_ADDRESS ((uintptr) m_pControlBlock));
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					         | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					         | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					         | CS_ACTIVE);
+
+	PeripheralExit ();
+
+	return TRUE;
+}
+
+boolean CGPIOCapture::Update (void)
+{
+	if (!m_bActive)
+	{
+		return TRUE;
+	}
+
+	if (!m_bTriggerEnabled)
+	{
+		if (IsRunning ())
+		{
+			return FALSE;
+		}
+
+		Finish (m_nMaxSamples-1);
+
+		return TRUE;
+	}
+
+	if (m_bTriggered)
+	{
+		if (IsRunning ())
+		{
+			return FALSE;
+		}
+
+		Finish (m_nStopPos);
+
+		return TRUE;
+	}
+
+	unsigned nPos = GetDMAPosition ();
+
+	// get the new samples from memory
+	if (nPos >= m_nScanPos)
+	{
+		CleanAndInvalidateDataCacheRange ((uintptr) &m_pBuffer[m_nScanPos],
+						  (nPos - m_nScanPos) * sizeof (u32));
+	}
+	else
+	{
+		CleanAndInvalidateDataCacheRange ((uintptr) &m_pBuffer[m_nScanPos],
+						  (m_nMaxSamples - m_nScanPos) * sizeof (u32));
+		CleanAndInvalidateDataCacheRange ((uintptr) m_pBuffer, nPos * sizeof (u32));
+	}
+
+	while (m_nScanPos != nPos)
+	{
+		boolean bMatch = (m_pBuffer[m_nScanPos] & m_nTriggerMask) == m_nTriggerValue;
+		if (   bMatch
+		    && (   !m_bTriggerEdge
+			|| !m_bPrevMatch))
+		{
+			m_bTriggered = TRUE;
+			m_nTriggerPos = m_nScanPos;
+
+			break;
+		}
+
+		m_bPrevMatch = bMatch;
+
+		if (++m_nScanPos == m_nMaxSamples)
+		{
+			m_nScanPos = 0;
+		}
+
+		m_ullScanned++;
+	}
+
+	if (!m_bTriggered)
+	{
+		return FALSE;
+	}
+
+	// stop the DMA after the post-trigger samples
+	m_nStopPos = (m_nTriggerPos + m_nPostTriggerSamples) % m_nMaxSamples;
+
+	unsigned nTaken = (nPos + m_nMaxSamples - m_nTriggerPos) % m_nMaxSamples;
+	if (nTaken + STOP_MARGIN > m_nPostTriggerSamples)
+	{
+		// too late to stop exactly, take the samples until now
+		ResetDMA ();
+
+		Finish ((nPos + m_nMaxSamples - 1) % m_nMaxSamples);
+
+		return TRUE;
+	}
+
+	TDMAControlBlock *pStopBlock = &m_pControlBlock[2*m_nStopPos + 1];
+	pStopBlock->nNextControlBlockAddress = 0;
+	CleanAndInvalidateDataCacheRange ((uintptr) pStopBlock, sizeof (TDMAControlBlock));
+
+	return FALSE;
+}
+
+void CGPIOCapture::Stop (void)
+{
+	if (!m_bActive)
+	{
+		return;
+	}
+
+	boolean bRunning = IsRunning ();
+	unsigned nPos = GetDMAPosition ();
+
+	ResetDMA ();
+
+	if (!m_bTriggerEnabled)
+	{
+		if (!bRunning)
+		{
+			Finish (m_nMaxSamples-1);
+		}
+		else if (nPos > 0)
+		{
+			Finish (nPos-1);
+		}
+		else
+		{
+			m_bActive = FALSE;
+		}
+
+		return;
+	}
+
+	if (!m_bTriggered)
+	{
+		m_nTriggerPos = m_nScanPos;	// no trigger, use the last checked position
+	}
+
+	Finish ((nPos + m_nMaxSamples - 1) % m_nMaxSamples);
+}
+
+boolean CGPIOCapture::IsTriggered (void) const
+{
+	return m_bTriggered;
+}
+
+unsigned CGPIOCapture::GetSampleCount (void) const
+{
+	return m_nSampleCount;
+}
+
+u32 CGPIOCapture::GetSample (unsigned nIndex) const
+{
+	assert (nIndex < m_nSampleCount);
+	assert (m_pBuffer != 0);
+
+	return m_pBuffer[(m_nFirstSample + nIndex) % m_nMaxSamples];
+}
+
+unsigned CGPIOCapture::GetTriggerIndex (void) const
+{
+	return (m_nTriggerPos + m_nMaxSamples - m_nFirstSample) % m_nMaxSamples;
+}
+
+unsigned CGPIOCapture::GetSampleRate (void) const
+{
+	return m_nSampleRate;
+}
+
+static boolean WriteVCD (const char *pString, char *pBuffer, size_t *pFill,
+			 TGPIOCaptureWriter *pWriter, void *pParam)
+{
+	size_t nLength = pString != 0 ? strlen (pString) : 0;
+	assert (nLength < VCD_BUFFER_SIZE);
+
+	if (   *pFill + nLength > VCD_BUFFER_SIZE
+	    || (   pString == 0
+		&& *pFill > 0))
+	{
+		if (!(*pWriter) (pBuffer, *pFill, pParam))
+		{
+			return FALSE;
+		}
+
+		*pFill = 0;
+	}
+
+	if (pString != 0)
+	{
+		memcpy (pBuffer + *pFill, pString, nLength);
+		*pFill += nLength;
+	}
+
+	return TRUE;
+}
+
+boolean CGPIOCapture::ExportVCD (TGPIOCaptureWriter *pWriter, void *pParam, u32 nPinMask) const
+{
+	assert (pWriter != 0);
+	assert (!m_bActive);
+
+	char Buffer[VCD_BUFFER_SIZE];
+	size_t nFill = 0;
+
+	CString Line;
+	Line.Format ("$comment %u samples at %u Hz $end\n"
+		     "$timescale 1 ns $end\n"
+		     "$scope module gpio $end\n", m_nSampleCount, m_nSampleRate);
+	if (!WriteVCD (Line, Buffer, &nFill, pWriter, pParam))
+	{
+		return FALSE;
+	}
+
+	// the identifier of GPIO n is the character '!' + n
+	for (unsigned nPin = 0; nPin < 32; nPin++)
+	{
+		if (nPinMask & (1U << nPin))
+		{
+			Line.Format ("$var wire 1 %c GPIO%u $end\n", '!' + nPin, nPin);
+			if (!WriteVCD (Line, Buffer, &nFill, pWriter, pParam))
+			{
+				return FALSE;
+			}
+		}
+	}
+
+	if (!WriteVCD ("$upscope $end\n$enddefinitions $end\n", Buffer, &nFill, pWriter, pParam))
+	{
+		return FALSE;
+	}
+
+	u32 nPrevSample = 0;
+	for (unsigned i = 0; i < m_nSampleCount; i++)
+	{
+		u32 nSample = GetSample (i);
+		u32 nChanged = i > 0 ? (nSample ^ nPrevSample) & nPinMask : nPinMask;
+		if (!nChanged)
+		{
+			continue;
+		}
+
+		Line.Format (i > 0 ? "#%llu\n" : "#%llu\n$dumpvars\n",
+			     (unsigned long long) i * 1000000000U / m_nSampleRate);
+		if (!WriteVCD (Line, Buffer, &nFill, pWriter, pParam))
+		{
+			return FALSE;
+		}
+
+		for (unsigned nPin = 0; nPin < 32; nPin++)
+		{
+			if (nChanged & (1U << nPin))
+			{
+				Line.Format ("%c%c\n", nSample & (1U << nPin) ? '1' : '0', '!' + nPin);
+				if (!WriteVCD (Line, Buffer, &nFill, pWriter, pParam))
+				{
+					return FALSE;
+				}
+			}
+		}
+
+		if (   i == 0
+		    && !WriteVCD ("$end\n", Buffer, &nFill, pWriter, pParam))
+		{
+			return FALSE;
+		}
+
+		nPrevSample = nSample;
+	}
+
+	return WriteVCD (0, Buffer, &nFill, pWriter, pParam);
+}
+
+void CGPIOCapture::Compile (boolean bCyclic)
+{
+	assert (m_pBuffer != 0);
+	assert (m_pControlBlock != 0);
+
+	for (unsigned i = 0; i < m_nMaxSamples; i++)
+	{
+		TDMAControlBlock *pReadBlock = &m_pControlBlock[2*i];
+		pReadBlock->nTransferInformation     = TI_WAIT_RESP;
+		pReadBlock->nSourceAddress           = BUS_IO_ADDRESS (ARM_GPIO_GPLEV0);
+		pReadBlock->nDestinationAddress      = BUS_ADDRESS ((uintptr) &m_pBuffer[i]);
+		pReadBlock->nTransferLength          = sizeof (u32);
+		pReadBlock->n2DModeStride            = 0;
+		pReadBlock->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &m_pControlBlock[2*i+1]);
+		pReadBlock->nReserved[0]	     = 0;
+		pReadBlock->nReserved[1]	     = 0;
+
+		// waits for one sample period
+		TDMAControlBlock *pDelayBlock = &m_pControlBlock[2*i+1];
+		pDelayBlock->nTransferInformation     =   (DREQ_SOURCE << TI_PERMAP_SHIFT)
+						        | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						        | TI_DEST_DREQ
+						        | TI_WAIT_RESP;
+		pDelayBlock->nSourceAddress           = BUS_ADDRESS ((uintptr) m_pDelaySource);
+		pDelayBlock->nDestinationAddress      = BUS_IO_ADDRESS (PWM_FIF1);
+		pDelayBlock->nTransferLength          = sizeof (u32);
+		pDelayBlock->n2DModeStride            = 0;
+		pDelayBlock->nReserved[0]	      = 0;
+		pDelayBlock->nReserved[1]	      = 0;
+
+		if (i < m_nMaxSamples-1)
+		{
+			pDelayBlock->nNextControlBlockAddress =
+				BUS_ADDRESS ((uintptr) &m_pControlBlock[2*(i+1)]);
+		}
+		else
+		{
+			pDelayBlock->nNextControlBlockAddress =
+				bCyclic ? BUS_ADDRESS ((uintptr) m_pControlBlock) : 0;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock,
+					  2 * m_nMaxSamples * sizeof (TDMAControlBlock));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pDelaySource, sizeof (u32));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pBuffer, m_nMaxSamples * sizeof (u32));
+}
+
+unsigned CGPIOCapture::GetDMAPosition (void) const
+{
+	PeripheralEntry ();
+
+	u32 nAddress = read32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel));
+
+	PeripheralExit ();
+
+	u32 nFirstAddress = BUS_ADDRESS ((uintptr) m_pControlBlock);
+	if (   nAddress < nFirstAddress
+	    || nAddress >= nFirstAddress + 2 * m_nMaxSamples * sizeof (TDMAControlBlock))
+	{
+		return 0;
+	}
+
+	return (nAddress - nFirstAddress) / (2 * sizeof (TDMAControlBlock));
+}
+
+void CGPIOCapture::Finish (unsigned nLastSample)
+{
+	assert (nLastSample < m_nMaxSamples);
+
+	m_bActive = FALSE;
+
+	PeripheralEntry ();
+	write32 (PWM_DMAC, 0);
+	PeripheralExit ();
+
+	if (!m_bTriggerEnabled)
+	{
+		m_nFirstSample = 0;
+		m_nSampleCount = nLastSample + 1;
+	}
+	else
+	{
+		u64 ullTotal =   m_ullScanned
+			       + (nLastSample + m_nMaxSamples - m_nTriggerPos) % m_nMaxSamples + 1;
+		if (ullTotal >= m_nMaxSamples)
+		{
+			m_nFirstSample = (nLastSample + 1) % m_nMaxSamples;
+			m_nSampleCount = m_nMaxSamples;
+		}
+		else
+		{
+			m_nFirstSample = 0;
+			m_nSampleCount = nLastSample + 1;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pBuffer, m_nMaxSamples * sizeof (u32));
+}
+
+void CGPIOCapture::RunPWM (void)
+{
+	PeripheralEntry ();
+
+#ifndef NDEBUG
+	boolean bOK =
+#endif
+		m_Clock.StartRate (CLOCK_RATE);
+	assert (bOK);
+	CTimer::SimpleusDelay (2000);
+
+	// one FIFO word is consumed per sample period
+	write32 (PWM_RNG1, CLOCK_RATE / m_nSampleRate);
+
+	write32 (PWM_CTL, PWM_CTL_PWEN1 | PWM_CTL_USEF1 | PWM_CTL_CLRF1);
+	CTimer::SimpleusDelay (2000);
+
+	PeripheralExit ();
+}
+
+void CGPIOCapture::StopPWM (void)
+{
+	PeripheralEntry ();
+
+	write32 (PWM_DMAC, 0);
+	write32 (PWM_CTL, 0);
+	CTimer::SimpleusDelay (2000);
+
+	m_Clock.Stop ();
+	CTimer::SimpleusDelay (2000);
+
+	PeripheralExit ();
+}
+
+void CGPIOCapture::ResetDMA (void)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	PeripheralExit ();
+}
+
+boolean CGPIOCapture::IsRunning (void) const
+{
+	PeripheralEntry ();
+
+	boolean bResult = read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_ACTIVE ? TRUE : FALSE;
+
+	PeripheralExit ();
+
+	return bResult;
+}
@@ -0,0 +1,193 @@
+//
+// gpioeventqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpioeventqueue.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CGPIOEventQueue::CGPIOEventQueue (unsigned nSize)
+:	m_pBuffer (0),
+	m_nSize (nSize),
+	m_nInPtr (0),
+	m_nOutPtr (0),
+	m_nOverflows (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	assert (m_nSize >= 2);
+	assert ((m_nSize & (m_nSize-1)) == 0);
+
+	m_pBuffer = new TGPIOEvent[m_nSize];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < GPIO_PINS; i++)
+	{
+		m_PinSlot[i].pThis = this;
+		m_PinSlot[i].pPin = 0;
+		m_PinSlot[i].Interrupt2 = GPIOInterruptUnknown;
+	}
+}
+
+CGPIOEventQueue::~CGPIOEventQueue (void)
+{
+	for (unsigned i = 0; i < GPIO_PINS; i++)
+	{
+		if (m_PinSlot[i].pPin != 0)
+		{
+			RemovePin (m_PinSlot[i].pPin);
+		}
+	}
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+boolean CGPIOEventQueue::AddPin (CGPIOPin *pPin, TGPIOInterrupt Interrupt,
+				 TGPIOInterrupt Interrupt2)
+{
+	assert (pPin != 0);
+	assert (Interrupt < GPIOInterruptUnknown);
+	assert (Interrupt2 != Interrupt);
+
+	unsigned nPin = pPin->GetPin ();
+	if (   nPin >= GPIO_PINS
+	    || m_PinSlot[nPin].pPin != 0)
+	{
+		return FALSE;
+	}
+
+	TPinSlot *pSlot = &m_PinSlot[nPin];
+	pSlot->pPin = pPin;
+	pSlot->Interrupt2 = Interrupt2;
+
+	pPin->ConnectInterrupt (EventStub, pSlot);
+
+	pPin->EnableInterrupt (Interrupt);
+	if (Interrupt2 != GPIOInterruptUnknown)
+	{
+		pPin->EnableInterrupt2 (Interrupt2);
+	}
+
+	return TRUE;
+}
+
+void CGPIOEventQueue::RemovePin (CGPIOPin *pPin)
+{
+	assert (pPin != 0);
+
+	unsigned nPin = pPin->GetPin ();
+	assert (nPin < GPIO_PINS);
+
+	TPinSlot *pSlot = &m_PinSlot[nPin];
+	assert (pSlot->pPin == pPin);
+
+	if (pSlot->Interrupt2 != GPIOInterruptUnknown)
+	{
+		pPin->DisableInterrupt2 ();
+	}
+	pPin->DisableInterrupt ();
+
+	pPin->DisconnectInterrupt ();
+
+	pSlot->pPin = 0;
+	pSlot->Interrupt2 = GPIOInterruptUnknown;
+}
+
+unsigned CGPIOEventQueue::Read (TGPIOEvent *pBuffer, unsigned nMaxEvents)
+{
+	assert (pBuffer != 0);
+
+	unsigned nResult = 0;
+
+	m_SpinLock.Acquire ();
+
+	while (   nResult < nMaxEvents
+	       && m_nOutPtr != m_nInPtr)
+	{
+		pBuffer[nResult++] = m_pBuffer[m_nOutPtr];
+
+		m_nOutPtr = (m_nOutPtr + 1) & (m_nSize-1);
+	}
+
+	m_SpinLock.Release ();
+
+	return nResult;
+}
+
+unsigned CGPIOEventQueue::GetCount (void) const
+{
+	m_SpinLock.Acquire ();
+
+	unsigned nResult = (m_nInPtr - m_nOutPtr) & (m_nSize-1);
+
+	m_SpinLock.Release ();
+
+	return nResult;
+}
+
+void CGPIOEventQueue::Flush (void)
+{
+	m_SpinLock.Acquire ();
+
+	m_nOutPtr = m_nInPtr;
+	m_nOverflows = 0;
+
+	m_SpinLock.Release ();
+}
+
+void CGPIOEventQueue::EventHandler (unsigned nPin)
+{
+	// take the time stamp first
+	u64 ullTimestamp = CTimer::GetClockTicks64 ();
+
+	assert (nPin < GPIO_PINS);
+	CGPIOPin *pPin = m_PinSlot[nPin].pPin;
+	assert (pPin != 0);
+
+	u8 uchLevel = (u8) pPin->Read ();
+
+	m_SpinLock.Acquire ();
+
+	unsigned nInPtr = (m_nInPtr + 1) & (m_nSize-1);
+	if (nInPtr != m_nOutPtr)
+	{
+		TGPIOEvent *pEvent = &m_pBuffer[m_nInPtr];
+		pEvent->ullTimestamp = ullTimestamp;
+		pEvent->uchPin = (u8) nPin;
+		pEvent->uchLevel = uchLevel;
+
+		m_nInPtr = nInPtr;
+	}
+	else
+	{
+		m_nOverflows++;
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CGPIOEventQueue::EventStub (void *pParam)
+{
+	TPinSlot *pSlot = (TPinSlot *) pParam;
+	assert (pSlot != 0);
+
+	CGPIOEventQueue *pThis = pSlot->pThis;
+	assert (pThis != 0);
+
+	pThis->EventHandler (pSlot - pThis->m_PinSlot);
+}
@@ -0,0 +1,402 @@
+//
+// gpiowaveform.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/gpiowaveform.h>
+#include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/machineinfo.h>
+#include <circle/memio.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <assert.h>
+
+//
+// PWM device selection (for DREQ only, the PWM outputs are not used)
+//
+#if RASPPI <= 3
+	#define CLOCK_RATE	250000000
+	#define PWM_BASE	ARM_PWM_BASE
+	#define DREQ_SOURCE	DREQSourcePWM
+#else
+	#define CLOCK_RATE	125000000
+	#define PWM_BASE	ARM_PWM1_BASE
+	#define DREQ_SOURCE	DREQSourcePWM1
+#endif
+
+#define PWM_CTL			(PWM_BASE + 0x00)
+	#define PWM_CTL_PWEN1		(1 << 0)
+	#define PWM_CTL_USEF1		(1 << 5)
+	#define PWM_CTL_CLRF1		(1 << 6)
+#define PWM_DMAC		(PWM_BASE + 0x08)
+	#define PWM_DMAC_DREQ__SHIFT	0
+	#define PWM_DMAC_PANIC__SHIFT	8
+	#define PWM_DMAC_ENAB		(1 << 31)
+#define PWM_RNG1		(PWM_BASE + 0x10)
+#define PWM_FIF1		(PWM_BASE + 0x18)
+
+#define BUS_IO_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
+CGPIOWaveform::CGPIOWaveform (unsigned nMaxSteps, unsigned nTickRateHZ,
+			      CInterruptSystem *pInterruptSystem)
+:	m_nMaxSteps (nMaxSteps),
+	m_nSteps (0),
+	m_nTickRate (nTickRateHZ),
+	m_pInterruptSystem (pInterruptSystem),
+	m_bIRQConnected (FALSE),
+	m_pCompletionRoutine (0),
+	m_pCompletionParam (0),
+	m_Clock (GPIOClockPWM),
+	m_nDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_NORMAL)),
+	m_bCyclic (FALSE)
+{
+	assert (m_nMaxSteps > 0);
+	assert (0 < m_nTickRate && m_nTickRate <= CLOCK_RATE / 2);
+	assert (m_nDMAChannel <= DMA_CHANNEL_MAX);
+
+	m_pSteps = new (HEAP_DMA30) TStep[m_nMaxSteps];
+	assert (m_pSteps != 0);
+
+	m_pControlBlockBuffer = new (HEAP_DMA30) u8[2 * m_nMaxSteps * sizeof (TDMAControlBlock) + 31];
+	assert (m_pControlBlockBuffer != 0);
+	m_pControlBlock = (TDMAControlBlock *) (((uintptr) m_pControlBlockBuffer + 31) & ~31);
+
+	m_pDelaySource = new (HEAP_DMA30) u32[1];
+	assert (m_pDelaySource != 0);
+	*m_pDelaySource = 0;
+
+	// start clock and PWM device
+	RunPWM ();
+
+	// enable and reset DMA channel
+	PeripheralEntry ();
+
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) | (1 << m_nDMAChannel));
+	CTimer::SimpleusDelay (1000);
+
+	PeripheralExit ();
+
+	ResetDMA ();
+}
+
+CGPIOWaveform::~CGPIOWaveform (void)
+{
+	ResetDMA ();
+
+	PeripheralEntry ();
+	write32 (ARM_DMA_ENABLE, read32 (ARM_DMA_ENABLE) & ~(1 << m_nDMAChannel));
+	PeripheralExit ();
+
+	StopPWM ();
+
+	if (m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel);
+	}
+
+	m_pInterruptSystem = 0;
+
+	CMachineInfo::Get ()->FreeDMAChannel (m_nDMAChannel);
+
+	delete [] m_pDelaySource;
+	m_pDelaySource = 0;
+
+	m_pControlBlock = 0;
+	delete [] m_pControlBlockBuffer;
+	m_pControlBlockBuffer = 0;
+
+	delete [] m_pSteps;
+	m_pSteps = 0;
+}
+
+boolean CGPIOWaveform::AddStep (u32 nSetMask, u32 nClearMask, unsigned nDelayTicks)
+{
+	assert (!IsRunning ());
+
+	if (   m_nSteps >= m_nMaxSteps
+	    || nDelayTicks > TXFR_LEN_MAX / sizeof (u32))
+	{
+		return FALSE;
+	}
+
+	assert (m_pSteps != 0);
+	TStep *pStep = &m_pSteps[m_nSteps++];
+
+	pStep->nSetMask = nSetMask;
+	pStep->nClearMask = nClearMask;
+	pStep->nDelayTicks = nDelayTicks;
+	pStep->nReserved = 0;
+
+	return TRUE;
+}
+
+void CGPIOWaveform::Clear (void)
+{
+	assert (!IsRunning ());
+
+	m_nSteps = 0;
+}
+
+void CGPIOWaveform::SetCompletionRoutine (TGPIOWaveformCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (m_pInterruptSystem != 0);
+	assert (!IsRunning ());
+
+	m_pCompletionRoutine = pRoutine;
+	m_pCompletionParam = pParam;
+}
+
+boolean CGPIOWaveform::Start (boolean bCyclic)
+{
+	if (   m_nSteps == 0
+	    || IsRunning ())
+	{
+		return FALSE;
+	}
+
+	if (bCyclic)
+	{
+		// an unpaced cyclic chain would congest the bus
+		boolean bPaced = FALSE;
+		for (unsigned i = 0; i < m_nSteps; i++)
+		{
+			if (m_pSteps[i].nDelayTicks > 0)
+			{
+				bPaced = TRUE;
+
+				break;
+			}
+		}
+
+		if (!bPaced)
+		{
+			return FALSE;
+		}
+	}
+
+	Compile (bCyclic);
+
+	if (   !bCyclic
+	    && m_pCompletionRoutine != 0
+	    && !m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nDMAChannel, InterruptStub, this);
+
+		m_bIRQConnected = TRUE;
+	}
+
+	ResetDMA ();
+
+	PeripheralEntry ();
+
+	// discard ticks from a previous run and enable the PWM DMA operation,
+	// the DMA does not run ahead of the ticks by more than one FIFO word
+	write32 (PWM_CTL, read32 (PWM_CTL) | PWM_CTL_CLRF1);
+	write32 (PWM_DMAC,   PWM_DMAC_ENAB
+			   | (1 << PWM_DMAC_PANIC__SHIFT)
+			   | (1 << PWM_DMAC_DREQ__SHIFT));
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nDMAChannel), BUS_ADDRESS ((uintptr) m_pControlBlock));
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					         | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					         | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					         | CS_ACTIVE);
+
+	PeripheralExit ();
+
+	return TRUE;
+}
+
+void CGPIOWaveform::Stop (void)
+{
+	ResetDMA ();
+}
+
+boolean CGPIOWaveform::IsRunning (void) const
+{
+	PeripheralEntry ();
+
+	boolean bResult = read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_ACTIVE ? TRUE : FALSE;
+
+	PeripheralExit ();
+
+	return bResult;
+}
+
+void CGPIOWaveform::Compile (boolean bCyclic)
+{
+	assert (m_nSteps > 0);
+	assert (m_pSteps != 0);
+	assert (m_pControlBlock != 0);
+
+	m_bCyclic = bCyclic;
+
+	TDMAControlBlock *pLast = 0;
+	for (unsigned i = 0; i < m_nSteps; i++)
+	{
+		TStep *pStep = &m_pSteps[i];
+
+		// write GPSET0 and GPCLR0 with one 2D transfer (two rows with one word each)
+		TDMAControlBlock *pGPIOBlock = &m_pControlBlock[2*i];
+		pGPIOBlock->nTransferInformation     =   TI_SRC_INC
+						       | TI_DEST_INC
+						       | TI_WAIT_RESP
+						       | TI_TDMODE;
+		pGPIOBlock->nSourceAddress           = BUS_ADDRESS ((uintptr) &pStep->nSetMask);
+		pGPIOBlock->nDestinationAddress      = BUS_IO_ADDRESS (ARM_GPIO_GPSET0);
+		pGPIOBlock->nTransferLength          =   ((2-1) << TXFR_LEN_YLENGTH_SHIFT)
+						       | (sizeof (u32) << TXFR_LEN_XLENGTH_SHIFT);
+		pGPIOBlock->n2DModeStride            =   (ARM_GPIO_GPCLR0 - ARM_GPIO_GPSET0 - sizeof (u32))
+						       << STRIDE_DEST_SHIFT;
+		pGPIOBlock->nReserved[0]	     = 0;
+		pGPIOBlock->nReserved[1]	     = 0;
+
+		if (pLast != 0)
+		{
+			pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) pGPIOBlock);
+		}
+		pLast = pGPIOBlock;
+
+		if (pStep->nDelayTicks == 0)
+		{
+			continue;
+		}
+
+		// each word written to the PWM FIFO takes one tick
+		TDMAControlBlock *pDelayBlock = &m_pControlBlock[2*i+1];
+		pDelayBlock->nTransferInformation     =   (DREQ_SOURCE << TI_PERMAP_SHIFT)
+						        | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						        | TI_DEST_DREQ
+						        | TI_WAIT_RESP;
+		pDelayBlock->nSourceAddress           = BUS_ADDRESS ((uintptr) m_pDelaySource);
+		pDelayBlock->nDestinationAddress      = BUS_IO_ADDRESS (PWM_FIF1);
+		pDelayBlock->nTransferLength          = pStep->nDelayTicks * sizeof (u32);
+		pDelayBlock->n2DModeStride            = 0;
+		pDelayBlock->nReserved[0]	      = 0;
+		pDelayBlock->nReserved[1]	      = 0;
+
+		pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) pDelayBlock);
+		pLast = pDelayBlock;
+	}
+
+	assert (pLast != 0);
+	if (bCyclic)
+	{
+		pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock);
+	}
+	else
+	{
+		pLast->nNextControlBlockAddress = 0;
+
+		if (m_pCompletionRoutine != 0)
+		{
+			pLast->nTransferInformation |= TI_INTEN;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pSteps, m_nSteps * sizeof (TStep));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock,
+					  2 * m_nSteps * sizeof (TDMAControlBlock));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pDelaySource, sizeof (u32));
+}
+
+void CGPIOWaveform::RunPWM (void)
+{
+	PeripheralEntry ();
+
+#ifndef NDEBUG
+	boolean bOK =
+#endif
+		m_Clock.StartRate (CLOCK_RATE);
+	assert (bOK);
+	CTimer::SimpleusDelay (2000);
+
+	// one FIFO word is consumed per tick
+	write32 (PWM_RNG1, CLOCK_RATE / m_nTickRate);
+
+	write32 (PWM_CTL, PWM_CTL_PWEN1 | PWM_CTL_USEF1 | PWM_CTL_CLRF1);
+	CTimer::SimpleusDelay (2000);
+
+	PeripheralExit ();
+}
+
+void CGPIOWaveform::StopPWM (void)
+{
+	PeripheralEntry ();
+
+	write32 (PWM_DMAC, 0);
+	write32 (PWM_CTL, 0);
+	CTimer::SimpleusDelay (2000);
+
+	m_Clock.Stop ();
+	CTimer::SimpleusDelay (2000);
+
+	PeripheralExit ();
+}
+
+void CGPIOWaveform::ResetDMA (void)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (m_nDMAChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	write32 (ARM_DMA_INT_STATUS, 1 << m_nDMAChannel);
+
+	PeripheralExit ();
+}
+
+void CGPIOWaveform::InterruptHandler (void)
+{
+	PeripheralEntry ();
+
+	u32 nIntMask = 1 << m_nDMAChannel;
+	if (!(read32 (ARM_DMA_INT_STATUS) & nIntMask))
+	{
+		PeripheralExit ();
+
+		return;
+	}
+
+	write32 (ARM_DMA_INT_STATUS, nIntMask);
+
+	u32 nCS = read32 (ARM_DMACHAN_CS (m_nDMAChannel));
+	write32 (ARM_DMACHAN_CS (m_nDMAChannel), nCS);	// reset CS_INT
+
+	PeripheralExit ();
+
+	if (m_pCompletionRoutine != 0)
+	{
+		(*m_pCompletionRoutine) (nCS & CS_ERROR ? FALSE : TRUE, m_pCompletionParam);
+	}
+}
+
+void CGPIOWaveform::InterruptStub (void *pParam)
+{
+	CGPIOWaveform *pThis = (CGPIOWaveform *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/heapallocator.h>
+#include <circle/multicore.h>
 #include <circle/logger.h>
 #include <circle/util.h>
 #include <assert.h>
@@ -28,9 +29,22 @@ CHeapAllocator::CHeapAllocator (const char *pHeapName)
 :	m_pHeapName (pHeapName),
 	m_pNext (0),
 	m_pLimit (0),
-	m_nReserve (0)
+	m_nReserve (0),
+	m_pLast (0),
+	m_nLargeFLBitmap (0),
+	m_nLargeFreeSpace (0),
+	m_nAllocations (0),
+	m_nSampleInterval (0),
+	m_nSampleCounter (0),
+	m_nSampleNext (0)
 {
 	memset (m_Bucket, 0, sizeof m_Bucket);
+	memset (m_nLargeSLBitmap, 0, sizeof m_nLargeSLBitmap);
+	memset (m_pLargeFreeList, 0, sizeof m_pLargeFreeList);
+	memset (m_Samples, 0, sizeof m_Samples);
+#ifdef HEAP_CORE_CACHE
+	memset (m_CoreCache, 0, sizeof m_CoreCache);
+#endif
 
 	unsigned nBuckets = sizeof s_nBucketSize / sizeof s_nBucketSize[0];
 	if (nBuckets > HEAP_BLOCK_MAX_BUCKETS)
@@ -60,32 +74,42 @@ size_t CHeapAllocator::GetFreeSpace (void) const
 	return m_pLimit - m_pNext;
 }
 
-void *CHeapAllocator::Allocate (size_t nSize)
+void *CHeapAllocator::Allocate (size_t nSize, uintptr nCallerPC)
 {
 	if (m_pNext == 0)
 	{
 		return 0;
 	}
 
-	m_SpinLock.Acquire ();
+	if (m_nSampleInterval != 0)
+	{
+		Sample (nSize, nCallerPC);
+	}
+
+	unsigned nBucket = GetBucket (nSize);
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
 
-	THeapBlockBucket *pBucket;
-	for (pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+#ifdef HEAP_CORE_CACHE
+	void *pCachedBlock = AllocateCached (nBucket);
+	if (pCachedBlock != 0)
 	{
-		if (nSize <= pBucket->nSize)
-		{
-			nSize = pBucket->nSize;
+		CountAllocation (pBucket);
+		__atomic_add_fetch (&m_nAllocations, 1, __ATOMIC_RELAXED);
 
-#ifdef HEAP_DEBUG
-			if (++pBucket->nCount > pBucket->nMaxCount)
-			{
-				pBucket->nMaxCount = pBucket->nCount;
-			}
+		return pCachedBlock;
+	}
 #endif
 
-			break;
-		}
+	if (pBucket->nSize > 0)
+	{
+		nSize = pBucket->nSize;
 	}
+	else
+	{
+		nSize = (nSize + HEAP_ALIGN_MASK) & ~HEAP_ALIGN_MASK;
+	}
+
+	m_SpinLock.Acquire ();
 
 	THeapBlockHeader *pBlockHeader;
 	if (   pBucket->nSize > 0
@@ -94,6 +118,11 @@ void *CHeapAllocator::Allocate (size_t nSize)
 		assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
 		pBucket->pFreeList = pBlockHeader->pNext;
 	}
+	else if (   pBucket->nSize == 0
+		 && (pBlockHeader = AllocateLarge (nSize)) != 0)
+	{
+		assert (pBlockHeader->nSize >= nSize);
+	}
 	else
 	{
 		pBlockHeader = (THeapBlockHeader *) m_pNext;
@@ -131,10 +160,18 @@ void *CHeapAllocator::Allocate (size_t nSize)
 		m_pNext = pNextBlock;
 
 		pBlockHeader->nSize = (u32) nSize;
+
+		pBlockHeader->pPrevPhys = m_pLast;
+		m_pLast = pBlockHeader;
+
+		pBucket->nBlocks++;
 	}
 
 	m_SpinLock.Release ();
 
+	CountAllocation (pBucket);
+	__atomic_add_fetch (&m_nAllocations, 1, __ATOMIC_RELAXED);
+
 	pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
 	pBlockHeader->pNext = 0;
 
@@ -144,11 +181,11 @@ void *CHeapAllocator::Allocate (size_t nSize)
 	return pResult;
 }
 
-void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
+void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize, uintptr nCallerPC)
 {
 	if (pBlock == 0)
 	{
-		return Allocate (nSize);
+		return Allocate (nSize, nCallerPC);
 	}
 
 	if (nSize == 0)
@@ -166,7 +203,7 @@ void *CHeapAllocator::ReAllocate (void *pBlock, size_t nSize)
 		return pBlock;
 	}
 
-	void *pNewBlock = Allocate (nSize);
+	void *pNewBlock = Allocate (nSize, nCallerPC);
 	if (pNewBlock == 0)
 	{
 		return 0;
@@ -191,42 +228,528 @@ void CHeapAllocator::Free (void *pBlock)
 	assert (pBlockHeader->nMagic == HEAP_BLOCK_ALLOC_MAGIC);
 	pBlockHeader->nMagic = HEAP_BLOCK_FREE_MAGIC;
 
-	for (THeapBlockBucket *pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+	unsigned nBucket = GetBucket (pBlockHeader->nSize);
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+	assert (pBucket->nSize == 0 || pBucket->nSize == pBlockHeader->nSize);
+
+	__atomic_sub_fetch (&pBucket->nCount, 1, __ATOMIC_RELAXED);
+
+#ifdef HEAP_CORE_CACHE
+	if (FreeCached (pBlockHeader, nBucket))
 	{
-		if (pBlockHeader->nSize == pBucket->nSize)
+		return;
+	}
+#endif
+
+	if (pBucket->nSize > 0)
+	{
+		m_SpinLock.Acquire ();
+
+		pBlockHeader->pNext = pBucket->pFreeList;
+		pBucket->pFreeList = pBlockHeader;
+
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	FreeLarge (pBlockHeader);
+
+	m_SpinLock.Release ();
+}
+
+#ifdef HEAP_CORE_CACHE
+
+// The cache of the own core is protected against concurrent access from
+// interrupt handlers only. The spin lock is acquired to move a batch of blocks
+// from or to the free list of the bucket.
+
+void *CHeapAllocator::AllocateCached (unsigned nBucket)
+{
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+	if (   pBucket->nSize == 0
+	    || pBucket->nSize > HEAP_CORE_CACHE_MAX_SIZE)
+	{
+		return 0;
+	}
+
+	EnterCritical (IRQ_LEVEL);
+
+	THeapCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()][nBucket];
+	if (pCache->pFreeList == 0)
+	{
+		m_SpinLock.Acquire ();
+
+		while (   pCache->nCount < HEAP_CORE_CACHE_BATCH
+		       && pBucket->pFreeList != 0)
 		{
-			m_SpinLock.Acquire ();
+			THeapBlockHeader *pBlockHeader = pBucket->pFreeList;
+			pBucket->pFreeList = pBlockHeader->pNext;
 
-			pBlockHeader->pNext = pBucket->pFreeList;
-			pBucket->pFreeList = pBlockHeader;
+			pBlockHeader->pNext = pCache->pFreeList;
+			pCache->pFreeList = pBlockHeader;
+			pCache->nCount++;
+		}
 
-#ifdef HEAP_DEBUG
-			pBucket->nCount--;
-#endif
+		m_SpinLock.Release ();
 
-			m_SpinLock.Release ();
+		if (pCache->pFreeList == 0)
+		{
+			LeaveCritical ();
 
-			return;
+			return 0;		// allocate a new block from the region
 		}
 	}
 
-#ifdef HEAP_DEBUG
-	CLogger::Get ()->Write (m_pHeapName, LogDebug, "Trying to free large block (size %u)",
-				pBlockHeader->nSize);
+	THeapBlockHeader *pBlockHeader = pCache->pFreeList;
+	assert (pBlockHeader->nMagic == HEAP_BLOCK_FREE_MAGIC);
+	pCache->pFreeList = pBlockHeader->pNext;
+	pCache->nCount--;
+
+	LeaveCritical ();
+
+	pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
+	pBlockHeader->pNext = 0;
+
+	void *pResult = pBlockHeader->Data;
+	assert (((uintptr) pResult & HEAP_ALIGN_MASK) == 0);
+
+	return pResult;
+}
+
+boolean CHeapAllocator::FreeCached (THeapBlockHeader *pBlockHeader, unsigned nBucket)
+{
+	assert (pBlockHeader != 0);
+	THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+	if (   pBucket->nSize == 0
+	    || pBucket->nSize > HEAP_CORE_CACHE_MAX_SIZE)
+	{
+		return FALSE;
+	}
+
+	EnterCritical (IRQ_LEVEL);
+
+	THeapCoreCache *pCache = &m_CoreCache[CMultiCoreSupport::ThisCore ()][nBucket];
+
+	pBlockHeader->pNext = pCache->pFreeList;
+	pCache->pFreeList = pBlockHeader;
+
+	// return a batch to the bucket, so that other cores can use the blocks
+	if (++pCache->nCount > 2*HEAP_CORE_CACHE_BATCH)
+	{
+		m_SpinLock.Acquire ();
+
+		while (pCache->nCount > HEAP_CORE_CACHE_BATCH)
+		{
+			THeapBlockHeader *pReturned = pCache->pFreeList;
+			pCache->pFreeList = pReturned->pNext;
+			pCache->nCount--;
+
+			pReturned->pNext = pBucket->pFreeList;
+			pBucket->pFreeList = pReturned;
+		}
+
+		m_SpinLock.Release ();
+	}
+
+	LeaveCritical ();
+
+	return TRUE;
+}
 
-	pBlockHeader->nMagic = 0;
 #endif
+
+THeapBlockHeader *CHeapAllocator::AllocateLarge (size_t nSize)
+{
+	assert ((nSize & HEAP_ALIGN_MASK) == 0);
+	if (nSize > 0x80000000U)
+	{
+		return 0;
+	}
+
+	// round up to the next list, where all blocks are big enough
+	size_t nSearchSize = nSize;
+	if (nSearchSize >= 1U << HEAP_LARGE_FL_SHIFT)
+	{
+		unsigned nMSB = 31 - __builtin_clz ((u32) nSearchSize);
+		nSearchSize += (1U << (nMSB - HEAP_LARGE_SL_SHIFT)) - 1;
+	}
+
+	unsigned nFL, nSL;
+	MapLargeSize (nSearchSize, &nFL, &nSL);
+
+	u32 nSLBitmap = nFL < HEAP_LARGE_FL_COUNT ? m_nLargeSLBitmap[nFL] & (~0U << nSL) : 0;
+	if (nSLBitmap == 0)
+	{
+		u32 nFLBitmap = nFL+1 < 32 ? m_nLargeFLBitmap & (~0U << (nFL+1)) : 0;
+		if (nFLBitmap == 0)
+		{
+			return 0;
+		}
+
+		nFL = __builtin_ctz (nFLBitmap);
+		assert (nFL < HEAP_LARGE_FL_COUNT);
+		nSLBitmap = m_nLargeSLBitmap[nFL];
+	}
+
+	assert (nSLBitmap != 0);
+	nSL = __builtin_ctz (nSLBitmap);
+
+	THeapBlockHeader *pBlockHeader = m_pLargeFreeList[nFL][nSL];
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nSize >= nSize);
+
+	RemoveLarge (pBlockHeader);
+
+	// split off the remaining space, if it is big enough for another large block
+	size_t nRemaining = pBlockHeader->nSize - nSize;
+	if (nRemaining >= sizeof (THeapBlockHeader) + HEAP_BLOCK_ALIGN)
+	{
+		THeapBlockHeader *pNextPhys = GetNextPhys (pBlockHeader);
+
+		pBlockHeader->nSize = (u32) nSize;
+
+		THeapBlockHeader *pRemainder = GetNextPhys (pBlockHeader);
+		pRemainder->nSize = (u32) (nRemaining - sizeof (THeapBlockHeader));
+		pRemainder->pPrevPhys = pBlockHeader;
+
+		if (pNextPhys != 0)
+		{
+			pNextPhys->pPrevPhys = pRemainder;
+		}
+		else
+		{
+			assert (m_pLast == pBlockHeader);
+			m_pLast = pRemainder;
+		}
+
+		InsertLarge (pRemainder);
+	}
+
+	return pBlockHeader;
 }
 
-#ifdef HEAP_DEBUG
+void CHeapAllocator::FreeLarge (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+
+	// merge with the following block
+	THeapBlockHeader *pNextPhys = GetNextPhys (pBlockHeader);
+	if (   pNextPhys != 0
+	    && pNextPhys->nMagic == HEAP_BLOCK_LARGE_MAGIC
+	    && (u64) pBlockHeader->nSize + sizeof (THeapBlockHeader) + pNextPhys->nSize < 0x80000000U)
+	{
+		RemoveLarge (pNextPhys);
+
+		pBlockHeader->nSize += sizeof (THeapBlockHeader) + pNextPhys->nSize;
+		pNextPhys->nMagic = 0;
+
+		pNextPhys = GetNextPhys (pBlockHeader);
+		if (pNextPhys != 0)
+		{
+			pNextPhys->pPrevPhys = pBlockHeader;
+		}
+		else
+		{
+			m_pLast = pBlockHeader;
+		}
+	}
+
+	// merge with the preceding block
+	THeapBlockHeader *pPrevPhys = pBlockHeader->pPrevPhys;
+	if (   pPrevPhys != 0
+	    && pPrevPhys->nMagic == HEAP_BLOCK_LARGE_MAGIC
+	    && (u64) pPrevPhys->nSize + sizeof (THeapBlockHeader) + pBlockHeader->nSize < 0x80000000U)
+	{
+		RemoveLarge (pPrevPhys);
+
+		pPrevPhys->nSize += sizeof (THeapBlockHeader) + pBlockHeader->nSize;
+		pBlockHeader->nMagic = 0;
+		pBlockHeader = pPrevPhys;
+
+		if (pNextPhys != 0)
+		{
+			pNextPhys->pPrevPhys = pBlockHeader;
+		}
+		else
+		{
+			m_pLast = pBlockHeader;
+		}
+	}
+
+	// return the block to the free space of the region, if it is at its end
+	if (pNextPhys == 0)
+	{
+		assert (m_pLast == pBlockHeader);
+		m_pNext = (u8 *) pBlockHeader;
+		m_pLast = pBlockHeader->pPrevPhys;
+
+		pBlockHeader->nMagic = 0;
+
+		return;
+	}
+
+	InsertLarge (pBlockHeader);
+}
+
+void CHeapAllocator::InsertLarge (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+	pBlockHeader->nMagic = HEAP_BLOCK_LARGE_MAGIC;
+
+	unsigned nFL, nSL;
+	MapLargeSize (pBlockHeader->nSize, &nFL, &nSL);
+	assert (nFL < HEAP_LARGE_FL_COUNT);
+
+	THeapBlockHeader *pHead = m_pLargeFreeList[nFL][nSL];
+	pBlockHeader->pPrev = 0;
+	pBlockHeader->pNext = pHead;
+	if (pHead != 0)
+	{
+		pHead->pPrev = pBlockHeader;
+	}
+	m_pLargeFreeList[nFL][nSL] = pBlockHeader;
+
+	m_nLargeFreeSpace += pBlockHeader->nSize;
+
+	m_nLargeFLBitmap |= 1U << nFL;
+	m_nLargeSLBitmap[nFL] |= 1U << nSL;
+}
+
+void CHeapAllocator::RemoveLarge (THeapBlockHeader *pBlockHeader)
+{
+	assert (pBlockHeader != 0);
+	assert (pBlockHeader->nMagic == HEAP_BLOCK_LARGE_MAGIC);
+
+	unsigned nFL, nSL;
+	MapLargeSize (pBlockHeader->nSize, &nFL, &nSL);
+	assert (nFL < HEAP_LARGE_FL_COUNT);
+
+	if (pBlockHeader->pPrev != 0)
+	{
+		pBlockHeader->pPrev->pNext = pBlockHeader->pNext;
+	}
+	else
+	{
+		assert (m_pLargeFreeList[nFL][nSL] == pBlockHeader);
+		m_pLargeFreeList[nFL][nSL] = pBlockHeader->pNext;
+	}
+
+	if (pBlockHeader->pNext != 0)
+	{
+		pBlockHeader->pNext->pPrev = pBlockHeader->pPrev;
+	}
+
+	assert (m_nLargeFreeSpace >= pBlockHeader->nSize);
+	m_nLargeFreeSpace -= pBlockHeader->nSize;
+
+	if (m_pLargeFreeList[nFL][nSL] == 0)
+	{
+		m_nLargeSLBitmap[nFL] &= ~(1U << nSL);
+		if (m_nLargeSLBitmap[nFL] == 0)
+		{
+			m_nLargeFLBitmap &= ~(1U << nFL);
+		}
+	}
+
+	pBlockHeader->nMagic = HEAP_BLOCK_ALLOC_MAGIC;
+	pBlockHeader->pNext = 0;
+}
+
+THeapBlockHeader *CHeapAllocator::GetNextPhys (THeapBlockHeader *pBlockHeader) const
+{
+	assert (pBlockHeader != 0);
+	u8 *pNext = pBlockHeader->Data + pBlockHeader->nSize;
+	assert (pNext <= m_pNext);
+
+	return pNext < m_pNext ? (THeapBlockHeader *) pNext : 0;
+}
+
+void CHeapAllocator::MapLargeSize (size_t nSize, unsigned *pFL, unsigned *pSL)
+{
+	assert (pFL != 0);
+	assert (pSL != 0);
+
+	if (nSize < 1U << HEAP_LARGE_FL_SHIFT)
+	{
+		*pFL = 0;
+		*pSL = (unsigned) nSize >> (HEAP_LARGE_FL_SHIFT - HEAP_LARGE_SL_SHIFT);
+	}
+	else
+	{
+		unsigned nMSB = 31 - __builtin_clz ((u32) nSize);
+		*pFL = nMSB - HEAP_LARGE_FL_SHIFT + 1;
+		*pSL = ((u32) nSize >> (nMSB - HEAP_LARGE_SL_SHIFT)) & (HEAP_LARGE_SL_COUNT-1);
+	}
+}
+
+void CHeapAllocator::GetStatistics (THeapStatistics *pStats)
+{
+	assert (pStats != 0);
+
+	m_SpinLock.Acquire ();
+
+	pStats->nFreeSpace = m_pLimit - m_pNext;
+	pStats->nFreeBucketSpace = 0;
+
+	unsigned nBucket;
+	for (nBucket = 0; m_Bucket[nBucket].nSize > 0; nBucket++)
+	{
+		const THeapBlockBucket *pBucket = &m_Bucket[nBucket];
+
+		pStats->Bucket[nBucket].nSize = pBucket->nSize;
+		pStats->Bucket[nBucket].nCount = pBucket->nCount;
+		pStats->Bucket[nBucket].nMaxCount = pBucket->nMaxCount;
+
+		// also includes the blocks in the per-core caches
+		if (pBucket->nBlocks > pBucket->nCount)
+		{
+			pStats->nFreeBucketSpace += (size_t) (pBucket->nBlocks - pBucket->nCount)
+						    * pBucket->nSize;
+		}
+	}
+
+	pStats->nBuckets = nBucket;
+	pStats->nLargeCount = m_Bucket[nBucket].nCount;
+	pStats->nLargeMaxCount = m_Bucket[nBucket].nMaxCount;
+
+	pStats->nFreeLargeSpace = m_nLargeFreeSpace;
+
+	// the largest free large block is on the highest non-empty list
+	size_t nLargestLarge = 0;
+	if (m_nLargeFLBitmap != 0)
+	{
+		unsigned nFL = 31 - __builtin_clz (m_nLargeFLBitmap);
+		assert (m_nLargeSLBitmap[nFL] != 0);
+		unsigned nSL = 31 - __builtin_clz ((u32) m_nLargeSLBitmap[nFL]);
+
+		for (THeapBlockHeader *pBlockHeader = m_pLargeFreeList[nFL][nSL];
+		     pBlockHeader != 0;
+		     pBlockHeader = pBlockHeader->pNext)
+		{
+			if (pBlockHeader->nSize > nLargestLarge)
+			{
+				nLargestLarge = pBlockHeader->nSize;
+			}
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	pStats->nAllocations = m_nAllocations;
+
+	size_t nLargestRegion = pStats->nFreeSpace;
+	if (nLargestRegion >= sizeof (THeapBlockHeader) + m_nReserve)
+	{
+		nLargestRegion -= sizeof (THeapBlockHeader) + m_nReserve;
+	}
+	else
+	{
+		nLargestRegion = 0;
+	}
+
+	pStats->nLargestFree = nLargestRegion > nLargestLarge ? nLargestRegion : nLargestLarge;
+
+	size_t nAllFree =   pStats->nFreeSpace + pStats->nFreeBucketSpace
+			  + pStats->nFreeLargeSpace;
+	pStats->nFragmentation =   nAllFree != 0
+				 ? 100 - (unsigned) ((u64) pStats->nLargestFree * 100 / nAllFree)
+				 : 0;
+}
+
+void CHeapAllocator::SetSampleInterval (unsigned nInterval)
+{
+	m_nSampleCounter = 0;
+	m_nSampleInterval = nInterval;
+}
+
+unsigned CHeapAllocator::GetSamples (THeapSample *pBuffer, unsigned nMaxSamples) const
+{
+	assert (pBuffer != 0);
+
+	unsigned nNext = m_nSampleNext;
+	unsigned nSamples = nNext < HEAP_SAMPLE_COUNT ? nNext : HEAP_SAMPLE_COUNT;
+	if (nSamples > nMaxSamples)
+	{
+		nSamples = nMaxSamples;
+	}
+
+	for (unsigned i = 0; i < nSamples; i++)
+	{
+		pBuffer[i] = m_Samples[(nNext - 1 - i) % HEAP_SAMPLE_COUNT];
+	}
+
+	return nSamples;
+}
 
 void CHeapAllocator::DumpStatus (void)
 {
-	for (THeapBlockBucket *pBucket = m_Bucket; pBucket->nSize > 0; pBucket++)
+	THeapStatistics Stats;
+	GetStatistics (&Stats);
+
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	for (unsigned i = 0; i < Stats.nBuckets; i++)
 	{
-		CLogger::Get ()->Write (m_pHeapName, LogDebug, "malloc(%lu): %u blocks (max %u)",
-					pBucket->nSize, pBucket->nCount, pBucket->nMaxCount);
+		pLogger->Write (m_pHeapName, LogDebug, "malloc(%lu): %u blocks (max %u)",
+				(unsigned long) Stats.Bucket[i].nSize,
+				Stats.Bucket[i].nCount, Stats.Bucket[i].nMaxCount);
 	}
+
+	pLogger->Write (m_pHeapName, LogDebug, "Large: %u blocks (max %u)",
+			Stats.nLargeCount, Stats.nLargeMaxCount);
+
+	pLogger->Write (m_pHeapName, LogDebug,
+			"Free %lu, buckets %lu, large %lu, largest %lu (%u%% fragmented)",
+			(unsigned long) Stats.nFreeSpace, (unsigned long) Stats.nFreeBucketSpace,
+			(unsigned long) Stats.nFreeLargeSpace, (unsigned long) Stats.nLargestFree,
+			Stats.nFragmentation);
 }
 
-#endif
+unsigned CHeapAllocator::GetBucket (size_t nSize) const
+{
+	unsigned nBucket;
+	for (nBucket = 0; m_Bucket[nBucket].nSize > 0; nBucket++)
+	{
+		if (nSize <= m_Bucket[nBucket].nSize)
+		{
+			break;
+		}
+	}
+
+	return nBucket;
+}
+
+void CHeapAllocator::Sample (size_t nSize, uintptr nCallerPC)
+{
+	unsigned nInterval = m_nSampleInterval;
+	if (   nInterval == 0
+	    || __atomic_add_fetch (&m_nSampleCounter, 1, __ATOMIC_RELAXED) % nInterval != 0)
+	{
+		return;
+	}
+
+	unsigned nIndex = __atomic_fetch_add (&m_nSampleNext, 1, __ATOMIC_RELAXED);
+
+	THeapSample *pSample = &m_Samples[nIndex % HEAP_SAMPLE_COUNT];
+	pSample->nCallerPC = nCallerPC;
+	pSample->nSize = nSize;
+}
+
+void CHeapAllocator::CountAllocation (THeapBlockBucket *pBucket)
+{
+	assert (pBucket != 0);
+
+	unsigned nCount = __atomic_add_fetch (&pBucket->nCount, 1, __ATOMIC_RELAXED);
+
+	unsigned nMaxCount = __atomic_load_n (&pBucket->nMaxCount, __ATOMIC_RELAXED);
+	while (   nCount > nMaxCount
+	       && !__atomic_compare_exchange_n (&pBucket->nMaxCount, &nMaxCount, nCount, TRUE,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		// nMaxCount has been updated by the failed compare-and-exchange
+	}
+}
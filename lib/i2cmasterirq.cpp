@@ -110,13 +110,18 @@ CI2CMasterIRQ::CI2CMasterIRQ (CInterruptSystem *pInterruptSystem, unsigned nDevi
 	m_bValid (FALSE),
 	m_nCoreClockRate (CMachineInfo::Get ()->GetClockRate (CLOCK_ID_CORE)),
 	m_nClockSpeed (0),
-	m_SpinLock (TASK_LEVEL),
+	m_SpinLock (IRQ_LEVEL),
 	m_nStatus (StatusSuccess),
 	m_pReadBuffer (0),
 	m_nReadCount (0),
 	m_pInterruptSystem (pInterruptSystem),
 	m_pCompletionRoutine (0),
-	m_pCompletionParam (0)
+	m_pCompletionParam (0),
+	m_nBatchIn (0),
+	m_nBatchOut (0),
+	m_bBatchActive (FALSE),
+	m_nSegment (0),
+	m_nSegmentOffset (0)
 {
 	if (   m_nDevice >= DEVICES
 	    || m_nConfig >= CONFIGS
@@ -259,6 +264,15 @@ int CI2CMasterIRQ::StartTransfer (u8 ucAddress,
 	}
 
 	m_SpinLock.Acquire ();
+
+	if (   m_bBatchActive
+	    || m_nBatchIn != m_nBatchOut)
+	{
+		m_SpinLock.Release ();
+
+		return StatusInvalidState;
+	}
+
 	m_pReadBuffer = pReadBuffer;
 	m_nReadCount = nReadCount;
 
@@ -303,6 +317,229 @@ int CI2CMasterIRQ::StartTransfer (u8 ucAddress,
 	return 0;
 }
 
+int CI2CMasterIRQ::SubmitBatch (const TI2CSegment *pSegments, unsigned nSegments,
+				TI2CBatchCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (m_bValid);
+
+	if (   pSegments == 0
+	    || nSegments == 0
+	    || pRoutine == 0)
+	{
+		return StatusInvalidParam;
+	}
+
+	for (unsigned i = 0; i < nSegments; i++)
+	{
+		const TI2CSegment *pSegment = &pSegments[i];
+
+		if (   pSegment->ucAddress >= 0x80
+		    || pSegment->pBuffer == 0
+		    || pSegment->nCount == 0
+		    || pSegment->nCount > 0xFFFF)
+		{
+			return StatusInvalidParam;
+		}
+
+		// the BSC can only continue a write with a read without stop condition
+		if (   pSegment->bRepeatedStart
+		    && (   pSegment->bRead
+			|| i+1 >= nSegments
+			|| !pSegments[i+1].bRead))
+		{
+			return StatusInvalidParam;
+		}
+	}
+
+	m_SpinLock.Acquire ();
+
+	unsigned nBatchIn = (m_nBatchIn + 1) % I2C_BATCH_QUEUE_SIZE;
+	if (nBatchIn == m_nBatchOut)
+	{
+		m_SpinLock.Release ();
+
+		return StatusInvalidState;
+	}
+
+	TBatch *pBatch = &m_BatchQueue[m_nBatchIn];
+	pBatch->pSegments = pSegments;
+	pBatch->nSegments = nSegments;
+	pBatch->pRoutine = pRoutine;
+	pBatch->pParam = pParam;
+
+	m_nBatchIn = nBatchIn;
+
+	// wait for a running single transfer to complete otherwise
+	if (   !m_bBatchActive
+	    && m_nStatus <= 0)
+	{
+		StartBatch ();
+	}
+
+	m_SpinLock.Release ();
+
+	return 0;
+}
+
+unsigned CI2CMasterIRQ::GetPendingBatches (void)
+{
+	m_SpinLock.Acquire ();
+
+	unsigned nBatches =   (m_nBatchIn + I2C_BATCH_QUEUE_SIZE - m_nBatchOut)
+			    % I2C_BATCH_QUEUE_SIZE;
+
+	m_SpinLock.Release ();
+
+	return nBatches;
+}
+
+// called with spin lock acquired
+void CI2CMasterIRQ::StartBatch (void)
+{
+	assert (!m_bBatchActive);
+
+	if (m_nBatchOut == m_nBatchIn)
+	{
+		return;
+	}
+
+	m_bBatchActive = TRUE;
+	m_nSegment = 0;
+
+	StartSegment (FALSE);
+}
+
+// called with spin lock acquired
+void CI2CMasterIRQ::StartSegment (boolean bRepeatedStart)
+{
+	assert (m_bBatchActive);
+	const TBatch *pBatch = &m_BatchQueue[m_nBatchOut];
+	assert (m_nSegment < pBatch->nSegments);
+	const TI2CSegment *pSegment = &pBatch->pSegments[m_nSegment];
+
+	m_nSegmentOffset = 0;
+
+	PeripheralEntry ();
+
+	// on repeated start the FIFO still holds the end of the write segment
+	if (!bRepeatedStart)
+	{
+		write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_CLEAR);
+		write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
+	}
+
+	write32 (m_nBaseAddress + ARM_BSC_A__OFFSET, pSegment->ucAddress);
+	write32 (m_nBaseAddress + ARM_BSC_DLEN__OFFSET, pSegment->nCount);
+
+	if (pSegment->bRead)
+	{
+		m_nStatus = StatusReading;
+
+		// RXR interrupt empties the FIFO for long reads
+		write32 (m_nBaseAddress + ARM_BSC_C__OFFSET,
+			 C_I2CEN | C_ST | C_READ | C_INTD | C_INTR);
+	}
+	else
+	{
+		m_nStatus = StatusWriting;
+
+		// a repeated start is issued from the TXW interrupt, after the last byte
+		// has been written to the FIFO, so do not fill the FIFO in advance then
+		if (!pSegment->bRepeatedStart)
+		{
+			const u8 *pWriteData = (const u8 *) pSegment->pBuffer;
+			while (   m_nSegmentOffset < pSegment->nCount
+			       && m_nSegmentOffset < FIFO_SIZE)
+			{
+				write32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET,
+					 pWriteData[m_nSegmentOffset++]);
+			}
+		}
+
+		write32 (m_nBaseAddress + ARM_BSC_C__OFFSET,
+			   C_I2CEN | C_ST | C_INTD
+			 | (m_nSegmentOffset < pSegment->nCount ? C_INTT : 0));
+	}
+
+	PeripheralExit ();
+}
+
+// called with spin lock acquired, returns TRUE if the batch has completed
+boolean CI2CMasterIRQ::BatchInterruptHandler (u32 nStatus, int *pResult)
+{
+	assert (m_bBatchActive);
+	const TBatch *pBatch = &m_BatchQueue[m_nBatchOut];
+	assert (m_nSegment < pBatch->nSegments);
+	const TI2CSegment *pSegment = &pBatch->pSegments[m_nSegment];
+
+	assert (pResult != 0);
+	if (nStatus & S_ERR)
+	{
+		*pResult = StatusAckError;
+
+		return TRUE;
+	}
+
+	if (nStatus & S_CLKT)
+	{
+		*pResult = StatusClockStretchTimeout;
+
+		return TRUE;
+	}
+
+	u8 *pBuffer = (u8 *) pSegment->pBuffer;
+	if (pSegment->bRead)
+	{
+		while (   m_nSegmentOffset < pSegment->nCount
+		       && (read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_RXD))
+		{
+			pBuffer[m_nSegmentOffset++] =
+				read32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET) & FIFO__MASK;
+		}
+	}
+	else if (!(nStatus & S_DONE))
+	{
+		while (   m_nSegmentOffset < pSegment->nCount
+		       && (read32 (m_nBaseAddress + ARM_BSC_S__OFFSET) & S_TXD))
+		{
+			write32 (m_nBaseAddress + ARM_BSC_FIFO__OFFSET, pBuffer[m_nSegmentOffset++]);
+		}
+
+		if (   m_nSegmentOffset == pSegment->nCount
+		    && pSegment->bRepeatedStart)
+		{
+			// the read is started, when the write has completed without stop
+			m_nSegment++;
+			StartSegment (TRUE);
+		}
+
+		return FALSE;
+	}
+
+	if (!(nStatus & S_DONE))
+	{
+		return FALSE;
+	}
+
+	if (m_nSegmentOffset < pSegment->nCount)
+	{
+		*pResult = StatusDataLeftToReadError;
+
+		return TRUE;
+	}
+
+	if (++m_nSegment < pBatch->nSegments)
+	{
+		StartSegment (FALSE);
+
+		return FALSE;
+	}
+
+	*pResult = StatusSuccess;
+
+	return TRUE;
+}
+
 void CI2CMasterIRQ::InterruptHandler (void)
 {
 	m_SpinLock.Acquire ();
@@ -312,6 +549,42 @@ void CI2CMasterIRQ::InterruptHandler (void)
 	u32 nStatus = read32 (m_nBaseAddress + ARM_BSC_S__OFFSET);
 	write32 (m_nBaseAddress + ARM_BSC_S__OFFSET, S_CLKT | S_ERR | S_DONE);
 
+	if (m_bBatchActive)
+	{
+		int nResult;
+		if (!BatchInterruptHandler (nStatus, &nResult))
+		{
+			PeripheralExit ();
+
+			m_SpinLock.Release ();
+
+			return;
+		}
+
+		write32 (m_nBaseAddress + ARM_BSC_C__OFFSET, C_CLEAR);
+
+		PeripheralExit ();
+
+		const TBatch *pBatch = &m_BatchQueue[m_nBatchOut];
+		TI2CBatchCompletionRoutine *pRoutine = pBatch->pRoutine;
+		void *pParam = pBatch->pParam;
+		unsigned nSegments = m_nSegment;
+
+		m_nBatchOut = (m_nBatchOut + 1) % I2C_BATCH_QUEUE_SIZE;
+		m_bBatchActive = FALSE;
+		m_nStatus = nResult;
+
+		// keep the bus busy, while the completion routine is running
+		StartBatch ();
+
+		m_SpinLock.Release ();
+
+		assert (pRoutine != 0);
+		(*pRoutine) (nResult, nSegments, pParam);
+
+		return;
+	}
+
 	if (nStatus & S_ERR)
 	{
 		m_nStatus = StatusAckError;
@@ -368,6 +641,12 @@ void CI2CMasterIRQ::InterruptHandler (void)
 
 	PeripheralExit ();
 
+	// batches, which have been submitted during the single transfer
+	if (m_nStatus <= 0)
+	{
+		StartBatch ();
+	}
+
 	m_SpinLock.Release ();
 }
 
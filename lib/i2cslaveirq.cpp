@@ -0,0 +1,401 @@
+//
+// i2cslaveirq.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/i2cslaveirq.h>
+#include <circle/memio.h>
+#include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define DR_DATA__MASK		0xFF
+
+#define RSR_UE			(1 << 1)
+#define RSR_OE			(1 << 0)
+
+#define CR_RXE			(1 << 9)
+#define CR_TXE			(1 << 8)
+#define CR_BRK			(1 << 7)
+#define CR_I2C			(1 << 2)
+#define CR_EN			(1 << 0)
+
+#define FR_TXFLEVEL(reg)	(((reg) >> 6)  & 0x1F)
+#define FR_RXBUSY		(1 << 5)
+#define FR_TXFF			(1 << 2)
+#define FR_RXFE			(1 << 1)
+#define FR_TXBUSY		(1 << 0)
+
+#define IFLS_RXIFLSEL__SHIFT	3
+#define IFLS_TXIFLSEL__SHIFT	0
+	#define IFLS_1_8		0	// FIFO 1/8 full
+
+#define IMSC_OEIM		(1 << 3)
+#define IMSC_TXIM		(1 << 1)
+#define IMSC_RXIM		(1 << 0)
+
+#define ICR_OEIC		(1 << 3)
+#define ICR_BEIC		(1 << 2)
+#define ICR_TXIC		(1 << 1)
+#define ICR_RXIC		(1 << 0)
+
+#define RING_MASK		(I2C_SLAVE_RING_SIZE-1)
+
+CI2CSlaveIRQ::CI2CSlaveIRQ (u8 ucAddress, CInterruptSystem *pInterrupt)
+:	m_ucAddress (ucAddress),
+	m_pInterrupt (pInterrupt),
+	m_bIRQConnected (FALSE),
+#if RASPPI <= 3
+	m_SDA (18, GPIOModeAlternateFunction3),
+	m_SCL (19, GPIOModeAlternateFunction3),
+#else
+	m_SDA (10, GPIOModeAlternateFunction3),
+	m_SCL (11, GPIOModeAlternateFunction3),
+#endif
+	m_pRegisters (0),
+	m_nRegisterSize (0),
+	m_pWriteHandler (0),
+	m_pWriteParam (0),
+	m_nPointer (0),
+	m_nTxPointer (0),
+	m_bTransferActive (FALSE),
+	m_nWriteStart (0),
+	m_nWriteCount (0),
+	m_nRxIn (0),
+	m_nRxOut (0),
+	m_nTxIn (0),
+	m_nTxOut (0),
+	m_nErrors (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+}
+
+CI2CSlaveIRQ::~CI2CSlaveIRQ (void)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_BSC_SPI_SLAVE_IMSC, 0);
+	write32 (ARM_BSC_SPI_SLAVE_CR, 0);
+
+	PeripheralExit ();
+
+	if (m_bIRQConnected)
+	{
+		assert (m_pInterrupt != 0);
+		m_pInterrupt->DisconnectIRQ (ARM_IRQ_I2CSPISLV);
+
+		m_bIRQConnected = FALSE;
+	}
+
+	m_pInterrupt = 0;
+}
+
+boolean CI2CSlaveIRQ::Initialize (void)
+{
+	assert (m_pInterrupt != 0);
+	assert (!m_bIRQConnected);
+	m_pInterrupt->ConnectIRQ (ARM_IRQ_I2CSPISLV, InterruptStub, this);
+	m_bIRQConnected = TRUE;
+
+	m_SpinLock.Acquire ();
+
+	PeripheralEntry ();
+
+	write32 (ARM_BSC_SPI_SLAVE_IMSC, 0);
+
+	write32 (ARM_BSC_SPI_SLAVE_SLV, m_ucAddress);
+
+	write32 (ARM_BSC_SPI_SLAVE_IFLS,   IFLS_1_8 << IFLS_RXIFLSEL__SHIFT
+					 | IFLS_1_8 << IFLS_TXIFLSEL__SHIFT);
+
+	write32 (ARM_BSC_SPI_SLAVE_RSR, 0);
+	write32 (ARM_BSC_SPI_SLAVE_ICR, ICR_OEIC | ICR_BEIC | ICR_TXIC | ICR_RXIC);
+
+	write32 (ARM_BSC_SPI_SLAVE_CR, CR_RXE | CR_TXE | CR_I2C | CR_EN);
+
+	u32 nMask = IMSC_RXIM | IMSC_OEIM;
+	if (m_pRegisters != 0)
+	{
+		// registers are always prefetched into the TX FIFO
+		RestartTransmit ();
+
+		nMask |= IMSC_TXIM;
+	}
+
+	write32 (ARM_BSC_SPI_SLAVE_IMSC, nMask);
+
+	PeripheralExit ();
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CI2CSlaveIRQ::SetRegisterMap (volatile u8 *pRegisters, unsigned nSize,
+				   TI2CSlaveWriteHandler *pHandler, void *pParam)
+{
+	assert (!m_bIRQConnected);
+	assert (pRegisters != 0);
+	assert (0 < nSize && nSize <= 256);
+
+	m_pRegisters = pRegisters;
+	m_nRegisterSize = nSize;
+	m_pWriteHandler = pHandler;
+	m_pWriteParam = pParam;
+}
+
+void CI2CSlaveIRQ::RegistersChanged (void)
+{
+	assert (m_pRegisters != 0);
+
+	m_SpinLock.Acquire ();
+
+	PeripheralEntry ();
+
+	// do not disturb a running transfer, the next write transfer refills the FIFO anyway
+	u32 nFlags = read32 (ARM_BSC_SPI_SLAVE_FR);
+	if (   !(nFlags & (FR_TXBUSY | FR_RXBUSY))
+	    && !m_bTransferActive)
+	{
+		// the register pointer of the master is behind the prefetched bytes
+		m_nPointer =   (m_nTxPointer + m_nRegisterSize - FR_TXFLEVEL (nFlags) % m_nRegisterSize)
+			     % m_nRegisterSize;
+
+		RestartTransmit ();
+	}
+
+	PeripheralExit ();
+
+	m_SpinLock.Release ();
+}
+
+int CI2CSlaveIRQ::Read (void *pBuffer, unsigned nCount)
+{
+	assert (m_pRegisters == 0);
+
+	u8 *pData = (u8 *) pBuffer;
+	assert (pData != 0);
+
+	int nResult = 0;
+	while (   nCount > 0
+	       && m_nRxOut != m_nRxIn)
+	{
+		DataMemBarrier ();
+
+		*pData++ = m_RxRing[m_nRxOut];
+
+		DataMemBarrier ();
+
+		m_nRxOut = (m_nRxOut + 1) & RING_MASK;
+
+		nResult++;
+		nCount--;
+	}
+
+	return nResult;
+}
+
+int CI2CSlaveIRQ::Write (const void *pBuffer, unsigned nCount)
+{
+	assert (m_pRegisters == 0);
+
+	const u8 *pData = (const u8 *) pBuffer;
+	assert (pData != 0);
+
+	int nResult = 0;
+	while (   nCount > 0
+	       && ((m_nTxIn + 1) & RING_MASK) != m_nTxOut)
+	{
+		m_TxRing[m_nTxIn] = *pData++;
+
+		DataMemBarrier ();
+
+		m_nTxIn = (m_nTxIn + 1) & RING_MASK;
+
+		nResult++;
+		nCount--;
+	}
+
+	if (nResult > 0)
+	{
+		m_SpinLock.Acquire ();
+
+		PeripheralEntry ();
+
+		FillTransmitFIFO ();
+
+		PeripheralExit ();
+
+		m_SpinLock.Release ();
+	}
+
+	return nResult;
+}
+
+void CI2CSlaveIRQ::InterruptHandler (void)
+{
+	unsigned nWriteStart = 0;
+	unsigned nWriteCount = 0;
+
+	m_SpinLock.Acquire ();
+
+	PeripheralEntry ();
+
+	if (read32 (ARM_BSC_SPI_SLAVE_RSR) & (RSR_OE | RSR_UE))
+	{
+		write32 (ARM_BSC_SPI_SLAVE_RSR, 0);
+
+		m_nErrors++;
+	}
+
+	write32 (ARM_BSC_SPI_SLAVE_ICR, ICR_OEIC | ICR_BEIC | ICR_TXIC | ICR_RXIC);
+
+	ReceiveFIFO ();
+
+	if (   m_pRegisters != 0
+	    && m_bTransferActive
+	    && !(read32 (ARM_BSC_SPI_SLAVE_FR) & FR_RXBUSY))
+	{
+		ReceiveFIFO ();			// bytes may have arrived in the meantime
+
+		m_bTransferActive = FALSE;
+
+		nWriteStart = m_nWriteStart;
+		nWriteCount = m_nWriteCount;
+
+		// the prefetched bytes are not valid any more
+		RestartTransmit ();
+	}
+	else
+	{
+		FillTransmitFIFO ();
+	}
+
+	PeripheralExit ();
+
+	m_SpinLock.Release ();
+
+	if (   nWriteCount > 0
+	    && m_pWriteHandler != 0)
+	{
+		(*m_pWriteHandler) (nWriteStart, nWriteCount, m_pWriteParam);
+	}
+}
+
+void CI2CSlaveIRQ::InterruptStub (void *pParam)
+{
+	CI2CSlaveIRQ *pThis = (CI2CSlaveIRQ *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
+
+void CI2CSlaveIRQ::ReceiveFIFO (void)
+{
+	while (!(read32 (ARM_BSC_SPI_SLAVE_FR) & FR_RXFE))
+	{
+		u8 uchData = read32 (ARM_BSC_SPI_SLAVE_DR) & DR_DATA__MASK;
+
+		if (m_pRegisters != 0)
+		{
+			if (!m_bTransferActive)
+			{
+				// the first byte of a write transfer is the register pointer
+				m_bTransferActive = TRUE;
+
+				m_nPointer = uchData % m_nRegisterSize;
+				m_nWriteStart = m_nPointer;
+				m_nWriteCount = 0;
+			}
+			else
+			{
+				m_pRegisters[m_nPointer] = uchData;
+				m_nPointer = (m_nPointer + 1) % m_nRegisterSize;
+
+				m_nWriteCount++;
+			}
+		}
+		else
+		{
+			unsigned nNextIn = (m_nRxIn + 1) & RING_MASK;
+			if (nNextIn == m_nRxOut)
+			{
+				m_nErrors++;		// ring buffer overrun
+
+				continue;
+			}
+
+			m_RxRing[m_nRxIn] = uchData;
+
+			DataMemBarrier ();
+
+			m_nRxIn = nNextIn;
+		}
+	}
+}
+
+void CI2CSlaveIRQ::FillTransmitFIFO (void)
+{
+	if (m_pRegisters != 0)
+	{
+		while (!(read32 (ARM_BSC_SPI_SLAVE_FR) & FR_TXFF))
+		{
+			write32 (ARM_BSC_SPI_SLAVE_DR, m_pRegisters[m_nTxPointer]);
+			m_nTxPointer = (m_nTxPointer + 1) % m_nRegisterSize;
+		}
+
+		return;
+	}
+
+	while (   m_nTxOut != m_nTxIn
+	       && !(read32 (ARM_BSC_SPI_SLAVE_FR) & FR_TXFF))
+	{
+		DataMemBarrier ();
+
+		write32 (ARM_BSC_SPI_SLAVE_DR, m_TxRing[m_nTxOut]);
+
+		m_nTxOut = (m_nTxOut + 1) & RING_MASK;
+	}
+
+	// the TX interrupt is level triggered, enable it only if there is data to be sent
+	u32 nMask = read32 (ARM_BSC_SPI_SLAVE_IMSC);
+	if (m_nTxOut != m_nTxIn)
+	{
+		nMask |= IMSC_TXIM;
+	}
+	else
+	{
+		nMask &= ~IMSC_TXIM;
+	}
+
+	write32 (ARM_BSC_SPI_SLAVE_IMSC, nMask);
+}
+
+void CI2CSlaveIRQ::RestartTransmit (void)
+{
+	assert (m_pRegisters != 0);
+
+	// clear the FIFOs, the RX FIFO has been read before
+	u32 nCR = read32 (ARM_BSC_SPI_SLAVE_CR);
+	write32 (ARM_BSC_SPI_SLAVE_CR, nCR | CR_BRK);
+	write32 (ARM_BSC_SPI_SLAVE_CR, nCR & ~CR_BRK);
+
+	m_nTxPointer = m_nPointer;
+
+	FillTransmitFIFO ();
+}
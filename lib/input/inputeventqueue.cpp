@@ -0,0 +1,134 @@
+//
+// inputeventqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/input/inputeventqueue.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+// This is the bounded queue algorithm by Dmitry Vyukov (see CMPMCQueue) with one
+// consumer. The producers claim a cell with a compare-and-swap, so that events from
+// different contexts and cores can be added without a lock.
+
+CInputEventQueue *CInputEventQueue::s_pThis = 0;
+
+CInputEventQueue::CInputEventQueue (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_nEnqueuePos (0),
+	m_nDequeuePos (0),
+	m_nOverflows (0)
+{
+	assert (IS_POWEROF_2 (nSize));
+
+	m_pBuffer = new TCell[nSize];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < nSize; i++)
+	{
+		m_pBuffer[i].nSequence = i;
+	}
+
+	DataMemBarrier ();
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+}
+
+CInputEventQueue::~CInputEventQueue (void)
+{
+	s_pThis = 0;
+
+	DataMemBarrier ();
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+unsigned CInputEventQueue::Read (TInputEvent *pBuffer, unsigned nMaxEvents)
+{
+	assert (pBuffer != 0);
+
+	unsigned nEvents = 0;
+	while (nEvents < nMaxEvents)
+	{
+		TCell *pCell = &m_pBuffer[m_nDequeuePos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+		if ((int) (nSequence - (m_nDequeuePos+1)) < 0)
+		{
+			break;		// queue is empty or the next event is currently written
+		}
+
+		pBuffer[nEvents++] = pCell->Event;
+
+		__atomic_store_n (&pCell->nSequence, m_nDequeuePos + m_nMask + 1, __ATOMIC_RELEASE);
+
+		m_nDequeuePos++;
+	}
+
+	return nEvents;
+}
+
+boolean CInputEventQueue::Put (TInputEventType Type, unsigned nDevice, u16 usCode,
+			       int nValue1, int nValue2, int nValue3, u64 ullTimestamp)
+{
+	if (ullTimestamp == 0)
+	{
+		ullTimestamp = CTimer::GetClockTicks64 ();
+	}
+
+	TCell *pCell;
+	unsigned nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		pCell = &m_pBuffer[nPos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - nPos);
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&m_nEnqueuePos, &nPos, nPos+1, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (nDiff < 0)
+		{
+			__atomic_add_fetch (&m_nOverflows, 1, __ATOMIC_RELAXED);
+
+			return FALSE;		// queue is full
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	TInputEvent *pEvent = &pCell->Event;
+	pEvent->ullTimestamp = ullTimestamp;
+	pEvent->uchType = (u8) Type;
+	pEvent->uchDevice = (u8) nDevice;
+	pEvent->usCode = usCode;
+	pEvent->nValue[0] = nValue1;
+	pEvent->nValue[1] = nValue2;
+	pEvent->nValue[2] = nValue3;
+
+	__atomic_store_n (&pCell->nSequence, nPos+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
@@ -0,0 +1,135 @@
+//
+// inputring.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/input/inputring.h>
+#include <assert.h>
+
+// This is the queue algorithm of CInputEventQueue with characters in the cells. A
+// producer checks, that the last cell of the string is free (the cells are freed in
+// order by the consumer) and claims all cells with one compare-and-swap.
+
+CInputRing::CInputRing (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_nEnqueuePos (0),
+	m_nDequeuePos (0),
+	m_nOverflows (0)
+{
+	assert (IS_POWEROF_2 (nSize));
+
+	m_pBuffer = new TCell[nSize];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < nSize; i++)
+	{
+		m_pBuffer[i].nSequence = i;
+	}
+
+	DataMemBarrier ();
+}
+
+CInputRing::~CInputRing (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+int CInputRing::Read (void *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+	char *pChar = (char *) pBuffer;
+
+	int nResult = 0;
+	while (nCount > 0)
+	{
+		TCell *pCell = &m_pBuffer[m_nDequeuePos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+		if ((int) (nSequence - (m_nDequeuePos+1)) < 0)
+		{
+			break;		// ring is empty or the next character is currently written
+		}
+
+		*pChar++ = pCell->chChar;
+
+		__atomic_store_n (&pCell->nSequence, m_nDequeuePos + m_nMask + 1, __ATOMIC_RELEASE);
+
+		m_nDequeuePos++;
+
+		nCount--;
+		nResult++;
+	}
+
+	return nResult;
+}
+
+int CInputRing::Write (const void *pBuffer, size_t nCount)
+{
+	assert (pBuffer != 0);
+	const char *pChar = (const char *) pBuffer;
+
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	if (nCount > m_nMask+1)
+	{
+		__atomic_add_fetch (&m_nOverflows, nCount, __ATOMIC_RELAXED);
+
+		return 0;
+	}
+
+	unsigned nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		unsigned nLast = nPos + nCount-1;
+		TCell *pCell = &m_pBuffer[nLast & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - nLast);
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&m_nEnqueuePos, &nPos, nPos+nCount, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (nDiff < 0)
+		{
+			__atomic_add_fetch (&m_nOverflows, nCount, __ATOMIC_RELAXED);
+
+			return 0;		// ring is full
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	for (unsigned i = 0; i < nCount; i++, nPos++)
+	{
+		TCell *pCell = &m_pBuffer[nPos & m_nMask];
+
+		pCell->chChar = *pChar++;
+
+		__atomic_store_n (&pCell->nSequence, nPos+1, __ATOMIC_RELEASE);
+	}
+
+	return nCount;
+}
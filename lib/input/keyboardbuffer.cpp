@@ -2,7 +2,7 @@
 // keyboardbuffer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2017-2018  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2017-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,14 +18,14 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/input/keyboardbuffer.h>
+#include <circle/util.h>
 #include <assert.h>
 
 CKeyboardBuffer *CKeyboardBuffer::s_pThis = 0;
 
 CKeyboardBuffer::CKeyboardBuffer (CUSBKeyboardDevice *pKeyboard)
 :	m_pKeyboard (pKeyboard),
-	m_nInPtr (0),
-	m_nOutPtr (0)
+	m_Ring (KEYB_BUF_SIZE)
 {
 	assert (s_pThis == 0);
 	s_pThis = this;
@@ -44,22 +44,8 @@ CKeyboardBuffer::~CKeyboardBuffer (void)
 int CKeyboardBuffer::Read (void *pBuffer, size_t nCount)
 {
 	assert (pBuffer != 0);
-	char *p = (char *) pBuffer;
 
-	int nResult = 0;
-
-	m_SpinLock.Acquire ();
-
-	while (   nCount > 0
-	       && BufStat ())
-	{
-		*p++ = OutBuf ();
-
-		nCount--;
-		nResult++;
-	}
-
-	m_SpinLock.Release ();
+	int nResult = m_Ring.Read (pBuffer, nCount);
 
 	assert (m_pKeyboard != 0);
 	m_pKeyboard->UpdateLEDs ();
@@ -67,45 +53,10 @@ int CKeyboardBuffer::Read (void *pBuffer, size_t nCount)
 	return nResult;
 }
 
-void CKeyboardBuffer::InBuf (char chChar)
-{
-	if (((m_nInPtr+1) & KEYB_BUF_MASK) != m_nOutPtr)
-	{
-		m_Buffer[m_nInPtr] = chChar;
-
-		m_nInPtr = (m_nInPtr+1) & KEYB_BUF_MASK;
-	}
-}
-
-boolean CKeyboardBuffer::BufStat (void) const
-{
-	return m_nInPtr != m_nOutPtr ? TRUE : FALSE;
-}
-
-char CKeyboardBuffer::OutBuf (void)
-{
-	if (m_nInPtr == m_nOutPtr)
-	{
-		return '\0';
-	}
-
-	char chChar = m_Buffer[m_nOutPtr];
-
-	m_nOutPtr = (m_nOutPtr+1) & KEYB_BUF_MASK;
-
-	return chChar;
-}
-
 void CKeyboardBuffer::KeyPressedHandler (const char *pString)
 {
-	m_SpinLock.Acquire ();
-
-	while (*pString)
-	{
-		InBuf (*pString++);
-	}
-
-	m_SpinLock.Release ();
+	assert (pString != 0);
+	m_Ring.Write (pString, strlen (pString));
 }
 
 void CKeyboardBuffer::KeyPressedStub (const char *pString)
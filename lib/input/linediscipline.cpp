@@ -29,6 +29,8 @@ CLineDiscipline::CLineDiscipline (CDevice *pInputDevice, CDevice *pOutputDevice)
 	m_pInEnd (m_Buffer),
 	m_bInsert (TRUE),
 	m_pOutBufferPtr (m_OutBuffer),
+	m_nInCount (0),
+	m_nInIndex (0),
 	m_InputState (StateStart),
 	m_nHistorySize (0),
 	m_nHistoryIndex (0)
@@ -58,6 +60,14 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 			int nChar = GetChar ();
 			if (nChar <= 0)
 			{
+				if (   nChar == 0
+				    && m_nInIndex < m_nInCount)
+				{
+					continue;	// inside escape sequence
+				}
+
+				Flush ();	// echo of the whole input slice at once
+
 				return nChar;
 			}
 
@@ -90,8 +100,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 					{
 						PutChar ('\b');
 					}
-
-					Flush ();
 				}
 				break;
 
@@ -138,8 +146,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 					{
 						PutChar ('\b');
 					}
-
-					Flush ();
 				}
 				break;
 
@@ -148,8 +154,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 				{
 					m_pInPtr--;		// move cursor left
 					PutChar ('\b');
-
-					Flush ();
 				}
 				break;
 
@@ -157,8 +161,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 				if (m_pInPtr < m_pInEnd)	// if cursor not at end
 				{
 					PutChar (*m_pInPtr++);	// move cursor right
-
-					Flush ();
 				}
 				break;
 
@@ -168,8 +170,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 					m_pInPtr--;		// move cursor left
 					PutChar ('\b');
 				}
-
-				Flush ();
 				break;
 
 			case EscapeKeyEnd:
@@ -177,8 +177,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 				{
 					PutChar (*m_pInPtr++);	// move cursor right
 				}
-
-				Flush ();
 				break;
 
 			case EscapeKeyInsert:
@@ -196,7 +194,19 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 			default:
 				if (' ' <= nChar && nChar <= EscapeKeyStart)	// printable char?
 				{
-					if (m_bInsert)
+					if (m_pInPtr == m_pInEnd)	// fast path, cursor at end
+					{
+						if (m_pInEnd < &m_Buffer[MaxLine]) // buffer not full
+						{
+							*m_pInEnd++ = (char) nChar;
+							PutChar (nChar);
+
+							AppendRun ();
+
+							m_pInPtr = m_pInEnd;
+						}
+					}
+					else if (m_bInsert)
 					{
 						if (m_pInEnd < &m_Buffer[MaxLine]) // buffer not full
 						{
@@ -222,8 +232,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 							{
 								PutChar ('\b');
 							}
-
-							Flush ();
 						}
 					}
 					else
@@ -234,8 +242,6 @@ int CLineDiscipline::Read (void *pBuffer, size_t nCount)
 							*m_pInPtr++ = (char) nChar;
 							PutChar (nChar);
 
-							Flush ();
-
 							// enlarge edit buffer, if beyond end
 							if (m_pInPtr > m_pInEnd)
 							{
@@ -368,8 +374,6 @@ void CLineDiscipline::MoveHistory (int nBackFore)
 			PutChar ('\b');
 		}
 
-		Flush ();
-
 		// terminate edit buffer
 		*m_pInEnd++ = '\n';
 		*m_pInEnd = '\0';
@@ -394,23 +398,29 @@ void CLineDiscipline::MoveHistory (int nBackFore)
 
 				m_pInEnd++;
 			}
-
-			Flush ();
 		}
 	}
 }
 
 int CLineDiscipline::GetChar (void)
 {
-	assert (m_pInputDevice != 0);
+	if (m_nInIndex == m_nInCount)
+	{
+		assert (m_pInputDevice != 0);
+		int nResult = m_pInputDevice->Read (m_InBuffer, InBufferSize);
+		if (nResult <= 0)
+		{
+			return nResult;
+		}
+
+		assert (nResult <= (int) InBufferSize);
+		m_nInCount = nResult;
+		m_nInIndex = 0;
+	}
 
-	unsigned char chChar;
-	int nResult = m_pInputDevice->Read (&chChar, sizeof chChar);
+	int nResult = m_InBuffer[m_nInIndex++];
 	if (nResult > 0)
 	{
-		assert (nResult == sizeof chChar);
-		nResult = chChar;
-
 		if (m_Mode == LineModeRaw)
 		{
 			return nResult;
@@ -557,6 +567,32 @@ int CLineDiscipline::GetChar (void)
 	return nResult;
 }
 
+void CLineDiscipline::AppendRun (void)
+{
+	assert (m_pInPtr == m_pInEnd);
+
+	if (m_InputState != StateStart)
+	{
+		return;
+	}
+
+	while (   m_nInIndex < m_nInCount
+	       && m_pInEnd < &m_Buffer[MaxLine])
+	{
+		char chChar = (char) m_InBuffer[m_nInIndex];
+		if (   (unsigned char) chChar < ' '
+		    || chChar == '\x7F')
+		{
+			break;
+		}
+
+		*m_pInEnd++ = chChar;
+		PutChar (chChar);
+
+		m_nInIndex++;
+	}
+}
+
 void CLineDiscipline::PutChar (int nChar)
 {
 	if (m_bEcho)
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/input/mouse.h>
+#include <circle/input/inputeventqueue.h>
 #include <circle/devicenameservice.h>
 #include <assert.h>
 
@@ -99,8 +100,16 @@ void CMouseDevice::RegisterStatusHandler (TMouseStatusHandler *pStatusHandler)
 }
 
 
-void CMouseDevice::ReportHandler (unsigned nButtons, int nDisplacementX, int nDisplacementY, int nWheelMove)
+void CMouseDevice::ReportHandler (unsigned nButtons, int nDisplacementX, int nDisplacementY, int nWheelMove,
+				  u64 ullTimestamp)
 {
+	CInputEventQueue *pQueue = CInputEventQueue::Get ();
+	if (pQueue != 0)
+	{
+		pQueue->Put (InputEventMouse, m_nDeviceNumber, (u16) nButtons,
+			     nDisplacementX, nDisplacementY, nWheelMove, ullTimestamp);
+	}
+
 	m_Behaviour.MouseStatusChanged (nButtons, nDisplacementX, nDisplacementY, nWheelMove);
 
 	if (m_pStatusHandler != 0)
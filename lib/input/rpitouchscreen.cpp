@@ -47,19 +47,27 @@ static const char FromFT5406[] = "ft5406";
 CRPiTouchScreen::CRPiTouchScreen (void)
 :	m_pFT5406Buffer (0),
 	m_nKnownIDs (0),
-	m_pDevice (0)
+	m_pDevice (0),
+	m_nUpdateIntervalUs (0),
+	m_hUpdateTimer (0)
 {
 }
 
 CRPiTouchScreen::~CRPiTouchScreen (void)
 {
+	if (m_hUpdateTimer != 0)
+	{
+		CTimer::Get ()->CancelKernelTimer (m_hUpdateTimer);
+		m_hUpdateTimer = 0;
+	}
+
 	delete m_pDevice;
 	m_pDevice = 0;
 
 	m_pFT5406Buffer = 0;
 }
 
-boolean CRPiTouchScreen::Initialize (void)
+boolean CRPiTouchScreen::Initialize (unsigned nUpdateIntervalUs)
 {
 	assert (m_pFT5406Buffer == 0);
 
@@ -95,6 +103,14 @@ boolean CRPiTouchScreen::Initialize (void)
 	m_pDevice = new CTouchScreenDevice (UpdateStub, this);
 	assert (m_pDevice != 0);
 
+	// the firmware writes the touch points to the buffer, no mailbox call needed here
+	m_nUpdateIntervalUs = nUpdateIntervalUs;
+	if (m_nUpdateIntervalUs != 0)
+	{
+		m_hUpdateTimer = CTimer::Get ()->StartKernelTimerUs (m_nUpdateIntervalUs,
+								     TimerHandler, this);
+	}
+
 	return TRUE;
 }
 
@@ -115,6 +131,8 @@ void CRPiTouchScreen::Update (void)
 
 	*(volatile u8 *) &m_pFT5406Buffer->NumPoints = 99;
 
+	u64 ullTimestamp = CTimer::GetClockTicks64 ();
+
 	// Do not output if theres no new information (NumPoints is 99)
 	// or we have no touch points and don't need to release any
 	if (   Regs.NumPoints == 99
@@ -146,7 +164,8 @@ void CRPiTouchScreen::Update (void)
 				m_nPosX[nTouchID] = x;
 				m_nPosY[nTouchID] = y;
 
-				m_pDevice->ReportHandler (TouchScreenEventFingerDown, nTouchID, x, y);
+				m_pDevice->ReportHandler (TouchScreenEventFingerDown, nTouchID, x, y,
+							  ullTimestamp);
 			}
 			else
 			{
@@ -157,7 +176,7 @@ void CRPiTouchScreen::Update (void)
 					m_nPosY[nTouchID] = y;
 
 					m_pDevice->ReportHandler (TouchScreenEventFingerMove,
-								  nTouchID, x, y);
+								  nTouchID, x, y, ullTimestamp);
 				}
 			}
 		}
@@ -168,7 +187,7 @@ void CRPiTouchScreen::Update (void)
 	{
 		if (nReleasedIDs & (1 << i))
 		{
-			m_pDevice->ReportHandler (TouchScreenEventFingerUp, i, 0, 0);
+			m_pDevice->ReportHandler (TouchScreenEventFingerUp, i, 0, 0, ullTimestamp);
 
 			nModifiedIDs &= ~(1 << i);
 		}
@@ -182,5 +201,19 @@ void CRPiTouchScreen::UpdateStub (void *pParam)
 	CRPiTouchScreen *pThis = static_cast<CRPiTouchScreen *> (pParam);
 	assert (pThis != 0);
 
+	if (pThis->m_nUpdateIntervalUs == 0)
+	{
+		pThis->Update ();
+	}
+}
+
+void CRPiTouchScreen::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CRPiTouchScreen *pThis = static_cast<CRPiTouchScreen *> (pParam);
+	assert (pThis != 0);
+
 	pThis->Update ();
+
+	pThis->m_hUpdateTimer = CTimer::Get ()->StartKernelTimerUs (pThis->m_nUpdateIntervalUs,
+								    TimerHandler, pThis);
 }
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/input/touchscreen.h>
+#include <circle/input/inputeventqueue.h>
 #include <circle/devicenameservice.h>
 #include <assert.h>
 
@@ -113,29 +114,53 @@ boolean CTouchScreenDevice::SetCalibration (const unsigned Coords[4])
 }
 
 void CTouchScreenDevice::ReportHandler (TTouchScreenEvent Event,
-					unsigned nID, unsigned nPosX, unsigned nPosY)
+					unsigned nID, unsigned nPosX, unsigned nPosY,
+					u64 ullTimestamp)
 {
-	if (m_pEventHandler != 0)
+	CInputEventQueue *pQueue = CInputEventQueue::Get ();
+	if (   m_pEventHandler == 0
+	    && pQueue == 0)
 	{
-		if (Event != TouchScreenEventFingerUp)
+		return;
+	}
+
+	if (Event != TouchScreenEventFingerUp)
+	{
+		nPosX = nPosX * m_nScaleX/1000 - m_nOffsetX;
+		nPosY = nPosY * m_nScaleY/1000 - m_nOffsetY;
+
+		assert (m_pDisplay);
+		nPosX -= m_pDisplay->GetOffsetX ();
+		nPosY -= m_pDisplay->GetOffsetY ();
+
+		if (   m_bIsCalibrated
+		    && (   nPosX >= m_pDisplay->GetWidth ()
+			|| nPosY >= m_pDisplay->GetHeight ()))
 		{
-			nPosX = nPosX * m_nScaleX/1000 - m_nOffsetX;
-			nPosY = nPosY * m_nScaleY/1000 - m_nOffsetY;
-
-			assert (m_pDisplay);
-			nPosX -= m_pDisplay->GetOffsetX ();
-			nPosY -= m_pDisplay->GetOffsetY ();
-
-			if (   !m_bIsCalibrated
-			    || (   nPosX < m_pDisplay->GetWidth ()
-				&& nPosY < m_pDisplay->GetHeight ()))
-			{
-				(*m_pEventHandler) (Event, nID, nPosX, nPosY);
-			}
+			return;
 		}
-		else
+	}
+	else
+	{
+		nPosX = 0;
+		nPosY = 0;
+	}
+
+	if (pQueue != 0)
+	{
+		static const TInputEventType Type[] =
 		{
-			(*m_pEventHandler) (Event, nID, 0, 0);
-		}
+			InputEventTouchDown,
+			InputEventTouchUp,
+			InputEventTouchMove,
+			InputEventUnknown
+		};
+
+		pQueue->Put (Type[Event], m_nDeviceNumber, (u16) nID, nPosX, nPosY, 0, ullTimestamp);
+	}
+
+	if (m_pEventHandler != 0)
+	{
+		(*m_pEventHandler) (Event, nID, nPosX, nPosY);
 	}
 }
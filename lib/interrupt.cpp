@@ -2,7 +2,7 @@
 // interrupt.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -23,6 +23,7 @@
 #include <circle/bcm2835.h>
 #include <circle/bcm2836.h>
 #include <circle/memio.h>
+#include <circle/tracer.h>
 #include <circle/sysconfig.h>
 #include <circle/types.h>
 #include <assert.h>
@@ -48,6 +49,10 @@
 				   
 CInterruptSystem *CInterruptSystem::s_pThis = 0;
 
+#ifdef USE_SCHEDULER_PREEMPTION
+TIRQReturnHandler *CInterruptSystem::s_pIRQReturnHandler = 0;
+#endif
+
 CInterruptSystem::CInterruptSystem (void)
 {
 	if (s_pThis != 0)
@@ -220,9 +225,17 @@ void CInterruptSystem::EnableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
-		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) | (1 << 1));
+		if (nIRQ == ARM_IRQLOCAL0_PMU)
+		{
+			// the PMU IRQ is routed for the calling core only
+			write32 (ARM_LOCAL_PM_ROUTING_SET, 1 << ThisCore ());
+		}
+		else
+		{
+			assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);
+			write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
+				 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) | (1 << 1));
+		}
 #else
 		assert (0);
 #endif
@@ -244,9 +257,16 @@ void CInterruptSystem::DisableIRQ (unsigned nIRQ)
 	else
 	{
 #if RASPPI >= 2
-		assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);	// the only implemented local IRQ so far
-		write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
-			 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) & ~(1 << 1));
+		if (nIRQ == ARM_IRQLOCAL0_PMU)
+		{
+			write32 (ARM_LOCAL_PM_ROUTING_CLR, 1 << ThisCore ());
+		}
+		else
+		{
+			assert (nIRQ == ARM_IRQLOCAL0_CNTPNS);
+			write32 (ARM_LOCAL_TIMER_INT_CONTROL0,
+				 read32 (ARM_LOCAL_TIMER_INT_CONTROL0) & ~(1 << 1));
+		}
 #else
 		assert (0);
 #endif
@@ -275,12 +295,39 @@ void CInterruptSystem::DisableFIQ (void)
 	PeripheralExit ();
 }
 
+boolean CInterruptSystem::SetIRQAffinity (unsigned nIRQ, unsigned nCore)
+{
+	assert (nIRQ < IRQ_LINES);
+
+	// the legacy interrupt controller routes all peripheral IRQs to the same core
+	return nCore == 0;
+}
+
+boolean CInterruptSystem::SetIRQTrigger (unsigned nIRQ, boolean bEdgeTriggered)
+{
+	assert (nIRQ < IRQ_LINES);
+
+	// the legacy interrupt controller has level triggered IRQs only
+	return !bEdgeTriggered;
+}
+
 CInterruptSystem *CInterruptSystem::Get (void)
 {
 	assert (s_pThis != 0);
 	return s_pThis;
 }
 
+#ifdef USE_SCHEDULER_PREEMPTION
+
+void CInterruptSystem::RegisterIRQReturnHandler (TIRQReturnHandler *pHandler)
+{
+	assert (s_pIRQReturnHandler == 0 || s_pIRQReturnHandler == pHandler);
+	s_pIRQReturnHandler = pHandler;
+	assert (s_pIRQReturnHandler != 0);
+}
+
+#endif
+
 boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 {
 	assert (nIRQ < IRQ_LINES);
@@ -288,7 +335,11 @@ boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 
 	if (pHandler != 0)
 	{
+		TRACE_SYSTEM_EVENT (TRACER_EVENT_IRQ_ENTER, nIRQ);
+
 		(*pHandler) (m_pParam[nIRQ]);
+
+		TRACE_SYSTEM_EVENT (TRACER_EVENT_IRQ_EXIT, nIRQ);
 		
 		return TRUE;
 	}
@@ -306,13 +357,21 @@ void CInterruptSystem::InterruptHandler (void)
 
 #if RASPPI >= 2
 	u32 nLocalPending = read32 (ARM_LOCAL_IRQ_PENDING0);
-	assert (!(nLocalPending & ~(1 << 1 | 0xF << 4 | 1 << 8)));
-	if (nLocalPending & (1 << 1))		// the only implemented local IRQ so far
+	assert (!(nLocalPending & ~(1 << 1 | 0xF << 4 | 1 << 8 | 1 << 9)));
+	if (nLocalPending & (1 << 1))
 	{
 		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_CNTPNS);
 
 		return;
 	}
+
+	// the PMU IRQ is pending in the register of the interrupted core
+	if (read32 (ARM_LOCAL_IRQ_PENDING0 + 4 * ThisCore ()) & (1 << 9))
+	{
+		s_pThis->CallIRQHandler (ARM_IRQLOCAL0_PMU);
+
+		return;
+	}
 #endif
 
 #ifdef ARM_ALLOW_MULTI_CORE
@@ -361,4 +420,8 @@ void InterruptHandler (void)
 	CInterruptSystem::InterruptHandler ();
 
 	PeripheralEntry ();	// continuing with interrupted peripheral
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	CInterruptSystem::CallIRQReturnHandler ();
+#endif
 }
@@ -4,7 +4,7 @@
 // Driver for the GIC-400 interrupt controller of the Raspberry Pi 4
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2019-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2019-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -24,6 +24,7 @@
 #include <circle/multicore.h>
 #include <circle/bcm2711.h>
 #include <circle/memio.h>
+#include <circle/tracer.h>
 #include <circle/logger.h>
 #include <circle/sysconfig.h>
 #include <circle/southbridge.h>
@@ -53,6 +54,7 @@
 	#define GICD_IPRIORITYR_FIQ	0x40
 #define GICD_ITARGETSR0		(ARM_GICD_BASE + 0x800)
 	#define GICD_ITARGETSR_CORE0	(1 << 0)
+	#define GICD_ITARGETSR_CORE(n)	(1 << (n))
 #define GICD_ICFGR0		(ARM_GICD_BASE + 0xC00)
 	#define GICD_ICFGR_LEVEL_SENSITIVE	(0 << 1)
 	#define GICD_ICFGR_EDGE_TRIGGERED	(1 << 1)
@@ -88,6 +90,10 @@ enum TSMCFunction
 
 CInterruptSystem *CInterruptSystem::s_pThis = 0;
 
+#ifdef USE_SCHEDULER_PREEMPTION
+TIRQReturnHandler *CInterruptSystem::s_pIRQReturnHandler = 0;
+#endif
+
 CInterruptSystem::CInterruptSystem (void)
 {
 	if (s_pThis != 0)
@@ -101,6 +107,15 @@ CInterruptSystem::CInterruptSystem (void)
 		m_apIRQHandler[nIRQ] = 0;
 		m_pParam[nIRQ] = 0;
 	}
+
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		for (unsigned nIRQ = 0; nIRQ < IRQ_PRIVATE_LINES; nIRQ++)
+		{
+			m_apPrivateIRQHandler[nCore][nIRQ] = 0;
+			m_pPrivateParam[nCore][nIRQ] = 0;
+		}
+	}
 }
 
 CInterruptSystem::~CInterruptSystem (void)
@@ -216,12 +231,23 @@ void CInterruptSystem::ConnectIRQ (unsigned nIRQ, TIRQHandler *pHandler, void *p
 #endif
 
 	assert (nIRQ < IRQ_LINES);
-	assert (m_apIRQHandler[nIRQ] == 0);
+	if (nIRQ < IRQ_PRIVATE_LINES)
+	{
+		unsigned nCore = ThisCore ();
+		assert (m_apPrivateIRQHandler[nCore][nIRQ] == 0);
 
-	m_apIRQHandler[nIRQ] = pHandler;
-	m_pParam[nIRQ] = pParam;
+		m_apPrivateIRQHandler[nCore][nIRQ] = pHandler;
+		m_pPrivateParam[nCore][nIRQ] = pParam;
+	}
+	else
+	{
+		assert (m_apIRQHandler[nIRQ] == 0);
+
+		m_apIRQHandler[nIRQ] = pHandler;
+		m_pParam[nIRQ] = pParam;
+	}
 
-	EnableIRQ (nIRQ);
+	EnableIRQ (nIRQ);		// PPIs are enabled for the calling core only
 }
 
 void CInterruptSystem::DisconnectIRQ (unsigned nIRQ)
@@ -246,12 +272,83 @@ void CInterruptSystem::DisconnectIRQ (unsigned nIRQ)
 #endif
 
 	assert (nIRQ < IRQ_LINES);
-	assert (m_apIRQHandler[nIRQ] != 0);
 
 	DisableIRQ (nIRQ);
 
-	m_apIRQHandler[nIRQ] = 0;
-	m_pParam[nIRQ] = 0;
+	if (nIRQ < IRQ_PRIVATE_LINES)
+	{
+		unsigned nCore = ThisCore ();
+		assert (m_apPrivateIRQHandler[nCore][nIRQ] != 0);
+
+		m_apPrivateIRQHandler[nCore][nIRQ] = 0;
+		m_pPrivateParam[nCore][nIRQ] = 0;
+	}
+	else
+	{
+		assert (m_apIRQHandler[nIRQ] != 0);
+
+		m_apIRQHandler[nIRQ] = 0;
+		m_pParam[nIRQ] = 0;
+	}
+}
+
+boolean CInterruptSystem::SetIRQAffinity (unsigned nIRQ, unsigned nCore)
+{
+	if (s_pThis != this)
+	{
+		return s_pThis->SetIRQAffinity (nIRQ, nCore);
+	}
+
+#if RASPPI >= 5
+	if (nIRQ & IRQ_FROM_RP1__MASK)
+	{
+		return nCore == 0;	// RP1 IRQs are cascaded through one SPI, which stays on core 0
+	}
+#endif
+
+	assert (nIRQ < IRQ_LINES);
+	assert (nCore < CORES);
+	if (nIRQ < IRQ_PRIVATE_LINES)
+	{
+		return FALSE;
+	}
+
+	// the target registers are byte accessible
+	write8 (GICD_ITARGETSR0 + nIRQ, GICD_ITARGETSR_CORE (nCore));
+
+	return TRUE;
+}
+
+boolean CInterruptSystem::SetIRQTrigger (unsigned nIRQ, boolean bEdgeTriggered)
+{
+	if (s_pThis != this)
+	{
+		return s_pThis->SetIRQTrigger (nIRQ, bEdgeTriggered);
+	}
+
+#if RASPPI >= 5
+	if (nIRQ & IRQ_FROM_RP1__MASK)
+	{
+		return !bEdgeTriggered;	// the cascading SPI of RP1 is level triggered
+	}
+#endif
+
+	assert (nIRQ < IRQ_LINES);
+	if (nIRQ < IRQ_PRIVATE_LINES)
+	{
+		return FALSE;
+	}
+
+	// two configuration bits per IRQ, the IRQ must be disabled, while it is changed
+	uintptr nReg = GICD_ICFGR0 + 4 * (nIRQ / 16);
+	unsigned nShift = (nIRQ % 16) * 2;
+
+	u32 nConfig = read32 (nReg);
+	nConfig &= ~(GICD_ICFGR_EDGE_TRIGGERED << nShift);
+	nConfig |= (bEdgeTriggered ? GICD_ICFGR_EDGE_TRIGGERED : GICD_ICFGR_LEVEL_SENSITIVE) << nShift;
+	write32 (nReg, nConfig);
+
+	return TRUE;
 }
 
 void CInterruptSystem::ConnectFIQ (unsigned nFIQ, TFIQHandler *pHandler, void *pParam)
@@ -369,14 +466,41 @@ CInterruptSystem *CInterruptSystem::Get (void)
 	return s_pThis;
 }
 
+#ifdef USE_SCHEDULER_PREEMPTION
+
+void CInterruptSystem::RegisterIRQReturnHandler (TIRQReturnHandler *pHandler)
+{
+	assert (s_pIRQReturnHandler == 0 || s_pIRQReturnHandler == pHandler);
+	s_pIRQReturnHandler = pHandler;
+	assert (s_pIRQReturnHandler != 0);
+}
+
+#endif
+
 boolean CInterruptSystem::CallIRQHandler (unsigned nIRQ)
 {
 	assert (nIRQ < IRQ_LINES);
-	TIRQHandler *pHandler = m_apIRQHandler[nIRQ];
+	TIRQHandler *pHandler;
+	void *pParam;
+	if (nIRQ < IRQ_PRIVATE_LINES)
+	{
+		unsigned nCore = ThisCore ();
+		pHandler = m_apPrivateIRQHandler[nCore][nIRQ];
+		pParam = m_pPrivateParam[nCore][nIRQ];
+	}
+	else
+	{
+		pHandler = m_apIRQHandler[nIRQ];
+		pParam = m_pParam[nIRQ];
+	}
 
 	if (pHandler != 0)
 	{
-		(*pHandler) (m_pParam[nIRQ]);
+		TRACE_SYSTEM_EVENT (TRACER_EVENT_IRQ_ENTER, nIRQ);
+
+		(*pHandler) (pParam);
+
+		TRACE_SYSTEM_EVENT (TRACER_EVENT_IRQ_EXIT, nIRQ);
 		
 		return TRUE;
 	}
@@ -395,9 +519,10 @@ void CInterruptSystem::InterruptHandler (void)
 	unsigned nIRQ = nIAR & GICC_IAR_INTERRUPT_ID__MASK;
 	if (nIRQ < IRQ_LINES)
 	{
-		if (nIRQ > 15)
+		if (   nIRQ > 15
+		    || nIRQ == ARM_IRQ_SOFTIRQ)
 		{
-			// peripheral interrupts (PPI and SPI)
+			// peripheral interrupts (PPI and SPI) and SGI of CSoftIRQ
 			assert (s_pThis != 0);
 			s_pThis->CallIRQHandler (nIRQ);
 		}
@@ -424,6 +549,10 @@ void CInterruptSystem::InterruptHandler (void)
 void InterruptHandler (void)
 {
 	CInterruptSystem::InterruptHandler ();
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	CInterruptSystem::CallIRQReturnHandler ();	// the IRQ has been acknowledged above
+#endif
 }
 
 void CInterruptSystem::InitializeSecondary (void)
@@ -0,0 +1,267 @@
+//
+// jobpool.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/jobpool.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+
+#include <circle/atomic.h>
+#include <assert.h>
+
+CJobPool::CJobPool (void)
+:	m_nQueued (0),
+	m_nPending (0),
+	m_bStop (FALSE)
+{
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		m_Queue[nCore].nHead = 0;
+		m_Queue[nCore].nTail = 0;
+
+		m_bSleeping[nCore] = FALSE;
+	}
+}
+
+CJobPool::~CJobPool (void)
+{
+	assert (m_nPending == 0);
+}
+
+void CJobPool::RunWorker (void)
+{
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+
+	while (!m_bStop)
+	{
+		if (ExecuteOne (nCore))
+		{
+			continue;
+		}
+
+		m_bSleeping[nCore] = TRUE;
+		DataMemBarrier ();
+
+		// check again, a job may have been submitted in the meantime
+		if (   AtomicGet (&m_nQueued) == 0
+		    && !m_bStop)
+		{
+			WaitForEvent ();
+		}
+
+		m_bSleeping[nCore] = FALSE;
+	}
+}
+
+void CJobPool::Stop (void)
+{
+	m_bStop = TRUE;
+	DataMemBarrier ();
+
+	WakeWorkers ();
+}
+
+void CJobPool::Submit (TJobFunction *pFunction, void *pParam)
+{
+	assert (pFunction != 0);
+
+	TJob Job;
+	Job.pFunction = pFunction;
+	Job.pForFunction = 0;
+	Job.pParam = pParam;
+	Job.nBegin = 0;
+	Job.nEnd = 0;
+
+	Push (Job);
+
+	WakeWorkers ();
+}
+
+void CJobPool::ParallelFor (unsigned nBegin, unsigned nEnd, unsigned nGrainSize,
+			    TParallelForFunction *pFunction, void *pParam)
+{
+	assert (pFunction != 0);
+	assert (nGrainSize > 0);
+
+	TJob Job;
+	Job.pFunction = 0;
+	Job.pForFunction = pFunction;
+	Job.pParam = pParam;
+
+	for (unsigned i = nBegin; i < nEnd; i += nGrainSize)
+	{
+		Job.nBegin = i;
+		Job.nEnd = nEnd - i > nGrainSize ? i + nGrainSize : nEnd;
+
+		Push (Job);
+
+		// wake the other cores early, so that they can start with the first jobs
+		if (i == nBegin)
+		{
+			WakeWorkers ();
+		}
+	}
+
+	WaitAll ();
+}
+
+void CJobPool::WaitAll (void)
+{
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+
+	while (AtomicGet (&m_nPending) != 0)
+	{
+		ExecuteOne (nCore);
+	}
+}
+
+void CJobPool::Push (const TJob &rJob)
+{
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+	TQueue *pQueue = &m_Queue[nCore];
+
+	pQueue->SpinLock.Acquire ();
+
+	if (pQueue->nTail - pQueue->nHead >= JOB_POOL_QUEUE_SIZE)
+	{
+		pQueue->SpinLock.Release ();
+
+		Execute (rJob);		// queue is full, execute the job directly
+
+		return;
+	}
+
+	pQueue->Job[pQueue->nTail & (JOB_POOL_QUEUE_SIZE-1)] = rJob;
+	pQueue->nTail++;
+
+	AtomicIncrement (&m_nPending);
+	AtomicIncrement (&m_nQueued);
+
+	pQueue->SpinLock.Release ();
+}
+
+boolean CJobPool::ExecuteOne (unsigned nCore)
+{
+	if (AtomicGet (&m_nQueued) == 0)
+	{
+		return FALSE;
+	}
+
+	TJob Job;
+	if (   !Take (nCore, &Job)
+	    && !Steal (nCore, &Job))
+	{
+		return FALSE;
+	}
+
+	Execute (Job);
+
+	AtomicDecrement (&m_nPending);
+
+	return TRUE;
+}
+
+boolean CJobPool::Take (unsigned nCore, TJob *pJob)
+{
+	assert (nCore < CORES);
+	TQueue *pQueue = &m_Queue[nCore];
+
+	if (pQueue->nTail == pQueue->nHead)
+	{
+		return FALSE;
+	}
+
+	pQueue->SpinLock.Acquire ();
+
+	if (pQueue->nTail == pQueue->nHead)
+	{
+		pQueue->SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	pQueue->nTail--;
+	*pJob = pQueue->Job[pQueue->nTail & (JOB_POOL_QUEUE_SIZE-1)];
+
+	AtomicDecrement (&m_nQueued);
+
+	pQueue->SpinLock.Release ();
+
+	return TRUE;
+}
+
+boolean CJobPool::Steal (unsigned nCore, TJob *pJob)
+{
+	for (unsigned i = 1; i < CORES; i++)
+	{
+		TQueue *pQueue = &m_Queue[(nCore + i) & (CORES-1)];
+
+		if (pQueue->nTail == pQueue->nHead)
+		{
+			continue;
+		}
+
+		pQueue->SpinLock.Acquire ();
+
+		if (pQueue->nTail != pQueue->nHead)
+		{
+			*pJob = pQueue->Job[pQueue->nHead & (JOB_POOL_QUEUE_SIZE-1)];
+			pQueue->nHead++;
+
+			AtomicDecrement (&m_nQueued);
+
+			pQueue->SpinLock.Release ();
+
+			return TRUE;
+		}
+
+		pQueue->SpinLock.Release ();
+	}
+
+	return FALSE;
+}
+
+void CJobPool::Execute (const TJob &rJob)
+{
+	if (rJob.pFunction != 0)
+	{
+		(*rJob.pFunction) (rJob.pParam);
+	}
+	else
+	{
+		assert (rJob.pForFunction != 0);
+		(*rJob.pForFunction) (rJob.nBegin, rJob.nEnd, rJob.pParam);
+	}
+}
+
+void CJobPool::WakeWorkers (void)
+{
+	DataMemBarrier ();
+
+	unsigned nThisCore = CMultiCoreSupport::ThisCore ();
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		if (   nCore != nThisCore
+		    && m_bSleeping[nCore])
+		{
+			CMultiCoreSupport::SendIPI (nCore, IPI_WAKE_CORE);
+		}
+	}
+}
+
+#endif
@@ -0,0 +1,246 @@
+//
+// latencymonitor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/latencymonitor.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+LOGMODULE ("latency");
+
+static const char *s_pSourceName[LatencySourceUnknown] =
+{
+	"IRQ entry",
+	"Task wakeup",
+	"Dispatch"
+};
+
+CLatencyMonitor *CLatencyMonitor::s_pThis = 0;
+
+CLatencyMonitor::CLatencyMonitor (void)
+{
+	Reset ();
+
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+#ifndef LATENCY_MONITOR
+	LOGWARN ("System option LATENCY_MONITOR is not enabled");
+#endif
+}
+
+CLatencyMonitor::~CLatencyMonitor (void)
+{
+	s_pThis = 0;
+
+	DataMemBarrier ();
+}
+
+void CLatencyMonitor::Reset (void)
+{
+	for (unsigned nCore = 0; nCore < LATENCY_MONITOR_CORES; nCore++)
+	{
+		for (unsigned nSource = 0; nSource < LatencySourceUnknown; nSource++)
+		{
+			THistogram *pHistogram = &m_Histogram[nCore][nSource];
+
+			memset (pHistogram->nBucket, 0, sizeof pHistogram->nBucket);
+			pHistogram->nCount = 0;
+			pHistogram->nMin = (unsigned) -1;
+			pHistogram->nMax = 0;
+		}
+	}
+
+	DataMemBarrier ();
+}
+
+void CLatencyMonitor::AddSample (TLatencySource Source, unsigned nNanoSeconds)
+{
+	assert (Source < LatencySourceUnknown);
+
+	// each source is recorded from one execution level only, so no lock is needed
+#ifdef ARM_ALLOW_MULTI_CORE
+	THistogram *pHistogram = &m_Histogram[CMultiCoreSupport::ThisCore ()][Source];
+#else
+	THistogram *pHistogram = &m_Histogram[0][Source];
+#endif
+
+	pHistogram->nBucket[GetBucket (nNanoSeconds)]++;
+	pHistogram->nCount++;
+
+	if (nNanoSeconds < pHistogram->nMin)
+	{
+		pHistogram->nMin = nNanoSeconds;
+	}
+
+	if (nNanoSeconds > pHistogram->nMax)
+	{
+		pHistogram->nMax = nNanoSeconds;
+	}
+}
+
+void CLatencyMonitor::GetStatistics (TLatencySource Source, TLatencyStatistics *pStatistics) const
+{
+	assert (Source < LatencySourceUnknown);
+	assert (pStatistics != 0);
+
+	Merge (Source, &pStatistics->nCount, &pStatistics->nMin, &pStatistics->nMax);
+
+	if (pStatistics->nCount == 0)
+	{
+		pStatistics->nMin = 0;
+	}
+
+	pStatistics->nP50 = FindPercentile (Source, pStatistics->nCount, 500);
+	pStatistics->nP99 = FindPercentile (Source, pStatistics->nCount, 990);
+	pStatistics->nP999 = FindPercentile (Source, pStatistics->nCount, 999);
+}
+
+unsigned CLatencyMonitor::GetPercentile (TLatencySource Source, unsigned nPerMille) const
+{
+	assert (Source < LatencySourceUnknown);
+	assert (nPerMille <= 1000);
+
+	u64 nCount;
+	unsigned nMin, nMax;
+	Merge (Source, &nCount, &nMin, &nMax);
+
+	return FindPercentile (Source, nCount, nPerMille);
+}
+
+void CLatencyMonitor::Dump (void) const
+{
+	for (unsigned nSource = 0; nSource < LatencySourceUnknown; nSource++)
+	{
+		TLatencyStatistics Stat;
+		GetStatistics ((TLatencySource) nSource, &Stat);
+
+		if (Stat.nCount == 0)
+		{
+			LOGNOTE ("%-12s no samples", s_pSourceName[nSource]);
+
+			continue;
+		}
+
+#define US(ns)	(ns) / 1000, (ns) % 1000 / 100		// format as "%u.%u" us
+
+		LOGNOTE ("%-12s n %u min %u.%u p50 %u.%u p99 %u.%u p99.9 %u.%u max %u.%u us",
+			 s_pSourceName[nSource], (unsigned) Stat.nCount,
+			 US (Stat.nMin), US (Stat.nP50), US (Stat.nP99), US (Stat.nP999),
+			 US (Stat.nMax));
+	}
+}
+
+const char *CLatencyMonitor::GetSourceName (TLatencySource Source)
+{
+	assert (Source < LatencySourceUnknown);
+
+	return s_pSourceName[Source];
+}
+
+void CLatencyMonitor::Merge (TLatencySource Source, u64 *pCount, unsigned *pMin,
+			     unsigned *pMax) const
+{
+	*pCount = 0;
+	*pMin = (unsigned) -1;
+	*pMax = 0;
+
+	for (unsigned nCore = 0; nCore < LATENCY_MONITOR_CORES; nCore++)
+	{
+		const THistogram *pHistogram = &m_Histogram[nCore][Source];
+
+		*pCount += pHistogram->nCount;
+
+		if (pHistogram->nMin < *pMin)
+		{
+			*pMin = pHistogram->nMin;
+		}
+
+		if (pHistogram->nMax > *pMax)
+		{
+			*pMax = pHistogram->nMax;
+		}
+	}
+}
+
+unsigned CLatencyMonitor::FindPercentile (TLatencySource Source, u64 nCount,
+					  unsigned nPerMille) const
+{
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	// number of samples, which must be less or equal the result (rounded up)
+	u64 nWanted = (nCount * nPerMille + 999) / 1000;
+	if (nWanted == 0)
+	{
+		nWanted = 1;
+	}
+
+	u64 nSum = 0;
+	for (unsigned nBucket = 0; nBucket < LATENCY_BUCKETS; nBucket++)
+	{
+		for (unsigned nCore = 0; nCore < LATENCY_MONITOR_CORES; nCore++)
+		{
+			nSum += m_Histogram[nCore][Source].nBucket[nBucket];
+		}
+
+		if (nSum >= nWanted)
+		{
+			return GetBucketLimit (nBucket);
+		}
+	}
+
+	// the histograms have been modified while reading
+	return GetBucketLimit (LATENCY_BUCKETS-1);
+}
+
+unsigned CLatencyMonitor::GetBucket (unsigned nNanoSeconds)
+{
+	if (nNanoSeconds < LATENCY_LINEAR_BUCKETS)
+	{
+		return nNanoSeconds;
+	}
+
+	// 16 <= nNanoSeconds, so nExponent is 4..31
+	unsigned nExponent = 31 - __builtin_clz (nNanoSeconds);
+	unsigned nSubBucket = (nNanoSeconds >> (nExponent-3)) & (LATENCY_SUB_BUCKETS-1);
+
+	return LATENCY_LINEAR_BUCKETS + (nExponent-4) * LATENCY_SUB_BUCKETS + nSubBucket;
+}
+
+unsigned CLatencyMonitor::GetBucketLimit (unsigned nBucket)
+{
+	assert (nBucket < LATENCY_BUCKETS);
+
+	if (nBucket < LATENCY_LINEAR_BUCKETS)
+	{
+		return nBucket;
+	}
+
+	nBucket -= LATENCY_LINEAR_BUCKETS;
+	unsigned nShift = nBucket / LATENCY_SUB_BUCKETS + 1;
+	unsigned nSubBucket = nBucket % LATENCY_SUB_BUCKETS;
+
+	// lower limit of the next bucket minus 1
+	return (u32) (((u64) (LATENCY_SUB_BUCKETS + nSubBucket + 1) << nShift) - 1);
+}
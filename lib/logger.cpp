@@ -2,7 +2,7 @@
 // logger.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,6 +19,7 @@
 //
 #include <circle/logger.h>
 #include <circle/string.h>
+#include <circle/formatter.h>
 #include <circle/synchronize.h>
 #include <circle/startup.h>
 #include <circle/multicore.h>
@@ -27,17 +28,74 @@
 #include <circle/machineinfo.h>
 #include <circle/version.h>
 #include <circle/debug.h>
+#include <assert.h>
 
-struct TLogEvent
+#define LOGGER_LINE_BUFFER	256		// on stack, longer lines are allocated on the heap
+
+struct TLogRecord				// deferred message, formatted on flush
+{
+	const char	*pSource;
+	const char	*pMessage;
+	TLogSeverity	 Severity;
+	unsigned	 nArgs;
+	u64		 Arg[LOG_DEFERRED_MAX_ARGS];
+};
+
+enum TLogArgType
 {
-	TLogSeverity	Severity;
-	char		Source[LOG_MAX_SOURCE];
-	char		Message[LOG_MAX_MESSAGE];
-	time_t		Time;
-	unsigned	nHundredthTime;
-	int		nTimeZone;			// minutes diff to UTC
+	LogArgNone,				// "%%" or invalid specification
+	LogArgInt,
+	LogArgLong,
+	LogArgLongLong,
+	LogArgString,
+	LogArgPointer,
+	LogArgDouble
 };
 
+// parses a format specification (pFormat points behind '%') like CString::FormatV()
+static const char *ParseFormatSpec (const char *pFormat, TLogArgType *pType)
+{
+	while (   *pFormat == '-' || *pFormat == '#' || *pFormat == '.'
+	       || ('0' <= *pFormat && *pFormat <= '9'))
+	{
+		pFormat++;
+	}
+
+	unsigned nLong = 0;
+	while (*pFormat == 'l')
+	{
+		nLong++;
+		pFormat++;
+	}
+
+	switch (*pFormat)
+	{
+	case 'c':
+	case 'd':
+	case 'i':
+	case 'o':
+	case 'u':
+	case 'x':
+	case 'X':
+		*pType = nLong == 0 ? LogArgInt : (nLong == 1 ? LogArgLong : LogArgLongLong);
+		break;
+
+	case 's':	*pType = LogArgString;	break;
+	case 'p':	*pType = LogArgPointer;	break;
+	case 'f':	*pType = LogArgDouble;	break;
+
+	case '\0':
+		*pType = LogArgNone;
+		return pFormat;
+
+	default:
+		*pType = LogArgNone;
+		break;
+	}
+
+	return pFormat+1;
+}
+
 CLogger *CLogger::s_pThis = 0;
 
 CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer, boolean bOverwriteOldest)
@@ -51,10 +109,19 @@ CLogger::CLogger (unsigned nLogLevel, CTimer *pTimer, boolean bOverwriteOldest)
 	m_nEventInPtr (0),
 	m_nEventOutPtr (0),
 	m_pEventNotificationHandler (0),
-	m_pPanicHandler (0)
+	m_pPanicHandler (0),
+	m_FlushSpinLock (TASK_LEVEL)
 {
 	m_pBuffer = new char[LOGGER_BUFSIZE];
 
+	for (unsigned nCore = 0; nCore < LOG_DEFERRED_CORES; nCore++)
+	{
+		m_Deferred[nCore].pRecord = new TLogRecord[LOG_DEFERRED_RECORDS];
+		m_Deferred[nCore].nDropped = 0;
+		m_Deferred[nCore].nIn = 0;
+		m_Deferred[nCore].nOut = 0;
+	}
+
 	s_pThis = this;
 }
 
@@ -72,6 +139,12 @@ CLogger::~CLogger (void)
 		}
 	}
 
+	for (unsigned nCore = 0; nCore < LOG_DEFERRED_CORES; nCore++)
+	{
+		delete [] m_Deferred[nCore].pRecord;
+		m_Deferred[nCore].pRecord = 0;
+	}
+
 	delete [] m_pBuffer;
 	m_pBuffer = 0;
 
@@ -131,65 +204,340 @@ void CLogger::Write (const char *pSource, TLogSeverity Severity, const char *pMe
 
 void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pMessage, va_list Args)
 {
-	CString Message;
-	Message.FormatV (pMessage, Args);
+	char Buffer[LOGGER_LINE_BUFFER];
 
-	WriteEvent (pSource, Severity, Message);
+	va_list ArgsCopy;
+	va_copy (ArgsCopy, Args);
 
-	if (Severity > m_nLogLevel)
+	if (CFormatter::FormatV (Buffer, sizeof Buffer, pMessage, Args) < sizeof Buffer)
 	{
-		return;
+		WriteMessage (pSource, Severity, Buffer);
 	}
+	else
+	{
+		CString Message;
+		Message.FormatV (pMessage, ArgsCopy);
 
-	CString Buffer;
+		WriteMessage (pSource, Severity, Message);
+	}
 
-#ifdef USE_LOG_COLORS
-	switch (Severity)
+	va_end (ArgsCopy);
+}
+
+void CLogger::WriteFields (const char *pSource, TLogSeverity Severity,
+			   const TLogField *pFields, unsigned nFields, const char *pMessage, ...)
+{
+	assert (pFields != 0 || nFields == 0);
+
+	char Buffer[LOGGER_LINE_BUFFER];
+
+	va_list var;
+	va_start (var, pMessage);
+
+	if (CFormatter::FormatV (Buffer, sizeof Buffer, pMessage, var) < sizeof Buffer)
 	{
-	case LogPanic:		Buffer = "\x1b[91m";	break;
-	case LogError:		Buffer = "\x1b[95m";	break;
-	case LogWarning:	Buffer = "\x1b[93m";	break;
-	default:		Buffer = "\x1b[97m";	break;
+		va_end (var);
+
+		WriteMessage (pSource, Severity, Buffer, pFields, nFields);
+
+		return;
 	}
-#else
+
+	va_end (var);
+
+	va_start (var, pMessage);
+
+	CString Message;
+	Message.FormatV (pMessage, var);
+
+	va_end (var);
+
+	WriteMessage (pSource, Severity, Message, pFields, nFields);
+}
+
+boolean CLogger::WriteDeferred (const char *pSource, TLogSeverity Severity, const char *pMessage, ...)
+{
+	va_list var;
+	va_start (var, pMessage);
+
 	if (Severity == LogPanic)
 	{
-		Buffer = "\x1b[1m";
+		WriteV (pSource, Severity, pMessage, var);
+
+		va_end (var);
+
+		return TRUE;
+	}
+
+	if (Severity > m_nLogLevel)
+	{
+		va_end (var);
+
+		return TRUE;
 	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TDeferredBuffer *pBuffer = &m_Deferred[CMultiCoreSupport::ThisCore ()];
+#else
+	TDeferredBuffer *pBuffer = &m_Deferred[0];
 #endif
 
-	if (m_pTimer != 0)
+	// IRQs are disabled only to serialize the producers on this core
+	EnterCritical (IRQ_LEVEL);
+
+	unsigned nIn = __atomic_load_n (&pBuffer->nIn, __ATOMIC_RELAXED);
+	if (nIn - __atomic_load_n (&pBuffer->nOut, __ATOMIC_ACQUIRE) >= LOG_DEFERRED_RECORDS)
 	{
-		CString *pTimeString = m_pTimer->GetTimeString ();
-		if (pTimeString != 0)
+		pBuffer->nDropped++;
+
+		LeaveCritical ();
+
+		va_end (var);
+
+		return FALSE;
+	}
+
+	TLogRecord *pRecord = &pBuffer->pRecord[nIn & (LOG_DEFERRED_RECORDS-1)];
+	pRecord->pSource = pSource;
+	pRecord->pMessage = pMessage;
+	pRecord->Severity = Severity;
+
+	unsigned nArgs = 0;
+	for (const char *p = pMessage; *p != '\0' && nArgs < LOG_DEFERRED_MAX_ARGS; )
+	{
+		if (*p++ != '%')
+		{
+			continue;
+		}
+
+		TLogArgType Type;
+		p = ParseFormatSpec (p, &Type);
+
+		switch (Type)
 		{
-			Buffer.Append (*pTimeString);
-			Buffer.Append (" ");
+		case LogArgInt:		pRecord->Arg[nArgs++] = va_arg (var, int);		break;
+		case LogArgLong:	pRecord->Arg[nArgs++] = va_arg (var, long);		break;
+		case LogArgLongLong:	pRecord->Arg[nArgs++] = va_arg (var, long long);	break;
+
+		case LogArgString:
+		case LogArgPointer:
+			pRecord->Arg[nArgs++] = (uintptr) va_arg (var, const void *);
+			break;
 
-			delete pTimeString;
+		case LogArgDouble: {
+			double fArg = va_arg (var, double);
+			memcpy (&pRecord->Arg[nArgs++], &fArg, sizeof fArg);
+			} break;
+
+		default:
+			break;
 		}
 	}
+	pRecord->nArgs = nArgs;
+
+	__atomic_store_n (&pBuffer->nIn, nIn+1, __ATOMIC_RELEASE);
 
-	Buffer.Append (pSource);
-	Buffer.Append (": ");
+	LeaveCritical ();
 
-	Buffer.Append (Message);
+	va_end (var);
 
+	return TRUE;
+}
+
+boolean CLogger::HasDeferred (void) const
+{
+	for (unsigned nCore = 0; nCore < LOG_DEFERRED_CORES; nCore++)
+	{
+		if (   __atomic_load_n (&m_Deferred[nCore].nIn, __ATOMIC_ACQUIRE)
+		    != m_Deferred[nCore].nOut)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CLogger::FlushDeferred (void)
+{
+	m_FlushSpinLock.Acquire ();
+
+	for (unsigned nCore = 0; nCore < LOG_DEFERRED_CORES; nCore++)
+	{
+		TDeferredBuffer *pBuffer = &m_Deferred[nCore];
+
+		unsigned nOut = pBuffer->nOut;
+		while (nOut != __atomic_load_n (&pBuffer->nIn, __ATOMIC_ACQUIRE))
+		{
+			const TLogRecord *pRecord = &pBuffer->pRecord[nOut & (LOG_DEFERRED_RECORDS-1)];
+
+			// format the message one specification at a time with the recorded arguments
+			CString Message;
+			unsigned nArg = 0;
+			for (const char *p = pRecord->pMessage; *p != '\0'; )
+			{
+				const char *pLiteral = p;
+				while (*p != '\0' && *p != '%')
+				{
+					p++;
+				}
+
+				CString Part;
+				if (p > pLiteral)
+				{
+					char Literal[LOG_MAX_MESSAGE];
+					size_t nLength = p - pLiteral;
+					if (nLength >= sizeof Literal)
+					{
+						nLength = sizeof Literal - 1;
+					}
+
+					memcpy (Literal, pLiteral, nLength);
+					Literal[nLength] = '\0';
+
+					Message.Append (Literal);
+				}
+
+				if (*p == '\0')
+				{
+					break;
+				}
+
+				const char *pSpec = p++;
+				TLogArgType Type;
+				p = ParseFormatSpec (p, &Type);
+
+				char Spec[20];
+				size_t nLength = p - pSpec;
+				if (nLength >= sizeof Spec)
+				{
+					nLength = sizeof Spec - 1;
+				}
+
+				memcpy (Spec, pSpec, nLength);
+				Spec[nLength] = '\0';
+
+				if (Type == LogArgNone)
+				{
+					Part.Format (Spec);
+				}
+				else if (nArg >= pRecord->nArgs)
+				{
+					Part = "<?>";		// more than LOG_DEFERRED_MAX_ARGS
+				}
+				else
+				{
+					u64 nArgValue = pRecord->Arg[nArg++];
+					double fArg;
+
+					switch (Type)
+					{
+					case LogArgInt:		Part.Format (Spec, (int) nArgValue);		break;
+					case LogArgLong:	Part.Format (Spec, (long) nArgValue);		break;
+					case LogArgLongLong:	Part.Format (Spec, (long long) nArgValue);	break;
+
+					case LogArgString:
+					case LogArgPointer:
+						Part.Format (Spec, (const void *) (uintptr) nArgValue);
+						break;
+
+					case LogArgDouble:
+						memcpy (&fArg, &nArgValue, sizeof fArg);
+						Part.Format (Spec, fArg);
+						break;
+
+					default:
+						break;
+					}
+				}
+
+				Message.Append (Part);
+			}
+
+			TLogSeverity Severity = pRecord->Severity;
+			const char *pSource = pRecord->pSource;
+
+			__atomic_store_n (&pBuffer->nOut, ++nOut, __ATOMIC_RELEASE);
+
+			WriteMessage (pSource, Severity, Message);
+		}
+
+		if (pBuffer->nDropped > 0)
+		{
+			unsigned nDropped = __atomic_exchange_n (&pBuffer->nDropped, 0,
+								 __ATOMIC_RELAXED);
+
+			CString Message;
+			Message.Format ("%u deferred messages dropped on core %u", nDropped, nCore);
+
+			WriteMessage ("logger", LogWarning, Message);
+		}
+	}
+
+	m_FlushSpinLock.Release ();
+}
+
+void CLogger::WriteMessage (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			    const TLogField *pFields, unsigned nFields)
+{
+	WriteEvent (pSource, Severity, pMessage, pFields, nFields);
+
+	if (Severity > m_nLogLevel)
+	{
+		return;
+	}
+
+	const char *pPrefix = "";
+	const char *pSuffix = "";
 #ifdef USE_LOG_COLORS
+	switch (Severity)
+	{
+	case LogPanic:		pPrefix = "\x1b[91m";	break;
+	case LogError:		pPrefix = "\x1b[95m";	break;
+	case LogWarning:	pPrefix = "\x1b[93m";	break;
+	default:		pPrefix = "\x1b[97m";	break;
+	}
+
 	if (Severity <= LogWarning)
 	{
-		Buffer.Append ("\x1b[97m");
+		pSuffix = "\x1b[97m";
 	}
 #else
 	if (Severity == LogPanic)
 	{
-		Buffer.Append ("\x1b[0m");
+		pPrefix = "\x1b[1m";
+		pSuffix = "\x1b[0m";
 	}
 #endif
 
-	Buffer.Append ("\n");
+	CString *pTimeString = 0;
+	if (m_pTimer != 0)
+	{
+		pTimeString = m_pTimer->GetTimeString ();
+	}
 
-	Write (Buffer);
+	// compose the line on the stack, only very long lines need the heap
+	char Buffer[LOGGER_LINE_BUFFER];
+	size_t nLength = FormatLine (Buffer, sizeof Buffer, pPrefix, pTimeString, pSource,
+				     pMessage, pFields, nFields, pSuffix);
+	if (nLength < sizeof Buffer)
+	{
+		Write (Buffer);
+	}
+	else
+	{
+		char *pBuffer = new char[nLength+1];
+		assert (pBuffer != 0);
+
+		FormatLine (pBuffer, nLength+1, pPrefix, pTimeString, pSource,
+			    pMessage, pFields, nFields, pSuffix);
+
+		Write (pBuffer);
+
+		delete [] pBuffer;
+	}
+
+	delete pTimeString;
 
 	if (Severity == LogPanic)
 	{
@@ -211,6 +559,30 @@ void CLogger::WriteV (const char *pSource, TLogSeverity Severity, const char *pM
 	}
 }
 
+size_t CLogger::FormatLine (char *pBuffer, size_t nSize, const char *pPrefix,
+			    const CString *pTimeString, const char *pSource, const char *pMessage,
+			    const TLogField *pFields, unsigned nFields, const char *pSuffix)
+{
+	assert (pBuffer != 0);
+	assert (nSize > 0);
+
+	size_t nLength = CFormatter::Format (pBuffer, nSize, "%s%s%s%s: %s", pPrefix,
+					     pTimeString != 0 ? (const char *) *pTimeString : "",
+					     pTimeString != 0 ? " " : "", pSource, pMessage);
+
+	for (unsigned i = 0; i < nFields; i++)
+	{
+		size_t nOffset = nLength < nSize ? nLength : nSize-1;
+
+		nLength += CFormatter::Format (pBuffer + nOffset, nSize - nOffset, " %s=%s",
+					       pFields[i].pKey, pFields[i].pValue);
+	}
+
+	size_t nOffset = nLength < nSize ? nLength : nSize-1;
+
+	return nLength + CFormatter::Format (pBuffer + nOffset, nSize - nOffset, "%s\n", pSuffix);
+}
+
 void CLogger::WriteNoAlloc (const char *pSource, TLogSeverity Severity, const char *pMessage)
 {
 	if (Severity > m_nLogLevel)
@@ -346,7 +718,8 @@ int CLogger::Read (void *pBuffer, unsigned nCount, boolean bClear)
 	return nResult;
 }
 
-void CLogger::WriteEvent (const char *pSource, TLogSeverity Severity, const char *pMessage)
+void CLogger::WriteEvent (const char *pSource, TLogSeverity Severity, const char *pMessage,
+			  const TLogField *pFields, unsigned nFields)
 {
 	TLogEvent *pEvent = new TLogEvent;
 	if (pEvent == 0)
@@ -362,6 +735,29 @@ void CLogger::WriteEvent (const char *pSource, TLogSeverity Severity, const char
 	strncpy (pEvent->Message, pMessage, LOG_MAX_MESSAGE);
 	pEvent->Message[LOG_MAX_MESSAGE-1] = '\0';
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	pEvent->nCore = CMultiCoreSupport::ThisCore ();
+#else
+	pEvent->nCore = 0;
+#endif
+
+	if (nFields > LOG_MAX_FIELDS)
+	{
+		nFields = LOG_MAX_FIELDS;
+	}
+
+	pEvent->nFields = nFields;
+	for (unsigned i = 0; i < nFields; i++)
+	{
+		assert (pFields[i].pKey != 0);
+		strncpy (pEvent->FieldKey[i], pFields[i].pKey, LOG_MAX_FIELD_KEY);
+		pEvent->FieldKey[i][LOG_MAX_FIELD_KEY-1] = '\0';
+
+		assert (pFields[i].pValue != 0);
+		strncpy (pEvent->FieldValue[i], pFields[i].pValue, LOG_MAX_FIELD_VALUE);
+		pEvent->FieldValue[i][LOG_MAX_FIELD_VALUE-1] = '\0';
+	}
+
 	unsigned nSeconds, nMicroSeconds;
 	if (   m_pTimer != 0
 	    && m_pTimer->GetLocalTime (&nSeconds, &nMicroSeconds))
@@ -444,6 +840,35 @@ boolean CLogger::ReadEvent (TLogSeverity *pSeverity, char *pSource, char *pMessa
 	return TRUE;
 }
 
+boolean CLogger::ReadEvent (TLogEvent *pEvent)
+{
+	assert (pEvent != 0);
+
+	m_EventSpinLock.Acquire ();
+
+	if (m_nEventInPtr == m_nEventOutPtr)
+	{
+		m_EventSpinLock.Release ();
+
+		return FALSE;
+	}
+
+	TLogEvent *pQueuedEvent = m_pEventQueue[m_nEventOutPtr];
+
+	if (++m_nEventOutPtr == LOG_QUEUE_SIZE)
+	{
+		m_nEventOutPtr = 0;
+	}
+
+	m_EventSpinLock.Release ();
+
+	memcpy (pEvent, pQueuedEvent, sizeof *pEvent);
+
+	delete pQueuedEvent;
+
+	return TRUE;
+}
+
 void CLogger::RegisterEventNotificationHandler (TLogEventNotificationHandler *pHandler)
 {
 	m_pEventNotificationHandler = pHandler;
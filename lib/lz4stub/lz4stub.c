@@ -0,0 +1,225 @@
+//
+// lz4stub.c
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+//
+// Self-extracting stub for LZ4-compressed kernel images (LZ4_KERNEL=1)
+//
+// The stub has been copied to its link address by the startup code before. It
+// decompresses the payload (LZ4 legacy frame format, as written by "lz4 -l") to
+// LOADADDR. On AArch64 the MMU and data cache are enabled while decompressing.
+//
+
+#ifndef LOADADDR
+	#error LOADADDR must be defined
+#endif
+
+#define LZ4_LEGACY_MAGIC	0x184C2102U
+
+typedef unsigned char		u8;
+typedef unsigned int		u32;
+typedef unsigned long		uptr;
+
+extern const u8 lz4_payload_start[];
+extern const u8 lz4_payload_end[];
+
+static u32 read_le32 (const u8 *p)
+{
+	return p[0] | p[1] << 8 | p[2] << 16 | (u32) p[3] << 24;
+}
+
+static u8 *lz4_decode_block (const u8 *pIn, const u8 *pInEnd, u8 *pOut)
+{
+	while (pIn < pInEnd)
+	{
+		unsigned nToken = *pIn++;
+
+		uptr nLength = nToken >> 4;
+		if (nLength == 15)
+		{
+			unsigned nByte;
+			do
+			{
+				nByte = *pIn++;
+				nLength += nByte;
+			}
+			while (nByte == 255);
+		}
+
+		while (nLength--)
+		{
+			*pOut++ = *pIn++;
+		}
+
+		if (pIn >= pInEnd)
+		{
+			break;			// the last sequence has literals only
+		}
+
+		uptr nOffset = pIn[0] | pIn[1] << 8;
+		pIn += 2;
+
+		nLength = nToken & 15;
+		if (nLength == 15)
+		{
+			unsigned nByte;
+			do
+			{
+				nByte = *pIn++;
+				nLength += nByte;
+			}
+			while (nByte == 255);
+		}
+		nLength += 4;
+
+		// the match may overlap the output, copy bytewise then
+		const u8 *pMatch = pOut - nOffset;
+#if AARCH == 64
+		// unaligned word accesses are allowed with the MMU enabled only
+		if (nOffset >= sizeof (uptr))
+		{
+			while (nLength >= sizeof (uptr))
+			{
+				uptr nWord;
+				__builtin_memcpy (&nWord, pMatch, sizeof nWord);
+				__builtin_memcpy (pOut, &nWord, sizeof nWord);
+
+				pMatch += sizeof (uptr);
+				pOut += sizeof (uptr);
+				nLength -= sizeof (uptr);
+			}
+		}
+#endif
+
+		while (nLength--)
+		{
+			*pOut++ = *pMatch++;
+		}
+	}
+
+	return pOut;
+}
+
+#if AARCH == 64
+
+#define SCTLR_M		(1 << 0)
+#define SCTLR_C		(1 << 2)
+#define SCTLR_I		(1 << 12)
+
+#define MAIR_VALUE	0x00FFUL		// attr0: normal write-back, attr1: device
+
+#define DESC_BLOCK	(1UL << 0)
+#define DESC_TABLE	(3UL << 0)
+#define DESC_NORMAL	((0UL << 2) | (3UL << 8) | (1UL << 10))
+#define DESC_DEVICE	((1UL << 2) | (1UL << 10) | (3UL << 53))
+
+#define CACHED_SIZE	0x8000000UL		// first 128 MB (2 MB blocks)
+
+static uptr s_Level1Table[512] __attribute__ ((aligned (4096)));
+static uptr s_Level2Table[512] __attribute__ ((aligned (4096)));
+
+static void mmu_enable (void)
+{
+	// identity map, normal memory only where the stub works (not the peripherals)
+	for (unsigned i = 0; i < 512; i++)
+	{
+		uptr nAddress = (uptr) i << 21;
+
+		s_Level2Table[i] = nAddress | DESC_BLOCK
+				 | (nAddress < CACHED_SIZE ? DESC_NORMAL : DESC_DEVICE);
+	}
+
+	s_Level1Table[0] = (uptr) s_Level2Table | DESC_TABLE;
+	for (unsigned i = 1; i < 4; i++)
+	{
+		s_Level1Table[i] = ((uptr) i << 30) | DESC_BLOCK | DESC_DEVICE;
+	}
+
+	uptr nEL;
+	asm volatile ("mrs %0, CurrentEL" : "=r" (nEL));
+
+	// T0SZ=32 (4 GB), inner/outer write-back, inner shareable, 4 KB granule
+	uptr nTCR = 32 | (1 << 8) | (1 << 10) | (3 << 12);
+
+	uptr nSCTLR;
+	if (((nEL >> 2) & 3) == 2)
+	{
+		nTCR |= (1UL << 31) | (1UL << 23);	// RES1
+		asm volatile ("msr mair_el2, %0" : : "r" (MAIR_VALUE));
+		asm volatile ("msr tcr_el2, %0" : : "r" (nTCR));
+		asm volatile ("msr ttbr0_el2, %0" : : "r" (s_Level1Table));
+		asm volatile ("dsb sy; isb; tlbi alle2; dsb sy; isb" ::: "memory");
+
+		asm volatile ("mrs %0, sctlr_el2" : "=r" (nSCTLR));
+		nSCTLR |= SCTLR_M | SCTLR_C | SCTLR_I;
+		asm volatile ("msr sctlr_el2, %0; isb" : : "r" (nSCTLR) : "memory");
+	}
+	else
+	{
+		nTCR |= 1UL << 23;			// EPD1
+		asm volatile ("msr mair_el1, %0" : : "r" (MAIR_VALUE));
+		asm volatile ("msr tcr_el1, %0" : : "r" (nTCR));
+		asm volatile ("msr ttbr0_el1, %0" : : "r" (s_Level1Table));
+		asm volatile ("dsb sy; isb; tlbi vmalle1; dsb sy; isb" ::: "memory");
+
+		asm volatile ("mrs %0, sctlr_el1" : "=r" (nSCTLR));
+		nSCTLR |= SCTLR_M | SCTLR_C | SCTLR_I;
+		asm volatile ("msr sctlr_el1, %0; isb" : : "r" (nSCTLR) : "memory");
+	}
+}
+
+#endif
+
+// returns the size of the decompressed kernel image (0 on error)
+uptr lz4stub_main (void)
+{
+	const u8 *pIn = lz4_payload_start;
+	const u8 *pInEnd = lz4_payload_end;
+
+	if (   pIn + 4 > pInEnd
+	    || read_le32 (pIn) != LZ4_LEGACY_MAGIC)
+	{
+		return 0;
+	}
+
+#if AARCH == 64
+	mmu_enable ();		// disabled again by the startup code
+#endif
+
+	u8 *pOut = (u8 *) LOADADDR;
+	while (pIn + 4 <= pInEnd)
+	{
+		u32 nSize = read_le32 (pIn);
+		pIn += 4;
+
+		if (nSize == LZ4_LEGACY_MAGIC)
+		{
+			continue;		// concatenated frame
+		}
+
+		if (nSize > (uptr) (pInEnd - pIn))
+		{
+			break;
+		}
+
+		pOut = lz4_decode_block (pIn, pIn + nSize, pOut);
+		pIn += nSize;
+	}
+
+	return pOut - (u8 *) LOADADDR;
+}
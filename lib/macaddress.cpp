@@ -76,6 +76,23 @@ void CMACAddress::SetMulticast (const u8 *pIPAddress)
 	m_bValid = TRUE;
 }
 
+void CMACAddress::SetMulticastIPv6 (const u8 *pIPv6Address)
+{
+	assert (pIPv6Address != 0);
+	assert (pIPv6Address[0] == 0xFF);
+
+	// RFC 2464 section 7, the last four bytes are mapped
+	m_Address[0] = 0x33;
+	m_Address[1] = 0x33;
+
+	m_Address[2] = pIPv6Address[12];
+	m_Address[3] = pIPv6Address[13];
+	m_Address[4] = pIPv6Address[14];
+	m_Address[5] = pIPv6Address[15];
+
+	m_bValid = TRUE;
+}
+
 const u8 *CMACAddress::Get (void) const
 {
 	assert (m_bValid);
@@ -10,8 +10,11 @@
 // Ported to Circle by R. Stange
 //
 #include <circle/macb.h>
+#include <circle/netbuffer.h>
 #include <circle/memio.h>
 #include <circle/bcm2712.h>
+#include <circle/rp1int.h>
+#include <circle/interrupt.h>
 #include <circle/synchronize.h>
 #include <circle/bcmpciehostbridge.h>
 #include <circle/devicetreeblob.h>
@@ -24,6 +27,7 @@
 
 #define PCLK_RATE		200000000UL
 #define GPIO_PHY_RESET		32
+#define TSU_CLK_RATE		50000000UL	/* RP1 clk_eth_tsu */
 
 #define DMA_BURST_LENGTH	16
 
@@ -508,6 +512,11 @@
 /* Bitfields in TISUBN */
 #define GEM_SUBNSINCR_OFFSET	0
 #define GEM_SUBNSINCR_SIZE	16
+#define GEM_SUBNSINCRL_OFFSET	24
+#define GEM_SUBNSINCRL_SIZE	8
+#define GEM_SUBNSINCRH_OFFSET	0
+#define GEM_SUBNSINCRH_SIZE	16
+#define GEM_SUBNSINCR_BITS	24	/* sub-ns increment in 1/2^24 ns */
 
 /* Bitfields in TI */
 #define GEM_NSINCR_OFFSET	0
@@ -525,6 +534,12 @@
 #define GEM_TN_OFFSET		0 /* TSU timer value (ns) */
 #define GEM_TN_SIZE			30
 
+/* Bitfields in TA */
+#define GEM_ITDT_OFFSET		0 /* Increment or decrement timer by this value (ns) */
+#define GEM_ITDT_SIZE		30
+#define GEM_ADDSUB_OFFSET	31 /* Subtract (1) or add (0) the ITDT value */
+#define GEM_ADDSUB_SIZE		1
+
 /* Bitfields in TXBDCTRL */
 #define GEM_TXTSMODE_OFFSET	4 /* TX Descriptor Timestamp Insertion mode */
 #define GEM_TXTSMODE_SIZE	2
@@ -920,7 +935,11 @@ LOGMODULE ("macb");
 
 CMACBDevice::CMACBDevice (void)
 :	m_phy_addr (PHY_ID),
-	m_link (0)
+	m_link (0),
+	m_bInterruptConnected (FALSE),
+	m_pRxHandler (0),
+	m_pRxParam (0),
+	m_bHasTSU (FALSE)
 {
 	m_PHYResetPin.AssignPin (GPIO_PHY_RESET);
 	m_PHYResetPin.Write (HIGH);
@@ -929,6 +948,14 @@ CMACBDevice::CMACBDevice (void)
 
 CMACBDevice::~CMACBDevice (void)
 {
+	if (m_bInterruptConnected)
+	{
+		macb_writel (IDR, MACB_BIT (RCOMP));
+
+		CInterruptSystem::Get ()->DisconnectIRQ (RP1_IRQ_ETH);
+		m_bInterruptConnected = FALSE;
+	}
+
 	macb_halt ();
 
 	m_PHYResetPin.SetMode (GPIOModeInput);
@@ -999,6 +1026,17 @@ const CMACAddress *CMACBDevice::GetMACAddress (void) const
 	return &m_MACAddress;
 }
 
+unsigned CMACBDevice::GetCapabilities (void) const
+{
+	unsigned nCaps = m_bHasTSU ? NET_DEVICE_CAP_PTP_TIMESTAMP : 0;
+
+#ifdef NET_CHECKSUM_OFFLOAD
+	nCaps |= NET_DEVICE_CAP_RX_CHECKSUM | NET_DEVICE_CAP_TX_CHECKSUM;
+#endif
+
+	return nCaps;
+}
+
 boolean CMACBDevice::IsSendFrameAdvisable (void)
 {
 	if (!m_tx_outstanding)
@@ -1038,6 +1076,34 @@ Timeout:
 }
 
 boolean CMACBDevice::SendFrame (const void *pBuffer, unsigned nLength)
+{
+	return SendFrame (pBuffer, nLength, 0);
+}
+
+boolean CMACBDevice::SendBuffer (CNetBuffer *pFrame)
+{
+	assert (pFrame);
+	unsigned nLength = pFrame->GetTotalLength ();
+	assert (nLength <= FRAME_BUFFER_SIZE);
+
+	unsigned nChecksumField = 0;
+	if (pFrame->IsChecksumPartial ())
+	{
+		nChecksumField = pFrame->GetChecksumStart () + pFrame->GetChecksumOffset ();
+	}
+
+	if (pFrame->GetNextSegment ())
+	{
+		u8 Buffer[FRAME_BUFFER_SIZE];	/* frame is copied to the TX buffer anyway */
+		pFrame->CopyTo (Buffer);
+
+		return SendFrame (Buffer, nLength, nChecksumField);
+	}
+
+	return SendFrame (pFrame->GetData (), nLength, nChecksumField);
+}
+
+boolean CMACBDevice::SendFrame (const void *pBuffer, unsigned nLength, unsigned nChecksumField)
 {
 	assert (pBuffer);
 	assert (nLength);
@@ -1057,6 +1123,13 @@ boolean CMACBDevice::SendFrame (const void *pBuffer, unsigned nLength)
 
 	assert (m_tx_buffer);
 	memcpy (m_tx_buffer, pBuffer, nLength);
+	if (nChecksumField)
+	{
+		/* the GEM includes the pseudo header, which is already there */
+		assert (nChecksumField + sizeof (u16) <= nLength);
+		m_tx_buffer[nChecksumField] = 0;
+		m_tx_buffer[nChecksumField + 1] = 0;
+	}
 	DataMemBarrier ();
 
 	u32 ctrl = nLength & TXBUF_FRMLEN_MASK;
@@ -1079,6 +1152,35 @@ boolean CMACBDevice::SendFrame (const void *pBuffer, unsigned nLength)
 }
 
 boolean CMACBDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
+{
+	boolean bChecksumValid;
+	return ReceiveFrame (pBuffer, pResultLength, &bChecksumValid);
+}
+
+boolean CMACBDevice::ReceiveBuffer (CNetBuffer *pFrame)
+{
+	assert (pFrame);
+	assert (!pFrame->GetLength ());
+	assert (pFrame->GetTailroom () >= FRAME_BUFFER_SIZE);
+
+	unsigned nLength;
+	boolean bChecksumValid;
+	if (!ReceiveFrame (pFrame->GetData (), &nLength, &bChecksumValid))
+	{
+		return FALSE;
+	}
+
+	pFrame->Append (nLength);
+
+	if (bChecksumValid)
+	{
+		pFrame->SetChecksumValid ();
+	}
+
+	return TRUE;
+}
+
+boolean CMACBDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength, boolean *pChecksumValid)
 {
 	assert (pBuffer);
 	assert (pResultLength);
@@ -1115,6 +1217,14 @@ boolean CMACBDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
 
 	*pResultLength = length;
 
+	/* IP header and TCP/UDP checksum have been verified by the GEM? */
+	assert (pChecksumValid);
+#ifdef NET_CHECKSUM_OFFLOAD
+	*pChecksumValid = !!(GEM_BFEXT (RX_CSUM, ctrl) & GEM_RX_CSUM_CHECKED_MASK);
+#else
+	*pChecksumValid = FALSE;	/* field has another meaning without RXCOEN */
+#endif
+
 	bResult = TRUE;
 
 Return:
@@ -1132,6 +1242,61 @@ Return:
 	return bResult;
 }
 
+boolean CMACBDevice::RegisterReceiveHandler (TNetReceiveHandler *pHandler, void *pParam)
+{
+	assert (pHandler);
+	assert (!m_pRxHandler);
+
+	m_pRxHandler = pHandler;
+	m_pRxParam = pParam;
+
+	/* the interrupt is enabled with EnableReceiveInterrupt(), after the ring has been polled */
+	macb_writel (IDR, MACB_BIT (RCOMP));
+
+	assert (!m_bInterruptConnected);
+	CInterruptSystem::Get ()->ConnectIRQ (RP1_IRQ_ETH, InterruptStub, this);
+	m_bInterruptConnected = TRUE;
+
+	return TRUE;
+}
+
+boolean CMACBDevice::EnableReceiveInterrupt (void)
+{
+	assert (m_pRxHandler);
+	macb_writel (IER, MACB_BIT (RCOMP));
+
+	/*
+	 * Frames, which have been received while the interrupt was disabled, do not
+	 * raise it, when it is enabled again. Check for this case here.
+	 */
+	DataSyncBarrier ();
+	return !(m_rx_ring[m_rx_tail].addr & MACB_BIT (RX_USED));
+}
+
+void CMACBDevice::InterruptHandler (void)
+{
+	u32 status = macb_readl (ISR);		/* clear on read */
+	if (!(status & MACB_BIT (RCOMP)))
+	{
+		return;
+	}
+
+	/* disable until the frames have been fetched (see EnableReceiveInterrupt()) */
+	macb_writel (IDR, MACB_BIT (RCOMP));
+	macb_writel (ISR, MACB_BIT (RCOMP));	/* clear on write, if configured */
+
+	assert (m_pRxHandler);
+	(*m_pRxHandler) (m_pRxParam);
+}
+
+void CMACBDevice::InterruptStub (void *pParam)
+{
+	CMACBDevice *pThis = (CMACBDevice *) pParam;
+	assert (pThis);
+
+	pThis->InterruptHandler ();
+}
+
 boolean CMACBDevice::IsLinkUp (void)
 {
 	UpdatePHY ();
@@ -1204,6 +1369,144 @@ boolean CMACBDevice::SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE])
 	return TRUE;
 }
 
+boolean CMACBDevice::GetPTPEventTimestamp (boolean bTransmit, u64 *pNanoSeconds)
+{
+	if (!m_bHasTSU)
+	{
+		return FALSE;
+	}
+
+	u64 sec;
+	u32 ns;
+	if (bTransmit)
+	{
+		sec =   (u64) GEM_BFEXT (TSH, gem_readl (EFTSH)) << 32
+		      | gem_readl (EFTSL);
+		ns = GEM_BFEXT (TN, gem_readl (EFTN));
+	}
+	else
+	{
+		sec =   (u64) GEM_BFEXT (TSH, gem_readl (EFRSH)) << 32
+		      | gem_readl (EFRSL);
+		ns = GEM_BFEXT (TN, gem_readl (EFRN));
+	}
+
+	assert (pNanoSeconds != 0);
+	*pNanoSeconds = sec * 1000000000ULL + ns;
+
+	return TRUE;
+}
+
+boolean CMACBDevice::GetPTPClock (u64 *pNanoSeconds)
+{
+	if (!m_bHasTSU)
+	{
+		return FALSE;
+	}
+
+	/* the seconds may increment in between, then read them again */
+	u32 first = GEM_BFEXT (TN, gem_readl (TN));
+	u32 secl = gem_readl (TSL);
+	u32 sech = GEM_BFEXT (TSH, gem_readl (TSH));
+	u32 second = GEM_BFEXT (TN, gem_readl (TN));
+	if (second < first)
+	{
+		secl = gem_readl (TSL);
+		sech = GEM_BFEXT (TSH, gem_readl (TSH));
+	}
+
+	assert (pNanoSeconds != 0);
+	*pNanoSeconds = ((u64) sech << 32 | secl) * 1000000000ULL + second;
+
+	return TRUE;
+}
+
+boolean CMACBDevice::SetPTPClock (u64 nNanoSeconds)
+{
+	if (!m_bHasTSU)
+	{
+		return FALSE;
+	}
+
+	u64 sec = nNanoSeconds / 1000000000ULL;
+	u32 ns = nNanoSeconds % 1000000000ULL;
+
+	/* TN = 0 prevents a seconds increment, while the seconds are written */
+	gem_writel (TN, 0);
+	gem_writel (TSH, GEM_BF (TSH, upper_32_bits (sec)));
+	gem_writel (TSL, lower_32_bits (sec));
+	gem_writel (TN, GEM_BF (TN, ns));
+
+	return TRUE;
+}
+
+boolean CMACBDevice::AdjustPTPClock (s64 nNanoSeconds)
+{
+	if (!m_bHasTSU)
+	{
+		return FALSE;
+	}
+
+	boolean bSubtract = nNanoSeconds < 0;
+	u64 delta = bSubtract ? -nNanoSeconds : nNanoSeconds;
+	if (delta >= 1000000000ULL)
+	{
+		u64 now;
+		GetPTPClock (&now);
+
+		return SetPTPClock (now + nNanoSeconds);
+	}
+
+	gem_writel (TA, GEM_BF (ADDSUB, bSubtract) | GEM_BF (ITDT, (u32) delta));
+
+	return TRUE;
+}
+
+boolean CMACBDevice::SetPTPClockRate (int nPPB)
+{
+	if (!m_bHasTSU)
+	{
+		return FALSE;
+	}
+
+	tsu_set_incr (nPPB);
+
+	return TRUE;
+}
+
+void CMACBDevice::tsu_init (void)
+{
+	m_bHasTSU = !!GEM_BFEXT (TSU, gem_readl (DCFG5));
+	if (!m_bHasTSU)
+	{
+		return;
+	}
+
+	tsu_set_incr (0);
+
+	/* start with the system time, until a PTP client sets the clock */
+	unsigned sec, usec;
+	CTimer::Get ()->GetUniversalTime (&sec, &usec);
+	SetPTPClock (sec * 1000000000ULL + usec * 1000ULL);
+}
+
+void CMACBDevice::tsu_set_incr (int ppb)
+{
+	/* nominal increment per TSU clock cycle in 1/2^24 ns */
+	u64 incr = (1000000000ULL << GEM_SUBNSINCR_BITS) / TSU_CLK_RATE;
+
+	s64 adj = (s64) (incr / 1000) * ppb / 1000000;
+	incr += adj;
+
+	u32 ns = incr >> GEM_SUBNSINCR_BITS;
+	u32 subns = incr & ((1 << GEM_SUBNSINCR_BITS) - 1);
+
+	/* the increment becomes active, when TI is written */
+	gem_writel (TISUBN,   GEM_BF (SUBNSINCRL, subns)
+			    | GEM_BF (SUBNSINCRH, subns >> GEM_SUBNSINCRL_SIZE));
+	gem_writel (TI, GEM_BF (NSINCR, ns));
+}
+
 int CMACBDevice::hash_get_index (const u8 addr[MAC_ADDRESS_SIZE])
 {
 	int hash_index = 0;
@@ -1256,6 +1559,9 @@ int CMACBDevice::eth_alloc (void)
 	u32 ncfgr = gem_mdc_clk_div (0);
 	ncfgr |= macb_dbw ();
 	ncfgr |= MACB_BIT (DRFCS);		/* Discard Rx FCS */
+#ifdef NET_CHECKSUM_OFFLOAD
+	ncfgr |= GEM_BIT (RXCOEN);		/* Rx checksum offload */
+#endif
 	macb_writel (NCFGR, ncfgr);
 
 	return 0;
@@ -1314,6 +1620,9 @@ int CMACBDevice::macb_initialize (void)
 	if (ret)
 		return ret;
 
+	/* Initialize IEEE 1588 time stamp unit */
+	tsu_init();
+
 	/* Enable TX and RX */
 	macb_writel(NCR, MACB_BIT(TE) | MACB_BIT(RE));
 
@@ -1420,6 +1729,9 @@ void CMACBDevice::gmac_configure_dma (void)
 	dmacfg &= ~GEM_BIT(ENDIA_PKT);
 	dmacfg &= ~GEM_BIT(ENDIA_DESC); /* little endian */
 	dmacfg |= GEM_BIT(ADDR64);
+#ifdef NET_CHECKSUM_OFFLOAD
+	dmacfg |= GEM_BIT(TXCOEN);	/* requires TXPBMS (full store and forward) */
+#endif
 	gem_writel(DMACFG, dmacfg);
 }
 
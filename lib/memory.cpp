@@ -58,6 +58,7 @@ CMemorySystem::CMemorySystem (boolean bEnableMMU)
 #if RASPPI >= 4
 	m_HeapHigh ("heaphigh"),
 #endif
+	m_HeapCoherent ("heapcoherent"),
 	m_pPageTable (0)
 {
 	if (s_pThis != 0)	// ignore second instance
@@ -82,6 +83,8 @@ CMemorySystem::CMemorySystem (boolean bEnableMMU)
 	size_t nBlockReserve = m_nMemSize - MEM_HEAP_START - PAGE_RESERVE;
 	m_HeapLow.Setup (MEM_HEAP_START, nBlockReserve, 0x40000);
 
+	m_HeapCoherent.Setup (MEM_DMA_COHERENT_POOL, DMA_COHERENT_POOL_SIZE, 0);
+
 	m_Pager.Setup (MEM_HEAP_START + nBlockReserve, PAGE_RESERVE);
 
 	if (m_bEnableMMU)
@@ -196,7 +199,8 @@ void CMemorySystem::EnableMMU (void)
 	// set MAIR0
 	u32 nMAIR0 =   LPAE_MAIR_NORMAL   << ATTRINDX_NORMAL*8
                      | LPAE_MAIR_DEVICE   << ATTRINDX_DEVICE*8
-	             | LPAE_MAIR_COHERENT << ATTRINDX_COHERENT*8;
+	             | LPAE_MAIR_COHERENT << ATTRINDX_COHERENT*8
+	             | LPAE_MAIR_NONCACHED << ATTRINDX_NONCACHED*8;
 	asm volatile ("mcr p15, 0, %0, c10, c2, 0" : : "r" (nMAIR0));
 
 	// set TTBCR
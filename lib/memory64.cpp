@@ -24,6 +24,7 @@
 #include <circle/spinlock.h>
 #include <circle/synchronize.h>
 #include <circle/sysconfig.h>
+#include <circle/util.h>
 #include <assert.h>
 
 CMemorySystem *CMemorySystem::s_pThis = 0;
@@ -36,6 +37,7 @@ CMemorySystem::CMemorySystem (boolean bEnableMMU)
 #if RASPPI >= 4
 	m_HeapHigh ("heaphigh"),
 #endif
+	m_HeapCoherent ("heapcoherent"),
 	m_pTranslationTable (0)
 {
 	if (s_pThis != 0)	// ignore second instance
@@ -58,6 +60,8 @@ CMemorySystem::CMemorySystem (boolean bEnableMMU)
 	size_t nBlockReserve = m_nMemSize - MEM_HEAP_START - PAGE_RESERVE;
 	m_HeapLow.Setup (MEM_HEAP_START, nBlockReserve, 0x40000);
 
+	m_HeapCoherent.Setup (MEM_DMA_COHERENT_POOL, DMA_COHERENT_POOL_SIZE, 0);
+
 	m_Pager.Setup (MEM_HEAP_START + nBlockReserve, PAGE_RESERVE);
 
 	if (m_bEnableMMU)
@@ -86,6 +90,9 @@ void CMemorySystem::Destructor (void)
 
 	if (m_bEnableMMU)
 	{
+		// return to the memory functions, which are used before the MMU is on
+		memfunc_select (MEMFUNC_CPU_GENERIC);
+
 		// disable MMU and data cache
 		u64 nSCTLR_EL1;
 		asm volatile ("mrs %0, sctlr_el1" : "=r" (nSCTLR_EL1));
@@ -157,7 +164,8 @@ void CMemorySystem::EnableMMU (void)
 
 	u64 nMAIR_EL1 =   0xFF << ATTRINDX_NORMAL*8	// inner/outer write-back non-transient, allocating
 	                | 0x04 << ATTRINDX_DEVICE*8	// Device-nGnRE
-	                | 0x00 << ATTRINDX_COHERENT*8;	// Device-nGnRnE
+	                | 0x00 << ATTRINDX_COHERENT*8	// Device-nGnRnE
+	                | 0x44 << ATTRINDX_NONCACHED*8;	// inner/outer non-cacheable
 	asm volatile ("msr mair_el1, %0" : : "r" (nMAIR_EL1));
 
 	assert (m_pTranslationTable != 0);
@@ -200,6 +208,19 @@ void CMemorySystem::EnableMMU (void)
 	asm volatile ("msr sctlr_el1, %0" : : "r" (nSCTLR_EL1) : "memory");
 }
 
+boolean CMemorySystem::SetMemoryAttributes (uintptr nBaseAddress, size_t nSize,
+					     unsigned nAttributes)
+{
+	assert (s_pThis != 0);
+	if (   !s_pThis->m_bEnableMMU
+	    || s_pThis->m_pTranslationTable == 0)
+	{
+		return FALSE;
+	}
+
+	return s_pThis->m_pTranslationTable->SetRegionAttributes (nBaseAddress, nSize, nAttributes);
+}
+
 uintptr CMemorySystem::GetCoherentPage (unsigned nSlot)
 {
 	u64 nPageAddress = MEM_COHERENT_REGION;
@@ -0,0 +1,295 @@
+//
+// metrics.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/metrics.h>
+#include <circle/util.h>
+#include <assert.h>
+
+static const char *s_pTypeName[MetricTypeUnknown] =
+{
+	"counter",
+	"gauge",
+	"histogram"
+};
+
+CMetric *CMetric::s_pFirst = 0;
+
+// TASK_LEVEL, because the zero-initialized state is valid then, metrics may be constructed
+// by global constructors before this object has been constructed
+CSpinLock CMetric::s_SpinLock (TASK_LEVEL);
+
+CMetric::CMetric (const char *pName, const char *pHelp, TMetricType Type, const char *pLabels)
+:	m_pName (pName),
+	m_pHelp (pHelp),
+	m_Type (Type),
+	m_pLabels (pLabels),
+	m_pNext (0)
+{
+	assert (m_pName != 0);
+	assert (m_pHelp != 0);
+	assert (m_Type < MetricTypeUnknown);
+
+	s_SpinLock.Acquire ();
+
+	// append to the list, so that the export order is the registration order
+	CMetric **ppMetric = &s_pFirst;
+	while (*ppMetric != 0)
+	{
+		ppMetric = &(*ppMetric)->m_pNext;
+	}
+
+	*ppMetric = this;
+
+	s_SpinLock.Release ();
+}
+
+CMetric::~CMetric (void)
+{
+	s_SpinLock.Acquire ();
+
+	for (CMetric **ppMetric = &s_pFirst; *ppMetric != 0; ppMetric = &(*ppMetric)->m_pNext)
+	{
+		if (*ppMetric == this)
+		{
+			*ppMetric = m_pNext;
+
+			break;
+		}
+	}
+
+	s_SpinLock.Release ();
+
+	m_pNext = 0;
+}
+
+unsigned CMetric::ExportAll (char *pBuffer, unsigned nBufferSize)
+{
+	assert (pBuffer != 0);
+
+	CString Output;
+
+	s_SpinLock.Acquire ();
+
+	for (CMetric *pMetric = s_pFirst; pMetric != 0; pMetric = pMetric->m_pNext)
+	{
+		// a family has been written already with its first member
+		CMetric *pPrevious;
+		for (pPrevious = s_pFirst; pPrevious != pMetric; pPrevious = pPrevious->m_pNext)
+		{
+			if (strcmp (pPrevious->m_pName, pMetric->m_pName) == 0)
+			{
+				break;
+			}
+		}
+
+		if (pPrevious != pMetric)
+		{
+			continue;
+		}
+
+		Output.Append ("# HELP ");
+		Output.Append (pMetric->m_pName);
+		Output.Append (" ");
+		Output.Append (pMetric->m_pHelp);
+		Output.Append ("\n# TYPE ");
+		Output.Append (pMetric->m_pName);
+		Output.Append (" ");
+		Output.Append (s_pTypeName[pMetric->m_Type]);
+		Output.Append ("\n");
+
+		for (CMetric *pMember = pMetric; pMember != 0; pMember = pMember->m_pNext)
+		{
+			if (strcmp (pMember->m_pName, pMetric->m_pName) == 0)
+			{
+				pMember->WriteSamples (&Output);
+			}
+		}
+	}
+
+	s_SpinLock.Release ();
+
+	unsigned nLength = Output.GetLength ();
+	if (nLength > nBufferSize)
+	{
+		nLength = nBufferSize;
+	}
+
+	memcpy (pBuffer, (const char *) Output, nLength);
+
+	return nLength;
+}
+
+const char *CMetric::GetContentType (void)
+{
+	return "text/plain; version=0.0.4";
+}
+
+void CMetric::WriteSampleName (CString *pOutput, const char *pSuffix,
+			       const char *pExtraLabel) const
+{
+	pOutput->Append (m_pName);
+
+	if (pSuffix != 0)
+	{
+		pOutput->Append (pSuffix);
+	}
+
+	if (   m_pLabels != 0
+	    || pExtraLabel != 0)
+	{
+		pOutput->Append ("{");
+
+		if (m_pLabels != 0)
+		{
+			pOutput->Append (m_pLabels);
+
+			if (pExtraLabel != 0)
+			{
+				pOutput->Append (",");
+			}
+		}
+
+		if (pExtraLabel != 0)
+		{
+			pOutput->Append (pExtraLabel);
+		}
+
+		pOutput->Append ("}");
+	}
+
+	pOutput->Append (" ");
+}
+
+void CMetric::AppendU64 (CString *pOutput, u64 nValue)
+{
+	// CString::Format() supports "%llu" with STDLIB_SUPPORT only
+	char Buffer[21];
+	char *p = &Buffer[sizeof Buffer-1];
+	*p = '\0';
+
+	do
+	{
+		*--p = '0' + nValue % 10;
+		nValue /= 10;
+	}
+	while (nValue != 0);
+
+	pOutput->Append (p);
+}
+
+void CMetric::AppendS64 (CString *pOutput, s64 nValue)
+{
+	if (nValue < 0)
+	{
+		pOutput->Append ("-");
+
+		AppendU64 (pOutput, -(u64) nValue);
+	}
+	else
+	{
+		AppendU64 (pOutput, nValue);
+	}
+}
+
+CMetricCounter::CMetricCounter (const char *pName, const char *pHelp, const char *pLabels)
+:	CMetric (pName, pHelp, MetricCounter, pLabels),
+	m_nValue (0)
+{
+}
+
+void CMetricCounter::WriteSamples (CString *pOutput) const
+{
+	WriteSampleName (pOutput);
+	AppendU64 (pOutput, Get ());
+	pOutput->Append ("\n");
+}
+
+CMetricGauge::CMetricGauge (const char *pName, const char *pHelp, const char *pLabels)
+:	CMetric (pName, pHelp, MetricGauge, pLabels),
+	m_nValue (0)
+{
+}
+
+void CMetricGauge::WriteSamples (CString *pOutput) const
+{
+	WriteSampleName (pOutput);
+	AppendS64 (pOutput, Get ());
+	pOutput->Append ("\n");
+}
+
+CMetricHistogram::CMetricHistogram (const char *pName, const char *pHelp,
+				    const u64 *pBounds, unsigned nBounds, const char *pLabels)
+:	CMetric (pName, pHelp, MetricHistogram, pLabels),
+	m_pBounds (pBounds),
+	m_nBounds (nBounds),
+	m_nSum (0)
+{
+	assert (m_pBounds != 0);
+	assert (m_nBounds <= METRIC_HISTOGRAM_MAX_BUCKETS);
+
+	for (unsigned i = 0; i <= METRIC_HISTOGRAM_MAX_BUCKETS; i++)
+	{
+		m_nBucket[i] = 0;
+	}
+}
+
+void CMetricHistogram::Observe (u64 nValue)
+{
+	unsigned i;
+	for (i = 0; i < m_nBounds; i++)
+	{
+		if (nValue <= m_pBounds[i])
+		{
+			break;
+		}
+	}
+
+	__atomic_add_fetch (&m_nBucket[i], 1, __ATOMIC_RELAXED);
+	__atomic_add_fetch (&m_nSum, nValue, __ATOMIC_RELAXED);
+}
+
+void CMetricHistogram::WriteSamples (CString *pOutput) const
+{
+	u64 nCumulative = 0;
+	for (unsigned i = 0; i <= m_nBounds; i++)
+	{
+		nCumulative += __atomic_load_n (&m_nBucket[i], __ATOMIC_RELAXED);
+
+		CString Label ("le=\"+Inf\"");
+		if (i < m_nBounds)
+		{
+			Label = "le=\"";
+			AppendU64 (&Label, m_pBounds[i]);
+			Label.Append ("\"");
+		}
+
+		WriteSampleName (pOutput, "_bucket", Label);
+		AppendU64 (pOutput, nCumulative);
+		pOutput->Append ("\n");
+	}
+
+	WriteSampleName (pOutput, "_sum");
+	AppendU64 (pOutput, __atomic_load_n (&m_nSum, __ATOMIC_RELAXED));
+	pOutput->Append ("\n");
+
+	// use the bucket sum, so that the count matches the +Inf bucket
+	WriteSampleName (pOutput, "_count");
+	AppendU64 (pOutput, nCumulative);
+	pOutput->Append ("\n");
+}
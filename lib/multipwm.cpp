@@ -0,0 +1,264 @@
+//
+// multipwm.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/multipwm.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#define MIN_DELAY	3		// edges nearer than this are handled at once (us)
+#define START_DELAY	100		// first period starts after this (us)
+
+CMultiPWM::CMultiPWM (CInterruptSystem *pInterruptSystem, unsigned nFrequencyHz,
+		      boolean bUseFIQ)
+:	m_UserTimer (pInterruptSystem, TimerStub, this, bUseFIQ),
+	m_nPeriodMicros (0),
+	m_nChannels (0),
+	m_nActive (0),
+	m_bSwapPending (FALSE),
+	m_bRunning (FALSE),
+	m_nNextEdge (0),
+	m_nPeriodStart (0),
+	m_nNextCompare (0)
+{
+	assert (nFrequencyHz > 0);
+	m_nPeriodMicros = USER_CLOCKHZ / nFrequencyHz;
+	assert (m_nPeriodMicros > 2*MIN_DELAY);
+
+	for (unsigned i = 0; i < MULTIPWM_MAX_CHANNELS; i++)
+	{
+		m_nPulseWidth[i] = 0;
+	}
+
+	Compile (&m_Schedule[0]);
+	Compile (&m_Schedule[1]);
+}
+
+CMultiPWM::~CMultiPWM (void)
+{
+	if (m_bRunning)
+	{
+		Stop ();
+	}
+}
+
+int CMultiPWM::AddChannel (unsigned nGPIOPin)
+{
+	assert (!m_bRunning);
+
+	if (   m_nChannels >= MULTIPWM_MAX_CHANNELS
+	    || nGPIOPin >= 32)
+	{
+		return -1;
+	}
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		if (m_Pin[i].GetPin () == nGPIOPin)
+		{
+			return -1;
+		}
+	}
+
+	m_Pin[m_nChannels].AssignPin (nGPIOPin);
+	m_Pin[m_nChannels].SetMode (GPIOModeOutput);
+	m_nPulseWidth[m_nChannels] = 0;
+
+	return m_nChannels++;
+}
+
+void CMultiPWM::SetPulseWidth (unsigned nChannel, unsigned nMicros)
+{
+	assert (nChannel < m_nChannels);
+
+	m_nPulseWidth[nChannel] = nMicros;
+}
+
+void CMultiPWM::SetDutyCycle (unsigned nChannel, unsigned nValue, unsigned nRange)
+{
+	assert (nRange > 0);
+	assert (nValue <= nRange);
+
+	SetPulseWidth (nChannel, (u32) ((u64) m_nPeriodMicros * nValue / nRange));
+}
+
+void CMultiPWM::Update (void)
+{
+	if (!m_bRunning)
+	{
+		Compile (&m_Schedule[m_nActive]);
+
+		return;
+	}
+
+	// the other schedule is still waiting to be played
+	while (m_bSwapPending)
+	{
+		DataMemBarrier ();
+	}
+
+	Compile (&m_Schedule[m_nActive ^ 1]);
+
+	DataSyncBarrier ();
+
+	m_bSwapPending = TRUE;
+}
+
+boolean CMultiPWM::Start (void)
+{
+	assert (!m_bRunning);
+
+	m_nActive = 0;
+	m_bSwapPending = FALSE;
+	Compile (&m_Schedule[0]);
+
+	m_nNextEdge = 0;
+
+	if (!m_UserTimer.Initialize ())
+	{
+		return FALSE;
+	}
+
+	m_bRunning = TRUE;
+
+	m_nNextCompare = CUserTimer::GetCounter () + START_DELAY;
+	m_UserTimer.StartAt (m_nNextCompare);
+
+	return TRUE;
+}
+
+void CMultiPWM::Stop (void)
+{
+	assert (m_bRunning);
+
+	m_UserTimer.Stop ();
+
+	m_bRunning = FALSE;
+	m_bSwapPending = FALSE;
+
+	CGPIOPin::WriteAll (0, m_Schedule[m_nActive].nAllMask);
+}
+
+void CMultiPWM::Compile (TSchedule *pSchedule)
+{
+	assert (pSchedule != 0);
+
+	pSchedule->nSetMask = 0;
+	pSchedule->nAllMask = 0;
+	pSchedule->nEdges = 0;
+
+	for (unsigned i = 0; i < m_nChannels; i++)
+	{
+		u32 nMask = 1 << m_Pin[i].GetPin ();
+		pSchedule->nAllMask |= nMask;
+
+		unsigned nWidth = m_nPulseWidth[i];
+		if (nWidth == 0)
+		{
+			continue;
+		}
+
+		pSchedule->nSetMask |= nMask;
+
+		if (nWidth >= m_nPeriodMicros)
+		{
+			continue;		// no falling edge
+		}
+
+		if (nWidth < MIN_DELAY)
+		{
+			nWidth = MIN_DELAY;
+		}
+
+		// insert into the edges, which are sorted by ascending offset
+		unsigned j;
+		for (j = 0; j < pSchedule->nEdges; j++)
+		{
+			if (pSchedule->Edge[j].nOffset >= nWidth)
+			{
+				break;
+			}
+		}
+
+		if (   j < pSchedule->nEdges
+		    && pSchedule->Edge[j].nOffset == nWidth)
+		{
+			pSchedule->Edge[j].nClearMask |= nMask;
+
+			continue;
+		}
+
+		for (unsigned k = pSchedule->nEdges; k > j; k--)
+		{
+			pSchedule->Edge[k] = pSchedule->Edge[k-1];
+		}
+
+		pSchedule->Edge[j].nOffset = nWidth;
+		pSchedule->Edge[j].nClearMask = nMask;
+		pSchedule->nEdges++;
+	}
+}
+
+void CMultiPWM::TimerHandler (void)
+{
+	do
+	{
+		if (m_nNextEdge == 0)
+		{
+			// swap the schedule at the period start only
+			if (m_bSwapPending)
+			{
+				m_nActive ^= 1;
+				m_bSwapPending = FALSE;
+			}
+
+			const TSchedule *pSchedule = &m_Schedule[m_nActive];
+			CGPIOPin::WriteAll (pSchedule->nSetMask, pSchedule->nAllMask);
+
+			m_nPeriodStart = m_nNextCompare;
+		}
+		else
+		{
+			const TSchedule *pSchedule = &m_Schedule[m_nActive];
+			assert (m_nNextEdge <= pSchedule->nEdges);
+			CGPIOPin::WriteAll (0, pSchedule->Edge[m_nNextEdge-1].nClearMask);
+		}
+
+		const TSchedule *pSchedule = &m_Schedule[m_nActive];
+		if (m_nNextEdge < pSchedule->nEdges)
+		{
+			m_nNextCompare = m_nPeriodStart + pSchedule->Edge[m_nNextEdge++].nOffset;
+		}
+		else
+		{
+			m_nNextCompare = m_nPeriodStart + m_nPeriodMicros;
+			m_nNextEdge = 0;
+		}
+	}
+	while ((int) (m_nNextCompare - CUserTimer::GetCounter ()) < MIN_DELAY);
+
+	m_UserTimer.StartAt (m_nNextCompare);
+}
+
+void CMultiPWM::TimerStub (CUserTimer *pUserTimer, void *pParam)
+{
+	CMultiPWM *pThis = (CMultiPWM *) pParam;
+	assert (pThis != 0);
+
+	pThis->TimerHandler ();
+}
@@ -27,7 +27,13 @@
 #define ARP_TIMEOUT_HZ		MSEC2HZ (800)
 #define ARP_MAX_ATTEMPTS	3
 
-#define ARP_LIFETIME_HZ		(600 * HZ)
+#define ARP_LIFETIME_HZ		(600 * HZ)	// after the last received packet
+
+// entries, which have been used recently, are refreshed before they expire,
+// so that sending to a known neighbor never has to wait for ARP
+#define ARP_REFRESH_HZ		(ARP_LIFETIME_HZ - 30 * HZ)
+#define ARP_REFRESH_INTERVAL_HZ	(5 * HZ)
+#define ARP_REFRESH_UNICAST	3		// attempts, before broadcasting
 
 struct TARPPacket
 {
@@ -60,18 +66,33 @@ CARPHandler::CARPHandler (CNetConfig *pNetConfig, CNetDeviceLayer *pNetDevLayer,
 	m_pNetDevLayer (pNetDevLayer),
 	m_pLinkLayer (pLinkLayer),
 	m_pRxQueue (pRxQueue),
+	m_nFreeList (0),
 	m_nEntries (0),
-	m_nTicksLastCleanup (0)
+	m_nPending (0),
+	m_nTicksLastRefresh (0),
+	m_nGeneration (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pNetDevLayer != 0);
 	assert (m_pLinkLayer != 0);
 	assert (m_pRxQueue != 0);
+
+	for (unsigned nEntry = 0; nEntry < ARP_CACHE_SIZE; nEntry++)
+	{
+		m_Entry[nEntry].State = ARPStateFreeSlot;
+		m_Entry[nEntry].pTxQueue = 0;
+		m_Entry[nEntry].nNext = nEntry+1 < ARP_CACHE_SIZE ? nEntry+1 : ARP_NO_ENTRY;
+	}
+
+	for (unsigned i = 0; i < ARP_HASH_SIZE; i++)
+	{
+		m_Hash[i] = ARP_NO_ENTRY;
+	}
 }
 
 CARPHandler::~CARPHandler (void)
 {
-	for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
+	for (unsigned nEntry = 0; nEntry < ARP_CACHE_SIZE; nEntry++)
 	{
 		delete m_Entry[nEntry].pTxQueue;
 		m_Entry[nEntry].pTxQueue = 0;
@@ -135,7 +156,7 @@ void CARPHandler::Process (void)
 
 	assert (m_pLinkLayer != 0);
 	assert (m_pNetDevLayer != 0);
-	for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
+	for (unsigned nEntry = 0; m_nPending > 0 && nEntry < ARP_CACHE_SIZE; nEntry++)
 	{
 		TARPEntry *pEntry = &m_Entry[nEntry];
 		switch (pEntry->State)
@@ -162,7 +183,14 @@ void CARPHandler::Process (void)
 					m_pLinkLayer->ResolveFailed (Buffer, nResultLength);
 				}
 
-				pEntry->State = ARPStateFreeSlot;
+				m_SpinLock.Acquire ();
+
+				assert (m_nPending > 0);
+				m_nPending--;
+
+				FreeEntry (nEntry);
+
+				m_SpinLock.Release ();
 			}
 			break;
 
@@ -177,7 +205,14 @@ void CARPHandler::Process (void)
 				m_pNetDevLayer->Send (Buffer, nResultLength);
 			}
 
+			m_SpinLock.Acquire ();
+
+			assert (m_nPending > 0);
+			m_nPending--;
+
 			pEntry->State = ARPStateValid;
+
+			m_SpinLock.Release ();
 			break;
 
 		default:
@@ -186,118 +221,61 @@ void CARPHandler::Process (void)
 	}
 
 	unsigned nTicks = CTimer::Get ()->GetTicks ();
-	if (nTicks - m_nTicksLastCleanup >= 60*HZ)
+	if (nTicks - m_nTicksLastRefresh >= HZ)
 	{
-		m_nTicksLastCleanup = nTicks;
-
-		m_SpinLock.Acquire ();
-
-		for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
-		{
-			if (   m_Entry[nEntry].State == ARPStateValid
-			    && m_Entry[nEntry].nTicksLastUsed + ARP_LIFETIME_HZ < nTicks)
-			{
-				m_Entry[nEntry].State = ARPStateFreeSlot;
-			}
-		}
+		m_nTicksLastRefresh = nTicks;
 
-		m_SpinLock.Release ();
+		RefreshEntries ();
 	}
 }
 
 boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAddress,
 			      const void *pFrame, unsigned nFrameLength)
 {
-	unsigned nFreeSlot = ARP_MAX_ENTRIES;
-
-	unsigned nOldestEntry = -1;
-	unsigned nMinTicks = -1;
-
 	m_SpinLock.Acquire ();
 
-	unsigned nEntry;
-	for (nEntry = 0; nEntry < m_nEntries; nEntry++)
+	TARPEntry *pEntry = Lookup (rIPAddress);
+	if (pEntry != 0)
 	{
-		switch (m_Entry[nEntry].State)
-		{
-		case ARPStateFreeSlot:
-			if (nFreeSlot == ARP_MAX_ENTRIES)
-			{
-				nFreeSlot = nEntry;
-			}
-			break;
-
-		case ARPStateRequestSent:
-		case ARPStateRetryRequest:
-		case ARPStateSendTxQueue:
-			if (rIPAddress == m_Entry[nEntry].IPAddress)
-			{
-				assert (m_Entry[nEntry].pTxQueue != 0);
-				m_Entry[nEntry].pTxQueue->Enqueue (pFrame, nFrameLength);
-
-				m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
-
-				m_SpinLock.Release ();
+		pEntry->nTicksLastUsed = CTimer::Get ()->GetTicks ();
 
-				return FALSE;
-			}
-			break;
+		if (pEntry->State == ARPStateValid)
+		{
+			assert (pMACAddress != 0);
+			pMACAddress->Set (pEntry->MACAddress);
 
-		case ARPStateValid:
-			if (m_Entry[nEntry].nTicksLastUsed < nMinTicks)
-			{
-				nOldestEntry = nEntry;
-				nMinTicks = m_Entry[nEntry].nTicksLastUsed;
-			}
+			m_SpinLock.Release ();
 
-			if (rIPAddress == m_Entry[nEntry].IPAddress)
-			{
-				assert (pMACAddress != 0);
-				pMACAddress->Set (m_Entry[nEntry].MACAddress);
-				m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
+			return TRUE;
+		}
 
-				m_SpinLock.Release ();
+		assert (pEntry->pTxQueue != 0);
+		pEntry->pTxQueue->Enqueue (pFrame, nFrameLength);
 
-				return TRUE;
-			}
-			break;
+		m_SpinLock.Release ();
 
-		default:
-			assert (0);
-			break;
-		}
+		return FALSE;
 	}
 
-	if (nFreeSlot == ARP_MAX_ENTRIES)
+	unsigned nEntry = AllocateEntry (rIPAddress);
+	if (nEntry == ARP_NO_ENTRY)
 	{
-		if (m_nEntries < ARP_MAX_ENTRIES)
-		{
-			nFreeSlot = m_nEntries;
-			m_Entry[nFreeSlot].State = ARPStateFreeSlot;
-
-			m_Entry[nFreeSlot].pTxQueue = new CNetQueue;
-			assert (m_Entry[nFreeSlot].pTxQueue != 0);
+		m_SpinLock.Release ();		// all entries are pending, drop the frame
 
-			m_nEntries++;
-		}
-		else
-		{
-			assert (nOldestEntry < m_nEntries);
-			m_Entry[nOldestEntry].State = ARPStateFreeSlot;
-
-			nFreeSlot = nOldestEntry;
-		}
+		return FALSE;
 	}
-	nEntry = nFreeSlot;
-	TARPEntry *pEntry = &m_Entry[nEntry];
 
+	pEntry = &m_Entry[nEntry];
 	pEntry->State = ARPStateRequestSent;
-	rIPAddress.CopyTo (pEntry->IPAddress);
+	m_nPending++;
 
-	assert (pEntry->pTxQueue != 0);
-	pEntry->pTxQueue->Enqueue (pFrame, nFrameLength);
+	if (pEntry->pTxQueue == 0)
+	{
+		pEntry->pTxQueue = new CNetQueue;
+		assert (pEntry->pTxQueue != 0);
+	}
 
-	pEntry->nTicksLastUsed = CTimer::Get ()->GetTicks ();
+	pEntry->pTxQueue->Enqueue (pFrame, nFrameLength);
 
 	pEntry->nAttempts = 1;
 
@@ -313,25 +291,84 @@ boolean CARPHandler::Resolve (const CIPAddress &rIPAddress, CMACAddress *pMACAdd
 	return FALSE;
 }
 
+boolean CARPHandler::IsResolved (const CIPAddress &rIPAddress)
+{
+	m_SpinLock.Acquire ();
+
+	TARPEntry *pEntry = Lookup (rIPAddress);
+	boolean bResult = pEntry != 0 && pEntry->State == ARPStateValid;
+
+	m_SpinLock.Release ();
+
+	return bResult;
+}
+
+boolean CARPHandler::Lookup (const CIPAddress &rIPAddress, CMACAddress *pMACAddress,
+			     unsigned *pEntry)
+{
+	m_SpinLock.Acquire ();
+
+	TARPEntry *pARPEntry = Lookup (rIPAddress);
+	if (   pARPEntry == 0
+	    || pARPEntry->State != ARPStateValid)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	pARPEntry->nTicksLastUsed = CTimer::Get ()->GetTicks ();
+
+	assert (pMACAddress != 0);
+	pMACAddress->Set (pARPEntry->MACAddress);
+
+	assert (pEntry != 0);
+	*pEntry = pARPEntry - m_Entry;
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+unsigned CARPHandler::GetGeneration (void) const
+{
+	return m_nGeneration;
+}
+
+void CARPHandler::Touch (unsigned nEntry)
+{
+	assert (nEntry < ARP_CACHE_SIZE);
+	m_Entry[nEntry].nTicksLastUsed = CTimer::Get ()->GetTicks ();
+}
+
 void CARPHandler::ReplyReceived (const CIPAddress &rForeignIP, const CMACAddress &rForeignMAC)
 {
 	m_SpinLock.Acquire ();
 
-	for (unsigned nEntry = 0; nEntry < m_nEntries; nEntry++)
+	TARPEntry *pEntry = Lookup (rForeignIP);
+	if (pEntry != 0)
 	{
-		if (   m_Entry[nEntry].State != ARPStateRequestSent
-		    && m_Entry[nEntry].State != ARPStateRetryRequest)
-		{
-			continue;
-		}
-			
-		if (rForeignIP == m_Entry[nEntry].IPAddress)
+		switch (pEntry->State)
 		{
-			CTimer::Get ()->CancelKernelTimer (m_Entry[nEntry].hTimer);
+		case ARPStateRequestSent:
+		case ARPStateRetryRequest:
+			CTimer::Get ()->CancelKernelTimer (pEntry->hTimer);
 
-			rForeignMAC.CopyTo (m_Entry[nEntry].MACAddress);
-			m_Entry[nEntry].State = ARPStateSendTxQueue;
+			rForeignMAC.CopyTo (pEntry->MACAddress);
+			pEntry->nTicksConfirmed = CTimer::Get ()->GetTicks ();
+			pEntry->State = ARPStateSendTxQueue;
+			break;
 
+		case ARPStateValid:		// response to refresh, MAC may have changed
+			if (rForeignMAC != CMACAddress (pEntry->MACAddress))
+			{
+				m_nGeneration++;
+			}
+			rForeignMAC.CopyTo (pEntry->MACAddress);
+			pEntry->nTicksConfirmed = CTimer::Get ()->GetTicks ();
+			break;
+
+		default:
 			break;
 		}
 	}
@@ -343,48 +380,189 @@ void CARPHandler::RequestReceived (const CIPAddress &rForeignIP, const CMACAddre
 {
 	m_SpinLock.Acquire ();
 
-	unsigned nFreeSlot = ARP_MAX_ENTRIES;
-	unsigned nEntry;
-	for (nEntry = 0; nEntry < m_nEntries; nEntry++)
+	if (Lookup (rForeignIP) != 0)
 	{
-		if (m_Entry[nEntry].State == ARPStateFreeSlot)
+		m_SpinLock.Release ();
+
+		// the request contains the current MAC address of the sender
+		ReplyReceived (rForeignIP, rForeignMAC);
+
+		return;
+	}
+
+	// the sender will most probably send to us, so we will have to reply
+	unsigned nEntry = AllocateEntry (rForeignIP);
+	if (nEntry != ARP_NO_ENTRY)
+	{
+		TARPEntry *pEntry = &m_Entry[nEntry];
+
+		rForeignMAC.CopyTo (pEntry->MACAddress);
+		pEntry->nTicksConfirmed = pEntry->nTicksLastUsed;
+
+		pEntry->State = ARPStateValid;
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CARPHandler::RefreshEntries (void)
+{
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	for (unsigned nEntry = 0; nEntry < ARP_CACHE_SIZE; nEntry++)
+	{
+		TARPEntry *pEntry = &m_Entry[nEntry];
+
+		m_SpinLock.Acquire ();
+
+		if (pEntry->State != ARPStateValid)
 		{
-			if (nFreeSlot == ARP_MAX_ENTRIES)
-			{
-				nFreeSlot = nEntry;
-			}
+			m_SpinLock.Release ();
+
+			continue;
+		}
+
+		if (   nTicks - pEntry->nTicksConfirmed >= ARP_LIFETIME_HZ
+		    || nTicks - pEntry->nTicksLastUsed >= ARP_LIFETIME_HZ)
+		{
+			FreeEntry (nEntry);
+
+			m_SpinLock.Release ();
+
+			continue;
+		}
+
+		if (   nTicks - pEntry->nTicksConfirmed < ARP_REFRESH_HZ
+		    || nTicks - pEntry->nTicksLastUsed >= ARP_REFRESH_HZ)
+		{
+			pEntry->nAttempts = 0;
+
+			m_SpinLock.Release ();
+
+			continue;
 		}
-		else if (rForeignIP == m_Entry[nEntry].IPAddress)
+
+		if (   pEntry->nAttempts > 0
+		    && nTicks - pEntry->nTicksRefresh < ARP_REFRESH_INTERVAL_HZ)
 		{
 			m_SpinLock.Release ();
 
-			return;
+			continue;
+		}
+
+		pEntry->nTicksRefresh = nTicks;
+
+		CIPAddress ForeignIP (pEntry->IPAddress);
+		CMACAddress ForeignMAC (pEntry->MACAddress);
+		if (pEntry->nAttempts++ >= ARP_REFRESH_UNICAST)
+		{
+			ForeignMAC.SetBroadcast ();
 		}
+
+		m_SpinLock.Release ();
+
+		// the entry remains valid, until the refresh finally failed
+		SendPacket (TRUE, ForeignIP, ForeignMAC);
 	}
+}
 
-	if (   nFreeSlot == ARP_MAX_ENTRIES
-	    && m_nEntries < ARP_MAX_ENTRIES)
-	{
-		nFreeSlot = m_nEntries;
-		m_Entry[nFreeSlot].State = ARPStateFreeSlot;
+unsigned CARPHandler::Hash (const u8 *pIPAddress)
+{
+	assert (pIPAddress != 0);
 
-		m_Entry[nFreeSlot].pTxQueue = new CNetQueue;
-		assert (m_Entry[nFreeSlot].pTxQueue != 0);
+	// the host part varies the most on a LAN
+	return (pIPAddress[3] ^ (pIPAddress[2] * 37) ^ (pIPAddress[1] * 11)) & (ARP_HASH_SIZE-1);
+}
+
+TARPEntry *CARPHandler::Lookup (const CIPAddress &rIPAddress)
+{
+	u8 IPAddress[IP_ADDRESS_SIZE];
+	rIPAddress.CopyTo (IPAddress);
+
+	for (unsigned nEntry = m_Hash[Hash (IPAddress)];
+	     nEntry != ARP_NO_ENTRY;
+	     nEntry = m_Entry[nEntry].nNext)
+	{
+		assert (nEntry < ARP_CACHE_SIZE);
+		if (rIPAddress == m_Entry[nEntry].IPAddress)
+		{
+			assert (m_Entry[nEntry].State != ARPStateFreeSlot);
 
-		m_nEntries++;
+			return &m_Entry[nEntry];
+		}
 	}
 
-	if (nFreeSlot < ARP_MAX_ENTRIES)
+	return 0;
+}
+
+unsigned CARPHandler::AllocateEntry (const CIPAddress &rIPAddress)
+{
+	if (m_nFreeList == ARP_NO_ENTRY)
 	{
-		rForeignIP.CopyTo (m_Entry[nFreeSlot].IPAddress);
-		rForeignMAC.CopyTo (m_Entry[nFreeSlot].MACAddress);
+		// replace the least recently used valid entry
+		unsigned nTicks = CTimer::Get ()->GetTicks ();
+		unsigned nOldestEntry = ARP_NO_ENTRY;
+		unsigned nMaxAge = 0;
 
-		m_Entry[nFreeSlot].nTicksLastUsed = CTimer::Get ()->GetTicks ();
+		for (unsigned nEntry = 0; nEntry < ARP_CACHE_SIZE; nEntry++)
+		{
+			if (   m_Entry[nEntry].State == ARPStateValid
+			    && (   nOldestEntry == ARP_NO_ENTRY
+				|| nTicks - m_Entry[nEntry].nTicksLastUsed > nMaxAge))
+			{
+				nOldestEntry = nEntry;
+				nMaxAge = nTicks - m_Entry[nEntry].nTicksLastUsed;
+			}
+		}
+
+		if (nOldestEntry == ARP_NO_ENTRY)
+		{
+			return ARP_NO_ENTRY;
+		}
 
-		m_Entry[nFreeSlot].State = ARPStateValid;
+		FreeEntry (nOldestEntry);
 	}
 
-	m_SpinLock.Release ();
+	unsigned nEntry = m_nFreeList;
+	assert (nEntry < ARP_CACHE_SIZE);
+	TARPEntry *pEntry = &m_Entry[nEntry];
+	assert (pEntry->State == ARPStateFreeSlot);
+	m_nFreeList = pEntry->nNext;
+
+	rIPAddress.CopyTo (pEntry->IPAddress);
+	pEntry->nTicksLastUsed = CTimer::Get ()->GetTicks ();
+	pEntry->nAttempts = 0;
+
+	unsigned nHash = Hash (pEntry->IPAddress);
+	pEntry->nNext = m_Hash[nHash];
+	m_Hash[nHash] = nEntry;
+
+	m_nEntries++;
+
+	return nEntry;
+}
+
+void CARPHandler::FreeEntry (unsigned nEntry)
+{
+	assert (nEntry < ARP_CACHE_SIZE);
+	TARPEntry *pEntry = &m_Entry[nEntry];
+	assert (pEntry->State != ARPStateFreeSlot);
+
+	u16 *pLink = &m_Hash[Hash (pEntry->IPAddress)];
+	while (*pLink != nEntry)
+	{
+		assert (*pLink != ARP_NO_ENTRY);
+		pLink = &m_Entry[*pLink].nNext;
+	}
+	*pLink = pEntry->nNext;
+
+	pEntry->State = ARPStateFreeSlot;
+	m_nGeneration++;			// cached flows may refer to this entry
+	pEntry->nNext = m_nFreeList;
+	m_nFreeList = nEntry;
+
+	assert (m_nEntries > 0);
+	m_nEntries--;
 }
 
 void CARPHandler::SendPacket (boolean		 bRequest,
@@ -425,7 +603,7 @@ void CARPHandler::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *p
 	assert (pThis != 0);
 
 	unsigned nEntry = (unsigned) (uintptr) pParam;
-	assert (nEntry < pThis->m_nEntries);
+	assert (nEntry < ARP_CACHE_SIZE);
 
 	pThis->m_SpinLock.Acquire ();
 
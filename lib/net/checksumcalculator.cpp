@@ -21,6 +21,14 @@
 #include <circle/util.h>
 #include <assert.h>
 
+#if AARCH == 64
+
+#define CHECKSUM_NEON_BLOCK	64		// bytes summed up per loop in checksum_fast.S
+
+extern "C" u64 checksum_neon (const void *pBuffer, size_t nLength);
+
+#endif
+
 CChecksumCalculator::CChecksumCalculator (const CIPAddress &rSourceIP, int nProtocol)
 :	m_bDestAddressSet (FALSE)
 {
@@ -69,6 +77,28 @@ u16 CChecksumCalculator::Calculate (const void *pBuffer, unsigned nLength)
 	return ~FoldResult (nChecksum);
 }
 
+u16 CChecksumCalculator::Calculate (const CNetBuffer *pBuffer)
+{
+	assert (m_bDestAddressSet);
+
+	assert (pBuffer != 0);
+	m_Header.nTCPLength = le2be16 (pBuffer->GetTotalLength ());
+	u32 nChecksum = CalculateChunk (&m_Header, sizeof m_Header, 0);
+
+	nChecksum = CalculateChain (pBuffer, pBuffer->GetData (), nChecksum);
+
+	return ~FoldResult (nChecksum);
+}
+
+u16 CChecksumCalculator::CalculatePseudoHeader (unsigned nLength)
+{
+	assert (m_bDestAddressSet);
+
+	m_Header.nTCPLength = le2be16 (nLength);
+
+	return FoldResult (CalculateChunk (&m_Header, sizeof m_Header, 0));
+}
+
 u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 {
 	assert (pBuffer != 0);
@@ -78,25 +108,133 @@ u16 CChecksumCalculator::SimpleCalculate (const void *pBuffer, unsigned nLength)
 	return ~FoldResult (nChecksum);
 }
 
+void CChecksumCalculator::CompletePartial (CNetBuffer *pBuffer)
+{
+	assert (pBuffer != 0);
+	assert (pBuffer->IsChecksumPartial ());
+
+	u8 *pStart = pBuffer->GetData () + pBuffer->GetChecksumStart ();
+	u16 *pChecksum = (u16 *) (pStart + pBuffer->GetChecksumOffset ());
+
+	// the checksum field already holds the checksum of the pseudo header
+	u16 nChecksum = ~FoldResult (CalculateChain (pBuffer, pStart, 0));
+
+	*pChecksum = nChecksum != 0 ? nChecksum : 0xFFFF;	// 0 means "no checksum" for UDP
+
+	pBuffer->ClearChecksumPartial ();
+}
+
+u32 CChecksumCalculator::CalculateChain (const CNetBuffer *pBuffer, const u8 *pStart, u32 nChecksum)
+{
+	assert (pBuffer != 0);
+	assert (pStart >= pBuffer->GetData ());
+
+	boolean bOddOffset = FALSE;
+	for (; pBuffer != 0; pBuffer = pBuffer->GetNextSegment (), pStart = 0)
+	{
+		const u8 *pData = pStart != 0 ? pStart : pBuffer->GetData ();
+		unsigned nLength = pBuffer->GetLength () - (pData - pBuffer->GetData ());
+		if (nLength == 0)
+		{
+			continue;
+		}
+
+		u32 nChunk = FoldResult (CalculateChunk (pData, nLength, 0));
+		if (bOddOffset)
+		{
+			// segment starts at an odd offset, so its byte lanes are swapped
+			nChunk = (nChunk & 0xFF) << 8 | nChunk >> 8;
+		}
+
+		nChecksum += nChunk;
+
+		if (nLength & 1)
+		{
+			bOddOffset = !bOddOffset;
+		}
+	}
+
+	return nChecksum;
+}
+
 u32 CChecksumCalculator::CalculateChunk (const void *pBuffer, unsigned nLength, u32 nChecksum)
 {
-	u16 *pBuffer16 = (u16 *) pBuffer;
-	assert (pBuffer16 != 0);
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	assert (pBuffer8 != 0);
 	assert (nLength > 0);
 
-	while (nLength >= 2)
+	// The one's complement sum does not depend on the word size used for the additions,
+	// so 32-bit words are summed up into a 64-bit accumulator, which cannot overflow.
+	u64 nSum = nChecksum;
+
+	if ((uintptr) pBuffer8 & 1)
 	{
-		nChecksum += *pBuffer16++;
-		nLength -= 2;
+		// odd address: use the slower 16-bit loop, which may access unaligned words
+		const u16 *pBuffer16 = (const u16 *) pBuffer8;
+		while (nLength >= 2)
+		{
+			nSum += *pBuffer16++;
+			nLength -= 2;
+		}
+
+		pBuffer8 = (const u8 *) pBuffer16;
+	}
+	else
+	{
+		if (   ((uintptr) pBuffer8 & 2)
+		    && nLength >= 2)
+		{
+			nSum += *(const u16 *) pBuffer8;
+			pBuffer8 += 2;
+			nLength -= 2;
+		}
+
+#if AARCH == 64
+		if (nLength >= CHECKSUM_NEON_BLOCK)
+		{
+			unsigned nBlockLength = nLength & ~(CHECKSUM_NEON_BLOCK-1);
+			nSum += checksum_neon (pBuffer8, nBlockLength);
+			pBuffer8 += nBlockLength;
+			nLength -= nBlockLength;
+		}
+#endif
+
+		const u32 *pBuffer32 = (const u32 *) pBuffer8;
+		while (nLength >= 16)
+		{
+			nSum += pBuffer32[0];
+			nSum += pBuffer32[1];
+			nSum += pBuffer32[2];
+			nSum += pBuffer32[3];
+			pBuffer32 += 4;
+			nLength -= 16;
+		}
+
+		while (nLength >= 4)
+		{
+			nSum += *pBuffer32++;
+			nLength -= 4;
+		}
+
+		pBuffer8 = (const u8 *) pBuffer32;
+		if (nLength >= 2)
+		{
+			nSum += *(const u16 *) pBuffer8;
+			pBuffer8 += 2;
+			nLength -= 2;
+		}
 	}
 
 	assert (nLength <= 1);
 	if (nLength != 0)
 	{
-		nChecksum += *(u8 *) pBuffer16;
+		nSum += *pBuffer8;
 	}
-	
-	return nChecksum;
+
+	nSum = (nSum & 0xFFFFFFFF) + (nSum >> 32);
+	nSum = (nSum & 0xFFFFFFFF) + (nSum >> 32);
+
+	return (u32) nSum;
 }
 
 u16 CChecksumCalculator::FoldResult (u32 nChecksum)
@@ -18,80 +18,44 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/dnsclient.h>
-#include <circle/net/socket.h>
-#include <circle/net/in.h>
-#include <circle/sched/scheduler.h>
-#include <circle/macros.h>
 #include <circle/util.h>
 #include <assert.h>
 
-#define MAX_HOSTNAME_SIZE	256
-#define DNS_MAX_MESSAGE_SIZE	512
-
-struct TDNSHeader
+CDNSClient::CDNSClient (CNetSubSystem *pNetSubSystem)
+:	m_pNetSubSystem (pNetSubSystem)
 {
-	unsigned short nID;
-	unsigned short nFlags;
-#define DNS_FLAGS_QR		0x8000
-#define DNS_FLAGS_OPCODE	0x7800
-	#define DNS_FLAGS_OPCODE_QUERY		0x0000
-	#define DNS_FLAGS_OPCODE_IQUERY		0x0800
-	#define DNS_FLAGS_OPCODE_STATUS		0x1000
-#define DNS_FLAGS_AA		0x0400
-#define DNS_FLAGS_TC		0x0200
-#define DNS_FLAGS_RD		0x0100
-#define DNS_FLAGS_RA		0x0080
-#define DNS_FLAGS_RCODE		0x000F
-	#define DNS_RCODE_SUCCESS		0x0000
-	#define DNS_RCODE_FORMAT_ERROR		0x0001
-	#define DNS_RCODE_SERVER_FAILURE	0x0002
-	#define DNS_RCODE_NAME_ERROR		0x0003
-	#define DNS_RCODE_NOT_IMPLEMENTED	0x0004
-	#define DNS_RCODE_REFUSED		0x0005
-	unsigned short nQDCount;
-	unsigned short nANCount;
-	unsigned short nNSCount;
-	unsigned short nARCount;
+	assert (m_pNetSubSystem != 0);
 }
-PACKED;
 
-struct TDNSQueryTrailer
+CDNSClient::~CDNSClient (void)
 {
-	unsigned short nQType;
-#define DNS_QTYPE_A		1
-	unsigned short nQClass;
-#define DNS_QCLASS_IN		1
+	m_pNetSubSystem = 0;
 }
-PACKED;
 
-struct TDNSResourceRecordTrailerAIN
+boolean CDNSClient::Resolve (const char *pHostname, CIPAddress *pIPAddress)
 {
-	unsigned short nType;
-	unsigned short nClass;
-	unsigned int   nTTL;
-	unsigned short nRDLength;
-#define DNS_RDLENGTH_AIN	4
-	unsigned char  RData[DNS_RDLENGTH_AIN];
-}
-PACKED;
+	assert (pIPAddress != 0);
 
-#define DNS_RR_TRAILER_HEADER_LENGTH	( sizeof (struct TDNSResourceRecordTrailerAIN) \
-					 - DNS_RDLENGTH_AIN)
+	TResolveRequest Request;
+	Request.pIPAddress = pIPAddress;
+	Request.bOK = FALSE;
 
-u16 CDNSClient::s_nXID = 1;
+	switch (ResolveAsync (pHostname, pIPAddress, ResolveHandler, &Request))
+	{
+	case DNSResolveOK:
+		return TRUE;
 
-CDNSClient::CDNSClient (CNetSubSystem *pNetSubSystem)
-:	m_pNetSubSystem (pNetSubSystem)
-{
-	assert (m_pNetSubSystem != 0);
-}
+	case DNSResolvePending:
+		Request.Event.Wait ();
+		return Request.bOK;
 
-CDNSClient::~CDNSClient (void)
-{
-	m_pNetSubSystem = 0;
+	default:
+		return FALSE;
+	}
 }
 
-boolean CDNSClient::Resolve (const char *pHostname, CIPAddress *pIPAddress)
+TDNSResolveStatus CDNSClient::ResolveAsync (const char *pHostname, CIPAddress *pIPAddress,
+					    TDNSResolveHandler *pHandler, void *pParam)
 {
 	assert (pHostname != 0);
 	assert (pIPAddress != 0);
@@ -102,7 +66,7 @@ boolean CDNSClient::Resolve (const char *pHostname, CIPAddress *pIPAddress)
 	{
 		if (ConvertIPString (pHostname, pIPAddress))
 		{
-			return TRUE;
+			return DNSResolveOK;
 		}
 	}
 	else if (strcmp (pHostname, "localhost") == 0)
@@ -112,179 +76,32 @@ boolean CDNSClient::Resolve (const char *pHostname, CIPAddress *pIPAddress)
 
 		if (pIP->IsNull ())
 		{
-			return FALSE;
+			return DNSResolveFailed;
 		}
 
 		pIPAddress->Set (*pIP);
 
-		return TRUE;
-	}
-
-	CIPAddress DNSServer (m_pNetSubSystem->GetConfig ()->GetDNSServer ()->Get ());
-	if (DNSServer.IsNull ())
-	{
-		return FALSE;
-	}
-
-	CSocket Socket (m_pNetSubSystem, IPPROTO_UDP);
-	if (Socket.Connect (DNSServer, 53) != 0)
-	{
-		return FALSE;
-	}
-
-	u8 Buffer[DNS_MAX_MESSAGE_SIZE];
-	memset (Buffer, 0, sizeof Buffer);
-	TDNSHeader *pDNSHeader = (TDNSHeader *) Buffer;
-
-	u16 nXID = s_nXID++;
-
-	pDNSHeader->nID      = le2be16 (nXID);
-	pDNSHeader->nFlags   = BE (DNS_FLAGS_OPCODE_QUERY | DNS_FLAGS_RD);
-	pDNSHeader->nQDCount = BE (1);
-
-	u8 *pQuery = Buffer + sizeof (TDNSHeader);
-
-	char Hostname[MAX_HOSTNAME_SIZE];
-	strncpy (Hostname, pHostname, MAX_HOSTNAME_SIZE-1);
-	Hostname[MAX_HOSTNAME_SIZE-1] = '\0';
-
-	char *pSavePtr;
-	size_t nLength;
-	char *pLabel = strtok_r (Hostname, ".", &pSavePtr);
-	while (pLabel != 0)
-	{
-		nLength = strlen (pLabel);
-		if (   nLength > 255
-		    || (int) (nLength+1+1) >= DNS_MAX_MESSAGE_SIZE-(pQuery-Buffer))
-		{
-			return FALSE;
-		}
-
-		*pQuery++ = (u8) nLength;
-
-		strcpy ((char *) pQuery, pLabel);
-		pQuery += nLength;
-
-		pLabel = strtok_r (0, ".", &pSavePtr);
-	}
-
-	*pQuery++ = '\0';
-
-	TDNSQueryTrailer QueryTrailer;
-	QueryTrailer.nQType  = BE (DNS_QTYPE_A);
-	QueryTrailer.nQClass = BE (DNS_QCLASS_IN);
-
-	if ((int) (sizeof QueryTrailer) > DNS_MAX_MESSAGE_SIZE-(pQuery-Buffer))
-	{
-		return FALSE;
-	}
-	memcpy (pQuery, &QueryTrailer, sizeof QueryTrailer);
-	pQuery += sizeof QueryTrailer;
-	
-	int nSize = pQuery - Buffer;
-	assert (nSize <= DNS_MAX_MESSAGE_SIZE);
-
-	unsigned char RecvBuffer[DNS_MAX_MESSAGE_SIZE];
-	int nRecvSize;
-
-	unsigned nTry = 1;
-	do
-	{
-		if (   nTry++ > 3
-		    || Socket.Send (Buffer, nSize, 0) != nSize)
-		{
-			return FALSE;
-		}
-
-		CScheduler::Get ()->MsSleep (1000);
-
-		nRecvSize = Socket.Receive (RecvBuffer, DNS_MAX_MESSAGE_SIZE, MSG_DONTWAIT);
-		assert (nRecvSize < DNS_MAX_MESSAGE_SIZE);
-		if (nRecvSize < 0)
-		{
-			return FALSE;
-		}
-	}
-	while (nRecvSize < (int) (sizeof (TDNSHeader)+sizeof (TDNSResourceRecordTrailerAIN)));
-
-	pDNSHeader = (TDNSHeader *) RecvBuffer;
-	if (   pDNSHeader->nID != le2be16 (nXID)
-	    ||    (pDNSHeader->nFlags & BE (  DNS_FLAGS_QR
-	                                    | DNS_FLAGS_OPCODE
-	                                    | DNS_FLAGS_TC
-	                                    | DNS_FLAGS_RCODE))
-	       != BE (DNS_FLAGS_QR | DNS_FLAGS_OPCODE_QUERY | DNS_RCODE_SUCCESS)
-	    || pDNSHeader->nQDCount != BE (1)
-	    || pDNSHeader->nANCount == BE (0))
-	{
-		return FALSE;
-	}
-
-	u8 *pResponse = RecvBuffer + sizeof (TDNSHeader);
-
-	// parse the query section
-	while ((nLength = *pResponse++) > 0)
-	{
-		pResponse += nLength;
-		if (pResponse-RecvBuffer >= nRecvSize)
-		{
-			return FALSE;
-		}
+		return DNSResolveOK;
 	}
 
-	pResponse += sizeof (TDNSQueryTrailer);
-	if (pResponse-RecvBuffer >= nRecvSize)
-	{
-		return FALSE;
-	}
+	return CDNSResolver::Get (m_pNetSubSystem)->Resolve (pHostname, pIPAddress,
+							      pHandler, pParam);
+}
 
-	TDNSResourceRecordTrailerAIN RRTrailer;
+void CDNSClient::ResolveHandler (const CIPAddress *pIPAddress, void *pParam)
+{
+	TResolveRequest *pRequest = (TResolveRequest *) pParam;
+	assert (pRequest != 0);
 
-	// parse the answer section
-	while (1)
+	if (pIPAddress != 0)
 	{
-		nLength = *pResponse++;
-		if ((nLength & 0xC0) == 0xC0)		// check for compression
-		{
-			pResponse++;
-		}
-		else
-		{
-			do
-			{
-				pResponse += nLength;
-				if (pResponse-RecvBuffer >= nRecvSize)
-				{
-					return FALSE;
-				}
-			}
-			while ((nLength = *pResponse++) > 0);
-		}
+		assert (pRequest->pIPAddress != 0);
+		pRequest->pIPAddress->Set (*pIPAddress);
 
-		if (pResponse-RecvBuffer > (int) (nRecvSize-sizeof RRTrailer))
-		{
-			return FALSE;
-		}
-
-		memcpy (&RRTrailer, pResponse, sizeof RRTrailer);
-
-		if (   RRTrailer.nType     == BE (DNS_QTYPE_A)
-		    && RRTrailer.nClass    == BE (DNS_QCLASS_IN)
-		    && RRTrailer.nRDLength == BE (DNS_RDLENGTH_AIN))
-		{
-			break;
-		}
-
-		pResponse += DNS_RR_TRAILER_HEADER_LENGTH + BE (RRTrailer.nRDLength);
-		if (pResponse-RecvBuffer >= nRecvSize)
-		{
-			return FALSE;
-		}
+		pRequest->bOK = TRUE;
 	}
 
-	pIPAddress->Set (RRTrailer.RData);
-
-	return TRUE;
+	pRequest->Event.Set ();
 }
 
 boolean CDNSClient::ConvertIPString (const char *pIPString, CIPAddress *pIPAddress)
@@ -0,0 +1,609 @@
+//
+// dnsresolver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/dnsresolver.h>
+#include <circle/net/in.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/macros.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define DNS_PORT		53
+#define DNS_MAX_MESSAGE_SIZE	512
+
+#define DNS_MAX_TRIES		3
+#define DNS_RETRY_TICKS		HZ		// resend the query after this time
+#define DNS_POLL_MSECS		10		// while queries are pending
+
+#define DNS_MIN_TTL		10		// seconds, cache time of positive results
+#define DNS_MAX_TTL		(24*3600)
+#define DNS_NEGATIVE_TTL	60		// for unknown hosts (NXDOMAIN, no data)
+#define DNS_FAILURE_TTL		5		// after a timeout or a server failure
+
+struct TDNSHeader
+{
+	unsigned short nID;
+	unsigned short nFlags;
+#define DNS_FLAGS_QR		0x8000
+#define DNS_FLAGS_OPCODE	0x7800
+	#define DNS_FLAGS_OPCODE_QUERY		0x0000
+	#define DNS_FLAGS_OPCODE_IQUERY		0x0800
+	#define DNS_FLAGS_OPCODE_STATUS		0x1000
+#define DNS_FLAGS_AA		0x0400
+#define DNS_FLAGS_TC		0x0200
+#define DNS_FLAGS_RD		0x0100
+#define DNS_FLAGS_RA		0x0080
+#define DNS_FLAGS_RCODE		0x000F
+	#define DNS_RCODE_SUCCESS		0x0000
+	#define DNS_RCODE_FORMAT_ERROR		0x0001
+	#define DNS_RCODE_SERVER_FAILURE	0x0002
+	#define DNS_RCODE_NAME_ERROR		0x0003
+	#define DNS_RCODE_NOT_IMPLEMENTED	0x0004
+	#define DNS_RCODE_REFUSED		0x0005
+	unsigned short nQDCount;
+	unsigned short nANCount;
+	unsigned short nNSCount;
+	unsigned short nARCount;
+}
+PACKED;
+
+struct TDNSQueryTrailer
+{
+	unsigned short nQType;
+#define DNS_QTYPE_A		1
+	unsigned short nQClass;
+#define DNS_QCLASS_IN		1
+}
+PACKED;
+
+struct TDNSResourceRecordTrailerAIN
+{
+	unsigned short nType;
+	unsigned short nClass;
+	unsigned int   nTTL;
+	unsigned short nRDLength;
+#define DNS_RDLENGTH_AIN	4
+	unsigned char  RData[DNS_RDLENGTH_AIN];
+}
+PACKED;
+
+#define DNS_RR_TRAILER_HEADER_LENGTH	( sizeof (struct TDNSResourceRecordTrailerAIN) \
+					 - DNS_RDLENGTH_AIN)
+
+static const char FromDNSResolver[] = "dns";
+
+CDNSResolver *CDNSResolver::s_pThis = 0;
+
+CDNSResolver::CDNSResolver (CNetSubSystem *pNetSubSystem)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_nPending (0),
+	m_pSocket (0),
+	m_nXID ((u16) CTimer::GetClockTicks ())
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		m_Entry[i].State = EntryFree;
+		m_Entry[i].pWaiters = 0;
+	}
+
+	SetName (FromDNSResolver);
+}
+
+CDNSResolver::~CDNSResolver (void)
+{
+	Flush ();
+
+	delete m_pSocket;
+	m_pSocket = 0;
+
+	m_pNetSubSystem = 0;
+
+	s_pThis = 0;
+}
+
+void CDNSResolver::Run (void)
+{
+	while (1)
+	{
+		if (m_nPending == 0)
+		{
+			m_Event.Clear ();
+			m_Event.Wait ();
+
+			continue;
+		}
+
+		// (re-)send the queries, which are due
+		unsigned nTicks = CTimer::Get ()->GetTicks ();
+		for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+		{
+			TEntry *pEntry = &m_Entry[i];
+			if (   pEntry->State != EntryPending
+			    || (   pEntry->nTries > 0
+				&& nTicks - pEntry->nSendTicks < DNS_RETRY_TICKS))
+			{
+				continue;
+			}
+
+			if (   pEntry->nTries >= DNS_MAX_TRIES
+			    || !SendQuery (pEntry))
+			{
+				Complete (pEntry, 0, DNS_FAILURE_TTL);
+			}
+		}
+
+		if (m_pSocket != 0)
+		{
+			u8 Buffer[FRAME_BUFFER_SIZE];
+			int nSize;
+			while ((nSize = m_pSocket->Receive (Buffer, sizeof Buffer, MSG_DONTWAIT)) > 0)
+			{
+				ProcessResponse (Buffer, nSize);
+			}
+		}
+
+		if (m_nPending > 0)
+		{
+			CScheduler::Get ()->MsSleep (DNS_POLL_MSECS);
+		}
+	}
+}
+
+TDNSResolveStatus CDNSResolver::Resolve (const char *pHostname, CIPAddress *pIPAddress,
+					 TDNSResolveHandler *pHandler, void *pParam)
+{
+	assert (pHostname != 0);
+	if (   *pHostname == '\0'
+	    || strlen (pHostname) > DNS_MAX_HOSTNAME)
+	{
+		return DNSResolveFailed;
+	}
+
+	TEntry *pEntry = Lookup (pHostname);
+	if (pEntry != 0)
+	{
+		switch (pEntry->State)
+		{
+		case EntryValid:
+			assert (pIPAddress != 0);
+			pIPAddress->Set (pEntry->IPAddress);
+			return DNSResolveOK;
+
+		case EntryFailed:
+			return DNSResolveFailed;
+
+		default:
+			assert (pEntry->State == EntryPending);
+			break;
+		}
+	}
+	else
+	{
+		pEntry = AllocateEntry ();
+		if (pEntry == 0)
+		{
+			CLogger::Get ()->Write (FromDNSResolver, LogWarning, "Too many queries");
+
+			return DNSResolveFailed;
+		}
+
+		strcpy (pEntry->Hostname, pHostname);
+		pEntry->State = EntryPending;
+		pEntry->nTries = 0;
+		pEntry->pWaiters = 0;
+
+		m_nPending++;
+		m_Event.Set ();
+	}
+
+	// the same query is shared by all requests for this host
+	TWaiter *pWaiter = new TWaiter;
+	assert (pWaiter != 0);
+	pWaiter->pHandler = pHandler;
+	pWaiter->pParam = pParam;
+	pWaiter->pNext = pEntry->pWaiters;
+	pEntry->pWaiters = pWaiter;
+
+	return DNSResolvePending;
+}
+
+void CDNSResolver::Flush (void)
+{
+	for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		if (   m_Entry[i].State == EntryValid
+		    || m_Entry[i].State == EntryFailed)
+		{
+			m_Entry[i].State = EntryFree;
+		}
+	}
+}
+
+CDNSResolver *CDNSResolver::Get (CNetSubSystem *pNetSubSystem)
+{
+	if (s_pThis == 0)
+	{
+		new CDNSResolver (pNetSubSystem);
+		assert (s_pThis != 0);
+	}
+
+	return s_pThis;
+}
+
+CDNSResolver::TEntry *CDNSResolver::Lookup (const char *pHostname)
+{
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		TEntry *pEntry = &m_Entry[i];
+		if (pEntry->State == EntryFree)
+		{
+			continue;
+		}
+
+		if (   pEntry->State != EntryPending
+		    && (int) (nTicks - pEntry->nExpireTicks) >= 0)
+		{
+			pEntry->State = EntryFree;		// expired
+
+			continue;
+		}
+
+		if (strcasecmp (pEntry->Hostname, pHostname) == 0)
+		{
+			pEntry->nLastUsedTicks = nTicks;
+
+			return pEntry;
+		}
+	}
+
+	return 0;
+}
+
+CDNSResolver::TEntry *CDNSResolver::AllocateEntry (void)
+{
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	TEntry *pOldest = 0;
+	for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		TEntry *pEntry = &m_Entry[i];
+		if (pEntry->State == EntryFree)
+		{
+			pOldest = pEntry;
+
+			break;
+		}
+
+		if (   pEntry->State != EntryPending
+		    && (   pOldest == 0
+			|| nTicks - pEntry->nLastUsedTicks > nTicks - pOldest->nLastUsedTicks))
+		{
+			pOldest = pEntry;
+		}
+	}
+
+	if (pOldest != 0)
+	{
+		pOldest->nLastUsedTicks = nTicks;
+	}
+
+	return pOldest;
+}
+
+boolean CDNSResolver::SendQuery (TEntry *pEntry)
+{
+	if (!CheckSocket ())
+	{
+		return FALSE;
+	}
+
+	u8 Buffer[DNS_MAX_MESSAGE_SIZE];
+	memset (Buffer, 0, sizeof Buffer);
+	TDNSHeader *pDNSHeader = (TDNSHeader *) Buffer;
+
+	// a new ID for each try, so that late responses cannot be mixed up
+	assert (pEntry != 0);
+	pEntry->nXID = m_nXID++;
+
+	pDNSHeader->nID      = le2be16 (pEntry->nXID);
+	pDNSHeader->nFlags   = BE (DNS_FLAGS_OPCODE_QUERY | DNS_FLAGS_RD);
+	pDNSHeader->nQDCount = BE (1);
+
+	u8 *pQuery = Buffer + sizeof (TDNSHeader);
+
+	char Hostname[DNS_MAX_HOSTNAME+1];
+	strcpy (Hostname, pEntry->Hostname);
+
+	char *pSavePtr;
+	size_t nLength;
+	char *pLabel = strtok_r (Hostname, ".", &pSavePtr);
+	while (pLabel != 0)
+	{
+		nLength = strlen (pLabel);
+		if (   nLength > 63
+		    || (int) (nLength+1+1) >= DNS_MAX_MESSAGE_SIZE-(pQuery-Buffer))
+		{
+			return FALSE;
+		}
+
+		*pQuery++ = (u8) nLength;
+
+		strcpy ((char *) pQuery, pLabel);
+		pQuery += nLength;
+
+		pLabel = strtok_r (0, ".", &pSavePtr);
+	}
+
+	*pQuery++ = '\0';
+
+	TDNSQueryTrailer QueryTrailer;
+	QueryTrailer.nQType  = BE (DNS_QTYPE_A);
+	QueryTrailer.nQClass = BE (DNS_QCLASS_IN);
+
+	if ((int) (sizeof QueryTrailer) > DNS_MAX_MESSAGE_SIZE-(pQuery-Buffer))
+	{
+		return FALSE;
+	}
+	memcpy (pQuery, &QueryTrailer, sizeof QueryTrailer);
+	pQuery += sizeof QueryTrailer;
+
+	int nSize = pQuery - Buffer;
+	assert (nSize <= DNS_MAX_MESSAGE_SIZE);
+
+	assert (m_pSocket != 0);
+	if (m_pSocket->Send (Buffer, nSize, MSG_DONTWAIT) != nSize)
+	{
+		return FALSE;
+	}
+
+	pEntry->nTries++;
+	pEntry->nSendTicks = CTimer::Get ()->GetTicks ();
+
+	return TRUE;
+}
+
+void CDNSResolver::ProcessResponse (const u8 *pBuffer, int nSize)
+{
+	if (nSize < (int) sizeof (TDNSHeader))
+	{
+		return;
+	}
+
+	TDNSHeader DNSHeader;
+	memcpy (&DNSHeader, pBuffer, sizeof DNSHeader);
+
+	TEntry *pEntry = 0;
+	for (unsigned i = 0; i < DNS_CACHE_SIZE; i++)
+	{
+		if (   m_Entry[i].State == EntryPending
+		    && DNSHeader.nID == le2be16 (m_Entry[i].nXID))
+		{
+			pEntry = &m_Entry[i];
+
+			break;
+		}
+	}
+
+	if (   pEntry == 0
+	    ||    (DNSHeader.nFlags & BE (DNS_FLAGS_QR | DNS_FLAGS_OPCODE | DNS_FLAGS_TC))
+	       != BE (DNS_FLAGS_QR | DNS_FLAGS_OPCODE_QUERY)
+	    || DNSHeader.nQDCount != BE (1))
+	{
+		return;
+	}
+
+	u16 nRCode = be2le16 (DNSHeader.nFlags) & DNS_FLAGS_RCODE;
+	if (nRCode == DNS_RCODE_NAME_ERROR)
+	{
+		Complete (pEntry, 0, DNS_NEGATIVE_TTL);
+
+		return;
+	}
+
+	if (nRCode != DNS_RCODE_SUCCESS)
+	{
+		Complete (pEntry, 0, DNS_FAILURE_TTL);
+
+		return;
+	}
+
+	if (DNSHeader.nANCount == BE (0))
+	{
+		Complete (pEntry, 0, DNS_NEGATIVE_TTL);		// no data
+
+		return;
+	}
+
+	const u8 *pResponse = pBuffer + sizeof (TDNSHeader);
+	size_t nLength;
+
+	// parse the query section
+	while ((nLength = *pResponse++) > 0)
+	{
+		pResponse += nLength;
+		if (pResponse-pBuffer >= nSize)
+		{
+			return;
+		}
+	}
+
+	pResponse += sizeof (TDNSQueryTrailer);
+	if (pResponse-pBuffer >= nSize)
+	{
+		return;
+	}
+
+	TDNSResourceRecordTrailerAIN RRTrailer;
+
+	// parse the answer section (CNAME records are followed by the A record)
+	for (unsigned nRecord = 0; nRecord < be2le16 (DNSHeader.nANCount); nRecord++)
+	{
+		nLength = *pResponse++;
+		if ((nLength & 0xC0) == 0xC0)		// check for compression
+		{
+			pResponse++;
+		}
+		else
+		{
+			while (nLength > 0)
+			{
+				pResponse += nLength;
+				if (pResponse-pBuffer >= nSize)
+				{
+					return;
+				}
+
+				nLength = *pResponse++;
+				if ((nLength & 0xC0) == 0xC0)	// compressed suffix
+				{
+					pResponse++;
+
+					break;
+				}
+			}
+		}
+
+		if (pResponse-pBuffer > (int) (nSize-DNS_RR_TRAILER_HEADER_LENGTH))
+		{
+			return;
+		}
+
+		memcpy (&RRTrailer, pResponse, DNS_RR_TRAILER_HEADER_LENGTH);
+
+		if (   RRTrailer.nType     == BE (DNS_QTYPE_A)
+		    && RRTrailer.nClass    == BE (DNS_QCLASS_IN)
+		    && RRTrailer.nRDLength == BE (DNS_RDLENGTH_AIN))
+		{
+			if (pResponse-pBuffer > (int) (nSize-sizeof RRTrailer))
+			{
+				return;
+			}
+
+			memcpy (&RRTrailer, pResponse, sizeof RRTrailer);
+
+			unsigned nTTL = be2le32 (RRTrailer.nTTL);
+			if (nTTL < DNS_MIN_TTL)
+			{
+				nTTL = DNS_MIN_TTL;
+			}
+			else if (nTTL > DNS_MAX_TTL)
+			{
+				nTTL = DNS_MAX_TTL;
+			}
+
+			Complete (pEntry, RRTrailer.RData, nTTL);
+
+			return;
+		}
+
+		pResponse += DNS_RR_TRAILER_HEADER_LENGTH + be2le16 (RRTrailer.nRDLength);
+		if (pResponse-pBuffer >= nSize)
+		{
+			return;
+		}
+	}
+
+	Complete (pEntry, 0, DNS_NEGATIVE_TTL);		// no A record
+}
+
+void CDNSResolver::Complete (TEntry *pEntry, const u8 *pIPAddress, unsigned nTTL)
+{
+	assert (pEntry != 0);
+	assert (pEntry->State == EntryPending);
+
+	CIPAddress IPAddress;
+	if (pIPAddress != 0)
+	{
+		memcpy (pEntry->IPAddress, pIPAddress, IP_ADDRESS_SIZE);
+		IPAddress.Set (pIPAddress);
+
+		pEntry->State = EntryValid;
+	}
+	else
+	{
+		pEntry->State = EntryFailed;
+	}
+
+	pEntry->nExpireTicks = CTimer::Get ()->GetTicks () + nTTL * HZ;
+
+	assert (m_nPending > 0);
+	m_nPending--;
+
+	// the handlers may start new requests
+	TWaiter *pWaiter = pEntry->pWaiters;
+	pEntry->pWaiters = 0;
+
+	while (pWaiter != 0)
+	{
+		if (pWaiter->pHandler != 0)
+		{
+			(*pWaiter->pHandler) (pIPAddress != 0 ? &IPAddress : 0, pWaiter->pParam);
+		}
+
+		TWaiter *pNext = pWaiter->pNext;
+		delete pWaiter;
+		pWaiter = pNext;
+	}
+}
+
+boolean CDNSResolver::CheckSocket (void)
+{
+	assert (m_pNetSubSystem != 0);
+	CIPAddress DNSServer (m_pNetSubSystem->GetConfig ()->GetDNSServer ()->Get ());
+	if (DNSServer.IsNull ())
+	{
+		return FALSE;
+	}
+
+	if (   m_pSocket != 0
+	    && DNSServer == m_DNSServer)
+	{
+		return TRUE;
+	}
+
+	// the DNS server has changed (e.g. by DHCP), the cached results may be wrong too
+	if (m_pSocket != 0)
+	{
+		Flush ();
+	}
+
+	delete m_pSocket;
+
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
+	assert (m_pSocket != 0);
+
+	if (m_pSocket->Connect (DNSServer, DNS_PORT) != 0)
+	{
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return FALSE;
+	}
+
+	m_DNSServer.Set (DNSServer);
+
+	return TRUE;
+}
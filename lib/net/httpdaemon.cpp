@@ -28,20 +28,23 @@
 #include <circle/util.h>
 #include <assert.h>
 
-#define HTTPD_VERSION		"0.03"
+#define HTTPD_VERSION		"0.04"
 #define SERVER			"CHTTPDaemon/" HTTPD_VERSION " (Circle)"
 
-#define MAX_CLIENTS		10
+#define MAX_CLIENTS		10		// backlog of the listening socket
 
 #define HTTPD_STACK_SIZE	TASK_STACK_SIZE
 
+#define HTTPD_KEEP_ALIVE_TIMEOUT	5	// seconds, an idle connection is closed then
+#define HTTPD_MAX_KEEP_ALIVE_REQUESTS	100	// per connection
+
 static const char FromHTTPDaemon[] = "httpd";
 
 unsigned CHTTPDaemon::s_nInstanceCount = 0;
 
 CHTTPDaemon::CHTTPDaemon (CNetSubSystem *pNetSubSystem, CSocket *pSocket,
 			  unsigned nMaxContentSize, u16 nPort, unsigned nMaxMultipartSize,
-			  unsigned nTimeoutSeconds)
+			  unsigned nTimeoutSeconds, unsigned nPoolSize)
 :	CTask (HTTPD_STACK_SIZE),
 	m_pNetSubSystem (pNetSubSystem),
 	m_pSocket (pSocket),
@@ -49,7 +52,15 @@ CHTTPDaemon::CHTTPDaemon (CNetSubSystem *pNetSubSystem, CSocket *pSocket,
 	m_nPort (nPort),
 	m_nMaxMultipartSize (nMaxMultipartSize),
 	m_nTimeoutSeconds (nTimeoutSeconds),
-	m_pContentBuffer (0)
+	m_nPoolSize (nPoolSize),
+	m_pListener (0),
+	m_nWorkers (0),
+	m_nIdleWorkers (0),
+	m_nPendingIn (0),
+	m_nPendingOut (0),
+	m_nPendingCount (0),
+	m_pContentBuffer (0),
+	m_pMultipartBuffer (0)
 {
 	s_nInstanceCount++;
 
@@ -76,6 +87,9 @@ CHTTPDaemon::~CHTTPDaemon (void)
 {
 	assert (m_pSocket == 0);
 
+	delete [] m_pMultipartBuffer;
+	m_pMultipartBuffer = 0;
+
 	delete m_pContentBuffer;
 	m_pContentBuffer = 0;
 
@@ -93,6 +107,15 @@ void CHTTPDaemon::Run (void)
 	else
 	{
 		Worker ();
+
+		// a pooled worker serves the following connections too
+		while (m_pListener != 0)
+		{
+			m_pSocket = m_pListener->GetConnection ();
+			assert (m_pSocket != 0);
+
+			Worker ();
+		}
 	}
 }
 
@@ -144,8 +167,17 @@ void CHTTPDaemon::Listener (void)
 		return;
 	}
 
+	assert (m_nPoolSize > 0);
+
 	while (1)
 	{
+		// backpressure: further connections wait in the backlog of the listening socket
+		while (m_nPendingCount >= HTTPD_MAX_PENDING)
+		{
+			m_SlotEvent.Clear ();
+			m_SlotEvent.Wait ();
+		}
+
 		CIPAddress ForeignIP;
 		u16 nForeignPort;
 		CSocket *pConnection = m_pSocket->Accept (&ForeignIP, &nForeignPort);
@@ -156,17 +188,61 @@ void CHTTPDaemon::Listener (void)
 			continue;
 		}
 
-		if (s_nInstanceCount >= MAX_CLIENTS+1)
+		// the pool grows on demand, its workers are never terminated
+		if (   m_nIdleWorkers == 0
+		    && m_nWorkers < m_nPoolSize)
 		{
-			CLogger::Get ()->Write (FromHTTPDaemon, LogWarning, "Too many clients");
+			CHTTPDaemon *pWorker = CreateWorker (m_pNetSubSystem, pConnection);
+			assert (pWorker != 0);
+			pWorker->m_pListener = this;	// before the worker runs the first time
 
-			delete pConnection;
+			m_nWorkers++;
 
 			continue;
 		}
 
-		CreateWorker (m_pNetSubSystem, pConnection);
+		QueueConnection (pConnection);
+	}
+}
+
+void CHTTPDaemon::QueueConnection (CSocket *pSocket)
+{
+	assert (pSocket != 0);
+	assert (m_nPendingCount < HTTPD_MAX_PENDING);
+
+	m_pPending[m_nPendingIn] = pSocket;
+	if (++m_nPendingIn >= HTTPD_MAX_PENDING)
+	{
+		m_nPendingIn = 0;
+	}
+
+	m_nPendingCount++;
+
+	m_ConnectionEvent.Set ();
+}
+
+CSocket *CHTTPDaemon::GetConnection (void)
+{
+	// all idle workers are woken, the first one takes the connection
+	m_nIdleWorkers++;
+	while (m_nPendingCount == 0)
+	{
+		m_ConnectionEvent.Clear ();
+		m_ConnectionEvent.Wait ();
+	}
+	m_nIdleWorkers--;
+
+	CSocket *pSocket = m_pPending[m_nPendingOut];
+	if (++m_nPendingOut >= HTTPD_MAX_PENDING)
+	{
+		m_nPendingOut = 0;
 	}
+
+	m_nPendingCount--;
+
+	m_SlotEvent.Set ();
+
+	return pSocket;
 }
 
 void CHTTPDaemon::Worker (void)
@@ -175,16 +251,53 @@ void CHTTPDaemon::Worker (void)
 
 	m_pSocket->SetOptionReceiveTimeout (m_nTimeoutSeconds * 1000000);
 
+	m_nRxOffset = 0;
+	m_nRxLength = 0;
+
+	// serve requests on the persistent connection, until it is closed
+	for (unsigned nRequest = 1; ProcessRequest (nRequest < HTTPD_MAX_KEEP_ALIVE_REQUESTS); nRequest++)
+	{
+		if (nRequest == 1)
+		{
+			// an idle connection is closed after a shorter timeout
+			unsigned nTimeoutSeconds = m_nTimeoutSeconds;
+			if (   nTimeoutSeconds == 0
+			    || nTimeoutSeconds > HTTPD_KEEP_ALIVE_TIMEOUT)
+			{
+				nTimeoutSeconds = HTTPD_KEEP_ALIVE_TIMEOUT;
+			}
+
+			m_pSocket->SetOptionReceiveTimeout (nTimeoutSeconds * 1000000);
+		}
+	}
+
+	delete m_pSocket;		// closes connection
+	m_pSocket = 0;
+}
+
+boolean CHTTPDaemon::ProcessRequest (boolean bKeepAliveAllowed)
+{
+	assert (m_pSocket != 0);
+
 	// parse HTTP request
 	THTTPStatus Status = ParseRequest ();
 	if (Status == HTTPUnknownError)		// unknown error cannot be reported to client
 	{
-		delete m_pSocket;
-		m_pSocket = 0;
+		return FALSE;
+	}
 
-		return;
+	// the connection is not kept, if the request cannot be framed reliably
+	if (   Status != HTTPOK
+	    || !bKeepAliveAllowed
+	    || (   m_pListener != 0		// other clients are waiting for a worker
+		&& m_pListener->m_nPendingCount > 0))
+	{
+		m_bKeepAlive = FALSE;
 	}
 
+	m_bStreaming = FALSE;
+	m_nStreamedLength = 0;
+
 	// process HTTP request
 	unsigned nContentLength = m_nMaxContentSize;
 	const char *pContentType = "text/html";
@@ -199,25 +312,47 @@ void CHTTPDaemon::Worker (void)
 				     m_pContentBuffer, &nContentLength, &pContentType);
 		assert (nContentLength <= m_nMaxContentSize);
 		assert (pContentType != 0);
-
-		delete [] m_pMultipartBuffer;
-		m_pMultipartBuffer = 0;
 	}
 
-	if (Status != HTTPOK)
+	delete [] m_pMultipartBuffer;
+	m_pMultipartBuffer = 0;
+
+	if (m_bStreaming)
 	{
-		switch (Status)
+		// content has been sent using WriteContent(), terminate it
+		if (   m_bChunked
+		    && m_RequestMethod != HTTPRequestMethodHead
+		    && m_pSocket->Send ("0\r\n\r\n", 5, MSG_DONTWAIT) < 0)
 		{
-		case HTTPBadRequest:		pStatusMsg = "Bad Request";			break;
-		case HTTPNotFound:		pStatusMsg = "Not Found";			break;
-		case HTTPRequestEntityTooLarge:	pStatusMsg = "Request Entity Too Large";	break;
-		case HTTPRequestURITooLong:	pStatusMsg = "Request-URI Too Long";		break;
-		case HTTPInternalServerError:	pStatusMsg = "Internal Server Error";		break;
-		case HTTPMethodNotImplemented:	pStatusMsg = "Method Not Implemented";		break;
-		case HTTPVersionNotSupported:	pStatusMsg = "Version Not Supported";		break;
-		default:			pStatusMsg = "Unknown Error";			break;
+			CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response");
+
+			return FALSE;
+		}
+
+		if (   Status != HTTPOK		// error cannot be reported any more
+		    || (   !m_bChunked	// client cannot find the end of the content
+			&& m_RequestMethod != HTTPRequestMethodHead
+			&& m_nStreamedLength != m_nStreamContentLength))
+		{
+			m_bKeepAlive = FALSE;
 		}
 
+		const u8 *pClientIP = m_pSocket->GetForeignIP ();
+		if (pClientIP == 0)
+		{
+			return FALSE;
+		}
+
+		WriteAccessLog (CIPAddress (pClientIP), m_RequestMethod, m_RequestURI,
+				m_StreamStatus, m_nStreamedLength);
+
+		return m_bKeepAlive;
+	}
+
+	if (Status != HTTPOK)
+	{
+		pStatusMsg = GetStatusMessage (Status);
+
 		CString ErrorPage;
 		ErrorPage.Format ("<!DOCTYPE html>\n"
 				  "<html>\n"
@@ -240,10 +375,7 @@ void CHTTPDaemon::Worker (void)
 	const u8 *pClientIP = m_pSocket->GetForeignIP ();
 	if (pClientIP == 0)			// connection closed in the meantime?
 	{
-		delete m_pSocket;
-		m_pSocket = 0;
-
-		return;
+		return FALSE;
 	}
 	CIPAddress ClientIP (pClientIP);
 
@@ -255,17 +387,26 @@ void CHTTPDaemon::Worker (void)
 		       "Server: " SERVER "\r\n"
 		       "Content-Type: %s\r\n"
 		       "Content-Length: %u\r\n"
-		       "Connection: close\r\n"
-		       "\r\n", Status, pStatusMsg, pContentType, nContentLength);
+		       "Connection: %s\r\n"
+		       "\r\n", Status, pStatusMsg, pContentType, nContentLength,
+		       m_bKeepAlive ? "keep-alive" : "close");
+
+	// coalesce header and content into full segments,
+	// and with the following responses, if requests are pipelined
+	boolean bPipelined = m_bKeepAlive && m_nRxOffset < m_nRxLength;
+	int nFlags = MSG_DONTWAIT;
+	if (   (   m_RequestMethod != HTTPRequestMethodHead
+		&& nContentLength > 0)
+	    || bPipelined)
+	{
+		nFlags |= MSG_MORE;
+	}
 
-	if (m_pSocket->Send ((const char *) Header, Header.GetLength (), MSG_DONTWAIT) < 0)
+	if (m_pSocket->Send ((const char *) Header, Header.GetLength (), nFlags) < 0)
 	{
 		CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response header");
 
-		delete m_pSocket;
-		m_pSocket = 0;
-
-		return;
+		return FALSE;
 	}
 
 	// send response
@@ -273,19 +414,176 @@ void CHTTPDaemon::Worker (void)
 	    && nContentLength > 0)
 	{
 		assert (m_pContentBuffer != 0);
-		if (m_pSocket->Send (m_pContentBuffer, nContentLength, MSG_DONTWAIT) < 0)
+		if (m_pSocket->Send (m_pContentBuffer, nContentLength,
+				     MSG_DONTWAIT | (bPipelined ? MSG_MORE : 0)) < 0)
 		{
 			CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response");
 
-			delete m_pSocket;
-			m_pSocket = 0;
-
-			return;
+			return FALSE;
 		}
 	}
 
-	delete m_pSocket;		// closes connection
-	m_pSocket = 0;
+	return m_bKeepAlive;
+}
+
+boolean CHTTPDaemon::BeginResponse (THTTPStatus Status, const char *pContentType,
+				   unsigned nContentLength, const char *pHeaderFields)
+{
+	assert (m_pSocket != 0);
+	assert (!m_bStreaming);
+	m_bStreaming = TRUE;
+	m_StreamStatus = Status;
+	m_nStreamContentLength = nContentLength;
+
+	CString Length;
+	if (nContentLength != HTTPD_CONTENT_LENGTH_UNKNOWN)
+	{
+		m_bChunked = FALSE;
+		Length.Format ("Content-Length: %u\r\n", nContentLength);
+	}
+	else if (m_bHTTP11)
+	{
+		m_bChunked = TRUE;
+		Length = "Transfer-Encoding: chunked\r\n";
+	}
+	else
+	{
+		// HTTP/1.0 does not know chunked encoding, the end is signaled by closing then
+		m_bChunked = FALSE;
+		m_bKeepAlive = FALSE;
+	}
+
+	CString Header;
+	Header.Format ("HTTP/1.1 %u %s\r\n"
+		       "Server: " SERVER "\r\n"
+		       "Content-Type: %s\r\n"
+		       "%s%s"
+		       "Connection: %s\r\n"
+		       "\r\n", Status, GetStatusMessage (Status),
+		       pContentType != 0 ? pContentType : "text/html",
+		       (const char *) Length, pHeaderFields != 0 ? pHeaderFields : "",
+		       m_bKeepAlive ? "keep-alive" : "close");
+
+	int nFlags = 0;
+	if (   m_RequestMethod != HTTPRequestMethodHead
+	    && nContentLength != 0)
+	{
+		nFlags |= MSG_MORE;
+	}
+
+	if (m_pSocket->Send ((const char *) Header, Header.GetLength (), nFlags) < 0)
+	{
+		CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response header");
+
+		m_bKeepAlive = FALSE;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+boolean CHTTPDaemon::WriteContent (const void *pData, unsigned nLength, const char *pContentType)
+{
+	if (   !m_bStreaming
+	    && !BeginResponse (HTTPOK, pContentType, HTTPD_CONTENT_LENGTH_UNKNOWN))
+	{
+		return FALSE;
+	}
+
+	if (   m_RequestMethod == HTTPRequestMethodHead
+	    || nLength == 0)			// an empty chunk would end the content
+	{
+		return TRUE;
+	}
+
+	assert (pData != 0);
+	return SendContent (pData, 0, nLength);
+}
+
+boolean CHTTPDaemon::WriteContent (CNetBuffer *pBuffer)
+{
+	assert (pBuffer != 0);
+	assert (m_bStreaming);
+
+	unsigned nLength = pBuffer->GetTotalLength ();
+	if (   m_RequestMethod == HTTPRequestMethodHead
+	    || nLength == 0)
+	{
+		pBuffer->Release ();
+
+		return TRUE;
+	}
+
+	return SendContent (0, pBuffer, nLength);
+}
+
+boolean CHTTPDaemon::SendContent (const void *pData, CNetBuffer *pBuffer, unsigned nLength)
+{
+	assert (m_pSocket != 0);
+	assert (m_bStreaming);
+	m_nStreamedLength += nLength;
+
+	// the pieces are coalesced into full segments, until the content is terminated
+	int nResult = 0;
+	if (m_bChunked)
+	{
+		CString ChunkHeader;
+		ChunkHeader.Format ("%X\r\n", nLength);
+
+		nResult = m_pSocket->Send ((const char *) ChunkHeader, ChunkHeader.GetLength (),
+					   MSG_MORE);
+	}
+
+	if (nResult >= 0)
+	{
+		nResult =   pBuffer != 0
+			  ? m_pSocket->SendBuffer (pBuffer, MSG_MORE)
+			  : m_pSocket->Send (pData, nLength, MSG_MORE);
+		pBuffer = 0;
+	}
+
+	if (   nResult >= 0
+	    && m_bChunked)
+	{
+		nResult = m_pSocket->Send ("\r\n", 2, MSG_MORE);
+	}
+
+	if (pBuffer != 0)
+	{
+		pBuffer->Release ();
+	}
+
+	if (nResult < 0)
+	{
+		CLogger::Get ()->Write (FromHTTPDaemon, LogError, "Cannot send response");
+
+		m_bKeepAlive = FALSE;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+const char *CHTTPDaemon::GetStatusMessage (THTTPStatus Status)
+{
+	switch (Status)
+	{
+	case HTTPOK:			return "OK";
+	case HTTPPartialContent:	return "Partial Content";
+	case HTTPNotModified:		return "Not Modified";
+	case HTTPBadRequest:		return "Bad Request";
+	case HTTPNotFound:		return "Not Found";
+	case HTTPRequestEntityTooLarge:	return "Request Entity Too Large";
+	case HTTPRequestURITooLong:	return "Request-URI Too Long";
+	case HTTPRangeNotSatisfiable:	return "Range Not Satisfiable";
+	case HTTPInternalServerError:	return "Internal Server Error";
+	case HTTPMethodNotImplemented:	return "Method Not Implemented";
+	case HTTPServiceUnavailable:	return "Service Unavailable";
+	case HTTPVersionNotSupported:	return "Version Not Supported";
+	default:			return "Unknown Error";
+	}
 }
 
 THTTPStatus CHTTPDaemon::ParseRequest (void)
@@ -302,11 +600,16 @@ THTTPStatus CHTTPDaemon::ParseRequest (void)
 	m_bMultipartFormDataAvailable = FALSE;
 	m_MultipartBoundary[0] = '\0';
 	m_nMultipartContentLength = 0;
+	delete [] m_pMultipartBuffer;
 	m_pMultipartBuffer = 0;
+	m_bHTTP11 = FALSE;
+	m_bKeepAlive = FALSE;
+	m_RequestRange[0] = '\0';
+	m_RequestIfNoneMatch[0] = '\0';
+	m_RequestIfModifiedSince[0] = '\0';
 
-	char Buffer[FRAME_BUFFER_SIZE];
 	char Line[HTTP_MAX_REQUEST_LINE+1];
-#if HTTP_MAX_REQUEST_LINE+FRAME_BUFFER_SIZE+2000 > HTTPD_STACK_SIZE
+#if HTTP_MAX_REQUEST_LINE+2000 > HTTPD_STACK_SIZE
 	#error Increase HTTPD_STACK_SIZE!
 #endif
 
@@ -314,15 +617,27 @@ THTTPStatus CHTTPDaemon::ParseRequest (void)
 	unsigned nLine = 0;
 	unsigned nChar = 0;
 
-	int nResult;
+	int nResult = 0;
 
+	// received data, which follows the request, is kept for the next (pipelined) request
 	assert (m_pSocket != 0);
-	while (   nState < 3
-	       && (nResult = m_pSocket->Receive (Buffer, sizeof Buffer, 0)) > 0)
+	while (nState < 3)
 	{
-		for (unsigned i = 0; i < (unsigned) nResult; i++)
+		if (m_nRxOffset >= m_nRxLength)
+		{
+			if ((nResult = m_pSocket->Receive (m_RxBuffer, sizeof m_RxBuffer, 0)) <= 0)
+			{
+				break;
+			}
+
+			m_nRxOffset = 0;
+			m_nRxLength = nResult;
+		}
+
+		while (   nState < 3
+		       && m_nRxOffset < m_nRxLength)
 		{
-			char chChar = Buffer[i];
+			char chChar = m_RxBuffer[m_nRxOffset++];
 
 			if (nState == 0)
 			{
@@ -526,8 +841,12 @@ THTTPStatus CHTTPDaemon::ParseMethod (char *pLine)
 		return HTTPBadRequest;
 	}
 
-	if (   strcmp (pToken, "1.0") != 0
-	    && strcmp (pToken, "1.1") != 0)
+	if (strcmp (pToken, "1.1") == 0)
+	{
+		m_bHTTP11 = TRUE;
+		m_bKeepAlive = TRUE;		// persistent connection by default
+	}
+	else if (strcmp (pToken, "1.0") != 0)
 	{
 		return HTTPVersionNotSupported;
 	}
@@ -599,6 +918,53 @@ THTTPStatus CHTTPDaemon::ParseHeaderField (char *pLine)
 
 		m_nRequestContentLength = nAccu;
 	}
+	else if (   strcmp (pToken, "Range") == 0
+		 || strcmp (pToken, "If-None-Match") == 0
+		 || strcmp (pToken, "If-Modified-Since") == 0)
+	{
+		char *pField = m_RequestIfModifiedSince;
+		if (strcmp (pToken, "Range") == 0)
+		{
+			pField = m_RequestRange;
+		}
+		else if (strcmp (pToken, "If-None-Match") == 0)
+		{
+			pField = m_RequestIfNoneMatch;
+		}
+
+		const char *pValue = strtok_r (0, "", &pSavePtr);
+		if (pValue == 0)
+		{
+			return HTTPBadRequest;
+		}
+
+		while (*pValue == ' ')
+		{
+			pValue++;
+		}
+
+		// too long values are ignored, the request is served unconditionally then
+		if (strlen (pValue) <= HTTP_MAX_HEADER_VALUE)
+		{
+			strcpy (pField, pValue);
+		}
+	}
+	else if (strcmp (pToken, "Connection") == 0)
+	{
+		if ((pToken = strtok_r (0, " ,", &pSavePtr)) == 0)
+		{
+			return HTTPBadRequest;
+		}
+
+		if (strcasecmp (pToken, "close") == 0)
+		{
+			m_bKeepAlive = FALSE;
+		}
+		else if (strcasecmp (pToken, "keep-alive") == 0)
+		{
+			m_bKeepAlive = TRUE;
+		}
+	}
 
 	return HTTPOK;
 }
@@ -155,6 +155,25 @@ void CICMPHandler::Process (void)
 		switch (pICMPHeader->nType)
 		{
 		case ICMP_TYPE_DEST_UNREACH:
+			if (pICMPHeader->nCode == ICMP_CODE_FRAG_REQUIRED)
+			{
+				// See: RFC 1191 section 4, the packet is not lost for the user
+				unsigned nMTU =   (unsigned) pICMPHeader->Parameter[2] << 8
+						| pICMPHeader->Parameter[3];
+				if (nMTU == 0)
+				{
+					nMTU = GetPlateauMTU (be2le16 (pIPHeader->nTotalLength));
+				}
+
+				CLogger::Get ()->Write (FromICMP, LogDebug,
+							"Fragmentation needed (MTU %u)", nMTU);
+
+				assert (m_pNetworkLayer != 0);
+				m_pNetworkLayer->PathMTUReduced (pIPHeader->DestinationAddress, nMTU);
+
+				break;
+			}
+
 			CLogger::Get ()->Write (FromICMP, LogDebug, "Destination unreachable (%u)",
 						pICMPHeader->nCode);
 			EnqueueNotification (ICMPNotificationDestUnreach, pIPHeader, pDatagramHeader);
@@ -230,6 +249,22 @@ void CICMPHandler::DestinationUnreachable (unsigned nCode, const void *pReturned
 	EnqueueNotification (ICMPNotificationDestUnreach, pIPHeader, pDatagramHeader);
 }
 
+unsigned CICMPHandler::GetPlateauMTU (unsigned nPacketLength)
+{
+	// See: RFC 1191 section 7, for routers, which do not report the next-hop MTU
+	static const unsigned PlateauTable[] = {32000, 17914, 8166, 4352, 2002, 1492, 1006, 508, 296};
+
+	for (unsigned i = 0; i < sizeof PlateauTable / sizeof PlateauTable[0]; i++)
+	{
+		if (PlateauTable[i] < nPacketLength)
+		{
+			return PlateauTable[i];
+		}
+	}
+
+	return 68;
+}
+
 void CICMPHandler::EnqueueNotification (TICMPNotificationType Type, TIPHeader *pIPHeader,
 					TICMPDataDatagramHeader *pDatagramHeader)
 {
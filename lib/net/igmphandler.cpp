@@ -32,15 +32,51 @@ struct TIGMPPacket
 #define IGMP_TYPE_MEMBERSHIP_REPORT_V1		0x12
 #define IGMP_TYPE_MEMBERSHIP_REPORT_V2		0x16
 #define IGMP_TYPE_LEAVE_GROUP			0x17
+#define IGMP_TYPE_MEMBERSHIP_REPORT_V3		0x22
 	u8	uchMaxRespTime;				// 1/10 seconds, always 0 for v1
 	u16	usChecksum;
 	u8	GroupAddress[IP_ADDRESS_SIZE];
 }
 PACKED;
 
+struct TIGMPQueryV3
+{
+	TIGMPPacket	Header;				// uchMaxRespTime is Max Resp Code
+	u8		uchFlagsQRV;
+	u8		uchQQIC;
+	u16		usNumberOfSources;
+	//u8		SourceAddress[IP_ADDRESS_SIZE][];
+}
+PACKED;
+
+struct TIGMPReportV3
+{
+	u8	uchType;
+	u8	uchReserved1;
+	u16	usChecksum;
+	u16	usReserved2;
+	u16	usNumberOfGroupRecords;
+}
+PACKED;
+
+struct TIGMPGroupRecord
+{
+	u8	uchRecordType;
+#define IGMP_RECORD_MODE_IS_INCLUDE		1
+#define IGMP_RECORD_MODE_IS_EXCLUDE		2
+#define IGMP_RECORD_CHANGE_TO_INCLUDE		3
+#define IGMP_RECORD_CHANGE_TO_EXCLUDE		4
+	u8	uchAuxDataLen;
+	u16	usNumberOfSources;
+	u8	MulticastAddress[IP_ADDRESS_SIZE];
+	//u8	SourceAddress[IP_ADDRESS_SIZE][];
+}
+PACKED;
+
 // Multicast addresses
 static const u8 AllSystemsGroup[] = {224, 0, 0, 1};
 static const u8 AllRoutersGroup[] = {224, 0, 0, 2};
+static const u8 AllV3RoutersGroup[] = {224, 0, 0, 22};
 
 CIGMPHandler::CIGMPHandler (CNetConfig *pNetConfig, CNetworkLayer *pNetworkLayer,
 			    CLinkLayer *pLinkLayer, CNetQueue *pRxQueue)
@@ -51,6 +87,8 @@ CIGMPHandler::CIGMPHandler (CNetConfig *pNetConfig, CNetworkLayer *pNetworkLayer
 	m_bAllSystemsJoined (FALSE),
 	m_nLastTicks (0),
 	m_nV1RouterTimer (0),
+	m_nV2RouterTimer (0),
+	m_nGeneralTimer (0),
 	m_nRandomSeed (0)
 {
 	assert (m_pNetConfig != 0);
@@ -61,7 +99,11 @@ CIGMPHandler::CIGMPHandler (CNetConfig *pNetConfig, CNetworkLayer *pNetworkLayer
 	for (unsigned i = 0; i < MaxHostGroups; i++)
 	{
 		m_nUseCounter[i] = 0;
+		m_nAnySourceCounter[i] = 0;
 		m_nDelayTimer[i] = 0;
+		m_nChangeTimer[i] = 0;
+		m_nChangeRetransmissions[i] = 0;
+		m_nSources[i] = 0;
 	}
 }
 
@@ -125,57 +167,19 @@ void CIGMPHandler::Process (void)
 
 		CIPAddress GroupAddressIP (pIGMPPacket->GroupAddress);
 
-		u8 uchMaxRespTime = pIGMPPacket->uchMaxRespTime;
-		if (uchMaxRespTime == 0)
-		{
-			uchMaxRespTime = 100;
-
-			m_nV1RouterTimer = nTicks + V1RouterPresentTimeout;
-		}
-
 		switch (pIGMPPacket->uchType)
 		{
 		case IGMP_TYPE_MEMBERSHIP_QUERY:
-			if (GroupAddressIP.IsNull ())
-			{
-				// General Query
-				for (unsigned i = 0; i < MaxHostGroups; i++)
-				{
-					if (m_nUseCounter[i] == 0)
-					{
-						continue;
-					}
-
-					m_nDelayTimer[i] =
-						nTicks + GetRandom (uchMaxRespTime) * HZ/10;
-				}
-			}
-			else
-			{
-				// Group-Specific Query
-				for (unsigned i = 0; i < MaxHostGroups; i++)
-				{
-					if (   m_nUseCounter[i] == 0
-					    || m_HostGroup[i] != GroupAddressIP)
-					{
-						continue;
-					}
-
-					unsigned nDelayTimer =
-						nTicks + GetRandom (uchMaxRespTime) * HZ/10;
-					if (   m_nDelayTimer[i] == 0
-					    || nDelayTimer < m_nDelayTimer[i])
-					{
-						m_nDelayTimer[i] = nDelayTimer;
-					}
-
-					break;
-				}
-			}
+			ProcessQuery (Buffer, nLength, nTicks);
 			break;
 
 		case IGMP_TYPE_MEMBERSHIP_REPORT_V1:
 		case IGMP_TYPE_MEMBERSHIP_REPORT_V2:
+			if (IsV3Mode ())
+			{
+				break;			// no report suppression in IGMPv3
+			}
+
 			for (unsigned i = 0; i < MaxHostGroups; i++)
 			{
 				if (   m_nUseCounter[i] == 0
@@ -207,9 +211,50 @@ void CIGMPHandler::Process (void)
 			    && m_nDelayTimer[i] <= nTicks)
 			{
 				m_nDelayTimer[i] = 0;
-				m_bLastHostFlag[i] = TRUE;
 
-				SendPacket (TRUE, m_HostGroup[i]);
+				if (m_nUseCounter[i] == 0)
+				{
+					// group has been left in the meantime
+				}
+				else if (IsV3Mode ())
+				{
+					SendReportV3 (FALSE, i);
+				}
+				else
+				{
+					m_bLastHostFlag[i] = TRUE;
+
+					SendPacket (TRUE, m_HostGroup[i]);
+				}
+			}
+
+			if (   m_nChangeTimer[i] != 0
+			    && m_nChangeTimer[i] <= nTicks)
+			{
+				m_nChangeTimer[i] = 0;
+
+				if (IsV3Mode ())
+				{
+					SendReportV3 (TRUE, i);
+
+					if (   m_nChangeRetransmissions[i] > 0
+					    && --m_nChangeRetransmissions[i] > 0)
+					{
+						m_nChangeTimer[i] =   nTicks + 1
+								    + GetRandom (UnsolicitedReportIntervalV3);
+					}
+				}
+			}
+		}
+
+		if (   m_nGeneralTimer != 0
+		    && m_nGeneralTimer <= nTicks)
+		{
+			m_nGeneralTimer = 0;
+
+			if (IsV3Mode ())
+			{
+				SendReportV3 (FALSE, MaxHostGroups);
 			}
 		}
 
@@ -218,17 +263,123 @@ void CIGMPHandler::Process (void)
 		{
 			m_nV1RouterTimer = 0;
 		}
+
+		if (   m_nV2RouterTimer != 0
+		    && m_nV2RouterTimer <= nTicks)
+		{
+			m_nV2RouterTimer = 0;
+		}
 	}
 }
 
-boolean CIGMPHandler::JoinHostGroup (const CIPAddress &rGroupAddress)
+void CIGMPHandler::ProcessQuery (const u8 *pPacket, unsigned nLength, unsigned nTicks)
 {
-	unsigned j = MaxHostGroups;
+	assert (pPacket != 0);
+	const TIGMPPacket *pIGMPPacket = (const TIGMPPacket *) pPacket;
+	CIPAddress GroupAddressIP (pIGMPPacket->GroupAddress);
+
+	// the query version is determined by its length and the Max Resp field (RFC 3376 7.1)
+	unsigned nMaxRespTime = pIGMPPacket->uchMaxRespTime;
+	if (nLength >= sizeof (TIGMPQueryV3))
+	{
+		if (nMaxRespTime >= 128)
+		{
+			nMaxRespTime = ((nMaxRespTime & 0x0F) | 0x10) << (((nMaxRespTime >> 4) & 7) + 3);
+		}
+	}
+	else
+	{
+		if (nMaxRespTime == 0)
+		{
+			nMaxRespTime = 100;
+
+			m_nV1RouterTimer = nTicks + V1RouterPresentTimeout;
+		}
+		else
+		{
+			m_nV2RouterTimer = nTicks + V1RouterPresentTimeout;
+		}
+
+		// Pending IGMPv3 responses are cancelled in an older compatibility mode
+		m_nGeneralTimer = 0;
+		for (unsigned i = 0; i < MaxHostGroups; i++)
+		{
+			m_nChangeTimer[i] = 0;
+		}
+	}
+
+	unsigned nDelayTimer = nTicks + 1 + GetRandom (nMaxRespTime) * HZ/10;
+
+	if (IsV3Mode ())
+	{
+		if (GroupAddressIP.IsNull ())
+		{
+			// General Query, one report with all groups
+			if (   m_nGeneralTimer == 0
+			    || nDelayTimer < m_nGeneralTimer)
+			{
+				m_nGeneralTimer = nDelayTimer;
+			}
+
+			return;
+		}
+
+		if (   m_nGeneralTimer != 0
+		    && m_nGeneralTimer <= nDelayTimer)
+		{
+			return;			// the pending general response covers this query
+		}
+	}
+
+	if (GroupAddressIP.IsNull ())
+	{
+		// General Query
+		for (unsigned i = 0; i < MaxHostGroups; i++)
+		{
+			if (m_nUseCounter[i] == 0)
+			{
+				continue;
+			}
+
+			m_nDelayTimer[i] = nTicks + GetRandom (nMaxRespTime) * HZ/10;
+		}
+
+		return;
+	}
+
+	// Group-Specific Query, the current state of the group is also reported
+	// on a Group-and-Source-Specific Query (a superset of the requested sources)
 	for (unsigned i = 0; i < MaxHostGroups; i++)
+	{
+		if (   m_nUseCounter[i] == 0
+		    || m_HostGroup[i] != GroupAddressIP)
+		{
+			continue;
+		}
+
+		if (   m_nDelayTimer[i] == 0
+		    || nDelayTimer < m_nDelayTimer[i])
+		{
+			m_nDelayTimer[i] = nDelayTimer;
+		}
+
+		break;
+	}
+}
+
+boolean CIGMPHandler::JoinHostGroup (const CIPAddress &rGroupAddress,
+				     const CIPAddress *pSourceAddress)
+{
+	unsigned i;
+	unsigned j = MaxHostGroups;
+	for (i = 0; i < MaxHostGroups; i++)
 	{
 		if (m_nUseCounter[i] == 0)
 		{
-			if (j == MaxHostGroups)
+			// prefer slots, which do not send a leave report any more
+			if (   j == MaxHostGroups
+			    || (   m_nChangeTimer[j] != 0
+				&& m_nChangeTimer[i] == 0))
 			{
 				j = i;
 			}
@@ -238,36 +389,101 @@ boolean CIGMPHandler::JoinHostGroup (const CIPAddress &rGroupAddress)
 
 		if (m_HostGroup[i] == rGroupAddress)
 		{
-			m_nUseCounter[i]++;
+			break;
+		}
+	}
 
-			return TRUE;
+	boolean bNewGroup = FALSE;
+	if (i == MaxHostGroups)
+	{
+		if (j == MaxHostGroups)
+		{
+			return FALSE;
 		}
+
+		i = j;
+		bNewGroup = TRUE;
+
+		m_HostGroup[i].Set (rGroupAddress);
+		m_nAnySourceCounter[i] = 0;
+		m_nSources[i] = 0;
+		m_nDelayTimer[i] = 0;
+		m_nChangeTimer[i] = 0;
 	}
 
-	if (j == MaxHostGroups)
+	boolean bStateChanged;
+	if (pSourceAddress == 0)
 	{
-		return FALSE;
+		bStateChanged = m_nAnySourceCounter[i]++ == 0;
 	}
+	else
+	{
+		unsigned k;
+		for (k = 0; k < m_nSources[i]; k++)
+		{
+			if (m_Source[i][k] == *pSourceAddress)
+			{
+				break;
+			}
+		}
 
-	assert (m_pLinkLayer != 0);
-	if (!m_pLinkLayer->JoinLocalGroup (rGroupAddress))
+		if (k < m_nSources[i])
+		{
+			m_nSourceUseCounter[i][k]++;
+
+			bStateChanged = FALSE;
+		}
+		else
+		{
+			if (m_nSources[i] == IGMP_MAX_SOURCES)
+			{
+				return FALSE;
+			}
+
+			m_Source[i][k].Set (*pSourceAddress);
+			m_nSourceUseCounter[i][k] = 1;
+			m_nSources[i]++;
+
+			bStateChanged = m_nAnySourceCounter[i] == 0;
+		}
+	}
+
+	if (bNewGroup)
 	{
-		return FALSE;
+		assert (m_pLinkLayer != 0);
+		if (!m_pLinkLayer->JoinLocalGroup (rGroupAddress))
+		{
+			m_nAnySourceCounter[i] = 0;
+			m_nSources[i] = 0;
+
+			return FALSE;
+		}
+
+		m_bLastHostFlag[i] = TRUE;
 	}
 
-	m_HostGroup[j].Set (rGroupAddress);
-	m_nUseCounter[j]++;
-	m_bLastHostFlag[j] = TRUE;
+	m_nUseCounter[i]++;
 
-	// start timer to send Membership Report twice on joining host group
-	m_nDelayTimer[j] = CTimer::Get ()->GetTicks () + UnsolicitedReportInterval;
+	if (IsV3Mode ())
+	{
+		if (bStateChanged)
+		{
+			ReportStateChange (i);
+		}
+	}
+	else if (bNewGroup)
+	{
+		// start timer to send Membership Report twice on joining host group
+		m_nDelayTimer[i] = CTimer::Get ()->GetTicks () + UnsolicitedReportInterval;
 
-	SendPacket (TRUE, rGroupAddress);
+		SendPacket (TRUE, rGroupAddress);
+	}
 
 	return TRUE;
 }
 
-boolean CIGMPHandler::LeaveHostGroup (const CIPAddress &rGroupAddress)
+boolean CIGMPHandler::LeaveHostGroup (const CIPAddress &rGroupAddress,
+				      const CIPAddress *pSourceAddress)
 {
 	unsigned i;
 	for (i = 0; i < MaxHostGroups; i++)
@@ -275,11 +491,6 @@ boolean CIGMPHandler::LeaveHostGroup (const CIPAddress &rGroupAddress)
 		if (   m_nUseCounter[i] > 0
 		    && m_HostGroup[i] == rGroupAddress)
 		{
-			if (--m_nUseCounter[i] > 0)
-			{
-				return TRUE;
-			}
-
 			break;
 		}
 	}
@@ -289,9 +500,62 @@ boolean CIGMPHandler::LeaveHostGroup (const CIPAddress &rGroupAddress)
 		return FALSE;
 	}
 
+	boolean bStateChanged;
+	if (pSourceAddress == 0)
+	{
+		if (m_nAnySourceCounter[i] == 0)
+		{
+			return FALSE;
+		}
+
+		bStateChanged = --m_nAnySourceCounter[i] == 0;
+	}
+	else
+	{
+		unsigned k;
+		for (k = 0; k < m_nSources[i]; k++)
+		{
+			if (m_Source[i][k] == *pSourceAddress)
+			{
+				break;
+			}
+		}
+
+		if (k == m_nSources[i])
+		{
+			return FALSE;
+		}
+
+		bStateChanged = FALSE;
+		if (--m_nSourceUseCounter[i][k] == 0)
+		{
+			// move the last source into the free slot
+			unsigned nLast = --m_nSources[i];
+			m_Source[i][k].Set (m_Source[i][nLast]);
+			m_nSourceUseCounter[i][k] = m_nSourceUseCounter[i][nLast];
+
+			bStateChanged = m_nAnySourceCounter[i] == 0;
+		}
+	}
+
+	if (--m_nUseCounter[i] > 0)
+	{
+		if (   bStateChanged
+		    && IsV3Mode ())
+		{
+			ReportStateChange (i);
+		}
+
+		return TRUE;
+	}
+
 	m_nDelayTimer[i] = 0;
 
-	if (m_bLastHostFlag[i])
+	if (IsV3Mode ())
+	{
+		ReportStateChange (i);		// reports INCLUDE {} now
+	}
+	else if (m_bLastHostFlag[i])
 	{
 		SendPacket (FALSE, rGroupAddress);
 	}
@@ -302,6 +566,17 @@ boolean CIGMPHandler::LeaveHostGroup (const CIPAddress &rGroupAddress)
 	return TRUE;
 }
 
+void CIGMPHandler::ReportStateChange (unsigned nGroup)
+{
+	assert (nGroup < MaxHostGroups);
+
+	SendReportV3 (TRUE, nGroup);
+
+	// the report is retransmitted [Robustness Variable] - 1 times (RFC 3376 5.1)
+	m_nChangeRetransmissions[nGroup] = RobustnessVariable - 1;
+	m_nChangeTimer[nGroup] = CTimer::Get ()->GetTicks () + 1 + GetRandom (UnsolicitedReportIntervalV3);
+}
+
 boolean CIGMPHandler::SendPacket (boolean bMembershipReport, const CIPAddress &rGroupAddress)
 {
 	u8 uchType;
@@ -340,6 +615,80 @@ boolean CIGMPHandler::SendPacket (boolean bMembershipReport, const CIPAddress &r
 	return m_pNetworkLayer->Send (DestIP, &Packet, sizeof Packet, IPPROTO_IGMP, TRUE);
 }
 
+boolean CIGMPHandler::SendReportV3 (boolean bStateChange, unsigned nGroup)
+{
+	u8 Buffer[sizeof (TIGMPReportV3) + MaxHostGroups * (  sizeof (TIGMPGroupRecord)
+							    + IGMP_MAX_SOURCES * IP_ADDRESS_SIZE)];
+	TIGMPReportV3 *pReport = (TIGMPReportV3 *) Buffer;
+	u8 *pRecords = Buffer + sizeof (TIGMPReportV3);
+
+	unsigned nRecords = 0;
+	for (unsigned i = 0; i < MaxHostGroups; i++)
+	{
+		if (nGroup < MaxHostGroups)
+		{
+			if (i != nGroup)
+			{
+				continue;
+			}
+		}
+		else if (m_nUseCounter[i] == 0)
+		{
+			continue;
+		}
+
+		// an unused group is reported as INCLUDE {} (leave)
+		boolean bExclude = m_nUseCounter[i] > 0 && m_nAnySourceCounter[i] > 0;
+		unsigned nSources = bExclude || m_nUseCounter[i] == 0 ? 0 : m_nSources[i];
+
+		TIGMPGroupRecord *pRecord = (TIGMPGroupRecord *) pRecords;
+		if (bStateChange)
+		{
+			pRecord->uchRecordType =   bExclude
+						 ? IGMP_RECORD_CHANGE_TO_EXCLUDE
+						 : IGMP_RECORD_CHANGE_TO_INCLUDE;
+		}
+		else
+		{
+			pRecord->uchRecordType =   bExclude
+						 ? IGMP_RECORD_MODE_IS_EXCLUDE
+						 : IGMP_RECORD_MODE_IS_INCLUDE;
+		}
+
+		pRecord->uchAuxDataLen = 0;
+		pRecord->usNumberOfSources = le2be16 (nSources);
+		m_HostGroup[i].CopyTo (pRecord->MulticastAddress);
+		pRecords += sizeof (TIGMPGroupRecord);
+
+		for (unsigned k = 0; k < nSources; k++)
+		{
+			m_Source[i][k].CopyTo (pRecords);
+			pRecords += IP_ADDRESS_SIZE;
+		}
+
+		nRecords++;
+	}
+
+	if (nRecords == 0)
+	{
+		return TRUE;
+	}
+
+	pReport->uchType = IGMP_TYPE_MEMBERSHIP_REPORT_V3;
+	pReport->uchReserved1 = 0;
+	pReport->usReserved2 = 0;
+	pReport->usNumberOfGroupRecords = le2be16 (nRecords);
+
+	unsigned nLength = pRecords - Buffer;
+	pReport->usChecksum = 0;
+	pReport->usChecksum = CChecksumCalculator::SimpleCalculate (Buffer, nLength);
+
+	CIPAddress DestIP (AllV3RoutersGroup);
+
+	assert (m_pNetworkLayer != 0);
+	return m_pNetworkLayer->Send (DestIP, Buffer, nLength, IPPROTO_IGMP, TRUE);
+}
+
 unsigned CIGMPHandler::GetRandom (unsigned nMax)
 {
 #define RAND_MAX	32767
@@ -0,0 +1,272 @@
+//
+// ipreassembly.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/ipreassembly.h>
+#include <circle/net/networklayer.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CIPReassembly::CIPReassembly (void)
+{
+	for (unsigned i = 0; i < IP_REASSEMBLY_SLOTS; i++)
+	{
+		m_Slot[i].bInUse = FALSE;
+		m_Slot[i].nFragments = 0;
+	}
+}
+
+CIPReassembly::~CIPReassembly (void)
+{
+	Flush ();
+}
+
+void CIPReassembly::Flush (void)
+{
+	for (unsigned i = 0; i < IP_REASSEMBLY_SLOTS; i++)
+	{
+		FreeSlot (&m_Slot[i]);
+	}
+}
+
+void CIPReassembly::Process (void)
+{
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	for (unsigned i = 0; i < IP_REASSEMBLY_SLOTS; i++)
+	{
+		TIPReassemblySlot *pSlot = &m_Slot[i];
+
+		if (   pSlot->bInUse
+		    && nTicks - pSlot->nTicksStarted >= IP_REASSEMBLY_TIMEOUT * HZ)
+		{
+			FreeSlot (pSlot);
+		}
+	}
+}
+
+CNetBuffer *CIPReassembly::AddFragment (CNetBuffer *pFragment)
+{
+	assert (pFragment != 0);
+	assert (pFragment->GetNextSegment () == 0);
+	TIPHeader *pHeader = (TIPHeader *) pFragment->GetData ();
+
+	unsigned nHeaderLength = (pHeader->nVersionIHL & 0xF) * 4;
+	assert (nHeaderLength <= IP_REASSEMBLY_MAX_HEADER);
+	assert (pFragment->GetLength () > nHeaderLength);
+	unsigned nLength = pFragment->GetLength () - nHeaderLength;
+
+	boolean bMoreFragments = pHeader->nFlagsFragmentOffset & IP_FLAGS_MF ? TRUE : FALSE;
+	unsigned nOffset = IP_FRAGMENT_OFFSET (le2be16 (pHeader->nFlagsFragmentOffset)) * 8;
+
+	// all fragments, but the last one, must carry a multiple of 8 bytes
+	if (   (   bMoreFragments
+		&& (nLength & 7) != 0)
+	    || nHeaderLength + nOffset + nLength > IP_MAX_DATAGRAM_SIZE)
+	{
+		pFragment->Release ();
+
+		return 0;
+	}
+
+	TIPReassemblySlot *pSlot = GetSlot (pHeader->SourceAddress, pHeader->DestinationAddress,
+					    pHeader->nIdentification, pHeader->nProtocol);
+	assert (pSlot != 0);
+
+	unsigned nEnd = nOffset + nLength;
+	if (!bMoreFragments)
+	{
+		if (   (   pSlot->nTotalLength != 0
+			&& pSlot->nTotalLength != nEnd)
+		    || (   pSlot->nFragments > 0
+			&&   pSlot->nOffset[pSlot->nFragments-1]
+			   + pSlot->pFragment[pSlot->nFragments-1]->GetLength () > nEnd))
+		{
+			goto DropDatagram;		// inconsistent length
+		}
+
+		pSlot->nTotalLength = nEnd;
+	}
+	else if (   pSlot->nTotalLength != 0
+		 && nEnd >= pSlot->nTotalLength)
+	{
+		goto DropDatagram;
+	}
+
+	{
+		// find the position of the new fragment
+		unsigned nPos;
+		for (nPos = 0; nPos < pSlot->nFragments; nPos++)
+		{
+			if (pSlot->nOffset[nPos] >= nOffset)
+			{
+				break;
+			}
+		}
+
+		if (   nPos < pSlot->nFragments
+		    && pSlot->nOffset[nPos] == nOffset
+		    && pSlot->pFragment[nPos]->GetLength () == nLength)
+		{
+			pFragment->Release ();		// duplicate
+
+			return 0;
+		}
+
+		if (   (   nPos > 0
+			&&   pSlot->nOffset[nPos-1] + pSlot->pFragment[nPos-1]->GetLength ()
+			   > nOffset)
+		    || (   nPos < pSlot->nFragments
+			&& pSlot->nOffset[nPos] < nEnd)
+		    || pSlot->nFragments == IP_REASSEMBLY_MAX_FRAGMENTS)
+		{
+			goto DropDatagram;		// overlapping or too many fragments
+		}
+
+		if (nOffset == 0)
+		{
+			memcpy (pSlot->Header, pHeader, nHeaderLength);
+			pSlot->nHeaderLength = nHeaderLength;
+		}
+
+		pFragment->RemoveHeader (nHeaderLength);
+
+		for (unsigned i = pSlot->nFragments; i > nPos; i--)
+		{
+			pSlot->pFragment[i] = pSlot->pFragment[i-1];
+			pSlot->nOffset[i] = pSlot->nOffset[i-1];
+		}
+
+		pSlot->pFragment[nPos] = pFragment;
+		pSlot->nOffset[nPos] = nOffset;
+		pSlot->nFragments++;
+
+		pSlot->nReceivedLength += nLength;
+	}
+
+	// fragments do not overlap, so the datagram is complete, if all bytes have arrived
+	if (   pSlot->nTotalLength == 0
+	    || pSlot->nReceivedLength < pSlot->nTotalLength)
+	{
+		return 0;
+	}
+
+	{
+		assert (pSlot->nReceivedLength == pSlot->nTotalLength);
+		assert (pSlot->nOffset[0] == 0);
+		assert (pSlot->nHeaderLength != 0);
+
+		CNetBuffer *pDatagram = pSlot->pFragment[0];
+		TIPHeader *pDatagramHeader = (TIPHeader *) pDatagram->Prepend (pSlot->nHeaderLength);
+		memcpy (pDatagramHeader, pSlot->Header, pSlot->nHeaderLength);
+
+		pDatagramHeader->nTotalLength = le2be16 ((u16) (pSlot->nHeaderLength + pSlot->nTotalLength));
+		pDatagramHeader->nFlagsFragmentOffset = BE (IP_FRAGMENT_OFFSET_FIRST);
+
+		for (unsigned i = 1; i < pSlot->nFragments; i++)
+		{
+			pDatagram->AppendSegment (pSlot->pFragment[i]);
+		}
+
+		pSlot->nFragments = 0;			// the fragments are handed over
+		FreeSlot (pSlot);
+
+		return pDatagram;
+	}
+
+DropDatagram:
+	pFragment->Release ();
+
+	FreeSlot (pSlot);
+
+	return 0;
+}
+
+TIPReassemblySlot *CIPReassembly::GetSlot (const u8 *pSourceAddress,
+					   const u8 *pDestinationAddress,
+					   u16 nIdentification, u8 nProtocol)
+{
+	TIPReassemblySlot *pFreeSlot = 0;
+	TIPReassemblySlot *pOldestSlot = 0;
+
+	for (unsigned i = 0; i < IP_REASSEMBLY_SLOTS; i++)
+	{
+		TIPReassemblySlot *pSlot = &m_Slot[i];
+
+		if (!pSlot->bInUse)
+		{
+			if (pFreeSlot == 0)
+			{
+				pFreeSlot = pSlot;
+			}
+
+			continue;
+		}
+
+		if (   pSlot->nIdentification == nIdentification
+		    && pSlot->nProtocol == nProtocol
+		    && memcmp (pSlot->SourceAddress, pSourceAddress, IP_ADDRESS_SIZE) == 0
+		    && memcmp (pSlot->DestinationAddress, pDestinationAddress, IP_ADDRESS_SIZE) == 0)
+		{
+			return pSlot;
+		}
+
+		if (   pOldestSlot == 0
+		    || (int) (pSlot->nTicksStarted - pOldestSlot->nTicksStarted) < 0)
+		{
+			pOldestSlot = pSlot;
+		}
+	}
+
+	// if all slots are in use, the oldest datagram is dropped
+	if (pFreeSlot == 0)
+	{
+		assert (pOldestSlot != 0);
+		FreeSlot (pOldestSlot);
+
+		pFreeSlot = pOldestSlot;
+	}
+
+	pFreeSlot->bInUse = TRUE;
+	memcpy (pFreeSlot->SourceAddress, pSourceAddress, IP_ADDRESS_SIZE);
+	memcpy (pFreeSlot->DestinationAddress, pDestinationAddress, IP_ADDRESS_SIZE);
+	pFreeSlot->nIdentification = nIdentification;
+	pFreeSlot->nProtocol = nProtocol;
+	pFreeSlot->nTicksStarted = CTimer::Get ()->GetTicks ();
+	pFreeSlot->nTotalLength = 0;
+	pFreeSlot->nReceivedLength = 0;
+	pFreeSlot->nFragments = 0;
+	pFreeSlot->nHeaderLength = 0;
+
+	return pFreeSlot;
+}
+
+void CIPReassembly::FreeSlot (TIPReassemblySlot *pSlot)
+{
+	assert (pSlot != 0);
+
+	for (unsigned i = 0; i < pSlot->nFragments; i++)
+	{
+		assert (pSlot->pFragment[i] != 0);
+		pSlot->pFragment[i]->Release ();
+	}
+
+	pSlot->nFragments = 0;
+	pSlot->bInUse = FALSE;
+}
@@ -0,0 +1,251 @@
+//
+// ipv6address.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/ipv6address.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CIPv6Address::CIPv6Address (void)
+{
+	SetNull ();
+}
+
+CIPv6Address::CIPv6Address (const u8 *pAddress)
+{
+	Set (pAddress);
+}
+
+CIPv6Address::CIPv6Address (const CIPv6Address &rAddress)
+{
+	Set (rAddress);
+}
+
+CIPv6Address::~CIPv6Address (void)
+{
+}
+
+boolean CIPv6Address::operator== (const CIPv6Address &rAddress2) const
+{
+	return memcmp (m_Address, rAddress2.m_Address, IPV6_ADDRESS_SIZE) == 0 ? TRUE : FALSE;
+}
+
+boolean CIPv6Address::operator!= (const CIPv6Address &rAddress2) const
+{
+	return !operator== (rAddress2);
+}
+
+boolean CIPv6Address::operator== (const u8 *pAddress2) const
+{
+	assert (pAddress2 != 0);
+	return memcmp (m_Address, pAddress2, IPV6_ADDRESS_SIZE) == 0 ? TRUE : FALSE;
+}
+
+boolean CIPv6Address::operator!= (const u8 *pAddress2) const
+{
+	return !operator== (pAddress2);
+}
+
+CIPv6Address &CIPv6Address::operator= (const CIPv6Address &rAddress)
+{
+	Set (rAddress);
+
+	return *this;
+}
+
+void CIPv6Address::Set (const u8 *pAddress)
+{
+	assert (pAddress != 0);
+	memcpy (m_Address, pAddress, IPV6_ADDRESS_SIZE);
+}
+
+void CIPv6Address::Set (const CIPv6Address &rAddress)
+{
+	memcpy (m_Address, rAddress.m_Address, IPV6_ADDRESS_SIZE);
+}
+
+void CIPv6Address::SetNull (void)
+{
+	memset (m_Address, 0, IPV6_ADDRESS_SIZE);
+}
+
+void CIPv6Address::SetLinkLocal (const CMACAddress &rMACAddress)
+{
+	static const u8 LinkLocalPrefix[IPV6_PREFIX_LENGTH / 8] = {0xFE, 0x80, 0, 0, 0, 0, 0, 0};
+
+	SetFromPrefix (LinkLocalPrefix, rMACAddress);
+}
+
+void CIPv6Address::SetFromPrefix (const u8 *pPrefix, const CMACAddress &rMACAddress)
+{
+	assert (pPrefix != 0);
+	memcpy (m_Address, pPrefix, IPV6_PREFIX_LENGTH / 8);
+
+	// modified EUI-64 interface identifier (RFC 4291 appendix A)
+	const u8 *pMAC = rMACAddress.Get ();
+	assert (pMAC != 0);
+	m_Address[8]  = pMAC[0] ^ 0x02;		// invert the universal/local bit
+	m_Address[9]  = pMAC[1];
+	m_Address[10] = pMAC[2];
+	m_Address[11] = 0xFF;
+	m_Address[12] = 0xFE;
+	m_Address[13] = pMAC[3];
+	m_Address[14] = pMAC[4];
+	m_Address[15] = pMAC[5];
+}
+
+void CIPv6Address::SetSolicitedNode (const CIPv6Address &rAddress)
+{
+	static const u8 SolicitedNodePrefix[13] = {0xFF, 0x02, 0, 0, 0, 0, 0, 0,
+						   0, 0, 0, 0x01, 0xFF};
+
+	u8 Address[IPV6_ADDRESS_SIZE];
+	memcpy (Address, SolicitedNodePrefix, sizeof SolicitedNodePrefix);
+	memcpy (Address + sizeof SolicitedNodePrefix, rAddress.m_Address + sizeof SolicitedNodePrefix,
+		IPV6_ADDRESS_SIZE - sizeof SolicitedNodePrefix);
+
+	Set (Address);
+}
+
+void CIPv6Address::SetAllNodes (void)
+{
+	SetNull ();
+	m_Address[0] = 0xFF;
+	m_Address[1] = 0x02;
+	m_Address[15] = 0x01;
+}
+
+void CIPv6Address::SetAllRouters (void)
+{
+	SetNull ();
+	m_Address[0] = 0xFF;
+	m_Address[1] = 0x02;
+	m_Address[15] = 0x02;
+}
+
+const u8 *CIPv6Address::Get (void) const
+{
+	return m_Address;
+}
+
+void CIPv6Address::CopyTo (u8 *pBuffer) const
+{
+	assert (pBuffer != 0);
+	memcpy (pBuffer, m_Address, IPV6_ADDRESS_SIZE);
+}
+
+boolean CIPv6Address::IsNull (void) const
+{
+	for (unsigned i = 0; i < IPV6_ADDRESS_SIZE; i++)
+	{
+		if (m_Address[i] != 0)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CIPv6Address::IsMulticast (void) const
+{
+	return m_Address[0] == 0xFF;
+}
+
+boolean CIPv6Address::IsLinkLocal (void) const
+{
+	return    m_Address[0] == 0xFE
+	       && (m_Address[1] & 0xC0) == 0x80;
+}
+
+unsigned CIPv6Address::GetSize (void) const
+{
+	return IPV6_ADDRESS_SIZE;
+}
+
+void CIPv6Address::Format (CString *pString) const
+{
+	assert (pString != 0);
+
+	u16 Group[IPV6_ADDRESS_SIZE / 2];
+	for (unsigned i = 0; i < IPV6_ADDRESS_SIZE / 2; i++)
+	{
+		Group[i] = (u16) m_Address[2*i] << 8 | m_Address[2*i+1];
+	}
+
+	// find the longest run of at least two zero groups, which is replaced by "::"
+	int nZeroStart = -1;
+	unsigned nZeroLength = 1;
+	for (unsigned i = 0; i < IPV6_ADDRESS_SIZE / 2; i++)
+	{
+		unsigned j;
+		for (j = i; j < IPV6_ADDRESS_SIZE / 2 && Group[j] == 0; j++)
+		{
+			// just count
+		}
+
+		if (j - i > nZeroLength)
+		{
+			nZeroStart = i;
+			nZeroLength = j - i;
+		}
+	}
+
+	*pString = "";
+	for (unsigned i = 0; i < IPV6_ADDRESS_SIZE / 2; i++)
+	{
+		if ((int) i == nZeroStart)
+		{
+			pString->Append (i == 0 ? "::" : ":");
+			i += nZeroLength - 1;
+
+			continue;
+		}
+
+		CString Hex;
+		Hex.Format ("%x", (unsigned) Group[i]);
+		pString->Append ((const char *) Hex);
+
+		if (i < IPV6_ADDRESS_SIZE / 2 - 1)
+		{
+			pString->Append (":");
+		}
+	}
+}
+
+boolean CIPv6Address::OnPrefix (const u8 *pPrefix, unsigned nPrefixLength) const
+{
+	assert (pPrefix != 0);
+	assert (nPrefixLength <= IPV6_ADDRESS_SIZE * 8);
+
+	unsigned nBytes = nPrefixLength / 8;
+	if (memcmp (m_Address, pPrefix, nBytes) != 0)
+	{
+		return FALSE;
+	}
+
+	unsigned nBits = nPrefixLength % 8;
+	if (nBits == 0)
+	{
+		return TRUE;
+	}
+
+	u8 uchMask = 0xFF << (8 - nBits);
+
+	return (m_Address[nBytes] & uchMask) == (pPrefix[nBytes] & uchMask);
+}
@@ -0,0 +1,1154 @@
+//
+// ipv6layer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/ipv6layer.h>
+#include <circle/net/checksumcalculator.h>
+#include <circle/net/in.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <circle/macros.h>
+#include <assert.h>
+
+#define ICMPV6_TYPE_ECHO_REQUEST		128
+#define ICMPV6_TYPE_ECHO_REPLY			129
+#define ICMPV6_TYPE_ROUTER_SOLICITATION		133
+#define ICMPV6_TYPE_ROUTER_ADVERTISEMENT	134
+#define ICMPV6_TYPE_NEIGHBOR_SOLICITATION	135
+#define ICMPV6_TYPE_NEIGHBOR_ADVERTISEMENT	136
+
+#define NDP_OPTION_SOURCE_LINK_ADDRESS		1
+#define NDP_OPTION_TARGET_LINK_ADDRESS		2
+#define NDP_OPTION_PREFIX_INFORMATION		3
+#define NDP_OPTION_MTU				5
+
+#define DAD_DELAY_HZ			HZ		// RetransTimer
+#define RS_INTERVAL_HZ			(4 * HZ)	// RFC 4861 section 10
+#define RS_MAX_SOLICITATIONS		3
+#define NS_INTERVAL_HZ			HZ
+#define NS_MAX_SOLICITATIONS		3
+#define NEIGHBOR_TIMEOUT_HZ		(60 * HZ)	// re-resolve after this time
+
+#define LIFETIME_INFINITE		0xFFFFFFFF
+
+struct TICMPv6Header
+{
+	u8	nType;
+	u8	nCode;
+	u16	nChecksum;
+}
+PACKED;
+
+struct TICMPv6Echo
+{
+	TICMPv6Header	Header;
+	u16		nIdentifier;
+	u16		nSequenceNumber;
+	//u8		Data[];
+}
+PACKED;
+
+struct TNDPLinkLayerOption
+{
+	u8	nType;
+	u8	nLength;				// in units of 8 bytes
+	u8	MACAddress[MAC_ADDRESS_SIZE];
+}
+PACKED;
+
+struct TNDPRouterSolicitation
+{
+	TICMPv6Header		Header;
+	u32			nReserved;
+	TNDPLinkLayerOption	SourceLinkAddress;
+}
+PACKED;
+
+struct TNDPRouterAdvertisement
+{
+	TICMPv6Header	Header;
+	u8		nCurHopLimit;
+	u8		nFlags;
+	u16		nRouterLifetime;		// in seconds
+	u32		nReachableTime;
+	u32		nRetransTimer;
+	//u8		Options[];
+}
+PACKED;
+
+struct TNDPPrefixOption
+{
+	u8	nType;
+	u8	nLength;
+	u8	nPrefixLength;
+	u8	nFlags;
+#define NDP_PREFIX_FLAG_ONLINK		0x80
+#define NDP_PREFIX_FLAG_AUTONOMOUS	0x40
+	u32	nValidLifetime;				// in seconds
+	u32	nPreferredLifetime;
+	u32	nReserved;
+	u8	Prefix[IPV6_ADDRESS_SIZE];
+}
+PACKED;
+
+struct TNDPMTUOption
+{
+	u8	nType;
+	u8	nLength;
+	u16	nReserved;
+	u32	nMTU;
+}
+PACKED;
+
+struct TNDPNeighborMessage			// solicitation and advertisement
+{
+	TICMPv6Header		Header;
+	u32			nFlags;			// reserved for solicitation
+#define NDP_NA_FLAG_ROUTER		(1 << 31)
+#define NDP_NA_FLAG_SOLICITED		(1 << 30)
+#define NDP_NA_FLAG_OVERRIDE		(1 << 29)
+	u8			TargetAddress[IPV6_ADDRESS_SIZE];
+	TNDPLinkLayerOption	LinkAddress;		// optional
+}
+PACKED;
+
+#define NDP_NEIGHBOR_MESSAGE_MIN	(sizeof (TNDPNeighborMessage) - sizeof (TNDPLinkLayerOption))
+
+struct TIPv6PseudoHeader
+{
+	u8	SourceAddress[IPV6_ADDRESS_SIZE];
+	u8	DestinationAddress[IPV6_ADDRESS_SIZE];
+	u32	nLength;
+	u8	Zero[3];
+	u8	nNextHeader;
+}
+PACKED;
+
+static const char FromIPv6[] = "ipv6";
+
+CIPv6Layer::CIPv6Layer (CNetDeviceLayer *pNetDevLayer, CLinkLayer *pLinkLayer)
+:	m_pNetDevLayer (pNetDevLayer),
+	m_pLinkLayer (pLinkLayer),
+	m_State (StateWaitForMAC),
+	m_nStateTicks (0),
+	m_nSolicitations (0),
+	m_bGlobalValid (FALSE),
+	m_nPrefixLength (0),
+	m_nGlobalTicks (0),
+	m_nGlobalLifetime (0),
+	m_bRouterValid (FALSE),
+	m_nRouterTicks (0),
+	m_nRouterLifetime (0),
+	m_nHopLimit (IPV6_HOP_LIMIT_DEFAULT),
+	m_nLinkMTU (IPV6_MTU_MIN)
+{
+	assert (m_pNetDevLayer != 0);
+	assert (m_pLinkLayer != 0);
+
+	for (unsigned i = 0; i < IPV6_NEIGHBOR_CACHE_SIZE; i++)
+	{
+		m_Neighbor[i].nState = IPV6_NEIGHBOR_FREE;
+		m_Neighbor[i].pPendingPacket = 0;
+	}
+}
+
+CIPv6Layer::~CIPv6Layer (void)
+{
+	for (unsigned i = 0; i < IPV6_NEIGHBOR_CACHE_SIZE; i++)
+	{
+		FreeNeighbor (&m_Neighbor[i]);
+	}
+
+	m_pLinkLayer = 0;
+	m_pNetDevLayer = 0;
+}
+
+boolean CIPv6Layer::Initialize (void)
+{
+	assert (m_pLinkLayer != 0);
+	m_pLinkLayer->EnableIPv6 ();
+
+	return TRUE;
+}
+
+void CIPv6Layer::Process (void)
+{
+	ProcessTimers ();
+
+	assert (m_pLinkLayer != 0);
+	CNetBuffer *pPacket;
+	while ((pPacket = m_pLinkLayer->ReceiveIPv6 ()) != 0)
+	{
+		if (m_State != StateWaitForMAC)
+		{
+			ProcessPacket (pPacket);
+		}
+
+		pPacket->Release ();
+	}
+}
+
+boolean CIPv6Layer::Send (const CIPv6Address &rReceiver, CNetBuffer *pPayload, int nNextHeader)
+{
+	assert (pPayload != 0);
+
+	const CIPv6Address *pSource = SelectSource (rReceiver);
+	unsigned nLength = pPayload->GetTotalLength ();
+	if (   pSource == 0
+	    || nLength == 0
+	    || sizeof (TIPv6Header) + nLength > m_nLinkMTU)	// we do not fragment
+	{
+		pPayload->Release ();
+
+		return FALSE;
+	}
+
+	// the upper layer checksum depends on the source address, which is selected here
+	unsigned nChecksumOffset = 0;
+	switch (nNextHeader)
+	{
+	case IPPROTO_ICMPV6:	nChecksumOffset = 2;	break;
+	case IPPROTO_UDP:	nChecksumOffset = 6;	break;
+	case IPPROTO_TCP:	nChecksumOffset = 16;	break;
+	}
+
+	if (   nChecksumOffset != 0
+	    && nChecksumOffset + 2 <= pPayload->GetLength ())
+	{
+		u16 *pChecksum = (u16 *) (pPayload->GetData () + nChecksumOffset);
+		*pChecksum = 0;
+
+		u16 nChecksum;
+		if (pPayload->GetNextSegment () == 0)
+		{
+			nChecksum = CalculateChecksum (*pSource, rReceiver, pPayload->GetData (),
+						       nLength, nNextHeader);
+		}
+		else
+		{
+			u8 Buffer[FRAME_BUFFER_SIZE];
+			assert (nLength <= sizeof Buffer);
+			pPayload->CopyTo (Buffer);
+
+			nChecksum = CalculateChecksum (*pSource, rReceiver, Buffer,
+						       nLength, nNextHeader);
+		}
+
+		if (   nChecksum == 0
+		    && nNextHeader == IPPROTO_UDP)
+		{
+			nChecksum = 0xFFFF;		// the UDP checksum is mandatory for IPv6
+		}
+
+		*pChecksum = nChecksum;
+	}
+
+	TIPv6Header *pHeader = (TIPv6Header *) pPayload->Prepend (sizeof (TIPv6Header));
+	assert (pHeader != 0);
+
+	pHeader->nVersionClassFlow = le2be32 (IPV6_VERSION_6 << 28);
+	pHeader->nPayloadLength = le2be16 (nLength);
+	pHeader->nNextHeader = (u8) nNextHeader;
+	pHeader->nHopLimit = rReceiver.IsMulticast () ? 1 : (u8) m_nHopLimit;
+	pSource->CopyTo (pHeader->SourceAddress);
+	rReceiver.CopyTo (pHeader->DestinationAddress);
+
+	const CIPv6Address *pNextHop = &rReceiver;
+	if (   !rReceiver.IsMulticast ()
+	    && !IsOnLink (rReceiver))
+	{
+		if (!m_bRouterValid)
+		{
+			pPayload->Release ();
+
+			return FALSE;
+		}
+
+		pNextHop = &m_DefaultRouter;
+	}
+
+	return SendPacket (*pNextHop, pPayload);
+}
+
+boolean CIPv6Layer::IsRunning (void) const
+{
+	return    m_State == StateRouterSolicitation
+	       || m_State == StateRunning;
+}
+
+const CIPv6Address *CIPv6Layer::GetLinkLocalAddress (void) const
+{
+	return &m_LinkLocalAddress;
+}
+
+const CIPv6Address *CIPv6Layer::GetGlobalAddress (void) const
+{
+	return m_bGlobalValid ? &m_GlobalAddress : 0;
+}
+
+const CIPv6Address *CIPv6Layer::GetDefaultRouter (void) const
+{
+	return m_bRouterValid ? &m_DefaultRouter : 0;
+}
+
+void CIPv6Layer::ProcessPacket (CNetBuffer *pPacket)
+{
+	assert (pPacket != 0);
+	assert (pPacket->GetNextSegment () == 0);
+	unsigned nLength = pPacket->GetLength ();
+	if (nLength < sizeof (TIPv6Header))
+	{
+		return;
+	}
+
+	const TIPv6Header *pHeader = (const TIPv6Header *) pPacket->GetData ();
+	if (IPV6_VERSION (be2le32 (pHeader->nVersionClassFlow)) != IPV6_VERSION_6)
+	{
+		return;
+	}
+
+	unsigned nPayloadLength = be2le16 (pHeader->nPayloadLength);
+	if (nPayloadLength > nLength - sizeof (TIPv6Header))
+	{
+		return;
+	}
+
+	CIPv6Address Destination (pHeader->DestinationAddress);
+	if (!IsOwnAddress (Destination))
+	{
+		if (!Destination.IsMulticast ())
+		{
+			return;
+		}
+
+		// multicast frames have already been filtered by MAC address in the link layer,
+		// we check the solicited-node groups for our addresses here
+		CIPv6Address Group;
+		Group.SetAllNodes ();
+		if (Destination != Group)
+		{
+			boolean bFound = FALSE;
+
+			Group.SetSolicitedNode (m_LinkLocalAddress);
+			if (Destination == Group)
+			{
+				bFound = TRUE;
+			}
+
+			if (m_bGlobalValid)
+			{
+				Group.SetSolicitedNode (m_GlobalAddress);
+				if (Destination == Group)
+				{
+					bFound = TRUE;
+				}
+			}
+
+			if (!bFound)
+			{
+				return;
+			}
+		}
+	}
+
+	// extension headers and upper layer protocols are not supported yet
+	if (pHeader->nNextHeader != IPPROTO_ICMPV6)
+	{
+		return;
+	}
+
+	const u8 *pMessage = (const u8 *) pHeader + sizeof (TIPv6Header);
+	if (   nPayloadLength < sizeof (TICMPv6Header)
+	    || CalculateChecksum (CIPv6Address (pHeader->SourceAddress), Destination,
+				  pMessage, nPayloadLength, IPPROTO_ICMPV6) != CHECKSUM_OK)
+	{
+		return;
+	}
+
+	ProcessICMPv6 (pHeader, pMessage, nPayloadLength);
+}
+
+void CIPv6Layer::ProcessICMPv6 (const TIPv6Header *pHeader, const u8 *pMessage, unsigned nLength)
+{
+	assert (pHeader != 0);
+	assert (pMessage != 0);
+	assert (nLength >= sizeof (TICMPv6Header));
+
+	const TICMPv6Header *pICMPv6Header = (const TICMPv6Header *) pMessage;
+	if (pICMPv6Header->nType < ICMPV6_TYPE_ECHO_REQUEST)
+	{
+		return;			// error messages are ignored
+	}
+
+	if (pICMPv6Header->nType >= ICMPV6_TYPE_ROUTER_SOLICITATION)
+	{
+		// NDP messages must not have been forwarded by a router (RFC 4861 section 6.1)
+		if (   pHeader->nHopLimit != IPV6_HOP_LIMIT_ND
+		    || pICMPv6Header->nCode != 0)
+		{
+			return;
+		}
+	}
+
+	switch (pICMPv6Header->nType)
+	{
+	case ICMPV6_TYPE_ECHO_REQUEST: {
+		if (   nLength < sizeof (TICMPv6Echo)
+		    || nLength > FRAME_BUFFER_SIZE
+		    || !IsRunning ())
+		{
+			break;
+		}
+
+		CIPv6Address Source (pHeader->SourceAddress);
+		CIPv6Address Destination (pHeader->DestinationAddress);
+
+		const CIPv6Address *pOwnAddress = &Destination;
+		if (Destination.IsMulticast ())
+		{
+			pOwnAddress = SelectSource (Source);
+			if (pOwnAddress == 0)
+			{
+				break;
+			}
+		}
+
+		u8 Buffer[FRAME_BUFFER_SIZE];
+		memcpy (Buffer, pMessage, nLength);
+
+		TICMPv6Echo *pEcho = (TICMPv6Echo *) Buffer;
+		pEcho->Header.nType = ICMPV6_TYPE_ECHO_REPLY;
+
+		SendICMPv6 (*pOwnAddress, Source, Buffer, nLength, m_nHopLimit);
+		} break;
+
+	case ICMPV6_TYPE_NEIGHBOR_SOLICITATION:
+		ProcessNeighborSolicitation (pHeader, pMessage, nLength);
+		break;
+
+	case ICMPV6_TYPE_NEIGHBOR_ADVERTISEMENT:
+		ProcessNeighborAdvertisement (pMessage, nLength);
+		break;
+
+	case ICMPV6_TYPE_ROUTER_ADVERTISEMENT:
+		ProcessRouterAdvertisement (pHeader, pMessage, nLength);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CIPv6Layer::ProcessNeighborSolicitation (const TIPv6Header *pHeader,
+					      const u8 *pMessage, unsigned nLength)
+{
+	assert (pHeader != 0);
+	assert (pMessage != 0);
+
+	if (nLength < NDP_NEIGHBOR_MESSAGE_MIN)
+	{
+		return;
+	}
+
+	const TNDPNeighborMessage *pNS = (const TNDPNeighborMessage *) pMessage;
+	CIPv6Address Target (pNS->TargetAddress);
+	CIPv6Address Source (pHeader->SourceAddress);
+
+	if (m_State == StateDAD)
+	{
+		// another node is probing for our tentative address
+		if (   Target == m_LinkLocalAddress
+		    && Source.IsNull ())
+		{
+			CString IPString;
+			m_LinkLocalAddress.Format (&IPString);
+			CLogger::Get ()->Write (FromIPv6, LogError, "Duplicate address %s",
+						(const char *) IPString);
+
+			m_State = StateDuplicate;
+		}
+
+		return;
+	}
+
+	if (   !IsRunning ()
+	    || !IsOwnAddress (Target))
+	{
+		return;
+	}
+
+	if (Source.IsNull ())
+	{
+		// DAD of another node for one of our addresses, defend it
+		CIPv6Address AllNodes;
+		AllNodes.SetAllNodes ();
+		SendNeighborAdvertisement (AllNodes, Target, FALSE);
+
+		return;
+	}
+
+	const u8 *pMACAddress = FindLinkLayerOption (pMessage + NDP_NEIGHBOR_MESSAGE_MIN,
+						     nLength - NDP_NEIGHBOR_MESSAGE_MIN,
+						     NDP_OPTION_SOURCE_LINK_ADDRESS);
+	if (pMACAddress != 0)
+	{
+		UpdateNeighbor (Source, pMACAddress, TRUE);
+	}
+
+	SendNeighborAdvertisement (Source, Target, TRUE);
+}
+
+void CIPv6Layer::ProcessNeighborAdvertisement (const u8 *pMessage, unsigned nLength)
+{
+	assert (pMessage != 0);
+
+	if (nLength < NDP_NEIGHBOR_MESSAGE_MIN)
+	{
+		return;
+	}
+
+	const TNDPNeighborMessage *pNA = (const TNDPNeighborMessage *) pMessage;
+	CIPv6Address Target (pNA->TargetAddress);
+	if (Target.IsMulticast ())
+	{
+		return;
+	}
+
+	if (   m_State == StateDAD
+	    && Target == m_LinkLocalAddress)
+	{
+		CString IPString;
+		m_LinkLocalAddress.Format (&IPString);
+		CLogger::Get ()->Write (FromIPv6, LogError, "Duplicate address %s",
+					(const char *) IPString);
+
+		m_State = StateDuplicate;
+
+		return;
+	}
+
+	const u8 *pMACAddress = FindLinkLayerOption (pMessage + NDP_NEIGHBOR_MESSAGE_MIN,
+						     nLength - NDP_NEIGHBOR_MESSAGE_MIN,
+						     NDP_OPTION_TARGET_LINK_ADDRESS);
+	if (pMACAddress != 0)
+	{
+		UpdateNeighbor (Target, pMACAddress, FALSE);
+	}
+}
+
+void CIPv6Layer::ProcessRouterAdvertisement (const TIPv6Header *pHeader,
+					     const u8 *pMessage, unsigned nLength)
+{
+	assert (pHeader != 0);
+	assert (pMessage != 0);
+
+	CIPv6Address Router (pHeader->SourceAddress);
+	if (   nLength < sizeof (TNDPRouterAdvertisement)
+	    || !Router.IsLinkLocal ()
+	    || !IsRunning ())
+	{
+		return;
+	}
+
+	const TNDPRouterAdvertisement *pRA = (const TNDPRouterAdvertisement *) pMessage;
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	if (pRA->nCurHopLimit != 0)
+	{
+		m_nHopLimit = pRA->nCurHopLimit;
+	}
+
+	unsigned nRouterLifetime = be2le16 (pRA->nRouterLifetime);
+	if (nRouterLifetime != 0)
+	{
+		if (   !m_bRouterValid
+		    || m_DefaultRouter != Router)
+		{
+			CString IPString;
+			Router.Format (&IPString);
+			CLogger::Get ()->Write (FromIPv6, LogNotice, "Default router is %s",
+						(const char *) IPString);
+		}
+
+		m_DefaultRouter = Router;
+		m_nRouterTicks = nTicks;
+		m_nRouterLifetime = nRouterLifetime;
+		m_bRouterValid = TRUE;
+	}
+	else if (   m_bRouterValid
+		 && m_DefaultRouter == Router)
+	{
+		m_bRouterValid = FALSE;
+	}
+
+	const u8 *pOptions = pMessage + sizeof (TNDPRouterAdvertisement);
+	nLength -= sizeof (TNDPRouterAdvertisement);
+	while (nLength >= 8)
+	{
+		unsigned nOptionLength = pOptions[1] * 8;
+		if (   nOptionLength == 0
+		    || nOptionLength > nLength)
+		{
+			break;
+		}
+
+		switch (pOptions[0])
+		{
+		case NDP_OPTION_SOURCE_LINK_ADDRESS:
+			if (nOptionLength >= sizeof (TNDPLinkLayerOption))
+			{
+				UpdateNeighbor (Router, pOptions + 2, TRUE);
+			}
+			break;
+
+		case NDP_OPTION_MTU:
+			if (nOptionLength >= sizeof (TNDPMTUOption))
+			{
+				const TNDPMTUOption *pMTU = (const TNDPMTUOption *) pOptions;
+				unsigned nMTU = be2le32 (pMTU->nMTU);
+				if (   nMTU >= IPV6_MTU_MIN
+				    && nMTU <= FRAME_BUFFER_SIZE - sizeof (TEthernetHeader))
+				{
+					m_nLinkMTU = nMTU;
+				}
+			}
+			break;
+
+		case NDP_OPTION_PREFIX_INFORMATION: {
+			if (nOptionLength < sizeof (TNDPPrefixOption))
+			{
+				break;
+			}
+
+			const TNDPPrefixOption *pPrefix = (const TNDPPrefixOption *) pOptions;
+			CIPv6Address Prefix (pPrefix->Prefix);
+			unsigned nValidLifetime = be2le32 (pPrefix->nValidLifetime);
+			if (   !(pPrefix->nFlags & NDP_PREFIX_FLAG_AUTONOMOUS)
+			    || pPrefix->nPrefixLength != IPV6_PREFIX_LENGTH
+			    || Prefix.IsLinkLocal ()
+			    || Prefix.IsMulticast ()
+			    || nValidLifetime == 0)
+			{
+				break;
+			}
+
+			CIPv6Address Address;
+			Address.SetFromPrefix (pPrefix->Prefix, m_OwnMACAddress);
+
+			if (   m_bGlobalValid
+			    && m_GlobalAddress != Address)
+			{
+				break;			// only one global address is supported
+			}
+
+			if (!m_bGlobalValid)
+			{
+				// DAD is omitted for SLAAC addresses, because the
+				// interface identifier is unique already
+				m_GlobalAddress = Address;
+				memcpy (m_Prefix, pPrefix->Prefix, IPV6_ADDRESS_SIZE);
+				m_nPrefixLength = pPrefix->nPrefixLength;
+				m_bGlobalValid = TRUE;
+
+				JoinSolicitedNodeGroup (m_GlobalAddress, TRUE);
+
+				CString IPString;
+				m_GlobalAddress.Format (&IPString);
+				CLogger::Get ()->Write (FromIPv6, LogNotice, "Global address is %s",
+							(const char *) IPString);
+			}
+
+			m_nGlobalTicks = nTicks;
+			m_nGlobalLifetime = nValidLifetime;
+			} break;
+
+		default:
+			break;
+		}
+
+		pOptions += nOptionLength;
+		nLength -= nOptionLength;
+	}
+
+	m_State = StateRunning;			// stop router solicitations
+}
+
+void CIPv6Layer::ProcessTimers (void)
+{
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	switch (m_State)
+	{
+	case StateWaitForMAC: {
+		assert (m_pNetDevLayer != 0);
+		const CMACAddress *pMACAddress = m_pNetDevLayer->GetMACAddress ();
+		if (pMACAddress == 0)
+		{
+			return;
+		}
+
+		m_OwnMACAddress.Set (pMACAddress->Get ());
+		m_LinkLocalAddress.SetLinkLocal (m_OwnMACAddress);
+
+		CIPv6Address AllNodes;
+		AllNodes.SetAllNodes ();
+		CMACAddress Group;
+		Group.SetMulticastIPv6 (AllNodes.Get ());
+		assert (m_pLinkLayer != 0);
+		m_pLinkLayer->JoinLocalGroup (Group);
+
+		JoinSolicitedNodeGroup (m_LinkLocalAddress, TRUE);
+
+		SendNeighborSolicitation (m_LinkLocalAddress, TRUE);
+
+		m_State = StateDAD;
+		m_nStateTicks = nTicks;
+		} return;
+
+	case StateDAD:
+		if (nTicks - m_nStateTicks >= DAD_DELAY_HZ)
+		{
+			CString IPString;
+			m_LinkLocalAddress.Format (&IPString);
+			CLogger::Get ()->Write (FromIPv6, LogNotice, "Link-local address is %s",
+						(const char *) IPString);
+
+			SendRouterSolicitation ();
+
+			m_State = StateRouterSolicitation;
+			m_nStateTicks = nTicks;
+			m_nSolicitations = 1;
+		}
+		return;
+
+	case StateRouterSolicitation:
+		if (nTicks - m_nStateTicks >= RS_INTERVAL_HZ)
+		{
+			if (m_nSolicitations >= RS_MAX_SOLICITATIONS)
+			{
+				m_State = StateRunning;		// no router on this link
+
+				break;
+			}
+
+			SendRouterSolicitation ();
+
+			m_nStateTicks = nTicks;
+			m_nSolicitations++;
+		}
+		break;
+
+	case StateRunning:
+		break;
+
+	case StateDuplicate:
+		return;
+	}
+
+	if (   m_bGlobalValid
+	    && m_nGlobalLifetime != LIFETIME_INFINITE
+	    && (nTicks - m_nGlobalTicks) / HZ >= m_nGlobalLifetime)
+	{
+		CLogger::Get ()->Write (FromIPv6, LogNotice, "Global address expired");
+
+		JoinSolicitedNodeGroup (m_GlobalAddress, FALSE);
+
+		m_bGlobalValid = FALSE;
+	}
+
+	if (   m_bRouterValid
+	    && (nTicks - m_nRouterTicks) / HZ >= m_nRouterLifetime)
+	{
+		m_bRouterValid = FALSE;
+	}
+
+	for (unsigned i = 0; i < IPV6_NEIGHBOR_CACHE_SIZE; i++)
+	{
+		TIPv6Neighbor *pEntry = &m_Neighbor[i];
+
+		switch (pEntry->nState)
+		{
+		case IPV6_NEIGHBOR_INCOMPLETE:
+			if (nTicks - pEntry->nTicks >= NS_INTERVAL_HZ)
+			{
+				if (++pEntry->nRetries >= NS_MAX_SOLICITATIONS)
+				{
+					FreeNeighbor (pEntry);
+
+					break;
+				}
+
+				SendNeighborSolicitation (pEntry->IPAddress, FALSE);
+
+				pEntry->nTicks = nTicks;
+			}
+			break;
+
+		case IPV6_NEIGHBOR_REACHABLE:
+			if (nTicks - pEntry->nTicks >= NEIGHBOR_TIMEOUT_HZ)
+			{
+				FreeNeighbor (pEntry);
+			}
+			break;
+
+		default:
+			break;
+		}
+	}
+}
+
+const u8 *CIPv6Layer::FindLinkLayerOption (const u8 *pOptions, unsigned nLength, unsigned nType)
+{
+	assert (pOptions != 0);
+
+	while (nLength >= sizeof (TNDPLinkLayerOption))
+	{
+		unsigned nOptionLength = pOptions[1] * 8;
+		if (   nOptionLength == 0
+		    || nOptionLength > nLength)
+		{
+			break;
+		}
+
+		if (pOptions[0] == nType)
+		{
+			return ((const TNDPLinkLayerOption *) pOptions)->MACAddress;
+		}
+
+		pOptions += nOptionLength;
+		nLength -= nOptionLength;
+	}
+
+	return 0;
+}
+
+boolean CIPv6Layer::SendICMPv6 (const CIPv6Address &rSource, const CIPv6Address &rDestination,
+				const void *pMessage, unsigned nLength, unsigned nHopLimit)
+{
+	assert (pMessage != 0);
+	assert (nLength >= sizeof (TICMPv6Header));
+
+	CNetBuffer *pPacket = CNetBuffer::Alloc (pMessage, nLength);
+	assert (pPacket != 0);
+
+	TICMPv6Header *pICMPv6Header = (TICMPv6Header *) pPacket->GetData ();
+	pICMPv6Header->nChecksum = 0;
+	pICMPv6Header->nChecksum = CalculateChecksum (rSource, rDestination,
+						      pICMPv6Header, nLength, IPPROTO_ICMPV6);
+
+	TIPv6Header *pHeader = (TIPv6Header *) pPacket->Prepend (sizeof (TIPv6Header));
+	assert (pHeader != 0);
+
+	pHeader->nVersionClassFlow = le2be32 (IPV6_VERSION_6 << 28);
+	pHeader->nPayloadLength = le2be16 (nLength);
+	pHeader->nNextHeader = IPPROTO_ICMPV6;
+	pHeader->nHopLimit = (u8) nHopLimit;
+	rSource.CopyTo (pHeader->SourceAddress);
+	rDestination.CopyTo (pHeader->DestinationAddress);
+
+	const CIPv6Address *pNextHop = &rDestination;
+	if (   !rDestination.IsMulticast ()
+	    && !IsOnLink (rDestination))
+	{
+		if (!m_bRouterValid)
+		{
+			pPacket->Release ();
+
+			return FALSE;
+		}
+
+		pNextHop = &m_DefaultRouter;
+	}
+
+	return SendPacket (*pNextHop, pPacket);
+}
+
+void CIPv6Layer::SendNeighborSolicitation (const CIPv6Address &rTarget, boolean bDAD)
+{
+	TNDPNeighborMessage NS;
+	NS.Header.nType = ICMPV6_TYPE_NEIGHBOR_SOLICITATION;
+	NS.Header.nCode = 0;
+	NS.nFlags = 0;
+	rTarget.CopyTo (NS.TargetAddress);
+
+	CIPv6Address Source;		// unspecified address for DAD
+	unsigned nLength = NDP_NEIGHBOR_MESSAGE_MIN;
+	if (!bDAD)
+	{
+		const CIPv6Address *pSource = SelectSource (rTarget);
+		if (pSource == 0)
+		{
+			return;
+		}
+		Source = *pSource;
+
+		NS.LinkAddress.nType = NDP_OPTION_SOURCE_LINK_ADDRESS;
+		NS.LinkAddress.nLength = 1;
+		m_OwnMACAddress.CopyTo (NS.LinkAddress.MACAddress);
+		nLength = sizeof NS;
+	}
+
+	CIPv6Address Destination;
+	Destination.SetSolicitedNode (rTarget);
+
+	SendICMPv6 (Source, Destination, &NS, nLength, IPV6_HOP_LIMIT_ND);
+}
+
+void CIPv6Layer::SendNeighborAdvertisement (const CIPv6Address &rDestination,
+					    const CIPv6Address &rTarget, boolean bSolicited)
+{
+	TNDPNeighborMessage NA;
+	NA.Header.nType = ICMPV6_TYPE_NEIGHBOR_ADVERTISEMENT;
+	NA.Header.nCode = 0;
+	NA.nFlags = le2be32 (NDP_NA_FLAG_OVERRIDE | (bSolicited ? NDP_NA_FLAG_SOLICITED : 0));
+	rTarget.CopyTo (NA.TargetAddress);
+
+	NA.LinkAddress.nType = NDP_OPTION_TARGET_LINK_ADDRESS;
+	NA.LinkAddress.nLength = 1;
+	m_OwnMACAddress.CopyTo (NA.LinkAddress.MACAddress);
+
+	SendICMPv6 (rTarget, rDestination, &NA, sizeof NA, IPV6_HOP_LIMIT_ND);
+}
+
+void CIPv6Layer::SendRouterSolicitation (void)
+{
+	TNDPRouterSolicitation RS;
+	RS.Header.nType = ICMPV6_TYPE_ROUTER_SOLICITATION;
+	RS.Header.nCode = 0;
+	RS.nReserved = 0;
+	RS.SourceLinkAddress.nType = NDP_OPTION_SOURCE_LINK_ADDRESS;
+	RS.SourceLinkAddress.nLength = 1;
+	m_OwnMACAddress.CopyTo (RS.SourceLinkAddress.MACAddress);
+
+	CIPv6Address AllRouters;
+	AllRouters.SetAllRouters ();
+
+	SendICMPv6 (m_LinkLocalAddress, AllRouters, &RS, sizeof RS, IPV6_HOP_LIMIT_ND);
+}
+
+boolean CIPv6Layer::SendPacket (const CIPv6Address &rNextHop, CNetBuffer *pPacket)
+{
+	assert (pPacket != 0);
+	assert (m_pLinkLayer != 0);
+
+	if (rNextHop.IsMulticast ())
+	{
+		CMACAddress Receiver;
+		Receiver.SetMulticastIPv6 (rNextHop.Get ());
+
+		return m_pLinkLayer->SendIPv6 (Receiver, pPacket);
+	}
+
+	TIPv6Neighbor *pEntry = LookupNeighbor (rNextHop);
+	if (   pEntry != 0
+	    && pEntry->nState == IPV6_NEIGHBOR_REACHABLE)
+	{
+		return m_pLinkLayer->SendIPv6 (pEntry->MACAddress, pPacket);
+	}
+
+	if (pEntry == 0)
+	{
+		pEntry = AllocNeighbor (rNextHop);
+		assert (pEntry != 0);
+
+		pEntry->nState = IPV6_NEIGHBOR_INCOMPLETE;
+		pEntry->nTicks = CTimer::Get ()->GetTicks ();
+		pEntry->nRetries = 0;
+
+		SendNeighborSolicitation (rNextHop, FALSE);
+	}
+
+	// only the last packet is kept until the address has been resolved (RFC 4861 7.2.2)
+	if (pEntry->pPendingPacket != 0)
+	{
+		pEntry->pPendingPacket->Release ();
+	}
+	pEntry->pPendingPacket = pPacket;
+
+	return TRUE;
+}
+
+const CIPv6Address *CIPv6Layer::SelectSource (const CIPv6Address &rDestination) const
+{
+	if (!IsRunning ())
+	{
+		return 0;
+	}
+
+	if (   m_bGlobalValid
+	    && !rDestination.IsLinkLocal ()
+	    && !(   rDestination.IsMulticast ()
+		 && (rDestination.Get ()[1] & 0x0F) == 2))	// not link-local scope
+	{
+		return &m_GlobalAddress;
+	}
+
+	return &m_LinkLocalAddress;
+}
+
+boolean CIPv6Layer::IsOwnAddress (const CIPv6Address &rAddress) const
+{
+	if (   m_State != StateWaitForMAC
+	    && rAddress == m_LinkLocalAddress)
+	{
+		return TRUE;
+	}
+
+	return    m_bGlobalValid
+	       && rAddress == m_GlobalAddress;
+}
+
+boolean CIPv6Layer::IsOnLink (const CIPv6Address &rAddress) const
+{
+	if (rAddress.IsLinkLocal ())
+	{
+		return TRUE;
+	}
+
+	return    m_bGlobalValid
+	       && rAddress.OnPrefix (m_Prefix, m_nPrefixLength);
+}
+
+TIPv6Neighbor *CIPv6Layer::LookupNeighbor (const CIPv6Address &rAddress)
+{
+	for (unsigned i = 0; i < IPV6_NEIGHBOR_CACHE_SIZE; i++)
+	{
+		if (   m_Neighbor[i].nState != IPV6_NEIGHBOR_FREE
+		    && m_Neighbor[i].IPAddress == rAddress)
+		{
+			return &m_Neighbor[i];
+		}
+	}
+
+	return 0;
+}
+
+TIPv6Neighbor *CIPv6Layer::AllocNeighbor (const CIPv6Address &rAddress)
+{
+	TIPv6Neighbor *pOldest = &m_Neighbor[0];
+	unsigned nTicks = CTimer::Get ()->GetTicks ();
+
+	for (unsigned i = 0; i < IPV6_NEIGHBOR_CACHE_SIZE; i++)
+	{
+		TIPv6Neighbor *pEntry = &m_Neighbor[i];
+		if (pEntry->nState == IPV6_NEIGHBOR_FREE)
+		{
+			pOldest = pEntry;
+
+			break;
+		}
+
+		if (nTicks - pEntry->nTicks > nTicks - pOldest->nTicks)
+		{
+			pOldest = pEntry;
+		}
+	}
+
+	FreeNeighbor (pOldest);
+
+	pOldest->IPAddress = rAddress;
+
+	return pOldest;
+}
+
+void CIPv6Layer::UpdateNeighbor (const CIPv6Address &rAddress, const u8 *pMACAddress,
+				 boolean bCreate)
+{
+	assert (pMACAddress != 0);
+
+	TIPv6Neighbor *pEntry = LookupNeighbor (rAddress);
+	if (pEntry == 0)
+	{
+		if (!bCreate)
+		{
+			return;
+		}
+
+		pEntry = AllocNeighbor (rAddress);
+		assert (pEntry != 0);
+	}
+
+	pEntry->MACAddress.Set (pMACAddress);
+	pEntry->nState = IPV6_NEIGHBOR_REACHABLE;
+	pEntry->nTicks = CTimer::Get ()->GetTicks ();
+
+	if (pEntry->pPendingPacket != 0)
+	{
+		CNetBuffer *pPacket = pEntry->pPendingPacket;
+		pEntry->pPendingPacket = 0;
+
+		assert (m_pLinkLayer != 0);
+		m_pLinkLayer->SendIPv6 (pEntry->MACAddress, pPacket);
+	}
+}
+
+void CIPv6Layer::FreeNeighbor (TIPv6Neighbor *pEntry)
+{
+	assert (pEntry != 0);
+
+	if (pEntry->pPendingPacket != 0)
+	{
+		pEntry->pPendingPacket->Release ();
+		pEntry->pPendingPacket = 0;
+	}
+
+	pEntry->nState = IPV6_NEIGHBOR_FREE;
+}
+
+void CIPv6Layer::JoinSolicitedNodeGroup (const CIPv6Address &rAddress, boolean bJoin)
+{
+	CIPv6Address SolicitedNode;
+	SolicitedNode.SetSolicitedNode (rAddress);
+
+	CMACAddress Group;
+	Group.SetMulticastIPv6 (SolicitedNode.Get ());
+
+	assert (m_pLinkLayer != 0);
+	if (bJoin)
+	{
+		m_pLinkLayer->JoinLocalGroup (Group);
+	}
+	else
+	{
+		m_pLinkLayer->LeaveLocalGroup (Group);
+	}
+}
+
+u16 CIPv6Layer::CalculateChecksum (const CIPv6Address &rSource, const CIPv6Address &rDestination,
+				   const void *pMessage, unsigned nLength, int nNextHeader)
+{
+	assert (pMessage != 0);
+	assert (nLength > 0);
+
+	TIPv6PseudoHeader PseudoHeader;
+	rSource.CopyTo (PseudoHeader.SourceAddress);
+	rDestination.CopyTo (PseudoHeader.DestinationAddress);
+	PseudoHeader.nLength = le2be32 (nLength);
+	memset (PseudoHeader.Zero, 0, sizeof PseudoHeader.Zero);
+	PseudoHeader.nNextHeader = (u8) nNextHeader;
+
+	// the one's complement sums of both parts can be added, because the pseudo header
+	// has an even length
+	u32 nSum =   (u16) ~CChecksumCalculator::SimpleCalculate (&PseudoHeader, sizeof PseudoHeader)
+		   + (u16) ~CChecksumCalculator::SimpleCalculate (pMessage, nLength);
+	nSum = (nSum & 0xFFFF) + (nSum >> 16);
+
+	return (u16) ~nSum;
+}
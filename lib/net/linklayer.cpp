@@ -19,6 +19,8 @@
 //
 #include <circle/net/linklayer.h>
 #include <circle/net/networklayer.h>
+#include <circle/net/rawframering.h>
+#include <circle/net/checksumcalculator.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -32,6 +34,11 @@ CLinkLayer::CLinkLayer (CNetConfig *pNetConfig, CNetDeviceLayer *pNetDevLayer)
 	m_pNetDevLayer (pNetDevLayer),
 	m_pNetworkLayer (0),
 	m_pARPHandler (0),
+	m_ARPRxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_IPRxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_bIPv6Enabled (FALSE),
+	m_IPv6RxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_RawRxQueue (NET_QUEUE_HIGH_WATER_MARK),
 	m_nRawProtocolType (0)
 {
 	assert (m_pNetConfig != 0);
@@ -41,6 +48,11 @@ CLinkLayer::CLinkLayer (CNetConfig *pNetConfig, CNetDeviceLayer *pNetDevLayer)
 	{
 		m_nMulticastUseCounter[i] = 0;
 	}
+
+	for (unsigned i = 0; i < MAX_RAW_FRAME_RINGS; i++)
+	{
+		m_pRawRing[i] = 0;
+	}
 }
 
 CLinkLayer::~CLinkLayer (void)
@@ -79,95 +91,175 @@ void CLinkLayer::Process (void)
 	}
 
 	assert (m_pNetDevLayer != 0);
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	unsigned nLength;
-	while (m_pNetDevLayer->Receive (Buffer, &nLength))
+	CNetBuffer *pFrame;
+	while ((pFrame = m_pNetDevLayer->Receive ()) != 0)
 	{
-		assert (nLength <= FRAME_BUFFER_SIZE);
-		if (nLength <= sizeof (TEthernetHeader))
+		if (!ProcessFrame (pFrame, pOwnMACAddress))
 		{
-			continue;
+			pFrame->Release ();
 		}
-		TEthernetHeader *pHeader = (TEthernetHeader *) Buffer;
+	}
 
-		CMACAddress MACAddressReceiver (pHeader->MACReceiver);
-		if (    MACAddressReceiver != *pOwnMACAddress
-		    && !MACAddressReceiver.IsBroadcast ())
+	assert (m_pARPHandler != 0);
+	m_pARPHandler->Process ();
+
+	// send the frames, the users of the rings have not flushed themselves
+	for (unsigned i = 0; i < MAX_RAW_FRAME_RINGS; i++)
+	{
+		if (m_pRawRing[i] != 0)
 		{
-			if (!MACAddressReceiver.IsMulticast ())
-			{
-				continue;
-			}
+			m_pRawRing[i]->Flush ();
+		}
+	}
+}
 
-			unsigned i;
-			for (i = 0; i < MaxGroups; i++)
-			{
-				if (   m_nMulticastUseCounter[i] > 0
-				    && m_MulticastGroup[i] == MACAddressReceiver)
-				{
-					break;
-				}
-			}
+boolean CLinkLayer::ProcessFrame (CNetBuffer *pFrame, const CMACAddress *pOwnMACAddress)
+{
+	assert (pFrame != 0);
+	assert (pFrame->GetNextSegment () == 0);
+	unsigned nLength = pFrame->GetLength ();
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	if (nLength <= sizeof (TEthernetHeader))
+	{
+		return FALSE;
+	}
+	TEthernetHeader *pHeader = (TEthernetHeader *) pFrame->GetData ();
+
+	CMACAddress MACAddressReceiver (pHeader->MACReceiver);
+	if (    MACAddressReceiver != *pOwnMACAddress
+	    && !MACAddressReceiver.IsBroadcast ())
+	{
+		if (!MACAddressReceiver.IsMulticast ())
+		{
+			return FALSE;
+		}
 
-			if (i == MaxGroups)
+		unsigned i;
+		for (i = 0; i < MaxGroups; i++)
+		{
+			if (   m_nMulticastUseCounter[i] > 0
+			    && m_MulticastGroup[i] == MACAddressReceiver)
 			{
-				continue;
+				break;
 			}
 		}
 
-		nLength -= sizeof (TEthernetHeader);
-		assert (nLength > 0);
-		
-		switch (pHeader->nProtocolType)
+		if (i == MaxGroups)
 		{
-		case BE (ETH_PROT_IP):
-			m_IPRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader), nLength);
-			break;
+			return FALSE;
+		}
+	}
 
-		case BE (ETH_PROT_ARP):
-			m_ARPRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader), nLength);
-			break;
+	// the header remains valid in the headroom
+	pFrame->RemoveHeader (sizeof (TEthernetHeader));
+	assert (pFrame->GetLength () > 0);
+
+	switch (pHeader->nProtocolType)
+	{
+	case BE (ETH_PROT_IP):
+		m_IPRxQueue.Enqueue (pFrame);
+		break;
+
+	case BE (ETH_PROT_ARP):
+		m_ARPRxQueue.Enqueue (pFrame);
+		break;
+
+	case BE (ETH_PROT_IPV6):
+		if (!m_bIPv6Enabled)
+		{
+			return FALSE;
+		}
+		m_IPv6RxQueue.Enqueue (pFrame);
+		break;
 
-		default:
-			if (pHeader->nProtocolType == m_nRawProtocolType)
+	default:
+		for (unsigned i = 0; i < MAX_RAW_FRAME_RINGS; i++)
+		{
+			if (   m_pRawRing[i] != 0
+			    && m_pRawRing[i]->GetEtherType () == pHeader->nProtocolType)
 			{
-				TRawPrivateData *pParam = new TRawPrivateData;
-				assert (pParam != 0);
-				memcpy (pParam->MACSender, pHeader->MACSender, MAC_ADDRESS_SIZE);
+				// copied into the ring, so the frame can be released
+				m_pRawRing[i]->FrameReceived (pHeader, sizeof (TEthernetHeader)
+									+ pFrame->GetLength ());
+				return FALSE;
+			}
+		}
+
+		if (pHeader->nProtocolType == m_nRawProtocolType)
+		{
+			TRawPrivateData *pParam = new TRawPrivateData;
+			assert (pParam != 0);
+			memcpy (pParam->MACSender, pHeader->MACSender, MAC_ADDRESS_SIZE);
 
-				m_RawRxQueue.Enqueue (Buffer+sizeof (TEthernetHeader),
-						      nLength, pParam);
+			if (!m_RawRxQueue.Enqueue (pFrame, pParam))
+			{
+				delete pParam;
 			}
 			break;
 		}
+		return FALSE;
 	}
 
-	assert (m_pARPHandler != 0);
-	m_pARPHandler->Process ();
+	return TRUE;
 }
 
 boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, unsigned nLength)
 {
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		return FALSE;
+	}
+
+	assert (pIPPacket != 0);
+	return Send (rReceiver, CNetBuffer::Alloc (pIPPacket, nLength,
+						   NET_BUFFER_HEADROOM + sizeof (TEthernetHeader)));
+}
+
+boolean CLinkLayer::Send (const CIPAddress &rReceiver, CNetBuffer *pIPPacket)
+{
+	assert (pIPPacket != 0);
+	unsigned nLength = pIPPacket->GetTotalLength ();
+
 	unsigned nFrameLength = sizeof (TEthernetHeader) + nLength;	// may wrap
 	if (   nFrameLength <= sizeof (TEthernetHeader)
 	    || nFrameLength > FRAME_BUFFER_SIZE)
 	{
+		pIPPacket->Release ();
+
 		return FALSE;
 	}
 
-	assert (pIPPacket != 0);
-	assert (nLength > 0);
 	assert (m_pNetConfig != 0);
 	if (   !rReceiver.IsNull ()
 	    && rReceiver == *m_pNetConfig->GetIPAddress ())
 	{
-		m_IPRxQueue.Enqueue (pIPPacket, nLength);	// loop back to own address
+		// a requested checksum is not needed, because the packet never leaves the host
+		boolean bChecksumPartial = pIPPacket->IsChecksumPartial ();
+
+		if (pIPPacket->GetNextSegment () != 0)	// the receive path expects one segment
+		{
+			CNetBuffer *pPacket = CNetBuffer::Alloc ();
+			assert (pPacket != 0);
+			pIPPacket->CopyTo (pPacket->Append (nLength));
+
+			pIPPacket->Release ();
+			pIPPacket = pPacket;
+		}
+
+		if (bChecksumPartial)
+		{
+			pIPPacket->ClearChecksumPartial ();
+			pIPPacket->SetChecksumValid ();
+		}
+
+		m_IPRxQueue.Enqueue (pIPPacket);	// loop back to own address
 
 		return TRUE;
 	}
 
-	u8 FrameBuffer[nFrameLength];
-	TEthernetHeader *pHeader = (TEthernetHeader *) FrameBuffer;
+	TEthernetHeader *pHeader = (TEthernetHeader *) pIPPacket->Prepend (sizeof (TEthernetHeader));
+	CNetBuffer *pFrame = pIPPacket;
 
 	assert (m_pNetDevLayer != 0);
 	const CMACAddress *pOwnMACAddress = m_pNetDevLayer->GetMACAddress ();
@@ -176,8 +268,6 @@ boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, un
 
 	pHeader->nProtocolType = BE (ETH_PROT_IP);
 
-	memcpy (FrameBuffer+sizeof (TEthernetHeader), pIPPacket, nLength);
-
 	assert (m_pARPHandler != 0);
 	CMACAddress MACAddressReceiver;
 	if (   rReceiver.IsBroadcast ()
@@ -189,19 +279,100 @@ boolean CLinkLayer::Send (const CIPAddress &rReceiver, const void *pIPPacket, un
 	{
 		MACAddressReceiver.SetMulticast (rReceiver.Get ());
 	}
-	else if (!m_pARPHandler->Resolve (rReceiver, &MACAddressReceiver,
-					  FrameBuffer, nFrameLength))
+	else
 	{
-		return TRUE;		// packet will be retransmitted by ARP handler
+		if (   pFrame->IsChecksumPartial ()
+		    && !m_pARPHandler->IsResolved (rReceiver))
+		{
+			// the ARP handler queues a copy of the frame, which loses the request
+			CChecksumCalculator::CompletePartial (pFrame);
+		}
+
+		boolean bResolved;
+		if (pFrame->GetNextSegment () == 0)
+		{
+			bResolved = m_pARPHandler->Resolve (rReceiver, &MACAddressReceiver,
+							    pFrame->GetData (), nFrameLength);
+		}
+		else
+		{
+			u8 FrameBuffer[nFrameLength];
+			pFrame->CopyTo (FrameBuffer);
+
+			bResolved = m_pARPHandler->Resolve (rReceiver, &MACAddressReceiver,
+							    FrameBuffer, nFrameLength);
+		}
+
+		if (!bResolved)
+		{
+			pFrame->Release ();
+
+			return TRUE;		// packet will be retransmitted by ARP handler
+		}
 	}
 
 	MACAddressReceiver.CopyTo (pHeader->MACReceiver);
 
-	m_pNetDevLayer->Send (FrameBuffer, nFrameLength);
+	m_pNetDevLayer->Send (pFrame);
 
 	return TRUE;
 }
 
+boolean CLinkLayer::SetupFlowHeader (const CIPAddress &rNextHop, TEthernetHeader *pHeader,
+				     unsigned *pNeighbor)
+{
+	assert (pHeader != 0);
+	assert (pNeighbor != 0);
+
+	CMACAddress MACAddressReceiver;
+	if (rNextHop.IsMulticast ())
+	{
+		MACAddressReceiver.SetMulticast (rNextHop.Get ());
+
+		*pNeighbor = ARP_NO_ENTRY;
+	}
+	else
+	{
+		assert (m_pARPHandler != 0);
+		if (!m_pARPHandler->Lookup (rNextHop, &MACAddressReceiver, pNeighbor))
+		{
+			return FALSE;
+		}
+	}
+
+	assert (m_pNetDevLayer != 0);
+	const CMACAddress *pOwnMACAddress = m_pNetDevLayer->GetMACAddress ();
+	if (pOwnMACAddress == 0)
+	{
+		return FALSE;
+	}
+
+	MACAddressReceiver.CopyTo (pHeader->MACReceiver);
+	pOwnMACAddress->CopyTo (pHeader->MACSender);
+	pHeader->nProtocolType = BE (ETH_PROT_IP);
+
+	return TRUE;
+}
+
+unsigned CLinkLayer::GetNeighborGeneration (void) const
+{
+	assert (m_pARPHandler != 0);
+	return m_pARPHandler->GetGeneration ();
+}
+
+void CLinkLayer::SendFlowFrame (CNetBuffer *pFrame, unsigned nNeighbor)
+{
+	if (nNeighbor != ARP_NO_ENTRY)
+	{
+		assert (m_pARPHandler != 0);
+		m_pARPHandler->Touch (nNeighbor);
+	}
+
+	assert (pFrame != 0);
+	assert (m_pNetDevLayer != 0);
+	m_pNetDevLayer->Send (pFrame);
+}
+
 boolean CLinkLayer::Receive (void *pBuffer, unsigned *pResultLength)
 {
 	assert (pBuffer != 0);
@@ -211,6 +382,11 @@ boolean CLinkLayer::Receive (void *pBuffer, unsigned *pResultLength)
 	return *pResultLength != 0 ? TRUE : FALSE;
 }
 
+CNetBuffer *CLinkLayer::Receive (void)
+{
+	return m_IPRxQueue.DequeueBuffer ();
+}
+
 boolean CLinkLayer::SendRaw (const void *pFrame, unsigned nLength)
 {
 	assert (pFrame != 0);
@@ -258,17 +434,87 @@ boolean CLinkLayer::EnableReceiveRaw (u16 nProtocolType)
 	return TRUE;
 }
 
+boolean CLinkLayer::AttachRawRing (CRawFrameRing *pRing)
+{
+	assert (pRing != 0);
+	u16 nEtherType = pRing->GetEtherType ();
+	if (   nEtherType == BE (ETH_PROT_IP)
+	    || nEtherType == BE (ETH_PROT_ARP)
+	    || nEtherType == BE (ETH_PROT_IPV6)
+	    || nEtherType == m_nRawProtocolType)
+	{
+		return FALSE;
+	}
+
+	int nFree = -1;
+	for (unsigned i = 0; i < MAX_RAW_FRAME_RINGS; i++)
+	{
+		if (m_pRawRing[i] == 0)
+		{
+			if (nFree < 0)
+			{
+				nFree = i;
+			}
+		}
+		else if (m_pRawRing[i]->GetEtherType () == nEtherType)
+		{
+			return FALSE;
+		}
+	}
+
+	if (nFree < 0)
+	{
+		return FALSE;
+	}
+
+	m_pRawRing[nFree] = pRing;
+
+	return TRUE;
+}
+
+void CLinkLayer::DetachRawRing (CRawFrameRing *pRing)
+{
+	for (unsigned i = 0; i < MAX_RAW_FRAME_RINGS; i++)
+	{
+		if (m_pRawRing[i] == pRing)
+		{
+			m_pRawRing[i] = 0;
+		}
+	}
+}
+
 boolean CLinkLayer::IsRunning (void) const
 {
 	assert (m_pNetDevLayer != 0);
 	return m_pNetDevLayer->IsRunning ();
 }
 
+unsigned CLinkLayer::GetCapabilities (void) const
+{
+	assert (m_pNetDevLayer != 0);
+	return m_pNetDevLayer->GetCapabilities ();
+}
+
 boolean CLinkLayer::JoinLocalGroup (const CIPAddress &rGroupAddress)
 {
 	CMACAddress Group;
 	Group.SetMulticast (rGroupAddress.Get ());
 
+	return JoinLocalGroup (Group);
+}
+
+boolean CLinkLayer::LeaveLocalGroup (const CIPAddress &rGroupAddress)
+{
+	CMACAddress Group;
+	Group.SetMulticast (rGroupAddress.Get ());
+
+	return LeaveLocalGroup (Group);
+}
+
+boolean CLinkLayer::JoinLocalGroup (const CMACAddress &rGroup)
+{
+	const CMACAddress &Group = rGroup;
+
 	unsigned j = MaxGroups;
 	for (unsigned i = 0; i < MaxGroups; i++)
 	{
@@ -301,10 +547,9 @@ boolean CLinkLayer::JoinLocalGroup (const CIPAddress &rGroupAddress)
 	return UpdateMulticastFilter ();
 }
 
-boolean CLinkLayer::LeaveLocalGroup (const CIPAddress &rGroupAddress)
+boolean CLinkLayer::LeaveLocalGroup (const CMACAddress &rGroup)
 {
-	CMACAddress Group;
-	Group.SetMulticast (rGroupAddress.Get ());
+	const CMACAddress &Group = rGroup;
 
 	for (unsigned i = 0; i < MaxGroups; i++)
 	{
@@ -323,16 +568,58 @@ boolean CLinkLayer::LeaveLocalGroup (const CIPAddress &rGroupAddress)
 	return FALSE;
 }
 
+void CLinkLayer::EnableIPv6 (void)
+{
+	m_bIPv6Enabled = TRUE;
+}
+
+boolean CLinkLayer::SendIPv6 (const CMACAddress &rReceiver, CNetBuffer *pIPv6Packet)
+{
+	assert (pIPv6Packet != 0);
+	unsigned nLength = pIPv6Packet->GetTotalLength ();
+
+	unsigned nFrameLength = sizeof (TEthernetHeader) + nLength;	// may wrap
+	if (   nFrameLength <= sizeof (TEthernetHeader)
+	    || nFrameLength > FRAME_BUFFER_SIZE)
+	{
+		pIPv6Packet->Release ();
+
+		return FALSE;
+	}
+
+	TEthernetHeader *pHeader = (TEthernetHeader *) pIPv6Packet->Prepend (sizeof (TEthernetHeader));
+
+	assert (m_pNetDevLayer != 0);
+	const CMACAddress *pOwnMACAddress = m_pNetDevLayer->GetMACAddress ();
+	assert (pOwnMACAddress != 0);
+	pOwnMACAddress->CopyTo (pHeader->MACSender);
+
+	rReceiver.CopyTo (pHeader->MACReceiver);
+
+	pHeader->nProtocolType = BE (ETH_PROT_IPV6);
+
+	m_pNetDevLayer->Send (pIPv6Packet);
+
+	return TRUE;
+}
+
+CNetBuffer *CLinkLayer::ReceiveIPv6 (void)
+{
+	return m_IPv6RxQueue.DequeueBuffer ();
+}
+
 boolean CLinkLayer::UpdateMulticastFilter (void)
 {
 	u8 Groups[MaxGroups+1][MAC_ADDRESS_SIZE];
 	memset (Groups, 0, sizeof Groups);
 
+	// the list is terminated by a zero entry, so it must not have gaps
+	unsigned nGroups = 0;
 	for (unsigned i = 0; i < MaxGroups; i++)
 	{
 		if (m_nMulticastUseCounter[i] > 0)
 		{
-			m_MulticastGroup[i].CopyTo (Groups[i]);
+			m_MulticastGroup[i].CopyTo (Groups[nGroups++]);
 		}
 	}
 
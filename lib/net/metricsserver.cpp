@@ -0,0 +1,67 @@
+//
+// metricsserver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/metricsserver.h>
+#include <circle/metrics.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CMetricsServer::CMetricsServer (CNetSubSystem *pNetSubSystem, u16 nPort, CSocket *pSocket)
+:	CHTTPDaemon (pNetSubSystem, pSocket, METRICS_MAX_CONTENT, nPort),
+	m_nPort (nPort)
+{
+}
+
+CMetricsServer::~CMetricsServer (void)
+{
+}
+
+CHTTPDaemon *CMetricsServer::CreateWorker (CNetSubSystem *pNetSubSystem, CSocket *pSocket)
+{
+	return new CMetricsServer (pNetSubSystem, m_nPort, pSocket);
+}
+
+THTTPStatus CMetricsServer::GetContent (const char  *pPath,
+					const char  *pParams,
+					const char  *pFormData,
+					u8	    *pBuffer,
+					unsigned    *pLength,
+					const char **ppContentType)
+{
+	assert (pPath != 0);
+	if (strcmp (pPath, "/metrics") != 0)
+	{
+		return HTTPNotFound;
+	}
+
+	assert (pBuffer != 0);
+	assert (pLength != 0);
+	*pLength = CMetric::ExportAll ((char *) pBuffer, *pLength);
+
+	assert (ppContentType != 0);
+	*ppContentType = CMetric::GetContentType ();
+
+	return HTTPOK;
+}
+
+void CMetricsServer::WriteAccessLog (const CIPAddress &rRemoteIP, THTTPRequestMethod RequestMethod,
+				     const char *pRequestURI, THTTPStatus Status,
+				     unsigned nContentLength)
+{
+}
@@ -24,6 +24,7 @@
 #include <circle/sched/scheduler.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/logger.h>
+#include <circle/util.h>
 #include <assert.h>
 
 const char *CMQTTClient::s_pErrorMsg[MQTTDisconnectUnknown+1] =
@@ -50,18 +51,36 @@ const char *CMQTTClient::s_pErrorMsg[MQTTDisconnectUnknown+1] =
 static const char FromMQTTClient[] = "mqtt";
 
 CMQTTClient::CMQTTClient (CNetSubSystem *pNetSubSystem, size_t nMaxPacketSize,
-			  size_t nMaxPacketsQueued, size_t nMaxTopicSize)
+			  size_t nMaxPacketsQueued, size_t nMaxTopicSize, size_t nMaxInFlight)
 :	m_pNetSubSystem (pNetSubSystem),
 	m_nMaxPacketSize (nMaxPacketSize),
 	m_nMaxTopicSize (nMaxTopicSize),
 	m_pTimer (CTimer::Get ()),
 	m_pSocket (0),
 	m_ConnectStatus (MQTTStatusDisconnected),
-	m_ReceivePacket (nMaxPacketSize, nMaxPacketsQueued)
+	m_ReceivePacket (nMaxPacketSize, nMaxPacketsQueued),
+	m_nMaxInFlight (nMaxInFlight),
+	m_pFreePackets (0),
+	m_pRetransmissionFirst (0),
+	m_pRetransmissionLast (0),
+	m_nInFlight (0),
+	m_pPendingFirst (0),
+	m_pPendingLast (0),
+	m_nTxLength (0)
 {
 	SetName (FromMQTTClient);
 
 	m_pTopicBuffer = new char [m_nMaxTopicSize+1];
+
+	// packets in send window and in pending queue, and one for other packets
+	assert (m_nMaxInFlight > 0);
+	for (unsigned i = 0; i < 2*m_nMaxInFlight+1; i++)
+	{
+		CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTPublish, m_nMaxPacketSize);
+		assert (pPacket != 0);
+
+		FreePacket (pPacket);
+	}
 }
 
 CMQTTClient::~CMQTTClient (void)
@@ -72,6 +91,14 @@ CMQTTClient::~CMQTTClient (void)
 	CleanupQueue ();
 	CleanupPacketIdentifierStore ();
 
+	while (m_pFreePackets != 0)
+	{
+		CMQTTSendPacket *pPacket = m_pFreePackets;
+		m_pFreePackets = pPacket->GetNext ();
+
+		delete pPacket;
+	}
+
 	delete [] m_pTopicBuffer;
 	m_pTopicBuffer = 0;
 
@@ -136,6 +163,7 @@ void CMQTTClient::Connect (const char *pHost, u16 usPort, const char *pClientIde
 	m_bTimerRunning = FALSE;
 	m_usNextPacketIdentifier = 1;
 	m_ReceivePacket.Reset ();
+	m_nTxLength = 0;
 	m_ConnectStatus = MQTTStatusConnectPending;
 
 	CString ClientIdentifier;
@@ -191,37 +219,42 @@ void CMQTTClient::Connect (const char *pHost, u16 usPort, const char *pClientIde
 		}
 	}
 
-	CMQTTSendPacket Packet (MQTTConnect, m_nMaxPacketSize);
-	Packet.AppendString ("MQTT");
-	Packet.AppendByte (MQTT_PROTOCOL_LEVEL);
-	Packet.AppendByte (uchConnectFlags);
-	Packet.AppendWord (usKeepAliveSeconds);
-	Packet.AppendString (ClientIdentifier);
+	CMQTTSendPacket *pPacket = AllocatePacket (MQTTConnect);
+	assert (pPacket != 0);			// all packets are free after disconnect
+	pPacket->AppendString ("MQTT");
+	pPacket->AppendByte (MQTT_PROTOCOL_LEVEL);
+	pPacket->AppendByte (uchConnectFlags);
+	pPacket->AppendWord (usKeepAliveSeconds);
+	pPacket->AppendString (ClientIdentifier);
 
 	if (pWillTopic != 0)
 	{
-		Packet.AppendString (pWillTopic);
+		pPacket->AppendString (pWillTopic);
 
 		assert (nWillPayloadLength < 0x10000);
-		Packet.AppendWord (nWillPayloadLength);
+		pPacket->AppendWord (nWillPayloadLength);
 		if (nWillPayloadLength > 0)
 		{
 			assert (pWillPayload != 0);
-			Packet.AppendData (pWillPayload, nWillPayloadLength);
+			pPacket->AppendData (pWillPayload, nWillPayloadLength);
 		}
 	}
 
 	if (pUsername != 0)
 	{
-		Packet.AppendString (pUsername);
+		pPacket->AppendString (pUsername);
 
 		if (pPassword != 0)
 		{
-			Packet.AppendString (pPassword);
+			pPacket->AppendString (pPassword);
 		}
 	}
 
-	if (!SendPacket (&Packet))
+	boolean bOK = SendPacket (pPacket) && FlushTxBuffer ();
+
+	FreePacket (pPacket);
+
+	if (!bOK)
 	{
 		CloseConnection (MQTTDisconnectSendFailed);
 
@@ -235,7 +268,10 @@ void CMQTTClient::Disconnect (boolean bForce)
 	{
 		CMQTTSendPacket Packet (MQTTDisconnect);
 
-		SendPacket (&Packet);
+		if (SendPacket (&Packet))
+		{
+			FlushTxBuffer ();
+		}
 	}
 
 	CloseConnection (MQTTDisconnectFromApplication);
@@ -246,67 +282,57 @@ void CMQTTClient::Subscribe (const char *pTopic, u8 uchQoS)
 	assert (pTopic != 0);
 	assert (uchQoS <= MQTT_QOS_EXACTLY_ONCE);
 
-	u16 usPacketIdentifier = m_usNextPacketIdentifier;
-	if (++m_usNextPacketIdentifier == 0)
+	CMQTTSendPacket *pPacket = AllocatePacket (MQTTSubscribe);
+	if (pPacket == 0)
 	{
-		m_usNextPacketIdentifier++;
+		CloseConnection (MQTTDisconnectInsufficientResources);
+
+		return;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTSubscribe, m_nMaxPacketSize);
-	assert (pPacket != 0);
+	u16 usPacketIdentifier = GetPacketIdentifier ();
 
 	pPacket->AppendWord (usPacketIdentifier);
 	pPacket->AppendString (pTopic);
 	pPacket->AppendByte (uchQoS);
 
-	if (!SendPacket (pPacket))
-	{
-		delete pPacket;
-
-		CloseConnection (MQTTDisconnectSendFailed);
-
-		return;
-	}
-
 	pPacket->SetQoS (MQTT_QOS_AT_LEAST_ONCE);
 	pPacket->SetPacketIdentifier (usPacketIdentifier);
 
-	InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
+	if (!QueuePacket (pPacket))
+	{
+		CloseConnection (MQTTDisconnectSendFailed);
+	}
 }
 
 void CMQTTClient::Unsubscribe (const char *pTopic)
 {
 	assert (pTopic != 0);
 
-	u16 usPacketIdentifier = m_usNextPacketIdentifier;
-	if (++m_usNextPacketIdentifier == 0)
+	CMQTTSendPacket *pPacket = AllocatePacket (MQTTUnsubscribe);
+	if (pPacket == 0)
 	{
-		m_usNextPacketIdentifier++;
+		CloseConnection (MQTTDisconnectInsufficientResources);
+
+		return;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTUnsubscribe, m_nMaxPacketSize);
-	assert (pPacket != 0);
+	u16 usPacketIdentifier = GetPacketIdentifier ();
 
 	pPacket->AppendWord (usPacketIdentifier);
 	pPacket->AppendString (pTopic);
 
-	if (!SendPacket (pPacket))
-	{
-		delete pPacket;
-
-		CloseConnection (MQTTDisconnectSendFailed);
-
-		return;
-	}
-
 	pPacket->SetQoS (MQTT_QOS_AT_LEAST_ONCE);
 	pPacket->SetPacketIdentifier (usPacketIdentifier);
 
-	InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
+	if (!QueuePacket (pPacket))
+	{
+		CloseConnection (MQTTDisconnectSendFailed);
+	}
 }
 
-void CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPayloadLength,
-			   u8 uchQoS, boolean bRetain)
+boolean CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPayloadLength,
+			      u8 uchQoS, boolean bRetain)
 {
 	assert (pTopic != 0);
 
@@ -317,32 +343,32 @@ void CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPaylo
 		uchFlags |= MQTT_FLAG_RETAIN;
 	}
 
-	u16 usPacketIdentifier = m_usNextPacketIdentifier;
-	if (++m_usNextPacketIdentifier == 0)
+	if (m_ConnectStatus == MQTTStatusDisconnected)
 	{
-		m_usNextPacketIdentifier++;
+		return FALSE;
 	}
 
-	CMQTTSendPacket *pPacket = new CMQTTSendPacket (MQTTPublish, m_nMaxPacketSize);
-	assert (pPacket != 0);
+	CMQTTSendPacket *pPacket = AllocatePacket (MQTTPublish);
+	if (pPacket == 0)
+	{
+		return FALSE;			// send window and pending queue are full
+	}
 
 	pPacket->SetFlags (uchFlags);
 	pPacket->AppendString (pTopic);
-	pPacket->AppendWord (usPacketIdentifier);
 
-	if (nPayloadLength > 0)
+	// the packet identifier is only present with QoS 1 and 2
+	u16 usPacketIdentifier = 0;
+	if (uchQoS >= MQTT_QOS_AT_LEAST_ONCE)
 	{
-		assert (pPayload != 0);
-		pPacket->AppendData (pPayload, nPayloadLength);
+		usPacketIdentifier = GetPacketIdentifier ();
+		pPacket->AppendWord (usPacketIdentifier);
 	}
 
-	if (!SendPacket (pPacket))
+	if (nPayloadLength > 0)
 	{
-		delete pPacket;
-
-		CloseConnection (MQTTDisconnectSendFailed);
-
-		return;
+		assert (pPayload != 0);
+		pPacket->AppendData (pPayload, nPayloadLength);
 	}
 
 	if (uchQoS >= MQTT_QOS_AT_LEAST_ONCE)
@@ -350,12 +376,26 @@ void CMQTTClient::Publish (const char *pTopic, const u8 *pPayload, size_t nPaylo
 		pPacket->SetQoS (uchQoS);
 		pPacket->SetPacketIdentifier (usPacketIdentifier);
 
-		InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
+		if (!QueuePacket (pPacket))
+		{
+			CloseConnection (MQTTDisconnectSendFailed);
+
+			return FALSE;
+		}
+
+		return TRUE;
 	}
-	else
+
+	boolean bOK = SendPacket (pPacket);
+
+	FreePacket (pPacket);
+
+	if (!bOK)
 	{
-		delete pPacket;
+		CloseConnection (MQTTDisconnectSendFailed);
 	}
+
+	return bOK;
 }
 
 void CMQTTClient::Run (void)
@@ -367,15 +407,18 @@ void CMQTTClient::Run (void)
 			Receiver ();
 			Sender ();
 			KeepAliveHandler ();
-
-			CScheduler::Get ()->MsSleep (50);
 		}
-		else
+
+		OnLoop ();
+
+		// send the packets, which have been collected in this loop
+		if (   m_ConnectStatus != MQTTStatusDisconnected
+		    && !FlushTxBuffer ())
 		{
-			CScheduler::Get ()->MsSleep (200);
+			CloseConnection (MQTTDisconnectSendFailed);
 		}
 
-		OnLoop ();
+		CScheduler::Get ()->MsSleep (m_ConnectStatus != MQTTStatusDisconnected ? 50 : 200);
 	}
 }
 
@@ -530,7 +573,10 @@ void CMQTTClient::Receiver (void)
 				CloseConnection (MQTTDisconnectPacketIdentifier);
 			}
 
-			delete pPacket;
+			if (pPacket != 0)
+			{
+				FreePacket (pPacket);
+			}
 			} break;
 
 		case MQTTPubRec: {
@@ -539,24 +585,26 @@ void CMQTTClient::Receiver (void)
 
 			CMQTTSendPacket *pPacket = RemovePacketFromQueue (usPacketIdentifier);
 			if (   pPacket == 0
-			    || pPacket->GetQoS () != MQTT_QOS_EXACTLY_ONCE)
+			    || pPacket->GetQoS () != MQTT_QOS_EXACTLY_ONCE
+			    || pPacket->GetType () != MQTTPublish)
 			{
-				delete pPacket;
+				if (pPacket != 0)
+				{
+					FreePacket (pPacket);
+				}
 
 				CloseConnection (MQTTDisconnectPacketIdentifier);
 
 				break;
 			}
 
-			delete pPacket;
-
-			pPacket = new CMQTTSendPacket (MQTTPubRel);
-			assert (pPacket != 0);
+			// the PUBREL continues the exchange in the same slot of the send window
+			pPacket->Reset (MQTTPubRel);
 			pPacket->AppendWord (usPacketIdentifier);
 
 			if (!SendPacket (pPacket))
 			{
-				delete pPacket;
+				FreePacket (pPacket);
 
 				CloseConnection (MQTTDisconnectSendFailed);
 
@@ -603,7 +651,10 @@ void CMQTTClient::Receiver (void)
 				CloseConnection (MQTTDisconnectPacketIdentifier);
 			}
 
-			delete pPacket;
+			if (pPacket != 0)
+			{
+				FreePacket (pPacket);
+			}
 			} break;
 
 		case MQTTSubAck: {
@@ -625,7 +676,10 @@ void CMQTTClient::Receiver (void)
 				CloseConnection (MQTTDisconnectPacketIdentifier);
 			}
 
-			delete pPacket;
+			if (pPacket != 0)
+			{
+				FreePacket (pPacket);
+			}
 			} break;
 
 		case MQTTUnsubAck: {
@@ -639,7 +693,10 @@ void CMQTTClient::Receiver (void)
 				CloseConnection (MQTTDisconnectPacketIdentifier);
 			}
 
-			delete pPacket;
+			if (pPacket != 0)
+			{
+				FreePacket (pPacket);
+			}
 			} break;
 
 		case MQTTPingResp:
@@ -663,13 +720,18 @@ void CMQTTClient::Receiver (void)
 
 void CMQTTClient::Sender (void)
 {
+	if (!SendPendingPackets ())
+	{
+		CloseConnection (MQTTDisconnectSendFailed);
+
+		return;
+	}
+
 	unsigned nTicks = m_pTimer->GetTicks ();
 
-	TPtrListElement *pElement = m_RetransmissionQueue.GetFirst ();
-	while (pElement != 0)
+	while (m_pRetransmissionFirst != 0)
 	{
-		CMQTTSendPacket *pPacket = (CMQTTSendPacket *) m_RetransmissionQueue.GetPtr (pElement);
-		assert (pPacket != 0);
+		CMQTTSendPacket *pPacket = m_pRetransmissionFirst;
 
 		// leave if scheduled time is after current time (queue is sorted)
 		if ((int) (pPacket->GetScheduledTime () - nTicks) > 0)
@@ -677,9 +739,8 @@ void CMQTTClient::Sender (void)
 			break;
 		}
 
-		TPtrListElement *pNextElement = m_RetransmissionQueue.GetNext (pElement);
-		m_RetransmissionQueue.Remove (pElement);
-		pElement = pNextElement;
+		pPacket = RemovePacketFromQueue (pPacket->GetPacketIdentifier ());
+		assert (pPacket != 0);
 
 		// retransmit packet
 		if (pPacket->GetType () == MQTTPublish)
@@ -690,7 +751,7 @@ void CMQTTClient::Sender (void)
 		// SendPacket() fails on too many retries
 		if (!SendPacket (pPacket))
 		{
-			delete pPacket;
+			FreePacket (pPacket);
 
 			CloseConnection (MQTTDisconnectSendFailed);
 
@@ -759,12 +820,34 @@ boolean CMQTTClient::SendPacket (CMQTTSendPacket *pPacket)
 	}
 
 	assert (pPacket != 0);
-	assert (m_pSocket != 0);
-	if (!pPacket->Send (m_pSocket))
+	unsigned nLength;
+	const u8 *pData = pPacket->Encode (&nLength);
+	if (pData == 0)
+	{
+		return FALSE;
+	}
+
+	if (   m_nTxLength + nLength > sizeof m_TxBuffer
+	    && !FlushTxBuffer ())
 	{
 		return FALSE;
 	}
 
+	assert (m_pSocket != 0);
+	if (nLength > sizeof m_TxBuffer)
+	{
+		// big packets are sent directly from the packet buffer
+		if (m_pSocket->Send (pData, nLength, MSG_DONTWAIT) != (int) nLength)
+		{
+			return FALSE;
+		}
+	}
+	else
+	{
+		memcpy (m_TxBuffer + m_nTxLength, pData, nLength);
+		m_nTxLength += nLength;
+	}
+
 	// keep alive handling
 	switch (pPacket->GetType ())
 	{
@@ -804,53 +887,149 @@ boolean CMQTTClient::SendPacket (CMQTTSendPacket *pPacket)
 	return TRUE;
 }
 
-void CMQTTClient::InsertPacketIntoQueue (CMQTTSendPacket *pPacket, unsigned nScheduledTime)
+boolean CMQTTClient::FlushTxBuffer (void)
+{
+	if (m_nTxLength == 0)
+	{
+		return TRUE;
+	}
+
+	assert (m_pSocket != 0);
+	int nResult = m_pSocket->Send (m_TxBuffer, m_nTxLength, MSG_DONTWAIT);
+
+	boolean bOK = nResult == (int) m_nTxLength;
+	m_nTxLength = 0;
+
+	return bOK;
+}
+
+u16 CMQTTClient::GetPacketIdentifier (void)
+{
+	u16 usPacketIdentifier = m_usNextPacketIdentifier;
+	if (++m_usNextPacketIdentifier == 0)
+	{
+		m_usNextPacketIdentifier++;
+	}
+
+	return usPacketIdentifier;
+}
+
+CMQTTSendPacket *CMQTTClient::AllocatePacket (TMQTTPacketType Type)
+{
+	CMQTTSendPacket *pPacket = m_pFreePackets;
+	if (pPacket == 0)
+	{
+		return 0;
+	}
+
+	m_pFreePackets = pPacket->GetNext ();
+
+	pPacket->SetNext (0);
+	pPacket->Reset (Type);
+
+	return pPacket;
+}
+
+void CMQTTClient::FreePacket (CMQTTSendPacket *pPacket)
 {
 	assert (pPacket != 0);
-	pPacket->SetScheduledTime (nScheduledTime);
+	pPacket->SetNext (m_pFreePackets);
+	m_pFreePackets = pPacket;
+}
 
-	TPtrListElement *pPrevElement = 0;
-	TPtrListElement *pElement = m_RetransmissionQueue.GetFirst ();
-	while (pElement != 0)
+boolean CMQTTClient::QueuePacket (CMQTTSendPacket *pPacket)
+{
+	assert (pPacket != 0);
+	pPacket->SetNext (0);
+
+	if (m_pPendingLast != 0)
 	{
-		CMQTTSendPacket *pPacket2 = (CMQTTSendPacket *) m_RetransmissionQueue.GetPtr (pElement);
-		assert (pPacket2 != 0);
+		m_pPendingLast->SetNext (pPacket);
+	}
+	else
+	{
+		m_pPendingFirst = pPacket;
+	}
+	m_pPendingLast = pPacket;
 
-		if ((int) (pPacket2->GetScheduledTime () - nScheduledTime) > 0)
+	return SendPendingPackets ();
+}
+
+boolean CMQTTClient::SendPendingPackets (void)
+{
+	while (   m_pPendingFirst != 0
+	       && m_nInFlight < m_nMaxInFlight)
+	{
+		CMQTTSendPacket *pPacket = m_pPendingFirst;
+		m_pPendingFirst = pPacket->GetNext ();
+		if (m_pPendingFirst == 0)
 		{
-			break;
+			m_pPendingLast = 0;
+		}
+
+		if (!SendPacket (pPacket))
+		{
+			FreePacket (pPacket);
+
+			return FALSE;
 		}
 
-		pPrevElement = pElement;
-		pElement = m_RetransmissionQueue.GetNext (pElement);
+		InsertPacketIntoQueue (pPacket, m_pTimer->GetTicks () + MQTT_RESEND_TIMEOUT);
 	}
 
-	if (pElement != 0)
+	return TRUE;
+}
+
+void CMQTTClient::InsertPacketIntoQueue (CMQTTSendPacket *pPacket, unsigned nScheduledTime)
+{
+	assert (pPacket != 0);
+	pPacket->SetScheduledTime (nScheduledTime);
+	pPacket->SetNext (0);
+
+	if (m_pRetransmissionLast != 0)
 	{
-		m_RetransmissionQueue.InsertBefore (pElement, pPacket);
+		assert ((int) (m_pRetransmissionLast->GetScheduledTime () - nScheduledTime) <= 0);
+		m_pRetransmissionLast->SetNext (pPacket);
 	}
 	else
 	{
-		m_RetransmissionQueue.InsertAfter (pPrevElement, pPacket);
+		m_pRetransmissionFirst = pPacket;
 	}
+	m_pRetransmissionLast = pPacket;
+
+	m_nInFlight++;
 }
 
 CMQTTSendPacket *CMQTTClient::RemovePacketFromQueue (u16 usPacketIdentifier)
 {
-	TPtrListElement *pElement = m_RetransmissionQueue.GetFirst ();
-	while (pElement != 0)
+	CMQTTSendPacket *pPrevPacket = 0;
+	for (CMQTTSendPacket *pPacket = m_pRetransmissionFirst;
+	     pPacket != 0;
+	     pPrevPacket = pPacket, pPacket = pPacket->GetNext ())
 	{
-		CMQTTSendPacket *pPacket = (CMQTTSendPacket *) m_RetransmissionQueue.GetPtr (pElement);
-		assert (pPacket != 0);
-
 		if (pPacket->GetPacketIdentifier () == usPacketIdentifier)
 		{
-			m_RetransmissionQueue.Remove (pElement);
+			if (pPrevPacket != 0)
+			{
+				pPrevPacket->SetNext (pPacket->GetNext ());
+			}
+			else
+			{
+				m_pRetransmissionFirst = pPacket->GetNext ();
+			}
+
+			if (m_pRetransmissionLast == pPacket)
+			{
+				m_pRetransmissionLast = pPrevPacket;
+			}
+
+			pPacket->SetNext (0);
+
+			assert (m_nInFlight > 0);
+			m_nInFlight--;
 
 			return pPacket;
 		}
-
-		pElement = m_RetransmissionQueue.GetNext (pElement);
 	}
 
 	return 0;
@@ -858,18 +1037,28 @@ CMQTTSendPacket *CMQTTClient::RemovePacketFromQueue (u16 usPacketIdentifier)
 
 void CMQTTClient::CleanupQueue (void)
 {
-	TPtrListElement *pElement = m_RetransmissionQueue.GetFirst ();
-	while (pElement != 0)
+	while (m_pRetransmissionFirst != 0)
 	{
-		CMQTTSendPacket *pPacket = (CMQTTSendPacket *) m_RetransmissionQueue.GetPtr (pElement);
-		assert (pPacket != 0);
+		CMQTTSendPacket *pPacket = m_pRetransmissionFirst;
+		m_pRetransmissionFirst = pPacket->GetNext ();
 
-		TPtrListElement *pNextElement = m_RetransmissionQueue.GetNext (pElement);
-		m_RetransmissionQueue.Remove (pElement);
-		pElement = pNextElement;
+		FreePacket (pPacket);
+	}
 
-		delete pPacket;
+	m_pRetransmissionLast = 0;
+	m_nInFlight = 0;
+
+	while (m_pPendingFirst != 0)
+	{
+		CMQTTSendPacket *pPacket = m_pPendingFirst;
+		m_pPendingFirst = pPacket->GetNext ();
+
+		FreePacket (pPacket);
 	}
+
+	m_pPendingLast = 0;
+
+	m_nTxLength = 0;
 }
 
 void CMQTTClient::InsertPacketIdentifierIntoStore (u16 usPacketIdentifier)
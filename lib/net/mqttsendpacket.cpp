@@ -18,28 +18,49 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/mqttsendpacket.h>
-#include <circle/net/in.h>
 #include <circle/util.h>
 #include <assert.h>
 
 #define MAX_LENGTH_FIXED_HEADER		5
 
 CMQTTSendPacket::CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize)
-:	m_Type (Type),
-	m_nMaxPacketSize (nMaxPacketSize),
+:	m_nMaxPacketSize (nMaxPacketSize),
 	m_bError (FALSE),
-	m_nBufPtr (MAX_LENGTH_FIXED_HEADER),
-	m_uchFlags (0),
-	m_nSendTries (MQTT_SEND_TRIES)
+	m_pBuffer (m_SmallBuffer),
+	m_pNext (0)
 {
-	assert (m_nMaxPacketSize >= 128);
-	m_pBuffer = new u8[m_nMaxPacketSize];
-	if (m_pBuffer == 0)
+	assert (m_nMaxPacketSize >= MQTT_CONTROL_PACKET_SIZE);
+	if (m_nMaxPacketSize > MQTT_CONTROL_PACKET_SIZE)
 	{
-		m_bError = TRUE;
+		m_pBuffer = new u8[m_nMaxPacketSize];
+		if (m_pBuffer == 0)
+		{
+			m_bError = TRUE;
+		}
+	}
 
-		return;
+	Reset (Type);
+}
+
+CMQTTSendPacket::~CMQTTSendPacket (void)
+{
+	if (m_pBuffer != m_SmallBuffer)
+	{
+		delete [] m_pBuffer;
 	}
+	m_pBuffer = 0;
+}
+
+void CMQTTSendPacket::Reset (TMQTTPacketType Type)
+{
+	m_Type = Type;
+	m_bError = m_pBuffer == 0;
+	m_nBufPtr = MAX_LENGTH_FIXED_HEADER;
+	m_uchFlags = 0;
+	m_nSendTries = MQTT_SEND_TRIES;
+	m_nScheduledTime = 0;
+	m_uchQoS = 0;
+	m_usPacketIdentifier = 0;
 
 	if (   m_Type == MQTTPubRel
 	    || m_Type == MQTTSubscribe
@@ -49,12 +70,6 @@ CMQTTSendPacket::CMQTTSendPacket (TMQTTPacketType Type, size_t nMaxPacketSize)
 	}
 }
 
-CMQTTSendPacket::~CMQTTSendPacket (void)
-{
-	delete [] m_pBuffer;
-	m_pBuffer = 0;
-}
-
 void CMQTTSendPacket::SetFlags (u8 uchFlags)
 {
 	assert (m_Type == MQTTPublish);
@@ -147,16 +162,16 @@ void CMQTTSendPacket::AppendData (const u8 *pBuffer, size_t nLength)
 	}
 }
 
-boolean CMQTTSendPacket::Send (CSocket *pSocket)
+const u8 *CMQTTSendPacket::Encode (unsigned *pLength)
 {
 	if (m_bError)
 	{
-		return FALSE;
+		return 0;
 	}
 
 	if (m_nSendTries == 0)
 	{
-		return FALSE;
+		return 0;
 	}
 	m_nSendTries--;
 
@@ -194,15 +209,10 @@ boolean CMQTTSendPacket::Send (CSocket *pSocket)
 	// insert control byte
 	m_pBuffer[MAX_LENGTH_FIXED_HEADER-nLengthBytes-1] = ((u8) m_Type << 4) | m_uchFlags;
 
-	assert (pSocket != 0);
-	int nSendLength = 1+nLengthBytes+nRemainingLength;
-	if (pSocket->Send (&m_pBuffer[MAX_LENGTH_FIXED_HEADER-nLengthBytes-1],
-			   nSendLength, MSG_DONTWAIT) != nSendLength)
-	{
-		return FALSE;
-	}
+	assert (pLength != 0);
+	*pLength = 1+nLengthBytes+nRemainingLength;
 
-	return TRUE;
+	return &m_pBuffer[MAX_LENGTH_FIXED_HEADER-nLengthBytes-1];
 }
 
 TMQTTPacketType CMQTTSendPacket::GetType (void) const
@@ -244,3 +254,13 @@ u16 CMQTTSendPacket::GetPacketIdentifier (void) const
 {
 	return m_usPacketIdentifier;
 }
+
+void CMQTTSendPacket::SetNext (CMQTTSendPacket *pNext)
+{
+	m_pNext = pNext;
+}
+
+CMQTTSendPacket *CMQTTSendPacket::GetNext (void) const
+{
+	return m_pNext;
+}
@@ -0,0 +1,229 @@
+//
+// netcapture.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/netcapture.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// pcapng block types
+#define PCAPNG_SHB		0x0A0D0D0A	// Section Header Block
+#define PCAPNG_IDB		0x00000001	// Interface Description Block
+#define PCAPNG_EPB		0x00000006	// Enhanced Packet Block
+
+#define PCAPNG_BYTE_ORDER_MAGIC	0x1A2B3C4D
+#define PCAPNG_LINKTYPE_ETHERNET 1
+
+#define PCAPNG_OPT_ENDOFOPT	0
+#define PCAPNG_OPT_EPB_FLAGS	2
+	#define PCAPNG_EPB_INBOUND	1
+	#define PCAPNG_EPB_OUTBOUND	2
+
+CNetCapture::CNetCapture (CNetDeviceLayer *pNetDeviceLayer, unsigned nRingSize,
+			  unsigned nSnapLength)
+:	m_pNetDeviceLayer (pNetDeviceLayer),
+	m_nRingSize (nRingSize),
+	m_nSnapLength (nSnapLength),
+	m_nIn (0),
+	m_nOut (0),
+	m_nDropped (0),
+	m_nTimeBase (0)
+{
+	assert (m_pNetDeviceLayer != 0);
+	assert (m_nRingSize >= 2);
+
+	if (m_nSnapLength > FRAME_BUFFER_SIZE)
+	{
+		m_nSnapLength = FRAME_BUFFER_SIZE;
+	}
+
+	m_nSlotSize = (sizeof (TSlot) + m_nSnapLength + 7) & ~7;
+
+	m_pRing = new u8[m_nRingSize * m_nSlotSize];
+	assert (m_pRing != 0);
+}
+
+CNetCapture::~CNetCapture (void)
+{
+	Stop ();
+
+	delete [] m_pRing;
+	m_pRing = 0;
+
+	m_pNetDeviceLayer = 0;
+}
+
+boolean CNetCapture::SetFilter (const char *pExpression)
+{
+	return m_Filter.Compile (pExpression);
+}
+
+void CNetCapture::Start (void)
+{
+	unsigned nSeconds, nMicroSeconds;
+	CTimer::Get ()->GetUniversalTime (&nSeconds, &nMicroSeconds);
+	m_nTimeBase =   nSeconds * 1000000ULL + nMicroSeconds
+		      - CTimer::GetClockTicks64 ();
+
+	m_nOut = m_nIn;
+	m_nDropped = 0;
+
+	DataMemBarrier ();
+
+	assert (m_pNetDeviceLayer != 0);
+	m_pNetDeviceLayer->SetCapture (this);
+}
+
+void CNetCapture::Stop (void)
+{
+	assert (m_pNetDeviceLayer != 0);
+	m_pNetDeviceLayer->SetCapture (0);
+}
+
+unsigned CNetCapture::GetDropped (void) const
+{
+	return m_nDropped;
+}
+
+void CNetCapture::CaptureFrame (const CNetBuffer *pFrame, boolean bTransmit)
+{
+	assert (pFrame != 0);
+
+	unsigned nIn = m_nIn;
+	if ((nIn + 1) % m_nRingSize == m_nOut)
+	{
+		m_nDropped++;
+
+		return;
+	}
+
+	TSlot *pSlot = GetSlot (nIn);
+
+	unsigned nLength = pFrame->GetTotalLength ();
+	unsigned nCaptured = nLength < m_nSnapLength ? nLength : m_nSnapLength;
+
+	if (pFrame->GetNextSegment () == 0)
+	{
+		// filter first, so that rejected frames are not copied
+		if (!m_Filter.Match (pFrame->GetData (), nLength))
+		{
+			return;
+		}
+
+		memcpy (pSlot->Data, pFrame->GetData (), nCaptured);
+	}
+	else
+	{
+		pFrame->CopyTo (pSlot->Data, nCaptured, 0);
+
+		if (!m_Filter.Match (pSlot->Data, nCaptured))
+		{
+			return;
+		}
+	}
+
+	pSlot->nTimestamp = m_nTimeBase + CTimer::GetClockTicks64 ();
+	pSlot->nCapturedLength = nCaptured;
+	pSlot->nOriginalLength = nLength;
+	pSlot->bTransmit = bTransmit;
+
+	// publish the slot after its contents
+	DataMemBarrier ();
+	m_nIn = (nIn + 1) % m_nRingSize;
+}
+
+unsigned CNetCapture::GetPcapngHeader (void *pBuffer) const
+{
+	assert (pBuffer != 0);
+	u32 *p = (u32 *) pBuffer;
+
+	// Section Header Block
+	*p++ = PCAPNG_SHB;
+	*p++ = 28;
+	*p++ = PCAPNG_BYTE_ORDER_MAGIC;
+	*p++ = 1;				// version 1.0
+	*p++ = 0xFFFFFFFF;			// section length unknown
+	*p++ = 0xFFFFFFFF;
+	*p++ = 28;
+
+	// Interface Description Block (timestamps in microseconds by default)
+	*p++ = PCAPNG_IDB;
+	*p++ = 20;
+	*p++ = PCAPNG_LINKTYPE_ETHERNET;
+	*p++ = m_nSnapLength;
+	*p++ = 20;
+
+	assert ((u8 *) p - (u8 *) pBuffer == NET_CAPTURE_PCAPNG_HEADER_SIZE);
+
+	return NET_CAPTURE_PCAPNG_HEADER_SIZE;
+}
+
+unsigned CNetCapture::ReadPcapngBlock (void *pBuffer)
+{
+	unsigned nOut = m_nOut;
+	if (nOut == m_nIn)
+	{
+		return 0;
+	}
+
+	// read the slot after the index has been seen
+	DataMemBarrier ();
+
+	const TSlot *pSlot = GetSlot (nOut);
+	unsigned nCaptured = pSlot->nCapturedLength;
+	unsigned nPadded = (nCaptured + 3) & ~3;
+	unsigned nBlockLength = 28 + nPadded + 12 + 4;
+	assert (nBlockLength <= NET_CAPTURE_PCAPNG_BLOCK_SIZE);
+
+	assert (pBuffer != 0);
+	u32 *p = (u32 *) pBuffer;
+
+	*p++ = PCAPNG_EPB;
+	*p++ = nBlockLength;
+	*p++ = 0;				// interface ID
+	*p++ = (u32) (pSlot->nTimestamp >> 32);
+	*p++ = (u32) pSlot->nTimestamp;
+	*p++ = nCaptured;
+	*p++ = pSlot->nOriginalLength;
+
+	memcpy (p, pSlot->Data, nCaptured);
+	memset ((u8 *) p + nCaptured, 0, nPadded - nCaptured);
+	p += nPadded / 4;
+
+	*p++ = PCAPNG_OPT_EPB_FLAGS | 4 << 16;
+	*p++ = pSlot->bTransmit ? PCAPNG_EPB_OUTBOUND : PCAPNG_EPB_INBOUND;
+	*p++ = PCAPNG_OPT_ENDOFOPT;
+
+	*p++ = nBlockLength;
+
+	// release the slot to the producer
+	DataMemBarrier ();
+	m_nOut = (nOut + 1) % m_nRingSize;
+
+	return nBlockLength;
+}
+
+CNetCapture::TSlot *CNetCapture::GetSlot (unsigned nIndex) const
+{
+	assert (nIndex < m_nRingSize);
+	assert (m_pRing != 0);
+
+	return (TSlot *) (m_pRing + nIndex * m_nSlotSize);
+}
@@ -0,0 +1,840 @@
+//
+// netcapturefilter.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/netcapturefilter.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define LIST_END	0xFFFF
+
+// frame offsets (Ethernet II, IPv4)
+#define OFFSET_ETHER_TYPE	12
+#define OFFSET_IP_HEADER	14
+#define OFFSET_IP_FRAGMENT	(OFFSET_IP_HEADER + 6)
+#define OFFSET_IP_PROTOCOL	(OFFSET_IP_HEADER + 9)
+#define OFFSET_IP_SOURCE	(OFFSET_IP_HEADER + 12)
+#define OFFSET_IP_DESTINATION	(OFFSET_IP_HEADER + 16)
+#define OFFSET_SOURCE_PORT	(OFFSET_IP_HEADER + 0)		// relative to X
+#define OFFSET_DEST_PORT	(OFFSET_IP_HEADER + 2)
+
+#define ETHER_TYPE_IP		0x0800
+#define ETHER_TYPE_ARP		0x0806
+#define ETHER_TYPE_IPV6		0x86DD
+
+#define IP_PROTOCOL_ICMP	1
+#define IP_PROTOCOL_TCP		6
+#define IP_PROTOCOL_UDP		17
+
+#define IP_FRAGMENT_OFFSET_MASK	0x1FFF
+
+enum TDirection
+{
+	DirectionAny,
+	DirectionSource,
+	DirectionDestination
+};
+
+CNetCaptureFilter::CNetCaptureFilter (void)
+:	m_nInsns (0),
+	m_pNext (0)
+{
+	m_Token[0] = '\0';
+}
+
+CNetCaptureFilter::~CNetCaptureFilter (void)
+{
+}
+
+boolean CNetCaptureFilter::Compile (const char *pExpression)
+{
+	m_nInsns = 0;
+
+	if (pExpression == 0)
+	{
+		return TRUE;
+	}
+
+	m_pNext = pExpression;
+	NextToken ();
+	if (m_Token[0] == '\0')
+	{
+		return TRUE;
+	}
+
+	TJumpLists Lists;
+	if (   !ParseExpression (&Lists)
+	    || m_Token[0] != '\0')
+	{
+		m_nInsns = 0;
+
+		return FALSE;
+	}
+
+	u16 nAccept = m_nInsns;
+	u16 nReject = m_nInsns + 1;
+	if (   !EmitReturn (1)
+	    || !EmitReturn (0))
+	{
+		m_nInsns = 0;
+
+		return FALSE;
+	}
+
+	Patch (Lists.nTrue, nAccept);
+	Patch (Lists.nFalse, nReject);
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::Match (const u8 *pFrame, unsigned nLength) const
+{
+	if (m_nInsns == 0)
+	{
+		return TRUE;
+	}
+
+	assert (pFrame != 0);
+
+	u32 A = 0;
+	u32 X = 0;
+
+	// all jumps go forward, so the program always terminates
+	unsigned nPC = 0;
+	while (nPC < m_nInsns)
+	{
+		const TInsn *pInsn = &m_Program[nPC];
+		u32 k = pInsn->nK;
+		boolean bCondition;
+
+		switch (pInsn->Opcode)
+		{
+		case OpLoadByte:
+			if (k + 1 > nLength)
+			{
+				return FALSE;
+			}
+			A = pFrame[k];
+			nPC++;
+			continue;
+
+		case OpLoadHalf:
+			if (k + 2 > nLength)
+			{
+				return FALSE;
+			}
+			A = pFrame[k] << 8 | pFrame[k+1];
+			nPC++;
+			continue;
+
+		case OpLoadWord:
+			if (k + 4 > nLength)
+			{
+				return FALSE;
+			}
+			A =   (u32) pFrame[k] << 24 | pFrame[k+1] << 16
+			    | pFrame[k+2] << 8 | pFrame[k+3];
+			nPC++;
+			continue;
+
+		case OpLoadLength:
+			A = nLength;
+			nPC++;
+			continue;
+
+		case OpLoadIndexMSH:
+			if (k + 1 > nLength)
+			{
+				return FALSE;
+			}
+			X = (pFrame[k] & 0xF) * 4;
+			nPC++;
+			continue;
+
+		case OpLoadHalfIndex:
+			if (X + k + 2 > nLength)
+			{
+				return FALSE;
+			}
+			A = pFrame[X+k] << 8 | pFrame[X+k+1];
+			nPC++;
+			continue;
+
+		case OpJumpEqual:
+			bCondition = A == k;
+			break;
+
+		case OpJumpGreaterEqual:
+			bCondition = A >= k;
+			break;
+
+		case OpJumpSet:
+			bCondition = !!(A & k);
+			break;
+
+		case OpReturn:
+			return k != 0;
+
+		default:
+			assert (0);
+			return FALSE;
+		}
+
+		nPC = bCondition ? pInsn->nTrue : pInsn->nFalse;
+	}
+
+	return FALSE;
+}
+
+boolean CNetCaptureFilter::ParseExpression (TJumpLists *pResult)
+{
+	assert (pResult != 0);
+	if (!ParseTerm (pResult))
+	{
+		return FALSE;
+	}
+
+	while (   IsToken ("or")
+	       || IsToken ("||"))
+	{
+		NextToken ();
+
+		Patch (pResult->nFalse, m_nInsns);
+
+		TJumpLists Term;
+		if (!ParseTerm (&Term))
+		{
+			return FALSE;
+		}
+
+		pResult->nTrue = Merge (pResult->nTrue, Term.nTrue);
+		pResult->nFalse = Term.nFalse;
+	}
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::ParseTerm (TJumpLists *pResult)
+{
+	assert (pResult != 0);
+	if (!ParseFactor (pResult))
+	{
+		return FALSE;
+	}
+
+	while (   IsToken ("and")
+	       || IsToken ("&&"))
+	{
+		NextToken ();
+
+		Patch (pResult->nTrue, m_nInsns);
+
+		TJumpLists Factor;
+		if (!ParseFactor (&Factor))
+		{
+			return FALSE;
+		}
+
+		pResult->nTrue = Factor.nTrue;
+		pResult->nFalse = Merge (pResult->nFalse, Factor.nFalse);
+	}
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::ParseFactor (TJumpLists *pResult)
+{
+	assert (pResult != 0);
+
+	if (   IsToken ("not")
+	    || IsToken ("!"))
+	{
+		NextToken ();
+
+		if (!ParseFactor (pResult))
+		{
+			return FALSE;
+		}
+
+		u16 nTemp = pResult->nTrue;
+		pResult->nTrue = pResult->nFalse;
+		pResult->nFalse = nTemp;
+
+		return TRUE;
+	}
+
+	if (IsToken ("("))
+	{
+		NextToken ();
+
+		if (   !ParseExpression (pResult)
+		    || !IsToken (")"))
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+
+		return TRUE;
+	}
+
+	return ParsePrimitive (pResult);
+}
+
+boolean CNetCaptureFilter::ParsePrimitive (TJumpLists *pResult)
+{
+	u8 uchProtocol = 0;
+	int nDirection = DirectionAny;
+	u32 nNumber;
+
+	if (IsToken ("ip"))
+	{
+		NextToken ();
+
+		return EmitEtherType (ETHER_TYPE_IP, pResult);
+	}
+
+	if (IsToken ("ip6"))
+	{
+		NextToken ();
+
+		return EmitEtherType (ETHER_TYPE_IPV6, pResult);
+	}
+
+	if (IsToken ("arp"))
+	{
+		NextToken ();
+
+		return EmitEtherType (ETHER_TYPE_ARP, pResult);
+	}
+
+	if (IsToken ("icmp"))
+	{
+		NextToken ();
+
+		return EmitIPProtocol (IP_PROTOCOL_ICMP, pResult);
+	}
+
+	if (IsToken ("ether"))
+	{
+		NextToken ();
+		if (!IsToken ("proto"))
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+		if (   !GetNumber (&nNumber)
+		    || nNumber > 0xFFFF)
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+
+		return EmitEtherType ((u16) nNumber, pResult);
+	}
+
+	if (   IsToken ("greater")
+	    || IsToken ("less"))
+	{
+		boolean bLess = IsToken ("less");
+
+		NextToken ();
+		if (!GetNumber (&nNumber))
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+
+		// less N is the same as not (length >= N+1)
+		if (   !EmitLoad (OpLoadLength, 0)
+		    || !EmitJump (OpJumpGreaterEqual, bLess ? nNumber + 1 : nNumber, pResult))
+		{
+			return FALSE;
+		}
+
+		if (bLess)
+		{
+			u16 nTemp = pResult->nTrue;
+			pResult->nTrue = pResult->nFalse;
+			pResult->nFalse = nTemp;
+		}
+
+		return TRUE;
+	}
+
+	if (   IsToken ("tcp")
+	    || IsToken ("udp"))
+	{
+		uchProtocol = IsToken ("tcp") ? IP_PROTOCOL_TCP : IP_PROTOCOL_UDP;
+
+		NextToken ();
+		if (   !IsToken ("src")
+		    && !IsToken ("dst")
+		    && !IsToken ("port"))
+		{
+			return EmitIPProtocol (uchProtocol, pResult);
+		}
+	}
+
+	if (IsToken ("src"))
+	{
+		nDirection = DirectionSource;
+
+		NextToken ();
+	}
+	else if (IsToken ("dst"))
+	{
+		nDirection = DirectionDestination;
+
+		NextToken ();
+	}
+
+	if (   IsToken ("host")
+	    && uchProtocol == 0)
+	{
+		NextToken ();
+
+		u32 nAddress;
+		if (!GetIPAddress (&nAddress))
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+
+		return EmitHost (nDirection, nAddress, pResult);
+	}
+
+	if (IsToken ("port"))
+	{
+		NextToken ();
+		if (   !GetNumber (&nNumber)
+		    || nNumber > 0xFFFF)
+		{
+			return FALSE;
+		}
+
+		NextToken ();
+
+		return EmitPort (uchProtocol, nDirection, (u16) nNumber, pResult);
+	}
+
+	return FALSE;
+}
+
+boolean CNetCaptureFilter::EmitEtherType (u16 usType, TJumpLists *pResult)
+{
+	return    EmitLoad (OpLoadHalf, OFFSET_ETHER_TYPE)
+	       && EmitJump (OpJumpEqual, usType, pResult);
+}
+
+boolean CNetCaptureFilter::EmitIPProtocol (u8 uchProtocol, TJumpLists *pResult)
+{
+	TJumpLists IP;
+	if (!EmitEtherType (ETHER_TYPE_IP, &IP))
+	{
+		return FALSE;
+	}
+
+	Patch (IP.nTrue, m_nInsns);
+
+	if (   !EmitLoad (OpLoadByte, OFFSET_IP_PROTOCOL)
+	    || !EmitJump (OpJumpEqual, uchProtocol, pResult))
+	{
+		return FALSE;
+	}
+
+	assert (pResult != 0);
+	pResult->nFalse = Merge (IP.nFalse, pResult->nFalse);
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::EmitHost (int nDirection, u32 nAddress, TJumpLists *pResult)
+{
+	TJumpLists IP;
+	if (!EmitEtherType (ETHER_TYPE_IP, &IP))
+	{
+		return FALSE;
+	}
+
+	Patch (IP.nTrue, m_nInsns);
+
+	assert (pResult != 0);
+	pResult->nTrue = LIST_END;
+	pResult->nFalse = IP.nFalse;
+
+	TJumpLists Jump;
+	if (nDirection != DirectionDestination)
+	{
+		if (   !EmitLoad (OpLoadWord, OFFSET_IP_SOURCE)
+		    || !EmitJump (OpJumpEqual, nAddress, &Jump))
+		{
+			return FALSE;
+		}
+
+		pResult->nTrue = Merge (pResult->nTrue, Jump.nTrue);
+
+		if (nDirection == DirectionSource)
+		{
+			pResult->nFalse = Merge (pResult->nFalse, Jump.nFalse);
+
+			return TRUE;
+		}
+
+		Patch (Jump.nFalse, m_nInsns);
+	}
+
+	if (   !EmitLoad (OpLoadWord, OFFSET_IP_DESTINATION)
+	    || !EmitJump (OpJumpEqual, nAddress, &Jump))
+	{
+		return FALSE;
+	}
+
+	pResult->nTrue = Merge (pResult->nTrue, Jump.nTrue);
+	pResult->nFalse = Merge (pResult->nFalse, Jump.nFalse);
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::EmitPort (u8 uchProtocol, int nDirection, u16 usPort,
+				     TJumpLists *pResult)
+{
+	TJumpLists IP;
+	if (!EmitEtherType (ETHER_TYPE_IP, &IP))
+	{
+		return FALSE;
+	}
+
+	Patch (IP.nTrue, m_nInsns);
+
+	assert (pResult != 0);
+	pResult->nTrue = LIST_END;
+	pResult->nFalse = IP.nFalse;
+
+	// TCP or UDP (or the given protocol only)
+	TJumpLists Jump;
+	if (!EmitLoad (OpLoadByte, OFFSET_IP_PROTOCOL))
+	{
+		return FALSE;
+	}
+
+	if (uchProtocol != 0)
+	{
+		if (!EmitJump (OpJumpEqual, uchProtocol, &Jump))
+		{
+			return FALSE;
+		}
+
+		Patch (Jump.nTrue, m_nInsns);
+		pResult->nFalse = Merge (pResult->nFalse, Jump.nFalse);
+	}
+	else
+	{
+		TJumpLists Jump2;
+		if (!EmitJump (OpJumpEqual, IP_PROTOCOL_TCP, &Jump))
+		{
+			return FALSE;
+		}
+
+		Patch (Jump.nFalse, m_nInsns);
+
+		if (!EmitJump (OpJumpEqual, IP_PROTOCOL_UDP, &Jump2))
+		{
+			return FALSE;
+		}
+
+		Patch (Jump.nTrue, m_nInsns);
+		Patch (Jump2.nTrue, m_nInsns);
+		pResult->nFalse = Merge (pResult->nFalse, Jump2.nFalse);
+	}
+
+	// only the first fragment holds the ports
+	if (   !EmitLoad (OpLoadHalf, OFFSET_IP_FRAGMENT)
+	    || !EmitJump (OpJumpSet, IP_FRAGMENT_OFFSET_MASK, &Jump))
+	{
+		return FALSE;
+	}
+
+	pResult->nFalse = Merge (pResult->nFalse, Jump.nTrue);
+	Patch (Jump.nFalse, m_nInsns);
+
+	if (!EmitLoad (OpLoadIndexMSH, OFFSET_IP_HEADER))
+	{
+		return FALSE;
+	}
+
+	if (nDirection != DirectionDestination)
+	{
+		if (   !EmitLoad (OpLoadHalfIndex, OFFSET_SOURCE_PORT)
+		    || !EmitJump (OpJumpEqual, usPort, &Jump))
+		{
+			return FALSE;
+		}
+
+		pResult->nTrue = Merge (pResult->nTrue, Jump.nTrue);
+
+		if (nDirection == DirectionSource)
+		{
+			pResult->nFalse = Merge (pResult->nFalse, Jump.nFalse);
+
+			return TRUE;
+		}
+
+		Patch (Jump.nFalse, m_nInsns);
+	}
+
+	if (   !EmitLoad (OpLoadHalfIndex, OFFSET_DEST_PORT)
+	    || !EmitJump (OpJumpEqual, usPort, &Jump))
+	{
+		return FALSE;
+	}
+
+	pResult->nTrue = Merge (pResult->nTrue, Jump.nTrue);
+	pResult->nFalse = Merge (pResult->nFalse, Jump.nFalse);
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::EmitLoad (TOpcode Opcode, u32 nK)
+{
+	// two instructions are reserved for the final returns
+	if (m_nInsns >= NET_CAPTURE_FILTER_MAX_INSNS - 2)
+	{
+		return FALSE;
+	}
+
+	TInsn *pInsn = &m_Program[m_nInsns++];
+	pInsn->Opcode = Opcode;
+	pInsn->nTrue = LIST_END;
+	pInsn->nFalse = LIST_END;
+	pInsn->nK = nK;
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::EmitJump (TOpcode Opcode, u32 nK, TJumpLists *pResult)
+{
+	u16 nIndex = m_nInsns;
+	if (!EmitLoad (Opcode, nK))
+	{
+		return FALSE;
+	}
+
+	assert (pResult != 0);
+	pResult->nTrue = nIndex << 1;
+	pResult->nFalse = nIndex << 1 | 1;
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::EmitReturn (u32 nK)
+{
+	if (m_nInsns >= NET_CAPTURE_FILTER_MAX_INSNS)
+	{
+		return FALSE;
+	}
+
+	TInsn *pInsn = &m_Program[m_nInsns++];
+	pInsn->Opcode = OpReturn;
+	pInsn->nTrue = LIST_END;
+	pInsn->nFalse = LIST_END;
+	pInsn->nK = nK;
+
+	return TRUE;
+}
+
+void CNetCaptureFilter::Patch (u16 nList, u16 nTarget)
+{
+	while (nList != LIST_END)
+	{
+		TInsn *pInsn = &m_Program[nList >> 1];
+		u16 *pField = nList & 1 ? &pInsn->nFalse : &pInsn->nTrue;
+
+		nList = *pField;
+		*pField = nTarget;
+	}
+}
+
+u16 CNetCaptureFilter::Merge (u16 nList1, u16 nList2)
+{
+	if (nList1 == LIST_END)
+	{
+		return nList2;
+	}
+
+	u16 nList = nList1;
+	while (1)
+	{
+		TInsn *pInsn = &m_Program[nList >> 1];
+		u16 *pField = nList & 1 ? &pInsn->nFalse : &pInsn->nTrue;
+
+		if (*pField == LIST_END)
+		{
+			*pField = nList2;
+
+			return nList1;
+		}
+
+		nList = *pField;
+	}
+}
+
+void CNetCaptureFilter::NextToken (void)
+{
+	assert (m_pNext != 0);
+	while (*m_pNext == ' ')
+	{
+		m_pNext++;
+	}
+
+	unsigned nLength = 0;
+	if (   *m_pNext == '('
+	    || *m_pNext == ')'
+	    || *m_pNext == '!')
+	{
+		m_Token[nLength++] = *m_pNext++;
+	}
+	else if (   (m_pNext[0] == '&' && m_pNext[1] == '&')
+		 || (m_pNext[0] == '|' && m_pNext[1] == '|'))
+	{
+		m_Token[nLength++] = *m_pNext++;
+		m_Token[nLength++] = *m_pNext++;
+	}
+	else
+	{
+		while (   *m_pNext != '\0'
+		       && !strchr (" ()!&|", *m_pNext))
+		{
+			if (nLength < sizeof m_Token - 1)
+			{
+				m_Token[nLength++] = *m_pNext;
+			}
+			else
+			{
+				m_Token[0] = '?';	// too long, cannot match
+			}
+
+			m_pNext++;
+		}
+
+		// a single '&' or '|' is not valid
+		if (   nLength == 0
+		    && *m_pNext != '\0')
+		{
+			m_Token[nLength++] = *m_pNext++;
+		}
+	}
+
+	m_Token[nLength] = '\0';
+}
+
+boolean CNetCaptureFilter::IsToken (const char *pToken) const
+{
+	return strcmp (m_Token, pToken) == 0;
+}
+
+boolean CNetCaptureFilter::GetNumber (u32 *pNumber)
+{
+	const char *p = m_Token;
+	unsigned nBase = 10;
+	if (p[0] == '0' && (p[1] == 'x' || p[1] == 'X'))
+	{
+		nBase = 16;
+		p += 2;
+	}
+
+	if (*p == '\0')
+	{
+		return FALSE;
+	}
+
+	u32 nNumber = 0;
+	for (; *p != '\0'; p++)
+	{
+		unsigned nDigit;
+		if ('0' <= *p && *p <= '9')
+		{
+			nDigit = *p - '0';
+		}
+		else if (nBase == 16 && 'a' <= (*p | 0x20) && (*p | 0x20) <= 'f')
+		{
+			nDigit = (*p | 0x20) - 'a' + 10;
+		}
+		else
+		{
+			return FALSE;
+		}
+
+		if (nNumber > (0xFFFFFFFFU - nDigit) / nBase)
+		{
+			return FALSE;
+		}
+
+		nNumber = nNumber * nBase + nDigit;
+	}
+
+	assert (pNumber != 0);
+	*pNumber = nNumber;
+
+	return TRUE;
+}
+
+boolean CNetCaptureFilter::GetIPAddress (u32 *pAddress)
+{
+	const char *p = m_Token;
+	u32 nAddress = 0;
+
+	for (unsigned i = 0; i < 4; i++)
+	{
+		if (!('0' <= *p && *p <= '9'))
+		{
+			return FALSE;
+		}
+
+		unsigned nByte = 0;
+		while ('0' <= *p && *p <= '9')
+		{
+			nByte = nByte * 10 + *p++ - '0';
+			if (nByte > 255)
+			{
+				return FALSE;
+			}
+		}
+
+		if (*p != (i < 3 ? '.' : '\0'))
+		{
+			return FALSE;
+		}
+
+		if (i < 3)
+		{
+			p++;
+		}
+
+		nAddress = nAddress << 8 | nByte;
+	}
+
+	assert (pAddress != 0);
+	*pAddress = nAddress;
+
+	return TRUE;
+}
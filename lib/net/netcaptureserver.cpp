@@ -0,0 +1,140 @@
+//
+// netcaptureserver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/netcaptureserver.h>
+#include <circle/net/socket.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/in.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+LOGMODULE ("netcapture");
+
+CNetCaptureServer::CNetCaptureServer (CNetSubSystem *pNetSubSystem, CNetCapture *pCapture,
+				      const char *pFilter, u16 nPort)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_pCapture (pCapture),
+	m_nPort (nPort)
+{
+	assert (m_pNetSubSystem != 0);
+	assert (m_pCapture != 0);
+
+	// do not capture the stream itself
+	if (pFilter != 0 && *pFilter != '\0')
+	{
+		m_Filter.Format ("(%s) and not tcp port %u", pFilter, (unsigned) m_nPort);
+	}
+	else
+	{
+		m_Filter.Format ("not tcp port %u", (unsigned) m_nPort);
+	}
+
+	SetName ("netcapture");
+}
+
+CNetCaptureServer::~CNetCaptureServer (void)
+{
+	m_pCapture = 0;
+	m_pNetSubSystem = 0;
+}
+
+void CNetCaptureServer::Run (void)
+{
+	assert (m_pCapture != 0);
+	if (!m_pCapture->SetFilter (m_Filter))
+	{
+		LOGERR ("Invalid filter: %s", (const char *) m_Filter);
+
+		return;
+	}
+
+	assert (m_pNetSubSystem != 0);
+	CSocket Listener (m_pNetSubSystem, IPPROTO_TCP);
+	if (   Listener.Bind (m_nPort) < 0
+	    || Listener.Listen (1) < 0)
+	{
+		LOGERR ("Cannot listen on port %u", (unsigned) m_nPort);
+
+		return;
+	}
+
+	while (1)
+	{
+		CIPAddress ForeignIP;
+		u16 nForeignPort;
+		CSocket *pConnection = Listener.Accept (&ForeignIP, &nForeignPort);
+		if (pConnection == 0)
+		{
+			CScheduler::Get ()->MsSleep (100);
+
+			continue;
+		}
+
+		CString IPString;
+		ForeignIP.Format (&IPString);
+		LOGNOTE ("Streaming to %s:%u", (const char *) IPString, (unsigned) nForeignPort);
+
+		Stream (pConnection);
+
+		delete pConnection;
+	}
+}
+
+void CNetCaptureServer::Stream (CSocket *pConnection)
+{
+	assert (pConnection != 0);
+	assert (m_pCapture != 0);
+
+	unsigned nLength = m_pCapture->GetPcapngHeader (m_Buffer);
+	if (pConnection->Send (m_Buffer, nLength, 0) != (int) nLength)
+	{
+		return;
+	}
+
+	m_pCapture->Start ();
+
+	while (1)
+	{
+		// collect the available blocks and send them with one call
+		nLength = 0;
+		unsigned nBlockLength;
+		while (   nLength + NET_CAPTURE_PCAPNG_BLOCK_SIZE <= sizeof m_Buffer
+		       && (nBlockLength = m_pCapture->ReadPcapngBlock (m_Buffer + nLength)) != 0)
+		{
+			nLength += nBlockLength;
+		}
+
+		if (nLength == 0)
+		{
+			CScheduler::Get ()->MsSleep (5);
+
+			continue;
+		}
+
+		if (pConnection->Send (m_Buffer, nLength, 0) != (int) nLength)
+		{
+			break;
+		}
+	}
+
+	m_pCapture->Stop ();
+
+	LOGNOTE ("Stream closed (%u frames dropped)", m_pCapture->GetDropped ());
+}
@@ -18,6 +18,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/netconnection.h>
+#include <circle/net/error.h>
+#include <circle/net/in.h>
 #include <assert.h>
 
 CNetConnection::CNetConnection (CNetConfig	*pNetConfig,
@@ -32,7 +34,9 @@ CNetConnection::CNetConnection (CNetConfig	*pNetConfig,
 	m_nForeignPort (nForeignPort),
 	m_nOwnPort (nOwnPort),
 	m_nProtocol (nProtocol),
-	m_Checksum (*pNetConfig->GetIPAddress (), rForeignIP, nProtocol)
+	m_Checksum (*pNetConfig->GetIPAddress (), rForeignIP, nProtocol),
+	m_pReadinessEvent (0),
+	m_nReadiness (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pNetworkLayer != 0);
@@ -47,7 +51,9 @@ CNetConnection::CNetConnection (CNetConfig	*pNetConfig,
 	m_nForeignPort (0),
 	m_nOwnPort (nOwnPort),
 	m_nProtocol (nProtocol),
-	m_Checksum (*pNetConfig->GetIPAddress (), nProtocol)
+	m_Checksum (*pNetConfig->GetIPAddress (), nProtocol),
+	m_pReadinessEvent (0),
+	m_nReadiness (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pNetworkLayer != 0);
@@ -55,6 +61,7 @@ CNetConnection::CNetConnection (CNetConfig	*pNetConfig,
 
 CNetConnection::~CNetConnection (void)
 {
+	m_pReadinessEvent = 0;
 	m_pNetworkLayer = 0;
 	m_pNetConfig = 0;
 }
@@ -90,3 +97,200 @@ const char *CNetConnection::GetStateName (void) const
 {
 	return "";
 }
+
+int CNetConnection::SendBuffer (CNetBuffer *pBuffer, int nFlags)
+{
+	assert (pBuffer != 0);
+	unsigned nLength = pBuffer->GetTotalLength ();
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	u8 Buffer[nLength];
+	pBuffer->CopyTo (Buffer);
+	pBuffer->Release ();
+
+	return Send (Buffer, nLength, nFlags);
+}
+
+int CNetConnection::SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+				  const CIPAddress &rForeignIP, u16 nForeignPort)
+{
+	assert (pBuffer != 0);
+	unsigned nLength = pBuffer->GetTotalLength ();
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	u8 Buffer[nLength];
+	pBuffer->CopyTo (Buffer);
+	pBuffer->Release ();
+
+	return SendTo (Buffer, nLength, nFlags, rForeignIP, nForeignPort);
+}
+
+int CNetConnection::ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags)
+{
+	CNetBuffer *pBuffer = CNetBuffer::Alloc ();
+	assert (pBuffer != 0);
+
+	int nResult = Receive (pBuffer->Append (FRAME_BUFFER_SIZE), nFlags);
+	if (nResult <= 0)
+	{
+		pBuffer->Release ();
+		pBuffer = 0;
+	}
+	else
+	{
+		pBuffer->Truncate (nResult);
+	}
+
+	assert (ppBuffer != 0);
+	*ppBuffer = pBuffer;
+
+	return nResult;
+}
+
+int CNetConnection::ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+				       CIPAddress *pForeignIP, u16 *pForeignPort)
+{
+	CNetBuffer *pBuffer = CNetBuffer::Alloc ();
+	assert (pBuffer != 0);
+
+	int nResult = ReceiveFrom (pBuffer->Append (FRAME_BUFFER_SIZE), nFlags,
+				   pForeignIP, pForeignPort);
+	if (nResult <= 0)
+	{
+		pBuffer->Release ();
+		pBuffer = 0;
+	}
+	else
+	{
+		pBuffer->Truncate (nResult);
+	}
+
+	assert (ppBuffer != 0);
+	*ppBuffer = pBuffer;
+
+	return nResult;
+}
+
+int CNetConnection::SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags)
+{
+	assert (pMessages != 0);
+
+	unsigned nSent = 0;
+	int nResult = 0;
+	while (nSent < nCount)
+	{
+		assert (pMessages[nSent].pBuffer != 0);
+		nResult = SendBufferTo (pMessages[nSent].pBuffer, nFlags,
+					pMessages[nSent].ForeignIP, pMessages[nSent].nForeignPort);
+		pMessages[nSent].pBuffer = 0;
+		if (nResult < 0)
+		{
+			break;
+		}
+
+		nSent++;
+	}
+
+	// release the messages, which have not been sent
+	for (unsigned i = nSent; i < nCount; i++)
+	{
+		if (pMessages[i].pBuffer != 0)
+		{
+			pMessages[i].pBuffer->Release ();
+			pMessages[i].pBuffer = 0;
+		}
+	}
+
+	return nSent > 0 ? (int) nSent : nResult;
+}
+
+int CNetConnection::ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags)
+{
+	assert (pMessages != 0);
+
+	unsigned nReceived = 0;
+	while (nReceived < nCount)
+	{
+		TNetMessage *pMessage = &pMessages[nReceived];
+
+		int nResult = ReceiveBufferFrom (&pMessage->pBuffer,
+						 nReceived == 0 ? nFlags : MSG_DONTWAIT,
+						 &pMessage->ForeignIP, &pMessage->nForeignPort);
+		if (nResult <= 0)
+		{
+			if (nReceived == 0)
+			{
+				return nResult;
+			}
+
+			break;
+		}
+
+		assert (pMessage->pBuffer != 0);
+		nReceived++;
+	}
+
+	return nReceived;
+}
+
+int CNetConnection::SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+						   const CIPAddress &rSourceAddress)
+{
+	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+}
+
+int CNetConnection::SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+						    const CIPAddress &rSourceAddress)
+{
+	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+}
+
+int CNetConnection::BufferReceived (CNetBuffer *pPacket,
+				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
+{
+	assert (pPacket != 0);
+	assert (pPacket->GetNextSegment () == 0);
+
+	return PacketReceived (pPacket->GetData (), pPacket->GetLength (),
+			       rSenderIP, rReceiverIP, nProtocol);
+}
+
+void CNetConnection::SetReadinessEvent (CSynchronizationEvent *pEvent)
+{
+	m_pReadinessEvent = pEvent;
+	m_nReadiness = 0;
+}
+
+void CNetConnection::UpdateReadiness (void)
+{
+	if (m_pReadinessEvent == 0)
+	{
+		return;
+	}
+
+	TStatus Status = GetStatus ();
+
+	unsigned nReadiness =   (Status.bConnected ? 1 << 0 : 0)
+			      | (Status.bRxReady   ? 1 << 1 : 0)
+			      | (Status.bTxReady   ? 1 << 2 : 0)
+			      | (Status.bException ? 1 << 3 : 0);
+
+	if (nReadiness != m_nReadiness)
+	{
+		m_nReadiness = nReadiness;
+
+		m_pReadinessEvent->Set ();
+	}
+}
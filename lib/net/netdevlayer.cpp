@@ -19,23 +19,41 @@
 //
 #include <circle/net/netdevlayer.h>
 #include <circle/net/phytask.h>
+#include <circle/net/netcapture.h>
 #include <circle/logger.h>
 #include <circle/timer.h>
+#include <circle/tracer.h>
 #include <circle/synchronize.h>
+#include <circle/util.h>
 #include <circle/macros.h>
 #include <assert.h>
 
+// maximum number of frames fetched from the device in one call to Process()
+#define NET_RX_BUDGET		64
+
 const char FromNetDev[] = "netdev";
 
 CNetDeviceLayer::CNetDeviceLayer (CNetConfig *pNetConfig, TNetDeviceType DeviceType)
 :	m_DeviceType (DeviceType),
 	m_pNetConfig (pNetConfig),
-	m_pDevice (0)
+	m_pDevice (0),
+	m_bRxInterrupt (FALSE),
+	m_bRxPending (TRUE),
+	m_nTxBatch (0),
+	m_TxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_RxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_pCapture (0)
 {
 }
 
 CNetDeviceLayer::~CNetDeviceLayer (void)
 {
+	for (unsigned i = 0; i < m_nTxBatch; i++)
+	{
+		m_pTxBatch[i]->Release ();
+	}
+	m_nTxBatch = 0;
+
 	m_pDevice = 0;
 	m_pNetConfig = 0;
 }
@@ -68,7 +86,7 @@ boolean CNetDeviceLayer::Initialize (boolean bWaitForActivate)
 		return FALSE;
 	}
 
-	new CPHYTask (m_pDevice);
+	AttachDevice ();
 
 	// wait for Ethernet PHY to come up
 	unsigned nStartTicks = CTimer::Get ()->GetTicks ();
@@ -103,27 +121,111 @@ void CNetDeviceLayer::Process (void)
 			return;
 		}
 
-		new CPHYTask (m_pDevice);
+		AttachDevice ();
 	}
 
-	DMA_BUFFER (u8, Buffer, FRAME_BUFFER_SIZE);
-	unsigned nLength;
-	while (   m_pDevice->IsSendFrameAdvisable ()
-	       && (nLength = m_TxQueue.Dequeue (Buffer)) > 0)
+	// hand over the queued frames in batches, so that the device has to be kicked only once
+	// per batch, frames which did not fit into the device are kept for the next batch
+	while (m_pDevice->IsSendFrameAdvisable ())
 	{
-		if (!m_pDevice->SendFrame (Buffer, nLength))
+		CNetBuffer *pFrame;
+		while (   m_nTxBatch < NET_TX_BUDGET
+		       && (pFrame = m_TxQueue.DequeueBuffer ()) != 0)
 		{
-			CLogger::Get ()->Write (FromNetDev, LogWarning, "Frame dropped");
+			m_pTxBatch[m_nTxBatch++] = pFrame;
+		}
 
+		if (m_nTxBatch == 0)
+		{
 			break;
 		}
+
+		unsigned nSent = m_pDevice->SendBuffers (m_pTxBatch, m_nTxBatch);
+		assert (nSent <= m_nTxBatch);
+
+		if (nSent == 0)
+		{
+			CLogger::Get ()->Write (FromNetDev, LogWarning, "Frame dropped");
+
+			m_pTxBatch[0]->Release ();	// the first frame could not be sent
+			nSent = 1;
+		}
+		else
+		{
+			for (unsigned i = 0; i < nSent; i++)
+			{
+				TRACE_SYSTEM_EVENT (TRACER_EVENT_NET_SEND,
+						    m_pTxBatch[i]->GetTotalLength ());
+
+				CNetCapture *pCapture = m_pCapture;
+				if (pCapture != 0)
+				{
+					pCapture->CaptureFrame (m_pTxBatch[i], TRUE);
+				}
+
+				m_pTxBatch[i]->Release ();
+			}
+		}
+
+		m_nTxBatch -= nSent;
+		memmove (m_pTxBatch, m_pTxBatch + nSent, m_nTxBatch * sizeof m_pTxBatch[0]);
+	}
+
+	// without interrupt, the device has to be polled each time
+	if (   m_bRxInterrupt
+	    && !m_bRxPending)
+	{
+		return;
 	}
 
-	while (m_pDevice->ReceiveFrame (Buffer, &nLength))
+	CNetBuffer *Frames[NET_RX_BUDGET];
+	unsigned nFrames = m_pDevice->ReceiveBuffers (Frames, NET_RX_BUDGET);
+	assert (nFrames <= NET_RX_BUDGET);
+
+	for (unsigned i = 0; i < nFrames; i++)
 	{
-		assert (nLength > 0);
-		m_RxQueue.Enqueue (Buffer, nLength);
+		assert (Frames[i] != 0);
+		assert (Frames[i]->GetLength () > 0);
+		TRACE_SYSTEM_EVENT (TRACER_EVENT_NET_RECEIVE, Frames[i]->GetLength ());
+
+		CNetCapture *pCapture = m_pCapture;
+		if (pCapture != 0)
+		{
+			pCapture->CaptureFrame (Frames[i], FALSE);
+		}
+
+		m_RxQueue.Enqueue (Frames[i]);
 	}
+
+	// if the budget has been exhausted, the device is polled again on next call
+	if (   m_bRxInterrupt
+	    && nFrames < NET_RX_BUDGET)
+	{
+		m_bRxPending = FALSE;
+		DataMemBarrier ();
+
+		if (!m_pDevice->EnableReceiveInterrupt ())
+		{
+			m_bRxPending = TRUE;		// frames arrived in the meantime
+		}
+	}
+}
+
+void CNetDeviceLayer::AttachDevice (void)
+{
+	assert (m_pDevice != 0);
+	new CPHYTask (m_pDevice);
+
+	m_bRxPending = TRUE;
+	m_bRxInterrupt = m_pDevice->RegisterReceiveHandler (ReceiveHandler, this);
+}
+
+void CNetDeviceLayer::ReceiveHandler (void *pParam)
+{
+	CNetDeviceLayer *pThis = (CNetDeviceLayer *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_bRxPending = TRUE;
 }
 
 const CMACAddress *CNetDeviceLayer::GetMACAddress (void) const
@@ -155,11 +257,41 @@ boolean CNetDeviceLayer::Receive (void *pBuffer, unsigned *pResultLength)
 	return TRUE;
 }
 
+void CNetDeviceLayer::Send (CNetBuffer *pFrame)
+{
+	m_TxQueue.Enqueue (pFrame);
+}
+
+CNetBuffer *CNetDeviceLayer::Receive (void)
+{
+	return m_RxQueue.DequeueBuffer ();
+}
+
 boolean CNetDeviceLayer::IsRunning (void) const
 {
 	return m_pDevice != 0 && m_pDevice->IsLinkUp ();
 }
 
+unsigned CNetDeviceLayer::GetCapabilities (void) const
+{
+	if (m_pDevice == 0)
+	{
+		return 0;
+	}
+
+	return m_pDevice->GetCapabilities ();
+}
+
+CNetDevice *CNetDeviceLayer::GetNetDevice (void)
+{
+	return m_pDevice;
+}
+
+void CNetDeviceLayer::SetCapture (CNetCapture *pCapture)
+{
+	m_pCapture = pCapture;
+}
+
 boolean CNetDeviceLayer::SetMulticastFilter (const u8 Groups[][MAC_ADDRESS_SIZE])
 {
 	assert (m_pDevice != 0);
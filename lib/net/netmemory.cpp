@@ -0,0 +1,89 @@
+//
+// netmemory.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/netmemory.h>
+#include <assert.h>
+
+#define PRESSURE_THRESHOLD	(NET_MEMORY_BUDGET / 4 * 3)
+
+unsigned CNetMemory::s_nUsage = 0;
+unsigned CNetMemory::s_nMaxUsage = 0;
+
+void CNetMemory::Charge (unsigned nBytes)
+{
+	unsigned nUsage = __atomic_add_fetch (&s_nUsage, nBytes, __ATOMIC_RELAXED);
+
+	if (nUsage > s_nMaxUsage)
+	{
+		s_nMaxUsage = nUsage;		// statistics only, a lost update does not matter
+	}
+}
+
+void CNetMemory::Uncharge (unsigned nBytes)
+{
+	assert (__atomic_load_n (&s_nUsage, __ATOMIC_RELAXED) >= nBytes);
+	__atomic_sub_fetch (&s_nUsage, nBytes, __ATOMIC_RELAXED);
+}
+
+unsigned CNetMemory::GetUsage (void)
+{
+	return __atomic_load_n (&s_nUsage, __ATOMIC_RELAXED);
+}
+
+unsigned CNetMemory::GetMaxUsage (void)
+{
+	return s_nMaxUsage;
+}
+
+TNetMemoryPressure CNetMemory::GetPressure (void)
+{
+	unsigned nUsage = GetUsage ();
+
+	if (nUsage >= NET_MEMORY_BUDGET)
+	{
+		return NetMemoryCritical;
+	}
+
+	if (nUsage >= PRESSURE_THRESHOLD)
+	{
+		return NetMemoryPressure;
+	}
+
+	return NetMemoryNormal;
+}
+
+unsigned CNetMemory::LimitBuffer (unsigned nSize)
+{
+	switch (GetPressure ())
+	{
+	case NetMemoryNormal:
+		return nSize;
+
+	case NetMemoryPressure:
+		return nSize < NET_MEMORY_PRESSURE_LIMIT ? nSize : NET_MEMORY_PRESSURE_LIMIT;
+
+	default:
+		return 0;
+	}
+}
+
+boolean CNetMemory::CanGrow (unsigned nBytes)
+{
+	return GetUsage () + nBytes < PRESSURE_THRESHOLD;
+}
@@ -19,21 +19,32 @@
 //
 #include <circle/net/netqueue.h>
 #include <circle/netdevice.h>
-#include <circle/util.h>
 #include <assert.h>
 
 struct TNetQueueEntry
 {
-	volatile TNetQueueEntry *pPrev;
-	volatile TNetQueueEntry *pNext;
-	unsigned		 nLength;
-	unsigned char		 Buffer[FRAME_BUFFER_SIZE];
+	volatile TNetQueueEntry	*pNext;
+	CNetBuffer		*pBuffer;
 	void			*pParam;
+	u64			 ullStamp;	// for the pipeline stage
 };
 
-CNetQueue::CNetQueue (void)
-:	m_pFirst (0),
+struct TNetQueueSlab
+{
+	TNetQueueSlab	*pNext;
+	TNetQueueEntry	 Entry[NET_QUEUE_SLAB_ENTRIES];
+};
+
+CNetQueue::CNetQueue (unsigned nHighWaterMark)
+:	m_nHighWaterMark (nHighWaterMark),
+	m_pFirst (0),
 	m_pLast (0),
+	m_pFreeList (0),
+	m_pSlabList (0),
+	m_nCount (0),
+	m_nMaxCount (0),
+	m_nDropCount (0),
+	m_pPipelineStage (0),
 	m_SpinLock (TASK_LEVEL)
 {
 }
@@ -41,6 +52,16 @@ CNetQueue::CNetQueue (void)
 CNetQueue::~CNetQueue (void)
 {
 	Flush ();
+
+	while (m_pSlabList != 0)
+	{
+		TNetQueueSlab *pSlab = m_pSlabList;
+		m_pSlabList = pSlab->pNext;
+
+		delete pSlab;
+	}
+
+	m_pFreeList = 0;
 }
 
 boolean CNetQueue::IsEmpty (void) const
@@ -50,48 +71,76 @@ boolean CNetQueue::IsEmpty (void) const
 
 void CNetQueue::Flush (void)
 {
-	while (m_pFirst != 0)
+	CNetBuffer *pBuffer;
+	while ((pBuffer = DequeueBuffer ()) != 0)
 	{
-		m_SpinLock.Acquire ();
-
-		volatile TNetQueueEntry *pEntry = m_pFirst;
-		assert (pEntry != 0);
-
-		m_pFirst = pEntry->pNext;
-		if (m_pFirst != 0)
-		{
-			m_pFirst->pPrev = 0;
-		}
-		else
-		{
-			assert (m_pLast == pEntry);
-			m_pLast = 0;
-		}
-
-		m_SpinLock.Release ();
-
-		delete pEntry;
+		pBuffer->Release ();
 	}
 }
 	
-void CNetQueue::Enqueue (const void *pBuffer, unsigned nLength, void *pParam)
+boolean CNetQueue::Enqueue (const void *pBuffer, unsigned nLength, void *pParam)
 {
-	TNetQueueEntry *pEntry = new TNetQueueEntry;
-	assert (pEntry != 0);
-
 	assert (nLength > 0);
 	assert (nLength <= FRAME_BUFFER_SIZE);
-	pEntry->nLength = nLength;
+
+	if (   m_nHighWaterMark != 0
+	    && m_nCount >= m_nHighWaterMark)
+	{
+		m_nDropCount++;		// do not copy the data, if it would be dropped anyway
+
+		return FALSE;
+	}
+
+	return Enqueue (CNetBuffer::Alloc (pBuffer, nLength), pParam);
+}
+
+unsigned CNetQueue::Dequeue (void *pBuffer, void **ppParam)
+{
+	CNetBuffer *pNetBuffer = DequeueBuffer (ppParam);
+	if (pNetBuffer == 0)
+	{
+		return 0;
+	}
+
+	unsigned nResult = pNetBuffer->GetTotalLength ();
+	assert (nResult > 0);
+	assert (nResult <= FRAME_BUFFER_SIZE);
 
 	assert (pBuffer != 0);
-	memcpy (pEntry->Buffer, pBuffer, nLength);
+	pNetBuffer->CopyTo (pBuffer);
 
-	pEntry->pParam = pParam;
+	pNetBuffer->Release ();
+
+	return nResult;
+}
+
+boolean CNetQueue::Enqueue (CNetBuffer *pBuffer, void *pParam)
+{
+	assert (pBuffer != 0);
+
+	u64 ullStamp = m_pPipelineStage != 0 ? CPipelineStage::Stamp () : 0;
 
 	m_SpinLock.Acquire ();
 
-	pEntry->pPrev = m_pLast;
+	if (   m_nHighWaterMark != 0
+	    && m_nCount >= m_nHighWaterMark)
+	{
+		m_nDropCount++;
+
+		m_SpinLock.Release ();
+
+		pBuffer->Release ();
+
+		return FALSE;
+	}
+
+	TNetQueueEntry *pEntry = AllocEntry ();
+	assert (pEntry != 0);
+
 	pEntry->pNext = 0;
+	pEntry->pBuffer = pBuffer;
+	pEntry->pParam = pParam;
+	pEntry->ullStamp = ullStamp;
 
 	if (m_pFirst == 0)
 	{
@@ -105,46 +154,93 @@ void CNetQueue::Enqueue (const void *pBuffer, unsigned nLength, void *pParam)
 	}
 	m_pLast = pEntry;
 
+	if (++m_nCount > m_nMaxCount)
+	{
+		m_nMaxCount = m_nCount;
+	}
+
 	m_SpinLock.Release ();
+
+	return TRUE;
 }
 
-unsigned CNetQueue::Dequeue (void *pBuffer, void **ppParam)
+CNetBuffer *CNetQueue::DequeueBuffer (void **ppParam)
 {
-	unsigned nResult = 0;
-	
-	if (m_pFirst != 0)
+	if (m_pFirst == 0)
 	{
-		m_SpinLock.Acquire ();
+		return 0;
+	}
 
-		volatile TNetQueueEntry *pEntry = m_pFirst;
-		assert (pEntry != 0);
+	m_SpinLock.Acquire ();
 
-		m_pFirst = pEntry->pNext;
-		if (m_pFirst != 0)
-		{
-			m_pFirst->pPrev = 0;
-		}
-		else
-		{
-			assert (m_pLast == pEntry);
-			m_pLast = 0;
-		}
+	TNetQueueEntry *pEntry = (TNetQueueEntry *) m_pFirst;
+	if (pEntry == 0)
+	{
+		m_SpinLock.Release ();
+
+		return 0;
+	}
 
+	m_pFirst = pEntry->pNext;
+	if (m_pFirst == 0)
+	{
+		assert (m_pLast == pEntry);
+		m_pLast = 0;
+	}
+
+	assert (m_nCount > 0);
+	m_nCount--;
+
+	CNetBuffer *pResult = pEntry->pBuffer;
+	assert (pResult != 0);
+
+	if (ppParam != 0)
+	{
+		*ppParam = pEntry->pParam;
+	}
+
+	u64 ullStamp = pEntry->ullStamp;
+
+	pEntry->pNext = m_pFreeList;
+	m_pFreeList = pEntry;
+
+	m_SpinLock.Release ();
+
+	CPipelineStage *pStage = m_pPipelineStage;
+	if (   pStage != 0
+	    && ullStamp != 0)
+	{
+		pStage->Complete (ullStamp, (uintptr) pResult);
+	}
+
+	return pResult;
+}
+
+TNetQueueEntry *CNetQueue::AllocEntry (void)
+{
+	if (m_pFreeList == 0)
+	{
+		// the spin lock is released while allocating from the heap
 		m_SpinLock.Release ();
 
-		nResult = pEntry->nLength;
-		assert (nResult > 0);
-		assert (nResult <= FRAME_BUFFER_SIZE);
+		TNetQueueSlab *pSlab = new TNetQueueSlab;
+		assert (pSlab != 0);
 
-		memcpy (pBuffer, (const void *) pEntry->Buffer, nResult);
+		m_SpinLock.Acquire ();
 
-		if (ppParam != 0)
+		pSlab->pNext = m_pSlabList;
+		m_pSlabList = pSlab;
+
+		for (unsigned i = 0; i < NET_QUEUE_SLAB_ENTRIES; i++)
 		{
-			*ppParam = pEntry->pParam;
+			pSlab->Entry[i].pNext = m_pFreeList;
+			m_pFreeList = &pSlab->Entry[i];
 		}
-
-		delete pEntry;
 	}
 
-	return nResult;
+	TNetQueueEntry *pEntry = m_pFreeList;
+	assert (pEntry != 0);
+	m_pFreeList = (TNetQueueEntry *) pEntry->pNext;
+
+	return pEntry;
 }
@@ -32,6 +32,9 @@ CNetSubSystem::CNetSubSystem (const u8 *pIPAddress, const u8 *pNetMask, const u8
 	m_LinkLayer (&m_Config, &m_NetDevLayer),
 	m_NetworkLayer (&m_Config, &m_LinkLayer),
 	m_TransportLayer (&m_Config, &m_NetworkLayer),
+#ifdef NET_IPV6
+	m_IPv6Layer (&m_NetDevLayer, &m_LinkLayer),
+#endif
 	m_bUseDHCP (pIPAddress == 0 ? TRUE : FALSE),
 	m_pDHCPClient (0)
 {
@@ -84,6 +87,13 @@ boolean CNetSubSystem::Initialize (boolean bWaitForActivate)
 
 	m_LinkLayer.AttachLayer (&m_NetworkLayer);
 
+#ifdef NET_IPV6
+	if (!m_IPv6Layer.Initialize ())
+	{
+		return FALSE;
+	}
+#endif
+
 	if (!m_TransportLayer.Initialize ())
 	{
 		return FALSE;
@@ -125,6 +135,10 @@ void CNetSubSystem::Process (void)
 
 	m_NetworkLayer.Process ();
 
+#ifdef NET_IPV6
+	m_IPv6Layer.Process ();
+#endif
+
 	m_TransportLayer.Process ();
 }
 
@@ -148,6 +162,15 @@ CNetworkLayer *CNetSubSystem::GetNetworkLayer (void)
 	return &m_NetworkLayer;
 }
 
+#ifdef NET_IPV6
+
+CIPv6Layer *CNetSubSystem::GetIPv6Layer (void)
+{
+	return &m_IPv6Layer;
+}
+
+#endif
+
 CTransportLayer *CNetSubSystem::GetTransportLayer (void)
 {
 	return &m_TransportLayer;
@@ -23,12 +23,25 @@
 #include <circle/util.h>
 #include <assert.h>
 
+// fields of the TCP header, which are modified on segmentation (GSO)
+#define TCP_SEQUENCE_NUMBER_OFFSET	4
+#define TCP_FLAGS_OFFSET		13
+#define TCP_FLAGS_FIN_PUSH		(1 << 0 | 1 << 3)
+#define TCP_CHECKSUM_OFFSET		16
+
+ASSERT_STATIC (NET_FLOW_HEADER_SIZE == sizeof (TEthernetHeader) + sizeof (TIPHeader));
+
 CNetworkLayer::CNetworkLayer (CNetConfig *pNetConfig, CLinkLayer *pLinkLayer)
 :	m_pNetConfig (pNetConfig),
 	m_pLinkLayer (pLinkLayer),
 	m_pICMPHandler (0),
 	m_pIGMPHandler (0),
-	m_pICMPRxQueue2 (0)
+	m_RxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_ICMPRxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_IGMPRxQueue (NET_QUEUE_HIGH_WATER_MARK),
+	m_pICMPRxQueue2 (0),
+	m_nNextIdentification (1),
+	m_nRouteGeneration (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pLinkLayer != 0);
@@ -68,191 +81,556 @@ void CNetworkLayer::Process (void)
 	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
 	assert (pOwnIPAddress != 0);
 
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	unsigned nResultLength;
+	CNetBuffer *pPacket;
 	assert (m_pLinkLayer != 0);
-	while (m_pLinkLayer->Receive (Buffer, &nResultLength))
+	while ((pPacket = m_pLinkLayer->Receive ()) != 0)
 	{
-		if (nResultLength <= sizeof (TIPHeader))
+		if (!ProcessPacket (pPacket, pOwnIPAddress))
 		{
-			continue;
+			pPacket->Release ();
 		}
-		TIPHeader *pHeader = (TIPHeader *) Buffer;
+	}
+
+	assert (m_pICMPHandler != 0);
+	m_pICMPHandler->Process ();
+
+	assert (m_pIGMPHandler != 0);
+	m_pIGMPHandler->Process ();
 
-		unsigned nHeaderLength = pHeader->nVersionIHL & 0xF;
-		if (   nHeaderLength < IP_HEADER_LENGTH_DWORD_MIN
-		    || nHeaderLength > IP_HEADER_LENGTH_DWORD_MAX)
+	m_Reassembly.Process ();
+}
+
+boolean CNetworkLayer::ProcessPacket (CNetBuffer *pPacket, const CIPAddress *pOwnIPAddress)
+{
+	assert (pPacket != 0);
+	assert (pPacket->GetNextSegment () == 0);
+	unsigned nResultLength = pPacket->GetLength ();
+	if (nResultLength <= sizeof (TIPHeader))
+	{
+		return FALSE;
+	}
+	TIPHeader *pHeader = (TIPHeader *) pPacket->GetData ();
+
+	unsigned nHeaderLength = pHeader->nVersionIHL & 0xF;
+	if (   nHeaderLength < IP_HEADER_LENGTH_DWORD_MIN
+	    || nHeaderLength > IP_HEADER_LENGTH_DWORD_MAX)
+	{
+		return FALSE;
+	}
+	nHeaderLength *= 4;
+	if (nResultLength <= nHeaderLength)
+	{
+		return FALSE;
+	}
+
+	if (   (   !pPacket->IsChecksumValid ()	// verified by the hardware too
+		&& CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength) != CHECKSUM_OK)
+	    || (pHeader->nVersionIHL >> 4) != IP_VERSION)
+	{
+		return FALSE;
+	}
+
+	CIPAddress IPAddressDestination (pHeader->DestinationAddress);
+	assert (pOwnIPAddress != 0);
+	if (!pOwnIPAddress->IsNull ())
+	{
+		assert (m_pNetConfig != 0);
+		if (   *pOwnIPAddress != IPAddressDestination
+		    && !IPAddressDestination.IsBroadcast ()
+		    && *m_pNetConfig->GetBroadcastAddress () != IPAddressDestination
+		    && !IPAddressDestination.IsMulticast ())
 		{
-			continue;
+			return FALSE;
 		}
-		nHeaderLength *= 4;
-		if (nResultLength <= nHeaderLength)
+	}
+	else
+	{
+		if (!IPAddressDestination.IsBroadcast ())
 		{
-			continue;
+			return FALSE;
 		}
+	}
 
-		if (   CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength) != CHECKSUM_OK
-		    || (pHeader->nVersionIHL >> 4) != IP_VERSION)
-		{
-			continue;
-		}
+	unsigned nTotalLength = le2be16 (pHeader->nTotalLength);
+	if (   nResultLength < nTotalLength
+	    || nTotalLength <= nHeaderLength)
+	{
+		return FALSE;
+	}
+	pPacket->Truncate (nTotalLength);		// ignore padding
 
-		CIPAddress IPAddressDestination (pHeader->DestinationAddress);
-		if (!pOwnIPAddress->IsNull ())
+	if (   (pHeader->nFlagsFragmentOffset & IP_FLAGS_MF)
+	    ||    IP_FRAGMENT_OFFSET (le2be16 (pHeader->nFlagsFragmentOffset))
+	       != IP_FRAGMENT_OFFSET_FIRST)
+	{
+		// the reference to the fragment is taken over from here
+		pPacket = m_Reassembly.AddFragment (pPacket);
+		if (pPacket == 0)
 		{
-			if (   *pOwnIPAddress != IPAddressDestination
-			    && !IPAddressDestination.IsBroadcast ()
-			    && *m_pNetConfig->GetBroadcastAddress () != IPAddressDestination
-			    && !IPAddressDestination.IsMulticast ())
-			{
-				continue;
-			}
-		}
-		else
-		{
-			if (!IPAddressDestination.IsBroadcast ())
-			{
-				continue;
-			}
+			return TRUE;			// datagram is not complete yet
 		}
 
-		if (   (pHeader->nFlagsFragmentOffset & IP_FLAGS_MF)
-		    ||    IP_FRAGMENT_OFFSET (le2be16 (pHeader->nFlagsFragmentOffset))
-		       != IP_FRAGMENT_OFFSET_FIRST)
+		// deliver the datagram in one buffer, if possible, only UDP can handle chains
+		if (pPacket->GetTotalLength () <= FRAME_BUFFER_SIZE)
 		{
-			continue;
+			CNetBuffer *pDatagram = CNetBuffer::Alloc ();
+			assert (pDatagram != 0);
+			pPacket->CopyTo (pDatagram->Append (pPacket->GetTotalLength ()));
+
+			pPacket->Release ();
+			pPacket = pDatagram;
 		}
-		
-		unsigned nTotalLength = le2be16 (pHeader->nTotalLength);
-		if (nResultLength < nTotalLength)
+		else if (((TIPHeader *) pPacket->GetData ())->nProtocol != IPPROTO_UDP)
 		{
-			continue;
+			pPacket->Release ();
+
+			return TRUE;
 		}
-		nResultLength = nTotalLength;		// ignore padding
 
-		TNetworkPrivateData *pParam = new TNetworkPrivateData;
-		assert (pParam != 0);
-		pParam->nProtocol = pHeader->nProtocol;
-		memcpy (pParam->SourceAddress, pHeader->SourceAddress, IP_ADDRESS_SIZE);
-		memcpy (pParam->DestinationAddress, pHeader->DestinationAddress, IP_ADDRESS_SIZE);
+		pHeader = (TIPHeader *) pPacket->GetData ();
+		nHeaderLength = (pHeader->nVersionIHL & 0xF) * 4;
+	}
 
-		nResultLength -= nHeaderLength;
+	TNetworkPrivateData *pParam = new TNetworkPrivateData;
+	assert (pParam != 0);
+	pParam->nProtocol = pHeader->nProtocol;
+	memcpy (pParam->SourceAddress, pHeader->SourceAddress, IP_ADDRESS_SIZE);
+	memcpy (pParam->DestinationAddress, pHeader->DestinationAddress, IP_ADDRESS_SIZE);
 
-		if (pHeader->nProtocol == IPPROTO_ICMP)
-		{
-			if (m_pICMPRxQueue2 != 0)
-			{
-				TNetworkPrivateData *pParam2 = new TNetworkPrivateData;
-				assert (pParam2 != 0);
-				memcpy (pParam2, pParam, sizeof *pParam);
+	pPacket->RemoveHeader (nHeaderLength);
 
-				m_pICMPRxQueue2->Enqueue (Buffer+nHeaderLength, nResultLength,
-							  pParam2);
-			}
+	CNetQueue *pRxQueue = &m_RxQueue;
 
-			m_ICMPRxQueue.Enqueue (Buffer+nHeaderLength, nResultLength, pParam);
-		}
-		else if (pHeader->nProtocol == IPPROTO_IGMP)
-		{
-			m_IGMPRxQueue.Enqueue (Buffer+nHeaderLength, nResultLength, pParam);
-		}
-		else
+	if (pParam->nProtocol == IPPROTO_ICMP)
+	{
+		if (m_pICMPRxQueue2 != 0)
 		{
-			m_RxQueue.Enqueue (Buffer+nHeaderLength, nResultLength, pParam);
+			TNetworkPrivateData *pParam2 = new TNetworkPrivateData;
+			assert (pParam2 != 0);
+			memcpy (pParam2, pParam, sizeof *pParam);
+
+			pPacket->AddRef ();		// the packet is shared by both queues
+			if (!m_pICMPRxQueue2->Enqueue (pPacket, pParam2))
+			{
+				delete pParam2;
+			}
 		}
+
+		pRxQueue = &m_ICMPRxQueue;
+	}
+	else if (pParam->nProtocol == IPPROTO_IGMP)
+	{
+		pRxQueue = &m_IGMPRxQueue;
 	}
 
-	assert (m_pICMPHandler != 0);
-	m_pICMPHandler->Process ();
+	if (!pRxQueue->Enqueue (pPacket, pParam))
+	{
+		delete pParam;
+	}
 
-	assert (m_pIGMPHandler != 0);
-	m_pIGMPHandler->Process ();
+	return TRUE;
 }
 
 boolean CNetworkLayer::Send (const CIPAddress &rReceiver, const void *pPacket, unsigned nLength,
 			     int nProtocol, boolean bRouterAlert)
 {
-	static const u8 RouterAlertOption[] =
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		return FALSE;
+	}
+
+	// reserve space for the IP and Ethernet header, so that the frame is aligned for DMA
+	unsigned nHeadroom =   NET_BUFFER_HEADROOM + sizeof (TEthernetHeader) + sizeof (TIPHeader)
+			     + (bRouterAlert ? IP_ROUTER_ALERT_SIZE : 0);
+
+	assert (pPacket != 0);
+	return Send (rReceiver, CNetBuffer::Alloc (pPacket, nLength, nHeadroom), nProtocol, bRouterAlert);
+}
+
+boolean CNetworkLayer::Send (const CIPAddress &rReceiver, CNetBuffer *pPacket,
+			     int nProtocol, boolean bRouterAlert)
+{
+	static const u8 RouterAlertOption[IP_ROUTER_ALERT_SIZE] =
 	{
 		0b1'00'10100,	// Copied, Control, Router Alert
 		0x04,		// Length
 		0x00, 0x00	// Multicast Listener Discovery
 	};
 
+	assert (pPacket != 0);
 	unsigned nHeaderLength = sizeof (TIPHeader) + (bRouterAlert ? sizeof RouterAlertOption : 0);
-	unsigned nPacketLength = nHeaderLength + nLength;		// may wrap
+	unsigned nPacketLength = nHeaderLength + pPacket->GetTotalLength ();
 	if (   nPacketLength <= nHeaderLength
-	    || nPacketLength > FRAME_BUFFER_SIZE)
+	    || nPacketLength > IP_MAX_DATAGRAM_SIZE)
 	{
+		pPacket->Release ();
+
 		return FALSE;
 	}
 
-	u8 PacketBuffer[nPacketLength];
-	TIPHeader *pHeader = (TIPHeader *) PacketBuffer;
+	unsigned nPathMTU = GetPathMTU (rReceiver);
+	if (nPacketLength > nPathMTU)
+	{
+		return SendFragmented (rReceiver, pPacket, nProtocol, nPathMTU);
+	}
 
-	pHeader->nVersionIHL          = IP_VERSION << 4 | nHeaderLength / 4;
-	pHeader->nTypeOfService       = IP_TOS_ROUTINE;
-	pHeader->nTotalLength         = le2be16 ((u16) nPacketLength);
-	pHeader->nIdentification      = BE (IP_IDENTIFICATION_DEFAULT);
-	pHeader->nFlagsFragmentOffset = IP_FLAGS_DF | BE (IP_FRAGMENT_OFFSET_FIRST);
-	pHeader->nTTL                 = rReceiver.IsMulticast () ? IP_TTL_MULTICAST : IP_TTL_DEFAULT;
-	pHeader->nProtocol            = (u8) nProtocol;
+	// prepend the header in place, if possible, otherwise chain a header segment in front
+	CNetBuffer *pPacketBuffer = pPacket;
+	if (pPacket->GetHeadroom () < nHeaderLength + sizeof (TEthernetHeader))
+	{
+		if (pPacket->IsChecksumPartial ())
+		{
+			// the request cannot be moved to the header segment
+			CChecksumCalculator::CompletePartial (pPacket);
+		}
+
+		pPacketBuffer = CNetBuffer::Alloc (NET_BUFFER_HEADROOM + sizeof (TEthernetHeader)
+						   + nHeaderLength);
+		assert (pPacketBuffer != 0);
+		pPacketBuffer->AppendSegment (pPacket);
+	}
+
+	TIPHeader *pHeader = (TIPHeader *) pPacketBuffer->Prepend (nHeaderLength);
 
 	if (bRouterAlert)
 	{
 		memcpy (pHeader+1, RouterAlertOption, sizeof RouterAlertOption);
 	}
 
+	// DF is set for path MTU discovery (RFC 1191), until the minimum has been reached
+	SetupHeader (pHeader, nHeaderLength, nPacketLength, BE (IP_IDENTIFICATION_DEFAULT),
+		       (nPathMTU > IP_MTU_MIN ? IP_FLAGS_DF : 0)
+		     | BE (IP_FRAGMENT_OFFSET_FIRST), rReceiver, nProtocol);
+
+	return SendPacket (rReceiver, pPacketBuffer);
+}
+
+boolean CNetworkLayer::SendPacket (const CIPAddress &rReceiver, CNetBuffer *pPacketBuffer)
+{
+	assert (pPacketBuffer != 0);
+
 	assert (m_pNetConfig != 0);
 	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
 	assert (pOwnIPAddress != 0);
 
-	pOwnIPAddress->CopyTo (pHeader->SourceAddress);
+	if (   pOwnIPAddress->IsNull ()
+	    && !rReceiver.IsBroadcast ())
+	{
+		SendFailed (ICMP_CODE_DEST_NET_UNREACH, pPacketBuffer);
 
-	rReceiver.CopyTo (pHeader->DestinationAddress);
+		pPacketBuffer->Release ();
 
-	pHeader->nHeaderChecksum = 0;
-	pHeader->nHeaderChecksum = CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength);
+		return FALSE;
+	}
 
-	assert (pPacket != 0);
-	assert (nLength > 0);
-	memcpy (PacketBuffer+nHeaderLength, pPacket, nLength);
+	CIPAddress GatewayIP;
+	const CIPAddress *pNextHop = GetNextHop (rReceiver, &GatewayIP);
+	if (pNextHop == 0)
+	{
+		SendFailed (ICMP_CODE_DEST_NET_UNREACH, pPacketBuffer);
 
-	if (   pOwnIPAddress->IsNull ()
-	    && !rReceiver.IsBroadcast ())
+		pPacketBuffer->Release ();
+
+		return FALSE;
+	}
+	
+	assert (m_pLinkLayer != 0);
+	return m_pLinkLayer->Send (*pNextHop, pPacketBuffer);
+}
+
+const CIPAddress *CNetworkLayer::GetNextHop (const CIPAddress &rReceiver,
+					     CIPAddress *pGatewayIP) const
+{
+	assert (m_pNetConfig != 0);
+	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
+	assert (pOwnIPAddress != 0);
+
+	if (   rReceiver.IsMulticast ()
+	    || pOwnIPAddress->OnSameNetwork (rReceiver, m_pNetConfig->GetNetMask ()))
+	{
+		return &rReceiver;
+	}
+
+	const u8 *pGateway = m_RouteCache.GetRoute (rReceiver.Get ());
+	if (pGateway != 0)
+	{
+		assert (pGatewayIP != 0);
+		pGatewayIP->Set (pGateway);
+
+		return pGatewayIP;
+	}
+
+	const CIPAddress *pDefaultGateway = m_pNetConfig->GetDefaultGateway ();
+	assert (pDefaultGateway != 0);
+	if (pDefaultGateway->IsNull ())
 	{
-		SendFailed (ICMP_CODE_DEST_NET_UNREACH, PacketBuffer, nPacketLength);
+		return 0;
+	}
+
+	return pDefaultGateway;
+}
+
+boolean CNetworkLayer::SendFlow (CNetFlow *pFlow, const CIPAddress &rReceiver,
+				 CNetBuffer *pPacket, int nProtocol)
+{
+	assert (pFlow != 0);
+	if (!IsFlowValid (pFlow, rReceiver, nProtocol))
+	{
+		BuildFlow (pFlow, rReceiver, nProtocol);
+	}
+
+	assert (pPacket != 0);
+	unsigned nPacketLength = sizeof (TIPHeader) + pPacket->GetTotalLength ();
+	if (   !pFlow->m_bValid
+	    || nPacketLength <= sizeof (TIPHeader)
+	    || nPacketLength > pFlow->m_nMTU
+	    || pPacket->GetHeadroom () < NET_FLOW_HEADER_SIZE)
+	{
+		return Send (rReceiver, pPacket, nProtocol);
+	}
 
+	// the frame header is a copy of the template, with the total length filled in
+	u8 *pFrame = (u8 *) pPacket->Prepend (NET_FLOW_HEADER_SIZE);
+	memcpy (pFrame, pFlow->m_Header, NET_FLOW_HEADER_SIZE);
+
+	TIPHeader *pHeader = (TIPHeader *) (pFrame + sizeof (TEthernetHeader));
+	pHeader->nTotalLength = le2be16 ((u16) nPacketLength);
+
+	// incremental update of the header checksum (RFC 1624)
+	u32 nSum = (u16) ~pFlow->m_nHeaderChecksum + (u32) pHeader->nTotalLength;
+	nSum = (nSum & 0xFFFF) + (nSum >> 16);
+	pHeader->nHeaderChecksum = (u16) ~nSum;
+
+	assert (m_pLinkLayer != 0);
+	m_pLinkLayer->SendFlowFrame (pPacket, pFlow->m_nNeighbor);
+
+	return TRUE;
+}
+
+boolean CNetworkLayer::IsFlowValid (const CNetFlow *pFlow, const CIPAddress &rReceiver,
+				    int nProtocol) const
+{
+	assert (pFlow != 0);
+	if (!pFlow->m_bValid)
+	{
 		return FALSE;
 	}
 
+	const TIPHeader *pHeader = (const TIPHeader *) (pFlow->m_Header + sizeof (TEthernetHeader));
+
+	assert (m_pNetConfig != 0);
+	assert (m_pLinkLayer != 0);
+	return    pFlow->m_nRouteGeneration == m_nRouteGeneration
+	       && pFlow->m_nNeighborGeneration == m_pLinkLayer->GetNeighborGeneration ()
+	       && pFlow->m_nProtocol == nProtocol
+	       && pFlow->m_Destination == rReceiver
+	       && *m_pNetConfig->GetIPAddress () == pHeader->SourceAddress;
+}
+
+void CNetworkLayer::BuildFlow (CNetFlow *pFlow, const CIPAddress &rReceiver, int nProtocol)
+{
+	assert (pFlow != 0);
+	pFlow->m_bValid = FALSE;
+
+	// packets to ourself and broadcasts are always sent the normal way
+	assert (m_pNetConfig != 0);
+	const CIPAddress *pOwnIPAddress = m_pNetConfig->GetIPAddress ();
+	assert (pOwnIPAddress != 0);
+	if (   pOwnIPAddress->IsNull ()
+	    || rReceiver.IsNull ()
+	    || rReceiver.IsBroadcast ()
+	    || rReceiver == *m_pNetConfig->GetBroadcastAddress ()
+	    || rReceiver == *pOwnIPAddress)
+	{
+		return;
+	}
+
+	// read the generations first, so that a change while building invalidates the flow
+	assert (m_pLinkLayer != 0);
+	pFlow->m_nRouteGeneration = m_nRouteGeneration;
+	pFlow->m_nNeighborGeneration = m_pLinkLayer->GetNeighborGeneration ();
+
 	CIPAddress GatewayIP;
-	const CIPAddress *pNextHop = &rReceiver;
-	if (   !rReceiver.IsMulticast ()
-	    && !pOwnIPAddress->OnSameNetwork (rReceiver, m_pNetConfig->GetNetMask ()))
+	const CIPAddress *pNextHop = GetNextHop (rReceiver, &GatewayIP);
+	if (   pNextHop == 0
+	    || !m_pLinkLayer->SetupFlowHeader (*pNextHop, (TEthernetHeader *) pFlow->m_Header,
+					       &pFlow->m_nNeighbor))
+	{
+		return;
+	}
+
+	pFlow->m_nMTU = GetPathMTU (rReceiver);
+
+	// the template has a total length of 0, which is added to the checksum on send
+	TIPHeader *pHeader = (TIPHeader *) (pFlow->m_Header + sizeof (TEthernetHeader));
+	SetupHeader (pHeader, sizeof (TIPHeader), 0, BE (IP_IDENTIFICATION_DEFAULT),
+		       (pFlow->m_nMTU > IP_MTU_MIN ? IP_FLAGS_DF : 0)
+		     | BE (IP_FRAGMENT_OFFSET_FIRST), rReceiver, nProtocol);
+	pFlow->m_nHeaderChecksum = pHeader->nHeaderChecksum;
+
+	pFlow->m_nProtocol = nProtocol;
+	pFlow->m_Destination.Set (rReceiver);
+	pFlow->m_bValid = TRUE;
+}
+
+boolean CNetworkLayer::SendFragmented (const CIPAddress &rReceiver, CNetBuffer *pPacket,
+				       int nProtocol, unsigned nMTU)
+{
+	assert (pPacket != 0);
+
+	// the checksum cannot be completed by the hardware over multiple fragments
+	if (pPacket->IsChecksumPartial ())
+	{
+		CChecksumCalculator::CompletePartial (pPacket);
+	}
+
+	// the data of all fragments, but the last one, must be a multiple of 8 bytes
+	assert (nMTU >= IP_MTU_MIN);
+	unsigned nFragmentSize = (nMTU - sizeof (TIPHeader)) & ~7U;
+	assert (nFragmentSize <= FRAME_BUFFER_SIZE);
+
+	u16 nIdentification = m_nNextIdentification++;
+	if (m_nNextIdentification == IP_IDENTIFICATION_DEFAULT)
+	{
+		m_nNextIdentification++;
+	}
+
+	boolean bOK = TRUE;
+	unsigned nTotalLength = pPacket->GetTotalLength ();
+	for (unsigned nOffset = 0; bOK && nOffset < nTotalLength; nOffset += nFragmentSize)
+	{
+		unsigned nLength = nTotalLength - nOffset;
+		u16 nFlagsFragmentOffset = le2be16 ((u16) (nOffset / 8));
+		if (nLength > nFragmentSize)
+		{
+			nLength = nFragmentSize;
+			nFlagsFragmentOffset |= IP_FLAGS_MF;
+		}
+
+		// reserve space for the IP and Ethernet header, so that the frame is aligned for DMA
+		CNetBuffer *pFragment = CNetBuffer::Alloc (  NET_BUFFER_HEADROOM
+							   + sizeof (TEthernetHeader)
+							   + sizeof (TIPHeader));
+		assert (pFragment != 0);
+		pPacket->CopyTo (pFragment->Append (nLength), nLength, nOffset);
+
+		TIPHeader *pHeader = (TIPHeader *) pFragment->Prepend (sizeof (TIPHeader));
+		SetupHeader (pHeader, sizeof (TIPHeader), sizeof (TIPHeader) + nLength,
+			     le2be16 (nIdentification), nFlagsFragmentOffset, rReceiver, nProtocol);
+
+		bOK = SendPacket (rReceiver, pFragment);
+	}
+
+	pPacket->Release ();
+
+	return bOK;
+}
+
+void CNetworkLayer::SetupHeader (TIPHeader *pHeader, unsigned nHeaderLength, unsigned nPacketLength,
+				 u16 nIdentification, u16 nFlagsFragmentOffset,
+				 const CIPAddress &rReceiver, int nProtocol)
+{
+	assert (pHeader != 0);
+
+	pHeader->nVersionIHL          = IP_VERSION << 4 | nHeaderLength / 4;
+	pHeader->nTypeOfService       = IP_TOS_ROUTINE;
+	pHeader->nTotalLength         = le2be16 ((u16) nPacketLength);
+	pHeader->nIdentification      = nIdentification;
+	pHeader->nFlagsFragmentOffset = nFlagsFragmentOffset;
+	pHeader->nTTL                 = rReceiver.IsMulticast () ? IP_TTL_MULTICAST : IP_TTL_DEFAULT;
+	pHeader->nProtocol            = (u8) nProtocol;
+
+	assert (m_pNetConfig != 0);
+	m_pNetConfig->GetIPAddress ()->CopyTo (pHeader->SourceAddress);
+
+	rReceiver.CopyTo (pHeader->DestinationAddress);
+
+	pHeader->nHeaderChecksum = 0;
+	pHeader->nHeaderChecksum = CChecksumCalculator::SimpleCalculate (pHeader, nHeaderLength);
+}
+
+boolean CNetworkLayer::SendSegmented (const CIPAddress &rReceiver, CNetBuffer *pSegments,
+				      int nProtocol, CNetFlow *pFlow)
+{
+	assert (pSegments != 0);
+	assert (nProtocol == IPPROTO_TCP);
+
+	const u8 *pTemplate = pSegments->GetData ();
+	unsigned nHeaderLength = pSegments->GetLength ();
+	assert (nHeaderLength >= TCP_CHECKSUM_OFFSET + 2);
+
+	u32 nSequenceNumber;
+	memcpy (&nSequenceNumber, pTemplate + TCP_SEQUENCE_NUMBER_OFFSET, sizeof nSequenceNumber);
+	nSequenceNumber = be2le32 (nSequenceNumber);
+
+	boolean bTxChecksum = GetCapabilities () & NET_DEVICE_CAP_TX_CHECKSUM ? TRUE : FALSE;
+
+	assert (m_pNetConfig != 0);
+	CChecksumCalculator Checksum (*m_pNetConfig->GetIPAddress (), rReceiver, nProtocol);
+
+	boolean bOK = TRUE;
+	CNetBuffer *pPayload = pSegments->DetachSegments ();
+	while (pPayload != 0)
 	{
-		const u8 *pGateway = m_RouteCache.GetRoute (rReceiver.Get ());
-		if (pGateway != 0)
+		CNetBuffer *pNext = pPayload->DetachSegments ();
+
+		if (!bOK)
 		{
-			GatewayIP.Set (pGateway);
+			pPayload->Release ();
+			pPayload = pNext;
 
-			pNextHop = &GatewayIP;
+			continue;
 		}
-		else
+
+		unsigned nDataLength = pPayload->GetLength ();
+		assert (nDataLength > 0);
+		if (pPayload->GetHeadroom () < nHeaderLength)
 		{
-			pNextHop = m_pNetConfig->GetDefaultGateway ();
-			if (pNextHop->IsNull ())
-			{
-				SendFailed (ICMP_CODE_DEST_NET_UNREACH, PacketBuffer, nPacketLength);
+			pPayload->Release ();
+			pPayload = pNext;
+			bOK = FALSE;
 
-				return FALSE;
-			}
+			continue;
+		}
+
+		u8 *pHeader = (u8 *) pPayload->Prepend (nHeaderLength);
+		memcpy (pHeader, pTemplate, nHeaderLength);
+
+		u32 nSequenceNumberBE = le2be32 (nSequenceNumber);
+		memcpy (pHeader + TCP_SEQUENCE_NUMBER_OFFSET, &nSequenceNumberBE, sizeof nSequenceNumberBE);
+
+		// only the last segment carries PSH and FIN
+		if (pNext != 0)
+		{
+			pHeader[TCP_FLAGS_OFFSET] &= ~TCP_FLAGS_FIN_PUSH;
+		}
+
+		u16 nChecksum;
+		if (bTxChecksum)
+		{
+			// the checksum will be completed by the hardware
+			nChecksum = Checksum.CalculatePseudoHeader (nHeaderLength + nDataLength);
+			memcpy (pHeader + TCP_CHECKSUM_OFFSET, &nChecksum, sizeof nChecksum);
+			pPayload->SetChecksumPartial (pHeader, TCP_CHECKSUM_OFFSET);
 		}
+		else
+		{
+			memset (pHeader + TCP_CHECKSUM_OFFSET, 0, sizeof nChecksum);
+			nChecksum = Checksum.Calculate (pHeader, nHeaderLength + nDataLength);
+			memcpy (pHeader + TCP_CHECKSUM_OFFSET, &nChecksum, sizeof nChecksum);
+		}
+
+		bOK = pFlow != 0 ? SendFlow (pFlow, rReceiver, pPayload, nProtocol)
+				 : Send (rReceiver, pPayload, nProtocol);
+
+		nSequenceNumber += nDataLength;
+		pPayload = pNext;
 	}
-	
-	assert (m_pLinkLayer != 0);
-	assert (pNextHop != 0);
-	return m_pLinkLayer->Send (*pNextHop, PacketBuffer, nPacketLength);
+
+	pSegments->Release ();
+
+	return bOK;
 }
 
 boolean CNetworkLayer::Receive (void *pBuffer, unsigned *pResultLength,
@@ -285,6 +663,32 @@ boolean CNetworkLayer::Receive (void *pBuffer, unsigned *pResultLength,
 	return TRUE;
 }
 
+CNetBuffer *CNetworkLayer::Receive (CIPAddress *pSender, CIPAddress *pReceiver, int *pProtocol)
+{
+	void *pParam;
+	CNetBuffer *pPacket = m_RxQueue.DequeueBuffer (&pParam);
+	if (pPacket == 0)
+	{
+		return 0;
+	}
+
+	TNetworkPrivateData *pData = (TNetworkPrivateData *) pParam;
+	assert (pData != 0);
+
+	assert (pProtocol != 0);
+	*pProtocol = pData->nProtocol;
+
+	assert (pSender != 0);
+	pSender->Set (pData->SourceAddress);
+
+	assert (pReceiver != 0);
+	pReceiver->Set (pData->DestinationAddress);
+
+	delete pData;
+
+	return pPacket;
+}
+
 boolean CNetworkLayer::ReceiveNotification (TICMPNotificationType *pType,
 					    CIPAddress *pSender, CIPAddress *pReceiver,
 					    u16 *pSendPort, u16 *pReceivePort,
@@ -325,7 +729,7 @@ void CNetworkLayer::EnableReceiveICMP (boolean bEnable)
 	{
 		if (m_pICMPRxQueue2 == 0)
 		{
-			m_pICMPRxQueue2 = new CNetQueue;
+			m_pICMPRxQueue2 = new CNetQueue (NET_QUEUE_HIGH_WATER_MARK);
 			assert (m_pICMPRxQueue2 != 0);
 		}
 	}
@@ -381,21 +785,60 @@ boolean CNetworkLayer::ReceiveICMP (void *pBuffer, unsigned *pResultLength,
 	return TRUE;
 }
 
-boolean CNetworkLayer::JoinHostGroup (const CIPAddress &rGroupAddress)
+boolean CNetworkLayer::JoinHostGroup (const CIPAddress &rGroupAddress,
+				      const CIPAddress *pSourceAddress)
 {
 	assert (m_pIGMPHandler != 0);
-	return m_pIGMPHandler->JoinHostGroup (rGroupAddress);
+	return m_pIGMPHandler->JoinHostGroup (rGroupAddress, pSourceAddress);
 }
 
-boolean CNetworkLayer::LeaveHostGroup (const CIPAddress &rGroupAddress)
+boolean CNetworkLayer::LeaveHostGroup (const CIPAddress &rGroupAddress,
+				       const CIPAddress *pSourceAddress)
 {
 	assert (m_pIGMPHandler != 0);
-	return m_pIGMPHandler->LeaveHostGroup (rGroupAddress);
+	return m_pIGMPHandler->LeaveHostGroup (rGroupAddress, pSourceAddress);
+}
+
+unsigned CNetworkLayer::GetCapabilities (void) const
+{
+	assert (m_pLinkLayer != 0);
+	return m_pLinkLayer->GetCapabilities ();
 }
 
 void CNetworkLayer::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 {
 	m_RouteCache.AddRoute (pDestIP, pGatewayIP);
+
+	m_nRouteGeneration++;
+}
+
+unsigned CNetworkLayer::GetPathMTU (const CIPAddress &rReceiver) const
+{
+	if (   rReceiver.IsMulticast ()
+	    || rReceiver.IsBroadcast ())
+	{
+		return IP_MTU_DEFAULT;
+	}
+
+	unsigned nMTU = m_RouteCache.GetPathMTU (rReceiver.Get ());
+
+	return nMTU != 0 ? nMTU : IP_MTU_DEFAULT;
+}
+
+void CNetworkLayer::PathMTUReduced (const u8 *pDestIP, unsigned nMTU)
+{
+	if (nMTU < IP_MTU_MIN)
+	{
+		nMTU = IP_MTU_MIN;
+	}
+
+	CIPAddress DestIP (pDestIP);
+	if (nMTU < GetPathMTU (DestIP))
+	{
+		m_RouteCache.SetPathMTU (pDestIP, nMTU);
+
+		m_nRouteGeneration++;
+	}
 }
 
 const u8 *CNetworkLayer::GetGateway (const u8 *pDestIP) const
@@ -418,3 +861,26 @@ void CNetworkLayer::SendFailed (unsigned nICMPCode, const void *pReturnedPacket,
 	assert (m_pICMPHandler != 0);
 	m_pICMPHandler->DestinationUnreachable (nICMPCode, pReturnedPacket, nLength);
 }
+
+void CNetworkLayer::SendFailed (unsigned nICMPCode, const CNetBuffer *pReturnedPacket)
+{
+	assert (pReturnedPacket != 0);
+	if (pReturnedPacket->GetNextSegment () == 0)
+	{
+		SendFailed (nICMPCode, pReturnedPacket->GetData (), pReturnedPacket->GetLength ());
+
+		return;
+	}
+
+	// the ICMP handler needs the IP header and the start of the data only
+	unsigned nLength = pReturnedPacket->GetTotalLength ();
+	if (nLength > FRAME_BUFFER_SIZE)
+	{
+		nLength = FRAME_BUFFER_SIZE;
+	}
+
+	u8 Buffer[nLength];
+	pReturnedPacket->CopyTo (Buffer, nLength, 0);
+
+	SendFailed (nICMPCode, Buffer, nLength);
+}
@@ -0,0 +1,855 @@
+//
+// ptpclient.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/ptpclient.h>
+#include <circle/net/socket.h>
+#include <circle/net/socketpoller.h>
+#include <circle/net/ipaddress.h>
+#include <circle/net/in.h>
+#include <circle/sched/scheduler.h>
+#include <circle/macaddress.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define PTP_EVENT_PORT		319
+#define PTP_GENERAL_PORT	320
+
+#define PTP_VERSION		2
+
+// message types
+#define PTP_SYNC		0x0
+#define PTP_DELAY_REQ		0x1
+#define PTP_FOLLOW_UP		0x8
+#define PTP_DELAY_RESP		0x9
+#define PTP_ANNOUNCE		0xB
+
+// message lengths
+#define PTP_HEADER_LENGTH	34
+#define PTP_SYNC_LENGTH		44
+#define PTP_DELAY_REQ_LENGTH	44
+#define PTP_FOLLOW_UP_LENGTH	44
+#define PTP_DELAY_RESP_LENGTH	54
+#define PTP_ANNOUNCE_LENGTH	64
+
+// header fields
+#define PTP_OFFSET_TYPE		0
+#define PTP_OFFSET_VERSION	1
+#define PTP_OFFSET_LENGTH	2
+#define PTP_OFFSET_DOMAIN	4
+#define PTP_OFFSET_FLAGS	6
+	#define PTP_FLAG_TWO_STEP	(1 << 9)
+	#define PTP_FLAG_UTC_VALID	(1 << 2)
+	#define PTP_FLAG_PTP_TIMESCALE	(1 << 3)
+#define PTP_OFFSET_CORRECTION	8
+#define PTP_OFFSET_PORT_ID	20
+#define PTP_OFFSET_SEQUENCE_ID	30
+#define PTP_OFFSET_CONTROL	32
+#define PTP_OFFSET_LOG_INTERVAL	33
+
+// body fields
+#define PTP_OFFSET_TIMESTAMP	34		// origin or receive timestamp
+#define PTP_OFFSET_UTC_OFFSET	44		// Announce
+#define PTP_OFFSET_PRIORITY	47		// Announce: priority1 ... grandmasterIdentity
+#define PTP_OFFSET_REQ_PORT_ID	44		// Delay_Resp
+
+#define PTP_SERVO_KP		7		// proportional constant * 10
+#define PTP_SERVO_KI		3		// integral constant * 10
+#define PTP_MAX_PPB		500000
+
+#define PTP_STEP_THRESHOLD	10000000	// ns, clock is stepped above
+#define PTP_LOCK_THRESHOLD_HW	1000		// ns, synchronized below
+#define PTP_LOCK_THRESHOLD_SW	100000		// ns
+#define PTP_LOCK_COUNT		4		// consecutive samples below threshold
+#define PTP_OUTLIER_COUNT	3		// max. consecutive ignored samples
+
+#define PTP_ANNOUNCE_TIMEOUT	6000000		// us
+#define PTP_DELAY_RESP_TIMEOUT	1000000		// us
+#define PTP_TX_TIMESTAMP_TIMEOUT 50000		// us
+
+#define PTP_DEFAULT_UTC_OFFSET	37		// TAI - UTC in seconds (since 2017)
+
+#define PTP_SYSTEM_TIME_PERIOD	60		// seconds, CTimer is updated
+
+static const u8 PTPPrimaryMulticast[] = {224, 0, 1, 129};
+
+LOGMODULE ("ptp");
+
+CPTPClient::CPTPClient (CNetSubSystem *pNetSubSystem, u8 uchDomain)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_uchDomain (uchDomain),
+	m_pNetDevice (0),
+	m_bHardware (FALSE),
+	m_pEventSocket (0),
+	m_bMasterValid (FALSE),
+	m_nUTCOffset (PTP_DEFAULT_UTC_OFFSET),
+	m_bPTPTimescale (TRUE),
+	m_bSyncPending (FALSE),
+	m_nLastSyncOrigin (0),
+	m_bDelayReqPending (FALSE),
+	m_usDelaySequenceId (0),
+	m_bDelayValid (FALSE),
+	m_nMeanPathDelay (0),
+	m_bSynchronized (FALSE),
+	m_nLockedCount (0),
+	m_nOutlierCount (0),
+	m_nOffset (0),
+	m_nDrift (0),
+	m_nFrequency (0),
+	m_nRefTime (0),
+	m_nRefTicks (0),
+	m_nRefPPB (0),
+	m_bRefValid (FALSE),
+	m_nLastSystemTimeUpdate (0)
+{
+	assert (m_pNetSubSystem != 0);
+
+	memset (m_PortIdentity, 0, sizeof m_PortIdentity);
+
+	SetName ("ptp");
+}
+
+CPTPClient::~CPTPClient (void)
+{
+	m_pEventSocket = 0;
+	m_pNetSubSystem = 0;
+	m_pNetDevice = 0;
+}
+
+void CPTPClient::Run (void)
+{
+	assert (m_pNetSubSystem != 0);
+	while (!m_pNetSubSystem->IsRunning ())
+	{
+		CScheduler::Get ()->MsSleep (100);
+	}
+
+	CNetDeviceLayer *pNetDeviceLayer = m_pNetSubSystem->GetNetDeviceLayer ();
+	assert (pNetDeviceLayer != 0);
+	m_pNetDevice = pNetDeviceLayer->GetNetDevice ();
+	assert (m_pNetDevice != 0);
+
+	m_bHardware = !!(m_pNetDevice->GetCapabilities () & NET_DEVICE_CAP_PTP_TIMESTAMP);
+
+	// software clock starts with the system time
+	if (!m_bHardware)
+	{
+		unsigned nSeconds, nMicroSeconds;
+		CTimer::Get ()->GetUniversalTime (&nSeconds, &nMicroSeconds);
+
+		m_nRefTicks = CTimer::GetClockTicks64 ();
+		m_nRefTime = (nSeconds + PTP_DEFAULT_UTC_OFFSET) * 1000000000ULL
+			     + nMicroSeconds * 1000ULL;
+		m_bRefValid = TRUE;
+	}
+
+	// clock identity is the EUI-64 derived from the MAC address, port number is 1
+	const CMACAddress *pMACAddress = pNetDeviceLayer->GetMACAddress ();
+	assert (pMACAddress != 0);
+	const u8 *pMAC = pMACAddress->Get ();
+	m_PortIdentity[0] = pMAC[0];
+	m_PortIdentity[1] = pMAC[1];
+	m_PortIdentity[2] = pMAC[2];
+	m_PortIdentity[3] = 0xFF;
+	m_PortIdentity[4] = 0xFE;
+	m_PortIdentity[5] = pMAC[3];
+	m_PortIdentity[6] = pMAC[4];
+	m_PortIdentity[7] = pMAC[5];
+	m_PortIdentity[9] = 1;
+
+	CSocket EventSocket (m_pNetSubSystem, IPPROTO_UDP);
+	CSocket GeneralSocket (m_pNetSubSystem, IPPROTO_UDP);
+	CIPAddress GroupAddress (PTPPrimaryMulticast);
+	if (   EventSocket.Bind (PTP_EVENT_PORT) < 0
+	    || GeneralSocket.Bind (PTP_GENERAL_PORT) < 0
+	    || EventSocket.SetOptionAddMembership (GroupAddress) < 0
+	    || GeneralSocket.SetOptionAddMembership (GroupAddress) < 0)
+	{
+		LOGERR ("Cannot open sockets");
+
+		return;
+	}
+
+	m_pEventSocket = &EventSocket;
+
+	CSocketPoller Poller (2);
+	Poller.Add (&EventSocket, SOCKET_POLL_READABLE);
+	Poller.Add (&GeneralSocket, SOCKET_POLL_READABLE);
+
+	LOGNOTE ("Listening on domain %u (%s timestamps)", (unsigned) m_uchDomain,
+		 m_bHardware ? "hardware" : "software");
+
+	while (1)
+	{
+		CSocketPoller::TEvent Events[2];
+		int nEvents = Poller.Wait (Events, 2, 100000);
+
+		for (int i = 0; i < nEvents; i++)
+		{
+			CSocket *pSocket = Events[i].pSocket;
+			assert (pSocket != 0);
+
+			u8 Buffer[FRAME_BUFFER_SIZE];
+			CIPAddress Sender;
+			u16 usSenderPort;
+			int nResult;
+			while ((nResult = pSocket->ReceiveFrom (Buffer, sizeof Buffer, MSG_DONTWAIT,
+								&Sender, &usSenderPort)) > 0)
+			{
+				// software timestamp as close to the reception as possible
+				u64 nRxTime = m_bHardware ? 0 : MapClockTicks (CTimer::GetClockTicks64 ());
+
+				ProcessMessage (Buffer, nResult, nRxTime);
+			}
+		}
+
+		unsigned nTicks = CTimer::GetClockTicks ();
+
+		if (   m_bMasterValid
+		    && nTicks - m_nLastAnnounceTicks >= PTP_ANNOUNCE_TIMEOUT)
+		{
+			LOGWARN ("Master lost");
+
+			ReleaseMaster ();
+		}
+
+		if (   m_bDelayReqPending
+		    && nTicks - m_nDelayReqTicks >= PTP_DELAY_RESP_TIMEOUT)
+		{
+			m_bDelayReqPending = FALSE;
+		}
+
+		if (m_bHardware)
+		{
+			SampleLocalClock ();
+		}
+
+		UpdateSystemTime ();
+	}
+}
+
+boolean CPTPClient::IsSynchronized (void) const
+{
+	return m_bSynchronized;
+}
+
+boolean CPTPClient::IsHardwareTimestamping (void) const
+{
+	return m_bHardware;
+}
+
+boolean CPTPClient::GetTime (u64 *pNanoSeconds)
+{
+	if (!m_bSynchronized)
+	{
+		return FALSE;
+	}
+
+	assert (pNanoSeconds != 0);
+	*pNanoSeconds = GetLocalTime ();
+
+	return TRUE;
+}
+
+boolean CPTPClient::ConvertClockTicks (u64 nClockTicks, u64 *pNanoSeconds)
+{
+	if (   !m_bSynchronized
+	    || !m_bRefValid)
+	{
+		return FALSE;
+	}
+
+	assert (pNanoSeconds != 0);
+	*pNanoSeconds = MapClockTicks (nClockTicks);
+
+	return TRUE;
+}
+
+s64 CPTPClient::GetOffsetFromMaster (void) const
+{
+	return m_nOffset;
+}
+
+s64 CPTPClient::GetMeanPathDelay (void) const
+{
+	return m_nMeanPathDelay;
+}
+
+int CPTPClient::GetFrequencyCorrection (void) const
+{
+	return m_nFrequency;
+}
+
+void CPTPClient::ProcessMessage (const u8 *pMessage, unsigned nLength, u64 nRxTime)
+{
+	assert (pMessage != 0);
+	if (   nLength < PTP_HEADER_LENGTH
+	    || (pMessage[PTP_OFFSET_VERSION] & 0x0F) != PTP_VERSION
+	    || pMessage[PTP_OFFSET_DOMAIN] != m_uchDomain)
+	{
+		return;
+	}
+
+	unsigned nMessageLength = pMessage[PTP_OFFSET_LENGTH] << 8 | pMessage[PTP_OFFSET_LENGTH+1];
+	if (nMessageLength > nLength)
+	{
+		return;
+	}
+
+	u8 uchType = pMessage[PTP_OFFSET_TYPE] & 0x0F;
+	if (uchType == PTP_ANNOUNCE)
+	{
+		ProcessAnnounce (pMessage, nMessageLength);
+
+		return;
+	}
+
+	// other messages are accepted from the selected master only
+	if (   !m_bMasterValid
+	    || memcmp (pMessage + PTP_OFFSET_PORT_ID, m_MasterPortIdentity,
+		       PTP_PORT_IDENTITY_SIZE) != 0)
+	{
+		return;
+	}
+
+	switch (uchType)
+	{
+	case PTP_SYNC:
+		ProcessSync (pMessage, nMessageLength, nRxTime);
+		break;
+
+	case PTP_FOLLOW_UP:
+		ProcessFollowUp (pMessage, nMessageLength);
+		break;
+
+	case PTP_DELAY_RESP:
+		ProcessDelayResp (pMessage, nMessageLength);
+		break;
+
+	default:
+		break;
+	}
+}
+
+void CPTPClient::ProcessAnnounce (const u8 *pMessage, unsigned nLength)
+{
+	if (nLength < PTP_ANNOUNCE_LENGTH)
+	{
+		return;
+	}
+
+	const u8 *pPortIdentity = pMessage + PTP_OFFSET_PORT_ID;
+	const u8 *pPriority = pMessage + PTP_OFFSET_PRIORITY;
+
+	if (   !m_bMasterValid
+	    || memcmp (pPortIdentity, m_MasterPortIdentity, PTP_PORT_IDENTITY_SIZE) != 0)
+	{
+		// simplified best master clock algorithm: compare the priority vectors
+		// (priority1, clockClass, clockAccuracy, offsetScaledLogVariance,
+		// priority2, grandmasterIdentity), a lower value is better
+		if (   m_bMasterValid
+		    && memcmp (pPriority, m_MasterPriority, sizeof m_MasterPriority) >= 0)
+		{
+			return;
+		}
+
+		ReleaseMaster ();
+
+		memcpy (m_MasterPortIdentity, pPortIdentity, PTP_PORT_IDENTITY_SIZE);
+		m_bMasterValid = TRUE;
+
+		LOGNOTE ("Master is %02X%02X%02X.%02X%02X.%02X%02X%02X-%u",
+			 pPortIdentity[0], pPortIdentity[1], pPortIdentity[2], pPortIdentity[3],
+			 pPortIdentity[4], pPortIdentity[5], pPortIdentity[6], pPortIdentity[7],
+			 (unsigned) (pPortIdentity[8] << 8 | pPortIdentity[9]));
+	}
+
+	memcpy (m_MasterPriority, pPriority, sizeof m_MasterPriority);
+	m_nLastAnnounceTicks = CTimer::GetClockTicks ();
+
+	u16 usFlags = pMessage[PTP_OFFSET_FLAGS] << 8 | pMessage[PTP_OFFSET_FLAGS+1];
+	m_bPTPTimescale = !!(usFlags & PTP_FLAG_PTP_TIMESCALE);
+	if (usFlags & PTP_FLAG_UTC_VALID)
+	{
+		m_nUTCOffset = (s16) (pMessage[PTP_OFFSET_UTC_OFFSET] << 8
+				      | pMessage[PTP_OFFSET_UTC_OFFSET+1]);
+	}
+}
+
+void CPTPClient::ProcessSync (const u8 *pMessage, unsigned nLength, u64 nRxTime)
+{
+	if (nLength < PTP_SYNC_LENGTH)
+	{
+		return;
+	}
+
+	if (m_bHardware)
+	{
+		// the event register holds the timestamp of the last received event frame,
+		// a Delay_Req of another slave may have overwritten it (filtered by the servo)
+		assert (m_pNetDevice != 0);
+		if (!m_pNetDevice->GetPTPEventTimestamp (FALSE, &nRxTime))
+		{
+			return;
+		}
+	}
+
+	m_t2 = nRxTime;
+	m_usSyncSequenceId = pMessage[PTP_OFFSET_SEQUENCE_ID] << 8
+			     | pMessage[PTP_OFFSET_SEQUENCE_ID+1];
+	m_nSyncCorrection = GetCorrection (pMessage);
+
+	u16 usFlags = pMessage[PTP_OFFSET_FLAGS] << 8 | pMessage[PTP_OFFSET_FLAGS+1];
+	if (usFlags & PTP_FLAG_TWO_STEP)
+	{
+		m_bSyncPending = TRUE;
+
+		return;
+	}
+
+	m_bSyncPending = FALSE;
+	m_t1 = GetTimestamp (pMessage + PTP_OFFSET_TIMESTAMP) + m_nSyncCorrection;
+
+	SyncCompleted ();
+}
+
+void CPTPClient::ProcessFollowUp (const u8 *pMessage, unsigned nLength)
+{
+	if (   nLength < PTP_FOLLOW_UP_LENGTH
+	    || !m_bSyncPending
+	    || m_usSyncSequenceId != (  pMessage[PTP_OFFSET_SEQUENCE_ID] << 8
+				      | pMessage[PTP_OFFSET_SEQUENCE_ID+1]))
+	{
+		return;
+	}
+
+	m_bSyncPending = FALSE;
+	m_t1 =   GetTimestamp (pMessage + PTP_OFFSET_TIMESTAMP)
+	       + m_nSyncCorrection + GetCorrection (pMessage);
+
+	SyncCompleted ();
+}
+
+void CPTPClient::ProcessDelayResp (const u8 *pMessage, unsigned nLength)
+{
+	if (   nLength < PTP_DELAY_RESP_LENGTH
+	    || !m_bDelayReqPending
+	    || m_usDelaySequenceId != (  pMessage[PTP_OFFSET_SEQUENCE_ID] << 8
+				       | pMessage[PTP_OFFSET_SEQUENCE_ID+1])
+	    || memcmp (pMessage + PTP_OFFSET_REQ_PORT_ID, m_PortIdentity,
+		       PTP_PORT_IDENTITY_SIZE) != 0)
+	{
+		return;
+	}
+
+	m_bDelayReqPending = FALSE;
+
+	u64 t4 = GetTimestamp (pMessage + PTP_OFFSET_TIMESTAMP) - GetCorrection (pMessage);
+
+	s64 nDelay = (m_nMasterToSlave + (s64) (t4 - m_t3)) / 2;
+	if (nDelay < 0)
+	{
+		return;
+	}
+
+	if (!m_bDelayValid)
+	{
+		m_nMeanPathDelay = nDelay;
+		m_bDelayValid = TRUE;
+	}
+	else
+	{
+		m_nMeanPathDelay += (nDelay - m_nMeanPathDelay) / 8;
+	}
+}
+
+void CPTPClient::SendDelayReq (void)
+{
+	u8 Message[PTP_DELAY_REQ_LENGTH];
+	PutHeader (Message, PTP_DELAY_REQ, sizeof Message, m_uchDomain, m_PortIdentity,
+		   ++m_usDelaySequenceId, 1);
+	memset (Message + PTP_OFFSET_TIMESTAMP, 0, sizeof Message - PTP_OFFSET_TIMESTAMP);
+
+	u64 nPrevTxTime = 0;
+	if (m_bHardware)
+	{
+		assert (m_pNetDevice != 0);
+		m_pNetDevice->GetPTPEventTimestamp (TRUE, &nPrevTxTime);
+	}
+
+	assert (m_pEventSocket != 0);
+	CIPAddress GroupAddress (PTPPrimaryMulticast);
+	if (m_pEventSocket->SendTo (Message, sizeof Message, MSG_DONTWAIT,
+			   GroupAddress, PTP_EVENT_PORT) != sizeof Message)
+	{
+		return;
+	}
+
+	m_nDelayReqTicks = CTimer::GetClockTicks ();
+
+	if (!m_bHardware)
+	{
+		m_t3 = MapClockTicks (CTimer::GetClockTicks64 ());
+	}
+	else
+	{
+		// wait for the frame to be sent, the event register changes then
+		u64 nTxTime;
+		do
+		{
+			if (CTimer::GetClockTicks () - m_nDelayReqTicks >= PTP_TX_TIMESTAMP_TIMEOUT)
+			{
+				return;
+			}
+
+			CScheduler::Get ()->Yield ();
+
+			m_pNetDevice->GetPTPEventTimestamp (TRUE, &nTxTime);
+		}
+		while (nTxTime == nPrevTxTime);
+
+		m_t3 = nTxTime;
+	}
+
+	m_nMasterToSlave = (s64) (m_t2 - m_t1);
+	m_bDelayReqPending = TRUE;
+}
+
+void CPTPClient::SyncCompleted (void)
+{
+	s64 nMasterToSlave = (s64) (m_t2 - m_t1);
+
+	s64 nInterval = m_nLastSyncOrigin != 0 ? (s64) (m_t1 - m_nLastSyncOrigin) : 0;
+	m_nLastSyncOrigin = m_t1;
+
+	if (m_bDelayValid)
+	{
+		UpdateClock (nMasterToSlave - m_nMeanPathDelay, nInterval);
+	}
+	else if (   nMasterToSlave > PTP_STEP_THRESHOLD
+		 || nMasterToSlave < -PTP_STEP_THRESHOLD)
+	{
+		// bring the clock into range first, so that the path delay can be measured
+		StepLocalClock (-nMasterToSlave);
+	}
+
+	if (!m_bDelayReqPending)
+	{
+		SendDelayReq ();
+	}
+}
+
+void CPTPClient::UpdateClock (s64 nOffset, s64 nInterval)
+{
+	s64 nAbsOffset = nOffset < 0 ? -nOffset : nOffset;
+
+	if (nAbsOffset > PTP_STEP_THRESHOLD)
+	{
+		LOGNOTE ("Stepping clock by %d ms", (int) (-nOffset / 1000000));
+
+		StepLocalClock (-nOffset);
+
+		m_nOffset = nOffset;
+		m_bSynchronized = FALSE;
+		m_nLockedCount = 0;
+		m_nOutlierCount = 0;
+
+		return;
+	}
+
+	s64 nLockThreshold = m_bHardware ? PTP_LOCK_THRESHOLD_HW : PTP_LOCK_THRESHOLD_SW;
+	if (   m_bSynchronized
+	    && nAbsOffset > 100 * nLockThreshold
+	    && ++m_nOutlierCount <= PTP_OUTLIER_COUNT)
+	{
+		return;
+	}
+	m_nOutlierCount = 0;
+
+	m_nOffset = nOffset;
+
+	if (nInterval <= 0)
+	{
+		return;
+	}
+
+	// PI controller, the offset per interval is a frequency error in ppb
+	s64 nError = nOffset * 1000000000LL / nInterval;
+
+	m_nDrift -= nError * PTP_SERVO_KI / 10;
+	if (m_nDrift > PTP_MAX_PPB)
+	{
+		m_nDrift = PTP_MAX_PPB;
+	}
+	else if (m_nDrift < -PTP_MAX_PPB)
+	{
+		m_nDrift = -PTP_MAX_PPB;
+	}
+
+	s64 nFrequency = m_nDrift - nError * PTP_SERVO_KP / 10;
+	if (nFrequency > PTP_MAX_PPB)
+	{
+		nFrequency = PTP_MAX_PPB;
+	}
+	else if (nFrequency < -PTP_MAX_PPB)
+	{
+		nFrequency = -PTP_MAX_PPB;
+	}
+
+	m_nFrequency = (int) nFrequency;
+	SetLocalClockRate (m_nFrequency);
+
+	if (nAbsOffset <= nLockThreshold)
+	{
+		if (   !m_bSynchronized
+		    && ++m_nLockedCount >= PTP_LOCK_COUNT)
+		{
+			LOGNOTE ("Synchronized (offset %d ns, delay %d ns)",
+				 (int) nOffset, (int) m_nMeanPathDelay);
+
+			m_bSynchronized = TRUE;
+			m_nLastSystemTimeUpdate = 0;
+		}
+	}
+	else
+	{
+		m_nLockedCount = 0;
+	}
+}
+
+void CPTPClient::ReleaseMaster (void)
+{
+	m_bMasterValid = FALSE;
+	m_bSyncPending = FALSE;
+	m_nLastSyncOrigin = 0;
+	m_bDelayReqPending = FALSE;
+	m_bDelayValid = FALSE;
+	m_bSynchronized = FALSE;
+	m_nLockedCount = 0;
+	m_nOutlierCount = 0;
+}
+
+u64 CPTPClient::GetLocalTime (void)
+{
+	if (m_bHardware)
+	{
+		assert (m_pNetDevice != 0);
+		u64 nTime;
+		if (m_pNetDevice->GetPTPClock (&nTime))
+		{
+			return nTime;
+		}
+	}
+
+	return MapClockTicks (CTimer::GetClockTicks64 ());
+}
+
+void CPTPClient::StepLocalClock (s64 nNanoSeconds)
+{
+	// the Sync interval and a pending path delay measurement become invalid
+	m_nLastSyncOrigin = 0;
+	m_bDelayReqPending = FALSE;
+
+	if (m_bHardware)
+	{
+		assert (m_pNetDevice != 0);
+		m_pNetDevice->AdjustPTPClock (nNanoSeconds);
+
+		m_RefSpinLock.Acquire ();
+		m_bRefValid = FALSE;
+		m_RefSpinLock.Release ();
+
+		SampleLocalClock ();
+	}
+	else
+	{
+		m_RefSpinLock.Acquire ();
+		m_nRefTime += nNanoSeconds;
+		m_RefSpinLock.Release ();
+	}
+
+	m_nLastSystemTimeUpdate = 0;
+}
+
+void CPTPClient::SetLocalClockRate (int nPPB)
+{
+	if (m_bHardware)
+	{
+		assert (m_pNetDevice != 0);
+		m_pNetDevice->SetPTPClockRate (nPPB);
+
+		return;
+	}
+
+	// continue the software clock from now with the new rate
+	u64 nTicks = CTimer::GetClockTicks64 ();
+	u64 nTime = MapClockTicks (nTicks);
+
+	m_RefSpinLock.Acquire ();
+	m_nRefTicks = nTicks;
+	m_nRefTime = nTime;
+	m_nRefPPB = nPPB;
+	m_RefSpinLock.Release ();
+}
+
+u64 CPTPClient::MapClockTicks (u64 nClockTicks)
+{
+	m_RefSpinLock.Acquire ();
+
+	s64 nDelta = (s64) (nClockTicks - m_nRefTicks) * 1000;
+	u64 nResult = m_nRefTime + nDelta + nDelta * m_nRefPPB / 1000000000LL;
+
+	m_RefSpinLock.Release ();
+
+	return nResult;
+}
+
+void CPTPClient::SampleLocalClock (void)
+{
+	assert (m_bHardware);
+	assert (m_pNetDevice != 0);
+
+	// take the system clock around reading the hardware clock
+	EnterCritical ();
+
+	u64 nTicks1 = CTimer::GetClockTicks64 ();
+	u64 nTime;
+	boolean bOK = m_pNetDevice->GetPTPClock (&nTime);
+	u64 nTicks2 = CTimer::GetClockTicks64 ();
+
+	LeaveCritical ();
+
+	if (!bOK)
+	{
+		return;
+	}
+
+	u64 nTicks = (nTicks1 + nTicks2) / 2;
+
+	m_RefSpinLock.Acquire ();
+
+	if (!m_bRefValid)
+	{
+		m_nRefTicks = nTicks;
+		m_nRefTime = nTime;
+		m_bRefValid = TRUE;
+	}
+	else if (nTicks - m_nRefTicks >= CLOCKHZ)
+	{
+		// estimate the rate of the hardware clock relative to the system clock
+		s64 nTicksDelta = (s64) (nTicks - m_nRefTicks) * 1000;
+		s64 nTimeDelta = (s64) (nTime - m_nRefTime);
+		m_nRefPPB = (int) ((nTimeDelta - nTicksDelta) * 1000000000LL / nTicksDelta);
+
+		m_nRefTicks = nTicks;
+		m_nRefTime = nTime;
+	}
+
+	m_RefSpinLock.Release ();
+}
+
+void CPTPClient::UpdateSystemTime (void)
+{
+	if (!m_bSynchronized)
+	{
+		return;
+	}
+
+	CTimer *pTimer = CTimer::Get ();
+	assert (pTimer != 0);
+
+	unsigned nUptime = pTimer->GetUptime ();
+	if (   m_nLastSystemTimeUpdate != 0
+	    && nUptime - m_nLastSystemTimeUpdate < PTP_SYSTEM_TIME_PERIOD)
+	{
+		return;
+	}
+	m_nLastSystemTimeUpdate = nUptime != 0 ? nUptime : 1;
+
+	// the wall clock of CTimer follows the local PTP clock with microsecond precision
+	u64 nClockTicks = CTimer::GetClockTicks64 ();
+	u64 nNanoSeconds;
+	if (ConvertClockTicks (nClockTicks, &nNanoSeconds))
+	{
+		if (m_bPTPTimescale)
+		{
+			nNanoSeconds -= m_nUTCOffset * 1000000000ULL;
+		}
+
+		pTimer->AdjustWallClock (nClockTicks, nNanoSeconds / 1000, m_nRefPPB);
+	}
+
+	u64 nSeconds = GetLocalTime () / 1000000000ULL;
+	if (m_bPTPTimescale)
+	{
+		nSeconds -= m_nUTCOffset;
+	}
+
+	if (pTimer->GetUniversalTime () != (unsigned) nSeconds)
+	{
+		pTimer->SetTime ((unsigned) nSeconds, FALSE);
+	}
+}
+
+u64 CPTPClient::GetTimestamp (const u8 *pBuffer)
+{
+	u64 nSeconds = 0;
+	for (unsigned i = 0; i < 6; i++)
+	{
+		nSeconds = nSeconds << 8 | pBuffer[i];
+	}
+
+	u32 nNanoSeconds = 0;
+	for (unsigned i = 6; i < 10; i++)
+	{
+		nNanoSeconds = nNanoSeconds << 8 | pBuffer[i];
+	}
+
+	return nSeconds * 1000000000ULL + nNanoSeconds;
+}
+
+s64 CPTPClient::GetCorrection (const u8 *pHeader)
+{
+	u64 nCorrection = 0;
+	for (unsigned i = 0; i < 8; i++)
+	{
+		nCorrection = nCorrection << 8 | pHeader[PTP_OFFSET_CORRECTION+i];
+	}
+
+	return (s64) nCorrection >> 16;		// in 1/2^16 ns
+}
+
+void CPTPClient::PutHeader (u8 *pBuffer, u8 uchType, u16 usLength, u8 uchDomain,
+			    const u8 *pPortIdentity, u16 usSequenceId, u8 uchControl)
+{
+	memset (pBuffer, 0, PTP_HEADER_LENGTH);
+
+	pBuffer[PTP_OFFSET_TYPE] = uchType;
+	pBuffer[PTP_OFFSET_VERSION] = PTP_VERSION;
+	pBuffer[PTP_OFFSET_LENGTH] = usLength >> 8;
+	pBuffer[PTP_OFFSET_LENGTH+1] = usLength & 0xFF;
+	pBuffer[PTP_OFFSET_DOMAIN] = uchDomain;
+	memcpy (pBuffer + PTP_OFFSET_PORT_ID, pPortIdentity, PTP_PORT_IDENTITY_SIZE);
+	pBuffer[PTP_OFFSET_SEQUENCE_ID] = usSequenceId >> 8;
+	pBuffer[PTP_OFFSET_SEQUENCE_ID+1] = usSequenceId & 0xFF;
+	pBuffer[PTP_OFFSET_CONTROL] = uchControl;
+	pBuffer[PTP_OFFSET_LOG_INTERVAL] = 0x7F;
+}
@@ -0,0 +1,205 @@
+//
+// rawframering.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/rawframering.h>
+#include <circle/net/linklayer.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CRawFrameRing::CRawFrameRing (CLinkLayer *pLinkLayer, u16 nEtherType,
+			      unsigned nRxSlots, unsigned nTxSlots)
+:	m_pLinkLayer (pLinkLayer),
+	m_nEtherType (le2be16 (nEtherType)),
+	m_bAttached (FALSE),
+	m_nRxSlots (nRxSlots),
+	m_nRxIn (0),
+	m_nRxOut (0),
+	m_nTxSlots (nTxSlots),
+	m_nTxIn (0),
+	m_nTxOut (0),
+	m_nDropped (0)
+{
+	assert (m_pLinkLayer != 0);
+	assert (nEtherType != 0);
+	assert (m_nRxSlots > 0);
+	assert (m_nTxSlots > 0);
+
+	m_pRxRing = new TRawFrameSlot[m_nRxSlots];
+	assert (m_pRxRing != 0);
+
+	for (unsigned i = 0; i < m_nRxSlots; i++)
+	{
+		m_pRxRing[i].nStatus = RAW_SLOT_STATUS_KERNEL;
+	}
+
+	m_pTxRing = new TRawFrameSlot[m_nTxSlots];
+	assert (m_pTxRing != 0);
+
+	for (unsigned i = 0; i < m_nTxSlots; i++)
+	{
+		m_pTxRing[i].nStatus = RAW_SLOT_STATUS_AVAILABLE;
+	}
+}
+
+CRawFrameRing::~CRawFrameRing (void)
+{
+	if (m_bAttached)
+	{
+		assert (m_pLinkLayer != 0);
+		m_pLinkLayer->DetachRawRing (this);
+	}
+
+	delete [] m_pTxRing;
+	m_pTxRing = 0;
+
+	delete [] m_pRxRing;
+	m_pRxRing = 0;
+
+	m_pLinkLayer = 0;
+}
+
+boolean CRawFrameRing::Initialize (void)
+{
+	assert (!m_bAttached);
+	assert (m_pLinkLayer != 0);
+	m_bAttached = m_pLinkLayer->AttachRawRing (this);
+
+	return m_bAttached;
+}
+
+TRawFrameSlot *CRawFrameRing::GetRxFrame (void)
+{
+	TRawFrameSlot *pSlot = &m_pRxRing[m_nRxOut];
+	if (pSlot->nStatus != RAW_SLOT_STATUS_USER)
+	{
+		return 0;
+	}
+
+	DataMemBarrier ();	// read the frame after the status
+
+	return pSlot;
+}
+
+void CRawFrameRing::ReleaseRxFrame (void)
+{
+	TRawFrameSlot *pSlot = &m_pRxRing[m_nRxOut];
+	assert (pSlot->nStatus == RAW_SLOT_STATUS_USER);
+
+	DataMemBarrier ();	// frame must have been read, before the slot is reused
+
+	pSlot->nStatus = RAW_SLOT_STATUS_KERNEL;
+
+	if (++m_nRxOut == m_nRxSlots)
+	{
+		m_nRxOut = 0;
+	}
+}
+
+TRawFrameSlot *CRawFrameRing::GetTxFrame (void)
+{
+	TRawFrameSlot *pSlot = &m_pTxRing[m_nTxIn];
+	if (pSlot->nStatus != RAW_SLOT_STATUS_AVAILABLE)
+	{
+		return 0;
+	}
+
+	return pSlot;
+}
+
+void CRawFrameRing::SendTxFrame (unsigned nLength)
+{
+	TRawFrameSlot *pSlot = &m_pTxRing[m_nTxIn];
+	assert (pSlot->nStatus == RAW_SLOT_STATUS_AVAILABLE);
+
+	assert (nLength > 0);
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	pSlot->nLength = (u16) nLength;
+
+	DataMemBarrier ();	// frame must be complete, before it is handed over
+
+	pSlot->nStatus = RAW_SLOT_STATUS_SEND_REQUEST;
+
+	if (++m_nTxIn == m_nTxSlots)
+	{
+		m_nTxIn = 0;
+	}
+}
+
+unsigned CRawFrameRing::Flush (void)
+{
+	unsigned nFrames = 0;
+
+	TRawFrameSlot *pSlot;
+	while ((pSlot = &m_pTxRing[m_nTxOut])->nStatus == RAW_SLOT_STATUS_SEND_REQUEST)
+	{
+		DataMemBarrier ();
+
+		assert (m_pLinkLayer != 0);
+		m_pLinkLayer->SendRaw (pSlot->Frame, pSlot->nLength);
+
+		pSlot->nStatus = RAW_SLOT_STATUS_AVAILABLE;
+
+		if (++m_nTxOut == m_nTxSlots)
+		{
+			m_nTxOut = 0;
+		}
+
+		nFrames++;
+	}
+
+	return nFrames;
+}
+
+unsigned CRawFrameRing::GetDropped (void) const
+{
+	return m_nDropped;
+}
+
+u16 CRawFrameRing::GetEtherType (void) const
+{
+	return m_nEtherType;
+}
+
+void CRawFrameRing::FrameReceived (const void *pFrame, unsigned nLength)
+{
+	TRawFrameSlot *pSlot = &m_pRxRing[m_nRxIn];
+	if (pSlot->nStatus != RAW_SLOT_STATUS_KERNEL)
+	{
+		m_nDropped++;
+
+		return;
+	}
+
+	assert (pFrame != 0);
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	memcpy (pSlot->Frame, pFrame, nLength);
+	pSlot->nLength = (u16) nLength;
+	pSlot->nTimestamp = CTimer::GetClockTicks64 ();
+
+	DataMemBarrier ();	// frame must be complete, before it is handed over
+
+	pSlot->nStatus = RAW_SLOT_STATUS_USER;
+
+	if (++m_nRxIn == m_nRxSlots)
+	{
+		m_nRxIn = 0;
+	}
+}
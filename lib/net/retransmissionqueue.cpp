@@ -121,9 +121,82 @@ void CRetransmissionQueue::Reset (void)
 	m_nPreOutPtr = m_nOutPtr;
 }
 
+unsigned CRetransmissionQueue::GetBytesUnacknowledged (void) const
+{
+	assert (m_nSize > 1);
+	assert (m_nOutPtr < m_nSize);
+	assert (m_nPreOutPtr < m_nSize);
+
+	if (m_nPreOutPtr < m_nOutPtr)
+	{
+		return m_nSize+m_nPreOutPtr-m_nOutPtr;
+	}
+
+	return m_nPreOutPtr-m_nOutPtr;
+}
+
+void CRetransmissionQueue::ReadAt (unsigned nOffset, void *pBuffer, unsigned nLength) const
+{
+	assert (nLength > 0);
+	assert (nOffset+nLength <= GetBytesUnacknowledged ());
+
+	unsigned char *p = (unsigned char *) pBuffer;
+	assert (p != 0);
+	assert (m_pBuffer != 0);
+
+	unsigned nPtr = (m_nOutPtr + nOffset) % m_nSize;
+	while (nLength--)
+	{
+		*p++ = m_pBuffer[nPtr++];
+		nPtr %= m_nSize;
+	}
+}
+
 void CRetransmissionQueue::Flush (void)
 {
 	m_nInPtr = 0;
 	m_nOutPtr = 0;
 	m_nPreOutPtr = 0;
 }
+
+boolean CRetransmissionQueue::Resize (unsigned nSize)
+{
+	assert (m_nSize > 1);
+	assert (m_nInPtr < m_nSize);
+	assert (m_nOutPtr < m_nSize);
+
+	if (nSize <= 1)
+	{
+		return FALSE;
+	}
+
+	unsigned nQueued = m_nSize-1-GetFreeSpace ();
+	if (nQueued >= nSize)
+	{
+		return FALSE;
+	}
+
+	u8 *pBuffer = new unsigned char[nSize];
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	assert (m_pBuffer != 0);
+	for (unsigned i = 0; i < nQueued; i++)
+	{
+		pBuffer[i] = m_pBuffer[(m_nOutPtr + i) % m_nSize];
+	}
+
+	unsigned nPreOutOffset = GetBytesUnacknowledged ();
+
+	delete [] m_pBuffer;
+	m_pBuffer = pBuffer;
+	m_nSize = nSize;
+
+	m_nOutPtr = 0;
+	m_nPreOutPtr = nPreOutOffset;
+	m_nInPtr = nQueued;
+
+	return TRUE;
+}
@@ -46,7 +46,10 @@ CRetransmissionTimeoutCalculator::CRetransmissionTimeoutCalculator (void)
 	m_nRTO (INITIAL_RTO),
 	m_bFirstMeasurement (TRUE),
 	m_bMeasurementRuns (FALSE),
-	m_nRetransmissions (0)
+	m_nRetransmissions (0),
+	m_bTimestampSample (FALSE),
+	m_nSRTTFine (0),
+	m_nMinRTTFine (0)
 {
 	assert (m_pTimer != 0);
 }
@@ -61,6 +64,16 @@ unsigned CRetransmissionTimeoutCalculator::GetRTO (void) const
 	return m_nRTO;
 }
 
+unsigned CRetransmissionTimeoutCalculator::GetSmoothedRTT (void) const
+{
+	return m_nSRTTFine;
+}
+
+unsigned CRetransmissionTimeoutCalculator::GetMinimumRTT (void) const
+{
+	return m_nMinRTTFine;
+}
+
 void CRetransmissionTimeoutCalculator::Initialize (u32 nISN)
 {
 	m_SpinLock.Acquire ();
@@ -74,6 +87,9 @@ void CRetransmissionTimeoutCalculator::Initialize (u32 nISN)
 	m_bFirstMeasurement = TRUE;
 	m_bMeasurementRuns = FALSE;
 	m_nRetransmissions = 0;
+	m_bTimestampSample = FALSE;
+	m_nSRTTFine = 0;
+	m_nMinRTTFine = 0;
 
 	m_SpinLock.Release ();
 }
@@ -94,6 +110,7 @@ void CRetransmissionTimeoutCalculator::SegmentSent (u32 nSequenceNumber, u32 nLe
 
 		assert (m_pTimer != 0);
 		m_nStartTicks = m_pTimer->GetTicks ();
+		m_nStartClockTicks = CTimer::GetClockTicks ();
 	}
 
 	m_SpinLock.Release ();
@@ -113,12 +130,35 @@ void CRetransmissionTimeoutCalculator::SegmentAcknowledged (u32 nAcknowledgmentN
 	if (   m_bMeasurementRuns
 	    && m_nRetransmissions == 0)
 	{
-		assert (m_pTimer != 0);
-		Calculate (m_pTimer->GetTicks () - m_nStartTicks);
+		if (!m_bTimestampSample)
+		{
+			assert (m_pTimer != 0);
+			Calculate (m_pTimer->GetTicks () - m_nStartTicks);
+		}
+
+		CalculateFine (CTimer::GetClockTicks () - m_nStartClockTicks);
 	}
 
 	m_bMeasurementRuns = FALSE;
 	m_nRetransmissions = 0;
+	m_bTimestampSample = FALSE;
+
+	m_SpinLock.Release ();
+}
+
+void CRetransmissionTimeoutCalculator::RTTMeasured (unsigned nRTT)
+{
+	m_SpinLock.Acquire ();
+
+#ifdef RTO_DEBUG
+	CLogger::Get ()->Write (FromRTO, LogDebug, "RTT measured (%u)", nRTT);
+#endif
+
+	// timestamps are not ambiguous on retransmitted segments (RFC 7323 section 4.1)
+	Calculate (nRTT);
+
+	// SegmentAcknowledged() follows and does the fine measurement only
+	m_bTimestampSample = TRUE;
 
 	m_SpinLock.Release ();
 }
@@ -195,3 +235,26 @@ void CRetransmissionTimeoutCalculator::Calculate (unsigned nRTT)
 				m_nRTO, m_nSRTT, m_nRTTVAR);
 #endif
 }
+
+void CRetransmissionTimeoutCalculator::CalculateFine (unsigned nRTT)
+{
+	if (nRTT == 0)
+	{
+		nRTT = 1;
+	}
+
+	if (   m_nMinRTTFine == 0
+	    || nRTT < m_nMinRTTFine)
+	{
+		m_nMinRTTFine = nRTT;
+	}
+
+	if (m_nSRTTFine == 0)
+	{
+		m_nSRTTFine = nRTT;
+	}
+	else
+	{
+		m_nSRTTFine = ((ALPHA - 1) * m_nSRTTFine + nRTT) / ALPHA;
+	}
+}
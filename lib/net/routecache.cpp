@@ -19,6 +19,7 @@
 //
 #include <circle/net/routecache.h>
 #include <circle/net/ipaddress.h>
+#include <circle/timer.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -26,6 +27,9 @@ struct TRouteCacheEntry
 {
 	u8	DestIP[IP_ADDRESS_SIZE];
 	u8	GatewayIP[IP_ADDRESS_SIZE];
+	boolean	bHasRoute;
+	unsigned nPathMTU;		// 0 if unknown
+	unsigned nTicksPathMTU;		// when the path MTU has been set
 };
 
 CRouteCache::CRouteCache (void)
@@ -53,48 +57,105 @@ void CRouteCache::AddRoute (const u8 *pDestIP, const u8 *pGatewayIP)
 	assert (pDestIP != 0);
 	assert (pGatewayIP != 0);
 
-	TRouteCacheEntry *pDestEntry = 0;
-
-	unsigned nCount = m_Cache.GetCount ();
-	for (unsigned i = 0; i < nCount; i++)
-	{
-		TRouteCacheEntry *pEntry = (TRouteCacheEntry *) m_Cache[i];
-		assert (pEntry != 0);
-
-		if (memcmp (pEntry->DestIP, pDestIP, IP_ADDRESS_SIZE) == 0)
-		{
-			pDestEntry = pEntry;
-
-			break;
-		}
-	}
-
+	TRouteCacheEntry *pDestEntry = (TRouteCacheEntry *) Lookup (pDestIP);
 	if (pDestEntry == 0)
 	{
 		pDestEntry = new TRouteCacheEntry;
 		assert (pDestEntry != 0);
 
 		memcpy (pDestEntry->DestIP, pDestIP, IP_ADDRESS_SIZE);
+		pDestEntry->nPathMTU = 0;
 
 		m_Cache.Append (pDestEntry);
 	}
 
 	memcpy (pDestEntry->GatewayIP, pGatewayIP, IP_ADDRESS_SIZE);
+	pDestEntry->bHasRoute = TRUE;
 }
 
 const u8 *CRouteCache::GetRoute (const u8 *pDestIP) const
+{
+	const TRouteCacheEntry *pEntry = (const TRouteCacheEntry *) Lookup (pDestIP);
+	if (   pEntry == 0
+	    || !pEntry->bHasRoute)
+	{
+		return 0;
+	}
+
+	return pEntry->GatewayIP;
+}
+
+void CRouteCache::SetPathMTU (const u8 *pDestIP, unsigned nMTU)
+{
+	assert (nMTU != 0);
+
+	TRouteCacheEntry *pDestEntry = (TRouteCacheEntry *) Lookup (pDestIP);
+	if (pDestEntry == 0)
+	{
+		// reuse the oldest entry without route, if the limit has been reached
+		unsigned nEntries = 0;
+		unsigned nCount = m_Cache.GetCount ();
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			TRouteCacheEntry *pEntry = (TRouteCacheEntry *) m_Cache[i];
+			assert (pEntry != 0);
+
+			if (!pEntry->bHasRoute)
+			{
+				if (   pDestEntry == 0
+				    || (int) (pEntry->nTicksPathMTU - pDestEntry->nTicksPathMTU) < 0)
+				{
+					pDestEntry = pEntry;
+				}
+
+				nEntries++;
+			}
+		}
+
+		if (nEntries < ROUTE_CACHE_MAX_PMTU_ENTRIES)
+		{
+			pDestEntry = new TRouteCacheEntry;
+			assert (pDestEntry != 0);
+
+			m_Cache.Append (pDestEntry);
+		}
+
+		assert (pDestEntry != 0);
+		memcpy (pDestEntry->DestIP, pDestIP, IP_ADDRESS_SIZE);
+		pDestEntry->bHasRoute = FALSE;
+	}
+
+	pDestEntry->nPathMTU = nMTU;
+	pDestEntry->nTicksPathMTU = CTimer::Get ()->GetTicks ();
+}
+
+unsigned CRouteCache::GetPathMTU (const u8 *pDestIP) const
+{
+	const TRouteCacheEntry *pEntry = (const TRouteCacheEntry *) Lookup (pDestIP);
+	if (   pEntry == 0
+	    || pEntry->nPathMTU == 0
+	    ||    CTimer::Get ()->GetTicks () - pEntry->nTicksPathMTU
+	       >= ROUTE_CACHE_PMTU_TIMEOUT * HZ)
+	{
+		return 0;
+	}
+
+	return pEntry->nPathMTU;
+}
+
+void *CRouteCache::Lookup (const u8 *pDestIP) const
 {
 	assert (pDestIP != 0);
 
 	unsigned nCount = m_Cache.GetCount ();
 	for (unsigned i = 0; i < nCount; i++)
 	{
-		const TRouteCacheEntry *pEntry = (const TRouteCacheEntry *) m_Cache[i];
+		TRouteCacheEntry *pEntry = (TRouteCacheEntry *) m_Cache[i];
 		assert (pEntry != 0);
 
 		if (memcmp (pEntry->DestIP, pDestIP, IP_ADDRESS_SIZE) == 0)
 		{
-			return pEntry->GatewayIP;
+			return pEntry;
 		}
 	}
 
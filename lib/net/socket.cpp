@@ -2,7 +2,7 @@
 // socket.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,6 +19,7 @@
 //
 #include <circle/net/socket.h>
 #include <circle/net/netsubsystem.h>
+#include <circle/net/tcpconnection.h>
 #include <circle/net/in.h>
 #include <circle/util.h>
 #include <assert.h>
@@ -30,7 +31,11 @@ CSocket::CSocket (CNetSubSystem *pNetSubSystem, int nProtocol)
 	m_nProtocol (nProtocol),
 	m_nOwnPort (0),
 	m_hConnection (-1),
-	m_nBackLog (0)
+	m_nBackLog (0),
+	m_nReceiveBufferSize (0),
+	m_nSendBufferSize (0),
+	m_bNoDelay (FALSE),
+	m_pReadinessEvent (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pTransportLayer != 0);
@@ -43,10 +48,17 @@ CSocket::CSocket (CSocket &rSocket, int hConnection)
 	m_nProtocol (rSocket.m_nProtocol),
 	m_nOwnPort (rSocket.m_nOwnPort),
 	m_hConnection (hConnection),
-	m_nBackLog (0)
+	m_nBackLog (0),
+	m_nReceiveBufferSize (rSocket.m_nReceiveBufferSize),
+	m_nSendBufferSize (rSocket.m_nSendBufferSize),
+	m_bNoDelay (rSocket.m_bNoDelay),
+	m_pReadinessEvent (0)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pTransportLayer != 0);
+
+	// the connection was listening for rSocket before
+	m_pTransportLayer->SetReadinessEvent (0, m_hConnection);
 }
 
 CSocket::~CSocket (void)
@@ -56,6 +68,7 @@ CSocket::~CSocket (void)
 	if (m_hConnection >= 0)
 	{
 		assert (m_nBackLog == 0);
+		m_pTransportLayer->SetReadinessEvent (0, m_hConnection);
 		m_pTransportLayer->Disconnect (m_hConnection);
 		m_hConnection = -1;
 	}
@@ -63,6 +76,7 @@ CSocket::~CSocket (void)
 	{
 		for (unsigned i = 0; i < m_nBackLog; i++)
 		{
+			m_pTransportLayer->SetReadinessEvent (0, m_hListenConnection[i]);
 			m_pTransportLayer->Disconnect (m_hListenConnection[i]);
 		}
 	}
@@ -97,6 +111,8 @@ int CSocket::Bind (u16 nOwnPort)
 		{
 			return m_hConnection;		// return error code
 		}
+
+		ApplyOptions (m_hConnection);
 	}
 
 	return 0;
@@ -131,8 +147,14 @@ int CSocket::Connect (const CIPAddress &rForeignIP, u16 nForeignPort)
 	}
 
 	m_hConnection = m_pTransportLayer->Connect (rForeignIP, nForeignPort, m_nOwnPort, m_nProtocol);
+	if (m_hConnection < 0)
+	{
+		return m_hConnection;
+	}
 
-	return m_hConnection >= 0 ? 0 : m_hConnection;
+	ApplyOptions (m_hConnection);
+
+	return 0;
 }
 
 int CSocket::Listen (unsigned nBackLog)
@@ -167,6 +189,8 @@ int CSocket::Listen (unsigned nBackLog)
 	{
 		m_hListenConnection[i] = m_pTransportLayer->Listen (m_nOwnPort, m_nProtocol);
 		assert (m_hListenConnection[i] >= 0);
+
+		ApplyOptions (m_hListenConnection[i]);
 	}
 
 	return 0;
@@ -223,6 +247,8 @@ CSocket *CSocket::Accept (CIPAddress *pForeignIP, u16 *pForeignPort)
 	m_hListenConnection[nIndex] = m_pTransportLayer->Listen (m_nOwnPort, m_nProtocol);
 	assert (m_hListenConnection[nIndex] >= 0);
 
+	ApplyOptions (m_hListenConnection[nIndex]);
+
 	return pNewSocket;
 }
 
@@ -256,6 +282,12 @@ int CSocket::Receive (void *pBuffer, unsigned nLength, int nFlags)
 	}
 	
 	assert (m_pTransportLayer != 0);
+	assert (pBuffer != 0);
+	if (nLength >= FRAME_BUFFER_SIZE)		// no truncation possible
+	{
+		return m_pTransportLayer->Receive (pBuffer, nFlags, m_hConnection);
+	}
+
 	u8 TempBuffer[FRAME_BUFFER_SIZE];
 	int nResult = m_pTransportLayer->Receive (TempBuffer, nFlags, m_hConnection);
 	if (nResult < 0)
@@ -317,6 +349,13 @@ int CSocket::ReceiveFrom (void *pBuffer, unsigned nLength, int nFlags,
 	}
 	
 	assert (m_pTransportLayer != 0);
+	assert (pBuffer != 0);
+	if (nLength >= FRAME_BUFFER_SIZE)		// no truncation possible
+	{
+		return m_pTransportLayer->ReceiveFrom (pBuffer, nFlags,
+						       pForeignIP, pForeignPort, m_hConnection);
+	}
+
 	u8 TempBuffer[FRAME_BUFFER_SIZE];
 	int nResult = m_pTransportLayer->ReceiveFrom (TempBuffer, nFlags,
 						      pForeignIP, pForeignPort, m_hConnection);
@@ -336,6 +375,151 @@ int CSocket::ReceiveFrom (void *pBuffer, unsigned nLength, int nFlags,
 	return nResult;
 }
 
+int CSocket::SendBuffer (CNetBuffer *pBuffer, int nFlags)
+{
+	assert (pBuffer != 0);
+
+	if (m_hConnection < 0)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SendBuffer (pBuffer, nFlags, m_hConnection);
+}
+
+int CSocket::ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags)
+{
+	assert (ppBuffer != 0);
+	*ppBuffer = 0;
+
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->ReceiveBuffer (ppBuffer, nFlags, m_hConnection);
+}
+
+int CSocket::SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+			   const CIPAddress &rForeignIP, u16 nForeignPort)
+{
+	assert (pBuffer != 0);
+
+	if (m_hConnection < 0)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (m_pNetConfig != 0);
+	if (m_pNetConfig->GetIPAddress ()->IsNull ())		// from null source address
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+	}
+
+	if (nForeignPort == 0)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SendBufferTo (pBuffer, nFlags, rForeignIP, nForeignPort,
+						m_hConnection);
+}
+
+int CSocket::ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+				CIPAddress *pForeignIP, u16 *pForeignPort)
+{
+	assert (ppBuffer != 0);
+	*ppBuffer = 0;
+
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->ReceiveBufferFrom (ppBuffer, nFlags, pForeignIP, pForeignPort,
+						     m_hConnection);
+}
+
+int CSocket::SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags)
+{
+	assert (pMessages != 0);
+
+	int nResult = 0;
+	if (m_nProtocol != IPPROTO_UDP)
+	{
+		nResult = -NET_ERROR_OPERATION_NOT_SUPPORTED;
+	}
+	else if (m_hConnection < 0)
+	{
+		nResult = -NET_ERROR_NOT_CONNECTED;
+	}
+	else
+	{
+		assert (m_pNetConfig != 0);
+		if (m_pNetConfig->GetIPAddress ()->IsNull ())		// from null source address
+		{
+			nResult = -NET_ERROR_OPERATION_NOT_SUPPORTED;
+		}
+
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			if (pMessages[i].nForeignPort == 0)
+			{
+				nResult = -NET_ERROR_INVALID_VALUE;
+			}
+		}
+	}
+
+	if (nResult < 0)
+	{
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			assert (pMessages[i].pBuffer != 0);
+			pMessages[i].pBuffer->Release ();
+			pMessages[i].pBuffer = 0;
+		}
+
+		return nResult;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SendBatch (pMessages, nCount, nFlags, m_hConnection);
+}
+
+int CSocket::ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags)
+{
+	assert (pMessages != 0);
+	for (unsigned i = 0; i < nCount; i++)
+	{
+		pMessages[i].pBuffer = 0;
+	}
+
+	if (m_nProtocol != IPPROTO_UDP)
+	{
+		return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+	}
+
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->ReceiveBatch (pMessages, nCount, nFlags, m_hConnection);
+}
+
 int CSocket::SetOptionReceiveTimeout (unsigned nMicroSeconds)
 {
 	if (m_hConnection < 0)
@@ -406,6 +590,155 @@ int CSocket::SetOptionDropMembership (const CIPAddress &rGroupAddress)
 	return m_pTransportLayer->SetOptionDropMembership (rGroupAddress, m_hConnection);
 }
 
+int CSocket::SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+					     const CIPAddress &rSourceAddress)
+{
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	if (m_nProtocol != IPPROTO_UDP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SetOptionAddSourceMembership (rGroupAddress, rSourceAddress,
+							      m_hConnection);
+}
+
+int CSocket::SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+					      const CIPAddress &rSourceAddress)
+{
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	if (m_nProtocol != IPPROTO_UDP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SetOptionDropSourceMembership (rGroupAddress, rSourceAddress,
+							      m_hConnection);
+}
+
+int CSocket::SetOptionReceiveBuffer (unsigned nBytes)
+{
+	if (   m_nProtocol != IPPROTO_TCP
+	    && m_nProtocol != IPPROTO_UDP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	if (   nBytes == 0
+	    || nBytes > TCP_MAX_BUFFER_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	m_nReceiveBufferSize = nBytes;
+
+	assert (m_pTransportLayer != 0);
+
+	if (m_hConnection >= 0)
+	{
+		return m_pTransportLayer->SetOptionReceiveBuffer (nBytes, m_hConnection);
+	}
+
+	for (unsigned i = 0; i < m_nBackLog; i++)
+	{
+		int nResult = m_pTransportLayer->SetOptionReceiveBuffer (nBytes, m_hListenConnection[i]);
+		if (nResult < 0)
+		{
+			return nResult;
+		}
+	}
+
+	return 0;
+}
+
+int CSocket::SetOptionSendBuffer (unsigned nBytes)
+{
+	if (m_nProtocol != IPPROTO_TCP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	if (   nBytes == 0
+	    || nBytes > TCP_MAX_BUFFER_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	m_nSendBufferSize = nBytes;
+
+	assert (m_pTransportLayer != 0);
+
+	if (m_hConnection >= 0)
+	{
+		return m_pTransportLayer->SetOptionSendBuffer (nBytes, m_hConnection);
+	}
+
+	for (unsigned i = 0; i < m_nBackLog; i++)
+	{
+		int nResult = m_pTransportLayer->SetOptionSendBuffer (nBytes, m_hListenConnection[i]);
+		if (nResult < 0)
+		{
+			return nResult;
+		}
+	}
+
+	return 0;
+}
+
+int CSocket::SetOptionNoDelay (boolean bNoDelay)
+{
+	if (m_nProtocol != IPPROTO_TCP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	m_bNoDelay = bNoDelay;
+
+	assert (m_pTransportLayer != 0);
+
+	if (m_hConnection >= 0)
+	{
+		return m_pTransportLayer->SetOptionNoDelay (bNoDelay, m_hConnection);
+	}
+
+	for (unsigned i = 0; i < m_nBackLog; i++)
+	{
+		int nResult = m_pTransportLayer->SetOptionNoDelay (bNoDelay, m_hListenConnection[i]);
+		if (nResult < 0)
+		{
+			return nResult;
+		}
+	}
+
+	return 0;
+}
+
+int CSocket::SetOptionCork (boolean bCork)
+{
+	if (m_hConnection < 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	if (m_nProtocol != IPPROTO_TCP)
+	{
+		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
+	}
+
+	assert (m_pTransportLayer != 0);
+	return m_pTransportLayer->SetOptionCork (bCork, m_hConnection);
+}
+
 const u8 *CSocket::GetForeignIP (void) const
 {
 	if (m_hConnection < 0)
@@ -447,3 +780,112 @@ CSocket::TStatus CSocket::GetStatus (void) const
 
 	return m_pTransportLayer->GetStatus (m_hConnection);
 }
+
+boolean CSocket::IsListening (void) const
+{
+	return m_nBackLog != 0;
+}
+
+void CSocket::SetReadinessEvent (CSynchronizationEvent *pEvent)
+{
+	m_pReadinessEvent = pEvent;
+
+	assert (m_pTransportLayer != 0);
+
+	if (m_hConnection >= 0)
+	{
+		m_pTransportLayer->SetReadinessEvent (pEvent, m_hConnection);
+	}
+
+	for (unsigned i = 0; i < m_nBackLog; i++)
+	{
+		m_pTransportLayer->SetReadinessEvent (pEvent, m_hListenConnection[i]);
+	}
+}
+
+// The readiness event is attached, before the non-blocking operation is tried, so that a
+// status change in-between cannot be missed.
+
+boolean CSocket::AwaitReceive (CAsyncFlow *pFlow, void *pBuffer, unsigned nLength)
+{
+	assert (pFlow != 0);
+	if (   pFlow->IsPending ()
+	    && !pFlow->FetchCompletion ())
+	{
+		return FALSE;
+	}
+
+	CSynchronizationEvent *pEvent = pFlow->GetEvent ();
+	assert (pEvent != 0);
+	pEvent->Clear ();
+	SetReadinessEvent (pEvent);
+
+	int nResult = Receive (pBuffer, nLength, MSG_DONTWAIT);
+	if (nResult == 0)
+	{
+		pFlow->SuspendOnEvent (pEvent);
+
+		return FALSE;
+	}
+
+	SetReadinessEvent (0);
+
+	pFlow->SetResult (nResult);
+
+	return TRUE;
+}
+
+boolean CSocket::AwaitSend (CAsyncFlow *pFlow, const void *pBuffer, unsigned nLength)
+{
+	assert (pFlow != 0);
+	if (   pFlow->IsPending ()
+	    && !pFlow->FetchCompletion ())
+	{
+		return FALSE;
+	}
+
+	CSynchronizationEvent *pEvent = pFlow->GetEvent ();
+	assert (pEvent != 0);
+	pEvent->Clear ();
+	SetReadinessEvent (pEvent);
+
+	int nResult = Send (pBuffer, nLength, MSG_DONTWAIT);
+	if (nResult == -NET_ERROR_WOULD_BLOCK)
+	{
+		pFlow->SuspendOnEvent (pEvent);
+
+		return FALSE;
+	}
+
+	SetReadinessEvent (0);
+
+	pFlow->SetResult (nResult);
+
+	return TRUE;
+}
+
+void CSocket::ApplyOptions (int hConnection)
+{
+	assert (hConnection >= 0);
+	assert (m_pTransportLayer != 0);
+
+	if (m_nReceiveBufferSize != 0)
+	{
+		m_pTransportLayer->SetOptionReceiveBuffer (m_nReceiveBufferSize, hConnection);
+	}
+
+	if (m_nSendBufferSize != 0)
+	{
+		m_pTransportLayer->SetOptionSendBuffer (m_nSendBufferSize, hConnection);
+	}
+
+	if (m_bNoDelay)
+	{
+		m_pTransportLayer->SetOptionNoDelay (m_bNoDelay, hConnection);
+	}
+
+	if (m_pReadinessEvent != 0)
+	{
+		m_pTransportLayer->SetReadinessEvent (m_pReadinessEvent, hConnection);
+	}
+}
@@ -0,0 +1,245 @@
+//
+// socketpoller.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/socketpoller.h>
+#include <circle/net/error.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+#define SOCKET_POLL_ALL		(  SOCKET_POLL_READABLE | SOCKET_POLL_WRITABLE	\
+				 | SOCKET_POLL_ACCEPT | SOCKET_POLL_ERROR)
+
+CSocketPoller::CSocketPoller (unsigned nMaxSockets)
+:	m_nMaxSockets (nMaxSockets),
+	m_nSockets (0),
+	m_nNextEntry (0)
+{
+	assert (m_nMaxSockets > 0);
+	m_pEntry = new TEntry[m_nMaxSockets];
+	assert (m_pEntry != 0);
+}
+
+CSocketPoller::~CSocketPoller (void)
+{
+	for (unsigned i = 0; i < m_nSockets; i++)
+	{
+		assert (m_pEntry[i].pSocket != 0);
+		m_pEntry[i].pSocket->SetReadinessEvent (0);
+	}
+
+	delete [] m_pEntry;
+	m_pEntry = 0;
+}
+
+int CSocketPoller::Add (CSocket *pSocket, unsigned nEvents, void *pParam)
+{
+	if (   pSocket == 0
+	    || (nEvents & ~(SOCKET_POLL_ALL | SOCKET_POLL_EDGE_TRIGGERED))
+	    || Find (pSocket) >= 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	if (m_nSockets >= m_nMaxSockets)
+	{
+		return -NET_ERROR_IO;
+	}
+
+	TEntry *pEntry = &m_pEntry[m_nSockets++];
+	pEntry->pSocket = pSocket;
+	pEntry->nEvents = nEvents | SOCKET_POLL_ERROR;
+	pEntry->nReported = 0;
+	pEntry->bWasConnected = FALSE;
+	pEntry->pParam = pParam;
+
+	pSocket->SetReadinessEvent (&m_Event);
+
+	return 0;
+}
+
+int CSocketPoller::Modify (CSocket *pSocket, unsigned nEvents)
+{
+	int nIndex = Find (pSocket);
+	if (   nIndex < 0
+	    || (nEvents & ~(SOCKET_POLL_ALL | SOCKET_POLL_EDGE_TRIGGERED)))
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	m_pEntry[nIndex].nEvents = nEvents | SOCKET_POLL_ERROR;
+	m_pEntry[nIndex].nReported = 0;		// re-arm edge-triggered events
+
+	return 0;
+}
+
+int CSocketPoller::Remove (CSocket *pSocket)
+{
+	int nIndex = Find (pSocket);
+	if (nIndex < 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	pSocket->SetReadinessEvent (0);
+
+	// the order of the entries does not matter
+	assert (m_nSockets > 0);
+	m_pEntry[nIndex] = m_pEntry[--m_nSockets];
+
+	if (m_nNextEntry >= m_nSockets)
+	{
+		m_nNextEntry = 0;
+	}
+
+	return 0;
+}
+
+int CSocketPoller::Wait (TEvent *pEvents, unsigned nMaxEvents, unsigned nMicroSeconds)
+{
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	while (1)
+	{
+		// the event is set by the network task on each status change from now on
+		m_Event.Clear ();
+
+		int nResult = Poll (pEvents, nMaxEvents);
+		if (nResult != 0)
+		{
+			return nResult;
+		}
+
+		if (nMicroSeconds == 0)
+		{
+			m_Event.Wait ();
+
+			continue;
+		}
+
+		unsigned nElapsed = CTimer::GetClockTicks () - nStartTicks;
+		if (   nElapsed >= nMicroSeconds
+		    || m_Event.WaitWithTimeout (nMicroSeconds - nElapsed))
+		{
+			return Poll (pEvents, nMaxEvents);
+		}
+	}
+}
+
+int CSocketPoller::Poll (TEvent *pEvents, unsigned nMaxEvents)
+{
+	if (   pEvents == 0
+	    || nMaxEvents == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	unsigned nResult = 0;
+
+	// start behind the last reported socket, so that all sockets get served
+	unsigned nIndex = m_nNextEntry;
+	for (unsigned i = 0; i < m_nSockets && nResult < nMaxEvents; i++)
+	{
+		assert (nIndex < m_nSockets);
+		TEntry *pEntry = &m_pEntry[nIndex];
+
+		if (++nIndex >= m_nSockets)
+		{
+			nIndex = 0;
+		}
+
+		assert (pEntry->pSocket != 0);
+		unsigned nReady =   GetReadiness (pEntry->pSocket, &pEntry->bWasConnected)
+				  & pEntry->nEvents;
+
+		if (pEntry->nEvents & SOCKET_POLL_EDGE_TRIGGERED)
+		{
+			unsigned nReported = pEntry->nReported;
+			pEntry->nReported = nReady;		// events which went away are re-armed
+
+			nReady &= ~nReported;
+		}
+
+		if (nReady == 0)
+		{
+			continue;
+		}
+
+		pEvents[nResult].pSocket = pEntry->pSocket;
+		pEvents[nResult].nEvents = nReady;
+		pEvents[nResult].pParam = pEntry->pParam;
+		nResult++;
+
+		m_nNextEntry = nIndex;
+	}
+
+	return nResult;
+}
+
+int CSocketPoller::Find (CSocket *pSocket) const
+{
+	for (unsigned i = 0; i < m_nSockets; i++)
+	{
+		if (m_pEntry[i].pSocket == pSocket)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+unsigned CSocketPoller::GetReadiness (CSocket *pSocket, boolean *pWasConnected)
+{
+	assert (pSocket != 0);
+	CSocket::TStatus Status = pSocket->GetStatus ();
+
+	if (pSocket->IsListening ())
+	{
+		return Status.bRxReady ? SOCKET_POLL_ACCEPT : 0;
+	}
+
+	unsigned nReady = 0;
+
+	if (Status.bRxReady)
+	{
+		nReady |= SOCKET_POLL_READABLE;
+	}
+
+	if (Status.bTxReady)
+	{
+		nReady |= SOCKET_POLL_WRITABLE;
+	}
+
+	assert (pWasConnected != 0);
+	if (Status.bConnected)
+	{
+		*pWasConnected = TRUE;
+	}
+	else if (*pWasConnected)
+	{
+		nReady |= SOCKET_POLL_ERROR;
+	}
+
+	if (Status.bException)
+	{
+		nReady |= SOCKET_POLL_ERROR;
+	}
+
+	return nReady;
+}
@@ -115,16 +115,10 @@ void CSysLogDaemon::Run (void)
 	{
 		m_Event.Clear ();
 
-		TLogSeverity Severity;
-		char Source[LOG_MAX_SOURCE];
-		char Message[LOG_MAX_MESSAGE];
-		time_t Time;
-		unsigned nHundredthTime;
-		int nTimeZone;
-		while (pLogger->ReadEvent (&Severity, Source, Message,
-					   &Time, &nHundredthTime, &nTimeZone))
+		TLogEvent Event;
+		while (pLogger->ReadEvent (&Event))
 		{
-			if (!SendMessage (Severity, Time, nHundredthTime, nTimeZone, Source, Message))
+			if (!SendMessage (Event))
 			{
 				CScheduler::Get ()->Sleep (20);
 			}
@@ -134,18 +128,14 @@ void CSysLogDaemon::Run (void)
 	}
 }
 
-boolean CSysLogDaemon::SendMessage (TLogSeverity Severity,
-				    time_t FullTime, unsigned nPartialTime, int nTimeNumOffset,
-				    const char *pAppName, const char *pMsg)
+boolean CSysLogDaemon::SendMessage (const TLogEvent &Event)
 {
-	assert (pAppName != 0);
-	assert (pMsg != 0);
-
 	CString Timestamp ("-");
 	CTime Time;
-	Time.Set (FullTime);
+	Time.Set (Event.Time);
 	if (Time.GetYear () > 1975)
 	{
+		int nTimeNumOffset = Event.nTimeZone;
 		char chTimeNumOffsetSign = '+';
 		if (nTimeNumOffset < 0)
 		{
@@ -155,14 +145,42 @@ boolean CSysLogDaemon::SendMessage (TLogSeverity Severity,
 
 		Timestamp.Format ("%04u-%02u-%02uT%02u:%02u:%02u.%02u%c%02d:%02d",
 				Time.GetYear (), Time.GetMonth (), Time.GetMonthDay (),
-				Time.GetHours (), Time.GetMinutes (), Time.GetSeconds (), nPartialTime,
+				Time.GetHours (), Time.GetMinutes (), Time.GetSeconds (),
+				Event.nHundredthTime,
 				chTimeNumOffsetSign, nTimeNumOffset / 60, nTimeNumOffset % 60);
 	}
 
+	// the fields are sent as STRUCTURED-DATA (RFC 5424 section 6.3)
+	CString StructuredData ("-");
+	if (Event.nFields > 0)
+	{
+		StructuredData = "[" SYSLOG_SD_ID;
+
+		for (unsigned i = 0; i < Event.nFields; i++)
+		{
+			StructuredData.Append (" ");
+			StructuredData.Append (Event.FieldKey[i]);
+			StructuredData.Append ("=\"");
+
+			// '"', '\\' and ']' must be escaped in PARAM-VALUE
+			for (const char *p = Event.FieldValue[i]; *p != '\0'; p++)
+			{
+				char Char[3] = {'\\', *p, '\0'};
+				StructuredData.Append (   *p == '"' || *p == '\\' || *p == ']'
+						       ? Char : Char+1);
+			}
+
+			StructuredData.Append ("\"");
+		}
+
+		StructuredData.Append ("]");
+	}
+
 	CString SysLogMsg;
-	SysLogMsg.Format ("<%u>%u %s %s %s - - - %s",
-			  CalculatePriority (pAppName, Severity), SYSLOG_VERSION,
-			  (const char *) Timestamp, (const char *) m_Hostname, pAppName, pMsg);
+	SysLogMsg.Format ("<%u>%u %s %s %s - - %s %s",
+			  CalculatePriority (Event.Source, Event.Severity), SYSLOG_VERSION,
+			  (const char *) Timestamp, (const char *) m_Hostname, Event.Source,
+			  (const char *) StructuredData, Event.Message);
 
 	assert (m_pSocket != 0);
 	if (   m_pSocket->Send ((const char *) SysLogMsg, SysLogMsg.GetLength (), MSG_DONTWAIT)
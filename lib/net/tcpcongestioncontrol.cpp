@@ -0,0 +1,96 @@
+//
+// tcpcongestioncontrol.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/tcpcongestioncontrol.h>
+#include <circle/net/tcpnewreno.h>
+#include <circle/net/tcpcubic.h>
+#include <assert.h>
+
+#define INITIAL_SSTHRESH	0x7FFFFFFFU	// "arbitrarily high" (RFC 5681 section 3.1)
+
+CTCPCongestionControl::CTCPCongestionControl (void)
+:	m_nMSS (536),
+	m_nCongestionWindow (4 * 536),
+	m_nSlowStartThreshold (INITIAL_SSTHRESH)
+{
+}
+
+CTCPCongestionControl::~CTCPCongestionControl (void)
+{
+}
+
+void CTCPCongestionControl::Initialize (unsigned nMSS)
+{
+	assert (nMSS > 0);
+	m_nMSS = nMSS;
+
+	// RFC 6928 section 2
+	unsigned nWindow = 2 * m_nMSS;
+	if (nWindow < 14600)
+	{
+		nWindow = 14600;
+	}
+	if (nWindow > 10 * m_nMSS)
+	{
+		nWindow = 10 * m_nMSS;
+	}
+
+	m_nCongestionWindow = nWindow;
+	m_nSlowStartThreshold = INITIAL_SSTHRESH;
+}
+
+void CTCPCongestionControl::RetransmissionTimeout (unsigned nFlightSize)
+{
+	// RFC 5681 section 3.1 (4)
+	m_nSlowStartThreshold = nFlightSize / 2;
+	if (m_nSlowStartThreshold < 2 * m_nMSS)
+	{
+		m_nSlowStartThreshold = 2 * m_nMSS;
+	}
+
+	m_nCongestionWindow = m_nMSS;		// loss window
+}
+
+unsigned CTCPCongestionControl::GetPacingGain (void) const
+{
+	return IsSlowStart () ? 200 : 120;
+}
+
+CTCPCongestionControl *CTCPCongestionControl::Create (TTCPCongestionAlgorithm Algorithm)
+{
+	CTCPCongestionControl *pResult = 0;
+
+	switch (Algorithm)
+	{
+	case TCPCongestionNewReno:
+		pResult = new CTCPNewReno;
+		break;
+
+	case TCPCongestionCUBIC:
+		pResult = new CTCPCubic;
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	assert (pResult != 0);
+	return pResult;
+}
@@ -33,7 +33,9 @@
 #include <circle/macros.h>
 #include <circle/util.h>
 #include <circle/logger.h>
+#include <circle/metrics.h>
 #include <circle/net/in.h>
+#include <circle/net/netmemory.h>
 #include <assert.h>
 
 //#define TCP_DEBUG
@@ -48,11 +50,22 @@
 
 #define TCP_CONFIG_RETRANS_BUFFER_SIZE	0x10000	// should be greater than maximum send window size
 
+#define TCP_CONFIG_WINDOW_SHIFT		5	// own window scale, TCP_MAX_BUFFER_SIZE must fit
+
 #define TCP_MAX_WINDOW			((u16) -1)	// without Window extension option
+#define TCP_MAX_WINDOW_SHIFT		14	// RFC 7323 section 2.3
+
+#define TCP_DUPACK_THRESHOLD		3	// duplicate ACKs before selective retransmission
 #define TCP_QUIET_TIME			30	// seconds after crash before another connection starts
 
 #define HZ_TIMEWAIT			(60 * HZ)
 #define HZ_FIN_TIMEOUT			(60 * HZ)	// timeout in FIN-WAIT-2 state
+#define HZ_DELAYED_ACK			(HZ / 25)	// 40ms, must be less than 0.5s
+#define HZ_CORK_TIMEOUT			(HZ / 5)	// partial segments are held up to 200ms
+
+#define TCP_DELAYED_ACK_SEGMENTS	2	// ACK at least every second full segment
+
+#define TCP_GSO_MAX_LENGTH		0x10000U	// max. bytes handed down at once
 
 #define MAX_RETRANSMISSIONS		5
 
@@ -91,12 +104,28 @@ struct TTCPOption
 #define TCP_OPTION_MSS		2	//	Maximum segment size (2 byte)
 #define TCP_OPTION_WINDOW_SCALE	3	//	Shift count (1 byte)
 #define TCP_OPTION_SACK_PERM	4	//	None
+#define TCP_OPTION_SACK		5	//	Left edge, right edge of blocks (n*2*4 byte)
 #define TCP_OPTION_TIMESTAMP	8	//	Timestamp value, Timestamp echo reply (2*4 byte)
 	u8	nLength;
 	u8	Data[];
 }
 PACKED;
 
+#define TCP_OPTION_TIMESTAMP_SPACE	12	// including two NOPs for alignment
+#define TCP_MAX_SACK_BLOCKS		4	// per segment
+
+struct TTCPSegmentOptions		// options of a received segment
+{
+	boolean	bWindowScale;
+	unsigned nWindowShift;
+	boolean	bSACKPermitted;
+	boolean	bTimestamp;
+	u32	nTSval;
+	u32	nTSecr;
+	unsigned nSACKBlocks;
+	TTCPSACKBlock SACK[TCP_MAX_SACK_BLOCKS];
+};
+
 #define min(n, m)		((n) <= (m) ? (n) : (m))
 #define max(n, m)		((n) >= (m) ? (n) : (m))
 
@@ -142,6 +171,13 @@ const char *CTCPConnection::s_pStateName[] =	// must match TTCPState
 
 static const char FromTCP[] = "tcp";
 
+static CMetricCounter s_Retransmissions ("circle_tcp_retransmission_timeouts_total",
+					 "Expired TCP retransmission timers of all connections");
+static CMetricCounter s_SelectiveRetransmissions ("circle_tcp_selective_retransmissions_total",
+						  "TCP retransmissions triggered by SACK information");
+static CMetricCounter s_FastRetransmits ("circle_tcp_fast_retransmits_total",
+					 "TCP fast retransmits after duplicate ACKs");
+
 CTCPConnection::CTCPConnection (CNetConfig	*pNetConfig,
 				CNetworkLayer	*pNetworkLayer,
 				const CIPAddress &rForeignIP,
@@ -162,13 +198,45 @@ CTCPConnection::CTCPConnection (CNetConfig	*pNetConfig,
 	m_nSND_UP (0),
 	m_nRCV_NXT (0),
 	m_nRCV_WND (TCP_CONFIG_WINDOW),
+	m_nRCV_ADV (0),
 	m_nIRS (0),
 	m_nSND_MSS (536),	// RFC 1122 section 4.2.2.6
+	m_bWindowScaling (FALSE),
+	m_nSND_SCALE (0),
+	m_nRCV_SCALE (0),
+	m_bTimestamps (FALSE),
+	m_nTS_RECENT (0),
+	m_nLAST_ACK_SENT (0),
+	m_bSACKPermitted (FALSE),
+	m_nScoreboardBlocks (0),
+	m_pCongestionControl (CTCPCongestionControl::Create ()),
+	m_nDuplicateACKs (0),
+	m_bInRecovery (FALSE),
+	m_nRecoveryPoint (0),
+	m_nHighRxt (0),
+	m_bFastRetransmit (FALSE),
+	m_nRecoveryInflation (0),
+#ifdef TCP_PACING
+	m_nPacingCredit (0),
+	m_nPacingClockTicks (0),
+#endif
+	m_bNoDelay (FALSE),
+	m_bCork (FALSE),
+	m_bMoreData (FALSE),
+	m_bHolding (FALSE),
+	m_nHoldTicks (0),
+	m_nSegmentsUnacked (0),
+	m_bSendDelayedACK (FALSE),
+	m_pRxPacket (0),
+	m_nRxSegments (1),
+	m_nRxQueued (0),
 	m_nReceiveTimeout (0),
 	m_nSendTimeout (0)
 {
 	s_nConnections++;
 
+	CNetMemory::Charge (m_RetransmissionQueue.GetSize ());
+
 	for (unsigned nTimer = TCPTimerUser; nTimer < TCPTimerUnknown; nTimer++)
 	{
 		m_hTimer[nTimer] = 0;
@@ -207,13 +275,45 @@ CTCPConnection::CTCPConnection (CNetConfig	*pNetConfig,
 	m_nSND_UP (0),
 	m_nRCV_NXT (0),
 	m_nRCV_WND (TCP_CONFIG_WINDOW),
+	m_nRCV_ADV (0),
 	m_nIRS (0),
 	m_nSND_MSS (536),	// RFC 1122 section 4.2.2.6
+	m_bWindowScaling (FALSE),
+	m_nSND_SCALE (0),
+	m_nRCV_SCALE (0),
+	m_bTimestamps (FALSE),
+	m_nTS_RECENT (0),
+	m_nLAST_ACK_SENT (0),
+	m_bSACKPermitted (FALSE),
+	m_nScoreboardBlocks (0),
+	m_pCongestionControl (CTCPCongestionControl::Create ()),
+	m_nDuplicateACKs (0),
+	m_bInRecovery (FALSE),
+	m_nRecoveryPoint (0),
+	m_nHighRxt (0),
+	m_bFastRetransmit (FALSE),
+	m_nRecoveryInflation (0),
+#ifdef TCP_PACING
+	m_nPacingCredit (0),
+	m_nPacingClockTicks (0),
+#endif
+	m_bNoDelay (FALSE),
+	m_bCork (FALSE),
+	m_bMoreData (FALSE),
+	m_bHolding (FALSE),
+	m_nHoldTicks (0),
+	m_nSegmentsUnacked (0),
+	m_bSendDelayedACK (FALSE),
+	m_pRxPacket (0),
+	m_nRxSegments (1),
+	m_nRxQueued (0),
 	m_nReceiveTimeout (0),
 	m_nSendTimeout (0)
 {
 	s_nConnections++;
 
+	CNetMemory::Charge (m_RetransmissionQueue.GetSize ());
+
 	for (unsigned nTimer = TCPTimerUser; nTimer < TCPTimerUnknown; nTimer++)
 	{
 		m_hTimer[nTimer] = 0;
@@ -233,10 +333,16 @@ CTCPConnection::~CTCPConnection (void)
 		StopTimer (nTimer);
 	}
 
+	delete m_pCongestionControl;
+	m_pCongestionControl = 0;
+
 	// ensure no task is waiting any more
 	m_Event.Set ();
 	m_TxEvent.Set ();
 
+	FlushRxQueue ();
+	CNetMemory::Uncharge (m_RetransmissionQueue.GetSize ());
+
 	assert (s_nConnections > 0);
 	s_nConnections--;
 }
@@ -370,8 +476,65 @@ int CTCPConnection::Close (void)
 
 int CTCPConnection::Send (const void *pData, unsigned nLength, int nFlags)
 {
-	if (   nFlags != 0
-	    && nFlags != MSG_DONTWAIT)
+	int nResult = WaitSend (nFlags);
+	if (nResult < 0)
+	{
+		return nResult;
+	}
+
+	nResult = nLength;
+
+	assert (pData != 0);
+	u8 *pBuffer = (u8 *) pData;
+
+	while (nLength > FRAME_BUFFER_SIZE)
+	{
+		m_TxQueue.Enqueue (pBuffer, FRAME_BUFFER_SIZE);
+
+		pBuffer += FRAME_BUFFER_SIZE;
+		nLength -= FRAME_BUFFER_SIZE;
+	}
+
+	if (nLength > 0)
+	{
+		m_TxQueue.Enqueue (pBuffer, nLength);
+	}
+
+	m_bMoreData = nFlags & MSG_MORE ? TRUE : FALSE;
+
+	return nResult;
+}
+
+int CTCPConnection::SendBuffer (CNetBuffer *pBuffer, int nFlags)
+{
+	assert (pBuffer != 0);
+	unsigned nLength = pBuffer->GetTotalLength ();
+	if (   nLength == 0
+	    || nLength > FRAME_BUFFER_SIZE)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	int nResult = WaitSend (nFlags);
+	if (nResult < 0)
+	{
+		pBuffer->Release ();
+
+		return nResult;
+	}
+
+	m_TxQueue.Enqueue (pBuffer);
+
+	m_bMoreData = nFlags & MSG_MORE ? TRUE : FALSE;
+
+	return nLength;
+}
+
+int CTCPConnection::WaitSend (int nFlags)
+{
+	if (nFlags & ~(MSG_DONTWAIT | MSG_MORE))
 	{
 		return -NET_ERROR_INVALID_VALUE;
 	}
@@ -422,28 +585,26 @@ int CTCPConnection::Send (const void *pData, unsigned nLength, int nFlags)
 		}
 	}
 
-	unsigned nResult = nLength;
-
-	assert (pData != 0);
-	u8 *pBuffer = (u8 *) pData;
+	return 0;
+}
 
-	while (nLength > FRAME_BUFFER_SIZE)
+int CTCPConnection::Receive (void *pBuffer, int nFlags)
+{
+	CNetBuffer *pNetBuffer;
+	int nResult = ReceiveBuffer (&pNetBuffer, nFlags);
+	if (nResult > 0)
 	{
-		m_TxQueue.Enqueue (pBuffer, FRAME_BUFFER_SIZE);
-
-		pBuffer += FRAME_BUFFER_SIZE;
-		nLength -= FRAME_BUFFER_SIZE;
-	}
+		assert (pNetBuffer != 0);
+		assert (pBuffer != 0);
+		pNetBuffer->CopyTo (pBuffer);
 
-	if (nLength > 0)
-	{
-		m_TxQueue.Enqueue (pBuffer, nLength);
+		pNetBuffer->Release ();
 	}
 
 	return nResult;
 }
 
-int CTCPConnection::Receive (void *pBuffer, int nFlags)
+int CTCPConnection::ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags)
 {
 	if (   nFlags != 0
 	    && nFlags != MSG_DONTWAIT)
@@ -451,13 +612,16 @@ int CTCPConnection::Receive (void *pBuffer, int nFlags)
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
+	assert (ppBuffer != 0);
+	*ppBuffer = 0;
+
 	if (m_nErrno < 0)
 	{
 		return m_nErrno;
 	}
 	
-	unsigned nLength;
-	while ((nLength = m_RxQueue.Dequeue (pBuffer)) == 0)
+	CNetBuffer *pBuffer;
+	while ((pBuffer = m_RxQueue.DequeueBuffer ()) == 0)
 	{
 		switch (m_State)
 		{
@@ -502,6 +666,13 @@ int CTCPConnection::Receive (void *pBuffer, int nFlags)
 		}
 	}
 
+	unsigned nLength = pBuffer->GetTotalLength ();
+	assert (m_nRxQueued >= nLength);
+	m_nRxQueued -= nLength;
+	CNetMemory::Uncharge (nLength);		// the window is updated in Process()
+
+	*ppBuffer = pBuffer;
+
 	return nLength;
 }
 
@@ -530,6 +701,32 @@ int CTCPConnection::ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeign
 	return nResult;
 }
 
+int CTCPConnection::SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+				  const CIPAddress &rForeignIP, u16 nForeignPort)
+{
+	// ignore rForeignIP and nForeignPort
+	return SendBuffer (pBuffer, nFlags);
+}
+
+int CTCPConnection::ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+				       CIPAddress *pForeignIP, u16 *pForeignPort)
+{
+	int nResult = ReceiveBuffer (ppBuffer, nFlags);
+	if (nResult <= 0)
+	{
+		return nResult;
+	}
+
+	if (   pForeignIP != 0
+	    && pForeignPort != 0)
+	{
+		pForeignIP->Set (m_ForeignIP);
+		*pForeignPort = m_nForeignPort;
+	}
+
+	return nResult;
+}
+
 int CTCPConnection::SetOptionReceiveTimeout (unsigned nMicroSeconds)
 {
 	m_nReceiveTimeout = nMicroSeconds;
@@ -559,6 +756,69 @@ int CTCPConnection::SetOptionDropMembership (const CIPAddress &rGroupAddress)
 	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
 }
 
+int CTCPConnection::SetOptionReceiveBuffer (unsigned nBytes)
+{
+	if (   nBytes < TCP_CONFIG_MSS
+	    || nBytes > TCP_MAX_BUFFER_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	// the window can be scaled only, if the option has been negotiated on SYN
+	if (   m_State >= TCPStateSynReceived
+	    && !m_bWindowScaling
+	    && nBytes > TCP_MAX_WINDOW)
+	{
+		nBytes = TCP_MAX_WINDOW;
+	}
+
+	m_nRCV_WND = nBytes;
+
+	return 0;
+}
+
+int CTCPConnection::SetOptionNoDelay (boolean bNoDelay)
+{
+	m_bNoDelay = bNoDelay;
+
+	return 0;
+}
+
+int CTCPConnection::SetOptionCork (boolean bCork)
+{
+	m_bCork = bCork;
+
+	return 0;
+}
+
+int CTCPConnection::SetOptionSendBuffer (unsigned nBytes)
+{
+	if (   nBytes <= FRAME_BUFFER_SIZE
+	    || nBytes > TCP_MAX_BUFFER_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	// a larger buffer must fit into the network memory budget
+	unsigned nOldSize = m_RetransmissionQueue.GetSize ();
+	if (   nBytes+1 > nOldSize
+	    && !CNetMemory::CanGrow (nBytes+1 - nOldSize))
+	{
+		return -NET_ERROR_NO_BUFFER_SPACE;
+	}
+
+	// queue size must be one more, because one entry is always unused
+	if (!m_RetransmissionQueue.Resize (nBytes+1))
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	CNetMemory::Charge (m_RetransmissionQueue.GetSize ());
+	CNetMemory::Uncharge (nOldSize);
+
+	return 0;
+}
+
 boolean CTCPConnection::IsConnected (void) const
 {
 	return     m_State > TCPStateSynSent
@@ -580,6 +840,15 @@ void CTCPConnection::Process (void)
 		return;
 	}
 
+	// window update, after the user has read data or the memory pressure has gone
+	if (   (   m_State == TCPStateEstablished
+		|| m_State == TCPStateFinWait1
+		|| m_State == TCPStateFinWait2)
+	    && GetReceiveWindow () > GetOfferedWindow ())
+	{
+		SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+	}
+
 	switch (m_State)
 	{
 	case TCPStateClosed:
@@ -627,14 +896,26 @@ void CTCPConnection::Process (void)
 
 	u8 TempBuffer[FRAME_BUFFER_SIZE];
 	unsigned nLength;
+
+	CNetBuffer *pTxBuffer;
 	while (    m_RetransmissionQueue.GetFreeSpace () >= FRAME_BUFFER_SIZE
-		&& (nLength = m_TxQueue.Dequeue (TempBuffer)) > 0)
+		&& (pTxBuffer = m_TxQueue.DequeueBuffer ()) != 0)
 	{
 #ifdef TCP_DEBUG
-		CLogger::Get ()->Write (FromTCP, LogDebug, "Transfering %u bytes into RT buffer", nLength);
+		CLogger::Get ()->Write (FromTCP, LogDebug, "Transfering %u bytes into RT buffer",
+					pTxBuffer->GetTotalLength ());
 #endif
 
-		m_RetransmissionQueue.Write (TempBuffer, nLength);
+		for (CNetBuffer *pSegment = pTxBuffer; pSegment != 0;
+		     pSegment = pSegment->GetNextSegment ())
+		{
+			if (pSegment->GetLength () > 0)
+			{
+				m_RetransmissionQueue.Write (pSegment->GetData (), pSegment->GetLength ());
+			}
+		}
+
+		pTxBuffer->Release ();
 	}
 
 	// pacing transmit
@@ -651,24 +932,60 @@ void CTCPConnection::Process (void)
 		CLogger::Get ()->Write (FromTCP, LogDebug, "Retransmission (nxt %u, una %u)", m_nSND_NXT-m_nISS, m_nSND_UNA-m_nISS);
 #endif
 		m_bRetransmit = FALSE;
+
+		assert (m_pCongestionControl != 0);
+		m_pCongestionControl->RetransmissionTimeout (m_nSND_NXT-m_nSND_UNA);
+
 		m_RetransmissionQueue.Reset ();
 		m_nSND_NXT = m_nSND_UNA;
+
+		// the receiver may have discarded SACK-ed data (RFC 2018 section 8)
+		m_nScoreboardBlocks = 0;
+		m_bInRecovery = FALSE;
+		m_bFastRetransmit = FALSE;
+		m_nRecoveryInflation = 0;
+		m_nDuplicateACKs = 0;
 	}
+	else if (m_bFastRetransmit)
+	{
+		m_bFastRetransmit = FALSE;
+		FastRetransmit ();
+	}
+
+	unsigned nMaxData = GetMaxSegmentData ();
+
+	assert (m_pCongestionControl != 0);
+	u32 nCongestionWindow = m_pCongestionControl->GetWindow () + m_nRecoveryInflation;
+#ifdef TCP_PACING
+	UpdatePacingCredit (nCongestionWindow);
+#endif
 
 	u32 nBytesAvail;
 	u32 nWindowLeft;
 	while (   (nBytesAvail = m_RetransmissionQueue.GetBytesAvailable ()) > 0
-	       && (nWindowLeft = m_nSND_UNA+m_nSND_WND-m_nSND_NXT) > 0)
+	       && (nWindowLeft = m_nSND_UNA+m_nSND_WND-m_nSND_NXT) > 0
+	       && GetFlightSize () < nCongestionWindow)
 	{
+#ifdef TCP_PACING
+		if (m_nPacingCredit <= 0)
+		{
+			break;
+		}
+#endif
+
 		nLength = min (nBytesAvail, nWindowLeft);
-		nLength = min (nLength, m_nSND_MSS);
+		nLength = min (nLength, nMaxData);
 
-#ifdef TCP_DEBUG
-		CLogger::Get ()->Write (FromTCP, LogDebug, "Transfering %u bytes into TX buffer", nLength);
-#endif
+		// hold back the last partial segment, but not on close
+		if (   nLength < nMaxData
+		    && nLength == nBytesAvail
+		    && !m_bFINQueued
+		    && HoldPartialSegment ())
+		{
+			break;
+		}
 
-		assert (nLength <= FRAME_BUFFER_SIZE);
-		m_RetransmissionQueue.Read (TempBuffer, nLength);
+		m_bHolding = FALSE;
 
 		unsigned nFlags = TCP_FLAG_ACK;
 		if (m_TxQueue.IsEmpty ())
@@ -676,11 +993,91 @@ void CTCPConnection::Process (void)
 			nFlags |= TCP_FLAG_PUSH;
 		}
 
+#ifdef NET_SEGMENTATION_OFFLOAD
+		if (nLength > nMaxData)
+		{
+			// send all full segments at once, which are allowed by the congestion window
+			// and the pacing credit, each may be exceeded by the last segment as before
+			u32 nBurst = nCongestionWindow - GetFlightSize ();
+#ifdef TCP_PACING
+			nBurst = min (nBurst, (u32) m_nPacingCredit);
+#endif
+			nBurst = min (nBurst, TCP_GSO_MAX_LENGTH);
+			nBurst = (nBurst + nMaxData-1) / nMaxData * nMaxData;
+
+			nLength = min (nLength, nBurst);
+			nLength -= nLength % nMaxData;	// a partial segment follows in the next loop
+			assert (nLength >= nMaxData);
+
+			if (nLength != nBytesAvail)
+			{
+				nFlags &= ~TCP_FLAG_PUSH;
+			}
+
+#ifdef TCP_DEBUG
+			CLogger::Get ()->Write (FromTCP, LogDebug, "Transfering %u bytes into TX buffers", nLength);
+#endif
+
+			SendSegments (nFlags, m_nSND_NXT, nLength);
+			m_RTOCalculator.SegmentSent (m_nSND_NXT, nLength);
+			m_nSND_NXT += nLength;
+			StartTimer (TCPTimerRetransmission, m_RTOCalculator.GetRTO ());
+
+#ifdef TCP_PACING
+			m_nPacingCredit -= nLength;
+#endif
+			continue;
+		}
+#endif
+
+#ifdef TCP_DEBUG
+		CLogger::Get ()->Write (FromTCP, LogDebug, "Transfering %u bytes into TX buffer", nLength);
+#endif
+
+		assert (nLength <= FRAME_BUFFER_SIZE);
+		m_RetransmissionQueue.Read (TempBuffer, nLength);
+
 		SendSegment (nFlags, m_nSND_NXT, m_nRCV_NXT, TempBuffer, nLength);
 		m_RTOCalculator.SegmentSent (m_nSND_NXT, nLength);
 		m_nSND_NXT += nLength;
 		StartTimer (TCPTimerRetransmission, m_RTOCalculator.GetRTO ());
+
+#ifdef TCP_PACING
+		m_nPacingCredit -= nLength;
+#endif
+	}
+
+	if (m_bSendDelayedACK)
+	{
+		m_bSendDelayedACK = FALSE;
+
+		if (m_nSegmentsUnacked > 0)
+		{
+			SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+		}
+	}
+}
+
+boolean CTCPConnection::HoldPartialSegment (void)
+{
+	if (   m_bCork
+	    || m_bMoreData)
+	{
+		assert (m_pTimer != 0);
+		if (!m_bHolding)
+		{
+			m_bHolding = TRUE;
+			m_nHoldTicks = m_pTimer->GetTicks ();
+
+			return TRUE;
+		}
+
+		return m_pTimer->GetTicks () - m_nHoldTicks < HZ_CORK_TIMEOUT;
 	}
+
+	// Nagle's algorithm: only one partial segment may be unacknowledged (RFC 896)
+	return    !m_bNoDelay
+	       && m_nSND_NXT != m_nSND_UNA;
 }
 
 int CTCPConnection::PacketReceived (const void	*pPacket,
@@ -725,7 +1122,9 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		m_Checksum.SetDestinationAddress (rSenderIP);
 	}
 
-	if (m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
+	if (   (   m_pRxPacket == 0
+		|| !m_pRxPacket->IsChecksumValid ())	// not verified by the hardware
+	    && m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
 	{
 		return 0;
 	}
@@ -749,10 +1148,15 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 	}
 	
 	u32 nSEG_WND = be2le16 (pHeader->nWindow);
+	if (!(nFlags & TCP_FLAG_SYN))
+	{
+		nSEG_WND <<= m_nSND_SCALE;	// window in SYN segment is never scaled
+	}
 	//u16 nSEG_UP  = be2le16 (pHeader->nUrgentPointer);
 	//u32 nSEG_PRC;	// segment precedence value
 
-	ScanOptions (pHeader);
+	TTCPSegmentOptions Options;
+	ScanOptions (pHeader, &Options);
 
 #ifdef TCP_DEBUG
 	CLogger::Get ()->Write (FromTCP, LogDebug,
@@ -772,6 +1176,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 #endif
 
 	boolean bAcceptable = FALSE;
+	u32 nRCV_WND;
 
 	// RFC 793 section 3.9 "SEGMENT ARRIVES"
 	switch (m_State)
@@ -814,6 +1219,13 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		}
 		else if (nFlags & TCP_FLAG_SYN)
 		{
+			// no new connection, while the socket buffers use all network memory,
+			// the SYN is dropped silently, so that the client retries later
+			if (CNetMemory::GetPressure () == NetMemoryCritical)
+			{
+				break;
+			}
+
 			if (s_nConnections >= TCP_MAX_CONNECTIONS)
 			{
 				m_ForeignIP.Set (rSenderIP);
@@ -826,17 +1238,20 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 			}
 
 			m_nRCV_NXT = nSEG_SEQ+1;
+			m_nRCV_ADV = m_nRCV_NXT;
 			m_nIRS = nSEG_SEQ;
 
 			m_nSND_WND = nSEG_WND;
 			m_nSND_WL1 = nSEG_SEQ;
 			m_nSND_WL2 = nSEG_ACK;
+
+			NegotiateOptions (&Options);
 	
 			assert (nSEG_LEN > 0);
 
 			if (nDataLength > 0)
 			{
-				m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+				QueueReceivedData (pPacket, nDataOffset, nDataLength);
 			}
 
 			m_nISS = CalculateISN ();
@@ -899,8 +1314,11 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		if (nFlags & TCP_FLAG_SYN)
 		{
 			m_nRCV_NXT = nSEG_SEQ+1;
+			m_nRCV_ADV = m_nRCV_NXT;
 			m_nIRS = nSEG_SEQ;
 
+			NegotiateOptions (&Options);
+
 			if (nFlags & TCP_FLAG_ACK)
 			{
 				m_RTOCalculator.SegmentAcknowledged (nSEG_ACK);
@@ -918,6 +1336,9 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 				NEW_STATE (TCPStateEstablished);
 				m_bSendSYN = FALSE;
 
+				assert (m_pCongestionControl != 0);
+				m_pCongestionControl->Initialize (GetMaxSegmentData ());
+
 				StopTimer (TCPTimerRetransmission);
 
 				// next transmission starts with this count
@@ -962,7 +1383,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 
 					if (nDataLength > 0)
 					{
-						m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+						QueueReceivedData (pPacket, nDataOffset, nDataLength);
 					}
 
 					break;
@@ -979,20 +1400,31 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 	case TCPStateClosing:
 	case TCPStateLastAck:
 	case TCPStateTimeWait:
-		// step 1 ( check sequence number)
-		if (m_nRCV_WND > 0)
+		// RFC 7323 section 5.3 R1 (PAWS)
+		if (   m_bTimestamps
+		    && Options.bTimestamp
+		    && !(nFlags & TCP_FLAG_RESET)
+		    && lt (Options.nTSval, m_nTS_RECENT))
+		{
+			SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+			break;
+		}
+
+		// step 1 ( check sequence number), against the window we have offered
+		nRCV_WND = GetOfferedWindow ();
+		if (nRCV_WND > 0)
 		{
 			if (nSEG_LEN == 0)
 			{
-				if (bwl (m_nRCV_NXT, nSEG_SEQ, m_nRCV_NXT+m_nRCV_WND))
+				if (bwl (m_nRCV_NXT, nSEG_SEQ, m_nRCV_NXT+nRCV_WND))
 				{
 					bAcceptable = TRUE;
 				}
 			}
 			else
 			{
-				if (   bwl (m_nRCV_NXT, nSEG_SEQ, m_nRCV_NXT+m_nRCV_WND)
-				    || bwl (m_nRCV_NXT, nSEG_SEQ+nSEG_LEN-1, m_nRCV_NXT+m_nRCV_WND))
+				if (   bwl (m_nRCV_NXT, nSEG_SEQ, m_nRCV_NXT+nRCV_WND)
+				    || bwl (m_nRCV_NXT, nSEG_SEQ+nSEG_LEN-1, m_nRCV_NXT+nRCV_WND))
 				{
 					bAcceptable = TRUE;
 				}
@@ -1016,6 +1448,15 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 			break;
 		}
 
+		// RFC 7323 section 4.3 (3)
+		if (   m_bTimestamps
+		    && Options.bTimestamp
+		    && ge (Options.nTSval, m_nTS_RECENT)
+		    && le (nSEG_SEQ, m_nLAST_ACK_SENT))
+		{
+			m_nTS_RECENT = Options.nTSval;
+		}
+
 		// step 2 (check RST bit)
 		if (nFlags & TCP_FLAG_RESET)
 		{
@@ -1045,7 +1486,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 				m_nErrno = -NET_ERROR_CONNECTION_RESET;
 				m_RetransmissionQueue.Flush ();
 				m_TxQueue.Flush ();
-				m_RxQueue.Flush ();
+				FlushRxQueue ();
 				NEW_STATE (TCPStateClosed);
 				m_Event.Set ();
 				return 1;
@@ -1080,7 +1521,7 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 			m_nErrno = -NET_ERROR_PROTOCOL_ERROR;
 			m_RetransmissionQueue.Flush ();
 			m_TxQueue.Flush ();
-			m_RxQueue.Flush ();
+			FlushRxQueue ();
 			NEW_STATE (TCPStateClosed);
 			m_Event.Set ();
 			return 1;
@@ -1108,6 +1549,9 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 
 				NEW_STATE (TCPStateEstablished);
 
+				assert (m_pCongestionControl != 0);
+				m_pCongestionControl->Initialize (GetMaxSegmentData ());
+
 				// next transmission starts with this count
 				m_nRetransmissionCount = MAX_RETRANSMISSIONS;
 			}
@@ -1124,11 +1568,55 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		case TCPStateClosing:
 			if (bwh (m_nSND_UNA, nSEG_ACK, m_nSND_NXT))
 			{
+				// RFC 7323 section 4.1
+				if (   m_bTimestamps
+				    && Options.bTimestamp
+				    && Options.nTSecr != 0)
+				{
+					assert (m_pTimer != 0);
+					m_RTOCalculator.RTTMeasured (m_pTimer->GetTicks () - Options.nTSecr);
+				}
+
 				m_RTOCalculator.SegmentAcknowledged (nSEG_ACK);
 
 				unsigned nBytesAck = nSEG_ACK-m_nSND_UNA;
+				u32 nFlightSize = GetFlightSize ();
 				m_nSND_UNA = nSEG_ACK;
 
+				m_nDuplicateACKs = 0;
+				PruneScoreboard ();
+				for (unsigned i = 0; i < Options.nSACKBlocks; i++)
+				{
+					UpdateScoreboard (Options.SACK[i].nLeft, Options.SACK[i].nRight);
+				}
+
+				assert (m_pCongestionControl != 0);
+				if (m_bInRecovery)
+				{
+					if (ge (m_nSND_UNA, m_nRecoveryPoint))
+					{
+						// full ACK, cwnd is ssthresh already (RFC 6582 section 3.2 (6))
+						m_bInRecovery = FALSE;
+						m_nRecoveryInflation = 0;
+					}
+					else
+					{
+						// partial ACK, RFC 6582 section 3.2 (5)
+						unsigned nMaxData = GetMaxSegmentData ();
+						m_nRecoveryInflation =   (  m_nRecoveryInflation > nBytesAck
+									  ? m_nRecoveryInflation - nBytesAck : 0)
+								       + (nBytesAck >= nMaxData ? nMaxData : 0);
+
+						m_bFastRetransmit = TRUE;
+					}
+				}
+				else if (2 * nFlightSize >= m_pCongestionControl->GetWindow ())
+				{
+					// do not grow the window, while it is not used
+					m_pCongestionControl->DataAcknowledged (nBytesAck,
+										m_RTOCalculator.GetSmoothedRTT ());
+				}
+
 				if (nSEG_ACK == m_nSND_NXT)	// all segments are acknowledged
 				{
 					StopTimer (TCPTimerRetransmission);
@@ -1168,17 +1656,60 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 			else if (le (nSEG_ACK, m_nSND_UNA))	// RFC 1122 section 4.2.2.20 (g)
 			{
 				// ignore duplicate ACK ...
-				
-				// RFC 1122 section 4.2.2.20 (g)
-				if (bwlh (m_nSND_UNA, nSEG_ACK, m_nSND_NXT))
+
+				// ... but use it for fast retransmit (RFC 5681 section 3.2)
+				if (   nSEG_ACK == m_nSND_UNA
+				    && nSEG_ACK != m_nSND_NXT
+				    && nDataLength == 0
+				    && !(nFlags & (TCP_FLAG_SYN | TCP_FLAG_FIN))
+				    && (   nSEG_WND == m_nSND_WND
+					|| Options.nSACKBlocks > 0))
 				{
-					// ... but update send window
-					if (   lt (m_nSND_WL1, nSEG_SEQ)
-					    || (   m_nSND_WL1 == nSEG_SEQ
-						&& le (m_nSND_WL2, nSEG_ACK)))
+					if (m_bSACKPermitted)
 					{
-						m_nSND_WND = nSEG_WND;
-						m_nSND_WL1 = nSEG_SEQ;
+						for (unsigned i = 0; i < Options.nSACKBlocks; i++)
+						{
+							UpdateScoreboard (Options.SACK[i].nLeft,
+									  Options.SACK[i].nRight);
+						}
+					}
+
+					if (m_bInRecovery)
+					{
+						if (!m_bSACKPermitted)
+						{
+							// RFC 6582 section 3.2 (4)
+							m_nRecoveryInflation += GetMaxSegmentData ();
+						}
+
+						m_bFastRetransmit = TRUE;
+					}
+					else if (++m_nDuplicateACKs >= TCP_DUPACK_THRESHOLD)
+					{
+						assert (m_pCongestionControl != 0);
+						m_pCongestionControl->CongestionDetected (m_nSND_NXT-m_nSND_UNA);
+
+						m_bInRecovery = TRUE;
+						m_nRecoveryPoint = m_nSND_NXT;
+						m_nHighRxt = m_nSND_UNA;
+						m_nRecoveryInflation =   m_bSACKPermitted
+								       ? 0 : TCP_DUPACK_THRESHOLD * GetMaxSegmentData ();
+						m_bFastRetransmit = TRUE;
+
+						s_FastRetransmits.Increment ();
+					}
+				}
+				
+				// RFC 1122 section 4.2.2.20 (g)
+				if (bwlh (m_nSND_UNA, nSEG_ACK, m_nSND_NXT))
+				{
+					// ... but update send window
+					if (   lt (m_nSND_WL1, nSEG_SEQ)
+					    || (   m_nSND_WL1 == nSEG_SEQ
+						&& le (m_nSND_WL2, nSEG_ACK)))
+					{
+						m_nSND_WND = nSEG_WND;
+						m_nSND_WL1 = nSEG_SEQ;
 						m_nSND_WL2 = nSEG_ACK;
 					}
 				}
@@ -1274,18 +1805,33 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 		case TCPStateEstablished:
 		case TCPStateFinWait1:
 		case TCPStateFinWait2:
+			if (   nSEG_SEQ == m_nRCV_NXT
+			    && nDataLength > GetOfferedWindow ())
+			{
+				// beyond the offered window, the peer will retransmit it
+				SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+				return 1;
+			}
+
 			if (nSEG_SEQ == m_nRCV_NXT)
 			{
 				if (nDataLength > 0)
 				{
-					m_RxQueue.Enqueue ((u8 *) pPacket+nDataOffset, nDataLength);
+					QueueReceivedData (pPacket, nDataOffset, nDataLength);
 
 					m_nRCV_NXT += nDataLength;
 
-					// m_nRCV_WND should be adjusted here (section 3.7)
-
-					// following ACK could be piggybacked with data
-					SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+					// delayed ACK (RFC 9293 section 3.8.6.3), may be piggybacked with data
+					if (   m_State == TCPStateEstablished
+					    && !(nFlags & TCP_FLAG_FIN)
+					    && (m_nSegmentsUnacked += m_nRxSegments) < TCP_DELAYED_ACK_SEGMENTS)
+					{
+						StartTimer (TCPTimerDelayedACK, HZ_DELAYED_ACK);
+					}
+					else
+					{
+						SendSegment (TCP_FLAG_ACK, m_nSND_NXT, m_nRCV_NXT);
+					}
 
 					if (nFlags & TCP_FLAG_PUSH)
 					{
@@ -1378,6 +1924,99 @@ int CTCPConnection::PacketReceived (const void	*pPacket,
 	return 1;
 }
 
+int CTCPConnection::BufferReceived (CNetBuffer *pPacket,
+				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
+{
+	assert (pPacket != 0);
+
+	assert (m_pRxPacket == 0);
+	m_pRxPacket = pPacket;
+
+	// the packet may be chained of segments, which have been merged (GRO),
+	// the header is always in the first segment and the checksum has been verified
+	m_nRxSegments = pPacket->GetSegmentCount ();
+	assert (m_nRxSegments == 1 || pPacket->IsChecksumValid ());
+
+	int nResult = PacketReceived (pPacket->GetData (), pPacket->GetTotalLength (),
+				      rSenderIP, rReceiverIP, nProtocol);
+
+	m_pRxPacket = 0;
+	m_nRxSegments = 1;
+
+	return nResult;
+}
+
+void CTCPConnection::QueueReceivedData (const void *pPacket, unsigned nDataOffset,
+					unsigned nDataLength)
+{
+	assert (nDataLength > 0);
+
+	// charged before queueing, the window announces the space left
+	m_nRxQueued += nDataLength;
+	CNetMemory::Charge (nDataLength);
+
+	if (   m_pRxPacket != 0
+	    && m_pRxPacket->GetData () == pPacket
+	    && m_pRxPacket->GetTotalLength () == nDataOffset + nDataLength)
+	{
+		// merged segments are queued one by one, so that each entry fits into a frame
+		CNetBuffer *pSegments = m_pRxPacket->DetachSegments ();
+
+		// keep the received buffer without copying, only remove the headers
+		m_pRxPacket->AddRef ();
+		m_pRxPacket->RemoveHeader (nDataOffset);
+
+		m_RxQueue.Enqueue (m_pRxPacket);
+
+		while (pSegments != 0)
+		{
+			CNetBuffer *pNext = pSegments->DetachSegments ();
+
+			m_RxQueue.Enqueue (pSegments);
+
+			pSegments = pNext;
+		}
+
+		m_pRxPacket = 0;
+
+		return;
+	}
+
+	assert (m_pRxPacket == 0 || m_pRxPacket->GetNextSegment () == 0);
+
+	m_RxQueue.Enqueue ((u8 *) pPacket + nDataOffset, nDataLength);
+}
+
+void CTCPConnection::FlushRxQueue (void)
+{
+	m_RxQueue.Flush ();
+
+	CNetMemory::Uncharge (m_nRxQueued);
+	m_nRxQueued = 0;
+}
+
+u32 CTCPConnection::GetReceiveWindow (void) const
+{
+	// the receive buffer may be limited by the memory pressure
+	u32 nBuffer = CNetMemory::LimitBuffer (m_nRCV_WND);
+	u32 nSpace = nBuffer > m_nRxQueued ? nBuffer - m_nRxQueued : 0;
+
+	// an offered window is not shrunk (RFC 9293 section 3.8.6.2.2) and it opens only
+	// by at least min (MSS, buffer / 2) (receiver side SWS avoidance, section 3.8.6.2.2)
+	u32 nOffered = GetOfferedWindow ();
+	if (nSpace < nOffered + min (nBuffer / 2, (u32) TCP_CONFIG_MSS))
+	{
+		return nOffered;
+	}
+
+	return nSpace;
+}
+
+u32 CTCPConnection::GetOfferedWindow (void) const
+{
+	return lt (m_nRCV_NXT, m_nRCV_ADV) ? m_nRCV_ADV - m_nRCV_NXT : 0;
+}
+
 int CTCPConnection::NotificationReceived (TICMPNotificationType  Type,
 					  CIPAddress		&rSenderIP,
 					  CIPAddress		&rReceiverIP,
@@ -1466,47 +2105,35 @@ CNetConnection::TStatus CTCPConnection::GetStatus (void) const
 boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 nAcknowledgmentNumber,
 				     const void *pData, unsigned nDataLength)
 {
-	unsigned nDataOffset = 5;
-	assert (nDataOffset * 4 == sizeof (TTCPHeader));
-	if (nFlags & TCP_FLAG_SYN)
-	{
-		nDataOffset++;
-	}
-	unsigned nHeaderLength = nDataOffset * 4;
-	
+	// the segment is built in place, so that the frame is aligned for DMA
+	CNetBuffer *pBuffer = CNetBuffer::Alloc (  NET_BUFFER_HEADROOM + sizeof (TEthernetHeader)
+						 + sizeof (TIPHeader));
+	assert (pBuffer != 0);
+	TTCPHeader *pHeader = BuildHeader (pBuffer, nFlags, nSequenceNumber, nAcknowledgmentNumber);
+	assert (pHeader != 0);
+
+	unsigned nHeaderLength = pBuffer->GetLength ();
 	unsigned nPacketLength = nHeaderLength + nDataLength;		// may wrap
 	assert (nPacketLength >= nHeaderLength);
-	assert (nHeaderLength <= FRAME_BUFFER_SIZE);
-
-	u8 TxBuffer[FRAME_BUFFER_SIZE];
-	TTCPHeader *pHeader = (TTCPHeader *) TxBuffer;
-
-	pHeader->nSourcePort	 	= le2be16 (m_nOwnPort);
-	pHeader->nDestPort	 	= le2be16 (m_nForeignPort);
-	pHeader->nSequenceNumber 	= le2be32 (nSequenceNumber);
-	pHeader->nAcknowledgmentNumber	= nFlags & TCP_FLAG_ACK ? le2be32 (nAcknowledgmentNumber) : 0;
-	pHeader->nDataOffsetFlags	= (nDataOffset << TCP_DATA_OFFSET_SHIFT) | nFlags;
-	pHeader->nWindow		= le2be16 (m_nRCV_WND);
-	pHeader->nUrgentPointer		= le2be16 (m_nSND_UP);
-
-	if (nFlags & TCP_FLAG_SYN)
-	{
-		TTCPOption *pOption = (TTCPOption *) pHeader->Options;
-
-		pOption->nKind   = TCP_OPTION_MSS;
-		pOption->nLength = 4;
-		pOption->Data[0] = TCP_CONFIG_MSS >> 8;
-		pOption->Data[1] = TCP_CONFIG_MSS & 0xFF;
-	}
 
 	if (nDataLength > 0)
 	{
 		assert (pData != 0);
-		memcpy (TxBuffer+nHeaderLength, pData, nDataLength);
+		memcpy (pBuffer->Append (nDataLength), pData, nDataLength);
 	}
 
-	pHeader->nChecksum = 0;		// must be 0 for calculation
-	pHeader->nChecksum = m_Checksum.Calculate (TxBuffer, nPacketLength);
+	assert (m_pNetworkLayer != 0);
+	if (m_pNetworkLayer->GetCapabilities () & NET_DEVICE_CAP_TX_CHECKSUM)
+	{
+		// the checksum will be completed by the hardware
+		pHeader->nChecksum = m_Checksum.CalculatePseudoHeader (nPacketLength);
+		pBuffer->SetChecksumPartial (pHeader, (u8 *) &pHeader->nChecksum - (u8 *) pHeader);
+	}
+	else
+	{
+		pHeader->nChecksum = 0;		// must be 0 for calculation
+		pHeader->nChecksum = m_Checksum.Calculate (pHeader, nPacketLength);
+	}
 
 #ifdef TCP_DEBUG
 	CLogger::Get ()->Write (FromTCP, LogDebug,
@@ -1523,12 +2150,173 @@ boolean CTCPConnection::SendSegment (unsigned nFlags, u32 nSequenceNumber, u32 n
 				nDataLength);
 #endif
 
+	return m_pNetworkLayer->SendFlow (&m_Flow, m_ForeignIP, pBuffer, IPPROTO_TCP);
+}
+
+#ifdef NET_SEGMENTATION_OFFLOAD
+
+boolean CTCPConnection::SendSegments (unsigned nFlags, u32 nSequenceNumber, unsigned nLength)
+{
+	assert (nLength > 0);
+
+	// the header is built only once and is copied in front of each segment by the IP layer
+	CNetBuffer *pSegments = CNetBuffer::Alloc ();
+	assert (pSegments != 0);
+	BuildHeader (pSegments, nFlags, nSequenceNumber, m_nRCV_NXT);
+	unsigned nHeaderLength = pSegments->GetLength ();
+
+	unsigned nMaxData = GetMaxSegmentData ();
+
+	// the payload is read from the retransmission queue directly into the segments
+	CNetBuffer *pLast = pSegments;
+	for (unsigned nOffset = 0; nOffset < nLength; nOffset += nMaxData)
+	{
+		unsigned nDataLength = min (nLength - nOffset, nMaxData);
+
+		// frame aligned for DMA, after the headers have been prepended
+		CNetBuffer *pPayload = CNetBuffer::Alloc (  NET_BUFFER_HEADROOM + sizeof (TEthernetHeader)
+							  + sizeof (TIPHeader) + nHeaderLength);
+		assert (pPayload != 0);
+		assert (nDataLength <= pPayload->GetTailroom ());
+		m_RetransmissionQueue.Read (pPayload->Append (nDataLength), nDataLength);
+
+		pLast->AppendSegment (pPayload);
+		pLast = pPayload;
+	}
+
+#ifdef TCP_DEBUG
+	CLogger::Get ()->Write (FromTCP, LogDebug, "tx %u bytes in %u segments, seq %u",
+				nLength, pSegments->GetSegmentCount () - 1, nSequenceNumber-m_nISS);
+#endif
+
 	assert (m_pNetworkLayer != 0);
-	return m_pNetworkLayer->Send (m_ForeignIP, TxBuffer, nPacketLength, IPPROTO_TCP);
+	return m_pNetworkLayer->SendSegmented (m_ForeignIP, pSegments, IPPROTO_TCP, &m_Flow);
+}
+
+#endif
+
+TTCPHeader *CTCPConnection::BuildHeader (CNetBuffer *pBuffer, unsigned nFlags,
+					 u32 nSequenceNumber, u32 nAcknowledgmentNumber)
+{
+	// options on SYN are sent, if we do an active OPEN or the peer has sent them
+	boolean bSYN = nFlags & TCP_FLAG_SYN ? TRUE : FALSE;
+	boolean bSendWindowScale   = bSYN && (!(nFlags & TCP_FLAG_ACK) || m_bWindowScaling);
+	boolean bSendSACKPermitted = bSYN && (!(nFlags & TCP_FLAG_ACK) || m_bSACKPermitted);
+	boolean bSendTimestamp =    !(nFlags & TCP_FLAG_RESET)
+				 && (m_bTimestamps || (bSYN && !(nFlags & TCP_FLAG_ACK)));
+
+	unsigned nDataOffset = 5;
+	assert (nDataOffset * 4 == sizeof (TTCPHeader));
+	if (bSYN)
+	{
+		nDataOffset++;			// MSS
+	}
+	if (bSendWindowScale)
+	{
+		nDataOffset++;
+	}
+	if (bSendSACKPermitted)
+	{
+		nDataOffset++;
+	}
+	if (bSendTimestamp)
+	{
+		nDataOffset += TCP_OPTION_TIMESTAMP_SPACE / 4;
+	}
+	unsigned nHeaderLength = nDataOffset * 4;
+
+	assert (pBuffer != 0);
+	assert (pBuffer->GetLength () == 0);
+	assert (nHeaderLength <= pBuffer->GetTailroom ());
+	u8 *pTxBuffer = (u8 *) pBuffer->Append (nHeaderLength);
+	TTCPHeader *pHeader = (TTCPHeader *) pTxBuffer;
+
+	pHeader->nSourcePort	 	= le2be16 (m_nOwnPort);
+	pHeader->nDestPort	 	= le2be16 (m_nForeignPort);
+	pHeader->nSequenceNumber 	= le2be32 (nSequenceNumber);
+	pHeader->nAcknowledgmentNumber	= nFlags & TCP_FLAG_ACK ? le2be32 (nAcknowledgmentNumber) : 0;
+	pHeader->nDataOffsetFlags	= (nDataOffset << TCP_DATA_OFFSET_SHIFT) | nFlags;
+	pHeader->nChecksum		= 0;
+	pHeader->nUrgentPointer		= le2be16 (m_nSND_UP);
+
+	u32 nWindow = GetReceiveWindow ();
+	if (!bSYN)
+	{
+		// round up, so that an offered window does not shrink by the scaling
+		nWindow = (nWindow + (1 << m_nRCV_SCALE) - 1) >> m_nRCV_SCALE;
+	}
+	nWindow = min (nWindow, TCP_MAX_WINDOW);
+	pHeader->nWindow		= le2be16 (nWindow);
+
+	// remember the right edge of the window, which has been offered now
+	if (   (nFlags & TCP_FLAG_ACK)
+	    && nAcknowledgmentNumber == m_nRCV_NXT)
+	{
+		m_nRCV_ADV = m_nRCV_NXT + (bSYN ? nWindow : nWindow << m_nRCV_SCALE);
+	}
+
+	u8 *pOption = (u8 *) pHeader->Options;
+	if (bSYN)
+	{
+		*pOption++ = TCP_OPTION_MSS;
+		*pOption++ = 4;
+		*pOption++ = TCP_CONFIG_MSS >> 8;
+		*pOption++ = TCP_CONFIG_MSS & 0xFF;
+	}
+
+	if (bSendWindowScale)
+	{
+		*pOption++ = TCP_OPTION_NOP;
+		*pOption++ = TCP_OPTION_WINDOW_SCALE;
+		*pOption++ = 3;
+		*pOption++ = TCP_CONFIG_WINDOW_SHIFT;
+	}
+
+	if (bSendSACKPermitted)
+	{
+		*pOption++ = TCP_OPTION_NOP;
+		*pOption++ = TCP_OPTION_NOP;
+		*pOption++ = TCP_OPTION_SACK_PERM;
+		*pOption++ = 2;
+	}
+
+	if (bSendTimestamp)
+	{
+		assert (m_pTimer != 0);
+		u32 nTSval = le2be32 (m_pTimer->GetTicks ());
+		u32 nTSecr = nFlags & TCP_FLAG_ACK ? le2be32 (m_nTS_RECENT) : 0;
+
+		*pOption++ = TCP_OPTION_NOP;
+		*pOption++ = TCP_OPTION_NOP;
+		*pOption++ = TCP_OPTION_TIMESTAMP;
+		*pOption++ = 10;
+		memcpy (pOption, &nTSval, 4);
+		memcpy (pOption+4, &nTSecr, 4);
+		pOption += 8;
+	}
+
+	assert (pOption == pTxBuffer+nHeaderLength);
+
+	if (nFlags & TCP_FLAG_ACK)
+	{
+		m_nLAST_ACK_SENT = nAcknowledgmentNumber;
+		m_nSegmentsUnacked = 0;
+	}
+
+	return pHeader;
 }
 
-void CTCPConnection::ScanOptions (TTCPHeader *pHeader)
+void CTCPConnection::ScanOptions (TTCPHeader *pHeader, TTCPSegmentOptions *pOptions)
 {
+	assert (pOptions != 0);
+	pOptions->bWindowScale = FALSE;
+	pOptions->nWindowShift = 0;
+	pOptions->bSACKPermitted = FALSE;
+	pOptions->bTimestamp = FALSE;
+	pOptions->nTSval = 0;
+	pOptions->nTSecr = 0;
+	pOptions->nSACKBlocks = 0;
+
 	assert (pHeader != 0);
 	unsigned nDataOffset = TCP_DATA_OFFSET (pHeader->nDataOffsetFlags)*4;
 	u8 *pHeaderEnd = (u8 *) pHeader+nDataOffset;
@@ -1543,7 +2331,7 @@ void CTCPConnection::ScanOptions (TTCPHeader *pHeader)
 
 		case TCP_OPTION_NOP:
 			pOption = (TTCPOption *) ((u8 *) pOption+1);
-			break;
+			continue;
 			
 		case TCP_OPTION_MSS:
 			if (   pOption->nLength == 4
@@ -1559,15 +2347,323 @@ void CTCPConnection::ScanOptions (TTCPHeader *pHeader)
 					m_nSND_MSS = (u16) nMSS;
 				}
 			}
-			// fall through
+			break;
+
+		case TCP_OPTION_WINDOW_SCALE:
+			if (   pOption->nLength == 3
+			    && (u8 *) pOption+3 <= pHeaderEnd)
+			{
+				pOptions->bWindowScale = TRUE;
+				pOptions->nWindowShift = min (pOption->Data[0], TCP_MAX_WINDOW_SHIFT);
+			}
+			break;
+
+		case TCP_OPTION_SACK_PERM:
+			if (pOption->nLength == 2)
+			{
+				pOptions->bSACKPermitted = TRUE;
+			}
+			break;
+
+		case TCP_OPTION_SACK:
+			if (   pOption->nLength >= 2+8
+			    && (pOption->nLength-2) % 8 == 0
+			    && (u8 *) pOption+pOption->nLength <= pHeaderEnd)
+			{
+				unsigned nBlocks = (pOption->nLength-2U) / 8;
+				nBlocks = min (nBlocks, TCP_MAX_SACK_BLOCKS-pOptions->nSACKBlocks);
+				for (unsigned i = 0; i < nBlocks; i++)
+				{
+					u32 nLeft, nRight;
+					memcpy (&nLeft, pOption->Data + i*8, 4);
+					memcpy (&nRight, pOption->Data + i*8 + 4, 4);
+
+					TTCPSACKBlock *pBlock = &pOptions->SACK[pOptions->nSACKBlocks++];
+					pBlock->nLeft = be2le32 (nLeft);
+					pBlock->nRight = be2le32 (nRight);
+				}
+			}
+			break;
+
+		case TCP_OPTION_TIMESTAMP:
+			if (   pOption->nLength == 10
+			    && (u8 *) pOption+10 <= pHeaderEnd)
+			{
+				u32 nTSval, nTSecr;
+				memcpy (&nTSval, pOption->Data, 4);
+				memcpy (&nTSecr, pOption->Data+4, 4);
+
+				pOptions->bTimestamp = TRUE;
+				pOptions->nTSval = be2le32 (nTSval);
+				pOptions->nTSecr = be2le32 (nTSecr);
+			}
+			break;
 
 		default:
-			pOption = (TTCPOption *) ((u8 *) pOption+pOption->nLength);
 			break;
 		}
+
+		if (pOption->nLength < 2)		// invalid option
+		{
+			return;
+		}
+
+		pOption = (TTCPOption *) ((u8 *) pOption+pOption->nLength);
+	}
+}
+
+void CTCPConnection::NegotiateOptions (const TTCPSegmentOptions *pOptions)
+{
+	assert (pOptions != 0);
+
+	// we have sent all options on active OPEN, so the peer decides
+	m_bWindowScaling = pOptions->bWindowScale;
+	if (m_bWindowScaling)
+	{
+		m_nSND_SCALE = (u8) pOptions->nWindowShift;
+		m_nRCV_SCALE = TCP_CONFIG_WINDOW_SHIFT;
+	}
+	else
+	{
+		m_nSND_SCALE = 0;
+		m_nRCV_SCALE = 0;
+
+		if (m_nRCV_WND > TCP_MAX_WINDOW)
+		{
+			m_nRCV_WND = TCP_MAX_WINDOW;
+		}
+	}
+
+	m_bSACKPermitted = pOptions->bSACKPermitted;
+
+	m_bTimestamps = pOptions->bTimestamp;
+	if (m_bTimestamps)
+	{
+		m_nTS_RECENT = pOptions->nTSval;
+	}
+}
+
+unsigned CTCPConnection::GetMaxSegmentData (void) const
+{
+	if (m_bTimestamps)
+	{
+		assert (m_nSND_MSS > TCP_OPTION_TIMESTAMP_SPACE);
+		return m_nSND_MSS - TCP_OPTION_TIMESTAMP_SPACE;	// RFC 6691
+	}
+
+	return m_nSND_MSS;
+}
+
+void CTCPConnection::UpdateScoreboard (u32 nLeft, u32 nRight)
+{
+	if (lt (nLeft, m_nSND_UNA))
+	{
+		nLeft = m_nSND_UNA;			// partly acknowledged already
+	}
+
+	if (   !lt (nLeft, nRight)
+	    || gt (nRight, m_nSND_NXT))		// invalid or D-SACK block
+	{
+		return;
+	}
+
+	// insert the block, merge overlapping and adjacent blocks
+	TTCPSACKBlock Result[TCP_MAX_SACK_SCOREBOARD+1];
+	unsigned nResult = 0;
+	boolean bInserted = FALSE;
+
+	for (unsigned i = 0; i < m_nScoreboardBlocks; i++)
+	{
+		const TTCPSACKBlock &rBlock = m_Scoreboard[i];
+
+		if (lt (rBlock.nRight, nLeft))
+		{
+			Result[nResult++] = rBlock;
+		}
+		else if (lt (nRight, rBlock.nLeft))
+		{
+			if (!bInserted)
+			{
+				Result[nResult].nLeft = nLeft;
+				Result[nResult++].nRight = nRight;
+				bInserted = TRUE;
+			}
+
+			Result[nResult++] = rBlock;
+		}
+		else
+		{
+			if (lt (rBlock.nLeft, nLeft))
+			{
+				nLeft = rBlock.nLeft;
+			}
+
+			if (gt (rBlock.nRight, nRight))
+			{
+				nRight = rBlock.nRight;
+			}
+		}
+	}
+
+	if (!bInserted)
+	{
+		Result[nResult].nLeft = nLeft;
+		Result[nResult++].nRight = nRight;
+	}
+
+	// drop the topmost block on overflow, this only suppresses a retransmission
+	m_nScoreboardBlocks = min (nResult, TCP_MAX_SACK_SCOREBOARD);
+	memcpy (m_Scoreboard, Result, m_nScoreboardBlocks * sizeof (TTCPSACKBlock));
+}
+
+void CTCPConnection::PruneScoreboard (void)
+{
+	unsigned nBlocks = 0;
+	for (unsigned i = 0; i < m_nScoreboardBlocks; i++)
+	{
+		if (gt (m_Scoreboard[i].nRight, m_nSND_UNA))
+		{
+			m_Scoreboard[nBlocks] = m_Scoreboard[i];
+			if (lt (m_Scoreboard[nBlocks].nLeft, m_nSND_UNA))
+			{
+				m_Scoreboard[nBlocks].nLeft = m_nSND_UNA;
+			}
+
+			nBlocks++;
+		}
 	}
+
+	m_nScoreboardBlocks = nBlocks;
 }
 
+void CTCPConnection::FastRetransmit (void)
+{
+	u8 TempBuffer[FRAME_BUFFER_SIZE];
+	unsigned nMaxData = GetMaxSegmentData ();
+	unsigned nUnacknowledged = m_RetransmissionQueue.GetBytesUnacknowledged ();
+
+	u32 nSeq = m_nHighRxt;
+	if (lt (nSeq, m_nSND_UNA))
+	{
+		nSeq = m_nSND_UNA;
+	}
+
+	if (m_nScoreboardBlocks == 0)
+	{
+		// NewReno: retransmit the first unacknowledged segment once (RFC 6582)
+		if (   nSeq != m_nSND_UNA
+		    || nUnacknowledged == 0)
+		{
+			return;
+		}
+
+		unsigned nLength = min (nUnacknowledged, nMaxData);
+
+		assert (nLength <= FRAME_BUFFER_SIZE);
+		m_RetransmissionQueue.ReadAt (0, TempBuffer, nLength);
+
+		SendSegment (TCP_FLAG_ACK, nSeq, m_nRCV_NXT, TempBuffer, nLength);
+		m_nHighRxt = nSeq+nLength;
+
+		StartTimer (TCPTimerRetransmission, m_RTOCalculator.GetRTO ());
+
+		return;
+	}
+
+	// SACK: retransmit the holes below the SACK-ed blocks (RFC 2018)
+	boolean bSent = FALSE;
+	for (unsigned i = 0; i < m_nScoreboardBlocks; i++)
+	{
+		const TTCPSACKBlock &rBlock = m_Scoreboard[i];
+
+		while (lt (nSeq, rBlock.nLeft))
+		{
+			unsigned nOffset = nSeq-m_nSND_UNA;
+			if (nOffset >= nUnacknowledged)
+			{
+				break;
+			}
+
+			unsigned nLength = min (rBlock.nLeft-nSeq, nMaxData);
+			nLength = min (nLength, nUnacknowledged-nOffset);
+
+#ifdef TCP_DEBUG
+			CLogger::Get ()->Write (FromTCP, LogDebug, "Selective retransmission (seq %u, len %u)",
+						nSeq-m_nISS, nLength);
+#endif
+
+			assert (nLength <= FRAME_BUFFER_SIZE);
+			m_RetransmissionQueue.ReadAt (nOffset, TempBuffer, nLength);
+
+			SendSegment (TCP_FLAG_ACK, nSeq, m_nRCV_NXT, TempBuffer, nLength);
+			nSeq += nLength;
+			bSent = TRUE;
+		}
+
+		if (lt (nSeq, rBlock.nRight))
+		{
+			nSeq = rBlock.nRight;
+		}
+	}
+
+	m_nHighRxt = nSeq;
+
+	if (bSent)
+	{
+		s_SelectiveRetransmissions.Increment ();
+
+		StartTimer (TCPTimerRetransmission, m_RTOCalculator.GetRTO ());
+	}
+}
+
+u32 CTCPConnection::GetFlightSize (void) const
+{
+	u32 nFlightSize = m_nSND_NXT-m_nSND_UNA;
+
+	for (unsigned i = 0; i < m_nScoreboardBlocks; i++)
+	{
+		u32 nBlockSize = m_Scoreboard[i].nRight-m_Scoreboard[i].nLeft;
+		nFlightSize = nFlightSize > nBlockSize ? nFlightSize-nBlockSize : 0;
+	}
+
+	return nFlightSize;
+}
+
+#ifdef TCP_PACING
+
+void CTCPConnection::UpdatePacingCredit (u32 nCongestionWindow)
+{
+	unsigned nClockTicks = CTimer::GetClockTicks ();
+	unsigned nElapsed = nClockTicks-m_nPacingClockTicks;
+	m_nPacingClockTicks = nClockTicks;
+
+	// allow bursts of a quarter of the window, so that a slow poll rate does not limit
+	int nMaxCredit = max (nCongestionWindow / 4, 2 * GetMaxSegmentData ());
+
+	unsigned nSRTT = m_RTOCalculator.GetSmoothedRTT ();
+	if (nSRTT == 0)				// no RTT sample yet, do not pace
+	{
+		m_nPacingCredit = nMaxCredit;
+
+		return;
+	}
+
+	if (nElapsed > nSRTT)
+	{
+		nElapsed = nSRTT;
+	}
+
+	// rate = gain * cwnd / SRTT
+	assert (m_pCongestionControl != 0);
+	u64 nCredit =   (u64) nElapsed * nCongestionWindow * m_pCongestionControl->GetPacingGain ()
+		      / (100ULL * nSRTT);
+
+	s64 nNewCredit = (s64) m_nPacingCredit + (s64) nCredit;	// may be negative
+	m_nPacingCredit = nNewCredit > nMaxCredit ? nMaxCredit : (int) nNewCredit;
+}
+
+#endif
+
 u32 CTCPConnection::CalculateISN (void)
 {
 	assert (m_pTimer != 0);
@@ -1625,6 +2721,8 @@ void CTCPConnection::TimerHandler (unsigned nTimer)
 	case TCPTimerRetransmission:
 		m_RTOCalculator.RetransmissionTimerExpired ();
 
+		s_Retransmissions.Increment ();
+
 		if (m_nRetransmissionCount-- == 0)
 		{
 			m_bTimedOut = TRUE;
@@ -1665,6 +2763,10 @@ void CTCPConnection::TimerHandler (unsigned nTimer)
 		NEW_STATE (TCPStateClosed);
 		break;
 
+	case TCPTimerDelayedACK:
+		m_bSendDelayedACK = TRUE;
+		break;
+
 	case TCPTimerUser:
 	case TCPTimerUnknown:
 		assert (0);
@@ -1688,11 +2790,12 @@ void CTCPConnection::TimerStub (TKernelTimerHandle hTimer, void *pParam, void *p
 void CTCPConnection::DumpStatus (void)
 {
 	CLogger::Get ()->Write (FromTCP, LogDebug,
-				"sta %u, una %u, snx %u, swn %u, rnx %u, rwn %u, fprt %u",
+				"sta %u, una %u, snx %u, swn %u, cwn %u, rnx %u, rwn %u, fprt %u",
 				m_State,
 				m_nSND_UNA-m_nISS,
 				m_nSND_NXT-m_nISS,
 				m_nSND_WND,
+				m_pCongestionControl->GetWindow (),
 				m_nRCV_NXT-m_nIRS,
 				m_nRCV_WND,
 				(unsigned) m_nForeignPort);
@@ -0,0 +1,208 @@
+//
+// tcpcubic.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/tcpcubic.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+// all factors multiplied by 1000
+#define CUBIC_C			400		// 0.4 segments / second^3
+#define CUBIC_BETA		700		// multiplicative decrease factor
+#define CUBIC_ALPHA		529		// 3 * (1 - beta) / (1 + beta)
+
+#define MAX_TIME_DIFF		100000		// milliseconds, prevents overflow
+#define ABC_LIMIT		2		// max. increment in slow start in MSS
+
+CTCPCubic::CTCPCubic (void)
+:	m_nWindowMax (0),
+	m_nWindowEstimate (0),
+	m_bEpochStarted (FALSE),
+	m_nEpochTime (0),
+	m_nLastClockTicks (0),
+	m_nK (0),
+	m_nWindowRemainder (0),
+	m_nEstimateRemainder (0)
+{
+}
+
+CTCPCubic::~CTCPCubic (void)
+{
+}
+
+const char *CTCPCubic::GetName (void) const
+{
+	return "cubic";
+}
+
+void CTCPCubic::Initialize (unsigned nMSS)
+{
+	CTCPCongestionControl::Initialize (nMSS);
+
+	m_nWindowMax = 0;
+	m_bEpochStarted = FALSE;
+}
+
+void CTCPCubic::DataAcknowledged (unsigned nBytesAcked, unsigned nSmoothedRTT)
+{
+	assert (m_nMSS > 0);
+
+	if (IsSlowStart ())
+	{
+		if (nBytesAcked > ABC_LIMIT * m_nMSS)
+		{
+			nBytesAcked = ABC_LIMIT * m_nMSS;
+		}
+
+		m_nCongestionWindow += nBytesAcked;
+
+		return;
+	}
+
+	unsigned nClockTicks = CTimer::GetClockTicks ();
+	if (!m_bEpochStarted)
+	{
+		// RFC 9438 section 4.2
+		m_bEpochStarted = TRUE;
+		m_nEpochTime = 0;
+
+		m_nWindowEstimate = m_nCongestionWindow;
+		m_nWindowRemainder = 0;
+		m_nEstimateRemainder = 0;
+
+		if (m_nCongestionWindow < m_nWindowMax)
+		{
+			// K = cbrt ((W_max - cwnd_epoch) / C) in milliseconds
+			m_nK = CubeRoot (  (u64) (m_nWindowMax - m_nCongestionWindow)
+					 * (1000 * 1000000000ULL / CUBIC_C) / m_nMSS);
+		}
+		else
+		{
+			m_nK = 0;
+			m_nWindowMax = m_nCongestionWindow;
+		}
+	}
+	else
+	{
+		m_nEpochTime += nClockTicks - m_nLastClockTicks;
+	}
+
+	m_nLastClockTicks = nClockTicks;
+
+	// RFC 9438 section 4.3
+	u64 nEstimateDivisor = 1000ULL * m_nCongestionWindow;
+	m_nEstimateRemainder += (u64) CUBIC_ALPHA * m_nMSS * nBytesAcked;
+	m_nWindowEstimate += (unsigned) (m_nEstimateRemainder / nEstimateDivisor);
+	m_nEstimateRemainder %= nEstimateDivisor;
+
+	s64 nTarget = GetCubicWindow ((m_nEpochTime + nSmoothedRTT) / 1000);
+	if (nTarget < (s64) m_nWindowEstimate)
+	{
+		m_nCongestionWindow = m_nWindowEstimate;	// Reno-friendly region
+
+		return;
+	}
+
+	// RFC 9438 section 4.4 and 4.5
+	if (nTarget < (s64) m_nCongestionWindow)
+	{
+		nTarget = m_nCongestionWindow;
+	}
+	else if (nTarget > (s64) m_nCongestionWindow * 3 / 2)
+	{
+		nTarget = (s64) m_nCongestionWindow * 3 / 2;
+	}
+
+	m_nWindowRemainder += (u64) (nTarget - m_nCongestionWindow) * nBytesAcked;
+	unsigned nIncrement = (unsigned) (m_nWindowRemainder / m_nCongestionWindow);
+	m_nWindowRemainder %= m_nCongestionWindow;
+
+	m_nCongestionWindow += nIncrement;
+}
+
+void CTCPCubic::CongestionDetected (unsigned nFlightSize)
+{
+	ReduceWindow (nFlightSize);
+
+	m_nCongestionWindow = m_nSlowStartThreshold;
+}
+
+void CTCPCubic::RetransmissionTimeout (unsigned nFlightSize)
+{
+	ReduceWindow (nFlightSize);
+
+	m_nCongestionWindow = m_nMSS;		// RFC 9438 section 4.8
+}
+
+void CTCPCubic::ReduceWindow (unsigned nFlightSize)
+{
+	// RFC 9438 section 4.6 and 4.7 (fast convergence)
+	if (m_nCongestionWindow < m_nWindowMax)
+	{
+		m_nWindowMax = (u64) m_nCongestionWindow * (1000 + CUBIC_BETA) / 2000;
+	}
+	else
+	{
+		m_nWindowMax = m_nCongestionWindow;
+	}
+
+	m_nSlowStartThreshold = (u64) nFlightSize * CUBIC_BETA / 1000;
+	if (m_nSlowStartThreshold < 2 * m_nMSS)
+	{
+		m_nSlowStartThreshold = 2 * m_nMSS;
+	}
+
+	m_bEpochStarted = FALSE;
+}
+
+s64 CTCPCubic::GetCubicWindow (u64 nTime) const
+{
+	// W_cubic (t) = C * (t - K)^3 + W_max
+	s64 nDiff = (s64) nTime - (s64) m_nK;
+	if (nDiff > MAX_TIME_DIFF)
+	{
+		nDiff = MAX_TIME_DIFF;
+	}
+	else if (nDiff < -MAX_TIME_DIFF)
+	{
+		nDiff = -MAX_TIME_DIFF;
+	}
+
+	s64 nCube = nDiff * nDiff * nDiff / 1000;		// ms^3 / 1000
+
+	return (s64) m_nWindowMax + nCube * CUBIC_C / 1000 * m_nMSS / 1000000;
+}
+
+u64 CTCPCubic::CubeRoot (u64 nValue)
+{
+	// bitwise calculation, three bits per step
+	u64 nResult = 0;
+	for (int nShift = 63; nShift >= 0; nShift -= 3)
+	{
+		nResult <<= 1;
+
+		u64 nBit = 3 * nResult * (nResult + 1) + 1;
+		if ((nValue >> nShift) >= nBit)
+		{
+			nValue -= nBit << nShift;
+			nResult++;
+		}
+	}
+
+	return nResult;
+}
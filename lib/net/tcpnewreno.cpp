@@ -0,0 +1,90 @@
+//
+// tcpnewreno.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/tcpnewreno.h>
+#include <assert.h>
+
+#define ABC_LIMIT	2		// max. increment in slow start in MSS (RFC 3465 section 2.2)
+
+CTCPNewReno::CTCPNewReno (void)
+:	m_nBytesAcked (0)
+{
+}
+
+CTCPNewReno::~CTCPNewReno (void)
+{
+}
+
+const char *CTCPNewReno::GetName (void) const
+{
+	return "newreno";
+}
+
+void CTCPNewReno::Initialize (unsigned nMSS)
+{
+	CTCPCongestionControl::Initialize (nMSS);
+
+	m_nBytesAcked = 0;
+}
+
+void CTCPNewReno::DataAcknowledged (unsigned nBytesAcked, unsigned nSmoothedRTT)
+{
+	assert (m_nMSS > 0);
+
+	if (IsSlowStart ())
+	{
+		// RFC 5681 section 3.1 (2)
+		if (nBytesAcked > ABC_LIMIT * m_nMSS)
+		{
+			nBytesAcked = ABC_LIMIT * m_nMSS;
+		}
+
+		m_nCongestionWindow += nBytesAcked;
+
+		return;
+	}
+
+	// congestion avoidance, RFC 5681 section 3.1 (3)
+	m_nBytesAcked += nBytesAcked;
+	if (m_nBytesAcked >= m_nCongestionWindow)
+	{
+		m_nBytesAcked -= m_nCongestionWindow;
+		m_nCongestionWindow += m_nMSS;
+	}
+}
+
+void CTCPNewReno::CongestionDetected (unsigned nFlightSize)
+{
+	// RFC 5681 section 3.2 (2), the window is inflated by the caller during recovery
+	m_nSlowStartThreshold = nFlightSize / 2;
+	if (m_nSlowStartThreshold < 2 * m_nMSS)
+	{
+		m_nSlowStartThreshold = 2 * m_nMSS;
+	}
+
+	m_nCongestionWindow = m_nSlowStartThreshold;
+	m_nBytesAcked = 0;
+}
+
+void CTCPNewReno::RetransmissionTimeout (unsigned nFlightSize)
+{
+	CTCPCongestionControl::RetransmissionTimeout (nFlightSize);
+
+	m_nBytesAcked = 0;
+}
@@ -0,0 +1,454 @@
+//
+// tftpclient.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/net/tftpclient.h>
+#include <circle/net/in.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define OWN_PORT_MIN		61000		// above the range of CTransportLayer
+#define OWN_PORT_MAX		61999
+
+#define RECEIVE_TIMEOUT_HZ	HZ		// resend request or ACK after this time
+#define MAX_TIMEOUTS		5
+
+#define MAX_FILENAME_LEN	128
+#define MAX_REQUEST_LEN		(2+MAX_FILENAME_LEN+1+5+1+TFTP_MAX_OPTIONS_LEN)
+
+typedef unsigned TIMER;
+#define START_TIMER(timer)		((timer) = CTimer::Get ()->GetTicks ())
+#define TIMER_EXPIRED(timer, timeout)	(CTimer::Get ()->GetTicks () - (timer) >= (timeout))
+
+struct TBufferParam
+{
+	u8	 *pBuffer;
+	unsigned nBufferSize;
+	unsigned nOffset;
+};
+
+static const char FromTFTPClient[] = "tftp";
+
+u16 CTFTPClient::s_usOwnPort = OWN_PORT_MIN;
+
+CTFTPClient::CTFTPClient (CNetSubSystem *pNetSubSystem, unsigned nBlockSize, unsigned nWindowSize)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_nRequestedBlockSize (nBlockSize),
+	m_nRequestedWindowSize (nWindowSize),
+	m_pSocket (0),
+	m_usServerPort (0),
+	m_nBlockSize (TFTP_DEFAULT_BLOCK_SIZE),
+	m_nWindowSize (1),
+	m_nTransferSize (0)
+{
+	assert (m_pNetSubSystem != 0);
+	assert (TFTP_MIN_BLOCK_SIZE <= m_nRequestedBlockSize);
+	assert (m_nRequestedBlockSize <= TFTP_MAX_BLOCK_SIZE);
+	assert (1 <= m_nRequestedWindowSize && m_nRequestedWindowSize <= TFTP_MAX_WINDOW_SIZE);
+}
+
+CTFTPClient::~CTFTPClient (void)
+{
+	delete m_pSocket;
+	m_pSocket = 0;
+
+	m_pNetSubSystem = 0;
+}
+
+static unsigned AppendOption (char *pBuffer, unsigned nOffset, const char *pName, unsigned nValue)
+{
+	CString Value;
+	Value.Format ("%u", nValue);
+
+	strcpy (pBuffer+nOffset, pName);
+	nOffset += strlen (pName)+1;
+
+	strcpy (pBuffer+nOffset, Value);
+	nOffset += Value.GetLength ()+1;
+
+	return nOffset;
+}
+
+int CTFTPClient::GetFile (const CIPAddress &rServerIP, const char *pFileName,
+			  TTFTPDataHandler *pHandler, void *pParam)
+{
+	assert (pFileName != 0);
+	assert (pHandler != 0);
+
+	m_ServerIP.Set (rServerIP);
+	m_usServerPort = 0;
+
+	m_nBlockSize = TFTP_DEFAULT_BLOCK_SIZE;
+	m_nWindowSize = 1;
+	m_nTransferSize = 0;
+
+	assert (m_pSocket == 0);
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
+	assert (m_pSocket != 0);
+
+	// the server replies from another port, so we cannot connect the socket
+	u16 usOwnPort = s_usOwnPort;
+	s_usOwnPort = usOwnPort < OWN_PORT_MAX ? usOwnPort+1 : OWN_PORT_MIN;
+
+	if (m_pSocket->Bind (usOwnPort) < 0)
+	{
+		CLogger::Get ()->Write (FromTFTPClient, LogError, "Cannot bind to port %u",
+					(unsigned) usOwnPort);
+
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return -1;
+	}
+
+	u8 Request[MAX_REQUEST_LEN];
+	unsigned nRequestLength = BuildRequest (Request, pFileName);
+
+	int nResult = -1;
+	int nTotal = 0;
+	u16 usBlockNumber = 1;			// expected next
+	unsigned nBlocksInWindow = 0;
+	unsigned nTimeouts = 0;
+
+	if (   nRequestLength == 0
+	    || m_pSocket->SendTo (Request, nRequestLength, MSG_DONTWAIT,
+				  m_ServerIP, TFTP_PORT) < 0)
+	{
+		CLogger::Get ()->Write (FromTFTPClient, LogError, "Cannot send request");
+
+		goto Cleanup;
+	}
+
+	while (1)
+	{
+		TTFTPDataPacket Packet;
+		CIPAddress ForeignIP;
+		u16 usForeignPort;
+		int nLength;
+
+		TIMER ReceiveTimer;
+		START_TIMER (ReceiveTimer);
+		do
+		{
+			CScheduler::Get ()->Yield ();
+
+			// leave room for a terminating 0 of strings
+			nLength = m_pSocket->ReceiveFrom (&Packet, sizeof Packet-1, MSG_DONTWAIT,
+							  &ForeignIP, &usForeignPort);
+			if (nLength < 0)
+			{
+				CLogger::Get ()->Write (FromTFTPClient, LogError, "Cannot receive");
+
+				goto Cleanup;
+			}
+		}
+		while (   nLength == 0
+		       && !TIMER_EXPIRED (ReceiveTimer, RECEIVE_TIMEOUT_HZ));
+
+		if (nLength == 0)
+		{
+			if (++nTimeouts > MAX_TIMEOUTS)
+			{
+				CLogger::Get ()->Write (FromTFTPClient, LogWarning, "Transfer timed out");
+
+				goto Cleanup;
+			}
+
+			// resend the request or the last ACK (may be the ACK of the OACK)
+			if (m_usServerPort == 0)
+			{
+				m_pSocket->SendTo (Request, nRequestLength, MSG_DONTWAIT,
+						   m_ServerIP, TFTP_PORT);
+			}
+			else
+			{
+				SendAck (usBlockNumber-1);
+			}
+
+			continue;
+		}
+
+		if (   ForeignIP != m_ServerIP
+		    || nLength < (int) sizeof Packet.OpCode)
+		{
+			continue;
+		}
+
+		if (m_usServerPort == 0)
+		{
+			m_usServerPort = usForeignPort;		// first reply selects the TID
+		}
+		else if (usForeignPort != m_usServerPort)
+		{
+			continue;
+		}
+
+		((char *) &Packet)[nLength] = '\0';
+
+		switch (be2le16 (Packet.OpCode))
+		{
+		case TFTP_OP_CODE_ERROR:
+			CLogger::Get ()->Write (FromTFTPClient, LogWarning, "Server error %u (%s)",
+						nLength >= TFTP_DATA_HEADER_LEN
+							? (unsigned) be2le16 (Packet.BlockNumber) : 0,
+						nLength > TFTP_DATA_HEADER_LEN
+							? (const char *) Packet.Data : "");
+			goto Cleanup;
+
+		case TFTP_OP_CODE_OACK:
+			if (   usBlockNumber != 1
+			    || nBlocksInWindow != 0)
+			{
+				break;			// repeated OACK, our ACK will be resent
+			}
+
+			if (!ParseOptionAck ((const char *) &Packet + sizeof Packet.OpCode,
+					     (const char *) &Packet + nLength))
+			{
+				SendError (TFTP_ERROR_CODE_OPTION, "Invalid option");
+
+				goto Cleanup;
+			}
+
+			nTimeouts = 0;
+
+			SendAck (0);
+			break;
+
+		case TFTP_OP_CODE_DATA: {
+			int nDataLength = nLength - TFTP_DATA_HEADER_LEN;
+			if (   nDataLength < 0
+			    || nDataLength > (int) m_nBlockSize)
+			{
+				break;
+			}
+
+			s16 sDelta = be2le16 (Packet.BlockNumber) - usBlockNumber;
+			if (sDelta != 0)
+			{
+				// ACK the last block in sequence, if we missed one or our ACK got lost
+				if (   sDelta == -1
+				    || (sDelta > 0 && m_nWindowSize > 1))
+				{
+					nBlocksInWindow = 0;
+
+					SendAck (usBlockNumber-1);
+				}
+
+				break;
+			}
+
+			nTimeouts = 0;
+
+			if (!(*pHandler) (Packet.Data, (unsigned) nDataLength, pParam))
+			{
+				SendError (TFTP_ERROR_CODE_OTHER, "Transfer aborted");
+
+				goto Cleanup;
+			}
+
+			nTotal += nDataLength;
+
+			if ((unsigned) nDataLength < m_nBlockSize)
+			{
+				SendAck (usBlockNumber);	// last block
+
+				nResult = nTotal;
+
+				goto Cleanup;
+			}
+
+			if (++nBlocksInWindow == m_nWindowSize)
+			{
+				nBlocksInWindow = 0;
+
+				SendAck (usBlockNumber);
+			}
+
+			usBlockNumber++;
+			} break;
+
+		default:
+			break;
+		}
+	}
+
+Cleanup:
+	delete m_pSocket;
+	m_pSocket = 0;
+
+	return nResult;
+}
+
+int CTFTPClient::GetFile (const CIPAddress &rServerIP, const char *pFileName,
+			  void *pBuffer, unsigned nBufferSize)
+{
+	TBufferParam Param;
+	Param.pBuffer = (u8 *) pBuffer;
+	Param.nBufferSize = nBufferSize;
+	Param.nOffset = 0;
+
+	return GetFile (rServerIP, pFileName, BufferHandler, &Param);
+}
+
+unsigned CTFTPClient::GetTransferSize (void) const
+{
+	return m_nTransferSize;
+}
+
+unsigned CTFTPClient::BuildRequest (void *pBuffer, const char *pFileName)
+{
+	assert (pBuffer != 0);
+	u16 *pOpCode = (u16 *) pBuffer;
+	*pOpCode = BE (TFTP_OP_CODE_RRQ);
+
+	assert (pFileName != 0);
+	size_t nNameLen = strlen (pFileName);
+	if (!(1 <= nNameLen && nNameLen <= MAX_FILENAME_LEN))
+	{
+		return 0;
+	}
+
+	char *pRequest = (char *) pBuffer + sizeof (u16);
+	unsigned nLength = 0;
+
+	strcpy (pRequest, pFileName);
+	nLength += nNameLen+1;
+
+	strcpy (pRequest+nLength, "octet");
+	nLength += 5+1;
+
+	nLength = AppendOption (pRequest, nLength, "tsize", 0);
+
+	if (m_nRequestedBlockSize != TFTP_DEFAULT_BLOCK_SIZE)
+	{
+		nLength = AppendOption (pRequest, nLength, "blksize", m_nRequestedBlockSize);
+	}
+
+	if (m_nRequestedWindowSize != 1)
+	{
+		nLength = AppendOption (pRequest, nLength, "windowsize", m_nRequestedWindowSize);
+	}
+
+	return sizeof (u16) + nLength;
+}
+
+boolean CTFTPClient::ParseOptionAck (const char *pOptions, const char *pEnd)
+{
+	// the server must not send options, which we did not request (RFC 2347)
+	while (pOptions < pEnd)
+	{
+		const char *pName = pOptions;
+		const char *pValue = pName + strlen (pName) + 1;
+		if (pValue >= pEnd)
+		{
+			return FALSE;
+		}
+		pOptions = pValue + strlen (pValue) + 1;
+
+		char *pValueEnd = 0;
+		unsigned long ulValue = strtoul (pValue, &pValueEnd, 10);
+		if (   pValueEnd == 0
+		    || *pValueEnd != '\0'
+		    || pValueEnd == pValue)
+		{
+			return FALSE;
+		}
+
+		if (strcasecmp (pName, "blksize") == 0)
+		{
+			if (!(TFTP_MIN_BLOCK_SIZE <= ulValue && ulValue <= m_nRequestedBlockSize))
+			{
+				return FALSE;
+			}
+
+			m_nBlockSize = (unsigned) ulValue;
+		}
+		else if (strcasecmp (pName, "windowsize") == 0)
+		{
+			if (!(1 <= ulValue && ulValue <= m_nRequestedWindowSize))
+			{
+				return FALSE;
+			}
+
+			m_nWindowSize = (unsigned) ulValue;
+		}
+		else if (strcasecmp (pName, "tsize") == 0)
+		{
+			m_nTransferSize = (unsigned) ulValue;
+		}
+		else
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CTFTPClient::SendAck (u16 usBlockNumber)
+{
+	TTFTPAckPacket AckPacket;
+	AckPacket.OpCode = BE (TFTP_OP_CODE_ACK);
+	AckPacket.BlockNumber = le2be16 (usBlockNumber);
+
+	assert (m_pSocket != 0);
+	assert (m_usServerPort != 0);
+	return m_pSocket->SendTo (&AckPacket, sizeof AckPacket, MSG_DONTWAIT,
+				  m_ServerIP, m_usServerPort) == sizeof AckPacket;
+}
+
+void CTFTPClient::SendError (u16 usErrorCode, const char *pErrorMessage)
+{
+	TTFTPErrorPacket ErrorPacket;
+	ErrorPacket.OpCode = BE (TFTP_OP_CODE_ERROR);
+	ErrorPacket.ErrorCode = le2be16 (usErrorCode);
+
+	assert (pErrorMessage != 0);
+	size_t nLength = strlen (pErrorMessage);
+	assert (nLength < TFTP_MAX_ERRMSG_LEN);
+	strcpy (ErrorPacket.ErrMsg, pErrorMessage);
+
+	assert (m_pSocket != 0);
+	assert (m_usServerPort != 0);
+	m_pSocket->SendTo (&ErrorPacket, TFTP_DATA_HEADER_LEN + nLength+1, MSG_DONTWAIT,
+			   m_ServerIP, m_usServerPort);
+}
+
+boolean CTFTPClient::BufferHandler (const void *pData, unsigned nLength, void *pParam)
+{
+	TBufferParam *pBufferParam = (TBufferParam *) pParam;
+	assert (pBufferParam != 0);
+
+	if (nLength > pBufferParam->nBufferSize - pBufferParam->nOffset)
+	{
+		CLogger::Get ()->Write (FromTFTPClient, LogWarning, "Buffer too small");
+
+		return FALSE;
+	}
+
+	assert (pBufferParam->pBuffer != 0);
+	memcpy (pBufferParam->pBuffer + pBufferParam->nOffset, pData, nLength);
+	pBufferParam->nOffset += nLength;
+
+	return TRUE;
+}
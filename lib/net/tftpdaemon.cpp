@@ -18,71 +18,28 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/net/tftpdaemon.h>
+#include <circle/net/tftp.h>
 #include <circle/net/retranstimeoutcalc.h>
 #include <circle/net/in.h>
 #include <circle/sched/scheduler.h>
 #include <circle/logger.h>
+#include <circle/string.h>
 #include <circle/timer.h>
 #include <circle/util.h>
 #include <circle/macros.h>
 #include <assert.h>
 
-#define TFTP_PORT		69
-
 #define RECEIVE_TIMEOUT_HZ	(5 * HZ)
 #define MAX_TIMEOUT_HZ		(25 * HZ)
 
 struct TTFTPReqPacket
 {
 	u16	OpCode;
-#define OP_CODE_RRQ		1
-#define OP_CODE_WRQ		2
-
 #define MAX_FILENAME_LEN	CTFTPDaemon::MaxFilenameLen
 #define MAX_MODE_LEN		16
 #define MIN_FILENAME_MODE_LEN	(1+1+1+1)
 #define MAX_FILENAME_MODE_LEN	(MAX_FILENAME_LEN+1+MAX_MODE_LEN+1)
-	char	FileNameMode[MAX_FILENAME_MODE_LEN];
-}
-PACKED;
-
-struct TTFTPDataPacket
-{
-	u16	OpCode;
-#define OP_CODE_DATA		3
-
-	u16	BlockNumber;
-#define MAX_DATA_LEN		512
-	u8	Data[MAX_DATA_LEN];
-}
-PACKED;
-
-struct TTFTPAckPacket
-{
-	u16	OpCode;
-#define OP_CODE_ACK		4
-
-	u16	BlockNumber;
-}
-PACKED;
-
-struct TTFTPErrorPacket
-{
-	u16	OpCode;
-#define OP_CODE_ERROR		5
-
-	u16	ErrorCode;
-#define ERROR_CODE_OTHER	0
-#define ERROR_CODE_NO_FILE	1
-#define ERROR_CODE_ACCESS	2
-#define ERROR_CODE_DISK_FULL	3
-#define ERROR_CODE_ILL_OPER	4
-#define ERROR_CODE_INV_ID	5
-#define ERROR_CODE_EXISTS	6
-#define ERROR_CODE_INV_USER	7
-
-#define MAX_ERRMSG_LEN		128
-	char	ErrMsg[MAX_ERRMSG_LEN];
+	char	FileNameMode[MAX_FILENAME_MODE_LEN+TFTP_MAX_OPTIONS_LEN];
 }
 PACKED;
 
@@ -95,7 +52,9 @@ static const char FromTFPTDaemon[] = "tftpd";
 CTFTPDaemon::CTFTPDaemon (CNetSubSystem *pNetSubSystem)
 :	m_pNetSubSystem (pNetSubSystem),
 	m_pRequestSocket (0),
-	m_pTransferSocket (0)
+	m_pTransferSocket (0),
+	m_nBlockSize (TFTP_DEFAULT_BLOCK_SIZE),
+	m_nWindowSize (1)
 {
 	SetName (FromTFPTDaemon);
 }
@@ -152,10 +111,11 @@ void CTFTPDaemon::Run (void)
 		}
 
 		u16 usOpCode = be2le16 (ReqPacket.OpCode);
-		if (   usOpCode != OP_CODE_RRQ
-		    && usOpCode != OP_CODE_WRQ)
+		if (   usOpCode != TFTP_OP_CODE_RRQ
+		    && usOpCode != TFTP_OP_CODE_WRQ)
 		{
-			SendError (ERROR_CODE_ILL_OPER, "Invalid operation", &ForeignIP, usForeignPort);
+			SendError (TFTP_ERROR_CODE_ILL_OPER, "Invalid operation",
+				   &ForeignIP, usForeignPort);
 
 			continue;
 		}
@@ -164,7 +124,7 @@ void CTFTPDaemon::Run (void)
 		size_t nNameLen = strlen (pFileName);
 		if (!(1 <= nNameLen && nNameLen <= MAX_FILENAME_LEN))
 		{
-			SendError (ERROR_CODE_OTHER, "Invalid file name", &ForeignIP, usForeignPort);
+			SendError (TFTP_ERROR_CODE_OTHER, "Invalid file name", &ForeignIP, usForeignPort);
 
 			continue;
 		}
@@ -176,15 +136,17 @@ void CTFTPDaemon::Run (void)
 		    && strcmp (pMode, "Octet") != 0
 		    && strcmp (pMode, "OCTET") != 0)
 		{
-			SendError (ERROR_CODE_OTHER, "Binary mode supported only",
+			SendError (TFTP_ERROR_CODE_OTHER, "Binary mode supported only",
 				   &ForeignIP, usForeignPort);
 
 			continue;
 		}
 
-		if (!IsAccessAllowed (&ForeignIP, m_Filename, usOpCode == OP_CODE_WRQ))
+		ParseOptions (pMode+strlen (pMode)+1, ReqPacket.FileNameMode+nLength);
+
+		if (!IsAccessAllowed (&ForeignIP, m_Filename, usOpCode == TFTP_OP_CODE_WRQ))
 		{
-			SendError (ERROR_CODE_ACCESS, "Access violation",
+			SendError (TFTP_ERROR_CODE_ACCESS, "Access violation",
 				   &ForeignIP, usForeignPort);
 
 			continue;
@@ -192,9 +154,10 @@ void CTFTPDaemon::Run (void)
 
 		CString IPString;
 		ForeignIP.Format (&IPString);
-		CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Incoming %s request from %s",
-					usOpCode == OP_CODE_RRQ ? "read" : "write",
-					(const char *) IPString);
+		CLogger::Get ()->Write (FromTFPTDaemon, LogDebug,
+					"Incoming %s request from %s (block size %u, window %u)",
+					usOpCode == TFTP_OP_CODE_RRQ ? "read" : "write",
+					(const char *) IPString, m_nBlockSize, m_nWindowSize);
 
 		assert (m_pTransferSocket == 0);
 		m_pTransferSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
@@ -215,11 +178,11 @@ void CTFTPDaemon::Run (void)
 
 		switch (usOpCode)
 		{
-		case OP_CODE_RRQ:
+		case TFTP_OP_CODE_RRQ:
 			bOK = DoRead (pFileName);
 			break;
 
-		case OP_CODE_WRQ:
+		case TFTP_OP_CODE_WRQ:
 			bOK = DoWrite (pFileName);
 			break;
 
@@ -234,129 +197,355 @@ void CTFTPDaemon::Run (void)
 		if (bOK)
 		{
 			CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Transfer %s %s completed",
-						usOpCode == OP_CODE_RRQ ? "to" : "from",
+						usOpCode == TFTP_OP_CODE_RRQ ? "to" : "from",
 						(const char *) IPString);
 		}
 	}
 }
 
-boolean CTFTPDaemon::DoRead (const char *pFileName)
+void CTFTPDaemon::ParseOptions (const char *pOptions, const char *pEnd)
 {
-	assert (m_pTransferSocket != 0);
+	m_nBlockSize = TFTP_DEFAULT_BLOCK_SIZE;
+	m_nWindowSize = 1;
+	m_bBlockSizeOption = FALSE;
+	m_bWindowSizeOption = FALSE;
+	m_bTransferSizeOption = FALSE;
+	m_nTransferSize = 0;
+
+	// options are pairs of 0-terminated strings (RFC 2347), unknown options are ignored
+	while (pOptions < pEnd)
+	{
+		const char *pName = pOptions;
+		const char *pValue = pName + strlen (pName) + 1;
+		if (pValue >= pEnd)
+		{
+			break;
+		}
+		pOptions = pValue + strlen (pValue) + 1;
 
-	assert (pFileName != 0);
-	if (!FileOpen (pFileName))
+		char *pValueEnd = 0;
+		unsigned long ulValue = strtoul (pValue, &pValueEnd, 10);
+		if (   pValueEnd == 0
+		    || *pValueEnd != '\0'
+		    || pValueEnd == pValue)
+		{
+			continue;
+		}
+
+		if (strcasecmp (pName, "blksize") == 0)			// RFC 2348
+		{
+			if (ulValue >= TFTP_MIN_BLOCK_SIZE)
+			{
+				m_nBlockSize =   ulValue < TFTP_MAX_BLOCK_SIZE
+					       ? (unsigned) ulValue : TFTP_MAX_BLOCK_SIZE;
+				m_bBlockSizeOption = TRUE;
+			}
+		}
+		else if (strcasecmp (pName, "windowsize") == 0)		// RFC 7440
+		{
+			if (ulValue >= 1)
+			{
+				m_nWindowSize =   ulValue < TFTP_MAX_WINDOW_SIZE
+						? (unsigned) ulValue : TFTP_MAX_WINDOW_SIZE;
+				m_bWindowSizeOption = TRUE;
+			}
+		}
+		else if (strcasecmp (pName, "tsize") == 0)		// RFC 2349
+		{
+			m_nTransferSize = (unsigned) ulValue;
+			m_bTransferSizeOption = TRUE;
+		}
+	}
+}
+
+unsigned CTFTPDaemon::BuildOptionAck (void *pBuffer, int nTransferSize)
+{
+	TTFTPOptionPacket *pPacket = (TTFTPOptionPacket *) pBuffer;
+	assert (pPacket != 0);
+	pPacket->OpCode = BE (TFTP_OP_CODE_OACK);
+
+	unsigned nOffset = 0;
+	if (m_bBlockSizeOption)
 	{
-		SendError (ERROR_CODE_NO_FILE, "File not found");
+		nOffset = AppendOption (pPacket->Options, nOffset, "blksize", m_nBlockSize);
+	}
 
-		return FALSE;
+	if (m_bWindowSizeOption)
+	{
+		nOffset = AppendOption (pPacket->Options, nOffset, "windowsize", m_nWindowSize);
+	}
+
+	if (   m_bTransferSizeOption
+	    && nTransferSize >= 0)
+	{
+		nOffset = AppendOption (pPacket->Options, nOffset, "tsize", (unsigned) nTransferSize);
 	}
 
+	if (nOffset == 0)
+	{
+		return 0;
+	}
+
+	return sizeof pPacket->OpCode + nOffset;
+}
+
+unsigned CTFTPDaemon::AppendOption (char *pBuffer, unsigned nOffset,
+				    const char *pName, unsigned nValue)
+{
+	CString Value;
+	Value.Format ("%u", nValue);
+
+	assert (pBuffer != 0);
+	assert (pName != 0);
+	assert (nOffset + strlen (pName)+1 + Value.GetLength ()+1 <= TFTP_MAX_OPTIONS_LEN);
+
+	strcpy (pBuffer+nOffset, pName);
+	nOffset += strlen (pName)+1;
+
+	strcpy (pBuffer+nOffset, Value);
+	nOffset += Value.GetLength ()+1;
+
+	return nOffset;
+}
+
+boolean CTFTPDaemon::SendOptionAck (const void *pOptionAck, unsigned nLength)
+{
+	assert (m_pTransferSocket != 0);
+
 	CRetransmissionTimeoutCalculator RTCalc;
 	RTCalc.Initialize (0);
 
-	int nDataLength = MAX_DATA_LEN;
-	for (u16 usBlockNumber = 1; nDataLength == MAX_DATA_LEN; usBlockNumber++)
+	TIMER TransferTimer;
+	START_TIMER (TransferTimer);
+	while (!TIMER_EXPIRED (TransferTimer, MAX_TIMEOUT_HZ))
 	{
-		UpdateStatus (StatusReadInProgress, m_Filename);
+		if (m_pTransferSocket->Send (pOptionAck, nLength, MSG_DONTWAIT) < 0)
+		{
+			CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot send OACK");
 
-		TTFTPDataPacket DataPacket;
-		DataPacket.OpCode = BE (OP_CODE_DATA);
-		DataPacket.BlockNumber = le2be16 (usBlockNumber);
+			return FALSE;
+		}
 
-		nDataLength = FileRead (DataPacket.Data, MAX_DATA_LEN);
-		if (nDataLength < 0)
+		TIMER ReceiveTimer;
+		START_TIMER (ReceiveTimer);
+		while (!TIMER_EXPIRED (ReceiveTimer, RTCalc.GetRTO ()))
 		{
-			CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot read");
+			CScheduler::Get ()->Yield ();
 
-			SendError (ERROR_CODE_OTHER, "Error reading file");
+			TTFTPAckPacket AckPacket;
+			int nResult = m_pTransferSocket->Receive (&AckPacket, sizeof AckPacket,
+								  MSG_DONTWAIT);
+			if (nResult < 0)
+			{
+				return FALSE;
+			}
 
-			FileClose ();
+			if (   nResult >= (int) sizeof AckPacket.OpCode
+			    && AckPacket.OpCode == BE (TFTP_OP_CODE_ERROR))
+			{
+				CLogger::Get ()->Write (FromTFPTDaemon, LogDebug,
+							"Options rejected by client");
 
-			UpdateStatus (StatusReadAborted, m_Filename);
+				return FALSE;
+			}
 
-			return FALSE;
+			if (   nResult == sizeof AckPacket
+			    && AckPacket.OpCode == BE (TFTP_OP_CODE_ACK)
+			    && AckPacket.BlockNumber == BE (0))
+			{
+				return TRUE;
+			}
 		}
 
-		unsigned nPacketLength =   sizeof DataPacket.OpCode
-					 + sizeof DataPacket.BlockNumber
-					 + nDataLength;
+		RTCalc.RetransmissionTimerExpired ();
+	}
+
+	CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Transfer timed out");
+
+	return FALSE;
+}
+
+boolean CTFTPDaemon::DoRead (const char *pFileName)
+{
+	assert (m_pTransferSocket != 0);
+
+	assert (pFileName != 0);
+	if (!FileOpen (pFileName))
+	{
+		SendError (TFTP_ERROR_CODE_NO_FILE, "File not found");
 
-		TIMER TransferTimer;
-		START_TIMER (TransferTimer);
-		while (!TIMER_EXPIRED (TransferTimer, MAX_TIMEOUT_HZ))
+		return FALSE;
+	}
+
+	TTFTPOptionPacket OptionAck;
+	unsigned nOptionAckLength = BuildOptionAck (&OptionAck, FileSize ());
+	if (   nOptionAckLength > 0
+	    && !SendOptionAck (&OptionAck, nOptionAckLength))
+	{
+		FileClose ();
+
+		UpdateStatus (StatusReadAborted, m_Filename);
+
+		return FALSE;
+	}
+
+	assert (1 <= m_nWindowSize && m_nWindowSize <= TFTP_MAX_WINDOW_SIZE);
+	TTFTPDataPacket *pWindow = new TTFTPDataPacket[m_nWindowSize];
+	assert (pWindow != 0);
+	unsigned PacketLength[TFTP_MAX_WINDOW_SIZE];
+
+	CRetransmissionTimeoutCalculator RTCalc;
+	RTCalc.Initialize (0);
+
+	// block numbers are counted with 32 bits here and wrap around on the wire
+	u32 nBaseBlock = 1;		// first block not acknowledged
+	u32 nNextBlock = 1;		// next block to be (re-)sent
+	u32 nReadBlock = 1;		// next block to be read from file
+	u32 nLastBlock = 0;		// 0 until the end of file has been reached
+	boolean bRewound = FALSE;	// on duplicate ACK
+
+	boolean bOK = FALSE;
+
+	TIMER TransferTimer;
+	START_TIMER (TransferTimer);
+	TIMER ReceiveTimer;
+	START_TIMER (ReceiveTimer);
+	while (!TIMER_EXPIRED (TransferTimer, MAX_TIMEOUT_HZ))
+	{
+		// read ahead until the window is full
+		while (   nLastBlock == 0
+		       && nReadBlock < nBaseBlock + m_nWindowSize)
 		{
-			if (m_pTransferSocket->Send (&DataPacket, nPacketLength, MSG_DONTWAIT) < 0)
-			{
-				CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot send data");
+			TTFTPDataPacket *pPacket = &pWindow[nReadBlock % m_nWindowSize];
+			pPacket->OpCode = BE (TFTP_OP_CODE_DATA);
+			pPacket->BlockNumber = le2be16 ((u16) nReadBlock);
 
-				FileClose ();
+			int nDataLength = FileRead (pPacket->Data, m_nBlockSize);
+			if (nDataLength < 0)
+			{
+				CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot read");
 
-				UpdateStatus (StatusReadAborted, m_Filename);
+				SendError (TFTP_ERROR_CODE_OTHER, "Error reading file");
 
-				return FALSE;
+				goto Abort;
 			}
 
-			RTCalc.SegmentSent ((u32) (usBlockNumber-1) * MAX_DATA_LEN, nDataLength);
+			PacketLength[nReadBlock % m_nWindowSize] = TFTP_DATA_HEADER_LEN + nDataLength;
 
-			TIMER ReceiveTimer;
-			START_TIMER (ReceiveTimer);
-			while (!TIMER_EXPIRED (ReceiveTimer, RTCalc.GetRTO ()))
+			if ((unsigned) nDataLength < m_nBlockSize)
 			{
-				CScheduler::Get ()->Yield ();
+				nLastBlock = nReadBlock;
+			}
+
+			nReadBlock++;
+		}
+
+		// send all blocks of the window, which have not been sent yet
+		if (nNextBlock < nReadBlock)
+		{
+			UpdateStatus (StatusReadInProgress, m_Filename);
 
-				TTFTPAckPacket AckPacket;
-				int nResult = m_pTransferSocket->Receive (&AckPacket, sizeof AckPacket,
-									  MSG_DONTWAIT);
-				if (nResult < 0)
+			do
+			{
+				unsigned nIndex = nNextBlock % m_nWindowSize;
+				if (m_pTransferSocket->Send (&pWindow[nIndex], PacketLength[nIndex],
+							     MSG_DONTWAIT) < 0)
 				{
 					CLogger::Get ()->Write (FromTFPTDaemon, LogError,
-								"Cannot receive ACK");
+								"Cannot send data");
+
+					goto Abort;
+				}
+
+				RTCalc.SegmentSent (nNextBlock);
+			}
+			while (++nNextBlock < nReadBlock);
+
+			START_TIMER (ReceiveTimer);
+		}
+
+		CScheduler::Get ()->Yield ();
 
-					FileClose ();
+		TTFTPAckPacket AckPacket;
+		int nResult = m_pTransferSocket->Receive (&AckPacket, sizeof AckPacket, MSG_DONTWAIT);
+		if (nResult < 0)
+		{
+			CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot receive ACK");
+
+			goto Abort;
+		}
+
+		if (   nResult >= (int) sizeof AckPacket.OpCode
+		    && AckPacket.OpCode == BE (TFTP_OP_CODE_ERROR))
+		{
+			CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Transfer aborted by client");
 
-					UpdateStatus (StatusReadAborted, m_Filename);
+			goto Abort;
+		}
 
-					return FALSE;
+		if (   nResult == sizeof AckPacket
+		    && AckPacket.OpCode == BE (TFTP_OP_CODE_ACK))
+		{
+			u16 usAcked = be2le16 (AckPacket.BlockNumber) - (u16) (nBaseBlock-1);
+			if (   usAcked >= 1
+			    && usAcked <= nReadBlock-nBaseBlock)
+			{
+				nBaseBlock += usAcked;
+				if (nNextBlock < nBaseBlock)
+				{
+					nNextBlock = nBaseBlock;
 				}
 
-				if (   nResult == sizeof AckPacket
-				    && AckPacket.OpCode == BE (OP_CODE_ACK)
-				    && AckPacket.BlockNumber == le2be16 (usBlockNumber))
+				bRewound = FALSE;
+
+				RTCalc.SegmentAcknowledged (nBaseBlock);
+
+				START_TIMER (TransferTimer);
+
+				if (   nLastBlock != 0
+				    && nBaseBlock > nLastBlock)
 				{
+					bOK = TRUE;
+
 					break;
 				}
 			}
-
-			if (!TIMER_EXPIRED (ReceiveTimer, RTCalc.GetRTO ()))
+			else if (   usAcked == 0
+				 && m_nWindowSize > 1
+				 && nNextBlock > nBaseBlock
+				 && !bRewound)
 			{
-				RTCalc.SegmentAcknowledged ((u32) (usBlockNumber-1) * MAX_DATA_LEN);
+				// the client missed a block, continue after the last one it got
+				nNextBlock = nBaseBlock;
 
-				break;
-			}
-			else
-			{
-				RTCalc.RetransmissionTimerExpired ();
+				bRewound = TRUE;	// ignore further duplicate ACKs
 			}
+
+			continue;
 		}
 
-		if (TIMER_EXPIRED (TransferTimer, MAX_TIMEOUT_HZ))
+		if (   nNextBlock > nBaseBlock
+		    && TIMER_EXPIRED (ReceiveTimer, RTCalc.GetRTO ()))
 		{
-			CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Transfer timed out");
-
-			FileClose ();
-
-			UpdateStatus (StatusReadAborted, m_Filename);
+			RTCalc.RetransmissionTimerExpired ();
 
-			return FALSE;
+			nNextBlock = nBaseBlock;
 		}
 	}
 
+	if (!bOK)
+	{
+		CLogger::Get ()->Write (FromTFPTDaemon, LogDebug, "Transfer timed out");
+	}
+
+Abort:
+	delete [] pWindow;
+
 	FileClose ();
 
-	UpdateStatus (StatusReadCompleted, m_Filename);
+	UpdateStatus (bOK ? StatusReadCompleted : StatusReadAborted, m_Filename);
 
-	return TRUE;
+	return bOK;
 }
 
 boolean CTFTPDaemon::DoWrite (const char *pFileName)
@@ -366,10 +555,19 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 	assert (pFileName != 0);
 	if (FileCreate (pFileName))
 	{
-		TTFTPAckPacket AckPacket;
-		AckPacket.OpCode = BE (OP_CODE_ACK);
-		AckPacket.BlockNumber = 0;
-		if (m_pTransferSocket->Send (&AckPacket, sizeof AckPacket, MSG_DONTWAIT) < 0)
+		// the OACK replaces the ACK of block 0, if options have been accepted
+		TTFTPOptionPacket OptionAck;
+		unsigned nOptionAckLength = BuildOptionAck (&OptionAck, m_nTransferSize);
+		if (nOptionAckLength == 0)
+		{
+			TTFTPAckPacket *pAckPacket = (TTFTPAckPacket *) &OptionAck;
+			pAckPacket->OpCode = BE (TFTP_OP_CODE_ACK);
+			pAckPacket->BlockNumber = 0;
+
+			nOptionAckLength = sizeof (TTFTPAckPacket);
+		}
+
+		if (m_pTransferSocket->Send (&OptionAck, nOptionAckLength, MSG_DONTWAIT) < 0)
 		{
 			CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot send ACK");
 
@@ -380,7 +578,7 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 	}
 	else
 	{
-		SendError (ERROR_CODE_ACCESS, "Access violation");
+		SendError (TFTP_ERROR_CODE_ACCESS, "Access violation");
 
 		return FALSE;
 	}
@@ -389,8 +587,11 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 	// After the first data packet has been received, use a longer time-out.
 	unsigned nTimeout = RECEIVE_TIMEOUT_HZ;
 
-	int nLength = MAX_DATA_LEN;
-	for (u16 usBlockNumber = 1; nLength == MAX_DATA_LEN; usBlockNumber++)
+	// the client sends m_nWindowSize blocks, before it waits for an ACK
+	unsigned nBlocksInWindow = 0;
+
+	int nLength = m_nBlockSize;
+	for (u16 usBlockNumber = 1; nLength == (int) m_nBlockSize; usBlockNumber++)
 	{
 		UpdateStatus (StatusWriteInProgress, m_Filename);
 
@@ -436,29 +637,58 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 				}
 				while (nResult == 0);
 
-				nLength = nResult - (  sizeof DataPacket.OpCode
-						     + sizeof DataPacket.BlockNumber);
+				nLength = nResult - TFTP_DATA_HEADER_LEN;
 			}
 			while (   nLength < 0
-			       || DataPacket.OpCode != BE (OP_CODE_DATA));
-
-			if ((int) (usBlockNumber - be2le16 (DataPacket.BlockNumber)) >= 0)
+			       || nLength > (int) m_nBlockSize
+			       || DataPacket.OpCode != BE (TFTP_OP_CODE_DATA));
+
+			// ACK the last block in sequence, if the window is complete, after
+			// the last block of the file or if a block is out of sequence
+			u16 usAckNumber = usBlockNumber;
+			boolean bInSequence = DataPacket.BlockNumber == le2be16 (usBlockNumber);
+			if (bInSequence)
 			{
-				TTFTPAckPacket AckPacket;
-				AckPacket.OpCode = BE (OP_CODE_ACK);
-				AckPacket.BlockNumber = DataPacket.BlockNumber;
-				if (m_pTransferSocket->Send (&AckPacket, sizeof AckPacket,
-							     MSG_DONTWAIT) < 0)
+				if (   ++nBlocksInWindow < m_nWindowSize
+				    && nLength == (int) m_nBlockSize)
 				{
-					CLogger::Get ()->Write (FromTFPTDaemon, LogError,
-								"Cannot send ACK");
+					break;
+				}
+			}
+			else
+			{
+				s16 sDelta = be2le16 (DataPacket.BlockNumber) - usBlockNumber;
+				if (sDelta > 0)
+				{
+					if (m_nWindowSize == 1)
+					{
+						continue;	// ignore blocks from the future
+					}
+				}
+				else if (sDelta != -1)
+				{
+					continue;	// ACK repeated windows only once
+				}
+
+				usAckNumber--;
+			}
 
-					FileClose ();
+			nBlocksInWindow = 0;
 
-					UpdateStatus (StatusWriteAborted, m_Filename);
+			TTFTPAckPacket AckPacket;
+			AckPacket.OpCode = BE (TFTP_OP_CODE_ACK);
+			AckPacket.BlockNumber = le2be16 (usAckNumber);
+			if (m_pTransferSocket->Send (&AckPacket, sizeof AckPacket,
+						     MSG_DONTWAIT) < 0)
+			{
+				CLogger::Get ()->Write (FromTFPTDaemon, LogError,
+							"Cannot send ACK");
 
-					return FALSE;
-				}
+				FileClose ();
+
+				UpdateStatus (StatusWriteAborted, m_Filename);
+
+				return FALSE;
 			}
 		}
 		while (DataPacket.BlockNumber != le2be16 (usBlockNumber));
@@ -469,7 +699,7 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 			{
 				CLogger::Get ()->Write (FromTFPTDaemon, LogError, "Cannot write");
 
-				SendError (ERROR_CODE_DISK_FULL, "Disk full");
+				SendError (TFTP_ERROR_CODE_DISK_FULL, "Disk full");
 
 				FileClose ();
 
@@ -492,7 +722,7 @@ boolean CTFTPDaemon::DoWrite (const char *pFileName)
 void CTFTPDaemon::SendError (u16 usErrorCode, const char *pErrorMessage, CIPAddress *pSendTo, u16 usPort)
 {
 	TTFTPErrorPacket ErrorPacket;
-	ErrorPacket.OpCode = BE (OP_CODE_ERROR);
+	ErrorPacket.OpCode = BE (TFTP_OP_CODE_ERROR);
 	ErrorPacket.ErrorCode = le2be16 (usErrorCode);
 	strcpy (ErrorPacket.ErrMsg, pErrorMessage);
 
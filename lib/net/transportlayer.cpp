@@ -20,28 +20,65 @@
 #include <circle/net/transportlayer.h>
 #include <circle/net/tcpconnection.h>
 #include <circle/net/udpconnection.h>
+#include <circle/net/checksumcalculator.h>
 #include <circle/net/error.h>
 #include <circle/net/in.h>
+#include <circle/synchronize.h>
 #include <circle/string.h>
 #include <circle/macros.h>
+#include <circle/util.h>
 #include <assert.h>
 
 #define OWN_PORT_MIN	60000
 #define OWN_PORT_MAX	60999
 
+// fields of the TCP header, which are checked on merging segments (GRO)
+#define TCP_HEADER_SIZE			20
+#define TCP_SEQUENCE_NUMBER_OFFSET	4
+#define TCP_ACKNOWLEDGMENT_NUMBER_OFFSET 8
+#define TCP_DATA_OFFSET_OFFSET		12
+#define TCP_FLAGS_OFFSET		13
+#define TCP_FLAGS_PUSH			(1 << 3)
+#define TCP_FLAGS_ACK			(1 << 4)
+#define TCP_WINDOW_OFFSET		14
+
+#define GRO_MAX_LENGTH			0x10000		// max. TCP data of merged segments
+
+#define UDP_HEADER_SIZE			8
+
 CTransportLayer::CTransportLayer (CNetConfig *pNetConfig, CNetworkLayer *pNetworkLayer)
 :	m_pNetConfig (pNetConfig),
 	m_pNetworkLayer (pNetworkLayer),
 	m_nOwnPort (OWN_PORT_MIN),
 	m_SpinLock (TASK_LEVEL),
-	m_TCPRejector (pNetConfig, pNetworkLayer)
+	m_TCPRejector (pNetConfig, pNetworkLayer),
+	m_pMulticastGroups (0),
+	m_UDPChecksum (*pNetConfig->GetIPAddress (), IPPROTO_UDP)
 {
 	assert (m_pNetConfig != 0);
 	assert (m_pNetworkLayer != 0);
+
+	for (unsigned i = 0; i < TRANSPORT_PORT_HASH_SIZE; i++)
+	{
+		m_pPortHash[i] = 0;
+	}
+
+	for (unsigned i = 0; i < TRANSPORT_TUPLE_HASH_SIZE; i++)
+	{
+		m_pTupleHash[i] = 0;
+	}
 }
 
 CTransportLayer::~CTransportLayer (void)
 {
+	for (unsigned i = 0; i < m_pConnection.GetCount (); i++)
+	{
+		if (m_pConnection[i] != 0)
+		{
+			RemoveConnection (i);
+		}
+	}
+
 	m_pNetworkLayer = 0;
 	m_pNetConfig = 0;
 }
@@ -53,35 +90,62 @@ boolean CTransportLayer::Initialize (void)
 
 void CTransportLayer::Process (void)
 {
-	unsigned nResultLength;
+	CNetBuffer *pPacket;
 	CIPAddress Sender;
 	CIPAddress Receiver;
 	int nProtocol;
 	assert (m_pNetworkLayer != 0);
-	u8 Buffer[FRAME_BUFFER_SIZE];
-	while (m_pNetworkLayer->Receive (Buffer, &nResultLength, &Sender, &Receiver, &nProtocol))
+	pPacket = m_pNetworkLayer->Receive (&Sender, &Receiver, &nProtocol);
+	while (pPacket != 0)
 	{
-		unsigned i;
-		for (i = 0; i < m_pConnection.GetCount (); i++)
+		CNetBuffer *pNextPacket = 0;
+		CIPAddress NextSender;
+		CIPAddress NextReceiver;
+		int nNextProtocol;
+
+#ifdef NET_SEGMENTATION_OFFLOAD
+		// merge the following in-order segments of the same TCP connection (GRO)
+		if (nProtocol == IPPROTO_TCP)
 		{
-			if (m_pConnection[i] == 0)
+			while (   (pNextPacket = m_pNetworkLayer->Receive (&NextSender, &NextReceiver,
+									   &nNextProtocol)) != 0
+			       && nNextProtocol == IPPROTO_TCP
+			       && NextSender == Sender
+			       && NextReceiver == Receiver
+			       && MergeSegment (pPacket, pNextPacket, Sender, Receiver))
 			{
-				continue;
-			}
-
-			if (((CNetConnection *) m_pConnection[i])->PacketReceived (
-				Buffer, nResultLength, Sender, Receiver, nProtocol) != 0)
-			{
-				break;
+				// pNextPacket has been appended to pPacket
 			}
 		}
+#endif
 
-		if (i >= m_pConnection.GetCount ())
+		if (!DeliverPacket (pPacket, Sender, Receiver, nProtocol))
 		{
 			// send RESET on not consumed TCP segment
-			m_TCPRejector.PacketReceived (Buffer, nResultLength,
+			m_TCPRejector.PacketReceived (pPacket->GetData (), pPacket->GetLength (),
 						      Sender, Receiver, nProtocol);
 		}
+
+		pPacket->Release ();
+
+		if (pNextPacket != 0)
+		{
+			// could not be merged, is processed next
+			pPacket = pNextPacket;
+			Sender.Set (NextSender);
+			Receiver.Set (NextReceiver);
+			nProtocol = nNextProtocol;
+		}
+#ifdef NET_SEGMENTATION_OFFLOAD
+		else if (nProtocol == IPPROTO_TCP)
+		{
+			break;				// queue is empty
+		}
+#endif
+		else
+		{
+			pPacket = m_pNetworkLayer->Receive (&Sender, &Receiver, &nProtocol);
+		}
 	}
 
 	TICMPNotificationType Type;
@@ -90,16 +154,21 @@ void CTransportLayer::Process (void)
 	while (m_pNetworkLayer->ReceiveNotification (&Type, &Sender, &Receiver,
 						     &nSendPort, &nReceivePort, &nProtocol))
 	{
-		unsigned i;
-		for (i = 0; i < m_pConnection.GetCount (); i++)
+		// all connections check their own port, so only these are asked
+		for (TDemuxEntry *pEntry = m_pPortHash[PortHash (nReceivePort, nProtocol)];
+		     pEntry != 0; pEntry = pEntry->pNext)
 		{
-			if (m_pConnection[i] == 0)
+			if (   pEntry->nOwnPort != nReceivePort
+			    || pEntry->nProtocol != nProtocol)
 			{
 				continue;
 			}
 
-			if (((CNetConnection *) m_pConnection[i])->NotificationReceived (
-				Type, Sender, Receiver, nSendPort, nReceivePort, nProtocol) != 0)
+			CNetConnection *pConnection = m_pConnection[pEntry->nConnection];
+			assert (pConnection != 0);
+
+			if (pConnection->NotificationReceived (Type, Sender, Receiver,
+							       nSendPort, nReceivePort, nProtocol) != 0)
 			{
 				break;
 			}
@@ -110,13 +179,20 @@ void CTransportLayer::Process (void)
 	{
 		if (m_pConnection[i] != 0)
 		{
-			if (!((CNetConnection *) m_pConnection[i])->IsTerminated ())
+			if (!(m_pConnection[i])->IsTerminated ())
 			{			
-				((CNetConnection *) m_pConnection[i])->Process ();
+				(m_pConnection[i])->Process ();
+				(m_pConnection[i])->UpdateReadiness ();
 			}
 			else
 			{
-				delete (CNetConnection *) m_pConnection[i];
+				m_SpinLock.Acquire ();
+
+				RemoveConnection (i);
+
+				m_SpinLock.Release ();
+
+				delete m_pConnection[i];
 				m_pConnection[i] = 0;
 			}
 		}
@@ -170,6 +246,8 @@ int CTransportLayer::Bind (u16 nOwnPort, int nProtocol)
 	m_pConnection[i] = new CUDPConnection (m_pNetConfig, m_pNetworkLayer, nOwnPort);
 	assert (m_pConnection[i] != 0);
 
+	InsertConnection (i);
+
 	m_SpinLock.Release ();
 
 	return i;
@@ -195,7 +273,6 @@ int CTransportLayer::Connect (const CIPAddress &rIPAddress, u16 nPort, u16 nOwnP
 
 	if (nOwnPort == 0)
 	{
-		unsigned j;
 		do
 		{
 			nOwnPort = m_nOwnPort;
@@ -203,18 +280,8 @@ int CTransportLayer::Connect (const CIPAddress &rIPAddress, u16 nPort, u16 nOwnP
 			{
 				m_nOwnPort = OWN_PORT_MIN;
 			}
-
-			for (j = 0; j < m_pConnection.GetCount (); j++)
-			{
-				if (   m_pConnection[j] != 0
-				    && ((CNetConnection *) m_pConnection[j])->GetOwnPort () == nOwnPort
-				    && ((CNetConnection *) m_pConnection[j])->GetProtocol () == nProtocol)
-				{
-					break;
-				}
-			}
 		}
-		while (j < m_pConnection.GetCount ());
+		while (IsPortUsed (nOwnPort, nProtocol));
 	}
 
 	assert (m_pNetConfig != 0);
@@ -234,10 +301,13 @@ int CTransportLayer::Connect (const CIPAddress &rIPAddress, u16 nPort, u16 nOwnP
 		return -NET_ERROR_PROTOCOL_NOT_SUPPORTED;
 	}
 
+	assert (m_pConnection[i] != 0);
+	InsertConnection (i);
+
 	m_SpinLock.Release ();
 
 	assert (m_pConnection[i] != 0);
-	int nResult = ((CNetConnection *) m_pConnection[i])->Connect ();
+	int nResult = (m_pConnection[i])->Connect ();
 	if (nResult < 0)
 	{
 		return nResult;
@@ -283,6 +353,8 @@ int CTransportLayer::Listen (u16 nOwnPort, int nProtocol)
 	m_pConnection[i] = new CTCPConnection (m_pNetConfig, m_pNetworkLayer, nOwnPort);
 	assert (m_pConnection[i] != 0);
 
+	InsertConnection (i);
+
 	m_SpinLock.Release ();
 
 	return i;
@@ -299,7 +371,7 @@ int CTransportLayer::Accept (CIPAddress *pForeignIP, u16 *pForeignPort, int hCon
 
 	assert (pForeignIP != 0);
 	assert (pForeignPort != 0);
-	return ((CNetConnection *) m_pConnection[hConnection])->Accept (pForeignIP, pForeignPort);
+	return (m_pConnection[hConnection])->Accept (pForeignIP, pForeignPort);
 }
 
 int CTransportLayer::Disconnect (int hConnection)
@@ -311,7 +383,7 @@ int CTransportLayer::Disconnect (int hConnection)
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->Close ();
+	return (m_pConnection[hConnection])->Close ();
 }
 
 int CTransportLayer::Send (const void *pData, unsigned nLength, int nFlags, int hConnection)
@@ -325,7 +397,7 @@ int CTransportLayer::Send (const void *pData, unsigned nLength, int nFlags, int
 
 	assert (pData != 0);
 	assert (nLength > 0);
-	return ((CNetConnection *) m_pConnection[hConnection])->Send (pData, nLength, nFlags);
+	return (m_pConnection[hConnection])->Send (pData, nLength, nFlags);
 }
 
 int CTransportLayer::Receive (void *pBuffer, int nFlags, int hConnection)
@@ -338,7 +410,7 @@ int CTransportLayer::Receive (void *pBuffer, int nFlags, int hConnection)
 	}
 
 	assert (pBuffer != 0);
-	return ((CNetConnection *) m_pConnection[hConnection])->Receive (pBuffer, nFlags);
+	return (m_pConnection[hConnection])->Receive (pBuffer, nFlags);
 }
 
 int CTransportLayer::SendTo (const void *pData, unsigned nLength, int nFlags,
@@ -353,7 +425,7 @@ int CTransportLayer::SendTo (const void *pData, unsigned nLength, int nFlags,
 
 	assert (pData != 0);
 	assert (nLength > 0);
-	return ((CNetConnection *) m_pConnection[hConnection])->SendTo (pData, nLength, nFlags,
+	return (m_pConnection[hConnection])->SendTo (pData, nLength, nFlags,
 									rForeignIP, nForeignPort);
 }
 
@@ -368,10 +440,111 @@ int CTransportLayer::ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeig
 	}
 
 	assert (pBuffer != 0);
-	return ((CNetConnection *) m_pConnection[hConnection])->ReceiveFrom (pBuffer, nFlags,
+	return (m_pConnection[hConnection])->ReceiveFrom (pBuffer, nFlags,
 									     pForeignIP, pForeignPort);
 }
 
+int CTransportLayer::SendBuffer (CNetBuffer *pBuffer, int nFlags, int hConnection)
+{
+	assert (pBuffer != 0);
+
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	return (m_pConnection[hConnection])->SendBuffer (pBuffer, nFlags);
+}
+
+int CTransportLayer::ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (ppBuffer != 0);
+	return (m_pConnection[hConnection])->ReceiveBuffer (ppBuffer, nFlags);
+}
+
+int CTransportLayer::SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+				   const CIPAddress &rForeignIP, u16 nForeignPort, int hConnection)
+{
+	assert (pBuffer != 0);
+
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		pBuffer->Release ();
+
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	return (m_pConnection[hConnection])->SendBufferTo (pBuffer, nFlags,
+									      rForeignIP, nForeignPort);
+}
+
+int CTransportLayer::ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags, CIPAddress *pForeignIP,
+					u16 *pForeignPort, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (ppBuffer != 0);
+	return (m_pConnection[hConnection])->ReceiveBufferFrom (ppBuffer, nFlags,
+										   pForeignIP,
+										   pForeignPort);
+}
+
+int CTransportLayer::SendBatch (TNetMessage *pMessages, unsigned nCount, int nFlags,
+				int hConnection)
+{
+	assert (pMessages != 0);
+
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		for (unsigned i = 0; i < nCount; i++)
+		{
+			assert (pMessages[i].pBuffer != 0);
+			pMessages[i].pBuffer->Release ();
+			pMessages[i].pBuffer = 0;
+		}
+
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	return (m_pConnection[hConnection])->SendBatch (pMessages, nCount,
+									   nFlags);
+}
+
+int CTransportLayer::ReceiveBatch (TNetMessage *pMessages, unsigned nCount, int nFlags,
+				   int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	assert (pMessages != 0);
+	return (m_pConnection[hConnection])->ReceiveBatch (pMessages, nCount,
+									      nFlags);
+}
+
 int CTransportLayer::SetOptionReceiveTimeout (unsigned nMicroSeconds, int hConnection)
 {
 	assert (hConnection >= 0);
@@ -381,7 +554,7 @@ int CTransportLayer::SetOptionReceiveTimeout (unsigned nMicroSeconds, int hConne
 		return -NET_ERROR_NOT_CONNECTED;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->SetOptionReceiveTimeout (nMicroSeconds);
+	return (m_pConnection[hConnection])->SetOptionReceiveTimeout (nMicroSeconds);
 }
 
 int CTransportLayer::SetOptionSendTimeout (unsigned nMicroSeconds, int hConnection)
@@ -393,7 +566,7 @@ int CTransportLayer::SetOptionSendTimeout (unsigned nMicroSeconds, int hConnecti
 		return -NET_ERROR_NOT_CONNECTED;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->SetOptionSendTimeout (nMicroSeconds);
+	return (m_pConnection[hConnection])->SetOptionSendTimeout (nMicroSeconds);
 }
 
 int CTransportLayer::SetOptionBroadcast (boolean bAllowed, int hConnection)
@@ -405,7 +578,7 @@ int CTransportLayer::SetOptionBroadcast (boolean bAllowed, int hConnection)
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->SetOptionBroadcast (bAllowed);
+	return (m_pConnection[hConnection])->SetOptionBroadcast (bAllowed);
 }
 
 int CTransportLayer::SetOptionAddMembership (const CIPAddress &rGroupAddress, int hConnection)
@@ -417,7 +590,11 @@ int CTransportLayer::SetOptionAddMembership (const CIPAddress &rGroupAddress, in
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->SetOptionAddMembership (rGroupAddress);
+	int nResult = (m_pConnection[hConnection])->SetOptionAddMembership (rGroupAddress);
+
+	UpdateMulticastMember (hConnection, rGroupAddress);
+
+	return nResult;
 }
 
 int CTransportLayer::SetOptionDropMembership (const CIPAddress &rGroupAddress, int hConnection)
@@ -429,7 +606,95 @@ int CTransportLayer::SetOptionDropMembership (const CIPAddress &rGroupAddress, i
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->SetOptionDropMembership (rGroupAddress);
+	int nResult = (m_pConnection[hConnection])->SetOptionDropMembership (rGroupAddress);
+
+	UpdateMulticastMember (hConnection, rGroupAddress);
+
+	return nResult;
+}
+
+int CTransportLayer::SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+						   const CIPAddress &rSourceAddress, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	int nResult = (m_pConnection[hConnection])->SetOptionAddSourceMembership (
+			rGroupAddress, rSourceAddress);
+
+	UpdateMulticastMember (hConnection, rGroupAddress);
+
+	return nResult;
+}
+
+int CTransportLayer::SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+						    const CIPAddress &rSourceAddress, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	int nResult = (m_pConnection[hConnection])->SetOptionDropSourceMembership (
+			rGroupAddress, rSourceAddress);
+
+	UpdateMulticastMember (hConnection, rGroupAddress);
+
+	return nResult;
+}
+
+int CTransportLayer::SetOptionReceiveBuffer (unsigned nBytes, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	return (m_pConnection[hConnection])->SetOptionReceiveBuffer (nBytes);
+}
+
+int CTransportLayer::SetOptionSendBuffer (unsigned nBytes, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	return (m_pConnection[hConnection])->SetOptionSendBuffer (nBytes);
+}
+
+int CTransportLayer::SetOptionNoDelay (boolean bNoDelay, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	return (m_pConnection[hConnection])->SetOptionNoDelay (bNoDelay);
+}
+
+int CTransportLayer::SetOptionCork (boolean bCork, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	return (m_pConnection[hConnection])->SetOptionCork (bCork);
 }
 
 boolean CTransportLayer::IsConnected (int hConnection) const
@@ -441,7 +706,7 @@ boolean CTransportLayer::IsConnected (int hConnection) const
 		return 0;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->IsConnected ();
+	return (m_pConnection[hConnection])->IsConnected ();
 }
 
 const u8 *CTransportLayer::GetForeignIP (int hConnection) const
@@ -453,7 +718,7 @@ const u8 *CTransportLayer::GetForeignIP (int hConnection) const
 		return 0;
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->GetForeignIP ();
+	return (m_pConnection[hConnection])->GetForeignIP ();
 }
 
 CNetConnection::TStatus CTransportLayer::GetStatus (int hConnection) const
@@ -465,7 +730,21 @@ CNetConnection::TStatus CTransportLayer::GetStatus (int hConnection) const
 		return {FALSE, FALSE, FALSE, FALSE};
 	}
 
-	return ((CNetConnection *) m_pConnection[hConnection])->GetStatus ();
+	return (m_pConnection[hConnection])->GetStatus ();
+}
+
+int CTransportLayer::SetReadinessEvent (CSynchronizationEvent *pEvent, int hConnection)
+{
+	assert (hConnection >= 0);
+	if (   hConnection >= (int) m_pConnection.GetCount ()
+	    || m_pConnection[hConnection] == 0)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	(m_pConnection[hConnection])->SetReadinessEvent (pEvent);
+
+	return 0;
 }
 
 void CTransportLayer::ListConnections (CDevice *pTarget)
@@ -485,29 +764,537 @@ void CTransportLayer::ListConnections (CDevice *pTarget)
 	for (unsigned i = 0; i < m_pConnection.GetCount (); i++)
 	{
 		if (   m_pConnection[i] == 0
-		    || ((CNetConnection *) m_pConnection[i])->IsTerminated ())
+		    || (m_pConnection[i])->IsTerminated ())
 		{
 			continue;
 		}
 
-		int nProtocol = ((CNetConnection *) m_pConnection[i])->GetProtocol ();
+		int nProtocol = (m_pConnection[i])->GetProtocol ();
 		assert (nProtocol == IPPROTO_TCP || nProtocol == IPPROTO_UDP);
 		const char *pProtocol = nProtocol == IPPROTO_TCP ? "tcp" : "udp";
 
 		Local.Format ("%s:%u", (const char *) OwnIP,
-			      (unsigned) ((CNetConnection *) m_pConnection[i])->GetOwnPort ());
+			      (unsigned) (m_pConnection[i])->GetOwnPort ());
 
 		const u8 *pForeignIP =
-			((CNetConnection *) m_pConnection[i])->GetForeignIP ();
+			(m_pConnection[i])->GetForeignIP ();
 		Foreign.Format ("%u.%u.%u.%u:%u",
 			(unsigned) pForeignIP[0], (unsigned) pForeignIP[1],
 			(unsigned) pForeignIP[2], (unsigned) pForeignIP[3],
-			(unsigned) ((CNetConnection *) m_pConnection[i])->GetForeignPort ());
+			(unsigned) (m_pConnection[i])->GetForeignPort ());
 
 		Line.Format ("%-4s %-21s %-21s %s\n", pProtocol,
 			     (const char *) Local, (const char *) Foreign,
-			     ((CNetConnection *) m_pConnection[i])->GetStateName ());
+			     (m_pConnection[i])->GetStateName ());
 
 		pTarget->Write ((const char *) Line, Line.GetLength ());
 	}
 }
+
+boolean CTransportLayer::DeliverPacket (CNetBuffer *pBuffer,
+					CIPAddress &rSender, CIPAddress &rReceiver, int nProtocol)
+{
+	assert (pBuffer != 0);
+	// reassembled UDP datagrams may be chained too, the header is in the first segment
+	assert (   pBuffer->GetNextSegment () == 0
+		|| nProtocol == IPPROTO_TCP
+		|| nProtocol == IPPROTO_UDP);
+
+	if (   nProtocol == IPPROTO_UDP
+	    && rReceiver.IsMulticast ())
+	{
+		DeliverMulticast (pBuffer, rSender, rReceiver);
+
+		return TRUE;
+	}
+
+	const u8 *pPacket = pBuffer->GetData ();
+	unsigned nLength = pBuffer->GetLength ();
+	if (nLength < 4)
+	{
+		return TRUE;		// too short for TCP and UDP header, ignore it
+	}
+
+	// source and destination port are at the same position in TCP and UDP header
+	u16 nSourcePort = (u16) pPacket[0] << 8 | pPacket[1];
+	u16 nDestPort = (u16) pPacket[2] << 8 | pPacket[3];
+
+	int nTupleConnection = -1;
+	if (nProtocol == IPPROTO_TCP)
+	{
+		nTupleConnection = LookupTuple (rSender, nSourcePort, nDestPort);
+		if (nTupleConnection >= 0)
+		{
+			CNetConnection *pConnection = m_pConnection[nTupleConnection];
+			assert (pConnection != 0);
+
+			if (pConnection->BufferReceived (pBuffer, rSender, rReceiver, nProtocol) != 0)
+			{
+				return TRUE;
+			}
+		}
+	}
+
+	// all connections check their own port, so only these are asked (in handle order)
+	for (TDemuxEntry *pEntry = m_pPortHash[PortHash (nDestPort, nProtocol)];
+	     pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (   pEntry->nOwnPort != nDestPort
+		    || pEntry->nProtocol != nProtocol
+		    || (int) pEntry->nConnection == nTupleConnection)
+		{
+			continue;
+		}
+
+		CNetConnection *pConnection = m_pConnection[pEntry->nConnection];
+		assert (pConnection != 0);
+
+		if (pConnection->BufferReceived (pBuffer, rSender, rReceiver, nProtocol) != 0)
+		{
+			// remember the TCP connection, if it is bound to this foreign address now
+			if (   nProtocol == IPPROTO_TCP
+			    && pConnection->GetForeignPort () == nSourcePort
+			    && rSender == pConnection->GetForeignIP ())
+			{
+				m_SpinLock.Acquire ();
+
+				InsertTuple (pEntry->nConnection, rSender, nSourcePort, nDestPort);
+
+				m_SpinLock.Release ();
+			}
+
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+void CTransportLayer::InsertConnection (unsigned nConnection)
+{
+	CNetConnection *pConnection = m_pConnection[nConnection];
+	assert (pConnection != 0);
+
+	TDemuxEntry *pNewEntry = new TDemuxEntry;
+	assert (pNewEntry != 0);
+
+	pNewEntry->nConnection = nConnection;
+	pNewEntry->nProtocol = pConnection->GetProtocol ();
+	pNewEntry->nOwnPort = pConnection->GetOwnPort ();
+	pNewEntry->nForeignPort = 0;
+	pNewEntry->nForeignIP = 0;
+
+	// keep the chain sorted, so that the first matching connection is the same as before
+	TDemuxEntry **ppEntry = &m_pPortHash[PortHash (pNewEntry->nOwnPort, pNewEntry->nProtocol)];
+	while (   *ppEntry != 0
+	       && (*ppEntry)->nConnection < nConnection)
+	{
+		ppEntry = &(*ppEntry)->pNext;
+	}
+
+	pNewEntry->pNext = *ppEntry;
+
+	DataMemBarrier ();	// entry must be complete, before it becomes visible
+
+	*ppEntry = pNewEntry;
+}
+
+void CTransportLayer::DeliverMulticast (CNetBuffer *pBuffer, CIPAddress &rSender, CIPAddress &rReceiver)
+{
+	const TMulticastGroup *pGroup;
+	for (pGroup = m_pMulticastGroups; pGroup != 0; pGroup = pGroup->pNext)
+	{
+		if (rReceiver == pGroup->nGroupIP)
+		{
+			break;
+		}
+	}
+
+	if (   pGroup == 0
+	    || rSender.IsMulticast ())
+	{
+		return;
+	}
+
+	// the UDP header is checked only once for all members
+	assert (pBuffer != 0);
+	if (pBuffer->GetLength () <= UDP_HEADER_SIZE)
+	{
+		return;
+	}
+
+	const u8 *pHeader = pBuffer->GetData ();
+	u16 nSourcePort = (u16) pHeader[0] << 8 | pHeader[1];
+	u16 nDestPort = (u16) pHeader[2] << 8 | pHeader[3];
+	unsigned nUDPLength = (unsigned) pHeader[4] << 8 | pHeader[5];
+	boolean bHasChecksum = pHeader[6] != 0 || pHeader[7] != 0;
+
+	if (pBuffer->GetTotalLength () < nUDPLength)
+	{
+		return;
+	}
+
+	const TDemuxEntry *pEntry;
+	for (pEntry = pGroup->pMembers; pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (pEntry->nOwnPort == nDestPort)
+		{
+			break;
+		}
+	}
+
+	if (pEntry == 0)
+	{
+		return;				// no member on this port
+	}
+
+	if (   bHasChecksum
+	    && !pBuffer->IsChecksumValid ())	// not verified by the hardware
+	{
+		m_UDPChecksum.SetSourceAddress (rSender);
+		m_UDPChecksum.SetDestinationAddress (rReceiver);
+
+		if (m_UDPChecksum.Calculate (pBuffer) != CHECKSUM_OK)
+		{
+			return;
+		}
+	}
+
+	// from here the payload is shared by all members, instead of copying it for each
+	pBuffer->RemoveHeader (UDP_HEADER_SIZE);
+
+	for (; pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (pEntry->nOwnPort != nDestPort)
+		{
+			continue;
+		}
+
+		CUDPConnection *pConnection = (CUDPConnection *) m_pConnection[pEntry->nConnection];
+		assert (pConnection != 0);
+
+		pConnection->MulticastReceived (pBuffer, rSender, nSourcePort, nDestPort);
+	}
+}
+
+void CTransportLayer::RemoveConnection (unsigned nConnection)
+{
+	CNetConnection *pConnection = m_pConnection[nConnection];
+	assert (pConnection != 0);
+
+	RemoveTuples (nConnection);
+	RemoveMulticastMember (nConnection);
+
+	for (TDemuxEntry **ppEntry = &m_pPortHash[PortHash (pConnection->GetOwnPort (),
+							    pConnection->GetProtocol ())];
+	     *ppEntry != 0; ppEntry = &(*ppEntry)->pNext)
+	{
+		if ((*ppEntry)->nConnection == nConnection)
+		{
+			TDemuxEntry *pEntry = *ppEntry;
+			*ppEntry = pEntry->pNext;
+
+			delete pEntry;
+
+			return;
+		}
+	}
+
+	assert (0);
+}
+
+void CTransportLayer::UpdateMulticastMember (unsigned nConnection, const CIPAddress &rGroupAddress)
+{
+	CNetConnection *pConnection = m_pConnection[nConnection];
+	assert (pConnection != 0);
+
+	boolean bMember =    pConnection->GetProtocol () == IPPROTO_UDP
+			  && ((CUDPConnection *) pConnection)->IsHostGroupMember (rGroupAddress);
+
+	m_SpinLock.Acquire ();
+
+	TMulticastGroup **ppGroup;
+	for (ppGroup = &m_pMulticastGroups; *ppGroup != 0; ppGroup = &(*ppGroup)->pNext)
+	{
+		if (rGroupAddress == (*ppGroup)->nGroupIP)
+		{
+			break;
+		}
+	}
+
+	if (*ppGroup == 0)
+	{
+		if (!bMember)
+		{
+			m_SpinLock.Release ();
+
+			return;
+		}
+
+		TMulticastGroup *pGroup = new TMulticastGroup;
+		assert (pGroup != 0);
+
+		pGroup->pNext = 0;
+		pGroup->nGroupIP = rGroupAddress;
+		pGroup->pMembers = 0;
+
+		DataMemBarrier ();
+
+		*ppGroup = pGroup;
+	}
+
+	TMulticastGroup *pGroup = *ppGroup;
+
+	// find the position in the member list (sorted by index)
+	TDemuxEntry **ppEntry;
+	for (ppEntry = &pGroup->pMembers; *ppEntry != 0; ppEntry = &(*ppEntry)->pNext)
+	{
+		if ((*ppEntry)->nConnection >= nConnection)
+		{
+			break;
+		}
+	}
+
+	boolean bListed = *ppEntry != 0 && (*ppEntry)->nConnection == nConnection;
+
+	if (   bMember
+	    && !bListed)
+	{
+		TDemuxEntry *pEntry = new TDemuxEntry;
+		assert (pEntry != 0);
+
+		pEntry->nConnection = nConnection;
+		pEntry->nProtocol = IPPROTO_UDP;
+		pEntry->nOwnPort = pConnection->GetOwnPort ();
+		pEntry->nForeignPort = 0;
+		pEntry->nForeignIP = 0;
+
+		pEntry->pNext = *ppEntry;
+
+		DataMemBarrier ();
+
+		*ppEntry = pEntry;
+	}
+	else if (   !bMember
+		 && bListed)
+	{
+		TDemuxEntry *pEntry = *ppEntry;
+		*ppEntry = pEntry->pNext;
+
+		delete pEntry;
+
+		if (pGroup->pMembers == 0)
+		{
+			*ppGroup = pGroup->pNext;
+
+			delete pGroup;
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CTransportLayer::RemoveMulticastMember (unsigned nConnection)
+{
+	TMulticastGroup **ppGroup = &m_pMulticastGroups;
+	while (*ppGroup != 0)
+	{
+		TMulticastGroup *pGroup = *ppGroup;
+
+		for (TDemuxEntry **ppEntry = &pGroup->pMembers; *ppEntry != 0;
+		     ppEntry = &(*ppEntry)->pNext)
+		{
+			if ((*ppEntry)->nConnection == nConnection)
+			{
+				TDemuxEntry *pEntry = *ppEntry;
+				*ppEntry = pEntry->pNext;
+
+				delete pEntry;
+
+				break;
+			}
+		}
+
+		if (pGroup->pMembers == 0)
+		{
+			*ppGroup = pGroup->pNext;
+
+			delete pGroup;
+		}
+		else
+		{
+			ppGroup = &pGroup->pNext;
+		}
+	}
+}
+
+boolean CTransportLayer::IsPortUsed (u16 nOwnPort, int nProtocol) const
+{
+	for (const TDemuxEntry *pEntry = m_pPortHash[PortHash (nOwnPort, nProtocol)];
+	     pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (   pEntry->nOwnPort == nOwnPort
+		    && pEntry->nProtocol == nProtocol)
+		{
+			return TRUE;
+		}
+	}
+
+	return FALSE;
+}
+
+int CTransportLayer::LookupTuple (u32 nForeignIP, u16 nForeignPort, u16 nOwnPort) const
+{
+	for (const TDemuxEntry *pEntry = m_pTupleHash[TupleHash (nForeignIP, nForeignPort, nOwnPort)];
+	     pEntry != 0; pEntry = pEntry->pNext)
+	{
+		if (   pEntry->nForeignIP == nForeignIP
+		    && pEntry->nForeignPort == nForeignPort
+		    && pEntry->nOwnPort == nOwnPort)
+		{
+			return pEntry->nConnection;
+		}
+	}
+
+	return -1;
+}
+
+void CTransportLayer::InsertTuple (unsigned nConnection, u32 nForeignIP, u16 nForeignPort,
+				   u16 nOwnPort)
+{
+	// a connection is bound to one foreign address only (e.g. after it has been listening)
+	RemoveTuples (nConnection);
+
+	TDemuxEntry *pNewEntry = new TDemuxEntry;
+	assert (pNewEntry != 0);
+
+	pNewEntry->nConnection = nConnection;
+	pNewEntry->nProtocol = IPPROTO_TCP;
+	pNewEntry->nOwnPort = nOwnPort;
+	pNewEntry->nForeignPort = nForeignPort;
+	pNewEntry->nForeignIP = nForeignIP;
+
+	unsigned nHash = TupleHash (nForeignIP, nForeignPort, nOwnPort);
+	pNewEntry->pNext = m_pTupleHash[nHash];
+
+	DataMemBarrier ();
+
+	m_pTupleHash[nHash] = pNewEntry;
+}
+
+void CTransportLayer::RemoveTuples (unsigned nConnection)
+{
+	for (unsigned i = 0; i < TRANSPORT_TUPLE_HASH_SIZE; i++)
+	{
+		TDemuxEntry **ppEntry = &m_pTupleHash[i];
+		while (*ppEntry != 0)
+		{
+			if ((*ppEntry)->nConnection == nConnection)
+			{
+				TDemuxEntry *pEntry = *ppEntry;
+				*ppEntry = pEntry->pNext;
+
+				delete pEntry;
+			}
+			else
+			{
+				ppEntry = &(*ppEntry)->pNext;
+			}
+		}
+	}
+}
+
+#ifdef NET_SEGMENTATION_OFFLOAD
+
+boolean CTransportLayer::MergeSegment (CNetBuffer *pHead, CNetBuffer *pSegment,
+				       const CIPAddress &rSender, const CIPAddress &rReceiver)
+{
+	assert (pHead != 0);
+	assert (pSegment != 0);
+	u8 *pHeadHeader = pHead->GetData ();
+	const u8 *pHeader = pSegment->GetData ();
+	unsigned nLength = pSegment->GetLength ();
+
+	if (   pSegment->GetNextSegment () != 0
+	    || pHead->GetLength () < TCP_HEADER_SIZE
+	    || nLength < TCP_HEADER_SIZE)
+	{
+		return FALSE;
+	}
+
+	// only pure data segments (ACK and optional PSH, which ends the merging) with the
+	// same ports, acknowledgment number and options (incl. timestamps) are merged
+	unsigned nHeaderLength = (pHeadHeader[TCP_DATA_OFFSET_OFFSET] >> 4) * 4;
+	if (   nHeaderLength < TCP_HEADER_SIZE
+	    || pHeader[TCP_DATA_OFFSET_OFFSET] != pHeadHeader[TCP_DATA_OFFSET_OFFSET]
+	    || pHead->GetLength () <= nHeaderLength
+	    || nLength <= nHeaderLength
+	    || pHeadHeader[TCP_FLAGS_OFFSET] != TCP_FLAGS_ACK
+	    || (pHeader[TCP_FLAGS_OFFSET] & ~TCP_FLAGS_PUSH) != TCP_FLAGS_ACK
+	    || memcmp (pHeadHeader, pHeader, TCP_SEQUENCE_NUMBER_OFFSET) != 0
+	    || memcmp (pHeadHeader + TCP_ACKNOWLEDGMENT_NUMBER_OFFSET,
+		       pHeader + TCP_ACKNOWLEDGMENT_NUMBER_OFFSET, 4) != 0
+	    || memcmp (pHeadHeader + TCP_HEADER_SIZE, pHeader + TCP_HEADER_SIZE,
+		       nHeaderLength - TCP_HEADER_SIZE) != 0)
+	{
+		return FALSE;
+	}
+
+	unsigned nHeadDataLength = pHead->GetTotalLength () - nHeaderLength;
+	unsigned nDataLength = nLength - nHeaderLength;
+	if (nHeadDataLength + nDataLength > GRO_MAX_LENGTH)
+	{
+		return FALSE;
+	}
+
+	u32 nHeadSequenceNumber, nSequenceNumber;
+	memcpy (&nHeadSequenceNumber, pHeadHeader + TCP_SEQUENCE_NUMBER_OFFSET, 4);
+	memcpy (&nSequenceNumber, pHeader + TCP_SEQUENCE_NUMBER_OFFSET, 4);
+	if (be2le32 (nHeadSequenceNumber) + nHeadDataLength != be2le32 (nSequenceNumber))
+	{
+		return FALSE;
+	}
+
+	// the checksums cannot be verified by TCP after merging
+	CChecksumCalculator Checksum (rSender, rReceiver, IPPROTO_TCP);
+	if (!pHead->IsChecksumValid ())
+	{
+		assert (pHead->GetNextSegment () == 0);
+		if (Checksum.Calculate (pHeadHeader, pHead->GetLength ()) != CHECKSUM_OK)
+		{
+			return FALSE;
+		}
+
+		pHead->SetChecksumValid ();
+	}
+
+	if (   !pSegment->IsChecksumValid ()
+	    && Checksum.Calculate (pHeader, nLength) != CHECKSUM_OK)
+	{
+		return FALSE;
+	}
+
+	// the latest window and PSH flag are taken over
+	memcpy (pHeadHeader + TCP_WINDOW_OFFSET, pHeader + TCP_WINDOW_OFFSET, 2);
+	pHeadHeader[TCP_FLAGS_OFFSET] = pHeader[TCP_FLAGS_OFFSET];
+
+	pSegment->RemoveHeader (nHeaderLength);
+	pHead->AppendSegment (pSegment);
+
+	return TRUE;
+}
+
+#endif
+
+unsigned CTransportLayer::PortHash (u16 nOwnPort, int nProtocol)
+{
+	return (nOwnPort ^ (nOwnPort >> 6) ^ nProtocol) & (TRANSPORT_PORT_HASH_SIZE-1);
+}
+
+unsigned CTransportLayer::TupleHash (u32 nForeignIP, u16 nForeignPort, u16 nOwnPort)
+{
+	u32 nHash = nForeignIP ^ ((u32) nForeignPort << 16 | nOwnPort);
+	nHash *= 0x9E3779B1U;		// Fibonacci hashing, the upper bits are mixed best
+
+	return (nHash ^ nHash >> 16) & (TRANSPORT_TUPLE_HASH_SIZE-1);
+}
@@ -20,6 +20,7 @@
 #include <circle/net/udpconnection.h>
 #include <circle/net/error.h>
 #include <circle/net/in.h>
+#include <circle/net/netmemory.h>
 #include <circle/macros.h>
 #include <circle/util.h>
 #include <assert.h>
@@ -34,6 +35,10 @@ struct TUDPHeader
 }
 PACKED;
 
+// space for all headers in front of the payload, so that the frame is aligned for DMA
+#define UDP_BUFFER_HEADROOM	(  NET_BUFFER_HEADROOM + sizeof (TEthernetHeader)		\
+				 + sizeof (TIPHeader) + sizeof (TUDPHeader))
+
 struct TUDPPrivateData
 {
 	u8	SourceAddress[IP_ADDRESS_SIZE];
@@ -48,9 +53,13 @@ CUDPConnection::CUDPConnection (CNetConfig	*pNetConfig,
 :	CNetConnection (pNetConfig, pNetworkLayer, rForeignIP, nForeignPort, nOwnPort, IPPROTO_UDP),
 	m_bOpen (TRUE),
 	m_bActiveOpen (TRUE),
+	m_RxQueue (NET_QUEUE_HIGH_WATER_MARK),
 	m_nReceiveTimeout (0),
 	m_bBroadcastsAllowed (FALSE),
 	m_pHostGroup (0),
+	m_nSources (0),
+	m_nRxBufferSize (UDP_DEFAULT_RECEIVE_BUFFER),
+	m_nRxQueued (0),
 	m_nErrno (0)
 {
 }
@@ -61,9 +70,13 @@ CUDPConnection::CUDPConnection (CNetConfig	*pNetConfig,
 :	CNetConnection (pNetConfig, pNetworkLayer, nOwnPort, IPPROTO_UDP),
 	m_bOpen (TRUE),
 	m_bActiveOpen (FALSE),
+	m_RxQueue (NET_QUEUE_HIGH_WATER_MARK),
 	m_nReceiveTimeout (0),
 	m_bBroadcastsAllowed (FALSE),
 	m_pHostGroup (0),
+	m_nSources (0),
+	m_nRxBufferSize (UDP_DEFAULT_RECEIVE_BUFFER),
+	m_nRxQueued (0),
 	m_nErrno (0)
 {
 }
@@ -72,6 +85,8 @@ CUDPConnection::~CUDPConnection (void)
 {
 	assert (!m_bOpen);
 	assert (!m_pHostGroup);
+
+	CNetMemory::Uncharge (m_nRxQueued);
 }
 
 int CUDPConnection::Connect (void)
@@ -95,11 +110,7 @@ int CUDPConnection::Close (void)
 
 	if (m_pHostGroup != 0)
 	{
-		assert (m_pNetworkLayer != 0);
-		m_pNetworkLayer->LeaveHostGroup (*m_pHostGroup);
-
-		delete m_pHostGroup;
-		m_pHostGroup = 0;
+		LeaveHostGroup ();
 	}
 
 	m_bOpen = FALSE;
@@ -109,8 +120,65 @@ int CUDPConnection::Close (void)
 
 int CUDPConnection::Send (const void *pData, unsigned nLength, int nFlags)
 {
+	if (   nLength == 0
+	    || nLength > UDP_MAX_MESSAGE_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	assert (pData != 0);
+	return SendBuffer (AllocMessage (pData, nLength), nFlags);
+}
+
+int CUDPConnection::Receive (void *pBuffer, int nFlags)
+{
+	return ReceiveFrom (pBuffer, nFlags, 0, 0);
+}
+
+int CUDPConnection::SendTo (const void *pData, unsigned nLength, int nFlags,
+			    const CIPAddress &rForeignIP, u16 nForeignPort)
+{
+	if (   nLength == 0
+	    || nLength > UDP_MAX_MESSAGE_SIZE)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	assert (pData != 0);
+	return SendBufferTo (AllocMessage (pData, nLength), nFlags,
+			     rForeignIP, nForeignPort);
+}
+
+int CUDPConnection::ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP, u16 *pForeignPort)
+{
+	CNetBuffer *pNetBuffer;
+	int nResult = ReceiveBufferFrom (&pNetBuffer, nFlags, pForeignIP, pForeignPort);
+	if (nResult > 0)
+	{
+		// reassembled datagrams may be larger than the buffer of size FRAME_BUFFER_SIZE
+		if (nResult > FRAME_BUFFER_SIZE)
+		{
+			nResult = FRAME_BUFFER_SIZE;
+		}
+
+		assert (pNetBuffer != 0);
+		assert (pBuffer != 0);
+		pNetBuffer->CopyTo (pBuffer, nResult, 0);
+
+		pNetBuffer->Release ();
+	}
+
+	return nResult;
+}
+
+int CUDPConnection::SendBuffer (CNetBuffer *pBuffer, int nFlags)
+{
+	assert (pBuffer != 0);
+
 	if (m_nErrno < 0)
 	{
+		pBuffer->Release ();
+
 		int nErrno = m_nErrno;
 		m_nErrno = 0;
 
@@ -119,56 +187,67 @@ int CUDPConnection::Send (const void *pData, unsigned nLength, int nFlags)
 
 	if (!m_bActiveOpen)
 	{
+		pBuffer->Release ();
+
 		return -NET_ERROR_OPERATION_NOT_SUPPORTED;
 	}
 
 	if (   nFlags != 0
 	    && nFlags != MSG_DONTWAIT)
 	{
+		pBuffer->Release ();
+
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	unsigned nPacketLength = sizeof (TUDPHeader) + nLength;		// may wrap
-	if (   nPacketLength <= sizeof (TUDPHeader)
-	    || nPacketLength > FRAME_BUFFER_SIZE)
+	return SendPacket (pBuffer, m_ForeignIP, m_nForeignPort);
+}
+
+int CUDPConnection::SendBufferTo (CNetBuffer *pBuffer, int nFlags,
+				  const CIPAddress &rForeignIP, u16 nForeignPort)
+{
+	assert (pBuffer != 0);
+
+	if (m_bActiveOpen)
 	{
-		return -NET_ERROR_INVALID_VALUE;
+		// ignore rForeignIP and nForeignPort
+		return SendBuffer (pBuffer, nFlags);
 	}
 
-	assert (m_pNetConfig != 0);
-	if (   !m_bBroadcastsAllowed
-	    && (   m_ForeignIP.IsBroadcast ()
-	        || m_ForeignIP == *m_pNetConfig->GetBroadcastAddress ()))
+	if (m_nErrno < 0)
 	{
-		return -NET_ERROR_PERMISSION_DENIED;
+		pBuffer->Release ();
+
+		int nErrno = m_nErrno;
+		m_nErrno = 0;
+
+		return nErrno;
 	}
 
-	u8 PacketBuffer[nPacketLength];
-	TUDPHeader *pHeader = (TUDPHeader *) PacketBuffer;
+	if (   nFlags != 0
+	    && nFlags != MSG_DONTWAIT)
+	{
+		pBuffer->Release ();
 
-	pHeader->nSourcePort = le2be16 (m_nOwnPort);
-	pHeader->nDestPort   = le2be16 (m_nForeignPort);
-	pHeader->nLength     = le2be16 (nPacketLength);
-	pHeader->nChecksum   = 0;
-	
-	assert (pData != 0);
-	assert (nLength > 0);
-	memcpy (PacketBuffer+sizeof (TUDPHeader), pData, nLength);
+		return -NET_ERROR_INVALID_VALUE;
+	}
 
-	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
-	m_Checksum.SetDestinationAddress (m_ForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (PacketBuffer, nPacketLength);
+	return SendPacket (pBuffer, rForeignIP, nForeignPort);
+}
 
-	assert (m_pNetworkLayer != 0);
-	boolean bOK = m_pNetworkLayer->Send (m_ForeignIP, PacketBuffer, nPacketLength, IPPROTO_UDP);
-	
-	return bOK ? nLength : -NET_ERROR_IO;
+int CUDPConnection::ReceiveBuffer (CNetBuffer **ppBuffer, int nFlags)
+{
+	return ReceiveBufferFrom (ppBuffer, nFlags, 0, 0);
 }
 
-int CUDPConnection::Receive (void *pBuffer, int nFlags)
+int CUDPConnection::ReceiveBufferFrom (CNetBuffer **ppBuffer, int nFlags,
+				       CIPAddress *pForeignIP, u16 *pForeignPort)
 {
+	assert (ppBuffer != 0);
+	*ppBuffer = 0;
+
 	void *pParam;
-	unsigned nLength;
+	CNetBuffer *pBuffer;
 	do
 	{
 		if (m_nErrno < 0)
@@ -179,9 +258,8 @@ int CUDPConnection::Receive (void *pBuffer, int nFlags)
 			return nErrno;
 		}
 
-		assert (pBuffer != 0);
-		nLength = m_RxQueue.Dequeue (pBuffer, &pParam);
-		if (nLength == 0)
+		pBuffer = m_RxQueue.DequeueBuffer (&pParam);
+		if (pBuffer == 0)
 		{
 			if (nFlags == MSG_DONTWAIT)
 			{
@@ -211,43 +289,37 @@ int CUDPConnection::Receive (void *pBuffer, int nFlags)
 			}
 		}
 	}
-	while (nLength == 0);
+	while (pBuffer == 0);
+
+	UnchargeReceived (pBuffer->GetTotalLength ());
 
 	TUDPPrivateData *pData = (TUDPPrivateData *) pParam;
 	assert (pData != 0);
 
+	if (   pForeignIP != 0
+	    && pForeignPort != 0)
+	{
+		pForeignIP->Set (pData->SourceAddress);
+		*pForeignPort = pData->nSourcePort;
+	}
+
 	delete pData;
 
-	return nLength;
+	*ppBuffer = pBuffer;
+
+	return pBuffer->GetTotalLength ();
 }
 
-int CUDPConnection::SendTo (const void *pData, unsigned nLength, int nFlags,
-			    const CIPAddress &rForeignIP, u16 nForeignPort)
+int CUDPConnection::SendPacket (CNetBuffer *pBuffer, const CIPAddress &rForeignIP, u16 nForeignPort)
 {
-	if (m_nErrno < 0)
-	{
-		int nErrno = m_nErrno;
-		m_nErrno = 0;
-
-		return nErrno;
-	}
-
-	if (m_bActiveOpen)
-	{
-		// ignore rForeignIP and nForeignPort
-		return Send (pData, nLength, nFlags);
-	}
-
-	if (   nFlags != 0
-	    && nFlags != MSG_DONTWAIT)
+	assert (pBuffer != 0);
+	unsigned nLength = pBuffer->GetTotalLength ();
+	unsigned nPacketLength = sizeof (TUDPHeader) + nLength;
+	if (   nLength == 0
+	    || nLength > UDP_MAX_MESSAGE_SIZE)
 	{
-		return -NET_ERROR_INVALID_VALUE;
-	}
+		pBuffer->Release ();
 
-	unsigned nPacketLength = sizeof (TUDPHeader) + nLength;		// may wrap
-	if (   nPacketLength <= sizeof (TUDPHeader)
-	    || nPacketLength > FRAME_BUFFER_SIZE)
-	{
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
@@ -256,92 +328,86 @@ int CUDPConnection::SendTo (const void *pData, unsigned nLength, int nFlags,
 	    && (   rForeignIP.IsBroadcast ()
 	        || rForeignIP == *m_pNetConfig->GetBroadcastAddress ()))
 	{
+		pBuffer->Release ();
+
 		return -NET_ERROR_PERMISSION_DENIED;
 	}
 
-	u8 PacketBuffer[nPacketLength];
-	TUDPHeader *pHeader = (TUDPHeader *) PacketBuffer;
+	// prepend the header in place, if possible, otherwise chain a header segment in front
+	CNetBuffer *pPacketBuffer = pBuffer;
+	if (pBuffer->GetHeadroom () < UDP_BUFFER_HEADROOM - NET_BUFFER_HEADROOM)
+	{
+		pPacketBuffer = CNetBuffer::Alloc (UDP_BUFFER_HEADROOM);
+		assert (pPacketBuffer != 0);
+		pPacketBuffer->AppendSegment (pBuffer);
+	}
+
+	TUDPHeader *pHeader = (TUDPHeader *) pPacketBuffer->Prepend (sizeof (TUDPHeader));
 
 	pHeader->nSourcePort = le2be16 (m_nOwnPort);
 	pHeader->nDestPort   = le2be16 (nForeignPort);
 	pHeader->nLength     = le2be16 (nPacketLength);
 	pHeader->nChecksum   = 0;
-	
-	assert (pData != 0);
-	assert (nLength > 0);
-	memcpy (PacketBuffer+sizeof (TUDPHeader), pData, nLength);
 
 	m_Checksum.SetSourceAddress (*m_pNetConfig->GetIPAddress ());
 	m_Checksum.SetDestinationAddress (rForeignIP);
-	pHeader->nChecksum = m_Checksum.Calculate (PacketBuffer, nPacketLength);
 
 	assert (m_pNetworkLayer != 0);
-	boolean bOK = m_pNetworkLayer->Send (rForeignIP, PacketBuffer, nPacketLength, IPPROTO_UDP);
-	
+	if (m_pNetworkLayer->GetCapabilities () & NET_DEVICE_CAP_TX_CHECKSUM)
+	{
+		// the checksum will be completed by the hardware
+		pHeader->nChecksum = m_Checksum.CalculatePseudoHeader (nPacketLength);
+		pPacketBuffer->SetChecksumPartial (pHeader, (u8 *) &pHeader->nChecksum - (u8 *) pHeader);
+	}
+	else
+	{
+		pHeader->nChecksum = m_Checksum.Calculate (pPacketBuffer);
+	}
+
+	boolean bOK;
+	if (   m_bActiveOpen			// the cached flow is used on a connected socket only
+	    && rForeignIP == m_ForeignIP)
+	{
+		bOK = m_pNetworkLayer->SendFlow (&m_Flow, rForeignIP, pPacketBuffer, IPPROTO_UDP);
+	}
+	else
+	{
+		bOK = m_pNetworkLayer->Send (rForeignIP, pPacketBuffer, IPPROTO_UDP);
+	}
+
 	return bOK ? nLength : -NET_ERROR_IO;
 }
 
-int CUDPConnection::ReceiveFrom (void *pBuffer, int nFlags, CIPAddress *pForeignIP, u16 *pForeignPort)
+CNetBuffer *CUDPConnection::AllocMessage (const void *pData, unsigned nLength)
 {
-	void *pParam;
-	unsigned nLength;
-	do
+	assert (pData != 0);
+	assert (nLength <= UDP_MAX_MESSAGE_SIZE);
+	const u8 *pData8 = (const u8 *) pData;
+
+	// the first segment leaves room for the headers, larger messages are chained
+	unsigned nChunk = nLength;
+	if (nChunk > FRAME_BUFFER_SIZE - sizeof (TUDPHeader))
 	{
-		if (m_nErrno < 0)
-		{
-			int nErrno = m_nErrno;
-			m_nErrno = 0;
+		nChunk = FRAME_BUFFER_SIZE - sizeof (TUDPHeader);
+	}
 
-			return nErrno;
-		}
+	CNetBuffer *pBuffer = CNetBuffer::Alloc (pData8, nChunk, UDP_BUFFER_HEADROOM);
+	assert (pBuffer != 0);
 
-		assert (pBuffer != 0);
-		nLength = m_RxQueue.Dequeue (pBuffer, &pParam);
-		if (nLength == 0)
+	for (unsigned nOffset = nChunk; nOffset < nLength; nOffset += nChunk)
+	{
+		nChunk = nLength - nOffset;
+		if (nChunk > FRAME_BUFFER_SIZE)
 		{
-			if (nFlags == MSG_DONTWAIT)
-			{
-				return 0;
-			}
-
-			m_Event.Clear ();
-
-			if (m_nReceiveTimeout == 0)
-			{
-				m_Event.Wait ();
-			}
-			else
-			{
-				if (m_Event.WaitWithTimeout (m_nReceiveTimeout))
-				{
-					m_nErrno = -1;
-				}
-			}
-
-			if (m_nErrno < 0)
-			{
-				int nErrno = m_nErrno;
-				m_nErrno = 0;
-
-				return nErrno;
-			}
+			nChunk = FRAME_BUFFER_SIZE;
 		}
-	}
-	while (nLength == 0);
-
-	TUDPPrivateData *pData = (TUDPPrivateData *) pParam;
-	assert (pData != 0);
 
-	if (   pForeignIP != 0
-	    && pForeignPort != 0)
-	{
-		pForeignIP->Set (pData->SourceAddress);
-		*pForeignPort = pData->nSourcePort;
+		CNetBuffer *pSegment = CNetBuffer::Alloc (pData8 + nOffset, nChunk, 0);
+		assert (pSegment != 0);
+		pBuffer->AppendSegment (pSegment);
 	}
 
-	delete pData;
-
-	return nLength;
+	return pBuffer;
 }
 
 int CUDPConnection::SetOptionReceiveTimeout (unsigned nMicroSeconds)
@@ -399,19 +465,163 @@ int CUDPConnection::SetOptionDropMembership (const CIPAddress &rGroupAddress)
 		return -NET_ERROR_INVALID_VALUE;
 	}
 
-	delete m_pHostGroup;
-	m_pHostGroup = 0;
+	LeaveHostGroup ();
+
+	return 0;
+}
+
+int CUDPConnection::SetOptionAddSourceMembership (const CIPAddress &rGroupAddress,
+						  const CIPAddress &rSourceAddress)
+{
+	if (m_pHostGroup != 0)
+	{
+		if (   *m_pHostGroup != rGroupAddress
+		    || m_nSources == 0)			// joined for any source
+		{
+			return -NET_ERROR_IS_CONNECTED;
+		}
+
+		for (unsigned i = 0; i < m_nSources; i++)
+		{
+			if (m_Source[i] == rSourceAddress)
+			{
+				return -NET_ERROR_INVALID_VALUE;
+			}
+		}
+
+		if (m_nSources == IGMP_MAX_SOURCES)
+		{
+			return -NET_ERROR_INVALID_VALUE;
+		}
+	}
+
+	if (   !rGroupAddress.IsMulticast ()
+	    || rSourceAddress.IsNull ()
+	    || rSourceAddress.IsMulticast ()
+	    || rSourceAddress.IsBroadcast ())
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	assert (m_pNetworkLayer != 0);
+	if (!m_pNetworkLayer->JoinHostGroup (rGroupAddress, &rSourceAddress))
+	{
+		return -NET_ERROR_IO;
+	}
+
+	if (m_pHostGroup == 0)
+	{
+		m_pHostGroup = new CIPAddress (rGroupAddress);
+		assert (m_pHostGroup != 0);
+	}
+
+	m_Source[m_nSources++].Set (rSourceAddress);
+
+	return 0;
+}
+
+int CUDPConnection::SetOptionDropSourceMembership (const CIPAddress &rGroupAddress,
+						   const CIPAddress &rSourceAddress)
+{
+	if (m_pHostGroup == 0)
+	{
+		return -NET_ERROR_NOT_CONNECTED;
+	}
+
+	if (*m_pHostGroup != rGroupAddress)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	unsigned i;
+	for (i = 0; i < m_nSources; i++)
+	{
+		if (m_Source[i] == rSourceAddress)
+		{
+			break;
+		}
+	}
+
+	if (i == m_nSources)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
 
 	assert (m_pNetworkLayer != 0);
 #ifndef NDEBUG
 	boolean bOK =
 #endif
-		m_pNetworkLayer->LeaveHostGroup (rGroupAddress);
+		m_pNetworkLayer->LeaveHostGroup (rGroupAddress, &rSourceAddress);
 	assert (bOK);
 
+	m_Source[i].Set (m_Source[--m_nSources]);
+
+	if (m_nSources == 0)
+	{
+		delete m_pHostGroup;
+		m_pHostGroup = 0;
+	}
+
 	return 0;
 }
 
+boolean CUDPConnection::IsHostGroupMember (const CIPAddress &rGroupAddress) const
+{
+	return    m_pHostGroup != 0
+	       && *m_pHostGroup == rGroupAddress;
+}
+
+void CUDPConnection::LeaveHostGroup (void)
+{
+	assert (m_pHostGroup != 0);
+	assert (m_pNetworkLayer != 0);
+
+	if (m_nSources == 0)
+	{
+#ifndef NDEBUG
+		boolean bOK =
+#endif
+			m_pNetworkLayer->LeaveHostGroup (*m_pHostGroup);
+		assert (bOK);
+	}
+
+	for (; m_nSources > 0; m_nSources--)
+	{
+		m_pNetworkLayer->LeaveHostGroup (*m_pHostGroup, &m_Source[m_nSources-1]);
+	}
+
+	delete m_pHostGroup;
+	m_pHostGroup = 0;
+}
+
+int CUDPConnection::SetOptionReceiveBuffer (unsigned nBytes)
+{
+	if (   nBytes < FRAME_BUFFER_SIZE
+	    || nBytes > UDP_MAX_RECEIVE_BUFFER)
+	{
+		return -NET_ERROR_INVALID_VALUE;
+	}
+
+	m_nRxBufferSize = nBytes;	// queued datagrams are kept, if it is smaller now
+
+	return 0;
+}
+
+int CUDPConnection::SetOptionSendBuffer (unsigned nBytes)
+{
+	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+}
+
+int CUDPConnection::SetOptionNoDelay (boolean bNoDelay)
+{
+	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+}
+
+int CUDPConnection::SetOptionCork (boolean bCork)
+{
+	return -NET_ERROR_OPERATION_NOT_SUPPORTED;
+}
+
 boolean CUDPConnection::IsConnected (void) const
 {
 	return FALSE;
@@ -428,6 +638,22 @@ void CUDPConnection::Process (void)
 
 int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
 				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
+{
+	return ReceivePacket (pPacket, nLength, 0, rSenderIP, rReceiverIP, nProtocol);
+}
+
+int CUDPConnection::BufferReceived (CNetBuffer *pPacket,
+				    CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
+{
+	assert (pPacket != 0);
+
+	// reassembled datagrams may be chained, the UDP header is in the first segment then
+	return ReceivePacket (pPacket->GetData (), pPacket->GetTotalLength (), pPacket,
+			      rSenderIP, rReceiverIP, nProtocol);
+}
+
+int CUDPConnection::ReceivePacket (const void *pPacket, unsigned nLength, CNetBuffer *pBuffer,
+				   CIPAddress &rSenderIP, CIPAddress &rReceiverIP, int nProtocol)
 {
 	if (nProtocol != IPPROTO_UDP)
 	{
@@ -474,12 +700,25 @@ int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
 		return -1;
 	}
 	
-	if (pHeader->nChecksum != UDP_CHECKSUM_NONE)
+	if (   pHeader->nChecksum != UDP_CHECKSUM_NONE
+	    && (   pBuffer == 0
+		|| !pBuffer->IsChecksumValid ()))	// not verified by the hardware
 	{
 		m_Checksum.SetSourceAddress (rSenderIP);
 		m_Checksum.SetDestinationAddress (rReceiverIP);
 
-		if (m_Checksum.Calculate (pPacket, nLength) != CHECKSUM_OK)
+		u16 nChecksum;
+		if (   pBuffer != 0
+		    && pBuffer->GetNextSegment () != 0)
+		{
+			nChecksum = m_Checksum.Calculate (pBuffer);
+		}
+		else
+		{
+			nChecksum = m_Checksum.Calculate (pPacket, nLength);
+		}
+
+		if (nChecksum != CHECKSUM_OK)
 		{
 			return -1;
 		}
@@ -502,18 +741,124 @@ int CUDPConnection::PacketReceived (const void *pPacket, unsigned nLength,
 	nLength -= sizeof (TUDPHeader);
 	assert (nLength > 0);
 
+	if (!ChargeReceived (nLength))
+	{
+		return 1;		// dropped, receive buffer full
+	}
+
+	TUDPPrivateData *pData = new TUDPPrivateData;
+	assert (pData != 0);
+	rSenderIP.CopyTo (pData->SourceAddress);
+	pData->nSourcePort = nSourcePort;
+
+	boolean bQueued;
+	if (pBuffer != 0)
+	{
+		// keep the received buffer without copying, only remove the header
+		pBuffer->AddRef ();
+		pBuffer->RemoveHeader (sizeof (TUDPHeader));
+
+		bQueued = m_RxQueue.Enqueue (pBuffer, pData);
+	}
+	else
+	{
+		bQueued = m_RxQueue.Enqueue ((u8 *) pPacket + sizeof (TUDPHeader), nLength, pData);
+	}
+
+	if (!bQueued)
+	{
+		delete pData;		// dropped, packet flood
+		UnchargeReceived (nLength);
+
+		return 1;
+	}
+
+	m_Event.Set ();
+
+	return 1;
+}
+
+int CUDPConnection::MulticastReceived (CNetBuffer *pPayload, const CIPAddress &rSenderIP,
+				       u16 nSourcePort, u16 nDestPort)
+{
+	assert (pPayload != 0);
+
+	if (m_nOwnPort != nDestPort)
+	{
+		return 0;
+	}
+
+	if (   m_bActiveOpen
+	    && (   m_nForeignPort != nSourcePort
+		|| (   m_ForeignIP != rSenderIP
+		    && !m_ForeignIP.IsMulticast ())))
+	{
+		return 0;
+	}
+
+	if (m_nSources > 0)
+	{
+		unsigned i;
+		for (i = 0; i < m_nSources; i++)
+		{
+			if (m_Source[i] == rSenderIP)
+			{
+				break;
+			}
+		}
+
+		if (i == m_nSources)
+		{
+			return 0;		// source is not included
+		}
+	}
+
+	unsigned nLength = pPayload->GetTotalLength ();
+	if (!ChargeReceived (nLength))
+	{
+		return 1;		// dropped, receive buffer full
+	}
+
 	TUDPPrivateData *pData = new TUDPPrivateData;
 	assert (pData != 0);
 	rSenderIP.CopyTo (pData->SourceAddress);
 	pData->nSourcePort = nSourcePort;
 
-	m_RxQueue.Enqueue ((u8 *) pPacket + sizeof (TUDPHeader), nLength, pData);
+	pPayload->AddRef ();
+	if (!m_RxQueue.Enqueue (pPayload, pData))
+	{
+		delete pData;		// dropped, packet flood
+		UnchargeReceived (nLength);
+
+		return 1;
+	}
 
 	m_Event.Set ();
 
 	return 1;
 }
 
+boolean CUDPConnection::ChargeReceived (unsigned nLength)
+{
+	// the receive buffer is limited by the memory pressure
+	if (m_nRxQueued + nLength > CNetMemory::LimitBuffer (m_nRxBufferSize))
+	{
+		return FALSE;
+	}
+
+	m_nRxQueued += nLength;
+	CNetMemory::Charge (nLength);
+
+	return TRUE;
+}
+
+void CUDPConnection::UnchargeReceived (unsigned nLength)
+{
+	assert (m_nRxQueued >= nLength);
+	m_nRxQueued -= nLength;
+	CNetMemory::Uncharge (nLength);
+}
+
 int CUDPConnection::NotificationReceived (TICMPNotificationType  Type,
 					  CIPAddress		&rSenderIP,
 					  CIPAddress		&rReceiverIP,
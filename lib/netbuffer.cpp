@@ -0,0 +1,234 @@
+//
+// netbuffer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/netbuffer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CNetBuffer *CNetBuffer::s_pFreeList = 0;
+
+CSpinLock CNetBuffer::s_SpinLock (TASK_LEVEL);
+
+CNetBuffer *CNetBuffer::Alloc (unsigned nHeadroom)
+{
+	assert (nHeadroom <= NET_BUFFER_SIZE);
+
+	s_SpinLock.Acquire ();
+
+	CNetBuffer *pBuffer = s_pFreeList;
+	if (pBuffer != 0)
+	{
+		s_pFreeList = pBuffer->m_pNextSegment;
+
+		s_SpinLock.Release ();
+	}
+	else
+	{
+		s_SpinLock.Release ();
+
+		pBuffer = new CNetBuffer;
+		assert (pBuffer != 0);
+	}
+
+	pBuffer->m_pData = pBuffer->m_Buffer + nHeadroom;
+	pBuffer->m_nLength = 0;
+	pBuffer->m_nRefCount = 1;
+	pBuffer->m_pNextSegment = 0;
+	pBuffer->m_bChecksumValid = FALSE;
+	pBuffer->m_pChecksumStart = 0;
+
+	return pBuffer;
+}
+
+CNetBuffer *CNetBuffer::Alloc (const void *pData, unsigned nLength, unsigned nHeadroom)
+{
+	CNetBuffer *pBuffer = Alloc (nHeadroom);
+	assert (pBuffer != 0);
+
+	assert (pData != 0);
+	memcpy (pBuffer->Append (nLength), pData, nLength);
+
+	return pBuffer;
+}
+
+void CNetBuffer::AddRef (void)
+{
+	assert (m_nRefCount > 0);
+	__atomic_add_fetch (&m_nRefCount, 1, __ATOMIC_RELAXED);
+}
+
+void CNetBuffer::Release (void)
+{
+	CNetBuffer *pBuffer = this;
+	while (pBuffer != 0)
+	{
+		assert (pBuffer->m_nRefCount > 0);
+		if (__atomic_sub_fetch (&pBuffer->m_nRefCount, 1, __ATOMIC_ACQ_REL) != 0)
+		{
+			break;
+		}
+
+		CNetBuffer *pNext = pBuffer->m_pNextSegment;
+
+		s_SpinLock.Acquire ();
+
+		pBuffer->m_pNextSegment = s_pFreeList;
+		s_pFreeList = pBuffer;
+
+		s_SpinLock.Release ();
+
+		pBuffer = pNext;
+	}
+}
+
+unsigned CNetBuffer::GetTotalLength (void) const
+{
+	unsigned nLength = 0;
+	for (const CNetBuffer *pBuffer = this; pBuffer != 0; pBuffer = pBuffer->m_pNextSegment)
+	{
+		nLength += pBuffer->m_nLength;
+	}
+
+	return nLength;
+}
+
+void *CNetBuffer::Append (unsigned nLength)
+{
+	assert (nLength <= GetTailroom ());
+
+	u8 *pTail = m_pData + m_nLength;
+	m_nLength += nLength;
+
+	return pTail;
+}
+
+void *CNetBuffer::Prepend (unsigned nLength)
+{
+	assert (nLength <= GetHeadroom ());
+
+	m_pData -= nLength;
+	m_nLength += nLength;
+
+	return m_pData;
+}
+
+void *CNetBuffer::RemoveHeader (unsigned nLength)
+{
+	if (nLength > m_nLength)
+	{
+		return 0;
+	}
+
+	m_pData += nLength;
+	m_nLength -= nLength;
+
+	return m_pData;
+}
+
+void CNetBuffer::Truncate (unsigned nLength)
+{
+	assert (nLength <= m_nLength);
+	m_nLength = nLength;
+}
+
+void CNetBuffer::AppendSegment (CNetBuffer *pSegment)
+{
+	assert (pSegment != 0);
+	assert (pSegment != this);
+
+	CNetBuffer *pLast = this;
+	while (pLast->m_pNextSegment != 0)
+	{
+		pLast = pLast->m_pNextSegment;
+	}
+
+	pLast->m_pNextSegment = pSegment;
+}
+
+CNetBuffer *CNetBuffer::DetachSegments (void)
+{
+	CNetBuffer *pSegments = m_pNextSegment;
+	m_pNextSegment = 0;
+
+	return pSegments;
+}
+
+unsigned CNetBuffer::GetSegmentCount (void) const
+{
+	unsigned nCount = 0;
+	for (const CNetBuffer *pSegment = this; pSegment != 0; pSegment = pSegment->m_pNextSegment)
+	{
+		nCount++;
+	}
+
+	return nCount;
+}
+
+void CNetBuffer::CopyTo (void *pBuffer) const
+{
+	u8 *pDest = (u8 *) pBuffer;
+	assert (pDest != 0);
+
+	for (const CNetBuffer *pSegment = this; pSegment != 0; pSegment = pSegment->m_pNextSegment)
+	{
+		memcpy (pDest, pSegment->m_pData, pSegment->m_nLength);
+		pDest += pSegment->m_nLength;
+	}
+}
+
+void CNetBuffer::CopyTo (void *pBuffer, unsigned nLength, unsigned nOffset) const
+{
+	u8 *pDest = (u8 *) pBuffer;
+	assert (pDest != 0);
+
+	for (const CNetBuffer *pSegment = this;
+	     pSegment != 0 && nLength > 0;
+	     pSegment = pSegment->m_pNextSegment)
+	{
+		if (nOffset >= pSegment->m_nLength)
+		{
+			nOffset -= pSegment->m_nLength;
+
+			continue;
+		}
+
+		unsigned nChunk = pSegment->m_nLength - nOffset;
+		if (nChunk > nLength)
+		{
+			nChunk = nLength;
+		}
+
+		memcpy (pDest, pSegment->m_pData + nOffset, nChunk);
+		pDest += nChunk;
+		nLength -= nChunk;
+		nOffset = 0;
+	}
+
+	assert (nLength == 0);
+}
+
+void CNetBuffer::SetChecksumPartial (const void *pStart, unsigned nOffset)
+{
+	const u8 *pStart8 = (const u8 *) pStart;
+	assert (pStart8 >= m_pData);
+	assert (pStart8 + nOffset + sizeof (u16) <= m_pData + m_nLength);
+
+	m_pChecksumStart = pStart8;
+	m_nChecksumOffset = nOffset;
+}
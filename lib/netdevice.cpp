@@ -18,6 +18,9 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/netdevice.h>
+#include <circle/netbuffer.h>
+#include <circle/synchronize.h>
+#include <assert.h>
 
 const char *CNetDevice::s_SpeedString[NetDeviceSpeedUnknown] =
 {
@@ -33,6 +36,81 @@ unsigned CNetDevice::s_nDeviceNumber = 0;
 
 CNetDevice *CNetDevice::s_pDevice[MAX_NET_DEVICES];
 
+boolean CNetDevice::SendBuffer (CNetBuffer *pFrame)
+{
+	assert (pFrame != 0);
+	unsigned nLength = pFrame->GetTotalLength ();
+	assert (nLength <= FRAME_BUFFER_SIZE);
+
+	if (   pFrame->GetNextSegment () != 0
+	    || ((uintptr) pFrame->GetData () & (DATA_CACHE_LINE_LENGTH_MAX-1)) != 0)
+	{
+		DMA_BUFFER (u8, Buffer, FRAME_BUFFER_SIZE);
+		pFrame->CopyTo (Buffer);
+
+		return SendFrame (Buffer, nLength);
+	}
+
+	return SendFrame (pFrame->GetData (), nLength);
+}
+
+unsigned CNetDevice::SendBuffers (CNetBuffer *pFrames[], unsigned nCount)
+{
+	assert (pFrames != 0);
+
+	unsigned nFrames = 0;
+	while (   nFrames < nCount
+	       && (   nFrames == 0
+		   || IsSendFrameAdvisable ())
+	       && SendBuffer (pFrames[nFrames]))
+	{
+		nFrames++;
+	}
+
+	return nFrames;
+}
+
+boolean CNetDevice::ReceiveBuffer (CNetBuffer *pFrame)
+{
+	assert (pFrame != 0);
+	assert (pFrame->GetLength () == 0);
+	assert (pFrame->GetTailroom () >= FRAME_BUFFER_SIZE);
+
+	unsigned nLength;
+	if (!ReceiveFrame (pFrame->GetData (), &nLength))
+	{
+		return FALSE;
+	}
+
+	assert (nLength <= FRAME_BUFFER_SIZE);
+	pFrame->Append (nLength);
+
+	return TRUE;
+}
+
+unsigned CNetDevice::ReceiveBuffers (CNetBuffer *pFrames[], unsigned nBudget)
+{
+	assert (pFrames != 0);
+
+	unsigned nFrames = 0;
+	while (nFrames < nBudget)
+	{
+		CNetBuffer *pFrame = CNetBuffer::Alloc ();
+		assert (pFrame != 0);
+
+		if (!ReceiveBuffer (pFrame))
+		{
+			pFrame->Release ();
+
+			break;
+		}
+
+		pFrames[nFrames++] = pFrame;
+	}
+
+	return nFrames;
+}
+
 void CNetDevice::AddNetDevice (void)
 {
 	if (s_nDeviceNumber < MAX_NET_DEVICES)
@@ -41,6 +119,51 @@ void CNetDevice::AddNetDevice (void)
 	}
 }
 
+u32 CNetDevice::GetFlowHash (const void *pFrame, unsigned nLength)
+{
+	const u8 *pFrame8 = (const u8 *) pFrame;
+	assert (pFrame8 != 0);
+
+	// Ethernet header without VLAN tag, followed by an IPv4 header
+	const unsigned nIPOffset = 14;
+	if (   nLength < nIPOffset + 20
+	    || pFrame8[12] != 0x08
+	    || pFrame8[13] != 0x00
+	    || (pFrame8[nIPOffset] >> 4) != 4)
+	{
+		return 0;
+	}
+
+	const u8 *pIPHeader = pFrame8 + nIPOffset;
+	unsigned nIPHeaderLength = (pIPHeader[0] & 0xF) * 4;
+	u8 nProtocol = pIPHeader[9];
+
+	// hash source address, destination address and protocol (FNV-1a)
+	u32 nHash = 2166136261U;
+	for (unsigned i = 12; i < 20; i++)
+	{
+		nHash = (nHash ^ pIPHeader[i]) * 16777619U;
+	}
+	nHash = (nHash ^ nProtocol) * 16777619U;
+
+	// ports are only available in the first fragment
+	boolean bFragment =    (pIPHeader[6] & 0x3F) != 0		// MF flag or fragment offset
+			    || pIPHeader[7] != 0;
+	if (   (   nProtocol == 6				// TCP
+		|| nProtocol == 17)				// UDP
+	    && !bFragment
+	    && nIPHeaderLength >= 20
+	    && nLength >= nIPOffset + nIPHeaderLength + 4)
+	{
+		for (unsigned i = 0; i < 4; i++)
+		{
+			nHash = (nHash ^ pIPHeader[nIPHeaderLength + i]) * 16777619U;
+		}
+	}
+
+	return nHash != 0 ? nHash : 1;
+}
+
 const char *CNetDevice::GetSpeedString (TNetDeviceSpeed Speed)
 {
 	if (Speed >= NetDeviceSpeedUnknown)
@@ -68,6 +68,10 @@ CPageTable::CPageTable (u32 nMemSize)
 		{
 			nAttributes = ARMV6MMUL1SECTION_COHERENT;
 		}
+		else if (nBaseAddress == MEM_DMA_COHERENT_POOL)
+		{
+			nAttributes = ARMV6MMUL1SECTION_NONCACHED;
+		}
 		else if (nBaseAddress < nMemSize)
 		{
 			nAttributes = ARMV6MMUL1SECTION_NORMAL_XN;
@@ -174,11 +178,17 @@ u64 *CPageTable::CreateLevel2Table (u64 nBaseAddress)
 				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
 			}
 			else if (   nBaseAddress >= MEM_COHERENT_REGION
-				 && nBaseAddress <  MEM_HEAP_START)
+				 && nBaseAddress <  MEM_DMA_COHERENT_POOL)
 			{
 				pDesc->AttrIndx = ATTRINDX_COHERENT;
 				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
 			}
+			else if (   nBaseAddress >= MEM_DMA_COHERENT_POOL
+				 && nBaseAddress <  MEM_HEAP_START)
+			{
+				pDesc->AttrIndx = ATTRINDX_NONCACHED;
+				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+			}
 
 			if (nBaseAddress == MEM_PCIE_RANGE_START_VIRTUAL)
 			{
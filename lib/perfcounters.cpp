@@ -0,0 +1,301 @@
+//
+// perfcounters.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/perfcounters.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+#define PMCR_E			(1 << 0)	// enable all counters
+#define PMCR_P			(1 << 1)	// reset event counters
+#define PMCR_C			(1 << 2)	// reset cycle counter
+#define PMCR_LC			(1 << 6)	// 64-bit cycle counter (AArch64 only)
+#define PMCR_N_SHIFT		11
+#define PMCR_N_MASK		(0x1F << PMCR_N_SHIFT)
+
+#define PMU_CYCLE_COUNTER	(1U << 31)
+
+#if RASPPI >= 2
+
+#if AARCH == 32
+
+#define PMU_WRITE(crm, op2, value) \
+	asm volatile ("mcr p15, 0, %0, c9, " #crm ", " #op2 : : "r" ((u32) (value)))
+#define PMU_READ(crm, op2, value) \
+	asm volatile ("mrc p15, 0, %0, c9, " #crm ", " #op2 : "=r" (value))
+
+#define PMCR_READ(value)		PMU_READ (c12, 0, value)
+#define PMCR_WRITE(value)		PMU_WRITE (c12, 0, value)
+#define PMCNTENSET_WRITE(value)		PMU_WRITE (c12, 1, value)
+#define PMCNTENCLR_WRITE(value)		PMU_WRITE (c12, 2, value)
+#define PMSELR_WRITE(value)		PMU_WRITE (c12, 5, value)
+#define PMXEVTYPER_WRITE(value)		PMU_WRITE (c13, 1, value)
+#define PMXEVCNTR_READ(value)		PMU_READ (c13, 2, value)
+#define PMINTENCLR_WRITE(value)		PMU_WRITE (c14, 2, value)
+
+#else
+
+#define PMU_WRITE(reg, value) \
+	asm volatile ("msr " #reg ", %0" : : "r" ((u64) (value)))
+#define PMU_READ(reg, value) \
+	do { u64 nValue; asm volatile ("mrs %0, " #reg : "=r" (nValue)); \
+	     value = (u32) nValue; } while (0)
+
+#define PMCR_READ(value)		PMU_READ (pmcr_el0, value)
+#define PMCR_WRITE(value)		PMU_WRITE (pmcr_el0, value)
+#define PMCNTENSET_WRITE(value)		PMU_WRITE (pmcntenset_el0, value)
+#define PMCNTENCLR_WRITE(value)		PMU_WRITE (pmcntenclr_el0, value)
+#define PMSELR_WRITE(value)		PMU_WRITE (pmselr_el0, value)
+#define PMXEVTYPER_WRITE(value)		PMU_WRITE (pmxevtyper_el0, value)
+#define PMXEVCNTR_READ(value)		PMU_READ (pmxevcntr_el0, value)
+#define PMINTENCLR_WRITE(value)		PMU_WRITE (pmintenclr_el1, value)
+#define PMCCFILTR_WRITE(value)		PMU_WRITE (pmccfiltr_el0, value)
+
+#endif
+
+#endif
+
+static const struct
+{
+	const char *pName;
+	u32	    nEventNumber;		// common architectural event
+}
+s_EventInfo[PerfEventUnknown] =
+{
+	{"none",			0},
+	{"instructions",		0x08},
+	{"L1-dcache-loads",		0x04},
+	{"L1-dcache-load-misses",	0x03},
+	{"L1-icache-load-misses",	0x01},
+	{"LLC-loads",			0x16},
+	{"LLC-load-misses",		0x17},
+	{"branch-misses",		0x10}
+};
+
+CPerfCounters::CPerfCounters (TPerfEvent Event0, TPerfEvent Event1,
+			      TPerfEvent Event2, TPerfEvent Event3)
+#if RASPPI >= 2
+:	m_bAvailable (TRUE)
+#else
+:	m_bAvailable (FALSE)
+#endif
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_nCore = CMultiCoreSupport::ThisCore ();
+#else
+	m_nCore = 0;
+#endif
+
+	m_Event[0] = Event0;
+	m_Event[1] = Event1;
+	m_Event[2] = Event2;
+	m_Event[3] = Event3;
+
+	unsigned nImplemented = GetImplementedCounters ();
+	u32 nEnable = PMU_CYCLE_COUNTER;
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		assert (m_Event[i] < PerfEventUnknown);
+		if (m_Event[i] == PerfEventNone)
+		{
+			continue;
+		}
+
+		if (i >= nImplemented)
+		{
+			m_Event[i] = PerfEventNone;
+			m_bAvailable = FALSE;
+
+			continue;
+		}
+
+		nEnable |= 1 << i;
+	}
+
+#if RASPPI >= 2
+	PMCNTENCLR_WRITE (nEnable);
+	PMINTENCLR_WRITE (nEnable);
+
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		if (m_Event[i] != PerfEventNone)
+		{
+			PMSELR_WRITE (i);
+			InstructionSyncBarrier ();
+			PMXEVTYPER_WRITE (s_EventInfo[m_Event[i]].nEventNumber);	// EL0 and EL1
+		}
+	}
+
+#if AARCH == 32
+	PMCR_WRITE (PMCR_E | PMCR_P | PMCR_C);
+#else
+	PMCCFILTR_WRITE (0);
+	PMCR_WRITE (PMCR_E | PMCR_P | PMCR_C | PMCR_LC);
+#endif
+
+	PMCNTENSET_WRITE (nEnable);
+	InstructionSyncBarrier ();
+#endif
+}
+
+CPerfCounters::~CPerfCounters (void)
+{
+#if RASPPI >= 2
+	u32 nEnable = PMU_CYCLE_COUNTER;
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		if (m_Event[i] != PerfEventNone)
+		{
+			nEnable |= 1 << i;
+		}
+	}
+
+	PMCNTENCLR_WRITE (nEnable);
+	InstructionSyncBarrier ();
+#endif
+}
+
+void CPerfCounters::Reset (void)
+{
+#if RASPPI >= 2
+	u32 nPMCR;
+	PMCR_READ (nPMCR);
+	PMCR_WRITE (nPMCR | PMCR_P | PMCR_C);
+	InstructionSyncBarrier ();
+#endif
+}
+
+void CPerfCounters::Read (TPerfCounterValues *pValues) const
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (CMultiCoreSupport::ThisCore () == m_nCore);
+#endif
+
+	assert (pValues != 0);
+	pValues->nCycles = ReadCycleCounter ();
+
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		u32 nValue = 0;
+
+#if RASPPI >= 2
+		if (m_Event[i] != PerfEventNone)
+		{
+			PMSELR_WRITE (i);
+			InstructionSyncBarrier ();
+			PMXEVCNTR_READ (nValue);
+		}
+#endif
+
+		pValues->nEvent[i] = nValue;
+	}
+}
+
+TPerfEvent CPerfCounters::GetEvent (unsigned nCounter) const
+{
+	assert (nCounter < PERF_EVENT_COUNTERS);
+	return m_Event[nCounter];
+}
+
+const char *CPerfCounters::GetEventName (TPerfEvent Event)
+{
+	assert (Event < PerfEventUnknown);
+	return s_EventInfo[Event].pName;
+}
+
+unsigned CPerfCounters::GetImplementedCounters (void)
+{
+#if RASPPI >= 2
+	u32 nPMCR;
+	PMCR_READ (nPMCR);
+
+	return (nPMCR & PMCR_N_MASK) >> PMCR_N_SHIFT;
+#else
+	return 0;
+#endif
+}
+
+// %llu is not available in any case
+static void FormatU64 (CString *pString, u64 nValue)
+{
+	assert (pString != 0);
+
+	if (nValue < 1000000000U)
+	{
+		pString->Format ("%u", (unsigned) nValue);
+	}
+	else
+	{
+		pString->Format ("%u%09u", (unsigned) (nValue / 1000000000U),
+				 (unsigned) (nValue % 1000000000U));
+	}
+}
+
+void CPerfCounters::Dump (const char *pSource, const TPerfCounterValues *pValues) const
+{
+	assert (pSource != 0);
+	assert (pValues != 0);
+
+	CString Value;
+	FormatU64 (&Value, pValues->nCycles);
+	CLogger::Get ()->Write (pSource, LogNotice, "%12s cycles", (const char *) Value);
+
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		if (m_Event[i] != PerfEventNone)
+		{
+			FormatU64 (&Value, pValues->nEvent[i]);
+			CLogger::Get ()->Write (pSource, LogNotice, "%12s %s",
+						(const char *) Value, GetEventName (m_Event[i]));
+		}
+	}
+}
+
+CPerfMeasurement::CPerfMeasurement (const CPerfCounters *pCounters, TPerfCounterValues *pResult)
+:	m_pCounters (pCounters),
+	m_pResult (pResult)
+{
+	assert (m_pCounters != 0);
+	assert (m_pResult != 0);
+
+	m_pCounters->Read (&m_Start);
+}
+
+CPerfMeasurement::~CPerfMeasurement (void)
+{
+	TPerfCounterValues End;
+	m_pCounters->Read (&End);
+
+	// the counters may have wrapped, the differences are valid up to 2^32 events
+#if AARCH == 32
+	m_pResult->nCycles += (u32) (End.nCycles - m_Start.nCycles);
+#else
+	m_pResult->nCycles += End.nCycles - m_Start.nCycles;
+#endif
+
+	for (unsigned i = 0; i < PERF_EVENT_COUNTERS; i++)
+	{
+		m_pResult->nEvent[i] += (u32) (End.nEvent[i] - m_Start.nEvent[i]);
+	}
+
+	m_pResult = 0;
+	m_pCounters = 0;
+}
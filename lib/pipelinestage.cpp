@@ -0,0 +1,298 @@
+//
+// pipelinestage.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/pipelinestage.h>
+#include <circle/multicore.h>
+#include <circle/synchronize.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+LOGMODULE ("pipeline");
+
+CPipelineStage *CPipelineStage::s_pFirst = 0;
+
+TPipelineViolation CPipelineStage::s_Violations[PIPELINE_VIOLATIONS];
+unsigned CPipelineStage::s_nViolations = 0;
+
+CSpinLock CPipelineStage::s_ListLock (TASK_LEVEL);
+CSpinLock CPipelineStage::s_ViolationLock (IRQ_LEVEL);
+
+CPipelineStage::CPipelineStage (const char *pName, unsigned nBudgetUs)
+:	m_pName (pName),
+	m_nBudget (nBudgetUs)
+{
+	assert (m_pName != 0);
+
+	Reset ();
+
+	s_ListLock.Acquire ();
+
+	// append to the list, so that the stages are reported in order of creation
+	m_pNext = 0;
+
+	CPipelineStage **ppStage = &s_pFirst;
+	while (*ppStage != 0)
+	{
+		ppStage = &(*ppStage)->m_pNext;
+	}
+	*ppStage = this;
+
+	s_ListLock.Release ();
+}
+
+CPipelineStage::~CPipelineStage (void)
+{
+	s_ListLock.Acquire ();
+
+	for (CPipelineStage **ppStage = &s_pFirst; *ppStage != 0; ppStage = &(*ppStage)->m_pNext)
+	{
+		if (*ppStage == this)
+		{
+			*ppStage = m_pNext;
+
+			break;
+		}
+	}
+
+	s_ListLock.Release ();
+
+	// recorded violations refer to our name
+	s_ViolationLock.Acquire ();
+
+	for (unsigned i = 0; i < PIPELINE_VIOLATIONS; i++)
+	{
+		if (s_Violations[i].pStage == m_pName)
+		{
+			s_Violations[i].pStage = "(removed)";
+		}
+	}
+
+	s_ViolationLock.Release ();
+}
+
+void CPipelineStage::Record (unsigned nLatencyUs, uintptr nContext)
+{
+	__atomic_add_fetch (&m_nBucket[CLatencyMonitor::GetBucket (nLatencyUs)], 1,
+			    __ATOMIC_RELAXED);
+	__atomic_add_fetch (&m_nCount, 1, __ATOMIC_RELAXED);
+
+	u32 nMax = __atomic_load_n (&m_nMax, __ATOMIC_RELAXED);
+	while (   nLatencyUs > nMax
+	       && !__atomic_compare_exchange_n (&m_nMax, &nMax, nLatencyUs, TRUE,
+						__ATOMIC_RELAXED, __ATOMIC_RELAXED))
+	{
+		// nMax has been updated with the current value
+	}
+
+	if (nLatencyUs > m_nBudget)
+	{
+		__atomic_add_fetch (&m_nViolations, 1, __ATOMIC_RELAXED);
+
+		AddViolation (nLatencyUs, nContext);
+	}
+}
+
+void CPipelineStage::Reset (void)
+{
+	memset (m_nBucket, 0, sizeof m_nBucket);
+	m_nCount = 0;
+	m_nMax = 0;
+	m_nViolations = 0;
+
+	DataMemBarrier ();
+}
+
+void CPipelineStage::GetStatistics (TPipelineStageStatistics *pStatistics) const
+{
+	assert (pStatistics != 0);
+
+	pStatistics->nCount = __atomic_load_n (&m_nCount, __ATOMIC_RELAXED);
+	pStatistics->nMax = __atomic_load_n (&m_nMax, __ATOMIC_RELAXED);
+	pStatistics->nViolations = __atomic_load_n (&m_nViolations, __ATOMIC_RELAXED);
+
+	pStatistics->nP50 = FindPercentile (pStatistics->nCount, 500);
+	pStatistics->nP99 = FindPercentile (pStatistics->nCount, 990);
+	pStatistics->nP999 = FindPercentile (pStatistics->nCount, 999);
+
+	// the percentiles are upper bounds of buckets
+	if (pStatistics->nP50 > pStatistics->nMax)	pStatistics->nP50 = pStatistics->nMax;
+	if (pStatistics->nP99 > pStatistics->nMax)	pStatistics->nP99 = pStatistics->nMax;
+	if (pStatistics->nP999 > pStatistics->nMax)	pStatistics->nP999 = pStatistics->nMax;
+}
+
+void CPipelineStage::ResetAll (void)
+{
+	s_ListLock.Acquire ();
+
+	for (CPipelineStage *pStage = s_pFirst; pStage != 0; pStage = pStage->m_pNext)
+	{
+		pStage->Reset ();
+	}
+
+	s_ListLock.Release ();
+
+	s_ViolationLock.Acquire ();
+
+	s_nViolations = 0;
+
+	s_ViolationLock.Release ();
+}
+
+unsigned CPipelineStage::GetViolations (TPipelineViolation *pBuffer, unsigned nMaxEntries)
+{
+	assert (pBuffer != 0);
+
+	s_ViolationLock.Acquire ();
+
+	unsigned nEntries = s_nViolations < PIPELINE_VIOLATIONS ? s_nViolations
+								: PIPELINE_VIOLATIONS;
+	if (nEntries > nMaxEntries)
+	{
+		nEntries = nMaxEntries;
+	}
+
+	// the newest entries are returned, if the buffer is too small
+	for (unsigned i = 0; i < nEntries; i++)
+	{
+		pBuffer[i] = s_Violations[(s_nViolations - nEntries + i) % PIPELINE_VIOLATIONS];
+	}
+
+	s_ViolationLock.Release ();
+
+	return nEntries;
+}
+
+unsigned CPipelineStage::Export (char *pBuffer, unsigned nBufferSize)
+{
+	assert (pBuffer != 0);
+
+	CString Output;
+	CString Line;
+
+	Output.Append ("Stage                 Budget      Count     p50     p99   p99.9     Max"
+		       " Violations\n");
+
+	s_ListLock.Acquire ();
+
+	for (CPipelineStage *pStage = s_pFirst; pStage != 0; pStage = pStage->m_pNext)
+	{
+		TPipelineStageStatistics Stat;
+		pStage->GetStatistics (&Stat);
+
+		Line.Format ("%-20s %7u %10u %7u %7u %7u %7u %10u\n",
+			     pStage->m_pName, pStage->m_nBudget, Stat.nCount,
+			     Stat.nP50, Stat.nP99, Stat.nP999, Stat.nMax, Stat.nViolations);
+		Output.Append (Line);
+	}
+
+	s_ListLock.Release ();
+
+	TPipelineViolation Violations[PIPELINE_VIOLATIONS];
+	unsigned nViolations = GetViolations (Violations, PIPELINE_VIOLATIONS);
+
+	Output.Append ("\nRecent violations (times in us)\n\n");
+
+	for (unsigned i = 0; i < nViolations; i++)
+	{
+		const TPipelineViolation *pViolation = &Violations[i];
+
+		Line.Format ("%12llu %-20s %7u > %7u core %u context 0x%lX\n",
+			     (unsigned long long) pViolation->ullTimestamp, pViolation->pStage,
+			     pViolation->nLatency, pViolation->nBudget, pViolation->nCore,
+			     (unsigned long) pViolation->nContext);
+		Output.Append (Line);
+	}
+
+	unsigned nLength = Output.GetLength ();
+	if (nLength > nBufferSize)
+	{
+		nLength = nBufferSize;
+	}
+
+	memcpy (pBuffer, (const char *) Output, nLength);
+
+	return nLength;
+}
+
+void CPipelineStage::Dump (void)
+{
+	s_ListLock.Acquire ();
+
+	for (CPipelineStage *pStage = s_pFirst; pStage != 0; pStage = pStage->m_pNext)
+	{
+		TPipelineStageStatistics Stat;
+		pStage->GetStatistics (&Stat);
+
+		LOGNOTE ("%-20s budget %u n %u p50 %u p99 %u p99.9 %u max %u us, %u violations",
+			 pStage->m_pName, pStage->m_nBudget, Stat.nCount,
+			 Stat.nP50, Stat.nP99, Stat.nP999, Stat.nMax, Stat.nViolations);
+	}
+
+	s_ListLock.Release ();
+}
+
+unsigned CPipelineStage::FindPercentile (unsigned nCount, unsigned nPerMille) const
+{
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	// number of samples, which must be less or equal the result (rounded up)
+	u64 nWanted = ((u64) nCount * nPerMille + 999) / 1000;
+	if (nWanted == 0)
+	{
+		nWanted = 1;
+	}
+
+	u64 nSum = 0;
+	for (unsigned nBucket = 0; nBucket < LATENCY_BUCKETS; nBucket++)
+	{
+		nSum += __atomic_load_n (&m_nBucket[nBucket], __ATOMIC_RELAXED);
+		if (nSum >= nWanted)
+		{
+			return CLatencyMonitor::GetBucketLimit (nBucket);
+		}
+	}
+
+	// the histogram has been modified while reading
+	return CLatencyMonitor::GetBucketLimit (LATENCY_BUCKETS-1);
+}
+
+void CPipelineStage::AddViolation (unsigned nLatencyUs, uintptr nContext)
+{
+	s_ViolationLock.Acquire ();
+
+	TPipelineViolation *pViolation = &s_Violations[s_nViolations++ % PIPELINE_VIOLATIONS];
+
+	pViolation->ullTimestamp = CTimer::GetClockTicks64 ();
+	pViolation->pStage = m_pName;
+	pViolation->nLatency = nLatencyUs;
+	pViolation->nBudget = m_nBudget;
+#ifdef ARM_ALLOW_MULTI_CORE
+	pViolation->nCore = CMultiCoreSupport::ThisCore ();
+#else
+	pViolation->nCore = 0;
+#endif
+	pViolation->nContext = nContext;
+
+	s_ViolationLock.Release ();
+}
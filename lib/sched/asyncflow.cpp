@@ -0,0 +1,213 @@
+//
+// asyncflow.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/asyncflow.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+CAsyncFlow::CAsyncFlow (void)
+:	m_nResumePoint (0),
+	m_pQueue (0),
+	m_WorkItem (WorkFunction, this),
+	m_bPending (FALSE),
+	m_bCompleted (FALSE),
+	m_nResult (0),
+	m_pWaitEvent (0),
+	m_pWaitListNext (0)
+{
+}
+
+CAsyncFlow::~CAsyncFlow (void)
+{
+	assert (!m_bPending);
+	assert (m_pWaitEvent == 0);
+	assert (!m_WorkItem.IsPending ());
+
+	m_pQueue = 0;
+}
+
+void CAsyncFlow::Start (CWorkQueue *pQueue)
+{
+	assert (!m_bPending);
+
+	m_pQueue = pQueue != 0 ? pQueue : CWorkQueue::Get ();
+	assert (m_pQueue != 0);
+
+	m_nResumePoint = 0;
+
+	Reschedule ();
+}
+
+void CAsyncFlow::Reschedule (void)
+{
+	assert (m_pQueue != 0);
+	m_pQueue->Queue (&m_WorkItem);
+}
+
+boolean CAsyncFlow::AwaitEvent (CSynchronizationEvent *pEvent)
+{
+	if (m_bPending)
+	{
+		return FetchCompletion ();
+	}
+
+	assert (pEvent != 0);
+	if (pEvent->GetState ())
+	{
+		m_nResult = 0;
+
+		return TRUE;
+	}
+
+	SuspendOnEvent (pEvent);
+
+	return FALSE;
+}
+
+boolean CAsyncFlow::AwaitDelay (unsigned nMicroSeconds)
+{
+	if (m_bPending)
+	{
+		return FetchCompletion ();
+	}
+
+	Suspend ();
+
+	CTimer::Get ()->StartKernelTimerUs (nMicroSeconds, DelayHandler, this);
+
+	return FALSE;
+}
+
+boolean CAsyncFlow::AwaitBlockRequest (CDevice *pDevice, TDeviceBlockRequest *pRequest)
+{
+	if (m_bPending)
+	{
+		return FetchCompletion ();
+	}
+
+	assert (pRequest != 0);
+	pRequest->pCompletionRoutine = BlockCompletionRoutine;
+	pRequest->pParam = this;
+
+	Suspend ();
+
+	assert (pDevice != 0);
+	if (pDevice->IOCtl (DEVICE_IOCTL_SUBMIT, pRequest) == 0)
+	{
+		return FALSE;
+	}
+
+	// otherwise transfer synchronously
+	m_bPending = FALSE;
+
+	int nResult = -1;
+	if (pDevice->Seek (pRequest->ullOffset) == pRequest->ullOffset)
+	{
+		nResult = pRequest->bWrite ? pDevice->Write (pRequest->pBuffer, pRequest->nCount)
+					   : pDevice->Read (pRequest->pBuffer, pRequest->nCount);
+	}
+
+	m_nResult = nResult;
+
+	return TRUE;
+}
+
+void CAsyncFlow::Suspend (void)
+{
+	assert (!m_bPending);
+
+	m_bCompleted = FALSE;
+	m_bPending = TRUE;
+}
+
+void CAsyncFlow::SuspendOnEvent (CSynchronizationEvent *pEvent)
+{
+	assert (pEvent != 0);
+
+	Suspend ();
+
+	pEvent->AddAsyncFlow (this);
+}
+
+void CAsyncFlow::Complete (int nResult)
+{
+	assert (m_bPending);
+	assert (!m_bCompleted);
+
+	m_nResult = nResult;
+
+	DataMemBarrier ();
+
+	m_bCompleted = TRUE;
+
+	Reschedule ();
+}
+
+boolean CAsyncFlow::FetchCompletion (void)
+{
+	assert (m_bPending);
+
+	if (!m_bCompleted)
+	{
+		return FALSE;
+	}
+
+	DataMemBarrier ();
+
+	m_bCompleted = FALSE;
+	m_bPending = FALSE;
+
+	return TRUE;
+}
+
+void CAsyncFlow::WorkFunction (void *pParam)
+{
+	CAsyncFlow *pThis = (CAsyncFlow *) pParam;
+	assert (pThis != 0);
+
+	if (pThis->IsFinished ())
+	{
+		return;
+	}
+
+	pThis->Run ();
+
+	if (pThis->IsFinished ())
+	{
+		assert (!pThis->m_bPending);
+
+		pThis->Finished ();		// may delete the flow
+	}
+}
+
+void CAsyncFlow::DelayHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CAsyncFlow *pThis = (CAsyncFlow *) pParam;
+	assert (pThis != 0);
+
+	pThis->Complete (0);
+}
+
+void CAsyncFlow::BlockCompletionRoutine (int nResult, void *pParam)
+{
+	CAsyncFlow *pThis = (CAsyncFlow *) pParam;
+	assert (pThis != 0);
+
+	pThis->Complete (nResult);
+}
@@ -0,0 +1,173 @@
+//
+// cpugovernor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/cpugovernor.h>
+#include <circle/sched/scheduler.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+CCPUGovernor::CCPUGovernor (CCPUThrottle *pThrottle, unsigned nSamplingMs,
+			    unsigned nUpThreshold, unsigned nDownThreshold, unsigned nDownDelay)
+:	CTask (TASK_STACK_SIZE, FALSE, TASK_PRIORITY_HIGHEST),
+	m_pThrottle (pThrottle),
+	m_nSamplingMs (nSamplingMs),
+	m_nUpThreshold (nUpThreshold),
+	m_nDownThreshold (nDownThreshold),
+	m_nDownDelay (nDownDelay),
+	m_nClockRate (0),
+	m_nLowSamples (0),
+	m_nLoad (0),
+	m_nLastTicks (0),
+	m_nBoostEndTicks (0),
+	m_bBoost (FALSE)
+{
+	assert (m_nSamplingMs > 0);
+	assert (m_nDownThreshold < m_nUpThreshold);
+	assert (m_nUpThreshold <= 100);
+
+	for (unsigned i = 0; i < sizeof m_nLastIdleTicks / sizeof m_nLastIdleTicks[0]; i++)
+	{
+		m_nLastIdleTicks[i] = 0;
+	}
+
+	SetName ("cpugov");
+}
+
+CCPUGovernor::~CCPUGovernor (void)
+{
+	m_pThrottle = 0;
+}
+
+void CCPUGovernor::Run (void)
+{
+	assert (m_pThrottle != 0);
+	if (!m_pThrottle->IsDynamic ())
+	{
+		return;
+	}
+
+	unsigned nMinClockRate = m_pThrottle->GetMinClockRate ();
+	unsigned nMaxClockRate = m_pThrottle->GetMaxClockRate ();
+
+	m_nClockRate = nMaxClockRate;
+	m_pThrottle->RequestClockRate (m_nClockRate);
+
+	MeasureLoad ();
+
+	while (1)
+	{
+		m_Event.Clear ();
+		m_Event.WaitWithTimeout (m_nSamplingMs * 1000);	// Boost() wakes us early
+
+		unsigned nLoad = MeasureLoad ();
+
+		if (m_bBoost)
+		{
+			if ((int) (m_nBoostEndTicks - CTimer::GetClockTicks ()) > 0)
+			{
+				nLoad = 100;
+			}
+			else
+			{
+				m_bBoost = FALSE;
+			}
+		}
+
+		if (nLoad > m_nUpThreshold)
+		{
+			m_nClockRate = nMaxClockRate;
+			m_nLowSamples = 0;
+		}
+		else if (nLoad < m_nDownThreshold)
+		{
+			if (++m_nLowSamples >= m_nDownDelay)
+			{
+				m_nLowSamples = 0;
+
+				// one step down, aligned to the step granularity
+				unsigned nClockRate = (m_nClockRate - 1) / CPU_GOVERNOR_STEP
+									 * CPU_GOVERNOR_STEP;
+				m_nClockRate = nClockRate > nMinClockRate ? nClockRate : nMinClockRate;
+			}
+		}
+		else
+		{
+			m_nLowSamples = 0;
+		}
+
+		m_pThrottle->RequestClockRate (m_nClockRate);
+		m_pThrottle->Update ();
+	}
+}
+
+void CCPUGovernor::Boost (unsigned nMilliSeconds)
+{
+	m_nBoostEndTicks = CTimer::GetClockTicks () + nMilliSeconds * (CLOCKHZ / 1000);
+	m_bBoost = TRUE;
+
+	m_Event.Set ();
+}
+
+unsigned CCPUGovernor::MeasureLoad (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	unsigned nInterval = nTicks - m_nLastTicks;
+	m_nLastTicks = nTicks;
+
+	unsigned nMaxLoad = 0;
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	CScheduler *pScheduler = CScheduler::Get ();
+	assert (pScheduler != 0);
+
+	unsigned nIdleTicks = pScheduler->GetIdleTicks ();
+	unsigned nIdle = nIdleTicks - m_nLastIdleTicks[0];
+	m_nLastIdleTicks[0] = nIdleTicks;
+
+	if (nInterval > 0 && nIdle < nInterval)
+	{
+		nMaxLoad = (u64) (nInterval - nIdle) * 100 / nInterval;
+	}
+#else
+	for (unsigned nCore = 0; nCore < CORES; nCore++)
+	{
+		if (!CScheduler::IsActive (nCore))
+		{
+			continue;
+		}
+
+		unsigned nIdleTicks = CScheduler::Get (nCore)->GetIdleTicks ();
+		unsigned nIdle = nIdleTicks - m_nLastIdleTicks[nCore];
+		m_nLastIdleTicks[nCore] = nIdleTicks;
+
+		if (nInterval > 0 && nIdle < nInterval)
+		{
+			unsigned nLoad = (u64) (nInterval - nIdle) * 100 / nInterval;
+			if (nLoad > nMaxLoad)
+			{
+				nMaxLoad = nLoad;
+			}
+		}
+	}
+#endif
+
+	m_nLoad = nMaxLoad;
+
+	return nMaxLoad;
+}
@@ -0,0 +1,162 @@
+//
+// initsequencer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/initsequencer.h>
+#include <circle/bootprofile.h>
+#include <circle/timer.h>
+#include <assert.h>
+
+class CInitStepTask : public CTask
+{
+public:
+	CInitStepTask (CInitSequencer *pSequencer, unsigned nStep, unsigned nCore)
+	:	CTask (TASK_STACK_SIZE, TRUE, TASK_PRIORITY_DEFAULT, nCore),
+		m_pSequencer (pSequencer),
+		m_nStep (nStep)
+	{
+	}
+
+	void Run (void)
+	{
+		assert (m_pSequencer != 0);
+		m_pSequencer->RunStep (m_nStep);
+	}
+
+private:
+	CInitSequencer *m_pSequencer;
+	unsigned m_nStep;
+};
+
+CInitSequencer::CInitSequencer (void)
+:	m_nSteps (0)
+{
+}
+
+CInitSequencer::~CInitSequencer (void)
+{
+}
+
+int CInitSequencer::AddStep (const char *pName, TInitStepFunction *pFunction, void *pParam,
+			     unsigned nCore)
+{
+	assert (pName != 0);
+	assert (pFunction != 0);
+
+	if (m_nSteps >= INIT_SEQUENCER_MAX_STEPS)
+	{
+		return -1;
+	}
+
+	TStep *pStep = &m_Step[m_nSteps];
+	pStep->pName = pName;
+	pStep->pFunction = pFunction;
+	pStep->pParam = pParam;
+	pStep->nCore = nCore;
+	pStep->nDependMask = 0;
+	pStep->Event.Clear ();
+	pStep->bResult = FALSE;
+	pStep->nDuration = 0;
+
+	return m_nSteps++;
+}
+
+void CInitSequencer::AddDependency (int nStep, int nDependsOnStep)
+{
+	assert (0 <= nStep && nStep < (int) m_nSteps);
+
+	// a dependency on a later step could deadlock
+	assert (0 <= nDependsOnStep && nDependsOnStep < nStep);
+
+	m_Step[nStep].nDependMask |= 1 << nDependsOnStep;
+}
+
+boolean CInitSequencer::Run (void)
+{
+	for (unsigned i = 0; i < m_nSteps; i++)
+	{
+		m_Step[i].Event.Clear ();
+
+		CInitStepTask *pTask = new CInitStepTask (this, i, m_Step[i].nCore);
+		assert (pTask != 0);
+		pTask->SetName (m_Step[i].pName);
+		pTask->Start ();
+	}
+
+	// the tasks are deleted by the scheduler on termination
+	boolean bResult = TRUE;
+	for (unsigned i = 0; i < m_nSteps; i++)
+	{
+		m_Step[i].Event.Wait ();
+
+		if (!m_Step[i].bResult)
+		{
+			bResult = FALSE;
+		}
+	}
+
+	return bResult;
+}
+
+boolean CInitSequencer::GetResult (int nStep) const
+{
+	assert (0 <= nStep && nStep < (int) m_nSteps);
+
+	return m_Step[nStep].bResult;
+}
+
+unsigned CInitSequencer::GetDuration (int nStep) const
+{
+	assert (0 <= nStep && nStep < (int) m_nSteps);
+
+	return m_Step[nStep].nDuration;
+}
+
+void CInitSequencer::RunStep (unsigned nStep)
+{
+	assert (nStep < m_nSteps);
+	TStep *pStep = &m_Step[nStep];
+
+	boolean bDependOK = TRUE;
+	for (unsigned i = 0; i < nStep; i++)
+	{
+		if (pStep->nDependMask & (1 << i))
+		{
+			m_Step[i].Event.Wait ();
+
+			if (!m_Step[i].bResult)
+			{
+				bDependOK = FALSE;
+			}
+		}
+	}
+
+	if (bDependOK)
+	{
+		CBootProfile::Mark (pStep->pName);
+
+		u64 ullStart = CTimer::GetClockTicks64 ();
+
+		assert (pStep->pFunction != 0);
+		pStep->bResult = (*pStep->pFunction) (pStep->pParam);
+
+		pStep->nDuration = (unsigned) (CTimer::GetClockTicks64 () - ullStart);
+	}
+
+	pStep->Event.Set ();
+}
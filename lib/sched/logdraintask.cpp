@@ -0,0 +1,49 @@
+//
+// logdraintask.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/logdraintask.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <assert.h>
+
+CLogDrainTask::CLogDrainTask (unsigned nIntervalMs, unsigned nPriority)
+:	CTask (TASK_STACK_SIZE, FALSE, nPriority),
+	m_nIntervalMs (nIntervalMs)
+{
+	assert (m_nIntervalMs > 0);
+
+	SetName ("logdrain");
+}
+
+CLogDrainTask::~CLogDrainTask (void)
+{
+}
+
+void CLogDrainTask::Run (void)
+{
+	CLogger *pLogger = CLogger::Get ();
+	assert (pLogger != 0);
+
+	while (1)
+	{
+		pLogger->FlushDeferred ();
+
+		CScheduler::Get ()->MsSleep (m_nIntervalMs);
+	}
+}
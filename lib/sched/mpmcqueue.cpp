@@ -0,0 +1,119 @@
+//
+// mpmcqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/mpmcqueue.h>
+#include <assert.h>
+
+// This is the bounded queue algorithm by Dmitry Vyukov. Each cell has a sequence
+// number, which tells, if the cell is free for the producer with the same
+// position (nSequence == nPos), or contains an item for the consumer with this
+// position (nSequence == nPos+1). A position is claimed with a compare-and-swap.
+
+CMPMCQueue::CMPMCQueue (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_nEnqueuePos (0),
+	m_nDequeuePos (0)
+{
+	assert (IS_POWEROF_2 (nSize));
+
+	m_pBuffer = new TCell[nSize];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < nSize; i++)
+	{
+		m_pBuffer[i].nSequence = i;
+	}
+}
+
+CMPMCQueue::~CMPMCQueue (void)
+{
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+boolean CMPMCQueue::Enqueue (void *pItem)
+{
+	TCell *pCell;
+	unsigned nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		pCell = &m_pBuffer[nPos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - nPos);
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&m_nEnqueuePos, &nPos, nPos+1, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (nDiff < 0)
+		{
+			return FALSE;		// queue is full
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nEnqueuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	pCell->pItem = pItem;
+
+	__atomic_store_n (&pCell->nSequence, nPos+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+boolean CMPMCQueue::Dequeue (void **ppItem)
+{
+	TCell *pCell;
+	unsigned nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+	while (1)
+	{
+		pCell = &m_pBuffer[nPos & m_nMask];
+		unsigned nSequence = __atomic_load_n (&pCell->nSequence, __ATOMIC_ACQUIRE);
+
+		int nDiff = (int) (nSequence - (nPos+1));
+		if (nDiff == 0)
+		{
+			if (__atomic_compare_exchange_n (&m_nDequeuePos, &nPos, nPos+1, TRUE,
+							 __ATOMIC_RELAXED, __ATOMIC_RELAXED))
+			{
+				break;
+			}
+		}
+		else if (nDiff < 0)
+		{
+			return FALSE;		// queue is empty
+		}
+		else
+		{
+			nPos = __atomic_load_n (&m_nDequeuePos, __ATOMIC_RELAXED);
+		}
+	}
+
+	assert (ppItem != 0);
+	*ppItem = pCell->pItem;
+
+	__atomic_store_n (&pCell->nSequence, nPos + m_nMask + 1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
@@ -2,7 +2,7 @@
 // mutex.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This class was developed by:
 //	Brad Robinson <contact@toptensoftware.com>
@@ -24,12 +24,21 @@
 #include <circle/sched/scheduler.h>
 #include <circle/sched/task.h>
 #include <circle/synchronize.h>
+#include <circle/multicore.h>
 #include <circle/sysconfig.h>
 #include <assert.h>
 
+// Number of loops a task spins on a mutex owned by a task on another core before it blocks
+#define MUTEX_SPIN_LOOPS	2000
+
 CMutex::CMutex (void)
 :   m_pOwningTask (0),
-    m_iReentrancyCount (0)
+    m_iReentrancyCount (0),
+    m_nWaiterPriority (TASK_PRIORITY_LOWEST),
+    m_pNextHeld (0)
+#ifdef ARM_ALLOW_MULTI_CORE
+    , m_SpinLock (TASK_LEVEL)
+#endif
 {
 }
 
@@ -38,23 +47,162 @@ CMutex::~CMutex (void)
     assert(m_pOwningTask == 0);
 }
 
+// The owner keeps a list of the mutexes it holds. On release its inherited priority is
+// recomputed from the waiters of the remaining mutexes, so that a priority inherited
+// through another mutex is not lost.
+
+void CMutex::AddToOwner (CTask *pTask)
+{
+    assert (pTask != 0);
+    m_pNextHeld = pTask->m_pHeldMutexes;
+    pTask->m_pHeldMutexes = this;
+}
+
+void CMutex::RemoveFromOwner (CTask *pTask)
+{
+    assert (pTask != 0);
+
+    unsigned nInheritedPriority = TASK_PRIORITY_LOWEST;
+
+    CMutex **ppMutex = &pTask->m_pHeldMutexes;
+    while (*ppMutex != 0)
+    {
+        if (*ppMutex == this)
+        {
+            *ppMutex = m_pNextHeld;
+            m_pNextHeld = 0;
+
+            continue;
+        }
+
+        unsigned nPriority = (*ppMutex)->m_nWaiterPriority;
+        if (nPriority > nInheritedPriority)
+        {
+            nInheritedPriority = nPriority;
+        }
+
+        ppMutex = &(*ppMutex)->m_pNextHeld;
+    }
+
+    // the waiters will raise it again, when they do not get the mutex
+    m_nWaiterPriority = TASK_PRIORITY_LOWEST;
+
+    pTask->RestorePriority (nInheritedPriority);
+}
+
+#ifndef ARM_ALLOW_MULTI_CORE
+
+// The owner check and update must not be interrupted by a preemption of the calling task.
+
 void CMutex::Acquire (void)
 {
     CTask* pTask = CScheduler::Get()->GetCurrentTask();
 
+    CScheduler::DisablePreemption();
+
     while (true)
     {
         if (m_pOwningTask == nullptr)
         {
             m_pOwningTask = pTask;
             m_iReentrancyCount = 1;
+            AddToOwner (pTask);
+            break;
+        }
+        else if (m_pOwningTask == pTask)
+        {
+            m_iReentrancyCount++;
+            break;
+        }
+
+        unsigned nPriority = pTask->GetPriority ();
+        if (nPriority > m_nWaiterPriority)
+        {
+            m_nWaiterPriority = nPriority;
+        }
+        m_pOwningTask->InheritPriority (nPriority);
+
+        m_event.Wait();
+    }
+
+    CScheduler::EnablePreemption();
+}
+
+void CMutex::Release (void)
+{
+    assert(m_pOwningTask == CScheduler::Get()->GetCurrentTask());
+    m_iReentrancyCount--;
+    if (m_iReentrancyCount == 0)
+    {
+        CScheduler::DisablePreemption();
+        m_pOwningTask = 0;
+        RemoveFromOwner (CScheduler::Get()->GetCurrentTask());
+        m_event.Pulse();
+        CScheduler::EnablePreemption();
+
+        CScheduler::Get()->Yield();
+    }
+}
+
+#else
+
+// The owner check and update is protected by a spin lock here. The event is
+// cleared before a task blocks and set on release, so that a release on
+// another core between the check and the Wait() is not lost. If the owner is
+// currently running on another core, it will probably release the mutex soon,
+// so that spinning for a while is cheaper than blocking.
+
+void CMutex::Acquire (void)
+{
+    CTask* pTask = CScheduler::Get()->GetCurrentTask();
+    boolean bSpun = FALSE;
+
+    while (true)
+    {
+        m_SpinLock.Acquire ();
+
+        if (m_pOwningTask == nullptr)
+        {
+            m_pOwningTask = pTask;
+            m_iReentrancyCount = 1;
+            AddToOwner (pTask);
+            m_SpinLock.Release ();
             return;
         }
         else if (m_pOwningTask == pTask)
         {
             m_iReentrancyCount++;
+            m_SpinLock.Release ();
             return;
         }
+
+        if (   !bSpun
+            && m_pOwningTask->GetCore () != CMultiCoreSupport::ThisCore ()
+            && m_pOwningTask->IsRunning ())
+        {
+            m_SpinLock.Release ();
+
+            for (unsigned i = 0; i < MUTEX_SPIN_LOOPS && m_pOwningTask != 0; i++)
+            {
+                DataMemBarrier ();
+            }
+
+            bSpun = TRUE;
+
+            continue;
+        }
+
+        unsigned nPriority = pTask->GetPriority ();
+        if (nPriority > m_nWaiterPriority)
+        {
+            m_nWaiterPriority = nPriority;
+        }
+        m_pOwningTask->InheritPriority (nPriority);
+
+        m_event.Clear();
+
+        m_SpinLock.Release ();
+
         m_event.Wait();
     }
 }
@@ -65,8 +213,14 @@ void CMutex::Release (void)
     m_iReentrancyCount--;
     if (m_iReentrancyCount == 0)
     {
+        m_SpinLock.Acquire ();
         m_pOwningTask = 0;
-        m_event.Pulse();
+        RemoveFromOwner (CScheduler::Get()->GetCurrentTask());
+        m_SpinLock.Release ();
+
+        m_event.Set();
         CScheduler::Get()->Yield();
     }
 }
+
+#endif
@@ -0,0 +1,161 @@
+//
+// rwlock.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/rwlock.h>
+#include <circle/sysconfig.h>
+#include <assert.h>
+
+// The lock state is protected by a spin lock, which is a no-op on single core
+// systems. An event is cleared before a task blocks and set on release, so that
+// a release on another core between the check and the Wait() is not lost.
+
+CRWLock::CRWLock (void)
+:	m_nReaders (0),
+	m_bWriter (FALSE),
+	m_nWaitingWriters (0),
+	m_SpinLock (TASK_LEVEL)
+{
+}
+
+CRWLock::~CRWLock (void)
+{
+	assert (m_nReaders == 0);
+	assert (!m_bWriter);
+	assert (m_nWaitingWriters == 0);
+}
+
+void CRWLock::AcquireRead (void)
+{
+	m_SpinLock.Acquire ();
+
+	while (   m_bWriter
+	       || m_nWaitingWriters > 0)
+	{
+		m_ReadEvent.Clear ();
+
+		m_SpinLock.Release ();
+
+		m_ReadEvent.Wait ();
+
+		m_SpinLock.Acquire ();
+	}
+
+	m_nReaders++;
+
+	m_SpinLock.Release ();
+}
+
+boolean CRWLock::TryAcquireRead (void)
+{
+	m_SpinLock.Acquire ();
+
+	if (   m_bWriter
+	    || m_nWaitingWriters > 0)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_nReaders++;
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CRWLock::ReleaseRead (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_nReaders > 0);
+	assert (!m_bWriter);
+	if (   --m_nReaders == 0
+	    && m_nWaitingWriters > 0)
+	{
+		m_WriteEvent.Set ();
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CRWLock::AcquireWrite (void)
+{
+	m_SpinLock.Acquire ();
+
+	m_nWaitingWriters++;
+
+	while (   m_bWriter
+	       || m_nReaders > 0)
+	{
+		m_WriteEvent.Clear ();
+
+		m_SpinLock.Release ();
+
+		m_WriteEvent.Wait ();
+
+		m_SpinLock.Acquire ();
+	}
+
+	assert (m_nWaitingWriters > 0);
+	m_nWaitingWriters--;
+
+	m_bWriter = TRUE;
+
+	m_SpinLock.Release ();
+}
+
+boolean CRWLock::TryAcquireWrite (void)
+{
+	m_SpinLock.Acquire ();
+
+	if (   m_bWriter
+	    || m_nReaders > 0)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_bWriter = TRUE;
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CRWLock::ReleaseWrite (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_bWriter);
+	m_bWriter = FALSE;
+
+	// wake the next writer, or all readers, if no writer is waiting
+	if (m_nWaitingWriters > 0)
+	{
+		m_WriteEvent.Set ();
+	}
+	else
+	{
+		m_ReadEvent.Set ();
+	}
+
+	m_SpinLock.Release ();
+}
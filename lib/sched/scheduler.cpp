@@ -2,7 +2,7 @@
 // scheduler.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,29 +19,80 @@
 //
 #include <circle/sched/scheduler.h>
 #include <circle/timer.h>
+#include <circle/tracer.h>
+#include <circle/latencymonitor.h>
+#include <circle/interrupt.h>
+#include <circle/synchronize.h>
 #include <circle/logger.h>
 #include <circle/string.h>
 #include <circle/util.h>
 #include <assert.h>
 
+#define IDLE_NO_DEADLINE	((unsigned) -1)
+#define IDLE_WAIT_MIN_US	50		// poll for shorter delays
+#define PREEMPT_RETRY_US	1000		// when the current task cannot be preempted
+
 static const char FromScheduler[] = "sched";
 
+#ifndef ARM_ALLOW_MULTI_CORE
 CScheduler *CScheduler::s_pThis = 0;
+#else
+CScheduler *CScheduler::s_pThis[CORES] = {0};
+#endif
+
+CSpinLock CScheduler::s_WaitListSpinLock;
 
 CScheduler::CScheduler (void)
-:	m_nTasks (0),
+:	m_pTask (0),
+	m_nTasks (0),
+	m_nTableSize (MAX_TASKS),
 	m_pCurrent (0),
+#ifndef USE_SCHEDULER_READY_QUEUE
 	m_nCurrent (0),
+#endif
 	m_pTaskSwitchHandler (0),
 	m_pTaskTerminationHandler (0),
-	m_iSuspendNewTasks (0)
+	m_iSuspendNewTasks (0),
+	m_nIdleTicks (0)
+#ifdef USE_TICKLESS_TIMER
+	, m_hIdleTimer (0)
+#endif
+#ifdef USE_SCHEDULER_PREEMPTION
+	, m_bSwitching (FALSE),
+	m_nSliceEnd (0),
+	m_bSliceTimerPending (FALSE)
+#endif
 {
+#ifndef ARM_ALLOW_MULTI_CORE
 	assert (s_pThis == 0);
 	s_pThis = this;
+#else
+	m_nCore = CMultiCoreSupport::ThisCore ();
+	assert (s_pThis[m_nCore] == 0);
+	s_pThis[m_nCore] = this;
+#endif
+
+	m_pTask = new CTask *[m_nTableSize];
+	assert (m_pTask != 0);
+
+#ifdef USE_SCHEDULER_READY_QUEUE
+	for (unsigned i = 0; i < TASK_PRIORITY_LEVELS; i++)
+	{
+		m_ReadyQueue[i].pHead = m_ReadyQueue[i].pTail = 0;
+	}
+	m_nReadyMask = 0;
+
+	m_SleepQueue.pHead = m_SleepQueue.pTail = 0;
+	m_TerminatedQueue.pHead = m_TerminatedQueue.pTail = 0;
+#endif
 
 	m_pCurrent = new CTask (0);		// main task currently running
 	assert (m_pCurrent != 0);
 	m_pCurrent->SetName ("main");
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	CInterruptSystem::RegisterIRQReturnHandler (IRQReturnHandler);
+#endif
 }
 
 CScheduler::~CScheduler (void)
@@ -49,19 +100,66 @@ CScheduler::~CScheduler (void)
 	m_pTaskSwitchHandler = 0;
 	m_pTaskTerminationHandler = 0;
 
+#ifndef ARM_ALLOW_MULTI_CORE
 	s_pThis = 0;
+#else
+	s_pThis[m_nCore] = 0;
+#endif
+
+	delete [] m_pTask;
+	m_pTask = 0;
+}
+
+inline void CScheduler::MarkReady (CTask *pTask, unsigned nTicks, unsigned nSource)
+{
+#ifdef LATENCY_MONITOR
+	if (CLatencyMonitor::IsActive ())
+	{
+		pTask->SetReadyTicks (nTicks, nSource);
+	}
+#endif
+}
+
+inline void CScheduler::RecordLatency (CTask *pTask)
+{
+#ifdef LATENCY_MONITOR
+	if (pTask->m_nReadySource != LatencySourceUnknown)
+	{
+		unsigned nDelay = CTimer::GetClockTicks () - pTask->m_nReadyTicks;
+
+		CLatencyMonitor::Record ((TLatencySource) pTask->m_nReadySource,
+					 nDelay < 4000000U ? nDelay * (1000000000U / CLOCKHZ) : -1U);
+
+		pTask->m_nReadySource = LatencySourceUnknown;
+	}
+#endif
 }
 
+#ifndef USE_SCHEDULER_READY_QUEUE
+
 void CScheduler::Yield (void)
 {
-	while ((m_nCurrent = GetNextTask ()) == MAX_TASKS)	// no task is ready
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (CMultiCoreSupport::ThisCore () == m_nCore);
+#endif
+
+	CTask *pNext = GetNextTask ();
+	if (pNext == 0)				// no task is ready
 	{
-		assert (m_nTasks > 0);
+		unsigned nIdleStart = CTimer::GetClockTicks ();
+
+		while ((pNext = GetNextTask ()) == 0)
+		{
+			assert (m_nTasks > 0);
+
+			WaitForWork (GetIdleDelay ());
+		}
+
+		m_nIdleTicks += CTimer::GetClockTicks () - nIdleStart;
 	}
 
-	assert (m_nCurrent < MAX_TASKS);
-	CTask *pNext = m_pTask[m_nCurrent];
-	assert (pNext != 0);
+	RecordLatency (pNext);
+
 	if (m_pCurrent == pNext)
 	{
 		return;
@@ -76,11 +174,276 @@ void CScheduler::Yield (void)
 		(*m_pTaskSwitchHandler) (m_pCurrent);
 	}
 
+	TRACE_TASK_SWITCH (m_pCurrent->GetName ());
+
+	assert (pOldRegs != 0);
+	assert (pNewRegs != 0);
+	TaskSwitch (pOldRegs, pNewRegs);
+}
+
+#else
+
+void CScheduler::Yield (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	assert (CMultiCoreSupport::ThisCore () == m_nCore);
+#endif
+
+	ReapTerminatedTasks ();
+
+	m_SpinLock.Acquire ();
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	m_bSwitching = TRUE;
+#endif
+
+	ParkCurrentTask ();
+
+	CTask *pNext = GetNextTask ();
+	if (pNext == 0)				// no task is ready
+	{
+		unsigned nIdleStart = CTimer::GetClockTicks ();
+
+		do
+		{
+			assert (m_nTasks > 0);
+
+			unsigned nDelay = GetIdleDelay ();
+
+			m_SpinLock.Release ();	// allow interrupts to wake tasks
+
+			WaitForWork (nDelay);
+
+			m_SpinLock.Acquire ();
+		}
+		while ((pNext = GetNextTask ()) == 0);
+
+		m_nIdleTicks += CTimer::GetClockTicks () - nIdleStart;
+	}
+
+	RecordLatency (pNext);
+
+	if (m_pCurrent == pNext)
+	{
+		m_SpinLock.Release ();
+
+#ifdef USE_SCHEDULER_PREEMPTION
+		StartTimeSlice (pNext);
+
+		m_bSwitching = FALSE;
+#endif
+
+		return;
+	}
+
+	TTaskRegisters *pOldRegs = m_pCurrent->GetRegs ();
+	m_pCurrent = pNext;
+	TTaskRegisters *pNewRegs = m_pCurrent->GetRegs ();
+
+	m_SpinLock.Release ();
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	StartTimeSlice (pNext);
+#endif
+
+	if (m_pTaskSwitchHandler != 0)
+	{
+		(*m_pTaskSwitchHandler) (m_pCurrent);
+	}
+
+	TRACE_TASK_SWITCH (m_pCurrent->GetName ());
+
+	assert (pOldRegs != 0);
+	assert (pNewRegs != 0);
+	TaskSwitch (pOldRegs, pNewRegs);
+
+#ifdef USE_SCHEDULER_PREEMPTION
+	SwitchedIn ();
+#endif
+}
+
+#endif
+
+#ifdef USE_SCHEDULER_PREEMPTION
+
+void CScheduler::DisablePreemption (void)
+{
+	if (!IsActive ())
+	{
+		return;
+	}
+
+	CTask *pTask = Get ()->m_pCurrent;
+	assert (pTask != 0);
+	pTask->m_nPreemptDisable++;
+}
+
+void CScheduler::EnablePreemption (void)
+{
+	if (!IsActive ())
+	{
+		return;
+	}
+
+	CScheduler *pThis = Get ();
+	CTask *pTask = pThis->m_pCurrent;
+	assert (pTask != 0);
+	assert (pTask->m_nPreemptDisable > 0);
+
+	// a preemption, which has been deferred, is done now
+	if (   --pTask->m_nPreemptDisable == 0
+	    && pTask->GetTimeSlice () != 0
+	    && (int) (CTimer::GetClockTicks () - pThis->m_nSliceEnd) >= 0)
+	{
+		pThis->Yield ();
+	}
+}
+
+void CScheduler::IRQReturnHandler (void)
+{
+	if (IsActive ())
+	{
+		Get ()->Preempt ();
+	}
+}
+
+// Runs on the stack of the interrupted task with IRQs disabled. When the task is switched out
+// here, its context remains in the IRQ stack frame below, until it is switched in again.
+void CScheduler::Preempt (void)
+{
+	CTask *pTask = m_pCurrent;
+	if (   pTask == 0
+	    || pTask->GetTimeSlice () == 0
+	    || m_bSwitching)
+	{
+		return;
+	}
+
+	// the task may also not have called Yield() yet, after changing its state
+	if (   pTask->m_nPreemptDisable != 0
+	    || pTask->GetState () != TaskStateReady
+	    || CSpinLock::IsTaskLevelLockHeld ())
+	{
+		StartTimeSliceTimer (PREEMPT_RETRY_US);
+
+		return;
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks ();
+	boolean bSliceElapsed = (int) (nTicks - m_nSliceEnd) >= 0;
+
+	m_SpinLock.Acquire ();
+
+	WakeSleepingTasks ();
+
+	// ready tasks with the same or a higher priority, than the current task
+	u32 nReadyMask = m_nReadyMask >> pTask->GetPriority ();
+	if (   nReadyMask <= 1
+	    && (   !bSliceElapsed
+		|| nReadyMask == 0))
+	{
+		m_SpinLock.Release ();
+
+		if (bSliceElapsed)
+		{
+			StartTimeSlice (pTask);			// nothing else to run
+		}
+		else
+		{
+			StartTimeSliceTimer ((m_nSliceEnd - nTicks) / (CLOCKHZ / 1000000));
+		}
+
+		return;
+	}
+
+	m_bSwitching = TRUE;
+
+	ParkCurrentTask ();				// append to the ready queue
+
+	CTask *pNext = GetNextTask ();
+	assert (pNext != 0);
+	assert (pNext != pTask);
+
+	RecordLatency (pNext);
+
+	TTaskRegisters *pOldRegs = pTask->GetRegs ();
+	m_pCurrent = pNext;
+	TTaskRegisters *pNewRegs = pNext->GetRegs ();
+
+	m_SpinLock.Release ();
+
+	StartTimeSlice (pNext);
+
+	if (m_pTaskSwitchHandler != 0)
+	{
+		(*m_pTaskSwitchHandler) (pNext);
+	}
+
+	TRACE_TASK_SWITCH (pNext->GetName ());
+
 	assert (pOldRegs != 0);
 	assert (pNewRegs != 0);
 	TaskSwitch (pOldRegs, pNewRegs);
+
+	// the switch back may have been done by a task, which runs with IRQs enabled
+	DisableIRQs ();
+
+	m_bSwitching = FALSE;
+}
+
+void CScheduler::SwitchedIn (void)
+{
+	m_bSwitching = FALSE;
+
+	// the switch may have been done by Preempt(), which runs with IRQs disabled
+	EnableIRQs ();
+}
+
+void CScheduler::StartTimeSlice (CTask *pTask)
+{
+	assert (pTask != 0);
+	unsigned nTimeSlice = pTask->GetTimeSlice ();
+	if (nTimeSlice == 0)
+	{
+		return;
+	}
+
+	m_nSliceEnd = CTimer::GetClockTicks () + nTimeSlice * (CLOCKHZ / 1000000);
+
+	StartTimeSliceTimer (nTimeSlice);
+}
+
+void CScheduler::StartTimeSliceTimer (unsigned nMicroSeconds)
+{
+	// a pending timer, which elapses too early, is started again from Preempt()
+	if (m_bSliceTimerPending)
+	{
+		return;
+	}
+
+	m_bSliceTimerPending = TRUE;
+
+	CTimer::Get ()->StartKernelTimerUs (nMicroSeconds, TimeSliceHandler, 0, this);
+}
+
+void CScheduler::TimeSliceHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CScheduler *pThis = (CScheduler *) pContext;
+	assert (pThis != 0);
+
+	pThis->m_bSliceTimerPending = FALSE;
+
+	// Preempt() is called on return from this IRQ, on the core of the scheduler only
+#ifdef ARM_ALLOW_MULTI_CORE
+	if (pThis->m_nCore != CMultiCoreSupport::ThisCore ())
+	{
+		CMultiCoreSupport::SendIPI (pThis->m_nCore, IPI_WAKE_CORE);
+	}
+#endif
 }
 
+#endif
+
 void CScheduler::Sleep (unsigned nSeconds)
 {
 	// be sure the clock does not run over taken as signed int
@@ -129,6 +492,10 @@ CTask *CScheduler::GetTask (const char *pTaskName)
 {
 	assert (pTaskName != 0);
 
+	CTask *pResult = 0;
+
+	m_SpinLock.Acquire ();
+
 	for (unsigned i = 0; i < m_nTasks; i++)
 	{
 		CTask *pTask = m_pTask[i];
@@ -136,23 +503,37 @@ CTask *CScheduler::GetTask (const char *pTaskName)
 		if (   pTask != 0
 		    && strcmp (pTask->GetName (), pTaskName) == 0)
 		{
-			return pTask;
+			pResult = pTask;
+
+			break;
 		}
 	}
 
-	return 0;
+	m_SpinLock.Release ();
+
+	return pResult;
 }
 
 boolean CScheduler::IsValidTask (CTask *pTask)
 {
+	boolean bResult = FALSE;
+
+	m_SpinLock.Acquire ();
+
 	unsigned i;
 	for (i = 0; i < m_nTasks; i++)
 	{
 		if (m_pTask[i] != 0 && m_pTask[i] == pTask)
-			return TRUE;
+		{
+			bResult = TRUE;
+
+			break;
+		}
 	}
 
-	return FALSE;
+	m_SpinLock.Release ();
+
+	return bResult;
 }
 
 void CScheduler::RegisterTaskSwitchHandler (TSchedulerTaskHandler *pHandler)
@@ -184,9 +565,10 @@ void CScheduler::ResumeNewTasks (void)
 		unsigned i;
 		for (i = 0; i < m_nTasks; i++)
 		{
-			if (m_pTask[i] != 0 && m_pTask[i]->GetState() == TaskStateNew)
+			CTask *pTask = GetTaskEntry (i);
+			if (pTask != 0 && pTask->GetState() == TaskStateNew)
 			{
-				m_pTask[i]->Start();
+				pTask->Start();
 			}
 		}
 
@@ -200,7 +582,7 @@ boolean CScheduler::EnumerateTasks (boolean (*pCallback) (CTask *pTask, const ch
 {
 	for (unsigned i = 0; i < m_nTasks; i++)
 	{
-		CTask *pTask = m_pTask[i];
+		CTask *pTask = GetTaskEntry (i);
 		if (pTask == 0)
 		{
 			continue;
@@ -229,12 +611,12 @@ void CScheduler::ListTasks (CDevice *pTarget)
 {
 	assert (pTarget != 0);
 
-	static const char Header[] = "#  ADDR     STAT  FL NAME\n";
+	static const char Header[] = "#  ADDR     STAT  FL PR NAME\n";
 	pTarget->Write (Header, sizeof Header-1);
 
 	for (unsigned i = 0; i < m_nTasks; i++)
 	{
-		CTask *pTask = m_pTask[i];
+		CTask *pTask = GetTaskEntry (i);
 		if (pTask == 0)
 		{
 			continue;
@@ -248,11 +630,12 @@ void CScheduler::ListTasks (CDevice *pTarget)
 			{"new", "ready", "block", "block", "sleep", "term"};
 
 		CString Line;
-		Line.Format ("%02u %08lX %-5s %c%c %s\n",
+		Line.Format ("%02u %08lX %-5s %c%c %2u %s\n",
 			     i, (uintptr) pTask,
 			     pTask == m_pCurrent ? "run" : StateNames[State],
 			     pTask->IsSuspended () ? 'S' : ' ',
 			     State == TaskStateBlockedWithTimeout ? 'T' : ' ',
+			     pTask->GetPriority (),
 			     pTask->GetName ());
 
 		pTarget->Write (Line, Line.GetLength ());
@@ -268,57 +651,136 @@ void CScheduler::AddTask (CTask *pTask)
 		pTask->SetState(TaskStateNew);
 	}
 
+	m_SpinLock.Acquire ();
+
 	unsigned i;
 	for (i = 0; i < m_nTasks; i++)
 	{
 		if (m_pTask[i] == 0)
 		{
-			m_pTask[i] = pTask;
-
-			return;
+			break;
 		}
 	}
 
-	if (m_nTasks >= MAX_TASKS)
+	CTask **pOldTable = 0;
+	while (i >= m_nTableSize)
 	{
-		CLogger::Get ()->Write (FromScheduler, LogPanic, "System limit of tasks exceeded");
-	}
+		// grow the task table, the heap must not be used with m_SpinLock acquired
+		unsigned nNewTableSize = m_nTableSize + MAX_TASKS;
 
-	m_pTask[m_nTasks++] = pTask;
-}
+		m_SpinLock.Release ();
 
-void CScheduler::RemoveTask (CTask *pTask)
-{
-	for (unsigned i = 0; i < m_nTasks; i++)
-	{
-		if (m_pTask[i] == pTask)
+		CTask **pNewTable = new CTask *[nNewTableSize];
+		if (pNewTable == 0)
 		{
-			m_pTask[i] = 0;
+			CLogger::Get ()->Write (FromScheduler, LogPanic, "Cannot grow task table");
+		}
+		assert (pNewTable != 0);
 
-			if (i == m_nTasks-1)
+		m_SpinLock.Acquire ();
+
+		// another task may have grown the table or freed an entry meanwhile
+		for (i = 0; i < m_nTasks; i++)
+		{
+			if (m_pTask[i] == 0)
 			{
-				m_nTasks--;
+				break;
 			}
-
-			return;
 		}
-	}
 
-	assert (0);
-}
+		if (   i < m_nTableSize
+		    || nNewTableSize <= m_nTableSize)
+		{
+			m_SpinLock.Release ();
 
-boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
-{
-	assert (ppWaitListHead != 0);
-	assert (m_pCurrent->m_pWaitListNext == 0);
-	assert (m_pCurrent != 0);
-	assert (m_pCurrent->GetState () == TaskStateReady);
+			delete [] pNewTable;
 
-	m_SpinLock.Acquire ();
+			m_SpinLock.Acquire ();
 
-	// Add current task to waiting task list
-	m_pCurrent->m_pWaitListNext = *ppWaitListHead;
-	*ppWaitListHead = m_pCurrent;
+			continue;
+		}
+
+		memcpy (pNewTable, m_pTask, m_nTableSize * sizeof (CTask *));
+
+		assert (pOldTable == 0);
+		pOldTable = m_pTask;
+		m_pTask = pNewTable;
+
+		m_nTableSize = nNewTableSize;
+	}
+
+	m_pTask[i] = pTask;
+	if (i == m_nTasks)
+	{
+		m_nTasks++;
+	}
+
+#ifdef USE_SCHEDULER_READY_QUEUE
+	// the main task is created, while m_pCurrent is not set yet, it is running already
+	if (   m_pCurrent != 0
+	    && pTask->GetState () == TaskStateReady)
+	{
+		EnqueueReady (pTask);
+	}
+#endif
+
+	m_SpinLock.Release ();
+
+	// all readers of the task table hold m_SpinLock, none can access it any more
+	delete [] pOldTable;
+
+	SignalWork ();			// the task may belong to a waiting core
+}
+
+CTask *CScheduler::GetTaskEntry (unsigned nIndex)
+{
+	m_SpinLock.Acquire ();
+
+	CTask *pTask = nIndex < m_nTasks ? m_pTask[nIndex] : 0;
+
+	m_SpinLock.Release ();
+
+	return pTask;
+}
+
+void CScheduler::RemoveTask (CTask *pTask)
+{
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < m_nTasks; i++)
+	{
+		if (m_pTask[i] == pTask)
+		{
+			m_pTask[i] = 0;
+
+			if (i == m_nTasks-1)
+			{
+				m_nTasks--;
+			}
+
+			m_SpinLock.Release ();
+
+			return;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	assert (0);
+}
+
+boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
+{
+	assert (ppWaitListHead != 0);
+	assert (m_pCurrent->m_pWaitListNext == 0);
+	assert (m_pCurrent != 0);
+	assert (m_pCurrent->GetState () == TaskStateReady);
+
+	s_WaitListSpinLock.Acquire ();
+
+	// Add current task to waiting task list
+	m_pCurrent->m_pWaitListNext = *ppWaitListHead;
+	*ppWaitListHead = m_pCurrent;
 
 	if (nMicroSeconds == 0)
 	{
@@ -333,11 +795,11 @@ boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
 		m_pCurrent->SetState (TaskStateBlockedWithTimeout);
 	}
 	
-	m_SpinLock.Release ();
+	s_WaitListSpinLock.Release ();
 
 	Yield ();
 
-	m_SpinLock.Acquire ();
+	s_WaitListSpinLock.Acquire ();
 
 	// Remove this task from the wait list in case was woken by timeout and
 	// not by the event signalling (in which case the list will already be 
@@ -358,7 +820,7 @@ boolean CScheduler::BlockTask (CTask **ppWaitListHead, unsigned nMicroSeconds)
 	}
 	m_pCurrent->m_pWaitListNext = nullptr;
 
-	m_SpinLock.Release ();
+	s_WaitListSpinLock.Release ();
 
 	// GetWakeTicks Will be zero if timeout expired, non-zero if event signalled
 	return m_pCurrent->GetWakeTicks() == 0;		
@@ -368,11 +830,15 @@ void CScheduler::WakeTasks (CTask **ppWaitListHead)
 {
 	assert (ppWaitListHead != 0);
 
-	m_SpinLock.Acquire ();
+	s_WaitListSpinLock.Acquire ();
 
 	CTask *pTask = *ppWaitListHead;
 	*ppWaitListHead = 0;
 
+#ifdef LATENCY_MONITOR
+	unsigned nTicks = pTask != 0 && CLatencyMonitor::IsActive () ? CTimer::GetClockTicks () : 0;
+#endif
+
 	while (pTask)
 	{
 #ifdef NDEBUG
@@ -388,22 +854,107 @@ void CScheduler::WakeTasks (CTask **ppWaitListHead)
 		        || pTask->GetState () == TaskStateBlockedWithTimeout);
 #endif
 
+#ifdef LATENCY_MONITOR
+		MarkReady (pTask, nTicks, LatencyTaskWakeup);
+#endif
+
+#ifndef USE_SCHEDULER_READY_QUEUE
 		pTask->SetState (TaskStateReady);
+#else
+		// the task may belong to the scheduler of another core
+		CScheduler *pScheduler = pTask->m_pScheduler;
+		assert (pScheduler != 0);
+
+		pScheduler->m_SpinLock.Acquire ();
+
+		pScheduler->MakeReady (pTask);
+
+		pScheduler->m_SpinLock.Release ();
+#endif
 
 		CTask* pNext = pTask->m_pWaitListNext;
 		pTask->m_pWaitListNext = 0;
 		pTask = pNext;
 	}
 
-	m_SpinLock.Release ();
+	s_WaitListSpinLock.Release ();
+
+	SignalWork ();
 }
 
-unsigned CScheduler::GetNextTask (void)
+void CScheduler::WaitForWork (unsigned nDelay)
 {
-	unsigned nTask = m_nCurrent < MAX_TASKS ? m_nCurrent : 0;
+	// there is no WFE on the Raspberry Pi 1, it polls for the next ready task
+#if !defined (NO_SCHEDULER_IDLE_WAIT) && RASPPI != 1
+#ifndef USE_TICKLESS_TIMER
+	// we are woken on the next timer tick at the latest, which may be too late
+	if (nDelay < 1000000 / HZ)
+	{
+		return;
+	}
+#else
+	if (nDelay < IDLE_WAIT_MIN_US)
+	{
+		return;
+	}
+
+	if (nDelay != IDLE_NO_DEADLINE)
+	{
+		m_hIdleTimer = CTimer::Get ()->StartKernelTimerUs (nDelay, IdleTimerHandler, 0, this);
+	}
+#endif
 
+	// woken by SignalWork(), by an interrupt or by the timer tick (see CTimer)
+	WaitForEvent ();
+
+#ifdef USE_TICKLESS_TIMER
+	if (m_hIdleTimer != 0)
+	{
+		// the handle is still safe to use, if the timer has elapsed already
+		CTimer::Get ()->CancelKernelTimer (m_hIdleTimer);
+		m_hIdleTimer = 0;
+	}
+#endif
+#endif
+}
+
+void CScheduler::SignalWork (void)
+{
+#if !defined (NO_SCHEDULER_IDLE_WAIT) && RASPPI != 1
+	DataSyncBarrier ();
+	SendEvent ();
+#endif
+}
+
+#ifdef USE_TICKLESS_TIMER
+
+void CScheduler::IdleTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+#if RASPPI != 1
+	SendEvent ();
+#endif
+}
+
+#endif
+
+#ifndef USE_SCHEDULER_READY_QUEUE
+
+CTask *CScheduler::GetNextTask (void)
+{
 	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
 
+#ifdef ARM_ALLOW_MULTI_CORE
+	// the task table may be modified from another core
+	m_SpinLock.Acquire ();
+#endif
+
+	unsigned nTask = m_nCurrent < m_nTasks ? m_nCurrent : 0;
+
+	// the first ready task with the highest priority after the current one will be selected
+	CTask *pNextTask = 0;
+	unsigned nNextTask = 0;
+	unsigned nNextPriority = 0;
+
 	for (unsigned i = 1; i <= m_nTasks; i++)
 	{
 		if (++nTask >= m_nTasks)
@@ -425,7 +976,7 @@ unsigned CScheduler::GetNextTask (void)
 		switch (pTask->GetState ())
 		{
 		case TaskStateReady:
-			return nTask;
+			break;
 
 		case TaskStateBlocked:
 		case TaskStateNew:
@@ -436,9 +987,10 @@ unsigned CScheduler::GetNextTask (void)
 			{
 				continue;
 			}
+			MarkReady (pTask, pTask->GetWakeTicks (), LatencyDispatch);
 			pTask->SetState (TaskStateReady);
 			pTask->SetWakeTicks(0);		// Use as flag that timeout expired
-			return nTask;
+			break;
 
 
 		case TaskStateSleeping:
@@ -446,29 +998,447 @@ unsigned CScheduler::GetNextTask (void)
 			{
 				continue;
 			}
+			MarkReady (pTask, pTask->GetWakeTicks (), LatencyDispatch);
 			pTask->SetState (TaskStateReady);
-			return nTask;
+			break;
 
 		case TaskStateTerminated:
+#ifdef ARM_ALLOW_MULTI_CORE
+			m_SpinLock.Release ();
+#endif
 			if (m_pTaskTerminationHandler != 0)
 			{
 				(*m_pTaskTerminationHandler) (pTask);
 			}
 			RemoveTask (pTask);
 			delete pTask;
-			return MAX_TASKS;
+			return 0;
 
 		default:
 			assert (0);
+			continue;
+		}
+
+		unsigned nPriority = pTask->GetPriority ();
+		if (   pNextTask == 0
+		    || nPriority > nNextPriority)
+		{
+			pNextTask = pTask;
+			nNextTask = nTask;
+			nNextPriority = nPriority;
+
+			if (nPriority == TASK_PRIORITY_HIGHEST)
+			{
+				break;
+			}
+		}
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_SpinLock.Release ();
+#endif
+
+	if (pNextTask != 0)
+	{
+		m_nCurrent = nNextTask;
+	}
+
+	return pNextTask;
+}
+
+unsigned CScheduler::GetIdleDelay (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	unsigned nDelay = IDLE_NO_DEADLINE;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_SpinLock.Acquire ();
+#endif
+
+	for (unsigned i = 0; i < m_nTasks && nDelay > 0; i++)
+	{
+		CTask *pTask = m_pTask[i];
+		if (   pTask == 0
+		    || pTask->IsSuspended ())
+		{
+			continue;
+		}
+
+		switch (pTask->GetState ())
+		{
+		case TaskStateReady:
+		case TaskStateTerminated:
+			nDelay = 0;		// GetNextTask() has to be called again
+			break;
+
+		case TaskStateBlockedWithTimeout:
+		case TaskStateSleeping: {
+				int nLeft = (int) (pTask->GetWakeTicks () - nTicks);
+				if (nLeft <= 0)
+				{
+					nDelay = 0;
+				}
+				else if ((unsigned) nLeft / (CLOCKHZ / 1000000) < nDelay)
+				{
+					nDelay = (unsigned) nLeft / (CLOCKHZ / 1000000);
+				}
+			} break;
+
+		default:
 			break;
 		}
 	}
 
-	return MAX_TASKS;
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_SpinLock.Release ();
+#endif
+
+	return nDelay;
+}
+
+#else
+
+void CScheduler::ResumeTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (   pTask->GetState () == TaskStateReady
+	    && !pTask->IsSuspended ()
+	    && pTask->m_pQueue == 0)
+	{
+		EnqueueReady (pTask);
+	}
+
+	m_SpinLock.Release ();
+}
+
+unsigned CScheduler::GetIdleDelay (void)
+{
+	// must be called with m_SpinLock acquired
+	CTask *pTask = m_SleepQueue.pHead;
+	if (pTask == 0)
+	{
+		return IDLE_NO_DEADLINE;
+	}
+
+	int nLeft = (int) (pTask->GetWakeTicks () - CTimer::GetClockTicks ());
+	if (nLeft <= 0)
+	{
+		return 0;
+	}
+
+	return (unsigned) nLeft / (CLOCKHZ / 1000000);
+}
+
+void CScheduler::SuspendTask (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	m_SpinLock.Acquire ();
+
+	// a sleeping task remains in the sleep queue, but does not get ready on wake-up
+	if (IsReadyQueue (pTask->m_pQueue))
+	{
+		Dequeue (pTask);
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CScheduler::SetTaskPriority (CTask *pTask, unsigned nPriority)
+{
+	assert (pTask != 0);
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+
+	m_SpinLock.Acquire ();
+
+	if (IsReadyQueue (pTask->m_pQueue))
+	{
+		Dequeue (pTask);
+
+		pTask->m_nPriority = nPriority;
+
+		EnqueueReady (pTask);
+	}
+	else
+	{
+		pTask->m_nPriority = nPriority;
+	}
+
+	m_SpinLock.Release ();
+}
+
+CTask *CScheduler::GetNextTask (void)
+{
+	WakeSleepingTasks ();
+
+	if (m_nReadyMask == 0)
+	{
+		return 0;
+	}
+
+	// highest priority first
+	unsigned nPriority = 31 - __builtin_clz (m_nReadyMask);
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+
+	CTask *pTask = m_ReadyQueue[nPriority].pHead;
+	assert (pTask != 0);
+	Dequeue (pTask);
+
+	assert (pTask->GetState () == TaskStateReady);
+	assert (!pTask->IsSuspended ());
+
+	return pTask;
+}
+
+void CScheduler::ParkCurrentTask (void)
+{
+	CTask *pTask = m_pCurrent;
+	assert (pTask != 0);
+
+	// the current task may have been made ready already, while it was running
+	if (pTask->m_pQueue != 0)
+	{
+		Dequeue (pTask);
+	}
+
+	switch (pTask->GetState ())
+	{
+	case TaskStateReady:
+		if (!pTask->IsSuspended ())
+		{
+			EnqueueReady (pTask);
+		}
+		break;
+
+	case TaskStateBlocked:
+		break;
+
+	case TaskStateBlockedWithTimeout:
+	case TaskStateSleeping:
+		InsertSleeping (pTask);
+		break;
+
+	case TaskStateTerminated:
+		Enqueue (&m_TerminatedQueue, pTask);
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CScheduler::WakeSleepingTasks (void)
+{
+	CTask *pTask = m_SleepQueue.pHead;
+	if (pTask == 0)
+	{
+		return;
+	}
+
+	unsigned nTicks = CTimer::Get ()->GetClockTicks ();
+
+	while (   pTask != 0
+	       && (int) (pTask->GetWakeTicks () - nTicks) <= 0)
+	{
+		Dequeue (pTask);
+
+		MarkReady (pTask, pTask->GetWakeTicks (), LatencyDispatch);
+
+		if (pTask->GetState () == TaskStateBlockedWithTimeout)
+		{
+			pTask->SetWakeTicks (0);	// Use as flag that timeout expired
+		}
+		else
+		{
+			assert (pTask->GetState () == TaskStateSleeping);
+		}
+
+		pTask->SetState (TaskStateReady);
+
+		if (!pTask->IsSuspended ())
+		{
+			EnqueueReady (pTask);
+		}
+
+		pTask = m_SleepQueue.pHead;
+	}
 }
 
+void CScheduler::MakeReady (CTask *pTask)
+{
+	assert (pTask != 0);
+
+	pTask->SetState (TaskStateReady);
+
+	if (pTask->m_pQueue == &m_SleepQueue)
+	{
+		Dequeue (pTask);
+	}
+
+	if (   !pTask->IsSuspended ()
+	    && pTask->m_pQueue == 0)
+	{
+		EnqueueReady (pTask);
+	}
+}
+
+void CScheduler::InsertSleeping (CTask *pTask)
+{
+	assert (pTask != 0);
+	assert (pTask->m_pQueue == 0);
+
+	// search from the tail, because new entries do normally expire last
+	CTask *pPrev = m_SleepQueue.pTail;
+	while (   pPrev != 0
+	       && (int) (pPrev->GetWakeTicks () - pTask->GetWakeTicks ()) > 0)
+	{
+		pPrev = pPrev->m_pQueuePrev;
+	}
+
+	pTask->m_pQueuePrev = pPrev;
+	if (pPrev != 0)
+	{
+		pTask->m_pQueueNext = pPrev->m_pQueueNext;
+		pPrev->m_pQueueNext = pTask;
+	}
+	else
+	{
+		pTask->m_pQueueNext = m_SleepQueue.pHead;
+		m_SleepQueue.pHead = pTask;
+	}
+
+	if (pTask->m_pQueueNext != 0)
+	{
+		pTask->m_pQueueNext->m_pQueuePrev = pTask;
+	}
+	else
+	{
+		m_SleepQueue.pTail = pTask;
+	}
+
+	pTask->m_pQueue = &m_SleepQueue;
+}
+
+void CScheduler::ReapTerminatedTasks (void)
+{
+	while (m_TerminatedQueue.pHead != 0)
+	{
+		m_SpinLock.Acquire ();
+
+		CTask *pTask = m_TerminatedQueue.pHead;
+		assert (pTask != 0);
+		assert (pTask != m_pCurrent);
+		Dequeue (pTask);
+
+		m_SpinLock.Release ();
+
+		assert (pTask->GetState () == TaskStateTerminated);
+		if (m_pTaskTerminationHandler != 0)
+		{
+			(*m_pTaskTerminationHandler) (pTask);
+		}
+
+		RemoveTask (pTask);
+		delete pTask;
+	}
+}
+
+void CScheduler::EnqueueReady (CTask *pTask)
+{
+	assert (pTask != 0);
+	unsigned nPriority = pTask->GetPriority ();
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+
+	Enqueue (&m_ReadyQueue[nPriority], pTask);
+
+	m_nReadyMask |= 1U << nPriority;
+}
+
+boolean CScheduler::IsReadyQueue (const TTaskQueue *pQueue) const
+{
+	return    pQueue >= &m_ReadyQueue[0]
+	       && pQueue < &m_ReadyQueue[TASK_PRIORITY_LEVELS];
+}
+
+void CScheduler::Enqueue (TTaskQueue *pQueue, CTask *pTask)
+{
+	assert (pQueue != 0);
+	assert (pTask != 0);
+	assert (pTask->m_pQueue == 0);
+
+	pTask->m_pQueueNext = 0;
+	pTask->m_pQueuePrev = pQueue->pTail;
+
+	if (pQueue->pTail != 0)
+	{
+		pQueue->pTail->m_pQueueNext = pTask;
+	}
+	else
+	{
+		pQueue->pHead = pTask;
+	}
+
+	pQueue->pTail = pTask;
+
+	pTask->m_pQueue = pQueue;
+}
+
+void CScheduler::Dequeue (CTask *pTask)
+{
+	assert (pTask != 0);
+	TTaskQueue *pQueue = pTask->m_pQueue;
+	assert (pQueue != 0);
+
+	if (pTask->m_pQueuePrev != 0)
+	{
+		pTask->m_pQueuePrev->m_pQueueNext = pTask->m_pQueueNext;
+	}
+	else
+	{
+		pQueue->pHead = pTask->m_pQueueNext;
+	}
+
+	if (pTask->m_pQueueNext != 0)
+	{
+		pTask->m_pQueueNext->m_pQueuePrev = pTask->m_pQueuePrev;
+	}
+	else
+	{
+		pQueue->pTail = pTask->m_pQueuePrev;
+	}
+
+	pTask->m_pQueuePrev = 0;
+	pTask->m_pQueueNext = 0;
+	pTask->m_pQueue = 0;
+
+	if (   pQueue->pHead == 0
+	    && IsReadyQueue (pQueue))
+	{
+		m_nReadyMask &= ~(1U << (pQueue - m_ReadyQueue));
+	}
+}
+
+#endif
+
+#ifndef ARM_ALLOW_MULTI_CORE
+
 CScheduler *CScheduler::Get (void)
 {
 	assert (s_pThis != 0);
 	return s_pThis;
 }
+
+#else
+
+CScheduler *CScheduler::Get (unsigned nCore)
+{
+	assert (nCore < CORES);
+	assert (s_pThis[nCore] != 0);
+	return s_pThis[nCore];
+}
+
+#endif
@@ -2,7 +2,7 @@
 // semaphore.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2021-2026  R. Stange <rsta2@o2online.de>
 //
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,6 +18,7 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sched/semaphore.h>
+#include <circle/sched/scheduler.h>
 #include <circle/atomic.h>
 #include <assert.h>
 
@@ -38,8 +39,12 @@ unsigned CSemaphore::GetState (void) const
 	return AtomicGet (&m_nCount);
 }
 
+// Down() and TryDown() must not be preempted between the check and the decrement.
+
 void CSemaphore::Down (void)
 {
+	CScheduler::DisablePreemption ();
+
 	while (AtomicGet (&m_nCount) == 0)
 	{
 		m_Event.Wait ();
@@ -50,6 +55,8 @@ void CSemaphore::Down (void)
 		assert (m_Event.GetState ());
 		m_Event.Clear ();
 	}
+
+	CScheduler::EnablePreemption ();
 }
 
 void CSemaphore::Up (void)
@@ -70,8 +77,12 @@ void CSemaphore::Up (void)
 
 boolean CSemaphore::TryDown (void)
 {
+	CScheduler::DisablePreemption ();
+
 	if (AtomicGet (&m_nCount) == 0)
 	{
+		CScheduler::EnablePreemption ();
+
 		return FALSE;
 	}
 
@@ -81,5 +92,7 @@ boolean CSemaphore::TryDown (void)
 		m_Event.Clear ();
 	}
 
+	CScheduler::EnablePreemption ();
+
 	return TRUE;
 }
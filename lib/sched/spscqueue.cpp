@@ -0,0 +1,79 @@
+//
+// spscqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/spscqueue.h>
+#include <assert.h>
+
+// The indices run freely and are masked on access to the buffer. The producer
+// publishes an entry with a release store of m_nTail, the consumer frees it with
+// a release store of m_nHead.
+
+CSPSCQueue::CSPSCQueue (unsigned nSize)
+:	m_nMask (nSize-1),
+	m_nHead (0),
+	m_nTail (0)
+{
+	assert (IS_POWEROF_2 (nSize));
+
+	m_ppBuffer = new void *[nSize];
+	assert (m_ppBuffer != 0);
+}
+
+CSPSCQueue::~CSPSCQueue (void)
+{
+	delete [] m_ppBuffer;
+	m_ppBuffer = 0;
+}
+
+boolean CSPSCQueue::IsEmpty (void) const
+{
+	return   __atomic_load_n (&m_nHead, __ATOMIC_RELAXED)
+	      == __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE);
+}
+
+boolean CSPSCQueue::Enqueue (void *pItem)
+{
+	unsigned nTail = __atomic_load_n (&m_nTail, __ATOMIC_RELAXED);
+	if (nTail - __atomic_load_n (&m_nHead, __ATOMIC_ACQUIRE) > m_nMask)
+	{
+		return FALSE;
+	}
+
+	m_ppBuffer[nTail & m_nMask] = pItem;
+
+	__atomic_store_n (&m_nTail, nTail+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
+
+boolean CSPSCQueue::Dequeue (void **ppItem)
+{
+	unsigned nHead = __atomic_load_n (&m_nHead, __ATOMIC_RELAXED);
+	if (nHead == __atomic_load_n (&m_nTail, __ATOMIC_ACQUIRE))
+	{
+		return FALSE;
+	}
+
+	assert (ppItem != 0);
+	*ppItem = m_ppBuffer[nHead & m_nMask];
+
+	__atomic_store_n (&m_nHead, nHead+1, __ATOMIC_RELEASE);
+
+	return TRUE;
+}
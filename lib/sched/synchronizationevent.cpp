@@ -2,7 +2,7 @@
 // synchronizationevent.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2015-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -18,21 +18,26 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sched/synchronizationevent.h>
+#include <circle/sched/asyncflow.h>
 #include <circle/sched/scheduler.h>
 #include <circle/sched/task.h>
 #include <circle/synchronize.h>
 #include <circle/sysconfig.h>
 #include <assert.h>
 
+CSpinLock CSynchronizationEvent::s_AsyncListSpinLock (IRQ_LEVEL);
+
 CSynchronizationEvent::CSynchronizationEvent (boolean bState)
 :	m_bState (bState),
-	m_pWaitListHead (0)
+	m_pWaitListHead (0),
+	m_pAsyncListHead (0)
 {
 }
 
 CSynchronizationEvent::~CSynchronizationEvent (void)
 {
 	assert (m_pWaitListHead == 0);
+	assert (m_pAsyncListHead == 0);
 }
 
 boolean CSynchronizationEvent::GetState (void) const
@@ -59,7 +64,9 @@ void CSynchronizationEvent::Set (void)
 		DataSyncBarrier ();
 #endif
 
-		CScheduler::Get ()->WakeTasks (&m_pWaitListHead);
+		CScheduler::WakeTasks (&m_pWaitListHead);
+
+		WakeAsyncFlows ();
 	}
 }
 
@@ -73,26 +80,89 @@ void CSynchronizationEvent::Pulse (void)
 	DataSyncBarrier ();
 #endif
 
-	CScheduler::Get ()->WakeTasks (&m_pWaitListHead);
+	CScheduler::WakeTasks (&m_pWaitListHead);
+
+	WakeAsyncFlows ();
 }
 
 
+// A preemptible task must not be preempted between the check and the block, otherwise
+// a Set() from another task in-between could be missed.
+
 void CSynchronizationEvent::Wait (void)
 {
+	CScheduler::DisablePreemption ();
+
 	if (!m_bState)
 	{
 		CScheduler::Get ()->BlockTask (&m_pWaitListHead, 0);
 	}
+
+	CScheduler::EnablePreemption ();
 }
 
 boolean CSynchronizationEvent::WaitWithTimeout (unsigned nMicroSeconds)
 {
+	CScheduler::DisablePreemption ();
+
+	boolean bResult;
 	if (m_bState)
 	{
-		return nMicroSeconds == 0;
+		bResult = nMicroSeconds == 0;
 	}
 	else
 	{
-		return CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds);
+		bResult = CScheduler::Get ()->BlockTask (&m_pWaitListHead, nMicroSeconds);
+	}
+
+	CScheduler::EnablePreemption ();
+
+	return bResult;
+}
+
+void CSynchronizationEvent::AddAsyncFlow (CAsyncFlow *pFlow)
+{
+	assert (pFlow != 0);
+	assert (pFlow->m_pWaitEvent == 0);
+
+	s_AsyncListSpinLock.Acquire ();
+
+	// the event may have been set in the meantime
+	if (m_bState)
+	{
+		s_AsyncListSpinLock.Release ();
+
+		pFlow->Complete (0);
+
+		return;
+	}
+
+	pFlow->m_pWaitEvent = this;
+	pFlow->m_pWaitListNext = m_pAsyncListHead;
+	m_pAsyncListHead = pFlow;
+
+	s_AsyncListSpinLock.Release ();
+}
+
+void CSynchronizationEvent::WakeAsyncFlows (void)
+{
+	s_AsyncListSpinLock.Acquire ();
+
+	CAsyncFlow *pFlow = m_pAsyncListHead;
+	m_pAsyncListHead = 0;
+
+	s_AsyncListSpinLock.Release ();
+
+	while (pFlow != 0)
+	{
+		CAsyncFlow *pNext = pFlow->m_pWaitListNext;
+
+		assert (pFlow->m_pWaitEvent == this);
+		pFlow->m_pWaitEvent = 0;
+		pFlow->m_pWaitListNext = 0;
+
+		pFlow->Complete (0);		// the flow may be freed now
+
+		pFlow = pNext;
 	}
 }
@@ -2,7 +2,7 @@
 // task.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2021  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -19,16 +19,34 @@
 //
 #include <circle/sched/task.h>
 #include <circle/sched/scheduler.h>
+#include <circle/sched/taskstackpool.h>
+#include <circle/latencymonitor.h>
+#include <circle/multicore.h>
 #include <circle/util.h>
 #include <assert.h>
 
-CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
+CTask::CTask (unsigned nStackSize, boolean bCreateSuspended, unsigned nPriority, unsigned nCore)
 :	m_State (bCreateSuspended ? TaskStateNew : TaskStateReady),
 	m_bSuspended (FALSE),
+	m_nPriority (nPriority),
+	m_nBasePriority (nPriority),
+	m_nInheritedPriority (TASK_PRIORITY_LOWEST),
+	m_pHeldMutexes (0),
+	m_nCore (0),
+	m_pScheduler (0),
+	m_nReadyTicks (0),
+	m_nReadySource (LatencySourceUnknown),
+	m_nTimeSlice (0),
+	m_nPreemptDisable (0),
 	m_nStackSize (nStackSize),
 	m_pStack (0),
-	m_pWaitListNext (0)
+	m_pWaitListNext (0),
+	m_pQueue (0),
+	m_pQueuePrev (0),
+	m_pQueueNext (0)
 {
+	assert (m_nPriority < TASK_PRIORITY_LEVELS);
+
 	for (unsigned i = 0; i < TASK_USER_DATA_SLOTS; i++)
 	{
 		m_pUserData[i] = 0;
@@ -42,7 +60,7 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 #else
 		assert ((m_nStackSize & 15) == 0);
 #endif
-		m_pStack = new u8[m_nStackSize];
+		m_pStack = CTaskStackPool::Allocate (m_nStackSize);
 		assert (m_pStack != 0);
 
 		InitializeRegs ();
@@ -50,7 +68,23 @@ CTask::CTask (unsigned nStackSize, boolean bCreateSuspended)
 
 	m_Name.Format ("@%lp", this);
 
-	CScheduler::Get ()->AddTask (this);
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned nThisCore = CMultiCoreSupport::ThisCore ();
+	m_nCore = nCore == TASK_CORE_CURRENT ? nThisCore : nCore;
+	assert (m_nCore < CORES);
+
+	// see the note in task.h
+	assert (m_nCore == nThisCore || bCreateSuspended);
+
+	m_pScheduler = CScheduler::Get (m_nCore);
+#else
+	assert (nCore == TASK_CORE_CURRENT || nCore == 0);
+
+	m_pScheduler = CScheduler::Get ();
+#endif
+	assert (m_pScheduler != 0);
+
+	m_pScheduler->AddTask (this);
 }
 
 CTask::~CTask (void)
@@ -58,7 +92,7 @@ CTask::~CTask (void)
 	assert (m_State == TaskStateTerminated);
 	m_State = TaskStateUnknown;
 
-	delete [] m_pStack;
+	CTaskStackPool::Free (m_pStack, m_nStackSize);
 	m_pStack = 0;
 }
 
@@ -73,6 +107,12 @@ void CTask::Start (void)
 		assert (m_bSuspended);
 		m_bSuspended = FALSE;
 	}
+
+#ifdef USE_SCHEDULER_READY_QUEUE
+	m_pScheduler->ResumeTask (this);
+#endif
+
+	CScheduler::SignalWork ();	// the task may belong to a waiting core
 }
 
 void CTask::Suspend (void)
@@ -80,6 +120,10 @@ void CTask::Suspend (void)
 	assert (m_State != TaskStateNew);
 	assert (!m_bSuspended);
 	m_bSuspended = TRUE;
+
+#ifdef USE_SCHEDULER_READY_QUEUE
+	m_pScheduler->SuspendTask (this);
+#endif
 }
 
 void CTask::Run (void)		// dummy method which is never called
@@ -89,9 +133,11 @@ void CTask::Run (void)		// dummy method which is never called
 
 void CTask::Terminate (void)
 {
+	assert (m_pScheduler == CScheduler::Get ());
+
 	m_State = TaskStateTerminated;
 	m_Event.Set ();
-	CScheduler::Get ()->Yield ();
+	m_pScheduler->Yield ();
 
 	assert (0);
 }
@@ -101,10 +147,27 @@ void CTask::WaitForTermination (void)
 	// Before accessing any of our member variables
 	// make sure this task object hasn't been deleted by 
 	// checking it's still registered with the scheduler
+#ifndef ARM_ALLOW_MULTI_CORE
 	if (!CScheduler::Get()->IsValidTask (this))
 	{
 		return;
 	}
+#else
+	unsigned nCore;
+	for (nCore = 0; nCore < CORES; nCore++)
+	{
+		if (   CScheduler::IsActive (nCore)
+		    && CScheduler::Get (nCore)->IsValidTask (this))
+		{
+			break;
+		}
+	}
+
+	if (nCore == CORES)
+	{
+		return;
+	}
+#endif
 
 	m_Event.Wait ();
 }
@@ -119,6 +182,66 @@ const char *CTask::GetName (void) const
 	return m_Name;
 }
 
+void CTask::SetPriority (unsigned nPriority)
+{
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+	m_nBasePriority = nPriority;
+
+	ApplyPriority (m_nBasePriority > m_nInheritedPriority ? m_nBasePriority
+							       : m_nInheritedPriority);
+}
+
+void CTask::InheritPriority (unsigned nPriority)
+{
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+	if (nPriority <= m_nPriority)
+	{
+		return;
+	}
+
+	m_nInheritedPriority = nPriority;
+
+	ApplyPriority (nPriority);
+}
+
+void CTask::RestorePriority (unsigned nInheritedPriority)
+{
+	assert (nInheritedPriority < TASK_PRIORITY_LEVELS);
+	m_nInheritedPriority = nInheritedPriority;
+
+	unsigned nPriority = m_nBasePriority > m_nInheritedPriority ? m_nBasePriority
+								    : m_nInheritedPriority;
+	if (nPriority != m_nPriority)
+	{
+		ApplyPriority (nPriority);
+	}
+}
+
+void CTask::ApplyPriority (unsigned nPriority)
+{
+	assert (nPriority < TASK_PRIORITY_LEVELS);
+
+#ifndef USE_SCHEDULER_READY_QUEUE
+	m_nPriority = nPriority;
+#else
+	assert (m_pScheduler != 0);
+	m_pScheduler->SetTaskPriority (this, nPriority);
+#endif
+}
+
+void CTask::SetTimeSlice (unsigned nMicroSeconds)
+{
+#ifdef USE_SCHEDULER_PREEMPTION
+	m_nTimeSlice = nMicroSeconds;
+#endif
+}
+
+boolean CTask::IsRunning (void) const
+{
+	assert (m_pScheduler != 0);
+	return m_pScheduler->GetCurrentTask () == this;
+}
+
 void CTask::SetUserData (void *pData, unsigned nSlot)
 {
 	m_pUserData[nSlot] = pData;
@@ -173,11 +296,15 @@ void CTask::TaskEntry (void *pParam)
 	CTask *pThis = (CTask *) pParam;
 	assert (pThis != 0);
 
+#ifdef USE_SCHEDULER_PREEMPTION
+	pThis->m_pScheduler->SwitchedIn ();
+#endif
+
 	pThis->Run ();
 
 	pThis->m_State = TaskStateTerminated;
 	pThis->m_Event.Set ();
-	CScheduler::Get ()->Yield ();
+	pThis->m_pScheduler->Yield ();
 
 	assert (0);
 }
@@ -0,0 +1,192 @@
+//
+// taskhealthmonitor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/taskhealthmonitor.h>
+#include <circle/sched/taskswitch.h>
+#include <circle/logger.h>
+#include <circle/debug.h>
+#include <assert.h>
+
+LOGMODULE ("taskhealth");
+
+CTaskHealthMonitor::CTaskHealthMonitor (CBcmWatchdog *pWatchdog, unsigned nWatchdogSeconds)
+:	m_pWatchdog (pWatchdog),
+	m_nWatchdogSeconds (nWatchdogSeconds),
+	m_hTimer (0),
+	m_bFailed (FALSE),
+	m_SpinLock (IRQ_LEVEL)
+{
+	for (unsigned i = 0; i < TASK_HEALTH_MAX_TASKS; i++)
+	{
+		m_Entry[i].pTask = 0;
+	}
+}
+
+CTaskHealthMonitor::~CTaskHealthMonitor (void)
+{
+	if (m_hTimer != 0)
+	{
+		CTimer::Get ()->CancelKernelTimer (m_hTimer);
+		m_hTimer = 0;
+	}
+
+	assert (m_pWatchdog != 0);
+	m_pWatchdog->Stop ();
+	m_pWatchdog = 0;
+}
+
+boolean CTaskHealthMonitor::Initialize (void)
+{
+	assert (m_pWatchdog != 0);
+	m_pWatchdog->Start (m_nWatchdogSeconds);
+
+	assert (m_hTimer == 0);
+	m_hTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ (TASK_HEALTH_CHECK_MS),
+						     TimerHandler, 0, this);
+
+	return TRUE;
+}
+
+CTaskHealthMonitor::THandle CTaskHealthMonitor::Register (CTask *pTask, unsigned nDeadlineMs)
+{
+	assert (pTask != 0);
+	assert (nDeadlineMs > 0);
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < TASK_HEALTH_MAX_TASKS; i++)
+	{
+		TEntry *pEntry = &m_Entry[i];
+		if (pEntry->pTask == 0)
+		{
+			pEntry->nDeadlineUs = nDeadlineMs * 1000;
+			pEntry->nBeats = 0;
+			pEntry->nLastBeats = 0;
+			pEntry->nLastBeatTicks = CTimer::GetClockTicks ();
+			pEntry->pTask = pTask;
+
+			m_SpinLock.Release ();
+
+			return i;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	LOGWARN ("Too many tasks");
+
+	return -1;
+}
+
+void CTaskHealthMonitor::Unregister (THandle hEntry)
+{
+	assert (0 <= hEntry && hEntry < TASK_HEALTH_MAX_TASKS);
+
+	m_SpinLock.Acquire ();
+
+	assert (m_Entry[hEntry].pTask != 0);
+	m_Entry[hEntry].pTask = 0;
+
+	m_SpinLock.Release ();
+}
+
+void CTaskHealthMonitor::Check (void)
+{
+	unsigned nTicks = CTimer::GetClockTicks ();
+	boolean bHealthy = TRUE;
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < TASK_HEALTH_MAX_TASKS; i++)
+	{
+		TEntry *pEntry = &m_Entry[i];
+		if (pEntry->pTask == 0)
+		{
+			continue;
+		}
+
+		unsigned nBeats = __atomic_load_n (&pEntry->nBeats, __ATOMIC_RELAXED);
+		if (   nBeats != pEntry->nLastBeats
+		    || pEntry->pTask->IsSuspended ())
+		{
+			pEntry->nLastBeats = nBeats;
+			pEntry->nLastBeatTicks = nTicks;
+
+			continue;
+		}
+
+		unsigned nElapsed = nTicks - pEntry->nLastBeatTicks;
+		if (nElapsed > pEntry->nDeadlineUs)
+		{
+			bHealthy = FALSE;
+
+			if (!m_bFailed)
+			{
+				ReportTask (pEntry->pTask, (nElapsed - pEntry->nDeadlineUs) / 1000);
+			}
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	if (!bHealthy)
+	{
+		if (!m_bFailed)
+		{
+			m_bFailed = TRUE;
+
+			LOGERR ("System will restart in %u seconds",
+				m_pWatchdog->GetTimeLeft ());
+		}
+
+		return;
+	}
+
+	assert (m_pWatchdog != 0);
+	m_pWatchdog->Start (m_nWatchdogSeconds);
+}
+
+void CTaskHealthMonitor::ReportTask (CTask *pTask, unsigned nOverdueMs)
+{
+	assert (pTask != 0);
+
+	LOGERR ("Task %s missed its deadline by %u ms (state %u)",
+		pTask->GetName (), nOverdueMs, (unsigned) pTask->GetState ());
+
+	if (pTask->IsRunning ())
+	{
+		LOGERR ("Task %s is running", pTask->GetName ());
+
+		return;
+	}
+
+	// the registers have been saved on the last task switch
+	DebugStackTrace ((const uintptr *) (uintptr) pTask->GetRegs ()->sp, From);
+}
+
+void CTaskHealthMonitor::TimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CTaskHealthMonitor *pThis = (CTaskHealthMonitor *) pContext;
+	assert (pThis != 0);
+
+	pThis->Check ();
+
+	pThis->m_hTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ (TASK_HEALTH_CHECK_MS),
+							    TimerHandler, 0, pThis);
+}
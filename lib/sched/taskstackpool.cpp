@@ -0,0 +1,105 @@
+//
+// taskstackpool.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/taskstackpool.h>
+#include <assert.h>
+
+#ifndef NO_TASK_STACK_POOL
+
+const unsigned CTaskStackPool::s_nClassSize[] = { TASK_STACK_POOL_SIZES };
+const unsigned CTaskStackPool::s_nClasses = sizeof s_nClassSize / sizeof s_nClassSize[0];
+
+#else
+
+const unsigned CTaskStackPool::s_nClassSize[] = { 0 };
+const unsigned CTaskStackPool::s_nClasses = 0;
+
+#endif
+
+CTaskStackPool::TFreeStack *CTaskStackPool::s_pFreeList[TASK_STACK_POOL_MAX_CLASSES] = {0};
+
+CSpinLock CTaskStackPool::s_SpinLock (TASK_LEVEL);
+
+u8 *CTaskStackPool::Allocate (unsigned nSize)
+{
+	unsigned nClass = GetClass (nSize);
+	if (nClass >= s_nClasses)
+	{
+		return new u8[nSize];
+	}
+
+	s_SpinLock.Acquire ();
+
+	TFreeStack *pStack = s_pFreeList[nClass];
+	if (pStack != 0)
+	{
+		s_pFreeList[nClass] = pStack->pNext;
+
+		s_SpinLock.Release ();
+
+		return (u8 *) pStack;
+	}
+
+	s_SpinLock.Release ();
+
+	return new u8[s_nClassSize[nClass]];
+}
+
+void CTaskStackPool::Free (u8 *pStack, unsigned nSize)
+{
+	if (pStack == 0)
+	{
+		return;
+	}
+
+	unsigned nClass = GetClass (nSize);
+	if (nClass >= s_nClasses)
+	{
+		delete [] pStack;
+
+		return;
+	}
+
+	TFreeStack *pFreeStack = (TFreeStack *) pStack;
+
+	s_SpinLock.Acquire ();
+
+	pFreeStack->pNext = s_pFreeList[nClass];
+	s_pFreeList[nClass] = pFreeStack;
+
+	s_SpinLock.Release ();
+}
+
+unsigned CTaskStackPool::GetClass (unsigned nSize)
+{
+	assert (s_nClasses <= TASK_STACK_POOL_MAX_CLASSES);
+
+	unsigned nClass;
+	for (nClass = 0; nClass < s_nClasses; nClass++)
+	{
+		assert (nClass == 0 || s_nClassSize[nClass-1] < s_nClassSize[nClass]);
+
+		if (nSize <= s_nClassSize[nClass])
+		{
+			break;
+		}
+	}
+
+	return nClass;
+}
@@ -0,0 +1,110 @@
+//
+// threadedirq.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/threadedirq.h>
+#include <assert.h>
+
+CThreadedIRQTask::CThreadedIRQTask (CThreadedIRQ *pIRQ, unsigned nPriority)
+:	CTask (TASK_STACK_SIZE, TRUE, nPriority),
+	m_pIRQ (pIRQ)
+{
+	SetName ("irqthread");
+}
+
+void CThreadedIRQTask::Run (void)
+{
+	assert (m_pIRQ != 0);
+	m_pIRQ->TaskHandler ();
+}
+
+CThreadedIRQ::CThreadedIRQ (unsigned nIRQ, TIRQHandler *pPrimaryHandler,
+			    TIRQHandler *pThreadHandler, void *pParam, unsigned nPriority)
+:	m_nIRQ (nIRQ),
+	m_pPrimaryHandler (pPrimaryHandler),
+	m_pThreadHandler (pThreadHandler),
+	m_pParam (pParam),
+	m_bTerminate (FALSE),
+	m_pTask (0)
+{
+	assert (m_pThreadHandler != 0);
+
+	m_pTask = new CThreadedIRQTask (this, nPriority);
+	assert (m_pTask != 0);
+
+	CInterruptSystem::Get ()->ConnectIRQ (m_nIRQ, IRQStub, this);
+
+	m_pTask->Start ();
+}
+
+CThreadedIRQ::~CThreadedIRQ (void)
+{
+	CInterruptSystem::Get ()->DisconnectIRQ (m_nIRQ);
+
+	// the handler task returns from Run() and is deleted by the scheduler then
+	m_bTerminate = TRUE;
+	m_Event.Set ();
+
+	assert (m_pTask != 0);
+	m_pTask->WaitForTermination ();
+	m_pTask = 0;
+
+	m_pThreadHandler = 0;
+	m_pPrimaryHandler = 0;
+}
+
+void CThreadedIRQ::TaskHandler (void)
+{
+	while (1)
+	{
+		m_Event.Wait ();
+		m_Event.Clear ();
+
+		if (m_bTerminate)
+		{
+			return;
+		}
+
+		assert (m_pThreadHandler != 0);
+		(*m_pThreadHandler) (m_pParam);
+
+		// the IRQ must not be enabled again, when it has been disconnected meanwhile
+		if (   m_pPrimaryHandler == 0
+		    && !m_bTerminate)
+		{
+			CInterruptSystem::EnableIRQ (m_nIRQ);
+		}
+	}
+}
+
+void CThreadedIRQ::IRQStub (void *pParam)
+{
+	CThreadedIRQ *pThis = (CThreadedIRQ *) pParam;
+	assert (pThis != 0);
+
+	if (pThis->m_pPrimaryHandler != 0)
+	{
+		(*pThis->m_pPrimaryHandler) (pThis->m_pParam);
+	}
+	else
+	{
+		CInterruptSystem::DisableIRQ (pThis->m_nIRQ);
+	}
+
+	pThis->m_Event.Set ();
+}
@@ -0,0 +1,147 @@
+//
+// workqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sched/workqueue.h>
+#include <circle/multicore.h>
+#include <assert.h>
+
+#ifndef ARM_ALLOW_MULTI_CORE
+CWorkQueue *CWorkQueue::s_pDefault[1] = {0};
+#else
+CWorkQueue *CWorkQueue::s_pDefault[CORES] = {0};
+#endif
+
+CWorkItem::CWorkItem (TWorkFunction *pFunction, void *pParam)
+:	m_pFunction (pFunction),
+	m_pParam (pParam),
+	m_bPending (FALSE),
+	m_pNext (0)
+{
+	assert (m_pFunction != 0);
+}
+
+CWorkItem::~CWorkItem (void)
+{
+	assert (!m_bPending);
+
+	m_pFunction = 0;
+}
+
+CWorkQueue::CWorkQueue (unsigned nPriority, unsigned nCore)
+:	CTask (TASK_STACK_SIZE, TRUE, nPriority, nCore),
+	m_pFirst (0),
+	m_pLast (0),
+	m_SpinLock (IRQ_LEVEL)
+{
+	SetName ("workqueue");
+
+	Start ();
+}
+
+CWorkQueue::~CWorkQueue (void)
+{
+	assert (m_pFirst == 0);
+}
+
+boolean CWorkQueue::Queue (CWorkItem *pItem)
+{
+	assert (pItem != 0);
+
+	m_SpinLock.Acquire ();
+
+	if (pItem->m_bPending)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	pItem->m_bPending = TRUE;
+	pItem->m_pNext = 0;
+
+	if (m_pFirst == 0)
+	{
+		m_pFirst = pItem;
+	}
+	else
+	{
+		assert (m_pLast != 0);
+		m_pLast->m_pNext = pItem;
+	}
+	m_pLast = pItem;
+
+	m_SpinLock.Release ();
+
+	m_Event.Set ();
+
+	return TRUE;
+}
+
+void CWorkQueue::Run (void)
+{
+	while (1)
+	{
+		m_Event.Wait ();
+		m_Event.Clear ();		// items queued from now on set the event again
+
+		while (1)
+		{
+			m_SpinLock.Acquire ();
+
+			CWorkItem *pItem = m_pFirst;
+			if (pItem == 0)
+			{
+				m_SpinLock.Release ();
+
+				break;
+			}
+
+			m_pFirst = pItem->m_pNext;
+
+			// the item can be queued again from here on
+			TWorkFunction *pFunction = pItem->m_pFunction;
+			void *pParam = pItem->m_pParam;
+			pItem->m_bPending = FALSE;
+
+			m_SpinLock.Release ();
+
+			assert (pFunction != 0);
+			(*pFunction) (pParam);
+		}
+	}
+}
+
+CWorkQueue *CWorkQueue::Get (void)
+{
+#ifdef ARM_ALLOW_MULTI_CORE
+	unsigned nCore = CMultiCoreSupport::ThisCore ();
+#else
+	unsigned nCore = 0;
+#endif
+
+	if (s_pDefault[nCore] == 0)
+	{
+		assert (CurrentExecutionLevel () == TASK_LEVEL);
+
+		s_pDefault[nCore] = new CWorkQueue;
+		assert (s_pDefault[nCore] != 0);
+	}
+
+	return s_pDefault[nCore];
+}
@@ -23,7 +23,12 @@
 #include <circle/memio.h>
 #include <circle/rp1int.h>
 #include <circle/machineinfo.h>
+#include <circle/dmacommon.h>
+#include <circle/dmachannel.h>
+#include <circle/timer.h>
 #include <circle/synchronize.h>
+#include <circle/util.h>
+#include <circle/new.h>
 #include <assert.h>
 
 #ifndef USE_RPI_STUB_AT
@@ -48,6 +53,7 @@
 #define ARM_UART_RIS    	(m_nBaseAddress + 0x3C)
 #define ARM_UART_MIS    	(m_nBaseAddress + 0x40)
 #define ARM_UART_ICR    	(m_nBaseAddress + 0x44)
+#define ARM_UART_DMACR    	(m_nBaseAddress + 0x48)
 
 // Definitions from Raspberry PI Remote Serial Protocol.
 //     Copyright 2012 Jamie Iles, jamie@jamieiles.com.
@@ -106,6 +112,11 @@
 #define INT_DCDM		(1 << 2)
 #define INT_CTSM		(1 << 1)
 
+#define DMACR_TXDMAE		(1 << 1)
+#define DMACR_RXDMAE		(1 << 0)
+
+#define BUS_IO_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
 #define ALT_FUNC(device, gpio)	((TGPIOMode) (  s_GPIOConfig[device][gpio][VALUE_ALT] \
 					      + GPIOModeAlternateFunction0))
 
@@ -221,10 +232,31 @@ CSerialDevice::CSerialDevice (CInterruptSystem *pInterruptSystem, boolean bUseFI
 	m_nOptions (SERIAL_OPTION_ONLCR),
 	m_pCharReceivedHandler (0),
 	m_pMagic (0),
-	m_SpinLock (bUseFIQ ? FIQ_LEVEL : IRQ_LEVEL)
+	m_SpinLock (bUseFIQ ? FIQ_LEVEL : IRQ_LEVEL),
 #ifdef REALTIME
-	, m_LineSpinLock (TASK_LEVEL)
+	m_LineSpinLock (TASK_LEVEL),
 #endif
+	m_bUseDMA (FALSE),
+	m_nRxDMAChannel (DMA_CHANNEL_NONE),
+	m_nTxDMAChannel (DMA_CHANNEL_NONE),
+	m_pDMAControlBlockBuffer (0),
+	m_pRxControlBlock (0),
+	m_pTxControlBlock (0),
+	m_pRxDMABuffer (0),
+	m_nRxDMASize (0),
+	m_nRxDMALaps (0),
+	m_nRxDMAConsumed (0),
+	m_pTxDMABuffer (0),
+	m_nTxDMASize (0),
+	m_nTxDMAInPtr (0),
+	m_nTxDMAOutPtr (0),
+	m_nTxDMALength (0),
+	m_pIdleHandler (0),
+	m_pIdleParam (0),
+	m_nIdleMicros (0),
+	m_hIdleTimer (0),
+	m_nIdleLastReceived (0),
+	m_bIdlePending (FALSE)
 {
 #if RASPPI == 5
 	s_IRQ[10] =   CMachineInfo::Get ()->GetSoCStepping () >= SoCSteppingD0
@@ -283,6 +315,13 @@ CSerialDevice::~CSerialDevice (void)
 
 	CDeviceNameService::Get ()->RemoveDevice ("ttyS", m_nDevice+1, FALSE);
 
+	if (m_bUseDMA)
+	{
+		RegisterIdleHandler (0);
+
+		StopDMA ();
+	}
+
 	// remove device from interrupt handling
 	s_nInterruptDeviceMask &= ~(1 << m_nDevice);
 	DataSyncBarrier ();
@@ -477,7 +516,22 @@ boolean CSerialDevice::Initialize (unsigned nBaudrate,
 		break;
 	}
 
-	if (m_pInterruptSystem != 0)
+	if (m_bUseDMA)
+	{
+		// the UART interrupt is not used, the DMA drains the RX FIFO
+		write32 (ARM_UART_IFLS,   IFLS_IFSEL_1_2 << IFLS_TXIFSEL_SHIFT
+					| IFLS_IFSEL_1_8 << IFLS_RXIFSEL_SHIFT);
+		write32 (ARM_UART_LCRH, nLCRH);
+		write32 (ARM_UART_DMACR, DMACR_TXDMAE | DMACR_RXDMAE);
+
+		if (!SetupDMA ())
+		{
+			PeripheralExit ();
+
+			return FALSE;
+		}
+	}
+	else if (m_pInterruptSystem != 0)
 	{
 		write32 (ARM_UART_IFLS,   IFLS_IFSEL_1_4 << IFLS_TXIFSEL_SHIFT
 					| IFLS_IFSEL_1_4 << IFLS_RXIFSEL_SHIFT);
@@ -544,7 +598,15 @@ int CSerialDevice::Write (const void *pBuffer, size_t nCount)
 
 	m_LineSpinLock.Release ();
 
-	if (m_pInterruptSystem != 0)
+	if (m_bUseDMA)
+	{
+		m_SpinLock.Acquire ();
+
+		StartTxDMA ();
+
+		m_SpinLock.Release ();
+	}
+	else if (m_pInterruptSystem != 0)
 	{
 		m_SpinLock.Acquire ();
 
@@ -585,7 +647,75 @@ int CSerialDevice::Read (void *pBuffer, size_t nCount)
 
 	int nResult = 0;
 
-	if (m_pInterruptSystem != 0)
+	if (m_bUseDMA)
+	{
+		m_SpinLock.Acquire ();
+
+		unsigned nAvailable = RxDMAAvailable ();
+
+		if (m_nRxStatus < 0)
+		{
+			nResult = m_nRxStatus;
+			m_nRxStatus = 0;
+		}
+		else
+		{
+			if (nCount > nAvailable)
+			{
+				nCount = nAvailable;
+			}
+
+			while (nCount > 0)
+			{
+				// copy contiguous words up to the end of the ring buffer
+				unsigned nIndex = m_nRxDMAConsumed & (m_nRxDMASize-1);
+				unsigned nChunk = m_nRxDMASize - nIndex;
+				if (nChunk > nCount)
+				{
+					nChunk = nCount;
+				}
+
+				const u32 *pWord = &m_pRxDMABuffer[nIndex];
+				CleanAndInvalidateDataCacheRange ((uintptr) pWord, nChunk * sizeof (u32));
+
+				unsigned i;
+				for (i = 0; i < nChunk; i++)
+				{
+					u32 nDR = pWord[i];
+					if (nDR & SERIAL_RX_ERROR_MASK)
+					{
+						break;
+					}
+
+					*pChar++ = nDR & 0xFF;
+				}
+
+				m_nRxDMAConsumed += i;
+				nResult += i;
+				nCount -= i;
+
+				if (i < nChunk)
+				{
+					// report the error, when the preceding data has been read
+					if (nResult == 0)
+					{
+						u32 nDR = pWord[i];
+						nResult =   nDR & DR_BE_MASK ? -SERIAL_ERROR_BREAK
+							  : nDR & DR_OE_MASK ? -SERIAL_ERROR_OVERRUN
+							  : nDR & DR_FE_MASK ? -SERIAL_ERROR_FRAMING
+							  : -SERIAL_ERROR_PARITY;
+
+						m_nRxDMAConsumed++;
+					}
+
+					break;
+				}
+			}
+		}
+
+		m_SpinLock.Release ();
+	}
+	else if (m_pInterruptSystem != 0)
 	{
 		m_SpinLock.Acquire ();
 
@@ -732,6 +862,13 @@ boolean CSerialDevice::IsTransmitting (void) const
 		return TRUE;
 	}
 
+	if (   m_bUseDMA
+	    && (   m_nTxDMALength != 0
+		|| m_nTxDMAInPtr != m_nTxDMAOutPtr))
+	{
+		return TRUE;
+	}
+
 	PeripheralEntry ();
 
 	u32 nFR = read32 (ARM_UART_FR);
@@ -771,6 +908,16 @@ unsigned CSerialDevice::AvailableForWrite (void)
 
 	m_SpinLock.Acquire ();
 
+	if (m_bUseDMA)
+	{
+		unsigned nResult =   (m_nTxDMAOutPtr - m_nTxDMAInPtr - 1)
+				   & (m_nTxDMASize-1);
+
+		m_SpinLock.Release ();
+
+		return nResult;
+	}
+
 	unsigned nResult;
 	if (m_nTxOutPtr <= m_nTxInPtr)
 	{
@@ -793,6 +940,15 @@ unsigned CSerialDevice::AvailableForRead (void)
 
 	m_SpinLock.Acquire ();
 
+	if (m_bUseDMA)
+	{
+		unsigned nResult = RxDMAAvailable ();
+
+		m_SpinLock.Release ();
+
+		return nResult;
+	}
+
 	unsigned nResult;
 	if (m_nRxInPtr < m_nRxOutPtr)
 	{
@@ -816,7 +972,17 @@ int CSerialDevice::Peek (void)
 	m_SpinLock.Acquire ();
 
 	int nResult = -1;
-	if (m_nRxInPtr != m_nRxOutPtr)
+	if (m_bUseDMA)
+	{
+		if (RxDMAAvailable () > 0)
+		{
+			const u32 *pWord = &m_pRxDMABuffer[m_nRxDMAConsumed & (m_nRxDMASize-1)];
+			CleanAndInvalidateDataCacheRange ((uintptr) pWord, sizeof (u32));
+
+			nResult = *pWord & 0xFF;
+		}
+	}
+	else if (m_nRxInPtr != m_nRxOutPtr)
 	{
 		nResult = m_RxBuffer[m_nRxOutPtr];
 	}
@@ -842,7 +1008,23 @@ boolean CSerialDevice::Write (u8 uchChar)
 {
 	boolean bOK = TRUE;
 
-	if (m_pInterruptSystem != 0)
+	if (m_bUseDMA)
+	{
+		m_SpinLock.Acquire ();
+
+		if (((m_nTxDMAInPtr+1) & (m_nTxDMASize-1)) != m_nTxDMAOutPtr)
+		{
+			m_pTxDMABuffer[m_nTxDMAInPtr++] = uchChar;
+			m_nTxDMAInPtr &= m_nTxDMASize-1;
+		}
+		else
+		{
+			bOK = FALSE;
+		}
+
+		m_SpinLock.Release ();
+	}
+	else if (m_pInterruptSystem != 0)
 	{
 		m_SpinLock.Acquire ();
 
@@ -1015,6 +1197,443 @@ void CSerialDevice::InterruptStub (void *pParam)
 #endif
 }
 
+boolean CSerialDevice::EnableDMA (unsigned nRxBufferSize, unsigned nTxBufferSize)
+{
+#if RASPPI <= 4
+	assert (!m_bUseDMA);
+
+	if (   !m_bValid
+	    || m_nDevice != 0			// other UARTs have no DREQ here
+	    || m_pInterruptSystem == 0
+	    || nRxBufferSize < 16 || (nRxBufferSize & (nRxBufferSize-1))
+	    || nTxBufferSize < 16 || (nTxBufferSize & (nTxBufferSize-1)))
+	{
+		return FALSE;
+	}
+
+	m_nRxDMAChannel = CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_NORMAL);
+	m_nTxDMAChannel = CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_NORMAL);
+	if (   m_nRxDMAChannel == DMA_CHANNEL_NONE
+	    || m_nTxDMAChannel == DMA_CHANNEL_NONE)
+	{
+		if (m_nRxDMAChannel != DMA_CHANNEL_NONE)
+		{
+			CMachineInfo::Get ()->FreeDMAChannel (m_nRxDMAChannel);
+			m_nRxDMAChannel = DMA_CHANNEL_NONE;
+		}
+
+		if (m_nTxDMAChannel != DMA_CHANNEL_NONE)
+		{
+			CMachineInfo::Get ()->FreeDMAChannel (m_nTxDMAChannel);
+			m_nTxDMAChannel = DMA_CHANNEL_NONE;
+		}
+
+		return FALSE;
+	}
+
+	m_nRxDMASize = nRxBufferSize;
+	m_pRxDMABuffer = new (HEAP_DMA30) u32[m_nRxDMASize];
+	assert (m_pRxDMABuffer != 0);
+	memset (m_pRxDMABuffer, 0, m_nRxDMASize * sizeof (u32));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pRxDMABuffer, m_nRxDMASize * sizeof (u32));
+
+	m_nTxDMASize = nTxBufferSize;
+	m_pTxDMABuffer = new (HEAP_DMA30) u32[m_nTxDMASize];
+	assert (m_pTxDMABuffer != 0);
+
+	m_pDMAControlBlockBuffer = new (HEAP_DMA30) u8[2 * sizeof (TDMAControlBlock) + 31];
+	assert (m_pDMAControlBlockBuffer != 0);
+	m_pRxControlBlock = (TDMAControlBlock *) (((uintptr) m_pDMAControlBlockBuffer + 31) & ~31);
+	m_pTxControlBlock = m_pRxControlBlock + 1;
+
+	m_bUseDMA = TRUE;
+
+	return TRUE;
+#else
+	return FALSE;
+#endif
+}
+
+void CSerialDevice::RegisterIdleHandler (TIdleHandler *pHandler, void *pParam,
+					 unsigned nIdleMicros)
+{
+	assert (m_bUseDMA);
+
+	if (m_hIdleTimer != 0)
+	{
+		CTimer::Get ()->CancelKernelTimer (m_hIdleTimer);
+		m_hIdleTimer = 0;
+	}
+
+	m_pIdleHandler = pHandler;
+	m_pIdleParam = pParam;
+	m_nIdleMicros = nIdleMicros;
+
+	if (m_pIdleHandler != 0)
+	{
+		m_bIdlePending = FALSE;
+
+		assert (m_nIdleMicros > 0);
+		m_hIdleTimer = CTimer::Get ()->StartKernelTimerUs (m_nIdleMicros,
+								   IdleTimerHandler, this);
+	}
+}
+
+const u32 *CSerialDevice::GetRxData (unsigned *pCount)
+{
+	assert (m_bUseDMA);
+	assert (pCount != 0);
+
+	m_SpinLock.Acquire ();
+
+	unsigned nAvailable = RxDMAAvailable ();
+
+	unsigned nIndex = m_nRxDMAConsumed & (m_nRxDMASize-1);
+	unsigned nCount = m_nRxDMASize - nIndex;
+	if (nCount > nAvailable)
+	{
+		nCount = nAvailable;
+	}
+
+	m_SpinLock.Release ();
+
+	*pCount = nCount;
+	if (nCount == 0)
+	{
+		return 0;
+	}
+
+	const u32 *pData = &m_pRxDMABuffer[nIndex];
+	CleanAndInvalidateDataCacheRange ((uintptr) pData, nCount * sizeof (u32));
+
+	return pData;
+}
+
+void CSerialDevice::ReleaseRxData (unsigned nCount)
+{
+	assert (m_bUseDMA);
+
+	m_SpinLock.Acquire ();
+
+	if (nCount > RxDMAAvailable ())
+	{
+		nCount = RxDMAAvailable ();	// data has been overwritten meanwhile
+	}
+
+	m_nRxDMAConsumed += nCount;
+
+	m_SpinLock.Release ();
+}
+
+boolean CSerialDevice::SetupDMA (void)
+{
+	assert (m_bUseDMA);
+	assert (m_pInterruptSystem != 0);
+
+	PeripheralEntry ();
+
+	write32 (ARM_DMA_ENABLE,   read32 (ARM_DMA_ENABLE)
+				 | 1 << m_nRxDMAChannel | 1 << m_nTxDMAChannel);
+
+	unsigned Channels[] = {m_nRxDMAChannel, m_nTxDMAChannel};
+	for (unsigned i = 0; i < 2; i++)
+	{
+		write32 (ARM_DMACHAN_CS (Channels[i]), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (Channels[i])) & CS_RESET)
+		{
+			// do nothing
+		}
+
+		write32 (ARM_DMA_INT_STATUS, 1 << Channels[i]);
+	}
+
+	PeripheralExit ();
+
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nRxDMAChannel, RxDMAInterruptStub, this);
+	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nTxDMAChannel, TxDMAInterruptStub, this);
+
+	// cyclic RX transfer into the ring buffer, with an interrupt on each wrap
+	assert (m_pRxControlBlock != 0);
+	m_pRxControlBlock->nTransferInformation	=   (DREQSourceUARTRX << TI_PERMAP_SHIFT)
+						  | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						  | TI_SRC_DREQ
+						  | TI_DEST_INC
+						  | TI_WAIT_RESP
+						  | TI_INTEN;
+	m_pRxControlBlock->nSourceAddress	= BUS_IO_ADDRESS (ARM_UART_DR);
+	m_pRxControlBlock->nDestinationAddress	= BUS_ADDRESS ((uintptr) m_pRxDMABuffer);
+	m_pRxControlBlock->nTransferLength	= m_nRxDMASize * sizeof (u32);
+	m_pRxControlBlock->n2DModeStride	= 0;
+	m_pRxControlBlock->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pRxControlBlock);
+	m_pRxControlBlock->nReserved[0]		= 0;
+	m_pRxControlBlock->nReserved[1]		= 0;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pRxControlBlock, sizeof (TDMAControlBlock));
+
+	m_nRxDMALaps = 0;
+	m_nRxDMAConsumed = 0;
+
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nRxDMAChannel),
+		 BUS_ADDRESS ((uintptr) m_pRxControlBlock));
+	write32 (ARM_DMACHAN_CS (m_nRxDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					           | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					           | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					           | CS_ACTIVE);
+
+	PeripheralExit ();
+
+	return TRUE;
+}
+
+void CSerialDevice::StopDMA (void)
+{
+	assert (m_bUseDMA);
+
+	PeripheralEntry ();
+
+	write32 (ARM_UART_DMACR, 0);
+
+	unsigned Channels[] = {m_nRxDMAChannel, m_nTxDMAChannel};
+	for (unsigned i = 0; i < 2; i++)
+	{
+		write32 (ARM_DMACHAN_CS (Channels[i]), CS_RESET);
+		while (read32 (ARM_DMACHAN_CS (Channels[i])) & CS_RESET)
+		{
+			// do nothing
+		}
+
+		write32 (ARM_DMA_INT_STATUS, 1 << Channels[i]);
+	}
+
+	write32 (ARM_DMA_ENABLE,   read32 (ARM_DMA_ENABLE)
+				 & ~(1 << m_nRxDMAChannel | 1 << m_nTxDMAChannel));
+
+	PeripheralExit ();
+
+	assert (m_pInterruptSystem != 0);
+	m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nRxDMAChannel);
+	m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nTxDMAChannel);
+
+	CMachineInfo::Get ()->FreeDMAChannel (m_nTxDMAChannel);
+	CMachineInfo::Get ()->FreeDMAChannel (m_nRxDMAChannel);
+
+	m_pRxControlBlock = 0;
+	m_pTxControlBlock = 0;
+	delete [] m_pDMAControlBlockBuffer;
+	m_pDMAControlBlockBuffer = 0;
+
+	delete [] m_pTxDMABuffer;
+	m_pTxDMABuffer = 0;
+
+	delete [] m_pRxDMABuffer;
+	m_pRxDMABuffer = 0;
+
+	m_bUseDMA = FALSE;
+}
+
+// called with m_SpinLock acquired
+unsigned CSerialDevice::RxDMAAvailable (void)
+{
+	assert (m_bUseDMA);
+
+	PeripheralEntry ();
+
+	// the lap counter must match the write position
+	unsigned nLaps;
+	u32 nDestAddress;
+	do
+	{
+		nLaps = m_nRxDMALaps;
+		DataMemBarrier ();
+
+		nDestAddress = read32 (ARM_DMACHAN_DEST_AD (m_nRxDMAChannel));
+		DataMemBarrier ();
+	}
+	while (nLaps != m_nRxDMALaps);
+
+	PeripheralExit ();
+
+	unsigned nPos = (nDestAddress - BUS_ADDRESS ((uintptr) m_pRxDMABuffer)) / sizeof (u32);
+	if (nPos >= m_nRxDMASize)
+	{
+		nPos = 0;			// wrap, the lap is counted below
+	}
+
+	unsigned nReceived = nLaps * m_nRxDMASize + nPos;
+	unsigned nAvailable = nReceived - m_nRxDMAConsumed;
+
+	// the interrupt of the last wrap has not been handled yet
+	if ((int) nAvailable < 0)
+	{
+		nAvailable += m_nRxDMASize;
+	}
+
+	// unread data has been overwritten, discard all of it
+	if (nAvailable > m_nRxDMASize)
+	{
+		m_nRxDMAConsumed += nAvailable;
+		nAvailable = 0;
+
+		if (m_nRxStatus == 0)
+		{
+			m_nRxStatus = -SERIAL_ERROR_OVERRUN;
+		}
+	}
+
+	return nAvailable;
+}
+
+// called with m_SpinLock acquired
+void CSerialDevice::StartTxDMA (void)
+{
+	assert (m_bUseDMA);
+
+	if (   m_nTxDMALength != 0
+	    || m_nTxDMAInPtr == m_nTxDMAOutPtr)
+	{
+		return;
+	}
+
+	// send contiguous words up to the end of the ring buffer
+	m_nTxDMALength =   m_nTxDMAInPtr > m_nTxDMAOutPtr
+			 ? m_nTxDMAInPtr - m_nTxDMAOutPtr
+			 : m_nTxDMASize - m_nTxDMAOutPtr;
+
+	const u32 *pSource = &m_pTxDMABuffer[m_nTxDMAOutPtr];
+	CleanAndInvalidateDataCacheRange ((uintptr) pSource, m_nTxDMALength * sizeof (u32));
+
+	assert (m_pTxControlBlock != 0);
+	m_pTxControlBlock->nTransferInformation	=   (DREQSourceUARTTX << TI_PERMAP_SHIFT)
+						  | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						  | TI_DEST_DREQ
+						  | TI_SRC_INC
+						  | TI_WAIT_RESP
+						  | TI_INTEN;
+	m_pTxControlBlock->nSourceAddress	= BUS_ADDRESS ((uintptr) pSource);
+	m_pTxControlBlock->nDestinationAddress	= BUS_IO_ADDRESS (ARM_UART_DR);
+	m_pTxControlBlock->nTransferLength	= m_nTxDMALength * sizeof (u32);
+	m_pTxControlBlock->n2DModeStride	= 0;
+	m_pTxControlBlock->nNextControlBlockAddress = 0;
+	m_pTxControlBlock->nReserved[0]		= 0;
+	m_pTxControlBlock->nReserved[1]		= 0;
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pTxControlBlock, sizeof (TDMAControlBlock));
+
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nTxDMAChannel),
+		 BUS_ADDRESS ((uintptr) m_pTxControlBlock));
+	write32 (ARM_DMACHAN_CS (m_nTxDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					           | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					           | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					           | CS_ACTIVE);
+
+	PeripheralExit ();
+}
+
+void CSerialDevice::RxDMAInterruptHandler (void)
+{
+	PeripheralEntry ();
+
+	u32 nIntMask = 1 << m_nRxDMAChannel;
+	if (!(read32 (ARM_DMA_INT_STATUS) & nIntMask))
+	{
+		PeripheralExit ();
+
+		return;
+	}
+
+	write32 (ARM_DMA_INT_STATUS, nIntMask);
+	write32 (ARM_DMACHAN_CS (m_nRxDMAChannel), read32 (ARM_DMACHAN_CS (m_nRxDMAChannel)));
+
+	PeripheralExit ();
+
+	m_SpinLock.Acquire ();
+
+	m_nRxDMALaps++;
+
+	m_SpinLock.Release ();
+}
+
+void CSerialDevice::RxDMAInterruptStub (void *pParam)
+{
+	CSerialDevice *pThis = (CSerialDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->RxDMAInterruptHandler ();
+}
+
+void CSerialDevice::TxDMAInterruptHandler (void)
+{
+	PeripheralEntry ();
+
+	u32 nIntMask = 1 << m_nTxDMAChannel;
+	if (!(read32 (ARM_DMA_INT_STATUS) & nIntMask))
+	{
+		PeripheralExit ();
+
+		return;
+	}
+
+	write32 (ARM_DMA_INT_STATUS, nIntMask);
+	write32 (ARM_DMACHAN_CS (m_nTxDMAChannel), read32 (ARM_DMACHAN_CS (m_nTxDMAChannel)));
+
+	PeripheralExit ();
+
+	m_SpinLock.Acquire ();
+
+	m_nTxDMAOutPtr = (m_nTxDMAOutPtr + m_nTxDMALength) & (m_nTxDMASize-1);
+	m_nTxDMALength = 0;
+
+	StartTxDMA ();
+
+	m_SpinLock.Release ();
+}
+
+void CSerialDevice::TxDMAInterruptStub (void *pParam)
+{
+	CSerialDevice *pThis = (CSerialDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->TxDMAInterruptHandler ();
+}
+
+void CSerialDevice::IdleTimerHandler (TKernelTimerHandle hTimer, void *pParam, void *pContext)
+{
+	CSerialDevice *pThis = (CSerialDevice *) pParam;
+	assert (pThis != 0);
+
+	pThis->m_SpinLock.Acquire ();
+
+	unsigned nReceived = pThis->m_nRxDMAConsumed + pThis->RxDMAAvailable ();
+
+	// idle, when data has been received before, but not in the last period
+	boolean bIdle = FALSE;
+	if (nReceived != pThis->m_nIdleLastReceived)
+	{
+		pThis->m_nIdleLastReceived = nReceived;
+		pThis->m_bIdlePending = TRUE;
+	}
+	else if (pThis->m_bIdlePending)
+	{
+		pThis->m_bIdlePending = FALSE;
+		bIdle = TRUE;
+	}
+
+	pThis->m_SpinLock.Release ();
+
+	pThis->m_hIdleTimer = CTimer::Get ()->StartKernelTimerUs (pThis->m_nIdleMicros,
+								  IdleTimerHandler, pThis);
+
+	if (bIdle)
+	{
+		assert (pThis->m_pIdleHandler != 0);
+		(*pThis->m_pIdleHandler) (pThis->m_pIdleParam);
+	}
+}
+
 #else	// #ifndef USE_RPI_STUB_AT
 
 boolean CSerialDevice::Initialize (unsigned nBaudrate)
@@ -221,6 +221,11 @@ void CSMIMaster::WriteDMA(boolean bWaitForCompletion)
 	if (bWaitForCompletion) m_txDMA.Wait();
 }
 
+boolean CSMIMaster::WaitForDMA (void)
+{
+	return m_txDMA.Wait ();
+}
+
 void CSMIMaster::SetupTiming(TSMIDataWidth nWidth, unsigned nCycle_ns, unsigned nSetup, unsigned nStrobe, unsigned nHold, unsigned nPace, unsigned nDevice)
 {
 	uintptr readReg, writeReg;
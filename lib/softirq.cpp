@@ -0,0 +1,173 @@
+//
+// softirq.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/softirq.h>
+#include <circle/multicore.h>
+#include <circle/atomic.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+#if RASPPI >= 4
+	#include <circle/bcm2711int.h>
+#endif
+
+CSoftIRQ *CSoftIRQ::s_pThis = 0;
+
+CSoftIRQ::CSoftIRQ (CInterruptSystem *pInterrupt)
+:	m_pInterrupt (pInterrupt),
+#if RASPPI <= 3
+	m_MPHI (pInterrupt),
+#endif
+	m_nPending (0),
+	m_nTriggered (0)
+{
+	assert (s_pThis == 0);
+	s_pThis = this;
+
+	for (unsigned i = 0; i < SOFTIRQ_LINES; i++)
+	{
+		m_pHandler[i] = 0;
+		m_pParam[i] = 0;
+	}
+
+#if RASPPI <= 3
+	m_MPHI.ConnectHandler (InterruptStub, this);
+#else
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_nCore = CMultiCoreSupport::ThisCore ();
+#else
+	m_nCore = 0;
+#endif
+
+	assert (m_pInterrupt != 0);
+	m_pInterrupt->ConnectIRQ (ARM_IRQ_SOFTIRQ, InterruptStub, this);
+#endif
+}
+
+CSoftIRQ::~CSoftIRQ (void)
+{
+#if RASPPI <= 3
+	m_MPHI.DisconnectHandler ();
+#else
+	assert (m_pInterrupt != 0);
+	m_pInterrupt->DisconnectIRQ (ARM_IRQ_SOFTIRQ);
+#endif
+
+	m_pInterrupt = 0;
+
+	s_pThis = 0;
+}
+
+int CSoftIRQ::Connect (TIRQHandler *pHandler, void *pParam)
+{
+	assert (pHandler != 0);
+
+	EnterCritical ();
+
+	for (unsigned i = 0; i < SOFTIRQ_LINES; i++)
+	{
+		if (m_pHandler[i] == 0)
+		{
+			m_pParam[i] = pParam;
+			m_pHandler[i] = pHandler;
+
+			LeaveCritical ();
+
+			return i;
+		}
+	}
+
+	LeaveCritical ();
+
+	return -1;
+}
+
+void CSoftIRQ::Disconnect (unsigned nLine)
+{
+	assert (nLine < SOFTIRQ_LINES);
+
+	EnterCritical ();
+
+	assert (m_pHandler[nLine] != 0);
+	m_pHandler[nLine] = 0;
+	m_pParam[nLine] = 0;
+
+	__atomic_and_fetch (&m_nPending, ~(1U << nLine), __ATOMIC_SEQ_CST);
+
+	LeaveCritical ();
+}
+
+void CSoftIRQ::Trigger (unsigned nLine)
+{
+	assert (nLine < SOFTIRQ_LINES);
+
+	__atomic_or_fetch (&m_nPending, 1U << nLine, __ATOMIC_SEQ_CST);
+
+	// trigger once, until the IRQ handler runs
+	if (AtomicExchange (&m_nTriggered, 1))
+	{
+		return;
+	}
+
+#if RASPPI <= 3
+	m_MPHI.TriggerIRQ ();
+#else
+	CInterruptSystem::SendIPI (m_nCore, ARM_IRQ_SOFTIRQ);
+#endif
+}
+
+CSoftIRQ *CSoftIRQ::Get (void)
+{
+	if (s_pThis == 0)
+	{
+		assert (CurrentExecutionLevel () == TASK_LEVEL);
+
+		new CSoftIRQ (CInterruptSystem::Get ());
+		assert (s_pThis != 0);
+	}
+
+	return s_pThis;
+}
+
+void CSoftIRQ::InterruptHandler (void)
+{
+	// reset before the pending lines are fetched, so that no trigger is missed
+	AtomicSet (&m_nTriggered, 0);
+
+	u32 nPending = __atomic_exchange_n (&m_nPending, 0, __ATOMIC_SEQ_CST);
+	while (nPending != 0)
+	{
+		unsigned nLine = __builtin_ctz (nPending);
+		nPending &= ~(1U << nLine);
+
+		TIRQHandler *pHandler = m_pHandler[nLine];
+		if (pHandler != 0)
+		{
+			(*pHandler) (m_pParam[nLine]);
+		}
+	}
+}
+
+void CSoftIRQ::InterruptStub (void *pParam)
+{
+	CSoftIRQ *pThis = (CSoftIRQ *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
@@ -32,19 +32,26 @@ CDMASoundBuffers::CDMASoundBuffers (boolean	      bDirectionOut,
 				    u32		      nIOAddress,
 				    TDREQ	      DREQ,
 				    unsigned	      nChunkSize,
-				    CInterruptSystem *pInterruptSystem)
+				    CInterruptSystem *pInterruptSystem,
+				    unsigned	      nPeriods)
 :	m_bDirectionOut {bDirectionOut},
 	m_nIOAddress {nIOAddress},
 	m_DREQ {DREQ},
 	m_nChunkSize {nChunkSize},
 	m_pInterruptSystem {pInterruptSystem},
+	m_nPeriods {nPeriods},
 	m_pHandler {0},
 	m_bIRQConnected {FALSE},
 	m_State {StateCreated},
-	m_nDMAChannel {DMA_CHANNEL_MAX+1},
-	m_pDMABuffer {nullptr, nullptr},
-	m_pControlBlock {nullptr, nullptr}
+	m_nDMAChannel {DMA_CHANNEL_MAX+1}
 {
+	assert (2 <= m_nPeriods && m_nPeriods <= DMA_SOUND_MAX_PERIODS);
+
+	for (unsigned i = 0; i < DMA_SOUND_MAX_PERIODS; i++)
+	{
+		m_pDMABuffer[i] = nullptr;
+		m_pControlBlock[i] = nullptr;
+	}
 }
 
 CDMASoundBuffers::~CDMASoundBuffers (void)
@@ -78,10 +85,11 @@ CDMASoundBuffers::~CDMASoundBuffers (void)
 		m_nDMAChannel = DMA_CHANNEL_MAX+1;
 	}
 
-	delete m_pControlBlock[0];
-	delete m_pControlBlock[1];
-	delete [] m_pDMABuffer[0];
-	delete [] m_pDMABuffer[1];
+	for (unsigned i = 0; i < m_nPeriods; i++)
+	{
+		delete m_pControlBlock[i];
+		delete [] m_pDMABuffer[i];
+	}
 }
 
 boolean CDMASoundBuffers::Start (TChunkCompletedHandler *pHandler, void *pParam)
@@ -97,24 +105,25 @@ boolean CDMASoundBuffers::Start (TChunkCompletedHandler *pHandler, void *pParam)
 			return FALSE;
 		}
 
-		// setup and concatenate DMA buffers and control blocks
-		if (   !SetupDMAControlBlock (0)
-		    || !SetupDMAControlBlock (1))
+		// setup and concatenate DMA buffers and control blocks to a ring
+		for (unsigned i = 0; i < m_nPeriods; i++)
 		{
-			m_State = StateFailed;
+			if (!SetupDMAControlBlock (i))
+			{
+				m_State = StateFailed;
 
-			return FALSE;
+				return FALSE;
+			}
 		}
 
-		m_pControlBlock[0]->nNextControlBlockAddress =
-			BUS_ADDRESS ((uintptr) m_pControlBlock[1]);
-		m_pControlBlock[1]->nNextControlBlockAddress =
-			BUS_ADDRESS ((uintptr) m_pControlBlock[0]);
+		for (unsigned i = 0; i < m_nPeriods; i++)
+		{
+			m_pControlBlock[i]->nNextControlBlockAddress =
+				BUS_ADDRESS ((uintptr) m_pControlBlock[(i+1) % m_nPeriods]);
 
-		CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[0],
-						  sizeof (TDMAControlBlock));
-		CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[1],
-						  sizeof (TDMAControlBlock));
+			CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[i],
+							  sizeof (TDMAControlBlock));
+		}
 
 		// enable and reset DMA channel
 		PeripheralEntry ();
@@ -174,19 +183,34 @@ boolean CDMASoundBuffers::Start (TChunkCompletedHandler *pHandler, void *pParam)
 
 	PeripheralExit ();
 
-	// fill buffer 1
-	if (   m_bDirectionOut
-	    && !GetNextChunk (FALSE))
+	// fill the remaining buffers
+	if (!m_bDirectionOut)
+	{
+		return TRUE;
+	}
+
+	for (unsigned i = 1; i < m_nPeriods; i++)
 	{
 		m_SpinLock.Acquire ();
 
-		if (m_State == StateRunning)
+		if (m_State != StateRunning)
+		{
+			m_SpinLock.Release ();
+
+			break;
+		}
+
+		if (!GetNextChunk (FALSE))
 		{
 			PeripheralEntry ();
 			write32 (ARM_DMACHAN_NEXTCONBK (m_nDMAChannel), 0);
 			PeripheralExit ();
 
 			m_State = StateTerminating;
+
+			m_SpinLock.Release ();
+
+			break;
 		}
 
 		m_SpinLock.Release ();
@@ -218,7 +242,7 @@ boolean CDMASoundBuffers::IsActive (void) const
 
 boolean CDMASoundBuffers::GetNextChunk (boolean bFirstCall)
 {
-	assert (m_nNextBuffer <= 1);
+	assert (m_nNextBuffer < m_nPeriods);
 	assert (m_pDMABuffer[m_nNextBuffer] != 0);
 
 	unsigned nChunkSize;
@@ -247,14 +271,17 @@ boolean CDMASoundBuffers::GetNextChunk (boolean bFirstCall)
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pDMABuffer[m_nNextBuffer], nTransferLength);
 	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock[m_nNextBuffer], sizeof (TDMAControlBlock));
 
-	m_nNextBuffer ^= 1;
+	if (++m_nNextBuffer == m_nPeriods)
+	{
+		m_nNextBuffer = 0;
+	}
 
 	return TRUE;
 }
 
 boolean CDMASoundBuffers::PutChunk (void)
 {
-	assert (m_nNextBuffer <= 1);
+	assert (m_nNextBuffer < m_nPeriods);
 	assert (m_pDMABuffer[m_nNextBuffer] != 0);
 
 	// TODO: must not write DMA buffer from handler (read-only)
@@ -264,7 +291,10 @@ boolean CDMASoundBuffers::PutChunk (void)
 	assert (m_pHandler != 0);
 	(*m_pHandler) (TRUE, m_pDMABuffer[m_nNextBuffer], m_nChunkSize, m_pParam);
 
-	m_nNextBuffer ^= 1;
+	if (++m_nNextBuffer == m_nPeriods)
+	{
+		m_nNextBuffer = 0;
+	}
 
 	return TRUE;
 }
@@ -349,7 +379,7 @@ void CDMASoundBuffers::InterruptStub (void *pParam)
 
 boolean CDMASoundBuffers::SetupDMAControlBlock (unsigned nID)
 {
-	assert (nID <= 1);
+	assert (nID < m_nPeriods);
 
 	assert (m_nChunkSize > 0);
 	m_pDMABuffer[nID] = new (HEAP_DMA30) u32[m_nChunkSize];
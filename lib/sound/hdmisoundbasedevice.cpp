@@ -334,6 +334,11 @@ boolean CHDMISoundBaseDevice::IsActive (void) const
 	       || m_State == HDMISoundCancelled;
 }
 
+unsigned CHDMISoundBaseDevice::GetHWTXBufferFrames (void) const
+{
+	return 2 * m_nChunkSize / GetHWTXChannels ();		// two DMA buffers
+}
+
 boolean CHDMISoundBaseDevice::IsWritable (void)
 {
 	assert (m_bUsePolling);
@@ -150,7 +150,8 @@ CI2SSoundBaseDevice::CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 					  CI2CMaster       *pI2CMaster,
 					  u8                ucI2CAddress,
 					  TDeviceMode       DeviceMode,
-					  unsigned	    nHWChannels)
+					  unsigned	    nHWChannels,
+					  unsigned	    nPeriods)
 :
 #ifdef USE_I2S_SOUND_IRQ
 	m_pInterruptSystem (pInterrupt),
@@ -343,6 +344,30 @@ CSoundController *CI2SSoundBaseDevice::GetController (void)
 	return m_pController;
 }
 
+#ifndef USE_I2S_SOUND_IRQ
+
+unsigned CI2SSoundBaseDevice::GetHWTXBufferFrames (void) const
+{
+	if (m_DeviceMode != DeviceModeTXOnly)
+	{
+		return 0;
+	}
+
+	return 2 * m_nChunkSize / m_nHWChannels;	// two DMA buffers
+}
+
+unsigned CI2SSoundBaseDevice::GetHWRXBufferFrames (void) const
+{
+	if (m_DeviceMode != DeviceModeRXOnly)
+	{
+		return 0;
+	}
+
+	return m_nChunkSize / m_nHWChannels;
+}
+
+#endif
+
 boolean CI2SSoundBaseDevice::RunI2S (void)
 {
 	// check device configuration
@@ -93,7 +93,8 @@ CI2SSoundBaseDevice::CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 					  CI2CMaster       *pI2CMaster,
 					  u8                ucI2CAddress,
 					  TDeviceMode       DeviceMode,
-					  unsigned	    nHWChannels)
+					  unsigned	    nHWChannels,
+					  unsigned	    nPeriods)
 :	CSoundBaseDevice (SoundFormatSigned24_32, 0, nSampleRate),
 	m_nSampleRate (nSampleRate),
 	m_nChunkSize (nChunkSize),
@@ -103,8 +104,8 @@ CI2SSoundBaseDevice::CI2SSoundBaseDevice (CInterruptSystem *pInterrupt,
 	m_DeviceMode (DeviceMode),
 	m_Clock (GPIOClockPCM, GPIOClockSourcePLLD),
 	m_bError (FALSE),
-	m_TXBuffers (TRUE, ARM_PCM_FIFO_A, DREQSourcePCMTX, nChunkSize, pInterrupt),
-	m_RXBuffers (FALSE, ARM_PCM_FIFO_A, DREQSourcePCMRX, nChunkSize, pInterrupt),
+	m_TXBuffers (TRUE, ARM_PCM_FIFO_A, DREQSourcePCMTX, nChunkSize, pInterrupt, nPeriods),
+	m_RXBuffers (FALSE, ARM_PCM_FIFO_A, DREQSourcePCMRX, nChunkSize, pInterrupt, nPeriods),
 	m_bControllerInited (FALSE),
 	m_pController (nullptr)
 {
@@ -272,6 +273,27 @@ CSoundController *CI2SSoundBaseDevice::GetController (void)
 	return m_pController;
 }
 
+unsigned CI2SSoundBaseDevice::GetHWTXBufferFrames (void) const
+{
+	if (m_DeviceMode == DeviceModeRXOnly)
+	{
+		return 0;
+	}
+
+	return m_TXBuffers.GetPeriods () * m_nChunkSize / GetHWTXChannels ();
+}
+
+unsigned CI2SSoundBaseDevice::GetHWRXBufferFrames (void) const
+{
+	if (m_DeviceMode == DeviceModeTXOnly)
+	{
+		return 0;
+	}
+
+	// received samples are handed over, when a whole chunk has been completed
+	return m_nChunkSize / GetHWRXChannels ();
+}
+
 void CI2SSoundBaseDevice::RunI2S (void)
 {
 	PeripheralEntry ();
@@ -209,6 +209,11 @@ boolean CPWMSoundBaseDevice::IsActive (void) const
 	       || State == StateCanceled;
 }
 
+unsigned CPWMSoundBaseDevice::GetHWTXBufferFrames (void) const
+{
+	return 2 * m_nChunkSize / GetHWTXChannels ();		// two DMA buffers
+}
+
 boolean CPWMSoundBaseDevice::RunPWM (void)
 {
 	if (!m_Clock.StartRate (CLOCK_RATE))
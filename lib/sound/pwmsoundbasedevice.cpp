@@ -307,6 +307,11 @@ boolean CPWMSoundBaseDevice::IsActive (void) const
 	return m_State != PWMSoundIdle ? TRUE : FALSE;
 }
 
+unsigned CPWMSoundBaseDevice::GetHWTXBufferFrames (void) const
+{
+	return 2 * m_nChunkSize / GetHWTXChannels ();		// two DMA buffers
+}
+
 boolean CPWMSoundBaseDevice::GetNextChunk (void)
 {
 	assert (m_pDMABuffer[m_nNextBuffer] != 0);
@@ -18,10 +18,16 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/sound/soundbasedevice.h>
+#include <circle/metrics.h>
 #include <circle/macros.h>
 #include <circle/util.h>
 #include <assert.h>
 
+static CMetricCounter s_Underruns ("circle_sound_underruns_total",
+				   "Output chunks, which had to be filled up with silence");
+static CMetricCounter s_Overruns ("circle_sound_overruns_total",
+				  "Input chunks, which did not fit into the read queue completely");
+
 CSoundBaseDevice::CSoundBaseDevice (void)
 :	m_HWFormat (SoundFormatUnknown),
 	m_nQueueSize (0),
@@ -32,6 +38,7 @@ CSoundBaseDevice::CSoundBaseDevice (void)
 	m_nInPtr (0),
 	m_nOutPtr (0),
 	m_pCallback (0),
+	m_pPipelineStage (0),
 	m_nReadQueueSize (0),
 	m_nHaveDataThreshold (0),
 	m_ReadFormat (SoundFormatUnknown),
@@ -40,7 +47,8 @@ CSoundBaseDevice::CSoundBaseDevice (void)
 	m_nReadInPtr (0),
 	m_nReadOutPtr (0),
 	m_pReadCallback (0),
-	m_pReadCallbackParam (0)
+	m_pReadCallbackParam (0),
+	m_nReadOverrunFrames (0)
 {
 }
 
@@ -55,6 +63,7 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 	m_nInPtr (0),
 	m_nOutPtr (0),
 	m_pCallback (0),
+	m_pPipelineStage (0),
 	m_nReadQueueSize (0),
 	m_nHaveDataThreshold (0),
 	m_ReadFormat (SoundFormatUnknown),
@@ -63,7 +72,8 @@ CSoundBaseDevice::CSoundBaseDevice (TSoundFormat HWFormat, u32 nRange32, unsigne
 	m_nReadInPtr (0),
 	m_nReadOutPtr (0),
 	m_pReadCallback (0),
-	m_pReadCallbackParam (0)
+	m_pReadCallbackParam (0),
+	m_nReadOverrunFrames (0)
 {
 	Setup (HWFormat, nRange32, nSampleRate, 2, 2, bSwapChannels);
 }
@@ -186,6 +196,35 @@ int CSoundBaseDevice::GetRangeMax (void) const
 	return m_nRangeMax;
 }
 
+TSoundFormat CSoundBaseDevice::GetHWFormat (void) const
+{
+	return m_HWFormat;
+}
+
+unsigned CSoundBaseDevice::GetTXLatencyFrames (void)
+{
+	unsigned nFrames = GetHWTXBufferFrames ();
+
+	if (m_nQueueSize > 0)
+	{
+		nFrames += GetQueueFramesAvail ();
+	}
+
+	return nFrames;
+}
+
+unsigned CSoundBaseDevice::GetRXLatencyFrames (void)
+{
+	unsigned nFrames = GetHWRXBufferFrames ();
+
+	if (m_nReadQueueSize > 0)
+	{
+		nFrames += GetReadQueueFramesAvail ();
+	}
+
+	return nFrames;
+}
+
 // Output /////////////////////////////////////////////////////////////
 
 boolean CSoundBaseDevice::AllocateQueue (unsigned nSizeMsecs)
@@ -193,8 +232,9 @@ boolean CSoundBaseDevice::AllocateQueue (unsigned nSizeMsecs)
 	assert (m_pQueue == 0);
 	assert (1 <= nSizeMsecs && nSizeMsecs <= 1000);
 
-	// 1 byte remains free
-	m_nQueueSize = (m_nHWTXFrameSize*m_nSampleRate*nSizeMsecs + 999) / 1000 + 1;
+	// 1 frame remains free, so that the queue pointers are always frame aligned
+	unsigned nSizeFrames = (m_nSampleRate*nSizeMsecs + 999) / 1000;
+	m_nQueueSize = m_nHWTXFrameSize * (nSizeFrames+1);
 
 	m_pQueue = new u8[m_nQueueSize];
 	if (m_pQueue == 0)
@@ -212,8 +252,8 @@ boolean CSoundBaseDevice::AllocateQueueFrames (unsigned nSizeFrames)
 	assert (m_pQueue == 0);
 	assert (1 <= nSizeFrames && nSizeFrames <= m_nSampleRate);
 
-	// 1 byte remains free
-	m_nQueueSize = m_nHWTXFrameSize*nSizeFrames + 1;
+	// 1 frame remains free, so that the queue pointers are always frame aligned
+	m_nQueueSize = m_nHWTXFrameSize * (nSizeFrames+1);
 
 	m_pQueue = new u8[m_nQueueSize];
 	if (m_pQueue == 0)
@@ -271,6 +311,8 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 
 	m_SpinLock.Acquire ();
 
+	unsigned nQueuedFrames = GetQueueBytesAvail () / m_nHWTXFrameSize;
+
 	if (   m_HWFormat == m_WriteFormat
 	    && m_nWriteChannels == m_nHWTXChannels
 	    && !m_bSwapChannels)
@@ -291,96 +333,101 @@ int CSoundBaseDevice::Write (const void *pBuffer, size_t nCount)
 			nResult = nBytes;
 		}
 	}
-	else if (   m_nHWTXChannels == 2
-		 && m_nWriteChannels <= 2)
+	else
 	{
-		while (   nCount >= m_nWriteFrameSize
-		       && GetQueueBytesFree () >= m_nHWTXFrameSize)
+		// convert blocks of frames, channel by channel (or all samples at once)
+		u8 Block[SOUND_BLOCK_SIZE];
+		unsigned nBlockFrames = sizeof Block / m_nHWTXFrameSize;
+		assert (nBlockFrames > 0);
+
+		while (nCount >= m_nWriteFrameSize)
 		{
-			u8 Frame[2 * SOUND_MAX_SAMPLE_SIZE];
+			unsigned nFrames = nCount / m_nWriteFrameSize;
 
-			if (!m_bSwapChannels)
+			unsigned nFramesFree = GetQueueBytesFree () / m_nHWTXFrameSize;
+			if (nFrames > nFramesFree)
 			{
-				ConvertSoundFormat (Frame, pBuffer8);
-				pBuffer8 += m_nWriteSampleSize;
-
-				if (m_nWriteChannels == 2)
-				{
-					ConvertSoundFormat (Frame+m_nHWSampleSize, pBuffer8);
-					pBuffer8 += m_nWriteSampleSize;
-				}
-				else
-				{
-					memcpy (Frame+m_nHWSampleSize, Frame, m_nHWSampleSize);
-				}
+				nFrames = nFramesFree;
 			}
-			else
-			{
-				ConvertSoundFormat (Frame+m_nHWSampleSize, pBuffer8);
-				pBuffer8 += m_nWriteSampleSize;
 
-				if (m_nWriteChannels == 2)
-				{
-					ConvertSoundFormat (Frame, pBuffer8);
-					pBuffer8 += m_nWriteSampleSize;
-				}
-				else
-				{
-					memcpy (Frame, Frame+m_nHWSampleSize, m_nHWSampleSize);
-				}
+			if (nFrames > nBlockFrames)
+			{
+				nFrames = nBlockFrames;
 			}
 
-			Enqueue (Frame, m_nHWTXFrameSize);
-
-			nCount -= m_nWriteFrameSize;
-			nResult += m_nWriteFrameSize;
-		}
-	}
-	else
-	{
-		unsigned nMinChannels = m_nHWTXChannels;
-		unsigned nNullBytes = 0;
-		if (m_nWriteChannels < m_nHWTXChannels)
-		{
-			nMinChannels = m_nWriteChannels;
-			nNullBytes = (m_nHWTXChannels - m_nWriteChannels) * m_nHWSampleSize;
-		}
-
-		while (   nCount >= m_nWriteFrameSize
-		       && GetQueueBytesFree () >= m_nHWTXFrameSize)
-		{
-			u8 Frame[SOUND_MAX_FRAME_SIZE];
-			u8 *pFrame = Frame;
-
-			for (unsigned i = 0; i < nMinChannels; i++)
+			if (!nFrames)
 			{
-				ConvertSoundFormat (pFrame, pBuffer8);
-
-				pFrame += m_nHWSampleSize;
-				pBuffer8 += m_nWriteSampleSize;
+				break;
 			}
 
-			if (nNullBytes != 0)
+			if (   m_nWriteChannels == m_nHWTXChannels
+			    && !m_bSwapChannels)
+			{
+				ConvertSoundBlock (Block, m_nHWSampleSize, pBuffer8, m_nWriteSampleSize,
+						   nFrames * m_nHWTXChannels);
+			}
+			else
 			{
-				memcpy (pFrame, m_NullFrame, nNullBytes);
+				for (unsigned nChannel = 0; nChannel < m_nHWTXChannels; nChannel++)
+				{
+					unsigned nFromChannel = nChannel;
+					if (   m_nHWTXChannels == 2
+					    && m_nWriteChannels <= 2)
+					{
+						if (m_nWriteChannels == 1)
+						{
+							nFromChannel = 0;
+						}
+						else if (m_bSwapChannels)
+						{
+							nFromChannel ^= 1;
+						}
+					}
+
+					u8 *pTo = Block + nChannel * m_nHWSampleSize;
+
+					if (nFromChannel < m_nWriteChannels)
+					{
+						ConvertSoundBlock (pTo, m_nHWTXFrameSize,
+								   pBuffer8 + nFromChannel * m_nWriteSampleSize,
+								   m_nWriteFrameSize, nFrames);
+					}
+					else
+					{
+						for (unsigned i = 0; i < nFrames; i++)
+						{
+							memcpy (pTo, m_NullFrame, m_nHWSampleSize);
+
+							pTo += m_nHWTXFrameSize;
+						}
+					}
+				}
 			}
 
-			Enqueue (Frame, m_nHWTXFrameSize);
+			Enqueue (Block, nFrames * m_nHWTXFrameSize);
 
-			nCount -= m_nWriteFrameSize;
-			nResult += m_nWriteFrameSize;
+			pBuffer8 += nFrames * m_nWriteFrameSize;
+			nCount -= nFrames * m_nWriteFrameSize;
+			nResult += nFrames * m_nWriteFrameSize;
 		}
 	}
 
 	m_SpinLock.Release ();
 
+	// the written samples are sent after the frames, which were queued before
+	if (   m_pPipelineStage != 0
+	    && nResult > 0)
+	{
+		m_pPipelineStage->Record ((unsigned) ((u64) nQueuedFrames * 1000000 / m_nSampleRate));
+	}
+
 	return nResult;
 }
 
 unsigned CSoundBaseDevice::GetQueueSizeFrames (void)
 {
 	assert (m_nQueueSize > 0);
-	return m_nQueueSize / m_nHWTXFrameSize;
+	return m_nQueueSize / m_nHWTXFrameSize - 1;
 }
 
 unsigned CSoundBaseDevice::GetQueueFramesAvail (void)
@@ -396,6 +443,47 @@ unsigned CSoundBaseDevice::GetQueueFramesAvail (void)
 	return nQueueBytesAvail / m_nHWTXFrameSize;
 }
 
+unsigned CSoundBaseDevice::AcquireWriteRegion (void **ppBuffer)
+{
+	assert (ppBuffer != 0);
+	assert (m_pQueue != 0);
+
+	unsigned nInPtr = m_nInPtr;
+	unsigned nBytes = GetQueueBytesFree ();
+
+	// contiguous part only
+	if (nBytes > m_nQueueSize - nInPtr)
+	{
+		nBytes = m_nQueueSize - nInPtr;
+	}
+
+	// the consumer must have read the data, before it is overwritten
+	DataMemBarrier ();
+
+	*ppBuffer = m_pQueue + nInPtr;
+
+	assert (nBytes % m_nHWTXFrameSize == 0);
+	return nBytes / m_nHWTXFrameSize;
+}
+
+void CSoundBaseDevice::CommitWriteRegion (unsigned nFrames)
+{
+	unsigned nBytes = nFrames * m_nHWTXFrameSize;
+	assert (nBytes <= GetQueueBytesFree ());
+	assert (m_nInPtr + nBytes <= m_nQueueSize);
+
+	unsigned nPtr = m_nInPtr + nBytes;
+	if (nPtr == m_nQueueSize)
+	{
+		nPtr = 0;
+	}
+
+	// the data must be written, before the consumer sees the new pointer
+	DataMemBarrier ();
+
+	m_nInPtr = nPtr;
+}
+
 void CSoundBaseDevice::RegisterNeedDataCallback (TSoundDataCallback *pCallback, void *pParam)
 {
 	assert (m_pCallback == 0);
@@ -417,8 +505,9 @@ boolean CSoundBaseDevice::AllocateReadQueue (unsigned nSizeMsecs)
 	assert (m_pReadQueue == 0);
 	assert (1 <= nSizeMsecs && nSizeMsecs <= 1000);
 
-	// 1 byte remains free
-	m_nReadQueueSize = (m_nHWRXFrameSize*m_nSampleRate*nSizeMsecs + 999) / 1000 + 1;
+	// 1 frame remains free, so that the queue pointers are always frame aligned
+	unsigned nSizeFrames = (m_nSampleRate*nSizeMsecs + 999) / 1000;
+	m_nReadQueueSize = m_nHWRXFrameSize * (nSizeFrames+1);
 
 	m_pReadQueue = new u8[m_nReadQueueSize];
 	if (m_pReadQueue == 0)
@@ -436,8 +525,8 @@ boolean CSoundBaseDevice::AllocateReadQueueFrames (unsigned nSizeFrames)
 	assert (m_pReadQueue == 0);
 	assert (1 <= nSizeFrames && nSizeFrames <= m_nSampleRate);
 
-	// 1 byte remains free
-	m_nReadQueueSize = m_nHWRXFrameSize*nSizeFrames + 1;
+	// 1 frame remains free, so that the queue pointers are always frame aligned
+	m_nReadQueueSize = m_nHWRXFrameSize * (nSizeFrames+1);
 
 	m_pReadQueue = new u8[m_nReadQueueSize];
 	if (m_pReadQueue == 0)
@@ -600,10 +689,80 @@ int CSoundBaseDevice::Read (void *pBuffer, size_t nCount)
 	return nResult;
 }
 
+unsigned CSoundBaseDevice::ReadPlanar (void *ppBuffers[], unsigned nFrames)
+{
+	assert (m_ReadFormat < SoundFormatUnknown);
+	assert (ppBuffers != 0);
+
+	unsigned nResult = 0;
+
+	m_ReadSpinLock.Acquire ();
+
+	// de-interleave blocks of frames, channel by channel
+	u8 Block[SOUND_BLOCK_SIZE];
+	unsigned nBlockFrames = sizeof Block / m_nHWRXFrameSize;
+	assert (nBlockFrames > 0);
+
+	while (nFrames > 0)
+	{
+		unsigned nBlock = GetReadQueueBytesAvail () / m_nHWRXFrameSize;
+		if (nBlock > nFrames)
+		{
+			nBlock = nFrames;
+		}
+
+		if (nBlock > nBlockFrames)
+		{
+			nBlock = nBlockFrames;
+		}
+
+		if (!nBlock)
+		{
+			break;
+		}
+
+		ReadDequeue (Block, nBlock * m_nHWRXFrameSize);
+
+		for (unsigned i = 0; i < m_nReadChannels; i++)
+		{
+			assert (ppBuffers[i] != 0);
+			u8 *pTo = static_cast<u8 *> (ppBuffers[i]) + nResult * m_nReadSampleSize;
+
+			unsigned nChannel = i;
+			if (   m_nReadChannels == 1
+			    && m_nHWRXChannels > 1
+			    && !m_bLeftChannel)
+			{
+				nChannel = 1;
+			}
+
+			if (nChannel < m_nHWRXChannels)
+			{
+				ConvertReadSoundBlock (pTo, m_nReadSampleSize,
+						       Block + nChannel * m_nHWSampleSize,
+						       m_nHWRXFrameSize, nBlock);
+			}
+			else
+			{
+				// missing channels are filled with the null sample
+				ConvertReadSoundBlock (pTo, m_nReadSampleSize,
+						       m_NullFrame, 0, nBlock);
+			}
+		}
+
+		nResult += nBlock;
+		nFrames -= nBlock;
+	}
+
+	m_ReadSpinLock.Release ();
+
+	return nResult;
+}
+
 unsigned CSoundBaseDevice::GetReadQueueSizeFrames (void)
 {
 	assert (m_nReadQueueSize > 0);
-	return m_nReadQueueSize / m_nHWRXFrameSize;
+	return m_nReadQueueSize / m_nHWRXFrameSize - 1;
 }
 
 unsigned CSoundBaseDevice::GetReadQueueFramesAvail (void)
@@ -619,6 +778,52 @@ unsigned CSoundBaseDevice::GetReadQueueFramesAvail (void)
 	return nReadQueueBytesAvail / m_nHWRXFrameSize;
 }
 
+unsigned CSoundBaseDevice::GetReadOverrunFrames (void) const
+{
+	return m_nReadOverrunFrames;
+}
+
+unsigned CSoundBaseDevice::AcquireReadRegion (const void **ppBuffer)
+{
+	assert (ppBuffer != 0);
+	assert (m_pReadQueue != 0);
+
+	unsigned nOutPtr = m_nReadOutPtr;
+	unsigned nBytes = GetReadQueueBytesAvail ();
+
+	// contiguous part only
+	if (nBytes > m_nReadQueueSize - nOutPtr)
+	{
+		nBytes = m_nReadQueueSize - nOutPtr;
+	}
+
+	// the producer must have written the data, before it is read
+	DataMemBarrier ();
+
+	*ppBuffer = m_pReadQueue + nOutPtr;
+
+	assert (nBytes % m_nHWRXFrameSize == 0);
+	return nBytes / m_nHWRXFrameSize;
+}
+
+void CSoundBaseDevice::ReleaseReadRegion (unsigned nFrames)
+{
+	unsigned nBytes = nFrames * m_nHWRXFrameSize;
+	assert (nBytes <= GetReadQueueBytesAvail ());
+	assert (m_nReadOutPtr + nBytes <= m_nReadQueueSize);
+
+	unsigned nPtr = m_nReadOutPtr + nBytes;
+	if (nPtr == m_nReadQueueSize)
+	{
+		nPtr = 0;
+	}
+
+	// the data must be read, before the producer sees the new pointer
+	DataMemBarrier ();
+
+	m_nReadOutPtr = nPtr;
+}
+
 void CSoundBaseDevice::RegisterHaveDataCallback (TSoundDataCallback *pCallback, void *pParam)
 {
 	assert (m_pReadCallback == 0);
@@ -675,75 +880,188 @@ u32 CSoundBaseDevice::ConvertIEC958Sample (u32 nSample, unsigned nFrame)
 	return nSample;
 }
 
-void CSoundBaseDevice::ConvertSoundFormat (void *pTo, const void *pFrom)
+// The format switch is done once per block, outside of the sample loops, so that the
+// compiler generates specialized (and vectorized with NEON, where possible) code for
+// each pair of write and hardware format.
+
+template <TSoundFormat Format>
+static inline s32 ReadSample (const u8 *p);		// returns left aligned 32-bit value
+
+template <>
+inline s32 ReadSample<SoundFormatUnsigned8> (const u8 *p)
 {
-	s32 nValue = 0;
+	return (s32) ((u32) (*p ^ 0x80) << 24);
+}
 
-	switch (m_WriteFormat)
+template <>
+inline s32 ReadSample<SoundFormatSigned16> (const u8 *p)
+{
+	return (s32) ((u32) *reinterpret_cast<const u16 *> (p) << 16);
+}
+
+template <>
+inline s32 ReadSample<SoundFormatSigned24> (const u8 *p)
+{
+	return (s32) ((p[0] | (u32) p[1] << 8 | (u32) p[2] << 16) << 8);
+}
+
+template <>
+inline s32 ReadSample<SoundFormatSigned24_32> (const u8 *p)
+{
+	return (s32) (*reinterpret_cast<const u32 *> (p) << 8);
+}
+
+template <TSoundFormat Format>
+static inline void WriteSample (u8 *p, s32 nValue, int nRangeMax);
+
+template <>
+inline void WriteSample<SoundFormatUnsigned8> (u8 *p, s32 nValue, int nRangeMax)
+{
+	*p = (u8) ((nValue >> 24) ^ 0x80);
+}
+template <>
+inline void WriteSample<SoundFormatSigned16> (u8 *p, s32 nValue, int nRangeMax)
+{
+	*reinterpret_cast<s16 *> (p) = nValue >> 16;
+}
+
+template <>
+inline void WriteSample<SoundFormatSigned24> (u8 *p, s32 nValue, int nRangeMax)
+{
+	// occupies 3 bytes only, a 32-bit write would overwrite the next sample
+	nValue >>= 8;
+	p[0] = nValue & 0xFF;
+	p[1] = (nValue >> 8) & 0xFF;
+	p[2] = (nValue >> 16) & 0xFF;
+}
+
+template <>
+inline void WriteSample<SoundFormatSigned24_32> (u8 *p, s32 nValue, int nRangeMax)
+{
+	*reinterpret_cast<s32 *> (p) = nValue >> 8;
+}
+
+template <>
+inline void WriteSample<SoundFormatUnsigned32> (u8 *p, s32 nValue, int nRangeMax)
+{
+	s64 llValue = (s64) nValue;
+	llValue += 1U << 31;
+	llValue *= nRangeMax;
+	llValue >>= 32;
+
+	*reinterpret_cast<u32 *> (p) = (u32) llValue;
+}
+
+template <>
+inline void WriteSample<SoundFormatIEC958> (u8 *p, s32 nValue, int nRangeMax)
+{
+	nValue >>= 4;
+	nValue &= 0xFFFFFF0;
+	if (parity32 (nValue))
 	{
-	case SoundFormatUnsigned8: {
-		const u8 *pValue = reinterpret_cast<const u8 *> (pFrom);
-		nValue = *pValue;
-		nValue -= 128;
-		nValue <<= 24;
-		} break;
+		nValue |= 0x80000000;
+	}
 
-	case SoundFormatSigned16: {
-		const s16 *pValue = reinterpret_cast<const s16 *> (pFrom);
-		nValue = *pValue;
-		nValue <<= 16;
-		} break;
+	*reinterpret_cast<s32 *> (p) = nValue;
+}
 
-	case SoundFormatSigned24:
-	case SoundFormatSigned24_32: {
-		const u32 *pValue = reinterpret_cast<const u32 *> (pFrom);
-		nValue = *pValue & 0xFFFFFF;
-		nValue <<= 8;
-		} break;
+template <TSoundFormat From, TSoundFormat To>
+static void ConvertSamples (u8 *pTo, unsigned nToStride, const u8 *pFrom, unsigned nFromStride,
+			    unsigned nSamples, unsigned nFromSize, unsigned nToSize, int nRangeMax)
+{
+	if (   nFromStride == nFromSize
+	    && nToStride == nToSize)
+	{
+		// contiguous samples, the strides are constant for the compiler here
+		for (unsigned i = 0; i < nSamples; i++)
+		{
+			WriteSample<To> (pTo + i*nToSize, ReadSample<From> (pFrom + i*nFromSize),
+					 nRangeMax);
+		}
 
-	case SoundFormatUnknown:
-		memcpy (pTo, pFrom, m_nWriteSampleSize);
 		return;
+	}
+
+	while (nSamples--)
+	{
+		WriteSample<To> (pTo, ReadSample<From> (pFrom), nRangeMax);
+
+		pTo += nToStride;
+		pFrom += nFromStride;
+	}
+}
+
+template <TSoundFormat From>
+static void ConvertSamplesTo (TSoundFormat To, u8 *pTo, unsigned nToStride,
+			      const u8 *pFrom, unsigned nFromStride, unsigned nSamples,
+			      unsigned nFromSize, unsigned nToSize, int nRangeMax)
+{
+	switch (To)
+	{
+#define CONVERT_TO(format)	case format:						\
+					ConvertSamples<From, format> (pTo, nToStride,	\
+						pFrom, nFromStride, nSamples,		\
+						nFromSize, nToSize, nRangeMax);		\
+					break;
+	CONVERT_TO (SoundFormatUnsigned8)
+	CONVERT_TO (SoundFormatSigned16)
+	CONVERT_TO (SoundFormatSigned24)
+	CONVERT_TO (SoundFormatSigned24_32)
+	CONVERT_TO (SoundFormatUnsigned32)
+	CONVERT_TO (SoundFormatIEC958)
+#undef CONVERT_TO
 
 	default:
 		assert (0);
 		break;
 	}
+}
 
-	switch (m_HWFormat)
-	{
-	case SoundFormatSigned16: {
-		s16 *pValue = reinterpret_cast<s16 *> (pTo);
-		*pValue = nValue >> 16;
-		} break;
-
-	case SoundFormatSigned24:
-	case SoundFormatSigned24_32: {
-		s32 *pValue = reinterpret_cast<s32 *> (pTo);
-		*pValue = nValue >> 8;
-		} break;
+void CSoundBaseDevice::ConvertSoundBlock (void *pTo, unsigned nToStride,
+					  const void *pFrom, unsigned nFromStride, unsigned nSamples)
+{
+	u8 *pTo8 = static_cast<u8 *> (pTo);
+	const u8 *pFrom8 = static_cast<const u8 *> (pFrom);
 
-	case SoundFormatUnsigned32: {
-		s64 llValue = (s64) nValue;
-		llValue += 1U << 31;
-		llValue *= m_nRangeMax;
-		llValue >>= 32;
+	switch (m_WriteFormat)
+	{
+#define CONVERT_FROM(format)	case format:						\
+					ConvertSamplesTo<format> (m_HWFormat, pTo8,	\
+						nToStride, pFrom8, nFromStride,		\
+						nSamples, m_nWriteSampleSize,		\
+						m_nHWSampleSize, m_nRangeMax);		\
+					break;
+	CONVERT_FROM (SoundFormatUnsigned8)
+	CONVERT_FROM (SoundFormatSigned16)
+	CONVERT_FROM (SoundFormatSigned24)
+	CONVERT_FROM (SoundFormatSigned24_32)
+#undef CONVERT_FROM
 
-		u32 *pValue = reinterpret_cast<u32 *> (pTo);
-		*pValue = (u32) llValue;
-		} break;
+	default:
+		assert (0);
+		break;
+	}
+}
 
-	case SoundFormatIEC958: {
-		nValue >>= 4;
-		nValue &= 0xFFFFFF0;
-		if (parity32 (nValue))
-		{
-			nValue |= 0x80000000;
-		}
+void CSoundBaseDevice::ConvertReadSoundBlock (void *pTo, unsigned nToStride,
+					      const void *pFrom, unsigned nFromStride,
+					      unsigned nSamples)
+{
+	u8 *pTo8 = static_cast<u8 *> (pTo);
+	const u8 *pFrom8 = static_cast<const u8 *> (pFrom);
 
-		s32 *pValue = reinterpret_cast<s32 *> (pTo);
-		*pValue = nValue;
-		} break;
+	switch (m_HWFormat)
+	{
+#define CONVERT_FROM(format)	case format:						\
+					ConvertSamplesTo<format> (m_ReadFormat, pTo8,	\
+						nToStride, pFrom8, nFromStride,		\
+						nSamples, m_nHWSampleSize,		\
+						m_nReadSampleSize, m_nRangeMax);	\
+					break;
+	CONVERT_FROM (SoundFormatSigned16)
+	CONVERT_FROM (SoundFormatSigned24)
+	CONVERT_FROM (SoundFormatSigned24_32)
+#undef CONVERT_FROM
 
 	default:
 		assert (0);
@@ -779,6 +1097,11 @@ unsigned CSoundBaseDevice::GetChunkInternal (void *pBuffer, unsigned nChunkSize)
 
 	m_SpinLock.Release ();
 
+	if (nBytes < nChunkSizeBytes)
+	{
+		s_Underruns.Increment ();
+	}
+
 	while (nBytes < nChunkSizeBytes)
 	{
 		memcpy (pBuffer8, m_NullFrame, m_nHWTXFrameSize);
@@ -841,12 +1164,14 @@ unsigned CSoundBaseDevice::GetQueueBytesFree (void)
 	assert (m_nInPtr < m_nQueueSize);
 	assert (m_nOutPtr < m_nQueueSize);
 
-	if (m_nOutPtr <= m_nInPtr)
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	if (nOutPtr <= nInPtr)
 	{
-		return m_nQueueSize+m_nOutPtr-m_nInPtr-1;
+		return m_nQueueSize+nOutPtr-nInPtr-m_nHWTXFrameSize;
 	}
 
-	return m_nOutPtr-m_nInPtr-1;
+	return nOutPtr-nInPtr-m_nHWTXFrameSize;
 }
 
 unsigned CSoundBaseDevice::GetQueueBytesAvail (void)
@@ -855,12 +1180,14 @@ unsigned CSoundBaseDevice::GetQueueBytesAvail (void)
 	assert (m_nInPtr < m_nQueueSize);
 	assert (m_nOutPtr < m_nQueueSize);
 
-	if (m_nInPtr < m_nOutPtr)
+	unsigned nInPtr = m_nInPtr;
+	unsigned nOutPtr = m_nOutPtr;
+	if (nInPtr < nOutPtr)
 	{
-		return m_nQueueSize+m_nInPtr-m_nOutPtr;
+		return m_nQueueSize+nInPtr-nOutPtr;
 	}
 
-	return m_nInPtr-m_nOutPtr;
+	return nInPtr-nOutPtr;
 }
 
 void CSoundBaseDevice::Enqueue (const void *pBuffer, unsigned nCount)
@@ -870,15 +1197,27 @@ void CSoundBaseDevice::Enqueue (const void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+
+	// copy in up to two parts, if the queue wraps around
+	unsigned nFirst = m_nQueueSize - m_nInPtr;
+	if (nFirst > nCount)
 	{
-		m_pQueue[m_nInPtr] = *p++;
+		nFirst = nCount;
+	}
 
-		if (++m_nInPtr == m_nQueueSize)
-		{
-			m_nInPtr = 0;
-		}
+	memcpy (m_pQueue + m_nInPtr, p, nFirst);
+	memcpy (m_pQueue, p + nFirst, nCount - nFirst);
+
+	unsigned nPtr = m_nInPtr + nCount;
+	if (nPtr >= m_nQueueSize)
+	{
+		nPtr -= m_nQueueSize;
 	}
+
+	// the data must be accessed, before the other side sees the new pointer
+	DataMemBarrier ();
+
+	m_nInPtr = nPtr;
 }
 
 void CSoundBaseDevice::Dequeue (void *pBuffer, unsigned nCount)
@@ -888,15 +1227,27 @@ void CSoundBaseDevice::Dequeue (void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+
+	// copy in up to two parts, if the queue wraps around
+	unsigned nFirst = m_nQueueSize - m_nOutPtr;
+	if (nFirst > nCount)
 	{
-		*p++ = m_pQueue[m_nOutPtr];
+		nFirst = nCount;
+	}
 
-		if (++m_nOutPtr == m_nQueueSize)
-		{
-			m_nOutPtr = 0;
-		}
+	memcpy (p, m_pQueue + m_nOutPtr, nFirst);
+	memcpy (p + nFirst, m_pQueue, nCount - nFirst);
+
+	unsigned nPtr = m_nOutPtr + nCount;
+	if (nPtr >= m_nQueueSize)
+	{
+		nPtr -= m_nQueueSize;
 	}
+
+	// the data must be accessed, before the other side sees the new pointer
+	DataMemBarrier ();
+
+	m_nOutPtr = nPtr;
 }
 
 // Input //////////////////////////////////////////////////////////////
@@ -941,8 +1292,18 @@ void CSoundBaseDevice::PutChunkInternal (const void *pBuffer, unsigned nChunkSiz
 		nReadQueueBytesFree -= nBytes;
 	}
 
+	if (nBytes < nChunkSizeBytes)
+	{
+		m_nReadOverrunFrames += (nChunkSizeBytes - nBytes) / m_nHWRXFrameSize;
+	}
+
 	m_ReadSpinLock.Release ();
 
+	if (nBytes < nChunkSizeBytes)
+	{
+		s_Overruns.Increment ();
+	}
+
 	if (   m_pReadCallback != 0
 	    && nReadQueueBytesFree < m_nHaveDataThreshold)
 	{
@@ -1008,12 +1369,14 @@ unsigned CSoundBaseDevice::GetReadQueueBytesFree (void)
 	assert (m_nReadInPtr < m_nReadQueueSize);
 	assert (m_nReadOutPtr < m_nReadQueueSize);
 
-	if (m_nReadOutPtr <= m_nReadInPtr)
+	unsigned nInPtr = m_nReadInPtr;
+	unsigned nOutPtr = m_nReadOutPtr;
+	if (nOutPtr <= nInPtr)
 	{
-		return m_nReadQueueSize+m_nReadOutPtr-m_nReadInPtr-1;
+		return m_nReadQueueSize+nOutPtr-nInPtr-m_nHWRXFrameSize;
 	}
 
-	return m_nReadOutPtr-m_nReadInPtr-1;
+	return nOutPtr-nInPtr-m_nHWRXFrameSize;
 }
 
 unsigned CSoundBaseDevice::GetReadQueueBytesAvail (void)
@@ -1022,12 +1385,14 @@ unsigned CSoundBaseDevice::GetReadQueueBytesAvail (void)
 	assert (m_nReadInPtr < m_nReadQueueSize);
 	assert (m_nReadOutPtr < m_nReadQueueSize);
 
-	if (m_nReadInPtr < m_nReadOutPtr)
+	unsigned nInPtr = m_nReadInPtr;
+	unsigned nOutPtr = m_nReadOutPtr;
+	if (nInPtr < nOutPtr)
 	{
-		return m_nReadQueueSize+m_nReadInPtr-m_nReadOutPtr;
+		return m_nReadQueueSize+nInPtr-nOutPtr;
 	}
 
-	return m_nReadInPtr-m_nReadOutPtr;
+	return nInPtr-nOutPtr;
 }
 
 void CSoundBaseDevice::ReadEnqueue (const void *pBuffer, unsigned nCount)
@@ -1037,15 +1402,27 @@ void CSoundBaseDevice::ReadEnqueue (const void *pBuffer, unsigned nCount)
 	assert (m_pReadQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+
+	// copy in up to two parts, if the queue wraps around
+	unsigned nFirst = m_nReadQueueSize - m_nReadInPtr;
+	if (nFirst > nCount)
 	{
-		m_pReadQueue[m_nReadInPtr] = *p++;
+		nFirst = nCount;
+	}
 
-		if (++m_nReadInPtr == m_nReadQueueSize)
-		{
-			m_nReadInPtr = 0;
-		}
+	memcpy (m_pReadQueue + m_nReadInPtr, p, nFirst);
+	memcpy (m_pReadQueue, p + nFirst, nCount - nFirst);
+
+	unsigned nPtr = m_nReadInPtr + nCount;
+	if (nPtr >= m_nReadQueueSize)
+	{
+		nPtr -= m_nReadQueueSize;
 	}
+
+	// the data must be accessed, before the other side sees the new pointer
+	DataMemBarrier ();
+
+	m_nReadInPtr = nPtr;
 }
 
 void CSoundBaseDevice::ReadDequeue (void *pBuffer, unsigned nCount)
@@ -1055,13 +1432,25 @@ void CSoundBaseDevice::ReadDequeue (void *pBuffer, unsigned nCount)
 	assert (m_pReadQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+
+	// copy in up to two parts, if the queue wraps around
+	unsigned nFirst = m_nReadQueueSize - m_nReadOutPtr;
+	if (nFirst > nCount)
 	{
-		*p++ = m_pReadQueue[m_nReadOutPtr];
+		nFirst = nCount;
+	}
 
-		if (++m_nReadOutPtr == m_nReadQueueSize)
-		{
-			m_nReadOutPtr = 0;
-		}
+	memcpy (p, m_pReadQueue + m_nReadOutPtr, nFirst);
+	memcpy (p + nFirst, m_pReadQueue, nCount - nFirst);
+
+	unsigned nPtr = m_nReadOutPtr + nCount;
+	if (nPtr >= m_nReadQueueSize)
+	{
+		nPtr -= m_nReadQueueSize;
 	}
+
+	// the data must be accessed, before the other side sees the new pointer
+	DataMemBarrier ();
+
+	m_nReadOutPtr = nPtr;
 }
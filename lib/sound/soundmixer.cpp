@@ -0,0 +1,549 @@
+//
+// soundmixer.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/sound/soundmixer.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/util.h>
+#include <assert.h>
+
+// Kaiser windowed sinc (beta 8, cut-off 0.9), Q14, each phase sums up to 1.0,
+// row p is used for a position of p/SOUND_MIXER_PHASES after the center tap,
+// the additional last row is used for the interpolation of the last phase
+static const s16 FilterTable[SOUND_MIXER_PHASES+1][SOUND_MIXER_TAPS] =
+{
+	{14, -68, 205, -457, 816, -1209, 1520, 14743, 1520, -1209, 816, -457, 205, -68, 14, -1},
+	{14, -68, 198, -432, 744, -1033, 1064, 14726, 1996, -1383, 884, -480, 210, -69, 14, -1},
+	{14, -66, 190, -404, 669, -857, 629, 14665, 2490, -1553, 948, -500, 214, -68, 14, -1},
+	{14, -64, 181, -374, 591, -682, 218, 14566, 3002, -1719, 1007, -517, 216, -67, 13, -1},
+	{14, -62, 171, -342, 513, -509, -169, 14426, 3528, -1878, 1060, -530, 216, -65, 12, -1},
+	{13, -59, 160, -309, 433, -340, -531, 14250, 4066, -2029, 1107, -539, 214, -63, 11, 0},
+	{13, -56, 148, -275, 354, -176, -866, 14032, 4616, -2170, 1146, -543, 210, -59, 10, 0},
+	{12, -52, 136, -241, 275, -17, -1175, 13783, 5173, -2301, 1177, -543, 204, -55, 8, 0},
+	{11, -49, 123, -206, 197, 135, -1456, 13497, 5737, -2418, 1200, -539, 196, -50, 6, 0},
+	{10, -45, 110, -171, 121, 278, -1710, 13179, 6303, -2521, 1213, -529, 185, -44, 4, 1},
+	{10, -41, 96, -136, 47, 414, -1936, 12825, 6871, -2607, 1217, -515, 173, -37, 2, 1},
+	{9, -37, 83, -102, -23, 540, -2134, 12444, 7437, -2677, 1210, -495, 158, -30, -1, 2},
+	{8, -33, 70, -69, -91, 656, -2303, 12035, 7999, -2727, 1193, -471, 140, -21, -4, 2},
+	{7, -29, 57, -37, -154, 762, -2446, 11596, 8554, -2757, 1166, -440, 121, -12, -7, 3},
+	{6, -25, 44, -7, -214, 858, -2561, 11137, 9100, -2766, 1127, -405, 99, -2, -10, 3},
+	{5, -21, 31, 23, -269, 942, -2650, 10656, 9633, -2751, 1076, -365, 76, 8, -14, 4},
+	{5, -17, 20, 50, -319, 1015, -2713, 10150, 10152, -2713, 1015, -319, 50, 20, -17, 5},
+	{4, -14, 8, 76, -365, 1076, -2751, 9633, 10656, -2650, 942, -269, 23, 31, -21, 5},
+	{3, -10, -2, 99, -405, 1127, -2766, 9100, 11137, -2561, 858, -214, -7, 44, -25, 6},
+	{3, -7, -12, 121, -440, 1166, -2757, 8554, 11596, -2446, 762, -154, -37, 57, -29, 7},
+	{2, -4, -21, 140, -471, 1193, -2727, 7999, 12035, -2303, 656, -91, -69, 70, -33, 8},
+	{2, -1, -30, 158, -495, 1210, -2677, 7437, 12444, -2134, 540, -23, -102, 83, -37, 9},
+	{1, 2, -37, 173, -515, 1217, -2607, 6871, 12825, -1936, 414, 47, -136, 96, -41, 10},
+	{1, 4, -44, 185, -529, 1213, -2521, 6303, 13179, -1710, 278, 121, -171, 110, -45, 10},
+	{0, 6, -50, 196, -539, 1200, -2418, 5737, 13497, -1456, 135, 197, -206, 123, -49, 11},
+	{0, 8, -55, 204, -543, 1177, -2301, 5173, 13783, -1175, -17, 275, -241, 136, -52, 12},
+	{0, 10, -59, 210, -543, 1146, -2170, 4616, 14032, -866, -176, 354, -275, 148, -56, 13},
+	{0, 11, -63, 214, -539, 1107, -2029, 4066, 14250, -531, -340, 433, -309, 160, -59, 13},
+	{-1, 12, -65, 216, -530, 1060, -1878, 3528, 14426, -169, -509, 513, -342, 171, -62, 14},
+	{-1, 13, -67, 216, -517, 1007, -1719, 3002, 14566, 218, -682, 591, -374, 181, -64, 14},
+	{-1, 14, -68, 214, -500, 948, -1553, 2490, 14665, 629, -857, 669, -404, 190, -66, 14},
+	{-1, 14, -69, 210, -480, 884, -1383, 1996, 14726, 1064, -1033, 744, -432, 198, -68, 14},
+	{-1, 14, -68, 205, -457, 816, -1209, 1520, 14743, 1520, -1209, 816, -457, 205, -68, 14},
+};
+
+#define FILTER_SHIFT		14
+#define GAIN_SHIFT		12
+#define PHASE_SHIFT		(32-5)		// SOUND_MIXER_PHASES == 1 << 5
+#define WEIGHT_SHIFT		(PHASE_SHIFT-16)
+
+// drift compensation controller (called once per block)
+#define DRIFT_KP		10		// ppm per frame of fill level error
+#define DRIFT_KI		87		// ppm * 65536 per frame and block (ca. 20s at 48 kHz)
+#define DRIFT_AVERAGE		16		// blocks of fill level averaging
+
+CSoundMixer::CSoundMixer (CSoundBaseDevice *pOutput, unsigned nSampleRate)
+:	m_pOutput (pOutput),
+	m_nSampleRate (nSampleRate),
+	m_nCPULoad (0),
+	m_bMeasuring (FALSE),
+	m_ullFramesWritten (0),
+	m_nOutputDriftPPM (0),
+	m_SpinLock (TASK_LEVEL)
+{
+	assert (m_pOutput != 0);
+	assert (m_nSampleRate > 0);
+	assert (1 << (32-PHASE_SHIFT) == SOUND_MIXER_PHASES);
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		m_pStream[i] = 0;
+	}
+
+	m_nBlockTicks = (u64) SOUND_MIXER_BLOCK_FRAMES * CLOCKHZ / m_nSampleRate;
+	assert (m_nBlockTicks > 0);
+}
+
+CSoundMixer::~CSoundMixer (void)
+{
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		RemoveStream (i);
+	}
+
+	m_pOutput = 0;
+}
+
+boolean CSoundMixer::Start (void)
+{
+	assert (m_pOutput != 0);
+	m_pOutput->SetWriteFormat (SoundFormatSigned16, 2);
+
+	if (m_pOutput->IsActive ())
+	{
+		return TRUE;
+	}
+
+	return m_pOutput->Start ();
+}
+
+int CSoundMixer::AddStream (unsigned nSampleRate, unsigned nQueueFrames)
+{
+	assert (nSampleRate > 0);
+	assert (nSampleRate < m_nSampleRate * (SOUND_MIXER_TAPS-1));
+
+	// the filter window and one block must fit into the queue
+	if (nQueueFrames < SOUND_MIXER_TAPS + SOUND_MIXER_BLOCK_FRAMES)
+	{
+		nQueueFrames = SOUND_MIXER_TAPS + SOUND_MIXER_BLOCK_FRAMES;
+	}
+
+	unsigned nSizePower2 = 1;
+	while (nSizePower2 < nQueueFrames)
+	{
+		nSizePower2 <<= 1;
+	}
+
+	TStream *pStream = new TStream;
+	if (pStream == 0)
+	{
+		return -1;
+	}
+
+	pStream->pQueue = new s16[nSizePower2 * 2];
+	if (pStream->pQueue == 0)
+	{
+		delete pStream;
+
+		return -1;
+	}
+
+	pStream->nGain = SOUND_MIXER_UNITY_GAIN;
+	pStream->nQueueMask = nSizePower2 - 1;
+	pStream->nIn = 0;
+	pStream->nOut = 0;
+	pStream->bResample = nSampleRate != m_nSampleRate;
+	pStream->ullStep = ((u64) nSampleRate << 32) / m_nSampleRate;
+	pStream->nFraction = 0;
+	pStream->bAdaptive = FALSE;
+	pStream->ullNominalStep = pStream->ullStep;
+	pStream->nTargetFrames = 0;
+	pStream->nFillError = 0;
+	pStream->nIntegral = 0;
+	pStream->nDriftPPM = 0;
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		if (m_pStream[i] == 0)
+		{
+			m_pStream[i] = pStream;
+
+			m_SpinLock.Release ();
+
+			return i;
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	delete [] pStream->pQueue;
+	delete pStream;
+
+	return -1;
+}
+
+void CSoundMixer::RemoveStream (unsigned nStream)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+
+	m_SpinLock.Acquire ();
+
+	TStream *pStream = m_pStream[nStream];
+	m_pStream[nStream] = 0;
+
+	m_SpinLock.Release ();
+
+	if (pStream != 0)
+	{
+		delete [] pStream->pQueue;
+		delete pStream;
+	}
+}
+
+void CSoundMixer::SetGain (unsigned nStream, unsigned nGain)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+	assert (nGain <= SOUND_MIXER_MAX_GAIN);
+	assert (m_pStream[nStream] != 0);
+
+	m_pStream[nStream]->nGain = nGain;
+}
+
+void CSoundMixer::EnableDriftCompensation (unsigned nStream, unsigned nTargetFrames)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+
+	m_SpinLock.Acquire ();
+
+	TStream *pStream = m_pStream[nStream];
+	assert (pStream != 0);
+
+	if (nTargetFrames == 0)
+	{
+		nTargetFrames = (pStream->nQueueMask + 1) / 2;
+	}
+	assert (nTargetFrames <= pStream->nQueueMask + 1 - SOUND_MIXER_BLOCK_FRAMES);
+
+	pStream->nTargetFrames = nTargetFrames;
+	pStream->nFillError = 0;
+	pStream->nIntegral = 0;
+	pStream->nDriftPPM = 0;
+	pStream->bResample = TRUE;		// the ratio is not exactly 1 any more
+	pStream->bAdaptive = TRUE;
+
+	m_SpinLock.Release ();
+}
+
+int CSoundMixer::GetStreamDriftPPM (unsigned nStream)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+	TStream *pStream = m_pStream[nStream];
+	assert (pStream != 0);
+
+	return pStream->nDriftPPM;
+}
+
+unsigned CSoundMixer::WriteStream (unsigned nStream, const s16 *pBuffer, unsigned nFrames)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+	TStream *pStream = m_pStream[nStream];
+	assert (pStream != 0);
+	assert (pBuffer != 0);
+
+	unsigned nIn = pStream->nIn;
+	unsigned nFramesFree = pStream->nQueueMask + 1 - (nIn - pStream->nOut);
+	if (nFrames > nFramesFree)
+	{
+		nFrames = nFramesFree;
+	}
+
+	// copy in up to two parts, because of the queue wrap
+	unsigned nFramesDone = 0;
+	while (nFramesDone < nFrames)
+	{
+		unsigned nIndex = (nIn + nFramesDone) & pStream->nQueueMask;
+		unsigned nCount = pStream->nQueueMask + 1 - nIndex;
+		if (nCount > nFrames - nFramesDone)
+		{
+			nCount = nFrames - nFramesDone;
+		}
+
+		memcpy (&pStream->pQueue[nIndex * 2], &pBuffer[nFramesDone * 2],
+			nCount * 2 * sizeof (s16));
+
+		nFramesDone += nCount;
+	}
+
+	DataMemBarrier ();
+
+	pStream->nIn = nIn + nFrames;
+
+	return nFrames;
+}
+
+unsigned CSoundMixer::GetStreamFramesFree (unsigned nStream)
+{
+	assert (nStream < SOUND_MIXER_MAX_STREAMS);
+	TStream *pStream = m_pStream[nStream];
+	assert (pStream != 0);
+
+	return pStream->nQueueMask + 1 - (pStream->nIn - pStream->nOut);
+}
+
+boolean CSoundMixer::Process (void)
+{
+	assert (m_pOutput != 0);
+
+	boolean bRendered = FALSE;
+
+	while (  m_pOutput->GetQueueSizeFrames ()
+	       - m_pOutput->GetQueueFramesAvail () >= SOUND_MIXER_BLOCK_FRAMES)
+	{
+		u64 ullStartTicks = CTimer::GetClockTicks64 ();
+
+		RenderBlock ();
+
+		unsigned nTicks = (unsigned) (CTimer::GetClockTicks64 () - ullStartTicks);
+		unsigned nLoad = (u64) nTicks * 100 * 256 / m_nBlockTicks;
+		m_nCPULoad = (m_nCPULoad * 7 + nLoad) / 8;
+
+		int nResult = m_pOutput->Write (m_OutputBuffer, sizeof m_OutputBuffer);
+		assert (nResult == (int) sizeof m_OutputBuffer);
+		(void) nResult;
+
+		MeasureOutput ();
+
+		bRendered = TRUE;
+	}
+
+	return bRendered;
+}
+
+unsigned CSoundMixer::GetCPULoad (void) const
+{
+	return (m_nCPULoad + 128) / 256;
+}
+
+int CSoundMixer::GetOutputDriftPPM (void) const
+{
+	return m_nOutputDriftPPM;
+}
+
+void CSoundMixer::RenderBlock (void)
+{
+	memset (m_MixBuffer, 0, sizeof m_MixBuffer);
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < SOUND_MIXER_MAX_STREAMS; i++)
+	{
+		TStream *pStream = m_pStream[i];
+		if (pStream == 0)
+		{
+			continue;
+		}
+
+		if (pStream->bAdaptive)
+		{
+			UpdateDrift (pStream);
+		}
+
+		if (pStream->bResample)
+		{
+			MixResampled (pStream, m_MixBuffer, SOUND_MIXER_BLOCK_FRAMES);
+		}
+		else
+		{
+			MixStream (pStream, m_MixBuffer, SOUND_MIXER_BLOCK_FRAMES);
+		}
+	}
+
+	m_SpinLock.Release ();
+
+	// saturate to the output format
+	for (unsigned i = 0; i < SOUND_MIXER_BLOCK_FRAMES * 2; i++)
+	{
+		s32 nSample = m_MixBuffer[i];
+		if (nSample > 32767)
+		{
+			nSample = 32767;
+		}
+		else if (nSample < -32768)
+		{
+			nSample = -32768;
+		}
+
+		m_OutputBuffer[i] = (s16) nSample;
+	}
+}
+
+void CSoundMixer::MixStream (TStream *pStream, s32 *pMix, unsigned nFrames)
+{
+	assert (pStream != 0);
+	assert (pMix != 0);
+
+	unsigned nOut = pStream->nOut;
+	unsigned nFramesAvail = pStream->nIn - nOut;
+	if (nFrames > nFramesAvail)
+	{
+		nFrames = nFramesAvail;		// underrun, remaining frames are silent
+	}
+
+	DataMemBarrier ();
+
+	s32 nGain = pStream->nGain;
+	const s16 *pQueue = pStream->pQueue;
+	unsigned nMask = pStream->nQueueMask;
+
+	for (unsigned i = 0; i < nFrames; i++)
+	{
+		unsigned nIndex = ((nOut + i) & nMask) * 2;
+
+		pMix[i*2]   += (pQueue[nIndex] * nGain) >> GAIN_SHIFT;
+		pMix[i*2+1] += (pQueue[nIndex+1] * nGain) >> GAIN_SHIFT;
+	}
+
+	DataMemBarrier ();
+
+	pStream->nOut = nOut + nFrames;
+}
+
+void CSoundMixer::MixResampled (TStream *pStream, s32 *pMix, unsigned nFrames)
+{
+	assert (pStream != 0);
+	assert (pMix != 0);
+
+	unsigned nOut = pStream->nOut;
+	unsigned nIn = pStream->nIn;
+
+	DataMemBarrier ();
+
+	s32 nGain = pStream->nGain;
+	const s16 *pQueue = pStream->pQueue;
+	unsigned nMask = pStream->nQueueMask;
+	u32 nFraction = pStream->nFraction;
+
+	for (unsigned i = 0; i < nFrames; i++)
+	{
+		if (nIn - nOut < SOUND_MIXER_TAPS)
+		{
+			break;			// underrun, remaining frames are silent
+		}
+
+		unsigned nPhase = nFraction >> PHASE_SHIFT;
+		s32 nWeight = (nFraction >> WEIGHT_SHIFT) & 0xFFFF;
+
+		const s16 *pCoeff0 = FilterTable[nPhase];
+		const s16 *pCoeff1 = FilterTable[nPhase+1];
+
+		s32 nLeft0 = 0, nRight0 = 0, nLeft1 = 0, nRight1 = 0;
+		for (unsigned k = 0; k < SOUND_MIXER_TAPS; k++)
+		{
+			unsigned nIndex = ((nOut + k) & nMask) * 2;
+			s32 nLeft = pQueue[nIndex];
+			s32 nRight = pQueue[nIndex+1];
+
+			nLeft0 += nLeft * pCoeff0[k];
+			nRight0 += nRight * pCoeff0[k];
+			nLeft1 += nLeft * pCoeff1[k];
+			nRight1 += nRight * pCoeff1[k];
+		}
+
+		// linear interpolation between the two phases
+		nLeft0 >>= FILTER_SHIFT;
+		nRight0 >>= FILTER_SHIFT;
+		s32 nLeft = nLeft0 + (s32) (((s64) ((nLeft1 >> FILTER_SHIFT) - nLeft0) * nWeight) >> 16);
+		s32 nRight = nRight0 + (s32) (((s64) ((nRight1 >> FILTER_SHIFT) - nRight0) * nWeight) >> 16);
+
+		pMix[i*2]   += (nLeft * nGain) >> GAIN_SHIFT;
+		pMix[i*2+1] += (nRight * nGain) >> GAIN_SHIFT;
+
+		u64 ullPosition = (u64) nFraction + pStream->ullStep;
+		nOut += (unsigned) (ullPosition >> 32);
+		nFraction = (u32) ullPosition;
+	}
+
+	pStream->nFraction = nFraction;
+
+	DataMemBarrier ();
+
+	pStream->nOut = nOut;
+}
+
+void CSoundMixer::UpdateDrift (TStream *pStream)
+{
+	assert (pStream != 0);
+	assert (pStream->bAdaptive);
+
+	s32 nFill = pStream->nIn - pStream->nOut;
+	if (nFill < SOUND_MIXER_TAPS)
+	{
+		return;				// stream is not fed at the moment
+	}
+
+	s32 nError = (nFill - (s32) pStream->nTargetFrames) * 256;
+	pStream->nFillError += (nError - pStream->nFillError) / DRIFT_AVERAGE;
+
+	// proportional-integral controller, which receives the fill level error and
+	// keeps the queue centered by consuming the stream slightly faster or slower
+	const s32 nMaxIntegral = SOUND_MIXER_MAX_DRIFT_PPM << 16;
+	s64 nIntegral = pStream->nIntegral + (s64) pStream->nFillError * DRIFT_KI / 256;
+	if (nIntegral > nMaxIntegral)
+	{
+		nIntegral = nMaxIntegral;
+	}
+	else if (nIntegral < -nMaxIntegral)
+	{
+		nIntegral = -nMaxIntegral;
+	}
+	pStream->nIntegral = (s32) nIntegral;
+
+	s32 nPPM = pStream->nFillError * DRIFT_KP / 256 + (pStream->nIntegral >> 16);
+	if (nPPM > SOUND_MIXER_MAX_DRIFT_PPM)
+	{
+		nPPM = SOUND_MIXER_MAX_DRIFT_PPM;
+	}
+	else if (nPPM < -SOUND_MIXER_MAX_DRIFT_PPM)
+	{
+		nPPM = -SOUND_MIXER_MAX_DRIFT_PPM;
+	}
+	pStream->nDriftPPM = nPPM;
+
+	s64 nNominalStep = (s64) pStream->ullNominalStep;
+	pStream->ullStep = (u64) (nNominalStep + nNominalStep * nPPM / 1000000);
+}
+
+void CSoundMixer::MeasureOutput (void)
+{
+	assert (m_pOutput != 0);
+
+	m_ullFramesWritten += SOUND_MIXER_BLOCK_FRAMES;
+
+	u64 ullTicks = CTimer::GetClockTicks64 ();
+	u64 ullFramesConsumed = m_ullFramesWritten - m_pOutput->GetQueueFramesAvail ();
+
+	if (!m_bMeasuring)
+	{
+		m_ullMeasureStartTicks = ullTicks;
+		m_ullFramesConsumedAtStart = ullFramesConsumed;
+		m_bMeasuring = TRUE;
+
+		return;
+	}
+
+	// the measurement gets more precise the longer it runs, because the consumed
+	// frames are known with the granularity of the device's DMA buffers only
+	u64 ullElapsed = ullTicks - m_ullMeasureStartTicks;
+	if (ullElapsed < CLOCKHZ)
+	{
+		return;
+	}
+
+	s64 nNominal = (s64) (ullElapsed * m_nSampleRate / CLOCKHZ);
+	s64 nConsumed = (s64) (ullFramesConsumed - m_ullFramesConsumedAtStart);
+
+	m_nOutputDriftPPM = (int) ((nConsumed - nNominal) * 1000000 / nNominal);
+}
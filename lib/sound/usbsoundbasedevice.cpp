@@ -490,6 +490,13 @@ void CUSBSoundBaseDevice::RXCompletionRoutine (unsigned nBytesTransferred)
 		assert (nBytesTransferred % m_nSubframeSize == 0);
 		assert (nBytesTransferred <= m_nRXChunkSizeBytes * 2);
 
+		// the output is paced by the rate of the input stream
+		if (   m_pTXUSBDevice
+		    && m_pTXUSBDevice->HasImplicitFeedback ())
+		{
+			m_pTXUSBDevice->ImplicitFeedback (m_pRXUSBDevice, nBytesTransferred);
+		}
+
 #if RASPPI >= 4
 		// on the Raspberry Pi 4 we maintain two outstanding transfers,
 		// so m_nRXCurrentBuffer points to the buffer, which has been recently filled
@@ -0,0 +1,552 @@
+//
+// spidmaqueue.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/spidmaqueue.h>
+#include <circle/bcm2835.h>
+#include <circle/bcm2835int.h>
+#include <circle/machineinfo.h>
+#include <circle/memio.h>
+#include <circle/timer.h>
+#include <circle/synchronize.h>
+#include <circle/new.h>
+#include <assert.h>
+
+// CS Register
+#define CS_ADCS		(1 << 11)
+#define CS_DMAEN	(1 << 8)
+#define CS_TA		(1 << 7)
+#define CS_CLEAR_RX	(1 << 5)
+#define CS_CLEAR_TX	(1 << 4)
+#define CS_CPOL__SHIFT	3
+#define CS_CPHA__SHIFT	2
+#define CS_CS__SHIFT	0
+
+//
+// PWM device selection (for DREQ only, the PWM outputs are not used)
+//
+#if RASPPI <= 3
+	#define CLOCK_RATE	250000000
+	#define PWM_BASE	ARM_PWM_BASE
+	#define DREQ_SOURCE	DREQSourcePWM
+#else
+	#define CLOCK_RATE	125000000
+	#define PWM_BASE	ARM_PWM1_BASE
+	#define DREQ_SOURCE	DREQSourcePWM1
+#endif
+
+#define PWM_CTL			(PWM_BASE + 0x00)
+	#define PWM_CTL_PWEN1		(1 << 0)
+	#define PWM_CTL_USEF1		(1 << 5)
+	#define PWM_CTL_CLRF1		(1 << 6)
+#define PWM_DMAC		(PWM_BASE + 0x08)
+	#define PWM_DMAC_DREQ__SHIFT	0
+	#define PWM_DMAC_PANIC__SHIFT	8
+	#define PWM_DMAC_ENAB		(1 << 31)
+#define PWM_RNG1		(PWM_BASE + 0x10)
+#define PWM_FIF1		(PWM_BASE + 0x18)
+
+#define PAUSE_TICK_RATE		1000000		// one FIFO word per microsecond
+
+#define BUS_IO_ADDRESS(addr)	(((addr) & 0xFFFFFF) + GPU_IO_BASE)
+
+#define RX_BLOCKS		6		// per transfer
+#define BLOCKS			(RX_BLOCKS + 1)	// plus TX block
+
+CSPIDMAQueue::CSPIDMAQueue (unsigned nMaxTransfers, CInterruptSystem *pInterruptSystem)
+:	m_nMaxTransfers (nMaxTransfers),
+	m_nTransfers (0),
+	m_pInterruptSystem (pInterruptSystem),
+	m_bIRQConnected (FALSE),
+	m_pCompletionRoutine (0),
+	m_pCompletionParam (0),
+	m_SCLK (11, GPIOModeAlternateFunction0),
+	m_MOSI (10, GPIOModeAlternateFunction0),
+	m_MISO ( 9, GPIOModeAlternateFunction0),
+	m_CE0  ( 8, GPIOModeAlternateFunction0),
+	m_CE1  ( 7, GPIOModeAlternateFunction0),
+	m_nCoreClockRate (CMachineInfo::Get ()->GetClockRate (CLOCK_ID_CORE)),
+	m_Clock (GPIOClockPWM),
+	m_bPWMRunning (FALSE),
+	m_nRxDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_NORMAL)),
+	m_nTxDMAChannel (CMachineInfo::Get ()->AllocateDMAChannel (DMA_CHANNEL_LITE))
+{
+	assert (m_nMaxTransfers > 0);
+	assert (m_nCoreClockRate > 0);
+	assert (m_nRxDMAChannel <= DMA_CHANNEL_MAX);
+	assert (m_nTxDMAChannel <= DMA_CHANNEL_MAX);
+
+	m_pTransfers = new (HEAP_DMA30) TTransfer[m_nMaxTransfers];
+	assert (m_pTransfers != 0);
+
+	m_pControlBlockBuffer =
+		new (HEAP_DMA30) u8[(BLOCKS * m_nMaxTransfers + 1) * sizeof (TDMAControlBlock) + 31];
+	assert (m_pControlBlockBuffer != 0);
+	m_pControlBlock = (TDMAControlBlock *) (((uintptr) m_pControlBlockBuffer + 31) & ~31);
+
+	m_pDMAWords = new (HEAP_DMA30) u32[2];
+	assert (m_pDMAWords != 0);
+	m_pDMAWords[0] = 0;
+	m_pDMAWords[1] = 0;
+}
+
+CSPIDMAQueue::~CSPIDMAQueue (void)
+{
+	Stop ();
+
+	PeripheralEntry ();
+	write32 (ARM_DMA_ENABLE,   read32 (ARM_DMA_ENABLE)
+				 & ~(1 << m_nRxDMAChannel | 1 << m_nTxDMAChannel));
+	PeripheralExit ();
+
+	if (m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_DMA0+m_nRxDMAChannel);
+	}
+
+	m_pInterruptSystem = 0;
+
+	CMachineInfo::Get ()->FreeDMAChannel (m_nTxDMAChannel);
+	CMachineInfo::Get ()->FreeDMAChannel (m_nRxDMAChannel);
+
+	delete [] m_pDMAWords;
+	m_pDMAWords = 0;
+
+	m_pControlBlock = 0;
+	delete [] m_pControlBlockBuffer;
+	m_pControlBlockBuffer = 0;
+
+	delete [] m_pTransfers;
+	m_pTransfers = 0;
+}
+
+boolean CSPIDMAQueue::Initialize (void)
+{
+	// enable and reset DMA channels
+	PeripheralEntry ();
+
+	write32 (ARM_DMA_ENABLE,   read32 (ARM_DMA_ENABLE)
+				 | 1 << m_nRxDMAChannel | 1 << m_nTxDMAChannel);
+	CTimer::SimpleusDelay (1000);
+
+	write32 (ARM_SPI0_CS, CS_CLEAR_RX | CS_CLEAR_TX);
+
+	PeripheralExit ();
+
+	ResetDMA (m_nRxDMAChannel);
+	ResetDMA (m_nTxDMAChannel);
+
+	return TRUE;
+}
+
+boolean CSPIDMAQueue::AddTransfer (unsigned nChipSelect, unsigned nClockSpeed,
+				   unsigned CPOL, unsigned CPHA,
+				   const void *pWriteBuffer, void *pReadBuffer, unsigned nCount)
+{
+	assert (!IsRunning ());
+
+	if (   m_nTransfers >= m_nMaxTransfers
+	    || (nChipSelect > 1 && nChipSelect != ChipSelectNone)
+	    || nClockSpeed < 4000 || nClockSpeed > 125000000
+	    || CPOL > 1 || CPHA > 1
+	    || nCount == 0 || nCount > 0xFFFF)
+	{
+		return FALSE;
+	}
+
+	assert (((uintptr) pWriteBuffer & 3) == 0);
+	assert (((uintptr) pReadBuffer & 3) == 0);
+
+	assert (m_pTransfers != 0);
+	TTransfer *pTransfer = &m_pTransfers[m_nTransfers++];
+
+	u32 nCS =   (CPOL << CS_CPOL__SHIFT) | (CPHA << CS_CPHA__SHIFT)
+		  | (nChipSelect << CS_CS__SHIFT);
+
+	pTransfer->nCSIdle = nCS | CS_CLEAR_RX | CS_CLEAR_TX;
+	pTransfer->nCLK = m_nCoreClockRate / nClockSpeed;
+	pTransfer->nDLEN = nCount;
+	pTransfer->nCSActive = nCS | CS_DMAEN | CS_ADCS | CS_TA;
+	pTransfer->nTxControlBlock = 0;		// set by Compile()
+	pTransfer->nTxCS =   CS_WAIT_FOR_OUTSTANDING_WRITES
+			   | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+			   | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+			   | CS_ACTIVE;
+	pTransfer->nReserved[0] = 0;
+	pTransfer->nReserved[1] = 0;
+
+	pTransfer->pWriteBuffer = pWriteBuffer;
+	pTransfer->pReadBuffer = pReadBuffer;
+	pTransfer->nCount = nCount;
+
+	return TRUE;
+}
+
+void CSPIDMAQueue::Clear (void)
+{
+	assert (!IsRunning ());
+
+	m_nTransfers = 0;
+}
+
+void CSPIDMAQueue::SetCompletionRoutine (TSPIQueueCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (m_pInterruptSystem != 0);
+	assert (!IsRunning ());
+
+	m_pCompletionRoutine = pRoutine;
+	m_pCompletionParam = pParam;
+}
+
+boolean CSPIDMAQueue::Start (void)
+{
+	if (   m_nTransfers == 0
+	    || IsRunning ())
+	{
+		return FALSE;
+	}
+
+	Compile (FALSE, 0);
+
+	if (   m_pCompletionRoutine != 0
+	    && !m_bIRQConnected)
+	{
+		assert (m_pInterruptSystem != 0);
+		m_pInterruptSystem->ConnectIRQ (ARM_IRQ_DMA0+m_nRxDMAChannel, InterruptStub, this);
+
+		m_bIRQConnected = TRUE;
+	}
+
+	StartDMA ();
+
+	return TRUE;
+}
+
+boolean CSPIDMAQueue::StartStreaming (unsigned nPauseUS)
+{
+	if (   m_nTransfers == 0
+	    || IsRunning ()
+	    || nPauseUS > TXFR_LEN_MAX / sizeof (u32))
+	{
+		return FALSE;
+	}
+
+	Compile (TRUE, nPauseUS);
+
+	if (nPauseUS > 0)
+	{
+		RunPWM ();
+	}
+
+	StartDMA ();
+
+	return TRUE;
+}
+
+void CSPIDMAQueue::Stop (void)
+{
+	ResetDMA (m_nRxDMAChannel);
+	ResetDMA (m_nTxDMAChannel);
+
+	PeripheralEntry ();
+	write32 (ARM_SPI0_CS, CS_CLEAR_RX | CS_CLEAR_TX);
+	PeripheralExit ();
+
+	if (m_bPWMRunning)
+	{
+		StopPWM ();
+	}
+}
+
+boolean CSPIDMAQueue::IsRunning (void) const
+{
+	PeripheralEntry ();
+
+	boolean bResult = read32 (ARM_DMACHAN_CS (m_nRxDMAChannel)) & CS_ACTIVE ? TRUE : FALSE;
+
+	PeripheralExit ();
+
+	return bResult;
+}
+
+void CSPIDMAQueue::SyncReadBuffers (void)
+{
+	for (unsigned i = 0; i < m_nTransfers; i++)
+	{
+		const TTransfer *pTransfer = &m_pTransfers[i];
+
+		if (pTransfer->pReadBuffer != 0)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) pTransfer->pReadBuffer,
+							  pTransfer->nCount);
+		}
+	}
+}
+
+void CSPIDMAQueue::Compile (boolean bStreaming, unsigned nPauseUS)
+{
+	assert (m_nTransfers > 0);
+	assert (m_pTransfers != 0);
+	assert (m_pControlBlock != 0);
+
+	// register writes: CS (idle), CLK and DLEN, CS (active),
+	// CONBLK_AD and CS of the TX channel
+	static const struct
+	{
+		unsigned nWordOffset;	// in TTransfer
+		unsigned nWords;
+	}
+	Writes[RX_BLOCKS-1] = {{0, 1}, {1, 2}, {3, 1}, {4, 1}, {5, 1}};
+
+	const uintptr Destinations[RX_BLOCKS-1] =
+	{
+		ARM_SPI0_CS, ARM_SPI0_CLK, ARM_SPI0_CS,
+		ARM_DMACHAN_CONBLK_AD (m_nTxDMAChannel), ARM_DMACHAN_CS (m_nTxDMAChannel)
+	};
+
+	TDMAControlBlock *pLast = 0;
+	for (unsigned i = 0; i < m_nTransfers; i++)
+	{
+		TTransfer *pTransfer = &m_pTransfers[i];
+		TDMAControlBlock *pBlock = &m_pControlBlock[BLOCKS * i];
+
+		for (unsigned j = 0; j < RX_BLOCKS-1; j++)
+		{
+			pBlock[j].nTransferInformation	= TI_SRC_INC | TI_DEST_INC | TI_WAIT_RESP;
+			pBlock[j].nSourceAddress	=
+				BUS_ADDRESS ((uintptr) &pTransfer->nCSIdle + Writes[j].nWordOffset*4);
+			pBlock[j].nDestinationAddress	= BUS_IO_ADDRESS (Destinations[j]);
+			pBlock[j].nTransferLength	= Writes[j].nWords * sizeof (u32);
+			pBlock[j].n2DModeStride		= 0;
+			pBlock[j].nNextControlBlockAddress = BUS_ADDRESS ((uintptr) &pBlock[j+1]);
+			pBlock[j].nReserved[0]		= 0;
+			pBlock[j].nReserved[1]		= 0;
+		}
+
+		// receive data, completes after the last byte has been shifted
+		TDMAControlBlock *pRxBlock = &pBlock[RX_BLOCKS-1];
+		pRxBlock->nTransferInformation	=   (DREQSourceSPIRX << TI_PERMAP_SHIFT)
+						  | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						  | TI_SRC_DREQ
+						  | (pTransfer->pReadBuffer != 0 ? TI_DEST_INC : 0)
+						  | TI_WAIT_RESP;
+		pRxBlock->nSourceAddress	= BUS_IO_ADDRESS (ARM_SPI0_FIFO);
+		pRxBlock->nDestinationAddress	= BUS_ADDRESS (  pTransfer->pReadBuffer != 0
+							       ? (uintptr) pTransfer->pReadBuffer
+							       : (uintptr) &m_pDMAWords[1]);
+		pRxBlock->nTransferLength	= pTransfer->nCount;
+		pRxBlock->n2DModeStride		= 0;
+		pRxBlock->nNextControlBlockAddress = 0;
+		pRxBlock->nReserved[0]		= 0;
+		pRxBlock->nReserved[1]		= 0;
+
+		// send data, started by the RX chain
+		TDMAControlBlock *pTxBlock = &pBlock[RX_BLOCKS];
+		pTxBlock->nTransferInformation	=   (DREQSourceSPITX << TI_PERMAP_SHIFT)
+						  | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+						  | TI_DEST_DREQ
+						  | (pTransfer->pWriteBuffer != 0 ? TI_SRC_INC : 0)
+						  | TI_WAIT_RESP;
+		pTxBlock->nSourceAddress	= BUS_ADDRESS (  pTransfer->pWriteBuffer != 0
+							       ? (uintptr) pTransfer->pWriteBuffer
+							       : (uintptr) &m_pDMAWords[0]);
+		pTxBlock->nDestinationAddress	= BUS_IO_ADDRESS (ARM_SPI0_FIFO);
+		pTxBlock->nTransferLength	= pTransfer->nCount;
+		pTxBlock->n2DModeStride		= 0;
+		pTxBlock->nNextControlBlockAddress = 0;
+		pTxBlock->nReserved[0]		= 0;
+		pTxBlock->nReserved[1]		= 0;
+
+		pTransfer->nTxControlBlock = BUS_ADDRESS ((uintptr) pTxBlock);
+
+		if (pLast != 0)
+		{
+			pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) pBlock);
+		}
+		pLast = pRxBlock;
+
+		if (pTransfer->pWriteBuffer != 0)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) pTransfer->pWriteBuffer,
+							  pTransfer->nCount);
+		}
+
+		if (pTransfer->pReadBuffer != 0)
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) pTransfer->pReadBuffer,
+							  pTransfer->nCount);
+		}
+	}
+
+	assert (pLast != 0);
+	if (bStreaming)
+	{
+		if (nPauseUS > 0)
+		{
+			// each word written to the PWM FIFO takes one microsecond
+			TDMAControlBlock *pPauseBlock = &m_pControlBlock[BLOCKS * m_nTransfers];
+			pPauseBlock->nTransferInformation =   (DREQ_SOURCE << TI_PERMAP_SHIFT)
+							    | (DEFAULT_BURST_LENGTH << TI_BURST_LENGTH_SHIFT)
+							    | TI_DEST_DREQ
+							    | TI_WAIT_RESP;
+			pPauseBlock->nSourceAddress	  = BUS_ADDRESS ((uintptr) &m_pDMAWords[0]);
+			pPauseBlock->nDestinationAddress  = BUS_IO_ADDRESS (PWM_FIF1);
+			pPauseBlock->nTransferLength	  = nPauseUS * sizeof (u32);
+			pPauseBlock->n2DModeStride	  = 0;
+			pPauseBlock->nReserved[0]	  = 0;
+			pPauseBlock->nReserved[1]	  = 0;
+
+			pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) pPauseBlock);
+			pLast = pPauseBlock;
+		}
+
+		pLast->nNextControlBlockAddress = BUS_ADDRESS ((uintptr) m_pControlBlock);
+	}
+	else
+	{
+		pLast->nNextControlBlockAddress = 0;
+
+		if (m_pCompletionRoutine != 0)
+		{
+			pLast->nTransferInformation |= TI_INTEN;
+		}
+	}
+
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pTransfers, m_nTransfers * sizeof (TTransfer));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pControlBlock,
+					  (BLOCKS * m_nTransfers + 1) * sizeof (TDMAControlBlock));
+	CleanAndInvalidateDataCacheRange ((uintptr) m_pDMAWords, 2 * sizeof (u32));
+}
+
+void CSPIDMAQueue::RunPWM (void)
+{
+	assert (!m_bPWMRunning);
+
+	PeripheralEntry ();
+
+#ifndef NDEBUG
+	boolean bOK =
+#endif
+		m_Clock.StartRate (CLOCK_RATE);
+	assert (bOK);
+	CTimer::SimpleusDelay (2000);
+
+	write32 (PWM_RNG1, CLOCK_RATE / PAUSE_TICK_RATE);
+
+	write32 (PWM_CTL, PWM_CTL_PWEN1 | PWM_CTL_USEF1 | PWM_CTL_CLRF1);
+	CTimer::SimpleusDelay (2000);
+
+	write32 (PWM_DMAC,   PWM_DMAC_ENAB
+			   | (1 << PWM_DMAC_PANIC__SHIFT)
+			   | (1 << PWM_DMAC_DREQ__SHIFT));
+
+	PeripheralExit ();
+
+	m_bPWMRunning = TRUE;
+}
+
+void CSPIDMAQueue::StopPWM (void)
+{
+	assert (m_bPWMRunning);
+
+	PeripheralEntry ();
+
+	write32 (PWM_DMAC, 0);
+	write32 (PWM_CTL, 0);
+	CTimer::SimpleusDelay (2000);
+
+	m_Clock.Stop ();
+	CTimer::SimpleusDelay (2000);
+
+	PeripheralExit ();
+
+	m_bPWMRunning = FALSE;
+}
+
+void CSPIDMAQueue::ResetDMA (unsigned nChannel)
+{
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CS (nChannel), CS_RESET);
+	while (read32 (ARM_DMACHAN_CS (nChannel)) & CS_RESET)
+	{
+		// do nothing
+	}
+
+	write32 (ARM_DMA_INT_STATUS, 1 << nChannel);
+
+	PeripheralExit ();
+}
+
+void CSPIDMAQueue::StartDMA (void)
+{
+	ResetDMA (m_nRxDMAChannel);
+	ResetDMA (m_nTxDMAChannel);
+
+	PeripheralEntry ();
+
+	write32 (ARM_DMACHAN_CONBLK_AD (m_nRxDMAChannel), BUS_ADDRESS ((uintptr) m_pControlBlock));
+
+	write32 (ARM_DMACHAN_CS (m_nRxDMAChannel),   CS_WAIT_FOR_OUTSTANDING_WRITES
+					           | (DEFAULT_PANIC_PRIORITY << CS_PANIC_PRIORITY_SHIFT)
+					           | (DEFAULT_PRIORITY << CS_PRIORITY_SHIFT)
+					           | CS_ACTIVE);
+
+	PeripheralExit ();
+}
+
+void CSPIDMAQueue::InterruptHandler (void)
+{
+	PeripheralEntry ();
+
+	u32 nIntMask = 1 << m_nRxDMAChannel;
+	if (!(read32 (ARM_DMA_INT_STATUS) & nIntMask))
+	{
+		PeripheralExit ();
+
+		return;
+	}
+
+	write32 (ARM_DMA_INT_STATUS, nIntMask);
+
+	u32 nCS = read32 (ARM_DMACHAN_CS (m_nRxDMAChannel));
+	write32 (ARM_DMACHAN_CS (m_nRxDMAChannel), nCS);	// reset CS_INT
+
+	u32 nTxCS = read32 (ARM_DMACHAN_CS (m_nTxDMAChannel));
+
+	write32 (ARM_SPI0_CS, read32 (ARM_SPI0_CS) & ~(CS_TA | CS_DMAEN | CS_ADCS));
+
+	PeripheralExit ();
+
+	SyncReadBuffers ();
+
+	if (m_pCompletionRoutine != 0)
+	{
+		(*m_pCompletionRoutine) ((nCS | nTxCS) & CS_ERROR ? FALSE : TRUE,
+					 m_pCompletionParam);
+	}
+}
+
+void CSPIDMAQueue::InterruptStub (void *pParam)
+{
+	CSPIDMAQueue *pThis = (CSPIDMAQueue *) pParam;
+	assert (pThis != 0);
+
+	pThis->InterruptHandler ();
+}
@@ -2,7 +2,7 @@
 // spinlock.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2015-2020  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2015-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -28,6 +28,10 @@
 
 boolean CSpinLock::s_bEnabled = FALSE;
 
+#ifdef USE_SCHEDULER_PREEMPTION
+volatile unsigned CSpinLock::s_nTaskLevelLocks[CORES] = {0};
+#endif
+
 CSpinLock::CSpinLock (unsigned nTargetLevel)
 :	m_nTargetLevel (nTargetLevel),
 	m_nLocked (0)
@@ -46,6 +50,12 @@ void CSpinLock::Acquire (void)
 	{
 		EnterCritical (m_nTargetLevel);
 	}
+#ifdef USE_SCHEDULER_PREEMPTION
+	else
+	{
+		s_nTaskLevelLocks[CMultiCoreSupport::ThisCore ()]++;
+	}
+#endif
 
 	if (s_bEnabled)
 	{
@@ -126,6 +136,12 @@ void CSpinLock::Release (void)
 	{
 		LeaveCritical ();
 	}
+#ifdef USE_SCHEDULER_PREEMPTION
+	else
+	{
+		s_nTaskLevelLocks[CMultiCoreSupport::ThisCore ()]--;
+	}
+#endif
 }
 
 void CSpinLock::Enable (void)
@@ -134,4 +150,19 @@ void CSpinLock::Enable (void)
 	s_bEnabled = TRUE;
 }
 
+#ifdef USE_SCHEDULER_PREEMPTION
+
+boolean CSpinLock::IsTaskLevelLockHeld (void)
+{
+	return s_nTaskLevelLocks[CMultiCoreSupport::ThisCore ()] != 0;
+}
+
+#endif
+
+#else
+
+#ifdef USE_SCHEDULER_PREEMPTION
+volatile unsigned CSpinLock::s_nTaskLevelLocks = 0;
+#endif
+
 #endif
@@ -27,6 +27,7 @@
 #include <circle/interrupt.h>
 #include <circle/southbridge.h>
 #include <circle/actled.h>
+#include <circle/bootprofile.h>
 #include <circle/timer.h>
 #include <circle/chainboot.h>
 #include <circle/qemu.h>
@@ -285,10 +286,33 @@ void sysinit (void)
 		halt ();
 	}
 
+	CBootProfile::Mark ("sysinit");
+
 	CMemorySystem Memory;
 
 	CMachineInfo MachineInfo;
 
+#if AARCH == 64
+	// select the optimized memory functions, now that the MMU is on
+	switch (MachineInfo.GetSoCType ())
+	{
+	case SoCTypeBCM2837:
+		memfunc_select (MEMFUNC_CPU_CORTEX_A53);
+		break;
+
+	case SoCTypeBCM2711:
+		memfunc_select (MEMFUNC_CPU_CORTEX_A72);
+		break;
+
+	case SoCTypeBCM2712:
+		memfunc_select (MEMFUNC_CPU_CORTEX_A76);
+		break;
+
+	default:
+		break;
+	}
+#endif
+
 #if RASPPI >= 4
 	Memory.SetupHighMem ();
 #endif
@@ -311,6 +335,8 @@ void sysinit (void)
 
 	strcpy (circle_version_string, Version);
 
+	CBootProfile::Mark ("interrupt system");
+
 	CInterruptSystem InterruptSystem;
 	if (!InterruptSystem.Initialize ())
 	{
@@ -326,6 +352,8 @@ void sysinit (void)
 #endif
 
 	// call constructors of static objects
+	CBootProfile::Mark ("static constructors");
+
 	extern void (*__init_start) (void);
 	extern void (*__init_end) (void);
 	for (void (**pFunc) (void) = &__init_start; pFunc < &__init_end; pFunc++)
@@ -333,6 +361,8 @@ void sysinit (void)
 		(**pFunc) ();
 	}
 
+	CBootProfile::Mark ("main");
+
 	extern int MAINPROC (void);
 	int nResult = MAINPROC ();
 	if (nResult == EXIT_REBOOT)
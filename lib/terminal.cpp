@@ -24,6 +24,10 @@
 #include <circle/timer.h>
 #include <circle/util.h>
 
+// Additional character rows in the display buffer, which allow scrolling by moving the
+// displayed window, without copying the buffer each time
+#define SCROLL_SPARE_ROWS	16
+
 static const char DevicePrefix[] = "tty";
 
 CTerminalDevice::CTerminalDevice (CDisplay *pDisplay, unsigned nDeviceIndex,
@@ -32,6 +36,8 @@ CTerminalDevice::CTerminalDevice (CDisplay *pDisplay, unsigned nDeviceIndex,
 	m_nDeviceIndex (nDeviceIndex),
 	m_CharGen (rFont, FontFlags),
 	m_pCursorPixels (nullptr),
+	m_pBufferBase (nullptr),
+	m_nBufferSize (0),
 	m_pBuffer8 (nullptr),
 	m_nSize (0),
 	m_nPitch (0),
@@ -53,18 +59,30 @@ CTerminalDevice::CTerminalDevice (CDisplay *pDisplay, unsigned nDeviceIndex,
 	m_bReverseAttribute (FALSE),
 	m_bInsertOn (FALSE),
 	m_bAutoPage (FALSE),
-	m_bDelayedUpdate (FALSE)
+	m_bDelayedUpdate (FALSE),
+	m_nGlyphCacheUse (0)
 #ifdef REALTIME
 	, m_SpinLock (TASK_LEVEL)
 #endif
 {
+	for (unsigned i = 0; i < TERMINAL_GLYPH_CACHE_SETS; i++)
+	{
+		m_GlyphCache[i].pGlyphs = nullptr;
+	}
 }
 
 CTerminalDevice::~CTerminalDevice (void)
 {
 	CDeviceNameService::Get ()->RemoveDevice (DevicePrefix, m_nDeviceIndex+1, FALSE);
 
-	delete [] m_pBuffer8;
+	for (unsigned i = 0; i < TERMINAL_GLYPH_CACHE_SETS; i++)
+	{
+		delete [] m_GlyphCache[i].pGlyphs;
+		m_GlyphCache[i].pGlyphs = nullptr;
+	}
+
+	delete [] m_pBufferBase;
+	m_pBufferBase = nullptr;
 	m_pBuffer8 = nullptr;
 
 	delete [] m_pCursorPixels;
@@ -87,12 +105,30 @@ boolean CTerminalDevice::Initialize (void)
 		return FALSE;
 	}
 
-	m_pBuffer8 = new u8[m_nSize];
-	if (!m_pBuffer8)
+	m_nBufferSize = m_nSize + SCROLL_SPARE_ROWS * m_CharGen.GetCharHeight () * m_nPitch;
+
+	m_pBufferBase = new u8[m_nBufferSize];
+	if (!m_pBufferBase)
 	{
 		return FALSE;
 	}
 
+	m_pBuffer8 = m_pBufferBase;
+
+	// the glyph cache is optional, characters are rendered directly without it
+	if (m_nDepth >= 8)
+	{
+		unsigned nGlyphSize =   m_CharGen.GetCharWidth () * m_CharGen.GetCharHeight ()
+				      * m_nDepth/8;
+
+		for (unsigned i = 0; i < TERMINAL_GLYPH_CACHE_SETS; i++)
+		{
+			m_GlyphCache[i].pGlyphs = new u8[256 * nGlyphSize];
+			m_GlyphCache[i].nLastUse = 0;
+			memset (m_GlyphCache[i].Valid, 0, sizeof m_GlyphCache[i].Valid);
+		}
+	}
+
 	m_pCursorPixels = new CDisplay::TRawColor[  m_CharGen.GetCharWidth ()
 						  * m_CharGen.GetCharHeight ()];
 	if (!m_pCursorPixels)
@@ -577,43 +613,9 @@ void CTerminalDevice::ClearDisplayEnd (void)
 	ClearLineEnd ();
 
 	unsigned nPosY = m_nCursorY + m_CharGen.GetCharHeight ();
-	unsigned nOffset = nPosY * m_nWidth;
 
-	switch (m_nDepth)
-	{
-	case 1: {
-			nOffset /= 8;
-			unsigned nSize = m_nSize - nOffset;
-			for (u8 *pBuffer = m_pBuffer8 + nOffset; nSize--;)
-			{
-				*pBuffer++ = m_BackgroundColor ? 0xFF : 0;
-			}
-		} break;
-
-	case 8: {
-			unsigned nSize = m_nSize - nOffset;
-			for (u8 *pBuffer = m_pBuffer8 + nOffset; nSize--;)
-			{
-				*pBuffer++ = (u8) m_BackgroundColor;
-			}
-		} break;
-
-	case 16: {
-			unsigned nSize = m_nSize / 2 - nOffset;
-			for (u16 *pBuffer = m_pBuffer16 + nOffset; nSize--;)
-			{
-				*pBuffer++ = (u16) m_BackgroundColor;
-			}
-		} break;
-
-	case 32: {
-			unsigned nSize = m_nSize / 4 - nOffset;
-			for (u32 *pBuffer = m_pBuffer32 + nOffset; nSize--;)
-			{
-				*pBuffer++ = (u32) m_BackgroundColor;
-			}
-		} break;
-	}
+	FillPixels (m_pBuffer8 + nPosY * m_nPitch, (m_nHeight - nPosY) * m_nWidth,
+		    m_BackgroundColor);
 
 	SetUpdateArea (m_nCursorY, m_nHeight-1);
 }
@@ -953,49 +955,39 @@ void CTerminalDevice::Scroll (void)
 {
 	unsigned nLines = m_CharGen.GetCharHeight ();
 
-	u8 *pTo = m_pBuffer8 + m_nScrollStart * m_nPitch;
-	u8 *pFrom = m_pBuffer8 + (m_nScrollStart + nLines) * m_nPitch;
-
-	unsigned nSize = m_nPitch * (m_nScrollEnd - m_nScrollStart - nLines);
-	if (nSize)
+	if (   m_nScrollStart == 0
+	    && m_nScrollEnd == m_nUsedHeight)
 	{
-		memcpy (pTo, pFrom, nSize);
+		// move the window down and copy it back, when the end of the buffer is reached
+		u8 *pFrom = m_pBuffer8 + nLines * m_nPitch;
+		if (pFrom + m_nSize > m_pBufferBase + m_nBufferSize)
+		{
+			memmove (m_pBufferBase, pFrom, m_nSize - nLines * m_nPitch);
 
-		pTo += nSize;
-	}
+			pFrom = m_pBufferBase;
+		}
 
-	nSize = m_nWidth * nLines;
-	switch (m_nDepth)
+		m_pBuffer8 = pFrom;
+
+		// clear the new row and the unused lines below it
+		unsigned nPosY = m_nUsedHeight - nLines;
+		FillPixels (m_pBuffer8 + nPosY * m_nPitch, (m_nHeight - nPosY) * m_nWidth,
+			    m_BackgroundColor);
+	}
+	else
 	{
-	case 1: {
-			nSize /= 8;
-			for (u8 *p = (u8 *) pTo; nSize--;)
-			{
-				*p++ = m_BackgroundColor ? 0xFF : 0;
-			}
-		}
-		break;
+		u8 *pTo = m_pBuffer8 + m_nScrollStart * m_nPitch;
+		u8 *pFrom = m_pBuffer8 + (m_nScrollStart + nLines) * m_nPitch;
 
-	case 8: {
-			for (u8 *p = (u8 *) pTo; nSize--;)
-			{
-				*p++ = (u8) m_BackgroundColor;
-			}
-		} break;
+		unsigned nSize = m_nPitch * (m_nScrollEnd - m_nScrollStart - nLines);
+		if (nSize)
+		{
+			memcpy (pTo, pFrom, nSize);
 
-	case 16: {
-			for (u16 *p = (u16 *) pTo; nSize--;)
-			{
-				*p++ = (u16) m_BackgroundColor;
-			}
-		} break;
+			pTo += nSize;
+		}
 
-	case 32: {
-			for (u32 *p = (u32 *) pTo; nSize--;)
-			{
-				*p++ = (u32) m_BackgroundColor;
-			}
-		} break;
+		FillPixels (pTo, m_nWidth * nLines, m_BackgroundColor);
 	}
 
 	SetUpdateArea (0, m_nHeight-1);
@@ -1004,14 +996,22 @@ void CTerminalDevice::Scroll (void)
 void CTerminalDevice::DisplayChar (char chChar, unsigned nPosX, unsigned nPosY,
 				   CDisplay::TRawColor nColor)
 {
-	for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+	const u8 *pGlyph = GetGlyph (chChar, nColor, GetTextBackgroundColor ());
+	if (pGlyph)
 	{
-		CCharGenerator::TPixelLine Line = m_CharGen.GetPixelLine (chChar, y);
-
-		for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
+		BlitGlyph (pGlyph, nPosX, nPosY);
+	}
+	else
+	{
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
 		{
-			SetRawPixel (nPosX + x, nPosY + y,   m_CharGen.GetPixel (x, Line)
-							   ? nColor : GetTextBackgroundColor ());
+			CCharGenerator::TPixelLine Line = m_CharGen.GetPixelLine (chChar, y);
+
+			for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
+			{
+				SetRawPixel (nPosX + x, nPosY + y,   m_CharGen.GetPixel (x, Line)
+								   ? nColor : GetTextBackgroundColor ());
+			}
 		}
 	}
 
@@ -1020,11 +1020,23 @@ void CTerminalDevice::DisplayChar (char chChar, unsigned nPosX, unsigned nPosY,
 
 void CTerminalDevice::EraseChar (unsigned nPosX, unsigned nPosY)
 {
-	for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+	if (m_nDepth >= 8)
 	{
-		for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
+		u8 *pBuffer = m_pBuffer8 + nPosY * m_nPitch + nPosX * m_nDepth/8;
+
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++, pBuffer += m_nPitch)
 		{
-			SetRawPixel (nPosX + x, nPosY + y, m_BackgroundColor);
+			FillPixels (pBuffer, m_CharGen.GetCharWidth (), m_BackgroundColor);
+		}
+	}
+	else
+	{
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+		{
+			for (unsigned x = 0; x < m_CharGen.GetCharWidth (); x++)
+			{
+				SetRawPixel (nPosX + x, nPosY + y, m_BackgroundColor);
+			}
 		}
 	}
 
@@ -1064,3 +1076,160 @@ void CTerminalDevice::InvertCursor (void)
 
 	SetUpdateArea (m_nCursorY + y0, m_nCursorY + m_CharGen.GetCharHeight ()-1);
 }
+
+const u8 *CTerminalDevice::GetGlyph (char chChar, CDisplay::TRawColor nColor,
+				     CDisplay::TRawColor nBackgroundColor)
+{
+	// find the cache set for this color combination or replace the least recently used
+	TGlyphCache *pCache = nullptr;
+	for (unsigned i = 0; i < TERMINAL_GLYPH_CACHE_SETS; i++)
+	{
+		TGlyphCache *pSet = &m_GlyphCache[i];
+		if (!pSet->pGlyphs)
+		{
+			return nullptr;
+		}
+
+		if (   pSet->nLastUse
+		    && pSet->Color == nColor
+		    && pSet->BackgroundColor == nBackgroundColor)
+		{
+			pCache = pSet;
+
+			break;
+		}
+
+		if (   !pCache
+		    || pSet->nLastUse < pCache->nLastUse)
+		{
+			pCache = pSet;
+		}
+	}
+
+	if (   pCache->Color != nColor
+	    || pCache->BackgroundColor != nBackgroundColor
+	    || !pCache->nLastUse)
+	{
+		pCache->Color = nColor;
+		pCache->BackgroundColor = nBackgroundColor;
+		memset (pCache->Valid, 0, sizeof pCache->Valid);
+	}
+
+	pCache->nLastUse = ++m_nGlyphCacheUse;
+
+	unsigned nWidth = m_CharGen.GetCharWidth ();
+	unsigned nHeight = m_CharGen.GetCharHeight ();
+
+	u8 uchChar = (u8) chChar;
+	u8 *pGlyph = pCache->pGlyphs + uchChar * nWidth * nHeight * m_nDepth/8;
+
+	u32 nMask = 1U << (uchChar & 31);
+	if (pCache->Valid[uchChar / 32] & nMask)
+	{
+		return pGlyph;
+	}
+
+	// render the glyph once
+	for (unsigned y = 0; y < nHeight; y++)
+	{
+		CCharGenerator::TPixelLine Line = m_CharGen.GetPixelLine (chChar, y);
+
+		for (unsigned x = 0; x < nWidth; x++)
+		{
+			CDisplay::TRawColor nPixel =   m_CharGen.GetPixel (x, Line)
+						     ? nColor : nBackgroundColor;
+			switch (m_nDepth)
+			{
+			case 8:	 pGlyph[y * nWidth + x] = (u8) nPixel;			break;
+			case 16: ((u16 *) pGlyph)[y * nWidth + x] = (u16) nPixel;	break;
+			case 32: ((u32 *) pGlyph)[y * nWidth + x] = nPixel;		break;
+			}
+		}
+	}
+
+	pCache->Valid[uchChar / 32] |= nMask;
+
+	return pGlyph;
+}
+
+void CTerminalDevice::BlitGlyph (const u8 *pGlyph, unsigned nPosX, unsigned nPosY)
+{
+	unsigned nRowSize = m_CharGen.GetCharWidth () * m_nDepth/8;
+	u8 *pBuffer = m_pBuffer8 + nPosY * m_nPitch + nPosX * m_nDepth/8;
+
+	if ((((uintptr) pBuffer | nRowSize | m_nPitch) & 3) == 0)
+	{
+		unsigned nWords = nRowSize / 4;
+
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+		{
+			u32 *pTo = (u32 *) pBuffer;
+			const u32 *pFrom = (const u32 *) pGlyph;
+
+			for (unsigned i = 0; i < nWords; i++)
+			{
+				*pTo++ = *pFrom++;
+			}
+
+			pGlyph += nRowSize;
+			pBuffer += m_nPitch;
+		}
+	}
+	else
+	{
+		for (unsigned y = 0; y < m_CharGen.GetCharHeight (); y++)
+		{
+			memcpy (pBuffer, pGlyph, nRowSize);
+
+			pGlyph += nRowSize;
+			pBuffer += m_nPitch;
+		}
+	}
+}
+
+void CTerminalDevice::FillPixels (u8 *pBuffer, unsigned nPixels, CDisplay::TRawColor nColor)
+{
+	u32 nPattern;
+	switch (m_nDepth)
+	{
+	case 1:
+		memset (pBuffer, nColor ? 0xFF : 0, nPixels / 8);
+		return;
+
+	case 8:
+		memset (pBuffer, (u8) nColor, nPixels);
+		return;
+
+	case 16:
+		nPattern = (u16) nColor * 0x10001U;
+		break;
+
+	case 32:
+		nPattern = nColor;
+		break;
+
+	default:
+		return;
+	}
+
+	unsigned nSize = nPixels * m_nDepth/8;
+
+	// the pattern is rotated by one byte per byte written, until the buffer is aligned
+	for (; ((uintptr) pBuffer & 3) && nSize; nSize--)
+	{
+		*pBuffer++ = (u8) nPattern;
+		nPattern = nPattern >> 8 | nPattern << 24;
+	}
+
+	u32 *pBuffer32 = (u32 *) pBuffer;
+	for (; nSize >= 4; nSize -= 4)
+	{
+		*pBuffer32++ = nPattern;
+	}
+
+	for (pBuffer = (u8 *) pBuffer32; nSize; nSize--)
+	{
+		*pBuffer++ = (u8) nPattern;
+		nPattern = nPattern >> 8 | nPattern << 24;
+	}
+}
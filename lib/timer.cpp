@@ -2,7 +2,7 @@
 // timer.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,8 +21,10 @@
 #include <circle/bcm2835.h>
 #include <circle/bcm2836.h>
 #include <circle/memio.h>
+#include <circle/multicore.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
+#include <circle/latencymonitor.h>
 #include <circle/debug.h>
 #include <assert.h>
 
@@ -30,18 +32,6 @@
 	#error USE_PHYSICAL_COUNTER is required on Raspberry Pi 4!
 #endif
 
-struct TKernelTimer
-{
-#ifndef NDEBUG
-	unsigned	     m_nMagic;
-#define KERNEL_TIMER_MAGIC	0x4B544D43
-#endif
-	TKernelTimerHandler *m_pHandler;
-	unsigned	     m_nElapsesAt;
-	void 		    *m_pParam;
-	void 		    *m_pContext;
-};
-
 static const char FromTimer[] = "timer";
 
 const unsigned CTimer::s_nDaysOfMonth[12] = {31, 28, 31, 30, 31, 30, 31, 31, 30, 31, 30, 31};
@@ -52,10 +42,24 @@ CTimer *CTimer::s_pThis = 0;
 
 CTimer::CTimer (CInterruptSystem *pInterruptSystem)
 :	m_pInterruptSystem (pInterruptSystem),
+#ifndef USE_TICKLESS_TIMER
 	m_nTicks (0),
 	m_nUptime (0),
 	m_nTime (0),
+#else
+	m_nBootClockTicks (0),
+	m_nTime (0),
+	m_nLastPeriodicTicks (0),
+#endif
+	m_nWallSequence (0),
+	m_ullWallRefTicks (0),
+	m_ullWallRefTime (0),
+	m_nWallRatePPB (0),
+	m_ullWallSlewUs (0),
 	m_nMinutesDiff (0),
+#ifdef USE_TICKLESS_TIMER
+	m_nNextEvent (0),
+#endif
 	m_nMsDelay (200000),
 	m_nusDelay (m_nMsDelay / 1000),
 	m_pUpdateTimeHandler (0),
@@ -80,18 +84,6 @@ CTimer::~CTimer (void)
 	m_pInterruptSystem->DisconnectIRQ (ARM_IRQLOCAL0_CNTPNS);
 #endif
 
-	TPtrListElement *pElement;
-	while ((pElement = m_KernelTimerList.GetFirst ()) != 0)
-	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		m_KernelTimerList.Remove (pElement);
-
-		delete pTimer;
-	}
-
 	s_pThis = 0;
 }
 
@@ -131,7 +123,11 @@ boolean CTimer::Initialize (void)
 	asm volatile ("msr CNTP_CTL_EL0, %0" :: "r" (1UL));
 #endif
 #endif
-	
+
+#ifdef USE_TICKLESS_TIMER
+	m_nBootClockTicks = GetClockTicks64 ();	// the first interrupt occurs after one tick
+#endif
+
 #ifdef CALIBRATE_DELAY
 	TuneMsDelay ();
 #endif
@@ -201,10 +197,30 @@ boolean CTimer::SetTime (unsigned nTime, boolean bLocal)
 
 	m_TimeSpinLock.Acquire ();
 
+#ifndef USE_TICKLESS_TIMER
 	m_nTime = nTime;
+#else
+	m_nTime = nTime - GetUptime ();
+#endif
 
 	m_TimeSpinLock.Release ();
 
+	// the wall clock is more precise, set it only if it is off by at least one second
+	if (   nSecondsDiff > 0
+	    && nTime < (unsigned) nSecondsDiff)
+	{
+		return TRUE;
+	}
+
+	u64 ullUniversalTimeUs = (u64) (nTime - nSecondsDiff) * 1000000;
+	u64 ullWallClock = GetWallClockUs ();
+	if (   ullWallClock == 0
+	    || ullWallClock + 1000000 <= ullUniversalTimeUs
+	    || ullUniversalTimeUs + 1000000 <= ullWallClock)
+	{
+		AdjustWallClock (GetClockTicks64 (), ullUniversalTimeUs, m_nWallRatePPB);
+	}
+
 	return TRUE;
 }
 
@@ -272,29 +288,43 @@ u64 CTimer::GetClockTicks64 (void)
 	u64 nCNTFRQ;
 	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
 
-	return nCNTPCT * CLOCKHZ / nCNTFRQ;
+	// split up, because nCNTPCT * CLOCKHZ would overflow after some days
+	return nCNTPCT / nCNTFRQ * CLOCKHZ + nCNTPCT % nCNTFRQ * CLOCKHZ / nCNTFRQ;
 #endif
 #endif
 }
 
 unsigned CTimer::GetTicks (void) const
 {
+#ifndef USE_TICKLESS_TIMER
 	return m_nTicks;
+#else
+	return (unsigned) ((GetClockTicks64 () - m_nBootClockTicks) / (CLOCKHZ / HZ));
+#endif
 }
 
 unsigned CTimer::GetUptime (void) const
 {
+#ifndef USE_TICKLESS_TIMER
 	return m_nUptime;
+#else
+	return (unsigned) ((GetClockTicks64 () - m_nBootClockTicks) / CLOCKHZ);
+#endif
 }
 
 boolean CTimer::GetUptime (unsigned *pSeconds, unsigned *pMicroSeconds)
 {
+#ifndef USE_TICKLESS_TIMER
 	m_TimeSpinLock.Acquire ();
 
 	unsigned nTime = m_nUptime;
 	unsigned nTicks = m_nTicks;
 
 	m_TimeSpinLock.Release ();
+#else
+	unsigned nTime, nTicks;
+	GetUptimeAndTicks (&nTime, &nTicks);
+#endif
 
 	assert (pSeconds != 0);
 	*pSeconds = nTime;
@@ -307,17 +337,38 @@ boolean CTimer::GetUptime (unsigned *pSeconds, unsigned *pMicroSeconds)
 
 unsigned CTimer::GetTime (void) const
 {
+	unsigned nSeconds, nMicroSeconds;
+	if (GetWallClockLocal (&nSeconds, &nMicroSeconds))
+	{
+		return nSeconds;
+	}
+
+#ifndef USE_TICKLESS_TIMER
 	return m_nTime;
+#else
+	return m_nTime + GetUptime ();
+#endif
 }
 
 boolean CTimer::GetLocalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 {
+	if (GetWallClockLocal (pSeconds, pMicroSeconds))
+	{
+		return TRUE;
+	}
+
+#ifndef USE_TICKLESS_TIMER
 	m_TimeSpinLock.Acquire ();
 
 	unsigned nTime = m_nTime;
 	unsigned nTicks = m_nTicks;
 
 	m_TimeSpinLock.Release ();
+#else
+	unsigned nTime, nTicks;
+	GetUptimeAndTicks (&nTime, &nTicks);
+	nTime += m_nTime;
+#endif
 
 	assert (pSeconds != 0);
 	*pSeconds = nTime;
@@ -330,7 +381,7 @@ boolean CTimer::GetLocalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 
 unsigned CTimer::GetUniversalTime (void) const
 {
-	unsigned nResult = m_nTime;
+	unsigned nResult = GetTime ();
 
 	int nSecondsDiff = m_nMinutesDiff * 60;
 	if (nSecondsDiff > (int) nResult)
@@ -343,12 +394,30 @@ unsigned CTimer::GetUniversalTime (void) const
 
 boolean CTimer::GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 {
+	u64 ullWallClock = GetWallClockUs ();
+	if (ullWallClock != 0)
+	{
+		assert (pSeconds != 0);
+		*pSeconds = (unsigned) (ullWallClock / 1000000);
+
+		assert (pMicroSeconds != 0);
+		*pMicroSeconds = (unsigned) (ullWallClock % 1000000);
+
+		return TRUE;
+	}
+
+#ifndef USE_TICKLESS_TIMER
 	m_TimeSpinLock.Acquire ();
 
 	unsigned nTime = m_nTime;
 	unsigned nTicks = m_nTicks;
 
 	m_TimeSpinLock.Release ();
+#else
+	unsigned nTime, nTicks;
+	GetUptimeAndTicks (&nTime, &nTicks);
+	nTime += m_nTime;
+#endif
 
 	int nSecondsDiff = m_nMinutesDiff * 60;
 	if (nSecondsDiff > (int) nTime)
@@ -365,21 +434,150 @@ boolean CTimer::GetUniversalTime (unsigned *pSeconds, unsigned *pMicroSeconds)
 	return TRUE;
 }
 
-CString *CTimer::GetTimeString (void)
+void CTimer::AdjustWallClock (u64 ullClockTicks, u64 ullUniversalTimeUs, int nRatePPB)
 {
+	if (nRatePPB > WALL_CLOCK_MAX_PPB)
+	{
+		nRatePPB = WALL_CLOCK_MAX_PPB;
+	}
+	else if (nRatePPB < -WALL_CLOCK_MAX_PPB)
+	{
+		nRatePPB = -WALL_CLOCK_MAX_PPB;
+	}
+
 	m_TimeSpinLock.Acquire ();
 
-	unsigned nTime = m_nTime;
-	unsigned nTicks = m_nTicks;
+	// move the reference point to now
+	u64 ullNow = GetClockTicks64 ();
+	s64 nDelta = (s64) (ullNow - ullClockTicks);
+	u64 ullNewTime = ullUniversalTimeUs + nDelta + nDelta * nRatePPB / 1000000000;
+
+	u64 ullOldTime = GetWallClock (ullNow);
+	u64 ullSlew = 0;
+	if (   ullOldTime != 0
+	    && ullNewTime < ullOldTime
+	    && ullOldTime - ullNewTime <= WALL_CLOCK_SLEW_MAX_US)
+	{
+		ullSlew = ullOldTime - ullNewTime;
+		ullNewTime = ullOldTime;
+	}
+
+	__atomic_store_n (&m_nWallSequence, m_nWallSequence+1, __ATOMIC_RELAXED);
+	DataMemBarrier ();
+
+	m_ullWallRefTicks = ullNow;
+	m_ullWallRefTime = ullNewTime;
+	m_nWallRatePPB = nRatePPB;
+	m_ullWallSlewUs = ullSlew;
+
+	DataMemBarrier ();
+	__atomic_store_n (&m_nWallSequence, m_nWallSequence+1, __ATOMIC_RELAXED);
 
 	m_TimeSpinLock.Release ();
+}
 
-	if (   nTime == 0
-	    && nTicks == 0)
+u64 CTimer::GetWallClockUs (void) const
+{
+	while (1)
+	{
+		unsigned nSequence = __atomic_load_n (&m_nWallSequence, __ATOMIC_ACQUIRE);
+		if (nSequence & 1)
+		{
+			continue;		// currently written
+		}
+
+		DataMemBarrier ();
+
+		u64 ullResult = GetWallClock (GetClockTicks64 ());
+
+		DataMemBarrier ();
+
+		if (__atomic_load_n (&m_nWallSequence, __ATOMIC_RELAXED) == nSequence)
+		{
+			return ullResult;
+		}
+	}
+}
+
+u64 CTimer::GetWallClock (u64 ullClockTicks) const
+{
+	if (m_ullWallRefTime == 0)
 	{
 		return 0;
 	}
 
+	s64 nDelta = (s64) (ullClockTicks - m_ullWallRefTicks);
+	if (nDelta < 0)
+	{
+		nDelta = 0;		// clock ticks have been read on another core before update
+	}
+
+	u64 ullResult = m_ullWallRefTime + nDelta + nDelta * m_nWallRatePPB / 1000000000;
+
+	u64 ullSlew = (u64) nDelta * WALL_CLOCK_SLEW_PPM / 1000000;
+	if (ullSlew > m_ullWallSlewUs)
+	{
+		ullSlew = m_ullWallSlewUs;
+	}
+
+	return ullResult - ullSlew;
+}
+
+boolean CTimer::GetWallClockLocal (unsigned *pSeconds, unsigned *pMicroSeconds) const
+{
+	u64 ullWallClock = GetWallClockUs ();
+	if (ullWallClock == 0)
+	{
+		return FALSE;
+	}
+
+	s64 nLocal = (s64) ullWallClock + (s64) m_nMinutesDiff * 60 * 1000000;
+	if (nLocal < 0)
+	{
+		return FALSE;
+	}
+
+	assert (pSeconds != 0);
+	*pSeconds = (unsigned) (nLocal / 1000000);
+
+	assert (pMicroSeconds != 0);
+	*pMicroSeconds = (unsigned) (nLocal % 1000000);
+
+	return TRUE;
+}
+
+CString *CTimer::GetTimeString (void)
+{
+	unsigned nTime, nTicks;
+	if (GetWallClockLocal (&nTime, &nTicks))
+	{
+		nTicks = nTicks / (1000000 / HZ);
+	}
+	else
+	{
+#ifndef USE_TICKLESS_TIMER
+		m_TimeSpinLock.Acquire ();
+
+		nTime = m_nTime;
+		nTicks = m_nTicks;
+
+		m_TimeSpinLock.Release ();
+#else
+		GetUptimeAndTicks (&nTime, &nTicks);
+		nTime += m_nTime;
+#endif
+
+#ifndef USE_TICKLESS_TIMER
+		if (   nTime == 0
+		    && nTicks == 0)
+#else
+		if (m_nBootClockTicks == 0)
+#endif
+		{
+			return 0;
+		}
+	}
+
 	unsigned nSecond = nTime % 60;
 	nTime /= 60;
 	unsigned nMinute = nTime % 60;
@@ -441,72 +639,63 @@ TKernelTimerHandle CTimer::StartKernelTimer (unsigned nDelay,
 					     void *pParam,
 					     void *pContext)
 {
-	TKernelTimer *pTimer = new TKernelTimer;
-	assert (pTimer != 0);
+#ifndef USE_TICKLESS_TIMER
+	return AddKernelTimer (nDelay, pHandler, pParam, pContext);
+#else
+	return AddKernelTimer ((u64) nDelay * (CLOCKHZ / HZ), pHandler, pParam, pContext);
+#endif
+}
 
-	unsigned nElapsesAt = m_nTicks + nDelay;
+TKernelTimerHandle CTimer::StartKernelTimerUs (unsigned nMicroSeconds,
+					       TKernelTimerHandler *pHandler,
+					       void *pParam,
+					       void *pContext)
+{
+#ifndef USE_TICKLESS_TIMER
+	return AddKernelTimer ((nMicroSeconds + CLOCKHZ / HZ - 1) / (CLOCKHZ / HZ),
+			       pHandler, pParam, pContext);
+#else
+	return AddKernelTimer (nMicroSeconds, pHandler, pParam, pContext);
+#endif
+}
 
+TKernelTimerHandle CTimer::AddKernelTimer (u64 nDelay,
+					   TKernelTimerHandler *pHandler,
+					   void *pParam, void *pContext)
+{
 	assert (pHandler != 0);
-#ifndef NDEBUG
-	pTimer->m_nMagic     = KERNEL_TIMER_MAGIC;
-#endif
-	pTimer->m_pHandler   = pHandler;
-	pTimer->m_nElapsesAt = nElapsesAt;
-	pTimer->m_pParam     = pParam;
-	pTimer->m_pContext   = pContext;
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pPrevElement = 0;
-	TPtrListElement *pElement = m_KernelTimerList.GetFirst ();
-	while (pElement != 0)
-	{
-		TKernelTimer *pTimer2 = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer2 != 0);
-		assert (pTimer2->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		if ((int) (pTimer2->m_nElapsesAt-nElapsesAt) > 0)
-		{
-			break;
-		}
+	u64 nElapsesAt = GetKernelTimerTime () + nDelay;
 
-		pPrevElement = pElement;
-		pElement = m_KernelTimerList.GetNext (pElement);
-	}
+	TKernelTimerHandle hTimer = m_KernelTimerWheel.Add (nElapsesAt, pHandler, pParam, pContext);
 
-	if (pElement != 0)
-	{
-		m_KernelTimerList.InsertBefore (pElement, pTimer);
-	}
-	else
+#ifdef USE_TICKLESS_TIMER
+	// the timer of core 0 can be programmed from core 0 only
+#if defined (ARM_ALLOW_MULTI_CORE) && defined (USE_PHYSICAL_COUNTER)
+	if (CMultiCoreSupport::ThisCore () == 0)
+#endif
 	{
-		m_KernelTimerList.InsertAfter (pPrevElement, pTimer);
+		if (nElapsesAt < m_nNextEvent)
+		{
+			ProgramNextEvent ();
+		}
 	}
+#endif
 
 	m_KernelTimerSpinLock.Release ();
 
-	return (TKernelTimerHandle) pTimer;
+	return hTimer;
 }
 
 void CTimer::CancelKernelTimer (TKernelTimerHandle hTimer)
 {
-	TKernelTimer *pTimer = (TKernelTimer *) hTimer;
-	assert (pTimer != 0);
+	assert (hTimer != 0);
 
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement = m_KernelTimerList.Find (pTimer);
-	if (pElement != 0)
-	{
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		m_KernelTimerList.Remove (pElement);
-
-#ifndef NDEBUG
-		pTimer->m_nMagic = 0;
-#endif
-		delete pTimer;
-	}
+	m_KernelTimerWheel.Remove (hTimer);
 
 	m_KernelTimerSpinLock.Release ();
 }
@@ -515,30 +704,18 @@ void CTimer::PollKernelTimers (void)
 {
 	m_KernelTimerSpinLock.Acquire ();
 
-	TPtrListElement *pElement;
-	while ((pElement = m_KernelTimerList.GetFirst ()) != 0)
-	{
-		TKernelTimer *pTimer = (TKernelTimer *) m_KernelTimerList.GetPtr (pElement);
-		assert (pTimer != 0);
-		assert (pTimer->m_nMagic == KERNEL_TIMER_MAGIC);
-
-		if ((int) (pTimer->m_nElapsesAt-m_nTicks) > 0)
-		{
-			break;
-		}
-
-		m_KernelTimerList.Remove (pElement);
+	u64 nNow = GetKernelTimerTime ();
 
+	TKernelTimerHandle hTimer;
+	TKernelTimerHandler *pHandler;
+	void *pParam;
+	void *pContext;
+	while (m_KernelTimerWheel.GetElapsed (nNow, &hTimer, &pHandler, &pParam, &pContext))
+	{
 		m_KernelTimerSpinLock.Release ();
 
-		TKernelTimerHandler *pHandler = pTimer->m_pHandler;
 		assert (pHandler != 0);
-		(*pHandler) ((TKernelTimerHandle) pTimer, pTimer->m_pParam, pTimer->m_pContext);
-
-#ifndef NDEBUG
-		pTimer->m_nMagic = 0;
-#endif
-		delete pTimer;
+		(*pHandler) (hTimer, pParam, pContext);
 
 		m_KernelTimerSpinLock.Acquire ();
 	}
@@ -546,8 +723,101 @@ void CTimer::PollKernelTimers (void)
 	m_KernelTimerSpinLock.Release ();
 }
 
+u64 CTimer::GetKernelTimerTime (void) const
+{
+#ifndef USE_TICKLESS_TIMER
+	// extend m_nTicks to 64 bits, the wheel has been advanced less than 2^32 ticks ago
+	u64 nWheelTime = m_KernelTimerWheel.GetTime ();
+
+	return nWheelTime + (unsigned) (m_nTicks - (unsigned) nWheelTime);
+#else
+	return GetClockTicks64 ();
+#endif
+}
+
+#ifdef LATENCY_MONITOR
+
+// returns the time since the timer compare value has been reached in nanoseconds
+static unsigned GetCompareLatency (void)
+{
+#ifndef USE_PHYSICAL_COUNTER
+	PeripheralEntry ();
+
+	u32 nDelay = read32 (ARM_SYSTIMER_CLO) - read32 (ARM_SYSTIMER_C3);
+
+	PeripheralExit ();
+
+	u64 nNanoSeconds = (u64) nDelay * (1000000000U / CLOCKHZ);
+#else
+#if AARCH == 32
+	InstructionSyncBarrier ();
+
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+	u32 nCNTP_CVALLow, nCNTP_CVALHigh;
+	asm volatile ("mrrc p15, 2, %0, %1, c14" : "=r" (nCNTP_CVALLow), "=r" (nCNTP_CVALHigh));
+
+	// the counter runs at CLOCKHZ here (see Initialize())
+	u64 nNanoSeconds =   (  ((u64) nCNTPCTHigh << 32 | nCNTPCTLow)
+			      - ((u64) nCNTP_CVALHigh << 32 | nCNTP_CVALLow))
+			   * (1000000000U / CLOCKHZ);
+#else
+	InstructionSyncBarrier ();
+
+	u64 nCNTPCT, nCNTP_CVAL, nCNTFRQ;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+	asm volatile ("mrs %0, CNTP_CVAL_EL0" : "=r" (nCNTP_CVAL));
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	u64 nNanoSeconds = (nCNTPCT - nCNTP_CVAL) * 1000000000U / nCNTFRQ;
+#endif
+#endif
+
+	return nNanoSeconds < 0xFFFFFFFFU ? (unsigned) nNanoSeconds : 0xFFFFFFFFU;
+}
+
+#endif
+
 void CTimer::InterruptHandler (void)
 {
+#ifdef LATENCY_MONITOR
+	if (CLatencyMonitor::IsActive ())
+	{
+		CLatencyMonitor::Record (LatencyIRQEntry, GetCompareLatency ());
+	}
+#endif
+
+#ifdef USE_TICKLESS_TIMER
+#ifndef USE_PHYSICAL_COUNTER
+	PeripheralEntry ();
+
+	write32 (ARM_SYSTIMER_CS, 1 << 3);
+
+	PeripheralExit ();
+#endif
+
+	PollKernelTimers ();
+
+	if (m_nPeriodicHandlers > 0)
+	{
+		unsigned nTicks = GetTicks ();
+		if (nTicks != m_nLastPeriodicTicks)
+		{
+			m_nLastPeriodicTicks = nTicks;
+
+			for (unsigned i = 0; i < m_nPeriodicHandlers; i++)
+			{
+				(*m_pPeriodicHandler[i]) ();
+			}
+		}
+	}
+
+	m_KernelTimerSpinLock.Acquire ();
+
+	ProgramNextEvent ();
+
+	m_KernelTimerSpinLock.Release ();
+#else
 #ifndef USE_PHYSICAL_COUNTER
 	PeripheralEntry ();
 
@@ -598,8 +868,94 @@ void CTimer::InterruptHandler (void)
 	{
 		(*m_pPeriodicHandler[i]) ();
 	}
+#endif
+
+#if RASPPI != 1
+	SendEvent ();		// wake CPU cores, which are waiting in the scheduler idle loop
+#endif
 }
 
+#ifdef USE_TICKLESS_TIMER
+
+void CTimer::GetUptimeAndTicks (unsigned *pUptime, unsigned *pTicks) const
+{
+	u64 nClockTicks = GetClockTicks64 () - m_nBootClockTicks;
+
+	assert (pUptime != 0);
+	*pUptime = (unsigned) (nClockTicks / CLOCKHZ);
+
+	assert (pTicks != 0);
+	*pTicks = (unsigned) (nClockTicks / (CLOCKHZ / HZ));
+}
+
+void CTimer::ProgramNextEvent (void)
+{
+	u64 nNow = GetClockTicks64 ();
+	u64 nDeadline = nNow + TICKLESS_MAX_IDLE_US;
+
+	u64 nNextTimer = m_KernelTimerWheel.GetNextEvent ();
+	if (nNextTimer < nDeadline)
+	{
+		nDeadline = nNextTimer;
+	}
+
+	if (m_nPeriodicHandlers > 0)
+	{
+		u64 nNextTick =   m_nBootClockTicks
+				+ ((nNow - m_nBootClockTicks) / (CLOCKHZ / HZ) + 1) * (CLOCKHZ / HZ);
+		if (nNextTick < nDeadline)
+		{
+			nDeadline = nNextTick;
+		}
+	}
+
+	m_nNextEvent = nDeadline;
+
+	ProgramOneShot (nDeadline > nNow ? (unsigned) (nDeadline - nNow) : 0);
+}
+
+void CTimer::ProgramOneShot (unsigned nMicroSeconds)
+{
+#ifndef USE_PHYSICAL_COUNTER
+	PeripheralEntry ();
+
+	// the compare register matches only, if it is set to a time in the future
+	u32 nCompare = read32 (ARM_SYSTIMER_CLO) + nMicroSeconds;
+	while ((int) (nCompare - read32 (ARM_SYSTIMER_CLO)) < 2)
+	{
+		nCompare = read32 (ARM_SYSTIMER_CLO) + 2;
+	}
+
+	write32 (ARM_SYSTIMER_C3, nCompare);
+
+	PeripheralExit ();
+#else
+#if AARCH == 32
+	InstructionSyncBarrier ();
+
+	u32 nCNTPCTLow, nCNTPCTHigh;
+	asm volatile ("mrrc p15, 0, %0, %1, c14" : "=r" (nCNTPCTLow), "=r" (nCNTPCTHigh));
+
+	// the counter runs at CLOCKHZ here (see Initialize())
+	u64 nCNTP_CVAL = ((u64) nCNTPCTHigh << 32 | nCNTPCTLow) + nMicroSeconds;
+	asm volatile ("mcrr p15, 2, %0, %1, c14" :: "r" (nCNTP_CVAL & 0xFFFFFFFFU),
+						    "r" (nCNTP_CVAL >> 32));
+#else
+	InstructionSyncBarrier ();
+
+	u64 nCNTPCT;
+	asm volatile ("mrs %0, CNTPCT_EL0" : "=r" (nCNTPCT));
+	u64 nCNTFRQ;
+	asm volatile ("mrs %0, CNTFRQ_EL0" : "=r" (nCNTFRQ));
+
+	// an already expired compare value triggers the interrupt immediately
+	asm volatile ("msr CNTP_CVAL_EL0, %0" :: "r" (nCNTPCT + nMicroSeconds * nCNTFRQ / CLOCKHZ));
+#endif
+#endif
+}
+
+#endif
+
 void CTimer::InterruptHandler (void *pParam)
 {
 	CTimer *pThis = (CTimer *) pParam;
@@ -0,0 +1,401 @@
+//
+// timerwheel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/timerwheel.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define ENTRIES_PER_CHUNK	64
+
+#define HANDLE_INDEX_BITS	20			// lower bits of handle are index+1
+#define HANDLE_INDEX_MASK	((1U << HANDLE_INDEX_BITS) - 1)
+
+struct TTimerWheelEntry
+{
+	TTimerWheelEntry    *pNext;
+	TTimerWheelEntry    *pPrev;
+	TTimerWheelEntry   **ppHead;			// list, the entry is linked in, 0 if free
+
+	unsigned	     nIndex;
+	unsigned	     nGeneration;		// incremented, when the entry is freed
+
+	u64		     nElapsesAt;
+	TKernelTimerHandler *pHandler;
+	void 		    *pParam;
+	void 		    *pContext;
+};
+
+CTimerWheel::CTimerWheel (void)
+:	m_nTime (0),
+	m_pElapsed (0),
+	m_ppChunk (0),
+	m_nChunks (0),
+	m_pFreeHead (0),
+	m_pFreeTail (0)
+{
+	for (unsigned nLevel = 0; nLevel < TIMER_WHEEL_LEVELS; nLevel++)
+	{
+		for (unsigned nSlot = 0; nSlot < TIMER_WHEEL_SLOTS; nSlot++)
+		{
+			m_pSlot[nLevel][nSlot] = 0;
+		}
+
+		m_nSlotMask[nLevel] = 0;
+	}
+}
+
+CTimerWheel::~CTimerWheel (void)
+{
+	for (unsigned i = 0; i < m_nChunks; i++)
+	{
+		delete [] m_ppChunk[i];
+	}
+
+	delete [] m_ppChunk;
+	m_ppChunk = 0;
+}
+
+TKernelTimerHandle CTimerWheel::Add (u64 nElapsesAt, TKernelTimerHandler *pHandler,
+				     void *pParam, void *pContext)
+{
+	TTimerWheelEntry *pEntry = AllocateEntry ();
+	assert (pEntry != 0);
+
+	if (nElapsesAt <= m_nTime)
+	{
+		nElapsesAt = m_nTime + 1;
+	}
+
+	assert (pHandler != 0);
+	pEntry->nElapsesAt = nElapsesAt;
+	pEntry->pHandler   = pHandler;
+	pEntry->pParam     = pParam;
+	pEntry->pContext   = pContext;
+
+	Insert (pEntry);
+
+	return   (pEntry->nIndex + 1)
+	       | (TKernelTimerHandle) pEntry->nGeneration << HANDLE_INDEX_BITS;
+}
+
+boolean CTimerWheel::Remove (TKernelTimerHandle hTimer)
+{
+	unsigned nIndex = (unsigned) (hTimer & HANDLE_INDEX_MASK);
+	if (   nIndex == 0
+	    || nIndex > m_nChunks * ENTRIES_PER_CHUNK)
+	{
+		return FALSE;
+	}
+
+	nIndex--;
+	TTimerWheelEntry *pEntry = &m_ppChunk[nIndex / ENTRIES_PER_CHUNK][nIndex % ENTRIES_PER_CHUNK];
+	assert (pEntry->nIndex == nIndex);
+
+	if (   pEntry->ppHead == 0
+	    ||    (hTimer & ~(TKernelTimerHandle) HANDLE_INDEX_MASK)
+	       != (TKernelTimerHandle) pEntry->nGeneration << HANDLE_INDEX_BITS)
+	{
+		return FALSE;
+	}
+
+	Unlink (pEntry);
+	FreeEntry (pEntry);
+
+	return TRUE;
+}
+
+boolean CTimerWheel::GetElapsed (u64 nNow, TKernelTimerHandle *phTimer,
+				 TKernelTimerHandler **ppHandler, void **ppParam, void **ppContext)
+{
+	while (m_pElapsed == 0)
+	{
+		u64 nNextEvent = GetNextEvent ();
+		if (nNextEvent > nNow)
+		{
+			if (nNow > m_nTime)
+			{
+				m_nTime = nNow;
+			}
+
+			return FALSE;
+		}
+
+		Advance (nNextEvent);
+	}
+
+	TTimerWheelEntry *pEntry = m_pElapsed;
+	Unlink (pEntry);
+
+	assert (phTimer != 0);
+	*phTimer =   (pEntry->nIndex + 1)
+		   | (TKernelTimerHandle) pEntry->nGeneration << HANDLE_INDEX_BITS;
+	assert (ppHandler != 0);
+	*ppHandler = pEntry->pHandler;
+	assert (ppParam != 0);
+	*ppParam = pEntry->pParam;
+	assert (ppContext != 0);
+	*ppContext = pEntry->pContext;
+
+	FreeEntry (pEntry);
+
+	return TRUE;
+}
+
+u64 CTimerWheel::GetNextEvent (void) const
+{
+	if (m_pElapsed != 0)
+	{
+		return m_nTime;
+	}
+
+	u64 nResult = (u64) -1;
+
+	for (unsigned nLevel = 0; nLevel < TIMER_WHEEL_LEVELS; nLevel++)
+	{
+		u64 nMask = m_nSlotMask[nLevel];
+		if (nMask == 0)
+		{
+			continue;
+		}
+
+		// the next slot to be processed at this level is the first one after the current
+		unsigned nShift = nLevel * TIMER_WHEEL_BITS;
+		unsigned nFirst = ((m_nTime >> nShift) + 1) % TIMER_WHEEL_SLOTS;
+		if (nFirst != 0)
+		{
+			nMask = nMask >> nFirst | nMask << (TIMER_WHEEL_SLOTS - nFirst);
+		}
+
+		unsigned nDistance = __builtin_ctzll (nMask) + 1;	// 1..TIMER_WHEEL_SLOTS
+		u64 nTime = ((m_nTime >> nShift) + nDistance) << nShift;
+		if (nTime < nResult)
+		{
+			nResult = nTime;
+		}
+	}
+
+	return nResult;
+}
+
+void CTimerWheel::Advance (u64 nTime)
+{
+	assert (nTime > m_nTime);
+	m_nTime = nTime;
+
+	// cascade timers from the upper levels, where a slot boundary has been reached
+	for (unsigned nLevel = 1; nLevel < TIMER_WHEEL_LEVELS; nLevel++)
+	{
+		if (nTime & ((1ULL << (nLevel * TIMER_WHEEL_BITS)) - 1))
+		{
+			break;
+		}
+
+		Cascade (nLevel);
+	}
+
+	// move the timers of the current slot of level 0 to the elapsed list
+	unsigned nSlot = nTime % TIMER_WHEEL_SLOTS;
+	TTimerWheelEntry *pEntry;
+	while ((pEntry = m_pSlot[0][nSlot]) != 0)
+	{
+		assert (pEntry->nElapsesAt == nTime);
+
+		Unlink (pEntry);
+
+		pEntry->pPrev = 0;
+		pEntry->pNext = m_pElapsed;
+		if (m_pElapsed != 0)
+		{
+			m_pElapsed->pPrev = pEntry;
+		}
+		m_pElapsed = pEntry;
+		pEntry->ppHead = &m_pElapsed;
+	}
+}
+
+void CTimerWheel::Cascade (unsigned nLevel)
+{
+	unsigned nSlot = (m_nTime >> (nLevel * TIMER_WHEEL_BITS)) % TIMER_WHEEL_SLOTS;
+
+	TTimerWheelEntry *pEntry = m_pSlot[nLevel][nSlot];
+	m_pSlot[nLevel][nSlot] = 0;
+	m_nSlotMask[nLevel] &= ~(1ULL << nSlot);
+
+	while (pEntry != 0)
+	{
+		TTimerWheelEntry *pNext = pEntry->pNext;
+
+		if (pEntry->nElapsesAt == m_nTime)
+		{
+			pEntry->pPrev = 0;
+			pEntry->pNext = m_pElapsed;
+			if (m_pElapsed != 0)
+			{
+				m_pElapsed->pPrev = pEntry;
+			}
+			m_pElapsed = pEntry;
+			pEntry->ppHead = &m_pElapsed;
+		}
+		else
+		{
+			Insert (pEntry);
+		}
+
+		pEntry = pNext;
+	}
+}
+
+void CTimerWheel::Insert (TTimerWheelEntry *pEntry)
+{
+	assert (pEntry != 0);
+	assert (pEntry->nElapsesAt > m_nTime);
+
+	u64 nDelta = pEntry->nElapsesAt - m_nTime;
+	u64 nElapsesAt = pEntry->nElapsesAt;
+
+	// timers beyond the range of the wheel are placed into the last slot and
+	// are inserted again, when this slot is cascaded
+	const u64 nMaxDelta = (1ULL << (TIMER_WHEEL_LEVELS * TIMER_WHEEL_BITS)) - 1;
+	if (nDelta > nMaxDelta)
+	{
+		nDelta = nMaxDelta;
+		nElapsesAt = m_nTime + nMaxDelta;
+	}
+
+	unsigned nLevel = 0;
+	while (nDelta >= 1ULL << ((nLevel+1) * TIMER_WHEEL_BITS))
+	{
+		nLevel++;
+	}
+	assert (nLevel < TIMER_WHEEL_LEVELS);
+
+	unsigned nSlot = (nElapsesAt >> (nLevel * TIMER_WHEEL_BITS)) % TIMER_WHEEL_SLOTS;
+
+	TTimerWheelEntry **ppHead = &m_pSlot[nLevel][nSlot];
+	pEntry->pPrev = 0;
+	pEntry->pNext = *ppHead;
+	if (*ppHead != 0)
+	{
+		(*ppHead)->pPrev = pEntry;
+	}
+	*ppHead = pEntry;
+	pEntry->ppHead = ppHead;
+
+	m_nSlotMask[nLevel] |= 1ULL << nSlot;
+}
+
+void CTimerWheel::Unlink (TTimerWheelEntry *pEntry)
+{
+	assert (pEntry != 0);
+	TTimerWheelEntry **ppHead = pEntry->ppHead;
+	assert (ppHead != 0);
+
+	if (pEntry->pPrev != 0)
+	{
+		pEntry->pPrev->pNext = pEntry->pNext;
+	}
+	else
+	{
+		assert (*ppHead == pEntry);
+		*ppHead = pEntry->pNext;
+	}
+
+	if (pEntry->pNext != 0)
+	{
+		pEntry->pNext->pPrev = pEntry->pPrev;
+	}
+
+	pEntry->ppHead = 0;
+
+	// update the bitmap, if a slot of the wheel became empty
+	if (   *ppHead == 0
+	    && ppHead != &m_pElapsed)
+	{
+		unsigned nSlotIndex = ppHead - &m_pSlot[0][0];
+		assert (nSlotIndex < TIMER_WHEEL_LEVELS * TIMER_WHEEL_SLOTS);
+
+		m_nSlotMask[nSlotIndex / TIMER_WHEEL_SLOTS] &=
+			~(1ULL << (nSlotIndex % TIMER_WHEEL_SLOTS));
+	}
+}
+
+TTimerWheelEntry *CTimerWheel::AllocateEntry (void)
+{
+	if (m_pFreeHead == 0)
+	{
+		assert ((m_nChunks + 1) * ENTRIES_PER_CHUNK <= HANDLE_INDEX_MASK);
+
+		TTimerWheelEntry **ppChunk = new TTimerWheelEntry * [m_nChunks + 1];
+		assert (ppChunk != 0);
+
+		if (m_ppChunk != 0)
+		{
+			memcpy (ppChunk, m_ppChunk, m_nChunks * sizeof *ppChunk);
+
+			delete [] m_ppChunk;
+		}
+
+		m_ppChunk = ppChunk;
+
+		TTimerWheelEntry *pChunk = new TTimerWheelEntry[ENTRIES_PER_CHUNK];
+		assert (pChunk != 0);
+		m_ppChunk[m_nChunks] = pChunk;
+
+		for (unsigned i = 0; i < ENTRIES_PER_CHUNK; i++)
+		{
+			pChunk[i].nIndex = m_nChunks * ENTRIES_PER_CHUNK + i;
+			pChunk[i].nGeneration = 0;
+
+			FreeEntry (&pChunk[i]);
+		}
+
+		m_nChunks++;
+	}
+
+	TTimerWheelEntry *pEntry = m_pFreeHead;
+	assert (pEntry != 0);
+
+	m_pFreeHead = pEntry->pNext;
+	if (m_pFreeHead == 0)
+	{
+		m_pFreeTail = 0;
+	}
+
+	return pEntry;
+}
+
+void CTimerWheel::FreeEntry (TTimerWheelEntry *pEntry)
+{
+	assert (pEntry != 0);
+
+	pEntry->ppHead = 0;
+	pEntry->nGeneration++;		// invalidates the handle
+
+	// entries are re-used in FIFO order, so that a handle stays invalid for long
+	pEntry->pNext = 0;
+	if (m_pFreeTail != 0)
+	{
+		m_pFreeTail->pNext = pEntry;
+	}
+	else
+	{
+		m_pFreeHead = pEntry;
+	}
+	m_pFreeTail = pEntry;
+}
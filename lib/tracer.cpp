@@ -18,36 +18,59 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/tracer.h>
+#include <circle/multicore.h>
 #include <circle/timer.h>
 #include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define JSON_EVENT_MAX_SIZE	256		// maximum length of one exported event
 
 static const char FromTracer[] = "trace";
 
+static const char JSONHeader[] = "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[\n";
+static const char JSONFooter[] = "\n]}\n";
+
 CTracer *CTracer::s_pThis = 0;
 
 CTracer::CTracer (unsigned nDepth, boolean bStopIfFull)
 : 	m_nDepth (nDepth),
 	m_bStopIfFull (bStopIfFull),
 	m_bActive (FALSE),
-	m_nStartTicks (0),
-	m_nEntries (0),
-	m_nCurrent (0)
+	m_nStartTicks (0)
 {
-	s_pThis = this;
+	assert (m_nDepth > 0);
 
-	m_pEntry = new TTraceEntry[nDepth];
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		m_Ring[nCore].pEntry = new TTraceEntry[nDepth];
+		assert (m_Ring[nCore].pEntry != 0);
+
+		m_Ring[nCore].nWrite = 0;
+	}
+
+	s_pThis = this;
 }
 
 CTracer::~CTracer (void)
 {
-	delete [] m_pEntry;
-
 	s_pThis = 0;
+
+	m_bActive = FALSE;
+
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		delete [] m_Ring[nCore].pEntry;
+		m_Ring[nCore].pEntry = 0;
+	}
 }
 
 void CTracer::Start (void)
 {
-	m_nStartTicks = CTimer::Get ()->GetClockTicks ();
+	m_nStartTicks = CTimer::GetClockTicks64 ();
+
+	DataMemBarrier ();
 
 	m_bActive = TRUE;
 }
@@ -57,37 +80,60 @@ void CTracer::Stop (void)
 	Event (TRACER_EVENT_STOP);
 
 	m_bActive = FALSE;
+
+	DataMemBarrier ();
 }
 
 void CTracer::Event (unsigned nID, unsigned nParam1, unsigned nParam2, unsigned nParam3, unsigned nParam4)
 {
-	if (m_bActive)
+	if (!m_bActive)
 	{
-		if (m_nEntries < m_nDepth)
-		{
-			m_nEntries++;
-		}
-		else if (m_bStopIfFull)
+		return;
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	TTraceRing *pRing = &m_Ring[CMultiCoreSupport::ThisCore ()];
+#else
+	TTraceRing *pRing = &m_Ring[0];
+#endif
+
+	// reserve the entry first, we may be interrupted by another event on this core
+	unsigned nIndex = __atomic_fetch_add (&pRing->nWrite, 1, __ATOMIC_RELAXED);
+	if (nIndex >= m_nDepth)
+	{
+		if (m_bStopIfFull)
 		{
-			m_bActive = FALSE;
+			__atomic_store_n (&pRing->nWrite, m_nDepth, __ATOMIC_RELAXED);
 
 			return;
 		}
 
-		TTraceEntry *pEntry = m_pEntry + m_nCurrent;
+		nIndex %= m_nDepth;
+	}
 
-		pEntry->nClockTicks = CTimer::Get ()->GetClockTicks () - m_nStartTicks;
-		pEntry->nEventID    = nID;
-		pEntry->nParam[0]   = nParam1;
-		pEntry->nParam[1]   = nParam2;
-		pEntry->nParam[2]   = nParam3;
-		pEntry->nParam[3]   = nParam4;
+	TTraceEntry *pEntry = pRing->pEntry + nIndex;
 
-		if (++m_nCurrent == m_nDepth)
-		{
-			m_nCurrent = 0;
-		}
+	pEntry->nTimestamp = CTimer::GetClockTicks64 () - m_nStartTicks;
+	pEntry->nEventID   = nID;
+	pEntry->nParam[0]  = nParam1;
+	pEntry->nParam[1]  = nParam2;
+	pEntry->nParam[2]  = nParam3;
+	pEntry->nParam[3]  = nParam4;
+}
+
+void CTracer::TaskSwitchEvent (const char *pTaskName)
+{
+	if (   s_pThis == 0
+	    || !s_pThis->m_bActive)
+	{
+		return;
 	}
+
+	unsigned Name[4] = {0};
+	assert (pTaskName != 0);
+	strncpy ((char *) Name, pTaskName, sizeof Name);
+
+	s_pThis->Event (TRACER_EVENT_TASK_SWITCH, Name[0], Name[1], Name[2], Name[3]);
 }
 
 void CTracer::Dump (void)
@@ -99,22 +145,190 @@ void CTracer::Dump (void)
 	
 	CLogger *pLogger = CLogger::Get ();
 
-	unsigned nEvent = 0;
-	if (m_nEntries == m_nDepth)
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
 	{
-		nEvent = m_nCurrent;
+		unsigned nEvent;
+		unsigned nEntries = GetEntries (nCore, &nEvent);
+
+		for (unsigned i = 1; i <= nEntries; i++)
+		{
+			TTraceEntry *pEntry = m_Ring[nCore].pEntry + nEvent;
+
+			pLogger->Write (FromTracer, LogNotice, "%u %2u: %2u.%06u %2u %08X %08X %08X %08X",
+					nCore, i, (unsigned) (pEntry->nTimestamp / CLOCKHZ),
+					(unsigned) (pEntry->nTimestamp % CLOCKHZ),
+					pEntry->nEventID, pEntry->nParam[0], pEntry->nParam[1],
+					pEntry->nParam[2], pEntry->nParam[3]);
+
+			nEvent = (nEvent+1) % m_nDepth;
+		}
 	}
-	
-	for (unsigned i = 1; i <= m_nEntries; i++)
-	{	
-		TTraceEntry *pEntry = m_pEntry + nEvent;
+}
+
+unsigned CTracer::GetChromeTraceMaxSize (void) const
+{
+	unsigned nEvents = TRACER_CORES;			// thread name records
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		unsigned nFirst;
+		nEvents += GetEntries (nCore, &nFirst) + 1;	// task switch needs two records
+	}
+
+	return nEvents * JSON_EVENT_MAX_SIZE + sizeof JSONHeader + sizeof JSONFooter;
+}
+
+unsigned CTracer::ExportChromeTrace (char *pBuffer, unsigned nBufferSize)
+{
+	if (m_bActive)
+	{
+		Stop ();
+	}
+
+	assert (pBuffer != 0);
+	assert (nBufferSize >= sizeof JSONHeader + sizeof JSONFooter);
+	unsigned nLimit = nBufferSize - sizeof JSONFooter;	// includes the null byte
+
+	strcpy (pBuffer, JSONHeader);
+	unsigned nLength = sizeof JSONHeader-1;
+
+	const char *pSeparator = "";
+	for (unsigned nCore = 0; nCore < TRACER_CORES; nCore++)
+	{
+		CString Record;
+		Record.Format ("{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":0,\"tid\":%u,"
+			       "\"args\":{\"name\":\"Core %u\"}}", nCore, nCore);
+
+		CString Task;			// task currently running on this core
+
+		unsigned nEvent;
+		unsigned nEntries = GetEntries (nCore, &nEvent);
+		for (unsigned i = 0; i <= nEntries; i++)
+		{
+			if (nLength + strlen (pSeparator) + Record.GetLength () > nLimit)
+			{
+				break;
+			}
+
+			strcpy (pBuffer + nLength, pSeparator);
+			nLength += strlen (pSeparator);
+			strcpy (pBuffer + nLength, Record);
+			nLength += Record.GetLength ();
+			pSeparator = ",\n";
+
+			if (i == nEntries)
+			{
+				break;
+			}
+
+			const TTraceEntry *pEntry = m_Ring[nCore].pEntry + nEvent;
+			nEvent = (nEvent+1) % m_nDepth;
+
+			// the timestamp is split, because %llu is not supported in any case
+			unsigned nSeconds = (unsigned) (pEntry->nTimestamp / CLOCKHZ);
+			unsigned nMicros = (unsigned) (pEntry->nTimestamp % CLOCKHZ);
+
+			CString Head;
+			if (nSeconds > 0)
+			{
+				Head.Format ("\"ts\":%u%06u,\"pid\":0,\"tid\":%u",
+					     nSeconds, nMicros, nCore);
+			}
+			else
+			{
+				Head.Format ("\"ts\":%u,\"pid\":0,\"tid\":%u", nMicros, nCore);
+			}
 
-		pLogger->Write (FromTracer, LogNotice, "%2u: %2u.%06u %2u %08X %08X %08X %08X",
-				i, pEntry->nClockTicks / CLOCKHZ, pEntry->nClockTicks % CLOCKHZ,
-				pEntry->nEventID, pEntry->nParam[0], pEntry->nParam[1], pEntry->nParam[2], pEntry->nParam[3]);
+			char TaskName[sizeof pEntry->nParam + 1];
+			CString Switch;
 
-		nEvent = (nEvent+1) % m_nDepth;
+			const unsigned *pParam = pEntry->nParam;
+			switch (pEntry->nEventID)
+			{
+			case TRACER_EVENT_TASK_SWITCH:
+				memcpy (TaskName, pParam, sizeof pEntry->nParam);
+				TaskName[sizeof pEntry->nParam] = '\0';
+
+				if (Task.GetLength () > 0)
+				{
+					Switch.Format ("{\"name\":\"%s\",\"ph\":\"E\",%s},\n",
+						       (const char *) Task, (const char *) Head);
+				}
+
+				Task = TaskName[0] != '\0' ? TaskName : "task";
+
+				Record.Format ("%s{\"name\":\"%s\",\"ph\":\"B\",%s}",
+					       (const char *) Switch, (const char *) Task,
+					       (const char *) Head);
+				break;
+
+			case TRACER_EVENT_IRQ_ENTER:
+			case TRACER_EVENT_IRQ_EXIT:
+				Record.Format ("{\"name\":\"IRQ %u\",\"cat\":\"irq\",\"ph\":\"%c\",%s}",
+					       pParam[0],
+					       pEntry->nEventID == TRACER_EVENT_IRQ_ENTER ? 'B' : 'E',
+					       (const char *) Head);
+				break;
+
+			case TRACER_EVENT_NET_SEND:
+			case TRACER_EVENT_NET_RECEIVE:
+				Record.Format ("{\"name\":\"%s\",\"cat\":\"net\",\"ph\":\"i\",\"s\":\"t\",%s,"
+					       "\"args\":{\"length\":%u}}",
+					       pEntry->nEventID == TRACER_EVENT_NET_SEND ? "send" : "receive",
+					       (const char *) Head, pParam[0]);
+				break;
+
+			case TRACER_EVENT_USB_SUBMIT:
+				Record.Format ("{\"name\":\"submit\",\"cat\":\"usb\",\"ph\":\"i\",\"s\":\"t\",%s,"
+					       "\"args\":{\"device\":%u,\"endpoint\":%u,\"length\":%u}}",
+					       (const char *) Head, pParam[0], pParam[1], pParam[2]);
+				break;
+
+			case TRACER_EVENT_USB_COMPLETE:
+				Record.Format ("{\"name\":\"complete\",\"cat\":\"usb\",\"ph\":\"i\",\"s\":\"t\",%s,"
+					       "\"args\":{\"device\":%u,\"endpoint\":%u,\"status\":%u,"
+					       "\"length\":%u}}",
+					       (const char *) Head, pParam[0], pParam[1], pParam[2],
+					       pParam[3]);
+				break;
+
+			case TRACER_EVENT_STOP:
+				Record.Format ("{\"name\":\"stop\",\"ph\":\"i\",\"s\":\"g\",%s}",
+					       (const char *) Head);
+				break;
+
+			default:
+				Record.Format ("{\"name\":\"event %u\",\"ph\":\"i\",\"s\":\"t\",%s,"
+					       "\"args\":{\"p1\":\"0x%X\",\"p2\":\"0x%X\",\"p3\":\"0x%X\","
+					       "\"p4\":\"0x%X\"}}",
+					       pEntry->nEventID, (const char *) Head,
+					       pParam[0], pParam[1], pParam[2], pParam[3]);
+				break;
+			}
+		}
 	}
+
+	strcpy (pBuffer + nLength, JSONFooter);
+	nLength += sizeof JSONFooter-1;
+
+	return nLength;
+}
+
+unsigned CTracer::GetEntries (unsigned nCore, unsigned *pFirst) const
+{
+	assert (nCore < TRACER_CORES);
+	unsigned nWrite = m_Ring[nCore].nWrite;
+
+	assert (pFirst != 0);
+	if (nWrite <= m_nDepth)
+	{
+		*pFirst = 0;
+
+		return nWrite;
+	}
+
+	*pFirst = nWrite % m_nDepth;
+
+	return m_nDepth;
 }
 
 CTracer *CTracer::Get (void)
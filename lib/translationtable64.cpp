@@ -25,6 +25,10 @@
 #include <assert.h>
 
 // Granule size is 64KB. Only EL1 stage 1 translation is enabled.
+//
+// 512MB ranges with equal attributes are mapped with a level 2 block descriptor,
+// so that a TLB miss requires one lookup level only. In level 3 tables the
+// contiguous hint is set for aligned groups of 32 equal pages (2MB).
 
 #if RASPPI == 3
 // We create one level 2 (first lookup level) translation table with 3 table
@@ -54,7 +58,7 @@ CTranslationTable::CTranslationTable (size_t nMemSize)
 
 	for (unsigned nEntry = 0; nEntry < LEVEL2_TABLE_ENTRIES; nEntry++)	// entries a 512MB
 	{
-		u64 nBaseAddress = (u64) nEntry * ARMV8MMU_TABLE_ENTRIES * ARMV8MMU_LEVEL3_PAGE_SIZE;
+		u64 nBaseAddress = (u64) nEntry * ARMV8MMU_LEVEL2_BLOCK_SIZE;
 
 #if RASPPI == 4
 		if (   nBaseAddress >= 4*GIGABYTE
@@ -74,6 +78,28 @@ CTranslationTable::CTranslationTable (size_t nMemSize)
 		}
 #endif
 
+		// use a block descriptor, if all pages have the same attributes
+		unsigned nAttributes = GetDefaultAttributes (nBaseAddress);
+
+		boolean bUniform = TRUE;
+		for (u64 nPage = 1; nPage < ARMV8MMU_TABLE_ENTRIES; nPage++)
+		{
+			if (GetDefaultAttributes (nBaseAddress + nPage * ARMV8MMU_LEVEL3_PAGE_SIZE)
+			    != nAttributes)
+			{
+				bUniform = FALSE;
+
+				break;
+			}
+		}
+
+		if (bUniform)
+		{
+			SetBlock (&m_pTable[nEntry].Block, nBaseAddress, nAttributes);
+
+			continue;
+		}
+
 		TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = CreateLevel3Table (nBaseAddress);
 		assert (pTable != 0);
 
@@ -105,56 +131,305 @@ uintptr CTranslationTable::GetBaseAddress (void) const
 	return (uintptr) m_pTable;
 }
 
-TARMV8MMU_LEVEL3_DESCRIPTOR *CTranslationTable::CreateLevel3Table (uintptr nBaseAddress)
+boolean CTranslationTable::SetRegionAttributes (uintptr nBaseAddress, size_t nSize,
+						unsigned nAttributes)
 {
-	TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *) palloc ();
-	assert (pTable != 0);
+	assert (m_pTable != 0);
 
-	for (unsigned nPage = 0; nPage < ARMV8MMU_TABLE_ENTRIES; nPage++)	// 8192 entries a 64KB
+	if (   nSize == 0
+	    || (nBaseAddress & (ARMV8MMU_LEVEL3_PAGE_SIZE-1))
+	    || (nSize & (ARMV8MMU_LEVEL3_PAGE_SIZE-1))
+	    || (nAttributes & ~(MEMATTR_TYPE_MASK | MEMATTR_EXECUTE_NEVER))
+	    || (nAttributes & MEMATTR_TYPE_MASK) > MEMATTR_WRITE_COMBINING)
 	{
-		TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR *pDesc = &pTable[nPage].Page;
-
-		pDesc->Value11	     = 3;
-		pDesc->AttrIndx	     = ATTRINDX_NORMAL;
-		pDesc->NS	     = 0;
-		pDesc->AP	     = ATTRIB_AP_RW_EL1;
-		pDesc->SH	     = ATTRIB_SH_INNER_SHAREABLE;
-		pDesc->AF	     = 1;
-		pDesc->nG	     = 0;
-		pDesc->Reserved0_1   = 0;
-		pDesc->OutputAddress = ARMV8MMUL3PAGEADDR (nBaseAddress);
-		pDesc->Reserved0_2   = 0;
-		pDesc->Continous     = 0;
-		pDesc->PXN	     = 0;
-		pDesc->UXN	     = 1;
-		pDesc->Ignored	     = 0;
-
-		extern u8 _etext;
-		if (nBaseAddress >= (u64) &_etext)
+		return FALSE;
+	}
+
+	u64 nEnd = (u64) nBaseAddress + nSize;
+	if (   nEnd <= nBaseAddress
+	    || nEnd > (u64) LEVEL2_TABLE_ENTRIES * ARMV8MMU_LEVEL2_BLOCK_SIZE)
+	{
+		return FALSE;
+	}
+
+	u64 nAddress = nBaseAddress;
+	while (nAddress < nEnd)
+	{
+		unsigned nEntry = nAddress / ARMV8MMU_LEVEL2_BLOCK_SIZE;
+		u64 nEntryStart = (u64) nEntry * ARMV8MMU_LEVEL2_BLOCK_SIZE;
+		u64 nEntryEnd = nEntryStart + ARMV8MMU_LEVEL2_BLOCK_SIZE;
+
+		TARMV8MMU_LEVEL2_DESCRIPTOR *pEntry = &m_pTable[nEntry];
+
+		if (   nAddress == nEntryStart
+		    && nEnd >= nEntryEnd)
 		{
-			pDesc->PXN = 1;
+			// the whole range is covered, replace it with a block
+			TARMV8MMU_LEVEL3_DESCRIPTOR *pOldTable = 0;
+			if (pEntry->Table.Value11 == 3)
+			{
+				pOldTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *)
+					ARMV8MMUL2TABLEPTR ((u64) pEntry->Table.TableAddress);
+			}
+
+			// break-before-make
+			pEntry->Invalid.Value0 = 0;
+			pEntry->Invalid.Ignored = 0;
+			InvalidateTLB ();
+
+			SetBlock (&pEntry->Block, nEntryStart, nAttributes);
+			InvalidateTLB ();
+
+			if (pOldTable != 0)
+			{
+				pfree (pOldTable);
+			}
+
+			nAddress = nEntryEnd;
+
+			continue;
+		}
+
+		TARMV8MMU_LEVEL3_DESCRIPTOR *pTable;
+		if (pEntry->Table.Value11 == 3)
+		{
+			pTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *)
+				ARMV8MMUL2TABLEPTR ((u64) pEntry->Table.TableAddress);
+		}
+		else
+		{
+			pTable = SplitBlock (nEntry);
+		}
+		assert (pTable != 0);
+
+		u64 nRangeEnd = nEnd < nEntryEnd ? nEnd : nEntryEnd;
+		unsigned nFirstPage = (nAddress - nEntryStart) / ARMV8MMU_LEVEL3_PAGE_SIZE;
+		unsigned nPages = (nRangeEnd - nAddress) / ARMV8MMU_LEVEL3_PAGE_SIZE;
+
+		// break-before-make, the contiguous hint must not be set for invalid pages
+		UpdateContiguous (pTable, nFirstPage, nPages, TRUE);
+		for (unsigned i = nFirstPage; i < nFirstPage + nPages; i++)
+		{
+			pTable[i].Invalid.Value0 = 0;
+			pTable[i].Invalid.Ignored = 0;
+		}
+		InvalidateTLB ();
+
+		for (unsigned i = nFirstPage; i < nFirstPage + nPages; i++)
+		{
+			SetPage (&pTable[i].Page, nEntryStart + (u64) i * ARMV8MMU_LEVEL3_PAGE_SIZE,
+				 nAttributes);
+		}
+		InvalidateTLB ();
+
+		UpdateContiguous (pTable, nFirstPage, nPages, FALSE);
+		InvalidateTLB ();
+
+		nAddress = nRangeEnd;
+	}
+
+	return TRUE;
+}
+
+unsigned CTranslationTable::GetDefaultAttributes (u64 nBaseAddress) const
+{
+	extern u8 _etext;
+	if (nBaseAddress < (u64) &_etext)
+	{
+		return MEMATTR_NORMAL;
+	}
 
 #if RASPPI >= 4
-			if (   (   nBaseAddress >= m_nMemSize
-			        && nBaseAddress < MEM_HIGHMEM_START)
-			    || nBaseAddress > MEM_HIGHMEM_END)
+	if (   (   nBaseAddress >= m_nMemSize
+	        && nBaseAddress < MEM_HIGHMEM_START)
+	    || nBaseAddress > MEM_HIGHMEM_END)
 #else
-			if (nBaseAddress >= m_nMemSize)
+	if (nBaseAddress >= m_nMemSize)
 #endif
+	{
+		return MEMATTR_DEVICE | MEMATTR_EXECUTE_NEVER;
+	}
+
+	if (   nBaseAddress >= MEM_COHERENT_REGION
+	    && nBaseAddress <  MEM_DMA_COHERENT_POOL)
+	{
+		return MEMATTR_STRONGLY_ORDERED | MEMATTR_EXECUTE_NEVER;
+	}
+
+	if (   nBaseAddress >= MEM_DMA_COHERENT_POOL
+	    && nBaseAddress <  MEM_HEAP_START)
+	{
+		return MEMATTR_WRITE_COMBINING | MEMATTR_EXECUTE_NEVER;
+	}
+
+	return MEMATTR_NORMAL | MEMATTR_EXECUTE_NEVER;
+}
+
+TARMV8MMU_LEVEL3_DESCRIPTOR *CTranslationTable::CreateLevel3Table (u64 nBaseAddress)
+{
+	TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *) palloc ();
+	assert (pTable != 0);
+
+	for (unsigned nPage = 0; nPage < ARMV8MMU_TABLE_ENTRIES; nPage++)	// 8192 entries a 64KB
+	{
+		SetPage (&pTable[nPage].Page, nBaseAddress, GetDefaultAttributes (nBaseAddress));
+
+		nBaseAddress += ARMV8MMU_LEVEL3_PAGE_SIZE;
+	}
+
+	UpdateContiguous (pTable, 0, ARMV8MMU_TABLE_ENTRIES, FALSE);
+
+	return pTable;
+}
+
+TARMV8MMU_LEVEL3_DESCRIPTOR *CTranslationTable::SplitBlock (unsigned nEntry)
+{
+	TARMV8MMU_LEVEL2_DESCRIPTOR *pEntry = &m_pTable[nEntry];
+	u64 nBaseAddress = (u64) nEntry * ARMV8MMU_LEVEL2_BLOCK_SIZE;
+
+	TARMV8MMU_LEVEL3_DESCRIPTOR *pTable = (TARMV8MMU_LEVEL3_DESCRIPTOR *) palloc ();
+	assert (pTable != 0);
+
+	if (pEntry->Block.Value01 == 1)
+	{
+		// the pages inherit the attributes of the block
+		unsigned nAttributes = pEntry->Block.AttrIndx;
+		if (pEntry->Block.PXN)
+		{
+			nAttributes |= MEMATTR_EXECUTE_NEVER;
+		}
+
+		for (unsigned nPage = 0; nPage < ARMV8MMU_TABLE_ENTRIES; nPage++)
+		{
+			SetPage (&pTable[nPage].Page,
+				 nBaseAddress + (u64) nPage * ARMV8MMU_LEVEL3_PAGE_SIZE, nAttributes);
+		}
+
+		UpdateContiguous (pTable, 0, ARMV8MMU_TABLE_ENTRIES, FALSE);
+	}
+	else
+	{
+		memset (pTable, 0, PAGE_SIZE);		// range was not mapped
+	}
+
+	DataSyncBarrier ();
+
+	// break-before-make
+	pEntry->Invalid.Value0 = 0;
+	pEntry->Invalid.Ignored = 0;
+	InvalidateTLB ();
+
+	TARMV8MMU_LEVEL2_TABLE_DESCRIPTOR *pDesc = &pEntry->Table;
+
+	pDesc->Value11	    = 3;
+	pDesc->Ignored1	    = 0;
+	pDesc->TableAddress = ARMV8MMUL2TABLEADDR ((u64) pTable);
+	pDesc->Reserved0    = 0;
+	pDesc->Ignored2	    = 0;
+	pDesc->PXNTable	    = 0;
+	pDesc->UXNTable	    = 0;
+	pDesc->APTable	    = AP_TABLE_ALL_ACCESS;
+	pDesc->NSTable	    = 0;
+
+	InvalidateTLB ();
+
+	return pTable;
+}
+
+void CTranslationTable::SetBlock (TARMV8MMU_LEVEL2_BLOCK_DESCRIPTOR *pDesc,
+				  u64 nBaseAddress, unsigned nAttributes)
+{
+	assert (pDesc != 0);
+	unsigned nType = nAttributes & MEMATTR_TYPE_MASK;
+
+	pDesc->Value01	     = 1;
+	pDesc->AttrIndx	     = nType;
+	pDesc->NS	     = 0;
+	pDesc->AP	     = ATTRIB_AP_RW_EL1;
+	pDesc->SH	     =   nType == MEMATTR_NORMAL
+			       ? ATTRIB_SH_INNER_SHAREABLE : ATTRIB_SH_OUTER_SHAREABLE;
+	pDesc->AF	     = 1;
+	pDesc->nG	     = 0;
+	pDesc->Reserved0_1   = 0;
+	pDesc->OutputAddress = ARMV8MMUL2BLOCKADDR (nBaseAddress);
+	pDesc->Reserved0_2   = 0;
+	pDesc->Continous     = 0;
+	pDesc->PXN	     = nAttributes & MEMATTR_EXECUTE_NEVER ? 1 : 0;
+	pDesc->UXN	     = 1;
+	pDesc->Ignored	     = 0;
+}
+
+void CTranslationTable::SetPage (TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR *pDesc,
+				 u64 nBaseAddress, unsigned nAttributes)
+{
+	assert (pDesc != 0);
+	unsigned nType = nAttributes & MEMATTR_TYPE_MASK;
+
+	pDesc->Value11	     = 3;
+	pDesc->AttrIndx	     = nType;
+	pDesc->NS	     = 0;
+	pDesc->AP	     = ATTRIB_AP_RW_EL1;
+	pDesc->SH	     =   nType == MEMATTR_NORMAL
+			       ? ATTRIB_SH_INNER_SHAREABLE : ATTRIB_SH_OUTER_SHAREABLE;
+	pDesc->AF	     = 1;
+	pDesc->nG	     = 0;
+	pDesc->Reserved0_1   = 0;
+	pDesc->OutputAddress = ARMV8MMUL3PAGEADDR (nBaseAddress);
+	pDesc->Reserved0_2   = 0;
+	pDesc->Continous     = 0;
+	pDesc->PXN	     = nAttributes & MEMATTR_EXECUTE_NEVER ? 1 : 0;
+	pDesc->UXN	     = 1;
+	pDesc->Ignored	     = 0;
+}
+
+void CTranslationTable::UpdateContiguous (TARMV8MMU_LEVEL3_DESCRIPTOR *pTable,
+					  unsigned nFirstPage, unsigned nPages, boolean bClear)
+{
+	assert (pTable != 0);
+	assert (nPages > 0);
+
+	unsigned nFirstGroup = nFirstPage / ARMV8MMU_LEVEL3_CONTIGUOUS;
+	unsigned nLastGroup = (nFirstPage + nPages - 1) / ARMV8MMU_LEVEL3_CONTIGUOUS;
+
+	for (unsigned nGroup = nFirstGroup; nGroup <= nLastGroup; nGroup++)
+	{
+		TARMV8MMU_LEVEL3_DESCRIPTOR *pGroup = &pTable[nGroup * ARMV8MMU_LEVEL3_CONTIGUOUS];
+
+		boolean bContiguous = FALSE;
+		if (!bClear)
+		{
+			// all pages must be valid and must have equal attributes
+			const TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR *pFirst = &pGroup[0].Page;
+
+			bContiguous = pFirst->Value11 == 3;
+			for (unsigned i = 1; bContiguous && i < ARMV8MMU_LEVEL3_CONTIGUOUS; i++)
 			{
-				pDesc->AttrIndx = ATTRINDX_DEVICE;
-				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+				const TARMV8MMU_LEVEL3_PAGE_DESCRIPTOR *pDesc = &pGroup[i].Page;
+
+				bContiguous =    pDesc->Value11  == 3
+					      && pDesc->AttrIndx == pFirst->AttrIndx
+					      && pDesc->SH	 == pFirst->SH
+					      && pDesc->PXN	 == pFirst->PXN
+					      && pDesc->UXN	 == pFirst->UXN;
 			}
-			else if (   nBaseAddress >= MEM_COHERENT_REGION
-				 && nBaseAddress <  MEM_HEAP_START)
+		}
+
+		for (unsigned i = 0; i < ARMV8MMU_LEVEL3_CONTIGUOUS; i++)
+		{
+			if (pGroup[i].Page.Value11 == 3)
 			{
-				pDesc->AttrIndx = ATTRINDX_COHERENT;
-				pDesc->SH	= ATTRIB_SH_OUTER_SHAREABLE;
+				pGroup[i].Page.Continous = bContiguous ? 1 : 0;
 			}
 		}
-
-		nBaseAddress += ARMV8MMU_LEVEL3_PAGE_SIZE;
 	}
+}
 
-	return pTable;
+void CTranslationTable::InvalidateTLB (void)
+{
+	DataSyncBarrier ();
+
+	asm volatile ("tlbi vmalle1is" : : : "memory");
+
+	DataSyncBarrier ();
+	InstructionSyncBarrier ();
 }
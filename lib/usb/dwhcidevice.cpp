@@ -2,7 +2,7 @@
 // dwhcidevice.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2025  R. Stange <rsta2@gmx.net>
+// Copyright (C) 2014-2026  R. Stange <rsta2@gmx.net>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -27,6 +27,8 @@
 #include <circle/bcm2835.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
+#include <circle/tracer.h>
+#include <circle/metrics.h>
 #include <circle/koptions.h>
 #include <circle/sysconfig.h>
 #include <circle/atomic.h>
@@ -65,6 +67,10 @@ enum TStageSubState
 
 LOGMODULE ("dwhci");
 
+static CMetricCounter s_NAKRetries ("circle_usb_nak_retries_total",
+				    "Periodic transactions retried after NAK or NYET",
+				    "hcd=\"dwhci\"");
+
 CDWHCIDevice::CDWHCIDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer, boolean bPlugAndPlay)
 :	CUSBHostController (bPlugAndPlay),
 	m_pInterruptSystem (pInterruptSystem),
@@ -73,17 +79,21 @@ CDWHCIDevice::CDWHCIDevice (CInterruptSystem *pInterruptSystem, CTimer *pTimer,
 	m_nChannelAllocated (0),
 	m_ChannelSpinLock (MAX_TARGET_LEVEL),
 #ifdef USE_USB_SOF_INTR
-	m_TransactionQueue (DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL),
+	m_TransactionQueue (DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL),
 #endif
 	m_IntMaskSpinLock (MAX_TARGET_LEVEL),
+#ifdef USE_USB_SOF_INTR
+	m_bSOFIntEnabled (FALSE),
+#endif
 	m_nWaitBlockAllocated (0),
 	m_WaitBlockSpinLock (TASK_LEVEL),
 	m_RootPort (this),
 	m_bRootPortEnabled (FALSE),
 #ifdef USE_USB_FIQ
 	m_nPortStatusChanged (0),
-	m_CompletionQueue (DWHCI_MAX_CHANNELS*2),
-	m_MPHI (pInterruptSystem),
+	m_nIRQTriggered (0),
+	m_CompletionQueue (DWHCI_MAX_REQUESTS),
+	m_nSoftIRQLine (-1),
 #endif
 	m_bShutdown (FALSE)
 {
@@ -113,7 +123,9 @@ CDWHCIDevice::~CDWHCIDevice (void)
 	m_pInterruptSystem->DisconnectIRQ (ARM_IRQ_USB);
 #else
 	m_pInterruptSystem->DisconnectFIQ ();
-	m_MPHI.DisconnectHandler ();
+	assert (m_nSoftIRQLine >= 0);
+	CSoftIRQ::Get ()->Disconnect (m_nSoftIRQLine);
+	m_nSoftIRQLine = -1;
 #endif
 
 	Reset ();
@@ -138,12 +150,12 @@ boolean CDWHCIDevice::Initialize (boolean bScanDevices)
 #endif
 
 	// init class-specific allocators in USB library
-	INIT_PROTECTED_CLASS_ALLOCATOR (CUSBRequest, DWHCI_MAX_CHANNELS*2, MAX_TARGET_LEVEL);
-	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCITransferStageData, DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL);
-	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerNonPeriodic, DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL);
-	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerPeriodic, DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL);
-	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerNoSplit, DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL);
-	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerIsochronous, DWHCI_MAX_CHANNELS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CUSBRequest, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCITransferStageData, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerNonPeriodic, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerPeriodic, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerNoSplit, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
+	INIT_PROTECTED_CLASS_ALLOCATOR (CDWHCIFrameSchedulerIsochronous, DWHCI_MAX_REQUESTS, MAX_TARGET_LEVEL);
 
 	PeripheralEntry ();
 
@@ -174,7 +186,9 @@ boolean CDWHCIDevice::Initialize (boolean bScanDevices)
 #ifndef USE_USB_FIQ
 	m_pInterruptSystem->ConnectIRQ (ARM_IRQ_USB, InterruptStub, this);
 #else
-	m_MPHI.ConnectHandler (InterruptStub2, this);
+	assert (m_nSoftIRQLine < 0);
+	m_nSoftIRQLine = CSoftIRQ::Get ()->Connect (InterruptStub2, this);
+	assert (m_nSoftIRQLine >= 0);
 	m_pInterruptSystem->ConnectFIQ (ARM_FIQ_USB, InterruptStub, this);
 #endif
 
@@ -314,7 +328,10 @@ boolean CDWHCIDevice::SubmitAsyncRequest (CUSBRequest *pURB, unsigned nTimeoutMs
 	assert (pURB->GetBufLen () > 0);
 	
 	pURB->SetStatus (0);
-	
+
+	TRACE_SYSTEM_EVENT (TRACER_EVENT_USB_SUBMIT, pURB->GetEndpoint ()->GetDevice ()->GetAddress (),
+			    pURB->GetEndpoint ()->GetNumber (), pURB->GetBufLen ());
+
 	boolean bOK = TransferStageAsync (pURB, pURB->GetEndpoint ()->IsDirectionIn (),
 					  FALSE, nTimeoutMs);
 
@@ -638,12 +655,13 @@ void CDWHCIDevice::EnableHostInterrupts (void)
 
 	EnableCommonInterrupts ();
 
-	IntMask.Read ();
-	IntMask.Or (  DWHCI_CORE_INT_MASK_HC_INTR
+	// the SOF interrupt is enabled on demand, while transactions are queued
 #ifdef USE_USB_SOF_INTR
-		    | DWHCI_CORE_INT_MASK_SOF_INTR
+	m_bSOFIntEnabled = FALSE;
 #endif
-		   );
+
+	IntMask.Read ();
+	IntMask.Or (DWHCI_CORE_INT_MASK_HC_INTR);
 	if (IsPlugAndPlay ())
 	{
 		IntMask.Or (  DWHCI_CORE_INT_MASK_PORT_INTR
@@ -821,6 +839,8 @@ void CDWHCIDevice::QueueTransaction (CDWHCITransferStageData *pStageData)
 	}
 
 	m_TransactionQueue.Enqueue (pStageData, usFrameNumber);
+
+	EnableSOFInterrupt ();
 }
 
 void CDWHCIDevice::QueueDelayedTransaction (CDWHCITransferStageData *pStageData)
@@ -860,6 +880,8 @@ void CDWHCIDevice::QueueDelayedTransaction (CDWHCITransferStageData *pStageData)
 	}
 
 	m_TransactionQueue.Enqueue (pStageData, usFrameNumber);
+
+	EnableSOFInterrupt ();
 }
 
 #endif
@@ -943,7 +965,7 @@ void CDWHCIDevice::StartChannel (CDWHCITransferStageData *pStageData)
 	Character.Or (pStageData->GetMaxPacketSize () & DWHCI_HOST_CHAN_CHARACTER_MAX_PKT_SIZ__MASK);
 
 	Character.And (~DWHCI_HOST_CHAN_CHARACTER_MULTI_CNT__MASK);
-	Character.Or (1 << DWHCI_HOST_CHAN_CHARACTER_MULTI_CNT__SHIFT);		// TODO: optimize
+	Character.Or (pStageData->GetMultiCount () << DWHCI_HOST_CHAN_CHARACTER_MULTI_CNT__SHIFT);
 
 	if (pStageData->IsDirectionIn ())
 	{
@@ -1143,6 +1165,8 @@ void CDWHCIDevice::ChannelInterruptHandler (unsigned nChannel)
 			}
 			else
 			{
+				s_NAKRetries.Increment ();
+
 #ifdef USE_USB_SOF_INTR
 				m_pStageData[nChannel] = 0;
 				FreeChannel (nChannel);
@@ -1385,9 +1409,23 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 	CDWHCIRegister FrameNumber (DWHCI_HOST_FRM_NUM);
 	u16 usFrameNumber = DWHCI_HOST_FRM_NUM_NUMBER (FrameNumber.Read ());
 
-	CDWHCITransferStageData *pStageData;
-	while ((pStageData = m_TransactionQueue.Dequeue (usFrameNumber)) != 0)
+	// start all due transactions in this (micro)frame, as long as channels are free
+	while (1)
 	{
+		unsigned nChannel = AllocateChannel ();
+		if (nChannel >= m_nChannels)
+		{
+			break;		// remaining transactions are started in the next (micro)frame
+		}
+
+		CDWHCITransferStageData *pStageData = m_TransactionQueue.Dequeue (usFrameNumber);
+		if (pStageData == 0)
+		{
+			FreeChannel (nChannel);
+
+			break;
+		}
+
 #if 0
 		if (pStageData->IsPeriodic ())
 		{
@@ -1400,6 +1438,8 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 
 			if (DWHCI_HOST_FRM_NUM_REMAINING (FrameNumber.Read ()) < nMinRemaining)
 			{
+				FreeChannel (nChannel);
+
 				QueueTransaction (pStageData);
 
 				break;
@@ -1407,9 +1447,6 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 		}
 #endif
 
-		unsigned nChannel = AllocateChannel ();
-		assert (nChannel < m_nChannels);	// too many parallel transactions otherwise
-
 		pStageData->SetChannelNumber (nChannel);
 
 		assert (m_pStageData[nChannel] == 0);
@@ -1419,6 +1456,45 @@ void CDWHCIDevice::SOFInterruptHandler (void)
 
 		StartTransaction (pStageData);
 	}
+
+	DisableSOFInterruptIfIdle ();
+}
+
+void CDWHCIDevice::EnableSOFInterrupt (void)
+{
+	m_IntMaskSpinLock.Acquire ();
+
+	if (!m_bSOFIntEnabled)
+	{
+		CDWHCIRegister IntMask (DWHCI_CORE_INT_MASK);
+		IntMask.Read ();
+		IntMask.Or (DWHCI_CORE_INT_MASK_SOF_INTR);
+		IntMask.Write ();
+
+		m_bSOFIntEnabled = TRUE;
+	}
+
+	m_IntMaskSpinLock.Release ();
+}
+
+void CDWHCIDevice::DisableSOFInterruptIfIdle (void)
+{
+	m_IntMaskSpinLock.Acquire ();
+
+	// the queue is checked with the lock held, so that a concurrent
+	// QueueTransaction() cannot be missed
+	if (   m_bSOFIntEnabled
+	    && m_TransactionQueue.IsEmpty ())
+	{
+		CDWHCIRegister IntMask (DWHCI_CORE_INT_MASK);
+		IntMask.Read ();
+		IntMask.And (~DWHCI_CORE_INT_MASK_SOF_INTR);
+		IntMask.Write ();
+
+		m_bSOFIntEnabled = FALSE;
+	}
+
+	m_IntMaskSpinLock.Release ();
 }
 
 #endif
@@ -1431,7 +1507,8 @@ void CDWHCIDevice::InterruptHandler (void)
 	IntStatus.Read ();
 
 #ifdef USE_USB_SOF_INTR
-	if (IntStatus.Get () & DWHCI_CORE_INT_STAT_SOF_INTR)
+	if (   (IntStatus.Get () & DWHCI_CORE_INT_STAT_SOF_INTR)
+	    && m_bSOFIntEnabled)
 	{
 #ifndef NDEBUG
 		//debug_click (DEBUG_CLICK_LEFT);
@@ -1504,10 +1581,14 @@ void CDWHCIDevice::InterruptHandler (void)
 	PeripheralExit ();
 
 #ifdef USE_USB_FIQ
-	if (   !m_CompletionQueue.IsEmpty ()
-	    || AtomicGet (&m_nPortStatusChanged))
+	// The FIQ handles the whole transaction state machine (incl. NAK
+	// retries and split transactions), the IRQ completes the URBs only.
+	// Trigger it once, until it runs, instead of once per FIQ.
+	if (   (   !m_CompletionQueue.IsEmpty ()
+		|| AtomicGet (&m_nPortStatusChanged))
+	    && !AtomicExchange (&m_nIRQTriggered, 1))
 	{
-		m_MPHI.TriggerIRQ ();
+		CSoftIRQ::Get ()->Trigger (m_nSoftIRQLine);
 	}
 #endif
 }
@@ -1592,6 +1673,9 @@ void CDWHCIDevice::InterruptHandler2 (void)
 	//debug_click (DEBUG_CLICK_RIGHT);
 #endif
 
+	// reset before the queue is processed, so that no completion is missed
+	AtomicSet (&m_nIRQTriggered, 0);
+
 	CUSBRequest *pURB;
 	while ((pURB = m_CompletionQueue.Dequeue ()) != 0)
 	{
@@ -218,4 +218,15 @@ CDWHCITransferStageData *CDWHCITransactionQueue::Dequeue (u16 usFrameNumber)
 	return pStageData;
 }
 
+boolean CDWHCITransactionQueue::IsEmpty (void)
+{
+	m_SpinLock.Acquire ();
+
+	boolean bResult = m_List.GetFirst () == 0;
+
+	m_SpinLock.Release ();
+
+	return bResult;
+}
+
 #endif
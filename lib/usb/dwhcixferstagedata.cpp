@@ -65,6 +65,14 @@ CDWHCITransferStageData::CDWHCITransferStageData (unsigned	 nChannel,
 	
 	m_bSplitTransaction = m_pDevice->IsSplit ();
 
+	// high-bandwidth isochronous endpoints send up to 3 packets per microframe
+	m_nMultiCount = 1;
+	if (   !m_bSplitTransaction
+	    && IsIsochronous ())
+	{
+		m_nMultiCount = m_pEndpoint->GetTransactionsPerMicroframe ();
+	}
+
 	if (!bStatusStage)
 	{
 		if (m_pEndpoint->GetNextPID (bStatusStage) == USBPIDSetup)
@@ -239,9 +247,11 @@ void CDWHCITransferStageData::TransactionComplete (u32 nStatus, u32 nPacketsLeft
 		{
 			nBytesTransfered = m_nMaxPacketSize * nPacketsTransfered;
 		}
-		else if (IsIsochronous ())
+		else if (   IsIsochronous ()
+			 && nPacketsTransfered > 0)
 		{
-			nBytesTransfered = m_nBytesPerTransaction * nPacketsTransfered;
+			// all packets of a high-bandwidth transaction belong to one iso packet
+			nBytesTransfered = m_nBytesPerTransaction;
 		}
 	}
 
@@ -394,6 +404,12 @@ u32 CDWHCITransferStageData::GetMaxPacketSize (void) const
 	return m_nMaxPacketSize;
 }
 
+u32 CDWHCITransferStageData::GetMultiCount (void) const
+{
+	assert (1 <= m_nMultiCount && m_nMultiCount <= 3);
+	return m_nMultiCount;
+}
+
 TUSBSpeed CDWHCITransferStageData::GetSpeed (void) const
 {
 	return m_Speed;
@@ -403,6 +419,21 @@ u8 CDWHCITransferStageData::GetPID (void) const
 {
 	assert (m_pEndpoint != 0);
 	
+	// see USB 2.0 spec chapter 5.9.2
+	if (m_nMultiCount > 1)
+	{
+		assert (IsIsochronous ());
+
+		if (!m_bIn)
+		{
+			return DWHCI_HOST_CHAN_XFER_SIZ_PID_MDATA;
+		}
+
+		return   m_nMultiCount == 2
+		       ? DWHCI_HOST_CHAN_XFER_SIZ_PID_DATA1
+		       : DWHCI_HOST_CHAN_XFER_SIZ_PID_DATA2;
+	}
+
 	u8 ucPID = 0;
 	
 	switch (m_pEndpoint->GetNextPID (m_bStatusStage))
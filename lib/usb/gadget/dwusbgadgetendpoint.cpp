@@ -200,6 +200,11 @@ void CDWUSBGadgetEndpoint::BeginTransfer (TTransferMode Mode, void *pBuffer, siz
 		assert (m_nEP || nLength <= 0x7F);
 		assert (m_nEP || nPacketCount <= 3);
 
+		// multi-packet transfer limits of the other EPs
+		assert (!m_nEP || nLength <= DWHCI_DEV_EP_XFER_SIZ_XFER_SIZ__MASK);
+		assert (!m_nEP || nPacketCount <= (  DWHCI_DEV_EP_XFER_SIZ_PKT_CNT__MASK
+						   >> DWHCI_DEV_EP_XFER_SIZ_PKT_CNT__SHIFT));
+
 		CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nLength);
 	}
 	else
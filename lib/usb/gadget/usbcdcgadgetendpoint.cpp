@@ -22,6 +22,7 @@
 #include <circle/usb/gadget/usbcdcgadgetendpoint.h>
 #include <circle/usb/gadget/usbcdcgadget.h>
 #include <circle/usb/usbserial.h>
+#include <circle/util.h>
 #include <assert.h>
 
 CUSBCDCGadgetEndpoint::CUSBCDCGadgetEndpoint (const TUSBEndpointDescriptor *pDesc,
@@ -271,15 +272,25 @@ void CUSBCDCGadgetEndpoint::Enqueue (const void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount <= GetQueueBytesFree ());
+
+	// copy in up to two parts, if the queue wraps around
+	unsigned nFirst = QueueSize - m_nInPtr;
+	if (nFirst > nCount)
 	{
-		m_pQueue[m_nInPtr] = *p++;
+		nFirst = nCount;
+	}
 
-		if (++m_nInPtr == QueueSize)
-		{
-			m_nInPtr = 0;
-		}
+	memcpy (m_pQueue + m_nInPtr, p, nFirst);
+	memcpy (m_pQueue, p + nFirst, nCount - nFirst);
+
+	unsigned nInPtr = m_nInPtr + nCount;
+	if (nInPtr >= QueueSize)
+	{
+		nInPtr -= QueueSize;
 	}
+
+	m_nInPtr = nInPtr;
 }
 
 void CUSBCDCGadgetEndpoint::Dequeue (void *pBuffer, unsigned nCount)
@@ -289,13 +300,22 @@ void CUSBCDCGadgetEndpoint::Dequeue (void *pBuffer, unsigned nCount)
 	assert (m_pQueue != 0);
 
 	assert (nCount > 0);
-	while (nCount-- > 0)
+	assert (nCount <= GetQueueBytesAvail ());
+
+	unsigned nFirst = QueueSize - m_nOutPtr;
+	if (nFirst > nCount)
 	{
-		*p++ = m_pQueue[m_nOutPtr];
+		nFirst = nCount;
+	}
 
-		if (++m_nOutPtr == QueueSize)
-		{
-			m_nOutPtr = 0;
-		}
+	memcpy (p, m_pQueue + m_nOutPtr, nFirst);
+	memcpy (p + nFirst, m_pQueue, nCount - nFirst);
+
+	unsigned nOutPtr = m_nOutPtr + nCount;
+	if (nOutPtr >= QueueSize)
+	{
+		nOutPtr -= QueueSize;
 	}
+
+	m_nOutPtr = nOutPtr;
 }
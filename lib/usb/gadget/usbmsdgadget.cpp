@@ -23,6 +23,7 @@
 #include <circle/usb/gadget/usbmsdgadgetendpoint.h>
 #include <circle/logger.h>
 #include <circle/sysconfig.h>
+#include <circle/new.h>
 #include <circle/util.h>
 #include <assert.h>
 
@@ -98,6 +99,14 @@ CUSBMSDGadget::CUSBMSDGadget (CInterruptSystem *pInterruptSystem, CDevice *pDevi
 	m_pDevice (pDevice),
 	m_pEP {nullptr, nullptr, nullptr}
 {
+	for (unsigned i = 0; i < NumBuffers; i++)
+	{
+		m_Buffer[i].pData = new (HEAP_DMA30) u8[MSD_MAX_TRANSFER_SIZE];
+		assert (m_Buffer[i].pData);
+		m_Buffer[i].State = BufferFree;
+		m_Buffer[i].pThis = this;
+	}
+
 	if(pDevice)SetDevice(pDevice);
 }
 
@@ -267,28 +276,20 @@ void CUSBMSDGadget::OnTransferComplete (boolean bIn, size_t nLength)
 				                            m_OutBuffer,SIZE_CBW);
 				break;
 			}
-		case TMSDState::DataIn:
+		case TMSDState::DataIn:     //done sending reply to host
 			{
-				if(m_nnumber_blocks>0)
-				{
-					if(m_MSDReady)
-					{
-						m_nState=TMSDState::DataInRead; //see Update function
-					}
-					else
-					{
-						MLOGERR("onXferCmplt DataIn","failed, %s",
-						        m_MSDReady?"ready":"not ready");
-						m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-						m_ReqSenseReply.bSenseKey = 2;
-						m_ReqSenseReply.bAddlSenseCode = 1;
-						SendCSW();
-					}
-				}
-				else     //done sending data to host
-				{
-					SendCSW();
-				}
+				SendCSW();
+				break;
+			}
+		case TMSDState::DataInRead:
+			{
+				//data buffer has been sent, see Update function
+				TDataBuffer *pBuffer = &m_Buffer[m_nUSBBuffer];
+				assert(pBuffer->State == BufferUSB);
+				m_nnumber_blocks-=pBuffer->nBlocks;
+				m_nbyteCount-=nLength;
+				pBuffer->State=BufferFree;
+				m_nUSBBuffer=(m_nUSBBuffer+1) % NumBuffers;
 				break;
 			}
 		case TMSDState::SendReqSenseReply:
@@ -332,23 +333,18 @@ void CUSBMSDGadget::OnTransferComplete (boolean bIn, size_t nLength)
 				} // TODO: response for not meaningful CBW
 				break;
 			}
-		case TMSDState::DataOut:
+		case TMSDState::DataOutWrite:
 			{
-				//process block from host
-				assert(m_nnumber_blocks>0);
-				if(m_MSDReady)
-				{
-					m_nState=TMSDState::DataOutWrite; //see Update function
-				}
-				else
+				//data buffer has been received, will be written in Update function
+				TDataBuffer *pBuffer = &m_Buffer[m_nUSBBuffer];
+				assert(pBuffer->State == BufferUSB);
+				if(nLength != pBuffer->nBlocks*BLOCK_SIZE)
 				{
-					MLOGERR("onXferCmplt DataOut","failed, %s",
-					        m_MSDReady?"ready":"not ready");
-					m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-					m_ReqSenseReply.bSenseKey = 2;
-					m_ReqSenseReply.bAddlSenseCode = 1;
-					SendCSW();
+					MLOGERR("onXferCmplt DataOut","Invalid length = %i",nLength);
+					pBuffer->nResult=-1;
 				}
+				pBuffer->State=BufferFull;
+				m_nUSBBuffer=(m_nUSBBuffer+1) % NumBuffers;
 				break;
 			}
 
@@ -498,6 +494,7 @@ void CUSBMSDGadget::HandleSCSICommand()
 				}
 				MLOGDEBUG("Read(10)","addr = %u len = %u",
 					  m_nblock_address,m_nnumber_blocks);
+				BeginDataIO();
 				m_nState=TMSDState::DataInRead; //see Update() function
 			}
 			else
@@ -521,9 +518,8 @@ void CUSBMSDGadget::HandleSCSICommand()
 				m_nblock_address = (u32)(m_CBW.CBWCB[2] << 24) | (u32)(m_CBW.CBWCB[3] << 16)
 				                   |(u32)(m_CBW.CBWCB[4] << 8) | m_CBW.CBWCB[5];
 				MLOGDEBUG("Write(10)","addr = %u len = %u",m_nblock_address,m_nnumber_blocks);
-				m_pEP[EPOut]->BeginTransfer(CUSBMSDGadgetEndpoint::TransferDataOut,
-				                            m_OutBuffer,512);
-				m_nState=TMSDState::DataOut;
+				BeginDataIO();
+				m_nState=TMSDState::DataOutWrite; //see Update() function
 				m_CSW.bmCSWStatus=MSD_CSW_STATUS_OK;	   //will be updated if write fails
 				m_ReqSenseReply.bSenseKey = 0;
 				m_ReqSenseReply.bAddlSenseCode = 0;
@@ -568,100 +564,224 @@ void CUSBMSDGadget::Update()
 	switch(m_nState)
 	{
 	case TMSDState::DataInRead:
+		UpdateRead();
+		break;
+
+	case TMSDState::DataOutWrite:
+		UpdateWrite();
+		break;
+
+	default:
+		break;
+	}
+}
+
+//read from device into one buffer, while the other one is sent to the host
+void CUSBMSDGadget::UpdateRead()
+{
+	if(!m_MSDReady)
+	{
+		m_bDataError=true;
+	}
+
+	//start the USB transfer before and after the (possibly synchronous) device read
+	for(unsigned i=0; i<2; i++)
+	{
+		TDataBuffer *pBuffer = &m_Buffer[m_nUSBBuffer];
+		if(pBuffer->State == BufferFull && !m_bDataError)
 		{
-			u64 offset=0;
-			int readCount=0;
-			if(m_MSDReady)
+			if(pBuffer->nResult != (int) (pBuffer->nBlocks*BLOCK_SIZE))
 			{
-				offset=m_pDevice->Seek(BLOCK_SIZE*m_nblock_address);
-				MLOGDEBUG("UpdateRead","offset = %u ",offset);
-				if(offset!=(u64)(-1))
-				{
-					readCount=m_pDevice->Read(m_InBuffer,BLOCK_SIZE);
-					if(readCount < BLOCK_SIZE)
-					{
-						MLOGERR("UpdateRead","readCount = %u ",readCount);
-						m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-						m_ReqSenseReply.bSenseKey = 2;
-						m_ReqSenseReply.bAddlSenseCode = 1;
-						SendCSW();
-						break;
-					}
-					m_pEP[EPIn]->BeginTransfer(CUSBMSDGadgetEndpoint::TransferDataIn,
-					                           m_InBuffer,readCount);
-					m_nnumber_blocks--;
-					m_nblock_address++;
-					m_nbyteCount-=readCount;
-					m_nState=TMSDState::DataIn;
-				}
+				MLOGERR("UpdateRead","readCount = %i ",pBuffer->nResult);
+				m_bDataError=true;
 			}
-			if(!m_MSDReady || offset==(u64)(-1))
+			else
 			{
-				MLOGERR("UpdateRead","failed, %s, offset=%i",
-				        m_MSDReady?"ready":"not ready",offset);
-				m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-				m_ReqSenseReply.bSenseKey = 2;
-				m_ReqSenseReply.bAddlSenseCode = 1;
-				SendCSW();
+				pBuffer->State=BufferUSB;
+				m_pEP[EPIn]->BeginTransfer(CUSBMSDGadgetEndpoint::TransferDataIn,
+				                           pBuffer->pData,pBuffer->nBlocks*BLOCK_SIZE);
 			}
-			break;
 		}
-	case TMSDState::DataOutWrite:
+
+		if(   i == 0
+		   && !m_bDataError
+		   && m_nIOBlocks>0
+		   && m_Buffer[m_nDeviceBuffer].State == BufferFree)
 		{
-			//process block from host
-			assert(m_nnumber_blocks>0);
-			u64 offset=0;
-			int writeCount=0;
-			if(m_MSDReady)
-			{
-				offset=m_pDevice->Seek(BLOCK_SIZE*m_nblock_address);
-				if(offset!=(u64)(-1))
-				{
-					writeCount=m_pDevice->Write(m_OutBuffer,BLOCK_SIZE);
-				}
-				if(writeCount>0)
-				{
-					if(writeCount<BLOCK_SIZE)
-					{
-						MLOGERR("UpdateWrite","writeCount = %u ",writeCount);
-						m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-						m_ReqSenseReply.bSenseKey = 0x2;
-						m_ReqSenseReply.bAddlSenseCode = 0x1;
-						SendCSW();
-						break;
-					}
-					m_nnumber_blocks--;
-					m_nblock_address++;
-					if(m_nnumber_blocks==0)  //done receiving data from host
-					{
-						SendCSW();
-						break;
-					}
-				}
-			}
-			if(!m_MSDReady || offset==(u64)(-1) || writeCount<=0)
+			StartDeviceIO(m_nDeviceBuffer,false);
+		}
+	}
+
+	if(m_bDataError)
+	{
+		DataIOFailed();
+	}
+	else if(m_nnumber_blocks==0)  //done sending data to host
+	{
+		SendCSW();
+	}
+}
+
+//write one buffer to device, while the other one is received from the host
+void CUSBMSDGadget::UpdateWrite()
+{
+	if(!m_MSDReady)
+	{
+		m_bDataError=true;
+	}
+
+	//start the USB transfer before and after the (possibly synchronous) device write
+	for(unsigned i=0; i<2; i++)
+	{
+		TDataBuffer *pBuffer = &m_Buffer[m_nUSBBuffer];
+		if(   !m_bDataError
+		   && m_nIOBlocks>0
+		   && pBuffer->State == BufferFree)
+		{
+			pBuffer->nBlocks = m_nIOBlocks < MSD_MAX_TRANSFER_SIZE/BLOCK_SIZE
+					   ? m_nIOBlocks : MSD_MAX_TRANSFER_SIZE/BLOCK_SIZE;
+			m_nIOBlocks-=pBuffer->nBlocks;
+			pBuffer->nResult=0;
+			pBuffer->State=BufferUSB;
+			m_pEP[EPOut]->BeginTransfer(CUSBMSDGadgetEndpoint::TransferDataOut,
+			                            pBuffer->pData,pBuffer->nBlocks*BLOCK_SIZE);
+		}
+
+		pBuffer = &m_Buffer[m_nDeviceBuffer];
+		if(   i == 0
+		   && !m_bDataError
+		   && pBuffer->State == BufferFull)
+		{
+			if(pBuffer->nResult < 0)
 			{
-				MLOGERR("UpdateWrite","failed, %s, offset=%i, writeCount=%i",
-				        m_MSDReady?"ready":"not ready",offset,writeCount);
-				m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
-				m_ReqSenseReply.bSenseKey = 2;
-				m_ReqSenseReply.bAddlSenseCode = 1;
-				SendCSW();
-				break;
+				m_bDataError=true;
 			}
 			else
 			{
-				if(m_nnumber_blocks>0)  //get next block
-				{
-					m_pEP[EPOut]->BeginTransfer(
-						CUSBMSDGadgetEndpoint::TransferDataOut,
-					        m_OutBuffer,512);
-					m_nState=TMSDState::DataOut;
-				}
+				StartDeviceIO(m_nDeviceBuffer,true);
 			}
-			break;
 		}
-	default:
-		break;
 	}
+
+	if(m_bDataError)
+	{
+		DataIOFailed();
+	}
+	else if(m_nnumber_blocks==0)  //done receiving data from host
+	{
+		SendCSW();
+	}
+}
+
+void CUSBMSDGadget::BeginDataIO()
+{
+	for(unsigned i=0; i<NumBuffers; i++)
+	{
+		assert(m_Buffer[i].State != BufferDevice);
+		m_Buffer[i].State=BufferFree;
+		m_Buffer[i].nBlocks=0;
+	}
+
+	m_nDeviceBuffer=0;
+	m_nUSBBuffer=0;
+	m_nIOBlocks=m_nnumber_blocks;
+	m_bDataError=false;
+}
+
+void CUSBMSDGadget::StartDeviceIO(unsigned nBuffer, boolean bWrite)
+{
+	assert(nBuffer < NumBuffers);
+	TDataBuffer *pBuffer = &m_Buffer[nBuffer];
+	m_nDeviceBuffer=(nBuffer+1) % NumBuffers;
+
+	if(!bWrite)
+	{
+		pBuffer->nBlocks = m_nIOBlocks < MSD_MAX_TRANSFER_SIZE/BLOCK_SIZE
+				   ? m_nIOBlocks : MSD_MAX_TRANSFER_SIZE/BLOCK_SIZE;
+		m_nIOBlocks-=pBuffer->nBlocks;
+	}
+	assert(pBuffer->nBlocks>0);
+
+	u64 ullOffset = (u64) BLOCK_SIZE*m_nblock_address;
+	size_t nBytes = pBuffer->nBlocks*BLOCK_SIZE;
+	m_nblock_address+=pBuffer->nBlocks;
+
+	pBuffer->bWrite=bWrite;
+	pBuffer->nResult=-1;
+	pBuffer->State=BufferDevice;
+
+	//queue the transfer, if the device supports it
+	TDeviceBlockRequest Request;
+	Request.bWrite = bWrite;
+	Request.pBuffer = pBuffer->pData;
+	Request.ullOffset = ullOffset;
+	Request.nCount = nBytes;
+	Request.pCompletionRoutine = DeviceCompletionRoutine;
+	Request.pParam = pBuffer;
+
+	assert(m_pDevice);
+	if(m_pDevice->IOCtl(DEVICE_IOCTL_SUBMIT,&Request) == 0)
+	{
+		return;
+	}
+
+	//otherwise transfer synchronously
+	int nResult=-1;
+	if(m_pDevice->Seek(ullOffset) == ullOffset)
+	{
+		nResult = bWrite ? m_pDevice->Write(pBuffer->pData,nBytes)
+				 : m_pDevice->Read(pBuffer->pData,nBytes);
+	}
+
+	DeviceCompletionRoutine(nResult,pBuffer);
+}
+
+//may be called from IRQ
+void CUSBMSDGadget::DeviceCompletionRoutine(int nResult, void *pParam)
+{
+	TDataBuffer *pBuffer = (TDataBuffer *) pParam;
+	assert(pBuffer);
+	assert(pBuffer->State == BufferDevice);
+
+	CUSBMSDGadget *pThis = pBuffer->pThis;
+	assert(pThis);
+
+	pBuffer->nResult=nResult;
+
+	if(!pBuffer->bWrite)
+	{
+		pBuffer->State=BufferFull;  //will be sent in UpdateRead()
+		return;
+	}
+
+	if(nResult != (int) (pBuffer->nBlocks*BLOCK_SIZE))
+	{
+		pThis->m_bDataError=true;
+	}
+	else
+	{
+		pThis->m_nnumber_blocks-=pBuffer->nBlocks;
+	}
+
+	pBuffer->State=BufferFree;
+}
+
+//send the failed status, when no transfer is active any more
+void CUSBMSDGadget::DataIOFailed()
+{
+	for(unsigned i=0; i<NumBuffers; i++)
+	{
+		if(   m_Buffer[i].State == BufferUSB
+		   || m_Buffer[i].State == BufferDevice)
+		{
+			return;
+		}
+	}
+
+	MLOGERR("UpdateIO","failed, %s, block = %u",m_MSDReady?"ready":"not ready",
+	        m_nblock_address);
+	m_CSW.bmCSWStatus=MSD_CSW_STATUS_FAIL;
+	m_ReqSenseReply.bSenseKey = 2;
+	m_ReqSenseReply.bAddlSenseCode = 1;
+	SendCSW();
 }
@@ -24,6 +24,7 @@
 //
 #include <circle/usb/lan7800.h>
 #include <circle/usb/usbhostcontroller.h>
+#include <circle/netbuffer.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
@@ -35,7 +36,7 @@
 
 #define MAX_RX_FIFO_SIZE		(12 * 1024)
 #define MAX_TX_FIFO_SIZE		(12 * 1024)
-#define DEFAULT_BURST_CAP_SIZE		MAX_TX_FIFO_SIZE
+#define DEFAULT_BURST_CAP_SIZE		LAN7800_RX_BUFFER_SIZE
 #define DEFAULT_BULK_IN_DELAY		0x800
 
 #define RX_HEADER_SIZE			(4 + 4 + 2)
@@ -232,12 +233,17 @@ static const char FromLAN7800[] = "lan7800";
 CLAN7800Device::CLAN7800Device (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxRing (0),
+	m_nRxOffset (0)
 {
 }
 
 CLAN7800Device::~CLAN7800Device (void)
 {
+	delete m_pRxRing;
+	m_pRxRing = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -337,8 +343,8 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
-	// enable the LEDs and SEF mode
-	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN, ~HW_CFG_MEF))
+	// enable the LEDs and MEF mode (multiple frames per bulk-in transfer)
+	if (!ReadWriteReg (HW_CFG, HW_CFG_LED0_EN | HW_CFG_LED1_EN | HW_CFG_MEF))
 	{
 		return FALSE;
 	}
@@ -414,6 +420,12 @@ boolean CLAN7800Device::Configure (void)
 		return FALSE;
 	}
 
+	m_pRxRing = new CUSBBulkInRing (GetHost (), m_pEndpointBulkIn,
+					LAN7800_RX_BUFFER_SIZE, LAN7800_RX_BUFFERS);
+	assert (m_pRxRing != 0);
+
+	m_pRxRing->Poll ();
+
 	AddNetDevice ();
 
 	return TRUE;
@@ -443,50 +455,156 @@ boolean CLAN7800Device::SendFrame (const void *pBuffer, unsigned nLength)
 	return GetHost ()->Transfer (m_pEndpointBulkOut, TxBuffer, nLength+TX_HEADER_SIZE) >= 0;
 }
 
-boolean CLAN7800Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
+unsigned CLAN7800Device::SendBuffers (CNetBuffer *pFrames[], unsigned nCount)
 {
-	assert (m_pEndpointBulkIn != 0);
-	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
+	assert (pFrames != 0);
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	unsigned nFrames = 0;
+	while (nFrames < nCount)
 	{
-		return FALSE;
+		// each frame is preceded by TX command A and B and starts 32-bit aligned
+		unsigned nOffset = 0;
+		unsigned nBatch = 0;
+		while (nFrames + nBatch < nCount)
+		{
+			CNetBuffer *pFrame = pFrames[nFrames + nBatch];
+			assert (pFrame != 0);
+			unsigned nLength = pFrame->GetTotalLength ();
+			if (nLength > FRAME_BUFFER_SIZE)
+			{
+				break;
+			}
+
+			unsigned nOffsetAligned = (nOffset + 3) & ~3;
+			if (nOffsetAligned + TX_HEADER_SIZE + nLength > sizeof m_TxBuffer)
+			{
+				break;
+			}
+
+			u32 *pTxHeader = (u32 *) (m_TxBuffer + nOffsetAligned);
+			pTxHeader[0] = (nLength & TX_CMD_A_LEN_MASK) | TX_CMD_A_FCS;
+			pTxHeader[1] = 0;
+
+			pFrame->CopyTo (m_TxBuffer + nOffsetAligned + TX_HEADER_SIZE);
+
+			nOffset = nOffsetAligned + TX_HEADER_SIZE + nLength;
+			nBatch++;
+		}
+
+		if (nBatch == 0)
+		{
+			break;			// invalid frame
+		}
+
+		assert (m_pEndpointBulkOut != 0);
+		if (GetHost ()->Transfer (m_pEndpointBulkOut, m_TxBuffer, nOffset) < 0)
+		{
+			break;
+		}
+
+		nFrames += nBatch;
 	}
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < RX_HEADER_SIZE)
+	return nFrames;
+}
+
+boolean CLAN7800Device::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
+{
+	unsigned nFrameLength;
+	const u8 *pFrame = GetNextFrame (&nFrameLength);
+	if (pFrame == 0)
 	{
 		return FALSE;
 	}
 
-	u32 nRxStatus = *(u32 *) pBuffer;	// RX command A
-	if (nRxStatus & RX_CMD_A_RED)
-	{
-		CLogger::Get ()->Write (FromLAN7800, LogWarning, "RX error (status 0x%X)", nRxStatus);
+	assert (pBuffer != 0);
+	memcpy (pBuffer, pFrame, nFrameLength);
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
-	assert (nFrameLength == nResultLength-RX_HEADER_SIZE);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
+	assert (pResultLength != 0);
+	*pResultLength = nFrameLength;
+
+	return TRUE;
+}
+
+boolean CLAN7800Device::ReceiveBuffer (CNetBuffer *pFrame)
+{
+	unsigned nFrameLength;
+	const u8 *pData = GetNextFrame (&nFrameLength);
+	if (pData == 0)
 	{
 		return FALSE;
 	}
-	nFrameLength -= 4;	// ignore FCS
 
-	//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+	assert (pFrame != 0);
+	assert (pFrame->GetTailroom () >= nFrameLength);
+	memcpy (pFrame->Append (nFrameLength), pData, nFrameLength);
 
-	memcpy (pBuffer, (u8 *) pBuffer + RX_HEADER_SIZE, nFrameLength); // overwrite RX command A..C
-
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
 	return TRUE;
 }
 
+const u8 *CLAN7800Device::GetNextFrame (unsigned *pLength)
+{
+	assert (m_pRxRing != 0);
+
+	while (1)
+	{
+		unsigned nLength;
+		const u8 *pData = m_pRxRing->GetData (&nLength);
+		if (pData == 0)
+		{
+			m_pRxRing->Poll ();
+
+			return 0;
+		}
+
+		if (m_nRxOffset + RX_HEADER_SIZE > nLength)
+		{
+			// buffer has been processed completely
+			m_nRxOffset = 0;
+			m_pRxRing->ReleaseData ();
+
+			continue;
+		}
+
+		const u8 *pHeader = pData + m_nRxOffset;
+		u32 nRxStatus = *(const u32 *) pHeader;		// RX command A
+		u32 nFrameLength = nRxStatus & RX_CMD_A_LEN_MASK;
+		if (m_nRxOffset + RX_HEADER_SIZE + nFrameLength > nLength)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning, "Invalid RX data");
+
+			m_nRxOffset = 0;
+			m_pRxRing->ReleaseData ();
+
+			continue;
+		}
+
+		// the next frame starts 32-bit aligned
+		m_nRxOffset = (m_nRxOffset + RX_HEADER_SIZE + nFrameLength + 3) & ~3;
+
+		if (nRxStatus & RX_CMD_A_RED)
+		{
+			CLogger::Get ()->Write (FromLAN7800, LogWarning,
+						"RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength - 4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+
+		//CLogger::Get ()->Write (FromLAN7800, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		assert (pLength != 0);
+		*pLength = nFrameLength - 4;		// ignore FCS
+
+		return pHeader + RX_HEADER_SIZE;
+	}
+}
+
 boolean CLAN7800Device::IsLinkUp (void)
 {
 	u16 usPHYModeStatus;
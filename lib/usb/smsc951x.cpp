@@ -26,6 +26,7 @@
 //
 #include <circle/usb/smsc951x.h>
 #include <circle/usb/usbhostcontroller.h>
+#include <circle/netbuffer.h>
 #include <circle/bcmpropertytags.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
@@ -35,6 +36,12 @@
 #include <circle/debug.h>
 #include <assert.h>
 
+#define HS_USB_PKT_SIZE			512
+#define DEFAULT_BULK_IN_DELAY		0x2000
+
+#define TX_HEADER_SIZE			8
+#define RX_HEADER_SIZE			4
+
 // USB vendor requests
 #define WRITE_REGISTER			0xA0
 #define READ_REGISTER			0xA1
@@ -47,6 +54,8 @@
 	#define TX_CFG_ON			0x00000004
 #define HW_CFG				0x14
 	#define HW_CFG_BIR			0x00001000
+	#define HW_CFG_MEF			0x00000020
+	#define HW_CFG_BCE			0x00000002
 #define RX_FIFO_INF			0x18
 #define PM_CTRL				0x20
 #define LED_GPIO_CFG			0x24
@@ -130,12 +139,17 @@ static const char FromSMSC951x[] = "smsc951x";
 CSMSC951xDevice::CSMSC951xDevice (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_pEndpointBulkIn (0),
-	m_pEndpointBulkOut (0)
+	m_pEndpointBulkOut (0),
+	m_pRxRing (0),
+	m_nRxOffset (0)
 {
 }
 
 CSMSC951xDevice::~CSMSC951xDevice (void)
 {
+	delete m_pRxRing;
+	m_pRxRing = 0;
+
 	delete m_pEndpointBulkOut;
 	m_pEndpointBulkOut = 0;
 
@@ -229,6 +243,18 @@ boolean CSMSC951xDevice::Configure (void)
 		return FALSE;
 	}
 
+	// allow multiple frames per bulk-in transfer up to the burst cap size
+	u32 nHWConfig;
+	if (   !WriteReg (BURST_CAP, SMSC951X_RX_BUFFER_SIZE / HS_USB_PKT_SIZE)	// for USB high speed
+	    || !WriteReg (BULK_IN_DLY, DEFAULT_BULK_IN_DELAY)
+	    || !ReadReg (HW_CFG, &nHWConfig)
+	    || !WriteReg (HW_CFG, nHWConfig | HW_CFG_MEF | HW_CFG_BCE | HW_CFG_BIR))
+	{
+		CLogger::Get ()->Write (FromSMSC951x, LogError, "Cannot enable RX burst mode");
+
+		return FALSE;
+	}
+
 	if (   !WriteReg (LED_GPIO_CFG,   LED_GPIO_CFG_SPD_LED
 					| LED_GPIO_CFG_LNK_LED
 					| LED_GPIO_CFG_FDX_LED)
@@ -243,6 +269,12 @@ boolean CSMSC951xDevice::Configure (void)
 		return FALSE;
 	}
 
+	m_pRxRing = new CUSBBulkInRing (GetHost (), m_pEndpointBulkIn,
+					SMSC951X_RX_BUFFER_SIZE, SMSC951X_RX_BUFFERS);
+	assert (m_pRxRing != 0);
+
+	m_pRxRing->Poll ();
+
 	AddNetDevice ();
 
 	return TRUE;
@@ -260,62 +292,168 @@ boolean CSMSC951xDevice::SendFrame (const void *pBuffer, unsigned nLength)
 		return FALSE;
 	}
 
-	DMA_BUFFER (u8, TxBuffer, FRAME_BUFFER_SIZE+8);
+	DMA_BUFFER (u8, TxBuffer, FRAME_BUFFER_SIZE+TX_HEADER_SIZE);
 	assert (pBuffer != 0);
-	memcpy (TxBuffer+8, pBuffer, nLength);
+	memcpy (TxBuffer+TX_HEADER_SIZE, pBuffer, nLength);
 
 	u32 *pTxHeader = (u32 *) TxBuffer;
 	pTxHeader[0] = TX_CMD_A_FIRST_SEG | TX_CMD_A_LAST_SEG | nLength;
 	pTxHeader[1] = nLength;
 	
 	assert (m_pEndpointBulkOut != 0);
-	return GetHost ()->Transfer (m_pEndpointBulkOut, TxBuffer, nLength+8) >= 0;
+	return GetHost ()->Transfer (m_pEndpointBulkOut, TxBuffer, nLength+TX_HEADER_SIZE) >= 0;
 }
 
-boolean CSMSC951xDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
+unsigned CSMSC951xDevice::SendBuffers (CNetBuffer *pFrames[], unsigned nCount)
 {
-	assert (m_pEndpointBulkIn != 0);
-	assert (pBuffer != 0);
-	CUSBRequest URB (m_pEndpointBulkIn, pBuffer, FRAME_BUFFER_SIZE);
+	assert (pFrames != 0);
 
-	if (!GetHost ()->SubmitBlockingRequest (&URB))
+	unsigned nFrames = 0;
+	while (nFrames < nCount)
 	{
-		return FALSE;
+		// each frame is preceded by TX command A and B and starts 32-bit aligned
+		unsigned nOffset = 0;
+		unsigned nBatch = 0;
+		while (nFrames + nBatch < nCount)
+		{
+			CNetBuffer *pFrame = pFrames[nFrames + nBatch];
+			assert (pFrame != 0);
+			unsigned nLength = pFrame->GetTotalLength ();
+			if (nLength > FRAME_BUFFER_SIZE)
+			{
+				break;
+			}
+
+			unsigned nOffsetAligned = (nOffset + 3) & ~3;
+			if (nOffsetAligned + TX_HEADER_SIZE + nLength > sizeof m_TxBuffer)
+			{
+				break;
+			}
+
+			u32 *pTxHeader = (u32 *) (m_TxBuffer + nOffsetAligned);
+			pTxHeader[0] = TX_CMD_A_FIRST_SEG | TX_CMD_A_LAST_SEG | nLength;
+			pTxHeader[1] = nLength;
+
+			pFrame->CopyTo (m_TxBuffer + nOffsetAligned + TX_HEADER_SIZE);
+
+			nOffset = nOffsetAligned + TX_HEADER_SIZE + nLength;
+			nBatch++;
+		}
+
+		if (nBatch == 0)
+		{
+			break;			// invalid frame
+		}
+
+		assert (m_pEndpointBulkOut != 0);
+		if (GetHost ()->Transfer (m_pEndpointBulkOut, m_TxBuffer, nOffset) < 0)
+		{
+			break;
+		}
+
+		nFrames += nBatch;
 	}
 
-	u32 nResultLength = URB.GetResultLength ();
-	if (nResultLength < 4)				// should not happen with HW_CFG_BIR set
+	return nFrames;
+}
+
+boolean CSMSC951xDevice::ReceiveFrame (void *pBuffer, unsigned *pResultLength)
+{
+	unsigned nFrameLength;
+	const u8 *pFrame = GetNextFrame (&nFrameLength);
+	if (pFrame == 0)
 	{
 		return FALSE;
 	}
 
-	u32 nRxStatus = *(u32 *) pBuffer;
-	if (nRxStatus & RX_STS_ERROR)
-	{
-		CLogger::Get ()->Write (FromSMSC951x, LogWarning, "RX error (status 0x%X)", nRxStatus);
+	assert (pBuffer != 0);
+	memcpy (pBuffer, pFrame, nFrameLength);
 
-		return FALSE;
-	}
-	
-	u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
-	assert (nFrameLength == nResultLength-4);
-	assert (nFrameLength > 4);
-	if (nFrameLength <= 4)
+	assert (pResultLength != 0);
+	*pResultLength = nFrameLength;
+
+	return TRUE;
+}
+
+boolean CSMSC951xDevice::ReceiveBuffer (CNetBuffer *pFrame)
+{
+	unsigned nFrameLength;
+	const u8 *pData = GetNextFrame (&nFrameLength);
+	if (pData == 0)
 	{
 		return FALSE;
 	}
-	nFrameLength -= 4;	// ignore CRC
-
-	//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
 
-	memcpy (pBuffer, (u8 *) pBuffer + 4, nFrameLength);	// overwrite RX status
+	assert (pFrame != 0);
+	assert (pFrame->GetTailroom () >= nFrameLength);
+	memcpy (pFrame->Append (nFrameLength), pData, nFrameLength);
 
-	assert (pResultLength != 0);
-	*pResultLength = nFrameLength;
-	
 	return TRUE;
 }
 
+const u8 *CSMSC951xDevice::GetNextFrame (unsigned *pLength)
+{
+	assert (m_pRxRing != 0);
+
+	while (1)
+	{
+		unsigned nLength;
+		const u8 *pData = m_pRxRing->GetData (&nLength);
+		if (pData == 0)
+		{
+			m_pRxRing->Poll ();
+
+			return 0;
+		}
+
+		if (m_nRxOffset + RX_HEADER_SIZE > nLength)
+		{
+			// buffer has been processed completely
+			m_nRxOffset = 0;
+			m_pRxRing->ReleaseData ();
+
+			continue;
+		}
+
+		const u8 *pHeader = pData + m_nRxOffset;
+		u32 nRxStatus = *(const u32 *) pHeader;
+		u32 nFrameLength = RX_STS_FRAMELEN (nRxStatus);
+		if (m_nRxOffset + RX_HEADER_SIZE + nFrameLength > nLength)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning, "Invalid RX data");
+
+			m_nRxOffset = 0;
+			m_pRxRing->ReleaseData ();
+
+			continue;
+		}
+
+		// the next frame starts 32-bit aligned
+		m_nRxOffset = (m_nRxOffset + RX_HEADER_SIZE + nFrameLength + 3) & ~3;
+
+		if (nRxStatus & RX_STS_ERROR)
+		{
+			CLogger::Get ()->Write (FromSMSC951x, LogWarning,
+						"RX error (status 0x%X)", nRxStatus);
+
+			continue;
+		}
+
+		if (   nFrameLength <= 4
+		    || nFrameLength - 4 > FRAME_BUFFER_SIZE)
+		{
+			continue;
+		}
+
+		//CLogger::Get ()->Write (FromSMSC951x, LogDebug, "Frame received (status 0x%X)", nRxStatus);
+
+		assert (pLength != 0);
+		*pLength = nFrameLength - 4;		// ignore CRC
+
+		return pHeader + RX_HEADER_SIZE;
+	}
+}
+
 boolean CSMSC951xDevice::IsLinkUp (void)
 {
 	u16 usPHYModeStatus;
@@ -127,6 +127,11 @@ CUSBAudioStreamingDevice::CUSBAudioStreamingDevice (CUSBFunction *pFunction)
 	m_nPacketsPerChunk (0),
 	m_bSyncEPActive (FALSE),
 	m_nSyncAccu (0),
+	m_bImplicitFeedback (FALSE),
+	m_nFeedbackNominal (0),
+	m_nFeedback (0),
+	m_nFeedbackShift (0),
+	m_bFeedbackShiftValid (FALSE),
 	m_uchClockSourceID (USB_AUDIO_UNDEFINED_UNIT_ID),
 	m_uchSelectorUnitID (USB_AUDIO_UNDEFINED_UNIT_ID),
 	From ("uaudio")
@@ -346,17 +351,21 @@ boolean CUSBAudioStreamingDevice::Configure (void)
 	{
 		TUSBAudioEndpointDescriptor *pEndpointInDesc;
 		pEndpointInDesc = (TUSBAudioEndpointDescriptor *) GetDescriptor (DESCRIPTOR_ENDPOINT);
-		if (   !pEndpointInDesc
-		    || (pEndpointInDesc->bmAttributes     & 0x3F) != 0x11  // Isochronous, Feedback
-		    || (pEndpointInDesc->bEndpointAddress & 0x80) != 0x80) // Input EP
+		if (   pEndpointInDesc
+		    && (pEndpointInDesc->bmAttributes     & 0x3F) == 0x11  // Isochronous, Feedback
+		    && (pEndpointInDesc->bEndpointAddress & 0x80) == 0x80) // Input EP
 		{
-			LOGWARN ("Isochronous feedback input EP expected");
-
-			return FALSE;
+			m_pEndpointSync = new CUSBEndpoint (GetDevice (),
+							    (TUSBEndpointDescriptor *) pEndpointInDesc);
+			assert (m_pEndpointSync != 0);
 		}
+		else
+		{
+			// the rate is given by the data input EP of the device
+			LOGNOTE ("Using implicit feedback");
 
-		m_pEndpointSync = new CUSBEndpoint (GetDevice (), (TUSBEndpointDescriptor *) pEndpointInDesc);
-		assert (m_pEndpointSync != 0);
+			m_bImplicitFeedback = TRUE;
+		}
 	}
 
 	m_bSynchronousSync = (pEndpointDesc->bmAttributes & 0x0C) == 0x0C;
@@ -724,11 +733,20 @@ boolean CUSBAudioStreamingDevice::Setup (unsigned nSampleRate)
 			m_nChunkSizeBytes += nFrameSize-1;
 			m_nChunkSizeBytes /= nFrameSize;
 			m_nChunkSizeBytes *= nFrameSize;
+
+			// start with the nominal rate, until the first feedback arrives
+			m_nFeedbackNominal = ((u64) nSampleRate << 16) / GetUSBFrameRate ();
+			m_nFeedback = m_nFeedbackNominal * m_nDataIntervalFactor;
+			m_bFeedbackShiftValid = FALSE;
+			m_nSyncAccu = 0;
 		}
 		else
 		{
-			m_nChunkSizeBytes =   m_pEndpointData->GetMaxPacketSize ()
-					    - m_pEndpointData->GetMaxPacketSize () % m_nSubframeSize;
+			// high-bandwidth endpoints receive up to 3 packets per microframe
+			unsigned nMaxPayload =   m_pEndpointData->GetMaxPacketSize ()
+					       * m_pEndpointData->GetTransactionsPerMicroframe ();
+
+			m_nChunkSizeBytes = nMaxPayload - nMaxPayload % m_nSubframeSize;
 		}
 	}
 
@@ -767,6 +785,12 @@ boolean CUSBAudioStreamingDevice::SendChunk (const void *pBuffer, unsigned nChun
 
 	boolean bOK = GetHost ()->SubmitAsyncRequest (pURB);
 
+	if (   bOK
+	    && !m_bSynchronousSync)
+	{
+		UpdateAsyncChunkSize ();
+	}
+
 	if (   bOK
 	    && m_pEndpointSync
 	    && !m_bSyncEPActive)
@@ -831,6 +855,44 @@ boolean CUSBAudioStreamingDevice::ReceiveChunk (void *pBuffer, unsigned nChunkSi
 	return bOK;
 }
 
+boolean CUSBAudioStreamingDevice::HasImplicitFeedback (void) const
+{
+	return m_bImplicitFeedback;
+}
+
+void CUSBAudioStreamingDevice::ImplicitFeedback (const CUSBAudioStreamingDevice *pSource,
+						 unsigned nBytesReceived)
+{
+	assert (m_bImplicitFeedback);
+	assert (pSource);
+	assert (!pSource->m_bIsOutput);
+
+	if (!nBytesReceived)
+	{
+		return;
+	}
+
+	// one packet is received per chunk, normalize it to frames per (micro)frame
+	unsigned nFrameSize = pSource->m_nChannels * pSource->m_nSubframeSize;
+	assert (nFrameSize);
+	u32 nFeedback = (nBytesReceived / nFrameSize << 16) / pSource->m_nDataIntervalFactor;
+
+	// the packet sizes vary around the rate, average them
+	u32 nAverage = m_nFeedback / m_nDataIntervalFactor;
+	SetFeedback (nAverage + ((s32) (nFeedback - nAverage) >> 3));
+}
+
+unsigned CUSBAudioStreamingDevice::GetFeedbackRate (void) const
+{
+	if (   !m_bIsOutput
+	    || m_bSynchronousSync)
+	{
+		return 0;
+	}
+
+	return (u64) m_nFeedback * GetUSBFrameRate () / m_nDataIntervalFactor;
+}
+
 boolean CUSBAudioStreamingDevice::SelectInputTerminal (unsigned nIndex)
 {
 	assert (m_nTerminals);
@@ -1071,18 +1133,12 @@ void CUSBAudioStreamingDevice::SyncCompletionHandler (CUSBRequest *pURB, void *p
 		if (bFormat10_14)
 		{
 			// Q10.14 format (FS)
-			pThis->m_nSyncAccu += pThis->m_SyncEPBuffer[0] & 0xFFFFFF;
-			pThis->m_nChunkSizeBytes =   (pThis->m_nSyncAccu >> 14)
-						   * pThis->m_nChannels * pThis->m_nSubframeSize;
-			pThis->m_nSyncAccu &= 0x3FFF;
+			pThis->SetFeedback ((pThis->m_SyncEPBuffer[0] & 0xFFFFFF) << 2);
 		}
 		else
 		{
 			// Q16.16 format (HS)
-			pThis->m_nSyncAccu += pThis->m_SyncEPBuffer[0];
-			pThis->m_nChunkSizeBytes =   (pThis->m_nSyncAccu >> 16)
-						   * pThis->m_nChannels * pThis->m_nSubframeSize;
-			pThis->m_nSyncAccu &= 0xFFFF;
+			pThis->SetFeedback (pThis->m_SyncEPBuffer[0]);
 		}
 	}
 
@@ -1094,8 +1150,7 @@ void CUSBAudioStreamingDevice::UpdateChunkSize (void)
 	assert (m_bSynchronousSync);
 	assert (m_nSampleRate > 0);
 
-	unsigned nUSBFrameRate =   (GetDevice ()->GetSpeed () == USBSpeedFull ? 1000 : 8000)
-				 / m_nDataIntervalFactor;
+	unsigned nUSBFrameRate = GetUSBFrameRate () / m_nDataIntervalFactor;
 
 	m_SpinLock.Acquire ();
 
@@ -1117,3 +1172,87 @@ void CUSBAudioStreamingDevice::UpdateChunkSize (void)
 
 	m_SpinLock.Release ();
 }
+
+void CUSBAudioStreamingDevice::SetFeedback (u32 nFeedback)
+{
+	assert (m_bIsOutput);
+	assert (m_nFeedbackNominal);
+
+	u32 nMin = m_nFeedbackNominal - m_nFeedbackNominal / 8;
+	u32 nMax = m_nFeedbackNominal + m_nFeedbackNominal / 8;
+
+	// Some devices send the value in a different format than specified
+	// (e.g. Q16.16 on full-speed), detect the required shift once.
+	if (!m_bFeedbackShiftValid)
+	{
+		for (int nShift = -4; nShift <= 4; nShift++)
+		{
+			u64 nValue = nShift >= 0 ? (u64) nFeedback << nShift : nFeedback >> -nShift;
+			if (nMin <= nValue && nValue <= nMax)
+			{
+				if (nShift)
+				{
+					LOGDBG ("Feedback format corrected by shift %d", nShift);
+				}
+
+				m_nFeedbackShift = nShift;
+				m_bFeedbackShiftValid = TRUE;
+
+				break;
+			}
+		}
+
+		if (!m_bFeedbackShiftValid)
+		{
+			return;
+		}
+	}
+
+	u64 nValue =   m_nFeedbackShift >= 0
+		     ? (u64) nFeedback << m_nFeedbackShift
+		     : nFeedback >> -m_nFeedbackShift;
+
+	// ignore invalid values
+	if (   nValue < nMin
+	    || nValue > nMax)
+	{
+		return;
+	}
+
+	m_nFeedback = (u32) nValue * m_nDataIntervalFactor;
+}
+
+void CUSBAudioStreamingDevice::UpdateAsyncChunkSize (void)
+{
+	assert (!m_bSynchronousSync);
+
+	if (!m_bIsOutput)
+	{
+		return;
+	}
+
+	// the fractional part of the feedback value is accumulated from packet to packet,
+	// so that the mean packet size precisely tracks the rate of the device
+	m_SpinLock.Acquire ();
+
+	m_nSyncAccu += m_nFeedback;
+	unsigned nFrames = m_nSyncAccu >> 16;
+	m_nSyncAccu &= 0xFFFF;
+
+	m_SpinLock.Release ();
+
+	unsigned nFrameSize = m_nChannels * m_nSubframeSize;
+	unsigned nMaxFrames =   m_pEndpointData->GetMaxPacketSize ()
+			      * m_pEndpointData->GetTransactionsPerMicroframe () / nFrameSize;
+	if (nFrames > nMaxFrames)
+	{
+		nFrames = nMaxFrames;
+	}
+
+	m_nChunkSizeBytes = nFrames * nFrameSize;
+}
+
+unsigned CUSBAudioStreamingDevice::GetUSBFrameRate (void) const
+{
+	return GetDevice ()->GetSpeed () == USBSpeedFull ? 1000 : 8000;
+}
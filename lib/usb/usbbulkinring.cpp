@@ -0,0 +1,161 @@
+//
+// usbbulkinring.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/usb/usbbulkinring.h>
+#include <circle/synchronize.h>
+#include <assert.h>
+
+CUSBBulkInRing::CUSBBulkInRing (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+				unsigned nBufferSize, unsigned nBuffers)
+:	m_pHost (pHost),
+	m_pEndpoint (pEndpoint),
+	m_nBufferSize (nBufferSize),
+	m_nBuffers (nBuffers),
+	m_nIn (0),
+	m_nOut (0),
+	m_nFilled (0),
+	m_pURB (0)
+{
+	assert (m_pHost != 0);
+	assert (m_pEndpoint != 0);
+	assert (m_nBufferSize > 0);
+	assert (m_nBufferSize % DATA_CACHE_LINE_LENGTH_MAX == 0);
+	assert (2 <= m_nBuffers && m_nBuffers <= USB_BULK_IN_RING_MAX_BUFFERS);
+
+	// heap blocks are aligned to the cache line length, so the buffers can be used for DMA
+	m_pBuffer = new u8[m_nBuffers * m_nBufferSize];
+	assert (m_pBuffer != 0);
+}
+
+CUSBBulkInRing::~CUSBBulkInRing (void)
+{
+	// an active request cannot be cancelled
+	assert (m_pURB == 0);
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	m_pEndpoint = 0;
+	m_pHost = 0;
+}
+
+void CUSBBulkInRing::Poll (void)
+{
+	EnterCritical ();
+
+	SubmitRequest ();
+
+	LeaveCritical ();
+}
+
+const u8 *CUSBBulkInRing::GetData (unsigned *pLength) const
+{
+	if (m_nFilled == 0)
+	{
+		return 0;
+	}
+
+	assert (pLength != 0);
+	*pLength = m_nLength[m_nOut];
+	assert (*pLength > 0);
+
+	// the buffer has been filled in the completion routine (IRQ context)
+	DataMemBarrier ();
+
+	return m_pBuffer + m_nOut * m_nBufferSize;
+}
+
+void CUSBBulkInRing::ReleaseData (void)
+{
+	EnterCritical ();
+
+	assert (m_nFilled > 0);
+	m_nFilled--;
+
+	if (++m_nOut == m_nBuffers)
+	{
+		m_nOut = 0;
+	}
+
+	SubmitRequest ();
+
+	LeaveCritical ();
+}
+
+void CUSBBulkInRing::SubmitRequest (void)
+{
+	if (   m_pURB != 0
+	    || m_nFilled == m_nBuffers)
+	{
+		return;
+	}
+
+	assert (m_pEndpoint != 0);
+	assert (m_pBuffer != 0);
+	m_pURB = new CUSBRequest (m_pEndpoint, m_pBuffer + m_nIn * m_nBufferSize, m_nBufferSize);
+	assert (m_pURB != 0);
+
+	m_pURB->SetCompletionRoutine (CompletionStub, 0, this);
+
+	m_pURB->SetCompleteOnNAK ();
+
+	assert (m_pHost != 0);
+	if (!m_pHost->SubmitAsyncRequest (m_pURB))
+	{
+		delete m_pURB;
+		m_pURB = 0;
+	}
+}
+
+void CUSBBulkInRing::CompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+	assert (m_pURB == pURB);
+
+	unsigned nLength = pURB->GetStatus () != 0 ? pURB->GetResultLength () : 0;
+	assert (nLength <= m_nBufferSize);
+
+	delete pURB;
+	m_pURB = 0;
+
+	if (nLength == 0)
+	{
+		return;			// NAK or error, next request is started by Poll()
+	}
+
+	m_nLength[m_nIn] = nLength;
+
+	if (++m_nIn == m_nBuffers)
+	{
+		m_nIn = 0;
+	}
+
+	m_nFilled++;
+
+	// more data is probably pending
+	SubmitRequest ();
+}
+
+void CUSBBulkInRing::CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
+{
+	CUSBBulkInRing *pThis = (CUSBBulkInRing *) pContext;
+	assert (pThis != 0);
+
+	pThis->CompletionRoutine (pURB);
+}
@@ -27,7 +27,8 @@ CUSBEndpoint::CUSBEndpoint (CUSBDevice *pDevice)
 	m_ucNumber (0),
 	m_Type (EndpointTypeControl),
 	m_bDirectionIn (FALSE),
-	m_nMaxPacketSize (USB_DEFAULT_MAX_PACKET_SIZE)
+	m_nMaxPacketSize (USB_DEFAULT_MAX_PACKET_SIZE),
+	m_nTransactions (1)
 #if RASPPI <= 3
 	, m_nInterval (1),
 	m_NextPID (USBPIDSetup)
@@ -77,6 +78,19 @@ CUSBEndpoint::CUSBEndpoint (CUSBDevice *pDevice, const TUSBEndpointDescriptor *p
 	m_bDirectionIn   = pDesc->bEndpointAddress & 0x80 ? TRUE : FALSE;
 	m_nMaxPacketSize = pDesc->wMaxPacketSize & 0x7FF;
 
+	// see USB 2.0 spec chapter 5.9
+	m_nTransactions = 1;
+	if (   m_pDevice->GetSpeed () == USBSpeedHigh
+	    && (   m_Type == EndpointTypeInterrupt
+		|| m_Type == EndpointTypeIsochronous))
+	{
+		m_nTransactions += (pDesc->wMaxPacketSize >> 11) & 3;
+		if (m_nTransactions > 3)
+		{
+			m_nTransactions = 3;		// reserved value
+		}
+	}
+
 #if RASPPI <= 3
 	if (   m_Type == EndpointTypeInterrupt
 	    || m_Type == EndpointTypeIsochronous)
@@ -196,6 +210,11 @@ u32 CUSBEndpoint::GetMaxPacketSize (void) const
 	return m_nMaxPacketSize;
 }
 
+u32 CUSBEndpoint::GetTransactionsPerMicroframe (void) const
+{
+	return m_nTransactions;
+}
+
 #if RASPPI <= 3
 
 unsigned CUSBEndpoint::GetInterval (void) const
@@ -346,7 +346,8 @@ void CUSBGamePadPS4Device::HandleTouchpad (const u8 *pReportBuffer)
 			assert (m_pMouseDevice != 0);
 			m_pMouseDevice->ReportHandler (  m_Touchpad.bButtonPressed
 						       ? MOUSE_BUTTON_LEFT : 0,
-						       nDisplacementX, nDisplacementY, 0);
+						       nDisplacementX, nDisplacementY, 0,
+						       GetReportTimestamp ());
 
 			bButtonChanged = FALSE;
 			nDisplacementX = 0;
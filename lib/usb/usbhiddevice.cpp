@@ -20,17 +20,21 @@
 #include <circle/usb/usbhiddevice.h>
 #include <circle/usb/usbhid.h>
 #include <circle/logger.h>
+#include <circle/timer.h>
 #include <circle/util.h>
 #include <assert.h>
 
 static const char FromUSBHID[] = "usbhid";
 
+unsigned CUSBHIDDevice::s_nPollingInterval = 0;
+
 CUSBHIDDevice::CUSBHIDDevice (CUSBFunction *pFunction, unsigned nMaxReportSize)
 :	CUSBFunction (pFunction),
 	m_nMaxReportSize (nMaxReportSize),
 	m_pReportEndpoint (0),
 	m_pEndpointOut (0),
-	m_pReportBuffer (0)
+	m_pReportBuffer (0),
+	m_ullReportTimestamp (0)
 {
 	if (m_nMaxReportSize > 0)
 	{
@@ -74,7 +78,36 @@ boolean CUSBHIDDevice::ConfigureHID (unsigned nMaxReportSize)
 					return FALSE;
 				}
 
-				m_pReportEndpoint = new CUSBEndpoint (GetDevice (), pEndpointDesc);
+				if (s_nPollingInterval != 0)
+				{
+					TUSBEndpointDescriptor EndpointDesc = *pEndpointDesc;
+
+					// see USB 2.0 spec chapter 9.6.6
+					u8 ucInterval;
+					if (GetDevice ()->GetSpeed () < USBSpeedHigh)
+					{
+						ucInterval =   s_nPollingInterval < 255
+							     ? s_nPollingInterval : 255;
+					}
+					else
+					{
+						for (ucInterval = 1; ucInterval < 16; ucInterval++)
+						{
+							if ((1U << (ucInterval-1)) >= s_nPollingInterval * 8)
+							{
+								break;
+							}
+						}
+					}
+
+					EndpointDesc.bInterval = ucInterval;
+
+					m_pReportEndpoint = new CUSBEndpoint (GetDevice (), &EndpointDesc);
+				}
+				else
+				{
+					m_pReportEndpoint = new CUSBEndpoint (GetDevice (), pEndpointDesc);
+				}
 			}
 			else							// Output EP
 			{
@@ -194,6 +227,16 @@ int CUSBHIDDevice::ReceiveFromEndpointIn (void *pBuffer, unsigned nBufSize, unsi
 	return GetHost ()->Transfer (m_pReportEndpoint, pBuffer, nBufSize, nTimeoutMs);
 }
 
+u64 CUSBHIDDevice::GetReportTimestamp (void) const
+{
+	return m_ullReportTimestamp;
+}
+
+void CUSBHIDDevice::SetPollingInterval (unsigned nMilliseconds)
+{
+	s_nPollingInterval = nMilliseconds;
+}
+
 boolean CUSBHIDDevice::StartRequest (void)
 {
 	assert (m_pReportEndpoint != 0);
@@ -213,6 +256,8 @@ void CUSBHIDDevice::CompletionRoutine (CUSBRequest *pURB)
 
 	boolean bRestart = TRUE;
 
+	m_ullReportTimestamp = CTimer::GetClockTicks64 ();
+
 	if (pURB->GetStatus () != 0)
 	{
 		ReportHandler (m_pReportBuffer, pURB->GetResultLength ());
@@ -2,7 +2,7 @@
 // usbhostcontroller.cpp
 //
 // Circle - A C++ bare metal environment for Raspberry Pi
-// Copyright (C) 2014-2023  R. Stange <rsta2@o2online.de>
+// Copyright (C) 2014-2026  R. Stange <rsta2@o2online.de>
 // 
 // This program is free software: you can redistribute it and/or modify
 // it under the terms of the GNU General Public License as published by
@@ -21,6 +21,7 @@
 #include <circle/usb/usbhcirootport.h>
 #include <circle/usb/usbstandardhub.h>
 #include <circle/timer.h>
+#include <circle/synchronize.h>
 #include <assert.h>
 
 struct TPortStatusEvent
@@ -99,8 +100,9 @@ int CUSBHostController::ControlMessage (CUSBEndpoint *pEndpoint,
 					u16 usValue, u16 usIndex,
 					void *pData, u16 usDataSize)
 {
-	TSetupData *pSetup = new TSetupData;
-	assert (pSetup != 0);
+	// no heap allocation on the data path, the setup packet is read using DMA
+	DMA_BUFFER (u8, SetupBuffer, sizeof (TSetupData));
+	TSetupData *pSetup = (TSetupData *) SetupBuffer;
 
 	pSetup->bmRequestType = ucRequestType;
 	pSetup->bRequest      = ucRequest;
@@ -121,8 +123,6 @@ int CUSBHostController::ControlMessage (CUSBEndpoint *pEndpoint,
 		assert (pEndpoint != 0);
 		pEndpoint->ResetPID ();
 	}
-	
-	delete pSetup;
 
 	return nResult;
 }
@@ -140,6 +140,37 @@ int CUSBHostController::Transfer (CUSBEndpoint *pEndpoint, void *pBuffer, unsign
 	return URB.GetResultLength ();
 }
 
+boolean CUSBHostController::AwaitRequest (CAsyncFlow *pFlow, CUSBRequest *pURB, unsigned nTimeoutMs)
+{
+	assert (pFlow != 0);
+	if (pFlow->IsPending ())
+	{
+		return pFlow->FetchCompletion ();
+	}
+
+	assert (pURB != 0);
+	pURB->SetCompletionRoutine (AsyncFlowCompletionRoutine, 0, pFlow);
+
+	pFlow->Suspend ();
+
+	if (!SubmitAsyncRequest (pURB, nTimeoutMs))
+	{
+		pFlow->Complete (-1);
+	}
+
+	return FALSE;
+}
+
+void CUSBHostController::AsyncFlowCompletionRoutine (CUSBRequest *pURB, void *pParam,
+						     void *pContext)
+{
+	CAsyncFlow *pFlow = (CAsyncFlow *) pContext;
+	assert (pFlow != 0);
+
+	assert (pURB != 0);
+	pFlow->Complete (pURB->GetStatus () ? (int) pURB->GetResultLength () : -1);
+}
+
 boolean CUSBHostController::IsPlugAndPlay (void) const
 {
 	return m_bPlugAndPlay;
@@ -19,6 +19,7 @@
 //
 #include <circle/usb/usbkeyboard.h>
 #include <circle/devicenameservice.h>
+#include <circle/input/inputeventqueue.h>
 #include <circle/usb/usbhostcontroller.h>
 #include <circle/synchronize.h>
 #include <circle/logger.h>
@@ -41,6 +42,7 @@ CUSBKeyboardDevice::CUSBKeyboardDevice (CUSBFunction *pFunction)
 	m_nDeviceNumber (0)		// not assigned
 {
 	memset (m_LastReport, 0, sizeof m_LastReport);
+	memset (m_QueuedReport, 0, sizeof m_QueuedReport);
 }
 
 CUSBKeyboardDevice::~CUSBKeyboardDevice (void)
@@ -197,6 +199,8 @@ void CUSBKeyboardDevice::ReportHandler (const u8 *pReport, unsigned nReportSize)
 		return;
 	}
 
+	QueueKeyEvents (pReport);
+
 	if (m_pKeyStatusHandlerRaw != 0)
 	{
 		(*m_pKeyStatusHandlerRaw) (pReport[0], pReport+2, m_pKeyStatusHandlerRawArg);
@@ -249,6 +253,53 @@ void CUSBKeyboardDevice::ReportHandler (const u8 *pReport, unsigned nReportSize)
 	memcpy (m_LastReport, pReport, sizeof m_LastReport);
 }
 
+void CUSBKeyboardDevice::QueueKeyEvents (const u8 *pReport)
+{
+	CInputEventQueue *pQueue = CInputEventQueue::Get ();
+	if (pQueue == 0)
+	{
+		return;
+	}
+
+	// all key events of a report get the time of its arrival
+	u64 ullTimestamp = GetReportTimestamp ();
+
+	for (unsigned i = 0; i < 8; i++)
+	{
+		unsigned nMask = 1 << i;
+
+		if ((pReport[0] ^ m_QueuedReport[0]) & nMask)
+		{
+			pQueue->Put (pReport[0] & nMask ? InputEventKeyDown : InputEventKeyUp,
+				     m_nDeviceNumber, 0x80 + i, 0, 0, 0, ullTimestamp);
+		}
+	}
+
+	for (unsigned i = 2; i < USBKEYB_REPORT_SIZE; i++)
+	{
+		u8 ucKeyCode = m_QueuedReport[i];
+		if (   ucKeyCode != 0
+		    && !FindByte (pReport+2, ucKeyCode, USBKEYB_REPORT_SIZE-2))
+		{
+			pQueue->Put (InputEventKeyUp, m_nDeviceNumber, ucKeyCode,
+				     0, 0, 0, ullTimestamp);
+		}
+	}
+
+	for (unsigned i = 2; i < USBKEYB_REPORT_SIZE; i++)
+	{
+		u8 ucKeyCode = pReport[i];
+		if (   ucKeyCode != 0
+		    && !FindByte (m_QueuedReport+2, ucKeyCode, USBKEYB_REPORT_SIZE-2))
+		{
+			pQueue->Put (InputEventKeyDown, m_nDeviceNumber, ucKeyCode,
+				     0, 0, 0, ullTimestamp);
+		}
+	}
+
+	memcpy (m_QueuedReport, pReport, sizeof m_QueuedReport);
+}
+
 boolean CUSBKeyboardDevice::FindByte (const u8 *pBuffer, u8 ucByte, unsigned nLength)
 {
 	while (nLength-- > 0)
@@ -168,6 +168,27 @@ struct TSCSIReadCapacityResponse
 }
 PACKED;
 
+struct TSCSIReadCapacity16
+{
+	u8		OperationCode;
+#define SCSI_OP_SERVICE_ACTION_IN16	0x9E
+	u8		ServiceAction;
+#define SCSI_SA_READ_CAPACITY16		0x10
+	u64		LogicalBlockAddress;			// set to 0
+	u32		AllocationLength;			// big endian
+	u8		PartialMediumIndicator;			// set to 0
+	u8		Control;
+}
+PACKED;
+
+struct TSCSIReadCapacity16Response
+{
+	u64		ReturnedLogicalBlockAddress;		// big endian
+	u32		BlockLengthInBytes;			// big endian
+	u8		Reserved[20];
+}
+PACKED;
+
 struct TSCSIRead10
 {
 	u8		OperationCode,
@@ -195,6 +216,19 @@ struct TSCSIWrite10
 }
 PACKED;
 
+struct TSCSIReadWrite16				// READ(16) and WRITE(16)
+{
+	u8		OperationCode,
+#define SCSI_OP_READ16		0x88
+#define SCSI_OP_WRITE16		0x8A
+			Flags;
+	u64		LogicalBlockAddress;			// big endian
+	u32		TransferLength;				// block count, big endian
+	u8		GroupNumber;
+	u8		Control;
+}
+PACKED;
+
 CNumberPool CUSBBulkOnlyMassStorageDevice::s_DeviceNumberPool (1);
 
 static const char FromUmsd[] = "umsd";
@@ -204,11 +238,23 @@ CUSBBulkOnlyMassStorageDevice::CUSBBulkOnlyMassStorageDevice (CUSBFunction *pFun
 	m_pEndpointIn (0),
 	m_pEndpointOut (0),
 	m_nCWBTag (0),
-	m_nBlockCount (0),
+	m_ullBlockCount (0),
 	m_ullOffset (0),
+	m_pAsyncFree (0),
+	m_pAsyncFirst (0),
+	m_pAsyncLast (0),
+	m_pAsyncActive (0),
+	m_AsyncStage (AsyncStageCBW),
+	m_bSyncActive (FALSE),
+	m_bAsyncFailed (FALSE),
 	m_pPartitionManager (0),
 	m_nDeviceNumber (0)
 {
+	for (unsigned i = 0; i < UMSD_MAX_ASYNC; i++)
+	{
+		m_AsyncCommand[i].pNext = m_pAsyncFree;
+		m_pAsyncFree = &m_AsyncCommand[i];
+	}
 }
 
 CUSBBulkOnlyMassStorageDevice::~CUSBBulkOnlyMassStorageDevice (void)
@@ -373,24 +419,42 @@ boolean CUSBBulkOnlyMassStorageDevice::Configure (void)
 	}
 
 	unsigned nBlockSize = le2be32 (SCSIReadCapacityResponse.BlockLengthInBytes);
-	if (nBlockSize != UMSD_BLOCK_SIZE)
+	m_ullBlockCount = le2be32 (SCSIReadCapacityResponse.ReturnedLogicalBlockAddress);
+	if (m_ullBlockCount == (u32) -1)
 	{
-		CLogger::Get ()->Write (FromUmsd, LogError, "Unsupported block size: %u", nBlockSize);
+		// disk size > 2TB
+		TSCSIReadCapacity16 SCSIReadCapacity16;
+		memset (&SCSIReadCapacity16, 0, sizeof SCSIReadCapacity16);
+		SCSIReadCapacity16.OperationCode	= SCSI_OP_SERVICE_ACTION_IN16;
+		SCSIReadCapacity16.ServiceAction	= SCSI_SA_READ_CAPACITY16;
+		SCSIReadCapacity16.AllocationLength	= le2be32 (sizeof (TSCSIReadCapacity16Response));
+		SCSIReadCapacity16.Control		= SCSI_CONTROL;
+
+		TSCSIReadCapacity16Response SCSIReadCapacity16Response;
+		if (Command (&SCSIReadCapacity16, sizeof SCSIReadCapacity16,
+			     &SCSIReadCapacity16Response, sizeof SCSIReadCapacity16Response,
+			     TRUE) != (int) sizeof SCSIReadCapacity16Response)
+		{
+			CLogger::Get ()->Write (FromUmsd, LogError, "Read capacity (16) failed");
 
-		return FALSE;
+			return FALSE;
+		}
+
+		nBlockSize = le2be32 (SCSIReadCapacity16Response.BlockLengthInBytes);
+		m_ullBlockCount = le2be64 (SCSIReadCapacity16Response.ReturnedLogicalBlockAddress);
 	}
 
-	m_nBlockCount = le2be32 (SCSIReadCapacityResponse.ReturnedLogicalBlockAddress);
-	if (m_nBlockCount == (u32) -1)
+	if (nBlockSize != UMSD_BLOCK_SIZE)
 	{
-		CLogger::Get ()->Write (FromUmsd, LogError, "Unsupported disk size > 2TB");
+		CLogger::Get ()->Write (FromUmsd, LogError, "Unsupported block size: %u", nBlockSize);
 
 		return FALSE;
 	}
 
-	m_nBlockCount++;
+	m_ullBlockCount++;
 
-	CLogger::Get ()->Write (FromUmsd, LogDebug, "Capacity is %u MByte", m_nBlockCount / (0x100000 / UMSD_BLOCK_SIZE));
+	CLogger::Get ()->Write (FromUmsd, LogDebug, "Capacity is %llu MByte",
+				m_ullBlockCount / (0x100000 / UMSD_BLOCK_SIZE));
 
 	unsigned nDeviceNumber = s_DeviceNumberPool.AllocateNumber (FALSE);
 	if (nDeviceNumber == CNumberPool::Invalid)
@@ -424,52 +488,116 @@ boolean CUSBBulkOnlyMassStorageDevice::Configure (void)
 
 int CUSBBulkOnlyMassStorageDevice::Read (void *pBuffer, size_t nCount)
 {
-	unsigned nTries = MAX_TRIES;
+	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
+	    || (nCount & UMSD_BLOCK_MASK) != 0
+	    || (m_ullOffset + nCount) >> UMSD_BLOCK_SHIFT > m_ullBlockCount)
+	{
+		return -1;
+	}
 
-	int nResult;
+	BeginSyncAccess ();
 
-	do
+	u8 *pBuffer8 = (u8 *) pBuffer;
+	u64 ullOffset = m_ullOffset;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
 	{
-		nResult = TryRead (pBuffer, nCount);
+		size_t nChunk = nRemaining < UMSD_MAX_TRANSFER ? nRemaining : UMSD_MAX_TRANSFER;
+
+		unsigned nTries = MAX_TRIES;
+
+		int nResult;
 
-		if (nResult != (int) nCount)
+		do
 		{
-			int nStatus = Reset ();
-			if (nStatus != 0)
+			nResult = TryRead (pBuffer8, ullOffset, nChunk);
+
+			if (nResult != (int) nChunk)
 			{
-				return nStatus;
+				int nStatus = Reset ();
+				if (nStatus != 0)
+				{
+					EndSyncAccess ();
+
+					return nStatus;
+				}
 			}
 		}
+		while (   nResult != (int) nChunk
+		       && --nTries > 0);
+
+		if (nResult != (int) nChunk)
+		{
+			EndSyncAccess ();
+
+			return nResult;
+		}
+
+		pBuffer8 += nChunk;
+		ullOffset += nChunk;
+		nRemaining -= nChunk;
 	}
-	while (   nResult != (int) nCount
-	       && --nTries > 0);
 
-	return nResult;
+	EndSyncAccess ();
+
+	return nCount;
 }
 
 int CUSBBulkOnlyMassStorageDevice::Write (const void *pBuffer, size_t nCount)
 {
-	unsigned nTries = MAX_TRIES;
+	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
+	    || (nCount & UMSD_BLOCK_MASK) != 0
+	    || (m_ullOffset + nCount) >> UMSD_BLOCK_SHIFT > m_ullBlockCount)
+	{
+		return -1;
+	}
 
-	int nResult;
+	BeginSyncAccess ();
 
-	do
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	u64 ullOffset = m_ullOffset;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
 	{
-		nResult = TryWrite (pBuffer, nCount);
+		size_t nChunk = nRemaining < UMSD_MAX_TRANSFER ? nRemaining : UMSD_MAX_TRANSFER;
 
-		if (nResult != (int) nCount)
+		unsigned nTries = MAX_TRIES;
+
+		int nResult;
+
+		do
 		{
-			int nStatus = Reset ();
-			if (nStatus != 0)
+			nResult = TryWrite (pBuffer8, ullOffset, nChunk);
+
+			if (nResult != (int) nChunk)
 			{
-				return nStatus;
+				int nStatus = Reset ();
+				if (nStatus != 0)
+				{
+					EndSyncAccess ();
+
+					return nStatus;
+				}
 			}
 		}
+		while (   nResult != (int) nChunk
+		       && --nTries > 0);
+
+		if (nResult != (int) nChunk)
+		{
+			EndSyncAccess ();
+
+			return nResult;
+		}
+
+		pBuffer8 += nChunk;
+		ullOffset += nChunk;
+		nRemaining -= nChunk;
 	}
-	while (   nResult != (int) nCount
-	       && --nTries > 0);
 
-	return nResult;
+	EndSyncAccess ();
+
+	return nCount;
 }
 
 u64 CUSBBulkOnlyMassStorageDevice::Seek (u64 ullOffset)
@@ -481,45 +609,43 @@ u64 CUSBBulkOnlyMassStorageDevice::Seek (u64 ullOffset)
 
 u64 CUSBBulkOnlyMassStorageDevice::GetSize (void) const
 {
-	assert (m_nBlockCount > 0);
-	assert (m_nBlockCount < (u32) -1);
+	assert (m_ullBlockCount > 0);
 
-	return (u64) m_nBlockCount << UMSD_BLOCK_SHIFT;
+	return m_ullBlockCount << UMSD_BLOCK_SHIFT;
 }
 
-unsigned CUSBBulkOnlyMassStorageDevice::GetCapacity (void) const
+u64 CUSBBulkOnlyMassStorageDevice::GetCapacity (void) const
 {
-	return m_nBlockCount;
+	return m_ullBlockCount;
 }
 
-int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, size_t nCount)
+int CUSBBulkOnlyMassStorageDevice::IOCtl (unsigned long ulCmd, void *pData)
 {
-	assert (pBuffer != 0);
-
-	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
-	    || m_ullOffset > UMSD_MAX_OFFSET)
+	switch (ulCmd)
 	{
-		return -1;
-	}
-	u32 nBlockAddress = (u32) (m_ullOffset >> UMSD_BLOCK_SHIFT);
+	case DEVICE_IOCTL_SUBMIT:
+		assert (pData != 0);
+		return SubmitRequest ((const TDeviceBlockRequest *) pData);
 
-	if ((nCount & UMSD_BLOCK_MASK) != 0)
-	{
+	default:
 		return -1;
 	}
-	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
+}
+
+int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, u64 ullOffset, size_t nCount)
+{
+	assert (pBuffer != 0);
+	assert ((ullOffset & UMSD_BLOCK_MASK) == 0);
+	assert ((nCount & UMSD_BLOCK_MASK) == 0);
+	assert (0 < nCount && nCount <= UMSD_MAX_TRANSFER);
 
-	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryRead %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
+	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryRead %llu/%p/%u", ullOffset >> UMSD_BLOCK_SHIFT, pBuffer, (unsigned) nCount);
 
-	TSCSIRead10 SCSIRead;
-	SCSIRead.OperationCode		= SCSI_OP_READ;
-	SCSIRead.Reserved1		= 0;
-	SCSIRead.LogicalBlockAddress	= le2be32 (nBlockAddress);
-	SCSIRead.Reserved2		= 0;
-	SCSIRead.TransferLength		= le2be16 (usTransferLength);
-	SCSIRead.Control		= SCSI_CONTROL;
+	u8 CmdBlk[16];
+	size_t nCmdBlkLen = SetupReadWrite (CmdBlk, FALSE, ullOffset >> UMSD_BLOCK_SHIFT,
+					    nCount >> UMSD_BLOCK_SHIFT);
 
-	if (Command (&SCSIRead, sizeof SCSIRead, pBuffer, nCount, TRUE) != (int) nCount)
+	if (Command (CmdBlk, nCmdBlkLen, pBuffer, nCount, TRUE) != (int) nCount)
 	{
 		CLogger::Get ()->Write (FromUmsd, LogError, "TryRead failed");
 
@@ -529,41 +655,71 @@ int CUSBBulkOnlyMassStorageDevice::TryRead (void *pBuffer, size_t nCount)
 	return nCount;
 }
 
-int CUSBBulkOnlyMassStorageDevice::TryWrite (const void *pBuffer, size_t nCount)
+int CUSBBulkOnlyMassStorageDevice::TryWrite (const void *pBuffer, u64 ullOffset, size_t nCount)
 {
 	assert (pBuffer != 0);
+	assert ((ullOffset & UMSD_BLOCK_MASK) == 0);
+	assert ((nCount & UMSD_BLOCK_MASK) == 0);
+	assert (0 < nCount && nCount <= UMSD_MAX_TRANSFER);
 
-	if (   (m_ullOffset & UMSD_BLOCK_MASK) != 0
-	    || m_ullOffset > UMSD_MAX_OFFSET)
-	{
-		return -1;
-	}
-	u32 nBlockAddress = (u32) (m_ullOffset >> UMSD_BLOCK_SHIFT);
+	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryWrite %llu/%p/%u", ullOffset >> UMSD_BLOCK_SHIFT, pBuffer, (unsigned) nCount);
+
+	u8 CmdBlk[16];
+	size_t nCmdBlkLen = SetupReadWrite (CmdBlk, TRUE, ullOffset >> UMSD_BLOCK_SHIFT,
+					    nCount >> UMSD_BLOCK_SHIFT);
 
-	if ((nCount & UMSD_BLOCK_MASK) != 0)
+	if (Command (CmdBlk, nCmdBlkLen, (void *) pBuffer, nCount, FALSE) < 0)
 	{
+		CLogger::Get ()->Write (FromUmsd, LogError, "TryWrite failed");
+
 		return -1;
 	}
-	u16 usTransferLength = (u16) (nCount >> UMSD_BLOCK_SHIFT);
 
-	//CLogger::Get ()->Write (FromUmsd, LogDebug, "TryWrite %u/0x%X/%u", nBlockAddress, (unsigned) pBuffer, (unsigned) usTransferLength);
+	return nCount;
+}
 
-	TSCSIWrite10 SCSIWrite;
-	SCSIWrite.OperationCode		= SCSI_OP_WRITE;
-	SCSIWrite.Flags			= SCSI_WRITE_FUA;
-	SCSIWrite.LogicalBlockAddress	= le2be32 (nBlockAddress);
-	SCSIWrite.Reserved		= 0;
-	SCSIWrite.TransferLength	= le2be16 (usTransferLength);
-	SCSIWrite.Control		= SCSI_CONTROL;
+size_t CUSBBulkOnlyMassStorageDevice::SetupReadWrite (u8 *pCmdBlk, boolean bWrite,
+						      u64 ullBlock, u32 nBlocks)
+{
+	assert (pCmdBlk != 0);
+	assert (nBlocks > 0);
 
-	if (Command (&SCSIWrite, sizeof SCSIWrite, (void *) pBuffer, nCount, FALSE) < 0)
+	if (   ullBlock + nBlocks <= 0x100000000ULL
+	    && nBlocks <= 0xFFFF)
 	{
-		CLogger::Get ()->Write (FromUmsd, LogError, "TryWrite failed");
+		if (!bWrite)
+		{
+			TSCSIRead10 *pSCSIRead = (TSCSIRead10 *) pCmdBlk;
+			pSCSIRead->OperationCode	= SCSI_OP_READ;
+			pSCSIRead->Reserved1		= 0;
+			pSCSIRead->LogicalBlockAddress	= le2be32 ((u32) ullBlock);
+			pSCSIRead->Reserved2		= 0;
+			pSCSIRead->TransferLength	= le2be16 ((u16) nBlocks);
+			pSCSIRead->Control		= SCSI_CONTROL;
+
+			return sizeof (TSCSIRead10);
+		}
 
-		return -1;
+		TSCSIWrite10 *pSCSIWrite = (TSCSIWrite10 *) pCmdBlk;
+		pSCSIWrite->OperationCode	= SCSI_OP_WRITE;
+		pSCSIWrite->Flags		= SCSI_WRITE_FUA;
+		pSCSIWrite->LogicalBlockAddress	= le2be32 ((u32) ullBlock);
+		pSCSIWrite->Reserved		= 0;
+		pSCSIWrite->TransferLength	= le2be16 ((u16) nBlocks);
+		pSCSIWrite->Control		= SCSI_CONTROL;
+
+		return sizeof (TSCSIWrite10);
 	}
 
-	return nCount;
+	TSCSIReadWrite16 *pSCSIReadWrite = (TSCSIReadWrite16 *) pCmdBlk;
+	pSCSIReadWrite->OperationCode		= bWrite ? SCSI_OP_WRITE16 : SCSI_OP_READ16;
+	pSCSIReadWrite->Flags			= bWrite ? SCSI_WRITE_FUA : 0;
+	pSCSIReadWrite->LogicalBlockAddress	= le2be64 (ullBlock);
+	pSCSIReadWrite->TransferLength		= le2be32 (nBlocks);
+	pSCSIReadWrite->GroupNumber		= 0;
+	pSCSIReadWrite->Control			= SCSI_CONTROL;
+
+	return sizeof (TSCSIReadWrite16);
 }
 
 int CUSBBulkOnlyMassStorageDevice::Command (void *pCmdBlk, size_t nCmdBlkLen,
@@ -732,3 +888,366 @@ int CUSBBulkOnlyMassStorageDevice::Reset (void)
 
 	return 0;
 }
+
+int CUSBBulkOnlyMassStorageDevice::SubmitRequest (const TDeviceBlockRequest *pRequest)
+{
+	assert (pRequest != 0);
+	assert (pRequest->pBuffer != 0);
+	assert (pRequest->pCompletionRoutine != 0);
+
+	if (   (pRequest->ullOffset & UMSD_BLOCK_MASK) != 0
+	    || (pRequest->nCount & UMSD_BLOCK_MASK) != 0
+	    || pRequest->nCount == 0
+	    || pRequest->nCount > 0x7FFFFFFF
+	    || (pRequest->ullOffset + pRequest->nCount) >> UMSD_BLOCK_SHIFT > m_ullBlockCount)
+	{
+		return -1;
+	}
+
+	m_SpinLock.Acquire ();
+
+	TAsyncCommand *pCommand = m_pAsyncFree;
+	if (   m_bAsyncFailed			// synchronous access does the recovery
+	    || pCommand == 0)
+	{
+		m_SpinLock.Release ();
+
+		return -1;
+	}
+
+	m_pAsyncFree = pCommand->pNext;
+
+	m_SpinLock.Release ();
+
+	pCommand->Request = *pRequest;
+	pCommand->pDMABuffer = 0;
+	pCommand->pNext = 0;
+
+	if (!IS_CACHE_ALIGNED (pRequest->pBuffer, pRequest->nCount))
+	{
+		pCommand->pDMABuffer = new (HEAP_DMA30) u8[pRequest->nCount];
+		if (pCommand->pDMABuffer == 0)
+		{
+			m_SpinLock.Acquire ();
+			pCommand->pNext = m_pAsyncFree;
+			m_pAsyncFree = pCommand;
+			m_SpinLock.Release ();
+
+			return -1;
+		}
+
+		if (pRequest->bWrite)
+		{
+			memcpy (pCommand->pDMABuffer, pRequest->pBuffer, pRequest->nCount);
+		}
+	}
+
+	m_SpinLock.Acquire ();
+
+	if (m_pAsyncLast == 0)
+	{
+		m_pAsyncFirst = pCommand;
+	}
+	else
+	{
+		m_pAsyncLast->pNext = pCommand;
+	}
+	m_pAsyncLast = pCommand;
+
+	m_SpinLock.Release ();
+
+	StartAsync ();
+
+	return 0;
+}
+
+void CUSBBulkOnlyMassStorageDevice::StartAsync (void)
+{
+	m_SpinLock.Acquire ();
+
+	TAsyncCommand *pCommand = m_pAsyncFirst;
+	if (   m_pAsyncActive != 0
+	    || m_bSyncActive
+	    || pCommand == 0)
+	{
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	m_pAsyncFirst = pCommand->pNext;
+	if (m_pAsyncFirst == 0)
+	{
+		m_pAsyncLast = 0;
+	}
+
+	// the active command is driven by the completion routine only
+	m_pAsyncActive = pCommand;
+
+	m_SpinLock.Release ();
+
+	pCommand->nDone = 0;
+
+	if (!StartCommand ())
+	{
+		CompleteAsync (-1);
+	}
+}
+
+boolean CUSBBulkOnlyMassStorageDevice::StartCommand (void)
+{
+	TAsyncCommand *pCommand = m_pAsyncActive;
+	assert (pCommand != 0);
+
+	const TDeviceBlockRequest *pRequest = &pCommand->Request;
+	assert (pCommand->nDone < pRequest->nCount);
+
+	pCommand->nLength = pRequest->nCount - pCommand->nDone;
+	if (pCommand->nLength > UMSD_MAX_TRANSFER)
+	{
+		pCommand->nLength = UMSD_MAX_TRANSFER;
+	}
+
+	TCBW *pCBW = (TCBW *) m_CBWBuffer;
+	memset (pCBW, 0, sizeof *pCBW);
+
+	pCBW->dCWBSignature	     = CBWSIGNATURE;
+	pCBW->dCWBTag		     = ++m_nCWBTag;
+	pCBW->dCBWDataTransferLength = pCommand->nLength;
+	pCBW->bmCBWFlags	     = pRequest->bWrite ? 0 : CBWFLAGS_DATA_IN;
+	pCBW->bCBWLUN		     = CBWLUN;
+	pCBW->bCBWCBLength	     = (u8) SetupReadWrite (pCBW->CBWCB, pRequest->bWrite,
+							    (pRequest->ullOffset + pCommand->nDone)
+								>> UMSD_BLOCK_SHIFT,
+							    pCommand->nLength >> UMSD_BLOCK_SHIFT);
+
+	return StartStage (AsyncStageCBW);
+}
+
+boolean CUSBBulkOnlyMassStorageDevice::StartStage (TAsyncStage Stage)
+{
+	TAsyncCommand *pCommand = m_pAsyncActive;
+	assert (pCommand != 0);
+
+	m_AsyncStage = Stage;
+
+	CUSBEndpoint *pEndpoint;
+	void *pBuffer;
+	u32 nLength;
+
+	switch (Stage)
+	{
+	case AsyncStageCBW:
+		pEndpoint = m_pEndpointOut;
+		pBuffer = m_CBWBuffer;
+		nLength = sizeof (TCBW);
+		break;
+
+	case AsyncStageData:
+		pEndpoint = pCommand->Request.bWrite ? m_pEndpointOut : m_pEndpointIn;
+		pBuffer =   (pCommand->pDMABuffer != 0 ? pCommand->pDMABuffer
+						       : (u8 *) pCommand->Request.pBuffer)
+			  + pCommand->nDone;
+		nLength = pCommand->nLength;
+		break;
+
+	case AsyncStageCSW:
+		pEndpoint = m_pEndpointIn;
+		pBuffer = m_CSWBuffer;
+		nLength = sizeof (TCSW);
+		break;
+
+	default:
+		assert (0);
+		return FALSE;
+	}
+
+	assert (pEndpoint != 0);
+	CUSBRequest *pURB = new CUSBRequest (pEndpoint, pBuffer, nLength);
+	assert (pURB != 0);
+	pURB->SetCompletionRoutine (AsyncCompletionStub, 0, this);
+
+	return GetHost ()->SubmitAsyncRequest (pURB);
+}
+
+void CUSBBulkOnlyMassStorageDevice::CompleteAsync (int nResult)
+{
+	TAsyncCommand *pCommand = m_pAsyncActive;
+	assert (pCommand != 0);
+
+	if (pCommand->pDMABuffer != 0)
+	{
+		if (   nResult >= 0
+		    && !pCommand->Request.bWrite)
+		{
+			memcpy (pCommand->Request.pBuffer, pCommand->pDMABuffer,
+				pCommand->Request.nCount);
+		}
+
+		delete [] pCommand->pDMABuffer;
+		pCommand->pDMABuffer = 0;
+	}
+
+	TDeviceCompletionRoutine *pRoutine = pCommand->Request.pCompletionRoutine;
+	void *pParam = pCommand->Request.pParam;
+
+	m_SpinLock.Acquire ();
+
+	m_pAsyncActive = 0;
+
+	pCommand->pNext = m_pAsyncFree;
+	m_pAsyncFree = pCommand;
+
+	// the device needs a reset recovery, fail the waiting commands too
+	TAsyncCommand *pFailed = 0;
+	if (nResult < 0)
+	{
+		m_bAsyncFailed = TRUE;
+
+		pFailed = m_pAsyncFirst;
+		m_pAsyncFirst = 0;
+		m_pAsyncLast = 0;
+	}
+
+	m_SpinLock.Release ();
+
+	assert (pRoutine != 0);
+	(*pRoutine) (nResult, pParam);
+
+	while (pFailed != 0)
+	{
+		TAsyncCommand *pNext = pFailed->pNext;
+
+		delete [] pFailed->pDMABuffer;
+		pFailed->pDMABuffer = 0;
+
+		pRoutine = pFailed->Request.pCompletionRoutine;
+		pParam = pFailed->Request.pParam;
+
+		m_SpinLock.Acquire ();
+		pFailed->pNext = m_pAsyncFree;
+		m_pAsyncFree = pFailed;
+		m_SpinLock.Release ();
+
+		assert (pRoutine != 0);
+		(*pRoutine) (-1, pParam);
+
+		pFailed = pNext;
+	}
+
+	StartAsync ();
+}
+
+void CUSBBulkOnlyMassStorageDevice::AsyncCompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+
+	boolean bOK = pURB->GetStatus () != 0;
+	u32 nResultLength = pURB->GetResultLength ();
+
+	delete pURB;
+
+	TAsyncCommand *pCommand = m_pAsyncActive;
+	assert (pCommand != 0);
+
+	switch (m_AsyncStage)
+	{
+	case AsyncStageCBW:
+		if (   bOK
+		    && StartStage (AsyncStageData))
+		{
+			return;
+		}
+		break;
+
+	case AsyncStageData:
+		if (   bOK
+		    && nResultLength == pCommand->nLength
+		    && StartStage (AsyncStageCSW))
+		{
+			return;
+		}
+		break;
+
+	case AsyncStageCSW: {
+		TCSW *pCSW = (TCSW *) m_CSWBuffer;
+		if (   !bOK
+		    || nResultLength != sizeof (TCSW)
+		    || pCSW->dCSWSignature != CSWSIGNATURE
+		    || pCSW->dCSWTag != m_nCWBTag
+		    || pCSW->bCSWStatus != CSWSTATUS_PASSED
+		    || pCSW->dCSWDataResidue != 0)
+		{
+			break;
+		}
+
+		pCommand->nDone += pCommand->nLength;
+		if (pCommand->nDone < pCommand->Request.nCount)
+		{
+			if (StartCommand ())
+			{
+				return;
+			}
+
+			break;
+		}
+
+		CompleteAsync ((int) pCommand->Request.nCount);
+		} return;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	CLogger::Get ()->Write (FromUmsd, LogError, "Queued command failed (stage %u)",
+				(unsigned) m_AsyncStage);
+
+	CompleteAsync (-1);
+}
+
+void CUSBBulkOnlyMassStorageDevice::AsyncCompletionStub (CUSBRequest *pURB, void *pParam,
+							 void *pContext)
+{
+	CUSBBulkOnlyMassStorageDevice *pThis = (CUSBBulkOnlyMassStorageDevice *) pContext;
+	assert (pThis != 0);
+
+	pThis->AsyncCompletionRoutine (pURB);
+}
+
+void CUSBBulkOnlyMassStorageDevice::BeginSyncAccess (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (!m_bSyncActive);
+	m_bSyncActive = TRUE;			// do not start further queued commands
+
+	while (m_pAsyncActive != 0)		// completed from interrupt
+	{
+		m_SpinLock.Release ();
+
+		m_SpinLock.Acquire ();
+	}
+
+	boolean bAsyncFailed = m_bAsyncFailed;
+	m_bAsyncFailed = FALSE;
+
+	m_SpinLock.Release ();
+
+	if (bAsyncFailed)
+	{
+		Reset ();
+	}
+}
+
+void CUSBBulkOnlyMassStorageDevice::EndSyncAccess (void)
+{
+	m_SpinLock.Acquire ();
+
+	assert (m_bSyncActive);
+	m_bSyncActive = FALSE;
+
+	m_SpinLock.Release ();
+
+	StartAsync ();
+}
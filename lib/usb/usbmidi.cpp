@@ -24,6 +24,8 @@
 
 #include <circle/usb/usbmidi.h>
 #include <circle/devicenameservice.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
 #include <circle/logger.h>
 #include <circle/debug.h>
 #include <circle/util.h>
@@ -44,6 +46,12 @@ CUSBMIDIDevice::CUSBMIDIDevice (void)
 :	m_pPacketHandler (0),
 	m_pSendEventsHandler (0),
 	m_bAllSoundOff (FALSE),
+	m_nPollingIntervalMs (10),
+	m_bEventQueueEnabled (FALSE),
+	m_pEventQueue (0),
+	m_nEventIn (0),
+	m_nEventOut (0),
+	m_nLostEvents (0),
 	m_nDeviceNumber (s_DeviceNumberPool.AllocateNumber (TRUE, FromMIDI))
 {
 	CDeviceNameService::Get ()->AddDevice (DevicePrefix, m_nDeviceNumber, this, FALSE);
@@ -54,6 +62,11 @@ CUSBMIDIDevice::~CUSBMIDIDevice (void)
 	CDeviceNameService::Get ()->RemoveDevice (DevicePrefix, m_nDeviceNumber, FALSE);
 
 	s_DeviceNumberPool.FreeNumber (m_nDeviceNumber);
+
+	m_bEventQueueEnabled = FALSE;
+
+	delete [] m_pEventQueue;
+	m_pEventQueue = 0;
 }
 
 static void ProxyHandler (unsigned nCable, u8 *pPacket, unsigned nLength,
@@ -78,6 +91,63 @@ void CUSBMIDIDevice::RegisterPacketHandler (TMIDIPacketHandlerEx *pPacketHandler
 	assert (m_pPacketHandler != 0);
 }
 
+void CUSBMIDIDevice::EnableEventQueue (void)
+{
+	if (m_pEventQueue == 0)
+	{
+		m_pEventQueue = new TMIDIEvent[USB_MIDI_EVENT_QUEUE_SIZE];
+		assert (m_pEventQueue != 0);
+	}
+
+	DataMemBarrier ();
+
+	m_bEventQueueEnabled = TRUE;
+}
+
+unsigned CUSBMIDIDevice::ReadEvents (TMIDIEvent *pEvents, unsigned nMaxEvents)
+{
+	assert (pEvents != 0);
+
+	unsigned nOut = m_nEventOut;
+	unsigned nEvents = m_nEventIn - nOut;
+	if (nEvents == 0)
+	{
+		return 0;
+	}
+
+	if (nEvents > nMaxEvents)
+	{
+		nEvents = nMaxEvents;
+	}
+
+	// the events have been written before the index in CallPacketHandler()
+	DataMemBarrier ();
+
+	assert (m_pEventQueue != 0);
+	for (unsigned i = 0; i < nEvents; i++)
+	{
+		pEvents[i] = m_pEventQueue[(nOut + i) & (USB_MIDI_EVENT_QUEUE_SIZE-1)];
+	}
+
+	// the events must have been read, before they can be overwritten
+	DataMemBarrier ();
+
+	m_nEventOut = nOut + nEvents;
+
+	return nEvents;
+}
+
+unsigned CUSBMIDIDevice::GetLostEvents (void) const
+{
+	return m_nLostEvents;
+}
+
+void CUSBMIDIDevice::SetPollingInterval (unsigned nMilliseconds)
+{
+	assert (nMilliseconds > 0);
+	m_nPollingIntervalMs = nMilliseconds;
+}
+
 boolean CUSBMIDIDevice::SendEventPackets (const u8 *pData, unsigned nLength)
 {
 	if (!m_pSendEventsHandler)
@@ -257,6 +327,10 @@ boolean CUSBMIDIDevice::CallPacketHandler (u8 *pData, unsigned nLength)
 
 	boolean bResult = FALSE;
 
+	// all packets of a request get the time of its completion
+	u64 ullTimestamp = m_bEventQueueEnabled ? CTimer::GetClockTicks64 () : 0;
+	unsigned nEventIn = m_nEventIn;
+
 	u8 *pEnd = pData + nLength;
 	for (u8 *pPacket = pData; pPacket < pEnd; pPacket += EventPacketSize)
 	{
@@ -273,10 +347,37 @@ boolean CUSBMIDIDevice::CallPacketHandler (u8 *pData, unsigned nLength)
 						     m_nDeviceNumber, m_pPacketHandlerParam);
 			}
 
+			if (m_bEventQueueEnabled)
+			{
+				if (nEventIn - m_nEventOut < USB_MIDI_EVENT_QUEUE_SIZE)
+				{
+					assert (m_pEventQueue != 0);
+					TMIDIEvent *pEvent =
+						&m_pEventQueue[nEventIn & (USB_MIDI_EVENT_QUEUE_SIZE-1)];
+
+					pEvent->ullTimestamp = ullTimestamp;
+					memcpy (pEvent->Packet, pPacket, EventPacketSize);
+
+					nEventIn++;
+				}
+				else
+				{
+					m_nLostEvents++;
+				}
+			}
+
 			bResult = TRUE;
 		}
 	}
 
+	if (nEventIn != m_nEventIn)
+	{
+		// the reader must not see the new index before the events
+		DataMemBarrier ();
+
+		m_nEventIn = nEventIn;
+	}
+
 	return bResult;
 }
 
@@ -293,3 +394,8 @@ boolean CUSBMIDIDevice::GetAllSoundOffOnUSBError (void) const
 {
 	return m_bAllSoundOff;
 }
+
+unsigned CUSBMIDIDevice::GetPollingInterval (void) const
+{
+	return m_nPollingIntervalMs;
+}
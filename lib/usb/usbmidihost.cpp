@@ -249,7 +249,8 @@ void CUSBMIDIHostDevice::CompletionRoutine (CUSBRequest *pURB)
 	else
 	{
 		assert (m_hTimer == 0);
-		m_hTimer = CTimer::Get ()->StartKernelTimer (MSEC2HZ (10), TimerStub, 0, this);
+		m_hTimer = CTimer::Get ()->StartKernelTimer (
+				MSEC2HZ (m_pInterface->GetPollingInterval ()), TimerStub, 0, this);
 		assert (m_hTimer != 0);
 	}
 }
@@ -162,7 +162,8 @@ void CUSBMouseDevice::ReportHandler (const u8 *pReport, unsigned nReportSize)
 				nButtons |= MOUSE_BUTTON_SIDE2;
 			}
 
-			m_pMouseDevice->ReportHandler (nButtons, xMove, yMove, wheelMove);
+			m_pMouseDevice->ReportHandler (nButtons, xMove, yMove, wheelMove,
+						       GetReportTimestamp ());
 		}
 	}
 }
@@ -0,0 +1,252 @@
+//
+// usbpipe.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/usb/usbpipe.h>
+#include <circle/synchronize.h>
+#include <circle/util.h>
+#include <assert.h>
+
+CUSBPipe::CUSBPipe (CUSBHostController *pHost, CUSBEndpoint *pEndpoint,
+		    unsigned nBufferSize, unsigned nBuffers,
+		    TCompletionHandler *pHandler, void *pParam)
+:	m_pHost (pHost),
+	m_pEndpoint (pEndpoint),
+	m_nBufferSize (nBufferSize),
+	m_nBuffers (nBuffers),
+	m_pHandler (pHandler),
+	m_pParam (pParam),
+	m_bCoalesce (FALSE),
+	m_nTail (0),
+	m_nActive (0),
+	m_nQueued (0),
+	m_bStarted (FALSE),
+	m_bFailed (FALSE)
+{
+	assert (m_pHost != 0);
+	assert (m_pEndpoint != 0);
+	assert (   m_pEndpoint->GetType () == EndpointTypeBulk
+		|| m_pEndpoint->GetType () == EndpointTypeInterrupt);
+	assert (m_nBufferSize > 0);
+	assert (m_nBufferSize % DATA_CACHE_LINE_LENGTH_MAX == 0);
+	assert (1 <= m_nBuffers && m_nBuffers <= USB_PIPE_MAX_BUFFERS);
+
+	m_bDirectionIn = m_pEndpoint->IsDirectionIn ();
+	assert (!m_bDirectionIn || m_pHandler != 0);
+
+	m_nMaxActive = m_nBuffers < USB_PIPE_MAX_ACTIVE ? m_nBuffers : USB_PIPE_MAX_ACTIVE;
+
+	// heap blocks are aligned to the cache line length, so the buffers can be used for DMA
+	m_pBuffer = new u8[m_nBuffers * m_nBufferSize];
+	assert (m_pBuffer != 0);
+}
+
+CUSBPipe::~CUSBPipe (void)
+{
+	// an active request cannot be cancelled
+	assert (m_nActive == 0);
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+
+	m_pHandler = 0;
+	m_pEndpoint = 0;
+	m_pHost = 0;
+}
+
+void CUSBPipe::Start (void)
+{
+	EnterCritical ();
+
+	m_bFailed = FALSE;
+
+	if (m_bDirectionIn)
+	{
+		m_bStarted = TRUE;
+	}
+
+	SubmitRequests ();
+
+	LeaveCritical ();
+}
+
+void CUSBPipe::Stop (void)
+{
+	EnterCritical ();
+
+	m_bStarted = FALSE;
+
+	LeaveCritical ();
+}
+
+void CUSBPipe::EnableCoalescing (void)
+{
+	assert (!m_bDirectionIn);
+
+	m_bCoalesce = TRUE;
+}
+
+boolean CUSBPipe::Submit (const void *pData, unsigned nLength)
+{
+	assert (!m_bDirectionIn);
+	assert (pData != 0);
+	assert (0 < nLength && nLength <= m_nBufferSize);
+
+	EnterCritical ();
+
+	if (m_bFailed)
+	{
+		LeaveCritical ();
+
+		return FALSE;
+	}
+
+	// a queued buffer has not been submitted yet, so it can still grow
+	if (   m_bCoalesce
+	    && m_nQueued > 0)
+	{
+		unsigned nIndex = (m_nTail + m_nActive + m_nQueued - 1) % m_nBuffers;
+		if (m_nLength[nIndex] + nLength <= m_nBufferSize)
+		{
+			assert (m_pBuffer != 0);
+			memcpy (m_pBuffer + nIndex * m_nBufferSize + m_nLength[nIndex], pData, nLength);
+			m_nLength[nIndex] += nLength;
+
+			LeaveCritical ();
+
+			return TRUE;
+		}
+	}
+
+	if (m_nActive + m_nQueued == m_nBuffers)
+	{
+		LeaveCritical ();
+
+		return FALSE;
+	}
+
+	unsigned nIndex = (m_nTail + m_nActive + m_nQueued) % m_nBuffers;
+
+	assert (m_pBuffer != 0);
+	memcpy (m_pBuffer + nIndex * m_nBufferSize, pData, nLength);
+	m_nLength[nIndex] = nLength;
+
+	m_nQueued++;
+
+	SubmitRequests ();
+
+	LeaveCritical ();
+
+	return TRUE;
+}
+
+boolean CUSBPipe::IsIdle (void) const
+{
+	return m_nActive == 0 && m_nQueued == 0;
+}
+
+boolean CUSBPipe::IsFailed (void) const
+{
+	return m_bFailed;
+}
+
+void CUSBPipe::SubmitRequests (void)
+{
+	while (   !m_bFailed
+	       && m_nActive < m_nMaxActive
+	       && (m_bDirectionIn ? m_bStarted : m_nQueued > 0))
+	{
+		unsigned nIndex = (m_nTail + m_nActive) % m_nBuffers;
+
+		assert (m_pEndpoint != 0);
+		assert (m_pBuffer != 0);
+		CUSBRequest *pURB = new CUSBRequest (m_pEndpoint, m_pBuffer + nIndex * m_nBufferSize,
+						     m_bDirectionIn ? m_nBufferSize
+								    : m_nLength[nIndex]);
+		assert (pURB != 0);
+
+		pURB->SetCompletionRoutine (CompletionStub, 0, this);
+
+		assert (m_pHost != 0);
+		if (!m_pHost->SubmitAsyncRequest (pURB))
+		{
+			delete pURB;
+
+			m_bFailed = TRUE;
+			m_nQueued = 0;
+
+			break;
+		}
+
+		m_nActive++;
+
+		if (!m_bDirectionIn)
+		{
+			assert (m_nQueued > 0);
+			m_nQueued--;
+		}
+	}
+}
+
+void CUSBPipe::CompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+	assert (m_nActive > 0);
+
+	// requests on an endpoint complete in the order of submission
+	const u8 *pBuffer = m_pBuffer + m_nTail * m_nBufferSize;
+	assert (pURB->GetBuffer () == pBuffer);
+
+	int nResult = -1;
+	if (pURB->GetStatus () != 0)
+	{
+		nResult = (int) pURB->GetResultLength ();
+		assert ((unsigned) nResult <= m_nBufferSize);
+	}
+
+	delete pURB;
+
+	if (nResult < 0)
+	{
+		m_bFailed = TRUE;
+		m_nQueued = 0;
+	}
+
+	// the buffer is still accounted as active, so it is not reused by the handler
+	if (m_pHandler != 0)
+	{
+		(*m_pHandler) (nResult, pBuffer, m_pParam);
+	}
+
+	if (++m_nTail == m_nBuffers)
+	{
+		m_nTail = 0;
+	}
+
+	m_nActive--;
+
+	SubmitRequests ();
+}
+
+void CUSBPipe::CompletionStub (CUSBRequest *pURB, void *pParam, void *pContext)
+{
+	CUSBPipe *pThis = (CUSBPipe *) pContext;
+	assert (pThis != 0);
+
+	pThis->CompletionRoutine (pURB);
+}
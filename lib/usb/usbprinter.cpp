@@ -28,11 +28,15 @@ CNumberPool CUSBPrinterDevice::s_DeviceNumberPool (1);
 static const char FromPrinter[] = "uprn";
 static const char DevicePrefix[] = "uprn";
 
+#define PRINTER_BUFFER_SIZE	4096
+#define PRINTER_BUFFERS		4
+
 CUSBPrinterDevice::CUSBPrinterDevice (CUSBFunction *pFunction)
 :	CUSBFunction (pFunction),
 	m_Protocol (USBPrinterProtocolUnknown),
 	m_pEndpointIn (0),
 	m_pEndpointOut (0),
+	m_pPipeOut (0),
 	m_nDeviceNumber (0)
 {
 }
@@ -46,6 +50,9 @@ CUSBPrinterDevice::~CUSBPrinterDevice (void)
 		s_DeviceNumberPool.FreeNumber (m_nDeviceNumber);
 	}
 
+	delete m_pPipeOut;
+	m_pPipeOut = 0;
+
 	delete m_pEndpointOut;
 	m_pEndpointOut =  0;
 	
@@ -123,6 +130,10 @@ boolean CUSBPrinterDevice::Configure (void)
 		return FALSE;
 	}
 
+	assert (m_pPipeOut == 0);
+	m_pPipeOut = new CUSBPipe (GetHost (), m_pEndpointOut, PRINTER_BUFFER_SIZE, PRINTER_BUFFERS);
+	assert (m_pPipeOut != 0);
+
 	assert (m_nDeviceNumber == 0);
 	m_nDeviceNumber = s_DeviceNumberPool.AllocateNumber (TRUE, FromPrinter);
 
@@ -135,13 +146,27 @@ int CUSBPrinterDevice::Write (const void *pBuffer, size_t nCount)
 {
 	assert (pBuffer != 0);
 	assert (nCount > 0);
-	
-	CUSBHostController *pHost = GetHost ();
-	assert (pHost != 0);
 
-	if (pHost->Transfer (m_pEndpointOut, (void *) pBuffer, nCount) < 0)
+	// the data is queued, so that the printer is kept busy, while the caller continues
+	assert (m_pPipeOut != 0);
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
 	{
-		return -1;
+		unsigned nChunk = nRemaining < PRINTER_BUFFER_SIZE ? nRemaining : PRINTER_BUFFER_SIZE;
+
+		while (!m_pPipeOut->Submit (pBuffer8, nChunk))
+		{
+			if (m_pPipeOut->IsFailed ())
+			{
+				m_pPipeOut->Start ();		// clear error for next call
+
+				return -1;
+			}
+		}
+
+		pBuffer8 += nChunk;
+		nRemaining -= nChunk;
 	}
 
 	return nCount;
@@ -18,6 +18,8 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/usb/usbrequest.h>
+#include <circle/usb/usbdevice.h>
+#include <circle/tracer.h>
 #include <assert.h>
 
 CUSBRequest::CUSBRequest (CUSBEndpoint *pEndpoint, void *pBuffer, u32 nBufLen, TSetupData *pSetupData)
@@ -142,7 +144,11 @@ void CUSBRequest::SetCompletionRoutine (TURBCompletionRoutine *pRoutine, void *p
 void CUSBRequest::CallCompletionRoutine (void)
 {
 	assert (m_pCompletionRoutine != 0);
-	
+
+	assert (m_pEndpoint != 0);
+	TRACE_SYSTEM_EVENT (TRACER_EVENT_USB_COMPLETE, m_pEndpoint->GetDevice ()->GetAddress (),
+			    m_pEndpoint->GetNumber (), m_bStatus, m_nResultLen);
+
 	(*m_pCompletionRoutine) (this, m_pCompletionParam, m_pCompletionContext);
 }
 
@@ -29,6 +29,8 @@ static const char DevicePrefix[] = "utty";
 CUSBSerialDevice::CUSBSerialDevice (void)
 :	m_pWriteHandler (nullptr),
 	m_pReadHandler (nullptr),
+	m_pGetReadDataHandler (nullptr),
+	m_pReleaseReadDataHandler (nullptr),
 	m_pSetBaudRateHandler (nullptr),
 	m_pSetLinePropertiesHandler (nullptr),
 	m_nOptions (0),
@@ -44,6 +46,8 @@ CUSBSerialDevice::~CUSBSerialDevice (void)
 
 	m_pWriteHandler = nullptr;
 	m_pReadHandler = nullptr;
+	m_pGetReadDataHandler = nullptr;
+	m_pReleaseReadDataHandler = nullptr;
 	m_pSetBaudRateHandler = nullptr;
 	m_pSetLinePropertiesHandler = nullptr;
 }
@@ -82,6 +86,22 @@ int CUSBSerialDevice::Read (void *pBuffer, size_t nCount)
 	return (*m_pReadHandler) (pBuffer, nCount, m_pReadParam);
 }
 
+int CUSBSerialDevice::GetReadData (const void **ppData)
+{
+	if (!m_pGetReadDataHandler)
+	{
+		return -1;
+	}
+
+	return (*m_pGetReadDataHandler) (ppData, m_pReadDataParam);
+}
+
+void CUSBSerialDevice::ReleaseReadData (size_t nCount)
+{
+	assert (m_pReleaseReadDataHandler);
+	(*m_pReleaseReadDataHandler) (nCount, m_pReadDataParam);
+}
+
 boolean CUSBSerialDevice::SetBaudRate (unsigned nBaudRate)
 {
 	if (!m_pSetBaudRateHandler)
@@ -133,6 +153,21 @@ void CUSBSerialDevice::RegisterReadHandler (TReadHandler *pHandler, void *pParam
 	assert (m_pReadHandler);
 }
 
+void CUSBSerialDevice::RegisterReadDataHandlers (TGetReadDataHandler *pGetHandler,
+						 TReleaseReadDataHandler *pReleaseHandler,
+						 void *pParam)
+{
+	m_pReadDataParam = pParam;
+
+	assert (!m_pGetReadDataHandler);
+	m_pGetReadDataHandler = pGetHandler;
+	assert (m_pGetReadDataHandler);
+
+	assert (!m_pReleaseReadDataHandler);
+	m_pReleaseReadDataHandler = pReleaseHandler;
+	assert (m_pReleaseReadDataHandler);
+}
+
 void CUSBSerialDevice::RegisterSetBaudRateHandler (TSetBaudRateHandler *pHandler, void *pParam)
 {
 	m_pSetBaudRateParam = pParam;
@@ -37,11 +37,21 @@ CUSBSerialHostDevice::CUSBSerialHostDevice (CUSBFunction *pFunction, size_t nRea
 	m_nReadHeaderBytes (nReadHeaderBytes),
 	m_pEndpointIn (0),
 	m_pEndpointOut (0),
-	m_pBufferIn (0),
+	m_nMaxPacketSizeIn (0),
 	m_nBufferInSize (0),
-	m_nBufferInValid (0),
-	m_nBufferInPtr (0),
-	m_bInRequestActive (FALSE)
+	m_pRxRing (0),
+	m_nRxIn (0),
+	m_nRxOut (0),
+	m_nRxOverruns (0),
+	m_pPipeOut (0),
+#if RASPPI <= 3
+	m_pBufferIn (0),
+	m_bInRequestActive (FALSE),
+	m_bWritePending (FALSE)
+#else
+	m_pPipeIn (0),
+	m_bPipeInStopped (FALSE)
+#endif
 {
 }
 
@@ -50,15 +60,40 @@ CUSBSerialHostDevice::~CUSBSerialHostDevice (void)
 	delete m_pInterface;
 	m_pInterface = 0;
 
+	// A request, which is still active on the removed device, does not complete any more.
+	// The pipe is left allocated then, because it cannot be cancelled.
+#if RASPPI >= 4
+	if (m_pPipeIn != 0)
+	{
+		m_pPipeIn->Stop ();
+
+		if (m_pPipeIn->IsIdle ())
+		{
+			delete m_pPipeIn;
+		}
+
+		m_pPipeIn = 0;
+	}
+#else
+	delete [] m_pBufferIn;
+	m_pBufferIn = 0;
+#endif
+
+	if (   m_pPipeOut != 0
+	    && m_pPipeOut->IsIdle ())
+	{
+		delete m_pPipeOut;
+	}
+	m_pPipeOut = 0;
+
 	delete m_pEndpointOut;
 	m_pEndpointOut =  0;
 	
 	delete m_pEndpointIn;
 	m_pEndpointIn = 0;
 
-	delete [] m_pBufferIn;
-	m_pBufferIn = 0;
-	m_nBufferInSize = 0;
+	delete [] m_pRxRing;
+	m_pRxRing = 0;
 }
 
 boolean CUSBSerialHostDevice::Configure (void)
@@ -101,9 +136,15 @@ boolean CUSBSerialHostDevice::Configure (void)
 		return FALSE;
 	}
 
-	m_nBufferInSize = m_pEndpointIn->GetMaxPacketSize ();
-	m_pBufferIn = new u8[m_nBufferInSize];
-	assert (m_pBufferIn != 0);
+	m_nMaxPacketSizeIn = m_pEndpointIn->GetMaxPacketSize ();
+	assert (m_nMaxPacketSizeIn > 0);
+
+	m_nBufferInSize = USB_SERIAL_RX_BUFFER_SIZE;
+	if (m_nBufferInSize < m_nMaxPacketSizeIn)
+	{
+		m_nBufferInSize = m_nMaxPacketSizeIn;
+	}
+	assert (m_nBufferInSize % m_nMaxPacketSizeIn == 0);
 
 	if (!CUSBFunction::Configure ())
 	{
@@ -112,6 +153,28 @@ boolean CUSBSerialHostDevice::Configure (void)
 		return FALSE;
 	}
 
+	m_pRxRing = new u8[USB_SERIAL_RX_RING_SIZE];
+	assert (m_pRxRing != 0);
+
+	m_pPipeOut = new CUSBPipe (GetHost (), m_pEndpointOut,
+				   USB_SERIAL_TX_BUFFER_SIZE, USB_SERIAL_TX_BUFFERS);
+	assert (m_pPipeOut != 0);
+
+	m_pPipeOut->EnableCoalescing ();
+
+#if RASPPI <= 3
+	// heap blocks are aligned to the cache line length, so the buffer can be used for DMA
+	m_pBufferIn = new u8[m_nBufferInSize];
+	assert (m_pBufferIn != 0);
+#else
+	m_pPipeIn = new CUSBPipe (GetHost (), m_pEndpointIn, m_nBufferInSize,
+				  USB_SERIAL_RX_BUFFERS, PipeInHandler, this);
+	assert (m_pPipeIn != 0);
+
+	m_bPipeInStopped = FALSE;
+	m_pPipeIn->Start ();
+#endif
+
 	// attach interface device
 	assert (m_pInterface == 0);
 	m_pInterface = new CUSBSerialDevice;
@@ -119,6 +182,7 @@ boolean CUSBSerialHostDevice::Configure (void)
 
 	m_pInterface->RegisterWriteHandler (WriteHandler, this);
 	m_pInterface->RegisterReadHandler (ReadHandler, this);
+	m_pInterface->RegisterReadDataHandlers (GetReadDataHandler, ReleaseReadDataHandler, this);
 	m_pInterface->RegisterSetBaudRateHandler (SetBaudRateHandler, this);
 	m_pInterface->RegisterSetLinePropertiesHandler (SetLinePropertiesHandler, this);
 
@@ -133,6 +197,7 @@ int CUSBSerialHostDevice::Write (const void *pBuffer, size_t nCount)
 #if RASPPI <= 3
 	// USB host controller does not allow concurrent split transactions
 	// to same device. Thus wait for completion of pending IN request.
+	m_bWritePending = TRUE;
 	do
 	{
 		DataMemBarrier ();
@@ -140,20 +205,40 @@ int CUSBSerialHostDevice::Write (const void *pBuffer, size_t nCount)
 	while (m_bInRequestActive);
 #endif
 
-	CUSBHostController *pHost = GetHost ();
-	assert (pHost != 0);
+	// the data is queued and coalesced, so that the caller does not wait for the transfer
+	assert (m_pPipeOut != 0);
+	const u8 *pBuffer8 = (const u8 *) pBuffer;
+	size_t nRemaining = nCount;
+	while (nRemaining > 0)
+	{
+		unsigned nChunk =   nRemaining < USB_SERIAL_TX_BUFFER_SIZE
+				  ? nRemaining : USB_SERIAL_TX_BUFFER_SIZE;
+
+		while (!m_pPipeOut->Submit (pBuffer8, nChunk))
+		{
+			if (m_pPipeOut->IsFailed ())
+			{
+				LOGWARN ("USB write failed");
 
-	DMA_BUFFER (u8, BufferOut, nCount);
-	memcpy (BufferOut, pBuffer, nCount);
+				m_pPipeOut->Start ();		// clear error for next call
 
-	assert (m_pEndpointOut != 0);
-	int nActual = pHost->Transfer (m_pEndpointOut, BufferOut, nCount);
-	if (nActual < 0)
-	{
-		LOGWARN ("USB write failed");
+#if RASPPI <= 3
+				m_bWritePending = FALSE;
+#endif
+
+				return -1;
+			}
+		}
+
+		pBuffer8 += nChunk;
+		nRemaining -= nChunk;
 	}
 
-	return nActual;
+#if RASPPI <= 3
+	m_bWritePending = FALSE;
+#endif
+
+	return nCount;
 }
 
 int CUSBSerialHostDevice::Read (void *pBuffer, size_t nCount)
@@ -161,58 +246,111 @@ int CUSBSerialHostDevice::Read (void *pBuffer, size_t nCount)
 	assert (pBuffer != 0);
 	assert (nCount > 0);
 
-	DataMemBarrier ();
+	const void *pData;
+	int nResult = GetReadData (&pData);
+	if (nResult <= 0)
+	{
+		return nResult;
+	}
 
-	if (m_bInRequestActive)
+	if ((size_t) nResult > nCount)
 	{
-		return 0;
+		nResult = nCount;
 	}
 
-	assert (m_pBufferIn != 0);
-	assert (m_nBufferInSize > 0);
-	assert (m_nBufferInValid <= m_nBufferInSize);
-	assert (m_nBufferInPtr <= m_nBufferInValid);
+	memcpy (pBuffer, pData, nResult);
 
-	if (m_nBufferInPtr == m_nBufferInValid)		// buffer empty?
-	{
-		CUSBHostController *pHost = GetHost ();
-		assert (pHost != 0);
+	ReleaseReadData (nResult);
+
+	return nResult;
+}
 
-		assert (m_pEndpointIn != 0);
-		CUSBRequest *pURB = new CUSBRequest (m_pEndpointIn, m_pBufferIn, m_nBufferInSize);
-		assert (pURB != 0);
+int CUSBSerialHostDevice::GetReadData (const void **ppData)
+{
+	assert (ppData != 0);
 
-		// do not retry if request cannot be served immediately
-		pURB->SetCompleteOnNAK ();
+	if (m_nRxOverruns != 0)
+	{
+		EnterCritical ();
+		unsigned nOverruns = m_nRxOverruns;
+		m_nRxOverruns = 0;
+		LeaveCritical ();
 
-		pURB->SetCompletionRoutine (CompletionStub, 0, this);
+		LOGWARN ("%u bytes lost", nOverruns);
+	}
+
+#if RASPPI <= 3
+	if (   CanStartInRequest ()
+	    && !m_bInRequestActive)
+	{
 		m_bInRequestActive = TRUE;
 
-		if (!pHost->SubmitAsyncRequest (pURB))
+		if (!SubmitInRequest ())
 		{
 			LOGWARN ("USB read failed");
 
 			m_bInRequestActive = FALSE;
 
-			delete pURB;
-
 			return -1;
 		}
+	}
+#else
+	assert (m_pPipeIn != 0);
+	if (m_pPipeIn->IsFailed ())
+	{
+		LOGWARN ("USB read failed");
+
+		m_pPipeIn->Start ();			// clear error for next call
+
+		return -1;
+	}
+#endif
 
+	unsigned nOut = m_nRxOut;
+	unsigned nAvail = m_nRxIn - nOut;
+	if (nAvail == 0)
+	{
 		return 0;
 	}
 
-	size_t nRemain = m_nBufferInValid - m_nBufferInPtr;
-	if (nRemain < nCount)
+	// the data has been written before the index in PutReceivedData()
+	DataMemBarrier ();
+
+	unsigned nOffset = nOut & (USB_SERIAL_RX_RING_SIZE-1);
+	if (nAvail > USB_SERIAL_RX_RING_SIZE - nOffset)
 	{
-		nCount = nRemain;
+		nAvail = USB_SERIAL_RX_RING_SIZE - nOffset;	// contiguous part only
 	}
 
-	assert (nCount > 0);
-	memcpy (pBuffer, m_pBufferIn + m_nBufferInPtr, nCount);
-	m_nBufferInPtr += nCount;
+	assert (m_pRxRing != 0);
+	*ppData = m_pRxRing + nOffset;
 
-	return nCount;
+	return nAvail;
+}
+
+void CUSBSerialHostDevice::ReleaseReadData (size_t nCount)
+{
+	assert (nCount <= m_nRxIn - m_nRxOut);
+
+	// the data must have been read, before it can be overwritten
+	DataMemBarrier ();
+
+	m_nRxOut += nCount;
+
+#if RASPPI >= 4
+	EnterCritical ();
+
+	if (   m_bPipeInStopped
+	    && USB_SERIAL_RX_RING_SIZE - (m_nRxIn - m_nRxOut) >= USB_PIPE_MAX_ACTIVE * m_nBufferInSize)
+	{
+		m_bPipeInStopped = FALSE;
+
+		assert (m_pPipeIn != 0);
+		m_pPipeIn->Start ();
+	}
+
+	LeaveCritical ();
+#endif
 }
 
 boolean CUSBSerialHostDevice::SetBaudRate (unsigned nBaudRate)
@@ -227,34 +365,117 @@ boolean CUSBSerialHostDevice::SetLineProperties (TUSBSerialDataBits nDataBits,
 	return TRUE;
 }
 
-void CUSBSerialHostDevice::CompletionRoutine (CUSBRequest *pURB)
+void CUSBSerialHostDevice::PutReceivedData (const u8 *pBuffer, unsigned nLength)
 {
-	assert (pURB != 0);
-	assert (m_bInRequestActive);
-	assert (m_nBufferInValid == m_nBufferInPtr);
+	assert (pBuffer != 0);
+	assert (m_nMaxPacketSizeIn > 0);
+	assert (m_pRxRing != 0);
 
-	if (pURB->GetStatus () != 0)
+	// each packet may start with a header, which has to be ignored
+	while (nLength > 0)
 	{
-		m_nBufferInValid = pURB->GetResultLength ();
-		m_nBufferInPtr = m_nReadHeaderBytes;
-
-		if (   m_nBufferInValid == 0
-		    || m_nBufferInValid == m_nBufferInPtr)
+		unsigned nPacket = nLength < m_nMaxPacketSizeIn ? nLength : m_nMaxPacketSizeIn;
+		if (nPacket < m_nReadHeaderBytes)
 		{
-			m_nBufferInValid = 0;
-			m_nBufferInPtr = 0;
+			LOGWARN ("Missing read header");
+
+			return;
 		}
-		else if (m_nBufferInValid < m_nBufferInPtr)
+
+		const u8 *pData = pBuffer + m_nReadHeaderBytes;
+		unsigned nData = nPacket - m_nReadHeaderBytes;
+
+		pBuffer += nPacket;
+		nLength -= nPacket;
+
+		unsigned nIn = m_nRxIn;
+		unsigned nFree = USB_SERIAL_RX_RING_SIZE - (nIn - m_nRxOut);
+		if (nData > nFree)
 		{
-			LOGWARN ("Missing read header");
+			m_nRxOverruns += nData - nFree;
 
-			m_nBufferInValid = 0;
-			m_nBufferInPtr = 0;
+			nData = nFree;
+		}
+
+		unsigned nOffset = nIn & (USB_SERIAL_RX_RING_SIZE-1);
+		unsigned nFirst = USB_SERIAL_RX_RING_SIZE - nOffset;
+		if (nFirst > nData)
+		{
+			nFirst = nData;
 		}
+
+		memcpy (m_pRxRing + nOffset, pData, nFirst);
+		memcpy (m_pRxRing, pData + nFirst, nData - nFirst);
+
+		// the reader must not see the new index before the data
+		DataMemBarrier ();
+
+		m_nRxIn = nIn + nData;
+	}
+}
+
+#if RASPPI <= 3
+
+boolean CUSBSerialHostDevice::CanStartInRequest (void) const
+{
+	// no concurrent split transactions to the same device (see Write())
+	assert (m_pPipeOut != 0);
+
+	return    !m_bWritePending
+	       && m_pPipeOut->IsIdle ()
+	       && USB_SERIAL_RX_RING_SIZE - (m_nRxIn - m_nRxOut) >= m_nBufferInSize;
+}
+
+boolean CUSBSerialHostDevice::SubmitInRequest (void)
+{
+	assert (m_bInRequestActive);
+
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	assert (m_pEndpointIn != 0);
+	assert (m_pBufferIn != 0);
+	CUSBRequest *pURB = new CUSBRequest (m_pEndpointIn, m_pBufferIn, m_nBufferInSize);
+	assert (pURB != 0);
+
+	// do not retry if request cannot be served immediately
+	pURB->SetCompleteOnNAK ();
+
+	pURB->SetCompletionRoutine (CompletionStub, 0, this);
+
+	if (!pHost->SubmitAsyncRequest (pURB))
+	{
+		delete pURB;
+
+		return FALSE;
 	}
 
+	return TRUE;
+}
+
+void CUSBSerialHostDevice::CompletionRoutine (CUSBRequest *pURB)
+{
+	assert (pURB != 0);
+	assert (m_bInRequestActive);
+
+	unsigned nLength = pURB->GetStatus () != 0 ? pURB->GetResultLength () : 0;
+	assert (nLength <= m_nBufferInSize);
+
 	delete pURB;
 
+	if (nLength > 0)
+	{
+		PutReceivedData (m_pBufferIn, nLength);
+	}
+
+	// more data is probably pending, if some has been received
+	if (   nLength > m_nReadHeaderBytes
+	    && CanStartInRequest ()
+	    && SubmitInRequest ())
+	{
+		return;
+	}
+
 	m_bInRequestActive = FALSE;
 	DataSyncBarrier ();
 }
@@ -267,6 +488,31 @@ void CUSBSerialHostDevice::CompletionStub (CUSBRequest *pURB, void *pParam, void
 	pThis->CompletionRoutine (pURB);
 }
 
+#else
+
+void CUSBSerialHostDevice::PipeInHandler (int nResult, const u8 *pBuffer, void *pParam)
+{
+	CUSBSerialHostDevice *pThis = static_cast <CUSBSerialHostDevice *> (pParam);
+	assert (pThis != 0);
+
+	if (nResult > 0)
+	{
+		pThis->PutReceivedData (pBuffer, nResult);
+	}
+
+	// the other active requests must still fit into the ring buffer
+	if (  USB_SERIAL_RX_RING_SIZE - (pThis->m_nRxIn - pThis->m_nRxOut)
+	    < USB_PIPE_MAX_ACTIVE * pThis->m_nBufferInSize)
+	{
+		pThis->m_bPipeInStopped = TRUE;
+
+		assert (pThis->m_pPipeIn != 0);
+		pThis->m_pPipeIn->Stop ();		// restarted from ReleaseReadData()
+	}
+}
+
+#endif
+
 int CUSBSerialHostDevice::WriteHandler (const void *pBuffer, size_t nCount, void *pParam)
 {
 	CUSBSerialHostDevice *pThis = static_cast <CUSBSerialHostDevice *> (pParam);
@@ -283,6 +529,22 @@ int CUSBSerialHostDevice::ReadHandler (void *pBuffer, size_t nCount, void *pPara
 	return pThis->Read (pBuffer, nCount);
 }
 
+int CUSBSerialHostDevice::GetReadDataHandler (const void **ppData, void *pParam)
+{
+	CUSBSerialHostDevice *pThis = static_cast <CUSBSerialHostDevice *> (pParam);
+	assert (pThis != 0);
+
+	return pThis->GetReadData (ppData);
+}
+
+void CUSBSerialHostDevice::ReleaseReadDataHandler (size_t nCount, void *pParam)
+{
+	CUSBSerialHostDevice *pThis = static_cast <CUSBSerialHostDevice *> (pParam);
+	assert (pThis != 0);
+
+	pThis->ReleaseReadData (nCount);
+}
+
 boolean CUSBSerialHostDevice::SetBaudRateHandler (unsigned nBaudRate, void *pParam)
 {
 	CUSBSerialHostDevice *pThis = static_cast <CUSBSerialHostDevice *> (pParam);
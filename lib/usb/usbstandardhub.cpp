@@ -316,24 +316,20 @@ boolean CUSBStandardHub::EnumeratePorts (void)
 			continue;
 		}
 
-		if (pHost->ControlMessage (pEndpoint0,
-			REQUEST_OUT | REQUEST_CLASS | REQUEST_TO_OTHER,
-			SET_FEATURE, PORT_RESET, nPort+1, 0, 0) < 0)
+		// the reset and the following address assignment must be serialized,
+		// because only one device may respond to address 0 at a time
+		int nStatus = ResetPort (nPort);
+		if (nStatus < 0)
+		{
+			return FALSE;
+		}
+		else if (nStatus == 0)
 		{
 			CLogger::Get ()->Write (FromHub, LogError, "Cannot reset port %u", nPort+1);
 
 			continue;
 		}
 
-		CTimer::Get ()->MsDelay (100);
-		
-		if (pHost->ControlMessage (pEndpoint0,
-			REQUEST_IN | REQUEST_CLASS | REQUEST_TO_OTHER,
-			GET_STATUS, 0, nPort+1, m_pStatus[nPort], 4) != 4)
-		{
-			return FALSE;
-		}
-
 		//CLogger::Get ()->Write (FromHub, LogDebug, "Port %u status is 0x%04X", nPort+1, (unsigned) m_pStatus[nPort]->wPortStatus);
 		
 		if (!(m_pStatus[nPort]->wPortStatus & PORT_ENABLE__MASK))
@@ -477,6 +473,49 @@ boolean CUSBStandardHub::EnumeratePorts (void)
 	return bResult;
 }
 
+int CUSBStandardHub::ResetPort (unsigned nPort)
+{
+	CUSBHostController *pHost = GetHost ();
+	assert (pHost != 0);
+
+	CUSBEndpoint *pEndpoint0 = GetEndpoint0 ();
+	assert (pEndpoint0 != 0);
+
+	assert (nPort < m_nPorts);
+	assert (m_pStatus[nPort] != 0);
+
+	if (pHost->ControlMessage (pEndpoint0,
+		REQUEST_OUT | REQUEST_CLASS | REQUEST_TO_OTHER,
+		SET_FEATURE, PORT_RESET, nPort+1, 0, 0) < 0)
+	{
+		return 0;
+	}
+
+	// poll for the end of the reset signaling (tDRSTR is 10-20 ms usually),
+	// instead of waiting the maximum time for each port
+	for (unsigned nMsWait = 0; nMsWait < HUB_PORT_RESET_TIMEOUT_MS;
+	     nMsWait += HUB_PORT_RESET_POLL_MS)
+	{
+		CTimer::Get ()->MsDelay (HUB_PORT_RESET_POLL_MS);
+
+		if (pHost->ControlMessage (pEndpoint0,
+			REQUEST_IN | REQUEST_CLASS | REQUEST_TO_OTHER,
+			GET_STATUS, 0, nPort+1, m_pStatus[nPort], 4) != 4)
+		{
+			return -1;
+		}
+
+		if (!(m_pStatus[nPort]->wPortStatus & PORT_RESET__MASK))
+		{
+			CTimer::Get ()->MsDelay (HUB_PORT_RESET_RECOVERY_MS);	// tRSTRCY
+
+			return 1;
+		}
+	}
+
+	return 1;			// caller checks PORT_ENABLE__MASK
+}
+
 boolean CUSBStandardHub::StartStatusChangeRequest (void)
 {
 	assert (m_nPorts > 0);
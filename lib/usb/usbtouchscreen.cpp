@@ -182,7 +182,8 @@ void CUSBTouchScreenDevice::ReportHandler (const u8 *pReport, unsigned nReportSi
 					}
 				}
 
-				m_pDevice->ReportHandler (TouchScreenEventFingerDown, j, x, y);
+				m_pDevice->ReportHandler (TouchScreenEventFingerDown, j, x, y,
+							  GetReportTimestamp ());
 
 				m_bFingerIsDown[j] = TRUE;
 				m_ucContactID[j] = ucContactID;
@@ -192,7 +193,8 @@ void CUSBTouchScreenDevice::ReportHandler (const u8 *pReport, unsigned nReportSi
 			{
 				// known, and position changed
 
-				m_pDevice->ReportHandler (TouchScreenEventFingerMove, j, x, y);
+				m_pDevice->ReportHandler (TouchScreenEventFingerMove, j, x, y,
+							  GetReportTimestamp ());
 			}
 
 			m_usLastX[j] = x;
@@ -222,7 +224,8 @@ void CUSBTouchScreenDevice::ReportHandler (const u8 *pReport, unsigned nReportSi
 			{
 				// not known any more
 
-				m_pDevice->ReportHandler (TouchScreenEventFingerUp, i, 0, 0);
+				m_pDevice->ReportHandler (TouchScreenEventFingerUp, i, 0, 0,
+							  GetReportTimestamp ());
 
 				m_bFingerIsDown[i] = FALSE;
 			}
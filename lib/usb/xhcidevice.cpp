@@ -21,6 +21,7 @@
 #include <circle/bcm2711.h>
 #include <circle/memio.h>
 #include <circle/logger.h>
+#include <circle/tracer.h>
 #include <circle/memory.h>
 #include <circle/util.h>
 #include <circle/bcmpropertytags.h>
@@ -114,7 +115,7 @@ CXHCIDevice::~CXHCIDevice (void)
 boolean CXHCIDevice::Initialize (boolean bScanDevices)
 {
 	// init class-specific allocators in USB library
-	INIT_PROTECTED_CLASS_ALLOCATOR (CUSBRequest, XHCI_CONFIG_MAX_REQUESTS, IRQ_LEVEL);
+	INIT_LOCKFREE_CLASS_ALLOCATOR (CUSBRequest, XHCI_CONFIG_MAX_REQUESTS, IRQ_LEVEL);
 
 #ifdef USE_XHCI_INTERNAL
 	if (CMachineInfo::Get ()->GetMachineModel () != MachineModel4B)
@@ -324,6 +325,9 @@ boolean CXHCIDevice::SubmitAsyncRequest (CUSBRequest *pURB, unsigned nTimeoutMs)
 	CXHCIEndpoint *pEndpoint = pURB->GetEndpoint ()->GetXHCIEndpoint ();
 	assert (pEndpoint != 0);
 
+	TRACE_SYSTEM_EVENT (TRACER_EVENT_USB_SUBMIT, pURB->GetEndpoint ()->GetDevice ()->GetAddress (),
+			    pURB->GetEndpoint ()->GetNumber (), pURB->GetBufLen ());
+
 	return pEndpoint->TransferAsync (pURB, nTimeoutMs);
 }
 
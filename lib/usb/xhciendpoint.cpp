@@ -39,9 +39,12 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, CXHCIDevice *pXHCIDevice)
 	m_pMMIO (pXHCIDevice->GetMMIOSpace ()),
 	m_bValid (TRUE),
 	m_pTransferRing (0),
+	m_uchMaxBurst (0),
 	m_uchEndpointID (1),
 	m_uchEndpointType (XHCI_EP_CONTEXT_EP_TYPE_CONTROL),
 	m_pURB {0, 0},
+	m_nTDTag {0, 0},
+	m_nTDSequence (0),
 	m_bTransferCompleted (TRUE),
 	m_pInputContextBuffer (0)
 {
@@ -68,11 +71,16 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, const TUSBEndpointDescrip
 	m_uchEndpointID (0),
 	m_uchEndpointType (0),
 	m_pURB {0, 0},
+	m_nTDTag {0, 0},
+	m_nTDSequence (0),
 	m_bTransferCompleted (TRUE),
 	m_pInputContextBuffer (0)
 {
+	assert (pDesc != 0);
 	m_pTransferRing = new CXHCIRing (XHCIRingTypeTransfer,
-					 XHCI_CONFIG_TRANSFER_RING_SIZE, pXHCIDevice);
+					 (pDesc->bmAttributes & 3) == 2 ? XHCI_CONFIG_BULK_RING_SIZE
+									: XHCI_CONFIG_TRANSFER_RING_SIZE,
+					 pXHCIDevice);
 	if (   m_pTransferRing == 0
 	    || !m_pTransferRing->IsValid ())
 	{
@@ -82,7 +90,6 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, const TUSBEndpointDescrip
 	}
 
 	// copy endpoint descriptor
-	assert (pDesc != 0);
 	assert (pDesc->bLength >= sizeof *pDesc);	// may have class-specific trailer
 	assert (pDesc->bDescriptorType == DESCRIPTOR_ENDPOINT);
 
@@ -91,9 +98,20 @@ CXHCIEndpoint::CXHCIEndpoint (CXHCIUSBDevice *pDevice, const TUSBEndpointDescrip
 	m_usMaxPacketSize = pDesc->wMaxPacketSize & 0x7FF;
 
 	assert (m_pDevice != 0);
+	m_uchMaxBurst = 0;
 	if ((m_uchAttributes & 1) == 1)		// interrupt or isochronous endpoint
 	{
 		m_uchInterval = ConvertInterval (pDesc->bInterval, m_pDevice->GetSpeed ());
+
+		// high-bandwidth endpoint (see xHCI spec chapter 6.2.3.4)
+		if (m_pDevice->GetSpeed () == USBSpeedHigh)
+		{
+			m_uchMaxBurst = (pDesc->wMaxPacketSize >> 11) & 3;
+			if (m_uchMaxBurst > 2)
+			{
+				m_uchMaxBurst = 2;	// reserved value
+			}
+		}
 	}
 	else
 	{
@@ -231,6 +249,7 @@ boolean CXHCIEndpoint::Transfer (CUSBRequest *pURB, unsigned nTimeoutMs)
 
 			m_SpinLock.Acquire ();
 			m_pURB[0] = m_pURB[1];
+			m_nTDTag[0] = m_nTDTag[1];
 			m_pURB[1] = 0;
 			m_SpinLock.Release ();
 			m_bTransferCompleted = TRUE;
@@ -262,14 +281,21 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 	u32 nBufLen = pURB->GetBufLen ();
 
 	m_SpinLock.Acquire ();
+	if (++m_nTDSequence == 0)
+	{
+		m_nTDSequence = 1;		// 0 is never used as tag
+	}
+	u32 nTag = m_nTDSequence;
 	if (m_pURB[0] == 0)
 	{
 		m_pURB[0] = pURB;
+		m_nTDTag[0] = nTag;
 	}
 	else
 	{
 		assert (m_pURB[1] == 0);
 		m_pURB[1] = pURB;
+		m_nTDTag[1] = nTag;
 	}
 	m_SpinLock.Release ();
 
@@ -282,13 +308,67 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 		assert ((uintptr) pBuffer > MEM_KERNEL_END);
 		CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nBufLen);
 
-		if (!EnqueueTRB (  XHCI_TRB_TYPE_NORMAL << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
-				 | XHCI_TRANSFER_TRB_CONTROL_IOC,
-		     		 nBufLen | 0 << XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT,
-				 XHCI_TO_DMA_LO (pBuffer),
-				 XHCI_TO_DMA_HI (pBuffer)))
+		// A TD is chained from Normal TRBs, which do not cross a 64K boundary. A chained
+		// TD is terminated by an Event Data TRB, which generates a single event with the
+		// total transferred length. Only a short packet generates an event before. The
+		// first TRB is passed to the xHC last, because the endpoint may be busy with a
+		// preceding TD.
+		TXHCITRB *pFirstTRB = m_pTransferRing->GetEnqueueTRB ();
+		boolean bChained = GetTRBLength (pBuffer, nBufLen, 0) < nBufLen;
+
+		u32 nOffset = 0;
+		while (nOffset < nBufLen)
 		{
-			goto EnqueueError;
+			u32 nLength = GetTRBLength (pBuffer, nBufLen, nOffset);
+			assert (nLength > 0);
+
+			u32 nTDSize = 0;		// number of packets after this TRB
+			if (nOffset + nLength < nBufLen)
+			{
+				assert (m_usMaxPacketSize > 0);
+				nTDSize = (nBufLen - nOffset - nLength + m_usMaxPacketSize-1) / m_usMaxPacketSize;
+				if (nTDSize > 31)
+				{
+					nTDSize = 31;
+				}
+			}
+
+			u8 *pTRBBuffer = (u8 *) pBuffer + nOffset;
+			if (!EnqueueTRB (  XHCI_TRB_TYPE_NORMAL << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
+					 | (bChained ?   XHCI_TRANSFER_TRB_CONTROL_CH
+						       | XHCI_TRANSFER_TRB_CONTROL_ISP
+						     : XHCI_TRANSFER_TRB_CONTROL_IOC),
+					 nLength | nTDSize << XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT,
+					 XHCI_TO_DMA_LO (pTRBBuffer),
+					 XHCI_TO_DMA_HI (pTRBBuffer),
+					 bChained && nOffset == 0))
+			{
+				if (nOffset > 0)
+				{
+					// the incomplete TD is never passed to the xHC
+					CLogger::Get ()->Write (From, LogError, "Transfer ring is full");
+				}
+
+				goto EnqueueError;
+			}
+
+			nOffset += nLength;
+		}
+
+		if (bChained)
+		{
+			if (!EnqueueTRB (  XHCI_TRB_TYPE_EVENT_DATA << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
+					 | XHCI_TRANSFER_TRB_CONTROL_IOC,
+					 0, nTag))
+			{
+				CLogger::Get ()->Write (From, LogError, "Transfer ring is full");
+
+				goto EnqueueError;
+			}
+
+			assert (pFirstTRB != 0);
+			DataSyncBarrier ();
+			pFirstTRB->Control ^= XHCI_TRB_CONTROL_C;
 		}
 	}
 	else if (m_uchEndpointType == 4)		// control EP
@@ -371,8 +451,13 @@ boolean CXHCIEndpoint::TransferAsync (CUSBRequest *pURB, unsigned nTimeoutMs)
 		{
 			u16 usPacketSize = pURB->GetIsoPacketSize (i);
 
+			// a (micro)frame of a high-bandwidth endpoint may take up to 3 packets
+			u32 nXferPackets = (usPacketSize + m_usMaxPacketSize-1) / m_usMaxPacketSize;
+			u32 nTLBPC = nXferPackets > 0 ? nXferPackets-1 : 0;
+
 			if (!EnqueueTRB (  XHCI_TRB_TYPE_ISOCH << XHCI_TRB_CONTROL_TRB_TYPE__SHIFT
 					 | (i == nPackets-1 ? XHCI_TRANSFER_TRB_CONTROL_IOC : 0)
+					 | nTLBPC << XHCI_TRANSFER_TRB_CONTROL_TLBPC__SHIFT
 					 | XHCI_TRANSFER_TRB_CONTROL_SIA,
 					   usPacketSize
 					 | (nPackets-i-1) << XHCI_TRANSFER_TRB_STATUS_TD_SIZE__SHIFT,
@@ -409,7 +494,22 @@ EnqueueError:
 	return FALSE;
 }
 
-void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength)
+u32 CXHCIEndpoint::GetTRBLength (const void *pBuffer, u32 nBufLen, u32 nOffset)
+{
+	assert (nOffset < nBufLen);
+
+	uintptr nAddress = (uintptr) pBuffer + nOffset;
+	u32 nLength = 0x10000 - (nAddress & 0xFFFF);
+	if (nLength > nBufLen - nOffset)
+	{
+		nLength = nBufLen - nOffset;
+	}
+
+	return nLength;
+}
+
+void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+				   u64 ullParameter, boolean bEventData)
 {
 #ifdef XHCI_DEBUG2
 	CLogger::Get ()->Write (From, LogDebug,
@@ -426,19 +526,49 @@ void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength)
 		return;
 	}
 
+	if (   bEventData
+	    && (u32) ullParameter != m_nTDTag[0])
+	{
+		return;		// TD has already been completed on a short packet
+	}
+
 	if (   XHCI_TRB_SUCCESS (uchCompletionCode)
 	    || uchCompletionCode == XHCI_TRB_COMPLETION_CODE_SHORT_PACKET)
 	{
 		void *pBuffer = pURB->GetBuffer ();
 		u32 nBufLen = pURB->GetBufLen ();
+
+		u32 nResultLen = nBufLen - nTransferLength;
+		if (   (m_uchEndpointType & 3) == 2		// bulk EP
+		    || (m_uchEndpointType & 3) == 3)		// interrupt EP
+		{
+			if (bEventData)
+			{
+				// Event Data TRB of a chained TD, total length is reported
+				nResultLen = nTransferLength;
+			}
+			else
+			{
+				// last Normal TRB of a TD or short packet on any Normal TRB
+				const TXHCITRB *pTRB = (const TXHCITRB *) XHCI_FROM_DMA (ullParameter);
+				assert (pTRB != 0);
+
+				u32 nLength =   pTRB->Status
+					      & XHCI_TRANSFER_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK;
+				assert (nTransferLength <= nLength);
+				nResultLen =   pTRB->Parameter1 - XHCI_TO_DMA_LO (pBuffer)
+					     + nLength - nTransferLength;
+			}
+		}
+
 		if (pBuffer != 0)
 		{
 			assert (nBufLen > 0);
 			CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nBufLen);
 		}
 
-		assert (nTransferLength <= nBufLen);
-		pURB->SetResultLen (nBufLen - nTransferLength);
+		assert (nResultLen <= nBufLen);
+		pURB->SetResultLen (nResultLen);
 
 		pURB->SetStatus (1);
 	}
@@ -456,6 +586,7 @@ void CXHCIEndpoint::TransferEvent (u8 uchCompletionCode, u32 nTransferLength)
 
 	m_SpinLock.Acquire ();
 	m_pURB[0] = m_pURB[1];
+	m_nTDTag[0] = m_nTDTag[1];
 	m_pURB[1] = 0;
 	m_SpinLock.Release ();
 
@@ -519,7 +650,8 @@ void CXHCIEndpoint::CompletionRoutine (CUSBRequest *pURB, void *pParam, void *pC
 	pThis->m_bTransferCompleted = TRUE;
 }
 
-boolean CXHCIEndpoint::EnqueueTRB (u32 nControl, u32 nStatus, u32 nParameter1, u32 nParameter2)
+boolean CXHCIEndpoint::EnqueueTRB (u32 nControl, u32 nStatus, u32 nParameter1, u32 nParameter2,
+				   boolean bDeferCycle)
 {
 	assert (m_pTransferRing != 0);
 	TXHCITRB *pTransferTRB = m_pTransferRing->GetEnqueueTRB ();
@@ -535,7 +667,7 @@ boolean CXHCIEndpoint::EnqueueTRB (u32 nControl, u32 nStatus, u32 nParameter1, u
 			       |    XHCI_INTERRUPTER_TARGET_DEFAULT
 			         << XHCI_TRANSFER_TRB_STATUS_INTERRUPTER_TARGET__SHIFT;
 
-	pTransferTRB->Control = nControl | m_pTransferRing->GetCycleState ();
+	pTransferTRB->Control = nControl | (m_pTransferRing->GetCycleState () ^ (bDeferCycle ? XHCI_TRB_CONTROL_C : 0));
 
 	m_pTransferRing->IncrementEnqueue ();
 
@@ -595,7 +727,7 @@ TXHCIInputContext *CXHCIEndpoint::GetInputContextConfigureEndpoint (void)
 
 	pEPContext->EPType = m_uchEndpointType;
 	pEPContext->MaxPacketSize = m_usMaxPacketSize;
-	pEPContext->MaxBurstSize = 0;		// TODO
+	pEPContext->MaxBurstSize = m_uchMaxBurst;	// TODO: SuperSpeed companion descriptor
 	pEPContext->MaxPStreams = 0;
 	pEPContext->CErr = 3;
 
@@ -610,14 +742,14 @@ TXHCIInputContext *CXHCIEndpoint::GetInputContextConfigureEndpoint (void)
 	case XHCI_EP_CONTEXT_EP_TYPE_INTERRUPT_IN:
 		pEPContext->Interval = m_uchInterval;
 		pEPContext->AverageTRBLength = 16;	// best guess
-		pEPContext->MaxESITPayload = m_usMaxPacketSize;
+		pEPContext->MaxESITPayload = m_usMaxPacketSize * (m_uchMaxBurst + 1);
 		break;
 
 	case XHCI_EP_CONTEXT_EP_TYPE_ISOCH_OUT:
 	case XHCI_EP_CONTEXT_EP_TYPE_ISOCH_IN:
 		pEPContext->Interval = m_uchInterval;
 		pEPContext->AverageTRBLength = m_usMaxPacketSize;
-		pEPContext->MaxESITPayload = m_usMaxPacketSize;
+		pEPContext->MaxESITPayload = m_usMaxPacketSize * (m_uchMaxBurst + 1);
 		break;
 
 	default:
@@ -97,6 +97,8 @@ TXHCITRB *CXHCIEventManager::HandleEvents (void)
 		m_pXHCIDevice->GetSlotManager ()->TransferEvent (
 			pEventTRB->Status >> XHCI_EVENT_TRB_STATUS_COMPLETION_CODE__SHIFT,
 			pEventTRB->Status & XHCI_TRANSFER_EVENT_TRB_STATUS_TRB_TRANSFER_LENGTH__MASK,
+			pEventTRB->Parameter,
+			!!(pEventTRB->Control & XHCI_TRANSFER_EVENT_TRB_CONTROL_ED),
 			pEventTRB->Control >> XHCI_CMD_COMPLETION_EVENT_TRB_CONTROL_SLOTID__SHIFT,
 			   (pEventTRB->Control & XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__MASK)
 			>> XHCI_TRANSFER_EVENT_TRB_CONTROL_ENDPOINTID__SHIFT);
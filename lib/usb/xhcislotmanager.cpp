@@ -100,6 +100,7 @@ void CXHCISlotManager::AssignScratchpadBufferArray (u64 *pScratchpadBufferArray)
 }
 
 void CXHCISlotManager::TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
+				      u64 ullParameter, boolean bEventData,
 				      u8 uchSlotID, u8 uchEndpointID)
 {
 	assert (XHCI_IS_SLOTID (uchSlotID));
@@ -108,7 +109,8 @@ void CXHCISlotManager::TransferEvent (u8 uchCompletionCode, u32 nTransferLength,
 		return;
 	}
 
-	m_pUSBDevice[uchSlotID-1]->TransferEvent (uchCompletionCode, nTransferLength, uchEndpointID);
+	m_pUSBDevice[uchSlotID-1]->TransferEvent (uchCompletionCode, nTransferLength,
+						  ullParameter, bEventData, uchEndpointID);
 }
 
 #ifndef NDEBUG
@@ -93,6 +93,28 @@ void CUserTimer::Start (unsigned nDelayMicros)
 	PeripheralExit ();
 }
 
+void CUserTimer::StartAt (u32 nCompareValue)
+{
+	assert (m_bInitialized);
+
+	PeripheralEntry ();
+
+	write32 (ARM_SYSTIMER_C1, nCompareValue);
+
+	PeripheralExit ();
+}
+
+u32 CUserTimer::GetCounter (void)
+{
+	PeripheralEntry ();
+
+	u32 nResult = read32 (ARM_SYSTIMER_CLO);
+
+	PeripheralExit ();
+
+	return nResult;
+}
+
 void CUserTimer::InterruptHandler (void *pParam)
 {
 	CUserTimer *pThis = reinterpret_cast<CUserTimer *> (pParam);
@@ -18,8 +18,98 @@
 // along with this program.  If not, see <http://www.gnu.org/licenses/>.
 //
 #include <circle/util.h>
+#include <circle/sysconfig.h>
 
-void *memmove (void *pDest, const void *pSrc, size_t nLength)
+#if AARCH == 64
+
+// the generic variants are selected by the dispatcher in util_fast.S until memfunc_select()
+#define GENERIC(name)	name##_generic
+
+extern "C"
+{
+	void *memset_generic (void *pBuffer, int nValue, size_t nLength);
+	void *memset_neon (void *pBuffer, int nValue, size_t nLength);
+	void *memcpy_generic (void *pDest, const void *pSrc, size_t nLength);
+	void *memcpy_neon (void *pDest, const void *pSrc, size_t nLength);
+	void *memmove_generic (void *pDest, const void *pSrc, size_t nLength);
+	void *memmove_neon (void *pDest, const void *pSrc, size_t nLength);
+#if STDLIB_SUPPORT <= 1
+	int memcmp_generic (const void *pBuffer1, const void *pBuffer2, size_t nLength);
+	int memcmp_neon (const void *pBuffer1, const void *pBuffer2, size_t nLength);
+	size_t strlen_generic (const char *pString);
+	size_t strlen_neon (const char *pString);
+#endif
+
+	void *(*memfunc_memset) (void *, int, size_t) = memset_generic;
+	void *(*memfunc_memcpy) (void *, const void *, size_t) = memcpy_generic;
+	void *(*memfunc_memmove) (void *, const void *, size_t) = memmove_generic;
+#if STDLIB_SUPPORT <= 1
+	int (*memfunc_memcmp) (const void *, const void *, size_t) = memcmp_generic;
+	size_t (*memfunc_strlen) (const char *) = strlen_generic;
+#endif
+
+	u64 memfunc_prefetch_distance = 256;		// bytes, read ahead in memcpy()
+	u64 memfunc_nt_threshold = 256*1024;		// use non-temporal stores from this size on
+}
+
+void memfunc_select (unsigned nCPU)
+{
+	// NEON registers must be saved on IRQ and FIQ, because handlers use these functions too
+#if defined (SAVE_VFP_REGS_ON_IRQ) && defined (SAVE_VFP_REGS_ON_FIQ)
+	switch (nCPU)
+	{
+	case MEMFUNC_CPU_CORTEX_A53:
+		memfunc_prefetch_distance = 256;
+		memfunc_nt_threshold = 256*1024;	// half of the 512 KB L2 cache
+		break;
+
+	case MEMFUNC_CPU_CORTEX_A72:
+		memfunc_prefetch_distance = 384;
+		memfunc_nt_threshold = 512*1024;	// half of the 1 MB L2 cache
+		break;
+
+	case MEMFUNC_CPU_CORTEX_A76:
+		memfunc_prefetch_distance = 512;
+		memfunc_nt_threshold = 1024*1024;	// half of the 2 MB L3 cache
+		break;
+
+	default:
+		nCPU = MEMFUNC_CPU_GENERIC;
+		break;
+	}
+#else
+	nCPU = MEMFUNC_CPU_GENERIC;
+#endif
+
+	if (nCPU == MEMFUNC_CPU_GENERIC)
+	{
+		memfunc_memset = memset_generic;
+		memfunc_memcpy = memcpy_generic;
+		memfunc_memmove = memmove_generic;
+#if STDLIB_SUPPORT <= 1
+		memfunc_memcmp = memcmp_generic;
+		memfunc_strlen = strlen_generic;
+#endif
+	}
+	else
+	{
+		memfunc_memset = memset_neon;
+		memfunc_memcpy = memcpy_neon;
+		memfunc_memmove = memmove_neon;
+#if STDLIB_SUPPORT <= 1
+		memfunc_memcmp = memcmp_neon;
+		memfunc_strlen = strlen_neon;
+#endif
+	}
+}
+
+#else
+
+#define GENERIC(name)	name
+
+#endif
+
+void *GENERIC (memmove) (void *pDest, const void *pSrc, size_t nLength)
 {
 	char *pchDest = (char *) pDest;
 	const char *pchSrc = (const char *) pSrc;
@@ -43,7 +133,7 @@ void *memmove (void *pDest, const void *pSrc, size_t nLength)
 
 #if STDLIB_SUPPORT <= 1
 
-int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
+int GENERIC (memcmp) (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 {
 	const unsigned char *p1 = (const unsigned char *) pBuffer1;
 	const unsigned char *p2 = (const unsigned char *) pBuffer2;
@@ -66,7 +156,7 @@ int memcmp (const void *pBuffer1, const void *pBuffer2, size_t nLength)
 	return 0;
 }
 
-size_t strlen (const char *pString)
+size_t GENERIC (strlen) (const char *pString)
 {
 	size_t nResult = 0;
 
@@ -720,6 +810,12 @@ u32 bswap32 (u32 ulValue)
 		| ((ulValue & 0xFF000000) >> 24);
 }
 
+u64 bswap64 (u64 ullValue)
+{
+	return    (u64) bswap32 ((u32) ullValue) << 32
+		| bswap32 ((u32) (ullValue >> 32));
+}
+
 #endif
 
 #if !defined (__GNUC__) || (AARCH == 32 && STDLIB_SUPPORT == 0)
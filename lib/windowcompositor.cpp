@@ -0,0 +1,599 @@
+//
+// windowcompositor.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include <circle/windowcompositor.h>
+#include <circle/util.h>
+#include <assert.h>
+
+//// CWindowCompositor /////////////////////////////////////////////////////////
+
+CWindowCompositor::CWindowCompositor (CDisplay *pDisplay, CDisplay::TColor BackgroundColor)
+:	m_pDisplay (pDisplay),
+	m_BackgroundColor (pDisplay->GetColor (BackgroundColor)),
+	m_nWidth (0),
+	m_nHeight (0),
+	m_nBytesPerPixel (0),
+	m_nWindows (0),
+	m_nDamage (0),
+	m_pComposeBuffer (nullptr),
+	m_SpinLock (TASK_LEVEL)
+{
+	assert (m_pDisplay);
+}
+
+CWindowCompositor::~CWindowCompositor (void)
+{
+	assert (m_nWindows == 0);
+
+	delete [] m_pComposeBuffer;
+	m_pComposeBuffer = nullptr;
+
+	m_pDisplay = nullptr;
+}
+
+boolean CWindowCompositor::Initialize (void)
+{
+	assert (m_pDisplay);
+	unsigned nDepth = m_pDisplay->GetDepth ();
+	if (   nDepth != 8
+	    && nDepth != 16
+	    && nDepth != 32)
+	{
+		return FALSE;
+	}
+
+	m_pComposeBuffer = new u8[m_pDisplay->GetWidth () * m_pDisplay->GetHeight () * nDepth/8];
+	if (!m_pComposeBuffer)
+	{
+		return FALSE;
+	}
+
+	m_SpinLock.Acquire ();
+
+	m_nWidth = m_pDisplay->GetWidth ();
+	m_nHeight = m_pDisplay->GetHeight ();
+	m_nBytesPerPixel = nDepth / 8;
+
+	// the display has an undefined content initially
+	CDisplay::TArea Area {0, m_nWidth-1, 0, m_nHeight-1};
+	AddDamageLocked (Area);
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CWindowCompositor::Update (void)
+{
+	if (!m_pComposeBuffer)
+	{
+		return;
+	}
+
+	m_SpinLock.Acquire ();
+
+	for (unsigned i = 0; i < m_nDamage; i++)
+	{
+		Compose (m_Damage[i]);
+	}
+
+	m_nDamage = 0;
+
+	m_SpinLock.Release ();
+}
+
+CDisplay *CWindowCompositor::GetDisplay (void) const
+{
+	return m_pDisplay;
+}
+
+boolean CWindowCompositor::AddWindow (CCompositedWindow *pWindow)
+{
+	assert (pWindow);
+
+	m_SpinLock.Acquire ();
+
+	if (m_nWindows >= WINDOW_COMPOSITOR_MAX_WINDOWS)
+	{
+		m_SpinLock.Release ();
+
+		return FALSE;
+	}
+
+	m_pWindow[m_nWindows++] = pWindow;
+
+	if (pWindow->m_bShown)
+	{
+		AddDamageLocked (pWindow->GetScreenArea ());
+	}
+
+	m_SpinLock.Release ();
+
+	return TRUE;
+}
+
+void CWindowCompositor::RemoveWindow (CCompositedWindow *pWindow)
+{
+	m_SpinLock.Acquire ();
+
+	int nIndex = FindWindow (pWindow);
+	if (nIndex < 0)
+	{
+		m_SpinLock.Release ();
+
+		return;
+	}
+
+	for (unsigned i = nIndex; i < m_nWindows-1; i++)
+	{
+		m_pWindow[i] = m_pWindow[i+1];
+	}
+
+	m_nWindows--;
+
+	if (pWindow->m_bShown)
+	{
+		AddDamageLocked (pWindow->GetScreenArea ());
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::RaiseWindow (CCompositedWindow *pWindow)
+{
+	m_SpinLock.Acquire ();
+
+	int nIndex = FindWindow (pWindow);
+	if (nIndex >= 0)
+	{
+		for (unsigned i = nIndex; i < m_nWindows-1; i++)
+		{
+			m_pWindow[i] = m_pWindow[i+1];
+		}
+
+		m_pWindow[m_nWindows-1] = pWindow;
+
+		if (pWindow->m_bShown)
+		{
+			AddDamageLocked (pWindow->GetScreenArea ());
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::LowerWindow (CCompositedWindow *pWindow)
+{
+	m_SpinLock.Acquire ();
+
+	int nIndex = FindWindow (pWindow);
+	if (nIndex >= 0)
+	{
+		for (unsigned i = nIndex; i > 0; i--)
+		{
+			m_pWindow[i] = m_pWindow[i-1];
+		}
+
+		m_pWindow[0] = pWindow;
+
+		if (pWindow->m_bShown)
+		{
+			AddDamageLocked (pWindow->GetScreenArea ());
+		}
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::MoveWindow (CCompositedWindow *pWindow, unsigned nPosX, unsigned nPosY)
+{
+	assert (pWindow);
+
+	m_SpinLock.Acquire ();
+
+	if (pWindow->m_bShown)
+	{
+		AddDamageLocked (pWindow->GetScreenArea ());
+	}
+
+	pWindow->m_nPosX = nPosX;
+	pWindow->m_nPosY = nPosY;
+
+	if (pWindow->m_bShown)
+	{
+		AddDamageLocked (pWindow->GetScreenArea ());
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::ShowWindow (CCompositedWindow *pWindow, boolean bShow)
+{
+	assert (pWindow);
+
+	m_SpinLock.Acquire ();
+
+	if (pWindow->m_bShown != bShow)
+	{
+		pWindow->m_bShown = bShow;
+
+		AddDamageLocked (pWindow->GetScreenArea ());
+	}
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::AddDamage (const CDisplay::TArea &rArea)
+{
+	m_SpinLock.Acquire ();
+
+	AddDamageLocked (rArea);
+
+	m_SpinLock.Release ();
+}
+
+void CWindowCompositor::AddDamageLocked (const CDisplay::TArea &rArea)
+{
+	CDisplay::TArea Screen {0, m_nWidth-1, 0, m_nHeight-1};
+	CDisplay::TArea Area;
+	if (   m_nWidth == 0
+	    || !Intersect (rArea, Screen, &Area))
+	{
+		return;
+	}
+
+	for (unsigned i = 0; i < m_nDamage; i++)
+	{
+		if (Contains (m_Damage[i], Area))
+		{
+			return;
+		}
+	}
+
+	if (m_nDamage < WINDOW_COMPOSITOR_MAX_DAMAGE)
+	{
+		m_Damage[m_nDamage++] = Area;
+
+		return;
+	}
+
+	// merge with the area, which grows least by doing so
+	unsigned nBest = 0;
+	u64 ullBestCost = (u64) -1;
+	for (unsigned i = 0; i < m_nDamage; i++)
+	{
+		const CDisplay::TArea &rDamage = m_Damage[i];
+
+		unsigned x1 = rDamage.x1 < Area.x1 ? rDamage.x1 : Area.x1;
+		unsigned x2 = rDamage.x2 > Area.x2 ? rDamage.x2 : Area.x2;
+		unsigned y1 = rDamage.y1 < Area.y1 ? rDamage.y1 : Area.y1;
+		unsigned y2 = rDamage.y2 > Area.y2 ? rDamage.y2 : Area.y2;
+
+		u64 ullCost =   (u64) (x2 - x1 + 1) * (y2 - y1 + 1)
+			      - (u64) (rDamage.x2 - rDamage.x1 + 1) * (rDamage.y2 - rDamage.y1 + 1);
+		if (ullCost < ullBestCost)
+		{
+			ullBestCost = ullCost;
+			nBest = i;
+		}
+	}
+
+	CDisplay::TArea &rDamage = m_Damage[nBest];
+	if (Area.x1 < rDamage.x1) rDamage.x1 = Area.x1;
+	if (Area.x2 > rDamage.x2) rDamage.x2 = Area.x2;
+	if (Area.y1 < rDamage.y1) rDamage.y1 = Area.y1;
+	if (Area.y2 > rDamage.y2) rDamage.y2 = Area.y2;
+}
+
+int CWindowCompositor::FindWindow (CCompositedWindow *pWindow) const
+{
+	for (unsigned i = 0; i < m_nWindows; i++)
+	{
+		if (m_pWindow[i] == pWindow)
+		{
+			return i;
+		}
+	}
+
+	return -1;
+}
+
+void CWindowCompositor::Compose (const CDisplay::TArea &rArea)
+{
+	assert (m_pComposeBuffer);
+	assert (rArea.x2 < m_nWidth && rArea.y2 < m_nHeight);
+
+	unsigned nWidth = rArea.x2 - rArea.x1 + 1;
+	unsigned nHeight = rArea.y2 - rArea.y1 + 1;
+	unsigned nPitch = nWidth * m_nBytesPerPixel;
+
+	// the windows below a window, which covers the whole area, are not visible
+	int nFirst = -1;
+	for (int i = m_nWindows-1; i >= 0; i--)
+	{
+		if (   m_pWindow[i]->m_bShown
+		    && Contains (m_pWindow[i]->GetScreenArea (), rArea))
+		{
+			nFirst = i;
+
+			break;
+		}
+	}
+
+	if (nFirst < 0)
+	{
+		switch (m_nBytesPerPixel)
+		{
+		case 1:
+			memset (m_pComposeBuffer, m_BackgroundColor, nPitch);
+			break;
+
+		case 2: {
+			u16 *pLine = (u16 *) m_pComposeBuffer;
+			for (unsigned x = 0; x < nWidth; x++)
+			{
+				pLine[x] = (u16) m_BackgroundColor;
+			}
+			} break;
+
+		case 4: {
+			u32 *pLine = (u32 *) m_pComposeBuffer;
+			for (unsigned x = 0; x < nWidth; x++)
+			{
+				pLine[x] = m_BackgroundColor;
+			}
+			} break;
+
+		default:
+			assert (0);
+			break;
+		}
+
+		for (unsigned y = 1; y < nHeight; y++)
+		{
+			memcpy (m_pComposeBuffer + y * nPitch, m_pComposeBuffer, nPitch);
+		}
+
+		nFirst = 0;
+	}
+
+	for (unsigned i = nFirst; i < m_nWindows; i++)
+	{
+		const CCompositedWindow *pWindow = m_pWindow[i];
+		assert (pWindow);
+
+		CDisplay::TArea Area;
+		if (   !pWindow->m_bShown
+		    || !Intersect (pWindow->GetScreenArea (), rArea, &Area))
+		{
+			continue;
+		}
+
+		unsigned nBytes = (Area.x2 - Area.x1 + 1) * m_nBytesPerPixel;
+		u8 *pTo = m_pComposeBuffer + (Area.y1 - rArea.y1) * nPitch
+					   + (Area.x1 - rArea.x1) * m_nBytesPerPixel;
+		unsigned nFromX = (Area.x1 - pWindow->m_nPosX) * m_nBytesPerPixel;
+
+		for (unsigned y = Area.y1; y <= Area.y2; y++)
+		{
+			memcpy (pTo, pWindow->GetLine (y - pWindow->m_nPosY) + nFromX, nBytes);
+
+			pTo += nPitch;
+		}
+	}
+
+	m_pDisplay->SetArea (rArea, m_pComposeBuffer);
+}
+
+boolean CWindowCompositor::Intersect (const CDisplay::TArea &rArea1, const CDisplay::TArea &rArea2,
+				      CDisplay::TArea *pResult)
+{
+	assert (pResult);
+
+	pResult->x1 = rArea1.x1 > rArea2.x1 ? rArea1.x1 : rArea2.x1;
+	pResult->x2 = rArea1.x2 < rArea2.x2 ? rArea1.x2 : rArea2.x2;
+	pResult->y1 = rArea1.y1 > rArea2.y1 ? rArea1.y1 : rArea2.y1;
+	pResult->y2 = rArea1.y2 < rArea2.y2 ? rArea1.y2 : rArea2.y2;
+
+	return    pResult->x1 <= pResult->x2
+	       && pResult->y1 <= pResult->y2;
+}
+
+boolean CWindowCompositor::Contains (const CDisplay::TArea &rOuter, const CDisplay::TArea &rInner)
+{
+	return    rOuter.x1 <= rInner.x1
+	       && rOuter.x2 >= rInner.x2
+	       && rOuter.y1 <= rInner.y1
+	       && rOuter.y2 >= rInner.y2;
+}
+
+//// CCompositedWindow /////////////////////////////////////////////////////////
+
+CCompositedWindow::CCompositedWindow (CWindowCompositor *pCompositor, const TArea &rArea)
+:	CDisplay (pCompositor->GetDisplay ()->GetColorModel ()),
+	m_pCompositor (pCompositor),
+	m_nPosX (rArea.x1),
+	m_nPosY (rArea.y1),
+	m_nWidth (rArea.x2 - rArea.x1 + 1),
+	m_nHeight (rArea.y2 - rArea.y1 + 1),
+	m_nBytesPerPixel (pCompositor->GetDisplay ()->GetDepth () / 8),
+	m_nPitch (m_nWidth * m_nBytesPerPixel),
+	m_bShown (TRUE)
+{
+	assert (m_pCompositor);
+	assert (rArea.x1 <= rArea.x2 && rArea.y1 <= rArea.y2);
+	assert (m_nBytesPerPixel > 0);
+
+	m_pSurface = new u8[m_nPitch * m_nHeight];
+	assert (m_pSurface);
+	memset (m_pSurface, 0, m_nPitch * m_nHeight);
+
+	if (!m_pCompositor->AddWindow (this))
+	{
+		assert (0);		// too many windows
+	}
+}
+
+CCompositedWindow::~CCompositedWindow (void)
+{
+	assert (m_pCompositor);
+	m_pCompositor->RemoveWindow (this);
+	m_pCompositor = nullptr;
+
+	delete [] m_pSurface;
+	m_pSurface = nullptr;
+}
+
+unsigned CCompositedWindow::GetWidth (void) const
+{
+	return m_nWidth;
+}
+
+unsigned CCompositedWindow::GetHeight (void) const
+{
+	return m_nHeight;
+}
+
+unsigned CCompositedWindow::GetDepth (void) const
+{
+	return m_nBytesPerPixel * 8;
+}
+
+void CCompositedWindow::SetPixel (unsigned nPosX, unsigned nPosY, TRawColor nColor)
+{
+	if (   nPosX >= m_nWidth
+	    || nPosY >= m_nHeight)
+	{
+		return;
+	}
+
+	u8 *pPixel = m_pSurface + nPosY * m_nPitch + nPosX * m_nBytesPerPixel;
+	switch (m_nBytesPerPixel)
+	{
+	case 1:
+		*pPixel = (u8) nColor;
+		break;
+
+	case 2:
+		*(u16 *) pPixel = (u16) nColor;
+		break;
+
+	case 4:
+		*(u32 *) pPixel = nColor;
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+
+	if (m_bShown)
+	{
+		TArea Area {m_nPosX + nPosX, m_nPosX + nPosX, m_nPosY + nPosY, m_nPosY + nPosY};
+		m_pCompositor->AddDamage (Area);
+	}
+}
+
+void CCompositedWindow::SetArea (const TArea &rArea, const void *pPixels,
+				 TAreaCompletionRoutine *pRoutine, void *pParam)
+{
+	assert (pPixels);
+
+	if (   rArea.x1 <= rArea.x2
+	    && rArea.y1 <= rArea.y2
+	    && rArea.x2 < m_nWidth
+	    && rArea.y2 < m_nHeight)
+	{
+		unsigned nBytes = (rArea.x2 - rArea.x1 + 1) * m_nBytesPerPixel;
+		const u8 *pFrom = (const u8 *) pPixels;
+		u8 *pTo = m_pSurface + rArea.y1 * m_nPitch + rArea.x1 * m_nBytesPerPixel;
+
+		for (unsigned y = rArea.y1; y <= rArea.y2; y++)
+		{
+			memcpy (pTo, pFrom, nBytes);
+
+			pFrom += nBytes;
+			pTo += m_nPitch;
+		}
+
+		if (m_bShown)
+		{
+			TArea Area {m_nPosX + rArea.x1, m_nPosX + rArea.x2,
+				    m_nPosY + rArea.y1, m_nPosY + rArea.y2};
+			m_pCompositor->AddDamage (Area);
+		}
+	}
+
+	if (pRoutine)
+	{
+		(*pRoutine) (pParam);
+	}
+}
+
+CDisplay *CCompositedWindow::GetParent (void) const
+{
+	assert (m_pCompositor);
+	return m_pCompositor->GetDisplay ();
+}
+
+unsigned CCompositedWindow::GetOffsetX (void) const
+{
+	return m_nPosX;
+}
+
+unsigned CCompositedWindow::GetOffsetY (void) const
+{
+	return m_nPosY;
+}
+
+void CCompositedWindow::Raise (void)
+{
+	assert (m_pCompositor);
+	m_pCompositor->RaiseWindow (this);
+}
+
+void CCompositedWindow::Lower (void)
+{
+	assert (m_pCompositor);
+	m_pCompositor->LowerWindow (this);
+}
+
+void CCompositedWindow::Move (unsigned nPosX, unsigned nPosY)
+{
+	assert (m_pCompositor);
+	m_pCompositor->MoveWindow (this, nPosX, nPosY);
+}
+
+void CCompositedWindow::Show (boolean bShow)
+{
+	assert (m_pCompositor);
+	m_pCompositor->ShowWindow (this, bShow);
+}
+
+boolean CCompositedWindow::IsShown (void) const
+{
+	return m_bShown;
+}
+
+CDisplay::TArea CCompositedWindow::GetScreenArea (void) const
+{
+	TArea Area {m_nPosX, m_nPosX + m_nWidth - 1, m_nPosY, m_nPosY + m_nHeight - 1};
+
+	return Area;
+}
@@ -0,0 +1,217 @@
+//
+// bootimage.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "bootimage.h"
+#include <circle/chainboot.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define BLOCKS(size)	(((size) + BOOT_IMAGE_BLOCK_SIZE-1) / BOOT_IMAGE_BLOCK_SIZE)
+
+static const char FromBootImage[] = "bootimg";
+
+u32 CBootImage::s_CRC32Table[256];
+boolean CBootImage::s_bCRC32TableValid = FALSE;
+
+CBootImage::CBootImage (size_t nMaxSize)
+:	m_nMaxSize (nMaxSize),
+	m_pBuffer (0),
+	m_nSize (0),
+	m_nCRC32 (0),
+	m_pReceivedMap (0),
+	m_nReceivedBlocks (0)
+{
+}
+
+CBootImage::~CBootImage (void)
+{
+	delete [] m_pReceivedMap;
+	m_pReceivedMap = 0;
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+boolean CBootImage::Initialize (void)
+{
+	InitCRC32Table ();
+
+	m_pBuffer = new u8[m_nMaxSize];
+	m_pReceivedMap = new u8[(BLOCKS (m_nMaxSize) + 7) / 8];
+
+	return m_pBuffer != 0 && m_pReceivedMap != 0;
+}
+
+boolean CBootImage::Begin (u32 nSize, u32 nCRC32)
+{
+	if (   nSize == 0
+	    || nSize > m_nMaxSize)
+	{
+		return FALSE;
+	}
+
+	if (   nSize != m_nSize
+	    || nCRC32 != m_nCRC32)
+	{
+		m_nSize = nSize;
+		m_nCRC32 = nCRC32;
+
+		ResetReceived ();
+	}
+
+	return TRUE;
+}
+
+u8 *CBootImage::GetData (u32 nOffset, u32 nLength)
+{
+	if (   m_pBuffer == 0
+	    || nOffset > m_nSize
+	    || nLength > m_nSize - nOffset)
+	{
+		return 0;
+	}
+
+	return m_pBuffer + nOffset;
+}
+
+boolean CBootImage::Write (u32 nOffset, const void *pData, u32 nLength)
+{
+	u8 *pBuffer = GetData (nOffset, nLength);
+	if (pBuffer == 0)
+	{
+		return FALSE;
+	}
+
+	assert (pData != 0);
+	memcpy (pBuffer, pData, nLength);
+
+	MarkReceived (nOffset, nLength);
+
+	return TRUE;
+}
+
+void CBootImage::MarkReceived (u32 nOffset, u32 nLength)
+{
+	assert (m_pReceivedMap != 0);
+	assert (nOffset + nLength <= m_nSize);
+
+	unsigned nBlock = BLOCKS (nOffset);
+	unsigned nEndBlock = nOffset + nLength == m_nSize ? BLOCKS (m_nSize)
+						       : (nOffset + nLength) / BOOT_IMAGE_BLOCK_SIZE;
+
+	for (; nBlock < nEndBlock; nBlock++)
+	{
+		u8 nMask = 1 << (nBlock & 7);
+		if (!(m_pReceivedMap[nBlock / 8] & nMask))
+		{
+			m_pReceivedMap[nBlock / 8] |= nMask;
+			m_nReceivedBlocks++;
+		}
+	}
+}
+
+boolean CBootImage::IsComplete (void) const
+{
+	return    m_nSize != 0
+	       && m_nReceivedBlocks == BLOCKS (m_nSize);
+}
+
+void CBootImage::ResetReceived (void)
+{
+	assert (m_pReceivedMap != 0);
+	memset (m_pReceivedMap, 0, (BLOCKS (m_nMaxSize) + 7) / 8);
+
+	m_nReceivedBlocks = 0;
+}
+
+u32 CBootImage::GetBlockCRC32 (u32 nOffset, u32 nBlockSize) const
+{
+	assert (m_pBuffer != 0);
+	assert (nOffset < m_nSize);
+
+	if (nBlockSize > m_nSize - nOffset)
+	{
+		nBlockSize = m_nSize - nOffset;
+	}
+
+	return CRC32 (m_pBuffer + nOffset, nBlockSize);
+}
+
+boolean CBootImage::Boot (void)
+{
+	if (m_nSize == 0)
+	{
+		return FALSE;
+	}
+
+	assert (m_pBuffer != 0);
+	u32 nCRC32 = CRC32 (m_pBuffer, m_nSize);
+	if (nCRC32 != m_nCRC32)
+	{
+		CLogger::Get ()->Write (FromBootImage, LogWarning,
+					"CRC32 mismatch (0x%08X, expected 0x%08X)", nCRC32, m_nCRC32);
+
+		return FALSE;
+	}
+
+	CLogger::Get ()->Write (FromBootImage, LogDebug, "%u bytes verified", m_nSize);
+
+	EnableChainBoot (m_pBuffer, m_nSize);
+
+	return TRUE;
+}
+
+u32 CBootImage::CRC32 (const void *pData, size_t nLength, u32 nCRC)
+{
+	assert (s_bCRC32TableValid);
+
+	const u8 *p = (const u8 *) pData;
+	assert (p != 0);
+
+	nCRC = ~nCRC;
+	while (nLength--)
+	{
+		nCRC = s_CRC32Table[(nCRC ^ *p++) & 0xFF] ^ (nCRC >> 8);
+	}
+
+	return ~nCRC;
+}
+
+void CBootImage::InitCRC32Table (void)
+{
+	if (s_bCRC32TableValid)
+	{
+		return;
+	}
+
+	// IEEE 802.3 polynomial (reflected), as used by zlib.crc32()
+	for (unsigned i = 0; i < 256; i++)
+	{
+		u32 nValue = i;
+		for (unsigned j = 0; j < 8; j++)
+		{
+			nValue = nValue & 1 ? 0xEDB88320U ^ (nValue >> 1) : nValue >> 1;
+		}
+
+		s_CRC32Table[i] = nValue;
+	}
+
+	s_bCRC32TableValid = TRUE;
+}
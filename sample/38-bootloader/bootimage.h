@@ -0,0 +1,80 @@
+//
+// bootimage.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _bootimage_h
+#define _bootimage_h
+
+#include <circle/types.h>
+
+#define BOOT_IMAGE_BLOCK_SIZE	1024		// granularity of received data tracking
+
+// Receive buffer for a kernel image, which is transferred in pieces (possibly out of order
+// or repeatedly) and verified with a CRC32 before chain boot. The buffer contents are kept,
+// when a new transfer starts, so that a delta transfer has only to send modified blocks.
+class CBootImage
+{
+public:
+	CBootImage (size_t nMaxSize);
+	~CBootImage (void);
+
+	boolean Initialize (void);
+
+	// announce the image to be received, resets the tracking of received blocks,
+	// if the image differs from the previously announced one
+	boolean Begin (u32 nSize, u32 nCRC32);
+
+	u32 GetSize (void) const		{ return m_nSize; }
+	u32 GetCRC32 (void) const		{ return m_nCRC32; }
+
+	// returns pointer to image data at nOffset (0 if not in image)
+	u8 *GetData (u32 nOffset, u32 nLength);
+	// write data into the image and mark the completely covered blocks as received
+	boolean Write (u32 nOffset, const void *pData, u32 nLength);
+	// mark data, which has been written to GetData() directly, as received
+	void MarkReceived (u32 nOffset, u32 nLength);
+
+	boolean IsComplete (void) const;
+	void ResetReceived (void);
+
+	// CRC32 of one block of the current buffer contents (nBlockSize up to the image end)
+	u32 GetBlockCRC32 (u32 nOffset, u32 nBlockSize) const;
+
+	// verifies the image with the CRC32 and enables chain boot on success
+	boolean Boot (void);
+
+	static u32 CRC32 (const void *pData, size_t nLength, u32 nCRC = 0);
+
+private:
+	static void InitCRC32Table (void);
+
+private:
+	size_t m_nMaxSize;
+
+	u8 *m_pBuffer;
+	u32 m_nSize;
+	u32 m_nCRC32;
+
+	u8 *m_pReceivedMap;		// one bit per block
+	unsigned m_nReceivedBlocks;
+
+	static u32 s_CRC32Table[256];
+	static boolean s_bCRC32TableValid;
+};
+
+#endif
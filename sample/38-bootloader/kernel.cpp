@@ -20,11 +20,17 @@
 #include "kernel.h"
 #include "httpbootserver.h"
 #include "tftpbootserver.h"
+#include "tcpbootserver.h"
+#include "multicastbootreceiver.h"
 #include <circle/chainboot.h>
 #include <circle/sysconfig.h>
 #include <assert.h>
 
 #define HTTP_BOOT_PORT		8080
+#define TCP_BOOT_PORT		8081
+#define MULTICAST_BOOT_PORT	8082
+
+static const u8 MulticastBootGroup[] = {239, 255, 38, 1};
 
 // Network configuration
 #define USE_DHCP
@@ -42,10 +48,11 @@ CKernel::CKernel (void)
 :	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
 	m_Timer (&m_Interrupt),
 	m_Logger (m_Options.GetLogLevel (), &m_Timer),
-	m_USBHCI (&m_Interrupt, &m_Timer)
+	m_USBHCI (&m_Interrupt, &m_Timer),
 #ifndef USE_DHCP
-	, m_Net (IPAddress, NetMask, DefaultGateway, DNSServer)
+	m_Net (IPAddress, NetMask, DefaultGateway, DNSServer),
 #endif
+	m_BootImage (KERNEL_MAX_SIZE)
 {
 }
 
@@ -98,6 +105,11 @@ boolean CKernel::Initialize (void)
 		bOK = m_Net.Initialize ();
 	}
 
+	if (bOK)
+	{
+		bOK = m_BootImage.Initialize ();
+	}
+
 	return bOK;
 }
 
@@ -112,9 +124,15 @@ TShutdownMode CKernel::Run (void)
 	m_Logger.Write (FromKernel, LogNotice,
 			"Try \"tftp -m binary %s -c put kernel.img\" from another computer!",
 			(const char *) IPString);
+	m_Logger.Write (FromKernel, LogNotice,
+			"Try \"netboot.py %s kernel.img\" for a fast transfer via TCP!",
+			(const char *) IPString);
 
 	new CHTTPBootServer (&m_Net, HTTP_BOOT_PORT, KERNEL_MAX_SIZE + 2000);
 	new CTFTPBootServer (&m_Net, KERNEL_MAX_SIZE);
+	new CTCPBootServer (&m_Net, TCP_BOOT_PORT, &m_BootImage);
+	new CMulticastBootReceiver (&m_Net, CIPAddress (MulticastBootGroup), MULTICAST_BOOT_PORT,
+				    &m_BootImage);
 
 	for (unsigned nCount = 0; !IsChainBootEnabled (); nCount++)
 	{
@@ -31,6 +31,7 @@
 #include <circle/usb/usbhcidevice.h>
 #include <circle/sched/scheduler.h>
 #include <circle/net/netsubsystem.h>
+#include "bootimage.h"
 #include <circle/types.h>
 
 enum TShutdownMode
@@ -63,6 +64,8 @@ private:
 	CUSBHCIDevice		m_USBHCI;
 	CScheduler		m_Scheduler;
 	CNetSubSystem		m_Net;
+
+	CBootImage		m_BootImage;
 };
 
 #endif
@@ -0,0 +1,112 @@
+//
+// multicastbootreceiver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "multicastbootreceiver.h"
+#include <circle/net/socket.h>
+#include <circle/net/in.h>
+#include <circle/netdevice.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <assert.h>
+
+static const char FromMulticastBoot[] = "mcastboot";
+
+CMulticastBootReceiver::CMulticastBootReceiver (CNetSubSystem *pNetSubSystem,
+						const CIPAddress &rGroupAddress,
+						u16 nPort, CBootImage *pImage)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_GroupAddress (rGroupAddress),
+	m_nPort (nPort),
+	m_pImage (pImage)
+{
+}
+
+CMulticastBootReceiver::~CMulticastBootReceiver (void)
+{
+}
+
+void CMulticastBootReceiver::Run (void)
+{
+	assert (m_pNetSubSystem != 0);
+	CSocket Socket (m_pNetSubSystem, IPPROTO_UDP);
+
+	if (   Socket.Bind (m_nPort) < 0
+	    || Socket.SetOptionAddMembership (m_GroupAddress) < 0)
+	{
+		CLogger::Get ()->Write (FromMulticastBoot, LogError, "Cannot join group");
+
+		return;
+	}
+
+	// queue a burst of datagrams, while the receiving task is not running
+	Socket.SetOptionReceiveBuffer (64 * FRAME_BUFFER_SIZE);
+
+	assert (m_pImage != 0);
+
+	while (1)
+	{
+		u8 Buffer[FRAME_BUFFER_SIZE];
+		CIPAddress ForeignIP;
+		u16 nForeignPort;
+		int nResult = Socket.ReceiveFrom (Buffer, sizeof Buffer, 0, &ForeignIP, &nForeignPort);
+		if (nResult < (int) sizeof (TMulticastBootHeader))
+		{
+			continue;
+		}
+
+		const TMulticastBootHeader *pHeader = (const TMulticastBootHeader *) Buffer;
+		u32 nLength = nResult - sizeof (TMulticastBootHeader);
+		if (   pHeader->nMagic != MULTICAST_BOOT_MAGIC
+		    || pHeader->nOffset % BOOT_IMAGE_BLOCK_SIZE != 0
+		    || nLength > BOOT_IMAGE_BLOCK_SIZE)
+		{
+			continue;
+		}
+
+		if (   pHeader->nImageSize != m_pImage->GetSize ()
+		    || pHeader->nImageCRC32 != m_pImage->GetCRC32 ())
+		{
+			if (!m_pImage->Begin (pHeader->nImageSize, pHeader->nImageCRC32))
+			{
+				continue;
+			}
+
+			CString IPString;
+			ForeignIP.Format (&IPString);
+			CLogger::Get ()->Write (FromMulticastBoot, LogDebug,
+						"Receiving %u bytes from %s ...",
+						pHeader->nImageSize, (const char *) IPString);
+		}
+
+		if (   !m_pImage->Write (pHeader->nOffset, Buffer + sizeof (TMulticastBootHeader),
+					 nLength)
+		    || !m_pImage->IsComplete ())
+		{
+			continue;
+		}
+
+		if (m_pImage->Boot ())
+		{
+			break;
+		}
+
+		// corrupted image, receive it again from the next round
+		m_pImage->ResetReceived ();
+	}
+}
@@ -0,0 +1,65 @@
+//
+// multicastbootreceiver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _multicastbootreceiver_h
+#define _multicastbootreceiver_h
+
+#include "bootimage.h"
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/ipaddress.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+// Multicast boot protocol (all values little endian):
+//
+// The host sends the image in UDP datagrams to a multicast group, so that any number of
+// boards receive it at the same time. Each datagram holds a TMulticastBootHeader, followed
+// by up to BOOT_IMAGE_BLOCK_SIZE bytes of image data at an offset, which is a multiple of
+// BOOT_IMAGE_BLOCK_SIZE. A board boots, when all blocks have been received and the CRC32
+// matches. Blocks lost on a board can be repaired with a delta transfer via TCP.
+
+#define MULTICAST_BOOT_MAGIC		0x4D424343	// "CCBM"
+
+struct TMulticastBootHeader
+{
+	u32	nMagic;
+	u32	nImageSize;
+	u32	nImageCRC32;
+	u32	nOffset;
+}
+PACKED;
+
+class CMulticastBootReceiver : public CTask
+{
+public:
+	CMulticastBootReceiver (CNetSubSystem *pNetSubSystem, const CIPAddress &rGroupAddress,
+				u16 nPort, CBootImage *pImage);
+	~CMulticastBootReceiver (void);
+
+	void Run (void);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	CIPAddress m_GroupAddress;
+	u16 m_nPort;
+	CBootImage *m_pImage;
+};
+
+#endif
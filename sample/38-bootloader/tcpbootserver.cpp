@@ -0,0 +1,253 @@
+//
+// tcpbootserver.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "tcpbootserver.h"
+#include <circle/net/in.h>
+#include <circle/logger.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define BLOCK_SIZE_MIN		256
+#define CRC_CHUNK_SIZE		256		// CRCs per Send()
+#define RECEIVE_BUFFER_SIZE	0x40000
+
+static const char FromBootServer[] = "tcpboot";
+
+CTCPBootServer::CTCPBootServer (CNetSubSystem *pNetSubSystem, u16 nPort, CBootImage *pImage)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_nPort (nPort),
+	m_pImage (pImage),
+	m_pConnection (0)
+{
+}
+
+CTCPBootServer::~CTCPBootServer (void)
+{
+	assert (m_pConnection == 0);
+}
+
+void CTCPBootServer::Run (void)
+{
+	assert (m_pNetSubSystem != 0);
+	CSocket Socket (m_pNetSubSystem, IPPROTO_TCP);
+
+	// a large receive window keeps the data flowing, while a segment is processed
+	Socket.SetOptionReceiveBuffer (RECEIVE_BUFFER_SIZE);
+
+	if (   Socket.Bind (m_nPort) < 0
+	    || Socket.Listen (1) < 0)
+	{
+		CLogger::Get ()->Write (FromBootServer, LogError, "Cannot listen on port %u", m_nPort);
+
+		return;
+	}
+
+	while (1)
+	{
+		CIPAddress ForeignIP;
+		u16 nForeignPort;
+		m_pConnection = Socket.Accept (&ForeignIP, &nForeignPort);
+		if (m_pConnection == 0)
+		{
+			continue;
+		}
+
+		CString IPString;
+		ForeignIP.Format (&IPString);
+		CLogger::Get ()->Write (FromBootServer, LogDebug, "Connection from %s",
+					(const char *) IPString);
+
+		m_nBufferOffset = 0;
+		m_nBufferValid = 0;
+
+		Serve ();
+
+		delete m_pConnection;			// closes connection
+		m_pConnection = 0;
+	}
+}
+
+void CTCPBootServer::Serve (void)
+{
+	assert (m_pImage != 0);
+
+	TTCPBootHeader Header;
+	while (Receive (&Header, sizeof Header))
+	{
+		if (Header.nMagic != TCP_BOOT_MAGIC)
+		{
+			CLogger::Get ()->Write (FromBootServer, LogWarning, "Invalid request");
+
+			return;
+		}
+
+		switch (Header.nCommand)
+		{
+		case TCP_BOOT_CMD_BEGIN:
+			CLogger::Get ()->Write (FromBootServer, LogDebug, "Receiving %u bytes ...",
+						Header.nParam1);
+
+			if (!SendStatus (m_pImage->Begin (Header.nParam1, Header.nParam2)
+					 ? TCP_BOOT_STATUS_OK : TCP_BOOT_STATUS_INVALID))
+			{
+				return;
+			}
+			break;
+
+		case TCP_BOOT_CMD_DATA: {
+				// the payload is received into the image buffer directly
+				u8 *pData = m_pImage->GetData (Header.nParam1, Header.nParam2);
+				if (   pData == 0
+				    || !Receive (pData, Header.nParam2))
+				{
+					return;
+				}
+
+				m_pImage->MarkReceived (Header.nParam1, Header.nParam2);
+			} break;
+
+		case TCP_BOOT_CMD_BLOCKCRC:
+			if (!ReceiveBlockCRCs (Header.nParam1))
+			{
+				return;
+			}
+			break;
+
+		case TCP_BOOT_CMD_BOOT:
+			if (m_pImage->Boot ())
+			{
+				SendStatus (TCP_BOOT_STATUS_OK);
+
+				return;
+			}
+
+			if (!SendStatus (TCP_BOOT_STATUS_CRC_ERROR))
+			{
+				return;
+			}
+			break;
+
+		default:
+			CLogger::Get ()->Write (FromBootServer, LogWarning, "Unknown command %u",
+						Header.nCommand);
+			return;
+		}
+	}
+}
+
+boolean CTCPBootServer::ReceiveBlockCRCs (u32 nBlockSize)
+{
+	assert (m_pImage != 0);
+	u32 nSize = m_pImage->GetSize ();
+
+	if (   nBlockSize < BLOCK_SIZE_MIN
+	    || nSize == 0)
+	{
+		u32 nCount = 0;
+
+		return m_pConnection->Send (&nCount, sizeof nCount, 0) == sizeof nCount;
+	}
+
+	u32 nCount = (nSize + nBlockSize-1) / nBlockSize;
+	if (m_pConnection->Send (&nCount, sizeof nCount, MSG_MORE) != sizeof nCount)
+	{
+		return FALSE;
+	}
+
+	u32 CRCs[CRC_CHUNK_SIZE];
+	for (u32 nBlock = 0; nBlock < nCount; )
+	{
+		unsigned i;
+		for (i = 0; i < CRC_CHUNK_SIZE && nBlock < nCount; i++, nBlock++)
+		{
+			CRCs[i] = m_pImage->GetBlockCRC32 (nBlock * nBlockSize, nBlockSize);
+		}
+
+		int nLength = i * sizeof (u32);
+		if (m_pConnection->Send (CRCs, nLength, nBlock < nCount ? MSG_MORE : 0) != nLength)
+		{
+			return FALSE;
+		}
+	}
+
+	return TRUE;
+}
+
+boolean CTCPBootServer::Receive (void *pBuffer, unsigned nLength)
+{
+	assert (m_pConnection != 0);
+
+	u8 *p = (u8 *) pBuffer;
+	assert (p != 0);
+
+	while (nLength > 0)
+	{
+		if (m_nBufferOffset < m_nBufferValid)
+		{
+			unsigned nChunk = m_nBufferValid - m_nBufferOffset;
+			if (nChunk > nLength)
+			{
+				nChunk = nLength;
+			}
+
+			memcpy (p, m_Buffer + m_nBufferOffset, nChunk);
+			m_nBufferOffset += nChunk;
+
+			p += nChunk;
+			nLength -= nChunk;
+
+			continue;
+		}
+
+		// a segment fits completely, receive it without intermediate copy
+		int nResult;
+		if (nLength >= FRAME_BUFFER_SIZE)
+		{
+			nResult = m_pConnection->Receive (p, nLength, 0);
+			if (nResult <= 0)
+			{
+				return FALSE;
+			}
+
+			p += nResult;
+			nLength -= nResult;
+
+			continue;
+		}
+
+		nResult = m_pConnection->Receive (m_Buffer, sizeof m_Buffer, 0);
+		if (nResult <= 0)
+		{
+			return FALSE;
+		}
+
+		m_nBufferOffset = 0;
+		m_nBufferValid = nResult;
+	}
+
+	return TRUE;
+}
+
+boolean CTCPBootServer::SendStatus (u32 nStatus)
+{
+	assert (m_pConnection != 0);
+
+	return m_pConnection->Send (&nStatus, sizeof nStatus, 0) == sizeof nStatus;
+}
@@ -0,0 +1,87 @@
+//
+// tcpbootserver.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _tcpbootserver_h
+#define _tcpbootserver_h
+
+#include "bootimage.h"
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/netdevice.h>
+#include <circle/macros.h>
+#include <circle/types.h>
+
+// TCP boot protocol (all values little endian):
+//
+// Each request starts with a TTCPBootHeader. The server answers BEGIN and BOOT with a u32
+// status (TCP_BOOT_STATUS_*) and BLOCKCRC with a u32 block count, followed by the CRC32 of
+// each block. DATA is not answered, the payload follows immediately behind the header.
+//
+// Full transfer:	BEGIN (size, crc32), DATA (0, size), BOOT
+// Delta transfer:	BEGIN (size, crc32), BLOCKCRC (block size), DATA for the modified blocks, BOOT
+
+#define TCP_BOOT_MAGIC			0x54424343	// "CCBT"
+
+#define TCP_BOOT_CMD_BEGIN		1		// param1: image size, param2: CRC32
+#define TCP_BOOT_CMD_DATA		2		// param1: offset, param2: length
+#define TCP_BOOT_CMD_BLOCKCRC		3		// param1: block size
+#define TCP_BOOT_CMD_BOOT		4
+
+#define TCP_BOOT_STATUS_OK		0
+#define TCP_BOOT_STATUS_INVALID		1
+#define TCP_BOOT_STATUS_CRC_ERROR	2
+
+struct TTCPBootHeader
+{
+	u32	nMagic;
+	u32	nCommand;
+	u32	nParam1;
+	u32	nParam2;
+}
+PACKED;
+
+class CTCPBootServer : public CTask
+{
+public:
+	CTCPBootServer (CNetSubSystem *pNetSubSystem, u16 nPort, CBootImage *pImage);
+	~CTCPBootServer (void);
+
+	void Run (void);
+
+private:
+	void Serve (void);
+	boolean ReceiveBlockCRCs (u32 nBlockSize);
+
+	boolean Receive (void *pBuffer, unsigned nLength);
+	boolean SendStatus (u32 nStatus);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	u16 m_nPort;
+	CBootImage *m_pImage;
+
+	CSocket *m_pConnection;
+
+	u8 m_Buffer[FRAME_BUFFER_SIZE];		// received segment, not consumed yet
+	unsigned m_nBufferOffset;
+	unsigned m_nBufferValid;
+};
+
+#endif
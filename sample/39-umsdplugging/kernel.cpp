@@ -27,7 +27,7 @@
 	#define DRIVE		"USB:"		// "USB2:", "USB3:"
 	#define DEVICE		"umsd1"		// "umsd2", "umsd3"
 #else
-	#define DRIVE		"umsd1"
+	#define DEVICE		"umsd1"
 	#define PARTITION	"umsd1-1"
 #endif
 
@@ -38,9 +38,11 @@ CKernel::CKernel (void)
 	m_Timer (&m_Interrupt),
 	m_Logger (m_Options.GetLogLevel (), &m_Timer),
 	m_USBHCI (&m_Interrupt, &m_Timer, TRUE),		// TRUE: enable plug-and-play
-	m_bStorageAttached (FALSE)
+	m_bStorageAttached (FALSE),
+	m_bStorageAdded (FALSE)
 #ifndef USE_FATFS
-	, m_pFileSystem (0)
+	, m_hPartition (0),
+	m_pFileSystem (0)
 #endif
 {
 	m_ActLED.Blink (5);	// show we are alive
@@ -87,6 +89,13 @@ boolean CKernel::Initialize (void)
 
 	if (bOK)
 	{
+		// get notified, when the flash drive has been registered
+		m_DeviceNameService.RegisterNotificationHandler (DeviceNameHandler, this);
+
+#ifndef USE_FATFS
+		m_hPartition = m_DeviceNameService.GetDeviceHandle (PARTITION, TRUE);
+#endif
+
 		bOK = m_USBHCI.Initialize ();
 	}
 
@@ -106,7 +115,8 @@ TShutdownMode CKernel::Run (void)
 		while (1)
 		{
 			// Update the tree of connected USB devices
-			if (m_USBHCI.UpdatePlugAndPlay ())
+			if (   m_USBHCI.UpdatePlugAndPlay ()
+			    && m_bStorageAdded)
 			{
 				// Try to mount file system
 				FRESULT Result = f_mount (&m_FileSystem, DRIVE, 1);
@@ -168,9 +178,10 @@ TShutdownMode CKernel::Run (void)
 		while (1)
 		{
 			// Update the tree of connected USB devices
-			if (m_USBHCI.UpdatePlugAndPlay ())
+			if (   m_USBHCI.UpdatePlugAndPlay ()
+			    && m_bStorageAdded)
 			{
-				CDevice *pDevice = m_DeviceNameService.GetDevice (DRIVE, TRUE);
+				CDevice *pDevice = m_DeviceNameService.GetDevice (DEVICE, TRUE);
 				if (pDevice != 0)
 				{
 					assert (!m_bStorageAttached);
@@ -184,7 +195,7 @@ TShutdownMode CKernel::Run (void)
 		}
 
 		// Mount file system
-		CDevice *pPartition = m_DeviceNameService.GetDevice (PARTITION, TRUE);
+		CDevice *pPartition = m_DeviceNameService.GetDevice (m_hPartition);
 		if (   pPartition != 0
 		    && (m_pFileSystem = new CFATFileSystem) != 0
 		    && m_pFileSystem->Mount (pPartition))
@@ -249,4 +260,19 @@ void CKernel::StorageRemovedHandler (CDevice *pDevice, void *pContext)
 
 	assert (pThis->m_bStorageAttached);
 	pThis->m_bStorageAttached = FALSE;
+	pThis->m_bStorageAdded = FALSE;
+}
+
+void CKernel::DeviceNameHandler (TDeviceNameEvent Event, const char *pName, CDevice *pDevice,
+				 boolean bBlockDevice, void *pContext)
+{
+	CKernel *pThis = (CKernel *) pContext;
+	assert (pThis != 0);
+
+	if (   Event == DeviceNameAdded
+	    && bBlockDevice
+	    && strcmp (pName, DEVICE) == 0)
+	{
+		pThis->m_bStorageAdded = TRUE;
+	}
 }
@@ -58,6 +58,9 @@ public:
 private:
 	static void StorageRemovedHandler (CDevice *pDevice, void *pContext);
 
+	static void DeviceNameHandler (TDeviceNameEvent Event, const char *pName, CDevice *pDevice,
+				       boolean bBlockDevice, void *pContext);
+
 private:
 	// do not change this order
 	CActLED			m_ActLED;
@@ -72,10 +75,12 @@ private:
 	CUSBHCIDevice		m_USBHCI;
 
 	volatile boolean	m_bStorageAttached;
+	volatile boolean	m_bStorageAdded;
 
 #ifdef USE_FATFS
 	FATFS			m_FileSystem;
 #else
+	TDeviceHandle		m_hPartition;
 	CFATFileSystem	       *m_pFileSystem;
 #endif
 };
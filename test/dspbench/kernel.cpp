@@ -0,0 +1,309 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include <circle/dsp/biquad.h>
+#include <circle/dsp/dspmath.h>
+#include <circle/dsp/fastconvolver.h>
+#include <circle/dsp/fft.h>
+#include <circle/dsp/fir.h>
+#include <circle/dsp/windowfunction.h>
+
+#define BLOCK_SIZE	4096		// samples per call
+#define ITERATIONS	100
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_CPUThrottle (CPUSpeedMaximum),
+	m_pInput (new float[BLOCK_SIZE * 2]),
+	m_pOutput (new float[BLOCK_SIZE * 8]),
+	m_pInputQ15 (new s16[BLOCK_SIZE]),
+	m_pOutputQ15 (new s16[BLOCK_SIZE]),
+	m_pInputQ31 (new s32[BLOCK_SIZE]),
+	m_pOutputQ31 (new s32[BLOCK_SIZE])
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	m_CPUThrottle.SetSpeed (CPUSpeedMaximum, TRUE);
+	m_Logger.Write (FromKernel, LogNotice, "CPU clock %u MHz",
+			m_CPUThrottle.GetClockRate () / 1000000);
+
+	// a chirp with some headroom
+	for (unsigned i = 0; i < BLOCK_SIZE * 2; i++)
+	{
+		m_pInput[i] = 0.5f * (float) CDSPMath::Sin (i * i * 0.0001);
+	}
+
+	for (unsigned i = 0; i < BLOCK_SIZE; i++)
+	{
+		m_pInputQ15[i] = CDSPMath::FloatToQ15 (m_pInput[i]);
+		m_pInputQ31[i] = CDSPMath::FloatToQ31 (m_pInput[i]);
+	}
+
+	BenchWindow ();
+	BenchBiquad ();
+	BenchFIR ();
+	BenchFFT ();
+	BenchConvolver ();
+
+	m_Logger.Write (FromKernel, LogNotice, "Benchmark finished");
+
+	return ShutdownHalt;
+}
+
+void CKernel::BenchWindow (void)
+{
+	float *pWindow = new float[BLOCK_SIZE];
+
+	CWindowFunction::Generate (WindowBlackmanHarris, pWindow, BLOCK_SIZE);
+
+	u64 nStart = CTimer::GetClockTicks64 ();
+	for (unsigned i = 0; i < ITERATIONS; i++)
+	{
+		CWindowFunction::Apply (pWindow, m_pOutput, BLOCK_SIZE);
+	}
+	Report ("window-apply", nStart, BLOCK_SIZE * ITERATIONS);
+
+	delete [] pWindow;
+}
+
+void CKernel::BenchBiquad (void)
+{
+	TBiquadCoefficients Coeffs;
+	CBiquadCascade::Design (&Coeffs, BiquadLowPass, 48000.0f, 1000.0f, 0.7071f);
+
+	static const unsigned Stages[] = {1, 4};
+	for (unsigned i = 0; i < sizeof Stages / sizeof Stages[0]; i++)
+	{
+		CString Name;
+
+		CBiquadCascade Biquad (Stages[i]);
+		CBiquadCascadeQ31 BiquadQ31 (Stages[i]);
+		for (unsigned j = 0; j < Stages[i]; j++)
+		{
+			Biquad.SetCoefficients (j, Coeffs);
+			BiquadQ31.SetCoefficients (j, Coeffs);
+		}
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			Biquad.Process (m_pInput, m_pOutput, BLOCK_SIZE);
+		}
+		Name.Format ("biquad-f32-%u", Stages[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			BiquadQ31.Process (m_pInputQ31, m_pOutputQ31, BLOCK_SIZE);
+		}
+		Name.Format ("biquad-q31-%u", Stages[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+	}
+}
+
+void CKernel::BenchFIR (void)
+{
+	static const unsigned Taps[] = {32, 128};
+	for (unsigned i = 0; i < sizeof Taps / sizeof Taps[0]; i++)
+	{
+		CString Name;
+
+		float *pCoeffs = new float[Taps[i]];
+		CFIRFilter::DesignLowPass (pCoeffs, Taps[i], 0.1f);
+
+		CFIRFilter FIR (pCoeffs, Taps[i]);
+		u64 nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			FIR.Process (m_pInput, m_pOutput, BLOCK_SIZE);
+		}
+		Name.Format ("fir-f32-%u", Taps[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+
+		CFIRFilterQ15 FIRQ15 (pCoeffs, Taps[i]);
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			FIRQ15.Process (m_pInputQ15, m_pOutputQ15, BLOCK_SIZE);
+		}
+		Name.Format ("fir-q15-%u", Taps[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+
+		// rate is given in input samples
+		CFIRFilter Decimator (pCoeffs, Taps[i], 4);
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			Decimator.Process (m_pInput, m_pOutput, BLOCK_SIZE);
+		}
+		Name.Format ("fir-decim4-%u", Taps[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+
+		// rate is given in output samples
+		CFIRInterpolator Interpolator (pCoeffs, Taps[i], 4);
+		nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			Interpolator.Process (m_pInput, m_pOutput, BLOCK_SIZE / 4);
+		}
+		Name.Format ("fir-interp4-%u", Taps[i]);
+		Report (Name, nStart, BLOCK_SIZE * ITERATIONS);
+
+		delete [] pCoeffs;
+	}
+}
+
+void CKernel::BenchFFT (void)
+{
+	static const unsigned Sizes[] = {256, 1024, 4096};
+	for (unsigned i = 0; i < sizeof Sizes / sizeof Sizes[0]; i++)
+	{
+		CFFT FFT (Sizes[i]);
+
+		for (unsigned j = 0; j < Sizes[i] * 2; j++)
+		{
+			m_pOutput[j] = m_pInput[j];
+		}
+
+		u64 nStart = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < ITERATIONS; j++)
+		{
+			FFT.Forward (m_pOutput);
+			FFT.Inverse (m_pOutput);
+		}
+
+		// check the round trip
+		float fMaxError = 0.0f;
+		for (unsigned j = 0; j < Sizes[i] * 2; j++)
+		{
+			float fError = m_pOutput[j] - m_pInput[j];
+			if (fError < 0.0f)
+			{
+				fError = -fError;
+			}
+
+			if (fError > fMaxError)
+			{
+				fMaxError = fError;
+			}
+		}
+
+		CString Name;
+		Name.Format ("fft-ifft-%u", Sizes[i]);
+		Report (Name, nStart, Sizes[i] * ITERATIONS);
+
+		m_Logger.Write (FromKernel, LogNotice, "%s round trip error %.7f",
+				(const char *) Name, fMaxError);
+	}
+}
+
+void CKernel::BenchConvolver (void)
+{
+	static const unsigned ImpulseLength = 8192;
+	static const unsigned BlockSize = 256;
+
+	float *pImpulse = new float[ImpulseLength];
+	for (unsigned i = 0; i < ImpulseLength; i++)
+	{
+		pImpulse[i] = m_pInput[i % BLOCK_SIZE] / (i + 1);
+	}
+
+	CFastConvolver Convolver (pImpulse, ImpulseLength, BlockSize);
+
+	u64 nStart = CTimer::GetClockTicks64 ();
+	for (unsigned i = 0; i < ITERATIONS; i++)
+	{
+		for (unsigned j = 0; j < BLOCK_SIZE; j += BlockSize)
+		{
+			Convolver.Process (&m_pInput[j], &m_pOutput[j]);
+		}
+	}
+	Report ("convolver-8192", nStart, BLOCK_SIZE * ITERATIONS);
+
+	delete [] pImpulse;
+}
+
+void CKernel::Report (const char *pName, u64 nStartTicks, unsigned nSamples)
+{
+	u64 nTicks = CTimer::GetClockTicks64 () - nStartTicks;	// microseconds
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	unsigned nRate = (unsigned) ((u64) nSamples * 1000000 / nTicks);
+	unsigned nCycles = (unsigned) (nTicks * (m_CPUThrottle.GetClockRate () / 1000)
+					/ ((u64) nSamples * 1000 / 100));
+
+	m_Logger.Write (FromKernel, LogNotice, "%-16s %9u samples/s  %u.%02u cycles/sample",
+			pName, nRate, nCycles / 100, nCycles % 100);
+}
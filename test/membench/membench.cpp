@@ -0,0 +1,557 @@
+//
+// membench.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "membench.h"
+#include <circle/dmachannel.h>
+#include <circle/machineinfo.h>
+#include <circle/synchronize.h>
+#include <circle/timer.h>
+#include <circle/logger.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#if RASPPI >= 5
+	#include <circle/dmachannel-rp1.h>
+#endif
+
+#define MEASURE_TICKS		(CLOCKHZ / 5)		// duration of each test
+#define START_DELAY_TICKS	(CLOCKHZ / 1000)	// until all cores have started
+
+#define LATENCY_MIN_SIZE	(4 * 1024)
+#define LATENCY_MAX_SIZE	(32 * MEGABYTE)
+#define LATENCY_STRIDE		64			// one pointer per cache line
+#define LATENCY_LOADS		(2 * 1024 * 1024)
+
+#define BANDWIDTH_L1_SIZE	(16 * 1024)
+#define BANDWIDTH_L2_SIZE	(128 * 1024)
+#define BANDWIDTH_DRAM_SIZE	(16 * MEGABYTE)
+
+#define UNCACHED_SIZE		(4 * 1024)
+#define COHERENT_SLOT_MEMBENCH	COHERENT_SLOT_VCHIQ_END	// VCHIQ is not used here
+
+#define DMA_SIZE		(4 * MEGABYTE)
+#define DMA_CHUNK_SIZE		0x40000			// maximum for RP1 DMA
+#define DMA_CHUNK_SIZE_LITE	0x8000
+#if RASPPI >= 5
+#define DMA_CHANNEL_RP1		4			// not used by other drivers here
+#endif
+
+static const unsigned CacheSizes[] = {4 * 1024, 64 * 1024, MEGABYTE};
+
+static const char FromBench[] = "membench";
+
+static volatile u64 s_nSink;		// prevents optimizing away the reads
+static uintptr * volatile s_pSink;
+
+CMemoryBenchmark::CMemoryBenchmark (CMemorySystem *pMemorySystem, CInterruptSystem *pInterrupt)
+:
+#ifdef ARM_ALLOW_MULTI_CORE
+	CMultiCoreSupport (pMemorySystem),
+#endif
+	m_pInterrupt (pInterrupt),
+	m_nRandom (0x12345678),
+	m_pDMASource (0),
+	m_pDMADestination (0),
+	m_nJobSequence (0)
+{
+}
+
+CMemoryBenchmark::~CMemoryBenchmark (void)
+{
+	m_pInterrupt = 0;
+}
+
+void CMemoryBenchmark::Run (unsigned nCore)
+{
+	if (nCore != 0)
+	{
+#ifdef ARM_ALLOW_MULTI_CORE
+		unsigned nSequence = 0;
+		while (1)
+		{
+			while (m_nJobSequence == nSequence)
+			{
+				DataMemBarrier ();
+			}
+
+			nSequence = m_nJobSequence;
+			DataMemBarrier ();
+
+			if (m_JobTest == BandwidthQuit)
+			{
+				return;
+			}
+
+			if (m_nJobCoreMask & (1 << nCore))
+			{
+				m_fJobResult[nCore] = RunBandwidth (m_JobTest, m_pJobBuffer[nCore],
+								    m_nJobSize, m_nJobStartTicks);
+
+				DataMemBarrier ();
+
+				m_bJobDone[nCore] = TRUE;
+			}
+		}
+#endif
+		return;
+	}
+
+	BenchLatency ();
+
+	BenchBandwidth (HEAP_LOW, "low");
+#if RASPPI >= 4
+	if (CMemorySystem::Get ()->GetHeapFreeSpace (HEAP_HIGH) >= BENCH_CORES * BANDWIDTH_DRAM_SIZE)
+	{
+		BenchBandwidth (HEAP_HIGH, "high");
+	}
+#endif
+
+	BenchUncached ();
+	BenchDMA ();
+	BenchCacheMaintenance ();
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_JobTest = BandwidthQuit;
+	DataMemBarrier ();
+	m_nJobSequence++;
+#endif
+}
+
+// Pointer chasing through a random cyclic list with one node per cache line, so that
+// each load must wait for the previous one and the prefetcher cannot predict it.
+void CMemoryBenchmark::BenchLatency (void)
+{
+	uintptr *pBuffer = (uintptr *) CMemorySystem::HeapAllocate (LATENCY_MAX_SIZE, HEAP_LOW);
+	unsigned *pOrder = new unsigned[LATENCY_MAX_SIZE / LATENCY_STRIDE];
+	assert (pBuffer != 0 && pOrder != 0);
+
+	const unsigned nStep = LATENCY_STRIDE / sizeof (uintptr);
+
+	for (size_t nSize = LATENCY_MIN_SIZE; nSize <= LATENCY_MAX_SIZE; nSize *= 2)
+	{
+		// Sattolo's algorithm gives a random permutation with a single cycle
+		unsigned nNodes = nSize / LATENCY_STRIDE;
+		for (unsigned i = 0; i < nNodes; i++)
+		{
+			pOrder[i] = i;
+		}
+
+		for (unsigned i = nNodes-1; i > 0; i--)
+		{
+			unsigned j = GetRandom () % i;
+
+			unsigned nTemp = pOrder[i];
+			pOrder[i] = pOrder[j];
+			pOrder[j] = nTemp;
+		}
+
+		for (unsigned i = 0; i < nNodes; i++)
+		{
+			pBuffer[i * nStep] = (uintptr) &pBuffer[pOrder[i] * nStep];
+		}
+
+		uintptr *p = pBuffer;
+		for (unsigned i = 0; i < nNodes; i++)		// warm up caches and TLB
+		{
+			p = (uintptr *) *p;
+		}
+
+		u64 nStartTicks = CTimer::GetClockTicks64 ();
+
+		for (unsigned i = 0; i < LATENCY_LOADS / 8; i++)
+		{
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+			p = (uintptr *) *p;
+		}
+
+		u64 nTicks = CTimer::GetClockTicks64 () - nStartTicks;
+
+		s_pSink = p;
+
+		CString Name;
+		Name.Format ("latency-%uk", (unsigned) (nSize / 1024));
+		Report (Name, (double) nTicks * (1000000000.0 / CLOCKHZ) / LATENCY_LOADS, "ns");
+	}
+
+	delete [] pOrder;
+	CMemorySystem::HeapFree (pBuffer);
+}
+
+void CMemoryBenchmark::BenchBandwidth (int nHeapType, const char *pHeapName)
+{
+	static const struct
+	{
+		TBandwidthTest	 Test;
+		const char	*pName;
+	}
+	Tests[] =
+	{
+		{BandwidthRead,		"read"},
+		{BandwidthWrite,	"write"},
+		{BandwidthCopy,		"copy"}
+	};
+
+	u8 *pBuffer[BENCH_CORES];
+	for (unsigned nCore = 0; nCore < BENCH_CORES; nCore++)
+	{
+		pBuffer[nCore] = (u8 *) CMemorySystem::HeapAllocate (BANDWIDTH_DRAM_SIZE, nHeapType);
+		assert (pBuffer[nCore] != 0);
+
+		memset (pBuffer[nCore], 0x55, BANDWIDTH_DRAM_SIZE);
+	}
+
+	for (unsigned i = 0; i < sizeof Tests / sizeof Tests[0]; i++)
+	{
+		CString Name;
+
+		// cache resident sizes on core 0 only
+		Name.Format ("%s-%s-16k", pHeapName, Tests[i].pName);
+		Report (Name, RunOnCores (Tests[i].Test, pBuffer, BANDWIDTH_L1_SIZE, 1), "MB/s");
+
+		Name.Format ("%s-%s-128k", pHeapName, Tests[i].pName);
+		Report (Name, RunOnCores (Tests[i].Test, pBuffer, BANDWIDTH_L2_SIZE, 1), "MB/s");
+
+		for (unsigned nCore = 0; nCore < BENCH_CORES; nCore++)
+		{
+			Name.Format ("%s-%s-16m-core%u", pHeapName, Tests[i].pName, nCore);
+			Report (Name, RunOnCores (Tests[i].Test, pBuffer, BANDWIDTH_DRAM_SIZE,
+						  1 << nCore), "MB/s");
+		}
+
+		if (BENCH_CORES > 1)
+		{
+			Name.Format ("%s-%s-16m-all", pHeapName, Tests[i].pName);
+			Report (Name, RunOnCores (Tests[i].Test, pBuffer, BANDWIDTH_DRAM_SIZE,
+						  (1 << BENCH_CORES) - 1), "MB/s");
+		}
+	}
+
+	for (unsigned nCore = 0; nCore < BENCH_CORES; nCore++)
+	{
+		CMemorySystem::HeapFree (pBuffer[nCore]);
+	}
+}
+
+// The DMA coherent pool is mapped non-cacheable (write-combining on AArch64), the coherent
+// region is mapped strongly ordered. Both are used for buffers shared with DMA engines.
+void CMemoryBenchmark::BenchUncached (void)
+{
+	u8 *pBuffer[BENCH_CORES];
+
+	pBuffer[0] = (u8 *) CMemorySystem::HeapAllocate (UNCACHED_SIZE, HEAP_COHERENT);
+	if (pBuffer[0] != 0)
+	{
+		Report ("noncached-read-4k", RunOnCores (BandwidthRead, pBuffer, UNCACHED_SIZE, 1),
+			"MB/s");
+		Report ("noncached-write-4k", RunOnCores (BandwidthWrite, pBuffer, UNCACHED_SIZE, 1),
+			"MB/s");
+		Report ("noncached-copy-4k", RunOnCores (BandwidthCopy, pBuffer, UNCACHED_SIZE, 1),
+			"MB/s");
+
+		CMemorySystem::HeapFree (pBuffer[0]);
+	}
+
+	pBuffer[0] = (u8 *) CMemorySystem::GetCoherentPage (COHERENT_SLOT_MEMBENCH);
+
+	Report ("strongly-ordered-read-4k", RunOnCores (BandwidthRead, pBuffer, UNCACHED_SIZE, 1),
+		"MB/s");
+	Report ("strongly-ordered-write-4k", RunOnCores (BandwidthWrite, pBuffer, UNCACHED_SIZE, 1),
+		"MB/s");
+}
+
+void CMemoryBenchmark::BenchDMA (void)
+{
+	m_pDMASource = (u8 *) CMemorySystem::HeapAllocate (DMA_SIZE, HEAP_DMA30);
+	m_pDMADestination = (u8 *) CMemorySystem::HeapAllocate (DMA_SIZE, HEAP_DMA30);
+	assert (m_pDMASource != 0 && m_pDMADestination != 0);
+
+	memset (m_pDMASource, 0x55, DMA_SIZE);
+
+#if RASPPI <= 4
+	Report ("dma-normal", RunDMA (DMA_CHANNEL_NORMAL, DMA_CHUNK_SIZE, 0), "MB/s");
+	Report ("dma-normal-burst4", RunDMA (DMA_CHANNEL_NORMAL, DMA_CHUNK_SIZE, 4), "MB/s");
+	Report ("dma-lite", RunDMA (DMA_CHANNEL_LITE, DMA_CHUNK_SIZE_LITE, 0), "MB/s");
+#endif
+#if RASPPI >= 4
+	Report ("dma-dma4", RunDMA (DMA_CHANNEL_EXTENDED, DMA_CHUNK_SIZE, 0), "MB/s");
+	Report ("dma-dma4-burst4", RunDMA (DMA_CHANNEL_EXTENDED, DMA_CHUNK_SIZE, 4), "MB/s");
+#endif
+#if RASPPI >= 5
+	Report ("dma-rp1", RunDMARP1 (DMA_CHUNK_SIZE), "MB/s");
+#endif
+
+	CMemorySystem::HeapFree (m_pDMADestination);
+	m_pDMADestination = 0;
+
+	CMemorySystem::HeapFree (m_pDMASource);
+	m_pDMASource = 0;
+}
+
+// The cost of cleaning and invalidating a dirty buffer (after writing it with the CPU),
+// and of the same operation on a buffer, which is not in the cache any more.
+void CMemoryBenchmark::BenchCacheMaintenance (void)
+{
+	u8 *pBuffer = (u8 *) CMemorySystem::HeapAllocate (MEGABYTE, HEAP_LOW);
+	assert (pBuffer != 0);
+
+	for (unsigned i = 0; i < sizeof CacheSizes / sizeof CacheSizes[0]; i++)
+	{
+		size_t nSize = CacheSizes[i];
+
+		// count the iterations of memset and cache maintenance in the test time
+		unsigned nIterations = 0;
+		u64 nStartTicks = CTimer::GetClockTicks64 ();
+		u64 nTicks;
+		do
+		{
+			memset (pBuffer, nIterations, nSize);
+			CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nSize);
+
+			nIterations++;
+		}
+		while ((nTicks = CTimer::GetClockTicks64 () - nStartTicks) < MEASURE_TICKS);
+
+		// subtract the time of memset alone
+		nStartTicks = CTimer::GetClockTicks64 ();
+		for (unsigned j = 0; j < nIterations; j++)
+		{
+			memset (pBuffer, j, nSize);
+		}
+		u64 nMemsetTicks = CTimer::GetClockTicks64 () - nStartTicks;
+
+		nTicks = nTicks > nMemsetTicks ? nTicks - nMemsetTicks : 0;
+
+		CString Name;
+		Name.Format ("clean-inval-dirty-%uk", (unsigned) (nSize / 1024));
+		Report (Name, (double) nTicks * (1000000000.0 / CLOCKHZ) * 1024
+			      / ((double) nIterations * nSize), "ns/KB");
+
+		CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nSize);
+
+		nIterations = 0;
+		nStartTicks = CTimer::GetClockTicks64 ();
+		do
+		{
+			CleanAndInvalidateDataCacheRange ((uintptr) pBuffer, nSize);
+
+			nIterations++;
+		}
+		while ((nTicks = CTimer::GetClockTicks64 () - nStartTicks) < MEASURE_TICKS);
+
+		Name.Format ("clean-inval-absent-%uk", (unsigned) (nSize / 1024));
+		Report (Name, (double) nTicks * (1000000000.0 / CLOCKHZ) * 1024
+			      / ((double) nIterations * nSize), "ns/KB");
+	}
+
+	CMemorySystem::HeapFree (pBuffer);
+}
+
+double CMemoryBenchmark::RunOnCores (TBandwidthTest Test, u8 **ppBuffer, size_t nSize,
+				     unsigned nCoreMask)
+{
+	assert (ppBuffer != 0);
+	u64 nStartTicks = CTimer::GetClockTicks64 () + START_DELAY_TICKS;
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	m_JobTest = Test;
+	m_nJobSize = nSize;
+	m_nJobCoreMask = nCoreMask;
+	m_nJobStartTicks = nStartTicks;
+
+	for (unsigned nCore = 1; nCore < BENCH_CORES; nCore++)
+	{
+		m_pJobBuffer[nCore] = ppBuffer[nCore];
+		m_bJobDone[nCore] = FALSE;
+	}
+
+	DataMemBarrier ();
+
+	m_nJobSequence++;
+#endif
+
+	double fResult = 0.0;
+	if (nCoreMask & 1)
+	{
+		fResult = RunBandwidth (Test, ppBuffer[0], nSize, nStartTicks);
+	}
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	for (unsigned nCore = 1; nCore < BENCH_CORES; nCore++)
+	{
+		if (nCoreMask & (1 << nCore))
+		{
+			while (!m_bJobDone[nCore])
+			{
+				DataMemBarrier ();
+			}
+
+			fResult += m_fJobResult[nCore];
+		}
+	}
+#endif
+
+	return fResult;
+}
+
+double CMemoryBenchmark::RunBandwidth (TBandwidthTest Test, u8 *pBuffer, size_t nSize,
+				       u64 nStartTicks)
+{
+	assert (pBuffer != 0);
+	assert (nSize % (4 * sizeof (u64)) == 0);
+
+	while (CTimer::GetClockTicks64 () < nStartTicks)
+	{
+		// just wait
+	}
+
+	u64 nBytes = 0;
+	u64 nTicks;
+	do
+	{
+		switch (Test)
+		{
+		case BandwidthRead: {
+			const u64 *p = (const u64 *) pBuffer;
+			u64 nSum = 0;
+			for (size_t i = 0; i < nSize / sizeof (u64); i += 4)
+			{
+				nSum += p[i] + p[i+1] + p[i+2] + p[i+3];
+			}
+			s_nSink = nSum;
+			nBytes += nSize;
+			} break;
+
+		case BandwidthWrite:
+			memset (pBuffer, 0x55, nSize);
+			nBytes += nSize;
+			break;
+
+		case BandwidthCopy:
+			memcpy (pBuffer + nSize/2, pBuffer, nSize/2);
+			nBytes += nSize/2;
+			break;
+
+		default:
+			assert (0);
+			break;
+		}
+	}
+	while ((nTicks = CTimer::GetClockTicks64 () - nStartTicks) < MEASURE_TICKS);
+
+	return (double) nBytes * CLOCKHZ / MEGABYTE / nTicks;
+}
+
+double CMemoryBenchmark::RunDMA (unsigned nChannel, size_t nChunkSize, unsigned nBurstLength)
+{
+	CDMAChannel DMA (nChannel);
+
+	u64 nBytes = 0;
+	u64 nStartTicks = CTimer::GetClockTicks64 ();
+	u64 nTicks;
+	do
+	{
+		for (size_t nOffset = 0; nOffset < DMA_SIZE; nOffset += nChunkSize)
+		{
+			DMA.SetupMemCopy (m_pDMADestination + nOffset, m_pDMASource + nOffset,
+					  nChunkSize, nBurstLength);
+			DMA.Start ();
+			if (!DMA.Wait ())
+			{
+				CLogger::Get ()->Write (FromBench, LogError, "DMA transfer failed");
+
+				return 0.0;
+			}
+		}
+
+		nBytes += DMA_SIZE;
+	}
+	while ((nTicks = CTimer::GetClockTicks64 () - nStartTicks) < MEASURE_TICKS);
+
+	return (double) nBytes * CLOCKHZ / MEGABYTE / nTicks;
+}
+
+#if RASPPI >= 5
+
+double CMemoryBenchmark::RunDMARP1 (size_t nChunkSize)
+{
+	CDMAChannelRP1 DMA (DMA_CHANNEL_RP1, m_pInterrupt);
+
+	u64 nBytes = 0;
+	u64 nStartTicks = CTimer::GetClockTicks64 ();
+	u64 nTicks;
+	do
+	{
+		for (size_t nOffset = 0; nOffset < DMA_SIZE; nOffset += nChunkSize)
+		{
+			m_bDMADone = FALSE;
+
+			DMA.SetupMemCopy (m_pDMADestination + nOffset, m_pDMASource + nOffset,
+					  nChunkSize);
+			DMA.SetCompletionRoutine (DMACompletionRoutine, this);
+			DMA.Start ();
+
+			while (!m_bDMADone)
+			{
+				// just wait
+			}
+		}
+
+		nBytes += DMA_SIZE;
+	}
+	while ((nTicks = CTimer::GetClockTicks64 () - nStartTicks) < MEASURE_TICKS);
+
+	return (double) nBytes * CLOCKHZ / MEGABYTE / nTicks;
+}
+
+void CMemoryBenchmark::DMACompletionRoutine (unsigned nChannel, unsigned nBuffer,
+					     boolean bStatus, void *pParam)
+{
+	CMemoryBenchmark *pThis = (CMemoryBenchmark *) pParam;
+	assert (pThis != 0);
+
+	if (!bStatus)
+	{
+		CLogger::Get ()->Write (FromBench, LogError, "RP1 DMA transfer failed");
+	}
+
+	pThis->m_bDMADone = TRUE;
+}
+
+#endif
+
+void CMemoryBenchmark::Report (const char *pName, double fValue, const char *pUnit)
+{
+	CLogger::Get ()->Write (FromBench, LogNotice, "%-28s %10.1f %s", pName, fValue, pUnit);
+}
+
+u32 CMemoryBenchmark::GetRandom (void)
+{
+	// xorshift32
+	m_nRandom ^= m_nRandom << 13;
+	m_nRandom ^= m_nRandom >> 17;
+	m_nRandom ^= m_nRandom << 5;
+
+	return m_nRandom;
+}
@@ -0,0 +1,106 @@
+//
+// membench.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _membench_h
+#define _membench_h
+
+#include <circle/multicore.h>
+#include <circle/memory.h>
+#include <circle/interrupt.h>
+#include <circle/sysconfig.h>
+#include <circle/types.h>
+
+#ifdef ARM_ALLOW_MULTI_CORE
+	#define BENCH_CORES	CORES
+#else
+	#define BENCH_CORES	1
+#endif
+
+enum TBandwidthTest
+{
+	BandwidthRead,
+	BandwidthWrite,
+	BandwidthCopy,
+	BandwidthQuit			// terminate the secondary cores
+};
+
+class CMemoryBenchmark		/// Memory latency, bandwidth and cache maintenance benchmark
+#ifdef ARM_ALLOW_MULTI_CORE
+	: public CMultiCoreSupport
+#endif
+{
+public:
+	CMemoryBenchmark (CMemorySystem *pMemorySystem, CInterruptSystem *pInterrupt);
+	~CMemoryBenchmark (void);
+
+#ifndef ARM_ALLOW_MULTI_CORE
+	boolean Initialize (void)	{ return TRUE; }
+#endif
+
+	/// \brief Runs the whole benchmark on core 0, waits for jobs on the other cores
+	void Run (unsigned nCore);
+
+private:
+	void BenchLatency (void);
+	void BenchBandwidth (int nHeapType, const char *pHeapName);
+	void BenchUncached (void);
+	void BenchDMA (void);
+	void BenchCacheMaintenance (void);
+
+	// runs on the cores in nCoreMask concurrently, returns the sum of MByte per second
+	double RunOnCores (TBandwidthTest Test, u8 **ppBuffer, size_t nSize, unsigned nCoreMask);
+	// starts at nStartTicks, returns MByte per second
+	static double RunBandwidth (TBandwidthTest Test, u8 *pBuffer, size_t nSize,
+				    u64 nStartTicks);
+
+	// returns MByte per second
+	double RunDMA (unsigned nChannel, size_t nChunkSize, unsigned nBurstLength);
+#if RASPPI >= 5
+	double RunDMARP1 (size_t nChunkSize);
+	static void DMACompletionRoutine (unsigned nChannel, unsigned nBuffer,
+					  boolean bStatus, void *pParam);
+#endif
+
+	static void Report (const char *pName, double fValue, const char *pUnit);
+
+	u32 GetRandom (void);
+
+private:
+	CInterruptSystem *m_pInterrupt;
+
+	u32 m_nRandom;
+
+	u8 *m_pDMASource;
+	u8 *m_pDMADestination;
+#if RASPPI >= 5
+	volatile boolean m_bDMADone;
+#endif
+
+	// job for the secondary cores
+	volatile unsigned m_nJobSequence;
+	TBandwidthTest m_JobTest;
+	u8 *m_pJobBuffer[BENCH_CORES];
+	size_t m_nJobSize;
+	unsigned m_nJobCoreMask;
+	u64 m_nJobStartTicks;
+	volatile double m_fJobResult[BENCH_CORES];
+	volatile boolean m_bJobDone[BENCH_CORES];
+};
+
+#endif
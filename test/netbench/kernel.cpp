@@ -0,0 +1,135 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+#include "netbench.h"
+#include <circle/perfcounters.h>
+#include <circle/string.h>
+
+// Network configuration
+#define USE_DHCP
+
+#ifndef USE_DHCP
+static const u8 IPAddress[]      = {192, 168, 0, 250};
+static const u8 NetMask[]        = {255, 255, 255, 0};
+static const u8 DefaultGateway[] = {192, 168, 0, 1};
+static const u8 DNSServer[]      = {192, 168, 0, 1};
+#endif
+
+static const char FromKernel[] = "kernel";
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_USBHCI (&m_Interrupt, &m_Timer)
+#ifndef USE_DHCP
+	, m_Net (IPAddress, NetMask, DefaultGateway, DNSServer)
+#endif
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_USBHCI.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Net.Initialize ();
+	}
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+	// only the instruction counter is used, the PMU stays configured on this core
+	CPerfCounters Counters (PerfEventInstructions, PerfEventNone,
+				PerfEventNone, PerfEventNone);
+	if (!Counters.IsAvailable ())
+	{
+		m_Logger.Write (FromKernel, LogWarning, "PMU not available, cycles are not valid");
+	}
+
+	CString IPString;
+	m_Net.GetConfig ()->GetIPAddress ()->Format (&IPString);
+	m_Logger.Write (FromKernel, LogNotice, "Try \"python3 netbench.py %s\" from another computer!",
+			(const char *) IPString);
+
+	new CNetBench (&m_Net, &Counters, NetBenchTCPReceive);
+	new CNetBench (&m_Net, &Counters, NetBenchTCPSend);
+	new CNetBench (&m_Net, &Counters, NetBenchTCPRequestResponse);
+	new CNetBench (&m_Net, &Counters, NetBenchTCPConnect);
+	new CNetBench (&m_Net, &Counters, NetBenchUDPReceive);
+	new CNetBench (&m_Net, &Counters, NetBenchUDPSend);
+
+	for (unsigned nCount = 0; 1; nCount++)
+	{
+		m_Scheduler.Yield ();
+
+		m_CPUThrottle.Update ();
+
+		m_Screen.Rotor (0, nCount);
+	}
+
+	return ShutdownHalt;
+}
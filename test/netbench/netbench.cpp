@@ -0,0 +1,569 @@
+//
+// netbench.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "netbench.h"
+#include <circle/net/in.h>
+#include <circle/netbuffer.h>
+#include <circle/sched/scheduler.h>
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <assert.h>
+
+#define TCP_SEND_SIZE		(4 * 1460)
+
+#define UDP_BATCH_SIZE		16
+#define UDP_SIZE_MIN		18		// minimum UDP payload in an Ethernet frame
+#define UDP_SIZE_MAX		1472
+#define UDP_SECONDS_MAX		60
+
+struct TUDPSendCommand			// sent by the host to NETBENCH_PORT_SEND (UDP)
+{
+	u16	nSize;				// of the UDP payload
+	u16	nSeconds;			// duration of the test
+}
+PACKED;
+
+static const char FromNetBench[] = "netbench";
+
+unsigned CNetBench::s_nWorkerCount = 0;
+
+const char *CNetBench::s_pTestName[NetBenchUnknown] =
+{
+	"TCP receive",
+	"TCP send",
+	"TCP request/response",
+	"TCP connect",
+	"UDP receive",
+	"UDP send"
+};
+
+CNetBench::CNetBench (CNetSubSystem *pNetSubSystem, CPerfCounters *pCounters,
+		      TNetBenchTest Test, CSocket *pSocket,
+		      const CIPAddress *pClientIP, u16 usClientPort)
+:	m_pNetSubSystem (pNetSubSystem),
+	m_pCounters (pCounters),
+	m_Test (Test),
+	m_pSocket (pSocket),
+	m_usClientPort (usClientPort),
+	m_nStartClockTicks (0),
+	m_nCycles (0),
+	m_nInstructions (0)
+{
+	assert (m_Test < NetBenchUnknown);
+
+	if (m_pSocket != 0)
+	{
+		s_nWorkerCount++;
+	}
+
+	if (pClientIP != 0)
+	{
+		m_ClientIP.Set (*pClientIP);
+	}
+}
+
+CNetBench::~CNetBench (void)
+{
+	assert (m_pSocket == 0);
+
+	m_pCounters = 0;
+	m_pNetSubSystem = 0;
+}
+
+void CNetBench::Run (void)
+{
+	switch (m_Test)
+	{
+	case NetBenchTCPReceive:
+	case NetBenchTCPSend:
+	case NetBenchTCPRequestResponse:
+		if (m_pSocket == 0)
+		{
+			TCPListener ();
+
+			break;
+		}
+
+		if (m_Test == NetBenchTCPReceive)
+		{
+			TCPReceive ();
+		}
+		else if (m_Test == NetBenchTCPSend)
+		{
+			TCPSend ();
+		}
+		else
+		{
+			TCPRequestResponse ();
+		}
+
+		delete m_pSocket;		// closes connection
+		m_pSocket = 0;
+
+		assert (s_nWorkerCount > 0);
+		s_nWorkerCount--;
+		break;
+
+	case NetBenchTCPConnect:
+		TCPListener ();
+		break;
+
+	case NetBenchUDPReceive:
+		UDPReceive ();
+		break;
+
+	case NetBenchUDPSend:
+		UDPSend ();
+		break;
+
+	default:
+		assert (0);
+		break;
+	}
+}
+
+void CNetBench::TCPListener (void)
+{
+	assert (m_pNetSubSystem != 0);
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_TCP);
+	assert (m_pSocket != 0);
+
+	u16 usPort = GetPort (m_Test);
+	if (m_pSocket->Bind (usPort) < 0)
+	{
+		CLogger::Get ()->Write (FromNetBench, LogError, "Cannot bind socket (port %u)",
+					(unsigned) usPort);
+
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return;
+	}
+
+	if (m_pSocket->Listen (NETBENCH_MAX_CLIENTS) < 0)
+	{
+		CLogger::Get ()->Write (FromNetBench, LogError, "Cannot listen on socket");
+
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return;
+	}
+
+	unsigned nConnections = 0;
+
+	while (1)
+	{
+		CIPAddress ForeignIP;
+		u16 usForeignPort;
+		CSocket *pConnection = m_pSocket->Accept (&ForeignIP, &usForeignPort);
+		if (pConnection == 0)
+		{
+			CLogger::Get ()->Write (FromNetBench, LogWarning, "Cannot accept connection");
+
+			continue;
+		}
+
+		if (m_Test == NetBenchTCPConnect)
+		{
+			// the connection is closed immediately, only the setup rate is measured
+			delete pConnection;
+
+			if (nConnections++ == 0)
+			{
+				m_ClientIP.Set (ForeignIP);
+				m_usClientPort = usForeignPort;
+
+				StartMeasurement ();
+			}
+			else
+			{
+				UpdateMeasurement ();
+			}
+
+			if (nConnections == NETBENCH_CONNECT_BATCH)
+			{
+				Report ("connections", 0, nConnections);
+
+				nConnections = 0;
+			}
+
+			continue;
+		}
+
+		if (s_nWorkerCount >= NETBENCH_MAX_CLIENTS)
+		{
+			CLogger::Get ()->Write (FromNetBench, LogWarning, "Too many clients");
+
+			delete pConnection;
+
+			continue;
+		}
+
+		new CNetBench (m_pNetSubSystem, m_pCounters, m_Test,
+			       pConnection, &ForeignIP, usForeignPort);
+	}
+}
+
+void CNetBench::TCPReceive (void)
+{
+	assert (m_pSocket != 0);
+
+	u64 nTotalBytes = 0;
+	u64 nSegments = 0;
+
+	u8 Buffer[FRAME_BUFFER_SIZE];
+	int nBytesReceived;
+
+	while ((nBytesReceived = m_pSocket->Receive (Buffer, sizeof Buffer, 0)) > 0)
+	{
+		if (nSegments++ == 0)
+		{
+			StartMeasurement ();
+		}
+		else
+		{
+			UpdateMeasurement ();
+		}
+
+		nTotalBytes += nBytesReceived;
+	}
+
+	Report ("segments", nTotalBytes, nSegments);
+}
+
+void CNetBench::TCPSend (void)
+{
+	assert (m_pSocket != 0);
+
+	u8 Buffer[TCP_SEND_SIZE];
+	memset (Buffer, 0x55, sizeof Buffer);
+
+	u64 nTotalBytes = 0;
+	u64 nCalls = 0;
+
+	StartMeasurement ();
+
+	while (CTimer::Get ()->GetClockTicks () - m_nStartClockTicks
+	       < NETBENCH_SEND_SECONDS * CLOCKHZ)
+	{
+		int nResult = m_pSocket->Send (Buffer, sizeof Buffer, 0);
+		if (nResult <= 0)
+		{
+			break;
+		}
+
+		nTotalBytes += nResult;
+		nCalls++;
+
+		UpdateMeasurement ();
+	}
+
+	Report ("send calls", nTotalBytes, nCalls);
+}
+
+void CNetBench::TCPRequestResponse (void)
+{
+	assert (m_pSocket != 0);
+
+	u64 nTotalBytes = 0;
+	u64 nTransactions = 0;
+
+	u8 Buffer[FRAME_BUFFER_SIZE];
+	int nBytesReceived;
+
+	// each request is answered with a response of the same size (netperf TCP_RR style)
+	while ((nBytesReceived = m_pSocket->Receive (Buffer, sizeof Buffer, 0)) > 0)
+	{
+		if (nTransactions++ == 0)
+		{
+			StartMeasurement ();
+		}
+
+		if (m_pSocket->Send (Buffer, nBytesReceived, 0) != nBytesReceived)
+		{
+			break;
+		}
+
+		nTotalBytes += nBytesReceived;
+
+		UpdateMeasurement ();
+	}
+
+	Report ("transactions", nTotalBytes, nTransactions);
+}
+
+void CNetBench::UDPReceive (void)
+{
+	assert (m_pNetSubSystem != 0);
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
+	assert (m_pSocket != 0);
+
+	if (m_pSocket->Bind (NETBENCH_PORT_RECEIVE) < 0)
+	{
+		CLogger::Get ()->Write (FromNetBench, LogError, "Cannot bind socket (port %u)",
+					NETBENCH_PORT_RECEIVE);
+
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return;
+	}
+
+	u64 nTotalBytes = 0;
+	u64 nDatagrams = 0;
+	unsigned nLastClockTicks = 0;
+
+	while (1)
+	{
+		TNetMessage Messages[UDP_BATCH_SIZE];
+		int nCount = m_pSocket->ReceiveBatch (Messages, UDP_BATCH_SIZE, MSG_DONTWAIT);
+		if (nCount < 0)
+		{
+			break;
+		}
+
+		unsigned nClockTicks = CTimer::Get ()->GetClockTicks ();
+
+		if (nCount == 0)
+		{
+			if (   nDatagrams > 0
+			    && nClockTicks - nLastClockTicks >= NETBENCH_UDP_IDLE_MS * (CLOCKHZ / 1000))
+			{
+				// the idle time at the end is not included in the result
+				m_nStartClockTicks += nClockTicks - nLastClockTicks;
+
+				Report ("datagrams", nTotalBytes, nDatagrams);
+
+				nTotalBytes = 0;
+				nDatagrams = 0;
+			}
+
+			if (nDatagrams > 0)
+			{
+				UpdateMeasurement ();
+			}
+
+			CScheduler::Get ()->Yield ();
+
+			continue;
+		}
+
+		if (nDatagrams == 0)
+		{
+			m_ClientIP.Set (Messages[0].ForeignIP);
+			m_usClientPort = Messages[0].nForeignPort;
+
+			StartMeasurement ();
+		}
+		else
+		{
+			UpdateMeasurement ();
+		}
+
+		for (int i = 0; i < nCount; i++)
+		{
+			assert (Messages[i].pBuffer != 0);
+			nTotalBytes += Messages[i].pBuffer->GetTotalLength ();
+			Messages[i].pBuffer->Release ();
+		}
+
+		nDatagrams += nCount;
+		nLastClockTicks = nClockTicks;
+	}
+
+	delete m_pSocket;
+	m_pSocket = 0;
+}
+
+void CNetBench::UDPSend (void)
+{
+	assert (m_pNetSubSystem != 0);
+	m_pSocket = new CSocket (m_pNetSubSystem, IPPROTO_UDP);
+	assert (m_pSocket != 0);
+
+	if (m_pSocket->Bind (NETBENCH_PORT_SEND) < 0)
+	{
+		CLogger::Get ()->Write (FromNetBench, LogError, "Cannot bind socket (port %u)",
+					NETBENCH_PORT_SEND);
+
+		delete m_pSocket;
+		m_pSocket = 0;
+
+		return;
+	}
+
+	while (1)
+	{
+		TUDPSendCommand Command;
+		CIPAddress ForeignIP;
+		u16 usForeignPort;
+		int nResult = m_pSocket->ReceiveFrom (&Command, sizeof Command, 0,
+						      &ForeignIP, &usForeignPort);
+		if (nResult < 0)
+		{
+			break;
+		}
+
+		if (nResult != sizeof Command)
+		{
+			continue;
+		}
+
+		unsigned nSize = be2le16 (Command.nSize);
+		unsigned nSeconds = be2le16 (Command.nSeconds);
+		if (   nSize < UDP_SIZE_MIN
+		    || nSize > UDP_SIZE_MAX
+		    || nSeconds == 0
+		    || nSeconds > UDP_SECONDS_MAX)
+		{
+			CLogger::Get ()->Write (FromNetBench, LogWarning, "Invalid UDP send command");
+
+			continue;
+		}
+
+		m_ClientIP.Set (ForeignIP);
+		m_usClientPort = usForeignPort;
+
+		u64 nTotalBytes = 0;
+		u64 nDatagrams = 0;
+
+		StartMeasurement ();
+
+		while (CTimer::Get ()->GetClockTicks () - m_nStartClockTicks
+		       < nSeconds * CLOCKHZ)
+		{
+			TNetMessage Messages[UDP_BATCH_SIZE];
+			for (unsigned i = 0; i < UDP_BATCH_SIZE; i++)
+			{
+				Messages[i].pBuffer = CNetBuffer::Alloc ();
+				assert (Messages[i].pBuffer != 0);
+
+				u32 *pSequence = (u32 *) Messages[i].pBuffer->Append (nSize);
+				assert (pSequence != 0);
+				*pSequence = le2be32 ((u32) (nDatagrams + i));
+
+				Messages[i].ForeignIP.Set (ForeignIP);
+				Messages[i].nForeignPort = usForeignPort;
+			}
+
+			nResult = m_pSocket->SendBatch (Messages, UDP_BATCH_SIZE, 0);
+			if (nResult < 0)
+			{
+				break;
+			}
+
+			nTotalBytes += (u64) nResult * nSize;
+			nDatagrams += nResult;
+
+			UpdateMeasurement ();
+		}
+
+		Report ("datagrams", nTotalBytes, nDatagrams);
+	}
+
+	delete m_pSocket;
+	m_pSocket = 0;
+}
+
+void CNetBench::StartMeasurement (void)
+{
+	m_nStartClockTicks = CTimer::Get ()->GetClockTicks ();
+
+	m_nCycles = 0;
+	m_nInstructions = 0;
+
+	assert (m_pCounters != 0);
+	m_pCounters->Read (&m_LastValues);
+}
+
+void CNetBench::UpdateMeasurement (void)
+{
+	TPerfCounterValues Values;
+	assert (m_pCounters != 0);
+	m_pCounters->Read (&Values);
+
+	// 32-bit differences are correct, if the counters have been sampled within 2^32 events
+	m_nCycles += (u32) (Values.nCycles - m_LastValues.nCycles);
+	m_nInstructions += (u32) (Values.nEvent[0] - m_LastValues.nEvent[0]);
+
+	m_LastValues = Values;
+}
+
+void CNetBench::Report (const char *pUnit, u64 nBytes, u64 nCount)
+{
+	assert (pUnit != 0);
+
+	unsigned nClockTicks = CTimer::Get ()->GetClockTicks () - m_nStartClockTicks;
+	float fSeconds = (float) nClockTicks / CLOCKHZ;
+
+	CString IPString;
+	m_ClientIP.Format (&IPString);
+
+	assert (m_Test < NetBenchUnknown);
+	if (   nCount == 0
+	    || fSeconds <= 0.0)
+	{
+		CLogger::Get ()->Write (FromNetBench, LogNotice, "%s: %s:%u: No data",
+					s_pTestName[m_Test], (const char *) IPString,
+					(unsigned) m_usClientPort);
+
+		return;
+	}
+
+	CString Result;
+	Result.Format ("%s: %s:%u: %llu %s in %.2f sec (%.0f/sec",
+		       s_pTestName[m_Test], (const char *) IPString, (unsigned) m_usClientPort,
+		       nCount, pUnit, fSeconds, (float) nCount / fSeconds);
+
+	CString String;
+	if (nBytes > 0)
+	{
+		String.Format (", %.1f MBits/sec, %.1f cycles/byte, %.1f instructions/byte)",
+			       (float) nBytes * 8.0 / 1000000.0 / fSeconds,
+			       (float) m_nCycles / nBytes, (float) m_nInstructions / nBytes);
+	}
+	else
+	{
+		String.Format (", %.0f usec, %.0f cycles each)",
+			       fSeconds * 1000000.0 / nCount, (float) m_nCycles / nCount);
+	}
+	Result.Append (String);
+
+	CLogger::Get ()->Write (FromNetBench, LogNotice, "%s", (const char *) Result);
+}
+
+u16 CNetBench::GetPort (TNetBenchTest Test)
+{
+	switch (Test)
+	{
+	case NetBenchTCPReceive:
+	case NetBenchUDPReceive:		return NETBENCH_PORT_RECEIVE;
+	case NetBenchTCPSend:
+	case NetBenchUDPSend:			return NETBENCH_PORT_SEND;
+	case NetBenchTCPRequestResponse:	return NETBENCH_PORT_RR;
+	case NetBenchTCPConnect:		return NETBENCH_PORT_CONNECT;
+
+	default:
+		assert (0);
+		return 0;
+	}
+}
@@ -0,0 +1,98 @@
+//
+// netbench.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _netbench_h
+#define _netbench_h
+
+#include <circle/sched/task.h>
+#include <circle/net/netsubsystem.h>
+#include <circle/net/socket.h>
+#include <circle/net/ipaddress.h>
+#include <circle/perfcounters.h>
+#include <circle/types.h>
+
+#define NETBENCH_PORT_RECEIVE		5001	// TCP and UDP (iperf2 compatible)
+#define NETBENCH_PORT_SEND		5002	// TCP and UDP
+#define NETBENCH_PORT_RR		5003	// TCP request/response
+#define NETBENCH_PORT_CONNECT		5004	// TCP connection setup rate
+
+#define NETBENCH_SEND_SECONDS		10	// duration of the TCP send test
+#define NETBENCH_UDP_IDLE_MS		1000	// ends an UDP receive test
+#define NETBENCH_CONNECT_BATCH		500	// connections per report
+
+#define NETBENCH_MAX_CLIENTS		5
+
+enum TNetBenchTest
+{
+	NetBenchTCPReceive,
+	NetBenchTCPSend,
+	NetBenchTCPRequestResponse,
+	NetBenchTCPConnect,
+	NetBenchUDPReceive,
+	NetBenchUDPSend,
+	NetBenchUnknown
+};
+
+class CNetBench : public CTask
+{
+public:
+	CNetBench (CNetSubSystem	*pNetSubSystem,
+		   CPerfCounters	*pCounters,
+		   TNetBenchTest	 Test,
+		   CSocket		*pSocket      = 0, // is 0 for the listener (TCP)
+		   const CIPAddress	*pClientIP    = 0,
+		   u16			 usClientPort = 0);
+	~CNetBench (void);
+
+	void Run (void);
+
+private:
+	void TCPListener (void);	// accepts incoming connections and creates worker task
+	void TCPReceive (void);
+	void TCPSend (void);
+	void TCPRequestResponse (void);
+
+	void UDPReceive (void);
+	void UDPSend (void);
+
+	// the 32-bit PMU counters are sampled often enough to detect their overflow
+	void StartMeasurement (void);
+	void UpdateMeasurement (void);
+	void Report (const char *pUnit, u64 nBytes, u64 nCount);
+
+	static u16 GetPort (TNetBenchTest Test);
+
+private:
+	CNetSubSystem *m_pNetSubSystem;
+	CPerfCounters *m_pCounters;
+	TNetBenchTest  m_Test;
+	CSocket	      *m_pSocket;
+	CIPAddress     m_ClientIP;
+	u16	       m_usClientPort;
+
+	unsigned m_nStartClockTicks;
+	TPerfCounterValues m_LastValues;
+	u64 m_nCycles;
+	u64 m_nInstructions;
+
+	static unsigned s_nWorkerCount;		// TCP connections
+	static const char *s_pTestName[NetBenchUnknown];
+};
+
+#endif
@@ -0,0 +1,149 @@
+#!/usr/bin/env python3
+#
+# netbench.py - host side of the Circle network benchmark (see README)
+#
+# usage: python3 netbench.py IPADDRESS [TEST ...]
+#
+
+import socket
+import struct
+import sys
+import time
+
+PORT_RECEIVE = 5001
+PORT_SEND = 5002
+PORT_RR = 5003
+PORT_CONNECT = 5004
+
+DURATION = 10				# seconds per test
+UDP_FRAME_SIZES = (64, 512, 1518)	# Ethernet frame sizes (with FCS)
+UDP_OVERHEAD = 14 + 20 + 8 + 4		# Ethernet, IP, UDP header and FCS
+RR_SIZE = 1
+CONNECTIONS = 1000			# multiple of NETBENCH_CONNECT_BATCH
+
+def report(name, count, unit, nbytes, seconds):
+	line = "%-24s %10d %-12s in %6.2f s: %10.0f/s" % (name, count, unit, seconds, count / seconds)
+	if nbytes > 0:
+		line += ", %8.1f MBit/s" % (nbytes * 8 / 1e6 / seconds)
+	print(line)
+	sys.stdout.flush()
+
+def tcp_receive(host):
+	# the Circle side receives
+	buffer = bytes(65536)
+	s = socket.create_connection((host, PORT_RECEIVE))
+	start = time.monotonic()
+	nbytes = 0
+	while time.monotonic() - start < DURATION:
+		s.sendall(buffer)
+		nbytes += len(buffer)
+	s.close()
+	report("TCP receive", nbytes, "bytes", nbytes, time.monotonic() - start)
+
+def tcp_send(host):
+	# the Circle side sends for NETBENCH_SEND_SECONDS
+	s = socket.create_connection((host, PORT_SEND))
+	start = time.monotonic()
+	nbytes = 0
+	while True:
+		data = s.recv(65536)
+		if not data:
+			break
+		nbytes += len(data)
+	s.close()
+	report("TCP send", nbytes, "bytes", nbytes, time.monotonic() - start)
+
+def tcp_rr(host):
+	s = socket.create_connection((host, PORT_RR))
+	s.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+	request = bytes(RR_SIZE)
+	latencies = []
+	start = time.monotonic()
+	while time.monotonic() - start < DURATION:
+		t = time.monotonic()
+		s.sendall(request)
+		received = 0
+		while received < RR_SIZE:
+			data = s.recv(RR_SIZE - received)
+			if not data:
+				raise RuntimeError("connection closed")
+			received += len(data)
+		latencies.append(time.monotonic() - t)
+	s.close()
+	report("TCP request/response", len(latencies), "transactions", 0, time.monotonic() - start)
+	latencies.sort()
+	print("%-24s mean %.1f us, median %.1f us, 99%% %.1f us" %
+	      ("", sum(latencies) / len(latencies) * 1e6, latencies[len(latencies) // 2] * 1e6,
+	       latencies[len(latencies) * 99 // 100] * 1e6))
+
+def tcp_connect(host):
+	start = time.monotonic()
+	for i in range(CONNECTIONS):
+		s = socket.create_connection((host, PORT_CONNECT))
+		s.close()
+	report("TCP connect", CONNECTIONS, "connections", 0, time.monotonic() - start)
+
+def udp_receive(host):
+	# the Circle side receives, the result is reported there
+	s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+	for frame in UDP_FRAME_SIZES:
+		payload = bytes(frame - UDP_OVERHEAD)
+		count = 0
+		start = time.monotonic()
+		while time.monotonic() - start < DURATION:
+			for i in range(100):
+				s.sendto(payload, (host, PORT_RECEIVE))
+			count += 100
+		seconds = time.monotonic() - start
+		report("UDP receive (%d)" % frame, count, "datagrams", count * len(payload), seconds)
+		time.sleep(2)			# Circle reports after 1 s idle time
+	s.close()
+
+def udp_send(host):
+	s = socket.socket(socket.AF_INET, socket.SOCK_DGRAM)
+	s.setsockopt(socket.SOL_SOCKET, socket.SO_RCVBUF, 4 * 1024 * 1024)
+	s.settimeout(1.0)
+	for frame in UDP_FRAME_SIZES:
+		size = frame - UDP_OVERHEAD
+		s.sendto(struct.pack(">HH", size, DURATION), (host, PORT_SEND))
+		count = 0
+		start = None
+		end = None
+		while True:
+			try:
+				data = s.recv(2048)
+			except socket.timeout:
+				break
+			end = time.monotonic()
+			if start is None:
+				start = end
+			count += 1
+		if count < 2:
+			print("UDP send (%d): no data" % frame)
+			continue
+		report("UDP send (%d)" % frame, count, "datagrams", count * size, end - start)
+	s.close()
+
+TESTS = {
+	"tcp-receive":	tcp_receive,
+	"tcp-send":	tcp_send,
+	"tcp-rr":	tcp_rr,
+	"tcp-connect":	tcp_connect,
+	"udp-receive":	udp_receive,
+	"udp-send":	udp_send,
+}
+
+if len(sys.argv) < 2:
+	print("usage: python3 netbench.py IPADDRESS [TEST ...]")
+	print("tests: " + " ".join(TESTS.keys()) + " (default: all)")
+	sys.exit(1)
+
+host = sys.argv[1]
+tests = sys.argv[2:] if len(sys.argv) > 2 else list(TESTS.keys())
+
+for test in tests:
+	if test not in TESTS:
+		print("unknown test: " + test)
+		sys.exit(1)
+	TESTS[test](host)
+	time.sleep(1)
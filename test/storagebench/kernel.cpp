@@ -0,0 +1,171 @@
+//
+// kernel.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "kernel.h"
+
+// Enable the raw write tests. This overwrites the last 64 MByte of each device!
+//#define RAW_WRITE_TEST
+
+static const char FromKernel[] = "kernel";
+
+static const struct
+{
+	const char *pDevice;		// raw block device
+	const char *pPartition;		// first partition
+	const char *pVolume;		// FatFs volume ID
+}
+Targets[] =
+{
+	{"emmc1", "emmc1-1", "SD:"},
+	{"umsd1", "umsd1-1", "USB:"},
+#ifdef USE_NVME
+	{"nvme1", "nvme1-1", "NVME:"}
+#endif
+};
+
+CKernel::CKernel (void)
+:	m_Screen (m_Options.GetWidth (), m_Options.GetHeight ()),
+	m_Timer (&m_Interrupt),
+	m_Logger (m_Options.GetLogLevel (), &m_Timer),
+	m_USBHCI (&m_Interrupt, &m_Timer),
+	m_EMMC (&m_Interrupt, &m_Timer, &m_ActLED)
+#ifdef USE_NVME
+	, m_NVMe (&m_Interrupt)
+#endif
+{
+	m_ActLED.Blink (5);	// show we are alive
+}
+
+CKernel::~CKernel (void)
+{
+}
+
+boolean CKernel::Initialize (void)
+{
+	boolean bOK = TRUE;
+
+	if (bOK)
+	{
+		bOK = m_Screen.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Serial.Initialize (115200);
+	}
+
+	if (bOK)
+	{
+		CDevice *pTarget = m_DeviceNameService.GetDevice (m_Options.GetLogDevice (), FALSE);
+		if (pTarget == 0)
+		{
+			pTarget = &m_Screen;
+		}
+
+		bOK = m_Logger.Initialize (pTarget);
+	}
+
+	if (bOK)
+	{
+		bOK = m_Interrupt.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_Timer.Initialize ();
+	}
+
+	if (bOK)
+	{
+		bOK = m_USBHCI.Initialize ();
+	}
+
+	if (bOK)
+	{
+		// continue without SD card, the other devices may be present
+		if (!m_EMMC.Initialize ())
+		{
+			m_Logger.Write (FromKernel, LogWarning, "SD card not available");
+		}
+	}
+
+#ifdef USE_NVME
+	if (bOK)
+	{
+		if (!m_NVMe.Initialize ())
+		{
+			m_Logger.Write (FromKernel, LogWarning, "NVMe device not available");
+		}
+	}
+#endif
+
+	return bOK;
+}
+
+TShutdownMode CKernel::Run (void)
+{
+	m_Logger.Write (FromKernel, LogNotice, "Compile time: " __DATE__ " " __TIME__);
+
+#ifdef RAW_WRITE_TEST
+	m_Logger.Write (FromKernel, LogWarning, "Raw write tests enabled");
+#endif
+
+	for (unsigned i = 0; i < sizeof Targets / sizeof Targets[0]; i++)
+	{
+		CDevice *pDevice = m_DeviceNameService.GetDevice (Targets[i].pDevice, TRUE);
+		if (pDevice == 0)
+		{
+			m_Logger.Write (FromKernel, LogNotice, "Device %s not found",
+					Targets[i].pDevice);
+
+			continue;
+		}
+
+		m_Logger.Write (FromKernel, LogNotice, "Testing %s", Targets[i].pDevice);
+
+#ifdef RAW_WRITE_TEST
+		m_Benchmark.RunRaw (pDevice, Targets[i].pDevice, TRUE);
+#else
+		m_Benchmark.RunRaw (pDevice, Targets[i].pDevice, FALSE);
+#endif
+
+		// the native FAT driver and FatFs must not use the partition at the same time
+		CDevice *pPartition = m_DeviceNameService.GetDevice (Targets[i].pPartition, TRUE);
+		if (pPartition != 0)
+		{
+			m_Benchmark.RunFAT (pPartition, Targets[i].pPartition);
+		}
+
+		if (f_mount (&m_FileSystem, Targets[i].pVolume, 1) == FR_OK)
+		{
+			m_Benchmark.RunFatFs (Targets[i].pVolume);
+
+			f_mount (0, Targets[i].pVolume, 0);
+		}
+		else
+		{
+			m_Logger.Write (FromKernel, LogWarning, "Cannot mount volume %s",
+					Targets[i].pVolume);
+		}
+	}
+
+	m_Logger.Write (FromKernel, LogNotice, "Benchmark finished");
+
+	return ShutdownHalt;
+}
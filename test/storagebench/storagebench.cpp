@@ -0,0 +1,633 @@
+//
+// storagebench.cpp
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#include "storagebench.h"
+#include <circle/logger.h>
+#include <circle/timer.h>
+#include <circle/new.h>
+#include <circle/synchronize.h>
+#include <circle/string.h>
+#include <circle/util.h>
+#include <fatfs/ff.h>
+#include <assert.h>
+
+#define MB	0x100000
+
+static const char FromBench[] = "bench";
+
+static const unsigned QueueDepths[] = {1, 4, 16, BENCH_MAX_QUEUE_DEPTH};
+
+CStorageBenchmark::CStorageBenchmark (void)
+:	m_nLatencies (0),
+	m_nRandom (0x12345678)
+{
+	m_pBuffer = new (HEAP_DMA30) u8[BENCH_SEQ_BLOCK_SIZE];
+	assert (m_pBuffer != 0);
+
+	for (unsigned i = 0; i < BENCH_SEQ_BLOCK_SIZE; i++)
+	{
+		m_pBuffer[i] = (u8) (i * 7 + (i >> 12));
+	}
+
+	m_pLatency = new unsigned[BENCH_RANDOM_OPS];
+	assert (m_pLatency != 0);
+
+	for (unsigned i = 0; i < BENCH_MAX_QUEUE_DEPTH; i++)
+	{
+		m_Slot[i].State = SlotFree;
+	}
+}
+
+CStorageBenchmark::~CStorageBenchmark (void)
+{
+	delete [] m_pLatency;
+	m_pLatency = 0;
+
+	delete [] m_pBuffer;
+	m_pBuffer = 0;
+}
+
+void CStorageBenchmark::RunRaw (CDevice *pDevice, const char *pName, boolean bWrite)
+{
+	assert (pDevice != 0);
+	assert (pName != 0);
+
+	u64 ullSize = pDevice->GetSize ();
+	if (   ullSize == (u64) -1
+	    || ullSize < 2 * BENCH_AREA_SIZE)
+	{
+		CLogger::Get ()->Write (FromBench, LogWarning, "%s: Size unknown or too small",
+					pName);
+
+		return;
+	}
+
+	SequentialRaw (pDevice, pName, 0, FALSE);
+
+	for (unsigned i = 0; i < sizeof QueueDepths / sizeof QueueDepths[0]; i++)
+	{
+		RandomRaw (pDevice, pName, 0, ullSize, FALSE, QueueDepths[i]);
+	}
+
+	if (!bWrite)
+	{
+		return;
+	}
+
+	// at the end of the device, which is not used by the file system tests
+	u64 ullBase = (ullSize - BENCH_AREA_SIZE) & ~(u64) (BENCH_SEQ_BLOCK_SIZE-1);
+
+	SequentialRaw (pDevice, pName, ullBase, TRUE);
+
+	for (unsigned i = 0; i < sizeof QueueDepths / sizeof QueueDepths[0]; i++)
+	{
+		RandomRaw (pDevice, pName, ullBase, BENCH_AREA_SIZE, TRUE, QueueDepths[i]);
+	}
+
+	pDevice->IOCtl (DEVICE_IOCTL_SYNC, 0);
+}
+
+void CStorageBenchmark::RunFatFs (const char *pVolume)
+{
+	assert (pVolume != 0);
+
+	CString Path (pVolume);
+	Path.Append ("/bench.tmp");
+
+	FIL File;
+	if (f_open (&File, Path, FA_READ | FA_WRITE | FA_CREATE_ALWAYS) != FR_OK)
+	{
+		CLogger::Get ()->Write (FromBench, LogError, "Cannot create %s",
+					(const char *) Path);
+
+		return;
+	}
+
+	FRESULT Result = FR_OK;
+	UINT nBytes;
+
+	// sequential write
+	StartTest ();
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	unsigned nOps;
+	for (nOps = 0; Result == FR_OK && nOps < BENCH_AREA_SIZE / BENCH_SEQ_BLOCK_SIZE; nOps++)
+	{
+		unsigned nOpTicks = CTimer::GetClockTicks ();
+		Result = f_write (&File, m_pBuffer, BENCH_SEQ_BLOCK_SIZE, &nBytes);
+		if (nBytes != BENCH_SEQ_BLOCK_SIZE)
+		{
+			Result = FR_DENIED;		// disk full
+		}
+		AddLatency (CTimer::GetClockTicks () - nOpTicks);
+	}
+
+	if (Result == FR_OK)
+	{
+		Result = f_sync (&File);
+	}
+
+	if (Result == FR_OK)
+	{
+		Report (pVolume, "fatfs-seq-write", BENCH_AREA_SIZE, nOps,
+			CTimer::GetClockTicks () - nStartTicks);
+	}
+
+	// sequential read
+	if (Result == FR_OK)
+	{
+		Result = f_lseek (&File, 0);
+	}
+
+	StartTest ();
+	nStartTicks = CTimer::GetClockTicks ();
+	for (nOps = 0; Result == FR_OK && nOps < BENCH_AREA_SIZE / BENCH_SEQ_BLOCK_SIZE; nOps++)
+	{
+		unsigned nOpTicks = CTimer::GetClockTicks ();
+		Result = f_read (&File, m_pBuffer, BENCH_SEQ_BLOCK_SIZE, &nBytes);
+		AddLatency (CTimer::GetClockTicks () - nOpTicks);
+	}
+
+	if (Result == FR_OK)
+	{
+		Report (pVolume, "fatfs-seq-read", BENCH_AREA_SIZE, nOps,
+			CTimer::GetClockTicks () - nStartTicks);
+	}
+
+	// random read and write
+	for (unsigned bWrite = 0; bWrite <= 1 && Result == FR_OK; bWrite++)
+	{
+		StartTest ();
+		nStartTicks = CTimer::GetClockTicks ();
+		for (nOps = 0; Result == FR_OK && nOps < BENCH_RANDOM_OPS; nOps++)
+		{
+			unsigned nOpTicks = CTimer::GetClockTicks ();
+
+			Result = f_lseek (&File, GetRandomOffset (BENCH_AREA_SIZE));
+			if (Result == FR_OK)
+			{
+				Result = bWrite ? f_write (&File, m_pBuffer, BENCH_RANDOM_BLOCK_SIZE,
+							   &nBytes)
+						: f_read (&File, m_pBuffer, BENCH_RANDOM_BLOCK_SIZE,
+							  &nBytes);
+			}
+
+			AddLatency (CTimer::GetClockTicks () - nOpTicks);
+		}
+
+		if (   bWrite
+		    && Result == FR_OK)
+		{
+			Result = f_sync (&File);
+		}
+
+		if (Result == FR_OK)
+		{
+			Report (pVolume, bWrite ? "fatfs-rand-write" : "fatfs-rand-read",
+				(u64) nOps * BENCH_RANDOM_BLOCK_SIZE, nOps,
+				CTimer::GetClockTicks () - nStartTicks);
+		}
+	}
+
+	if (Result != FR_OK)
+	{
+		CLogger::Get ()->Write (FromBench, LogError, "%s: FatFs error %d", pVolume,
+					(int) Result);
+	}
+
+	f_close (&File);
+	f_unlink (Path);
+}
+
+void CStorageBenchmark::RunFAT (CDevice *pPartition, const char *pName)
+{
+	assert (pPartition != 0);
+	assert (pName != 0);
+
+	static const char Title[] = "BENCH.TMP";
+
+	CFATFileSystem *pFileSystem = new CFATFileSystem;
+	assert (pFileSystem != 0);
+
+	if (!pFileSystem->Mount (pPartition))
+	{
+		CLogger::Get ()->Write (FromBench, LogWarning, "%s: Cannot mount FAT file system",
+					pName);
+
+		delete pFileSystem;
+
+		return;
+	}
+
+	boolean bOK = TRUE;
+
+	// sequential write
+	unsigned hFile = pFileSystem->FileCreate (Title);
+	if (hFile == 0)
+	{
+		bOK = FALSE;
+	}
+
+	StartTest ();
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	unsigned nOps;
+	for (nOps = 0; bOK && nOps < BENCH_AREA_SIZE / BENCH_SEQ_BLOCK_SIZE; nOps++)
+	{
+		unsigned nOpTicks = CTimer::GetClockTicks ();
+		bOK = pFileSystem->FileWrite (hFile, m_pBuffer, BENCH_SEQ_BLOCK_SIZE)
+			== BENCH_SEQ_BLOCK_SIZE;
+		AddLatency (CTimer::GetClockTicks () - nOpTicks);
+	}
+
+	if (hFile != 0)
+	{
+		bOK = pFileSystem->FileClose (hFile) != 0 && bOK;
+	}
+
+	if (bOK)
+	{
+		pFileSystem->Synchronize ();
+
+		Report (pName, "fat-seq-write", BENCH_AREA_SIZE, nOps,
+			CTimer::GetClockTicks () - nStartTicks);
+	}
+
+	// sequential read
+	hFile = bOK ? pFileSystem->FileOpen (Title) : 0;
+	if (hFile == 0)
+	{
+		bOK = FALSE;
+	}
+
+	StartTest ();
+	nStartTicks = CTimer::GetClockTicks ();
+	for (nOps = 0; bOK && nOps < BENCH_AREA_SIZE / BENCH_SEQ_BLOCK_SIZE; nOps++)
+	{
+		unsigned nOpTicks = CTimer::GetClockTicks ();
+		bOK = pFileSystem->FileRead (hFile, m_pBuffer, BENCH_SEQ_BLOCK_SIZE)
+			== BENCH_SEQ_BLOCK_SIZE;
+		AddLatency (CTimer::GetClockTicks () - nOpTicks);
+	}
+
+	if (hFile != 0)
+	{
+		pFileSystem->FileClose (hFile);
+	}
+
+	if (bOK)
+	{
+		Report (pName, "fat-seq-read", BENCH_AREA_SIZE, nOps,
+			CTimer::GetClockTicks () - nStartTicks);
+	}
+	else
+	{
+		CLogger::Get ()->Write (FromBench, LogError, "%s: FAT file system error", pName);
+	}
+
+	pFileSystem->FileDelete (Title);
+
+	pFileSystem->UnMount ();
+	delete pFileSystem;
+}
+
+void CStorageBenchmark::SequentialRaw (CDevice *pDevice, const char *pName, u64 ullBase,
+				       boolean bWrite)
+{
+	assert (pDevice != 0);
+
+	StartTest ();
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+
+	unsigned nOps;
+	for (nOps = 0; nOps < BENCH_AREA_SIZE / BENCH_SEQ_BLOCK_SIZE; nOps++)
+	{
+		unsigned nOpTicks = CTimer::GetClockTicks ();
+
+		u64 ullOffset = ullBase + (u64) nOps * BENCH_SEQ_BLOCK_SIZE;
+		int nResult = -1;
+		if (pDevice->Seek (ullOffset) == ullOffset)
+		{
+			nResult = bWrite ? pDevice->Write (m_pBuffer, BENCH_SEQ_BLOCK_SIZE)
+					 : pDevice->Read (m_pBuffer, BENCH_SEQ_BLOCK_SIZE);
+		}
+
+		if (nResult != BENCH_SEQ_BLOCK_SIZE)
+		{
+			CLogger::Get ()->Write (FromBench, LogError, "%s: I/O error at %llu",
+						pName, ullOffset);
+
+			return;
+		}
+
+		AddLatency (CTimer::GetClockTicks () - nOpTicks);
+	}
+
+	Report (pName, bWrite ? "raw-seq-write" : "raw-seq-read", BENCH_AREA_SIZE, nOps,
+		CTimer::GetClockTicks () - nStartTicks);
+}
+
+void CStorageBenchmark::RandomRaw (CDevice *pDevice, const char *pName, u64 ullBase,
+				   u64 ullRange, boolean bWrite, unsigned nDepth)
+{
+	assert (pDevice != 0);
+	assert (0 < nDepth && nDepth <= BENCH_MAX_QUEUE_DEPTH);
+
+	CString Test;
+	Test.Format ("raw-rand-%s-qd%u", bWrite ? "write" : "read", nDepth);
+
+	unsigned nStartTicks;
+	unsigned nOps = 0;
+
+	if (nDepth == 1)
+	{
+		// synchronous interface
+		StartTest ();
+		nStartTicks = CTimer::GetClockTicks ();
+
+		for (nOps = 0; nOps < BENCH_RANDOM_OPS; nOps++)
+		{
+			unsigned nOpTicks = CTimer::GetClockTicks ();
+
+			u64 ullOffset = ullBase + GetRandomOffset (ullRange);
+			int nResult = -1;
+			if (pDevice->Seek (ullOffset) == ullOffset)
+			{
+				nResult = bWrite ? pDevice->Write (m_pBuffer, BENCH_RANDOM_BLOCK_SIZE)
+						 : pDevice->Read (m_pBuffer, BENCH_RANDOM_BLOCK_SIZE);
+			}
+
+			if (nResult != BENCH_RANDOM_BLOCK_SIZE)
+			{
+				CLogger::Get ()->Write (FromBench, LogError, "%s: I/O error at %llu",
+							pName, ullOffset);
+
+				return;
+			}
+
+			AddLatency (CTimer::GetClockTicks () - nOpTicks);
+		}
+
+		Report (pName, Test, (u64) nOps * BENCH_RANDOM_BLOCK_SIZE, nOps,
+			CTimer::GetClockTicks () - nStartTicks);
+
+		return;
+	}
+
+	// queued interface
+	unsigned nIdleLoopsPerMs = GetIdleLoopsPerMs (nDepth);
+
+	StartTest ();
+	nStartTicks = CTimer::GetClockTicks ();
+
+	unsigned nSubmitted = 0;
+	for (unsigned i = 0; i < nDepth; i++)
+	{
+		if (!Submit (pDevice, i, ullBase + GetRandomOffset (ullRange), bWrite))
+		{
+			break;
+		}
+
+		nSubmitted++;
+	}
+
+	if (nSubmitted == 0)
+	{
+		CLogger::Get ()->Write (FromBench, LogNotice, "%s: Queued requests not supported",
+					pName);
+
+		return;
+	}
+
+	boolean bError = FALSE;
+	unsigned nIdleLoops = 0;
+	while (nOps < nSubmitted)
+	{
+		boolean bIdle = TRUE;
+
+		for (unsigned i = 0; i < nDepth; i++)
+		{
+			TSlot *pSlot = &m_Slot[i];
+			if (pSlot->State != SlotDone)
+			{
+				continue;
+			}
+
+			bIdle = FALSE;
+
+			AddLatency (CTimer::GetClockTicks () - pSlot->nStartTicks);
+			if (pSlot->nResult != BENCH_RANDOM_BLOCK_SIZE)
+			{
+				bError = TRUE;
+			}
+
+			pSlot->State = SlotFree;
+			nOps++;
+
+			if (   !bError
+			    && nSubmitted < BENCH_RANDOM_OPS)
+			{
+				if (Submit (pDevice, i, ullBase + GetRandomOffset (ullRange), bWrite))
+				{
+					nSubmitted++;
+				}
+				else
+				{
+					bError = TRUE;
+				}
+			}
+		}
+
+		if (bIdle)
+		{
+			nIdleLoops++;
+		}
+	}
+
+	unsigned nTicks = CTimer::GetClockTicks () - nStartTicks;
+
+	if (bError)
+	{
+		CLogger::Get ()->Write (FromBench, LogError, "%s: Queued I/O error", pName);
+
+		return;
+	}
+
+	Report (pName, Test, (u64) nOps * BENCH_RANDOM_BLOCK_SIZE, nOps, nTicks,
+		(unsigned) ((u64) nIdleLoops * 1000 / nIdleLoopsPerMs));
+}
+
+boolean CStorageBenchmark::Submit (CDevice *pDevice, unsigned nSlot, u64 ullOffset,
+				   boolean bWrite)
+{
+	assert (pDevice != 0);
+	assert (nSlot < BENCH_MAX_QUEUE_DEPTH);
+
+	TSlot *pSlot = &m_Slot[nSlot];
+	assert (pSlot->State == SlotFree);
+	pSlot->State = SlotActive;
+	pSlot->nStartTicks = CTimer::GetClockTicks ();
+
+	TDeviceBlockRequest Request;
+	Request.bWrite = bWrite;
+	Request.pBuffer = m_pBuffer + nSlot * BENCH_RANDOM_BLOCK_SIZE;
+	Request.ullOffset = ullOffset;
+	Request.nCount = BENCH_RANDOM_BLOCK_SIZE;
+	Request.pCompletionRoutine = CompletionRoutine;
+	Request.pParam = pSlot;
+
+	if (pDevice->IOCtl (DEVICE_IOCTL_SUBMIT, &Request) != 0)
+	{
+		pSlot->State = SlotFree;
+
+		return FALSE;
+	}
+
+	return TRUE;
+}
+
+void CStorageBenchmark::CompletionRoutine (int nResult, void *pParam)
+{
+	TSlot *pSlot = (TSlot *) pParam;
+	assert (pSlot != 0);
+	assert (pSlot->State == SlotActive);
+
+	pSlot->nResult = nResult;
+	DataMemBarrier ();
+	pSlot->State = SlotDone;
+}
+
+unsigned CStorageBenchmark::GetIdleLoopsPerMs (unsigned nDepth)
+{
+	// the same loop as in RandomRaw(), without completions
+	for (unsigned i = 0; i < nDepth; i++)
+	{
+		m_Slot[i].State = SlotActive;
+	}
+
+	unsigned nLoops = 0;
+	unsigned nStartTicks = CTimer::GetClockTicks ();
+	while (CTimer::GetClockTicks () - nStartTicks < 20000)
+	{
+		boolean bIdle = TRUE;
+
+		for (unsigned i = 0; i < nDepth; i++)
+		{
+			TSlot *pSlot = &m_Slot[i];
+			if (pSlot->State != SlotDone)
+			{
+				continue;
+			}
+
+			bIdle = FALSE;
+		}
+
+		if (bIdle)
+		{
+			nLoops++;
+		}
+	}
+
+	for (unsigned i = 0; i < nDepth; i++)
+	{
+		m_Slot[i].State = SlotFree;
+	}
+
+	nLoops /= 20;
+
+	return nLoops > 0 ? nLoops : 1;
+}
+
+void CStorageBenchmark::StartTest (void)
+{
+	m_nLatencies = 0;
+}
+
+void CStorageBenchmark::AddLatency (unsigned nTicks)
+{
+	if (m_nLatencies < BENCH_RANDOM_OPS)
+	{
+		m_pLatency[m_nLatencies++] = nTicks * 1000000 / CLOCKHZ;
+	}
+}
+
+void CStorageBenchmark::Report (const char *pName, const char *pTest, u64 ullBytes,
+				unsigned nOps, unsigned nTicks, unsigned nIdleTicks)
+{
+	if (nTicks == 0)
+	{
+		nTicks = 1;
+	}
+
+	if (nIdleTicks > nTicks)
+	{
+		nIdleTicks = nTicks;
+	}
+
+	double fSeconds = (double) nTicks / CLOCKHZ;
+	double fMBytes = (double) ullBytes / MB;
+	unsigned nBusyTicks = nTicks - nIdleTicks;
+
+	// sort the latencies for the percentiles (shell sort)
+	unsigned n = m_nLatencies;
+	for (unsigned nGap = n / 2; nGap > 0; nGap /= 2)
+	{
+		for (unsigned i = nGap; i < n; i++)
+		{
+			unsigned nValue = m_pLatency[i];
+			unsigned j;
+			for (j = i; j >= nGap && m_pLatency[j - nGap] > nValue; j -= nGap)
+			{
+				m_pLatency[j] = m_pLatency[j - nGap];
+			}
+
+			m_pLatency[j] = nValue;
+		}
+	}
+
+	unsigned nP50 = n > 0 ? m_pLatency[n * 50 / 100] : 0;
+	unsigned nP90 = n > 0 ? m_pLatency[n * 90 / 100] : 0;
+	unsigned nP99 = n > 0 ? m_pLatency[n * 99 / 100] : 0;
+	unsigned nMax = n > 0 ? m_pLatency[n - 1] : 0;
+
+	CLogger::Get ()->Write (FromBench, LogNotice,
+				"%s %s: %.2f MB/s, %u IOPS, latency us p50 %u p90 %u p99 %u max %u, "
+				"CPU %u%% %.0f us/MB",
+				pName, pTest, fMBytes / fSeconds, (unsigned) (nOps / fSeconds),
+				nP50, nP90, nP99, nMax,
+				(unsigned) ((u64) nBusyTicks * 100 / nTicks),
+				(double) nBusyTicks * 1000000 / CLOCKHZ / fMBytes);
+}
+
+u64 CStorageBenchmark::GetRandomOffset (u64 ullRange)
+{
+	u64 ullBlocks = ullRange / BENCH_RANDOM_BLOCK_SIZE;
+	assert (ullBlocks > 0);
+
+	// xorshift32
+	u64 ullRandom = 0;
+	for (unsigned i = 0; i < 2; i++)
+	{
+		m_nRandom ^= m_nRandom << 13;
+		m_nRandom ^= m_nRandom >> 17;
+		m_nRandom ^= m_nRandom << 5;
+
+		ullRandom = ullRandom << 32 | m_nRandom;
+	}
+
+	return ullRandom % ullBlocks * BENCH_RANDOM_BLOCK_SIZE;
+}
@@ -0,0 +1,97 @@
+//
+// storagebench.h
+//
+// Circle - A C++ bare metal environment for Raspberry Pi
+// Copyright (C) 2026  R. Stange <rsta2@gmx.net>
+// 
+// This program is free software: you can redistribute it and/or modify
+// it under the terms of the GNU General Public License as published by
+// the Free Software Foundation, either version 3 of the License, or
+// (at your option) any later version.
+//
+// This program is distributed in the hope that it will be useful,
+// but WITHOUT ANY WARRANTY; without even the implied warranty of
+// MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+// GNU General Public License for more details.
+//
+// You should have received a copy of the GNU General Public License
+// along with this program.  If not, see <http://www.gnu.org/licenses/>.
+//
+#ifndef _storagebench_h
+#define _storagebench_h
+
+#include <circle/device.h>
+#include <circle/fs/fat/fatfs.h>
+#include <circle/types.h>
+
+#define BENCH_AREA_SIZE		(64 * 0x100000)	// bytes used by each test
+#define BENCH_SEQ_BLOCK_SIZE	0x100000	// bytes per sequential transfer
+#define BENCH_RANDOM_BLOCK_SIZE	4096		// bytes per random transfer
+#define BENCH_RANDOM_OPS	2000		// random transfers per test
+#define BENCH_MAX_QUEUE_DEPTH	32
+
+class CStorageBenchmark		/// Measures throughput, IOPS, latency and CPU use of storage
+{
+public:
+	CStorageBenchmark (void);
+	~CStorageBenchmark (void);
+
+	/// \brief Tests on a raw block device
+	/// \param pDevice Block device (e.g. "emmc1") or partition
+	/// \param pName Name used in the report
+	/// \param bWrite Run the write tests too (overwrites data at the end of the device!)
+	void RunRaw (CDevice *pDevice, const char *pName, boolean bWrite);
+
+	/// \brief Tests on a mounted FatFs volume, using a temporary file
+	/// \param pVolume Volume ID with colon (e.g. "SD:")
+	void RunFatFs (const char *pVolume);
+
+	/// \brief Tests on the native FAT file system driver, using a temporary file
+	/// \param pPartition Partition device (e.g. "emmc1-1")
+	/// \param pName Name used in the report
+	void RunFAT (CDevice *pPartition, const char *pName);
+
+private:
+	void SequentialRaw (CDevice *pDevice, const char *pName, u64 ullBase, boolean bWrite);
+	void RandomRaw (CDevice *pDevice, const char *pName, u64 ullBase, u64 ullRange,
+			boolean bWrite, unsigned nDepth);
+
+	void StartTest (void);
+	void AddLatency (unsigned nTicks);
+	// nIdleTicks is 0 for synchronous tests, which occupy the CPU all the time
+	void Report (const char *pName, const char *pTest, u64 ullBytes, unsigned nOps,
+		     unsigned nTicks, unsigned nIdleTicks = 0);
+
+	u64 GetRandomOffset (u64 ullRange);
+
+	boolean Submit (CDevice *pDevice, unsigned nSlot, u64 ullOffset, boolean bWrite);
+	unsigned GetIdleLoopsPerMs (unsigned nDepth);
+
+	static void CompletionRoutine (int nResult, void *pParam);
+
+private:
+	u8 *m_pBuffer;
+
+	unsigned *m_pLatency;			// in microseconds
+	unsigned m_nLatencies;
+
+	u32 m_nRandom;
+
+	enum TSlotState
+	{
+		SlotFree,
+		SlotActive,
+		SlotDone
+	};
+
+	struct TSlot
+	{
+		volatile TSlotState State;
+		volatile int nResult;
+		unsigned nStartTicks;
+	};
+
+	TSlot m_Slot[BENCH_MAX_QUEUE_DEPTH];
+};
+
+#endif
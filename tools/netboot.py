@@ -0,0 +1,127 @@
+#
+# netboot.py - Sends a kernel image to sample/38-bootloader via TCP or multicast UDP
+#
+# Usage:
+#	python3 netboot.py IPADDRESS KERNELIMAGE		full transfer via TCP
+#	python3 netboot.py -d IPADDRESS KERNELIMAGE		send modified blocks only
+#	python3 netboot.py -m KERNELIMAGE [IPADDRESS ...]	multicast to all boards, then
+#								repair and boot the given boards
+#
+
+import socket
+import struct
+import sys
+import time
+import zlib
+
+TCP_PORT = 8081
+MULTICAST_GROUP = "239.255.38.1"
+MULTICAST_PORT = 8082
+
+TCP_MAGIC = 0x54424343
+CMD_BEGIN = 1
+CMD_DATA = 2
+CMD_BLOCKCRC = 3
+CMD_BOOT = 4
+
+MULTICAST_MAGIC = 0x4D424343
+BLOCK_SIZE = 1024
+MULTICAST_ROUNDS = 2
+
+def receive_all(sock, length):
+	data = b""
+	while len(data) < length:
+		chunk = sock.recv(length - len(data))
+		if not chunk:
+			raise Exception("Connection closed")
+		data += chunk
+	return data
+
+def request(sock, command, param1=0, param2=0):
+	sock.sendall(struct.pack("<IIII", TCP_MAGIC, command, param1, param2))
+
+def receive_status(sock):
+	return struct.unpack("<I", receive_all(sock, 4))[0]
+
+def tcp_boot(address, image, delta):
+	crc = zlib.crc32(image) & 0xFFFFFFFF
+
+	sock = socket.create_connection((address, TCP_PORT))
+	sock.setsockopt(socket.IPPROTO_TCP, socket.TCP_NODELAY, 1)
+
+	request(sock, CMD_BEGIN, len(image), crc)
+	if receive_status(sock) != 0:
+		raise Exception("Image rejected (too big?)")
+
+	blocks = range(0, len(image), BLOCK_SIZE)
+	if delta:
+		request(sock, CMD_BLOCKCRC, BLOCK_SIZE)
+		count = struct.unpack("<I", receive_all(sock, 4))[0]
+		crcs = struct.unpack("<%dI" % count, receive_all(sock, 4 * count))
+		blocks = [offset for i, offset in enumerate(blocks)
+			  if i >= count or crcs[i] != zlib.crc32(image[offset:offset+BLOCK_SIZE]) & 0xFFFFFFFF]
+		print(address + ": " + str(len(blocks)) + " modified blocks")
+		for offset in blocks:
+			block = image[offset:offset+BLOCK_SIZE]
+			request(sock, CMD_DATA, offset, len(block))
+			sock.sendall(block)
+	else:
+		request(sock, CMD_DATA, 0, len(image))
+		sock.sendall(image)
+
+	request(sock, CMD_BOOT)
+	status = receive_status(sock)
+	sock.close()
+
+	if status != 0:
+		raise Exception("CRC error")
+
+	print(address + ": Booting")
+
+def multicast_send(image):
+	crc = zlib.crc32(image) & 0xFFFFFFFF
+
+	sock = socket.socket(socket.AF_INET, socket.SOCK_DGRAM, socket.IPPROTO_UDP)
+	sock.setsockopt(socket.IPPROTO_IP, socket.IP_MULTICAST_TTL, 1)
+
+	for round in range(MULTICAST_ROUNDS):
+		for offset in range(0, len(image), BLOCK_SIZE):
+			sock.sendto(struct.pack("<IIII", MULTICAST_MAGIC, len(image), crc, offset)
+				    + image[offset:offset+BLOCK_SIZE],
+				    (MULTICAST_GROUP, MULTICAST_PORT))
+			if offset % (32 * BLOCK_SIZE) == 0:
+				time.sleep(0.002)	# do not overrun the receive queues
+
+	sock.close()
+
+try:
+	mode = sys.argv[1] if sys.argv[1] in ("-d", "-m") else ""
+	args = sys.argv[2:] if mode else sys.argv[1:]
+	if mode == "-m":
+		filename = args[0]
+		addresses = args[1:]
+	else:
+		addresses = [args[0]]
+		filename = args[1]
+except Exception:
+	print("Usage: python3 netboot.py [-d] IPADDRESS KERNELIMAGE")
+	print("       python3 netboot.py -m KERNELIMAGE [IPADDRESS ...]")
+	exit(1)
+
+try:
+	with open(filename, "rb") as f:
+		image = f.read()
+except Exception:
+	print("ERROR: Cannot read " + filename)
+	exit(1)
+
+try:
+	if mode == "-m":
+		print("Sending " + str(len(image)) + " bytes to " + MULTICAST_GROUP + " ...")
+		multicast_send(image)
+
+	for address in addresses:
+		tcp_boot(address, image, mode != "")
+except Exception as e:
+	print("ERROR: " + str(e))
+	exit(1)